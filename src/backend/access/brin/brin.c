@@ -19,20 +19,27 @@
 #include "access/brin_page.h"
 #include "access/brin_pageops.h"
 #include "access/brin_xlog.h"
+#include "access/parallel.h"
 #include "access/relation.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
 #include "access/table.h"
 #include "access/tableam.h"
+#include "access/xact.h"
 #include "access/xloginsert.h"
 #include "catalog/index.h"
 #include "catalog/pg_am.h"
 #include "commands/vacuum.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
 #include "storage/freespace.h"
+#include "storage/lmgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
@@ -40,11 +47,73 @@
 #include "utils/index_selfuncs.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/tuplesort.h"
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_BRIN_SHARED		UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xB000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xB000000000000005)
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment, like BTShared for btree builds.
+ */
+typedef struct BrinShared
+{
+	/* immutable state */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	BlockNumber pagesPerRange;
+	int			scantuplesortstates;
+
+	/* signalled whenever a participant finishes its part of the scan */
+	ConditionVariable workersdonecv;
+
+	/* mutex protects the fields below */
+	slock_t		mutex;
+
+	int			nparticipantsdone;
+	double		reltuples;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} BrinShared;
+
+#define ParallelTableScanFromBrinShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(BrinShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct BrinLeader
+{
+	ParallelContext *pcxt;
+
+	/* worker processes launched, plus the leader itself */
+	int			nparticipanttuplesorts;
+
+	BrinShared *brinshared;
+	Sharedsort *sharedsort;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} BrinLeader;
 
 /*
  * We use a BrinBuildState during initial construction of a BRIN index.
  * The running state is kept in a BrinMemTuple.
+ *
+ * In a parallel build, bs_leader is set in the leader, and bs_sortstate in
+ * every participant.  Participants send the summary of each range they see
+ * to the sort instead of the index, and the leader unions the summaries
+ * that the participants produced for the same range.
  */
 typedef struct BrinBuildState
 {
@@ -56,6 +125,9 @@ typedef struct BrinBuildState
 	BrinRevmap *bs_rmAccess;
 	BrinDesc   *bs_bdesc;
 	BrinMemTuple *bs_dtuple;
+
+	BrinLeader *bs_leader;
+	Tuplesortstate *bs_sortstate;
 } BrinBuildState;
 
 /*
@@ -76,6 +148,18 @@ static void terminate_brin_buildstate(BrinBuildState *state);
 static void brinsummarize(Relation index, Relation heapRel, BlockNumber pageRange,
 						  bool include_partial, double *numSummarized, double *numExisting);
 static void form_and_insert_tuple(BrinBuildState *state);
+static void form_and_spill_tuple(BrinBuildState *state);
+static bool brin_summarize_range_inline(Relation idxRel, Relation heapRel,
+										BlockNumber heapBlk);
+static void _brin_begin_parallel(BrinBuildState *buildstate, Relation heap,
+								 Relation index, bool isconcurrent,
+								 int request);
+static void _brin_end_parallel(BrinLeader *brinleader);
+static double _brin_parallel_merge(BrinBuildState *state, Relation heap);
+static void _brin_parallel_scan_and_build(BrinShared *brinshared,
+										  Sharedsort *sharedsort,
+										  Relation heap, Relation index,
+										  int sortmem, bool progress);
 static void union_tuples(BrinDesc *bdesc, BrinMemTuple *a,
 						 BrinTuple *b);
 static void brin_vacuum_scan(Relation idxrel, BufferAccessStrategy strategy);
@@ -129,6 +213,7 @@ brinhandler(PG_FUNCTION_ARGS)
 	amroutine->ambeginscan = brinbeginscan;
 	amroutine->amrescan = brinrescan;
 	amroutine->amgettuple = NULL;
+	amroutine->amgetbatch = NULL;
 	amroutine->amgetbitmap = bringetbitmap;
 	amroutine->amendscan = brinendscan;
 	amroutine->ammarkpos = NULL;
@@ -147,7 +232,9 @@ brinhandler(PG_FUNCTION_ARGS)
  * the summary tuple, we need to update the index tuple.
  *
  * If autosummarization is enabled, check if we need to summarize the previous
- * page range.
+ * page range.  We try to do that right away, while its pages are likely still
+ * cached, and leave it to autovacuum only if that cannot be done without
+ * waiting for a lock.
  *
  * If the range is not currently summarized (i.e. the revmap returns NULL for
  * it), there's nothing to do for this tuple.
@@ -203,7 +290,8 @@ brininsert(Relation idxRel, Datum *values, bool *nulls,
 			lastPageTuple =
 				brinGetTupleForHeapBlock(revmap, lastPageRange, &buf, &off,
 										 NULL, BUFFER_LOCK_SHARE, NULL);
-			if (!lastPageTuple)
+			if (!lastPageTuple &&
+				!brin_summarize_range_inline(idxRel, heapRel, lastPageRange))
 			{
 				bool		recorded;
 
@@ -217,7 +305,7 @@ brininsert(Relation idxRel, Datum *values, bool *nulls,
 									RelationGetRelationName(idxRel),
 									lastPageRange)));
 			}
-			else
+			else if (lastPageTuple)
 				LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 		}
 
@@ -793,6 +881,29 @@ brinbuildCallback(Relation index,
 
 	thisblock = ItemPointerGetBlockNumber(tid);
 
+	/*
+	 * A participant in a parallel build sees the heap in chunks, which need
+	 * not come in order.  When it moves to a block outside the current range,
+	 * it sends what it has to the sort and starts afresh on the new range;
+	 * ranges it saw nothing of are left for the leader to fill in.
+	 */
+	if (state->bs_sortstate)
+	{
+		if (thisblock < state->bs_currRangeStart ||
+			thisblock > state->bs_currRangeStart + state->bs_pagesPerRange - 1)
+		{
+			form_and_spill_tuple(state);
+
+			state->bs_currRangeStart =
+				(thisblock / state->bs_pagesPerRange) * state->bs_pagesPerRange;
+			brin_memtuple_initialize(state->bs_dtuple, state->bs_bdesc);
+		}
+
+		(void) add_values_to_range(index, state->bs_bdesc, state->bs_dtuple,
+								   values, isnull);
+		return;
+	}
+
 	/*
 	 * If we're in a block that belongs to a future range, summarize what
 	 * we've got and start afresh.  Note the scan might have skipped many
@@ -883,12 +994,30 @@ brinbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	revmap = brinRevmapInitialize(index, &pagesPerRange, NULL);
 	state = initialize_brin_buildstate(index, revmap, pagesPerRange);
 
-	/*
-	 * Now scan the relation.  No syncscan allowed here because we want the
-	 * heap blocks in physical order.
-	 */
-	reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
-									   brinbuildCallback, (void *) state, NULL);
+	/* Attempt to launch parallel worker scan when required */
+	if (indexInfo->ii_ParallelWorkers > 0)
+		_brin_begin_parallel(state, heap, index, indexInfo->ii_Concurrent,
+							 indexInfo->ii_ParallelWorkers);
+
+	if (state->bs_leader)
+	{
+		/*
+		 * The participants have summarized the ranges in their parts of the
+		 * heap; combine and insert the summaries in block order.
+		 */
+		reltuples = _brin_parallel_merge(state, heap);
+		_brin_end_parallel(state->bs_leader);
+	}
+	else
+	{
+		/*
+		 * Now scan the relation.  No syncscan allowed here because we want
+		 * the heap blocks in physical order.
+		 */
+		reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
+										   brinbuildCallback, (void *) state,
+										   NULL);
+	}
 
 	/* process the final batch */
 	form_and_insert_tuple(state);
@@ -1320,6 +1449,8 @@ initialize_brin_buildstate(Relation idxRel, BrinRevmap *revmap,
 	state->bs_rmAccess = revmap;
 	state->bs_bdesc = brin_build_desc(idxRel);
 	state->bs_dtuple = brin_new_memtuple(state->bs_bdesc);
+	state->bs_leader = NULL;
+	state->bs_sortstate = NULL;
 
 	return state;
 }
@@ -1612,6 +1743,58 @@ form_and_insert_tuple(BrinBuildState *state)
 	pfree(tup);
 }
 
+/*
+ * In a participant of a parallel build, convert the deformed tuple in the
+ * build state into the on-disk format and send it to the sort.  Nothing is
+ * sent for a range in which no tuples were seen.
+ */
+static void
+form_and_spill_tuple(BrinBuildState *state)
+{
+	BrinTuple  *tup;
+	Size		size;
+
+	if (state->bs_dtuple->bt_empty_range)
+		return;
+
+	tup = brin_form_tuple(state->bs_bdesc, state->bs_currRangeStart,
+						  state->bs_dtuple, &size);
+	tuplesort_putbrintuple(state->bs_sortstate, tup, size);
+	state->bs_numtuples++;
+
+	pfree(tup);
+}
+
+/*
+ * Summarize the page range containing heapBlk from within brininsert(), when
+ * an insertion has moved past its end.  The range was written just now, so
+ * its heap pages are most likely still in shared buffers and scanning them is
+ * cheap.  summarize_range() copes with concurrent insertions into it.
+ *
+ * We take the same locks as brin_summarize_range(), but do not wait for
+ * them: if the table is being vacuumed or somebody else is summarizing the
+ * index, we return false and let the caller hand the range to autovacuum.
+ */
+static bool
+brin_summarize_range_inline(Relation idxRel, Relation heapRel,
+							BlockNumber heapBlk)
+{
+	if (!ConditionalLockRelation(heapRel, ShareUpdateExclusiveLock))
+		return false;
+	if (!ConditionalLockRelation(idxRel, ShareUpdateExclusiveLock))
+	{
+		UnlockRelation(heapRel, ShareUpdateExclusiveLock);
+		return false;
+	}
+
+	brinsummarize(idxRel, heapRel, heapBlk, false, NULL, NULL);
+
+	UnlockRelation(idxRel, ShareUpdateExclusiveLock);
+	UnlockRelation(heapRel, ShareUpdateExclusiveLock);
+
+	return true;
+}
+
 /*
  * Given two deformed tuples, adjust the first one so that it's consistent
  * with the summary values in both.
@@ -1931,3 +2114,397 @@ check_null_keys(BrinValues *bval, ScanKey *nullkeys, int nnullkeys)
 
 	return true;
 }
+
+/*
+ * Create parallel context, and launch workers for leader.
+ *
+ * Like _bt_begin_parallel(), sets buildstate's BrinLeader only if at least
+ * one worker process could be launched; otherwise caller does a serial build.
+ */
+static void
+_brin_begin_parallel(BrinBuildState *buildstate, Relation heap, Relation index,
+					 bool isconcurrent, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		estbrinshared;
+	Size		estsort;
+	BrinShared *brinshared;
+	Sharedsort *sharedsort;
+	BrinLeader *brinleader = (BrinLeader *) palloc0(sizeof(BrinLeader));
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			querylen;
+	int			sortmem;
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of brin
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_brin_parallel_build_main",
+								 request);
+
+	/* the leader participates as a worker, too */
+	scantuplesortstates = request + 1;
+
+	/*
+	 * Prepare for scan of the base relation.  As in btree builds, a normal
+	 * build uses SnapshotAny, and a concurrent one a regular MVCC snapshot.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_BRIN_SHARED workspace, and
+	 * PARALLEL_KEY_TUPLESORT tuplesort workspace
+	 */
+	estbrinshared = add_size(BUFFERALIGN(sizeof(BrinShared)),
+							 table_parallelscan_estimate(heap, snapshot));
+	shm_toc_estimate_chunk(&pcxt->estimator, estbrinshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/* Estimate space for WalUsage and BufferUsage */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	brinshared = (BrinShared *) shm_toc_allocate(pcxt->toc, estbrinshared);
+	brinshared->heaprelid = RelationGetRelid(heap);
+	brinshared->indexrelid = RelationGetRelid(index);
+	brinshared->isconcurrent = isconcurrent;
+	brinshared->pagesPerRange = buildstate->bs_pagesPerRange;
+	brinshared->scantuplesortstates = scantuplesortstates;
+	ConditionVariableInit(&brinshared->workersdonecv);
+	SpinLockInit(&brinshared->mutex);
+	brinshared->nparticipantsdone = 0;
+	brinshared->reltuples = 0.0;
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromBrinShared(brinshared),
+								  snapshot);
+
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BRIN_SHARED, brinshared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	brinleader->pcxt = pcxt;
+	brinleader->nparticipanttuplesorts = pcxt->nworkers_launched + 1;
+	brinleader->brinshared = brinshared;
+	brinleader->sharedsort = sharedsort;
+	brinleader->snapshot = snapshot;
+	brinleader->walusage = walusage;
+	brinleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_brin_end_parallel(brinleader);
+		return;
+	}
+
+	/* Save leader state now that it's clear build will be parallel */
+	buildstate->bs_leader = brinleader;
+
+	/*
+	 * Join heap scan ourselves.  Might as well use reliable figure when
+	 * doling out maintenance_work_mem.
+	 */
+	sortmem = maintenance_work_mem / brinleader->nparticipanttuplesorts;
+	_brin_parallel_scan_and_build(brinshared, sharedsort, heap, index,
+								  sortmem, true);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_brin_end_parallel(BrinLeader *brinleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(brinleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < brinleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&brinleader->bufferusage[i], &brinleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(brinleader->snapshot))
+		UnregisterSnapshot(brinleader->snapshot);
+	DestroyParallelContext(brinleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Within leader, wait for the participants to finish their scans, then read
+ * the merged output of their sorts and insert the index tuples.
+ *
+ * The summaries arrive in block order, possibly several for one range when
+ * it was split between participants; those are unioned.  Ranges nobody
+ * produced a summary for get an empty index tuple, the same as in a serial
+ * build.  On return, the build state holds the last range, which the caller
+ * inserts.
+ *
+ * Returns the total number of heap tuples scanned.
+ */
+static double
+_brin_parallel_merge(BrinBuildState *state, Relation heap)
+{
+	BrinLeader *brinleader = state->bs_leader;
+	BrinShared *brinshared = brinleader->brinshared;
+	SortCoordinate coordinate;
+	Tuplesortstate *sortstate;
+	BrinTuple  *btup;
+	Size		tuplen;
+	MemoryContext oldcxt;
+	double		reltuples = 0;
+
+	for (;;)
+	{
+		SpinLockAcquire(&brinshared->mutex);
+		if (brinshared->nparticipantsdone == brinleader->nparticipanttuplesorts)
+		{
+			reltuples = brinshared->reltuples;
+			SpinLockRelease(&brinshared->mutex);
+			break;
+		}
+		SpinLockRelease(&brinshared->mutex);
+
+		ConditionVariableSleep(&brinshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+	ConditionVariableCancelSleep();
+
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = false;
+	coordinate->nParticipants = brinleader->nparticipanttuplesorts;
+	coordinate->sharedsort = brinleader->sharedsort;
+
+	sortstate = tuplesort_begin_index_brin(maintenance_work_mem, coordinate,
+										   TUPLESORT_NONE);
+	tuplesort_performsort(sortstate);
+
+	state->bs_currRangeStart = 0;
+	brin_memtuple_initialize(state->bs_dtuple, state->bs_bdesc);
+
+	while ((btup = tuplesort_getbrintuple(sortstate, &tuplen, true)) != NULL)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		/* insert the ranges before this one, including any missing ones */
+		while (btup->bt_blkno > state->bs_currRangeStart)
+		{
+			form_and_insert_tuple(state);
+			state->bs_currRangeStart += state->bs_pagesPerRange;
+			brin_memtuple_initialize(state->bs_dtuple, state->bs_bdesc);
+		}
+
+		/*
+		 * Union the summary in the memtuple's own context, so that it is
+		 * released with the range.
+		 */
+		Assert(btup->bt_blkno == state->bs_currRangeStart);
+		oldcxt = MemoryContextSwitchTo(state->bs_dtuple->bt_context);
+		union_tuples(state->bs_bdesc, state->bs_dtuple, btup);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	tuplesort_end(sortstate);
+
+	return reltuples;
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_brin_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	BrinShared *brinshared;
+	Sharedsort *sharedsort;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			sortmem;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up brin shared state */
+	brinshared = shm_toc_lookup(toc, PARALLEL_KEY_BRIN_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!brinshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(brinshared->heaprelid, heapLockmode);
+	indexRel = index_open(brinshared->indexrelid, indexLockmode);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	sortmem = maintenance_work_mem / brinshared->scantuplesortstates;
+	_brin_parallel_scan_and_build(brinshared, sharedsort, heapRel, indexRel,
+								  sortmem, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Perform a participant's portion of a parallel build: scan its share of the
+ * heap and sort the summaries of the ranges it saw.
+ *
+ * sortmem is the amount of working memory to use within each participant,
+ * expressed in KBs.
+ */
+static void
+_brin_parallel_scan_and_build(BrinShared *brinshared, Sharedsort *sharedsort,
+							  Relation heap, Relation index,
+							  int sortmem, bool progress)
+{
+	SortCoordinate coordinate;
+	BrinBuildState *state;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	/* no revmap is needed, as participants don't touch the index */
+	state = initialize_brin_buildstate(index, NULL, brinshared->pagesPerRange);
+	state->bs_sortstate = tuplesort_begin_index_brin(Max(sortmem, 64),
+													 coordinate,
+													 TUPLESORT_NONE);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = brinshared->isconcurrent;
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromBrinShared(brinshared));
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   brinbuildCallback, (void *) state,
+									   scan);
+
+	/* send the last range to the sort, and execute this worker's part */
+	form_and_spill_tuple(state);
+	tuplesort_performsort(state->bs_sortstate);
+
+	/* Done.  Record ambuild statistics. */
+	SpinLockAcquire(&brinshared->mutex);
+	brinshared->nparticipantsdone++;
+	brinshared->reltuples += reltuples;
+	SpinLockRelease(&brinshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&brinshared->workersdonecv);
+
+	/* Help the leader with the final merge, see _bt_parallel_scan_and_sort */
+	if (IsParallelWorker())
+		tuplesort_merge_ranges(state->bs_sortstate);
+
+	tuplesort_end(state->bs_sortstate);
+	state->bs_sortstate = NULL;
+
+	terminate_brin_buildstate(state);
+}
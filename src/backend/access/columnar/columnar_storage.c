@@ -0,0 +1,654 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_storage.c
+ *	  page-level storage of the columnar table access method
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_storage.c
+ *
+ * INTERFACE ROUTINES
+ *		columnar_reserve_rownums	- reserve row numbers for new rows
+ *		columnar_next_rownum		- first row number not yet reserved
+ *		columnar_write_stripe		- write a stripe and add it to the directory
+ *		columnar_append_delete		- add an entry to the delete log
+ *		columnar_read_stripes		- read new entries of the stripe directory
+ *		columnar_read_deletes		- read new entries of the delete log
+ *		columnar_read_stripe_data	- read a byte range of a stripe
+ *		columnar_freeze				- freeze old xids of the directory and log
+ *		columnar_xid_visible		- is the xid visible to a snapshot?
+ *
+ * NOTES
+ *
+ * A columnar table is append-only: stripes, once written, are never
+ * changed, and a delete is an entry in the delete log.  The only pages ever
+ * modified in place are the metapage, the last page of each list, and list
+ * pages whose xids VACUUM freezes.  All changes are WAL-logged as generic
+ * WAL records, so that recovery and physical replication need nothing
+ * specific to this access method.
+ *
+ * Writers hold the metapage exclusively while they extend the relation and
+ * link new pages into the lists, which serializes them and keeps the pages
+ * of a stripe consecutive.  Readers share-lock each list page they copy
+ * items from, and can resume reading a list where they left off, to pick up
+ * only the entries appended since.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/columnar.h"
+#include "access/generic_xlog.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "commands/vacuum.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
+#include "storage/procarray.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+
+
+#define ColumnarPageGetMeta(page) \
+	((ColumnarMetaPageData *) PageGetContents(page))
+#define ColumnarPageGetListHeader(page) \
+	((ColumnarListPageHeader *) PageGetContents(page))
+#define ColumnarListPageItem(page, itemsz, i) \
+	((char *) (ColumnarPageGetListHeader(page) + 1) + (i) * (itemsz))
+
+/* number of stripe pages to extend the relation by at once */
+#define COLUMNAR_EXTEND_BATCH	64
+
+/*
+ * Set pd_lower to just past len bytes of contents, so that the contents
+ * survive the hole elimination of full-page images.
+ */
+static void
+columnar_set_contents_length(Page page, Size len)
+{
+	((PageHeader) page)->pd_lower = (PageGetContents(page) - page) + len;
+}
+
+static void
+columnar_check_meta(Relation rel, ColumnarMetaPageData *meta)
+{
+	if (meta->magic != COLUMNAR_MAGIC)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("\"%s\" is not a columnar table",
+						RelationGetRelationName(rel))));
+	if (meta->version != COLUMNAR_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("columnar table \"%s\" has wrong version %u, expected %u",
+						RelationGetRelationName(rel), meta->version,
+						COLUMNAR_VERSION)));
+}
+
+/*
+ * Create the metapage if the relation is still empty.
+ *
+ * The metapage is created by the first write rather than when the storage
+ * is created, so that creating a columnar table needs no WAL beyond that of
+ * the storage itself.
+ */
+static void
+columnar_ensure_meta(Relation rel)
+{
+	Buffer		buf;
+	GenericXLogState *state;
+	Page		page;
+	ColumnarMetaPageData *meta;
+
+	if (RelationGetNumberOfBlocks(rel) > 0)
+		return;
+
+	LockRelationForExtension(rel, ExclusiveLock);
+
+	/* somebody else might have got here first */
+	if (RelationGetNumberOfBlocks(rel) > 0)
+	{
+		UnlockRelationForExtension(rel, ExclusiveLock);
+		return;
+	}
+
+	buf = ExtendBufferedRel(BMR_REL(rel), MAIN_FORKNUM, NULL,
+							EB_LOCK_FIRST | EB_SKIP_EXTENSION_LOCK);
+	Assert(BufferGetBlockNumber(buf) == COLUMNAR_METAPAGE_BLKNO);
+
+	state = GenericXLogStart(rel);
+	page = GenericXLogRegisterBuffer(state, buf, GENERIC_XLOG_FULL_IMAGE);
+	PageInit(page, BLCKSZ, 0);
+	meta = ColumnarPageGetMeta(page);
+	meta->magic = COLUMNAR_MAGIC;
+	meta->version = COLUMNAR_VERSION;
+	meta->dir_head = InvalidBlockNumber;
+	meta->dir_tail = InvalidBlockNumber;
+	meta->del_head = InvalidBlockNumber;
+	meta->del_tail = InvalidBlockNumber;
+	meta->next_rownum = 0;
+	columnar_set_contents_length(page, sizeof(ColumnarMetaPageData));
+	GenericXLogFinish(state);
+
+	UnlockReleaseBuffer(buf);
+	UnlockRelationForExtension(rel, ExclusiveLock);
+}
+
+/*
+ * Pin and lock the metapage in the given mode.  Returns InvalidBuffer if
+ * the relation is empty; pass create = true to create the metapage then.
+ */
+static Buffer
+columnar_lock_meta(Relation rel, int mode, bool create)
+{
+	Buffer		buf;
+
+	if (create)
+		columnar_ensure_meta(rel);
+	else if (RelationGetNumberOfBlocks(rel) == 0)
+		return InvalidBuffer;
+
+	buf = ReadBuffer(rel, COLUMNAR_METAPAGE_BLKNO);
+	LockBuffer(buf, mode);
+	columnar_check_meta(rel, ColumnarPageGetMeta(BufferGetPage(buf)));
+
+	return buf;
+}
+
+/*
+ * columnar_reserve_rownums - reserve nrows consecutive row numbers
+ *
+ * Returns the first of them.  Rows of aborted transactions leave holes in
+ * the numbering, which is harmless.
+ */
+uint64
+columnar_reserve_rownums(Relation rel, uint64 nrows)
+{
+	Buffer		metabuf;
+	GenericXLogState *state;
+	ColumnarMetaPageData *meta;
+	uint64		first;
+
+	metabuf = columnar_lock_meta(rel, BUFFER_LOCK_EXCLUSIVE, true);
+
+	state = GenericXLogStart(rel);
+	meta = ColumnarPageGetMeta(GenericXLogRegisterBuffer(state, metabuf, 0));
+	first = meta->next_rownum;
+	if (nrows > COLUMNAR_MAX_ROWNUM - first)
+	{
+		GenericXLogAbort(state);
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("columnar table \"%s\" has run out of row numbers",
+						RelationGetRelationName(rel))));
+	}
+	meta->next_rownum += nrows;
+	GenericXLogFinish(state);
+
+	UnlockReleaseBuffer(metabuf);
+
+	return first;
+}
+
+/*
+ * columnar_next_rownum - first row number not yet reserved
+ */
+uint64
+columnar_next_rownum(Relation rel)
+{
+	Buffer		metabuf;
+	uint64		result;
+
+	metabuf = columnar_lock_meta(rel, BUFFER_LOCK_SHARE, false);
+	if (!BufferIsValid(metabuf))
+		return 0;
+
+	result = ColumnarPageGetMeta(BufferGetPage(metabuf))->next_rownum;
+	UnlockReleaseBuffer(metabuf);
+
+	return result;
+}
+
+/*
+ * Append an item to the stripe directory (is_dir) or the delete log.  The
+ * caller holds the metapage exclusively.
+ */
+static void
+columnar_list_append(Relation rel, Buffer metabuf, bool is_dir,
+					 const void *item, Size itemsz)
+{
+	ColumnarMetaPageData *meta = ColumnarPageGetMeta(BufferGetPage(metabuf));
+	BlockNumber tail = is_dir ? meta->dir_tail : meta->del_tail;
+	Buffer		tailbuf = InvalidBuffer;
+	Buffer		newbuf;
+	BlockNumber newblk;
+	GenericXLogState *state;
+	Page		page;
+	ColumnarListPageHeader *hdr;
+
+	if (BlockNumberIsValid(tail))
+	{
+		tailbuf = ReadBuffer(rel, tail);
+		LockBuffer(tailbuf, BUFFER_LOCK_EXCLUSIVE);
+		hdr = ColumnarPageGetListHeader(BufferGetPage(tailbuf));
+
+		if (hdr->nitems < COLUMNAR_ITEMS_PER_PAGE(itemsz))
+		{
+			state = GenericXLogStart(rel);
+			page = GenericXLogRegisterBuffer(state, tailbuf, 0);
+			hdr = ColumnarPageGetListHeader(page);
+			memcpy(ColumnarListPageItem(page, itemsz, hdr->nitems), item, itemsz);
+			hdr->nitems++;
+			columnar_set_contents_length(page, sizeof(ColumnarListPageHeader) +
+										 hdr->nitems * itemsz);
+			GenericXLogFinish(state);
+
+			UnlockReleaseBuffer(tailbuf);
+			return;
+		}
+	}
+
+	/* the tail page is full, or there is none yet: start a new page */
+	newbuf = ExtendBufferedRel(BMR_REL(rel), MAIN_FORKNUM, NULL, EB_LOCK_FIRST);
+	newblk = BufferGetBlockNumber(newbuf);
+
+	state = GenericXLogStart(rel);
+
+	page = GenericXLogRegisterBuffer(state, newbuf, GENERIC_XLOG_FULL_IMAGE);
+	PageInit(page, BLCKSZ, 0);
+	hdr = ColumnarPageGetListHeader(page);
+	hdr->next = InvalidBlockNumber;
+	hdr->nitems = 1;
+	memcpy(ColumnarListPageItem(page, itemsz, 0), item, itemsz);
+	columnar_set_contents_length(page, sizeof(ColumnarListPageHeader) + itemsz);
+
+	if (BufferIsValid(tailbuf))
+	{
+		page = GenericXLogRegisterBuffer(state, tailbuf, 0);
+		ColumnarPageGetListHeader(page)->next = newblk;
+	}
+
+	meta = ColumnarPageGetMeta(GenericXLogRegisterBuffer(state, metabuf, 0));
+	if (is_dir)
+	{
+		if (!BlockNumberIsValid(meta->dir_head))
+			meta->dir_head = newblk;
+		meta->dir_tail = newblk;
+	}
+	else
+	{
+		if (!BlockNumberIsValid(meta->del_head))
+			meta->del_head = newblk;
+		meta->del_tail = newblk;
+	}
+
+	GenericXLogFinish(state);
+
+	UnlockReleaseBuffer(newbuf);
+	if (BufferIsValid(tailbuf))
+		UnlockReleaseBuffer(tailbuf);
+}
+
+/*
+ * columnar_write_stripe - write the data of a stripe and add it to the
+ * stripe directory
+ *
+ * The stripe becomes visible to others once its writer commits, like a heap
+ * tuple.
+ */
+void
+columnar_write_stripe(Relation rel, char *data, uint32 datalen,
+					  uint64 first_rownum, uint32 nrows,
+					  TransactionId xmin, CommandId cmin)
+{
+	Buffer		metabuf;
+	ColumnarStripeEntry entry;
+	uint32		nblocks;
+	uint32		done = 0;
+	Buffer		buffers[COLUMNAR_EXTEND_BATCH];
+
+	nblocks = Max((datalen + COLUMNAR_PAGE_DATA_SIZE - 1) /
+				  COLUMNAR_PAGE_DATA_SIZE, 1);
+
+	metabuf = columnar_lock_meta(rel, BUFFER_LOCK_EXCLUSIVE, true);
+
+	entry.first_rownum = first_rownum;
+	entry.nrows = nrows;
+	entry.first_block = InvalidBlockNumber;
+	entry.nblocks = nblocks;
+	entry.datalen = datalen;
+	entry.xmin = xmin;
+	entry.cmin = cmin;
+
+	while (done < nblocks)
+	{
+		uint32		extend_by = Min(nblocks - done, COLUMNAR_EXTEND_BATCH);
+		uint32		extended_by = 0;
+		BlockNumber first;
+
+		first = ExtendBufferedRelBy(BMR_REL(rel), MAIN_FORKNUM, NULL, 0,
+									extend_by, buffers, &extended_by);
+
+		/* all extensions of the relation happen under the metapage lock */
+		if (done == 0)
+			entry.first_block = first;
+		else if (first != entry.first_block + done)
+			elog(ERROR, "columnar table \"%s\" was extended concurrently",
+				 RelationGetRelationName(rel));
+
+		for (uint32 i = 0; i < extended_by; i++)
+		{
+			uint32		off = (done + i) * COLUMNAR_PAGE_DATA_SIZE;
+			uint32		len = Min(datalen - Min(off, datalen),
+								  COLUMNAR_PAGE_DATA_SIZE);
+			GenericXLogState *state;
+			Page		page;
+
+			LockBuffer(buffers[i], BUFFER_LOCK_EXCLUSIVE);
+
+			state = GenericXLogStart(rel);
+			page = GenericXLogRegisterBuffer(state, buffers[i],
+											 GENERIC_XLOG_FULL_IMAGE);
+			PageInit(page, BLCKSZ, 0);
+			memcpy(PageGetContents(page), data + off, len);
+			columnar_set_contents_length(page, len);
+			GenericXLogFinish(state);
+
+			UnlockReleaseBuffer(buffers[i]);
+		}
+
+		done += extended_by;
+	}
+
+	columnar_list_append(rel, metabuf, true, &entry, sizeof(entry));
+
+	UnlockReleaseBuffer(metabuf);
+}
+
+/*
+ * columnar_append_delete - record that the row was deleted
+ */
+void
+columnar_append_delete(Relation rel, uint64 rownum,
+					   TransactionId xmax, CommandId cmax)
+{
+	Buffer		metabuf;
+	ColumnarDeleteEntry entry;
+
+	entry.rownum = rownum;
+	entry.xmax = xmax;
+	entry.cmax = cmax;
+
+	metabuf = columnar_lock_meta(rel, BUFFER_LOCK_EXCLUSIVE, true);
+	columnar_list_append(rel, metabuf, false, &entry, sizeof(entry));
+	UnlockReleaseBuffer(metabuf);
+}
+
+/*
+ * Copy the items of a list that come after *pos into a palloc'd array, and
+ * advance *pos past them.  An invalid *pos starts from the head of the list.
+ *
+ * Once linked in, a list page stays in the list, and an append changes the
+ * tail page and links a new page in one WAL record under exclusive locks on
+ * both, so no lock on the metapage is needed while walking the list.
+ */
+static void *
+columnar_read_list(Relation rel, bool is_dir, Size itemsz,
+				   ColumnarListPosition *pos, int *nitems)
+{
+	BlockNumber blkno;
+	uint32		skip;
+	char	   *items = NULL;
+	int			n = 0;
+	int			maxitems = 0;
+
+	*nitems = 0;
+
+	if (BlockNumberIsValid(pos->blkno))
+	{
+		blkno = pos->blkno;
+		skip = pos->nitems;
+	}
+	else
+	{
+		Buffer		metabuf;
+
+		metabuf = columnar_lock_meta(rel, BUFFER_LOCK_SHARE, false);
+		if (!BufferIsValid(metabuf))
+			return NULL;
+
+		blkno = is_dir ? ColumnarPageGetMeta(BufferGetPage(metabuf))->dir_head :
+			ColumnarPageGetMeta(BufferGetPage(metabuf))->del_head;
+		skip = 0;
+		UnlockReleaseBuffer(metabuf);
+	}
+
+	while (BlockNumberIsValid(blkno))
+	{
+		Buffer		buf = ReadBuffer(rel, blkno);
+		Page		page;
+		ColumnarListPageHeader *hdr;
+		uint32		nnew;
+
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buf);
+		hdr = ColumnarPageGetListHeader(page);
+
+		if (hdr->nitems > COLUMNAR_ITEMS_PER_PAGE(itemsz) || hdr->nitems < skip)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid list page %u in columnar table \"%s\"",
+							blkno, RelationGetRelationName(rel))));
+
+		nnew = hdr->nitems - skip;
+		if (n + nnew > maxitems)
+		{
+			maxitems = Max(maxitems * 2, n + nnew);
+			if (items == NULL)
+				items = palloc(maxitems * itemsz);
+			else
+				items = repalloc_huge(items, maxitems * itemsz);
+		}
+		if (nnew > 0)
+			memcpy(items + n * itemsz, ColumnarListPageItem(page, itemsz, skip),
+				   nnew * itemsz);
+		n += nnew;
+
+		pos->blkno = blkno;
+		pos->nitems = hdr->nitems;
+		skip = 0;
+
+		blkno = hdr->next;
+		UnlockReleaseBuffer(buf);
+	}
+
+	*nitems = n;
+	return items;
+}
+
+/*
+ * columnar_read_stripes - read the stripe directory entries after *pos
+ *
+ * Entries are in the order the stripes were written, which is not
+ * necessarily the order of their row numbers.
+ */
+ColumnarStripeEntry *
+columnar_read_stripes(Relation rel, ColumnarListPosition *pos, int *nstripes)
+{
+	return (ColumnarStripeEntry *)
+		columnar_read_list(rel, true, sizeof(ColumnarStripeEntry), pos,
+						   nstripes);
+}
+
+/*
+ * columnar_read_deletes - read the delete log entries after *pos
+ */
+ColumnarDeleteEntry *
+columnar_read_deletes(Relation rel, ColumnarListPosition *pos, int *ndeletes)
+{
+	return (ColumnarDeleteEntry *)
+		columnar_read_list(rel, false, sizeof(ColumnarDeleteEntry), pos,
+						   ndeletes);
+}
+
+/*
+ * columnar_read_stripe_data - copy len bytes at offset of the stripe data
+ * into dest
+ */
+void
+columnar_read_stripe_data(Relation rel, ColumnarStripeEntry *stripe,
+						  uint32 offset, uint32 len, char *dest,
+						  BufferAccessStrategy strategy)
+{
+	if ((uint64) offset + len > stripe->datalen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid stripe data reference in columnar table \"%s\"",
+						RelationGetRelationName(rel))));
+
+	while (len > 0)
+	{
+		BlockNumber blkno = stripe->first_block + offset / COLUMNAR_PAGE_DATA_SIZE;
+		uint32		inpage = offset % COLUMNAR_PAGE_DATA_SIZE;
+		uint32		n = Min(len, COLUMNAR_PAGE_DATA_SIZE - inpage);
+		Buffer		buf;
+
+		/* stripe pages are never modified, so a pin would do; but be tidy */
+		buf = ReadBufferExtended(rel, MAIN_FORKNUM, blkno, RBM_NORMAL, strategy);
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
+		memcpy(dest, PageGetContents(BufferGetPage(buf)) + inpage, n);
+		UnlockReleaseBuffer(buf);
+
+		dest += n;
+		offset += n;
+		len -= n;
+	}
+}
+
+/*
+ * Freeze the xids at xid_offset of the items of one list.
+ */
+static void
+columnar_freeze_list(Relation rel, bool is_dir, Size itemsz, Size xid_offset,
+					 TransactionId OldestXmin)
+{
+	Buffer		metabuf;
+	BlockNumber blkno;
+
+	metabuf = columnar_lock_meta(rel, BUFFER_LOCK_SHARE, false);
+	if (!BufferIsValid(metabuf))
+		return;
+
+	blkno = is_dir ? ColumnarPageGetMeta(BufferGetPage(metabuf))->dir_head :
+		ColumnarPageGetMeta(BufferGetPage(metabuf))->del_head;
+	UnlockReleaseBuffer(metabuf);
+
+	/* pages are never removed from a list, so we can walk it unlocked */
+	while (BlockNumberIsValid(blkno))
+	{
+		Buffer		buf;
+		Page		page;
+		ColumnarListPageHeader *hdr;
+		GenericXLogState *state = NULL;
+
+		vacuum_delay_point();
+
+		buf = ReadBuffer(rel, blkno);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+		hdr = ColumnarPageGetListHeader(page);
+
+		for (uint32 i = 0; i < hdr->nitems; i++)
+		{
+			TransactionId xid;
+			char	   *ptr = ColumnarListPageItem(page, itemsz, i) + xid_offset;
+
+			memcpy(&xid, ptr, sizeof(TransactionId));
+			if (!TransactionIdIsNormal(xid) ||
+				!TransactionIdPrecedes(xid, OldestXmin))
+				continue;
+
+			if (state == NULL)
+			{
+				state = GenericXLogStart(rel);
+				page = GenericXLogRegisterBuffer(state, buf, 0);
+				hdr = ColumnarPageGetListHeader(page);
+				ptr = ColumnarListPageItem(page, itemsz, i) + xid_offset;
+			}
+
+			xid = TransactionIdDidCommit(xid) ? FrozenTransactionId :
+				InvalidTransactionId;
+			memcpy(ptr, &xid, sizeof(TransactionId));
+		}
+
+		blkno = hdr->next;
+
+		if (state != NULL)
+			GenericXLogFinish(state);
+		UnlockReleaseBuffer(buf);
+	}
+}
+
+/*
+ * columnar_freeze - freeze all xids older than OldestXmin
+ *
+ * Committed xids become FrozenTransactionId and aborted ones
+ * InvalidTransactionId, so that every xid left is at least OldestXmin and
+ * the caller can advance relfrozenxid to it.
+ */
+void
+columnar_freeze(Relation rel, TransactionId OldestXmin)
+{
+	columnar_freeze_list(rel, true, sizeof(ColumnarStripeEntry),
+						 offsetof(ColumnarStripeEntry, xmin), OldestXmin);
+	columnar_freeze_list(rel, false, sizeof(ColumnarDeleteEntry),
+						 offsetof(ColumnarDeleteEntry, xmax), OldestXmin);
+}
+
+/*
+ * columnar_xid_visible - are the effects of (xid, cid) visible to snapshot?
+ *
+ * This is the visibility test for both the writer of a stripe and the
+ * deleter of a row.
+ */
+bool
+columnar_xid_visible(TransactionId xid, CommandId cid, Snapshot snapshot)
+{
+	if (!TransactionIdIsValid(xid))
+		return false;
+
+	switch (snapshot->snapshot_type)
+	{
+		case SNAPSHOT_ANY:
+			return true;
+
+		case SNAPSHOT_MVCC:
+			if (TransactionIdEquals(xid, FrozenTransactionId))
+				return true;
+			if (TransactionIdIsCurrentTransactionId(xid))
+				return cid < snapshot->curcid;
+			if (XidInMVCCSnapshot(xid, snapshot))
+				return false;
+			return TransactionIdDidCommit(xid);
+
+		case SNAPSHOT_SELF:
+		case SNAPSHOT_DIRTY:
+		case SNAPSHOT_TOAST:
+			if (TransactionIdEquals(xid, FrozenTransactionId))
+				return true;
+			if (TransactionIdIsCurrentTransactionId(xid))
+				return true;
+			if (TransactionIdIsInProgress(xid))
+				return false;
+			return TransactionIdDidCommit(xid);
+
+		default:
+			elog(ERROR, "unsupported snapshot type %d for columnar tables",
+				 (int) snapshot->snapshot_type);
+	}
+
+	return false;				/* keep compiler quiet */
+}
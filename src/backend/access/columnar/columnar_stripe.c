@@ -0,0 +1,477 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_stripe.c
+ *	  encoding and decoding of columnar stripes
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_stripe.c
+ *
+ * NOTES
+ *
+ * A stripe holds the rows of one write, split into chunk groups of
+ * group_rows rows.  Each column of each chunk group is a chunk: an optional
+ * null bitmap, as in a heap tuple, followed by the non-null values packed
+ * and aligned the way heap_fill_tuple() does it, so that the usual tuple
+ * macros can walk them.  The chunk is then compressed on its own, and kept
+ * uncompressed if that doesn't make it smaller.
+ *
+ * For pass-by-value types with a btree comparison function, the chunk also
+ * records the minimum and maximum of its values, which lets a scan skip
+ * chunk groups that can't match its scan keys without reading them.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "access/columnar.h"
+#include "access/tupmacs.h"
+#include "common/pg_lzcompress.h"
+#include "lib/stringinfo.h"
+#include "utils/rel.h"
+#include "utils/typcache.h"
+
+
+/* zstd level used for column chunks; the default level favours speed */
+#define COLUMNAR_ZSTD_LEVEL		ZSTD_CLEVEL_DEFAULT
+
+static const char *
+columnar_compression_name(int method)
+{
+	switch (method)
+	{
+		case COLUMNAR_COMPRESSION_NONE:
+			return "none";
+		case COLUMNAR_COMPRESSION_PGLZ:
+			return "pglz";
+		case COLUMNAR_COMPRESSION_LZ4:
+			return "lz4";
+		case COLUMNAR_COMPRESSION_ZSTD:
+			return "zstd";
+	}
+	return "unknown";
+}
+
+#if !defined(USE_LZ4) || !defined(USE_ZSTD)
+static void
+columnar_compression_unsupported(int method)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("compression method %s not supported",
+					columnar_compression_name(method)),
+			 errdetail("This functionality requires the server to be built with %s support.",
+					   columnar_compression_name(method))));
+}
+#endif
+
+/*
+ * Compress srclen bytes at src.  Returns the compressed length and sets
+ * *dst to a palloc'd buffer holding the result, or returns -1 if the data
+ * didn't get smaller.
+ */
+static int32
+columnar_compress(int method, const char *src, int32 srclen, char **dst)
+{
+	int32		len = -1;
+
+	switch (method)
+	{
+		case COLUMNAR_COMPRESSION_PGLZ:
+			*dst = palloc(PGLZ_MAX_OUTPUT(srclen));
+			len = pglz_compress(src, srclen, *dst, PGLZ_strategy_default);
+			break;
+#ifdef USE_LZ4
+		case COLUMNAR_COMPRESSION_LZ4:
+			{
+				int32		bound = LZ4_compressBound(srclen);
+
+				*dst = palloc(bound);
+				len = LZ4_compress_default(src, *dst, srclen, bound);
+				if (len <= 0)
+					len = -1;
+			}
+			break;
+#endif
+#ifdef USE_ZSTD
+		case COLUMNAR_COMPRESSION_ZSTD:
+			{
+				size_t		bound = ZSTD_compressBound(srclen);
+				size_t		zlen;
+
+				*dst = palloc(bound);
+				zlen = ZSTD_compress(*dst, bound, src, srclen,
+									 COLUMNAR_ZSTD_LEVEL);
+				len = ZSTD_isError(zlen) ? -1 : (int32) zlen;
+			}
+			break;
+#endif
+		default:
+			return -1;
+	}
+
+	if (len < 0 || len >= srclen)
+	{
+		pfree(*dst);
+		*dst = NULL;
+		return -1;
+	}
+
+	return len;
+}
+
+/*
+ * Decompress a chunk of srclen bytes at src into dst, which has room for
+ * exactly rawlen bytes.
+ */
+static void
+columnar_decompress(int method, const char *src, int32 srclen,
+					char *dst, int32 rawlen)
+{
+	bool		ok = false;
+
+	switch (method)
+	{
+		case COLUMNAR_COMPRESSION_PGLZ:
+			ok = pglz_decompress(src, srclen, dst, rawlen, true) == rawlen;
+			break;
+		case COLUMNAR_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			ok = LZ4_decompress_safe(src, dst, srclen, rawlen) == rawlen;
+#else
+			columnar_compression_unsupported(method);
+#endif
+			break;
+		case COLUMNAR_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				size_t		len = ZSTD_decompress(dst, rawlen, src, srclen);
+
+				ok = !ZSTD_isError(len) && len == rawlen;
+			}
+#else
+			columnar_compression_unsupported(method);
+#endif
+			break;
+		default:
+			break;
+	}
+
+	if (!ok)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg_internal("compressed columnar data is corrupt")));
+}
+
+/*
+ * Append a zero-padded value of att to buf, aligned as in heap_fill_tuple.
+ * Varlenas must not be toasted, but may have a short header.
+ */
+static void
+columnar_append_value(StringInfo buf, Form_pg_attribute att, Datum value)
+{
+	Size		len;
+	Size		start;
+
+	if (att->attlen > 0)
+	{
+		start = att_align_nominal(buf->len, att->attalign);
+		len = att->attlen;
+	}
+	else if (att->attlen == -1)
+	{
+		Pointer		ptr = DatumGetPointer(value);
+
+		Assert(!VARATT_IS_EXTERNAL(ptr) && !VARATT_IS_COMPRESSED(ptr));
+		start = VARATT_IS_SHORT(ptr) ? buf->len :
+			att_align_nominal(buf->len, att->attalign);
+		len = VARSIZE_ANY(ptr);
+	}
+	else
+	{
+		start = buf->len;
+		len = strlen(DatumGetCString(value)) + 1;
+	}
+
+	enlargeStringInfo(buf, (start - buf->len) + len);
+	memset(buf->data + buf->len, 0, start - buf->len);
+
+	if (att->attbyval)
+		store_att_byval(buf->data + start, value, att->attlen);
+	else
+		memcpy(buf->data + start, DatumGetPointer(value), len);
+
+	buf->len = start + len;
+}
+
+/*
+ * columnar_encode_stripe - build the data of a stripe
+ *
+ * values[attno][row] and nulls[attno][row] hold the rows, for all
+ * attributes of tupdesc; dropped columns must be null.  Returns a palloc'd
+ * buffer and sets *datalen to its length.
+ */
+char *
+columnar_encode_stripe(TupleDesc tupdesc, uint32 nrows,
+					   Datum **values, bool **nulls,
+					   uint32 group_rows, int compression,
+					   uint32 *datalen)
+{
+	int			natts = tupdesc->natts;
+	uint32		ngroups = (nrows + group_rows - 1) / group_rows;
+	Size		hdrlen;
+	ColumnarStripeHeader hdr;
+	ColumnarChunk *chunks;
+	FmgrInfo  **cmpfns;
+	StringInfoData buf;
+	StringInfoData raw;
+
+	Assert(nrows > 0 && group_rows > 0);
+	Assert(ngroups <= PG_UINT16_MAX && natts <= PG_UINT16_MAX);
+
+	hdrlen = sizeof(ColumnarStripeHeader) +
+		(Size) ngroups * natts * sizeof(ColumnarChunk);
+	chunks = palloc0_array(ColumnarChunk, (Size) ngroups * natts);
+
+	/* comparison functions for min/max, where there are any */
+	cmpfns = palloc0_array(FmgrInfo *, natts);
+	for (int attno = 0; attno < natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+		TypeCacheEntry *typentry;
+
+		if (att->attisdropped || !att->attbyval)
+			continue;
+		typentry = lookup_type_cache(att->atttypid, TYPECACHE_CMP_PROC_FINFO);
+		if (OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			cmpfns[attno] = &typentry->cmp_proc_finfo;
+	}
+
+	initStringInfo(&buf);
+	enlargeStringInfo(&buf, hdrlen);
+	memset(buf.data, 0, hdrlen);
+	buf.len = hdrlen;
+
+	initStringInfo(&raw);
+
+	for (uint32 group = 0; group < ngroups; group++)
+	{
+		uint32		first = group * group_rows;
+		uint32		n = Min(nrows - first, group_rows);
+
+		for (int attno = 0; attno < natts; attno++)
+		{
+			Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+			ColumnarChunk *chunk = ColumnarStripeChunk(chunks, natts, group, attno);
+			Datum	   *vals = values[attno] + first;
+			bool	   *isnull = nulls[attno] + first;
+			uint32		nnulls = 0;
+			bool		have_minmax = false;
+			char	   *compressed = NULL;
+			int32		clen;
+
+			for (uint32 i = 0; i < n; i++)
+				nnulls += isnull[i];
+
+			if (nnulls == n)
+			{
+				chunk->flags = COLUMNAR_CHUNK_ALL_NULL;
+				continue;
+			}
+
+			resetStringInfo(&raw);
+			if (nnulls > 0)
+			{
+				bits8	   *bitmap;
+
+				chunk->flags |= COLUMNAR_CHUNK_HAS_NULLS;
+				enlargeStringInfo(&raw, BITMAPLEN(n));
+				bitmap = (bits8 *) raw.data;
+				memset(bitmap, 0, BITMAPLEN(n));
+				for (uint32 i = 0; i < n; i++)
+				{
+					if (!isnull[i])
+						bitmap[i >> 3] |= (1 << (i & 0x07));
+				}
+				raw.len = BITMAPLEN(n);
+			}
+
+			for (uint32 i = 0; i < n; i++)
+			{
+				if (isnull[i])
+					continue;
+
+				columnar_append_value(&raw, att, vals[i]);
+
+				if (cmpfns[attno] == NULL)
+					continue;
+				if (!have_minmax)
+				{
+					chunk->min = chunk->max = vals[i];
+					have_minmax = true;
+				}
+				else if (DatumGetInt32(FunctionCall2Coll(cmpfns[attno],
+														 att->attcollation,
+														 vals[i],
+														 chunk->min)) < 0)
+					chunk->min = vals[i];
+				else if (DatumGetInt32(FunctionCall2Coll(cmpfns[attno],
+														 att->attcollation,
+														 vals[i],
+														 chunk->max)) > 0)
+					chunk->max = vals[i];
+			}
+			if (have_minmax)
+				chunk->flags |= COLUMNAR_CHUNK_HAS_MINMAX;
+
+			chunk->offset = buf.len;
+			chunk->rawlength = raw.len;
+			clen = columnar_compress(compression, raw.data, raw.len, &compressed);
+			if (clen >= 0)
+			{
+				chunk->compression = compression;
+				chunk->length = clen;
+				appendBinaryStringInfo(&buf, compressed, clen);
+				pfree(compressed);
+			}
+			else
+			{
+				chunk->compression = COLUMNAR_COMPRESSION_NONE;
+				chunk->length = raw.len;
+				appendBinaryStringInfo(&buf, raw.data, raw.len);
+			}
+		}
+	}
+
+	hdr.magic = COLUMNAR_MAGIC;
+	hdr.nrows = nrows;
+	hdr.natts = natts;
+	hdr.ngroups = ngroups;
+	hdr.group_rows = group_rows;
+	memcpy(buf.data, &hdr, sizeof(hdr));
+	memcpy(buf.data + sizeof(hdr), chunks,
+		   (Size) ngroups * natts * sizeof(ColumnarChunk));
+
+	pfree(raw.data);
+	pfree(chunks);
+	pfree(cmpfns);
+
+	*datalen = buf.len;
+	return buf.data;
+}
+
+/*
+ * columnar_read_stripe_header - read the header and chunk directory of a
+ * stripe
+ *
+ * Returns the palloc'd chunk directory, to be indexed with
+ * ColumnarStripeChunk().
+ */
+ColumnarChunk *
+columnar_read_stripe_header(Relation rel, ColumnarStripeEntry *stripe,
+							ColumnarStripeHeader *hdr,
+							BufferAccessStrategy strategy)
+{
+	ColumnarChunk *chunks;
+	Size		len;
+
+	columnar_read_stripe_data(rel, stripe, 0, sizeof(ColumnarStripeHeader),
+							  (char *) hdr, strategy);
+
+	len = (Size) hdr->ngroups * hdr->natts * sizeof(ColumnarChunk);
+	if (hdr->magic != COLUMNAR_MAGIC || hdr->nrows != stripe->nrows ||
+		hdr->group_rows == 0 ||
+		hdr->ngroups != (hdr->nrows + hdr->group_rows - 1) / hdr->group_rows ||
+		sizeof(ColumnarStripeHeader) + len > stripe->datalen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid stripe header at block %u of columnar table \"%s\"",
+						stripe->first_block, RelationGetRelationName(rel))));
+
+	chunks = palloc(Max(len, 1));
+	columnar_read_stripe_data(rel, stripe, sizeof(ColumnarStripeHeader), len,
+							  (char *) chunks, strategy);
+
+	return chunks;
+}
+
+/*
+ * columnar_decode_chunk - decode the nrows values of a chunk
+ *
+ * The data is read and decompressed into CurrentMemoryContext, and values of
+ * pass-by-reference types point into it.
+ */
+void
+columnar_decode_chunk(Relation rel, ColumnarStripeEntry *stripe,
+					  ColumnarChunk *chunk, Form_pg_attribute att,
+					  uint32 nrows, Datum *values, bool *isnull,
+					  BufferAccessStrategy strategy)
+{
+	char	   *stored;
+	char	   *data;
+	bits8	   *bitmap = NULL;
+	Size		off = 0;
+
+	if (chunk->flags & COLUMNAR_CHUNK_ALL_NULL)
+	{
+		memset(isnull, true, nrows * sizeof(bool));
+		return;
+	}
+
+	stored = palloc(chunk->length);
+	columnar_read_stripe_data(rel, stripe, chunk->offset, chunk->length,
+							  stored, strategy);
+
+	if (chunk->compression == COLUMNAR_COMPRESSION_NONE)
+	{
+		if (chunk->length != chunk->rawlength)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("columnar chunk length %u does not match its raw length %u",
+									 chunk->length, chunk->rawlength)));
+		data = stored;
+	}
+	else
+	{
+		data = palloc(chunk->rawlength);
+		columnar_decompress(chunk->compression, stored, chunk->length,
+							data, chunk->rawlength);
+		pfree(stored);
+	}
+
+	if (chunk->flags & COLUMNAR_CHUNK_HAS_NULLS)
+	{
+		bitmap = (bits8 *) data;
+		off = BITMAPLEN(nrows);
+	}
+
+	for (uint32 i = 0; i < nrows; i++)
+	{
+		if (bitmap != NULL && !(bitmap[i >> 3] & (1 << (i & 0x07))))
+		{
+			values[i] = (Datum) 0;
+			isnull[i] = true;
+			continue;
+		}
+
+		off = att_align_pointer(off, att->attalign, att->attlen, data + off);
+		if (off >= chunk->rawlength)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("columnar chunk is shorter than its %u rows",
+									 nrows)));
+		values[i] = fetchatt(att, data + off);
+		isnull[i] = false;
+		off = att_addlength_pointer(off, att->attlen, data + off);
+	}
+}
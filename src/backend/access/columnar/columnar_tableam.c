@@ -0,0 +1,2168 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_tableam.c
+ *	  columnar table access method code
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/columnar/columnar_tableam.c
+ *
+ * NOTES
+ *	  This file wires the columnar storage up to the table access method
+ *	  interface.  See columnar_storage.c for the page layout and
+ *	  columnar_stripe.c for the encoding of the stripes.
+ *
+ *	  Inserted rows are buffered per relation in backend-local memory, and
+ *	  written out as one stripe when the buffer is full, when the command or
+ *	  subtransaction changes, before the rows could be read, and at commit.
+ *	  Row numbers, and so TIDs, are reserved when rows are buffered, so that
+ *	  they can be handed back to the executor at once.
+ *
+ *	  Stripes are never changed: a delete appends an entry to the delete
+ *	  log, and an update is a delete followed by an insert.  Deleters take an
+ *	  exclusive tuple lock on a sentinel TID and keep it until end of
+ *	  transaction, which serializes them, so that a deleter that got the lock
+ *	  sees every earlier delete of the row as committed or aborted.  As there
+ *	  are no update chains, a row updated concurrently is reported as
+ *	  deleted, and READ COMMITTED transactions skip it.
+ *
+ *	  Indexes, row locks, sample scans, VACUUM FULL and CLUSTER are not
+ *	  supported.  Space taken by deleted rows is not reclaimed.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/columnar.h"
+#include "access/detoast.h"
+#include "access/heapam.h"
+#include "access/multixact.h"
+#include "access/relation.h"
+#include "access/relscan.h"
+#include "access/stratnum.h"
+#include "access/sysattr.h"
+#include "access/tableam.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "access/xloginsert.h"
+#include "catalog/index.h"
+#include "catalog/storage.h"
+#include "catalog/storage_xlog.h"
+#include "commands/vacuum.h"
+#include "executor/tuptable.h"
+#include "miscadmin.h"
+#include "nodes/bitmapset.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
+#include "storage/predicate.h"
+#include "storage/procarray.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/typcache.h"
+
+
+/* GUC variables */
+int			columnar_compression = DEFAULT_COLUMNAR_COMPRESSION;
+int			columnar_stripe_row_limit = 150000;
+int			columnar_chunk_group_row_limit = 10000;
+
+/* row numbers reserved by the first insert into a write buffer */
+#define COLUMNAR_FIRST_RESERVATION	1000
+
+/* flush a write buffer once its values take this much memory */
+#define COLUMNAR_MAX_STRIPE_BYTES	(256 * 1024 * 1024)
+
+/*
+ * Rows inserted into a relation by the current command and subtransaction
+ * that haven't been written out yet.  The buffer holds row numbers
+ * [first_rownum, first_rownum + nreserved), of which the first nrows are in
+ * use.  Buffers live in their own memory contexts under
+ * TopTransactionContext.
+ */
+typedef struct ColumnarWriteState
+{
+	struct ColumnarWriteState *next;
+	Oid			relid;
+	RelFileLocator locator;		/* the storage the rows belong to */
+	SubTransactionId subid;
+	TransactionId xid;
+	CommandId	cid;
+	MemoryContext cxt;
+	TupleDesc	tupdesc;
+	uint32		stripe_rows;	/* settings as of the first row */
+	uint32		group_rows;
+	int			compression;
+	uint64		first_rownum;
+	uint32		nreserved;
+	uint32		nrows;
+	Datum	  **values;			/* values[attno][row] */
+	bool	  **nulls;
+	Size		rawbytes;		/* memory taken by the values */
+} ColumnarWriteState;
+
+static ColumnarWriteState *pending_writes = NULL;
+
+/*
+ * A chunk group decoded into memory, along with the header of its stripe.
+ * values[attno] is NULL for columns that weren't decoded.
+ */
+typedef struct ColumnarGroupData
+{
+	MemoryContext stripe_cxt;
+	MemoryContext group_cxt;
+	bool		have_stripe;
+	ColumnarStripeEntry stripe;
+	ColumnarStripeHeader hdr;
+	ColumnarChunk *chunks;
+	int			group;			/* decoded group, or -1 */
+	int			natts;			/* number of entries of values */
+	uint32		nrows;
+	uint64		first_rownum;	/* row number of its first row */
+	Datum	  **values;
+	bool	  **isnull;
+} ColumnarGroupData;
+
+/*
+ * What this transaction has read of the stripe directory and delete log of
+ * a relation, so that repeated lookups only read what was appended since.
+ * The stripes are kept sorted by row number, and the deletes of each row
+ * are chained through delnext from a hash table entry.
+ */
+typedef struct ColumnarDeleteHashEntry
+{
+	uint64		rownum;			/* hash key */
+	int			first;			/* index of its latest delete entry */
+} ColumnarDeleteHashEntry;
+
+typedef struct ColumnarRelCache
+{
+	struct ColumnarRelCache *next;
+	Oid			relid;
+	RelFileLocator locator;
+	MemoryContext cxt;
+	ColumnarListPosition dirpos;
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+	int			maxstripes;
+	ColumnarListPosition delpos;
+	ColumnarDeleteEntry *deletes;
+	int		   *delnext;
+	int			ndeletes;
+	int			maxdeletes;
+	HTAB	   *delhash;
+	ColumnarGroupData fetchgroup;	/* last group decoded for a fetch */
+} ColumnarRelCache;
+
+static ColumnarRelCache *rel_caches = NULL;
+
+static bool columnar_callbacks_registered = false;
+
+typedef struct ColumnarScanDescData
+{
+	TableScanDescData rs_base;	/* AM independent part of the descriptor */
+
+	MemoryContext scan_cxt;
+	BufferAccessStrategy strategy;
+
+	bool	   *returned;		/* columns to return, or NULL for all */
+	bool	   *decoded;		/* those plus the scan key columns */
+	bool		materialize;	/* copy pass-by-reference values? */
+	FmgrInfo  **key_cmp;		/* comparison functions of equality keys */
+
+	/* visible stripes in row number order, and sorted deleted rows */
+	ColumnarStripeEntry *stripes;
+	int			nstripes;
+	uint64	   *deleted;
+	int			ndeleted;
+
+	/* current position */
+	int			cur_stripe;		/* -1 before the start, nstripes past the end */
+	int			cur_group;
+	int64		cur_row;		/* row within the decoded group */
+	bool		in_group;
+	ColumnarGroupData gd;
+
+	/* for ANALYZE: all deletes in row number order, and the sampled rows */
+	ColumnarDeleteEntry *alldeletes;
+	int			nalldeletes;
+	uint64		analyze_nrows;
+	BlockNumber analyze_nblocks;
+	uint64		analyze_next;
+	uint64		analyze_end;
+} ColumnarScanDescData;
+
+typedef struct ColumnarScanDescData *ColumnarScanDesc;
+
+typedef struct ParallelColumnarScanDescData
+{
+	ParallelTableScanDescData base;
+	pg_atomic_uint32 next_stripe;	/* next stripe to hand out */
+} ParallelColumnarScanDescData;
+
+typedef struct ParallelColumnarScanDescData *ParallelColumnarScanDesc;
+
+static const TableAmRoutine columnar_methods;
+
+static void columnar_flush_state(ColumnarWriteState *state, Relation rel);
+
+
+/* ------------------------------------------------------------------------
+ * Transaction bookkeeping
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_remove_state(ColumnarWriteState *state)
+{
+	ColumnarWriteState **prev = &pending_writes;
+
+	while (*prev != state)
+		prev = &(*prev)->next;
+	*prev = state->next;
+
+	MemoryContextDelete(state->cxt);
+}
+
+/*
+ * Write out the buffered rows of all relations, before commit.
+ */
+static void
+columnar_flush_all(void)
+{
+	while (pending_writes != NULL)
+	{
+		ColumnarWriteState *state = pending_writes;
+		Relation	rel;
+
+		/* we still hold the lock taken by the insert */
+		rel = try_relation_open(state->relid, NoLock);
+		if (rel != NULL && RelFileLocatorEquals(rel->rd_locator, state->locator))
+			columnar_flush_state(state, rel);
+		else
+			columnar_remove_state(state);	/* dropped or truncated */
+
+		if (rel != NULL)
+			relation_close(rel, NoLock);
+	}
+}
+
+static void
+columnar_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PARALLEL_PRE_COMMIT:
+		case XACT_EVENT_PRE_PREPARE:
+			columnar_flush_all();
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			/* the memory goes away with TopTransactionContext */
+			pending_writes = NULL;
+			rel_caches = NULL;
+			break;
+	}
+}
+
+/*
+ * Rows buffered by an aborted subtransaction, or by any of its children,
+ * are simply forgotten.
+ */
+static void
+columnar_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						  SubTransactionId parentSubid, void *arg)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState *next;
+
+	if (event != SUBXACT_EVENT_ABORT_SUB)
+		return;
+
+	for (state = pending_writes; state != NULL; state = next)
+	{
+		next = state->next;
+		if (state->subid >= mySubid)
+			columnar_remove_state(state);
+	}
+}
+
+static void
+columnar_register_callbacks(void)
+{
+	if (columnar_callbacks_registered)
+		return;
+
+	RegisterXactCallback(columnar_xact_callback, NULL);
+	RegisterSubXactCallback(columnar_subxact_callback, NULL);
+	columnar_callbacks_registered = true;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Write buffers
+ * ------------------------------------------------------------------------
+ */
+
+static ColumnarWriteState *
+columnar_new_write_state(Relation rel, CommandId cid)
+{
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+	ColumnarWriteState *state;
+
+	columnar_register_callbacks();
+
+	cxt = AllocSetContextCreate(TopTransactionContext,
+								"columnar write buffer",
+								ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	state = palloc0(sizeof(ColumnarWriteState));
+	state->relid = RelationGetRelid(rel);
+	state->locator = rel->rd_locator;
+	state->subid = GetCurrentSubTransactionId();
+	state->xid = GetCurrentTransactionId();
+	state->cid = cid;
+	state->cxt = cxt;
+	state->tupdesc = CreateTupleDescCopy(RelationGetDescr(rel));
+	state->stripe_rows = columnar_stripe_row_limit;
+	state->group_rows = columnar_chunk_group_row_limit;
+	state->compression = columnar_compression;
+	state->values = palloc0_array(Datum *, state->tupdesc->natts);
+	state->nulls = palloc0_array(bool *, state->tupdesc->natts);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	state->next = pending_writes;
+	pending_writes = state;
+
+	return state;
+}
+
+/*
+ * Get the write buffer for new rows of rel, written by command cid.  Rows
+ * buffered by a different command or subtransaction, or with a different
+ * number of columns, are written out first.
+ */
+static ColumnarWriteState *
+columnar_get_write_state(Relation rel, CommandId cid)
+{
+	ColumnarWriteState *state;
+
+	for (state = pending_writes; state != NULL; state = state->next)
+	{
+		if (state->relid != RelationGetRelid(rel))
+			continue;
+
+		if (!RelFileLocatorEquals(state->locator, rel->rd_locator))
+			columnar_remove_state(state);
+		else if (state->subid != GetCurrentSubTransactionId() ||
+				 state->cid != cid ||
+				 state->tupdesc->natts != RelationGetNumberOfAttributes(rel))
+			columnar_flush_state(state, rel);
+		else
+			return state;
+		break;
+	}
+
+	return columnar_new_write_state(rel, cid);
+}
+
+/*
+ * Encode the buffered rows as a stripe, write it, and free the buffer.
+ */
+static void
+columnar_flush_state(ColumnarWriteState *state, Relation rel)
+{
+	if (state->nrows > 0)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(state->cxt);
+		char	   *data;
+		uint32		datalen;
+
+		data = columnar_encode_stripe(state->tupdesc, state->nrows,
+									  state->values, state->nulls,
+									  state->group_rows, state->compression,
+									  &datalen);
+		columnar_write_stripe(rel, data, datalen, state->first_rownum,
+							  state->nrows, state->xid, state->cid);
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	columnar_remove_state(state);
+}
+
+/*
+ * columnar_flush_pending - write out the buffered rows of rel
+ */
+void
+columnar_flush_pending(Relation rel)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState *next;
+
+	for (state = pending_writes; state != NULL; state = next)
+	{
+		next = state->next;
+		if (state->relid != RelationGetRelid(rel))
+			continue;
+
+		if (RelFileLocatorEquals(state->locator, rel->rd_locator))
+			columnar_flush_state(state, rel);
+		else
+			columnar_remove_state(state);
+	}
+}
+
+/*
+ * Write out the buffered rows of rel if the row is one of them.  Fetching or
+ * deleting a row of an earlier command by TID needn't flush the rows the
+ * current command is buffering, which would make for tiny stripes.
+ */
+static void
+columnar_flush_pending_row(Relation rel, uint64 rownum)
+{
+	ColumnarWriteState *state;
+
+	for (state = pending_writes; state != NULL; state = state->next)
+	{
+		if (state->relid == RelationGetRelid(rel) &&
+			rownum >= state->first_rownum &&
+			rownum < state->first_rownum + state->nrows)
+		{
+			columnar_flush_pending(rel);
+			return;
+		}
+	}
+}
+
+/*
+ * columnar_discard_pending - forget the buffered rows of rel
+ */
+void
+columnar_discard_pending(Relation rel)
+{
+	ColumnarWriteState *state;
+	ColumnarWriteState *next;
+
+	for (state = pending_writes; state != NULL; state = next)
+	{
+		next = state->next;
+		if (state->relid == RelationGetRelid(rel))
+			columnar_remove_state(state);
+	}
+}
+
+/*
+ * Add the row in slot to the write buffer of rel, and set the slot's TID.
+ */
+static void
+columnar_buffer_row(Relation rel, TupleTableSlot *slot, CommandId cid)
+{
+	ColumnarWriteState *state = columnar_get_write_state(rel, cid);
+	MemoryContext oldcxt;
+	TupleDesc	tupdesc;
+	uint32		row;
+
+	if (state->nrows == state->nreserved)
+	{
+		uint32		want;
+		uint64		first;
+
+		/* reserve row numbers in growing steps, up to a full stripe */
+		if (state->nreserved == 0)
+			want = Min(COLUMNAR_FIRST_RESERVATION, state->stripe_rows);
+		else
+			want = Min(state->nreserved, state->stripe_rows - state->nreserved);
+
+		first = columnar_reserve_rownums(rel, want);
+
+		/* somebody else reserved row numbers in between: start a new stripe */
+		if (state->nreserved > 0 &&
+			first != state->first_rownum + state->nreserved)
+		{
+			columnar_flush_state(state, rel);
+			state = columnar_new_write_state(rel, cid);
+		}
+
+		if (state->nreserved == 0)
+			state->first_rownum = first;
+		state->nreserved += want;
+
+		oldcxt = MemoryContextSwitchTo(state->cxt);
+		for (int attno = 0; attno < state->tupdesc->natts; attno++)
+		{
+			if (state->values[attno] == NULL)
+			{
+				state->values[attno] = palloc_array(Datum, state->nreserved);
+				state->nulls[attno] = palloc_array(bool, state->nreserved);
+			}
+			else
+			{
+				state->values[attno] = repalloc_huge(state->values[attno],
+													 sizeof(Datum) * state->nreserved);
+				state->nulls[attno] = repalloc_huge(state->nulls[attno],
+													sizeof(bool) * state->nreserved);
+			}
+		}
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	slot_getallattrs(slot);
+	tupdesc = state->tupdesc;
+	row = state->nrows;
+
+	oldcxt = MemoryContextSwitchTo(state->cxt);
+	for (int attno = 0; attno < tupdesc->natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+		Datum		value = slot->tts_values[attno];
+
+		if (slot->tts_isnull[attno] || att->attisdropped)
+		{
+			state->values[attno][row] = (Datum) 0;
+			state->nulls[attno][row] = true;
+			continue;
+		}
+
+		if (att->attbyval)
+			state->rawbytes += att->attlen;
+		else if (att->attlen == -1)
+		{
+			struct varlena *orig = (struct varlena *) DatumGetPointer(value);
+			struct varlena *plain = pg_detoast_datum_packed(orig);
+
+			/* values are stored inline, compressed chunk by chunk */
+			if (plain == orig)
+				value = datumCopy(value, false, -1);
+			else
+				value = PointerGetDatum(plain);
+			state->rawbytes += VARSIZE_ANY(DatumGetPointer(value));
+		}
+		else
+		{
+			value = datumCopy(value, false, att->attlen);
+			state->rawbytes += datumGetSize(value, false, att->attlen);
+		}
+
+		state->values[attno][row] = value;
+		state->nulls[attno][row] = false;
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	ColumnarRowNumberToTid(state->first_rownum + row, &slot->tts_tid);
+	slot->tts_tableOid = RelationGetRelid(rel);
+	state->nrows++;
+
+	if (state->nrows >= state->stripe_rows ||
+		state->rawbytes >= COLUMNAR_MAX_STRIPE_BYTES)
+		columnar_flush_state(state, rel);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Decoding chunk groups
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_group_init(ColumnarGroupData *gd, MemoryContext parent)
+{
+	memset(gd, 0, sizeof(ColumnarGroupData));
+	gd->stripe_cxt = AllocSetContextCreate(parent,
+										   "columnar stripe",
+										   ALLOCSET_DEFAULT_SIZES);
+	gd->group_cxt = AllocSetContextCreate(parent,
+										  "columnar chunk group",
+										  ALLOCSET_DEFAULT_SIZES);
+	gd->group = -1;
+}
+
+/*
+ * Make stripe the current stripe of gd, reading its header unless it's
+ * current already.
+ */
+static void
+columnar_group_set_stripe(Relation rel, ColumnarGroupData *gd,
+						  ColumnarStripeEntry *stripe,
+						  BufferAccessStrategy strategy)
+{
+	MemoryContext oldcxt;
+
+	if (gd->have_stripe &&
+		gd->stripe.first_rownum == stripe->first_rownum &&
+		gd->stripe.first_block == stripe->first_block)
+		return;
+
+	MemoryContextReset(gd->group_cxt);
+	MemoryContextReset(gd->stripe_cxt);
+	gd->group = -1;
+	gd->have_stripe = false;
+
+	oldcxt = MemoryContextSwitchTo(gd->stripe_cxt);
+	gd->stripe = *stripe;
+	gd->chunks = columnar_read_stripe_header(rel, &gd->stripe, &gd->hdr,
+											 strategy);
+	MemoryContextSwitchTo(oldcxt);
+
+	gd->have_stripe = true;
+}
+
+/*
+ * Decode group of the current stripe, for the columns in needed (or all
+ * columns, if needed is NULL).
+ */
+static void
+columnar_group_decode(Relation rel, ColumnarGroupData *gd, int group,
+					  const bool *needed, BufferAccessStrategy strategy)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	MemoryContext oldcxt;
+
+	Assert(gd->have_stripe && group < gd->hdr.ngroups);
+
+	MemoryContextReset(gd->group_cxt);
+	oldcxt = MemoryContextSwitchTo(gd->group_cxt);
+
+	gd->group = group;
+	gd->natts = tupdesc->natts;
+	gd->nrows = Min(gd->hdr.nrows - group * gd->hdr.group_rows,
+					gd->hdr.group_rows);
+	gd->first_rownum = gd->stripe.first_rownum +
+		(uint64) group * gd->hdr.group_rows;
+	gd->values = palloc0_array(Datum *, tupdesc->natts);
+	gd->isnull = palloc0_array(bool *, tupdesc->natts);
+
+	for (int attno = 0; attno < tupdesc->natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+		Datum	   *values;
+		bool	   *isnull;
+
+		if (needed != NULL && !needed[attno])
+			continue;
+
+		values = gd->values[attno] = palloc_array(Datum, gd->nrows);
+		isnull = gd->isnull[attno] = palloc_array(bool, gd->nrows);
+
+		if (att->attisdropped)
+			memset(isnull, true, gd->nrows * sizeof(bool));
+		else if (attno >= gd->hdr.natts)
+		{
+			/* added after the stripe was written */
+			bool		missingnull;
+			Datum		missing = getmissingattr(tupdesc, attno + 1,
+												 &missingnull);
+
+			for (uint32 i = 0; i < gd->nrows; i++)
+			{
+				values[i] = missing;
+				isnull[i] = missingnull;
+			}
+		}
+		else
+			columnar_decode_chunk(rel, &gd->stripe,
+								  ColumnarStripeChunk(gd->chunks, gd->hdr.natts,
+													  group, attno),
+								  att, gd->nrows, values, isnull, strategy);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * Store row of the decoded group in slot, with only the columns in returned
+ * (all if NULL).  The values point into the group's memory unless we
+ * materialize the slot.
+ */
+static void
+columnar_store_row(ColumnarGroupData *gd, uint32 row, const bool *returned,
+				   bool materialize, TupleTableSlot *slot)
+{
+	int			natts = slot->tts_tupleDescriptor->natts;
+
+	ExecClearTuple(slot);
+
+	for (int attno = 0; attno < natts; attno++)
+	{
+		if (attno < gd->natts && gd->values[attno] != NULL &&
+			(returned == NULL || returned[attno]))
+		{
+			slot->tts_values[attno] = gd->values[attno][row];
+			slot->tts_isnull[attno] = gd->isnull[attno][row];
+		}
+		else
+		{
+			slot->tts_values[attno] = (Datum) 0;
+			slot->tts_isnull[attno] = true;
+		}
+	}
+
+	ExecStoreVirtualTuple(slot);
+	if (materialize)
+		ExecMaterializeSlot(slot);
+
+	ColumnarRowNumberToTid(gd->first_rownum + row, &slot->tts_tid);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Stripe directory and delete log cache
+ * ------------------------------------------------------------------------
+ */
+
+static int
+columnar_stripe_cmp(const void *a, const void *b)
+{
+	uint64		ra = ((const ColumnarStripeEntry *) a)->first_rownum;
+	uint64		rb = ((const ColumnarStripeEntry *) b)->first_rownum;
+
+	if (ra < rb)
+		return -1;
+	if (ra > rb)
+		return 1;
+	return 0;
+}
+
+static int
+columnar_rownum_cmp(const void *a, const void *b)
+{
+	uint64		ra = *(const uint64 *) a;
+	uint64		rb = *(const uint64 *) b;
+
+	if (ra < rb)
+		return -1;
+	if (ra > rb)
+		return 1;
+	return 0;
+}
+
+static int
+columnar_delete_cmp(const void *a, const void *b)
+{
+	return columnar_rownum_cmp(&((const ColumnarDeleteEntry *) a)->rownum,
+							   &((const ColumnarDeleteEntry *) b)->rownum);
+}
+
+static void
+columnar_remove_rel_cache(ColumnarRelCache *cache)
+{
+	ColumnarRelCache **prev = &rel_caches;
+
+	while (*prev != cache)
+		prev = &(*prev)->next;
+	*prev = cache->next;
+
+	MemoryContextDelete(cache->cxt);
+}
+
+static void
+columnar_forget_rel_cache(Relation rel)
+{
+	ColumnarRelCache *cache;
+
+	for (cache = rel_caches; cache != NULL; cache = cache->next)
+	{
+		if (cache->relid == RelationGetRelid(rel))
+		{
+			columnar_remove_rel_cache(cache);
+			return;
+		}
+	}
+}
+
+/*
+ * Get the cache for rel, and bring it up to date with the stripe directory
+ * and delete log.
+ */
+static ColumnarRelCache *
+columnar_get_rel_cache(Relation rel)
+{
+	ColumnarRelCache *cache;
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+	HASHCTL		ctl;
+	ColumnarStripeEntry *stripes;
+	ColumnarDeleteEntry *deletes;
+	int			n;
+
+	for (cache = rel_caches; cache != NULL; cache = cache->next)
+	{
+		if (cache->relid == RelationGetRelid(rel))
+			break;
+	}
+
+	if (cache != NULL && !RelFileLocatorEquals(cache->locator, rel->rd_locator))
+	{
+		columnar_remove_rel_cache(cache);
+		cache = NULL;
+	}
+
+	if (cache == NULL)
+	{
+		columnar_register_callbacks();
+
+		cxt = AllocSetContextCreate(TopTransactionContext,
+									"columnar relation cache",
+									ALLOCSET_DEFAULT_SIZES);
+		cache = MemoryContextAllocZero(cxt, sizeof(ColumnarRelCache));
+		cache->relid = RelationGetRelid(rel);
+		cache->locator = rel->rd_locator;
+		cache->cxt = cxt;
+		cache->dirpos.blkno = InvalidBlockNumber;
+		cache->delpos.blkno = InvalidBlockNumber;
+
+		ctl.keysize = sizeof(uint64);
+		ctl.entrysize = sizeof(ColumnarDeleteHashEntry);
+		ctl.hcxt = cxt;
+		cache->delhash = hash_create("columnar deletes", 256, &ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		columnar_group_init(&cache->fetchgroup, cxt);
+
+		cache->next = rel_caches;
+		rel_caches = cache;
+	}
+
+	oldcxt = MemoryContextSwitchTo(cache->cxt);
+
+	stripes = columnar_read_stripes(rel, &cache->dirpos, &n);
+	if (n > 0)
+	{
+		if (cache->nstripes + n > cache->maxstripes)
+		{
+			cache->maxstripes = Max(cache->maxstripes * 2, cache->nstripes + n);
+			if (cache->stripes == NULL)
+				cache->stripes = palloc_array(ColumnarStripeEntry,
+											  cache->maxstripes);
+			else
+				cache->stripes = repalloc_huge(cache->stripes,
+											   sizeof(ColumnarStripeEntry) *
+											   cache->maxstripes);
+		}
+		memcpy(cache->stripes + cache->nstripes, stripes,
+			   sizeof(ColumnarStripeEntry) * n);
+		cache->nstripes += n;
+		qsort(cache->stripes, cache->nstripes, sizeof(ColumnarStripeEntry),
+			  columnar_stripe_cmp);
+		pfree(stripes);
+	}
+
+	deletes = columnar_read_deletes(rel, &cache->delpos, &n);
+	if (n > 0)
+	{
+		if (cache->ndeletes + n > cache->maxdeletes)
+		{
+			cache->maxdeletes = Max(cache->maxdeletes * 2, cache->ndeletes + n);
+			if (cache->deletes == NULL)
+			{
+				cache->deletes = palloc_array(ColumnarDeleteEntry,
+											  cache->maxdeletes);
+				cache->delnext = palloc_array(int, cache->maxdeletes);
+			}
+			else
+			{
+				cache->deletes = repalloc_huge(cache->deletes,
+											   sizeof(ColumnarDeleteEntry) *
+											   cache->maxdeletes);
+				cache->delnext = repalloc_huge(cache->delnext,
+											   sizeof(int) * cache->maxdeletes);
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			int			idx = cache->ndeletes++;
+			ColumnarDeleteHashEntry *entry;
+			bool		found;
+
+			cache->deletes[idx] = deletes[i];
+			entry = hash_search(cache->delhash, &deletes[i].rownum,
+								HASH_ENTER, &found);
+			cache->delnext[idx] = found ? entry->first : -1;
+			entry->first = idx;
+		}
+		pfree(deletes);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return cache;
+}
+
+/*
+ * Find the stripe holding rownum, or NULL if there's none.
+ */
+static ColumnarStripeEntry *
+columnar_find_stripe(ColumnarStripeEntry *stripes, int nstripes, uint64 rownum)
+{
+	int			lo = 0;
+	int			hi = nstripes;
+
+	/* find the first stripe starting after rownum */
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (stripes[mid].first_rownum <= rownum)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0 ||
+		rownum >= stripes[lo - 1].first_rownum + stripes[lo - 1].nrows)
+		return NULL;
+
+	return &stripes[lo - 1];
+}
+
+/*
+ * Is the row visible to snapshot?  If so, returns its stripe in *stripe.
+ */
+static bool
+columnar_row_visible(ColumnarRelCache *cache, uint64 rownum,
+					 Snapshot snapshot, ColumnarStripeEntry **stripe)
+{
+	ColumnarStripeEntry *s;
+	ColumnarDeleteHashEntry *entry;
+
+	s = columnar_find_stripe(cache->stripes, cache->nstripes, rownum);
+	if (s == NULL || !columnar_xid_visible(s->xmin, s->cmin, snapshot))
+		return false;
+
+	if (snapshot->snapshot_type != SNAPSHOT_ANY)
+	{
+		entry = hash_search(cache->delhash, &rownum, HASH_FIND, NULL);
+		for (int i = entry ? entry->first : -1; i >= 0; i = cache->delnext[i])
+		{
+			ColumnarDeleteEntry *del = &cache->deletes[i];
+
+			if (columnar_xid_visible(del->xmax, del->cmax, snapshot))
+				return false;
+		}
+	}
+
+	*stripe = s;
+	return true;
+}
+
+/*
+ * Decode the row into slot, with all its columns.
+ */
+static void
+columnar_fetch_into_slot(Relation rel, ColumnarRelCache *cache,
+						 ColumnarStripeEntry *stripe, uint64 rownum,
+						 TupleTableSlot *slot)
+{
+	ColumnarGroupData *gd = &cache->fetchgroup;
+	int			group;
+
+	columnar_group_set_stripe(rel, gd, stripe, NULL);
+
+	group = (rownum - stripe->first_rownum) / gd->hdr.group_rows;
+	if (gd->group != group || gd->natts != RelationGetNumberOfAttributes(rel))
+		columnar_group_decode(rel, gd, group, NULL, NULL);
+
+	/* the decoded group doesn't stay around, so copy the values */
+	columnar_store_row(gd, rownum - gd->first_rownum, NULL, true, slot);
+	slot->tts_tableOid = RelationGetRelid(rel);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Slot related callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static const TupleTableSlotOps *
+columnar_slot_callbacks(Relation relation)
+{
+	return &TTSOpsVirtual;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Table scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Work out which columns to decode and return, given the columns the
+ * caller asked for (NULL for all).
+ */
+static void
+columnar_scan_set_columns(ColumnarScanDesc scan, bool *returned)
+{
+	TupleDesc	tupdesc = RelationGetDescr(scan->rs_base.rs_rd);
+
+	scan->returned = returned;
+	scan->decoded = NULL;
+	scan->materialize = false;
+
+	if (returned != NULL)
+	{
+		scan->decoded = MemoryContextAlloc(scan->scan_cxt,
+										   sizeof(bool) * tupdesc->natts);
+		memcpy(scan->decoded, returned, sizeof(bool) * tupdesc->natts);
+		for (int i = 0; i < scan->rs_base.rs_nkeys; i++)
+		{
+			AttrNumber	attno = scan->rs_base.rs_key[i].sk_attno;
+
+			if (attno > 0 && attno <= tupdesc->natts)
+				scan->decoded[attno - 1] = true;
+		}
+	}
+
+	/*
+	 * A slot may be kept while the scan moves on to another chunk group, as
+	 * in batch mode, so pass-by-reference values must be copied.
+	 */
+	for (int attno = 0; attno < tupdesc->natts; attno++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, attno);
+
+		if (!att->attbyval && !att->attisdropped &&
+			(returned == NULL || returned[attno]))
+			scan->materialize = true;
+	}
+}
+
+static void
+columnar_scan_reset(ColumnarScanDesc scan)
+{
+	scan->cur_stripe = -1;
+	scan->cur_group = -1;
+	scan->cur_row = -1;
+	scan->in_group = false;
+}
+
+static TableScanDesc
+columnar_beginscan(Relation relation, Snapshot snapshot,
+				   int nkeys, ScanKey key,
+				   ParallelTableScanDesc parallel_scan,
+				   uint32 flags)
+{
+	ColumnarScanDesc scan;
+	ColumnarRelCache *cache;
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	MemoryContext oldcxt;
+
+	/* the scan must see the rows buffered by earlier commands */
+	columnar_flush_pending(relation);
+
+	RelationIncrementReferenceCount(relation);
+
+	scan = (ColumnarScanDesc) palloc0(sizeof(ColumnarScanDescData));
+	scan->rs_base.rs_rd = relation;
+	scan->rs_base.rs_snapshot = snapshot;
+	scan->rs_base.rs_nkeys = nkeys;
+	scan->rs_base.rs_flags = flags;
+	scan->rs_base.rs_parallel = parallel_scan;
+	if (nkeys > 0)
+	{
+		scan->rs_base.rs_key = (ScanKey) palloc(sizeof(ScanKeyData) * nkeys);
+		memcpy(scan->rs_base.rs_key, key, sizeof(ScanKeyData) * nkeys);
+	}
+
+	scan->scan_cxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "columnar scan",
+										   ALLOCSET_DEFAULT_SIZES);
+	columnar_group_init(&scan->gd, scan->scan_cxt);
+
+	if ((flags & SO_ALLOW_STRAT) &&
+		RelationGetNumberOfBlocks(relation) > NBuffers / 4)
+		scan->strategy = GetAccessStrategy(BAS_BULKREAD);
+
+	if (flags & SO_TYPE_SEQSCAN)
+		PredicateLockRelation(relation, snapshot);
+
+	oldcxt = MemoryContextSwitchTo(scan->scan_cxt);
+
+	/* only the number of rows matters, so don't decode any column */
+	if ((flags & SO_TYPE_SEQSCAN) && !(flags & SO_NEED_TUPLES))
+		columnar_scan_set_columns(scan, palloc0(sizeof(bool) * tupdesc->natts));
+	else
+		columnar_scan_set_columns(scan, NULL);
+
+	scan->key_cmp = palloc0_array(FmgrInfo *, Max(nkeys, 1));
+	for (int i = 0; i < nkeys; i++)
+	{
+		ScanKey		k = &scan->rs_base.rs_key[i];
+		TypeCacheEntry *typentry;
+
+		if (k->sk_strategy != BTEqualStrategyNumber ||
+			k->sk_attno <= 0 || k->sk_attno > tupdesc->natts)
+			continue;
+		typentry = lookup_type_cache(TupleDescAttr(tupdesc, k->sk_attno - 1)->atttypid,
+									 TYPECACHE_CMP_PROC_FINFO);
+		if (OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			scan->key_cmp[i] = &typentry->cmp_proc_finfo;
+	}
+
+	cache = columnar_get_rel_cache(relation);
+
+	if (flags & SO_TYPE_ANALYZE)
+	{
+		/* ANALYZE looks at all rows, and sorts them out itself */
+		scan->stripes = palloc_array(ColumnarStripeEntry, Max(cache->nstripes, 1));
+		memcpy(scan->stripes, cache->stripes,
+			   sizeof(ColumnarStripeEntry) * cache->nstripes);
+		scan->nstripes = cache->nstripes;
+
+		scan->alldeletes = palloc_array(ColumnarDeleteEntry, Max(cache->ndeletes, 1));
+		memcpy(scan->alldeletes, cache->deletes,
+			   sizeof(ColumnarDeleteEntry) * cache->ndeletes);
+		scan->nalldeletes = cache->ndeletes;
+		qsort(scan->alldeletes, scan->nalldeletes, sizeof(ColumnarDeleteEntry),
+			  columnar_delete_cmp);
+
+		scan->analyze_nrows = columnar_next_rownum(relation);
+		scan->analyze_nblocks = RelationGetNumberOfBlocks(relation);
+	}
+	else
+	{
+		Assert(snapshot != NULL);
+
+		/*
+		 * A snapshot sees the same stripes and deletes for its whole life,
+		 * so the visibility checks can all be done up front.
+		 */
+		scan->stripes = palloc_array(ColumnarStripeEntry, Max(cache->nstripes, 1));
+		for (int i = 0; i < cache->nstripes; i++)
+		{
+			ColumnarStripeEntry *s = &cache->stripes[i];
+
+			if (columnar_xid_visible(s->xmin, s->cmin, snapshot))
+				scan->stripes[scan->nstripes++] = *s;
+		}
+
+		scan->deleted = palloc_array(uint64, Max(cache->ndeletes, 1));
+		if (snapshot->snapshot_type != SNAPSHOT_ANY)
+		{
+			for (int i = 0; i < cache->ndeletes; i++)
+			{
+				ColumnarDeleteEntry *del = &cache->deletes[i];
+
+				if (columnar_xid_visible(del->xmax, del->cmax, snapshot))
+					scan->deleted[scan->ndeleted++] = del->rownum;
+			}
+		}
+		qsort(scan->deleted, scan->ndeleted, sizeof(uint64),
+			  columnar_rownum_cmp);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	columnar_scan_reset(scan);
+
+	return (TableScanDesc) scan;
+}
+
+static void
+columnar_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
+				bool allow_strat, bool allow_sync, bool allow_pagemode)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	if (set_params)
+	{
+		if (allow_strat)
+			scan->rs_base.rs_flags |= SO_ALLOW_STRAT;
+		else
+			scan->rs_base.rs_flags &= ~SO_ALLOW_STRAT;
+	}
+
+	if (key != NULL && scan->rs_base.rs_nkeys > 0)
+		memcpy(scan->rs_base.rs_key, key,
+			   sizeof(ScanKeyData) * scan->rs_base.rs_nkeys);
+
+	columnar_scan_reset(scan);
+}
+
+static void
+columnar_endscan(TableScanDesc sscan)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	RelationDecrementReferenceCount(scan->rs_base.rs_rd);
+
+	if (scan->strategy != NULL)
+		FreeAccessStrategy(scan->strategy);
+
+	MemoryContextDelete(scan->scan_cxt);
+
+	if (scan->rs_base.rs_key)
+		pfree(scan->rs_base.rs_key);
+
+	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
+		UnregisterSnapshot(scan->rs_base.rs_snapshot);
+
+	pfree(scan);
+}
+
+static void
+columnar_scan_set_projection(TableScanDesc sscan, Bitmapset *attrs)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	int			natts = RelationGetNumberOfAttributes(scan->rs_base.rs_rd);
+	bool	   *returned;
+	int			x = -1;
+
+	returned = MemoryContextAllocZero(scan->scan_cxt, sizeof(bool) * natts);
+	while ((x = bms_next_member(attrs, x)) >= 0)
+	{
+		AttrNumber	attno = x + FirstLowInvalidHeapAttributeNumber;
+
+		if (attno > 0 && attno <= natts)
+			returned[attno - 1] = true;
+	}
+
+	columnar_scan_set_columns(scan, returned);
+}
+
+/*
+ * Can no row of the chunk group match the scan keys, going by the minimum
+ * and maximum of its chunks?
+ */
+static bool
+columnar_scan_skip_group(ColumnarScanDesc scan, int group)
+{
+	ColumnarGroupData *gd = &scan->gd;
+
+	for (int i = 0; i < scan->rs_base.rs_nkeys; i++)
+	{
+		ScanKey		k = &scan->rs_base.rs_key[i];
+		int			attno = k->sk_attno - 1;
+		ColumnarChunk *chunk;
+
+		if (k->sk_flags & SK_ISNULL)
+			return true;
+		if (attno < 0 || attno >= gd->hdr.natts)
+			continue;
+
+		chunk = ColumnarStripeChunk(gd->chunks, gd->hdr.natts, group, attno);
+
+		/* the operators of scan keys are strict */
+		if (chunk->flags & COLUMNAR_CHUNK_ALL_NULL)
+			return true;
+		if (!(chunk->flags & COLUMNAR_CHUNK_HAS_MINMAX))
+			continue;
+
+		switch (k->sk_strategy)
+		{
+			case BTLessStrategyNumber:
+			case BTLessEqualStrategyNumber:
+				if (!DatumGetBool(FunctionCall2Coll(&k->sk_func,
+													k->sk_collation,
+													chunk->min,
+													k->sk_argument)))
+					return true;
+				break;
+			case BTGreaterStrategyNumber:
+			case BTGreaterEqualStrategyNumber:
+				if (!DatumGetBool(FunctionCall2Coll(&k->sk_func,
+													k->sk_collation,
+													chunk->max,
+													k->sk_argument)))
+					return true;
+				break;
+			case BTEqualStrategyNumber:
+				if (scan->key_cmp[i] != NULL &&
+					(DatumGetInt32(FunctionCall2Coll(scan->key_cmp[i],
+													 k->sk_collation,
+													 chunk->min,
+													 k->sk_argument)) > 0 ||
+					 DatumGetInt32(FunctionCall2Coll(scan->key_cmp[i],
+													 k->sk_collation,
+													 chunk->max,
+													 k->sk_argument)) < 0))
+					return true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Move to the next (or previous) chunk group that might have matching rows,
+ * and decode it.  Returns false at the end of the scan.
+ */
+static bool
+columnar_scan_next_group(ColumnarScanDesc scan, ScanDirection direction)
+{
+	Relation	rel = scan->rs_base.rs_rd;
+	ParallelColumnarScanDesc pscan =
+		(ParallelColumnarScanDesc) scan->rs_base.rs_parallel;
+	bool		backward = ScanDirectionIsBackward(direction);
+
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (scan->cur_stripe >= 0 && scan->cur_stripe < scan->nstripes)
+		{
+			int			group = scan->cur_group + (backward ? -1 : 1);
+
+			if (group >= 0 && group < scan->gd.hdr.ngroups)
+			{
+				scan->cur_group = group;
+				if (columnar_scan_skip_group(scan, group))
+					continue;
+
+				columnar_group_decode(rel, &scan->gd, group, scan->decoded,
+									  scan->strategy);
+				scan->cur_row = backward ? scan->gd.nrows : -1;
+				scan->in_group = true;
+				return true;
+			}
+		}
+
+		/* on to the next stripe */
+		if (pscan != NULL)
+		{
+			uint32		next;
+
+			Assert(!backward);
+			next = pg_atomic_fetch_add_u32(&pscan->next_stripe, 1);
+			if (next >= (uint32) scan->nstripes)
+			{
+				scan->cur_stripe = scan->nstripes;
+				return false;
+			}
+			scan->cur_stripe = next;
+		}
+		else if (backward)
+		{
+			if (--scan->cur_stripe < 0)
+			{
+				scan->cur_stripe = -1;
+				return false;
+			}
+		}
+		else
+		{
+			if (++scan->cur_stripe >= scan->nstripes)
+			{
+				scan->cur_stripe = scan->nstripes;
+				return false;
+			}
+		}
+
+		columnar_group_set_stripe(rel, &scan->gd,
+								  &scan->stripes[scan->cur_stripe],
+								  scan->strategy);
+		scan->cur_group = backward ? scan->gd.hdr.ngroups : -1;
+	}
+}
+
+static bool
+columnar_scan_row_matches(ColumnarScanDesc scan, uint32 row)
+{
+	ColumnarGroupData *gd = &scan->gd;
+
+	if (scan->ndeleted > 0)
+	{
+		uint64		rownum = gd->first_rownum + row;
+
+		if (bsearch(&rownum, scan->deleted, scan->ndeleted, sizeof(uint64),
+					columnar_rownum_cmp) != NULL)
+			return false;
+	}
+
+	for (int i = 0; i < scan->rs_base.rs_nkeys; i++)
+	{
+		ScanKey		k = &scan->rs_base.rs_key[i];
+		int			attno = k->sk_attno - 1;
+
+		if (gd->isnull[attno][row] ||
+			!DatumGetBool(FunctionCall2Coll(&k->sk_func,
+											k->sk_collation,
+											gd->values[attno][row],
+											k->sk_argument)))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+columnar_getnextslot(TableScanDesc sscan, ScanDirection direction,
+					 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	for (;;)
+	{
+		if (!scan->in_group &&
+			!columnar_scan_next_group(scan, direction))
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+
+		if (ScanDirectionIsBackward(direction))
+			scan->cur_row--;
+		else
+			scan->cur_row++;
+
+		if (scan->cur_row < 0 || scan->cur_row >= scan->gd.nrows)
+		{
+			scan->in_group = false;
+			continue;
+		}
+
+		if (!columnar_scan_row_matches(scan, scan->cur_row))
+			continue;
+
+		columnar_store_row(&scan->gd, scan->cur_row, scan->returned,
+						   scan->materialize, slot);
+		slot->tts_tableOid = RelationGetRelid(scan->rs_base.rs_rd);
+		pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+		return true;
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Parallel scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Parallel workers take whole stripes.  They all see the same stripes, as
+ * they have the same snapshot.
+ */
+static Size
+columnar_parallelscan_estimate(Relation rel)
+{
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+static Size
+columnar_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+
+	cpscan->base.phs_relid = RelationGetRelid(rel);
+	cpscan->base.phs_syncscan = false;
+	pg_atomic_init_u32(&cpscan->next_stripe, 0);
+
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+static void
+columnar_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+
+	pg_atomic_write_u32(&cpscan->next_stripe, 0);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Unsupported callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_indexes_unsupported(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("indexes are not supported on columnar tables")));
+}
+
+static IndexFetchTableData *
+columnar_index_fetch_begin(Relation rel)
+{
+	columnar_indexes_unsupported();
+	return NULL;				/* keep compiler quiet */
+}
+
+static void
+columnar_index_fetch_reset(IndexFetchTableData *scan)
+{
+	columnar_indexes_unsupported();
+}
+
+static void
+columnar_index_fetch_end(IndexFetchTableData *scan)
+{
+	columnar_indexes_unsupported();
+}
+
+static bool
+columnar_index_fetch_tuple(struct IndexFetchTableData *scan,
+						   ItemPointer tid,
+						   Snapshot snapshot,
+						   TupleTableSlot *slot,
+						   bool *call_again, bool *all_dead)
+{
+	columnar_indexes_unsupported();
+	return false;				/* keep compiler quiet */
+}
+
+static TransactionId
+columnar_index_delete_tuples(Relation rel, TM_IndexDeleteOp *delstate)
+{
+	columnar_indexes_unsupported();
+	return InvalidTransactionId;	/* keep compiler quiet */
+}
+
+static double
+columnar_index_build_range_scan(Relation tableRelation,
+								Relation indexRelation,
+								IndexInfo *indexInfo,
+								bool allow_sync,
+								bool anyvisible,
+								bool progress,
+								BlockNumber start_blockno,
+								BlockNumber numblocks,
+								IndexBuildCallback callback,
+								void *callback_state,
+								TableScanDesc scan)
+{
+	columnar_indexes_unsupported();
+	return 0;					/* keep compiler quiet */
+}
+
+static void
+columnar_index_validate_scan(Relation tableRelation,
+							 Relation indexRelation,
+							 IndexInfo *indexInfo,
+							 Snapshot snapshot,
+							 ValidateIndexState *state)
+{
+	columnar_indexes_unsupported();
+}
+
+static void
+columnar_tuple_insert_speculative(Relation relation, TupleTableSlot *slot,
+								  CommandId cid, int options,
+								  BulkInsertState bistate, uint32 specToken)
+{
+	columnar_indexes_unsupported();
+}
+
+static void
+columnar_tuple_complete_speculative(Relation relation, TupleTableSlot *slot,
+									uint32 specToken, bool succeeded)
+{
+	columnar_indexes_unsupported();
+}
+
+static TM_Result
+columnar_tuple_lock(Relation relation, ItemPointer tid, Snapshot snapshot,
+					TupleTableSlot *slot, CommandId cid, LockTupleMode mode,
+					LockWaitPolicy wait_policy, uint8 flags,
+					TM_FailureData *tmfd)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("row-level locks are not supported on columnar tables")));
+	return TM_Invisible;		/* keep compiler quiet */
+}
+
+static void
+columnar_relation_copy_for_cluster(Relation OldTable, Relation NewTable,
+								   Relation OldIndex, bool use_sort,
+								   TransactionId OldestXmin,
+								   TransactionId *xid_cutoff,
+								   MultiXactId *multi_cutoff,
+								   double *num_tuples,
+								   double *tups_vacuumed,
+								   double *tups_recently_dead)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("VACUUM FULL and CLUSTER are not supported on columnar tables")));
+}
+
+static bool
+columnar_scan_sample_next_block(TableScanDesc scan,
+								struct SampleScanState *scanstate)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("TABLESAMPLE is not supported on columnar tables")));
+	return false;				/* keep compiler quiet */
+}
+
+static bool
+columnar_scan_sample_next_tuple(TableScanDesc scan,
+								struct SampleScanState *scanstate,
+								TupleTableSlot *slot)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("TABLESAMPLE is not supported on columnar tables")));
+	return false;				/* keep compiler quiet */
+}
+
+
+/* ------------------------------------------------------------------------
+ * Callbacks for non-modifying operations on individual tuples
+ * ------------------------------------------------------------------------
+ */
+
+static bool
+columnar_fetch_row_version(Relation relation, ItemPointer tid,
+						   Snapshot snapshot, TupleTableSlot *slot)
+{
+	uint64		rownum = ColumnarTidToRowNumber(tid);
+	ColumnarRelCache *cache;
+	ColumnarStripeEntry *stripe;
+
+	columnar_flush_pending_row(relation, rownum);
+
+	cache = columnar_get_rel_cache(relation);
+	if (!columnar_row_visible(cache, rownum, snapshot, &stripe))
+		return false;
+
+	columnar_fetch_into_slot(relation, cache, stripe, rownum, slot);
+	return true;
+}
+
+static bool
+columnar_tuple_tid_valid(TableScanDesc scan, ItemPointer tid)
+{
+	OffsetNumber offnum = ItemPointerGetOffsetNumberNoCheck(tid);
+
+	return ItemPointerIsValid(tid) &&
+		offnum <= COLUMNAR_ROWS_PER_TID_BLOCK &&
+		ColumnarTidToRowNumber(tid) < columnar_next_rownum(scan->rs_rd);
+}
+
+static void
+columnar_get_latest_tid(TableScanDesc sscan, ItemPointer tid)
+{
+	/* there are no update chains, every row is its own latest version */
+}
+
+static bool
+columnar_tuple_satisfies_snapshot(Relation rel, TupleTableSlot *slot,
+								  Snapshot snapshot)
+{
+	uint64		rownum = ColumnarTidToRowNumber(&slot->tts_tid);
+	ColumnarStripeEntry *stripe;
+
+	columnar_flush_pending_row(rel, rownum);
+
+	return columnar_row_visible(columnar_get_rel_cache(rel), rownum, snapshot,
+								&stripe);
+}
+
+
+/* ----------------------------------------------------------------------------
+ *  Functions for manipulations of physical tuples for columnar AM.
+ * ----------------------------------------------------------------------------
+ */
+
+static void
+columnar_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
+					  int options, BulkInsertState bistate)
+{
+	CheckForSerializableConflictIn(relation, NULL, InvalidBlockNumber);
+
+	columnar_buffer_row(relation, slot, cid);
+
+	pgstat_count_heap_insert(relation, 1);
+}
+
+static void
+columnar_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
+					  CommandId cid, int options, BulkInsertState bistate)
+{
+	CheckForSerializableConflictIn(relation, NULL, InvalidBlockNumber);
+
+	for (int i = 0; i < ntuples; i++)
+		columnar_buffer_row(relation, slots[i], cid);
+
+	pgstat_count_heap_insert(relation, ntuples);
+}
+
+/*
+ * Add a delete entry for the row, after making sure nobody else deleted it.
+ */
+static TM_Result
+columnar_delete_row(Relation relation, ItemPointer tid, CommandId cid,
+					bool wait, TM_FailureData *tmfd)
+{
+	uint64		rownum = ColumnarTidToRowNumber(tid);
+	ItemPointerData sentinel;
+	ColumnarRelCache *cache;
+	ColumnarDeleteHashEntry *entry;
+
+	CheckForSerializableConflictIn(relation, NULL, InvalidBlockNumber);
+
+	columnar_flush_pending_row(relation, rownum);
+
+	/* serialize deleters; released at end of transaction */
+	ItemPointerSet(&sentinel, MaxBlockNumber, MaxOffsetNumber);
+	if (wait)
+		LockTuple(relation, &sentinel, ExclusiveLock);
+	else if (!ConditionalLockTuple(relation, &sentinel, ExclusiveLock))
+		return TM_WouldBlock;
+
+	/* every earlier deleter has committed or aborted by now */
+	cache = columnar_get_rel_cache(relation);
+	entry = hash_search(cache->delhash, &rownum, HASH_FIND, NULL);
+	for (int i = entry ? entry->first : -1; i >= 0; i = cache->delnext[i])
+	{
+		ColumnarDeleteEntry *del = &cache->deletes[i];
+
+		if (!TransactionIdIsValid(del->xmax))
+			continue;
+
+		if (TransactionIdIsCurrentTransactionId(del->xmax))
+		{
+			tmfd->ctid = *tid;
+			tmfd->xmax = del->xmax;
+			tmfd->cmax = del->cmax;
+			tmfd->traversed = false;
+			return del->cmax >= cid ? TM_SelfModified : TM_Invisible;
+		}
+
+		if (TransactionIdEquals(del->xmax, FrozenTransactionId) ||
+			TransactionIdDidCommit(del->xmax))
+		{
+			tmfd->ctid = *tid;
+			tmfd->xmax = del->xmax;
+			tmfd->cmax = InvalidCommandId;
+			tmfd->traversed = false;
+			return TM_Deleted;
+		}
+	}
+
+	columnar_append_delete(relation, rownum, GetCurrentTransactionId(), cid);
+
+	return TM_Ok;
+}
+
+static TM_Result
+columnar_tuple_delete(Relation relation, ItemPointer tid, CommandId cid,
+					  Snapshot snapshot, Snapshot crosscheck, bool wait,
+					  TM_FailureData *tmfd, bool changingPart)
+{
+	TM_Result	result;
+
+	result = columnar_delete_row(relation, tid, cid, wait, tmfd);
+	if (result == TM_Ok)
+		pgstat_count_heap_delete(relation);
+
+	return result;
+}
+
+static TM_Result
+columnar_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
+					  CommandId cid, Snapshot snapshot, Snapshot crosscheck,
+					  bool wait, TM_FailureData *tmfd,
+					  LockTupleMode *lockmode, TU_UpdateIndexes *update_indexes)
+{
+	TM_Result	result;
+
+	*lockmode = LockTupleExclusive;
+	*update_indexes = TU_None;
+
+	result = columnar_delete_row(relation, otid, cid, wait, tmfd);
+	if (result != TM_Ok)
+		return result;
+
+	columnar_buffer_row(relation, slot, cid);
+	pgstat_count_heap_update(relation, false, false);
+
+	return TM_Ok;
+}
+
+
+/* ------------------------------------------------------------------------
+ * DDL related callbacks for columnar AM.
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_relation_set_new_filelocator(Relation rel,
+									  const RelFileLocator *newrlocator,
+									  char persistence,
+									  TransactionId *freezeXid,
+									  MultiXactId *minmulti)
+{
+	SMgrRelation srel;
+
+	/* see heapam_relation_set_new_filelocator() */
+	*freezeXid = RecentXmin;
+	*minmulti = GetOldestMultiXactId();
+
+	srel = RelationCreateStorage(*newrlocator, persistence, true);
+
+	if (persistence == RELPERSISTENCE_UNLOGGED)
+	{
+		Assert(rel->rd_rel->relkind == RELKIND_RELATION ||
+			   rel->rd_rel->relkind == RELKIND_MATVIEW);
+		smgrcreate(srel, INIT_FORKNUM, false);
+		log_smgrcreate(newrlocator, INIT_FORKNUM);
+		smgrimmedsync(srel, INIT_FORKNUM);
+	}
+
+	smgrclose(srel);
+}
+
+static void
+columnar_relation_nontransactional_truncate(Relation rel)
+{
+	columnar_discard_pending(rel);
+	columnar_forget_rel_cache(rel);
+	RelationTruncate(rel, 0);
+}
+
+static void
+columnar_relation_copy_data(Relation rel, const RelFileLocator *newrlocator)
+{
+	SMgrRelation dstrel;
+
+	columnar_flush_pending(rel);
+
+	dstrel = smgropen(*newrlocator, rel->rd_backend);
+
+	/* see heapam_relation_copy_data() */
+	FlushRelationBuffers(rel);
+
+	RelationCreateStorage(*newrlocator, rel->rd_rel->relpersistence, true);
+
+	RelationCopyStorage(RelationGetSmgr(rel), dstrel, MAIN_FORKNUM,
+						rel->rd_rel->relpersistence);
+
+	if (smgrexists(RelationGetSmgr(rel), INIT_FORKNUM))
+	{
+		smgrcreate(dstrel, INIT_FORKNUM, false);
+		log_smgrcreate(newrlocator, INIT_FORKNUM);
+		RelationCopyStorage(RelationGetSmgr(rel), dstrel, INIT_FORKNUM,
+							rel->rd_rel->relpersistence);
+	}
+
+	RelationDropStorage(rel);
+	smgrclose(dstrel);
+}
+
+/*
+ * VACUUM can't reclaim any space, as stripes are never rewritten.  It
+ * freezes the xids of the stripe directory and delete log, so that
+ * relfrozenxid can advance, and updates the statistics.
+ */
+static void
+columnar_vacuum_rel(Relation rel, VacuumParams *params,
+					BufferAccessStrategy bstrategy)
+{
+	struct VacuumCutoffs cutoffs;
+	ColumnarListPosition pos;
+	ColumnarStripeEntry *stripes;
+	ColumnarDeleteEntry *deletes;
+	int			nstripes;
+	int			ndeletes;
+	double		live_rows = 0;
+	double		dead_rows = 0;
+	BlockNumber nblocks;
+	bool		frozenxid_updated;
+	bool		minmulti_updated;
+
+	vacuum_get_cutoffs(rel, params, &cutoffs);
+
+	columnar_freeze(rel, cutoffs.OldestXmin);
+
+	/* every xid left is at least OldestXmin, and still in the clog */
+	pos.blkno = InvalidBlockNumber;
+	stripes = columnar_read_stripes(rel, &pos, &nstripes);
+	for (int i = 0; i < nstripes; i++)
+	{
+		TransactionId xmin = stripes[i].xmin;
+
+		if (TransactionIdEquals(xmin, FrozenTransactionId) ||
+			(TransactionIdIsNormal(xmin) &&
+			 !TransactionIdIsInProgress(xmin) &&
+			 TransactionIdDidCommit(xmin)))
+			live_rows += stripes[i].nrows;
+	}
+
+	pos.blkno = InvalidBlockNumber;
+	deletes = columnar_read_deletes(rel, &pos, &ndeletes);
+	for (int i = 0; i < ndeletes; i++)
+	{
+		TransactionId xmax = deletes[i].xmax;
+
+		if (TransactionIdEquals(xmax, FrozenTransactionId) ||
+			(TransactionIdIsNormal(xmax) &&
+			 !TransactionIdIsInProgress(xmax) &&
+			 TransactionIdDidCommit(xmax)))
+			dead_rows += 1;
+	}
+	live_rows = Max(live_rows - dead_rows, 0);
+
+	nblocks = RelationGetNumberOfBlocks(rel);
+
+	vac_update_relstats(rel, nblocks, live_rows, 0, false,
+						cutoffs.OldestXmin, cutoffs.OldestMxact,
+						&frozenxid_updated, &minmulti_updated, false);
+
+	pgstat_report_vacuum(RelationGetRelid(rel),
+						 rel->rd_rel->relisshared,
+						 (PgStat_Counter) live_rows,
+						 (PgStat_Counter) dead_rows,
+						 0, 0, GetXLogInsertRecPtr());
+
+	ereport((params->options & VACOPT_VERBOSE) ? INFO : DEBUG2,
+			(errmsg("\"%s\": found %.0f live and %.0f deleted rows in %u stripes and %u pages",
+					RelationGetRelationName(rel), live_rows, dead_rows,
+					nstripes, nblocks)));
+
+	if (stripes)
+		pfree(stripes);
+	if (deletes)
+		pfree(deletes);
+}
+
+/*
+ * ANALYZE samples blocks, which don't mean anything to a columnar table;
+ * each sampled block stands for its share of the row numbers instead.
+ */
+static bool
+columnar_scan_analyze_next_block(TableScanDesc sscan, ReadStream *stream)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Buffer		buf;
+	BlockNumber blkno;
+
+	buf = read_stream_next_buffer(stream, NULL);
+	if (!BufferIsValid(buf))
+		return false;
+	blkno = BufferGetBlockNumber(buf);
+	ReleaseBuffer(buf);
+
+	if (blkno >= scan->analyze_nblocks)
+	{
+		scan->analyze_next = scan->analyze_end = 0;
+		return true;
+	}
+
+	scan->analyze_next = (uint64) ((double) scan->analyze_nrows * blkno /
+								   scan->analyze_nblocks);
+	if (blkno + 1 == scan->analyze_nblocks)
+		scan->analyze_end = scan->analyze_nrows;
+	else
+		scan->analyze_end = (uint64) ((double) scan->analyze_nrows *
+									  (blkno + 1) / scan->analyze_nblocks);
+
+	return true;
+}
+
+static bool
+columnar_scan_analyze_next_tuple(TableScanDesc sscan, TransactionId OldestXmin,
+								 double *liverows, double *deadrows,
+								 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	Relation	rel = scan->rs_base.rs_rd;
+
+	while (scan->analyze_next < scan->analyze_end)
+	{
+		uint64		rownum = scan->analyze_next++;
+		ColumnarStripeEntry *stripe;
+		TransactionId xmin;
+		ColumnarDeleteEntry key;
+		ColumnarDeleteEntry *del;
+		bool		deleted = false;
+		int			group;
+
+		stripe = columnar_find_stripe(scan->stripes, scan->nstripes, rownum);
+		if (stripe == NULL)
+			continue;
+
+		/*
+		 * As in heapam_scan_analyze_next_tuple(), rows inserted by other
+		 * transactions still in progress aren't counted, and rows whose
+		 * delete is in progress count as live, unless it's our own.
+		 */
+		xmin = stripe->xmin;
+		if (!TransactionIdIsValid(xmin))
+			continue;
+		if (!TransactionIdEquals(xmin, FrozenTransactionId) &&
+			!TransactionIdIsCurrentTransactionId(xmin) &&
+			(TransactionIdIsInProgress(xmin) || !TransactionIdDidCommit(xmin)))
+			continue;
+
+		key.rownum = rownum;
+		del = bsearch(&key, scan->alldeletes, scan->nalldeletes,
+					  sizeof(ColumnarDeleteEntry), columnar_delete_cmp);
+		if (del != NULL)
+		{
+			/* bsearch finds any of the entries of the row */
+			while (del > scan->alldeletes && (del - 1)->rownum == rownum)
+				del--;
+			for (; del < scan->alldeletes + scan->nalldeletes &&
+				 del->rownum == rownum; del++)
+			{
+				TransactionId xmax = del->xmax;
+
+				if (TransactionIdEquals(xmax, FrozenTransactionId) ||
+					(TransactionIdIsValid(xmax) &&
+					 (TransactionIdIsCurrentTransactionId(xmax) ||
+					  (!TransactionIdIsInProgress(xmax) &&
+					   TransactionIdDidCommit(xmax)))))
+					deleted = true;
+			}
+		}
+		if (deleted)
+		{
+			*deadrows += 1;
+			continue;
+		}
+
+		columnar_group_set_stripe(rel, &scan->gd, stripe, scan->strategy);
+		group = (rownum - stripe->first_rownum) / scan->gd.hdr.group_rows;
+		if (scan->gd.group != group)
+			columnar_group_decode(rel, &scan->gd, group, NULL, scan->strategy);
+
+		columnar_store_row(&scan->gd, rownum - scan->gd.first_rownum, NULL,
+						   true, slot);
+		slot->tts_tableOid = RelationGetRelid(rel);
+		*liverows += 1;
+		return true;
+	}
+
+	return false;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Miscellaneous callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Values are stored inline and compressed chunk by chunk, so there's no
+ * need for a TOAST table.
+ */
+static bool
+columnar_relation_needs_toast_table(Relation rel)
+{
+	return false;
+}
+
+/* ------------------------------------------------------------------------
+ * Planner related callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_estimate_rel_size(Relation rel, int32 *attr_widths,
+						   BlockNumber *pages, double *tuples,
+						   double *allvisfrac)
+{
+	BlockNumber curpages = RelationGetNumberOfBlocks(rel);
+	BlockNumber relpages = rel->rd_rel->relpages;
+	double		reltuples = rel->rd_rel->reltuples;
+
+	*pages = curpages;
+	*allvisfrac = 0;
+
+	if (curpages == 0)
+		*tuples = 0;
+	else if (reltuples >= 0 && relpages > 0)
+		*tuples = rint(reltuples / relpages * curpages);
+	else
+		*tuples = (double) columnar_next_rownum(rel);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Definition of the columnar table access method.
+ * ------------------------------------------------------------------------
+ */
+
+static const TableAmRoutine columnar_methods = {
+	.type = T_TableAmRoutine,
+
+	.slot_callbacks = columnar_slot_callbacks,
+
+	.scan_begin = columnar_beginscan,
+	.scan_end = columnar_endscan,
+	.scan_rescan = columnar_rescan,
+	.scan_getnextslot = columnar_getnextslot,
+
+	.scan_set_projection = columnar_scan_set_projection,
+
+	.parallelscan_estimate = columnar_parallelscan_estimate,
+	.parallelscan_initialize = columnar_parallelscan_initialize,
+	.parallelscan_reinitialize = columnar_parallelscan_reinitialize,
+
+	.index_fetch_begin = columnar_index_fetch_begin,
+	.index_fetch_reset = columnar_index_fetch_reset,
+	.index_fetch_end = columnar_index_fetch_end,
+	.index_fetch_tuple = columnar_index_fetch_tuple,
+
+	.tuple_insert = columnar_tuple_insert,
+	.tuple_insert_speculative = columnar_tuple_insert_speculative,
+	.tuple_complete_speculative = columnar_tuple_complete_speculative,
+	.multi_insert = columnar_multi_insert,
+	.tuple_delete = columnar_tuple_delete,
+	.tuple_update = columnar_tuple_update,
+	.tuple_lock = columnar_tuple_lock,
+
+	.tuple_fetch_row_version = columnar_fetch_row_version,
+	.tuple_get_latest_tid = columnar_get_latest_tid,
+	.tuple_tid_valid = columnar_tuple_tid_valid,
+	.tuple_satisfies_snapshot = columnar_tuple_satisfies_snapshot,
+	.index_delete_tuples = columnar_index_delete_tuples,
+
+	.relation_set_new_filelocator = columnar_relation_set_new_filelocator,
+	.relation_nontransactional_truncate = columnar_relation_nontransactional_truncate,
+	.relation_copy_data = columnar_relation_copy_data,
+	.relation_copy_for_cluster = columnar_relation_copy_for_cluster,
+	.relation_vacuum = columnar_vacuum_rel,
+	.scan_analyze_next_block = columnar_scan_analyze_next_block,
+	.scan_analyze_next_tuple = columnar_scan_analyze_next_tuple,
+	.index_build_range_scan = columnar_index_build_range_scan,
+	.index_validate_scan = columnar_index_validate_scan,
+
+	.relation_size = table_block_relation_size,
+	.relation_needs_toast_table = columnar_relation_needs_toast_table,
+
+	.relation_estimate_size = columnar_estimate_rel_size,
+
+	.scan_sample_next_block = columnar_scan_sample_next_block,
+	.scan_sample_next_tuple = columnar_scan_sample_next_tuple
+};
+
+
+const TableAmRoutine *
+GetColumnarTableAmRoutine(void)
+{
+	return &columnar_methods;
+}
+
+Datum
+columnar_tableam_handler(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(&columnar_methods);
+}
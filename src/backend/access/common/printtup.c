@@ -19,6 +19,8 @@
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
 #include "tcop/pquery.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
@@ -29,6 +31,8 @@ static void printtup_startup(DestReceiver *self, int operation,
 static bool printtup(TupleTableSlot *slot, DestReceiver *self);
 static void printtup_shutdown(DestReceiver *self);
 static void printtup_destroy(DestReceiver *self);
+static Oid	printtup_fast_func(Oid func);
+static void printtup_fast(StringInfo buf, Oid func, Datum attr);
 
 /* ----------------------------------------------------------------
  *		printtup / debugtup support
@@ -48,6 +52,7 @@ typedef struct
 	Oid			typsend;		/* Oid for the type's binary output fn */
 	bool		typisvarlena;	/* is it varlena (ie possibly toastable)? */
 	int16		format;			/* format code for this column */
+	Oid			fastfunc;		/* output fn printtup_fast() handles, or 0 */
 	FmgrInfo	finfo;			/* Precomputed call info for output fn */
 } PrinttupAttrInfo;
 
@@ -278,6 +283,7 @@ printtup_prepare_info(DR_printtup *myState, TupleDesc typeinfo, int numAttrs)
 							  &thisState->typoutput,
 							  &thisState->typisvarlena);
 			fmgr_info(thisState->typoutput, &thisState->finfo);
+			thisState->fastfunc = printtup_fast_func(thisState->typoutput);
 		}
 		else if (format == 1)
 		{
@@ -285,6 +291,7 @@ printtup_prepare_info(DR_printtup *myState, TupleDesc typeinfo, int numAttrs)
 									&thisState->typsend,
 									&thisState->typisvarlena);
 			fmgr_info(thisState->typsend, &thisState->finfo);
+			thisState->fastfunc = printtup_fast_func(thisState->typsend);
 		}
 		else
 			ereport(ERROR,
@@ -349,7 +356,9 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 			VALGRIND_CHECK_MEM_IS_DEFINED(DatumGetPointer(attr),
 										  VARSIZE_ANY(attr));
 
-		if (thisState->format == 0)
+		if (OidIsValid(thisState->fastfunc))
+			printtup_fast(buf, thisState->fastfunc, attr);
+		else if (thisState->format == 0)
 		{
 			/* Text output */
 			char	   *outputstr;
@@ -378,6 +387,133 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 	return true;
 }
 
+/*
+ * Output functions of common builtin types can have their value written
+ * straight into the DataRow message, sparing the palloc'd cstring or bytea
+ * that calling them would produce and the copy out of it.  Returns func if
+ * printtup_fast() knows how to do that for it, else InvalidOid.
+ *
+ * This goes by output function rather than by type, so that domains over
+ * these types take the fast path too.
+ */
+static Oid
+printtup_fast_func(Oid func)
+{
+	switch (func)
+	{
+		case F_BOOLOUT:
+		case F_BOOLSEND:
+		case F_INT2OUT:
+		case F_INT2SEND:
+		case F_INT4OUT:
+		case F_INT4SEND:
+		case F_INT8OUT:
+		case F_INT8SEND:
+		case F_FLOAT4SEND:
+		case F_FLOAT8SEND:
+		case F_DATE_SEND:
+		case F_TIMESTAMP_SEND:
+		case F_TIMESTAMPTZ_SEND:
+		case F_TEXTOUT:
+		case F_TEXTSEND:
+		case F_VARCHAROUT:
+		case F_VARCHARSEND:
+		case F_BPCHAROUT:
+		case F_BPCHARSEND:
+			return func;
+		default:
+			return InvalidOid;
+	}
+}
+
+/*
+ * Append one non-null field, length word included, exactly as calling
+ * output function func and sending its result would.
+ */
+static void
+printtup_fast(StringInfo buf, Oid func, Datum attr)
+{
+	int			len;
+
+	switch (func)
+	{
+		case F_BOOLOUT:
+			pq_sendint32(buf, 1);
+			pq_sendbyte(buf, DatumGetBool(attr) ? 't' : 'f');
+			break;
+		case F_BOOLSEND:
+			pq_sendint32(buf, 1);
+			pq_sendbyte(buf, DatumGetBool(attr) ? 1 : 0);
+			break;
+
+			/*
+			 * Integer text output is plain ASCII, so needs no encoding
+			 * conversion; format the digits in place after the length word.
+			 * The pg_*toa functions also store a trailing NUL.
+			 */
+		case F_INT2OUT:
+		case F_INT4OUT:
+		case F_INT8OUT:
+			enlargeStringInfo(buf, 4 + MAXINT8LEN + 1);
+			if (func == F_INT2OUT)
+				len = pg_itoa(DatumGetInt16(attr), buf->data + buf->len + 4);
+			else if (func == F_INT4OUT)
+				len = pg_ltoa(DatumGetInt32(attr), buf->data + buf->len + 4);
+			else
+				len = pg_lltoa(DatumGetInt64(attr), buf->data + buf->len + 4);
+			pq_writeint32(buf, len);
+			buf->len += len;
+			break;
+
+		case F_INT2SEND:
+			pq_sendint32(buf, 2);
+			pq_sendint16(buf, DatumGetInt16(attr));
+			break;
+		case F_INT4SEND:
+		case F_DATE_SEND:
+			pq_sendint32(buf, 4);
+			pq_sendint32(buf, DatumGetInt32(attr));
+			break;
+		case F_INT8SEND:
+		case F_TIMESTAMP_SEND:
+		case F_TIMESTAMPTZ_SEND:
+			pq_sendint32(buf, 8);
+			pq_sendint64(buf, DatumGetInt64(attr));
+			break;
+		case F_FLOAT4SEND:
+			pq_sendint32(buf, 4);
+			pq_sendfloat4(buf, DatumGetFloat4(attr));
+			break;
+		case F_FLOAT8SEND:
+			pq_sendint32(buf, 8);
+			pq_sendfloat8(buf, DatumGetFloat8(attr));
+			break;
+
+			/*
+			 * For these types, both the text and the binary form are the
+			 * value in the client encoding.  The detoasted copy, if any, is
+			 * in the per-row context.
+			 */
+		case F_TEXTOUT:
+		case F_TEXTSEND:
+		case F_VARCHAROUT:
+		case F_VARCHARSEND:
+		case F_BPCHAROUT:
+		case F_BPCHARSEND:
+			{
+				struct varlena *t;
+
+				t = pg_detoast_datum_packed((struct varlena *) DatumGetPointer(attr));
+
+				pq_sendcountedtext(buf, VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t),
+								   false);
+			}
+			break;
+		default:
+			elog(ERROR, "unexpected fast-path output function %u", func);
+	}
+}
+
 /* ----------------
  *		printtup_shutdown
  * ----------------
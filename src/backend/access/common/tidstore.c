@@ -0,0 +1,799 @@
+/*-------------------------------------------------------------------------
+ *
+ * tidstore.c
+ *		TID (ItemPointerData) storage implementation.
+ *
+ * TidStore is an in-memory data structure to store a set of TIDs, used by
+ * VACUUM to remember the dead items found in the first heap pass.  The TIDs
+ * are grouped by block: each block number maps to the set of offsets stored
+ * for it, either embedded directly in the tree slot when there are only a
+ * few of them, or as a bitmap that is only as long as needed to cover the
+ * highest offset.  That makes a page full of dead items cost a few dozen
+ * bytes instead of six bytes per TID, and lets a membership test be done
+ * with a handful of array lookups rather than a binary search.
+ *
+ * The block numbers are the keys of a radix tree with a fanout of 256 per
+ * level, so the tree has at most four levels.  To stay small when the keys
+ * are sparse, nodes come in three sizes (4, 16 and 256 children), and a
+ * node is replaced by the next larger kind when it runs out of room.  The
+ * height of the tree grows on demand with the largest key inserted.
+ *
+ * A TidStore can be allocated either in backend-local memory or in a DSA
+ * area, so that parallel VACUUM workers can look up the TIDs collected by
+ * the leader.  Nodes reference their children through TsPtr, which holds
+ * either a local pointer or a dsa_pointer, depending on where the store
+ * lives.  The store is not internally synchronized; when a shared store may
+ * be modified while other processes read it, callers must use
+ * TidStoreLockExclusive() and TidStoreLockShare().
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/common/tidstore.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/tidstore.h"
+#include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "storage/lwlock.h"
+#include "utils/memutils.h"
+
+/*
+ * A reference to a node or to a block's offset bitmap, or an embedded set of
+ * up to TS_MAX_EMBEDDED offsets.  Allocations are always MAXALIGN'd, both
+ * in local memory and in DSA, so the low bit is free to tag embedded values.
+ */
+typedef uint64 TsPtr;
+
+#define TS_INVALID_PTR		((TsPtr) 0)
+
+#define TS_EMBEDDED_TAG		((TsPtr) 1)
+#define TS_MAX_EMBEDDED		3
+#define TsPtrIsEmbedded(p)	(((p) & TS_EMBEDDED_TAG) != 0)
+#define TsEmbeddedCount(p)	((int) (((p) >> 1) & 0x03))
+#define TsEmbeddedOffset(p, i) \
+	((OffsetNumber) (((p) >> (16 * ((i) + 1))) & 0xFFFF))
+
+/* each tree level consumes 8 bits of the block number */
+#define TS_SPAN				8
+#define TS_CHUNK_MASK		((1 << TS_SPAN) - 1)
+#define TS_MAX_LEVEL		((int) (sizeof(BlockNumber) * BITS_PER_BYTE / TS_SPAN))
+
+/* node kinds */
+#define TS_NODE_4			0
+#define TS_NODE_16			1
+#define TS_NODE_256			2
+
+typedef struct TsNode
+{
+	uint16		kind;
+	uint16		count;			/* number of children in use */
+} TsNode;
+
+/* the smaller kinds keep their chunks sorted, in parallel with children[] */
+typedef struct TsNode4
+{
+	TsNode		n;
+	uint8		chunks[4];
+	TsPtr		children[4];
+} TsNode4;
+
+typedef struct TsNode16
+{
+	TsNode		n;
+	uint8		chunks[16];
+	TsPtr		children[16];
+} TsNode16;
+
+/* the largest kind is indexed directly by chunk; unused slots are invalid */
+typedef struct TsNode256
+{
+	TsNode		n;
+	TsPtr		children[256];
+} TsNode256;
+
+static const int ts_node_capacity[] = {4, 16, 256};
+static const Size ts_node_size[] = {
+	sizeof(TsNode4), sizeof(TsNode16), sizeof(TsNode256)
+};
+
+/* offsets of one block, when there are too many to embed */
+typedef struct TsBlockEntry
+{
+	uint16		nwords;			/* length of words[] */
+	uint16		ntids;			/* number of bits set */
+	uint64		words[FLEXIBLE_ARRAY_MEMBER];
+} TsBlockEntry;
+
+#define TS_BITS_PER_WORD	64
+#define WORDNUM(x)	((x) / TS_BITS_PER_WORD)
+#define BITNUM(x)	((x) % TS_BITS_PER_WORD)
+
+/*
+ * Control information of a TidStore.  For a shared store, this lives in the
+ * DSA area so that every attached process sees the same root.
+ */
+typedef struct TidStoreControl
+{
+	size_t		max_bytes;		/* memory budget set by the creator */
+	size_t		mem_used;		/* bytes allocated for nodes and entries */
+	int64		num_tids;		/* number of TIDs stored */
+	TsPtr		root;			/* root node, or TS_INVALID_PTR */
+	int			root_shift;		/* shift of the chunk used in the root */
+
+	/* the following are used only by a shared store */
+	LWLock		lock;
+	dsa_pointer handle;			/* points to this struct */
+} TidStoreControl;
+
+struct TidStore
+{
+	TidStoreControl *control;
+
+	/* backend-local store: memory context holding the tree */
+	MemoryContext context;
+
+	/* shared store: the DSA area holding the tree and the control data */
+	dsa_area   *area;
+};
+
+#define TidStoreIsShared(ts)	((ts)->area != NULL)
+
+/* iteration state, one frame per tree level */
+typedef struct TsIterFrame
+{
+	TsNode	   *node;
+	int			idx;			/* next child position to visit */
+} TsIterFrame;
+
+struct TidStoreIter
+{
+	TidStore   *ts;
+	int			level;			/* current depth, -1 once exhausted */
+	uint32		key;			/* block number being assembled */
+	TsIterFrame stack[TS_MAX_LEVEL];
+	TidStoreIterResult result;
+};
+
+static inline void *
+ts_ptr(TidStore *ts, TsPtr p)
+{
+	Assert(p != TS_INVALID_PTR && !TsPtrIsEmbedded(p));
+
+	if (TidStoreIsShared(ts))
+		return dsa_get_address(ts->area, (dsa_pointer) p);
+	else
+		return (void *) (uintptr_t) p;
+}
+
+static TsPtr
+ts_alloc(TidStore *ts, Size size)
+{
+	TsPtr		p;
+
+	if (TidStoreIsShared(ts))
+		p = (TsPtr) dsa_allocate0(ts->area, size);
+	else
+		p = (TsPtr) (uintptr_t) MemoryContextAllocZero(ts->context, size);
+
+	Assert(!TsPtrIsEmbedded(p));
+	ts->control->mem_used += size;
+
+	return p;
+}
+
+static void
+ts_free(TidStore *ts, TsPtr p, Size size)
+{
+	if (TidStoreIsShared(ts))
+		dsa_free(ts->area, (dsa_pointer) p);
+	else
+		pfree((void *) (uintptr_t) p);
+
+	ts->control->mem_used -= size;
+}
+
+static TsPtr
+ts_alloc_node(TidStore *ts, int kind)
+{
+	TsPtr		p = ts_alloc(ts, ts_node_size[kind]);
+	TsNode	   *node = (TsNode *) ts_ptr(ts, p);
+
+	node->kind = kind;
+	node->count = 0;
+
+	return p;
+}
+
+static inline uint8 *
+ts_node_chunks(TsNode *node)
+{
+	Assert(node->kind != TS_NODE_256);
+
+	if (node->kind == TS_NODE_4)
+		return ((TsNode4 *) node)->chunks;
+	else
+		return ((TsNode16 *) node)->chunks;
+}
+
+static inline TsPtr *
+ts_node_children(TsNode *node)
+{
+	switch (node->kind)
+	{
+		case TS_NODE_4:
+			return ((TsNode4 *) node)->children;
+		case TS_NODE_16:
+			return ((TsNode16 *) node)->children;
+		default:
+			return ((TsNode256 *) node)->children;
+	}
+}
+
+/*
+ * Return the slot holding the child for 'chunk', or NULL if there is none.
+ */
+static inline TsPtr *
+ts_node_find(TsNode *node, uint8 chunk)
+{
+	TsPtr	   *children = ts_node_children(node);
+	uint8	   *chunks;
+
+	if (node->kind == TS_NODE_256)
+		return children[chunk] != TS_INVALID_PTR ? &children[chunk] : NULL;
+
+	chunks = ts_node_chunks(node);
+	for (int i = 0; i < node->count; i++)
+	{
+		if (chunks[i] == chunk)
+			return &children[i];
+		if (chunks[i] > chunk)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Add a child for 'chunk' to the node referenced by *nodep, which must not
+ * already have one.  A full node is replaced by a node of the next larger
+ * kind, and *nodep is updated to point to it.
+ */
+static void
+ts_node_insert(TidStore *ts, TsPtr *nodep, uint8 chunk, TsPtr child)
+{
+	TsNode	   *node = (TsNode *) ts_ptr(ts, *nodep);
+	TsPtr	   *children;
+	uint8	   *chunks;
+	int			idx;
+
+	if (node->kind != TS_NODE_256 &&
+		node->count == ts_node_capacity[node->kind])
+	{
+		TsPtr		newp = ts_alloc_node(ts, node->kind + 1);
+		TsNode	   *newnode = (TsNode *) ts_ptr(ts, newp);
+		TsPtr	   *oldchildren = ts_node_children(node);
+		uint8	   *oldchunks = ts_node_chunks(node);
+
+		if (newnode->kind == TS_NODE_256)
+		{
+			TsPtr	   *newchildren = ts_node_children(newnode);
+
+			for (int i = 0; i < node->count; i++)
+				newchildren[oldchunks[i]] = oldchildren[i];
+		}
+		else
+		{
+			memcpy(ts_node_chunks(newnode), oldchunks, node->count);
+			memcpy(ts_node_children(newnode), oldchildren,
+				   sizeof(TsPtr) * node->count);
+		}
+		newnode->count = node->count;
+
+		ts_free(ts, *nodep, ts_node_size[node->kind]);
+		*nodep = newp;
+		node = newnode;
+	}
+
+	children = ts_node_children(node);
+
+	if (node->kind == TS_NODE_256)
+	{
+		Assert(children[chunk] == TS_INVALID_PTR);
+		children[chunk] = child;
+		node->count++;
+		return;
+	}
+
+	/* keep the chunks sorted */
+	chunks = ts_node_chunks(node);
+	for (idx = 0; idx < node->count; idx++)
+	{
+		Assert(chunks[idx] != chunk);
+		if (chunks[idx] > chunk)
+			break;
+	}
+	memmove(&chunks[idx + 1], &chunks[idx], node->count - idx);
+	memmove(&children[idx + 1], &children[idx],
+			sizeof(TsPtr) * (node->count - idx));
+	chunks[idx] = chunk;
+	children[idx] = child;
+	node->count++;
+}
+
+/*
+ * Advance to the next used child of a node, starting at position *idx.
+ */
+static inline bool
+ts_node_next(TsNode *node, int *idx, uint8 *chunk, TsPtr *child)
+{
+	TsPtr	   *children = ts_node_children(node);
+
+	if (node->kind == TS_NODE_256)
+	{
+		while (*idx < 256 && children[*idx] == TS_INVALID_PTR)
+			(*idx)++;
+		if (*idx >= 256)
+			return false;
+		*chunk = (uint8) *idx;
+	}
+	else
+	{
+		if (*idx >= node->count)
+			return false;
+		*chunk = ts_node_chunks(node)[*idx];
+	}
+
+	*child = children[*idx];
+	(*idx)++;
+
+	return true;
+}
+
+/* largest block number that fits in a tree whose root uses 'shift' */
+static inline uint64
+ts_shift_max_key(int shift)
+{
+	return ((uint64) 1 << (shift + TS_SPAN)) - 1;
+}
+
+static inline int
+ts_key_get_shift(BlockNumber key)
+{
+	int			shift = 0;
+
+	while (key > ts_shift_max_key(shift))
+		shift += TS_SPAN;
+
+	return shift;
+}
+
+/* size and number of TIDs of a leaf value */
+static inline void
+ts_value_info(TidStore *ts, TsPtr value, Size *size, int *ntids)
+{
+	if (TsPtrIsEmbedded(value))
+	{
+		*size = 0;
+		*ntids = TsEmbeddedCount(value);
+	}
+	else
+	{
+		TsBlockEntry *entry = (TsBlockEntry *) ts_ptr(ts, value);
+
+		*size = offsetof(TsBlockEntry, words) +
+			sizeof(uint64) * entry->nwords;
+		*ntids = entry->ntids;
+	}
+}
+
+static TidStore *
+TidStoreCreateInternal(size_t max_bytes, dsa_area *area, int tranche_id)
+{
+	TidStore   *ts = palloc0(sizeof(TidStore));
+
+	if (area != NULL)
+	{
+		dsa_pointer dp;
+
+		ts->area = area;
+		dp = dsa_allocate0(area, sizeof(TidStoreControl));
+		ts->control = (TidStoreControl *) dsa_get_address(area, dp);
+		ts->control->handle = dp;
+		LWLockInitialize(&ts->control->lock, tranche_id);
+	}
+	else
+	{
+		ts->context = AllocSetContextCreate(CurrentMemoryContext,
+											"TID storage",
+											ALLOCSET_DEFAULT_SIZES);
+		ts->control = (TidStoreControl *)
+			MemoryContextAllocZero(ts->context, sizeof(TidStoreControl));
+		ts->control->handle = InvalidDsaPointer;
+	}
+
+	ts->control->max_bytes = max_bytes;
+	ts->control->root = TS_INVALID_PTR;
+
+	return ts;
+}
+
+/*
+ * Create a TidStore in backend-local memory.  max_bytes is not enforced
+ * here; it is remembered for the caller, which is expected to compare it
+ * with TidStoreMemoryUsage() and empty the store when it is exceeded.
+ */
+TidStore *
+TidStoreCreateLocal(size_t max_bytes)
+{
+	return TidStoreCreateInternal(max_bytes, NULL, 0);
+}
+
+/*
+ * Create a TidStore in a new DSA area, so that it can be attached to by
+ * other backends using TidStoreGetDSAHandle() and TidStoreGetHandle().
+ * The area is freed when the last backend detaches from it.
+ */
+TidStore *
+TidStoreCreateShared(size_t max_bytes, int tranche_id)
+{
+	dsa_area   *area = dsa_create(tranche_id);
+
+	return TidStoreCreateInternal(max_bytes, area, tranche_id);
+}
+
+/*
+ * Attach to a shared TidStore created by another backend.
+ */
+TidStore *
+TidStoreAttach(dsa_handle area_handle, dsa_pointer handle)
+{
+	TidStore   *ts;
+
+	Assert(area_handle != DSA_HANDLE_INVALID);
+	Assert(DsaPointerIsValid(handle));
+
+	ts = palloc0(sizeof(TidStore));
+	ts->area = dsa_attach(area_handle);
+	ts->control = (TidStoreControl *) dsa_get_address(ts->area, handle);
+
+	return ts;
+}
+
+/*
+ * Detach from a shared TidStore.  The store stays valid for the other
+ * attached backends.
+ */
+void
+TidStoreDetach(TidStore *ts)
+{
+	Assert(TidStoreIsShared(ts));
+
+	dsa_detach(ts->area);
+	pfree(ts);
+}
+
+/*
+ * Free a TidStore and all the memory it uses.  For a shared store, this must
+ * be called by the creator once the other backends have detached.
+ */
+void
+TidStoreDestroy(TidStore *ts)
+{
+	if (TidStoreIsShared(ts))
+		dsa_detach(ts->area);
+	else
+		MemoryContextDelete(ts->context);
+
+	pfree(ts);
+}
+
+void
+TidStoreLockExclusive(TidStore *ts)
+{
+	if (TidStoreIsShared(ts))
+		LWLockAcquire(&ts->control->lock, LW_EXCLUSIVE);
+}
+
+void
+TidStoreLockShare(TidStore *ts)
+{
+	if (TidStoreIsShared(ts))
+		LWLockAcquire(&ts->control->lock, LW_SHARED);
+}
+
+void
+TidStoreUnlock(TidStore *ts)
+{
+	if (TidStoreIsShared(ts))
+		LWLockRelease(&ts->control->lock);
+}
+
+/*
+ * Set the given offsets, which must be sorted in ascending order and free of
+ * duplicates, as the TIDs stored for blkno.  Any offsets stored for the
+ * block before are replaced.
+ */
+void
+TidStoreSetBlockOffsets(TidStore *ts, BlockNumber blkno,
+						OffsetNumber *offsets, int num_offsets)
+{
+	TidStoreControl *control = ts->control;
+	TsPtr		value;
+	TsPtr	   *nodep;
+	TsPtr	   *slot;
+	TsNode	   *node;
+	int			shift;
+
+	Assert(num_offsets > 0);
+#ifdef USE_ASSERT_CHECKING
+	for (int i = 0; i < num_offsets; i++)
+	{
+		Assert(OffsetNumberIsValid(offsets[i]));
+		Assert(i == 0 || offsets[i] > offsets[i - 1]);
+	}
+#endif
+
+	/* Build the leaf value */
+	if (num_offsets <= TS_MAX_EMBEDDED)
+	{
+		value = TS_EMBEDDED_TAG | ((TsPtr) num_offsets << 1);
+		for (int i = 0; i < num_offsets; i++)
+			value |= (TsPtr) offsets[i] << (16 * (i + 1));
+	}
+	else
+	{
+		int			nwords = WORDNUM(offsets[num_offsets - 1]) + 1;
+		TsBlockEntry *entry;
+
+		value = ts_alloc(ts, offsetof(TsBlockEntry, words) +
+						 sizeof(uint64) * nwords);
+		entry = (TsBlockEntry *) ts_ptr(ts, value);
+		entry->nwords = nwords;
+		entry->ntids = num_offsets;
+		for (int i = 0; i < num_offsets; i++)
+			entry->words[WORDNUM(offsets[i])] |=
+				(UINT64CONST(1) << BITNUM(offsets[i]));
+	}
+
+	/* Make sure the tree is tall enough for the key */
+	if (control->root == TS_INVALID_PTR)
+	{
+		control->root = ts_alloc_node(ts, TS_NODE_4);
+		control->root_shift = ts_key_get_shift(blkno);
+	}
+	else
+	{
+		while (blkno > ts_shift_max_key(control->root_shift))
+		{
+			TsPtr		newroot = ts_alloc_node(ts, TS_NODE_4);
+
+			ts_node_insert(ts, &newroot, 0, control->root);
+			control->root = newroot;
+			control->root_shift += TS_SPAN;
+		}
+	}
+
+	/* Descend to the leaf level, creating inner nodes as we go */
+	nodep = &control->root;
+	for (shift = control->root_shift; shift > 0; shift -= TS_SPAN)
+	{
+		uint8		chunk = (blkno >> shift) & TS_CHUNK_MASK;
+
+		node = (TsNode *) ts_ptr(ts, *nodep);
+		slot = ts_node_find(node, chunk);
+		if (slot == NULL)
+		{
+			ts_node_insert(ts, nodep, chunk, ts_alloc_node(ts, TS_NODE_4));
+			node = (TsNode *) ts_ptr(ts, *nodep);
+			slot = ts_node_find(node, chunk);
+		}
+		nodep = slot;
+	}
+
+	node = (TsNode *) ts_ptr(ts, *nodep);
+	slot = ts_node_find(node, blkno & TS_CHUNK_MASK);
+	if (slot != NULL)
+	{
+		Size		oldsize;
+		int			oldtids;
+
+		ts_value_info(ts, *slot, &oldsize, &oldtids);
+		if (!TsPtrIsEmbedded(*slot))
+			ts_free(ts, *slot, oldsize);
+		control->num_tids -= oldtids;
+		*slot = value;
+	}
+	else
+		ts_node_insert(ts, nodep, blkno & TS_CHUNK_MASK, value);
+
+	control->num_tids += num_offsets;
+}
+
+/*
+ * Return true if the given TID is present in the TidStore.
+ */
+bool
+TidStoreIsMember(TidStore *ts, ItemPointer tid)
+{
+	TidStoreControl *control = ts->control;
+	BlockNumber blkno = ItemPointerGetBlockNumber(tid);
+	OffsetNumber off = ItemPointerGetOffsetNumber(tid);
+	TsPtr		p = control->root;
+	TsPtr	   *slot;
+	int			shift;
+
+	if (p == TS_INVALID_PTR || blkno > ts_shift_max_key(control->root_shift))
+		return false;
+
+	for (shift = control->root_shift; shift >= 0; shift -= TS_SPAN)
+	{
+		slot = ts_node_find((TsNode *) ts_ptr(ts, p),
+							(blkno >> shift) & TS_CHUNK_MASK);
+		if (slot == NULL)
+			return false;
+		p = *slot;
+	}
+
+	if (TsPtrIsEmbedded(p))
+	{
+		for (int i = 0; i < TsEmbeddedCount(p); i++)
+		{
+			if (TsEmbeddedOffset(p, i) == off)
+				return true;
+		}
+		return false;
+	}
+	else
+	{
+		TsBlockEntry *entry = (TsBlockEntry *) ts_ptr(ts, p);
+
+		if (WORDNUM(off) >= entry->nwords)
+			return false;
+		return (entry->words[WORDNUM(off)] &
+				(UINT64CONST(1) << BITNUM(off))) != 0;
+	}
+}
+
+/*
+ * Prepare to iterate through the TidStore, in ascending block order.  The
+ * store must not be modified until TidStoreEndIterate() is called.
+ */
+TidStoreIter *
+TidStoreBeginIterate(TidStore *ts)
+{
+	TidStoreIter *iter = palloc0(sizeof(TidStoreIter));
+
+	iter->ts = ts;
+	if (ts->control->root == TS_INVALID_PTR)
+		iter->level = -1;
+	else
+	{
+		iter->level = 0;
+		iter->stack[0].node = (TsNode *) ts_ptr(ts, ts->control->root);
+		iter->stack[0].idx = 0;
+	}
+
+	return iter;
+}
+
+/*
+ * Return the offsets stored for the next block, or NULL when there are no
+ * more blocks.  The result is valid until the next call.
+ */
+TidStoreIterResult *
+TidStoreIterateNext(TidStoreIter *iter)
+{
+	TidStore   *ts = iter->ts;
+	TidStoreIterResult *result = &iter->result;
+
+	while (iter->level >= 0)
+	{
+		TsIterFrame *frame = &iter->stack[iter->level];
+		int			shift = ts->control->root_shift - TS_SPAN * iter->level;
+		uint8		chunk;
+		TsPtr		child;
+
+		if (!ts_node_next(frame->node, &frame->idx, &chunk, &child))
+		{
+			iter->level--;
+			continue;
+		}
+
+		iter->key &= ~((uint32) TS_CHUNK_MASK << shift);
+		iter->key |= (uint32) chunk << shift;
+
+		if (shift > 0)
+		{
+			iter->level++;
+			iter->stack[iter->level].node = (TsNode *) ts_ptr(ts, child);
+			iter->stack[iter->level].idx = 0;
+			continue;
+		}
+
+		/* reached a leaf value */
+		result->blkno = iter->key;
+		result->num_offsets = 0;
+		if (TsPtrIsEmbedded(child))
+		{
+			for (int i = 0; i < TsEmbeddedCount(child); i++)
+				result->offsets[result->num_offsets++] =
+					TsEmbeddedOffset(child, i);
+		}
+		else
+		{
+			TsBlockEntry *entry = (TsBlockEntry *) ts_ptr(ts, child);
+
+			for (int wordnum = 0; wordnum < entry->nwords; wordnum++)
+			{
+				uint64		w = entry->words[wordnum];
+
+				while (w != 0)
+				{
+					int			bitnum = pg_rightmost_one_pos64(w);
+
+					result->offsets[result->num_offsets++] =
+						wordnum * TS_BITS_PER_WORD + bitnum;
+					w &= w - 1;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	return NULL;
+}
+
+void
+TidStoreEndIterate(TidStoreIter *iter)
+{
+	pfree(iter);
+}
+
+/* Return the number of TIDs stored */
+int64
+TidStoreNumTids(TidStore *ts)
+{
+	return ts->control->num_tids;
+}
+
+/*
+ * Return the amount of memory used by the TidStore.  For a local store, this
+ * includes the allocator's overhead.
+ */
+size_t
+TidStoreMemoryUsage(TidStore *ts)
+{
+	if (TidStoreIsShared(ts))
+		return sizeof(TidStoreControl) + ts->control->mem_used;
+	else
+		return MemoryContextMemAllocated(ts->context, true);
+}
+
+/* Return the memory budget given at creation */
+size_t
+TidStoreMaxMemory(TidStore *ts)
+{
+	return ts->control->max_bytes;
+}
+
+dsa_handle
+TidStoreGetDSAHandle(TidStore *ts)
+{
+	Assert(TidStoreIsShared(ts));
+
+	return dsa_get_handle(ts->area);
+}
+
+dsa_pointer
+TidStoreGetHandle(TidStore *ts)
+{
+	Assert(TidStoreIsShared(ts));
+
+	return ts->control->handle;
+}
@@ -16,12 +16,18 @@
 #ifdef USE_LZ4
 #include <lz4.h>
 #endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
 
 #include "access/detoast.h"
 #include "access/toast_compression.h"
+#include "catalog/pg_compression_dictionary.h"
 #include "common/pg_lzcompress.h"
 #include "fmgr.h"
 #include "utils/builtins.h"
+#include "utils/hsearch.h"
 #include "varatt.h"
 
 /* GUC */
@@ -33,6 +39,12 @@ int			default_toast_compression = TOAST_PGLZ_COMPRESSION;
 			 errmsg("compression method lz4 not supported"), \
 			 errdetail("This functionality requires the server to be built with lz4 support.")))
 
+#define NO_ZSTD_SUPPORT() \
+	ereport(ERROR, \
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), \
+			 errmsg("compression method zstd not supported"), \
+			 errdetail("This functionality requires the server to be built with zstd support.")))
+
 /*
  * Compress a varlena using PGLZ.
  *
@@ -247,6 +259,303 @@ lz4_decompress_datum_slice(const struct varlena *value, int32 slicelength)
 #endif
 }
 
+/*
+ * Backend-local zstd state.  The contexts are reused for every datum, and
+ * digested dictionaries are cached by OID; dictionaries are immutable, so
+ * cache entries never need invalidation.
+ */
+#ifdef USE_ZSTD
+typedef struct ZstdDictCacheEntry
+{
+	Oid			dictid;			/* hash key - must be first */
+	ZSTD_CDict *cdict;			/* for compression, or NULL if not made yet */
+	ZSTD_DDict *ddict;			/* for decompression, or NULL if not made yet */
+} ZstdDictCacheEntry;
+
+static ZSTD_CCtx *zstd_cctx = NULL;
+static ZSTD_DCtx *zstd_dctx = NULL;
+static HTAB *ZstdDictCacheHash = NULL;
+
+/*
+ * Find or create the cache entry for a dictionary, making sure the digested
+ * form needed by the caller exists.
+ */
+static ZstdDictCacheEntry *
+zstd_get_dictionary(Oid dictid, bool for_compression)
+{
+	ZstdDictCacheEntry *entry;
+	bool		found;
+	bytea	   *dict;
+
+	if (ZstdDictCacheHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(ZstdDictCacheEntry);
+		ZstdDictCacheHash = hash_create("zstd dictionary cache", 16, &ctl,
+										HASH_ELEM | HASH_BLOBS);
+	}
+
+	entry = (ZstdDictCacheEntry *) hash_search(ZstdDictCacheHash, &dictid,
+											   HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->cdict = NULL;
+		entry->ddict = NULL;
+	}
+
+	if (for_compression ? entry->cdict != NULL : entry->ddict != NULL)
+		return entry;
+
+	dict = GetCompressionDictionaryData(dictid);
+	if (for_compression)
+		entry->cdict = ZSTD_createCDict(VARDATA_ANY(dict),
+										VARSIZE_ANY_EXHDR(dict),
+										ZSTD_CLEVEL_DEFAULT);
+	else
+		entry->ddict = ZSTD_createDDict(VARDATA_ANY(dict),
+										VARSIZE_ANY_EXHDR(dict));
+	pfree(dict);
+
+	if (for_compression ? entry->cdict == NULL : entry->ddict == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Could not load zstd dictionary %u.", dictid)));
+
+	return entry;
+}
+
+/*
+ * Prepare the backend's decompression context for a datum.
+ */
+static ZSTD_DCtx *
+zstd_begin_decompress(const struct varlena *value)
+{
+	uint32		dictid;
+
+	if (zstd_dctx == NULL)
+	{
+		zstd_dctx = ZSTD_createDCtx();
+		if (zstd_dctx == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+	}
+
+	(void) ZSTD_DCtx_reset(zstd_dctx, ZSTD_reset_session_and_parameters);
+
+	memcpy(&dictid, (const char *) value + VARHDRSZ_COMPRESSED, sizeof(uint32));
+	if (OidIsValid(dictid))
+	{
+		size_t		ret;
+
+		ret = ZSTD_DCtx_refDDict(zstd_dctx,
+								 zstd_get_dictionary(dictid, false)->ddict);
+		if (ZSTD_isError(ret))
+			elog(ERROR, "could not set zstd dictionary: %s",
+				 ZSTD_getErrorName(ret));
+	}
+
+	return zstd_dctx;
+}
+#endif							/* USE_ZSTD */
+
+/*
+ * Compress a varlena using zstd, with the given dictionary if it's valid.
+ *
+ * Returns the compressed varlena, or NULL if compression fails.
+ */
+struct varlena *
+zstd_compress_datum(const struct varlena *value, Oid dictid)
+{
+#ifndef USE_ZSTD
+	NO_ZSTD_SUPPORT();
+	return NULL;				/* keep compiler quiet */
+#else
+	int32		valsize;
+	size_t		max_size;
+	size_t		len;
+	uint32		hdrdictid = dictid;
+	struct varlena *tmp = NULL;
+
+	valsize = VARSIZE_ANY_EXHDR(value);
+
+	if (zstd_cctx == NULL)
+	{
+		zstd_cctx = ZSTD_createCCtx();
+		if (zstd_cctx == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+	}
+
+	(void) ZSTD_CCtx_reset(zstd_cctx, ZSTD_reset_session_and_parameters);
+	if (OidIsValid(dictid))
+		len = ZSTD_CCtx_refCDict(zstd_cctx,
+								 zstd_get_dictionary(dictid, true)->cdict);
+	else
+		len = ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_compressionLevel,
+									 ZSTD_CLEVEL_DEFAULT);
+	if (ZSTD_isError(len))
+		elog(ERROR, "could not set zstd compression parameters: %s",
+			 ZSTD_getErrorName(len));
+
+	/* the raw size is in the toast header; don't repeat it in the frame */
+	(void) ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_contentSizeFlag, 0);
+	(void) ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_dictIDFlag, 0);
+
+	/*
+	 * Figure out the maximum possible size of the zstd output, add the bytes
+	 * that will be needed for varlena overhead and the dictionary OID, and
+	 * allocate that amount.
+	 */
+	max_size = ZSTD_compressBound(valsize);
+	tmp = (struct varlena *) palloc(max_size + ZSTD_COMPRESSED_HDRSZ);
+
+	len = ZSTD_compress2(zstd_cctx,
+						 (char *) tmp + ZSTD_COMPRESSED_HDRSZ, max_size,
+						 VARDATA_ANY(value), valsize);
+	if (ZSTD_isError(len))
+		elog(ERROR, "zstd compression failed: %s", ZSTD_getErrorName(len));
+
+	/* data is incompressible so just free the memory and return NULL */
+	if (len + sizeof(uint32) > valsize)
+	{
+		pfree(tmp);
+		return NULL;
+	}
+
+	memcpy((char *) tmp + VARHDRSZ_COMPRESSED, &hdrdictid, sizeof(uint32));
+	SET_VARSIZE_COMPRESSED(tmp, len + ZSTD_COMPRESSED_HDRSZ);
+
+	return tmp;
+#endif
+}
+
+/*
+ * Decompress a varlena that was compressed using zstd.
+ */
+struct varlena *
+zstd_decompress_datum(const struct varlena *value)
+{
+#ifndef USE_ZSTD
+	NO_ZSTD_SUPPORT();
+	return NULL;				/* keep compiler quiet */
+#else
+	ZSTD_DCtx  *dctx;
+	size_t		rawsize;
+	struct varlena *result;
+
+	dctx = zstd_begin_decompress(value);
+
+	/* allocate memory for the uncompressed data */
+	result = (struct varlena *) palloc(VARDATA_COMPRESSED_GET_EXTSIZE(value) + VARHDRSZ);
+
+	/* decompress the data */
+	rawsize = ZSTD_decompressDCtx(dctx,
+								  VARDATA(result),
+								  VARDATA_COMPRESSED_GET_EXTSIZE(value),
+								  (const char *) value + ZSTD_COMPRESSED_HDRSZ,
+								  VARSIZE(value) - ZSTD_COMPRESSED_HDRSZ);
+	if (ZSTD_isError(rawsize) ||
+		rawsize != VARDATA_COMPRESSED_GET_EXTSIZE(value))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg_internal("compressed zstd data is corrupt")));
+
+	SET_VARSIZE(result, rawsize + VARHDRSZ);
+
+	return result;
+#endif
+}
+
+/*
+ * Decompress part of a varlena that was compressed using zstd.
+ *
+ * This streams the frame into a buffer of just the requested size, so only
+ * as much of the input as needed is decoded.
+ */
+struct varlena *
+zstd_decompress_datum_slice(const struct varlena *value, int32 slicelength)
+{
+#ifndef USE_ZSTD
+	NO_ZSTD_SUPPORT();
+	return NULL;				/* keep compiler quiet */
+#else
+	ZSTD_DCtx  *dctx;
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	struct varlena *result;
+
+	dctx = zstd_begin_decompress(value);
+
+	/* allocate memory for the uncompressed data */
+	result = (struct varlena *) palloc(slicelength + VARHDRSZ);
+
+	in.src = (const char *) value + ZSTD_COMPRESSED_HDRSZ;
+	in.size = VARSIZE(value) - ZSTD_COMPRESSED_HDRSZ;
+	in.pos = 0;
+	out.dst = VARDATA(result);
+	out.size = slicelength;
+	out.pos = 0;
+
+	while (out.pos < out.size && in.pos < in.size)
+	{
+		size_t		ret;
+
+		ret = ZSTD_decompressStream(dctx, &out, &in);
+		if (ZSTD_isError(ret))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("compressed zstd data is corrupt")));
+		if (ret == 0)
+			break;				/* end of frame */
+	}
+
+	SET_VARSIZE(result, out.pos + VARHDRSZ);
+
+	return result;
+#endif
+}
+
+/*
+ * Train a zstd dictionary of at most dictsize bytes from the concatenated
+ * samples.
+ *
+ * Returns the dictionary as a bytea, or NULL if zstd could not make one
+ * from these samples (typically because there are too few of them).
+ */
+bytea *
+zstd_train_dictionary(const char *samples, const size_t *samplesizes,
+					  int nsamples, size_t dictsize)
+{
+#ifndef USE_ZSTD
+	NO_ZSTD_SUPPORT();
+	return NULL;				/* keep compiler quiet */
+#else
+	bytea	   *result;
+	size_t		len;
+
+	result = (bytea *) palloc(dictsize + VARHDRSZ);
+
+	len = ZDICT_trainFromBuffer(VARDATA(result), dictsize,
+								samples, samplesizes, nsamples);
+	if (ZDICT_isError(len))
+	{
+		elog(DEBUG1, "could not train zstd dictionary: %s",
+			 ZDICT_getErrorName(len));
+		pfree(result);
+		return NULL;
+	}
+
+	SET_VARSIZE(result, len + VARHDRSZ);
+
+	return result;
+#endif
+}
+
 /*
  * Extract compression ID from a varlena.
  *
@@ -295,6 +604,13 @@ CompressionNameToMethod(const char *compression)
 #endif
 		return TOAST_LZ4_COMPRESSION;
 	}
+	else if (strcmp(compression, "zstd") == 0)
+	{
+#ifndef USE_ZSTD
+		NO_ZSTD_SUPPORT();
+#endif
+		return TOAST_ZSTD_COMPRESSION;
+	}
 
 	return InvalidCompressionMethod;
 }
@@ -311,6 +627,8 @@ GetCompressionMethodName(char method)
 			return "pglz";
 		case TOAST_LZ4_COMPRESSION:
 			return "lz4";
+		case TOAST_ZSTD_COMPRESSION:
+			return "zstd";
 		default:
 			elog(ERROR, "invalid compression method %c", method);
 			return NULL;		/* keep compiler quiet */
@@ -45,6 +45,20 @@ static bool toastid_valueid_exists(Oid toastrelid, Oid valueid);
  */
 Datum
 toast_compress_datum(Datum value, char cmethod)
+{
+	return toast_compress_datum_ext(value, cmethod, InvalidOid);
+}
+
+/* ----------
+ * toast_compress_datum_ext -
+ *
+ *	Like toast_compress_datum, but zstd compression uses the given
+ *	pg_compression_dictionary entry if dictid is valid.  Other methods
+ *	ignore dictid.
+ * ----------
+ */
+Datum
+toast_compress_datum_ext(Datum value, char cmethod, Oid dictid)
 {
 	struct varlena *tmp = NULL;
 	int32		valsize;
@@ -72,6 +86,10 @@ toast_compress_datum(Datum value, char cmethod)
 			tmp = lz4_compress_datum((const struct varlena *) value);
 			cmid = TOAST_LZ4_COMPRESSION_ID;
 			break;
+		case TOAST_ZSTD_COMPRESSION:
+			tmp = zstd_compress_datum((const struct varlena *) value, dictid);
+			cmid = TOAST_ZSTD_COMPRESSION_ID;
+			break;
 		default:
 			elog(ERROR, "invalid compression method %c", cmethod);
 	}
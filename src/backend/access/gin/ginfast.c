@@ -6,6 +6,9 @@
  *	  (typically during VACUUM), ginInsertCleanup() will be invoked to
  *	  transfer pending entries into the regular index structure.  This
  *	  wins because bulk insertion is much more efficient than retail.
+ *	  When the list outgrows gin_pending_list_limit, inserters hand the
+ *	  cleanup to autovacuum, and only do it themselves if the list keeps
+ *	  growing well past the limit.
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -34,10 +37,24 @@
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
 
 /* GUC parameter */
 int			gin_pending_list_limit = 0;
 
+/*
+ * While autovacuum is running, an inserter that finds the pending list over
+ * gin_pending_list_limit requests a cleanup work item instead of cleaning up
+ * the list itself.  Only when the list grows past this many times the limit,
+ * because the cleanups don't keep up, does the inserter clean it up anyway.
+ */
+#define GIN_PENDING_LIST_HARD_FACTOR	4
+
+/* inserters repeat the request for an index at most this often */
+#define GIN_CLEANUP_REQUEST_INTERVAL_MS	1000
+
+static bool ginRequestBackgroundCleanup(Relation index);
+
 #define GIN_PAGE_FREESIZE \
 	( BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(GinPageOpaqueData)) )
 
@@ -227,7 +244,9 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	ginxlogUpdateMeta data;
 	bool		separateList = false;
 	bool		needCleanup = false;
+	bool		forceCleanup = false;
 	int			cleanupSize;
+	int64		pendingSize;
 	bool		needWal;
 
 	if (collector->ntuples == 0)
@@ -455,8 +474,11 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	 * ginInsertCleanup() should not be called inside our CRIT_SECTION.
 	 */
 	cleanupSize = GinGetPendingListCleanupSize(index);
-	if (metadata->nPendingPages * GIN_PAGE_FREESIZE > cleanupSize * 1024L)
+	pendingSize = (int64) metadata->nPendingPages * GIN_PAGE_FREESIZE;
+	if (pendingSize > cleanupSize * INT64CONST(1024))
 		needCleanup = true;
+	if (pendingSize > GIN_PENDING_LIST_HARD_FACTOR * cleanupSize * INT64CONST(1024))
+		forceCleanup = true;
 
 	UnlockReleaseBuffer(metabuffer);
 
@@ -464,12 +486,49 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 
 	/*
 	 * Since it could contend with concurrent cleanup process we cleanup
-	 * pending list not forcibly.
+	 * pending list not forcibly.  Leave it to autovacuum if we can, sparing
+	 * this insert the latency of the cleanup.
 	 */
-	if (needCleanup)
+	if (needCleanup &&
+		(forceCleanup || !ginRequestBackgroundCleanup(index)))
 		ginInsertCleanup(ginstate, false, true, false, NULL);
 }
 
+/*
+ * Ask autovacuum to clean up the pending list of the index.  Returns false
+ * if that is not possible, in which case the caller should do the cleanup.
+ */
+static bool
+ginRequestBackgroundCleanup(Relation index)
+{
+	static Oid	lastRequestRelid = InvalidOid;
+	static TimestampTz lastRequestTime = 0;
+	TimestampTz now;
+
+	/* autovacuum can't process temporary relations */
+	if (!AutoVacuumingActive() || RelationUsesLocalBuffers(index))
+		return false;
+
+	/*
+	 * Each insert into a list that is over the limit lands here until
+	 * autovacuum gets to the index, so avoid taking AutovacuumLock every
+	 * time.  A request that is still queued is not recorded twice anyway.
+	 */
+	now = GetCurrentTimestamp();
+	if (lastRequestRelid == RelationGetRelid(index) &&
+		!TimestampDifferenceExceeds(lastRequestTime, now,
+									GIN_CLEANUP_REQUEST_INTERVAL_MS))
+		return true;
+
+	if (!AutoVacuumRequestWork(AVW_GINCleanPendingList,
+							   RelationGetRelid(index), InvalidBlockNumber))
+		return false;
+
+	lastRequestRelid = RelationGetRelid(index);
+	lastRequestTime = now;
+	return true;
+}
+
 /*
  * Create temporary index tuples for a single indexable item (one index column
  * for the heap tuple specified by ht_ctid), and append them to the array
@@ -16,16 +16,88 @@
 
 #include "access/gin_private.h"
 #include "access/ginxlog.h"
+#include "access/parallel.h"
+#include "access/table.h"
 #include "access/tableam.h"
+#include "access/xact.h"
 #include "access/xloginsert.h"
 #include "catalog/index.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
 #include "storage/indexfsm.h"
 #include "storage/predicate.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
+#include "utils/datum.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/tuplesort.h"
+
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_GIN_SHARED			UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xB000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xB000000000000005)
+
+/* Most heap TIDs a single GinTuple may carry */
+#define GIN_TUPLE_MAX_ITEMS \
+	((int) ((MaxAllocSize / 2) / sizeof(ItemPointerData)))
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment, like BTShared for btree builds.
+ */
+typedef struct GinBuildShared
+{
+	/* immutable state */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	int			scantuplesortstates;
+
+	/* signalled whenever a participant finishes its part of the scan */
+	ConditionVariable workersdonecv;
+
+	/* mutex protects the fields below */
+	slock_t		mutex;
+
+	int			nparticipantsdone;
+	double		reltuples;
+	double		indtuples;
+	bool		brokenhotchain;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} GinBuildShared;
+
+#define ParallelTableScanFromGinBuildShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(GinBuildShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct GinLeader
+{
+	ParallelContext *pcxt;
+
+	/* worker processes launched, plus the leader itself */
+	int			nparticipanttuplesorts;
+
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} GinLeader;
 
 typedef struct
 {
@@ -35,8 +107,34 @@ typedef struct
 	MemoryContext tmpCtx;
 	MemoryContext funcCtx;
 	BuildAccumulator accum;
+
+	/* memory the accumulator may use before it is dumped, in kB */
+	int			work_mem;
+
+	/*
+	 * ginleader is set in the leader of a parallel build.  sortstate is set
+	 * in each participant of one, and receives the accumulated entries in
+	 * place of the index.
+	 */
+	GinLeader  *ginleader;
+	Tuplesortstate *sortstate;
 } GinBuildState;
 
+static void ginFlushBuildState(GinBuildState *buildstate);
+static GinTuple *_gin_build_tuple(GinState *ginstate, OffsetNumber attrnum,
+								  GinNullCategory category, Datum key,
+								  ItemPointerData *items, uint32 nitems);
+static void _gin_begin_parallel(GinBuildState *buildstate, Relation heap,
+								Relation index, bool isconcurrent,
+								int request);
+static void _gin_end_parallel(GinLeader *ginleader);
+static double _gin_parallel_merge(GinBuildState *buildstate, Relation heap,
+								  Relation index, IndexInfo *indexInfo);
+static void _gin_parallel_scan_and_build(GinBuildShared *ginshared,
+										 Sharedsort *sharedsort,
+										 Relation heap, Relation index,
+										 int sortmem, bool progress);
+
 
 /*
  * Adds array of item pointers to tuple's posting list, or
@@ -291,29 +389,57 @@ ginBuildCallback(Relation index, ItemPointer tid, Datum *values,
 							   values[i], isnull[i], tid);
 
 	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= (Size) maintenance_work_mem * 1024L)
+	if (buildstate->accum.allocatedMemory >= (Size) buildstate->work_mem * 1024L)
+		ginFlushBuildState(buildstate);
+
+	MemoryContextSwitchTo(oldCtx);
+}
+
+/*
+ * Dump the accumulated entries, either into the index or, in a participant
+ * of a parallel build, into its tuplesort.  Must be called in tmpCtx, which
+ * is reset.
+ */
+static void
+ginFlushBuildState(GinBuildState *buildstate)
+{
+	ItemPointerData *list;
+	Datum		key;
+	GinNullCategory category;
+	uint32		nlist;
+	OffsetNumber attnum;
+
+	ginBeginBAScan(&buildstate->accum);
+	while ((list = ginGetBAEntry(&buildstate->accum,
+								 &attnum, &key, &category, &nlist)) != NULL)
 	{
-		ItemPointerData *list;
-		Datum		key;
-		GinNullCategory category;
-		uint32		nlist;
-		OffsetNumber attnum;
-
-		ginBeginBAScan(&buildstate->accum);
-		while ((list = ginGetBAEntry(&buildstate->accum,
-									 &attnum, &key, &category, &nlist)) != NULL)
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		if (buildstate->sortstate == NULL)
 		{
-			/* there could be many entries, so be willing to abort here */
-			CHECK_FOR_INTERRUPTS();
 			ginEntryInsert(&buildstate->ginstate, attnum, key, category,
 						   list, nlist, &buildstate->buildStats);
+			continue;
 		}
 
-		MemoryContextReset(buildstate->tmpCtx);
-		ginInitBA(&buildstate->accum);
+		while (nlist > 0)
+		{
+			uint32		nitems = Min(nlist, GIN_TUPLE_MAX_ITEMS);
+			GinTuple   *tup;
+
+			tup = _gin_build_tuple(&buildstate->ginstate, attnum, category,
+								   key, list, nitems);
+			tuplesort_putgintuple(buildstate->sortstate, tup);
+			pfree(tup);
+
+			list += nitems;
+			nlist -= nitems;
+		}
 	}
 
-	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->tmpCtx);
+	ginInitBA(&buildstate->accum);
 }
 
 IndexBuildResult *
@@ -338,6 +464,9 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	initGinState(&buildstate.ginstate, index);
 	buildstate.indtuples = 0;
 	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.work_mem = maintenance_work_mem;
+	buildstate.ginleader = NULL;
+	buildstate.sortstate = NULL;
 
 	/* initialize the meta page */
 	MetaBuffer = GinNewBuffer(index);
@@ -378,26 +507,43 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	buildstate.accum.ginstate = &buildstate.ginstate;
 	ginInitBA(&buildstate.accum);
 
-	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
-	 */
-	reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
-									   ginBuildCallback, (void *) &buildstate,
-									   NULL);
+	/* Attempt to launch parallel worker scan when required */
+	if (indexInfo->ii_ParallelWorkers > 0)
+		_gin_begin_parallel(&buildstate, heap, index, indexInfo->ii_Concurrent,
+							indexInfo->ii_ParallelWorkers);
 
-	/* dump remaining entries to the index */
-	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
-	ginBeginBAScan(&buildstate.accum);
-	while ((list = ginGetBAEntry(&buildstate.accum,
-								 &attnum, &key, &category, &nlist)) != NULL)
+	if (buildstate.ginleader)
 	{
-		/* there could be many entries, so be willing to abort here */
-		CHECK_FOR_INTERRUPTS();
-		ginEntryInsert(&buildstate.ginstate, attnum, key, category,
-					   list, nlist, &buildstate.buildStats);
+		/*
+		 * The participants have scanned the heap into sorted runs of keys;
+		 * merge them and insert each key's TIDs in one go.
+		 */
+		reltuples = _gin_parallel_merge(&buildstate, heap, index, indexInfo);
+		_gin_end_parallel(buildstate.ginleader);
+	}
+	else
+	{
+		/*
+		 * Do the heap scan.  We disallow sync scan here because
+		 * dataPlaceToPage prefers to receive tuples in TID order.
+		 */
+		reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
+										   ginBuildCallback, (void *) &buildstate,
+										   NULL);
+
+		/* dump remaining entries to the index */
+		oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+		ginBeginBAScan(&buildstate.accum);
+		while ((list = ginGetBAEntry(&buildstate.accum,
+									 &attnum, &key, &category, &nlist)) != NULL)
+		{
+			/* there could be many entries, so be willing to abort here */
+			CHECK_FOR_INTERRUPTS();
+			ginEntryInsert(&buildstate.ginstate, attnum, key, category,
+						   list, nlist, &buildstate.buildStats);
+		}
+		MemoryContextSwitchTo(oldCtx);
 	}
-	MemoryContextSwitchTo(oldCtx);
 
 	MemoryContextDelete(buildstate.funcCtx);
 	MemoryContextDelete(buildstate.tmpCtx);
@@ -537,3 +683,595 @@ gininsert(Relation index, Datum *values, bool *isnull,
 
 	return false;
 }
+
+/*
+ * Routines for parallel index builds
+ *
+ * Each participant scans a share of the heap through the parallel heap scan,
+ * accumulating entries in a BuildAccumulator as a serial build does.  When
+ * the accumulator fills up, its entries are dumped as GinTuples into the
+ * participant's tuplesort rather than into the index.  The leader then reads
+ * the merged output of all the sorts, which brings the runs of TIDs for each
+ * key together, and inserts each key's complete TID list with a single
+ * ginEntryInsert() call.  That replaces the repeated descents and posting
+ * list rewrites of a serial build that has to dump the accumulator more than
+ * once.
+ */
+
+/*
+ * Form a GinTuple holding the given key and heap TIDs, palloc'd in the
+ * current memory context.
+ */
+static GinTuple *
+_gin_build_tuple(GinState *ginstate, OffsetNumber attrnum,
+				 GinNullCategory category, Datum key,
+				 ItemPointerData *items, uint32 nitems)
+{
+	Form_pg_attribute attr = TupleDescAttr(ginstate->origTupdesc, attrnum - 1);
+	Size		keylen = 0;
+	Size		tuplen;
+	GinTuple   *tup;
+
+	if (category == GIN_CAT_NORM_KEY)
+	{
+		if (attr->attbyval)
+			keylen = sizeof(Datum);
+		else
+		{
+			if (attr->attlen == -1)
+				key = PointerGetDatum(PG_DETOAST_DATUM(key));
+			keylen = datumGetSize(key, false, attr->attlen);
+		}
+	}
+
+	tuplen = MAXALIGN(sizeof(GinTuple)) + MAXALIGN(keylen) +
+		nitems * sizeof(ItemPointerData);
+
+	tup = (GinTuple *) palloc(tuplen);
+	tup->tuplen = tuplen;
+	tup->attrnum = attrnum;
+	tup->category = category;
+	tup->keylen = keylen;
+	tup->nitems = nitems;
+
+	if (attr->attbyval)
+		memcpy(GinTupleGetKeyData(tup), &key, keylen);
+	else if (keylen > 0)
+		memcpy(GinTupleGetKeyData(tup), DatumGetPointer(key), keylen);
+
+	memcpy(GinTupleGetItems(tup), items, nitems * sizeof(ItemPointerData));
+
+	return tup;
+}
+
+/*
+ * Return the key of a GinTuple.  A pass-by-reference key points into the
+ * tuple.
+ */
+Datum
+_gin_tuple_get_key(GinState *ginstate, GinTuple *tup)
+{
+	Form_pg_attribute attr;
+	Datum		key;
+
+	if (tup->category != GIN_CAT_NORM_KEY)
+		return (Datum) 0;
+
+	attr = TupleDescAttr(ginstate->origTupdesc, tup->attrnum - 1);
+	if (!attr->attbyval)
+		return PointerGetDatum(GinTupleGetKeyData(tup));
+
+	memcpy(&key, GinTupleGetKeyData(tup), sizeof(Datum));
+	return key;
+}
+
+/*
+ * Compare two GinTuples by index column, key and first heap TID, for
+ * tuplesort.
+ */
+int
+_gin_compare_tuples(GinTuple *a, GinTuple *b, GinState *ginstate)
+{
+	int			res;
+
+	res = ginCompareAttEntries(ginstate,
+							   a->attrnum, _gin_tuple_get_key(ginstate, a),
+							   a->category,
+							   b->attrnum, _gin_tuple_get_key(ginstate, b),
+							   b->category);
+	if (res != 0)
+		return res;
+
+	return ItemPointerCompare(GinTupleGetItems(a), GinTupleGetItems(b));
+}
+
+/*
+ * Create parallel context, and launch workers for leader.
+ *
+ * Like _bt_begin_parallel(), sets buildstate's GinLeader only if at least one
+ * worker process could be launched; otherwise caller does a serial build.
+ */
+static void
+_gin_begin_parallel(GinBuildState *buildstate, Relation heap, Relation index,
+					bool isconcurrent, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		estginshared;
+	Size		estsort;
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	GinLeader  *ginleader = (GinLeader *) palloc0(sizeof(GinLeader));
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			querylen;
+	int			sortmem;
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of gin
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_gin_parallel_build_main",
+								 request);
+
+	/* the leader participates as a worker, too */
+	scantuplesortstates = request + 1;
+
+	/*
+	 * Prepare for scan of the base relation.  As in btree builds, a normal
+	 * build uses SnapshotAny, and a concurrent one a regular MVCC snapshot.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_GIN_SHARED workspace, and
+	 * PARALLEL_KEY_TUPLESORT tuplesort workspace
+	 */
+	estginshared = add_size(BUFFERALIGN(sizeof(GinBuildShared)),
+							table_parallelscan_estimate(heap, snapshot));
+	shm_toc_estimate_chunk(&pcxt->estimator, estginshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/* Estimate space for WalUsage and BufferUsage */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	ginshared = (GinBuildShared *) shm_toc_allocate(pcxt->toc, estginshared);
+	ginshared->heaprelid = RelationGetRelid(heap);
+	ginshared->indexrelid = RelationGetRelid(index);
+	ginshared->isconcurrent = isconcurrent;
+	ginshared->scantuplesortstates = scantuplesortstates;
+	ConditionVariableInit(&ginshared->workersdonecv);
+	SpinLockInit(&ginshared->mutex);
+	ginshared->nparticipantsdone = 0;
+	ginshared->reltuples = 0.0;
+	ginshared->indtuples = 0.0;
+	ginshared->brokenhotchain = false;
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromGinBuildShared(ginshared),
+								  snapshot);
+
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_GIN_SHARED, ginshared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	ginleader->pcxt = pcxt;
+	ginleader->nparticipanttuplesorts = pcxt->nworkers_launched + 1;
+	ginleader->ginshared = ginshared;
+	ginleader->sharedsort = sharedsort;
+	ginleader->snapshot = snapshot;
+	ginleader->walusage = walusage;
+	ginleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_gin_end_parallel(ginleader);
+		return;
+	}
+
+	/* Save leader state now that it's clear build will be parallel */
+	buildstate->ginleader = ginleader;
+
+	/*
+	 * Join heap scan ourselves.  Might as well use reliable figure when
+	 * doling out maintenance_work_mem.
+	 */
+	sortmem = maintenance_work_mem / ginleader->nparticipanttuplesorts;
+	_gin_parallel_scan_and_build(ginshared, sharedsort, heap, index,
+								 sortmem, true);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_gin_end_parallel(GinLeader *ginleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(ginleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < ginleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&ginleader->bufferusage[i], &ginleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(ginleader->snapshot))
+		UnregisterSnapshot(ginleader->snapshot);
+	DestroyParallelContext(ginleader->pcxt);
+	ExitParallelMode();
+}
+
+static int
+qsortCompareItemPointers(const void *a, const void *b)
+{
+	return ItemPointerCompare((ItemPointer) a, (ItemPointer) b);
+}
+
+/*
+ * Within leader, wait for the participants to finish their scans, then read
+ * the merged output of their sorts and insert the entries into the index.
+ *
+ * Consecutive GinTuples with the same key are collected into one TID list,
+ * which is inserted once the key changes.  Their TIDs come from separate
+ * participants and dumps, so the list is sorted when they interleave.  To
+ * stay within maintenance_work_mem, a key with a very long list is inserted
+ * in several pieces, which ginEntryInsert() merges.
+ *
+ * Returns the total number of heap tuples scanned.
+ */
+static double
+_gin_parallel_merge(GinBuildState *buildstate, Relation heap, Relation index,
+					IndexInfo *indexInfo)
+{
+	GinLeader  *ginleader = buildstate->ginleader;
+	GinBuildShared *ginshared = ginleader->ginshared;
+	GinState   *ginstate = &buildstate->ginstate;
+	SortCoordinate coordinate;
+	Tuplesortstate *sortstate;
+	MemoryContext keyCtx;
+	MemoryContext oldCtx;
+	GinTuple   *tup;
+	OffsetNumber attnum = InvalidOffsetNumber;
+	GinNullCategory category = GIN_CAT_NORM_KEY;
+	Datum		key = (Datum) 0;
+	ItemPointerData *items;
+	uint32		nitems = 0;
+	uint32		maxitems;
+	uint32		limit;
+	bool		sorted = true;
+	double		reltuples = 0;
+
+	for (;;)
+	{
+		SpinLockAcquire(&ginshared->mutex);
+		if (ginshared->nparticipantsdone == ginleader->nparticipanttuplesorts)
+		{
+			buildstate->indtuples = ginshared->indtuples;
+			reltuples = ginshared->reltuples;
+			if (ginshared->brokenhotchain)
+				indexInfo->ii_BrokenHotChain = true;
+			SpinLockRelease(&ginshared->mutex);
+			break;
+		}
+		SpinLockRelease(&ginshared->mutex);
+
+		ConditionVariableSleep(&ginshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+	ConditionVariableCancelSleep();
+
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = false;
+	coordinate->nParticipants = ginleader->nparticipanttuplesorts;
+	coordinate->sharedsort = ginleader->sharedsort;
+
+	sortstate = tuplesort_begin_index_gin(heap, index, maintenance_work_mem,
+										  coordinate, TUPLESORT_NONE);
+	tuplesort_performsort(sortstate);
+
+	keyCtx = AllocSetContextCreate(CurrentMemoryContext,
+								   "Gin build merge key",
+								   ALLOCSET_SMALL_SIZES);
+
+	/* the TID list may use up to a quarter of maintenance_work_mem */
+	limit = (uint32) Min(Max((Size) maintenance_work_mem * 1024L / 4 /
+							 sizeof(ItemPointerData), 1024),
+						 (Size) PG_INT32_MAX / 2);
+	maxitems = 1024;
+	items = (ItemPointerData *) palloc(maxitems * sizeof(ItemPointerData));
+
+	for (;;)
+	{
+		Datum		tupkey = (Datum) 0;
+
+		tup = tuplesort_getgintuple(sortstate, true);
+		if (tup != NULL)
+			tupkey = _gin_tuple_get_key(ginstate, tup);
+
+		/* insert the collected TIDs at a new key, a full list, or the end */
+		if (nitems > 0 &&
+			(tup == NULL ||
+			 nitems + tup->nitems > limit ||
+			 ginCompareAttEntries(ginstate, attnum, key, category,
+								  tup->attrnum, tupkey, tup->category) != 0))
+		{
+			if (!sorted)
+				qsort(items, nitems, sizeof(ItemPointerData),
+					  qsortCompareItemPointers);
+
+			/* there could be many entries, so be willing to abort here */
+			CHECK_FOR_INTERRUPTS();
+
+			oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+			ginEntryInsert(ginstate, attnum, key, category,
+						   items, nitems, &buildstate->buildStats);
+			MemoryContextSwitchTo(oldCtx);
+			MemoryContextReset(buildstate->tmpCtx);
+
+			nitems = 0;
+			sorted = true;
+		}
+
+		if (tup == NULL)
+			break;
+
+		if (nitems == 0)
+		{
+			Form_pg_attribute attr;
+
+			/* remember the key, which tuplesort may overwrite */
+			MemoryContextReset(keyCtx);
+			attnum = tup->attrnum;
+			category = tup->category;
+			key = (Datum) 0;
+			if (category == GIN_CAT_NORM_KEY)
+			{
+				attr = TupleDescAttr(ginstate->origTupdesc, attnum - 1);
+				oldCtx = MemoryContextSwitchTo(keyCtx);
+				key = datumCopy(tupkey, attr->attbyval, attr->attlen);
+				MemoryContextSwitchTo(oldCtx);
+			}
+		}
+		else if (ItemPointerCompare(&items[nitems - 1],
+									GinTupleGetItems(tup)) > 0)
+			sorted = false;
+
+		if (nitems + tup->nitems > maxitems)
+		{
+			while (nitems + tup->nitems > maxitems)
+				maxitems *= 2;
+			items = (ItemPointerData *)
+				repalloc_huge(items, (Size) maxitems * sizeof(ItemPointerData));
+		}
+		memcpy(items + nitems, GinTupleGetItems(tup),
+			   tup->nitems * sizeof(ItemPointerData));
+		nitems += tup->nitems;
+	}
+
+	pfree(items);
+	MemoryContextDelete(keyCtx);
+	tuplesort_end(sortstate);
+
+	return reltuples;
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_gin_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	GinBuildShared *ginshared;
+	Sharedsort *sharedsort;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			sortmem;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up gin shared state */
+	ginshared = shm_toc_lookup(toc, PARALLEL_KEY_GIN_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!ginshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(ginshared->heaprelid, heapLockmode);
+	indexRel = index_open(ginshared->indexrelid, indexLockmode);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	sortmem = maintenance_work_mem / ginshared->scantuplesortstates;
+	_gin_parallel_scan_and_build(ginshared, sharedsort, heapRel, indexRel,
+								 sortmem, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Perform a participant's portion of a parallel build: scan its share of the
+ * heap and sort the accumulated entries.
+ *
+ * sortmem is the amount of working memory to use within each participant,
+ * expressed in KBs.  Half of it goes to the accumulator and half to the
+ * tuplesort.
+ */
+static void
+_gin_parallel_scan_and_build(GinBuildShared *ginshared, Sharedsort *sharedsort,
+							 Relation heap, Relation index,
+							 int sortmem, bool progress)
+{
+	SortCoordinate coordinate;
+	GinBuildState buildstate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+	MemoryContext oldCtx;
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	initGinState(&buildstate.ginstate, index);
+	buildstate.indtuples = 0;
+	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.work_mem = Max(sortmem / 2, 64);
+	buildstate.ginleader = NULL;
+	buildstate.sortstate = tuplesort_begin_index_gin(heap, index,
+													 Max(sortmem / 2, 64),
+													 coordinate,
+													 TUPLESORT_NONE);
+
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "Gin build temporary context",
+											  ALLOCSET_DEFAULT_SIZES);
+	buildstate.funcCtx = AllocSetContextCreate(CurrentMemoryContext,
+											   "Gin build temporary context for user-defined function",
+											   ALLOCSET_DEFAULT_SIZES);
+	buildstate.accum.ginstate = &buildstate.ginstate;
+	ginInitBA(&buildstate.accum);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = ginshared->isconcurrent;
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromGinBuildShared(ginshared));
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   ginBuildCallback, (void *) &buildstate,
+									   scan);
+
+	/* dump remaining entries to the sort, and execute this worker's part */
+	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+	ginFlushBuildState(&buildstate);
+	MemoryContextSwitchTo(oldCtx);
+
+	tuplesort_performsort(buildstate.sortstate);
+
+	/* Done.  Record ambuild statistics. */
+	SpinLockAcquire(&ginshared->mutex);
+	ginshared->nparticipantsdone++;
+	ginshared->reltuples += reltuples;
+	ginshared->indtuples += buildstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		ginshared->brokenhotchain = true;
+	SpinLockRelease(&ginshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&ginshared->workersdonecv);
+
+	/* Help the leader with the final merge, see _bt_parallel_scan_and_sort */
+	if (IsParallelWorker())
+		tuplesort_merge_ranges(buildstate.sortstate);
+
+	tuplesort_end(buildstate.sortstate);
+
+	MemoryContextDelete(buildstate.funcCtx);
+	MemoryContextDelete(buildstate.tmpCtx);
+}
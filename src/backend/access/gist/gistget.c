@@ -738,6 +738,44 @@ gistgettuple(IndexScanDesc scan, ScanDirection dir)
 	}
 }
 
+/*
+ * gistgetbatch() -- Get the next batch of tuples in the scan
+ *
+ * Returns the rest of the matches collected from the current leaf page, up
+ * to maxtids of them.  Scans with ordering operators must return their
+ * tuples in distance order, so for those we return one tuple at a time.
+ */
+int
+gistgetbatch(IndexScanDesc scan, ScanDirection dir, ItemPointer tids,
+			 bool *recheck, int maxtids)
+{
+	GISTScanOpaque so = (GISTScanOpaque) scan->opaque;
+	int			ntids = 0;
+
+	Assert(!scan->kill_prior_tuple);
+
+	if (!gistgettuple(scan, dir))
+		return 0;
+
+	tids[ntids] = scan->xs_heaptid;
+	recheck[ntids++] = scan->xs_recheck;
+
+	if (scan->numberOfOrderBys > 0)
+		return ntids;
+
+	while (ntids < maxtids && so->curPageData < so->nPageData)
+	{
+		tids[ntids] = so->pageData[so->curPageData].heapPtr;
+		recheck[ntids++] = so->pageData[so->curPageData].recheck;
+		so->curPageData++;
+	}
+
+	scan->xs_heaptid = tids[ntids - 1];
+	scan->xs_recheck = recheck[ntids - 1];
+
+	return ntids;
+}
+
 /*
  * gistgetbitmap() -- Get a bitmap of all heap tuple locations
  */
@@ -37,6 +37,9 @@ static uint64 part_bits32_by2(uint32 x);
 static uint32 ieee_float32_to_uint32(float f);
 static int	gist_bbox_zorder_cmp(Datum a, Datum b, SortSupport ssup);
 static Datum gist_bbox_zorder_abbrev_convert(Datum original, SortSupport ssup);
+static uint64 box_center_zorder(const BOX *box);
+static int	gist_box_zorder_cmp(Datum a, Datum b, SortSupport ssup);
+static Datum gist_box_zorder_abbrev_convert(Datum original, SortSupport ssup);
 static bool gist_bbox_zorder_abbrev_abort(int memtupcount, SortSupport ssup);
 
 
@@ -1759,3 +1762,74 @@ gist_point_sortsupport(PG_FUNCTION_ARGS)
 	}
 	PG_RETURN_VOID();
 }
+
+/*
+ * Compute Z-value of the center of a box
+ *
+ * Boxes, and the bounding boxes that polygons and circles are indexed by, are
+ * sorted by their centers.  That is only an approximation of their position,
+ * but good enough for the sorted build: it only needs to put boxes that are
+ * near each other close together, and picksplit cleans up the rest.
+ */
+static uint64
+box_center_zorder(const BOX *box)
+{
+	return point_zorder_internal((float4) ((box->low.x + box->high.x) / 2.0),
+								 (float4) ((box->low.y + box->high.y) / 2.0));
+}
+
+/*
+ * Compare the Z-order of box centers
+ */
+static int
+gist_box_zorder_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	uint64		z1 = box_center_zorder(DatumGetBoxP(a));
+	uint64		z2 = box_center_zorder(DatumGetBoxP(b));
+
+	if (z1 > z2)
+		return 1;
+	else if (z1 < z2)
+		return -1;
+	else
+		return 0;
+}
+
+/*
+ * Abbreviated version of box Z-order comparison, see
+ * gist_bbox_zorder_abbrev_convert()
+ */
+static Datum
+gist_box_zorder_abbrev_convert(Datum original, SortSupport ssup)
+{
+	uint64		z = box_center_zorder(DatumGetBoxP(original));
+
+#if SIZEOF_DATUM == 8
+	return (Datum) z;
+#else
+	return (Datum) (z >> 32);
+#endif
+}
+
+/*
+ * Sort support routine for fast GiST index build by sorting, for opclasses
+ * whose keys are boxes.
+ */
+Datum
+gist_box_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	if (ssup->abbreviate)
+	{
+		ssup->comparator = ssup_datum_unsigned_cmp;
+		ssup->abbrev_converter = gist_box_zorder_abbrev_convert;
+		ssup->abbrev_abort = gist_bbox_zorder_abbrev_abort;
+		ssup->abbrev_full_comparator = gist_box_zorder_cmp;
+	}
+	else
+	{
+		ssup->comparator = gist_box_zorder_cmp;
+	}
+	PG_RETURN_VOID();
+}
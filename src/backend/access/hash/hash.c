@@ -36,7 +36,7 @@
 /* Working state for hashbuild and its callback */
 typedef struct
 {
-	HSpool	   *spool;			/* NULL if not using spooling */
+	HSpool	   *spool;			/* spool of tuples to sort */
 	double		indtuples;		/* # tuples accepted into index */
 	Relation	heapRel;		/* heap relation descriptor */
 } HashBuildState;
@@ -95,6 +95,7 @@ hashhandler(PG_FUNCTION_ARGS)
 	amroutine->ambeginscan = hashbeginscan;
 	amroutine->amrescan = hashrescan;
 	amroutine->amgettuple = hashgettuple;
+	amroutine->amgetbatch = hashgetbatch;
 	amroutine->amgetbitmap = hashgetbitmap;
 	amroutine->amendscan = hashendscan;
 	amroutine->ammarkpos = NULL;
@@ -117,7 +118,6 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	double		reltuples;
 	double		allvisfrac;
 	uint32		num_buckets;
-	long		sort_threshold;
 	HashBuildState buildstate;
 
 	/*
@@ -135,51 +135,41 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	num_buckets = _hash_init(index, reltuples, MAIN_FORKNUM);
 
 	/*
-	 * If we just insert the tuples into the index in scan order, then
-	 * (assuming their hash codes are pretty random) there will be no locality
-	 * of access to the index, and if the index is bigger than available RAM
-	 * then we'll thrash horribly.  To prevent that scenario, we can sort the
-	 * tuples by (expected) bucket number.  However, such a sort is useless
-	 * overhead when the index does fit in RAM.  We choose to sort if the
-	 * initial index size exceeds maintenance_work_mem, or the number of
-	 * buffers usable for the index, whichever is less.  (Limiting by the
-	 * number of buffers should reduce thrashing between PG buffers and kernel
-	 * buffers, which seems useful even if no physical I/O results.  Limiting
-	 * by maintenance_work_mem is useful to allow easy testing of the sort
-	 * code path, and may be useful to DBAs as an additional control knob.)
+	 * If we just inserted the tuples into the index in scan order, then
+	 * (assuming their hash codes are pretty random) there would be no
+	 * locality of access to the index, and if the index is bigger than
+	 * available RAM we'd thrash horribly.  So we always sort the tuples by
+	 * (expected) bucket number, and load each bucket's pages in turn, see
+	 * hashsort.c.  Even when the index fits in RAM that beats inserting the
+	 * tuples one at a time, as the load doesn't need to WAL-log each tuple.
 	 *
-	 * NOTE: this test will need adjustment if a bucket is ever different from
-	 * one page.  Also, "initial index size" accounting does not include the
-	 * metapage, nor the first bitmap page.
+	 * If parallel workers were requested, they scan the heap and sort their
+	 * share of the tuples; otherwise we do it all ourselves.
 	 */
-	sort_threshold = (maintenance_work_mem * 1024L) / BLCKSZ;
-	if (index->rd_rel->relpersistence != RELPERSISTENCE_TEMP)
-		sort_threshold = Min(sort_threshold, NBuffers);
-	else
-		sort_threshold = Min(sort_threshold, NLocBuffer);
-
-	if (num_buckets >= (uint32) sort_threshold)
-		buildstate.spool = _h_spoolinit(heap, index, num_buckets);
-	else
-		buildstate.spool = NULL;
-
-	/* prepare to build the index */
+	buildstate.spool = NULL;
 	buildstate.indtuples = 0;
 	buildstate.heapRel = heap;
 
-	/* do the heap scan */
-	reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
-									   hashbuildCallback,
-									   (void *) &buildstate, NULL);
-	pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_TOTAL,
-								 buildstate.indtuples);
+	if (indexInfo->ii_ParallelWorkers > 0)
+		buildstate.spool = _h_parallel_spoolinit(heap, index, indexInfo,
+												 num_buckets, &reltuples,
+												 &buildstate.indtuples);
 
-	if (buildstate.spool)
+	if (buildstate.spool == NULL)
 	{
-		/* sort the tuples and insert them into the index */
-		_h_indexbuild(buildstate.spool, buildstate.heapRel);
-		_h_spooldestroy(buildstate.spool);
+		buildstate.spool = _h_spoolinit(heap, index, num_buckets);
+
+		/* do the heap scan */
+		reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
+										   hashbuildCallback,
+										   (void *) &buildstate, NULL);
 	}
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_TOTAL,
+								 buildstate.indtuples);
+
+	/* sort the tuples and insert them into the index */
+	_h_indexbuild(buildstate.spool, buildstate.heapRel);
+	_h_spooldestroy(buildstate.spool);
 
 	/*
 	 * Return statistics
@@ -215,7 +205,6 @@ hashbuildCallback(Relation index,
 	HashBuildState *buildstate = (HashBuildState *) state;
 	Datum		index_values[1];
 	bool		index_isnull[1];
-	IndexTuple	itup;
 
 	/* convert data to a hash key; on failure, do not insert anything */
 	if (!_hash_convert_tuple(index,
@@ -223,18 +212,8 @@ hashbuildCallback(Relation index,
 							 index_values, index_isnull))
 		return;
 
-	/* Either spool the tuple for sorting, or just put it into the index */
-	if (buildstate->spool)
-		_h_spool(buildstate->spool, tid, index_values, index_isnull);
-	else
-	{
-		/* form an index tuple and point it at the heap tuple */
-		itup = index_form_tuple(RelationGetDescr(index),
-								index_values, index_isnull);
-		itup->t_tid = *tid;
-		_hash_doinsert(index, itup, buildstate->heapRel, false);
-		pfree(itup);
-	}
+	/* spool the tuple for sorting */
+	_h_spool(buildstate->spool, tid, index_values, index_isnull);
 
 	buildstate->indtuples += 1;
 }
@@ -325,6 +304,53 @@ hashgettuple(IndexScanDesc scan, ScanDirection dir)
 	return res;
 }
 
+/*
+ *	hashgetbatch() -- Get the next batch of tuples in the scan.
+ *
+ * Like btgetbatch, returns the rest of the items saved from the current
+ * bucket page, up to maxtids of them.  They all need rechecking.
+ */
+int
+hashgetbatch(IndexScanDesc scan, ScanDirection dir, ItemPointer tids,
+			 bool *recheck, int maxtids)
+{
+	HashScanOpaque so = (HashScanOpaque) scan->opaque;
+	int			ntids = 0;
+
+	Assert(!scan->kill_prior_tuple);
+
+	if (!hashgettuple(scan, dir))
+		return 0;
+
+	tids[ntids] = scan->xs_heaptid;
+	recheck[ntids++] = true;
+
+	if (ScanDirectionIsForward(dir))
+	{
+		while (ntids < maxtids &&
+			   so->currPos.itemIndex < so->currPos.lastItem)
+		{
+			so->currPos.itemIndex++;
+			tids[ntids] = so->currPos.items[so->currPos.itemIndex].heapTid;
+			recheck[ntids++] = true;
+		}
+	}
+	else
+	{
+		while (ntids < maxtids &&
+			   so->currPos.itemIndex > so->currPos.firstItem)
+		{
+			so->currPos.itemIndex--;
+			tids[ntids] = so->currPos.items[so->currPos.itemIndex].heapTid;
+			recheck[ntids++] = true;
+		}
+	}
+
+	scan->xs_heaptid = tids[ntids - 1];
+
+	return ntids;
+}
+
 
 /*
  *	hashgetbitmap() -- get all tuples at once
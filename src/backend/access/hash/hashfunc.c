@@ -31,6 +31,7 @@
 #include "common/hashfn.h"
 #include "utils/builtins.h"
 #include "utils/float.h"
+#include "utils/fmgroids.h"
 #include "utils/pg_locale.h"
 #include "varatt.h"
 
@@ -406,3 +407,96 @@ hashvarlenaextended(PG_FUNCTION_ARGS)
 
 	return result;
 }
+
+/*
+ * Direct versions of the most common hash support functions, computing the
+ * same hash values.  The executor hashes every input row of a hash join or
+ * hash aggregate, and calling these saves setting up an fmgr call for each
+ * key of every row.
+ */
+static uint32
+hash_direct_int2(Datum value)
+{
+	return hash_bytes_uint32((int32) DatumGetInt16(value));
+}
+
+static uint32
+hash_direct_int4(Datum value)
+{
+	return hash_bytes_uint32(DatumGetInt32(value));
+}
+
+static uint32
+hash_direct_int8(Datum value)
+{
+	/* same as hashint8 */
+	int64		val = DatumGetInt64(value);
+	uint32		lohalf = (uint32) val;
+	uint32		hihalf = (uint32) (val >> 32);
+
+	lohalf ^= (val >= 0) ? hihalf : ~hihalf;
+
+	return hash_bytes_uint32(lohalf);
+}
+
+static uint32
+hash_direct_oid(Datum value)
+{
+	return hash_bytes_uint32((uint32) DatumGetObjectId(value));
+}
+
+static uint32
+hash_direct_char(Datum value)
+{
+	return hash_bytes_uint32((int32) DatumGetChar(value));
+}
+
+/* hashtext with a deterministic collation */
+static uint32
+hash_direct_text(Datum value)
+{
+	text	   *key = DatumGetTextPP(value);
+	uint32		result;
+
+	result = hash_bytes((unsigned char *) VARDATA_ANY(key),
+						VARSIZE_ANY_EXHDR(key));
+
+	if ((Pointer) key != DatumGetPointer(value))
+		pfree(key);
+
+	return result;
+}
+
+/*
+ * Return a function that computes the same hash value as the hash support
+ * function hashfn with the given collation, without going through fmgr, or
+ * NULL if there is none and hashfn must be called the usual way.
+ */
+DatumHashFunction
+hash_direct_function(Oid hashfn, Oid collation)
+{
+	switch (hashfn)
+	{
+		case F_HASHINT2:
+			return hash_direct_int2;
+		case F_HASHINT4:
+			return hash_direct_int4;
+		case F_HASHINT8:
+			return hash_direct_int8;
+		case F_HASHOID:
+		case F_HASHENUM:
+			return hash_direct_oid;
+		case F_HASHCHAR:
+			return hash_direct_char;
+		case F_HASHTEXT:
+			/* hashtext itself reports a missing collation */
+			if (!OidIsValid(collation))
+				return NULL;
+			if (lc_collate_is_c(collation) ||
+				pg_locale_deterministic(pg_newlocale_from_collation(collation)))
+				return hash_direct_text;
+			return NULL;
+		default:
+			return NULL;
+	}
+}
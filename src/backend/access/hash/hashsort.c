@@ -3,15 +3,17 @@
  * hashsort.c
  *		Sort tuples for insertion into a new hash index.
  *
- * When building a very large hash index, we pre-sort the tuples by bucket
- * number to improve locality of access to the index, and thereby avoid
- * thrashing.  We use tuplesort.c to sort the given index tuples into order.
+ * When building a hash index, we pre-sort the tuples by bucket number, and
+ * then by hash value.  We use tuplesort.c to sort the given index tuples into
+ * order, possibly with the help of parallel workers.  The sorted tuples are
+ * then appended to each bucket's pages in turn, chaining overflow pages as
+ * the pages fill up, without going through _hash_doinsert().  Like the other
+ * index AMs, we write no WAL for that and log the finished pages instead.
  *
- * Note: if the number of rows in the table has been underestimated,
- * bucket splits may occur during the index build.  In that case we'd
- * be inserting into two or more buckets for each possible masked-off
- * hash code value.  That's no big problem though, since we'll still have
- * plenty of locality of access.
+ * Note: if the number of rows in the table has been underestimated, the
+ * buckets get longer overflow chains than they should.  We perform the
+ * bucket splits that a one-by-one build would have done once all tuples are
+ * loaded.
  *
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
@@ -26,12 +28,89 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/parallel.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/xact.h"
+#include "access/xloginsert.h"
+#include "catalog/index.h"
 #include "commands/progress.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/pg_bitutils.h"
+#include "storage/condition_variable.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
 #include "utils/tuplesort.h"
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_HASH_SHARED		UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_TUPLESORT			UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000003)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xB000000000000004)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xB000000000000005)
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment, like BTShared for btree builds.
+ */
+typedef struct HashShared
+{
+	/* immutable state */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	uint32		num_buckets;
+	int			scantuplesortstates;
+
+	/* signalled whenever a participant finishes its part of the scan */
+	ConditionVariable workersdonecv;
+
+	/* mutex protects the fields below */
+	slock_t		mutex;
+
+	int			nparticipantsdone;
+	double		reltuples;
+	double		indtuples;
+	bool		brokenhotchain;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} HashShared;
+
+#define ParallelTableScanFromHashShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(HashShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct HashLeader
+{
+	ParallelContext *pcxt;
+
+	/* worker processes launched, plus the leader itself */
+	int			nparticipanttuplesorts;
+
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} HashLeader;
+
+/* Working state of a participant's heap scan */
+typedef struct HashSpoolState
+{
+	HSpool	   *spool;
+	double		indtuples;
+} HashSpoolState;
+
 
 /*
  * Status record for spooling/sorting phase.
@@ -50,14 +129,42 @@ struct HSpool
 	uint32		high_mask;
 	uint32		low_mask;
 	uint32		max_buckets;
+
+	/* set in the leader of a parallel build, whose sort merges the others */
+	HashLeader *hashleader;
 };
 
+static HSpool *_h_spoolinit_internal(Relation heap, Relation index,
+									 uint32 num_buckets, int workMem,
+									 SortCoordinate coordinate);
+static void _h_end_parallel(HashLeader *hashleader);
+static void _h_parallel_callback(Relation index, ItemPointer tid,
+								 Datum *values, bool *isnull,
+								 bool tupleIsAlive, void *state);
+static void _h_parallel_scan_and_sort(HashShared *hashshared,
+									  Sharedsort *sharedsort,
+									  Relation heap, Relation index,
+									  int sortmem, bool progress);
+
 
 /*
  * create and initialize a spool structure
  */
 HSpool *
 _h_spoolinit(Relation heap, Relation index, uint32 num_buckets)
+{
+	/*
+	 * We size the sort area as maintenance_work_mem rather than work_mem to
+	 * speed index creation.  This should be OK since a single backend can't
+	 * run multiple index creations in parallel.
+	 */
+	return _h_spoolinit_internal(heap, index, num_buckets,
+								 maintenance_work_mem, NULL);
+}
+
+static HSpool *
+_h_spoolinit_internal(Relation heap, Relation index, uint32 num_buckets,
+					  int workMem, SortCoordinate coordinate)
 {
 	HSpool	   *hspool = (HSpool *) palloc0(sizeof(HSpool));
 
@@ -75,18 +182,13 @@ _h_spoolinit(Relation heap, Relation index, uint32 num_buckets)
 	hspool->low_mask = (hspool->high_mask >> 1);
 	hspool->max_buckets = num_buckets - 1;
 
-	/*
-	 * We size the sort area as maintenance_work_mem rather than work_mem to
-	 * speed index creation.  This should be OK since a single backend can't
-	 * run multiple index creations in parallel.
-	 */
 	hspool->sortstate = tuplesort_begin_index_hash(heap,
 												   index,
 												   hspool->high_mask,
 												   hspool->low_mask,
 												   hspool->max_buckets,
-												   maintenance_work_mem,
-												   NULL,
+												   workMem,
+												   coordinate,
 												   TUPLESORT_NONE);
 
 	return hspool;
@@ -99,6 +201,8 @@ void
 _h_spooldestroy(HSpool *hspool)
 {
 	tuplesort_end(hspool->sortstate);
+	if (hspool->hashleader)
+		_h_end_parallel(hspool->hashleader);
 	pfree(hspool);
 }
 
@@ -112,43 +216,497 @@ _h_spool(HSpool *hspool, ItemPointer self, Datum *values, bool *isnull)
 								  self, values, isnull);
 }
 
+
 /*
  * given a spool loaded by successive calls to _h_spool,
  * create an entire index.
+ *
+ * The tuples come out of the sort bucket by bucket, in hash order within
+ * each bucket, so we can append them to the bucket's last page, and add a
+ * new overflow page when that is full, without searching the chain.  The
+ * index is not visible to anyone else yet, so we keep the current page
+ * locked until we move to the next one, and update the tuple count in the
+ * metapage just once at the end.
  */
 void
 _h_indexbuild(HSpool *hspool, Relation heapRel)
 {
+	Relation	rel = hspool->index;
 	IndexTuple	itup;
 	int64		tups_done = 0;
-#ifdef USE_ASSERT_CHECKING
-	uint32		hashkey = 0;
-#endif
+	Buffer		metabuf;
+	Page		metapage;
+	HashMetaPage metap;
+	Buffer		bucket_buf = InvalidBuffer;
+	Buffer		buf = InvalidBuffer;
+	Bucket		curbucket = InvalidBucket;
+	uint32		lastmaxbucket;
 
 	tuplesort_performsort(hspool->sortstate);
 
+	metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_NOLOCK, LH_META_PAGE);
+	metapage = BufferGetPage(metabuf);
+	metap = HashPageGetMeta(metapage);
+
 	while ((itup = tuplesort_getindextuple(hspool->sortstate, true)) != NULL)
 	{
-		/*
-		 * Technically, it isn't critical that hash keys be found in sorted
-		 * order, since this sorting is only used to increase locality of
-		 * access as a performance optimization.  It still seems like a good
-		 * idea to test tuplesort.c's handling of hash index tuple sorts
-		 * through an assertion, though.
-		 */
-#ifdef USE_ASSERT_CHECKING
-		uint32		lasthashkey = hashkey;
-
-		hashkey = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
-									   hspool->max_buckets, hspool->high_mask,
-									   hspool->low_mask);
-		Assert(hashkey >= lasthashkey);
-#endif
-
-		/* the tuples are sorted by hashkey, so pass 'sorted' as true */
-		_hash_doinsert(hspool->index, itup, heapRel, true);
+		Bucket		bucket;
+		Size		itemsz;
+
+		bucket = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
+									  hspool->max_buckets, hspool->high_mask,
+									  hspool->low_mask);
+		Assert(curbucket == InvalidBucket || bucket >= curbucket);
+
+		itemsz = MAXALIGN(IndexTupleSize(itup));
+		if (itemsz > HashMaxItemSize(metapage))
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("index row size %zu exceeds hash maximum %zu",
+							itemsz, HashMaxItemSize(metapage)),
+					 errhint("Values larger than a buffer page cannot be indexed.")));
+
+		/* Move on to the primary page of the next bucket */
+		if (bucket != curbucket)
+		{
+			if (BufferIsValid(buf))
+			{
+				_hash_relbuf(rel, buf);
+				if (buf != bucket_buf)
+					_hash_dropbuf(rel, bucket_buf);
+			}
+			bucket_buf = buf = _hash_getbuf(rel, BUCKET_TO_BLKNO(metap, bucket),
+											HASH_WRITE, LH_BUCKET_PAGE);
+			curbucket = bucket;
+		}
+
+		/* Chain a new overflow page if the current one is full */
+		if (PageGetFreeSpace(BufferGetPage(buf)) < itemsz)
+		{
+			/* _hash_addovflpage expects the buffer unlocked, as in insert */
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			buf = _hash_addovflpage(rel, metabuf, buf, (buf == bucket_buf));
+			Assert(PageGetFreeSpace(BufferGetPage(buf)) >= itemsz);
+		}
+
+		/* the tuples are sorted by hashkey, so they can just be appended */
+		(void) _hash_pgaddtup(rel, buf, itemsz, itup, true);
+		MarkBufferDirty(buf);
 
 		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_DONE,
 									 ++tups_done);
 	}
+
+	if (BufferIsValid(buf))
+	{
+		_hash_relbuf(rel, buf);
+		if (buf != bucket_buf)
+			_hash_dropbuf(rel, bucket_buf);
+	}
+
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+	metap->hashm_ntuples += tups_done;
+	MarkBufferDirty(metabuf);
+	LockBuffer(metabuf, BUFFER_LOCK_UNLOCK);
+
+	/*
+	 * We didn't write WAL records for the tuples as we loaded them, so if
+	 * WAL-logging is required, write all pages to the WAL now.  This must
+	 * happen before any split below, which is WAL-logged as usual.
+	 */
+	if (RelationNeedsWAL(rel))
+		log_newpage_range(rel, MAIN_FORKNUM,
+						  0, RelationGetNumberOfBlocks(rel),
+						  true);
+
+	/*
+	 * If there were more tuples than estimated, split buckets until we reach
+	 * the fill factor, as inserting them one by one would have.  Stop if
+	 * _hash_expandtable() declines to split.
+	 */
+	do
+	{
+		lastmaxbucket = metap->hashm_maxbucket;
+		if (metap->hashm_ntuples <=
+			(double) metap->hashm_ffactor * (metap->hashm_maxbucket + 1))
+			break;
+		CHECK_FOR_INTERRUPTS();
+		_hash_expandtable(rel, metabuf);
+	} while (metap->hashm_maxbucket != lastmaxbucket);
+
+	_hash_dropbuf(rel, metabuf);
+}
+
+/*
+ * Scan the heap into a spool with the help of parallel workers, which each
+ * sort their share of the tuples.  On return, the spool's sort merges their
+ * sorted runs, and is ready for _h_indexbuild().  The number of heap tuples
+ * scanned is returned in *reltuples, and the number of index tuples in
+ * *indtuples.
+ *
+ * Like _bt_begin_parallel(), this returns NULL if no worker process could be
+ * launched; caller then builds the index serially.
+ */
+HSpool *
+_h_parallel_spoolinit(Relation heap, Relation index, IndexInfo *indexInfo,
+					  uint32 num_buckets, double *reltuples,
+					  double *indtuples)
+{
+	ParallelContext *pcxt;
+	int			request = indexInfo->ii_ParallelWorkers;
+	bool		isconcurrent = indexInfo->ii_Concurrent;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		esthashshared;
+	Size		estsort;
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	HashLeader *hashleader = (HashLeader *) palloc0(sizeof(HashLeader));
+	SortCoordinate coordinate;
+	HSpool	   *hspool;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			querylen;
+	int			sortmem;
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of hash
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_hash_parallel_build_main",
+								 request);
+
+	/* the leader participates as a worker, too */
+	scantuplesortstates = request + 1;
+
+	/*
+	 * Prepare for scan of the base relation.  As in btree builds, a normal
+	 * build uses SnapshotAny, and a concurrent one a regular MVCC snapshot.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Estimate size for our own PARALLEL_KEY_HASH_SHARED workspace, and
+	 * PARALLEL_KEY_TUPLESORT tuplesort workspace
+	 */
+	esthashshared = add_size(BUFFERALIGN(sizeof(HashShared)),
+							 table_parallelscan_estimate(heap, snapshot));
+	shm_toc_estimate_chunk(&pcxt->estimator, esthashshared);
+	estsort = tuplesort_estimate_shared(scantuplesortstates);
+	shm_toc_estimate_chunk(&pcxt->estimator, estsort);
+	shm_toc_estimate_keys(&pcxt->estimator, 2);
+
+	/* Estimate space for WalUsage and BufferUsage */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	hashshared = (HashShared *) shm_toc_allocate(pcxt->toc, esthashshared);
+	hashshared->heaprelid = RelationGetRelid(heap);
+	hashshared->indexrelid = RelationGetRelid(index);
+	hashshared->isconcurrent = isconcurrent;
+	hashshared->num_buckets = num_buckets;
+	hashshared->scantuplesortstates = scantuplesortstates;
+	ConditionVariableInit(&hashshared->workersdonecv);
+	SpinLockInit(&hashshared->mutex);
+	hashshared->nparticipantsdone = 0;
+	hashshared->reltuples = 0.0;
+	hashshared->indtuples = 0.0;
+	hashshared->brokenhotchain = false;
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromHashShared(hashshared),
+								  snapshot);
+
+	sharedsort = (Sharedsort *) shm_toc_allocate(pcxt->toc, estsort);
+	tuplesort_initialize_shared(sharedsort, scantuplesortstates,
+								pcxt->seg);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_HASH_SHARED, hashshared);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_TUPLESORT, sharedsort);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	hashleader->pcxt = pcxt;
+	hashleader->nparticipanttuplesorts = pcxt->nworkers_launched + 1;
+	hashleader->hashshared = hashshared;
+	hashleader->sharedsort = sharedsort;
+	hashleader->snapshot = snapshot;
+	hashleader->walusage = walusage;
+	hashleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_h_end_parallel(hashleader);
+		return NULL;
+	}
+
+	/*
+	 * Join heap scan ourselves.  Might as well use reliable figure when
+	 * doling out maintenance_work_mem.
+	 */
+	sortmem = maintenance_work_mem / hashleader->nparticipanttuplesorts;
+	_h_parallel_scan_and_sort(hashshared, sharedsort, heap, index,
+							  sortmem, true);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+
+	/* Wait for the participants to finish their scans */
+	for (;;)
+	{
+		SpinLockAcquire(&hashshared->mutex);
+		if (hashshared->nparticipantsdone == hashleader->nparticipanttuplesorts)
+		{
+			*reltuples = hashshared->reltuples;
+			*indtuples = hashshared->indtuples;
+			if (hashshared->brokenhotchain)
+				indexInfo->ii_BrokenHotChain = true;
+			SpinLockRelease(&hashshared->mutex);
+			break;
+		}
+		SpinLockRelease(&hashshared->mutex);
+
+		ConditionVariableSleep(&hashshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+	ConditionVariableCancelSleep();
+
+	/* Set up the leader's sort, which merges the participants' runs */
+	coordinate = (SortCoordinate) palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = false;
+	coordinate->nParticipants = hashleader->nparticipanttuplesorts;
+	coordinate->sharedsort = sharedsort;
+
+	hspool = _h_spoolinit_internal(heap, index, num_buckets,
+								   maintenance_work_mem, coordinate);
+	hspool->hashleader = hashleader;
+
+	return hspool;
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_h_end_parallel(HashLeader *hashleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(hashleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < hashleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&hashleader->bufferusage[i], &hashleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(hashleader->snapshot))
+		UnregisterSnapshot(hashleader->snapshot);
+	DestroyParallelContext(hashleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Per-tuple callback for the heap scan of a parallel build participant
+ */
+static void
+_h_parallel_callback(Relation index, ItemPointer tid, Datum *values,
+					 bool *isnull, bool tupleIsAlive, void *state)
+{
+	HashSpoolState *spoolstate = (HashSpoolState *) state;
+	Datum		index_values[1];
+	bool		index_isnull[1];
+
+	/* convert data to a hash key; on failure, do not insert anything */
+	if (!_hash_convert_tuple(index,
+							 values, isnull,
+							 index_values, index_isnull))
+		return;
+
+	_h_spool(spoolstate->spool, tid, index_values, index_isnull);
+	spoolstate->indtuples += 1;
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_hash_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	HashShared *hashshared;
+	Sharedsort *sharedsort;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			sortmem;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up hash shared state */
+	hashshared = shm_toc_lookup(toc, PARALLEL_KEY_HASH_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!hashshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(hashshared->heaprelid, heapLockmode);
+	indexRel = index_open(hashshared->indexrelid, indexLockmode);
+
+	/* Look up shared state private to tuplesort.c */
+	sharedsort = shm_toc_lookup(toc, PARALLEL_KEY_TUPLESORT, false);
+	tuplesort_attach_shared(sharedsort, seg);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	sortmem = maintenance_work_mem / hashshared->scantuplesortstates;
+	_h_parallel_scan_and_sort(hashshared, sharedsort, heapRel, indexRel,
+							  sortmem, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Perform a participant's portion of a parallel build: scan its share of the
+ * heap, and sort the hash keys.
+ *
+ * sortmem is the amount of working memory to use within each participant,
+ * expressed in KBs.
+ */
+static void
+_h_parallel_scan_and_sort(HashShared *hashshared, Sharedsort *sharedsort,
+						  Relation heap, Relation index,
+						  int sortmem, bool progress)
+{
+	SortCoordinate coordinate;
+	HashSpoolState spoolstate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+
+	/* Initialize local tuplesort coordination state */
+	coordinate = palloc0(sizeof(SortCoordinateData));
+	coordinate->isWorker = true;
+	coordinate->nParticipants = -1;
+	coordinate->sharedsort = sharedsort;
+
+	spoolstate.spool = _h_spoolinit_internal(heap, index,
+											 hashshared->num_buckets,
+											 Max(sortmem, 64), coordinate);
+	spoolstate.indtuples = 0;
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = hashshared->isconcurrent;
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromHashShared(hashshared));
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   _h_parallel_callback,
+									   (void *) &spoolstate, scan);
+
+	/* Execute this worker's part of the sort */
+	tuplesort_performsort(spoolstate.spool->sortstate);
+
+	/* Done.  Record ambuild statistics. */
+	SpinLockAcquire(&hashshared->mutex);
+	hashshared->nparticipantsdone++;
+	hashshared->reltuples += reltuples;
+	hashshared->indtuples += spoolstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		hashshared->brokenhotchain = true;
+	SpinLockRelease(&hashshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&hashshared->workersdonecv);
+
+	/* Help the leader with the final merge, see _bt_parallel_scan_and_sort */
+	if (IsParallelWorker())
+		tuplesort_merge_ranges(spoolstate.spool->sortstate);
+
+	_h_spooldestroy(spoolstate.spool);
 }
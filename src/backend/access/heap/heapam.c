@@ -45,6 +45,7 @@
 #include "access/sysattr.h"
 #include "access/tableam.h"
 #include "access/transam.h"
+#include "access/tuplecountmap.h"
 #include "access/valid.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
@@ -54,6 +55,7 @@
 #include "catalog/catalog.h"
 #include "commands/vacuum.h"
 #include "miscadmin.h"
+#include "nodes/tidbitmap.h"
 #include "pgstat.h"
 #include "port/atomics.h"
 #include "port/pg_bitutils.h"
@@ -73,6 +75,11 @@
 #include "utils/spccache.h"
 
 
+static inline BlockNumber heapgettup_initial_block(HeapScanDesc scan,
+												 ScanDirection dir);
+static inline BlockNumber heapgettup_advance_block(HeapScanDesc scan,
+												 BlockNumber block,
+												 ScanDirection dir);
 static HeapTuple heap_prepare_insert(Relation relation, HeapTuple tup,
 									 TransactionId xid, CommandId cid, int options);
 static XLogRecPtr log_heap_update(Relation reln, Buffer oldbuf,
@@ -326,6 +333,8 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_dir = ForwardScanDirection;
+	scan->rs_prefetch_block = InvalidBlockNumber;
 
 	/* page-at-a-time fields are always invalid when not rs_inited */
 
@@ -367,51 +376,214 @@ heap_setscanlimits(TableScanDesc sscan, BlockNumber startBlk, BlockNumber numBlk
 }
 
 /*
- * heapgetpage - subroutine for heapgettup()
+ * heap_scan_skip_block - can a count-only sequential scan skip this block?
  *
- * This routine reads and pins the specified page of the relation.
- * In page-at-a-time mode it performs additional work, namely determining
- * which tuples on the page are visible.
+ * If the block is all-visible and the tuple count map knows how many tuples
+ * it holds, the scan doesn't need to read it: every tuple on it is visible
+ * to the scan's snapshot, and none of their contents are needed.  The
+ * skipped tuples are returned as empty tuples by heap_getnextslot.  See
+ * tuplecountmap.c for why the count can be trusted.
  */
-void
-heapgetpage(TableScanDesc sscan, BlockNumber block)
+static inline bool
+heap_scan_skip_block(HeapScanDesc scan, BlockNumber block)
+{
+	int			ntuples;
+
+	if (!VM_ALL_VISIBLE(scan->rs_base.rs_rd, block, &scan->rs_vmbuffer))
+		return false;
+
+	ntuples = tuplecountmap_get(scan->rs_base.rs_rd, block,
+								&scan->rs_tcmbuffer);
+	if (ntuples < 0)
+		return false;
+
+	Assert(scan->rs_empty_tuples_pending >= 0);
+	scan->rs_empty_tuples_pending += ntuples;
+	return true;
+}
+
+/*
+ * Streaming read callback for parallel sequential scans.  Returns the next
+ * block the caller wants from the read stream or InvalidBlockNumber when
+ * done.
+ */
+static BlockNumber
+heap_scan_stream_read_next_parallel(ReadStream *stream,
+									void *callback_private_data,
+									void *per_buffer_data)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private_data;
+
+	Assert(ScanDirectionIsForward(scan->rs_dir));
+	Assert(scan->rs_base.rs_parallel);
+
+	if (unlikely(!scan->rs_inited))
+	{
+		/* parallel scan */
+		table_block_parallelscan_startblock_init(scan->rs_base.rs_rd,
+												 scan->rs_parallelworkerdata,
+												 (ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
+
+		/* may return InvalidBlockNumber if there are no more blocks */
+		scan->rs_prefetch_block = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
+																	scan->rs_parallelworkerdata,
+																	(ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
+		scan->rs_inited = true;
+	}
+	else
+	{
+		scan->rs_prefetch_block = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
+																	scan->rs_parallelworkerdata, (ParallelBlockTableScanDesc)
+																	scan->rs_base.rs_parallel);
+	}
+
+	while (scan->rs_count_only &&
+		   BlockNumberIsValid(scan->rs_prefetch_block) &&
+		   heap_scan_skip_block(scan, scan->rs_prefetch_block))
+	{
+		scan->rs_prefetch_block = table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
+																	scan->rs_parallelworkerdata, (ParallelBlockTableScanDesc)
+																	scan->rs_base.rs_parallel);
+	}
+
+	return scan->rs_prefetch_block;
+}
+
+/*
+ * Streaming read callback for serial sequential and TID range scans.
+ * Returns the next block the caller wants from the read stream or
+ * InvalidBlockNumber when done.
+ */
+static BlockNumber
+heap_scan_stream_read_next_serial(ReadStream *stream,
+								  void *callback_private_data,
+								  void *per_buffer_data)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private_data;
+
+	if (unlikely(!scan->rs_inited))
+	{
+		scan->rs_prefetch_block = heapgettup_initial_block(scan, scan->rs_dir);
+		scan->rs_inited = true;
+	}
+	else
+		scan->rs_prefetch_block = heapgettup_advance_block(scan,
+														   scan->rs_prefetch_block,
+														   scan->rs_dir);
+
+	while (scan->rs_count_only && ScanDirectionIsForward(scan->rs_dir) &&
+		   BlockNumberIsValid(scan->rs_prefetch_block) &&
+		   heap_scan_skip_block(scan, scan->rs_prefetch_block))
+	{
+		scan->rs_prefetch_block = heapgettup_advance_block(scan,
+														   scan->rs_prefetch_block,
+														   scan->rs_dir);
+	}
+
+	return scan->rs_prefetch_block;
+}
+
+/*
+ * Streaming read callback for bitmap heap scans.  Returns the next block the
+ * bitmap points to, leaving a copy of its bitmap entry in per_buffer_data,
+ * or InvalidBlockNumber when the bitmap is exhausted.
+ */
+static BlockNumber
+bitmapheap_stream_read_next(ReadStream *stream,
+							void *callback_private_data,
+							void *per_buffer_data)
+{
+	HeapScanDesc hscan = (HeapScanDesc) callback_private_data;
+	TableScanDesc sscan = &hscan->rs_base;
+	TBMIterateResult *tbmres = per_buffer_data;
+
+	for (;;)
+	{
+		TBMIterateResult *result;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (sscan->rs_tbmiterator)
+			result = tbm_iterate(sscan->rs_tbmiterator);
+		else if (sscan->rs_shared_tbmiterator)
+			result = tbm_shared_iterate(sscan->rs_shared_tbmiterator);
+		else
+			result = NULL;
+
+		/* no more entries in the bitmap */
+		if (result == NULL)
+			return InvalidBlockNumber;
+
+		/*
+		 * Ignore any claimed entries past what we think is the end of the
+		 * relation. It may have been extended after the start of our scan (we
+		 * only hold an AccessShareLock, and it could be inserts from this
+		 * backend).  We don't take this optimization in SERIALIZABLE
+		 * isolation though, as we need to examine all invisible tuples
+		 * reachable by the index.
+		 */
+		if (!IsolationIsSerializable() && result->blockno >= hscan->rs_nblocks)
+			continue;
+
+		/*
+		 * We can skip fetching the heap page if we don't need any fields from
+		 * the heap, the bitmap entries don't need rechecking, and all tuples
+		 * on the page are visible to our transaction.
+		 */
+		if (!(sscan->rs_flags & SO_NEED_TUPLES) &&
+			!result->recheck &&
+			VM_ALL_VISIBLE(sscan->rs_rd, result->blockno, &hscan->rs_vmbuffer))
+		{
+			/* can't be lossy in the skip_fetch case */
+			Assert(result->ntuples >= 0);
+			Assert(hscan->rs_empty_tuples_pending >= 0);
+
+			hscan->rs_empty_tuples_pending += result->ntuples;
+			hscan->rs_skipped_pages++;
+			continue;
+		}
+
+		memcpy(tbmres, result,
+			   offsetof(TBMIterateResult, offsets) +
+			   Max(result->ntuples, 0) * sizeof(OffsetNumber));
+
+		return result->blockno;
+	}
+}
+
+/*
+ * heap_prepare_pagescan - prepare the page in rs_cbuf for scanning
+ *
+ * In page-at-a-time mode, this prunes the page and determines which of its
+ * tuples are visible, filling rs_vistuples.  Otherwise there's nothing to do.
+ *
+ * If the scan has scan keys (sample scans ignore them), only the visible
+ * tuples that also satisfy the keys are put into rs_vistuples.  Testing the
+ * keys of the whole page here, right after the visibility checks, finds the
+ * tuples still in the CPU cache, and spares heapgettup_pagemode from
+ * returning one tuple at a time only to skip it.
+ */
+static void
+heap_prepare_pagescan(HeapScanDesc scan)
 {
-	HeapScanDesc scan = (HeapScanDesc) sscan;
 	Buffer		buffer;
 	Snapshot	snapshot;
 	Page		page;
+	BlockNumber block;
 	int			lines;
 	int			ntup;
 	OffsetNumber lineoff;
 	bool		all_visible;
 
-	Assert(block < scan->rs_nblocks);
-
-	/* release previous scan buffer, if any */
-	if (BufferIsValid(scan->rs_cbuf))
-	{
-		ReleaseBuffer(scan->rs_cbuf);
-		scan->rs_cbuf = InvalidBuffer;
-	}
-
-	/*
-	 * Be sure to check for interrupts at least once per page.  Checks at
-	 * higher code levels won't be able to stop a seqscan that encounters many
-	 * pages' worth of consecutive dead tuples.
-	 */
-	CHECK_FOR_INTERRUPTS();
-
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, block,
-									   RBM_NORMAL, scan->rs_strategy);
-	scan->rs_cblock = block;
-
 	if (!(scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE))
 		return;
 
 	buffer = scan->rs_cbuf;
+	block = scan->rs_cblock;
 	snapshot = scan->rs_base.rs_snapshot;
 
+	Assert(BufferGetBlockNumber(buffer) == block);
+
 	/*
 	 * Prune and repair fragmentation for the whole page, if possible.
 	 */
@@ -479,49 +651,142 @@ heapgetpage(TableScanDesc sscan, BlockNumber block)
 
 	LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
+	/*
+	 * Apply the scan keys to the visible tuples.  The tuples stay valid as
+	 * long as we hold the pin, so there's no need to keep the content lock
+	 * while calling the key functions.
+	 */
+	if (scan->rs_base.rs_nkeys > 0 &&
+		!(scan->rs_base.rs_flags & SO_TYPE_SAMPLESCAN))
+	{
+		TupleDesc	tupdesc = RelationGetDescr(scan->rs_base.rs_rd);
+		int			nkeys = scan->rs_base.rs_nkeys;
+		ScanKey		key = scan->rs_base.rs_key;
+		int			nqual = 0;
+
+		for (int i = 0; i < ntup; i++)
+		{
+			ItemId		lpp;
+			HeapTupleData loctup;
+
+			lineoff = scan->rs_vistuples[i];
+			lpp = PageGetItemId(page, lineoff);
+			loctup.t_tableOid = RelationGetRelid(scan->rs_base.rs_rd);
+			loctup.t_data = (HeapTupleHeader) PageGetItem(page, lpp);
+			loctup.t_len = ItemIdGetLength(lpp);
+			ItemPointerSet(&(loctup.t_self), block, lineoff);
+
+			if (HeapKeyTest(&loctup, tupdesc, nkeys, key))
+				scan->rs_vistuples[nqual++] = lineoff;
+		}
+		ntup = nqual;
+	}
+
 	Assert(ntup <= MaxHeapTuplesPerPage);
 	scan->rs_ntuples = ntup;
 }
 
+/*
+ * heapgetpage - subroutine for sample scans
+ *
+ * This routine reads and pins the specified page of the relation.
+ * In page-at-a-time mode it performs additional work, namely determining
+ * which tuples on the page are visible.
+ */
+void
+heapgetpage(TableScanDesc sscan, BlockNumber block)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+
+	Assert(block < scan->rs_nblocks);
+
+	/* release previous scan buffer, if any */
+	if (BufferIsValid(scan->rs_cbuf))
+	{
+		ReleaseBuffer(scan->rs_cbuf);
+		scan->rs_cbuf = InvalidBuffer;
+	}
+
+	/*
+	 * Be sure to check for interrupts at least once per page.  Checks at
+	 * higher code levels won't be able to stop a seqscan that encounters many
+	 * pages' worth of consecutive dead tuples.
+	 */
+	CHECK_FOR_INTERRUPTS();
+
+	/* read page using selected strategy */
+	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, block,
+									   RBM_NORMAL, scan->rs_strategy);
+	scan->rs_cblock = block;
+
+	heap_prepare_pagescan(scan);
+}
+
+/*
+ * heap_fetch_next_buffer - read and pin the next block from MAIN_FORKNUM.
+ *
+ * Read the next block of the scan relation from the read stream and save it
+ * in the scan descriptor.  It is already pinned.
+ */
+static inline void
+heap_fetch_next_buffer(HeapScanDesc scan, ScanDirection dir)
+{
+	Assert(scan->rs_read_stream);
+
+	/* release previous scan buffer, if any */
+	if (BufferIsValid(scan->rs_cbuf))
+	{
+		ReleaseBuffer(scan->rs_cbuf);
+		scan->rs_cbuf = InvalidBuffer;
+	}
+
+	/*
+	 * Be sure to check for interrupts at least once per page.  Checks at
+	 * higher code levels won't be able to stop a seqscan that encounters many
+	 * pages' worth of consecutive dead tuples.
+	 */
+	CHECK_FOR_INTERRUPTS();
+
+	/*
+	 * If the scan direction is changing, reset the prefetch block to the
+	 * current block.  Otherwise, we will incorrectly prefetch the blocks
+	 * between the prefetch block and the current block again before
+	 * prefetching blocks in the new, correct scan direction.
+	 */
+	if (unlikely(scan->rs_dir != dir))
+	{
+		scan->rs_prefetch_block = scan->rs_cblock;
+		read_stream_reset(scan->rs_read_stream);
+	}
+
+	scan->rs_dir = dir;
+
+	scan->rs_cbuf = read_stream_next_buffer(scan->rs_read_stream, NULL);
+	if (BufferIsValid(scan->rs_cbuf))
+		scan->rs_cblock = BufferGetBlockNumber(scan->rs_cbuf);
+}
+
 /*
  * heapgettup_initial_block - return the first BlockNumber to scan
  *
  * Returns InvalidBlockNumber when there are no blocks to scan.  This can
- * occur with empty tables and in parallel scans when parallel workers get all
- * of the pages before we can get a chance to get our first page.
+ * occur with empty tables.  Parallel scans get their first block from
+ * heap_scan_stream_read_next_parallel() instead.
  */
-static BlockNumber
+static inline BlockNumber
 heapgettup_initial_block(HeapScanDesc scan, ScanDirection dir)
 {
 	Assert(!scan->rs_inited);
+	Assert(scan->rs_base.rs_parallel == NULL);
 
 	/* When there are no pages to scan, return InvalidBlockNumber */
 	if (scan->rs_nblocks == 0 || scan->rs_numblocks == 0)
 		return InvalidBlockNumber;
 
 	if (ScanDirectionIsForward(dir))
-	{
-		/* serial scan */
-		if (scan->rs_base.rs_parallel == NULL)
-			return scan->rs_startblock;
-		else
-		{
-			/* parallel scan */
-			table_block_parallelscan_startblock_init(scan->rs_base.rs_rd,
-													 scan->rs_parallelworkerdata,
-													 (ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
-
-			/* may return InvalidBlockNumber if there are no more blocks */
-			return table_block_parallelscan_nextpage(scan->rs_base.rs_rd,
-													 scan->rs_parallelworkerdata,
-													 (ParallelBlockTableScanDesc) scan->rs_base.rs_parallel);
-		}
-	}
+		return scan->rs_startblock;
 	else
 	{
-		/* backward parallel scan not supported */
-		Assert(scan->rs_base.rs_parallel == NULL);
-
 		/*
 		 * Disable reporting to syncscan logic in a backwards scan; it's not
 		 * very likely anyone else is doing the same thing at the same time,
@@ -732,23 +997,13 @@ heapgettup(HeapScanDesc scan,
 		   ScanKey key)
 {
 	HeapTuple	tuple = &(scan->rs_ctup);
-	BlockNumber block;
 	Page		page;
 	OffsetNumber lineoff;
 	int			linesleft;
 
-	if (unlikely(!scan->rs_inited))
-	{
-		block = heapgettup_initial_block(scan, dir);
-		/* ensure rs_cbuf is invalid when we get InvalidBlockNumber */
-		Assert(block != InvalidBlockNumber || !BufferIsValid(scan->rs_cbuf));
-		scan->rs_inited = true;
-	}
-	else
+	if (likely(scan->rs_inited))
 	{
 		/* continue from previously returned page/tuple */
-		block = scan->rs_cblock;
-
 		LockBuffer(scan->rs_cbuf, BUFFER_LOCK_SHARE);
 		page = heapgettup_continue_page(scan, dir, &linesleft, &lineoff);
 		goto continue_page;
@@ -758,9 +1013,16 @@ heapgettup(HeapScanDesc scan,
 	 * advance the scan until we find a qualifying tuple or run out of stuff
 	 * to scan
 	 */
-	while (block != InvalidBlockNumber)
+	while (true)
 	{
-		heapgetpage((TableScanDesc) scan, block);
+		heap_fetch_next_buffer(scan, dir);
+
+		/* did we run out of blocks to scan? */
+		if (!BufferIsValid(scan->rs_cbuf))
+			break;
+
+		Assert(BufferGetBlockNumber(scan->rs_cbuf) == scan->rs_cblock);
+
 		LockBuffer(scan->rs_cbuf, BUFFER_LOCK_SHARE);
 		page = heapgettup_start_page(scan, dir, &linesleft, &lineoff);
 continue_page:
@@ -782,7 +1044,7 @@ continue_page:
 
 			tuple->t_data = (HeapTupleHeader) PageGetItem(page, lpp);
 			tuple->t_len = ItemIdGetLength(lpp);
-			ItemPointerSet(&(tuple->t_self), block, lineoff);
+			ItemPointerSet(&(tuple->t_self), scan->rs_cblock, lineoff);
 
 			visible = HeapTupleSatisfiesVisibility(tuple,
 												   scan->rs_base.rs_snapshot,
@@ -812,9 +1074,6 @@ continue_page:
 		 * it's time to move to the next.
 		 */
 		LockBuffer(scan->rs_cbuf, BUFFER_LOCK_UNLOCK);
-
-		/* get the BlockNumber to scan next */
-		block = heapgettup_advance_block(scan, block, dir);
 	}
 
 	/* end of scan */
@@ -823,6 +1082,7 @@ continue_page:
 
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_prefetch_block = InvalidBlockNumber;
 	tuple->t_data = NULL;
 	scan->rs_inited = false;
 }
@@ -834,35 +1094,25 @@ continue_page:
  *
  * The internal logic is much the same as heapgettup's too, but there are some
  * differences: we do not take the buffer content lock (that only needs to
- * happen inside heapgetpage), and we iterate through just the tuples listed
- * in rs_vistuples[] rather than all tuples on the page.  Notice that
+ * happen inside heap_prepare_pagescan), and we iterate through just the tuples listed
+ * in rs_vistuples[] rather than all tuples on the page.  The scan keys have
+ * also been applied by heap_prepare_pagescan already.  Notice that
  * lineindex is 0-based, where the corresponding loop variable lineoff in
  * heapgettup is 1-based.
  * ----------------
  */
 static void
 heapgettup_pagemode(HeapScanDesc scan,
-					ScanDirection dir,
-					int nkeys,
-					ScanKey key)
+					ScanDirection dir)
 {
 	HeapTuple	tuple = &(scan->rs_ctup);
-	BlockNumber block;
 	Page		page;
 	int			lineindex;
 	int			linesleft;
 
-	if (unlikely(!scan->rs_inited))
-	{
-		block = heapgettup_initial_block(scan, dir);
-		/* ensure rs_cbuf is invalid when we get InvalidBlockNumber */
-		Assert(block != InvalidBlockNumber || !BufferIsValid(scan->rs_cbuf));
-		scan->rs_inited = true;
-	}
-	else
+	if (likely(scan->rs_inited))
 	{
 		/* continue from previously returned page/tuple */
-		block = scan->rs_cblock;	/* current page */
 		page = BufferGetPage(scan->rs_cbuf);
 		TestForOldSnapshot(scan->rs_base.rs_snapshot, scan->rs_base.rs_rd, page);
 
@@ -880,9 +1130,18 @@ heapgettup_pagemode(HeapScanDesc scan,
 	 * advance the scan until we find a qualifying tuple or run out of stuff
 	 * to scan
 	 */
-	while (block != InvalidBlockNumber)
+	while (true)
 	{
-		heapgetpage((TableScanDesc) scan, block);
+		heap_fetch_next_buffer(scan, dir);
+
+		/* did we run out of blocks to scan? */
+		if (!BufferIsValid(scan->rs_cbuf))
+			break;
+
+		Assert(BufferGetBlockNumber(scan->rs_cbuf) == scan->rs_cblock);
+
+		/* prune the page and work out which tuples are visible */
+		heap_prepare_pagescan(scan);
 		page = BufferGetPage(scan->rs_cbuf);
 		TestForOldSnapshot(scan->rs_base.rs_snapshot, scan->rs_base.rs_rd, page);
 		linesleft = scan->rs_ntuples;
@@ -902,20 +1161,11 @@ continue_page:
 
 			tuple->t_data = (HeapTupleHeader) PageGetItem(page, lpp);
 			tuple->t_len = ItemIdGetLength(lpp);
-			ItemPointerSet(&(tuple->t_self), block, lineoff);
-
-			/* skip any tuples that don't match the scan key */
-			if (key != NULL &&
-				!HeapKeyTest(tuple, RelationGetDescr(scan->rs_base.rs_rd),
-							 nkeys, key))
-				continue;
+			ItemPointerSet(&(tuple->t_self), scan->rs_cblock, lineoff);
 
 			scan->rs_cindex = lineindex;
 			return;
 		}
-
-		/* get the BlockNumber to scan next */
-		block = heapgettup_advance_block(scan, block, dir);
 	}
 
 	/* end of scan */
@@ -923,6 +1173,7 @@ continue_page:
 		ReleaseBuffer(scan->rs_cbuf);
 	scan->rs_cbuf = InvalidBuffer;
 	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_prefetch_block = InvalidBlockNumber;
 	tuple->t_data = NULL;
 	scan->rs_inited = false;
 }
@@ -934,6 +1185,49 @@ continue_page:
  */
 
 
+/*
+ * heap_begin_read_stream - set up scan->rs_read_stream, if the scan uses one
+ *
+ * Sequential scans and TID range scans read the relation in block order,
+ * and bitmap heap scans read the blocks the bitmap points to; each gets a
+ * stream with a suitable callback.  Other scan types read blocks one at a
+ * time.
+ */
+static void
+heap_begin_read_stream(HeapScanDesc scan)
+{
+	Assert(scan->rs_read_stream == NULL);
+
+	if (scan->rs_base.rs_flags & (SO_TYPE_SEQSCAN | SO_TYPE_TIDRANGESCAN))
+	{
+		ReadStreamBlockNumberCB cb;
+
+		if (scan->rs_base.rs_parallel)
+			cb = heap_scan_stream_read_next_parallel;
+		else
+			cb = heap_scan_stream_read_next_serial;
+
+		scan->rs_read_stream = read_stream_begin_relation(READ_STREAM_SEQUENTIAL,
+														  scan->rs_strategy,
+														  scan->rs_base.rs_rd,
+														  MAIN_FORKNUM,
+														  cb,
+														  scan,
+														  0);
+	}
+	else if (scan->rs_base.rs_flags & SO_TYPE_BITMAPSCAN)
+	{
+		scan->rs_read_stream = read_stream_begin_relation(READ_STREAM_DEFAULT,
+														  scan->rs_strategy,
+														  scan->rs_base.rs_rd,
+														  MAIN_FORKNUM,
+														  bitmapheap_stream_read_next,
+														  scan,
+														  offsetof(TBMIterateResult, offsets) +
+														  MaxHeapTuplesPerPage * sizeof(OffsetNumber));
+	}
+}
+
 TableScanDesc
 heap_beginscan(Relation relation, Snapshot snapshot,
 			   int nkeys, ScanKey key,
@@ -961,7 +1255,13 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 	scan->rs_base.rs_nkeys = nkeys;
 	scan->rs_base.rs_flags = flags;
 	scan->rs_base.rs_parallel = parallel_scan;
+	scan->rs_base.rs_tbmiterator = NULL;
+	scan->rs_base.rs_shared_tbmiterator = NULL;
 	scan->rs_strategy = NULL;	/* set in initscan */
+	scan->rs_vmbuffer = InvalidBuffer;
+	scan->rs_tcmbuffer = InvalidBuffer;
+	scan->rs_empty_tuples_pending = 0;
+	scan->rs_skipped_pages = 0;
 
 	/*
 	 * Disable page-at-a-time mode if it's not a MVCC-safe snapshot.
@@ -969,6 +1269,18 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 	if (!(snapshot && IsMVCCSnapshot(snapshot)))
 		scan->rs_base.rs_flags &= ~SO_ALLOW_PAGEMODE;
 
+	/*
+	 * A sequential scan that doesn't need the tuples can skip the pages
+	 * whose tuple count is known.  Not in SERIALIZABLE isolation, though,
+	 * where the tuples read are checked for conflicts.
+	 */
+	scan->rs_count_only =
+		(scan->rs_base.rs_flags & SO_TYPE_SEQSCAN) &&
+		!(scan->rs_base.rs_flags & SO_NEED_TUPLES) &&
+		(scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE) &&
+		!IsolationIsSerializable() &&
+		tuplecountmap_exists(relation);
+
 	/*
 	 * For seqscan and sample scans in a serializable transaction, acquire a
 	 * predicate lock on the entire relation. This is required not only to
@@ -1016,6 +1328,15 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 
 	initscan(scan, key, false);
 
+	/*
+	 * Set up a read stream for the scan types that read blocks in an order
+	 * we can predict.  This should be done after initscan() because
+	 * initscan() allocates the BufferAccessStrategy object passed to the read
+	 * stream API.
+	 */
+	scan->rs_read_stream = NULL;
+	heap_begin_read_stream(scan);
+
 	return (TableScanDesc) scan;
 }
 
@@ -1024,6 +1345,7 @@ heap_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 			bool allow_strat, bool allow_sync, bool allow_pagemode)
 {
 	HeapScanDesc scan = (HeapScanDesc) sscan;
+	BufferAccessStrategy old_strategy;
 
 	if (set_params)
 	{
@@ -1050,10 +1372,43 @@ heap_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
 
+	if (BufferIsValid(scan->rs_vmbuffer))
+	{
+		ReleaseBuffer(scan->rs_vmbuffer);
+		scan->rs_vmbuffer = InvalidBuffer;
+	}
+	if (BufferIsValid(scan->rs_tcmbuffer))
+	{
+		ReleaseBuffer(scan->rs_tcmbuffer);
+		scan->rs_tcmbuffer = InvalidBuffer;
+	}
+	scan->rs_empty_tuples_pending = 0;
+	scan->rs_skipped_pages = 0;
+
+	/*
+	 * The read stream is reset on rescan.  This must be done before
+	 * initscan(), as some state referred to by read_stream_reset() is reset
+	 * in initscan().
+	 */
+	if (scan->rs_read_stream)
+		read_stream_reset(scan->rs_read_stream);
+
 	/*
 	 * reinitialize scan descriptor
 	 */
+	old_strategy = scan->rs_strategy;
 	initscan(scan, key, true);
+
+	/*
+	 * The read stream remembers the buffer access strategy, so if initscan()
+	 * chose a different one, start a new stream.
+	 */
+	if (scan->rs_read_stream && scan->rs_strategy != old_strategy)
+	{
+		read_stream_end(scan->rs_read_stream);
+		scan->rs_read_stream = NULL;
+		heap_begin_read_stream(scan);
+	}
 }
 
 void
@@ -1069,6 +1424,18 @@ heap_endscan(TableScanDesc sscan)
 	if (BufferIsValid(scan->rs_cbuf))
 		ReleaseBuffer(scan->rs_cbuf);
 
+	if (BufferIsValid(scan->rs_vmbuffer))
+		ReleaseBuffer(scan->rs_vmbuffer);
+
+	if (BufferIsValid(scan->rs_tcmbuffer))
+		ReleaseBuffer(scan->rs_tcmbuffer);
+
+	/*
+	 * Must free the read stream before freeing the BufferAccessStrategy.
+	 */
+	if (scan->rs_read_stream)
+		read_stream_end(scan->rs_read_stream);
+
 	/*
 	 * decrement relation reference count and free scan descriptor storage
 	 */
@@ -1119,8 +1486,7 @@ heap_getnext(TableScanDesc sscan, ScanDirection direction) // ScanDirection是
 	/* Note: no locking manipulations needed */
 
 	if (scan->rs_base.rs_flags & SO_ALLOW_PAGEMODE)
-		heapgettup_pagemode(scan, direction,
-							scan->rs_base.rs_nkeys, scan->rs_base.rs_key);
+		heapgettup_pagemode(scan, direction);
 	else
 		heapgettup(scan, direction,
 				   scan->rs_base.rs_nkeys, scan->rs_base.rs_key);
@@ -1145,13 +1511,24 @@ heap_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableSlot *s
 
 	/* Note: no locking manipulations needed */
 
+	/*
+	 * Return the empty tuples for the pages the read stream callback
+	 * skipped first.  They may have been skipped before reaching the end of
+	 * the scan, too.
+	 */
+	if (scan->rs_empty_tuples_pending > 0)
+		goto empty_tuple;
+
 	if (sscan->rs_flags & SO_ALLOW_PAGEMODE)
-		heapgettup_pagemode(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+		heapgettup_pagemode(scan, direction);
 	else
 		heapgettup(scan, direction, sscan->rs_nkeys, sscan->rs_key);
 
 	if (scan->rs_ctup.t_data == NULL)
 	{
+		if (scan->rs_empty_tuples_pending > 0)
+			goto empty_tuple;
+
 		ExecClearTuple(slot);
 		return false;
 	}
@@ -1166,6 +1543,13 @@ heap_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableSlot *s
 	ExecStoreBufferHeapTuple(&scan->rs_ctup, slot,
 							 scan->rs_cbuf);
 	return true;
+
+empty_tuple:
+	pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+
+	ExecStoreAllNullTuple(slot);
+	scan->rs_empty_tuples_pending--;
+	return true;
 }
 
 void
@@ -1253,7 +1637,7 @@ heap_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
 	for (;;)
 	{
 		if (sscan->rs_flags & SO_ALLOW_PAGEMODE)
-			heapgettup_pagemode(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+			heapgettup_pagemode(scan, direction);
 		else
 			heapgettup(scan, direction, sscan->rs_nkeys, sscan->rs_key);
 
@@ -1777,9 +2161,25 @@ GetBulkInsertState(void)
 	bistate->next_free = InvalidBlockNumber;
 	bistate->last_free = InvalidBlockNumber;
 	bistate->already_extended_by = 0;
+	bistate->expected_pages = 0;
+	bistate->nfsm_pages = 0;
+	bistate->next_fsm_page = 0;
 	return bistate;
 }
 
+/*
+ * SetBulkInsertStateExpectedSize - hint how much more data will be inserted
+ *
+ * nbytes is a rough estimate of the amount of data still to be inserted
+ * using this bistate; 0 means unknown.  It's used to extend the relation in
+ * large chunks up front.
+ */
+void
+SetBulkInsertStateExpectedSize(BulkInsertState bistate, uint64 nbytes)
+{
+	bistate->expected_pages = (uint32) Min(nbytes / BLCKSZ, PG_UINT32_MAX);
+}
+
 /*
  * FreeBulkInsertState - clean up after finishing a bulk insert
  */
@@ -1812,6 +2212,8 @@ ReleaseBulkInsertStatePin(BulkInsertState bistate)
 	 */
 	bistate->next_free = InvalidBlockNumber;
 	bistate->last_free = InvalidBlockNumber;
+	bistate->nfsm_pages = 0;
+	bistate->next_fsm_page = 0;
 }
 
 
@@ -2030,9 +2432,11 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
 	 * To allow parallel inserts, we need to ensure that they are safe to be
 	 * performed in workers. We have the infrastructure to allow parallel
 	 * inserts in general except for the cases where inserts generate a new
-	 * CommandId (eg. inserts into a table having a foreign key column).
+	 * CommandId (eg. inserts into a table having a foreign key column).  So
+	 * a worker may only insert if the leader had already marked the current
+	 * command ID used, as parallel COPY FROM does.
 	 */
-	if (IsParallelWorker())
+	if (IsParallelWorker() && !IsCurrentCommandIdUsed())
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
 				 errmsg("cannot insert tuples in a parallel worker")));
@@ -2398,10 +2802,12 @@ heap_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 			/*
 			 * It's fine to use InvalidTransactionId here - this is only used
 			 * when HEAP_INSERT_FROZEN is specified, which intentionally
-			 * violates visibility rules.
+			 * violates visibility rules.  HEAP_INSERT_FROZEN also implies a
+			 * relfilenumber created in this transaction, which has no tuple
+			 * count map yet.
 			 */
 			visibilitymap_set(relation, BufferGetBlockNumber(buffer), buffer,
-							  InvalidXLogRecPtr, vmbuffer,
+							  InvalidXLogRecPtr, vmbuffer, InvalidBuffer,
 							  InvalidTransactionId,
 							  VISIBILITYMAP_ALL_VISIBLE | VISIBILITYMAP_ALL_FROZEN);
 		}
@@ -8331,14 +8737,19 @@ bottomup_sort_and_shrink(TM_IndexDeleteOp *delstate)
  * image of heap_buffer. Otherwise, we optimize away the FPI (by specifying
  * REGBUF_NO_IMAGE for the heap buffer), in which case the caller should *not*
  * update the heap page's LSN.
+ *
+ * If tcm_buffer is valid, it is the tuple count map page whose entry for the
+ * heap page was set to ntuples, and it is logged as block 2.
  */
 XLogRecPtr
 log_heap_visible(Relation rel, Buffer heap_buffer, Buffer vm_buffer,
+				 Buffer tcm_buffer, int ntuples,
 				 TransactionId snapshotConflictHorizon, uint8 vmflags)
 {
 	xl_heap_visible xlrec;
 	XLogRecPtr	recptr;
 	uint8		flags;
+	int16		tcm_ntuples = ntuples;
 
 	Assert(BufferIsValid(heap_buffer));
 	Assert(BufferIsValid(vm_buffer));
@@ -8357,6 +8768,12 @@ log_heap_visible(Relation rel, Buffer heap_buffer, Buffer vm_buffer,
 		flags |= REGBUF_NO_IMAGE;
 	XLogRegisterBuffer(1, heap_buffer, flags);
 
+	if (BufferIsValid(tcm_buffer))
+	{
+		XLogRegisterBuffer(2, tcm_buffer, 0);
+		XLogRegisterBufData(2, (char *) &tcm_ntuples, sizeof(int16));
+	}
+
 	recptr = XLogInsert(RM_HEAP2_ID, XLOG_HEAP2_VISIBLE);
 
 	return recptr;
@@ -8785,11 +9202,11 @@ heap_xlog_prune(XLogReaderState *record)
 											rlocator);
 
 	/*
-	 * If we have a full-page image, restore it (using a cleanup lock) and
-	 * we're done.
+	 * If we have a full-page image, restore it and we're done.  We need a
+	 * cleanup lock, unless the primary didn't move any tuples either.
 	 */
-	action = XLogReadBufferForRedoExtended(record, 0, RBM_NORMAL, true,
-										   &buffer);
+	action = XLogReadBufferForRedoExtended(record, 0, RBM_NORMAL,
+										   !xlrec->deferDefrag, &buffer);
 	if (action == BLK_NEEDS_REDO)
 	{
 		Page		page = (Page) BufferGetPage(buffer);
@@ -8812,11 +9229,15 @@ heap_xlog_prune(XLogReaderState *record)
 		nunused = (end - nowunused);
 		Assert(nunused >= 0);
 
-		/* Update all line pointers per the record, and repair fragmentation */
+		/*
+		 * Update all line pointers per the record, and repair fragmentation
+		 * unless the primary deferred that
+		 */
 		heap_page_prune_execute(buffer,
 								redirected, nredirected,
 								nowdead, ndead,
-								nowunused, nunused);
+								nowunused, nunused,
+								!xlrec->deferDefrag);
 
 		/*
 		 * Note: we don't worry about updating the page's prunability hints.
@@ -9046,13 +9467,37 @@ heap_xlog_visible(XLogReaderState *record)
 		visibilitymap_pin(reln, blkno, &vmbuffer);
 
 		visibilitymap_set(reln, blkno, InvalidBuffer, lsn, vmbuffer,
-						  xlrec->snapshotConflictHorizon, vmbits);
+						  InvalidBuffer, xlrec->snapshotConflictHorizon, vmbits);
 
 		ReleaseBuffer(vmbuffer);
 		FreeFakeRelcacheEntry(reln);
 	}
 	else if (BufferIsValid(vmbuffer))
 		UnlockReleaseBuffer(vmbuffer);
+
+	/*
+	 * Like the visibility map, the tuple count map entry can be set
+	 * regardless of the heap page's LSN; it is only looked at while the
+	 * all-visible bit is set.
+	 */
+	if (XLogRecHasBlockRef(record, 2))
+	{
+		Buffer		tcmbuffer;
+
+		if (XLogReadBufferForRedoExtended(record, 2, RBM_ZERO_ON_ERROR, false,
+										  &tcmbuffer) == BLK_NEEDS_REDO)
+		{
+			int16		ntuples;
+
+			memcpy(&ntuples, XLogRecGetBlockData(record, 2, NULL),
+				   sizeof(int16));
+			tuplecountmap_set_entry(tcmbuffer, blkno, ntuples);
+			PageSetLSN(BufferGetPage(tcmbuffer), lsn);
+			MarkBufferDirty(tcmbuffer);
+		}
+		if (BufferIsValid(tcmbuffer))
+			UnlockReleaseBuffer(tcmbuffer);
+	}
 }
 
 /*
@@ -28,10 +28,47 @@
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "access/heaptoast.h"
+#include "access/relscan.h"
+#include "access/tableam.h"
 #include "access/toast_helper.h"
 #include "access/toast_internals.h"
+#include "executor/tuptable.h"
+#include "storage/read_stream.h"
 #include "utils/fmgroids.h"
 
+/*
+ * State for fetching the chunks of a TOAST value, see toast_begin_fetch().
+ */
+typedef struct ToastChunkFetch
+{
+	IndexScanDesc scan;			/* scan on the toast index */
+	TupleTableSlot *slot;		/* holds the current chunk */
+
+	/* TIDs of all the chunks, in chunk order */
+	ItemPointerData *tids;
+	int			ntids;
+	int			nexttid;		/* next TID to fetch */
+	int			curtid;			/* TID being fetched */
+	bool		call_again;		/* more tuples to try at curtid? */
+
+	/* distinct heap blocks of the TIDs, in the same order, for the stream */
+	BlockNumber *blocks;
+	int			nblocks;
+	int			nextblock;		/* next block to hand to the stream */
+	int			curblock;		/* block of streambuf */
+	ReadStream *stream;			/* NULL if all chunks are on one block */
+	Buffer		streambuf;
+} ToastChunkFetch;
+
+static void toast_begin_fetch(ToastChunkFetch *fetch, Relation toastrel,
+							  Relation toastidx, Snapshot snapshot,
+							  ScanKey keys, int nkeys, int nchunks);
+static HeapTuple toast_fetch_next(ToastChunkFetch *fetch);
+static void toast_end_fetch(ToastChunkFetch *fetch);
+static BlockNumber toast_fetch_next_block(ReadStream *stream,
+										  void *callback_private_data,
+										  void *per_buffer_data);
+
 
 /* ----------
  * heap_toast_delete -
@@ -621,6 +658,11 @@ toast_build_flattened_tuple(TupleDesc tupleDesc,
  * sliceoffset is the byte offset within the TOAST value from which to fetch.
  * slicelength is the number of bytes to be fetched from the TOAST value.
  * result is the varlena into which the results should be written.
+ *
+ * Rather than reading the chunks one at a time as the index scan finds them,
+ * we first collect the TIDs of all the chunks wanted from the index, and then
+ * read their heap blocks through a read stream, so that a value spread over
+ * many blocks that aren't cached yet doesn't cost a synchronous read each.
  */
 void
 heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
@@ -631,7 +673,6 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 	ScanKeyData toastkey[3];
 	TupleDesc	toasttupDesc = toastrel->rd_att;
 	int			nscankeys;
-	SysScanDesc toastscan;
 	HeapTuple	ttup;
 	int32		expectedchunk;
 	int32		totalchunks = ((attrsize - 1) / TOAST_MAX_CHUNK_SIZE) + 1;
@@ -640,6 +681,7 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 	int			num_indexes;
 	int			validIndex;
 	SnapshotData SnapshotToast;
+	ToastChunkFetch fetch;
 
 	/* Look for the valid index of toast relation */
 	validIndex = toast_open_indexes(toastrel,
@@ -684,10 +726,13 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 		nscankeys = 3;
 	}
 
-	/* Prepare for scan */
+	/*
+	 * Prepare for scan.  The scan keys use the heap's attribute numbers,
+	 * which match the toast index's columns.
+	 */
 	init_toast_snapshot(&SnapshotToast);
-	toastscan = systable_beginscan_ordered(toastrel, toastidxs[validIndex],
-										   &SnapshotToast, nscankeys, toastkey);
+	toast_begin_fetch(&fetch, toastrel, toastidxs[validIndex], &SnapshotToast,
+					  toastkey, nscankeys, endchunk - startchunk + 1);
 
 	/*
 	 * Read the chunks by index
@@ -695,7 +740,7 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 	 * The index is on (valueid, chunkidx) so they will come in order
 	 */
 	expectedchunk = startchunk;
-	while ((ttup = systable_getnext_ordered(toastscan, ForwardScanDirection)) != NULL)
+	while ((ttup = toast_fetch_next(&fetch)) != NULL)
 	{
 		int32		curchunk;
 		Pointer		chunk;
@@ -788,6 +833,163 @@ heap_fetch_toast_slice(Relation toastrel, Oid valueid, int32 attrsize,
 								 RelationGetRelationName(toastrel))));
 
 	/* End scan and close indexes. */
-	systable_endscan_ordered(toastscan);
+	toast_end_fetch(&fetch);
 	toast_close_indexes(toastidxs, num_indexes, AccessShareLock);
 }
+
+/*
+ * Start fetching the chunks of a TOAST value that match the given scan keys
+ * on the toast index.  nchunks is the number of chunks expected.
+ *
+ * The TIDs of all matching index entries are collected up front, in index
+ * order, and the distinct heap blocks they point to are read ahead through
+ * a read stream while toast_fetch_next() returns the chunks one by one.
+ */
+static void
+toast_begin_fetch(ToastChunkFetch *fetch, Relation toastrel,
+				  Relation toastidx, Snapshot snapshot,
+				  ScanKey keys, int nkeys, int nchunks)
+{
+	int			maxtids = Max(nchunks, 1);
+	bool	   *recheck;
+
+	fetch->scan = index_beginscan(toastrel, toastidx, snapshot, nkeys, 0);
+	index_rescan(fetch->scan, keys, nkeys, NULL, 0);
+	fetch->slot = table_slot_create(toastrel, NULL);
+
+	/*
+	 * Collect the TIDs.  There is normally one per chunk, but the index can
+	 * also point to dead tuples that VACUUM hasn't removed yet.
+	 */
+	fetch->tids = palloc(sizeof(ItemPointerData) * maxtids);
+	recheck = palloc(sizeof(bool) * maxtids);
+	fetch->ntids = 0;
+	for (;;)
+	{
+		int			n;
+
+		if (fetch->ntids == maxtids)
+		{
+			maxtids *= 2;
+			fetch->tids = repalloc(fetch->tids,
+								   sizeof(ItemPointerData) * maxtids);
+			recheck = repalloc(recheck, sizeof(bool) * maxtids);
+		}
+
+		n = index_getbatch(fetch->scan, ForwardScanDirection,
+						   fetch->tids + fetch->ntids,
+						   recheck + fetch->ntids,
+						   maxtids - fetch->ntids);
+		if (n == 0)
+			break;
+		fetch->ntids += n;
+	}
+	pfree(recheck);
+
+	fetch->nexttid = 0;
+	fetch->curtid = -1;
+	fetch->call_again = false;
+
+	/* Chunks of a value are usually stored next to each other */
+	fetch->blocks = palloc(sizeof(BlockNumber) * Max(fetch->ntids, 1));
+	fetch->nblocks = 0;
+	for (int i = 0; i < fetch->ntids; i++)
+	{
+		BlockNumber blkno = ItemPointerGetBlockNumber(&fetch->tids[i]);
+
+		if (fetch->nblocks == 0 || fetch->blocks[fetch->nblocks - 1] != blkno)
+			fetch->blocks[fetch->nblocks++] = blkno;
+	}
+
+	fetch->nextblock = 0;
+	fetch->curblock = -1;
+	fetch->streambuf = InvalidBuffer;
+	if (fetch->nblocks > 1)
+		fetch->stream = read_stream_begin_relation(READ_STREAM_DEFAULT,
+												   NULL,
+												   toastrel,
+												   MAIN_FORKNUM,
+												   toast_fetch_next_block,
+												   fetch,
+												   0);
+	else
+		fetch->stream = NULL;
+}
+
+/*
+ * Return the next visible chunk tuple, or NULL when there are no more.  The
+ * tuple is valid until the next call.
+ */
+static HeapTuple
+toast_fetch_next(ToastChunkFetch *fetch)
+{
+	for (;;)
+	{
+		bool		all_dead;
+
+		if (!fetch->call_again)
+		{
+			if (fetch->nexttid >= fetch->ntids)
+				return NULL;
+			fetch->curtid = fetch->nexttid++;
+
+			/*
+			 * Keep the stream in step with the TIDs, holding on to the
+			 * buffer of the block we're at, so that the stream can read
+			 * ahead of it.
+			 */
+			if (fetch->stream != NULL &&
+				(fetch->curblock < 0 ||
+				 fetch->blocks[fetch->curblock] !=
+				 ItemPointerGetBlockNumber(&fetch->tids[fetch->curtid])))
+			{
+				if (BufferIsValid(fetch->streambuf))
+					ReleaseBuffer(fetch->streambuf);
+				fetch->streambuf = read_stream_next_buffer(fetch->stream, NULL);
+				fetch->curblock++;
+				Assert(BufferGetBlockNumber(fetch->streambuf) ==
+					   fetch->blocks[fetch->curblock]);
+			}
+		}
+
+		if (table_index_fetch_tuple(fetch->scan->xs_heapfetch,
+									&fetch->tids[fetch->curtid],
+									fetch->scan->xs_snapshot,
+									fetch->slot,
+									&fetch->call_again,
+									&all_dead))
+			return ExecFetchSlotHeapTuple(fetch->slot, false, NULL);
+	}
+}
+
+/*
+ * Release the resources of a chunk fetch.
+ */
+static void
+toast_end_fetch(ToastChunkFetch *fetch)
+{
+	if (BufferIsValid(fetch->streambuf))
+		ReleaseBuffer(fetch->streambuf);
+	if (fetch->stream != NULL)
+		read_stream_end(fetch->stream);
+	ExecDropSingleTupleTableSlot(fetch->slot);
+	index_endscan(fetch->scan);
+	pfree(fetch->tids);
+	pfree(fetch->blocks);
+}
+
+/*
+ * Read stream callback returning the heap blocks of a chunk fetch in turn.
+ */
+static BlockNumber
+toast_fetch_next_block(ReadStream *stream,
+					   void *callback_private_data,
+					   void *per_buffer_data)
+{
+	ToastChunkFetch *fetch = (ToastChunkFetch *) callback_private_data;
+
+	if (fetch->nextblock >= fetch->nblocks)
+		return InvalidBlockNumber;
+
+	return fetch->blocks[fetch->nextblock++];
+}
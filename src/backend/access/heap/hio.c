@@ -211,6 +211,34 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
 	return released_locks;
 }
 
+/*
+ * Return the next page with at least targetFreeSpace bytes free according to
+ * the FSM, for a caller that expects to fill num_pages pages.
+ *
+ * The pages are looked up in one go with GetPagesWithFreeSpace() and
+ * remembered in the bistate, so that the following calls for the same
+ * multi-insert don't have to search the FSM again.  Returns
+ * InvalidBlockNumber if the FSM knows of no suitable page.
+ */
+static BlockNumber
+RelationGetFsmPage(Relation relation, BulkInsertState bistate,
+				   Size targetFreeSpace, int num_pages)
+{
+	if (bistate->next_fsm_page >= bistate->nfsm_pages)
+	{
+		bistate->nfsm_pages =
+			GetPagesWithFreeSpace(relation, targetFreeSpace,
+								  bistate->fsm_pages,
+								  Min(num_pages, BULK_INSERT_FSM_PAGES));
+		bistate->next_fsm_page = 0;
+
+		if (bistate->nfsm_pages == 0)
+			return InvalidBlockNumber;
+	}
+
+	return bistate->fsm_pages[bistate->next_fsm_page++];
+}
+
 /*
  * Extend the relation. By multiple pages, if beneficial.
  *
@@ -301,6 +329,15 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 		if (bistate)
 			extend_by_pages = Max(extend_by_pages, bistate->already_extended_by);
 
+		/*
+		 * If the caller told us how much more data is coming (e.g. COPY from
+		 * a file), extend by that much right away, rather than ramping up.
+		 * Beyond holding the extension lock less often, large extensions let
+		 * mdzeroextend() use fallocate() instead of writing out zeroes.
+		 */
+		if (bistate)
+			extend_by_pages = Max(extend_by_pages, bistate->expected_pages);
+
 		/*
 		 * Can't extend by more than MAX_BUFFERS_TO_EXTEND_BY, we need to pin
 		 * them all concurrently.
@@ -379,31 +416,29 @@ RelationAddBlocks(Relation relation, BulkInsertState bistate,
 
 	/*
 	 * Relation is now extended. Release pins on all buffers, except for the
-	 * first (which we'll return).  If we decided to put pages into the FSM,
-	 * we can do that as part of the same loop.
+	 * first (which we'll return).
 	 */
 	for (uint32 i = 1; i < extend_by_pages; i++)
 	{
-		BlockNumber curBlock = first_block + i;
+		BlockNumber curBlock PG_USED_FOR_ASSERTS_ONLY = first_block + i;
 
 		Assert(curBlock == BufferGetBlockNumber(victim_buffers[i]));
 		Assert(BlockNumberIsValid(curBlock));
 
 		ReleaseBuffer(victim_buffers[i]);
-
-		if (use_fsm && i >= not_in_fsm_pages)
-		{
-			Size		freespace = BufferGetPageSize(victim_buffers[i]) -
-				SizeOfPageHeaderData;
-
-			RecordPageWithFreeSpace(relation, curBlock, freespace);
-		}
 	}
 
+	/*
+	 * If we decided to put pages into the FSM, enter them all at once.  They
+	 * are still new (all zeroes), which RelationGetBufferForTuple() handles
+	 * by initializing them when they're first used.
+	 */
 	if (use_fsm && not_in_fsm_pages < extend_by_pages)
 	{
 		BlockNumber first_fsm_block = first_block + not_in_fsm_pages;
 
+		RecordRangeWithFreeSpace(relation, first_fsm_block, last_block,
+								 BufferGetPageSize(buffer) - SizeOfPageHeaderData);
 		FreeSpaceMapVacuumRange(relation, first_fsm_block, last_block);
 	}
 
@@ -580,9 +615,14 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	{
 		/*
 		 * We have no cached target page, so ask the FSM for an initial
-		 * target.
+		 * target.  If the caller is going to fill several pages, ask for
+		 * all of them at once.
 		 */
-		targetBlock = GetPageWithFreeSpace(relation, targetFreeSpace);
+		if (bistate && num_pages > 1)
+			targetBlock = RelationGetFsmPage(relation, bistate,
+											 targetFreeSpace, num_pages);
+		else
+			targetBlock = GetPageWithFreeSpace(relation, targetFreeSpace);
 	}
 
 	/*
@@ -751,6 +791,15 @@ loop:
 			/* Without FSM, always fall out of the loop and extend */
 			break;
 		}
+		else if (bistate && bistate->next_fsm_page < bistate->nfsm_pages)
+		{
+			/*
+			 * Try the next page of an earlier multi-page FSM lookup, but do
+			 * record the free space of this one.
+			 */
+			RecordPageWithFreeSpace(relation, targetBlock, pageFreeSpace);
+			targetBlock = bistate->fsm_pages[bistate->next_fsm_page++];
+		}
 		else
 		{
 			/*
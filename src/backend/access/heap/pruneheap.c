@@ -97,7 +97,9 @@ static void page_verify_redirects(Page page);
  *
  * This is an opportunistic function.  It will perform housekeeping
  * only if the page heuristically looks like a candidate for pruning and we
- * can acquire buffer cleanup lock without blocking.
+ * can acquire a buffer lock without blocking.  With a cleanup lock we prune
+ * and defragment; if someone else holds a pin, we settle for pruning under
+ * an ordinary exclusive lock and leave the defragmentation for later.
  *
  * Note: this is called quite often.  It's important that it fall out quickly
  * if there's not any use in pruning.
@@ -137,7 +139,7 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 	 * (i.e. no updates/deletes left potentially dead tuples around).
 	 */
 	prune_xid = ((PageHeader) page)->pd_prune_xid;
-	if (!TransactionIdIsValid(prune_xid))
+	if (!TransactionIdIsValid(prune_xid) && !PageNeedsDefrag(page))
 		return;
 
 	/*
@@ -156,10 +158,14 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 	 * TransactionIdLimitedForOldSnapshots() is not cheap, and because not
 	 * unnecessarily relying on old_snapshot_threshold avoids causing
 	 * conflicts.
+	 *
+	 * A page that was pruned without defragmenting it is worth visiting even
+	 * if it has nothing new to be pruned.
 	 */
 	vistest = GlobalVisTestFor(relation);
 
-	if (!GlobalVisTestIsRemovableXid(vistest, prune_xid))
+	if (!PageNeedsDefrag(page) &&
+		!GlobalVisTestIsRemovableXid(vistest, prune_xid))
 	{
 		if (!OldSnapshotThresholdActive())
 			return;
@@ -191,9 +197,25 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 
 	if (PageIsFull(page) || PageGetHeapFreeSpace(page) < minfree)
 	{
+		bool		defragment = true;
+
 		/* OK, try to get exclusive buffer lock */
 		if (!ConditionalLockBufferForCleanup(buffer))
-			return;
+		{
+			/*
+			 * Somebody else has the page pinned, which on a busy page may
+			 * well always be the case.  Dead tuples can still be removed and
+			 * HOT chains shortened under an ordinary exclusive lock, as long
+			 * as we don't move any tuples: backends holding only a pin may
+			 * have pointers to tuples on the page, but the storage of removed
+			 * items stays untouched until a later prune gets a cleanup lock.
+			 * There's no point if only the defragmentation is left to do.
+			 */
+			if (!TransactionIdIsValid(prune_xid) ||
+				!ConditionalLockBuffer(buffer))
+				return;
+			defragment = false;
+		}
 
 		/*
 		 * Now that we have buffer lock, get accurate information about the
@@ -206,7 +228,8 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 						nnewlpdead;
 
 			ndeleted = heap_page_prune(relation, buffer, vistest, limited_xmin,
-									   limited_ts, &nnewlpdead, NULL);
+									   limited_ts, defragment, &nnewlpdead,
+									   NULL);
 
 			/*
 			 * Report the number of tuples reclaimed to pgstats.  This is
@@ -242,7 +265,10 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 /*
  * Prune and repair fragmentation in the specified page.
  *
- * Caller must have pin and buffer cleanup lock on the page.  Note that we
+ * Caller must have pin and buffer cleanup lock on the page, unless it passes
+ * defragment = false.  Then an exclusive lock is enough: items are removed,
+ * but their storage is only reclaimed by a later call that defragments the
+ * page, which is done even if there is nothing else to prune.  Note that we
  * don't update the FSM information for page on caller's behalf.  Caller might
  * also need to account for a reduction in the length of the line pointer
  * array following array truncation by us.
@@ -266,6 +292,7 @@ heap_page_prune(Relation relation, Buffer buffer,
 				GlobalVisState *vistest,
 				TransactionId old_snap_xmin,
 				TimestampTz old_snap_ts,
+				bool defragment,
 				int *nnewlpdead,
 				OffsetNumber *off_loc)
 {
@@ -382,8 +409,9 @@ heap_page_prune(Relation relation, Buffer buffer,
 	/* Any error while applying the changes is critical */
 	START_CRIT_SECTION();
 
-	/* Have we found any prunable items? */
-	if (prstate.nredirected > 0 || prstate.ndead > 0 || prstate.nunused > 0) // 找到了有死亡记录的，有没有使用的，或者重定向的记录
+	/* Have we found any prunable items, or left-over fragmentation? */
+	if (prstate.nredirected > 0 || prstate.ndead > 0 || prstate.nunused > 0 ||
+		(defragment && PageNeedsDefrag(page))) // 找到了有死亡记录的，有没有使用的，或者重定向的记录
 	{
 		/*
 		 * Apply the planned item changes, then repair page fragmentation, and
@@ -392,7 +420,8 @@ heap_page_prune(Relation relation, Buffer buffer,
 		heap_page_prune_execute(buffer,
 								prstate.redirected, prstate.nredirected,
 								prstate.nowdead, prstate.ndead,
-								prstate.nowunused, prstate.nunused);
+								prstate.nowunused, prstate.nunused,
+								defragment);
 
 		/*
 		 * Update the page's pd_prune_xid field to either zero, or the lowest
@@ -418,6 +447,7 @@ heap_page_prune(Relation relation, Buffer buffer,
 			XLogRecPtr	recptr;
 
 			xlrec.isCatalogRel = RelationIsAccessibleInLogicalDecoding(relation);
+			xlrec.deferDefrag = !defragment;
 			xlrec.snapshotConflictHorizon = prstate.snapshotConflictHorizon;
 			xlrec.nredirected = prstate.nredirected;
 			xlrec.ndead = prstate.ndead;
@@ -906,20 +936,23 @@ heap_prune_record_unused(PruneState *prstate, OffsetNumber offnum)
 /*
  * Perform the actual page changes needed by heap_page_prune.
  * It is expected that the caller has a full cleanup lock on the
- * buffer.
+ * buffer, unless defragment is false.  In that case tuple storage is left
+ * where it is, and the page is marked as needing defragmentation.
  */
 void // redirected/nowdead/nowunused实际上是三个数组，它们的个数由后面的整型变量指定
 heap_page_prune_execute(Buffer buffer,
 						OffsetNumber *redirected, int nredirected,
 						OffsetNumber *nowdead, int ndead,
-						OffsetNumber *nowunused, int nunused)
+						OffsetNumber *nowunused, int nunused,
+						bool defragment)
 {
 	Page		page = (Page) BufferGetPage(buffer); // 获取页面内存地址
 	OffsetNumber *offnum;
 	HeapTupleHeader htup PG_USED_FOR_ASSERTS_ONLY;
 
 	/* Shouldn't be called unless there's something to do */
-	Assert(nredirected > 0 || ndead > 0 || nunused > 0); // 只有这三个指标中至少有一个大于0，本函数才会被调用
+	Assert(nredirected > 0 || ndead > 0 || nunused > 0 ||
+		   (defragment && PageNeedsDefrag(page))); // 只有这三个指标中至少有一个大于0，本函数才会被调用
 
 	/* Update all redirected line pointers */
 	offnum = redirected;
@@ -1034,9 +1067,17 @@ heap_page_prune_execute(Buffer buffer,
 
 	/*
 	 * Finally, repair any fragmentation, and update the page's hint bit about
-	 * whether it has free pointers.
+	 * whether it has free pointers.  Without a cleanup lock, just remember
+	 * that the storage of removed items is still to be reclaimed.
 	 */
-	PageRepairFragmentation(page); // 整理这个数据块里面的碎片
+	if (defragment)
+		PageRepairFragmentation(page); // 整理这个数据块里面的碎片
+	else
+	{
+		if (nunused > 0)
+			PageSetHasFreeLinePointers(page);
+		PageSetNeedsDefrag(page);
+	}
 
 	/*
 	 * Now that the page has been modified, assert that redirect items still
@@ -0,0 +1,260 @@
+/*-------------------------------------------------------------------------
+ *
+ * tuplecountmap.c
+ *	  per-page tuple counts for all-visible heap pages
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/heap/tuplecountmap.c
+ *
+ * INTERFACE ROUTINES
+ *		tuplecountmap_exists	- does the relation have a tuple count map?
+ *		tuplecountmap_extend	- make the map cover a number of heap pages
+ *		tuplecountmap_pin		- pin a map page for reading or setting an entry
+ *		tuplecountmap_pin_ok	- check whether the right map page is pinned
+ *		tuplecountmap_get_entry - read an entry of a pinned map page
+ *		tuplecountmap_set_entry - set an entry of a pinned and locked page
+ *		tuplecountmap_get		- read the entry for a heap page
+ *		tuplecountmap_count_page - count the tuples of an all-visible page
+ *
+ * NOTES
+ *
+ * The tuple count map is a fork alongside the visibility map, holding for
+ * each heap page the number of tuples it contained when it was last marked
+ * all-visible.  A sequential scan that doesn't need the contents of the
+ * tuples, only how many there are (as for count(*)), can take the count of
+ * an all-visible page from the map instead of reading the page.
+ *
+ * An entry is meaningful only while the page's all-visible bit is set.  Once
+ * the bit is cleared the entry is stale, but it isn't looked at again until
+ * the bit is set again, and visibilitymap_set() rewrites the entry whenever
+ * it sets the bit, in the same critical section and WAL record.  Entries
+ * store the count plus one, so that a zeroed entry, such as one of a page
+ * past the end of the map or of a map page that was just extended, means
+ * "unknown" and makes the scan read the page as usual.  That also holds for
+ * pages that were all-visible before the map existed.
+ *
+ * The same snapshot argument as in index-only scans makes the lock-free
+ * reads safe: if a scan sees the all-visible bit set, all the tuples counted
+ * were visible to everyone, and so to the scan's snapshot, when the entry
+ * was written; a modification by a transaction the snapshot can't see must
+ * clear the bit, and the bit can't be set again while our snapshot still
+ * holds back the xmin horizon.
+ *
+ * The map is only extended by VACUUM, at the start of its scan of a table
+ * with the tuple_count_map option, so that setting an entry never has to
+ * extend the fork while the caller holds buffer locks.  Pages added to the
+ * table after that have no entries until the next VACUUM.  The map is not
+ * truncated along with the heap: heap pages that are truncated away have
+ * their visibility map bits cleared, which makes their entries irrelevant.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/tuplecountmap.h"
+#include "storage/bufmgr.h"
+#include "storage/smgr.h"
+#include "utils/inval.h"
+#include "utils/rel.h"
+
+
+/* Number of heap pages covered by each map page */
+#define TCM_ENTRIES_PER_PAGE \
+	((BLCKSZ - MAXALIGN(SizeOfPageHeaderData)) / sizeof(uint16))
+
+/* Mapping from heap block number to the right entry in the map */
+#define HEAPBLK_TO_TCMBLOCK(x) ((x) / TCM_ENTRIES_PER_PAGE)
+#define HEAPBLK_TO_TCMENTRY(x) ((x) % TCM_ENTRIES_PER_PAGE)
+
+#define TcmPageGetEntries(page) ((uint16 *) PageGetContents(page))
+
+/*
+ * Return the number of blocks of the map fork, caching it in the smgr
+ * relation the same way the visibility map does.  Extending the map sends
+ * an smgr invalidation, so a cached size doesn't go stale.
+ */
+static BlockNumber
+tcm_nblocks(Relation rel)
+{
+	SMgrRelation reln = RelationGetSmgr(rel);
+
+	if (reln->smgr_cached_nblocks[TUPLECOUNT_FORKNUM] == InvalidBlockNumber)
+	{
+		if (smgrexists(reln, TUPLECOUNT_FORKNUM))
+			smgrnblocks(reln, TUPLECOUNT_FORKNUM);
+		else
+			reln->smgr_cached_nblocks[TUPLECOUNT_FORKNUM] = 0;
+	}
+
+	return reln->smgr_cached_nblocks[TUPLECOUNT_FORKNUM];
+}
+
+/*
+ * tuplecountmap_exists - does the relation have a tuple count map?
+ */
+bool
+tuplecountmap_exists(Relation rel)
+{
+	return tcm_nblocks(rel) > 0;
+}
+
+/*
+ * tuplecountmap_extend - make the map cover the first nheapblocks pages
+ *
+ * The caller must not hold any buffer locks.
+ */
+void
+tuplecountmap_extend(Relation rel, BlockNumber nheapblocks)
+{
+	BlockNumber tcm_nblocks_needed;
+	Buffer		buf;
+
+	if (nheapblocks == 0)
+		return;
+
+	tcm_nblocks_needed = HEAPBLK_TO_TCMBLOCK(nheapblocks - 1) + 1;
+	if (tcm_nblocks(rel) >= tcm_nblocks_needed)
+		return;
+
+	buf = ExtendBufferedRelTo(BMR_REL(rel), TUPLECOUNT_FORKNUM, NULL,
+							  EB_CREATE_FORK_IF_NEEDED |
+							  EB_CLEAR_SIZE_CACHE,
+							  tcm_nblocks_needed,
+							  RBM_ZERO_ON_ERROR);
+	ReleaseBuffer(buf);
+
+	/* see vm_extend() */
+	CacheInvalidateSmgr(RelationGetSmgr(rel)->smgr_rlocator);
+}
+
+/*
+ * tuplecountmap_pin - pin the map page holding the entry for heapBlk
+ *
+ * Like visibilitymap_pin, this keeps *tcmbuf if it already holds the right
+ * page.  *tcmbuf is set to InvalidBuffer if the map doesn't cover heapBlk;
+ * the map is never extended here.  A new page is initialized on the fly, as
+ * in vm_readbuf().
+ */
+void
+tuplecountmap_pin(Relation rel, BlockNumber heapBlk, Buffer *tcmbuf)
+{
+	BlockNumber mapBlock = HEAPBLK_TO_TCMBLOCK(heapBlk);
+
+	/* Reuse the old pinned buffer if possible */
+	if (BufferIsValid(*tcmbuf))
+	{
+		if (BufferGetBlockNumber(*tcmbuf) == mapBlock)
+			return;
+
+		ReleaseBuffer(*tcmbuf);
+		*tcmbuf = InvalidBuffer;
+	}
+
+	if (mapBlock >= tcm_nblocks(rel))
+		return;
+
+	*tcmbuf = ReadBufferExtended(rel, TUPLECOUNT_FORKNUM, mapBlock,
+								 RBM_ZERO_ON_ERROR, NULL);
+	if (PageIsNew(BufferGetPage(*tcmbuf)))
+	{
+		LockBuffer(*tcmbuf, BUFFER_LOCK_EXCLUSIVE);
+		if (PageIsNew(BufferGetPage(*tcmbuf)))
+			PageInit(BufferGetPage(*tcmbuf), BLCKSZ, 0);
+		LockBuffer(*tcmbuf, BUFFER_LOCK_UNLOCK);
+	}
+}
+
+/*
+ * tuplecountmap_pin_ok - is the right map page pinned for heapBlk?
+ */
+bool
+tuplecountmap_pin_ok(BlockNumber heapBlk, Buffer tcmBuf)
+{
+	return BufferIsValid(tcmBuf) &&
+		BufferGetBlockNumber(tcmBuf) == HEAPBLK_TO_TCMBLOCK(heapBlk);
+}
+
+/*
+ * tuplecountmap_get_entry - read the entry for heapBlk from a pinned page
+ *
+ * Returns the tuple count, or -1 if it isn't known.
+ */
+int
+tuplecountmap_get_entry(Buffer tcmBuf, BlockNumber heapBlk)
+{
+	uint16	   *entries;
+
+	Assert(BufferGetBlockNumber(tcmBuf) == HEAPBLK_TO_TCMBLOCK(heapBlk));
+
+	entries = TcmPageGetEntries(BufferGetPage(tcmBuf));
+
+	return (int) entries[HEAPBLK_TO_TCMENTRY(heapBlk)] - 1;
+}
+
+/*
+ * tuplecountmap_set_entry - set the entry for heapBlk
+ *
+ * The caller must hold an exclusive lock on the map page, and takes care of
+ * marking it dirty and WAL-logging the change.  A negative count marks the
+ * entry unknown.
+ */
+void
+tuplecountmap_set_entry(Buffer tcmBuf, BlockNumber heapBlk, int ntuples)
+{
+	Page		page = BufferGetPage(tcmBuf);
+
+	Assert(BufferGetBlockNumber(tcmBuf) == HEAPBLK_TO_TCMBLOCK(heapBlk));
+	Assert(ntuples <= MaxHeapTuplesPerPage);
+
+	/* pages read as zeros in recovery haven't been initialized yet */
+	if (PageIsNew(page))
+		PageInit(page, BLCKSZ, 0);
+
+	TcmPageGetEntries(page)[HEAPBLK_TO_TCMENTRY(heapBlk)] =
+		(uint16) (Max(ntuples, -1) + 1);
+}
+
+/*
+ * tuplecountmap_get - get the tuple count recorded for heapBlk
+ *
+ * Returns -1 if it isn't known.  Like visibilitymap_get_status, this keeps
+ * the map page pinned in *tcmbuf between calls, and takes no lock; the
+ * caller must check the all-visible bit of the page first.
+ */
+int
+tuplecountmap_get(Relation rel, BlockNumber heapBlk, Buffer *tcmbuf)
+{
+	tuplecountmap_pin(rel, heapBlk, tcmbuf);
+	if (!BufferIsValid(*tcmbuf))
+		return -1;
+
+	return tuplecountmap_get_entry(*tcmbuf, heapBlk);
+}
+
+/*
+ * tuplecountmap_count_page - number of tuples on an all-visible heap page
+ *
+ * On an all-visible page every normal line pointer is a live tuple visible
+ * to everyone; redirect and unused line pointers aren't tuples.
+ */
+int
+tuplecountmap_count_page(Page heapPage)
+{
+	OffsetNumber maxoff = PageGetMaxOffsetNumber(heapPage);
+	OffsetNumber offnum;
+	int			ntuples = 0;
+
+	for (offnum = FirstOffsetNumber; offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		if (ItemIdIsNormal(PageGetItemId(heapPage, offnum)))
+			ntuples++;
+	}
+
+	return ntuples;
+}
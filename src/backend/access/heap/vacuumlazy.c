@@ -3,18 +3,18 @@
  * vacuumlazy.c
  *	  Concurrent ("lazy") vacuuming.
  *
- * The major space usage for vacuuming is storage for the array of dead TIDs
- * that are to be removed from indexes.  We want to ensure we can vacuum even
- * the very largest relations with finite memory space usage.  To do that, we
- * set upper bounds on the number of TIDs we can keep track of at once.
+ * The major space usage for vacuuming is storage for the dead TIDs that are
+ * to be removed from indexes.  We want to ensure we can vacuum even the very
+ * largest relations with finite memory space usage.  To do that, we set upper
+ * bounds on the amount of memory used to keep track of dead TIDs at once.
  *
  * We are willing to use at most maintenance_work_mem (or perhaps
- * autovacuum_work_mem) memory space to keep track of dead TIDs.  We initially
- * allocate an array of TIDs of that size, with an upper limit that depends on
- * table size (this limit ensures we don't allocate a huge area uselessly for
- * vacuuming small tables).  If the array threatens to overflow, we must call
- * lazy_vacuum to vacuum indexes (and to vacuum the pages that we've pruned).
- * This frees up the memory space dedicated to storing dead TIDs.
+ * autovacuum_work_mem) memory space to keep track of dead TIDs.  The TIDs are
+ * kept in a TidStore, which groups them by heap block and grows as needed,
+ * so small tables don't pay for the whole budget up front.  If the TidStore
+ * outgrows the budget, we must call lazy_vacuum to vacuum indexes (and to
+ * vacuum the pages that we've pruned).  This frees up the memory space
+ * dedicated to storing dead TIDs.
  *
  * In practice VACUUM will often complete its initial pass over the target
  * heap relation without ever running out of space to store TIDs.  This means
@@ -40,7 +40,9 @@
 #include "access/heapam_xlog.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/tidstore.h"
 #include "access/transam.h"
+#include "access/tuplecountmap.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
 #include "access/xlog.h"
@@ -59,6 +61,7 @@
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "storage/read_stream.h"
 #include "tcop/tcopprot.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
@@ -127,6 +130,22 @@
  */
 #define ParallelVacuumIsActive(vacrel) ((vacrel)->pvs != NULL)
 
+/*
+ * Are the dead items kept in the DSM segment?  Without indexes, every process
+ * taking part in a parallel heap scan vacuums the pages it prunes right away,
+ * so there is nothing to share.
+ */
+#define DeadItemsAreShared(vacrel) \
+	(ParallelVacuumIsActive(vacrel) && (vacrel)->nindexes > 0)
+
+/*
+ * Number of blocks that a participant of a parallel heap scan claims at a
+ * time.  It always scans the whole chunk, even once dead_items is full, so
+ * this must be small enough not to overrun the memory budget by much, but
+ * large enough to keep the reads of each process sequential.
+ */
+#define PARALLEL_VACUUM_CHUNK_SIZE	((BlockNumber) 256)
+
 /* Phases of vacuum during which we report error context. */
 typedef enum
 {
@@ -138,6 +157,56 @@ typedef enum
 	VACUUM_ERRCB_PHASE_TRUNCATE
 } VacErrPhase;
 
+/*
+ * Counters that a worker accumulates for its share of a parallel heap scan.
+ * These are the LVRelState fields of the same names; the leader adds them up
+ * into its own once the workers are done.
+ */
+typedef struct LVScanCounters
+{
+	BlockNumber scanned_pages;
+	BlockNumber frozen_pages;
+	BlockNumber eager_frozen_pages;
+	BlockNumber lpdead_item_pages;
+	BlockNumber missed_dead_pages;
+	BlockNumber nonempty_pages;
+	int64		tuples_deleted;
+	int64		tuples_frozen;
+	int64		lpdead_items;
+	int64		live_tuples;
+	int64		recently_dead_tuples;
+	int64		missed_dead_tuples;
+	TransactionId NewRelfrozenXid;
+	MultiXactId NewRelminMxid;
+	bool		skippedallvis;
+} LVScanCounters;
+
+/*
+ * Shared state of a parallel heap scan, in the parallel vacuum DSM segment.
+ * The leader sets the plain fields before launching workers.
+ */
+typedef struct LVParallelScanShared
+{
+	BlockNumber rel_pages;
+	struct VacuumCutoffs cutoffs;
+	bool		aggressive;
+	bool		skipwithvm;
+	bool		do_index_vacuuming;
+	XLogRecPtr	eager_freeze_lsn;
+
+	/* Next block to hand out; overshoots rel_pages at the end */
+	pg_atomic_uint64 next_block;
+
+	/* Set once dead_items is full, so that nobody claims more blocks */
+	pg_atomic_uint32 dead_items_full;
+
+	/* Set once the leader has triggered the wraparound failsafe */
+	pg_atomic_uint32 failsafe_active;
+
+	/* Counters of each worker, indexed by ParallelWorkerNumber */
+	LVScanCounters worker_counters[FLEXIBLE_ARRAY_MEMBER];
+} LVParallelScanShared;
+
 typedef struct LVRelState
 {
 	/* Target heap relation and its indexes */
@@ -148,6 +217,9 @@ typedef struct LVRelState
 	/* Buffer access strategy and parallel vacuum state */
 	BufferAccessStrategy bstrategy;
 	ParallelVacuumState *pvs; /// 貌似这是一个数组，每一个成员是一个结构体
+	/* Parallel heap scan state (NULL if not used), and its # of workers */
+	LVParallelScanShared *pscan;
+	int			nheap_workers;
 
 	/* Aggressive VACUUM? (must set relfrozenxid >= FreezeLimit) */
 	bool		aggressive;
@@ -164,6 +236,8 @@ typedef struct LVRelState
 	/* VACUUM operation's cutoffs for freezing and pruning */
 	struct VacuumCutoffs cutoffs;
 	GlobalVisState *vistest;
+	/* Eagerly freeze stable pages whose LSN is older than this, if valid */
+	XLogRecPtr	eager_freeze_lsn;
 	/* Tracks oldest extant XID/MXID for setting relfrozenxid/relminmxid */
 	TransactionId NewRelfrozenXid;
 	MultiXactId NewRelminMxid;  /// 这两个域可能是用来更新pg_class里面的relfrozenxid和relminmxid两列  typedef TransactionId MultiXactId;
@@ -186,11 +260,12 @@ typedef struct LVRelState
 	 * lazy_vacuum_heap_rel, which marks the same LP_DEAD line pointers as
 	 * LP_UNUSED during second heap pass.
 	 */
-	VacDeadItems *dead_items;	/* TIDs whose index tuples we'll delete */  // 这个占据最大的内存，死亡记录数组
+	TidStore   *dead_items;		/* TIDs whose index tuples we'll delete */  // 这个占据最大的内存，死亡记录数组
 	BlockNumber rel_pages;		/* total number of pages */
 	BlockNumber scanned_pages;	/* # pages examined (not skipped via VM) */
 	BlockNumber removed_pages;	/* # pages removed by relation truncation */
 	BlockNumber frozen_pages;	/* # pages with newly frozen tuples */
+	BlockNumber eager_frozen_pages; /* # of those frozen only eagerly */
 	BlockNumber lpdead_item_pages;	/* # pages with LP_DEAD items */
 	BlockNumber missed_dead_pages;	/* # pages with missed dead tuples */
 	BlockNumber nonempty_pages; /* actually, last nonempty page + 1 */
@@ -210,6 +285,17 @@ typedef struct LVRelState
 	int64		live_tuples;	/* # live tuples remaining */
 	int64		recently_dead_tuples;	/* # dead, but not yet removable */
 	int64		missed_dead_tuples; /* # removable, but not removed */
+
+	/* State maintained by heap_vac_scan_next_block() */
+	BlockNumber current_block;	/* last block returned */
+	BlockNumber scan_end;		/* end of the range being scanned */
+	BlockNumber next_unskippable_block; /* next unskippable block */
+	bool		next_unskippable_allvis;	/* its visibility status */
+	bool		skipping_current_range; /* skip blocks before it? */
+	Buffer		next_unskippable_vmbuffer;	/* buffer containing its VM bit */
+
+	/* Tuple count map page of the block being processed, if any */
+	Buffer		tcmbuffer;
 } LVRelState;
 
 /*
@@ -241,6 +327,22 @@ typedef struct LVSavedErrInfo
 
 /* non-export function prototypes */
 static void lazy_scan_heap(LVRelState *vacrel);
+static void lazy_scan_heap_parallel(LVRelState *vacrel,
+									BlockNumber *next_fsm_block_to_vacuum);
+static void lazy_scan_heap_blocks(LVRelState *vacrel,
+								  BlockNumber *next_fsm_block_to_vacuum);
+static void lazy_scan_heap_page(LVRelState *vacrel, Buffer buf,
+								BlockNumber blkno,
+								bool all_visible_according_to_vm,
+								Buffer *vmbuffer,
+								BlockNumber *next_fsm_block_to_vacuum);
+static int	lazy_scan_compute_workers(LVRelState *vacrel, int nrequested);
+static void lazy_scan_merge_counters(LVRelState *vacrel,
+									 const LVScanCounters *counters);
+static BlockNumber heap_vac_scan_next_block(ReadStream *stream,
+											void *callback_private_data,
+											void *per_buffer_data);
+static bool heap_vac_scan_next_chunk(LVRelState *vacrel);
 static BlockNumber lazy_scan_skip(LVRelState *vacrel, Buffer *vmbuffer,
 								  BlockNumber next_block,
 								  bool *next_unskippable_allvis,
@@ -257,8 +359,9 @@ static bool lazy_scan_noprune(LVRelState *vacrel, Buffer buf,
 static void lazy_vacuum(LVRelState *vacrel);
 static bool lazy_vacuum_all_indexes(LVRelState *vacrel);
 static void lazy_vacuum_heap_rel(LVRelState *vacrel);
-static int	lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno,
-								  Buffer buffer, int index, Buffer vmbuffer);
+static void lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno,
+								  Buffer buffer, OffsetNumber *deadoffsets,
+								  int num_offsets, Buffer vmbuffer);
 static bool lazy_check_wraparound_failsafe(LVRelState *vacrel);
 static void lazy_cleanup_all_indexes(LVRelState *vacrel);
 static IndexBulkDeleteResult *lazy_vacuum_one_index(Relation indrel,
@@ -275,6 +378,9 @@ static void lazy_truncate_heap(LVRelState *vacrel);
 static BlockNumber count_nondeletable_pages(LVRelState *vacrel,
 											bool *lock_waiter_detected);
 static void dead_items_alloc(LVRelState *vacrel, int nworkers);
+static void dead_items_add(LVRelState *vacrel, BlockNumber blkno,
+						   OffsetNumber *offsets, int num_offsets);
+static void dead_items_reset(LVRelState *vacrel);
 static void dead_items_cleanup(LVRelState *vacrel);
 static bool heap_page_is_all_visible(LVRelState *vacrel, Buffer buf,
 									 TransactionId *visibility_cutoff_xid, bool *all_frozen);
@@ -311,7 +417,8 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 				minmulti_updated;
 	BlockNumber orig_rel_pages,
 				new_rel_pages,
-				new_rel_allvisible;
+				new_rel_allvisible,
+				new_rel_allfrozen;
 	PGRUsage	ru0;
 	TimestampTz starttime = 0;
 	PgStat_Counter startreadtime = 0,
@@ -420,6 +527,7 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 	vacrel->scanned_pages = 0;
 	vacrel->removed_pages = 0;
 	vacrel->frozen_pages = 0;
+	vacrel->eager_frozen_pages = 0;
 	vacrel->lpdead_item_pages = 0;
 	vacrel->missed_dead_pages = 0;
 	vacrel->nonempty_pages = 0;
@@ -475,6 +583,24 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 
 	vacrel->skipwithvm = skipwithvm;
 
+	/*
+	 * With the eager freezing strategy, lazy_scan_prune also freezes pages
+	 * that nobody has modified since the previous VACUUM of the table ended.
+	 * Only WAL-logged relations have page LSNs to tell those apart.  Without
+	 * a previous VACUUM to compare against, nothing is frozen eagerly.
+	 */
+	vacrel->eager_freeze_lsn = InvalidXLogRecPtr;
+	if (vacuum_freeze_strategy == VACUUM_FREEZE_STRATEGY_EAGER &&
+		RelationNeedsWAL(rel))
+	{
+		PgStat_StatTabEntry *tabentry;
+
+		tabentry = pgstat_fetch_stat_tabentry_ext(rel->rd_rel->relisshared,
+												  RelationGetRelid(rel));
+		if (tabentry != NULL)
+			vacrel->eager_freeze_lsn = tabentry->last_vacuum_lsn;
+	}
+
 	if (verbose)
 	{
 		if (vacrel->aggressive)
@@ -499,6 +625,14 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 	lazy_check_wraparound_failsafe(vacrel);
 	dead_items_alloc(vacrel, params->nworkers); // 为死亡记录数组分配内存空间
 
+	/*
+	 * Make the tuple count map cover the table before we start setting
+	 * pages all-visible; pages added after this point get entries the next
+	 * time.  See tuplecountmap.c.
+	 */
+	if (RelationWantsTupleCountMap(rel))
+		tuplecountmap_extend(rel, orig_rel_pages);
+
 	/*
 	 * Call lazy_scan_heap to perform all required heap pruning, index
 	 * vacuuming, and heap vacuuming (plus related processing)
@@ -567,9 +701,11 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 	 * pg_class.relpages to
 	 */
 	new_rel_pages = vacrel->rel_pages;	/* After possible rel truncation */
-	visibilitymap_count(rel, &new_rel_allvisible, NULL);
+	visibilitymap_count(rel, &new_rel_allvisible, &new_rel_allfrozen);
 	if (new_rel_allvisible > new_rel_pages)
 		new_rel_allvisible = new_rel_pages;
+	if (new_rel_allfrozen > new_rel_allvisible)
+		new_rel_allfrozen = new_rel_allvisible;
 
 	/*
 	 * Now actually update rel's pg_class entry.
@@ -592,12 +728,20 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 	 * It seems like a good idea to err on the side of not vacuuming again too
 	 * soon in cases where the failsafe prevented significant amounts of heap
 	 * vacuuming.
+	 *
+	 * The freeze debt is the number of all-visible pages that are not yet
+	 * all-frozen, which an aggressive VACUUM would have to freeze.  The
+	 * current insert LSN tells the next VACUUM which pages have been stable
+	 * since now.
 	 */
 	pgstat_report_vacuum(RelationGetRelid(rel),
 						 rel->rd_rel->relisshared,
 						 Max(vacrel->new_live_tuples, 0),
 						 vacrel->recently_dead_tuples +
-						 vacrel->missed_dead_tuples);
+						 vacrel->missed_dead_tuples,
+						 vacrel->eager_frozen_pages,
+						 new_rel_allvisible - new_rel_allfrozen,
+						 GetXLogInsertRecPtr());
 	pgstat_progress_end_command();
 
 	if (instrument)
@@ -701,6 +845,9 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
 							 orig_rel_pages == 0 ? 100.0 :
 							 100.0 * vacrel->frozen_pages / orig_rel_pages,
 							 (long long) vacrel->tuples_frozen);
+			if (vacrel->eager_frozen_pages > 0)
+				appendStringInfo(&buf, _("eager freezing: %u pages frozen because they were unmodified since the last vacuum\n"),
+								 vacrel->eager_frozen_pages);
 			if (vacrel->do_index_vacuuming)
 			{
 				if (vacrel->nindexes == 0 || vacrel->num_index_scans == 0)
@@ -820,74 +967,222 @@ heap_vacuum_rel(Relation rel, VacuumParams *params,
  *		However, we process indexes in full every time lazy_vacuum is called,
  *		which makes index processing very inefficient when memory is in short
  *		supply.
+ *
+ *		The initial pass can be shared with parallel workers, see
+ *		lazy_scan_heap_parallel.  Index vacuuming may use parallel workers as
+ *		well, but the final pass over the heap is always done by the leader.
  */
 static void // 这个是清理的主要马力函数了
 lazy_scan_heap(LVRelState *vacrel)
 {
 	BlockNumber rel_pages = vacrel->rel_pages,
-				blkno,
-				next_unskippable_block,
 				next_fsm_block_to_vacuum = 0;
-	VacDeadItems *dead_items = vacrel->dead_items; // 这是占用内存最大的数组，里面包含了死亡记录的TD，6个字节
-	Buffer		vmbuffer = InvalidBuffer;
-	bool		next_unskippable_allvis,
-				skipping_current_range; // 如果可以跳过的块小于32个，这个值就为false，否则为true
 	const int	initprog_index[] = {
 		PROGRESS_VACUUM_PHASE,
 		PROGRESS_VACUUM_TOTAL_HEAP_BLKS,
-		PROGRESS_VACUUM_MAX_DEAD_TUPLES
+		PROGRESS_VACUUM_MAX_DEAD_TUPLE_BYTES
 	};
 	int64		initprog_val[3];
 
 	/* Report that we're scanning the heap, advertising total # of blocks */
 	initprog_val[0] = PROGRESS_VACUUM_PHASE_SCAN_HEAP;  // 表示正在处于的阶段
 	initprog_val[1] = rel_pages; // 这张表有多少个数据块
-	initprog_val[2] = dead_items->max_items;  // 共计多少死亡记录
+	initprog_val[2] = TidStoreMaxMemory(vacrel->dead_items);  // 死亡记录最多可以使用的内存
 	pgstat_progress_update_multi_param(3, initprog_index, initprog_val); // 显示此时所处的阶段，总块数，死亡数组记录的体积
 
+	/* Prune and freeze every page that can't be skipped */
+	if (vacrel->pscan != NULL)
+		lazy_scan_heap_parallel(vacrel, &next_fsm_block_to_vacuum);
+	else
+		lazy_scan_heap_blocks(vacrel, &next_fsm_block_to_vacuum);
+
+	/* report that everything is now scanned */
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, rel_pages); // 显示已经扫描了多少块，我们是从0号块开始扫描的，所以这个数字处于总的块数就是总进度
+
+	/* now we can compute the new value for pg_class.reltuples */
+	vacrel->new_live_tuples = vac_estimate_reltuples(vacrel->rel, rel_pages,
+													 vacrel->scanned_pages,
+													 vacrel->live_tuples);
+
+	/*
+	 * Also compute the total number of surviving heap entries.  In the
+	 * (unlikely) scenario that new_live_tuples is -1, take it as zero.
+	 */
+	vacrel->new_rel_tuples =
+		Max(vacrel->new_live_tuples, 0) + vacrel->recently_dead_tuples +
+		vacrel->missed_dead_tuples;
+
+	/*
+	 * Do index vacuuming (call each index's ambulkdelete routine), then do
+	 * related heap vacuuming
+	 */
+	if (TidStoreNumTids(vacrel->dead_items) > 0) // 如果死亡记录中还有剩余的尾巴，再做一次
+		lazy_vacuum(vacrel);
+
+	/*
+	 * Vacuum the remainder of the Free Space Map.  We must do this whether or
+	 * not there were indexes, and whether or not we bypassed index vacuuming.
+	 */
+	if (rel_pages > next_fsm_block_to_vacuum)
+		FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum, rel_pages);
+
+	/* report all blocks vacuumed */
+	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, rel_pages);
+
+	/* Do final index cleanup (call each index's amvacuumcleanup routine) */
+	if (vacrel->nindexes > 0 && vacrel->do_index_cleanup)
+		lazy_cleanup_all_indexes(vacrel);
+}
+
+/*
+ *	lazy_scan_heap_parallel() -- first pass over the heap, with parallel workers
+ *
+ * The leader and the workers claim chunks of blocks from a shared counter, so
+ * each block is scanned by exactly one of them.  Once dead_items is full,
+ * nobody claims another chunk.  When every participant has finished the
+ * chunks it already claimed, the leader adds up their counters, does a round
+ * of index and heap vacuuming, and launches the workers again for the rest of
+ * the heap.
+ */
+static void
+lazy_scan_heap_parallel(LVRelState *vacrel,
+						BlockNumber *next_fsm_block_to_vacuum)
+{
+	LVParallelScanShared *pscan = vacrel->pscan;
+
+	for (;;)
+	{
+		BlockNumber scanned_upto;
+		int			nlaunched;
+
+		/* Publish the state that may have changed since the last round */
+		pscan->do_index_vacuuming = vacrel->do_index_vacuuming;
+		pg_atomic_write_u32(&pscan->failsafe_active,
+							VacuumFailsafeActive ? 1 : 0);
+		pg_atomic_write_u32(&pscan->dead_items_full, 0);
+		for (int i = 0; i < vacrel->nheap_workers; i++)
+		{
+			LVScanCounters *counters = &pscan->worker_counters[i];
+
+			memset(counters, 0, sizeof(LVScanCounters));
+			counters->NewRelfrozenXid = vacrel->cutoffs.OldestXmin;
+			counters->NewRelminMxid = vacrel->cutoffs.OldestMxact;
+		}
+
+		/* Launch the workers, and join the scan ourselves */
+		nlaunched = parallel_vacuum_begin_heap_scan(vacrel->pvs);
+		lazy_scan_heap_blocks(vacrel, NULL);
+		parallel_vacuum_end_heap_scan(vacrel->pvs);
+
+		for (int i = 0; i < nlaunched; i++)
+			lazy_scan_merge_counters(vacrel, &pscan->worker_counters[i]);
+
+		/* The counter overshoots rel_pages once the heap is exhausted */
+		scanned_upto = (BlockNumber) Min(pg_atomic_read_u64(&pscan->next_block),
+										 (uint64) vacrel->rel_pages);
+		if (scanned_upto >= vacrel->rel_pages)
+			break;
+
+		/*
+		 * We stopped early because dead_items filled up.  Perform a round of
+		 * index and heap vacuuming, much like the serial scan does.
+		 */
+		Assert(pg_atomic_read_u32(&pscan->dead_items_full) != 0);
+		vacrel->consider_bypass_optimization = false;
+		lazy_vacuum(vacrel);
+
+		/*
+		 * Vacuum the Free Space Map to make newly-freed space visible on
+		 * upper-level FSM pages.
+		 */
+		FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
+								scanned_upto);
+		*next_fsm_block_to_vacuum = scanned_upto;
+
+		/* Report that we are once again scanning the heap */
+		pgstat_progress_update_param(PROGRESS_VACUUM_PHASE,
+									 PROGRESS_VACUUM_PHASE_SCAN_HEAP);
+	}
+}
+
+/*
+ *	lazy_scan_heap_blocks() -- scan the blocks of the first heap pass
+ *
+ * In a serial VACUUM this scans the whole heap, vacuuming indexes and heap
+ * whenever dead_items fills up.  In a parallel heap scan it is called by the
+ * leader and by each worker, and only scans the chunks of blocks claimed by
+ * the calling process; next_fsm_block_to_vacuum is NULL then, since the
+ * leader takes care of the FSM between rounds.
+ */
+static void
+lazy_scan_heap_blocks(LVRelState *vacrel, BlockNumber *next_fsm_block_to_vacuum)
+{
+	Buffer		vmbuffer = InvalidBuffer;
+	ReadStream *stream;
+
 	/* Set up an initial range of skippable blocks using the visibility map */
-	next_unskippable_block = lazy_scan_skip(vacrel, &vmbuffer, 0,
-											&next_unskippable_allvis,
-											&skipping_current_range); // 从编号为0的数据块开始计算，第一个不能跳过的数据块的编号是多少
+	vacrel->current_block = InvalidBlockNumber;
+	vacrel->next_unskippable_vmbuffer = InvalidBuffer;
+	if (vacrel->pscan == NULL)
+	{
+		vacrel->scan_end = vacrel->rel_pages;
+		vacrel->next_unskippable_block = lazy_scan_skip(vacrel,
+														&vacrel->next_unskippable_vmbuffer,
+														0,
+														&vacrel->next_unskippable_allvis,
+														&vacrel->skipping_current_range); // 从编号为0的数据块开始计算，第一个不能跳过的数据块的编号是多少
+	}
+	else
+	{
+		/* heap_vac_scan_next_block() claims the first chunk */
+		vacrel->scan_end = 0;
+	}
 
-	for (blkno = 0; blkno < rel_pages; blkno++) // 从头开始扫描这张表的每个数据块
+	/*
+	 * Read the blocks that can't be skipped through a read stream, so that
+	 * reads are issued ahead of the page currently being processed.  The
+	 * stream callback decides which blocks to skip, and passes along whether
+	 * the VM said each block was all-visible.
+	 */
+	stream = read_stream_begin_relation(READ_STREAM_MAINTENANCE,
+										vacrel->bstrategy,
+										vacrel->rel,
+										MAIN_FORKNUM,
+										heap_vac_scan_next_block,
+										vacrel,
+										sizeof(bool));
+
+	while (true)
 	{
 		Buffer		buf;
-		Page		page;
+		BlockNumber blkno;
 		bool		all_visible_according_to_vm;
-		LVPagePruneState prunestate;
+		void	   *per_buffer_data;
 
-		if (blkno == next_unskippable_block) // 计算下一个不能跳过的数据块的编号
-		{
-			/*
-			 * Can't skip this page safely.  Must scan the page.  But
-			 * determine the next skippable range after the page first.
-			 */
-			all_visible_according_to_vm = next_unskippable_allvis;
-			next_unskippable_block = lazy_scan_skip(vacrel, &vmbuffer,
-													blkno + 1,
-													&next_unskippable_allvis,
-													&skipping_current_range); // 继续计算下一个不能跳过的数据块
-
-			Assert(next_unskippable_block >= blkno + 1);
-		}
-		else
-		{
-			/* Last page always scanned (may need to set nonempty_pages) */
-			Assert(blkno < rel_pages - 1);
+		buf = read_stream_next_buffer(stream, &per_buffer_data);
 
-			if (skipping_current_range) // 如果可以被跳过的块的总数小于32，就不能被跳过，要依次检查每一个块，否则就跳过大于32个数据块
-				continue;
+		/* The relation (or our share of it) is exhausted */
+		if (!BufferIsValid(buf))
+			break;
 
-			/* Current range is too small to skip -- just scan the page */
-			all_visible_according_to_vm = true;
-		}
+		all_visible_according_to_vm = *((bool *) per_buffer_data);
+		blkno = BufferGetBlockNumber(buf);
 
 		// 扫描的块数scanned_pages不包括被跳过的数据块，所以它的总数是小于等于该表的总块数的
 		vacrel->scanned_pages++; // 这一个数据块要被处理，所以扫描块数要加一
 
-		/* Report as block scanned, update error traceback information */
-		pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno);
+		/*
+		 * Report as block scanned, update error traceback information.  In a
+		 * parallel heap scan, the leader reports how far the participants
+		 * have claimed blocks.
+		 */
+		if (vacrel->pscan == NULL)
+			pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED,
+										 blkno);
+		else if (!IsParallelWorker())
+			pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED,
+										 Min(pg_atomic_read_u64(&vacrel->pscan->next_block),
+											 (uint64) vacrel->rel_pages));
 		update_vacuum_error_info(vacrel, NULL, VACUUM_ERRCB_PHASE_SCAN_HEAP,
 								 blkno, InvalidOffsetNumber);
 
@@ -901,18 +1196,28 @@ lazy_scan_heap(LVRelState *vacrel)
 		 * that point.  This check also provides failsafe coverage for the
 		 * one-pass strategy, and the two-pass strategy with the index_cleanup
 		 * param set to 'off'.
+		 *
+		 * In a parallel heap scan only the leader checks, and passes the
+		 * verdict on to the workers.
 		 */
-		if (vacrel->scanned_pages % FAILSAFE_EVERY_PAGES == 0) // 每扫描512KB个数据块
-			lazy_check_wraparound_failsafe(vacrel);
+		if (!IsParallelWorker() &&
+			vacrel->scanned_pages % FAILSAFE_EVERY_PAGES == 0) // 每扫描512KB个数据块
+		{
+			if (lazy_check_wraparound_failsafe(vacrel) && vacrel->pscan != NULL)
+				pg_atomic_write_u32(&vacrel->pscan->failsafe_active, 1);
+		}
 
 		/*
 		 * Consider if we definitely have enough space to process TIDs on page
-		 * already.  If we are close to overrunning the available space for
+		 * already.  If we have already used up the memory budget for
 		 * dead_items TIDs, pause and do a cycle of vacuuming before we tackle
-		 * this page.
+		 * this page.  The budget may be overrun by the TIDs of the last page
+		 * added, but not by much.  (A parallel heap scan stops handing out
+		 * blocks instead, see dead_items_add.)
 		 */
-		Assert(dead_items->max_items >= MaxHeapTuplesPerPage); // MaxHeapTuplesPerPage的值是291
-		if (dead_items->max_items - dead_items->num_items < MaxHeapTuplesPerPage) // 如果死亡记录快满了，就处理一批
+		if (vacrel->pscan == NULL &&
+			TidStoreMemoryUsage(vacrel->dead_items) >
+			TidStoreMaxMemory(vacrel->dead_items)) // 如果死亡记录占用的内存超过了上限，就处理一批
 		{
 			/*
 			 * Before beginning index vacuuming, we release any pin we may
@@ -925,6 +1230,11 @@ lazy_scan_heap(LVRelState *vacrel)
 				ReleaseBuffer(vmbuffer);
 				vmbuffer = InvalidBuffer;
 			}
+			if (BufferIsValid(vacrel->tcmbuffer))
+			{
+				ReleaseBuffer(vacrel->tcmbuffer);
+				vacrel->tcmbuffer = InvalidBuffer;
+			}
 
 			/* Perform a round of index and heap vacuuming */
 			vacrel->consider_bypass_optimization = false;
@@ -934,9 +1244,9 @@ lazy_scan_heap(LVRelState *vacrel)
 			 * Vacuum the Free Space Map to make newly-freed space visible on
 			 * upper-level FSM pages.  Note we have not yet processed blkno.
 			 */
-			FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum,
+			FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
 									blkno);
-			next_fsm_block_to_vacuum = blkno;
+			*next_fsm_block_to_vacuum = blkno;
 
 			/* Report that we are once again scanning the heap */
 			pgstat_progress_update_param(PROGRESS_VACUUM_PHASE,
@@ -949,327 +1259,461 @@ lazy_scan_heap(LVRelState *vacrel)
 		 * already have the correct page pinned anyway.
 		 */
 		visibilitymap_pin(vacrel->rel, blkno, &vmbuffer); // 把blkno对应的VM数据块搞到内存中，因为VM每块可以记录32672个数据块，所以大部分情况下这个操作很cheap
+		tuplecountmap_pin(vacrel->rel, blkno, &vacrel->tcmbuffer);
 
-		/*
-		 * We need a buffer cleanup lock to prune HOT chains and defragment
-		 * the page in lazy_scan_prune.  But when it's not possible to acquire
-		 * a cleanup lock right away, we may be able to settle for reduced
-		 * processing using lazy_scan_noprune.
-		 */
-		buf = ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
-								 vacrel->bstrategy); // 根据数据块blkno读取数据页到内存，编号是buf
-		page = BufferGetPage(buf); // 就是根据页面编号获得真正的数据指针
-		if (!ConditionalLockBufferForCleanup(buf))
-		{
-			bool		hastup,
-						recordfreespace;
+		lazy_scan_heap_page(vacrel, buf, blkno, all_visible_according_to_vm,
+							&vmbuffer, next_fsm_block_to_vacuum);
+	}
 
-			LockBuffer(buf, BUFFER_LOCK_SHARE);
+	read_stream_end(stream);
 
-			/* Check for new or empty pages before lazy_scan_noprune call */
-			if (lazy_scan_new_or_empty(vacrel, buf, blkno, page, true,
-									   vmbuffer))
-			{
-				/* Processed as new/empty page (lock and pin released) */
-				continue;
-			}
+	vacrel->blkno = InvalidBlockNumber;
+	if (BufferIsValid(vmbuffer))
+		ReleaseBuffer(vmbuffer);
+	if (BufferIsValid(vacrel->tcmbuffer))
+	{
+		ReleaseBuffer(vacrel->tcmbuffer);
+		vacrel->tcmbuffer = InvalidBuffer;
+	}
+	if (BufferIsValid(vacrel->next_unskippable_vmbuffer))
+	{
+		ReleaseBuffer(vacrel->next_unskippable_vmbuffer);
+		vacrel->next_unskippable_vmbuffer = InvalidBuffer;
+	}
+}
 
-			/* Collect LP_DEAD items in dead_items array, count tuples */
-			if (lazy_scan_noprune(vacrel, buf, blkno, page, &hastup,
-								  &recordfreespace))
-			{
-				Size		freespace = 0;
+/*
+ *	lazy_scan_heap_page() -- process one page of the first heap pass
+ *
+ * Prunes and freezes the page, collects its LP_DEAD items, and updates the
+ * visibility map and the FSM for it.  Caller has pinned buf, and the VM page
+ * covering it in *vmbuffer.  We release buf before returning.
+ */
+static void
+lazy_scan_heap_page(LVRelState *vacrel, Buffer buf, BlockNumber blkno,
+					bool all_visible_according_to_vm, Buffer *vmbuffer,
+					BlockNumber *next_fsm_block_to_vacuum)
+{
+	Page		page;
+	LVPagePruneState prunestate;
 
-				/*
-				 * Processed page successfully (without cleanup lock) -- just
-				 * need to perform rel truncation and FSM steps, much like the
-				 * lazy_scan_prune case.  Don't bother trying to match its
-				 * visibility map setting steps, though.
-				 */
-				if (hastup)
-					vacrel->nonempty_pages = blkno + 1;
-				if (recordfreespace)
-					freespace = PageGetHeapFreeSpace(page);
-				UnlockReleaseBuffer(buf);
-				if (recordfreespace)
-					RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
-				continue;
-			}
+	/*
+	 * We need a buffer cleanup lock to prune HOT chains and defragment
+	 * the page in lazy_scan_prune.  But when it's not possible to acquire
+	 * a cleanup lock right away, we may be able to settle for reduced
+	 * processing using lazy_scan_noprune.
+	 */
+	page = BufferGetPage(buf); // 就是根据页面编号获得真正的数据指针
+	if (!ConditionalLockBufferForCleanup(buf))
+	{
+		bool		hastup,
+					recordfreespace;
 
-			/*
-			 * lazy_scan_noprune could not do all required processing.  Wait
-			 * for a cleanup lock, and call lazy_scan_prune in the usual way.
-			 */
-			Assert(vacrel->aggressive);
-			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-			LockBufferForCleanup(buf);
-		}
+		LockBuffer(buf, BUFFER_LOCK_SHARE);
 
-		/* Check for new or empty pages before lazy_scan_prune call */
-		if (lazy_scan_new_or_empty(vacrel, buf, blkno, page, false, vmbuffer))
+		/* Check for new or empty pages before lazy_scan_noprune call */
+		if (lazy_scan_new_or_empty(vacrel, buf, blkno, page, true,
+								   *vmbuffer))
 		{
 			/* Processed as new/empty page (lock and pin released) */
-			continue;
+			return;
 		}
 
-		/*
-		 * Prune, freeze, and count tuples.
-		 *
-		 * Accumulates details of remaining LP_DEAD line pointers on page in
-		 * dead_items array.  This includes LP_DEAD line pointers that we
-		 * pruned ourselves, as well as existing LP_DEAD line pointers that
-		 * were pruned some time earlier.  Also considers freezing XIDs in the
-		 * tuple headers of remaining items with storage.
-		 */
-		lazy_scan_prune(vacrel, buf, blkno, page, &prunestate); // 往死亡记录数组中添加记录
-
-		Assert(!prunestate.all_visible || !prunestate.has_lpdead_items);
-
-		/* Remember the location of the last page with nonremovable tuples */
-		if (prunestate.hastup)
-			vacrel->nonempty_pages = blkno + 1;
-
-		if (vacrel->nindexes == 0) // 该表没有没有索引
+		/* Collect LP_DEAD items in dead_items array, count tuples */
+		if (lazy_scan_noprune(vacrel, buf, blkno, page, &hastup,
+							  &recordfreespace))
 		{
+			Size		freespace = 0;
+
 			/*
-			 * Consider the need to do page-at-a-time heap vacuuming when
-			 * using the one-pass strategy now.
-			 *
-			 * The one-pass strategy will never call lazy_vacuum().  The steps
-			 * performed here can be thought of as the one-pass equivalent of
-			 * a call to lazy_vacuum().
+			 * Processed page successfully (without cleanup lock) -- just
+			 * need to perform rel truncation and FSM steps, much like the
+			 * lazy_scan_prune case.  Don't bother trying to match its
+			 * visibility map setting steps, though.
 			 */
-			if (prunestate.has_lpdead_items)
-			{
-				Size		freespace;
-
-				lazy_vacuum_heap_page(vacrel, blkno, buf, 0, vmbuffer);
+			if (hastup)
+				vacrel->nonempty_pages = blkno + 1;
+			if (recordfreespace)
+				freespace = PageGetHeapFreeSpace(page);
+			UnlockReleaseBuffer(buf);
+			if (recordfreespace)
+				RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
+			return;
+		}
 
-				/* Forget the LP_DEAD items that we just vacuumed */
-				dead_items->num_items = 0; // 处理一个页面，就把这些死的记录清空，为下一个页面做准备
+		/*
+		 * lazy_scan_noprune could not do all required processing.  Wait
+		 * for a cleanup lock, and call lazy_scan_prune in the usual way.
+		 */
+		Assert(vacrel->aggressive);
+		LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+		LockBufferForCleanup(buf);
+	}
 
-				/*
-				 * Periodically perform FSM vacuuming to make newly-freed
-				 * space visible on upper FSM pages.  Note we have not yet
-				 * performed FSM processing for blkno.
-				 */
-				if (blkno - next_fsm_block_to_vacuum >= VACUUM_FSM_EVERY_PAGES)
-				{
-					FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum,
-											blkno);
-					next_fsm_block_to_vacuum = blkno;
-				}
+	/* Check for new or empty pages before lazy_scan_prune call */
+	if (lazy_scan_new_or_empty(vacrel, buf, blkno, page, false, *vmbuffer))
+	{
+		/* Processed as new/empty page (lock and pin released) */
+		return;
+	}
 
-				/*
-				 * Now perform FSM processing for blkno, and move on to next
-				 * page.
-				 *
-				 * Our call to lazy_vacuum_heap_page() will have considered if
-				 * it's possible to set all_visible/all_frozen independently
-				 * of lazy_scan_prune().  Note that prunestate was invalidated
-				 * by lazy_vacuum_heap_page() call.
-				 */
-				freespace = PageGetHeapFreeSpace(page);
+	/*
+	 * Prune, freeze, and count tuples.
+	 *
+	 * Accumulates details of remaining LP_DEAD line pointers on page in
+	 * dead_items array.  This includes LP_DEAD line pointers that we
+	 * pruned ourselves, as well as existing LP_DEAD line pointers that
+	 * were pruned some time earlier.  Also considers freezing XIDs in the
+	 * tuple headers of remaining items with storage.
+	 */
+	lazy_scan_prune(vacrel, buf, blkno, page, &prunestate); // 往死亡记录数组中添加记录
 
-				UnlockReleaseBuffer(buf);
-				RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
-				continue;
-			}
+	Assert(!prunestate.all_visible || !prunestate.has_lpdead_items);
 
-			/*
-			 * There was no call to lazy_vacuum_heap_page() because pruning
-			 * didn't encounter/create any LP_DEAD items that needed to be
-			 * vacuumed.  Prune state has not been invalidated, so proceed
-			 * with prunestate-driven visibility map and FSM steps (just like
-			 * the two-pass strategy).
-			 */
-			Assert(dead_items->num_items == 0);
-		}
+	/* Remember the location of the last page with nonremovable tuples */
+	if (prunestate.hastup)
+		vacrel->nonempty_pages = blkno + 1;
 
+	if (vacrel->nindexes == 0) // 该表没有没有索引
+	{
 		/*
-		 * Handle setting visibility map bit based on information from the VM
-		 * (as of last lazy_scan_skip() call), and from prunestate
+		 * Consider the need to do page-at-a-time heap vacuuming when
+		 * using the one-pass strategy now.
+		 *
+		 * The one-pass strategy will never call lazy_vacuum().  The steps
+		 * performed here can be thought of as the one-pass equivalent of
+		 * a call to lazy_vacuum().
 		 */
-		if (!all_visible_according_to_vm && prunestate.all_visible)
+		if (prunestate.has_lpdead_items)
 		{
-			uint8		flags = VISIBILITYMAP_ALL_VISIBLE;
+			Size		freespace;
+			TidStoreIter *iter;
+			TidStoreIterResult *iter_result;
 
-			if (prunestate.all_frozen)
+			/* dead_items holds just this page's TIDs in this case */
+			iter = TidStoreBeginIterate(vacrel->dead_items);
+			iter_result = TidStoreIterateNext(iter);
+			Assert(iter_result != NULL && iter_result->blkno == blkno);
+			lazy_vacuum_heap_page(vacrel, blkno, buf, iter_result->offsets,
+								  iter_result->num_offsets, *vmbuffer);
+			TidStoreEndIterate(iter);
+
+			/* Forget the LP_DEAD items that we just vacuumed */
+			dead_items_reset(vacrel); // 处理一个页面，就把这些死的记录清空，为下一个页面做准备
+
+			/*
+			 * Periodically perform FSM vacuuming to make newly-freed
+			 * space visible on upper FSM pages.  Note we have not yet
+			 * performed FSM processing for blkno.  In a parallel heap scan
+			 * the leader does all of the FSM vacuuming instead.
+			 */
+			if (next_fsm_block_to_vacuum != NULL &&
+				blkno - *next_fsm_block_to_vacuum >= VACUUM_FSM_EVERY_PAGES)
 			{
-				Assert(!TransactionIdIsValid(prunestate.visibility_cutoff_xid));
-				flags |= VISIBILITYMAP_ALL_FROZEN;
+				FreeSpaceMapVacuumRange(vacrel->rel, *next_fsm_block_to_vacuum,
+										blkno);
+				*next_fsm_block_to_vacuum = blkno;
 			}
 
 			/*
-			 * It should never be the case that the visibility map page is set
-			 * while the page-level bit is clear, but the reverse is allowed
-			 * (if checksums are not enabled).  Regardless, set both bits so
-			 * that we get back in sync.
+			 * Now perform FSM processing for blkno, and move on to next
+			 * page.
 			 *
-			 * NB: If the heap page is all-visible but the VM bit is not set,
-			 * we don't need to dirty the heap page.  However, if checksums
-			 * are enabled, we do need to make sure that the heap page is
-			 * dirtied before passing it to visibilitymap_set(), because it
-			 * may be logged.  Given that this situation should only happen in
-			 * rare cases after a crash, it is not worth optimizing.
+			 * Our call to lazy_vacuum_heap_page() will have considered if
+			 * it's possible to set all_visible/all_frozen independently
+			 * of lazy_scan_prune().  Note that prunestate was invalidated
+			 * by lazy_vacuum_heap_page() call.
 			 */
-			PageSetAllVisible(page);
-			MarkBufferDirty(buf);
-			visibilitymap_set(vacrel->rel, blkno, buf, InvalidXLogRecPtr,
-							  vmbuffer, prunestate.visibility_cutoff_xid,
-							  flags);
+			freespace = PageGetHeapFreeSpace(page);
+
+			UnlockReleaseBuffer(buf);
+			RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
+			return;
 		}
 
 		/*
-		 * As of PostgreSQL 9.2, the visibility map bit should never be set if
-		 * the page-level bit is clear.  However, it's possible that the bit
-		 * got cleared after lazy_scan_skip() was called, so we must recheck
-		 * with buffer lock before concluding that the VM is corrupt.
+		 * There was no call to lazy_vacuum_heap_page() because pruning
+		 * didn't encounter/create any LP_DEAD items that needed to be
+		 * vacuumed.  Prune state has not been invalidated, so proceed
+		 * with prunestate-driven visibility map and FSM steps (just like
+		 * the two-pass strategy).
 		 */
-		else if (all_visible_according_to_vm && !PageIsAllVisible(page) &&
-				 visibilitymap_get_status(vacrel->rel, blkno, &vmbuffer) != 0)
+		Assert(TidStoreNumTids(vacrel->dead_items) == 0);
+	}
+
+	/*
+	 * Handle setting visibility map bit based on information from the VM
+	 * (as of last lazy_scan_skip() call), and from prunestate
+	 */
+	if (!all_visible_according_to_vm && prunestate.all_visible)
+	{
+		uint8		flags = VISIBILITYMAP_ALL_VISIBLE;
+
+		if (prunestate.all_frozen)
 		{
-			elog(WARNING, "page is not marked all-visible but visibility map bit is set in relation \"%s\" page %u",
-				 vacrel->relname, blkno);
-			visibilitymap_clear(vacrel->rel, blkno, vmbuffer,
-								VISIBILITYMAP_VALID_BITS);
+			Assert(!TransactionIdIsValid(prunestate.visibility_cutoff_xid));
+			flags |= VISIBILITYMAP_ALL_FROZEN;
 		}
 
 		/*
-		 * It's possible for the value returned by
-		 * GetOldestNonRemovableTransactionId() to move backwards, so it's not
-		 * wrong for us to see tuples that appear to not be visible to
-		 * everyone yet, while PD_ALL_VISIBLE is already set. The real safe
-		 * xmin value never moves backwards, but
-		 * GetOldestNonRemovableTransactionId() is conservative and sometimes
-		 * returns a value that's unnecessarily small, so if we see that
-		 * contradiction it just means that the tuples that we think are not
-		 * visible to everyone yet actually are, and the PD_ALL_VISIBLE flag
-		 * is correct.
+		 * It should never be the case that the visibility map page is set
+		 * while the page-level bit is clear, but the reverse is allowed
+		 * (if checksums are not enabled).  Regardless, set both bits so
+		 * that we get back in sync.
 		 *
-		 * There should never be LP_DEAD items on a page with PD_ALL_VISIBLE
-		 * set, however.
+		 * NB: If the heap page is all-visible but the VM bit is not set,
+		 * we don't need to dirty the heap page.  However, if checksums
+		 * are enabled, we do need to make sure that the heap page is
+		 * dirtied before passing it to visibilitymap_set(), because it
+		 * may be logged.  Given that this situation should only happen in
+		 * rare cases after a crash, it is not worth optimizing.
 		 */
-		else if (prunestate.has_lpdead_items && PageIsAllVisible(page))
+		PageSetAllVisible(page);
+		MarkBufferDirty(buf);
+		visibilitymap_set(vacrel->rel, blkno, buf, InvalidXLogRecPtr,
+						  *vmbuffer, vacrel->tcmbuffer,
+						  prunestate.visibility_cutoff_xid, flags);
+	}
+
+	/*
+	 * As of PostgreSQL 9.2, the visibility map bit should never be set if
+	 * the page-level bit is clear.  However, it's possible that the bit
+	 * got cleared after lazy_scan_skip() was called, so we must recheck
+	 * with buffer lock before concluding that the VM is corrupt.
+	 */
+	else if (all_visible_according_to_vm && !PageIsAllVisible(page) &&
+			 visibilitymap_get_status(vacrel->rel, blkno, vmbuffer) != 0)
+	{
+		elog(WARNING, "page is not marked all-visible but visibility map bit is set in relation \"%s\" page %u",
+			 vacrel->relname, blkno);
+		visibilitymap_clear(vacrel->rel, blkno, *vmbuffer,
+							VISIBILITYMAP_VALID_BITS);
+	}
+
+	/*
+	 * It's possible for the value returned by
+	 * GetOldestNonRemovableTransactionId() to move backwards, so it's not
+	 * wrong for us to see tuples that appear to not be visible to
+	 * everyone yet, while PD_ALL_VISIBLE is already set. The real safe
+	 * xmin value never moves backwards, but
+	 * GetOldestNonRemovableTransactionId() is conservative and sometimes
+	 * returns a value that's unnecessarily small, so if we see that
+	 * contradiction it just means that the tuples that we think are not
+	 * visible to everyone yet actually are, and the PD_ALL_VISIBLE flag
+	 * is correct.
+	 *
+	 * There should never be LP_DEAD items on a page with PD_ALL_VISIBLE
+	 * set, however.
+	 */
+	else if (prunestate.has_lpdead_items && PageIsAllVisible(page))
+	{
+		elog(WARNING, "page containing LP_DEAD items is marked as all-visible in relation \"%s\" page %u",
+			 vacrel->relname, blkno);
+		PageClearAllVisible(page);
+		MarkBufferDirty(buf);
+		visibilitymap_clear(vacrel->rel, blkno, *vmbuffer,
+							VISIBILITYMAP_VALID_BITS);
+	}
+
+	/*
+	 * If the all-visible page is all-frozen but not marked as such yet,
+	 * mark it as all-frozen.  Note that all_frozen is only valid if
+	 * all_visible is true, so we must check both prunestate fields.
+	 */
+	else if (all_visible_according_to_vm && prunestate.all_visible &&
+			 prunestate.all_frozen &&
+			 !VM_ALL_FROZEN(vacrel->rel, blkno, vmbuffer))
+	{
+		/*
+		 * Avoid relying on all_visible_according_to_vm as a proxy for the
+		 * page-level PD_ALL_VISIBLE bit being set, since it might have
+		 * become stale -- even when all_visible is set in prunestate
+		 */
+		if (!PageIsAllVisible(page))
 		{
-			elog(WARNING, "page containing LP_DEAD items is marked as all-visible in relation \"%s\" page %u",
-				 vacrel->relname, blkno);
-			PageClearAllVisible(page);
+			PageSetAllVisible(page);
 			MarkBufferDirty(buf);
-			visibilitymap_clear(vacrel->rel, blkno, vmbuffer,
-								VISIBILITYMAP_VALID_BITS);
 		}
 
 		/*
-		 * If the all-visible page is all-frozen but not marked as such yet,
-		 * mark it as all-frozen.  Note that all_frozen is only valid if
-		 * all_visible is true, so we must check both prunestate fields.
+		 * Set the page all-frozen (and all-visible) in the VM.
+		 *
+		 * We can pass InvalidTransactionId as our visibility_cutoff_xid,
+		 * since a snapshotConflictHorizon sufficient to make everything
+		 * safe for REDO was logged when the page's tuples were frozen.
 		 */
-		else if (all_visible_according_to_vm && prunestate.all_visible &&
-				 prunestate.all_frozen &&
-				 !VM_ALL_FROZEN(vacrel->rel, blkno, &vmbuffer))
-		{
-			/*
-			 * Avoid relying on all_visible_according_to_vm as a proxy for the
-			 * page-level PD_ALL_VISIBLE bit being set, since it might have
-			 * become stale -- even when all_visible is set in prunestate
-			 */
-			if (!PageIsAllVisible(page))
-			{
-				PageSetAllVisible(page);
-				MarkBufferDirty(buf);
-			}
+		Assert(!TransactionIdIsValid(prunestate.visibility_cutoff_xid));
+		visibilitymap_set(vacrel->rel, blkno, buf, InvalidXLogRecPtr,
+						  *vmbuffer, vacrel->tcmbuffer, InvalidTransactionId,
+						  VISIBILITYMAP_ALL_VISIBLE |
+						  VISIBILITYMAP_ALL_FROZEN);
+	}
 
-			/*
-			 * Set the page all-frozen (and all-visible) in the VM.
-			 *
-			 * We can pass InvalidTransactionId as our visibility_cutoff_xid,
-			 * since a snapshotConflictHorizon sufficient to make everything
-			 * safe for REDO was logged when the page's tuples were frozen.
-			 */
-			Assert(!TransactionIdIsValid(prunestate.visibility_cutoff_xid));
+	/*
+	 * If the page was already all-visible, its tuple count map entry may be
+	 * missing, because the page was set all-visible before the map covered
+	 * it.  Record it now, without changing the visibility map bits.  The
+	 * cleanup lock keeps the bits from being cleared under us.
+	 */
+	else if (all_visible_according_to_vm && prunestate.all_visible &&
+			 PageIsAllVisible(page) && BufferIsValid(vacrel->tcmbuffer) &&
+			 tuplecountmap_get_entry(vacrel->tcmbuffer, blkno) !=
+			 tuplecountmap_count_page(page))
+	{
+		uint8		flags = visibilitymap_get_status(vacrel->rel, blkno,
+													 vmbuffer);
+
+		if (flags & VISIBILITYMAP_ALL_VISIBLE)
 			visibilitymap_set(vacrel->rel, blkno, buf, InvalidXLogRecPtr,
-							  vmbuffer, InvalidTransactionId,
-							  VISIBILITYMAP_ALL_VISIBLE |
-							  VISIBILITYMAP_ALL_FROZEN);
-		}
+							  *vmbuffer, vacrel->tcmbuffer,
+							  InvalidTransactionId, flags);
+	}
 
+	/*
+	 * Final steps for block: drop cleanup lock, record free space in the
+	 * FSM
+	 */
+	if (prunestate.has_lpdead_items && vacrel->do_index_vacuuming)
+	{
 		/*
-		 * Final steps for block: drop cleanup lock, record free space in the
-		 * FSM
+		 * Wait until lazy_vacuum_heap_rel() to save free space.  This
+		 * doesn't just save us some cycles; it also allows us to record
+		 * any additional free space that lazy_vacuum_heap_page() will
+		 * make available in cases where it's possible to truncate the
+		 * page's line pointer array.
+		 *
+		 * Note: It's not in fact 100% certain that we really will call
+		 * lazy_vacuum_heap_rel() -- lazy_vacuum() might yet opt to skip
+		 * index vacuuming (and so must skip heap vacuuming).  This is
+		 * deemed okay because it only happens in emergencies, or when
+		 * there is very little free space anyway. (Besides, we start
+		 * recording free space in the FSM once index vacuuming has been
+		 * abandoned.)
+		 *
+		 * Note: The one-pass (no indexes) case is only supposed to make
+		 * it this far when there were no LP_DEAD items during pruning.
 		 */
-		if (prunestate.has_lpdead_items && vacrel->do_index_vacuuming)
+		Assert(vacrel->nindexes > 0);
+		UnlockReleaseBuffer(buf);
+	}
+	else
+	{
+		Size		freespace = PageGetHeapFreeSpace(page);
+
+		UnlockReleaseBuffer(buf);
+		RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
+	}
+}
+
+/*
+ *	heap_vac_scan_next_block() -- read stream callback for lazy_scan_heap
+ *
+ * Returns the next block that the first pass over the heap needs to scan, or
+ * InvalidBlockNumber once all blocks have been considered.  Blocks are
+ * skipped in ranges chosen by lazy_scan_skip().  *per_buffer_data is set to
+ * whether the visibility map said the returned block was all-visible.
+ *
+ * In a parallel heap scan, we only consider the blocks up to scan_end, and
+ * then move on to the next chunk of blocks not yet claimed by anyone.
+ */
+static BlockNumber
+heap_vac_scan_next_block(ReadStream *stream,
+						 void *callback_private_data,
+						 void *per_buffer_data)
+{
+	LVRelState *vacrel = callback_private_data;
+	bool	   *all_visible_according_to_vm = per_buffer_data;
+
+	for (;;)
+	{
+		/* relies on InvalidBlockNumber + 1 overflowing to 0 on first call */
+		BlockNumber next_block = vacrel->current_block + 1;
+
+		if (next_block >= vacrel->scan_end)
+		{
+			if (vacrel->pscan == NULL || !heap_vac_scan_next_chunk(vacrel))
+				return InvalidBlockNumber;
+			continue;
+		}
+
+		if (next_block == vacrel->next_unskippable_block)
 		{
 			/*
-			 * Wait until lazy_vacuum_heap_rel() to save free space.  This
-			 * doesn't just save us some cycles; it also allows us to record
-			 * any additional free space that lazy_vacuum_heap_page() will
-			 * make available in cases where it's possible to truncate the
-			 * page's line pointer array.
-			 *
-			 * Note: It's not in fact 100% certain that we really will call
-			 * lazy_vacuum_heap_rel() -- lazy_vacuum() might yet opt to skip
-			 * index vacuuming (and so must skip heap vacuuming).  This is
-			 * deemed okay because it only happens in emergencies, or when
-			 * there is very little free space anyway. (Besides, we start
-			 * recording free space in the FSM once index vacuuming has been
-			 * abandoned.)
-			 *
-			 * Note: The one-pass (no indexes) case is only supposed to make
-			 * it this far when there were no LP_DEAD items during pruning.
+			 * Can't skip this page safely.  Must scan the page.  But
+			 * determine the next skippable range after the page first.
 			 */
-			Assert(vacrel->nindexes > 0);
-			UnlockReleaseBuffer(buf);
+			*all_visible_according_to_vm = vacrel->next_unskippable_allvis;
+			vacrel->next_unskippable_block =
+				lazy_scan_skip(vacrel, &vacrel->next_unskippable_vmbuffer,
+							   next_block + 1,
+							   &vacrel->next_unskippable_allvis,
+							   &vacrel->skipping_current_range);
+
+			Assert(vacrel->next_unskippable_block >= next_block + 1);
+			vacrel->current_block = next_block;
+			return next_block;
 		}
-		else
-		{
-			Size		freespace = PageGetHeapFreeSpace(page);
 
-			UnlockReleaseBuffer(buf);
-			RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
-		}
-	}
+		/* Last page always scanned (may need to set nonempty_pages) */
+		Assert(next_block < vacrel->rel_pages - 1);
 
-	vacrel->blkno = InvalidBlockNumber;
-	if (BufferIsValid(vmbuffer))
-		ReleaseBuffer(vmbuffer);
+		if (vacrel->skipping_current_range)
+		{
+			/* Jump straight to the next unskippable block */
+			vacrel->current_block = vacrel->next_unskippable_block - 1;
+			continue;
+		}
 
-	/* report that everything is now scanned */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_SCANNED, blkno); // 显示已经扫描了多少块，我们是从0号块开始扫描的，所以这个数字处于总的块数就是总进度
+		/* Current range is too small to skip -- just scan the page */
+		*all_visible_according_to_vm = true;
+		vacrel->current_block = next_block;
+		return next_block;
+	}
+}
 
-	/* now we can compute the new value for pg_class.reltuples */
-	vacrel->new_live_tuples = vac_estimate_reltuples(vacrel->rel, rel_pages,
-													 vacrel->scanned_pages,
-													 vacrel->live_tuples);
+/*
+ *	heap_vac_scan_next_chunk() -- claim a chunk of blocks in a parallel heap scan
+ *
+ * Returns false when there's nothing left to claim, either because the heap
+ * is exhausted or because dead_items is full and the leader has to vacuum
+ * indexes first.  Otherwise sets up heap_vac_scan_next_block() to scan the
+ * chunk.
+ */
+static bool
+heap_vac_scan_next_chunk(LVRelState *vacrel)
+{
+	LVParallelScanShared *pscan = vacrel->pscan;
+	uint64		start;
 
-	/*
-	 * Also compute the total number of surviving heap entries.  In the
-	 * (unlikely) scenario that new_live_tuples is -1, take it as zero.
-	 */
-	vacrel->new_rel_tuples =
-		Max(vacrel->new_live_tuples, 0) + vacrel->recently_dead_tuples +
-		vacrel->missed_dead_tuples;
+	/* Stop throttling ourselves if the leader has triggered the failsafe */
+	if (IsParallelWorker() && !VacuumFailsafeActive &&
+		pg_atomic_read_u32(&pscan->failsafe_active) != 0)
+	{
+		VacuumFailsafeActive = true;
+		VacuumCostActive = false;
+		VacuumCostBalance = 0;
+		vacrel->do_index_vacuuming = false;
+	}
 
-	/*
-	 * Do index vacuuming (call each index's ambulkdelete routine), then do
-	 * related heap vacuuming
-	 */
-	if (dead_items->num_items > 0) // 如果死亡记录数组中还有剩余的尾巴，再做一次
-		lazy_vacuum(vacrel);
+	if (pg_atomic_read_u32(&pscan->dead_items_full) != 0)
+		return false;
 
-	/*
-	 * Vacuum the remainder of the Free Space Map.  We must do this whether or
-	 * not there were indexes, and whether or not we bypassed index vacuuming.
-	 */
-	if (blkno > next_fsm_block_to_vacuum)
-		FreeSpaceMapVacuumRange(vacrel->rel, next_fsm_block_to_vacuum, blkno);
+	start = pg_atomic_fetch_add_u64(&pscan->next_block,
+									PARALLEL_VACUUM_CHUNK_SIZE);
+	if (start >= vacrel->rel_pages)
+		return false;
 
-	/* report all blocks vacuumed */
-	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, blkno);
+	/* relies on InvalidBlockNumber + 1 overflowing to 0 for block 0 */
+	vacrel->current_block = (BlockNumber) start - 1;
+	vacrel->scan_end = (BlockNumber) Min(start + PARALLEL_VACUUM_CHUNK_SIZE,
+										 (uint64) vacrel->rel_pages);
+	vacrel->next_unskippable_block =
+		lazy_scan_skip(vacrel, &vacrel->next_unskippable_vmbuffer,
+					   (BlockNumber) start,
+					   &vacrel->next_unskippable_allvis,
+					   &vacrel->skipping_current_range);
 
-	/* Do final index cleanup (call each index's amvacuumcleanup routine) */
-	if (vacrel->nindexes > 0 && vacrel->do_index_cleanup)
-		lazy_cleanup_all_indexes(vacrel);
+	return true;
 }
 
 /*
@@ -1285,6 +1729,7 @@ lazy_scan_heap(LVRelState *vacrel)
  *
  * Sets *skipping_current_range to indicate if caller should skip this range.
  * Costs and benefits drive our decision.  Very small ranges won't be skipped.
+ * A range never extends past vacrel->scan_end.
  *
  * Note: our opinion of which blocks can be skipped can go stale immediately.
  * It's okay if caller "misses" a page whose all-visible or all-frozen marking
@@ -1304,7 +1749,7 @@ lazy_scan_skip(LVRelState *vacrel, Buffer *vmbuffer, BlockNumber next_block,
 	bool		skipsallvis = false;
 
 	*next_unskippable_allvis = true;
-	while (next_unskippable_block < rel_pages) // rel_pages表示这张表的数据块的总个数
+	while (next_unskippable_block < vacrel->scan_end) // scan_end在串行扫描时就是这张表的数据块的总个数
 	{
 		uint8		mapbits = visibilitymap_get_status(vacrel->rel,
 													   next_unskippable_block,
@@ -1498,7 +1943,7 @@ lazy_scan_new_or_empty(LVRelState *vacrel, Buffer buf, BlockNumber blkno,
 
 			PageSetAllVisible(page);
 			visibilitymap_set(vacrel->rel, blkno, buf, InvalidXLogRecPtr,
-							  vmbuffer, InvalidTransactionId,
+							  vmbuffer, vacrel->tcmbuffer, InvalidTransactionId,
 							  VISIBILITYMAP_ALL_VISIBLE | VISIBILITYMAP_ALL_FROZEN);
 			END_CRIT_SECTION();
 		}
@@ -1554,6 +1999,9 @@ lazy_scan_prune(LVRelState *vacrel,
 	int			nnewlpdead;
 	HeapPageFreeze pagefrz;
 	int64		fpi_before = pgWalUsage.wal_fpi;
+	XLogRecPtr	page_lsn = PageGetLSN(page);
+	bool		freeze_for_fpi,
+				freeze_eagerly;
 	OffsetNumber deadoffsets[MaxHeapTuplesPerPage]; // 死亡记录数组，最大291个元素
 	HeapTupleFreeze frozen[MaxHeapTuplesPerPage];
 
@@ -1590,7 +2038,7 @@ retry:
 	 * that were deleted from indexes.
 	 */
 	tuples_deleted = heap_page_prune(rel, buf, vacrel->vistest,
-									 InvalidTransactionId, 0, &nnewlpdead,
+									 InvalidTransactionId, 0, true, &nnewlpdead,
 									 &vacrel->offnum);
 
 	/*
@@ -1800,10 +2248,22 @@ retry:
 	 * one XID/MXID from before FreezeLimit/MultiXactCutoff is present.  Also
 	 * freeze when pruning generated an FPI, if doing so means that we set the
 	 * page all-frozen afterwards (might not happen until final heap pass).
+	 *
+	 * With the eager strategy, also freeze a page that we can set all-frozen
+	 * right away if nothing but VACUUM has modified it since the previous
+	 * VACUUM ended (its LSN from before pruning is older).  Such a page is
+	 * unlikely to be modified again soon, and we're dirtying it to set it
+	 * all-visible anyway, so freezing it now is cheaper than making some
+	 * future aggressive VACUUM read and freeze it all over again.
 	 */
-	if (pagefrz.freeze_required || tuples_frozen == 0 ||
-		(prunestate->all_visible && prunestate->all_frozen &&
-		 fpi_before != pgWalUsage.wal_fpi))
+	freeze_for_fpi = (prunestate->all_visible && prunestate->all_frozen &&
+					  fpi_before != pgWalUsage.wal_fpi);
+	freeze_eagerly = (!pagefrz.freeze_required && !freeze_for_fpi &&
+					  tuples_frozen > 0 &&
+					  prunestate->all_visible && prunestate->all_frozen &&
+					  page_lsn < vacrel->eager_freeze_lsn);
+	if (pagefrz.freeze_required || tuples_frozen == 0 || freeze_for_fpi ||
+		freeze_eagerly)
 	{
 		/*
 		 * We're freezing the page.  Our final NewRelfrozenXid doesn't need to
@@ -1833,6 +2293,8 @@ retry:
 			TransactionId snapshotConflictHorizon;
 
 			vacrel->frozen_pages++;
+			if (freeze_eagerly)
+				vacrel->eager_frozen_pages++;
 
 			/*
 			 * We can use visibility_cutoff_xid as our cutoff for conflicts
@@ -1896,25 +2358,12 @@ retry:
 	/*
 	 * Now save details of the LP_DEAD items from the page in vacrel
 	 */
-	if (lpdead_items > 0) // 把死亡记录放在vacrel的大数组中
+	if (lpdead_items > 0) // 把死亡记录放在vacrel的dead_items中
 	{
-		VacDeadItems *dead_items = vacrel->dead_items;
-		ItemPointerData tmp;
-
 		vacrel->lpdead_item_pages++;
 		prunestate->has_lpdead_items = true;
 
-		ItemPointerSetBlockNumber(&tmp, blkno); // 把块号保存进去
-
-		for (int i = 0; i < lpdead_items; i++)
-		{
-			ItemPointerSetOffsetNumber(&tmp, deadoffsets[i]); // 把记录指针下标保存进去
-			dead_items->items[dead_items->num_items++] = tmp; // 加入到大的数组中
-		}
-
-		Assert(dead_items->num_items <= dead_items->max_items);
-		pgstat_progress_update_param(PROGRESS_VACUUM_NUM_DEAD_TUPLES, 
-									 dead_items->num_items); // 更新一下系统视图，显示目前找到了多少死亡记录
+		dead_items_add(vacrel, blkno, deadoffsets, lpdead_items);
 
 		/*
 		 * It was convenient to ignore LP_DEAD items in all_visible earlier on
@@ -2135,9 +2584,6 @@ lazy_scan_noprune(LVRelState *vacrel,
 	}
 	else
 	{
-		VacDeadItems *dead_items = vacrel->dead_items;
-		ItemPointerData tmp;
-
 		/*
 		 * Page has LP_DEAD items, and so any references/TIDs that remain in
 		 * indexes will be deleted during index vacuuming (and then marked
@@ -2145,17 +2591,7 @@ lazy_scan_noprune(LVRelState *vacrel,
 		 */
 		vacrel->lpdead_item_pages++;
 
-		ItemPointerSetBlockNumber(&tmp, blkno);
-
-		for (int i = 0; i < lpdead_items; i++)
-		{
-			ItemPointerSetOffsetNumber(&tmp, deadoffsets[i]);
-			dead_items->items[dead_items->num_items++] = tmp;
-		}
-
-		Assert(dead_items->num_items <= dead_items->max_items);
-		pgstat_progress_update_param(PROGRESS_VACUUM_NUM_DEAD_TUPLES,
-									 dead_items->num_items);
+		dead_items_add(vacrel, blkno, deadoffsets, lpdead_items);
 
 		vacrel->lpdead_items += lpdead_items;
 
@@ -2204,7 +2640,7 @@ lazy_vacuum(LVRelState *vacrel) // 这个函数做index vacuuming和heap vacuumi
 	if (!vacrel->do_index_vacuuming)
 	{
 		Assert(!vacrel->do_index_cleanup);
-		vacrel->dead_items->num_items = 0;
+		dead_items_reset(vacrel);
 		return;
 	}
 
@@ -2233,7 +2669,7 @@ lazy_vacuum(LVRelState *vacrel) // 这个函数做index vacuuming和heap vacuumi
 		BlockNumber threshold;
 
 		Assert(vacrel->num_index_scans == 0);
-		Assert(vacrel->lpdead_items == vacrel->dead_items->num_items);
+		Assert(vacrel->lpdead_items == TidStoreNumTids(vacrel->dead_items));
 		Assert(vacrel->do_index_vacuuming);
 		Assert(vacrel->do_index_cleanup);
 
@@ -2245,7 +2681,7 @@ lazy_vacuum(LVRelState *vacrel) // 这个函数做index vacuuming和heap vacuumi
 		 * it's a proxy for the number of heap pages whose visibility map bits
 		 * cannot be set on account of bypassing index and heap vacuuming.
 		 *
-		 * We apply one further precautionary test: the space currently used
+		 * We apply one further precautionary test: the memory currently used
 		 * to store the TIDs (TIDs that now all point to LP_DEAD items) must
 		 * not exceed 32MB.  This limits the risk that we will bypass index
 		 * vacuuming again and again until eventually there is a VACUUM whose
@@ -2261,7 +2697,7 @@ lazy_vacuum(LVRelState *vacrel) // 这个函数做index vacuuming和heap vacuumi
 		 */
 		threshold = (double) vacrel->rel_pages * BYPASS_THRESHOLD_PAGES;
 		bypass = (vacrel->lpdead_item_pages < threshold &&
-				  vacrel->lpdead_items < MAXDEADITEMS(32L * 1024L * 1024L));
+				  TidStoreMemoryUsage(vacrel->dead_items) < 32L * 1024L * 1024L);
 	}
 
 	if (bypass)
@@ -2306,7 +2742,7 @@ lazy_vacuum(LVRelState *vacrel) // 这个函数做index vacuuming和heap vacuumi
 	 * Forget the LP_DEAD items that we just vacuumed (or just decided to not
 	 * vacuum)
 	 */
-	vacrel->dead_items->num_items = 0; // 清空死亡记录数组
+	dead_items_reset(vacrel); // 清空死亡记录
 }
 
 /*
@@ -2379,7 +2815,7 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
 	 * place).
 	 */
 	Assert(vacrel->num_index_scans > 0 ||
-		   vacrel->dead_items->num_items == vacrel->lpdead_items);
+		   TidStoreNumTids(vacrel->dead_items) == vacrel->lpdead_items);
 	Assert(allindexes || VacuumFailsafeActive);
 
 	/*
@@ -2398,7 +2834,7 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
 /*
  *	lazy_vacuum_heap_rel() -- second pass over the heap for two pass strategy
  *
- * This routine marks LP_DEAD items in vacrel->dead_items array as LP_UNUSED.
+ * This routine marks LP_DEAD items in vacrel->dead_items as LP_UNUSED.
  * Pages that never had lazy_scan_prune record LP_DEAD items are not visited
  * at all.
  *
@@ -2413,13 +2849,15 @@ lazy_vacuum_all_indexes(LVRelState *vacrel)
  * tuples until we've removed their index entries, and we want to process
  * index entry removal in batches as large as possible. // 必须先清空索引的记录，再清空堆表中的记录
  */
-static void // 对堆表的第二轮扫描，并不是扫描整个堆表，而是死亡记录数组中的内容
+static void // 对堆表的第二轮扫描，并不是扫描整个堆表，而是死亡记录中的内容
 lazy_vacuum_heap_rel(LVRelState *vacrel)
 {
-	int			index = 0;
+	int64		vacuumed_items = 0;
 	BlockNumber vacuumed_pages = 0;
 	Buffer		vmbuffer = InvalidBuffer;
 	LVSavedErrInfo saved_err_info;
+	TidStoreIter *iter;
+	TidStoreIterResult *iter_result;
 
 	Assert(vacrel->do_index_vacuuming);
 	Assert(vacrel->do_index_cleanup);
@@ -2434,7 +2872,8 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 							 VACUUM_ERRCB_PHASE_VACUUM_HEAP,
 							 InvalidBlockNumber, InvalidOffsetNumber);
 
-	while (index < vacrel->dead_items->num_items) // 扫描死亡记录的数组
+	iter = TidStoreBeginIterate(vacrel->dead_items);
+	while ((iter_result = TidStoreIterateNext(iter)) != NULL) // 按块号顺序扫描死亡记录
 	{
 		BlockNumber blkno;
 		Buffer		buf;
@@ -2443,7 +2882,7 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 
 		vacuum_delay_point();
 
-		blkno = ItemPointerGetBlockNumber(&vacrel->dead_items->items[index]); // 获得该TID的数据块的块号
+		blkno = iter_result->blkno; // 获得数据块的块号
 		vacrel->blkno = blkno;
 
 		/*
@@ -2452,12 +2891,15 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 		 * already have the correct page pinned anyway.
 		 */
 		visibilitymap_pin(vacrel->rel, blkno, &vmbuffer); // 把这个数据块对应的VM读入到内存
+		tuplecountmap_pin(vacrel->rel, blkno, &vacrel->tcmbuffer);
 
 		/* We need a non-cleanup exclusive lock to mark dead_items unused */
 		buf = ReadBufferExtended(vacrel->rel, MAIN_FORKNUM, blkno, RBM_NORMAL,
 								 vacrel->bstrategy);
 		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
-		index = lazy_vacuum_heap_page(vacrel, blkno, buf, index, vmbuffer);
+		lazy_vacuum_heap_page(vacrel, blkno, buf, iter_result->offsets,
+							  iter_result->num_offsets, vmbuffer);
+		vacuumed_items += iter_result->num_offsets;
 
 		/* Now that we've vacuumed the page, record its available space */
 		page = BufferGetPage(buf);
@@ -2467,45 +2909,50 @@ lazy_vacuum_heap_rel(LVRelState *vacrel)
 		RecordPageWithFreeSpace(vacrel->rel, blkno, freespace);
 		vacuumed_pages++;
 	}
+	TidStoreEndIterate(iter);
 
 	vacrel->blkno = InvalidBlockNumber;
 	if (BufferIsValid(vmbuffer))
 		ReleaseBuffer(vmbuffer);
+	if (BufferIsValid(vacrel->tcmbuffer))
+	{
+		ReleaseBuffer(vacrel->tcmbuffer);
+		vacrel->tcmbuffer = InvalidBuffer;
+	}
 
 	/*
 	 * We set all LP_DEAD items from the first heap pass to LP_UNUSED during
 	 * the second heap pass.  No more, no less.
 	 */
-	Assert(index > 0);
+	Assert(vacuumed_items > 0);
 	Assert(vacrel->num_index_scans > 1 ||
-		   (index == vacrel->lpdead_items &&
+		   (vacuumed_items == vacrel->lpdead_items &&
 			vacuumed_pages == vacrel->lpdead_item_pages));
 
 	ereport(DEBUG2,
 			(errmsg("table \"%s\": removed %lld dead item identifiers in %u pages",
-					vacrel->relname, (long long) index, vacuumed_pages)));
+					vacrel->relname, (long long) vacuumed_items, vacuumed_pages)));
 
 	/* Revert to the previous phase information for error traceback */
 	restore_vacuum_error_info(vacrel, &saved_err_info);
 }
 
 /*
- *	lazy_vacuum_heap_page() -- free page's LP_DEAD items listed in the
- *						  vacrel->dead_items array.
+ *	lazy_vacuum_heap_page() -- free page's LP_DEAD items listed in
+ *						  deadoffsets.
  *
  * Caller must have an exclusive buffer lock on the buffer (though a full
  * cleanup lock is also acceptable).  vmbuffer must be valid and already have
  * a pin on blkno's visibility map page.
  *
- * index is an offset into the vacrel->dead_items array for the first listed
- * LP_DEAD item on the page.  The return value is the first index immediately
- * after all LP_DEAD items for the same page in the array.
+ * deadoffsets holds the offsets of the page's LP_DEAD items, as stored in
+ * vacrel->dead_items.
  */
-static int // index是在死亡记录数组中，该页的第一个LP_DEAD的记录编号
+static void // deadoffsets是该页中LP_DEAD的记录编号
 lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno, Buffer buffer,
-					  int index, Buffer vmbuffer)
+					  OffsetNumber *deadoffsets, int num_offsets,
+					  Buffer vmbuffer)
 {
-	VacDeadItems *dead_items = vacrel->dead_items;
 	Page		page = BufferGetPage(buffer);
 	OffsetNumber unused[MaxHeapTuplesPerPage]; // 本函数只处理一个页面，所以最多291条记录足够了
 	int			nunused = 0;
@@ -2524,16 +2971,11 @@ lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno, Buffer buffer,
 
 	START_CRIT_SECTION();
 
-	for (; index < dead_items->num_items; index++) // 扫描死亡记录数组
+	for (int i = 0; i < num_offsets; i++) // 扫描本页的死亡记录
 	{
-		BlockNumber tblk;
-		OffsetNumber toff;
+		OffsetNumber toff = deadoffsets[i];
 		ItemId		itemid;
 
-		tblk = ItemPointerGetBlockNumber(&dead_items->items[index]);
-		if (tblk != blkno) // 已经不是本块了，所以就跳出循环后返回
-			break;				/* past end of tuples for this block */
-		toff = ItemPointerGetOffsetNumber(&dead_items->items[index]);
 		itemid = PageGetItemId(page, toff); // itemid指向页面的该条记录的指针
 
 		Assert(ItemIdIsDead(itemid) && !ItemIdHasStorage(itemid));
@@ -2598,12 +3040,12 @@ lazy_vacuum_heap_page(LVRelState *vacrel, BlockNumber blkno, Buffer buffer,
 
 		PageSetAllVisible(page);
 		visibilitymap_set(vacrel->rel, blkno, buffer, InvalidXLogRecPtr,
-						  vmbuffer, visibility_cutoff_xid, flags);
+						  vmbuffer, vacrel->tcmbuffer, visibility_cutoff_xid,
+						  flags);
 	}
 
 	/* Revert to the previous phase information for error traceback */
 	restore_vacuum_error_info(vacrel, &saved_err_info);
-	return index;
 }
 
 /*
@@ -3109,67 +3551,32 @@ count_nondeletable_pages(LVRelState *vacrel, bool *lock_waiter_detected)
 }
 
 /*
- * Returns the number of dead TIDs that VACUUM should allocate space to
- * store, given a heap rel of size vacrel->rel_pages, and given current
- * maintenance_work_mem setting (or current autovacuum_work_mem setting,
- * when applicable).
- *
- * See the comments at the head of this file for rationale.
- */
-static int
-dead_items_max_items(LVRelState *vacrel)
-{
-	int64		max_items; // 它的单位不是字节，而是字节/6，因为每个TID都是6个字节
-	int			vac_work_mem = IsAutoVacuumWorkerProcess() &&
-		autovacuum_work_mem != -1 ?
-		autovacuum_work_mem : maintenance_work_mem; // 如果autovacuum_work_mem没有设置，就取maintenance_work_mem的值
-
-	if (vacrel->nindexes > 0) // 如果有索引的话，这是最常见的情况。按照vac_work_mem的大小分配，如果超过了总块数/291，就按照后者为准
-	{
-		BlockNumber rel_pages = vacrel->rel_pages;
-
-		max_items = MAXDEADITEMS(vac_work_mem * 1024L); // vac_work_mem的缺省单位是KB
-		max_items = Min(max_items, INT_MAX);
-		max_items = Min(max_items, MAXDEADITEMS(MaxAllocSize)); // MaxAllocSize是1GB，这里限制了最多不能超过1GB的内存使用量
-
-		/* curious coding here to ensure the multiplication can't overflow */
-		if ((BlockNumber) (max_items / MaxHeapTuplesPerPage) > rel_pages)
-			max_items = rel_pages * MaxHeapTuplesPerPage; //rel_pages是这个表的总的块数，每块最多291条记录，所以。。。
-
-		/* stay sane if small maintenance_work_mem */
-		max_items = Max(max_items, MaxHeapTuplesPerPage); // 确保最小值是291
-	}
-	else // 这张表没有索引，就简单了，只要设置为291就行了，因为没有索引的表，直接对堆表的数据进行一个页面一个页面的处理
-	{
-		/* One-pass case only stores a single heap page's TIDs at a time */
-		max_items = MaxHeapTuplesPerPage;
-	}
-
-	return (int) max_items;
-}
-
-/*
- * Allocate dead_items (either using palloc, or in dynamic shared memory).
+ * Allocate dead_items (either in local memory, or in dynamic shared memory).
  * Sets dead_items in vacrel for caller.
  *
  * Also handles parallel initialization as part of allocating dead_items in
  * DSM when required.
  */
-static void // 分配死亡记录数组的内存，挂在vacrel->dead_items中
+static void // 分配死亡记录的存储结构，挂在vacrel->dead_items中
 dead_items_alloc(LVRelState *vacrel, int nworkers)
 {
-	VacDeadItems *dead_items;
-	int			max_items;
+	int			vac_work_mem = IsAutoVacuumWorkerProcess() &&
+		autovacuum_work_mem != -1 ?
+		autovacuum_work_mem : maintenance_work_mem; // 如果autovacuum_work_mem没有设置，就取maintenance_work_mem的值
+	int			nheap_workers = 0;
 
-	max_items = dead_items_max_items(vacrel); // 在这里确定要分配的TID的总个数，最高不超过1GB字节的内存使用
-	Assert(max_items >= MaxHeapTuplesPerPage); // MaxHeapTuplesPerPage就是291
+	if (nworkers >= 0)
+		nheap_workers = lazy_scan_compute_workers(vacrel, nworkers);
 
 	/*
 	 * Initialize state for a parallel vacuum.  As of now, only one worker can
-	 * be used for an index, so we invoke parallelism only if there are at
-	 * least two indexes on a table.
+	 * be used for an index, so we invoke parallelism for indexes only if
+	 * there are at least two indexes on a table.  The heap scan can use
+	 * parallel workers whenever the table is large enough.
 	 */
-	if (nworkers >= 0 && vacrel->nindexes > 1 && vacrel->do_index_vacuuming)
+	if (nworkers >= 0 &&
+		((vacrel->nindexes > 1 && vacrel->do_index_vacuuming) ||
+		 nheap_workers > 0))
 	{
 		/*
 		 * Since parallel workers cannot access data in temporary tables, we
@@ -3189,24 +3596,104 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 		else
 			vacrel->pvs = parallel_vacuum_init(vacrel->rel, vacrel->indrels,
 											   vacrel->nindexes, nworkers,
-											   max_items,
+											   nheap_workers,
+											   add_size(offsetof(LVParallelScanShared, worker_counters),
+														mul_size(sizeof(LVScanCounters),
+																 nheap_workers)),
+											   vac_work_mem,
 											   vacrel->verbose ? INFO : DEBUG2,
 											   vacrel->bstrategy);
 
+		/* Set up the shared state of the parallel heap scan, if any */
+		if (ParallelVacuumIsActive(vacrel) && nheap_workers > 0)
+		{
+			LVParallelScanShared *pscan;
+
+			pscan = parallel_vacuum_get_heap_scan_state(vacrel->pvs);
+			pscan->rel_pages = vacrel->rel_pages;
+			pscan->cutoffs = vacrel->cutoffs;
+			pscan->aggressive = vacrel->aggressive;
+			pscan->skipwithvm = vacrel->skipwithvm;
+			pscan->do_index_vacuuming = vacrel->do_index_vacuuming;
+			pscan->eager_freeze_lsn = vacrel->eager_freeze_lsn;
+			pg_atomic_init_u64(&pscan->next_block, 0);
+			pg_atomic_init_u32(&pscan->dead_items_full, 0);
+			pg_atomic_init_u32(&pscan->failsafe_active, 0);
+
+			vacrel->pscan = pscan;
+			vacrel->nheap_workers = nheap_workers;
+		}
+
 		/* If parallel mode started, dead_items space is allocated in DSM */
-		if (ParallelVacuumIsActive(vacrel))
+		if (DeadItemsAreShared(vacrel))
 		{
 			vacrel->dead_items = parallel_vacuum_get_dead_items(vacrel->pvs);
 			return;
 		}
 	}
 
-	/* Serial VACUUM case */
-	dead_items = (VacDeadItems *) palloc(vac_max_items_to_alloc_size(max_items)); // 在内存中按照max_items指定的大小分配数组保存死亡记录的TID
-	dead_items->max_items = max_items;
-	dead_items->num_items = 0;
+	/*
+	 * Serial VACUUM case.  The TidStore only allocates memory as TIDs are
+	 * added, so there's no need to size it to the table.  In the one-pass
+	 * case it never holds more than one heap page's TIDs anyway.
+	 */
+	vacrel->dead_items = TidStoreCreateLocal((size_t) vac_work_mem * 1024);
+}
 
-	vacrel->dead_items = dead_items;
+/*
+ * Add the given LP_DEAD offsets of a heap page to dead_items, and report the
+ * new totals.
+ */
+static void
+dead_items_add(LVRelState *vacrel, BlockNumber blkno, OffsetNumber *offsets,
+			   int num_offsets)
+{
+	TidStore   *dead_items = vacrel->dead_items;
+	const int	prog_index[2] = {
+		PROGRESS_VACUUM_NUM_DEAD_TUPLES,
+		PROGRESS_VACUUM_DEAD_TUPLE_BYTES
+	};
+	int64		prog_val[2];
+
+	TidStoreLockExclusive(dead_items);
+	TidStoreSetBlockOffsets(dead_items, blkno, offsets, num_offsets);
+	prog_val[0] = TidStoreNumTids(dead_items);
+	prog_val[1] = TidStoreMemoryUsage(dead_items);
+	TidStoreUnlock(dead_items);
+
+	/*
+	 * In a parallel heap scan, stop everybody from claiming more blocks once
+	 * the memory budget is used up.  The leader does a round of index and
+	 * heap vacuuming when all participants are done with their chunks.
+	 */
+	if (vacrel->pscan != NULL && vacrel->nindexes > 0 &&
+		prog_val[1] > TidStoreMaxMemory(dead_items))
+		pg_atomic_write_u32(&vacrel->pscan->dead_items_full, 1);
+
+	/* Workers don't report progress, the leader does */
+	if (!IsParallelWorker())
+		pgstat_progress_update_multi_param(2, prog_index, prog_val); // 更新一下系统视图，显示目前找到了多少死亡记录
+}
+
+/*
+ * Forget all collected dead items.
+ */
+static void
+dead_items_reset(LVRelState *vacrel)
+{
+	if (DeadItemsAreShared(vacrel))
+	{
+		parallel_vacuum_reset_dead_items(vacrel->pvs);
+		vacrel->dead_items = parallel_vacuum_get_dead_items(vacrel->pvs);
+	}
+	else
+	{
+		size_t		max_bytes = TidStoreMaxMemory(vacrel->dead_items);
+
+		/* Recreating the store is cheaper than emptying it */
+		TidStoreDestroy(vacrel->dead_items);
+		vacrel->dead_items = TidStoreCreateLocal(max_bytes);
+	}
 }
 
 /*
@@ -3215,15 +3702,169 @@ dead_items_alloc(LVRelState *vacrel, int nworkers)
 static void
 dead_items_cleanup(LVRelState *vacrel)
 {
-	if (!ParallelVacuumIsActive(vacrel))
+	if (!DeadItemsAreShared(vacrel))
 	{
-		/* Don't bother with pfree here */
-		return;
+		TidStoreDestroy(vacrel->dead_items);
+		vacrel->dead_items = NULL;
+		if (!ParallelVacuumIsActive(vacrel))
+			return;
 	}
 
 	/* End parallel mode */
 	parallel_vacuum_end(vacrel->pvs, vacrel->indstats);
 	vacrel->pvs = NULL;
+	vacrel->pscan = NULL;
+}
+
+/*
+ * Compute the number of parallel workers to use for the first pass over the
+ * heap.  Like compute_parallel_worker() does for a parallel sequential scan,
+ * we use none below min_parallel_table_scan_size, and one more each time the
+ * table triples in size.  nrequested caps the result if it's positive.
+ */
+static int
+lazy_scan_compute_workers(LVRelState *vacrel, int nrequested)
+{
+	int			heap_parallel_threshold;
+	int			parallel_workers = 1;
+
+	/*
+	 * We don't allow performing parallel operation in standalone backend or
+	 * when parallelism is disabled.
+	 */
+	if (!IsUnderPostmaster || max_parallel_maintenance_workers == 0)
+		return 0;
+
+	if (vacrel->rel_pages < (BlockNumber) min_parallel_table_scan_size)
+		return 0;
+
+	heap_parallel_threshold = Max(min_parallel_table_scan_size, 1);
+	while (vacrel->rel_pages >= (BlockNumber) (heap_parallel_threshold * 3))
+	{
+		parallel_workers++;
+		heap_parallel_threshold *= 3;
+		if (heap_parallel_threshold > INT_MAX / 3)
+			break;				/* avoid overflow */
+	}
+
+	if (nrequested > 0)
+		parallel_workers = Min(nrequested, parallel_workers);
+
+	/* Cap by max_parallel_maintenance_workers */
+	return Min(parallel_workers, max_parallel_maintenance_workers);
+}
+
+/*
+ * Add the counters of a parallel heap scan worker to the leader's.
+ */
+static void
+lazy_scan_merge_counters(LVRelState *vacrel, const LVScanCounters *counters)
+{
+	vacrel->scanned_pages += counters->scanned_pages;
+	vacrel->frozen_pages += counters->frozen_pages;
+	vacrel->eager_frozen_pages += counters->eager_frozen_pages;
+	vacrel->lpdead_item_pages += counters->lpdead_item_pages;
+	vacrel->missed_dead_pages += counters->missed_dead_pages;
+	vacrel->nonempty_pages = Max(vacrel->nonempty_pages,
+								 counters->nonempty_pages);
+	vacrel->tuples_deleted += counters->tuples_deleted;
+	vacrel->tuples_frozen += counters->tuples_frozen;
+	vacrel->lpdead_items += counters->lpdead_items;
+	vacrel->live_tuples += counters->live_tuples;
+	vacrel->recently_dead_tuples += counters->recently_dead_tuples;
+	vacrel->missed_dead_tuples += counters->missed_dead_tuples;
+
+	/* relfrozenxid and relminmxid can't advance past any worker's */
+	if (TransactionIdPrecedes(counters->NewRelfrozenXid,
+							  vacrel->NewRelfrozenXid))
+		vacrel->NewRelfrozenXid = counters->NewRelfrozenXid;
+	if (MultiXactIdPrecedes(counters->NewRelminMxid, vacrel->NewRelminMxid))
+		vacrel->NewRelminMxid = counters->NewRelminMxid;
+	if (counters->skippedallvis)
+		vacrel->skippedallvis = true;
+}
+
+/*
+ *	heap_vacuum_parallel_scan() -- a worker's share of a parallel heap scan
+ *
+ * Called by parallel_vacuum_main() in the workers launched by
+ * parallel_vacuum_begin_heap_scan().  dead_items is the shared TidStore, or
+ * NULL if the table has no indexes.  state is the LVParallelScanShared set up
+ * by the leader, where we leave our counters for it to pick up.
+ */
+void
+heap_vacuum_parallel_scan(Relation rel, int nindexes, TidStore *dead_items,
+						  void *state, BufferAccessStrategy bstrategy)
+{
+	LVParallelScanShared *pscan = (LVParallelScanShared *) state;
+	LVScanCounters *counters;
+	LVRelState *vacrel;
+	ErrorContextCallback errcallback;
+
+	Assert(IsParallelWorker());
+	Assert(nindexes == 0 || dead_items != NULL);
+
+	vacrel = (LVRelState *) palloc0(sizeof(LVRelState));
+	vacrel->dbname = get_database_name(MyDatabaseId);
+	vacrel->relnamespace = get_namespace_name(RelationGetNamespace(rel));
+	vacrel->relname = pstrdup(RelationGetRelationName(rel));
+	vacrel->indname = NULL;
+	vacrel->phase = VACUUM_ERRCB_PHASE_UNKNOWN;
+	errcallback.callback = vacuum_error_callback;
+	errcallback.arg = vacrel;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/*
+	 * Set up the state the leader decided on.  Use our own vistest, which is
+	 * at least as aggressive as the leader's since OldestXmin was computed
+	 * before the workers started.
+	 */
+	vacrel->rel = rel;
+	vacrel->nindexes = nindexes;
+	vacrel->bstrategy = bstrategy;
+	vacrel->pscan = pscan;
+	vacrel->aggressive = pscan->aggressive;
+	vacrel->skipwithvm = pscan->skipwithvm;
+	vacrel->do_index_vacuuming = pscan->do_index_vacuuming;
+	vacrel->cutoffs = pscan->cutoffs;
+	vacrel->eager_freeze_lsn = pscan->eager_freeze_lsn;
+	vacrel->vistest = GlobalVisTestFor(rel);
+	vacrel->NewRelfrozenXid = vacrel->cutoffs.OldestXmin;
+	vacrel->NewRelminMxid = vacrel->cutoffs.OldestMxact;
+	vacrel->rel_pages = pscan->rel_pages;
+
+	/* Without indexes, we vacuum each page right away, as in the leader */
+	if (nindexes > 0)
+		vacrel->dead_items = dead_items;
+	else
+		vacrel->dead_items = TidStoreCreateLocal((size_t) maintenance_work_mem * 1024);
+
+	lazy_scan_heap_blocks(vacrel, NULL);
+
+	/* Leave our counters for the leader */
+	counters = &pscan->worker_counters[ParallelWorkerNumber];
+	counters->scanned_pages = vacrel->scanned_pages;
+	counters->frozen_pages = vacrel->frozen_pages;
+	counters->eager_frozen_pages = vacrel->eager_frozen_pages;
+	counters->lpdead_item_pages = vacrel->lpdead_item_pages;
+	counters->missed_dead_pages = vacrel->missed_dead_pages;
+	counters->nonempty_pages = vacrel->nonempty_pages;
+	counters->tuples_deleted = vacrel->tuples_deleted;
+	counters->tuples_frozen = vacrel->tuples_frozen;
+	counters->lpdead_items = vacrel->lpdead_items;
+	counters->live_tuples = vacrel->live_tuples;
+	counters->recently_dead_tuples = vacrel->recently_dead_tuples;
+	counters->missed_dead_tuples = vacrel->missed_dead_tuples;
+	counters->NewRelfrozenXid = vacrel->NewRelfrozenXid;
+	counters->NewRelminMxid = vacrel->NewRelminMxid;
+	counters->skippedallvis = vacrel->skippedallvis;
+
+	if (nindexes == 0)
+		TidStoreDestroy(vacrel->dead_items);
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
 }
 
 /*
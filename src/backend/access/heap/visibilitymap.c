@@ -19,6 +19,7 @@
  *		visibilitymap_count  - count number of bits set in visibility map
  *		visibilitymap_prepare_truncate -
  *			prepare for truncation of the visibility map
+ *		visibilitymap_clear_count - count of all-visible bits cleared so far
  *
  * NOTES
  *
@@ -82,18 +83,34 @@
  * But when a bit is cleared, we don't have to do that because it's always
  * safe to clear a bit in the map from correctness point of view.
  *
+ * CLEAR COUNTERS
+ *
+ * Whenever an all-visible bit is cleared, we also bump a counter in shared
+ * memory, chosen by hashing the relation's file locator.  Someone who has
+ * checked a set of bits can remember the counter value read before checking
+ * them, and later know that none of them has been cleared since, as long as
+ * the counter hasn't moved, without looking at the map again.  nbtree uses
+ * this for its all-visible hints on leaf pages.  Relations sharing a counter
+ * only make each other's hints go stale sooner.  The counters are not
+ * preserved across restarts, so they are only good for state that isn't
+ * either.
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
 #include "access/heapam_xlog.h"
+#include "access/tuplecountmap.h"
 #include "access/visibilitymap.h"
 #include "access/xloginsert.h"
 #include "access/xlogutils.h"
 #include "miscadmin.h"
 #include "port/pg_bitutils.h"
+#include "common/hashfn.h"
+#include "port/atomics.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "utils/inval.h"
 
@@ -124,7 +141,13 @@
 #define FROZEN_MASK64	UINT64CONST(0xaaaaaaaaaaaaaaaa) /* The upper bit of each
 														 * bit pair */
 
+/* Number of all-visible clear counters, see CLEAR COUNTERS above */
+#define VM_CLEAR_COUNTERS	1024
+
+static pg_atomic_uint64 *VisibilityMapClearCounters = NULL;
+
 /* prototypes for internal routines */
+static pg_atomic_uint64 *vm_clear_counter(Relation rel);
 static Buffer vm_readbuf(Relation rel, BlockNumber blkno, bool extend);
 static Buffer vm_extend(Relation rel, BlockNumber vm_nblocks);
 
@@ -162,10 +185,22 @@ visibilitymap_clear(Relation rel, BlockNumber heapBlk, Buffer vmbuf, uint8 flags
 
 	if (map[mapByte] & mask)
 	{
+		bool		was_all_visible;
+
+		was_all_visible =
+			(map[mapByte] & (VISIBILITYMAP_ALL_VISIBLE << mapOffset)) != 0;
 		map[mapByte] &= ~mask;
 
 		MarkBufferDirty(vmbuf);
 		cleared = true;
+
+		/*
+		 * Tell holders of all-visible hints that this bit is gone.  The
+		 * atomic add is a full barrier, so whoever sees the new count also
+		 * sees the cleared bit.
+		 */
+		if (was_all_visible && (flags & VISIBILITYMAP_ALL_VISIBLE))
+			pg_atomic_fetch_add_u64(vm_clear_counter(rel), 1);
 	}
 
 	LockBuffer(vmbuf, BUFFER_LOCK_UNLOCK); // 对这个页面进行解锁
@@ -241,17 +276,25 @@ visibilitymap_pin_ok(BlockNumber heapBlk, Buffer vmbuf)
  * You must pass a buffer containing the correct map page to this function.
  * Call visibilitymap_pin first to pin the right one. This function doesn't do
  * any I/O.
+ *
+ * If the relation has a tuple count map covering heapBlk, the caller passes
+ * the map page pinned with tuplecountmap_pin as tcmBuf, and the page's tuple
+ * count is recorded in the same WAL record; otherwise tcmBuf is
+ * InvalidBuffer.  In recovery the count is replayed separately, so tcmBuf is
+ * always InvalidBuffer there.
  */
 void
 visibilitymap_set(Relation rel, BlockNumber heapBlk, Buffer heapBuf,
-				  XLogRecPtr recptr, Buffer vmBuf, TransactionId cutoff_xid,
-				  uint8 flags)
+				  XLogRecPtr recptr, Buffer vmBuf, Buffer tcmBuf,
+				  TransactionId cutoff_xid, uint8 flags)
 {
 	BlockNumber mapBlock = HEAPBLK_TO_MAPBLOCK(heapBlk);
 	uint32		mapByte = HEAPBLK_TO_MAPBYTE(heapBlk);
 	uint8		mapOffset = HEAPBLK_TO_OFFSET(heapBlk);
 	Page		page;
 	uint8	   *map;
+	int			ntuples = -1;
+	bool		tcm_changed = false;
 
 #ifdef TRACE_VISIBILITYMAP
 	elog(DEBUG1, "vm_set %s %d", RelationGetRelationName(rel), heapBlk);
@@ -272,23 +315,43 @@ visibilitymap_set(Relation rel, BlockNumber heapBlk, Buffer heapBuf,
 	if (!BufferIsValid(vmBuf) || BufferGetBlockNumber(vmBuf) != mapBlock)
 		elog(ERROR, "wrong VM buffer passed to visibilitymap_set");
 
+	/* Check that we have the right tuple count map page pinned, if present */
+	if (BufferIsValid(tcmBuf) && !tuplecountmap_pin_ok(heapBlk, tcmBuf))
+		elog(ERROR, "wrong tuple count map buffer passed to visibilitymap_set");
+	Assert(!InRecovery || !BufferIsValid(tcmBuf));
+
 	page = BufferGetPage(vmBuf);
 	map = (uint8 *) PageGetContents(page);
 	LockBuffer(vmBuf, BUFFER_LOCK_EXCLUSIVE);
 
-	if (flags != (map[mapByte] >> mapOffset & VISIBILITYMAP_VALID_BITS))
+	if (BufferIsValid(tcmBuf))
+	{
+		LockBuffer(tcmBuf, BUFFER_LOCK_EXCLUSIVE);
+		ntuples = tuplecountmap_count_page(BufferGetPage(heapBuf));
+		tcm_changed = (tuplecountmap_get_entry(tcmBuf, heapBlk) != ntuples);
+	}
+
+	if (flags != (map[mapByte] >> mapOffset & VISIBILITYMAP_VALID_BITS) ||
+		tcm_changed)
 	{
 		START_CRIT_SECTION();
 
 		map[mapByte] |= (flags << mapOffset);
 		MarkBufferDirty(vmBuf);
 
+		if (BufferIsValid(tcmBuf))
+		{
+			tuplecountmap_set_entry(tcmBuf, heapBlk, ntuples);
+			MarkBufferDirty(tcmBuf);
+		}
+
 		if (RelationNeedsWAL(rel))
 		{
 			if (XLogRecPtrIsInvalid(recptr))
 			{
 				Assert(!InRecovery);
-				recptr = log_heap_visible(rel, heapBuf, vmBuf, cutoff_xid, flags);
+				recptr = log_heap_visible(rel, heapBuf, vmBuf, tcmBuf, ntuples,
+										  cutoff_xid, flags);
 
 				/*
 				 * If data checksums are enabled (or wal_log_hints=on), we
@@ -307,11 +370,15 @@ visibilitymap_set(Relation rel, BlockNumber heapBlk, Buffer heapBuf,
 				}
 			}
 			PageSetLSN(page, recptr);
+			if (BufferIsValid(tcmBuf))
+				PageSetLSN(BufferGetPage(tcmBuf), recptr);
 		}
 
 		END_CRIT_SECTION();
 	}
 
+	if (BufferIsValid(tcmBuf))
+		LockBuffer(tcmBuf, BUFFER_LOCK_UNLOCK);
 	LockBuffer(vmBuf, BUFFER_LOCK_UNLOCK);
 }
 
@@ -463,6 +530,9 @@ visibilitymap_prepare_truncate(Relation rel, BlockNumber nheapblocks)
 	elog(DEBUG1, "vm_truncate %s %d", RelationGetRelationName(rel), nheapblocks);
 #endif
 
+	/* truncation clears bits too, as far as the hints are concerned */
+	pg_atomic_fetch_add_u64(vm_clear_counter(rel), 1);
+
 	/*
 	 * If no visibility map has been created yet for this relation, there's
 	 * nothing to truncate.
@@ -543,6 +613,71 @@ visibilitymap_prepare_truncate(Relation rel, BlockNumber nheapblocks)
 	return newnblocks;
 }
 
+/*
+ *	visibilitymap_clear_count - count of all-visible bits cleared so far
+ *
+ * Returns the counter that visibilitymap_clear() bumps for the relation.  A
+ * caller that reads the count before checking some all-visible bits knows
+ * that they are all still set as long as the count is unchanged.  The read
+ * is followed by a full barrier, so that the bits are read after it.
+ */
+uint64
+visibilitymap_clear_count(Relation rel)
+{
+	uint64		count;
+
+	count = pg_atomic_read_u64(vm_clear_counter(rel));
+	pg_memory_barrier();
+
+	return count;
+}
+
+/*
+ * VisibilityMapShmemSize --- report amount of shared memory space needed
+ */
+Size
+VisibilityMapShmemSize(void)
+{
+	return mul_size(VM_CLEAR_COUNTERS, sizeof(pg_atomic_uint64));
+}
+
+/*
+ * VisibilityMapShmemInit --- initialize the all-visible clear counters
+ */
+void
+VisibilityMapShmemInit(void)
+{
+	bool		found;
+
+	VisibilityMapClearCounters = (pg_atomic_uint64 *)
+		ShmemInitStruct("Visibility Map Clear Counters",
+						VisibilityMapShmemSize(),
+						&found);
+
+	if (!IsUnderPostmaster)
+	{
+		Assert(!found);
+		for (int i = 0; i < VM_CLEAR_COUNTERS; i++)
+			pg_atomic_init_u64(&VisibilityMapClearCounters[i], 0);
+	}
+	else
+		Assert(found);
+}
+
+/*
+ * Return the clear counter for rel.
+ */
+static pg_atomic_uint64 *
+vm_clear_counter(Relation rel)
+{
+	uint32		hash;
+
+	hash = hash_bytes((const unsigned char *) &rel->rd_locator,
+					  sizeof(RelFileLocator));
+
+	return &VisibilityMapClearCounters[hash % VM_CLEAR_COUNTERS];
+}
+
 /*
  * Read a visibility map page.
  *
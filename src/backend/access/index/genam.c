@@ -121,11 +121,14 @@ RelationGetIndexScan(Relation indexRelation, int nkeys, int norderbys)
 
 	scan->opaque = NULL;
 
+	scan->xs_heap_allvisible = false;
 	scan->xs_itup = NULL;
 	scan->xs_itupdesc = NULL;
 	scan->xs_hitup = NULL;
 	scan->xs_hitupdesc = NULL;
 
+	scan->xs_prefetch = NULL;
+
 	return scan;
 }
 
@@ -24,7 +24,9 @@
  *		index_parallelscan_initialize - initialize parallel scan
  *		index_parallelrescan  - (re)start a parallel scan of an index
  *		index_beginscan_parallel - join parallel index scan
+ *		index_set_prefetch	- read ahead in a scan to prefetch heap blocks
  *		index_getnext_tid	- get the next TID from a scan
+ *		index_getbatch	- get the next batch of TIDs from a scan
  *		index_fetch_heap		- get the scan's next heap tuple
  *		index_getnext_slot	- get the next tuple from a scan
  *		index_getbitmap - get all tuples from a scan
@@ -49,6 +51,7 @@
 #include "access/relscan.h"
 #include "access/tableam.h"
 #include "access/transam.h"
+#include "access/visibilitymap.h"
 #include "access/xlog.h"
 #include "catalog/index.h"
 #include "catalog/pg_amproc.h"
@@ -104,9 +107,50 @@ do { \
 			 CppAsString(pname), RelationGetRelationName(scan->indexRelation)); \
 } while(0)
 
+/*
+ * Lookahead queue of an index scan, see index_set_prefetch.  The queue is a
+ * ring buffer of the index entries that the index AM has returned to us but
+ * that we haven't returned to our caller yet.
+ */
+#define INDEX_PREFETCH_QUEUE_SIZE	256
+
+typedef struct IndexPrefetchEntry
+{
+	ItemPointerData heaptid;
+	bool		recheck;
+	bool		allvisible;		/* xs_heap_allvisible */
+	bool		prefetched;		/* did we prefetch heaptid's block? */
+	IndexTuple	itup;			/* copy of xs_itup, if any */
+	HeapTuple	hitup;			/* copy of xs_hitup, if any */
+} IndexPrefetchEntry;
+
+typedef struct IndexPrefetchData
+{
+	MemoryContext cxt;			/* context for the copied index tuples */
+	int			prefetch_maximum;	/* max number of blocks to prefetch */
+	int			prefetch_target;	/* current target, ramped up */
+	int			nprefetched;	/* number of prefetched entries in queue */
+	int			nexamined;		/* number of entries considered for prefetch */
+	BlockNumber last_block;		/* heap block of the last queued entry */
+	bool		eof;			/* has the index AM run out of entries? */
+	Buffer		vmbuffer;		/* for visibility map tests */
+
+	/* tuples returned last, to be freed by the next index_getnext_tid */
+	IndexTuple	cur_itup;
+	HeapTuple	cur_hitup;
+
+	int			head;			/* index of the next entry to return */
+	int			nentries;		/* number of entries in queue */
+	IndexPrefetchEntry queue[INDEX_PREFETCH_QUEUE_SIZE];
+} IndexPrefetchData;
+
 static IndexScanDesc index_beginscan_internal(Relation indexRelation,
 											  int nkeys, int norderbys, Snapshot snapshot,
 											  ParallelIndexScanDesc pscan, bool temp_snap);
+static void index_prefetch_reset(IndexScanDesc scan);
+static void index_prefetch_fill(IndexScanDesc scan, ScanDirection direction);
+static ItemPointer index_prefetch_next_tid(IndexScanDesc scan,
+										   ScanDirection direction);
 
 
 /* ----------------------------------------------------------------
@@ -315,6 +359,9 @@ index_rescan(IndexScanDesc scan,
 	scan->kill_prior_tuple = false; /* for safety */
 	scan->xs_heap_continue = false;
 
+	if (scan->xs_prefetch)
+		index_prefetch_reset(scan);
+
 	scan->indexRelation->rd_indam->amrescan(scan, keys, nkeys,
 											orderbys, norderbys);
 }
@@ -336,6 +383,15 @@ index_endscan(IndexScanDesc scan)
 		scan->xs_heapfetch = NULL;
 	}
 
+	if (scan->xs_prefetch)
+	{
+		index_prefetch_reset(scan);
+		if (BufferIsValid(scan->xs_prefetch->vmbuffer))
+			ReleaseBuffer(scan->xs_prefetch->vmbuffer);
+		pfree(scan->xs_prefetch);
+		scan->xs_prefetch = NULL;
+	}
+
 	/* End the AM's scan */
 	scan->indexRelation->rd_indam->amendscan(scan);
 
@@ -359,6 +415,9 @@ index_markpos(IndexScanDesc scan)
 	SCAN_CHECKS;
 	CHECK_SCAN_PROCEDURE(ammarkpos);
 
+	/* the AM's position is ahead of ours when looking ahead */
+	Assert(scan->xs_prefetch == NULL);
+
 	scan->indexRelation->rd_indam->ammarkpos(scan);
 }
 
@@ -384,6 +443,7 @@ index_restrpos(IndexScanDesc scan)
 
 	SCAN_CHECKS;
 	CHECK_SCAN_PROCEDURE(amrestrpos);
+	Assert(scan->xs_prefetch == NULL);
 
 	/* release resources (like buffer pins) from table accesses */
 	if (scan->xs_heapfetch)
@@ -478,6 +538,9 @@ index_parallelrescan(IndexScanDesc scan)
 	if (scan->xs_heapfetch)
 		table_index_fetch_reset(scan->xs_heapfetch);
 
+	if (scan->xs_prefetch)
+		index_prefetch_reset(scan);
+
 	/* amparallelrescan is optional; assume no-op if not provided by AM */
 	if (scan->indexRelation->rd_indam->amparallelrescan != NULL)
 		scan->indexRelation->rd_indam->amparallelrescan(scan);
@@ -514,6 +577,42 @@ index_beginscan_parallel(Relation heaprel, Relation indexrel, int nkeys,
 	return scan;
 }
 
+/* ----------------
+ *		index_set_prefetch - read ahead in a scan to prefetch heap blocks
+ *
+ * From now on, index_getnext_tid reads index entries ahead of the ones it
+ * returns, and prefetches the heap blocks they point to, up to
+ * prefetch_maximum blocks ahead; the entries are still returned in index
+ * order.  In an index-only scan, blocks that are all-visible in the
+ * visibility map aren't prefetched, as they won't be read.
+ *
+ * Since the index AM's position is ahead of the caller's, the scan can't
+ * be marked or restored, nor change its direction, and the AM won't be told
+ * to kill dead entries.  Ordering operators aren't supported either.
+ * ----------------
+ */
+void
+index_set_prefetch(IndexScanDesc scan, int prefetch_maximum)
+{
+#ifdef USE_PREFETCH
+	IndexPrefetchData *prefetch;
+
+	Assert(scan->numberOfOrderBys == 0);
+
+	if (prefetch_maximum <= 0 || !IsMVCCSnapshot(scan->xs_snapshot) ||
+		scan->xs_prefetch != NULL)
+		return;
+
+	prefetch = palloc0_object(IndexPrefetchData);
+	prefetch->cxt = CurrentMemoryContext;
+	prefetch->prefetch_maximum = Min(prefetch_maximum,
+									 INDEX_PREFETCH_QUEUE_SIZE);
+	prefetch->vmbuffer = InvalidBuffer;
+	scan->xs_prefetch = prefetch;
+	index_prefetch_reset(scan);
+#endif
+}
+
 /* ----------------
  * index_getnext_tid - get the next TID from a scan
  *
@@ -532,6 +631,9 @@ index_getnext_tid(IndexScanDesc scan, ScanDirection direction)
 	/* XXX: we should assert that a snapshot is pushed or registered */
 	Assert(TransactionIdIsValid(RecentXmin));
 
+	if (scan->xs_prefetch)
+		return index_prefetch_next_tid(scan, direction);
+
 	/*
 	 * The AM's amgettuple proc finds the next index entry matching the scan
 	 * keys, and puts the TID into scan->xs_heaptid.  It should also set
@@ -561,6 +663,279 @@ index_getnext_tid(IndexScanDesc scan, ScanDirection direction)
 	return &scan->xs_heaptid;
 }
 
+/* ----------------
+ *		index_getbatch - get the next batch of TIDs from a scan
+ *
+ * Stores up to maxtids TIDs satisfying the scan keys into tids[], and their
+ * recheck flags into recheck[], and returns the number stored; zero means
+ * that no more matching tuples exist.  If the AM has an amgetbatch method,
+ * that returns the rest of the current index page at once, saving a call
+ * per tuple; otherwise, and in index-only scans and scans with ordering
+ * operators, we return a single TID from amgettuple.
+ *
+ * No index tuples are returned, and since the AM is left positioned on the
+ * last TID of the batch, it can't be told to kill its dead entries.  This
+ * can't be mixed with index_set_prefetch.
+ * ----------------
+ */
+int
+index_getbatch(IndexScanDesc scan, ScanDirection direction,
+			   ItemPointer tids, bool *recheck, int maxtids)
+{
+	IndexAmRoutine *indam = scan->indexRelation->rd_indam;
+	int			ntids;
+
+	SCAN_CHECKS;
+	CHECK_SCAN_PROCEDURE(amgettuple);
+	Assert(maxtids > 0);
+	Assert(scan->xs_prefetch == NULL);
+
+	/* XXX: we should assert that a snapshot is pushed or registered */
+	Assert(TransactionIdIsValid(RecentXmin));
+
+	scan->kill_prior_tuple = false;
+	scan->xs_heap_continue = false;
+
+	if (indam->amgetbatch != NULL &&
+		scan->numberOfOrderBys == 0 && !scan->xs_want_itup)
+		ntids = indam->amgetbatch(scan, direction, tids, recheck, maxtids);
+	else if (indam->amgettuple(scan, direction))
+	{
+		tids[0] = scan->xs_heaptid;
+		recheck[0] = scan->xs_recheck;
+		ntids = 1;
+	}
+	else
+		ntids = 0;
+
+	Assert(ntids >= 0 && ntids <= maxtids);
+
+	if (ntids > 0)
+		pgstat_count_index_tuples(scan->indexRelation, ntids);
+
+	return ntids;
+}
+
+/*
+ * Empty the lookahead queue, for a rescan or the end of the scan.
+ */
+static void
+index_prefetch_reset(IndexScanDesc scan)
+{
+	IndexPrefetchData *prefetch = scan->xs_prefetch;
+
+	while (prefetch->nentries > 0)
+	{
+		IndexPrefetchEntry *entry = &prefetch->queue[prefetch->head];
+
+		if (entry->itup)
+			pfree(entry->itup);
+		if (entry->hitup)
+			heap_freetuple(entry->hitup);
+		prefetch->head = (prefetch->head + 1) % INDEX_PREFETCH_QUEUE_SIZE;
+		prefetch->nentries--;
+	}
+	if (prefetch->cur_itup)
+		pfree(prefetch->cur_itup);
+	if (prefetch->cur_hitup)
+		heap_freetuple(prefetch->cur_hitup);
+	prefetch->cur_itup = NULL;
+	prefetch->cur_hitup = NULL;
+	scan->xs_itup = NULL;
+	scan->xs_hitup = NULL;
+
+	prefetch->head = 0;
+	prefetch->nprefetched = 0;
+	prefetch->nexamined = 0;
+	prefetch->last_block = InvalidBlockNumber;
+	prefetch->eof = false;
+
+	/* start small, in case the caller only wants a few tuples */
+	prefetch->prefetch_target = 1;
+}
+
+/*
+ * Top up the lookahead queue with entries from the index AM, until it
+ * holds prefetch_target prefetched blocks.
+ */
+static void
+index_prefetch_fill(IndexScanDesc scan, ScanDirection direction)
+{
+	IndexPrefetchData *prefetch = scan->xs_prefetch;
+	IndexAmRoutine *indam = scan->indexRelation->rd_indam;
+
+	for (;;)
+	{
+		/*
+		 * Prefetch the blocks of the entries we haven't looked at yet, each
+		 * run of entries pointing to the same block once.
+		 */
+		while (prefetch->nexamined < prefetch->nentries &&
+			   prefetch->nprefetched < prefetch->prefetch_target)
+		{
+			IndexPrefetchEntry *entry;
+			BlockNumber block;
+
+			entry = &prefetch->queue[(prefetch->head + prefetch->nexamined) %
+									 INDEX_PREFETCH_QUEUE_SIZE];
+			prefetch->nexamined++;
+
+			block = ItemPointerGetBlockNumber(&entry->heaptid);
+			if (block == prefetch->last_block)
+				continue;
+			prefetch->last_block = block;
+
+			if (scan->xs_want_itup &&
+				(entry->allvisible ||
+				 VM_ALL_VISIBLE(scan->heapRelation, block, &prefetch->vmbuffer)))
+				continue;
+
+			PrefetchBuffer(scan->heapRelation, MAIN_FORKNUM, block);
+			entry->prefetched = true;
+			prefetch->nprefetched++;
+		}
+
+		if (prefetch->eof ||
+			prefetch->nentries >= INDEX_PREFETCH_QUEUE_SIZE ||
+			prefetch->nprefetched >= prefetch->prefetch_target)
+			break;
+
+		/*
+		 * The AM is positioned on the last entry we queued, not on the one
+		 * our caller just fetched, so we mustn't let it kill anything.
+		 */
+		scan->kill_prior_tuple = false;
+
+		if (indam->amgetbatch != NULL && !scan->xs_want_itup)
+		{
+			ItemPointerData tids[INDEX_PREFETCH_QUEUE_SIZE];
+			bool		recheck[INDEX_PREFETCH_QUEUE_SIZE];
+			int			ntids;
+
+			/* queue as much of the current index page as fits */
+			ntids = indam->amgetbatch(scan, direction, tids, recheck,
+									  INDEX_PREFETCH_QUEUE_SIZE -
+									  prefetch->nentries);
+			if (ntids == 0)
+			{
+				prefetch->eof = true;
+				continue;
+			}
+
+			pgstat_count_index_tuples(scan->indexRelation, ntids);
+
+			for (int i = 0; i < ntids; i++)
+			{
+				IndexPrefetchEntry *entry;
+
+				entry = &prefetch->queue[(prefetch->head + prefetch->nentries) %
+										 INDEX_PREFETCH_QUEUE_SIZE];
+				prefetch->nentries++;
+
+				entry->heaptid = tids[i];
+				entry->recheck = recheck[i];
+				entry->allvisible = false;
+				entry->prefetched = false;
+				entry->itup = NULL;
+				entry->hitup = NULL;
+			}
+		}
+		else
+		{
+			IndexPrefetchEntry *entry;
+			MemoryContext oldcxt;
+
+			if (!indam->amgettuple(scan, direction))
+			{
+				prefetch->eof = true;
+				continue;
+			}
+			Assert(ItemPointerIsValid(&scan->xs_heaptid));
+
+			pgstat_count_index_tuples(scan->indexRelation, 1);
+
+			entry = &prefetch->queue[(prefetch->head + prefetch->nentries) %
+									 INDEX_PREFETCH_QUEUE_SIZE];
+			prefetch->nentries++;
+
+			entry->heaptid = scan->xs_heaptid;
+			entry->recheck = scan->xs_recheck;
+			entry->allvisible = scan->xs_heap_allvisible;
+			entry->prefetched = false;
+
+			/* the AM's tuples are only valid until its next amgettuple call */
+			oldcxt = MemoryContextSwitchTo(prefetch->cxt);
+			entry->itup = scan->xs_itup ? CopyIndexTuple(scan->xs_itup) : NULL;
+			entry->hitup = scan->xs_hitup ? heap_copytuple(scan->xs_hitup) : NULL;
+			MemoryContextSwitchTo(oldcxt);
+		}
+	}
+}
+
+/*
+ * index_getnext_tid for a scan with a lookahead queue: return the entry at
+ * the head of the queue.
+ */
+static ItemPointer
+index_prefetch_next_tid(IndexScanDesc scan, ScanDirection direction)
+{
+	IndexPrefetchData *prefetch = scan->xs_prefetch;
+	IndexPrefetchEntry *entry;
+
+	/* The caller is done with the tuples we returned last. */
+	if (prefetch->cur_itup)
+		pfree(prefetch->cur_itup);
+	if (prefetch->cur_hitup)
+		heap_freetuple(prefetch->cur_hitup);
+	prefetch->cur_itup = NULL;
+	prefetch->cur_hitup = NULL;
+
+	index_prefetch_fill(scan, direction);
+
+	scan->kill_prior_tuple = false;
+	scan->xs_heap_continue = false;
+
+	/* If we're out of index entries, we're done */
+	if (prefetch->nentries == 0)
+	{
+		scan->xs_itup = NULL;
+		scan->xs_hitup = NULL;
+
+		/* release resources (like buffer pins) from table accesses */
+		if (scan->xs_heapfetch)
+			table_index_fetch_reset(scan->xs_heapfetch);
+
+		return NULL;
+	}
+
+	entry = &prefetch->queue[prefetch->head];
+	prefetch->head = (prefetch->head + 1) % INDEX_PREFETCH_QUEUE_SIZE;
+	prefetch->nentries--;
+	if (prefetch->nexamined > 0)
+		prefetch->nexamined--;
+
+	/*
+	 * As in a bitmap heap scan, ramp up the prefetch distance as we consume
+	 * the blocks we prefetched.
+	 */
+	if (entry->prefetched)
+	{
+		prefetch->nprefetched--;
+		if (prefetch->prefetch_target >= prefetch->prefetch_maximum / 2)
+			prefetch->prefetch_target = prefetch->prefetch_maximum;
+		else
+			prefetch->prefetch_target *= 2;
+	}
+
+	scan->xs_heaptid = entry->heaptid;
+	scan->xs_recheck = entry->recheck;
+	scan->xs_heap_allvisible = entry->allvisible;
+	scan->xs_itup = prefetch->cur_itup = entry->itup;
+	scan->xs_hitup = prefetch->cur_hitup = entry->hitup;
+
+	return &scan->xs_heaptid;
+}
+
 /* ----------------
  *		index_fetch_heap - get the scan's next heap tuple
  *
@@ -134,6 +134,7 @@ bthandler(PG_FUNCTION_ARGS)
 	amroutine->ambeginscan = btbeginscan;
 	amroutine->amrescan = btrescan;
 	amroutine->amgettuple = btgettuple;
+	amroutine->amgetbatch = btgetbatch;
 	amroutine->amgetbitmap = btgetbitmap;
 	amroutine->amendscan = btendscan;
 	amroutine->ammarkpos = btmarkpos;
@@ -281,6 +282,56 @@ btgettuple(IndexScanDesc scan, ScanDirection dir)
 	return res;
 }
 
+/*
+ *	btgetbatch() -- Get the next batch of tuples in the scan.
+ *
+ * Returns the rest of the items that _bt_readpage saved from the current leaf
+ * page, up to maxtids of them, moving on to the next page first if they have
+ * all been returned.  The scan is left positioned on the last item returned,
+ * so the caller must not ask us to kill the previous tuple.
+ */
+int
+btgetbatch(IndexScanDesc scan, ScanDirection dir, ItemPointer tids,
+		   bool *recheck, int maxtids)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	int			ntids = 0;
+
+	Assert(!scan->kill_prior_tuple);
+
+	/* btgettuple deals with starting the scan and stepping to a new page */
+	if (!btgettuple(scan, dir))
+		return 0;
+
+	tids[ntids] = scan->xs_heaptid;
+	recheck[ntids++] = false;
+
+	if (ScanDirectionIsForward(dir))
+	{
+		while (ntids < maxtids &&
+			   so->currPos.itemIndex < so->currPos.lastItem)
+		{
+			so->currPos.itemIndex++;
+			tids[ntids] = so->currPos.items[so->currPos.itemIndex].heapTid;
+			recheck[ntids++] = false;
+		}
+	}
+	else
+	{
+		while (ntids < maxtids &&
+			   so->currPos.itemIndex > so->currPos.firstItem)
+		{
+			so->currPos.itemIndex--;
+			tids[ntids] = so->currPos.items[so->currPos.itemIndex].heapTid;
+			recheck[ntids++] = false;
+		}
+	}
+
+	scan->xs_heaptid = tids[ntids - 1];
+
+	return ntids;
+}
+
 /*
  * btgetbitmap() -- gets all matching tuples, and adds them to a bitmap
  */
@@ -358,16 +409,21 @@ btbeginscan(Relation rel, int nkeys, int norderbys)
 	so = (BTScanOpaque) palloc(sizeof(BTScanOpaqueData));
 	BTScanPosInvalidate(so->currPos);
 	BTScanPosInvalidate(so->markPos);
+
+	/* leave room for the key of a skip array, see _bt_preprocess_array_keys */
 	if (scan->numberOfKeys > 0)
-		so->keyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
+		so->keyData = (ScanKey) palloc((scan->numberOfKeys + 1) * sizeof(ScanKeyData));
 	else
 		so->keyData = NULL;
 
 	so->arrayKeyData = NULL;	/* assume no array keys for now */
+	so->numArrayKeyData = 0;
 	so->arraysStarted = false;
 	so->numArrayKeys = 0;
 	so->arrayKeys = NULL;
+	so->skipArray = NULL;
 	so->arrayContext = NULL;
+	so->arrayLeaf = InvalidBlockNumber;
 
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
@@ -407,6 +463,7 @@ btrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 
 	so->markItemIndex = -1;
 	so->arrayKeyCount = 0;
+	so->arrayLeaf = InvalidBlockNumber;
 	BTScanPosUnpinIfPinned(so->markPos);
 	BTScanPosInvalidate(so->markPos);
 
@@ -1325,7 +1382,17 @@ backtrack:
 		if (minoff > maxoff)
 			attempt_pagedel = (blkno == scanblkno);
 		else if (callback)
+		{
 			stats->num_index_tuples += nhtidslive;
+
+			/*
+			 * Now that the dead TIDs are gone, let index-only scans of the
+			 * page skip the visibility map if the live ones all point to
+			 * all-visible heap pages.
+			 */
+			if (heaprel != NULL)
+				_bt_set_allvisible_hint(rel, heaprel, buf);
+		}
 		else
 			stats->num_index_tuples += maxoff - minoff + 1;
 
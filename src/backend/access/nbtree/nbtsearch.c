@@ -21,6 +21,8 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 
@@ -29,6 +31,9 @@ static void _bt_drop_lock_and_maybe_pin(IndexScanDesc scan, BTScanPos sp);
 static OffsetNumber _bt_binsrch(Relation rel, BTScanInsert key, Buffer buf);
 static int	_bt_binsrch_posting(BTScanInsert key, Page page,
 								OffsetNumber offnum);
+static inline int32 _bt_compare_prefix(Relation rel, BTScanInsert key,
+									   Page page, OffsetNumber offnum,
+									   int *cmpcol);
 static bool _bt_readpage(IndexScanDesc scan, ScanDirection dir,
 						 OffsetNumber offnum);
 static void _bt_saveitem(BTScanOpaque so, int itemIndex,
@@ -45,6 +50,15 @@ static bool _bt_parallel_readpage(IndexScanDesc scan, BlockNumber blkno,
 								  ScanDirection dir);
 static Buffer _bt_walk_left(Relation rel, Buffer buf, Snapshot snapshot);
 static bool _bt_endpoint(IndexScanDesc scan, ScanDirection dir);
+static bool _bt_array_relocate(IndexScanDesc scan, BTScanInsert key,
+							   ScanDirection dir, Buffer *bufP);
+static void _bt_skip_inskey(IndexScanDesc scan, ScanDirection dir,
+							BTScanInsert inskey);
+static void _bt_skip_copy_value(IndexScanDesc scan, Page page,
+								OffsetNumber offnum,
+								Datum *value, bool *isnull);
+static void _bt_skip_note_next(IndexScanDesc scan, ScanDirection dir,
+							   Buffer buf);
 static inline void _bt_initialize_more_data(BTScanOpaque so, ScanDirection dir);
 
 
@@ -356,6 +370,9 @@ _bt_binsrch(Relation rel,
 				high;
 	int32		result,
 				cmpval;
+	int			lowcol,
+				highcol;
+	bool		useprefix;
 
 	page = BufferGetPage(buf);
 	opaque = BTPageGetOpaque(page);
@@ -389,23 +406,43 @@ _bt_binsrch(Relation rel,
 	 * 'low' are <= scan key, all slots at or after 'high' are > scan key.
 	 *
 	 * We can fall out when high == low.
+	 *
+	 * On a leaf page we also track how many leading key attributes the scan
+	 * key is known to share with the tuples bounding the search range
+	 * (lowcol and highcol are the first attribute that may still differ).
+	 * Every tuple between the two bounds must share the same prefix, so each
+	 * probe can start comparing at the smaller of the two.  Skipping those
+	 * attributes matters for composite keys whose leading columns repeat
+	 * across the page, for example a tenant id.  Internal pages are not
+	 * handled this way, since their truncated pivot tuples and the minus
+	 * infinity first item don't have the values the argument relies on.
 	 */
 	high++;						/* establish the loop invariant for high */
 
 	cmpval = key->nextkey ? 0 : 1;	/* select comparison value */
 
+	lowcol = highcol = 1;
+	useprefix = P_ISLEAF(opaque);
+
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
+		int			cmpcol = useprefix ? Min(lowcol, highcol) : 1;
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		result = _bt_compare_prefix(rel, key, page, mid, &cmpcol);
 
 		if (result >= cmpval)
+		{
 			low = mid + 1;
+			lowcol = cmpcol;
+		}
 		else
+		{
 			high = mid;
+			highcol = cmpcol;
+		}
 	}
 
 	/*
@@ -460,6 +497,8 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 				stricthigh;
 	int32		result,
 				cmpval;
+	int			lowcol,
+				highcol;
 
 	page = BufferGetPage(insertstate->buf);
 	opaque = BTPageGetOpaque(page);
@@ -499,7 +538,10 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 	 * at or after 'high' are >= scan key.  'stricthigh' is > scan key, and is
 	 * maintained to save additional search effort for caller.
 	 *
-	 * We can fall out when high == low.
+	 * We can fall out when high == low.  As in _bt_binsrch(), each probe
+	 * skips the leading attributes known to be equal at both bounds.  The
+	 * prefixes aren't cached with the bounds, so a restored search starts
+	 * again from the first attribute.
 	 */
 	if (!insertstate->bounds_valid)
 		high++;					/* establish the loop invariant for high */
@@ -507,19 +549,26 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 
 	cmpval = 1;					/* !nextkey comparison value */
 
+	lowcol = highcol = 1;
+
 	while (high > low)
 	{
 		OffsetNumber mid = low + ((high - low) / 2);
+		int			cmpcol = Min(lowcol, highcol);
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		result = _bt_compare_prefix(rel, key, page, mid, &cmpcol);
 
 		if (result >= cmpval)
+		{
 			low = mid + 1;
+			lowcol = cmpcol;
+		}
 		else
 		{
 			high = mid;
+			highcol = cmpcol;
 			if (result != 0)
 				stricthigh = high;
 		}
@@ -636,6 +685,44 @@ _bt_binsrch_posting(BTScanInsert key, Page page, OffsetNumber offnum)
 	return low;
 }
 
+/*
+ * _bt_compare_inline() -- Apply a btree comparison support function without
+ *		going through fmgr, for the common integer opclasses.
+ *
+ * Returns false if the function isn't one we know, so that the caller must
+ * call it the usual way.  These are the functions btint2cmp, btint4cmp and
+ * btint8cmp themselves would run; calling them through fmgr costs far more
+ * than the comparison, and _bt_compare runs once per binary search probe.
+ */
+static inline bool
+_bt_compare_inline(FmgrInfo *flinfo, Datum a, Datum b, int32 *result)
+{
+	switch (flinfo->fn_oid)
+	{
+		case F_BTINT4CMP:
+			{
+				int32		ia = DatumGetInt32(a);
+				int32		ib = DatumGetInt32(b);
+
+				*result = (ia > ib) ? 1 : ((ia < ib) ? -1 : 0);
+			}
+			return true;
+		case F_BTINT8CMP:
+			{
+				int64		ia = DatumGetInt64(a);
+				int64		ib = DatumGetInt64(b);
+
+				*result = (ia > ib) ? 1 : ((ia < ib) ? -1 : 0);
+			}
+			return true;
+		case F_BTINT2CMP:
+			*result = (int32) DatumGetInt16(a) - (int32) DatumGetInt16(b);
+			return true;
+		default:
+			return false;
+	}
+}
+
 /*----------
  *	_bt_compare() -- Compare insertion-type scankey to tuple on a page.
  *
@@ -668,6 +755,27 @@ _bt_compare(Relation rel,
 			BTScanInsert key,
 			Page page,
 			OffsetNumber offnum)
+{
+	int			cmpcol = 1;
+
+	return _bt_compare_prefix(rel, key, page, offnum, &cmpcol);
+}
+
+/*
+ * _bt_compare_prefix() -- _bt_compare(), starting at a given key attribute.
+ *
+ * On entry *cmpcol is the first key attribute to compare; caller promises
+ * that the scankey is equal to the tuple on all attributes before it.  On
+ * exit *cmpcol is the attribute that decided the result, or one past the
+ * last compared attribute when they were all equal.  Only leaf tuples may be
+ * compared with *cmpcol > 1.
+ */
+static inline int32
+_bt_compare_prefix(Relation rel,
+				   BTScanInsert key,
+				   Page page,
+				   OffsetNumber offnum,
+				   int *cmpcol)
 {
 	TupleDesc	itupdesc = RelationGetDescr(rel);
 	BTPageOpaque opaque = BTPageGetOpaque(page);
@@ -707,8 +815,9 @@ _bt_compare(Relation rel,
 	ncmpkey = Min(ntupatts, key->keysz);
 	Assert(key->heapkeyspace || ncmpkey == key->keysz);
 	Assert(!BTreeTupleIsPosting(itup) || key->allequalimage);
-	scankey = key->scankeys;
-	for (int i = 1; i <= ncmpkey; i++)
+	Assert(*cmpcol == 1 || P_ISLEAF(opaque));
+	scankey = key->scankeys + (*cmpcol - 1);
+	for (int i = *cmpcol; i <= ncmpkey; i++)
 	{
 		Datum		datum;
 		bool		isNull;
@@ -741,10 +850,12 @@ _bt_compare(Relation rel,
 			 * to flip the sign of the comparison result.  (Unless it's a DESC
 			 * column, in which case we *don't* flip the sign.)
 			 */
-			result = DatumGetInt32(FunctionCall2Coll(&scankey->sk_func,
-													 scankey->sk_collation,
-													 datum,
-													 scankey->sk_argument));
+			if (!_bt_compare_inline(&scankey->sk_func, datum,
+									scankey->sk_argument, &result))
+				result = DatumGetInt32(FunctionCall2Coll(&scankey->sk_func,
+														 scankey->sk_collation,
+														 datum,
+														 scankey->sk_argument));
 
 			if (!(scankey->sk_flags & SK_BT_DESC))
 				INVERT_COMPARE_RESULT(result);
@@ -752,10 +863,14 @@ _bt_compare(Relation rel,
 
 		/* if the keys are unequal, return the difference */
 		if (result != 0)
+		{
+			*cmpcol = i;
 			return result;
+		}
 
 		scankey++;
 	}
+	*cmpcol = Max(*cmpcol, ncmpkey + 1);
 
 	/*
 	 * All non-truncated attributes (other than heap TID) were found to be
@@ -1372,12 +1487,17 @@ _bt_first(IndexScanDesc scan, ScanDirection dir)
 
 	/*
 	 * Use the manufactured insertion scan key to descend the tree and
-	 * position ourselves on the target leaf page.
+	 * position ourselves on the target leaf page, unless the page where the
+	 * scan for the previous array keys stopped is known to be it.
 	 */
-	stack = _bt_search(rel, NULL, &inskey, &buf, BT_READ, scan->xs_snapshot);
+	if (!_bt_array_relocate(scan, &inskey, dir, &buf))
+	{
+		stack = _bt_search(rel, NULL, &inskey, &buf, BT_READ,
+						   scan->xs_snapshot);
 
-	/* don't need to keep the stack around... */
-	_bt_freestack(stack);
+		/* don't need to keep the stack around... */
+		_bt_freestack(stack);
+	}
 
 	if (!BufferIsValid(buf))
 	{
@@ -1465,6 +1585,7 @@ readcomplete:
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_heaptid = currItem->heapTid;
+	scan->xs_heap_allvisible = so->currPos.allvisible;
 	if (scan->xs_want_itup)
 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
@@ -1515,6 +1636,7 @@ _bt_next(IndexScanDesc scan, ScanDirection dir)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_heaptid = currItem->heapTid;
+	scan->xs_heap_allvisible = so->currPos.allvisible;
 	if (scan->xs_want_itup)
 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
@@ -1595,6 +1717,16 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 	 */
 	so->currPos.nextPage = opaque->btpo_next;
 
+	/*
+	 * For an index-only scan, see if the executor can skip the visibility map
+	 * for this page's TIDs.  Our lock on the page keeps new TIDs out while we
+	 * look.
+	 */
+	so->currPos.allvisible = scan->xs_want_itup &&
+		scan->heapRelation != NULL &&
+		_bt_allvisible_hint_valid(scan->indexRelation, scan->heapRelation,
+								  so->currPos.buf);
+
 	/* initialize tuple workspace to empty */
 	so->currPos.nextTupleOffset = 0;
 
@@ -1689,8 +1821,18 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 		}
 
 		if (!continuescan)
+		{
 			so->currPos.moreRight = false;
 
+			/* remember where to look for the next array keys */
+			if (so->numArrayKeys > 0 && !scan->parallel_scan)
+				so->arrayLeaf = so->currPos.currPage;
+
+			/* and look for the next value of a skip array while we're here */
+			if (so->skipArray)
+				_bt_skip_note_next(scan, dir, so->currPos.buf);
+		}
+
 		Assert(itemIndex <= MaxTIDsPerBTreePage);
 		so->currPos.firstItem = 0;
 		so->currPos.lastItem = itemIndex - 1;
@@ -1780,6 +1922,8 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 			{
 				/* there can't be any more matches, so stop */
 				so->currPos.moreLeft = false;
+				if (so->skipArray)
+					_bt_skip_note_next(scan, dir, so->currPos.buf);
 				break;
 			}
 
@@ -2490,12 +2634,257 @@ _bt_endpoint(IndexScanDesc scan, ScanDirection dir)
 	/* OK, itemIndex says what to return */
 	currItem = &so->currPos.items[so->currPos.itemIndex];
 	scan->xs_heaptid = currItem->heapTid;
+	scan->xs_heap_allvisible = so->currPos.allvisible;
 	if (scan->xs_want_itup)
 		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
 
 	return true;
 }
 
+/*
+ *	_bt_array_relocate() -- Find the leaf page for the next array keys
+ *		without descending the tree.
+ *
+ * When a forward scan for one set of array keys stops, it's at the first
+ * tuple beyond those keys.  Array keys are visited in order, so any match
+ * for the next keys is at that tuple or after it: if the page holding it
+ * also covers the new insertion scan key, that's where to start.  This saves
+ * a descent for each array element whose matches are on the same leaf page,
+ * as with long lists of nearby keys.
+ *
+ * The page can't have been recycled since we read it, as our snapshot holds
+ * back its deletion horizon.  If it has been split or deleted meanwhile, its
+ * high key or flags tell, and we descend as usual.
+ *
+ * Returns true with the page read-locked in *bufP, or false.
+ */
+static bool
+_bt_array_relocate(IndexScanDesc scan, BTScanInsert key, ScanDirection dir,
+				   Buffer *bufP)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	BlockNumber blkno = so->arrayLeaf;
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+
+	so->arrayLeaf = InvalidBlockNumber;
+	if (!BlockNumberIsValid(blkno) || !ScanDirectionIsForward(dir) ||
+		scan->parallel_scan)
+		return false;
+
+	buf = _bt_getbuf(rel, blkno, BT_READ);
+	page = BufferGetPage(buf);
+	TestForOldSnapshot(scan->xs_snapshot, rel, page);
+	opaque = BTPageGetOpaque(page);
+
+	/* same test as _bt_moveright for whether the key belongs further right */
+	if (!P_ISLEAF(opaque) || P_IGNORE(opaque) ||
+		(!P_RIGHTMOST(opaque) &&
+		 _bt_compare(rel, key, page, P_HIKEY) >= (key->nextkey ? 0 : 1)))
+	{
+		_bt_relbuf(rel, buf);
+		return false;
+	}
+
+	*bufP = buf;
+	return true;
+}
+
+/*
+ *	_bt_skip_inskey() -- Build an insertion scan key for the skip array.
+ *
+ * The key finds the first tuple beyond the current element of the skip
+ * array in the scan direction: with nextkey, the first tuple > element for a
+ * forward scan, and the first tuple >= element for a backward scan, where
+ * the caller wants the tuple just before that.
+ */
+static void
+_bt_skip_inskey(IndexScanDesc scan, ScanDirection dir, BTScanInsert inskey)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	ScanKey		skey = &so->arrayKeyData[so->skipArray->scan_key];
+	int			flags;
+
+	flags = (skey->sk_flags & SK_ISNULL) |
+		(rel->rd_indoption[0] << SK_BT_INDOPTION_SHIFT);
+	ScanKeyEntryInitializeWithInfo(inskey->scankeys,
+								   flags,
+								   1,
+								   InvalidStrategy,
+								   rel->rd_opcintype[0],
+								   rel->rd_indcollation[0],
+								   index_getprocinfo(rel, 1, BTORDER_PROC),
+								   skey->sk_argument);
+
+	_bt_metaversion(rel, &inskey->heapkeyspace, &inskey->allequalimage);
+	inskey->anynullkeys = (flags & SK_ISNULL) != 0;
+	inskey->nextkey = ScanDirectionIsForward(dir);
+	inskey->pivotsearch = false;
+	inskey->scantid = NULL;
+	inskey->keysz = 1;
+}
+
+/*
+ *	_bt_skip_copy_value() -- Copy the first column of a leaf tuple into the
+ *		skip array's memory.
+ */
+static void
+_bt_skip_copy_value(IndexScanDesc scan, Page page, OffsetNumber offnum,
+					Datum *value, bool *isnull)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	TupleDesc	itupdesc = RelationGetDescr(scan->indexRelation);
+	Form_pg_attribute attr = TupleDescAttr(itupdesc, 0);
+	IndexTuple	itup;
+	Datum		datum;
+	MemoryContext oldContext;
+
+	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	datum = index_getattr(itup, 1, itupdesc, isnull);
+	if (*isnull)
+	{
+		*value = (Datum) 0;
+		return;
+	}
+
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+	*value = datumCopy(datum, attr->attbyval, attr->attlen);
+	MemoryContextSwitchTo(oldContext);
+}
+
+/*
+ *	_bt_skip_note_next() -- Remember the next value of the skip array if it
+ *		is on the leaf page where the current primitive scan stopped.
+ *
+ * This saves _bt_skip_next a descent of the tree whenever the current group
+ * of tuples ends on the page we have already locked.
+ */
+static void
+_bt_skip_note_next(IndexScanDesc scan, ScanDirection dir, Buffer buf)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTArrayKeyInfo *skip = so->skipArray;
+	Page		page = BufferGetPage(buf);
+	BTPageOpaque opaque = BTPageGetOpaque(page);
+	BTScanInsertData inskey;
+	OffsetNumber offnum;
+
+	if (skip->skip_done || skip->next_valid)
+		return;
+
+	_bt_skip_inskey(scan, dir, &inskey);
+	offnum = _bt_binsrch(scan->indexRelation, &inskey, buf);
+	if (ScanDirectionIsBackward(dir))
+		offnum = OffsetNumberPrev(offnum);
+
+	if (offnum < P_FIRSTDATAKEY(opaque) ||
+		offnum > PageGetMaxOffsetNumber(page))
+		return;
+
+	_bt_skip_copy_value(scan, page, offnum,
+						&skip->next_value, &skip->next_null);
+	skip->next_page = BufferGetBlockNumber(buf);
+	skip->next_valid = true;
+}
+
+/*
+ *	_bt_skip_next() -- Find the next distinct value of the first index column
+ *		for a skip scan.
+ *
+ * With first, that's the first value in the index in the scan direction;
+ * otherwise it's the first one beyond the current element of the skip array,
+ * which we find by descending the tree as for any other insertion scan key.
+ * Empty pages are stepped over the same way _bt_readnextpage does.
+ *
+ * Returns false if there is no such value.  Otherwise the value, copied into
+ * the array context, is returned in *value and *isnull, and the leaf page it
+ * was found on in *blkno.
+ *
+ * The leaf pages we land on are predicate-locked, as the tuples inserted
+ * into the gaps we skip would go there.
+ */
+bool
+_bt_skip_next(IndexScanDesc scan, ScanDirection dir, bool first,
+			  Datum *value, bool *isnull, BlockNumber *blkno)
+{
+	Relation	rel = scan->indexRelation;
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+	OffsetNumber offnum;
+
+	if (first)
+	{
+		buf = _bt_get_endpoint(rel, 0, ScanDirectionIsBackward(dir),
+							   scan->xs_snapshot);
+		if (!BufferIsValid(buf))
+			return false;
+		page = BufferGetPage(buf);
+		opaque = BTPageGetOpaque(page);
+		if (ScanDirectionIsForward(dir))
+			offnum = P_FIRSTDATAKEY(opaque);
+		else
+			offnum = PageGetMaxOffsetNumber(page);
+	}
+	else
+	{
+		BTScanInsertData inskey;
+		BTStack		stack;
+
+		_bt_skip_inskey(scan, dir, &inskey);
+		stack = _bt_search(rel, NULL, &inskey, &buf, BT_READ,
+						   scan->xs_snapshot);
+		_bt_freestack(stack);
+		if (!BufferIsValid(buf))
+			return false;
+
+		offnum = _bt_binsrch(rel, &inskey, buf);
+		if (ScanDirectionIsBackward(dir))
+			offnum = OffsetNumberPrev(offnum);
+	}
+
+	for (;;)
+	{
+		page = BufferGetPage(buf);
+		opaque = BTPageGetOpaque(page);
+
+		PredicateLockPage(rel, BufferGetBlockNumber(buf), scan->xs_snapshot);
+
+		if (ScanDirectionIsForward(dir))
+		{
+			if (offnum <= PageGetMaxOffsetNumber(page) && !P_IGNORE(opaque))
+				break;
+			if (P_RIGHTMOST(opaque))
+			{
+				_bt_relbuf(rel, buf);
+				return false;
+			}
+			buf = _bt_relandgetbuf(rel, buf, opaque->btpo_next, BT_READ);
+			page = BufferGetPage(buf);
+			TestForOldSnapshot(scan->xs_snapshot, rel, page);
+			offnum = P_FIRSTDATAKEY(BTPageGetOpaque(page));
+		}
+		else
+		{
+			if (offnum >= P_FIRSTDATAKEY(opaque) && !P_IGNORE(opaque))
+				break;
+			buf = _bt_walk_left(rel, buf, scan->xs_snapshot);
+			if (!BufferIsValid(buf))
+				return false;
+			offnum = PageGetMaxOffsetNumber(BufferGetPage(buf));
+		}
+	}
+
+	_bt_skip_copy_value(scan, page, offnum, value, isnull);
+	*blkno = BufferGetBlockNumber(buf);
+	_bt_relbuf(rel, buf);
+
+	return true;
+}
+
 /*
  * _bt_initialize_more_data() -- initialize moreLeft/moreRight appropriately
  * for scan direction
@@ -2517,3 +2906,81 @@ _bt_initialize_more_data(BTScanOpaque so, ScanDirection dir)
 	so->numKilled = 0;			/* just paranoia */
 	so->markItemIndex = -1;		/* ditto */
 }
+
+/*
+ * _bt_tid_exists() -- does the index contain caller's tuple?
+ *
+ * itup is a leaf tuple built from a heap tuple's index values, with t_tid
+ * set to the heap TID.  Returns true if the index has an entry with the same
+ * key values and heap TID, whether in a plain tuple or in a posting list.
+ * Entries marked LP_DEAD still count.  Only works with heapkeyspace indexes,
+ * where the heap TID is part of the key space, so that we need only descend
+ * to the one leaf page where the entry would be.
+ */
+bool
+_bt_tid_exists(Relation rel, Relation heaprel, IndexTuple itup)
+{
+	BTScanInsert key;
+	BTStack		stack;
+	Buffer		buf;
+	Page		page;
+	OffsetNumber offnum;
+	bool		found = false;
+
+	key = _bt_mkscankey(rel, itup);
+	if (!key->heapkeyspace)
+		elog(ERROR, "index \"%s\" does not use heapkeyspace",
+			 RelationGetRelationName(rel));
+	Assert(key->scantid != NULL);
+
+	stack = _bt_search(rel, heaprel, key, &buf, BT_READ, NULL);
+	_bt_freestack(stack);
+
+	if (!BufferIsValid(buf))
+	{
+		/* empty index */
+		pfree(key);
+		return false;
+	}
+
+	page = BufferGetPage(buf);
+	offnum = _bt_binsrch(rel, key, buf);
+	if (offnum <= PageGetMaxOffsetNumber(page) &&
+		_bt_compare(rel, key, page, offnum) == 0)
+	{
+		IndexTuple	curitup;
+
+		curitup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+		if (!BTreeTupleIsPosting(curitup))
+			found = true;
+		else
+		{
+			int			low = 0;
+			int			high = BTreeTupleGetNPosting(curitup);
+
+			/* _bt_compare only told us scantid is within the list's range */
+			while (high > low)
+			{
+				int			mid = low + ((high - low) / 2);
+				int32		res;
+
+				res = ItemPointerCompare(key->scantid,
+										 BTreeTupleGetPostingN(curitup, mid));
+				if (res > 0)
+					low = mid + 1;
+				else if (res < 0)
+					high = mid;
+				else
+				{
+					found = true;
+					break;
+				}
+			}
+		}
+	}
+
+	_bt_relbuf(rel, buf);
+	pfree(key);
+
+	return found;
+}
@@ -2016,6 +2016,18 @@ _bt_parallel_scan_and_sort(BTSpool *btspool, BTSpool *btspool2,
 	/* Notify leader */
 	ConditionVariableSignal(&btshared->workersdonecv);
 
+	/*
+	 * Help the leader with the final merge.  The leader's own worker
+	 * tuplesorts can't, as the leader only starts it once all participants
+	 * are done.
+	 */
+	if (IsParallelWorker())
+	{
+		tuplesort_merge_ranges(btspool->sortstate);
+		if (btspool2)
+			tuplesort_merge_ranges(btspool2->sortstate);
+	}
+
 	/* We can end tuplesorts immediately */
 	tuplesort_end(btspool->sortstate);
 	if (btspool2)
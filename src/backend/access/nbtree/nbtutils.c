@@ -20,10 +20,14 @@
 #include "access/nbtree.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
+#include "access/visibilitymap.h"
 #include "catalog/catalog.h"
 #include "commands/progress.h"
+#include "common/hashfn.h"
 #include "lib/qunique.h"
 #include "miscadmin.h"
+#include "optimizer/cost.h"
+#include "storage/spin.h"
 #include "utils/array.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
@@ -31,6 +35,12 @@
 #include "utils/rel.h"
 
 
+/*
+ * A skip scan gives up skipping after this many distinct values in a row
+ * had all their tuples on a single leaf page; see _bt_skip_advance.
+ */
+#define BT_SKIP_MAX_DENSE	8
+
 typedef struct BTSortArrayContext
 {
 	FmgrInfo	flinfo;
@@ -38,6 +48,17 @@ typedef struct BTSortArrayContext
 	bool		reverse;
 } BTSortArrayContext;
 
+static bool _bt_skip_wanted(IndexScanDesc scan);
+static void _bt_skip_init_key(IndexScanDesc scan, ScanKey skey,
+							  StrategyNumber strat);
+static void _bt_skip_release(IndexScanDesc scan, BTArrayKeyInfo *skip,
+							 ScanKey skey);
+static void _bt_skip_set_element(IndexScanDesc scan, BTArrayKeyInfo *skip,
+								 ScanKey skey, Datum value, bool isnull);
+static void _bt_skip_start(IndexScanDesc scan, BTArrayKeyInfo *skip,
+						   ScanDirection dir);
+static bool _bt_skip_advance(IndexScanDesc scan, BTArrayKeyInfo *skip,
+							 ScanDirection dir);
 static Datum _bt_find_extreme_element(IndexScanDesc scan, ScanKey skey,
 									  StrategyNumber strat,
 									  Datum *elems, int nelems);
@@ -202,6 +223,11 @@ _bt_freestack(BTStack stack)
  * array keys, it's sufficient to find the extreme element value and replace
  * the whole array with that scalar value.
  *
+ * If the first index column has no keys but the second one has, we also add
+ * a skip array for the first column: a key "col1 = <current element>" in
+ * arrayKeyData[0] makes the keys on the second column usable for positioning
+ * each primitive indexscan, instead of scanning the whole index.
+ *
  * Note: the reason we need so->arrayKeyData, rather than just scribbling
  * on scan->keyData, is that callers are permitted to call btrescan without
  * supplying a new set of scankey data.
@@ -213,10 +239,13 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 	int			numberOfKeys = scan->numberOfKeys;
 	int16	   *indoption = scan->indexRelation->rd_indoption;
 	int			numArrayKeys;
+	int			firstKey;
 	ScanKey		cur;
 	int			i;
 	MemoryContext oldContext;
 
+	so->skipArray = NULL;
+
 	/* Quick check to see if there are any array keys */
 	numArrayKeys = 0;
 	for (i = 0; i < numberOfKeys; i++)
@@ -236,8 +265,11 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 		}
 	}
 
+	/* The skip array, if any, goes first */
+	firstKey = _bt_skip_wanted(scan) ? 1 : 0;
+
 	/* Quit if nothing to do. */
-	if (numArrayKeys == 0)
+	if (numArrayKeys == 0 && firstKey == 0)
 	{
 		so->numArrayKeys = 0;
 		so->arrayKeyData = NULL;
@@ -258,17 +290,29 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 	oldContext = MemoryContextSwitchTo(so->arrayContext);
 
 	/* Create modifiable copy of scan->keyData in the workspace context */
-	so->arrayKeyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
-	memcpy(so->arrayKeyData,
+	so->numArrayKeyData = firstKey + numberOfKeys;
+	so->arrayKeyData = (ScanKey) palloc(so->numArrayKeyData * sizeof(ScanKeyData));
+	memcpy(so->arrayKeyData + firstKey,
 		   scan->keyData,
 		   scan->numberOfKeys * sizeof(ScanKeyData));
 
 	/* Allocate space for per-array data in the workspace context */
-	so->arrayKeys = (BTArrayKeyInfo *) palloc0(numArrayKeys * sizeof(BTArrayKeyInfo));
+	so->arrayKeys = (BTArrayKeyInfo *)
+		palloc0((firstKey + numArrayKeys) * sizeof(BTArrayKeyInfo));
 
-	/* Now process each array key */
+	/* Set up the skip array; its first element is found by _bt_skip_start */
 	numArrayKeys = 0;
-	for (i = 0; i < numberOfKeys; i++)
+	if (firstKey > 0)
+	{
+		_bt_skip_init_key(scan, &so->arrayKeyData[0], BTEqualStrategyNumber);
+		so->arrayKeys[0].scan_key = 0;
+		so->arrayKeys[0].skip = true;
+		so->skipArray = &so->arrayKeys[0];
+		numArrayKeys++;
+	}
+
+	/* Now process each array key */
+	for (i = firstKey; i < so->numArrayKeyData; i++)
 	{
 		ArrayType  *arrayval;
 		int16		elmlen;
@@ -367,10 +411,217 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 	}
 
 	so->numArrayKeys = numArrayKeys;
+	if (numArrayKeys < 0)
+		so->skipArray = NULL;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+/*
+ * _bt_skip_wanted() -- should the scan skip over the first index column?
+ *
+ * That's the case when the first column has no keys, but the second one has
+ * keys that can bound each primitive indexscan (IS NOT NULL alone can't).
+ * Parallel scans don't skip, since their participants step through the
+ * array keys in lockstep, which needs the elements to be known in advance.
+ */
+static bool
+_bt_skip_wanted(IndexScanDesc scan)
+{
+	Relation	rel = scan->indexRelation;
+	int			i;
 
+	if (!enable_indexskipscan || scan->parallel_scan != NULL ||
+		scan->numberOfKeys < 1 ||
+		IndexRelationGetNumberOfKeyAttributes(rel) < 2)
+		return false;
+
+	/* input keys are ordered by attribute, see _bt_preprocess_keys */
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey		cur = &scan->keyData[i];
+
+		if (cur->sk_attno != 2)
+			break;
+		if (!(cur->sk_flags & SK_SEARCHNOTNULL))
+			return OidIsValid(get_opfamily_member(rel->rd_opfamily[0],
+												  rel->rd_opcintype[0],
+												  rel->rd_opcintype[0],
+												  BTEqualStrategyNumber));
+	}
+
+	return false;
+}
+
+/*
+ * _bt_skip_init_key() -- set up the scan key of the skip array
+ *
+ * The key compares the first index column with an element using the
+ * opfamily's operator of the given strategy.  The caller sets the element.
+ */
+static void
+_bt_skip_init_key(IndexScanDesc scan, ScanKey skey, StrategyNumber strat)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	Oid			opcintype = rel->rd_opcintype[0];
+	Oid			opno;
+	MemoryContext oldContext;
+
+	opno = get_opfamily_member(rel->rd_opfamily[0], opcintype, opcintype,
+							   strat);
+	if (!OidIsValid(opno))
+		elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+			 strat, opcintype, opcintype, rel->rd_opfamily[0]);
+
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+	ScanKeyEntryInitialize(skey, 0, 1, strat, opcintype,
+						   rel->rd_indcollation[0], get_opcode(opno),
+						   (Datum) 0);
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ * _bt_skip_release() -- free the current element of the skip array
+ *
+ * Elements are copies made in arrayContext by _bt_skip_next.  The one saved
+ * in the mark must be kept.
+ */
+static void
+_bt_skip_release(IndexScanDesc scan, BTArrayKeyInfo *skip, ScanKey skey)
+{
+	Form_pg_attribute attr = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+	Pointer		ptr = DatumGetPointer(skey->sk_argument);
+
+	if (!attr->attbyval && !(skey->sk_flags & SK_ISNULL) && ptr != NULL &&
+		ptr != DatumGetPointer(skip->mark_key.sk_argument))
+		pfree(ptr);
+	skey->sk_argument = (Datum) 0;
+}
+
+/*
+ * _bt_skip_set_element() -- make value the current element of the skip array
+ *
+ * A NULL element is searched for as "IS NULL", which btree treats as an
+ * equality key.  _bt_preprocess_keys adds the index option flags again.
+ */
+static void
+_bt_skip_set_element(IndexScanDesc scan, BTArrayKeyInfo *skip, ScanKey skey,
+					 Datum value, bool isnull)
+{
+	Relation	rel = scan->indexRelation;
+
+	_bt_skip_release(scan, skip, skey);
+
+	if (isnull)
+	{
+		skey->sk_flags = SK_ISNULL | SK_SEARCHNULL;
+		skey->sk_strategy = InvalidStrategy;
+		skey->sk_subtype = InvalidOid;
+		skey->sk_collation = InvalidOid;
+		skey->sk_argument = (Datum) 0;
+	}
+	else
+	{
+		skey->sk_flags = 0;
+		skey->sk_strategy = BTEqualStrategyNumber;
+		skey->sk_subtype = rel->rd_opcintype[0];
+		skey->sk_collation = rel->rd_indcollation[0];
+		skey->sk_argument = value;
+	}
+}
+
+/*
+ * _bt_skip_start() -- set the skip array to the first value in the index
+ */
+static void
+_bt_skip_start(IndexScanDesc scan, BTArrayKeyInfo *skip, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	ScanKey		skey = &so->arrayKeyData[skip->scan_key];
+	Datum		value;
+	bool		isnull;
+
+	/* undo the switch to a plain scan made by a previous cycle */
+	if (skip->skip_done)
+	{
+		_bt_skip_release(scan, skip, skey);
+		_bt_skip_init_key(scan, skey, BTEqualStrategyNumber);
+	}
+	skip->skip_done = false;
+	skip->next_valid = false;
+	skip->ndense = 0;
+
+	/* in an empty index, any element will do */
+	if (!_bt_skip_next(scan, dir, true, &value, &isnull, &skip->elem_page))
+	{
+		value = (Datum) 0;
+		isnull = true;
+	}
+	_bt_skip_set_element(scan, skip, skey, value, isnull);
+}
+
+/*
+ * _bt_skip_advance() -- step the skip array to the next distinct value
+ *
+ * If the next value is on the leaf page where the scan for the previous one
+ * stopped, _bt_readpage saved it for us; otherwise we descend the index to
+ * find it.
+ *
+ * If many values in a row had all their tuples on one leaf page, the groups
+ * are too small for skipping to pay off.  Then we read the rest of the index
+ * in one go, with the skip array turned into a bound on the first column.
+ * That's only possible when there are no other arrays to step through for
+ * every value.
+ */
+static bool
+_bt_skip_advance(IndexScanDesc scan, BTArrayKeyInfo *skip, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	ScanKey		skey = &so->arrayKeyData[skip->scan_key];
+	Datum		value;
+	bool		isnull;
+
+	if (skip->skip_done)
+		return false;
+
+	if (skip->next_valid)
+	{
+		value = skip->next_value;
+		isnull = skip->next_null;
+		skip->next_valid = false;
+		if (skip->next_page == skip->elem_page)
+			skip->ndense++;
+		else
+			skip->ndense = 0;
+		skip->elem_page = skip->next_page;
+	}
+	else
+	{
+		if (!_bt_skip_next(scan, dir, false, &value, &isnull,
+						   &skip->elem_page))
+			return false;
+		skip->ndense = 0;
+	}
+
+	if (skip->ndense >= BT_SKIP_MAX_DENSE && so->numArrayKeys == 1 && !isnull)
+	{
+		bool		desc = (scan->indexRelation->rd_indoption[0] & INDOPTION_DESC) != 0;
+
+		_bt_skip_release(scan, skip, skey);
+		_bt_skip_init_key(scan, skey,
+						  ScanDirectionIsForward(dir) != desc ?
+						  BTGreaterEqualStrategyNumber :
+						  BTLessEqualStrategyNumber);
+		skey->sk_argument = value;
+		skip->skip_done = true;
+	}
+	else
+		_bt_skip_set_element(scan, skip, skey, value, isnull);
+
+	return true;
+}
+
 /*
  * _bt_find_extreme_element() -- get least or greatest array element
  *
@@ -532,6 +783,12 @@ _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 
+		if (curArrayKey->skip)
+		{
+			_bt_skip_start(scan, curArrayKey, dir);
+			continue;
+		}
+
 		Assert(curArrayKey->num_elems > 0);
 		if (ScanDirectionIsBackward(dir))
 			curArrayKey->cur_elem = curArrayKey->num_elems - 1;
@@ -569,6 +826,13 @@ _bt_advance_array_keys(IndexScanDesc scan, ScanDirection dir)
 		int			cur_elem = curArrayKey->cur_elem;
 		int			num_elems = curArrayKey->num_elems;
 
+		/* the skip array is the first one, so it advances most slowly */
+		if (curArrayKey->skip)
+		{
+			found = _bt_skip_advance(scan, curArrayKey, dir);
+			break;
+		}
+
 		if (ScanDirectionIsBackward(dir))
 		{
 			if (--cur_elem < 0)
@@ -627,6 +891,20 @@ _bt_mark_array_keys(IndexScanDesc scan)
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 
 		curArrayKey->mark_elem = curArrayKey->cur_elem;
+
+		/* for the skip array, remember the key itself */
+		if (curArrayKey->skip)
+		{
+			ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
+			ScanKeyData oldmark = curArrayKey->mark_key;
+
+			curArrayKey->mark_key = *skey;
+			curArrayKey->mark_done = curArrayKey->skip_done;
+
+			/* free the previously marked element, unless it's current */
+			if (oldmark.sk_argument != skey->sk_argument)
+				_bt_skip_release(scan, curArrayKey, &oldmark);
+		}
 	}
 }
 
@@ -642,6 +920,9 @@ _bt_restore_array_keys(IndexScanDesc scan)
 	bool		changed = false;
 	int			i;
 
+	/* the keys may go back, so don't reposition from where we stopped */
+	so->arrayLeaf = InvalidBlockNumber;
+
 	/* Restore each array key to its position when the mark was set */
 	for (i = 0; i < so->numArrayKeys; i++)
 	{
@@ -649,6 +930,17 @@ _bt_restore_array_keys(IndexScanDesc scan)
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 		int			mark_elem = curArrayKey->mark_elem;
 
+		if (curArrayKey->skip)
+		{
+			_bt_skip_release(scan, curArrayKey, skey);
+			*skey = curArrayKey->mark_key;
+			curArrayKey->skip_done = curArrayKey->mark_done;
+			curArrayKey->next_valid = false;
+			curArrayKey->ndense = 0;
+			changed = true;
+			continue;
+		}
+
 		if (curArrayKey->cur_elem != mark_elem)
 		{
 			curArrayKey->cur_elem = mark_elem;
@@ -785,10 +1077,14 @@ _bt_preprocess_keys(IndexScanDesc scan)
 		return;					/* done if qual-less scan */
 
 	/*
-	 * Read so->arrayKeyData if array keys are present, else scan->keyData
+	 * Read so->arrayKeyData if array keys are present, else scan->keyData.
+	 * The former can have one more key, for a skip array.
 	 */
 	if (so->arrayKeyData != NULL)
+	{
 		inkeys = so->arrayKeyData;
+		numberOfKeys = so->numArrayKeyData;
+	}
 	else
 		inkeys = scan->keyData;
 
@@ -1943,6 +2239,36 @@ typedef struct BTVacInfo
 
 static BTVacInfo *btvacinfo;
 
+/*
+ * All-visible hints for leaf pages
+ *
+ * VACUUM sets BTP_ALL_VISIBLE on a leaf page when it finds that all of the
+ * page's heap TIDs point to all-visible heap pages, so that index-only scans
+ * can skip the visibility map lookup for each TID.  The flag alone can't be
+ * trusted, since heap updates and deletes clear visibility map bits without
+ * touching the index.  So we also record in shared memory the heap's
+ * visibility map clear count as of the time the bits were checked (see
+ * visibilitymap_clear_count), and the hint is only valid until the count
+ * moves.  Inserting a TID on the page clears the flag.
+ *
+ * The table is a fixed-size cache indexed by a hash of the index and block
+ * number; a page whose entry has been taken over by another page has simply
+ * lost its hint.  Nothing here survives a restart, and a standby never sets
+ * entries, so the flag is ignored on pages written before or elsewhere.
+ */
+typedef struct BTAllVisHint
+{
+	slock_t		mutex;			/* protects the fields below */
+	RelFileLocator locator;		/* index the entry is for */
+	BlockNumber blkno;			/* leaf page the entry is for */
+	uint64		clearcount;		/* heap's clear count when checked */
+} BTAllVisHint;
+
+static BTAllVisHint *btallvishints;
+
+/* number of entries in btallvishints */
+#define BT_ALLVIS_HINTS		Max(NBuffers / 8, 1024)
+
 
 /*
  * _bt_vacuum_cycleid --- get the active vacuum cycle ID for an index,
@@ -2088,6 +2414,8 @@ BTreeShmemSize(void)
 
 	size = offsetof(BTVacInfo, vacuums);
 	size = add_size(size, mul_size(MaxBackends, sizeof(BTOneVacInfo)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(BT_ALLVIS_HINTS, sizeof(BTAllVisHint)));
 	return size;
 }
 
@@ -2102,6 +2430,10 @@ BTreeShmemInit(void)
 	btvacinfo = (BTVacInfo *) ShmemInitStruct("BTree Vacuum State",
 											  BTreeShmemSize(),
 											  &found);
+	btallvishints = (BTAllVisHint *)
+		((char *) btvacinfo +
+		 MAXALIGN(offsetof(BTVacInfo, vacuums) +
+				  mul_size(MaxBackends, sizeof(BTOneVacInfo))));
 
 	if (!IsUnderPostmaster)
 	{
@@ -2117,11 +2449,145 @@ BTreeShmemInit(void)
 
 		btvacinfo->num_vacuums = 0;
 		btvacinfo->max_vacuums = MaxBackends;
+
+		for (int i = 0; i < BT_ALLVIS_HINTS; i++)
+		{
+			SpinLockInit(&btallvishints[i].mutex);
+			btallvishints[i].locator.relNumber = InvalidRelFileNumber;
+			btallvishints[i].blkno = InvalidBlockNumber;
+		}
 	}
 	else
 		Assert(found);
 }
 
+/*
+ * Return the all-visible hint table entry for a leaf page
+ */
+static BTAllVisHint *
+_bt_allvis_hint_entry(Relation rel, BlockNumber blkno)
+{
+	uint32		hash;
+
+	hash = hash_bytes((const unsigned char *) &rel->rd_locator,
+					  sizeof(RelFileLocator));
+	hash = hash_combine(hash, murmurhash32(blkno));
+
+	return &btallvishints[hash % BT_ALLVIS_HINTS];
+}
+
+/*
+ * _bt_set_allvisible_hint() -- set all-visible hint on a leaf page
+ *
+ * Called by VACUUM with a cleanup lock on the leaf page, after deleting its
+ * dead TIDs.  If every remaining TID points to an all-visible heap page, we
+ * set BTP_ALL_VISIBLE and remember the heap's visibility map clear count for
+ * the page.  Like BTP_HAS_GARBAGE, the flag is not WAL-logged.
+ */
+void
+_bt_set_allvisible_hint(Relation rel, Relation heaprel, Buffer buf)
+{
+	Page		page = BufferGetPage(buf);
+	BTPageOpaque opaque = BTPageGetOpaque(page);
+	OffsetNumber offnum,
+				minoff,
+				maxoff;
+	Buffer		vmbuffer = InvalidBuffer;
+	BlockNumber lastblkno = InvalidBlockNumber;
+	uint64		clearcount;
+	bool		allvisible = true;
+	BTAllVisHint *hint;
+
+	Assert(P_ISLEAF(opaque));
+
+	/* must be read before the bits, see visibilitymap_clear_count */
+	clearcount = visibilitymap_clear_count(heaprel);
+
+	minoff = P_FIRSTDATAKEY(opaque);
+	maxoff = PageGetMaxOffsetNumber(page);
+	for (offnum = minoff;
+		 allvisible && offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		IndexTuple	itup;
+		int			nhtids;
+
+		itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+		nhtids = BTreeTupleIsPosting(itup) ? BTreeTupleGetNPosting(itup) : 1;
+
+		for (int i = 0; i < nhtids; i++)
+		{
+			ItemPointer htid;
+			BlockNumber heapblkno;
+
+			if (BTreeTupleIsPosting(itup))
+				htid = BTreeTupleGetPostingN(itup, i);
+			else
+				htid = &itup->t_tid;
+
+			/* TIDs of the same heap page are usually next to each other */
+			heapblkno = ItemPointerGetBlockNumber(htid);
+			if (heapblkno == lastblkno)
+				continue;
+			lastblkno = heapblkno;
+
+			if (!VM_ALL_VISIBLE(heaprel, heapblkno, &vmbuffer))
+			{
+				allvisible = false;
+				break;
+			}
+		}
+	}
+
+	if (BufferIsValid(vmbuffer))
+		ReleaseBuffer(vmbuffer);
+
+	if (!allvisible)
+		return;
+
+	hint = _bt_allvis_hint_entry(rel, BufferGetBlockNumber(buf));
+	SpinLockAcquire(&hint->mutex);
+	hint->locator = rel->rd_locator;
+	hint->blkno = BufferGetBlockNumber(buf);
+	hint->clearcount = clearcount;
+	SpinLockRelease(&hint->mutex);
+
+	if (!P_ALL_VISIBLE(opaque))
+	{
+		opaque->btpo_flags |= BTP_ALL_VISIBLE;
+		MarkBufferDirtyHint(buf, true);
+	}
+}
+
+/*
+ * _bt_allvisible_hint_valid() -- check a leaf page's all-visible hint
+ *
+ * Caller must hold at least a shared lock on the leaf page, so that no TID
+ * can be added to it while we look.  Returns true if all of the page's TIDs
+ * point to heap pages that are still all-visible.
+ */
+bool
+_bt_allvisible_hint_valid(Relation rel, Relation heaprel, Buffer buf)
+{
+	BTPageOpaque opaque = BTPageGetOpaque(BufferGetPage(buf));
+	BlockNumber blkno = BufferGetBlockNumber(buf);
+	BTAllVisHint *hint;
+	bool		match;
+	uint64		clearcount;
+
+	if (!P_ALL_VISIBLE(opaque))
+		return false;
+
+	hint = _bt_allvis_hint_entry(rel, blkno);
+	SpinLockAcquire(&hint->mutex);
+	match = RelFileLocatorEquals(hint->locator, rel->rd_locator) &&
+		hint->blkno == blkno;
+	clearcount = hint->clearcount;
+	SpinLockRelease(&hint->mutex);
+
+	return match && clearcount == visibilitymap_clear_count(heaprel);
+}
+
 bytea *
 btoptions(Datum reloptions, bool validate)
 {
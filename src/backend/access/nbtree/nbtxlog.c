@@ -1119,6 +1119,12 @@ btree_mask(char *pagedata, BlockNumber blkno)
 	 */
 	maskopaq->btpo_flags &= ~BTP_HAS_GARBAGE;
 
+	/*
+	 * BTP_ALL_VISIBLE is also an un-logged hint, which insertions clear
+	 * without replay doing the same.  See _bt_set_allvisible_hint().
+	 */
+	maskopaq->btpo_flags &= ~BTP_ALL_VISIBLE;
+
 	/*
 	 * During replay of a btree page split, we don't set the BTP_SPLIT_END
 	 * flag of the right sibling and initialize the cycle_id to 0 for the same
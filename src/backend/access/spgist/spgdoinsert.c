@@ -290,7 +290,7 @@ addLeafTuple(Relation index, SpGistState *state, SpGistLeafTuple leafTuple,
 
 	MarkBufferDirty(current->buffer);
 
-	if (RelationNeedsWAL(index) && !state->isBuild)
+	if (RelationNeedsWAL(index) && !state->skipWAL)
 	{
 		XLogRecPtr	recptr;
 		int			flags;
@@ -518,7 +518,7 @@ moveLeafs(Relation index, SpGistState *state,
 	MarkBufferDirty(current->buffer);
 	MarkBufferDirty(nbuf);
 
-	if (RelationNeedsWAL(index) && !state->isBuild)
+	if (RelationNeedsWAL(index) && !state->skipWAL)
 	{
 		XLogRecPtr	recptr;
 
@@ -1358,7 +1358,7 @@ doPickSplit(Relation index, SpGistState *state,
 		saveCurrent.buffer = InvalidBuffer;
 	}
 
-	if (RelationNeedsWAL(index) && !state->isBuild)
+	if (RelationNeedsWAL(index) && !state->skipWAL)
 	{
 		XLogRecPtr	recptr;
 		int			flags;
@@ -1555,7 +1555,7 @@ spgAddNodeAction(Relation index, SpGistState *state,
 
 		MarkBufferDirty(current->buffer);
 
-		if (RelationNeedsWAL(index) && !state->isBuild)
+		if (RelationNeedsWAL(index) && !state->skipWAL)
 		{
 			XLogRecPtr	recptr;
 
@@ -1668,7 +1668,7 @@ spgAddNodeAction(Relation index, SpGistState *state,
 
 		MarkBufferDirty(saveCurrent.buffer);
 
-		if (RelationNeedsWAL(index) && !state->isBuild)
+		if (RelationNeedsWAL(index) && !state->skipWAL)
 		{
 			XLogRecPtr	recptr;
 			int			flags;
@@ -1864,7 +1864,7 @@ spgSplitNodeAction(Relation index, SpGistState *state,
 
 	MarkBufferDirty(current->buffer);
 
-	if (RelationNeedsWAL(index) && !state->isBuild)
+	if (RelationNeedsWAL(index) && !state->skipWAL)
 	{
 		XLogRecPtr	recptr;
 
@@ -17,18 +17,75 @@
 #include "postgres.h"
 
 #include "access/genam.h"
+#include "access/parallel.h"
 #include "access/spgist_private.h"
 #include "access/spgxlog.h"
+#include "access/table.h"
 #include "access/tableam.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "catalog/index.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"		/* pgrminclude ignore */
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_SPGIST_SHARED		UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000002)
+#define PARALLEL_KEY_WAL_USAGE			UINT64CONST(0xB000000000000003)
+#define PARALLEL_KEY_BUFFER_USAGE		UINT64CONST(0xB000000000000004)
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment.
+ *
+ * Unlike btree, SP-GiST has no sorted build: all participants insert into the
+ * index directly, the same way concurrent backends insert into an existing
+ * index.
+ */
+typedef struct SpGistShared
+{
+	/* immutable state */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+
+	/* mutex protects the fields below */
+	slock_t		mutex;
+
+	double		reltuples;
+	double		indtuples;
+	bool		brokenhotchain;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} SpGistShared;
+
+#define ParallelTableScanFromSpGistShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(SpGistShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct SpGistLeader
+{
+	ParallelContext *pcxt;
+	SpGistShared *spgshared;
+	Snapshot	snapshot;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+} SpGistLeader;
 
 typedef struct
 {
@@ -37,6 +94,13 @@ typedef struct
 	MemoryContext tmpCtx;		/* per-tuple temporary context */
 } SpGistBuildState;
 
+static SpGistLeader *_spg_begin_parallel(Relation heap, Relation index,
+										 bool isconcurrent, int request);
+static void _spg_end_parallel(SpGistLeader *spgleader);
+static void _spg_parallel_scan_and_insert(SpGistShared *spgshared,
+										  Relation heap, Relation index,
+										  bool progress);
+
 
 /* Callback to process one heap tuple during table_index_build_scan */
 static void
@@ -50,10 +114,11 @@ spgistBuildCallback(Relation index, ItemPointer tid, Datum *values,
 	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
 
 	/*
-	 * Even though no concurrent insertions can be happening, we still might
-	 * get a buffer-locking failure due to bgwriter or checkpointer taking a
-	 * lock on some buffer.  So we need to be willing to retry.  We can flush
-	 * any temp data when retrying.
+	 * Even though no concurrent insertions can be happening (except from the
+	 * other participants of a parallel build), we still might get a
+	 * buffer-locking failure due to bgwriter or checkpointer taking a lock on
+	 * some buffer.  So we need to be willing to retry.  We can flush any temp
+	 * data when retrying.
 	 */
 	while (!spgdoinsert(index, &buildstate->spgstate, tid,
 						values, isnull))
@@ -77,6 +142,7 @@ spgbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	IndexBuildResult *result;
 	double		reltuples;
 	SpGistBuildState buildstate;
+	SpGistLeader *spgleader = NULL;
 	Buffer		metabuffer,
 				rootbuffer,
 				nullbuffer;
@@ -112,22 +178,48 @@ spgbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	UnlockReleaseBuffer(rootbuffer);
 	UnlockReleaseBuffer(nullbuffer);
 
-	/*
-	 * Now insert all the heap data into the index
-	 */
-	initSpGistState(&buildstate.spgstate, index);
-	buildstate.spgstate.isBuild = true;
-	buildstate.indtuples = 0;
+	/* Attempt to launch parallel worker scan when required */
+	if (indexInfo->ii_ParallelWorkers > 0)
+		spgleader = _spg_begin_parallel(heap, index, indexInfo->ii_Concurrent,
+										indexInfo->ii_ParallelWorkers);
 
-	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
-											  "SP-GiST build temporary context",
-											  ALLOCSET_DEFAULT_SIZES);
+	if (spgleader)
+	{
+		SpGistShared *spgshared = spgleader->spgshared;
 
-	reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
-									   spgistBuildCallback, (void *) &buildstate,
-									   NULL);
+		/*
+		 * All participants have inserted their share of the heap once the
+		 * workers are done.
+		 */
+		WaitForParallelWorkersToFinish(spgleader->pcxt);
 
-	MemoryContextDelete(buildstate.tmpCtx);
+		reltuples = spgshared->reltuples;
+		buildstate.indtuples = (int64) spgshared->indtuples;
+		if (spgshared->brokenhotchain)
+			indexInfo->ii_BrokenHotChain = true;
+
+		_spg_end_parallel(spgleader);
+	}
+	else
+	{
+		/*
+		 * Now insert all the heap data into the index
+		 */
+		initSpGistState(&buildstate.spgstate, index);
+		buildstate.spgstate.isBuild = true;
+		buildstate.spgstate.skipWAL = true;
+		buildstate.indtuples = 0;
+
+		buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+												  "SP-GiST build temporary context",
+												  ALLOCSET_DEFAULT_SIZES);
+
+		reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
+										   spgistBuildCallback, (void *) &buildstate,
+										   NULL);
+
+		MemoryContextDelete(buildstate.tmpCtx);
+	}
 
 	SpGistUpdateMetaPage(index);
 
@@ -234,3 +326,267 @@ spginsert(Relation index, Datum *values, bool *isnull,
 	/* return false since we've not done any unique check */
 	return false;
 }
+
+/*
+ * Create parallel context, launch workers, and join the build ourselves.
+ *
+ * Returns NULL, without having scanned anything, if no worker process could
+ * be launched; caller then does a serial build.
+ */
+static SpGistLeader *
+_spg_begin_parallel(Relation heap, Relation index, bool isconcurrent,
+					int request)
+{
+	ParallelContext *pcxt;
+	Snapshot	snapshot;
+	Size		estspgshared;
+	SpGistShared *spgshared;
+	SpGistLeader *spgleader = (SpGistLeader *) palloc0(sizeof(SpGistLeader));
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+	int			querylen;
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of spgist
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_spg_parallel_build_main",
+								 request);
+
+	/*
+	 * Prepare for scan of the base relation.  As in btree builds, a normal
+	 * build uses SnapshotAny, and a concurrent one a regular MVCC snapshot.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/* Estimate size for our own PARALLEL_KEY_SPGIST_SHARED workspace */
+	estspgshared = add_size(BUFFERALIGN(sizeof(SpGistShared)),
+							table_parallelscan_estimate(heap, snapshot));
+	shm_toc_estimate_chunk(&pcxt->estimator, estspgshared);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate space for WalUsage and BufferUsage */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+	else
+		querylen = 0;			/* keep compiler quiet */
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* If no DSM segment was available, back out (do serial build) */
+	if (pcxt->seg == NULL)
+	{
+		if (IsMVCCSnapshot(snapshot))
+			UnregisterSnapshot(snapshot);
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	/* Store shared build state, for which we reserved space */
+	spgshared = (SpGistShared *) shm_toc_allocate(pcxt->toc, estspgshared);
+	spgshared->heaprelid = RelationGetRelid(heap);
+	spgshared->indexrelid = RelationGetRelid(index);
+	spgshared->isconcurrent = isconcurrent;
+	SpinLockInit(&spgshared->mutex);
+	spgshared->reltuples = 0.0;
+	spgshared->indtuples = 0.0;
+	spgshared->brokenhotchain = false;
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromSpGistShared(spgshared),
+								  snapshot);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_SPGIST_SHARED, spgshared);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	/*
+	 * Allocate space for each worker's WalUsage and BufferUsage; no need to
+	 * initialize.
+	 */
+	walusage = shm_toc_allocate(pcxt->toc,
+								mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_WAL_USAGE, walusage);
+	bufferusage = shm_toc_allocate(pcxt->toc,
+								   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BUFFER_USAGE, bufferusage);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	spgleader->pcxt = pcxt;
+	spgleader->spgshared = spgshared;
+	spgleader->snapshot = snapshot;
+	spgleader->walusage = walusage;
+	spgleader->bufferusage = bufferusage;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_spg_end_parallel(spgleader);
+		return NULL;
+	}
+
+	/* Join heap scan ourselves */
+	_spg_parallel_scan_and_insert(spgshared, heap, index, true);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+
+	return spgleader;
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ */
+static void
+_spg_end_parallel(SpGistLeader *spgleader)
+{
+	int			i;
+
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(spgleader->pcxt);
+
+	/*
+	 * Next, accumulate WAL usage.  (This must wait for the workers to finish,
+	 * or we might get incomplete data.)
+	 */
+	for (i = 0; i < spgleader->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&spgleader->bufferusage[i], &spgleader->walusage[i]);
+
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(spgleader->snapshot))
+		UnregisterSnapshot(spgleader->snapshot);
+	DestroyParallelContext(spgleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_spg_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	SpGistShared *spgshared;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	WalUsage   *walusage;
+	BufferUsage *bufferusage;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up spgist shared state */
+	spgshared = shm_toc_lookup(toc, PARALLEL_KEY_SPGIST_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!spgshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(spgshared->heaprelid, heapLockmode);
+	indexRel = index_open(spgshared->indexrelid, indexLockmode);
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	_spg_parallel_scan_and_insert(spgshared, heapRel, indexRel, false);
+
+	/* Report WAL/buffer usage during parallel execution */
+	bufferusage = shm_toc_lookup(toc, PARALLEL_KEY_BUFFER_USAGE, false);
+	walusage = shm_toc_lookup(toc, PARALLEL_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&bufferusage[ParallelWorkerNumber],
+						  &walusage[ParallelWorkerNumber]);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Perform a participant's portion of a parallel build: scan its share of the
+ * heap and insert the tuples into the index.
+ *
+ * The other participants insert at the same time, so we can't take the
+ * shortcuts of a serial build, which assumes nobody else looks at the index:
+ * moved tuples leave redirects behind, as in regular insertions.  Like a
+ * serial build, we write no WAL; the leader logs the whole index at the end.
+ */
+static void
+_spg_parallel_scan_and_insert(SpGistShared *spgshared,
+							  Relation heap, Relation index, bool progress)
+{
+	SpGistBuildState buildstate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+
+	initSpGistState(&buildstate.spgstate, index);
+	buildstate.spgstate.skipWAL = true;
+	buildstate.indtuples = 0;
+
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "SP-GiST build temporary context",
+											  ALLOCSET_DEFAULT_SIZES);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = spgshared->isconcurrent;
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromSpGistShared(spgshared));
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   spgistBuildCallback, (void *) &buildstate,
+									   scan);
+
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	/* Done.  Record ambuild statistics. */
+	SpinLockAcquire(&spgshared->mutex);
+	spgshared->reltuples += reltuples;
+	spgshared->indtuples += buildstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		spgshared->brokenhotchain = true;
+	SpinLockRelease(&spgshared->mutex);
+}
@@ -112,7 +112,8 @@ TableScanDesc
 table_beginscan_catalog(Relation relation, int nkeys, struct ScanKeyData *key)
 {
 	uint32		flags = SO_TYPE_SEQSCAN |
-		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE | SO_TEMP_SNAPSHOT;
+		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE | SO_TEMP_SNAPSHOT |
+		SO_NEED_TUPLES;
 	Oid			relid = RelationGetRelid(relation); // 就是((relation)->rd_id)
 	Snapshot	snapshot = RegisterSnapshot(GetCatalogSnapshot(relid));
 
@@ -171,12 +172,13 @@ table_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan,
 	}
 }
 
-TableScanDesc
-table_beginscan_parallel(Relation relation, ParallelTableScanDesc pscan)
+static TableScanDesc
+table_beginscan_parallel_internal(Relation relation,
+								  ParallelTableScanDesc pscan,
+								  int nkeys, struct ScanKeyData *key,
+								  uint32 flags)
 {
 	Snapshot	snapshot;
-	uint32		flags = SO_TYPE_SEQSCAN |
-		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE;
 
 	Assert(RelationGetRelid(relation) == pscan->phs_relid);
 
@@ -193,10 +195,36 @@ table_beginscan_parallel(Relation relation, ParallelTableScanDesc pscan)
 		snapshot = SnapshotAny;
 	}
 
-	return relation->rd_tableam->scan_begin(relation, snapshot, 0, NULL,
+	return relation->rd_tableam->scan_begin(relation, snapshot, nkeys, key,
 											pscan, flags);
 }
 
+TableScanDesc
+table_beginscan_parallel(Relation relation, ParallelTableScanDesc pscan)
+{
+	return table_beginscan_parallel_keys(relation, pscan, 0, NULL);
+}
+
+TableScanDesc
+table_beginscan_parallel_keys(Relation relation, ParallelTableScanDesc pscan,
+							  int nkeys, struct ScanKeyData *key)
+{
+	uint32		flags = SO_TYPE_SEQSCAN |
+		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE | SO_NEED_TUPLES;
+
+	return table_beginscan_parallel_internal(relation, pscan, nkeys, key,
+											 flags);
+}
+
+TableScanDesc
+table_beginscan_parallel_count(Relation relation, ParallelTableScanDesc pscan)
+{
+	uint32		flags = SO_TYPE_SEQSCAN |
+		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE;
+
+	return table_beginscan_parallel_internal(relation, pscan, 0, NULL, flags);
+}
+
 
 /* ----------------------------------------------------------------------------
  * Index scan related functions.
@@ -630,8 +658,15 @@ table_block_relation_size(Relation rel, ForkNumber forkNumber)
 	/* InvalidForkNumber indicates returning the size for all forks */
 	if (forkNumber == InvalidForkNumber)
 	{
-		for (int i = 0; i < MAX_FORKNUM; i++)
+		for (int i = 0; i <= MAX_FORKNUM; i++)
+		{
+			if (i == INIT_FORKNUM)
+				continue;
+			if (i == TUPLECOUNT_FORKNUM &&
+				!smgrexists(RelationGetSmgr(rel), i))
+				continue;
 			nblocks += smgrnblocks(RelationGetSmgr(rel), i);
+		}
 	}
 	else
 		nblocks = smgrnblocks(RelationGetSmgr(rel), forkNumber);
@@ -18,6 +18,7 @@
 #include "access/table.h"
 #include "access/toast_helper.h"
 #include "access/toast_internals.h"
+#include "catalog/pg_compression_dictionary.h"
 #include "catalog/pg_type_d.h"
 #include "varatt.h"
 
@@ -230,8 +231,16 @@ toast_tuple_try_compression(ToastTupleContext *ttc, int attribute)
 	Datum	   *value = &ttc->ttc_values[attribute];
 	Datum		new_value;
 	ToastAttrInfo *attr = &ttc->ttc_attr[attribute];
+	char		cmethod = attr->tai_compression;
+	Oid			dictid = InvalidOid;
 
-	new_value = toast_compress_datum(*value, attr->tai_compression);
+	/* zstd can use a dictionary trained for this column by ANALYZE */
+	if (!CompressionMethodIsValid(cmethod))
+		cmethod = default_toast_compression;
+	if (cmethod == TOAST_ZSTD_COMPRESSION)
+		dictid = GetColumnCompressionDictionary(ttc->ttc_rel, attribute + 1);
+
+	new_value = toast_compress_datum_ext(*value, cmethod, dictid);
 
 	if (DatumGetPointer(new_value) != NULL)
 	{
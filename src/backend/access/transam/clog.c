@@ -35,6 +35,7 @@
 #include "access/clog.h"
 #include "access/slru.h"
 #include "access/transam.h"
+#include "access/twophase.h"
 #include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "access/xlogutils.h"
@@ -43,6 +44,7 @@
 #include "pgstat.h"
 #include "storage/proc.h"
 #include "storage/sync.h"
+#include "utils/guc_hooks.h"
 
 /*
  * Defines for CLOG page sizes.  A page is the same BLCKSZ as is used
@@ -74,13 +76,6 @@
 #define GetLSNIndex(slotno, xid)	((slotno) * CLOG_LSNS_PER_PAGE + \
 	((xid) % (TransactionId) CLOG_XACTS_PER_PAGE) / CLOG_XACTS_PER_LSN_GROUP)
 
-/*
- * The number of subtransactions below which we consider to apply clog group
- * update optimization.  Testing reveals that the number higher than this can
- * hurt performance.
- */
-#define THRESHOLD_SUBTRANS_CLOG_OPT	5
-
 /*
  * Link to shared-memory data structures for CLOG control
  */
@@ -97,13 +92,18 @@ static void WriteTruncateXlogRec(int pageno, TransactionId oldestXact,
 static void TransactionIdSetPageStatus(TransactionId xid, int nsubxids,
 									   TransactionId *subxids, XidStatus status,
 									   XLogRecPtr lsn, int pageno,
-									   bool all_xact_same_page);
+									   bool shared_xids);
 static void TransactionIdSetStatusBit(TransactionId xid, XidStatus status,
 									  XLogRecPtr lsn, int slotno);
 static void set_status_by_pages(int nsubxids, TransactionId *subxids,
-								XidStatus status, XLogRecPtr lsn);
-static bool TransactionGroupUpdateXidStatus(TransactionId xid,
-											XidStatus status, XLogRecPtr lsn, int pageno);
+								XidStatus status, XLogRecPtr lsn,
+								bool shared_xids);
+static PGPROC *TransactionGroupSubxidsProc(TransactionId xid, int nsubxids,
+										   TransactionId *subxids);
+static bool TransactionGroupUpdateXidStatus(TransactionId xid, int nsubxids,
+											TransactionId *subxids,
+											XidStatus status, XLogRecPtr lsn,
+											int pageno);
 static void TransactionIdSetPageStatusInternal(TransactionId xid, int nsubxids,
 											   TransactionId *subxids, XidStatus status,
 											   XLogRecPtr lsn, int pageno);
@@ -139,6 +139,9 @@ static void TransactionIdSetPageStatusInternal(TransactionId xid, int nsubxids,
  * Note that as far as concurrent checkers are concerned, main transaction
  * commit as a whole is still atomic.
  *
+ * Each of those page updates can be done through the group update
+ * mechanism, see TransactionIdSetPageStatus.
+ *
  * Example:
  *		TransactionId t commits and has subxids t1, t2, t3, t4
  *		t is on page p1, t1 is also on p1, t2 and t3 are on p2, t4 is on p3
@@ -163,11 +166,20 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 						   TransactionId *subxids, XidStatus status, XLogRecPtr lsn)
 {
 	int			pageno = TransactionIdToPage(xid);	/* get page of parent */
+	PGPROC	   *proc;
 	int			i;
 
 	Assert(status == TRANSACTION_STATUS_COMMITTED ||
 		   status == TRANSACTION_STATUS_ABORTED);
 
+	/*
+	 * If the subxids are also in the subxid cache of a PGPROC, use that copy,
+	 * which a group leader can read too.
+	 */
+	proc = TransactionGroupSubxidsProc(xid, nsubxids, subxids);
+	if (proc != NULL)
+		subxids = proc->subxids.xids;
+
 	/*
 	 * See how many subxids, if any, are on the same page as the parent, if
 	 * any.
@@ -187,7 +199,7 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 		 * Set the parent and all subtransactions in a single call
 		 */
 		TransactionIdSetPageStatus(xid, nsubxids, subxids, status, lsn,
-								   pageno, true);
+								   pageno, proc != NULL);
 	}
 	else
 	{
@@ -206,7 +218,8 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 		if (status == TRANSACTION_STATUS_COMMITTED)
 			set_status_by_pages(nsubxids - nsubxids_on_first_page,
 								subxids + nsubxids_on_first_page,
-								TRANSACTION_STATUS_SUB_COMMITTED, lsn);
+								TRANSACTION_STATUS_SUB_COMMITTED, lsn,
+								proc != NULL);
 
 		/*
 		 * Now set the parent and subtransactions on same page as the parent,
@@ -214,7 +227,7 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 		 */
 		pageno = TransactionIdToPage(xid);
 		TransactionIdSetPageStatus(xid, nsubxids_on_first_page, subxids, status,
-								   lsn, pageno, false);
+								   lsn, pageno, proc != NULL);
 
 		/*
 		 * Now work through the rest of the subxids one clog page at a time,
@@ -222,7 +235,7 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
 		 */
 		set_status_by_pages(nsubxids - nsubxids_on_first_page,
 							subxids + nsubxids_on_first_page,
-							status, lsn);
+							status, lsn, proc != NULL);
 	}
 }
 
@@ -234,7 +247,7 @@ TransactionIdSetTreeStatus(TransactionId xid, int nsubxids,
  */
 static void
 set_status_by_pages(int nsubxids, TransactionId *subxids,
-					XidStatus status, XLogRecPtr lsn)
+					XidStatus status, XLogRecPtr lsn, bool shared_xids)
 {
 	int			pageno = TransactionIdToPage(subxids[0]);
 	int			offset = 0;
@@ -258,62 +271,87 @@ set_status_by_pages(int nsubxids, TransactionId *subxids,
 
 		TransactionIdSetPageStatus(InvalidTransactionId,
 								   num_on_page, subxids + offset,
-								   status, lsn, pageno, false);
+								   status, lsn, pageno, shared_xids);
 		offset = i;
 		pageno = nextpageno;
 	}
 }
 
+/*
+ * Find a PGPROC whose subxid cache holds exactly the given subxids of xid,
+ * in the same order: our own while committing or aborting our transaction,
+ * or the dummy PGPROC of the prepared transaction we are finishing.
+ * Returns NULL if there is none, for example because the cache overflowed.
+ */
+static PGPROC *
+TransactionGroupSubxidsProc(TransactionId xid, int nsubxids,
+							TransactionId *subxids)
+{
+	PGPROC	   *proc;
+
+	if (xid == MyProc->xid)
+		proc = MyProc;
+	else if (max_prepared_xacts > 0)
+		proc = TwoPhaseGetLockedDummyProc(xid);
+	else
+		proc = NULL;
+
+	if (proc == NULL ||
+		proc->subxidStatus.overflowed ||
+		proc->subxidStatus.count != nsubxids ||
+		(nsubxids > 0 &&
+		 memcmp(subxids, proc->subxids.xids,
+				nsubxids * sizeof(TransactionId)) != 0))
+		return NULL;
+
+	return proc;
+}
+
 /*
  * Record the final state of transaction entries in the commit log for all
  * entries on a single page.  Atomic only on this page.
+ *
+ * shared_xids says that the subxids live in shared memory, in the subxid
+ * cache of a PGPROC, so that another backend can set their status for us.
  */
 static void
 TransactionIdSetPageStatus(TransactionId xid, int nsubxids,
 						   TransactionId *subxids, XidStatus status,
 						   XLogRecPtr lsn, int pageno,
-						   bool all_xact_same_page)
+						   bool shared_xids)
 {
-	/* Can't use group update when PGPROC overflows. */
-	StaticAssertDecl(THRESHOLD_SUBTRANS_CLOG_OPT <= PGPROC_MAX_CACHED_SUBXIDS,
-					 "group clog threshold less than PGPROC cached subxids");
+	LWLock	   *lock;
 
 	/*
-	 * When there is contention on XactSLRULock, we try to group multiple
-	 * updates; a single leader process will perform transaction status
-	 * updates for multiple backends so that the number of times XactSLRULock
-	 * needs to be acquired is reduced.
-	 *
-	 * For this optimization to be safe, the XID and subxids in MyProc must be
-	 * the same as the ones for which we're setting the status.  Check that
-	 * this is the case.
+	 * When there is contention on the SLRU bank lock we need, we try to group
+	 * multiple updates; a single leader process will perform transaction
+	 * status updates for multiple backends so that the number of times the
+	 * bank lock needs to be acquired is reduced.
 	 *
-	 * For this optimization to be efficient, we shouldn't have too many
-	 * sub-XIDs and all of the XIDs for which we're adjusting clog should be
-	 * on the same page.  Check those conditions, too.
+	 * For this optimization to be safe, the leader must be able to read the
+	 * subxids, so they must be in shared memory.  Any number of them will
+	 * do, and a transaction spanning several pages joins a group for each
+	 * page in turn.
 	 */
-	if (all_xact_same_page && xid == MyProc->xid &&
-		nsubxids <= THRESHOLD_SUBTRANS_CLOG_OPT &&
-		nsubxids == MyProc->subxidStatus.count &&
-		(nsubxids == 0 ||
-		 memcmp(subxids, MyProc->subxids.xids,
-				nsubxids * sizeof(TransactionId)) == 0))
+	lock = SimpleLruGetBankLock(XactCtl, pageno);
+	if (shared_xids)
 	{
 		/*
-		 * If we can immediately acquire XactSLRULock, we update the status of
+		 * If we can immediately acquire the bank lock, we update the status of
 		 * our own XID and release the lock.  If not, try use group XID
 		 * update.  If that doesn't work out, fall back to waiting for the
 		 * lock to perform an update for this transaction only.
 		 */
-		if (LWLockConditionalAcquire(XactSLRULock, LW_EXCLUSIVE))
+		if (LWLockConditionalAcquire(lock, LW_EXCLUSIVE))
 		{
 			/* Got the lock without waiting!  Do the update. */
 			TransactionIdSetPageStatusInternal(xid, nsubxids, subxids, status,
 											   lsn, pageno);
-			LWLockRelease(XactSLRULock);
+			LWLockRelease(lock);
 			return;
 		}
-		else if (TransactionGroupUpdateXidStatus(xid, status, lsn, pageno))
+		else if (TransactionGroupUpdateXidStatus(xid, nsubxids, subxids,
+												 status, lsn, pageno))
 		{
 			/* Group update mechanism has done the work. */
 			return;
@@ -323,10 +361,10 @@ TransactionIdSetPageStatus(TransactionId xid, int nsubxids,
 	}
 
 	/* Group update not applicable, or couldn't accept this page number. */
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 	TransactionIdSetPageStatusInternal(xid, nsubxids, subxids, status,
 									   lsn, pageno);
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -345,7 +383,8 @@ TransactionIdSetPageStatusInternal(TransactionId xid, int nsubxids,
 	Assert(status == TRANSACTION_STATUS_COMMITTED ||
 		   status == TRANSACTION_STATUS_ABORTED ||
 		   (status == TRANSACTION_STATUS_SUB_COMMITTED && !TransactionIdIsValid(xid)));
-	Assert(LWLockHeldByMeInMode(XactSLRULock, LW_EXCLUSIVE));
+	Assert(LWLockHeldByMeInMode(SimpleLruGetBankLock(XactCtl, pageno),
+								LW_EXCLUSIVE));
 
 	/*
 	 * If we're doing an async commit (ie, lsn is valid), then we must wait
@@ -396,30 +435,36 @@ TransactionIdSetPageStatusInternal(TransactionId xid, int nsubxids,
 }
 
 /*
- * When we cannot immediately acquire XactSLRULock in exclusive mode at
+ * When we cannot immediately acquire the SLRU bank lock in exclusive mode at
  * commit time, add ourselves to a list of processes that need their XIDs
  * status update.  The first process to add itself to the list will acquire
- * XactSLRULock in exclusive mode and set transaction status as required
+ * the bank lock in exclusive mode and set transaction status as required
  * on behalf of all group members.  This avoids a great deal of contention
- * around XactSLRULock when many processes are trying to commit at once,
+ * around the bank lock when many processes are trying to commit at once,
  * since the lock need not be repeatedly handed off from one committing
  * process to the next.
  *
+ * xid may be invalid, and status TRANSACTION_STATUS_SUB_COMMITTED, when
+ * setting the status of subxids on other pages than the top-level xid's.
+ *
  * Returns true when transaction status has been updated in clog; returns
  * false if we decided against applying the optimization because the page
  * number we need to update differs from those processes already waiting.
  */
 static bool
-TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
+TransactionGroupUpdateXidStatus(TransactionId xid, int nsubxids,
+								TransactionId *subxids, XidStatus status,
 								XLogRecPtr lsn, int pageno)
 {
 	volatile PROC_HDR *procglobal = ProcGlobal;
 	PGPROC	   *proc = MyProc;
 	uint32		nextidx;
 	uint32		wakeidx;
+	int			prevpageno;
+	LWLock	   *prevlock;
 
 	/* We should definitely have an XID whose status needs to be updated. */
-	Assert(TransactionIdIsValid(xid));
+	Assert(TransactionIdIsValid(xid) || nsubxids > 0);
 
 	/*
 	 * Add ourselves to the list of processes needing a group XID status
@@ -427,6 +472,8 @@ TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
 	 */
 	proc->clogGroupMember = true;
 	proc->clogGroupMemberXid = xid;
+	proc->clogGroupMemberSubxids = subxids;
+	proc->clogGroupMemberNsubxids = nsubxids;
 	proc->clogGroupMemberXidStatus = status;
 	proc->clogGroupMemberPage = pageno;
 	proc->clogGroupMemberLsn = lsn;
@@ -497,8 +544,13 @@ TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
 		return true;
 	}
 
-	/* We are the leader.  Acquire the lock on behalf of everyone. */
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+	/*
+	 * We are the leader.  Acquire the lock of our page's bank on behalf of
+	 * everyone.
+	 */
+	prevpageno = proc->clogGroupMemberPage;
+	prevlock = SimpleLruGetBankLock(XactCtl, prevpageno);
+	LWLockAcquire(prevlock, LW_EXCLUSIVE);
 
 	/*
 	 * Now that we've got the lock, clear the list of processes waiting for
@@ -515,16 +567,29 @@ TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
 	while (nextidx != INVALID_PGPROCNO)
 	{
 		PGPROC	   *nextproc = &ProcGlobal->allProcs[nextidx];
+		int			thispageno = nextproc->clogGroupMemberPage;
 
 		/*
-		 * Transactions with more than THRESHOLD_SUBTRANS_CLOG_OPT sub-XIDs
-		 * should not use group XID status update mechanism.
+		 * If the page to update belongs to a different bank than the
+		 * previous one (see the race described above), exchange the bank
+		 * lock for that one.
 		 */
-		Assert(nextproc->subxidStatus.count <= THRESHOLD_SUBTRANS_CLOG_OPT);
+		if (thispageno != prevpageno)
+		{
+			LWLock	   *lock = SimpleLruGetBankLock(XactCtl, thispageno);
+
+			if (prevlock != lock)
+			{
+				LWLockRelease(prevlock);
+				LWLockAcquire(lock, LW_EXCLUSIVE);
+			}
+			prevlock = lock;
+			prevpageno = thispageno;
+		}
 
 		TransactionIdSetPageStatusInternal(nextproc->clogGroupMemberXid,
-										   nextproc->subxidStatus.count,
-										   nextproc->subxids.xids,
+										   nextproc->clogGroupMemberNsubxids,
+										   nextproc->clogGroupMemberSubxids,
 										   nextproc->clogGroupMemberXidStatus,
 										   nextproc->clogGroupMemberLsn,
 										   nextproc->clogGroupMemberPage);
@@ -534,7 +599,7 @@ TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
 	}
 
 	/* We're done with the lock now. */
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(prevlock);
 
 	/*
 	 * Now that we've released the lock, go back and wake everybody up.  We
@@ -563,7 +628,7 @@ TransactionGroupUpdateXidStatus(TransactionId xid, XidStatus status,
 /*
  * Sets the commit status of a single transaction.
  *
- * Must be called with XactSLRULock held
+ * Must be called with the bank lock of the transaction's page held
  */
 static void
 TransactionIdSetStatusBit(TransactionId xid, XidStatus status, XLogRecPtr lsn, int slotno)
@@ -655,7 +720,7 @@ TransactionIdGetStatus(TransactionId xid, XLogRecPtr *lsn)
 	lsnindex = GetLSNIndex(slotno, xid);
 	*lsn = XactCtl->shared->group_lsn[lsnindex]; /// LSN保存在这里
 
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(SimpleLruGetBankLock(XactCtl, pageno));
 
 	return status;
 }
@@ -663,23 +728,23 @@ TransactionIdGetStatus(TransactionId xid, XLogRecPtr *lsn)
 /*
  * Number of shared CLOG buffers.
  *
- * On larger multi-processor systems, it is possible to have many CLOG page
- * requests in flight at one time which could lead to disk access for CLOG
- * page if the required page is not found in memory.  Testing revealed that we
- * can get the best performance by having 128 CLOG buffers, more than that it
- * doesn't improve performance.
+ * If asked to autotune, use 2MB for every 1GB of shared buffers, up to 8MB.
+ * Otherwise just cap the configured amount to be between 16 and the maximum
+ * allowed.
  *
- * Unconditionally keeping the number of CLOG buffers to 128 did not seem like
- * a good idea, because it would increase the minimum amount of shared memory
- * required to start, which could be a problem for people running very small
- * configurations.  The following formula seems to represent a reasonable
- * compromise: people with very low values for shared_buffers will get fewer
- * CLOG buffers as well, and everyone else will get 128.
+ * Clamping at some minimum avoids a minimum amount of shared memory that
+ * would be a problem for people running very small configurations, and
+ * autotuning gives everyone else plenty of buffers; with the buffers divided
+ * into banks, a large number of them doesn't make lookups any slower.
  */
 Size
 CLOGShmemBuffers(void)
 {
-	return Min(128, Max(4, NBuffers / 512));
+	/* auto-tune based on shared buffers */
+	if (transaction_buffers == 0)
+		return SimpleLruAutotuneBuffers(512, 1024);
+
+	return Min(Max(16, transaction_buffers), SLRU_MAX_ALLOWED_BUFFERS);
 }
 
 /*
@@ -694,13 +759,43 @@ CLOGShmemSize(void)
 void
 CLOGShmemInit(void)
 {
+	/* If auto-tuning is requested, now is the time to do it */
+	if (transaction_buffers == 0)
+	{
+		char		buf[32];
+
+		snprintf(buf, sizeof(buf), "%zu", CLOGShmemBuffers());
+		SetConfigOption("transaction_buffers", buf, PGC_POSTMASTER,
+						PGC_S_DYNAMIC_DEFAULT);
+
+		/*
+		 * We prefer to report this value's source as PGC_S_DYNAMIC_DEFAULT.
+		 * However, if the DBA explicitly set transaction_buffers = 0 in the
+		 * config file, then PGC_S_DYNAMIC_DEFAULT will fail to override that
+		 * and we must force the matter with PGC_S_OVERRIDE.
+		 */
+		if (transaction_buffers == 0)	/* failed to apply it? */
+			SetConfigOption("transaction_buffers", buf, PGC_POSTMASTER,
+							PGC_S_OVERRIDE);
+	}
+	Assert(transaction_buffers != 0);
+
 	XactCtl->PagePrecedes = CLOGPagePrecedes;
 	SimpleLruInit(XactCtl, "Xact", CLOGShmemBuffers(), CLOG_LSNS_PER_PAGE,
-				  XactSLRULock, "pg_xact", LWTRANCHE_XACT_BUFFER,
+				  "pg_xact", LWTRANCHE_XACT_BUFFER, LWTRANCHE_XACT_SLRU,
 				  SYNC_HANDLER_CLOG);
 	SlruPagePrecedesUnitTests(XactCtl, CLOG_XACTS_PER_PAGE);
 }
 
+/*
+ * GUC check_hook for transaction_buffers
+ */
+bool
+check_transaction_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("transaction_buffers", newval);
+}
+
 /*
  * This func must be called ONCE on system install.  It creates
  * the initial CLOG segment.  (The CLOG directory is assumed to
@@ -711,8 +806,9 @@ void
 BootStrapCLOG(void)
 {
 	int			slotno;
+	LWLock	   *lock = SimpleLruGetBankLock(XactCtl, 0);
 
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/* Create and zero the first page of the commit log */
 	slotno = ZeroCLOGPage(0, false);
@@ -721,7 +817,7 @@ BootStrapCLOG(void)
 	SimpleLruWritePage(XactCtl, slotno);
 	Assert(!XactCtl->shared->page_dirty[slotno]);
 
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -731,7 +827,7 @@ BootStrapCLOG(void)
  * The page is not actually written, just set up in shared memory.
  * The slot number of the new page is returned.
  *
- * Control lock must be held at entry, and will be held at exit.
+ * The page's bank lock must be held at entry, and will be held at exit.
  */
 static int
 ZeroCLOGPage(int pageno, bool writeXlog)
@@ -756,14 +852,10 @@ StartupCLOG(void)
 	TransactionId xid = XidFromFullTransactionId(ShmemVariableCache->nextXid);
 	int			pageno = TransactionIdToPage(xid);
 
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
-
 	/*
 	 * Initialize our idea of the latest page number.
 	 */
-	XactCtl->shared->latest_page_number = pageno;
-
-	LWLockRelease(XactSLRULock);
+	pg_atomic_write_u32(&XactCtl->shared->latest_page_number, pageno);
 }
 
 /*
@@ -774,8 +866,9 @@ TrimCLOG(void)
 {
 	TransactionId xid = XidFromFullTransactionId(ShmemVariableCache->nextXid);
 	int			pageno = TransactionIdToPage(xid);
+	LWLock	   *lock = SimpleLruGetBankLock(XactCtl, pageno);
 
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/*
 	 * Zero out the remainder of the current clog page.  Under normal
@@ -807,7 +900,7 @@ TrimCLOG(void)
 		XactCtl->shared->page_dirty[slotno] = true;
 	}
 
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -839,6 +932,7 @@ void
 ExtendCLOG(TransactionId newestXact) /// 每当分配一个新的事务号，确保CLOG有足够的空间保存它
 {
 	int			pageno;
+	LWLock	   *lock;
 
 	/*
 	 * No work except at first XID of a page.  But beware: just after
@@ -849,13 +943,14 @@ ExtendCLOG(TransactionId newestXact) /// 每当分配一个新的事务号，确
 		return;
 
 	pageno = TransactionIdToPage(newestXact);
+	lock = SimpleLruGetBankLock(XactCtl, pageno);
 
-	LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/* Zero the page and make an XLOG entry about it */
 	ZeroCLOGPage(pageno, true);
 
-	LWLockRelease(XactSLRULock);
+	LWLockRelease(lock);
 }
 
 
@@ -993,16 +1088,18 @@ clog_redo(XLogReaderState *record)
 	{
 		int			pageno;
 		int			slotno;
+		LWLock	   *lock;
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
 
-		LWLockAcquire(XactSLRULock, LW_EXCLUSIVE);
+		lock = SimpleLruGetBankLock(XactCtl, pageno);
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 
 		slotno = ZeroCLOGPage(pageno, false);
 		SimpleLruWritePage(XactCtl, slotno);
 		Assert(!XactCtl->shared->page_dirty[slotno]);
 
-		LWLockRelease(XactSLRULock);
+		LWLockRelease(lock);
 	}
 	else if (info == CLOG_TRUNCATE)
 	{
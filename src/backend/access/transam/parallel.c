@@ -14,9 +14,14 @@
 
 #include "postgres.h"
 
+#include "access/brin.h"
+#include "access/gin_private.h"
+#include "access/gist_private.h"
+#include "access/hash.h"
 #include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/session.h"
+#include "access/spgist_private.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/index.h"
@@ -24,6 +29,7 @@
 #include "catalog/pg_enum.h"
 #include "catalog/storage.h"
 #include "commands/async.h"
+#include "commands/copy.h"
 #include "commands/vacuum.h"
 #include "executor/execParallel.h"
 #include "libpq/libpq.h"
@@ -33,7 +39,11 @@
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
 #include "storage/ipc.h"
+#include "storage/lwlock.h"
 #include "storage/predicate.h"
+#include "storage/proc.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
 #include "storage/sinval.h"
 #include "storage/spin.h"
 #include "tcop/tcopprot.h"
@@ -43,6 +53,7 @@
 #include "utils/memutils.h"
 #include "utils/relmapper.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 #include "utils/typcache.h"
 
 /*
@@ -127,6 +138,65 @@ static dlist_head pcxt_list = DLIST_STATIC_INIT(pcxt_list);
 /* Backend-local copy of data from FixedParallelState. */
 static pid_t ParallelLeaderPid;
 
+/* DSM segment of the parallel operation we're working on, in a worker. */
+static dsm_segment *ParallelWorkerSegment = NULL;
+
+/*
+ * Parallel worker pool.
+ *
+ * With parallel_worker_pool_size > 0, workers running ParallelQueryMain don't
+ * exit when they're done, but wait in a pool slot for the next parallel query
+ * in the same database and for the same authenticated user, until
+ * parallel_worker_pool_idle_timeout expires.  That saves starting a process
+ * and connecting to the database for each worker of short parallel queries;
+ * everything else is still restored from the leader's DSM segment each time,
+ * just as for a new worker.
+ *
+ * A slot is reserved for a worker when the leader launches it, so that the
+ * leader can tell when the worker is done with the leader's transaction;
+ * subsequent leaders identify their use of the slot by the assignment number.
+ * Idle workers hold on to the background worker slot they were launched in,
+ * so they still count toward max_worker_processes and max_parallel_workers.
+ *
+ * All fields are protected by ParallelWorkerPoolLock.
+ */
+typedef enum ParallelPoolSlotState
+{
+	POOL_SLOT_UNUSED,			/* free */
+	POOL_SLOT_BUSY,				/* worker is working on an assignment */
+	POOL_SLOT_IDLE,				/* worker is waiting for an assignment */
+	POOL_SLOT_ASSIGNED			/* assignment given to an idle worker */
+} ParallelPoolSlotState;
+
+typedef struct ParallelPoolSlot
+{
+	ParallelPoolSlotState state;
+	pid_t		pid;			/* worker's PID, 0 if not started yet */
+	int			pgprocno;		/* worker's PGPROC, valid if pid != 0 */
+	Oid			database_id;
+	Oid			authenticated_user_id;
+	uint64		assignment;		/* current assignment */
+	pid_t		leader_pid;		/* leader of current assignment */
+	BackendId	leader_backend_id;
+	dsm_handle	handle;			/* DSM segment of current assignment */
+	int			worker_number;	/* ParallelWorkerNumber for it */
+} ParallelPoolSlot;
+
+typedef struct ParallelPoolData
+{
+	uint64		next_assignment;
+	ParallelPoolSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} ParallelPoolData;
+
+static ParallelPoolData *ParallelPool = NULL;
+
+/* Our slot in the pool, in a worker, or -1 if not pooled. */
+static int	MyPoolSlot = -1;
+
+/* GUC parameters */
+int			parallel_worker_pool_size = 0;
+int			parallel_worker_pool_idle_timeout = 60000;
+
 /*
  * List of internal parallel worker entry points.  We need this for
  * reasons explained in LookupParallelWorkerFunction(), below.
@@ -144,8 +214,29 @@ static const struct
 	{
 		"_bt_parallel_build_main", _bt_parallel_build_main
 	},
+	{
+		"_gin_parallel_build_main", _gin_parallel_build_main
+	},
+	{
+		"_brin_parallel_build_main", _brin_parallel_build_main
+	},
+	{
+		"_gist_parallel_build_main", _gist_parallel_build_main
+	},
+	{
+		"_spg_parallel_build_main", _spg_parallel_build_main
+	},
+	{
+		"_hash_parallel_build_main", _hash_parallel_build_main
+	},
 	{
 		"parallel_vacuum_main", parallel_vacuum_main
+	},
+	{
+		"parallel_analyze_main", parallel_analyze_main
+	},
+	{
+		"ParallelCopyFromMain", ParallelCopyFromMain
 	}
 };
 
@@ -154,6 +245,15 @@ static void HandleParallelMessage(ParallelContext *pcxt, int i, StringInfo msg);
 static void WaitForParallelWorkersToExit(ParallelContext *pcxt);
 static parallel_worker_main_type LookupParallelWorkerFunction(const char *libraryname, const char *funcname);
 static void ParallelWorkerShutdown(int code, Datum arg);
+static bool ParallelWorkerRun(dsm_handle handle, bool connected);
+static void ParallelWorkerReset(void);
+static bool ParallelPoolAssign(ParallelContext *pcxt, int i);
+static int	ParallelPoolReserve(ParallelContext *pcxt, int i, uint64 *assignment);
+static void ParallelPoolRelease(int slotno, uint64 assignment);
+static bool ParallelPoolAssignmentEnded(int slotno, uint64 assignment);
+static void ParallelPoolTerminate(int slotno, uint64 assignment);
+static void WaitForPooledWorkerToFinish(ParallelContext *pcxt, int i);
+static bool ParallelPoolWaitForAssignment(dsm_handle *handle);
 
 
 /*
@@ -304,10 +404,15 @@ InitializeParallelDSM(ParallelContext *pcxt)
 	 * backend-private memory, and plan not to use any workers.  We hope this
 	 * won't happen very often, but it's better to abandon the use of
 	 * parallelism than to fail outright.
+	 *
+	 * The segment may be one kept from an earlier parallel operation.  That's
+	 * safe since DestroyParallelContext waits for all workers to be done with
+	 * it, so no worker can attach to it after we detach.
 	 */
 	segsize = shm_toc_estimate(&pcxt->estimator);
 	if (pcxt->nworkers > 0)
-		pcxt->seg = dsm_create(segsize, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+		pcxt->seg = dsm_create(segsize,
+							   DSM_CREATE_NULL_IF_MAXSEGMENTS | DSM_CREATE_CACHED);
 	if (pcxt->seg != NULL)
 		pcxt->toc = shm_toc_create(PARALLEL_MAGIC,
 								   dsm_segment_address(pcxt->seg),
@@ -553,6 +658,7 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	BackgroundWorker worker;
 	int			i;
 	bool		any_registrations_failed = false;
+	bool		poolable;
 
 	/* Skip this if we have no workers. */
 	if (pcxt->nworkers == 0 || pcxt->nworkers_to_launch == 0)
@@ -582,6 +688,14 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(pcxt->seg));
 	worker.bgw_notify_pid = MyProcPid;
 
+	/*
+	 * Only parallel query workers are pooled: they are by far the most
+	 * common, and the other entry points might leave state behind.
+	 */
+	poolable = parallel_worker_pool_size > 0 &&
+		strcmp(pcxt->library_name, "postgres") == 0 &&
+		strcmp(pcxt->function_name, "ParallelQueryMain") == 0;
+
 	/*
 	 * Start workers.
 	 *
@@ -592,17 +706,40 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	 */
 	for (i = 0; i < pcxt->nworkers_to_launch; ++i)
 	{
+		int			slotno = -1;
+		uint64		assignment = 0;
+
+		pcxt->worker[i].pool_slot = -1;
+
+		/* Use an idle pooled worker if there is one. */
+		if (poolable && ParallelPoolAssign(pcxt, i))
+		{
+			pcxt->worker[i].bgwhandle = NULL;
+			pcxt->nworkers_launched++;
+			continue;
+		}
+
+		/* Else reserve a pool slot for the new worker to return to. */
+		if (poolable && !any_registrations_failed)
+			slotno = ParallelPoolReserve(pcxt, i, &assignment);
+
 		memcpy(worker.bgw_extra, &i, sizeof(int));
+		memcpy(worker.bgw_extra + sizeof(int), &slotno, sizeof(int));
 		if (!any_registrations_failed &&
 			RegisterDynamicBackgroundWorker(&worker,
 											&pcxt->worker[i].bgwhandle))
 		{
 			shm_mq_set_handle(pcxt->worker[i].error_mqh,
 							  pcxt->worker[i].bgwhandle);
+			pcxt->worker[i].pool_slot = slotno;
+			pcxt->worker[i].pool_assignment = assignment;
 			pcxt->nworkers_launched++;
 		}
 		else
 		{
+			if (slotno >= 0)
+				ParallelPoolRelease(slotno, assignment);
+
 			/*
 			 * If we weren't able to register the worker, then we've bumped up
 			 * against the max_worker_processes limit, and future
@@ -704,7 +841,23 @@ WaitForParallelWorkersToAttach(ParallelContext *pcxt)
 				continue;
 			}
 
-			status = GetBackgroundWorkerPid(pcxt->worker[i].bgwhandle, &pid);
+			if (pcxt->worker[i].bgwhandle == NULL)
+			{
+				/*
+				 * A pooled worker is running already, and is attached once
+				 * it has attached to the error queue; if its assignment
+				 * ended first, it failed.
+				 */
+				Assert(pcxt->worker[i].pool_slot >= 0);
+				if (ParallelPoolAssignmentEnded(pcxt->worker[i].pool_slot,
+												pcxt->worker[i].pool_assignment))
+					status = BGWH_STOPPED;
+				else
+					status = BGWH_STARTED;
+			}
+			else
+				status = GetBackgroundWorkerPid(pcxt->worker[i].bgwhandle,
+												&pid);
 			if (status == BGWH_STARTED)
 			{
 				/* Has the worker attached to the error queue? */
@@ -715,6 +868,16 @@ WaitForParallelWorkersToAttach(ParallelContext *pcxt)
 					pcxt->known_attached_workers[i] = true;
 					++pcxt->nknown_attached_workers;
 				}
+				else if (pcxt->worker[i].bgwhandle == NULL)
+				{
+					/* Pooled worker not attached yet; it will signal us. */
+					rc = WaitLatch(MyLatch,
+								   WL_LATCH_SET | WL_EXIT_ON_PM_DEATH,
+								   -1, WAIT_EVENT_BGWORKER_STARTUP);
+
+					if (rc & WL_LATCH_SET)
+						ResetLatch(MyLatch);
+				}
 			}
 			else if (status == BGWH_STOPPED)
 			{
@@ -827,10 +990,17 @@ WaitForParallelWorkersToFinish(ParallelContext *pcxt)
 				 * should just keep waiting.  If it is BGWH_STOPPED, then
 				 * further investigation is needed.
 				 */
-				if (pcxt->worker[i].error_mqh == NULL ||
-					pcxt->worker[i].bgwhandle == NULL ||
-					GetBackgroundWorkerPid(pcxt->worker[i].bgwhandle,
-										   &pid) != BGWH_STOPPED)
+				if (pcxt->worker[i].error_mqh == NULL)
+					continue;
+				if (pcxt->worker[i].bgwhandle == NULL)
+				{
+					if (pcxt->worker[i].pool_slot < 0 ||
+						!ParallelPoolAssignmentEnded(pcxt->worker[i].pool_slot,
+													 pcxt->worker[i].pool_assignment))
+						continue;
+				}
+				else if (GetBackgroundWorkerPid(pcxt->worker[i].bgwhandle,
+												&pid) != BGWH_STOPPED)
 					continue;
 
 				/*
@@ -893,7 +1063,17 @@ WaitForParallelWorkersToExit(ParallelContext *pcxt)
 	{
 		BgwHandleStatus status;
 
-		if (pcxt->worker == NULL || pcxt->worker[i].bgwhandle == NULL)
+		if (pcxt->worker == NULL)
+			continue;
+
+		/* A pooled worker doesn't exit, but returns to the pool. */
+		if (pcxt->worker[i].pool_slot >= 0)
+		{
+			WaitForPooledWorkerToFinish(pcxt, i);
+			continue;
+		}
+
+		if (pcxt->worker[i].bgwhandle == NULL)
 			continue;
 
 		status = WaitForBackgroundWorkerShutdown(pcxt->worker[i].bgwhandle);
@@ -943,7 +1123,11 @@ DestroyParallelContext(ParallelContext *pcxt)
 		{
 			if (pcxt->worker[i].error_mqh != NULL)
 			{
-				TerminateBackgroundWorker(pcxt->worker[i].bgwhandle);
+				if (pcxt->worker[i].bgwhandle != NULL)
+					TerminateBackgroundWorker(pcxt->worker[i].bgwhandle);
+				else
+					ParallelPoolTerminate(pcxt->worker[i].pool_slot,
+										  pcxt->worker[i].pool_assignment);
 
 				shm_mq_detach(pcxt->worker[i].error_mqh);
 				pcxt->worker[i].error_mqh = NULL;
@@ -1066,6 +1250,22 @@ HandleParallelMessages(void)
 
 		for (i = 0; i < pcxt->nworkers_launched; ++i)
 		{
+			bool		pool_ended = false;
+
+			/*
+			 * A pooled worker that was running already when we launched it
+			 * can't be waited for through a background worker handle, so
+			 * check whether it's gone away.  Check before reading, since it
+			 * sends everything it has to say before it gives up the
+			 * assignment.
+			 */
+			if (pcxt->worker[i].error_mqh != NULL &&
+				pcxt->worker[i].bgwhandle == NULL &&
+				pcxt->worker[i].pool_slot >= 0)
+				pool_ended =
+					ParallelPoolAssignmentEnded(pcxt->worker[i].pool_slot,
+												pcxt->worker[i].pool_assignment);
+
 			/*
 			 * Read as many messages as we can from each worker, but stop when
 			 * either (1) the worker's error queue goes away, which can happen
@@ -1096,6 +1296,11 @@ HandleParallelMessages(void)
 							(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 							 errmsg("lost connection to parallel worker")));
 			}
+
+			if (pool_ended && pcxt->worker[i].error_mqh != NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+						 errmsg("lost connection to parallel worker")));
 		}
 	}
 
@@ -1260,6 +1465,69 @@ AtEOXact_Parallel(bool isCommit)
  */
 void
 ParallelWorkerMain(Datum main_arg)
+{
+	dsm_handle	handle = DatumGetUInt32(main_arg);
+	MemoryContext worker_context;
+	bool		connected = false;
+
+	/* Set flag to indicate that we're initializing a parallel worker. */
+	InitializingParallelWorker = true;
+
+	/* Establish signal handlers. */
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Determine and set our parallel worker number, and pool slot. */
+	Assert(ParallelWorkerNumber == -1);
+	memcpy(&ParallelWorkerNumber, MyBgworkerEntry->bgw_extra, sizeof(int));
+	memcpy(&MyPoolSlot, MyBgworkerEntry->bgw_extra + sizeof(int), sizeof(int));
+
+	/* Set up a memory context to work in, just for cleanliness. */
+	worker_context = AllocSetContextCreate(TopMemoryContext,
+										   "Parallel worker",
+										   ALLOCSET_DEFAULT_SIZES);
+
+	/* Arrange to signal the leader if we exit. */
+	before_shmem_exit(ParallelWorkerShutdown, (Datum) 0);
+
+	if (MyPoolSlot >= 0)
+	{
+		ParallelPoolSlot *slot = &ParallelPool->slots[MyPoolSlot];
+
+		LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+		slot->pid = MyProcPid;
+		slot->pgprocno = MyProc->pgprocno;
+		LWLockRelease(ParallelWorkerPoolLock);
+	}
+
+	for (;;)
+	{
+		MemoryContextSwitchTo(worker_context);
+		if (!ParallelWorkerRun(handle, connected))
+			break;
+		connected = true;
+
+		/* Unless pooled, we're done. */
+		if (MyPoolSlot < 0)
+			break;
+
+		ParallelWorkerReset();
+		MemoryContextReset(worker_context);
+
+		if (!ParallelPoolWaitForAssignment(&handle))
+			break;
+		InitializingParallelWorker = true;
+	}
+}
+
+/*
+ * Do the work of a parallel worker for the given DSM segment.  connected is
+ * true if this worker, taken from the pool, is connected already.
+ *
+ * Returns false if the leader went away before we could join its lock group.
+ */
+static bool
+ParallelWorkerRun(dsm_handle handle, bool connected)
 {
 	dsm_segment *seg;
 	shm_toc    *toc;
@@ -1287,22 +1555,6 @@ ParallelWorkerMain(Datum main_arg)
 	Snapshot	tsnapshot;
 	Snapshot	asnapshot;
 
-	/* Set flag to indicate that we're initializing a parallel worker. */
-	InitializingParallelWorker = true;
-
-	/* Establish signal handlers. */
-	pqsignal(SIGTERM, die);
-	BackgroundWorkerUnblockSignals();
-
-	/* Determine and set our parallel worker number. */
-	Assert(ParallelWorkerNumber == -1);
-	memcpy(&ParallelWorkerNumber, MyBgworkerEntry->bgw_extra, sizeof(int));
-
-	/* Set up a memory context to work in, just for cleanliness. */
-	CurrentMemoryContext = AllocSetContextCreate(TopMemoryContext,
-												 "Parallel worker",
-												 ALLOCSET_DEFAULT_SIZES);
-
 	/*
 	 * Attach to the dynamic shared memory segment for the parallel query, and
 	 * find its table of contents.
@@ -1312,7 +1564,7 @@ ParallelWorkerMain(Datum main_arg)
 	 * exit, which is fine.  If there were a ResourceOwner, it would acquire
 	 * ownership of the mapping, but we have no need for that.
 	 */
-	seg = dsm_attach(DatumGetUInt32(main_arg));
+	seg = dsm_attach(handle);
 	if (seg == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
@@ -1327,10 +1579,10 @@ ParallelWorkerMain(Datum main_arg)
 	fps = shm_toc_lookup(toc, PARALLEL_KEY_FIXED, false);
 	MyFixedParallelState = fps;
 
-	/* Arrange to signal the leader if we exit. */
+	/* ParallelWorkerShutdown signals the leader if we exit. */
 	ParallelLeaderPid = fps->parallel_leader_pid;
 	ParallelLeaderBackendId = fps->parallel_leader_backend_id;
-	before_shmem_exit(ParallelWorkerShutdown, PointerGetDatum(seg));
+	ParallelWorkerSegment = seg;
 
 	/*
 	 * Now we can find and attach to the error queue provided for us.  That's
@@ -1375,7 +1627,7 @@ ParallelWorkerMain(Datum main_arg)
 	 */
 	if (!BecomeLockGroupMember(fps->parallel_leader_pgproc,
 							   fps->parallel_leader_pid))
-		return;
+		return false;
 
 	/*
 	 * Restore transaction and statement start-time timestamps.  This must
@@ -1395,16 +1647,25 @@ ParallelWorkerMain(Datum main_arg)
 
 	entrypt = LookupParallelWorkerFunction(library_name, function_name);
 
-	/* Restore database connection. */
-	BackgroundWorkerInitializeConnectionByOid(fps->database_id,
-											  fps->authenticated_user_id,
-											  0);
-
 	/*
-	 * Set the client encoding to the database encoding, since that is what
-	 * the leader will expect.
+	 * Restore database connection, unless we have it from a previous
+	 * assignment; the pool only hands us parallel operations in the same
+	 * database and for the same authenticated user.
 	 */
-	SetClientEncoding(GetDatabaseEncoding());
+	if (!connected)
+	{
+		BackgroundWorkerInitializeConnectionByOid(fps->database_id,
+												  fps->authenticated_user_id,
+												  0);
+
+		/*
+		 * Set the client encoding to the database encoding, since that is
+		 * what the leader will expect.
+		 */
+		SetClientEncoding(GetDatabaseEncoding());
+	}
+	Assert(fps->database_id == MyDatabaseId &&
+		   fps->authenticated_user_id == GetAuthenticatedUserId());
 
 	/*
 	 * Load libraries that were loaded by original backend.  We want to do
@@ -1531,8 +1792,42 @@ ParallelWorkerMain(Datum main_arg)
 	/* Detach from the per-session DSM segment. */
 	DetachSession();
 
+	/*
+	 * A pooled worker leaves the leader's lock group now, so it's entirely
+	 * done with the leader's transaction by the time the leader sees the
+	 * message below.  We hold no locks anymore.
+	 */
+	if (MyPoolSlot >= 0)
+		LeaveLockGroup();
+
 	/* Report success. */
 	pq_putmessage('X', NULL, 0);
+
+	return true;
+}
+
+/*
+ * Forget about the parallel operation just completed, so that a pooled
+ * worker can take on the next one.
+ */
+static void
+ParallelWorkerReset(void)
+{
+	/* This also stops sending protocol messages to the leader. */
+	dsm_detach(ParallelWorkerSegment);
+	ParallelWorkerSegment = NULL;
+
+	MyFixedParallelState = NULL;
+	debug_query_string = NULL;
+	ParallelLeaderPid = 0;
+	ParallelLeaderBackendId = InvalidBackendId;
+	ParallelWorkerNumber = -1;
+
+	/* state restored from the leader that end of transaction doesn't reset */
+	ResetReindexState(0);
+
+	pgstat_report_activity(STATE_IDLE, NULL);
+	pgstat_report_stat(true);
 }
 
 /*
@@ -1570,11 +1865,44 @@ ParallelWorkerReportLastRecEnd(XLogRecPtr last_xlog_end)
 static void
 ParallelWorkerShutdown(int code, Datum arg)
 {
-	SendProcSignal(ParallelLeaderPid,
-				   PROCSIG_PARALLEL_MESSAGE,
-				   ParallelLeaderBackendId);
+	/*
+	 * Give up our pool slot first, so that the leader sees us gone when it
+	 * gets the signal below.  Our transaction has been aborted by now, so we
+	 * may leave the leader's lock group early.
+	 */
+	if (MyPoolSlot >= 0)
+	{
+		ParallelPoolSlot *slot = &ParallelPool->slots[MyPoolSlot];
+
+		if (MyProc->lockGroupLeader != NULL)
+			LeaveLockGroup();
 
-	dsm_detach((dsm_segment *) DatumGetPointer(arg));
+		LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+		if (slot->pid == MyProcPid)
+		{
+			/* an assignment we didn't get to start on needs a signal, too */
+			if (slot->state != POOL_SLOT_IDLE && ParallelLeaderPid == 0)
+			{
+				ParallelLeaderPid = slot->leader_pid;
+				ParallelLeaderBackendId = slot->leader_backend_id;
+			}
+			slot->state = POOL_SLOT_UNUSED;
+			slot->pid = 0;
+		}
+		LWLockRelease(ParallelWorkerPoolLock);
+		MyPoolSlot = -1;
+	}
+
+	if (ParallelLeaderPid != 0)
+		SendProcSignal(ParallelLeaderPid,
+					   PROCSIG_PARALLEL_MESSAGE,
+					   ParallelLeaderBackendId);
+
+	if (ParallelWorkerSegment != NULL)
+	{
+		dsm_detach(ParallelWorkerSegment);
+		ParallelWorkerSegment = NULL;
+	}
 }
 
 /*
@@ -1620,3 +1948,284 @@ LookupParallelWorkerFunction(const char *libraryname, const char *funcname)
 	return (parallel_worker_main_type)
 		load_external_function(libraryname, funcname, true, NULL);
 }
+
+/*
+ * Report shared-memory space needed by ParallelWorkerPoolShmemInit.
+ */
+Size
+ParallelWorkerPoolShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(ParallelPoolData, slots);
+	size = add_size(size, mul_size(parallel_worker_pool_size,
+								   sizeof(ParallelPoolSlot)));
+	return size;
+}
+
+/*
+ * Allocate and initialize the parallel worker pool.
+ */
+void
+ParallelWorkerPoolShmemInit(void)
+{
+	bool		found;
+
+	ParallelPool = (ParallelPoolData *)
+		ShmemInitStruct("Parallel Worker Pool", ParallelWorkerPoolShmemSize(),
+						&found);
+
+	if (!found)
+		MemSet(ParallelPool, 0, ParallelWorkerPoolShmemSize());
+}
+
+/*
+ * Hand worker i of pcxt to an idle pooled worker, if there's one for our
+ * database and user.
+ */
+static bool
+ParallelPoolAssign(ParallelContext *pcxt, int i)
+{
+	Oid			userid = GetAuthenticatedUserId();
+	int			pgprocno = -1;
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+	for (int slotno = 0; slotno < parallel_worker_pool_size; slotno++)
+	{
+		ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+
+		if (slot->state != POOL_SLOT_IDLE ||
+			slot->database_id != MyDatabaseId ||
+			slot->authenticated_user_id != userid)
+			continue;
+
+		slot->state = POOL_SLOT_ASSIGNED;
+		slot->assignment = ++ParallelPool->next_assignment;
+		slot->leader_pid = MyProcPid;
+		slot->leader_backend_id = MyBackendId;
+		slot->handle = dsm_segment_handle(pcxt->seg);
+		slot->worker_number = i;
+
+		pcxt->worker[i].pool_slot = slotno;
+		pcxt->worker[i].pool_assignment = slot->assignment;
+		pgprocno = slot->pgprocno;
+		break;
+	}
+	LWLockRelease(ParallelWorkerPoolLock);
+
+	if (pgprocno < 0)
+		return false;
+
+	SetLatch(&ProcGlobal->allProcs[pgprocno].procLatch);
+	return true;
+}
+
+/*
+ * Reserve a pool slot for a new worker i of pcxt, which will return to the
+ * pool when it's done.  Returns the slot number, or -1 if the pool is full.
+ */
+static int
+ParallelPoolReserve(ParallelContext *pcxt, int i, uint64 *assignment)
+{
+	int			result = -1;
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+	for (int slotno = 0; slotno < parallel_worker_pool_size; slotno++)
+	{
+		ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+
+		if (slot->state != POOL_SLOT_UNUSED)
+			continue;
+
+		slot->state = POOL_SLOT_BUSY;
+		slot->pid = 0;
+		slot->database_id = MyDatabaseId;
+		slot->authenticated_user_id = GetAuthenticatedUserId();
+		slot->assignment = ++ParallelPool->next_assignment;
+		slot->leader_pid = MyProcPid;
+		slot->leader_backend_id = MyBackendId;
+		slot->handle = dsm_segment_handle(pcxt->seg);
+		slot->worker_number = i;
+
+		*assignment = slot->assignment;
+		result = slotno;
+		break;
+	}
+	LWLockRelease(ParallelWorkerPoolLock);
+
+	return result;
+}
+
+/*
+ * Free a slot reserved by ParallelPoolReserve whose worker never ran.
+ */
+static void
+ParallelPoolRelease(int slotno, uint64 assignment)
+{
+	ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+	if (slot->assignment == assignment && slot->pid == 0)
+		slot->state = POOL_SLOT_UNUSED;
+	LWLockRelease(ParallelWorkerPoolLock);
+}
+
+/*
+ * Is the pooled worker done with the given assignment, successfully or not?
+ */
+static bool
+ParallelPoolAssignmentEnded(int slotno, uint64 assignment)
+{
+	ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+	bool		result;
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_SHARED);
+	result = slot->assignment != assignment ||
+		slot->state == POOL_SLOT_UNUSED ||
+		slot->state == POOL_SLOT_IDLE;
+	LWLockRelease(ParallelWorkerPoolLock);
+
+	return result;
+}
+
+/*
+ * Terminate a pooled worker that is still working on the given assignment.
+ *
+ * We signal it while holding the lock, so that it can't have moved on to
+ * somebody else's assignment meanwhile.
+ */
+static void
+ParallelPoolTerminate(int slotno, uint64 assignment)
+{
+	ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_SHARED);
+	if (slot->assignment == assignment && slot->pid != 0 &&
+		(slot->state == POOL_SLOT_BUSY || slot->state == POOL_SLOT_ASSIGNED))
+		(void) kill(slot->pid, SIGTERM);
+	LWLockRelease(ParallelWorkerPoolLock);
+}
+
+/*
+ * Wait for pooled worker i of pcxt to be done with our assignment, the
+ * counterpart of waiting for a worker to exit.
+ */
+static void
+WaitForPooledWorkerToFinish(ParallelContext *pcxt, int i)
+{
+	ParallelWorkerInfo *winfo = &pcxt->worker[i];
+
+	for (;;)
+	{
+		int			rc;
+
+		if (ParallelPoolAssignmentEnded(winfo->pool_slot,
+										winfo->pool_assignment))
+			break;
+
+		/* A new worker might have failed to start at all. */
+		if (winfo->bgwhandle != NULL)
+		{
+			pid_t		pid;
+
+			if (GetBackgroundWorkerPid(winfo->bgwhandle, &pid) == BGWH_STOPPED)
+			{
+				ParallelPoolRelease(winfo->pool_slot, winfo->pool_assignment);
+				break;
+			}
+		}
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1,
+					   WAIT_EVENT_BGWORKER_SHUTDOWN);
+
+		/* See WaitForParallelWorkersToExit. */
+		if (rc & WL_POSTMASTER_DEATH)
+			ereport(FATAL,
+					(errcode(ERRCODE_ADMIN_SHUTDOWN),
+					 errmsg("postmaster exited during a parallel transaction")));
+
+		ResetLatch(MyLatch);
+	}
+
+	if (winfo->bgwhandle != NULL)
+	{
+		pfree(winfo->bgwhandle);
+		winfo->bgwhandle = NULL;
+	}
+	winfo->pool_slot = -1;
+}
+
+/*
+ * Wait in the pool, as a worker that's done with its assignment, for the
+ * next one.  Returns false if parallel_worker_pool_idle_timeout expires
+ * first, in which case we have given up our slot.
+ */
+static bool
+ParallelPoolWaitForAssignment(dsm_handle *handle)
+{
+	ParallelPoolSlot *slot = &ParallelPool->slots[MyPoolSlot];
+	TimestampTz idle_start = GetCurrentTimestamp();
+	pid_t		leader_pid;
+	BackendId	leader_backend_id;
+
+	LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+	Assert(slot->pid == MyProcPid && slot->state == POOL_SLOT_BUSY);
+	slot->state = POOL_SLOT_IDLE;
+	leader_pid = slot->leader_pid;
+	leader_backend_id = slot->leader_backend_id;
+	LWLockRelease(ParallelWorkerPoolLock);
+
+	/* Let the leader know that we're done. */
+	SendProcSignal(leader_pid, PROCSIG_PARALLEL_MESSAGE, leader_backend_id);
+
+	for (;;)
+	{
+		long		timeout;
+
+		CHECK_FOR_INTERRUPTS();
+
+		timeout = parallel_worker_pool_idle_timeout -
+			TimestampDifferenceMilliseconds(idle_start, GetCurrentTimestamp());
+
+		LWLockAcquire(ParallelWorkerPoolLock, LW_EXCLUSIVE);
+		if (slot->state == POOL_SLOT_ASSIGNED)
+		{
+			slot->state = POOL_SLOT_BUSY;
+			*handle = slot->handle;
+			ParallelWorkerNumber = slot->worker_number;
+			LWLockRelease(ParallelWorkerPoolLock);
+			return true;
+		}
+		if (timeout <= 0)
+		{
+			slot->state = POOL_SLOT_UNUSED;
+			slot->pid = 0;
+			LWLockRelease(ParallelWorkerPoolLock);
+			MyPoolSlot = -1;
+			return false;
+		}
+		LWLockRelease(ParallelWorkerPoolLock);
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 timeout, WAIT_EVENT_PARALLEL_WORKER_POOL_MAIN);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Terminate the idle pooled workers connected to the given database, so
+ * that they don't get in the way of dropping or altering it.
+ */
+void
+TerminateIdleParallelWorkers(Oid databaseId)
+{
+	LWLockAcquire(ParallelWorkerPoolLock, LW_SHARED);
+	for (int slotno = 0; slotno < parallel_worker_pool_size; slotno++)
+	{
+		ParallelPoolSlot *slot = &ParallelPool->slots[slotno];
+
+		if (slot->state == POOL_SLOT_IDLE && slot->database_id == databaseId)
+			(void) kill(slot->pid, SIGTERM);
+	}
+	LWLockRelease(ParallelWorkerPoolLock);
+}
@@ -22,17 +22,41 @@
 #include "access/clog.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
+#include "storage/proc.h"
 #include "utils/snapmgr.h"
 
 /*
- * Single-item cache for results of TransactionLogFetch.  It's worth having
- * such a cache because we frequently find ourselves repeatedly checking the
- * same XID, for example when scanning a table just after a bulk insert,
- * update, or delete.
+ * Cache for results of TransactionLogFetch.  It's worth having such a cache
+ * because we frequently find ourselves repeatedly checking the same few
+ * XIDs, for example when scanning a table just after a bulk insert, update,
+ * or delete, or on a standby or with checksums, where hint bits often can't
+ * be set.  Each hit saves a trip to the clog SLRU and its locks.
+ *
+ * The cache is direct-mapped on the low bits of the XID.  Only statuses that
+ * can't change are cached, and they stay right until the XID is reused after
+ * wraparound, which can't happen while we hold back the xmin horizon.  So
+ * the cache is only used while we advertise an xmin, and is emptied whenever
+ * we stop advertising one, at transaction end or when the last snapshot is
+ * released, by bumping the generation its entries must match.
  */
-static TransactionId cachedFetchXid = InvalidTransactionId;
-static XidStatus cachedFetchXidStatus;
-static XLogRecPtr cachedCommitLSN;
+#define XID_STATUS_CACHE_SIZE	1024
+
+typedef struct XidStatusCacheEntry
+{
+	TransactionId xid;
+	uint32		generation;
+	XLogRecPtr	commitLSN;
+	XidStatus	status;
+} XidStatusCacheEntry;
+
+static XidStatusCacheEntry xidStatusCache[XID_STATUS_CACHE_SIZE];
+static uint32 xidStatusCacheGeneration = 1;
+
+#define XidStatusCacheSlot(xid) \
+	(&xidStatusCache[(xid) % XID_STATUS_CACHE_SIZE])
+
+#define XidStatusCacheUsable() \
+	(MyProc != NULL && TransactionIdIsValid(MyProc->xmin))
 
 /* Local functions */
 static XidStatus TransactionLogFetch(TransactionId transactionId);
@@ -53,16 +77,10 @@ TransactionLogFetch(TransactionId transactionId)
 {
 	XidStatus	xidstatus;
 	XLogRecPtr	xidlsn;
+	XidStatusCacheEntry *entry;
 
 	/*
-	 * Before going to the commit log manager, check our single item cache to
-	 * see if we didn't just check the transaction status a moment ago.
-	 */
-	if (TransactionIdEquals(transactionId, cachedFetchXid)) // 缓存cachedFetchXid/cachedFetchXidStatus，加速查找的方法
-		return cachedFetchXidStatus;
-
-	/*
-	 * Also, check to see if the transaction ID is a permanent one.
+	 * Check to see if the transaction ID is a permanent one.
 	 */
 	if (!TransactionIdIsNormal(transactionId)) // 如果不是正常事务号，就是1和2两个
 	{
@@ -73,6 +91,16 @@ TransactionLogFetch(TransactionId transactionId)
 		return TRANSACTION_STATUS_ABORTED;
 	}
 
+	/*
+	 * Before going to the commit log manager, check our cache to see if we
+	 * didn't check the transaction status a moment ago.
+	 */
+	entry = XidStatusCacheUsable() ? XidStatusCacheSlot(transactionId) : NULL; // 缓存xidStatusCache，加速查找的方法
+	if (entry != NULL &&
+		TransactionIdEquals(entry->xid, transactionId) &&
+		entry->generation == xidStatusCacheGeneration)
+		return entry->status;
+
 	/*
 	 * Get the transaction status.
 	 */
@@ -82,17 +110,36 @@ TransactionLogFetch(TransactionId transactionId)
 	 * Cache it, but DO NOT cache status for unfinished or sub-committed
 	 * transactions!  We only cache status that is guaranteed not to change.
 	 */
-	if (xidstatus != TRANSACTION_STATUS_IN_PROGRESS &&
+	if (entry != NULL &&
+		xidstatus != TRANSACTION_STATUS_IN_PROGRESS &&
 		xidstatus != TRANSACTION_STATUS_SUB_COMMITTED)
 	{
-		cachedFetchXid = transactionId; //缓存一下，有3个变量保存状态
-		cachedFetchXidStatus = xidstatus;
-		cachedCommitLSN = xidlsn;
+		entry->xid = transactionId; //缓存一下
+		entry->generation = xidStatusCacheGeneration;
+		entry->status = xidstatus;
+		entry->commitLSN = xidlsn;
 	}
 
 	return xidstatus;
 }
 
+/*
+ * TransactionLogCacheReset --- forget the cached transaction statuses
+ *
+ * Called at the start of each transaction, and when we stop advertising an
+ * xmin within one.
+ */
+void
+TransactionLogCacheReset(void)
+{
+	if (++xidStatusCacheGeneration == 0)
+	{
+		/* don't let old entries match again after the counter wraps */
+		memset(xidStatusCache, 0, sizeof(xidStatusCache));
+		xidStatusCacheGeneration = 1;
+	}
+}
+
 /* ----------------------------------------------------------------
  *						Interface functions
  *
@@ -382,19 +429,24 @@ XLogRecPtr
 TransactionIdGetCommitLSN(TransactionId xid) /// 根据事务号，返回提交WAL记录或者更后的LSN
 {
 	XLogRecPtr	result;
+	XidStatusCacheEntry *entry;
+
+	/* Special XIDs are always known committed */
+	if (!TransactionIdIsNormal(xid))
+		return InvalidXLogRecPtr;
 
 	/*
 	 * Currently, all uses of this function are for xids that were just
 	 * reported to be committed by TransactionLogFetch, so we expect that
 	 * checking TransactionLogFetch's cache will usually succeed and avoid an
-	 * extra trip to shared memory.
+	 * extra trip to shared memory.  The cached LSN may be older than the
+	 * group's current one, but it's still late enough for this xid.
 	 */
-	if (TransactionIdEquals(xid, cachedFetchXid))
-		return cachedCommitLSN;
-
-	/* Special XIDs are always known committed */
-	if (!TransactionIdIsNormal(xid))
-		return InvalidXLogRecPtr;
+	entry = XidStatusCacheSlot(xid);
+	if (XidStatusCacheUsable() &&
+		TransactionIdEquals(entry->xid, xid) &&
+		entry->generation == xidStatusCacheGeneration)
+		return entry->commitLSN;
 
 	/*
 	 * Get the transaction status.
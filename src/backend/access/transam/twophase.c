@@ -452,6 +452,10 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 					TimestampTz prepared_at, Oid owner, Oid databaseid)
 {
 	PGPROC	   *proc;
+	TransactionId *subxids;
+	uint64	   *fpLockBits;
+	Oid		   *fpRelId;
+	dlist_head *myProcLocks;
 	int			i;
 
 	Assert(LWLockHeldByMeInMode(TwoPhaseStateLock, LW_EXCLUSIVE));
@@ -459,8 +463,20 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	Assert(gxact != NULL);
 	proc = &ProcGlobal->allProcs[gxact->pgprocno];
 
-	/* Initialize the PGPROC entry */
+	/*
+	 * Initialize the PGPROC entry, keeping the pointers to its arrays in
+	 * shared memory set up by InitProcGlobal().
+	 */
+	subxids = proc->subxids.xids;
+	fpLockBits = proc->fpLockBits;
+	fpRelId = proc->fpRelId;
+	myProcLocks = proc->myProcLocks;
 	MemSet(proc, 0, sizeof(PGPROC));
+	proc->subxids.xids = subxids;
+	proc->fpLockBits = fpLockBits;
+	proc->fpRelId = fpRelId;
+	proc->myProcLocks = myProcLocks;
+	proc->runningXidIndex = -1;
 	proc->pgprocno = gxact->pgprocno;
 	dlist_node_init(&proc->links);
 	proc->waitStatus = PROC_WAIT_STATUS_OK;
@@ -526,10 +542,10 @@ GXactLoadSubxactData(GlobalTransaction gxact, int nsubxacts,
 	PGPROC	   *proc = &ProcGlobal->allProcs[gxact->pgprocno];
 
 	/* We need no extra lock since the GXACT isn't valid yet */
-	if (nsubxacts > PGPROC_MAX_CACHED_SUBXIDS)
+	if (nsubxacts > max_cached_subxids)
 	{
 		proc->subxidStatus.overflowed = true;
-		nsubxacts = PGPROC_MAX_CACHED_SUBXIDS;
+		nsubxacts = max_cached_subxids;
 	}
 	if (nsubxacts > 0)
 	{
@@ -938,6 +954,22 @@ TwoPhaseGetDummyProc(TransactionId xid, bool lock_held)
 	return &ProcGlobal->allProcs[gxact->pgprocno];
 }
 
+/*
+ * TwoPhaseGetLockedDummyProc
+ *		Get the PGPROC of the prepared transaction this backend has locked,
+ *		if its XID is xid; otherwise return NULL.
+ *
+ * No lock is needed, as the gxact can't go away while we hold it.
+ */
+PGPROC *
+TwoPhaseGetLockedDummyProc(TransactionId xid)
+{
+	if (MyLockedGxact == NULL || MyLockedGxact->xid != xid)
+		return NULL;
+
+	return &ProcGlobal->allProcs[MyLockedGxact->pgprocno];
+}
+
 /************************************************************************/
 /* State file support													*/
 /************************************************************************/
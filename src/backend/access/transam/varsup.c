@@ -24,6 +24,7 @@
 #include "postmaster/autovacuum.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
+#include "storage/procarray.h"
 #include "utils/syscache.h"
 
 
@@ -230,6 +231,7 @@ GetNewTransactionId(bool isSubXact) /// 获得一个事务号。输入参数表
 		/* LWLockRelease acts as barrier */
 		MyProc->xid = xid;
 		ProcGlobal->xids[MyProc->pgxactoff] = xid;
+		ProcArrayAddRunningXid(MyProc, xid);
 	}
 	else
 	{
@@ -239,7 +241,7 @@ GetNewTransactionId(bool isSubXact) /// 获得一个事务号。输入参数表
 		Assert(substat->count == MyProc->subxidStatus.count);
 		Assert(substat->overflowed == MyProc->subxidStatus.overflowed);
 
-		if (nxids < PGPROC_MAX_CACHED_SUBXIDS)
+		if (nxids < max_cached_subxids)
 		{
 			MyProc->subxids.xids[nxids] = xid;
 			pg_write_barrier();
@@ -130,10 +130,16 @@ bool	   *wal_consistency_checking = NULL;
 bool		wal_init_zero = true;
 bool		wal_recycle = true;
 bool		log_checkpoints = true;
+bool		end_of_recovery_checkpoint = true;
 int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_REPLICA;
 int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
+bool		wal_group_commit = true;
+
+/* Bounds of the WAL flush group window, in microseconds */
+#define XLOG_GROUP_MIN_DELAY	20
+#define XLOG_GROUP_MAX_DELAY	10000
 int			wal_retrieve_retry_interval = 5000;
 int			max_slot_wal_keep_size_mb = -1;
 int			wal_decode_buffer_size = 512 * 1024;
@@ -146,11 +152,35 @@ bool		XLOG_DEBUG = false;
 int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 
 /*
- * Number of WAL insertion locks to use. A higher value allows more insertions
- * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * Number of WAL insertion locks to use (GUC wal_insert_locks). A higher value
+ * allows more insertions to happen concurrently, but adds some CPU overhead
+ * to flushing the WAL, which needs to iterate all the locks.  That's only an
+ * atomic read per lock that isn't held, though.  The limit of the GUC keeps
+ * WALInsertLockAcquireExclusive() well within MAX_SIMUL_LWLOCKS.
+ */
+int			wal_insert_locks = 8;
+
+/*
+ * Number of WAL buffer pages the WAL writer tries to keep initialized ahead
+ * of the insert position (GUC wal_buffer_init_ahead), so that inserters
+ * rarely have to do it themselves.  It's capped at half of wal_buffers, as
+ * the pages being replaced must already have been inserted.
+ */
+int			wal_buffer_init_ahead = 64;
+
+#define WALInitAheadPages()	Min(wal_buffer_init_ahead, XLOGbuffers / 2)
+
+/*
+ * Maximum number of future WAL segments the checkpointer keeps ready between
+ * checkpoints (GUC wal_preallocate_segments), see XLogPreallocSegments().
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			wal_preallocate_segments = 8;
+
+/*
+ * XLogPreallocSegments() aims to have enough segments ready for this much
+ * time at the recent WAL rate.
+ */
+#define WAL_PREALLOC_HORIZON_MS		2000
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -160,6 +190,14 @@ int			CheckPointSegments;
 
 /* Estimated distance between checkpoints, in bytes */
 static double CheckPointDistanceEstimate = 0;
+
+/*
+ * Recent WAL rate in bytes per second, and where and when it was last
+ * sampled.  Only used by XLogPreallocSegments() in the checkpointer.
+ */
+static double PreallocWalRateEstimate = 0;
+static XLogRecPtr PreallocLastInsertPos = InvalidXLogRecPtr;
+static TimestampTz PreallocLastTime = 0;
 static double PrevCheckPointDistance = 0;
 
 /*
@@ -376,7 +414,7 @@ typedef struct XLogwrtResult
 typedef struct
 {
 	LWLock		lock;
-	XLogRecPtr	insertingAt;
+	pg_atomic_uint64 insertingAt;
 	XLogRecPtr	lastImportantAt;
 } WALInsertLock;
 
@@ -477,6 +515,14 @@ typedef struct XLogCtlData // XLOG在共享内存中的数据结构
 	pg_time_t	lastSegSwitchTime;
 	XLogRecPtr	lastSegSwitchLSN;
 
+	/*
+	 * Hints for sizing the WAL flush group window, updated without locking:
+	 * moving average of the time a WAL fsync takes, in microseconds, and the
+	 * number of members of the last flush group.
+	 */
+	uint32		walFsyncTime;
+	uint32		walFlushGroupSize;
+
 	/*
 	 * Protected by info_lck and WALWriteLock (you must hold either lock to
 	 * read it, but both to update)
@@ -498,10 +544,13 @@ typedef struct XLogCtlData // XLOG在共享内存中的数据结构
 	/*
 	 * These values do not change after startup, although the pointed-to pages
 	 * and xlblocks values certainly do.  xlblocks values are protected by
-	 * WALBufMappingLock.
+	 * WALBufMappingLock.  A page's xlblocks entry is reset to
+	 * InvalidXLogRecPtr before the page is re-initialized, so that
+	 * WALReadFromBuffers() can copy pages out without taking the lock.
+	 * They're atomics so that such unlocked reads can't see torn values.
 	 */
 	char	   *pages;			/* buffers for unwritten XLOG pages */
-	XLogRecPtr *xlblocks;		/* 1st byte ptr-s + XLOG_BLCKSZ */
+	pg_atomic_uint64 *xlblocks; /* 1st byte ptr-s + XLOG_BLCKSZ */
 	int			XLogCacheBlck;	/* highest allocated xlog buffer index */
 
 	/*
@@ -652,7 +701,7 @@ static void CheckPointGuts(XLogRecPtr checkPointRedo, int flags);
 static void KeepLogSeg(XLogRecPtr recptr, XLogSegNo *logSegNo);
 static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 
-static void AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli,
+static int	AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli,
 								  bool opportunistic);
 static void XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
@@ -693,6 +742,11 @@ static XLogRecPtr XLogBytePosToRecPtr(uint64 bytepos);
 static XLogRecPtr XLogBytePosToEndRecPtr(uint64 bytepos);
 static uint64 XLogRecPtrToBytePos(XLogRecPtr ptr);
 
+static void XLogFlushUpto(XLogRecPtr record, TimeLineID insertTLI,
+						  bool allowDelay);
+static void XLogFlushGroupDelay(void);
+static void XLogFlushGroup(XLogRecPtr record, TimeLineID insertTLI);
+static int	WALInsertLockFirstToTry(void);
 static void WALInsertLockAcquire(void);
 static void WALInsertLockAcquireExclusive(void);
 static void WALInsertLockRelease(void);
@@ -777,7 +831,7 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
 	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * determined by wal_insert_locks. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -1021,6 +1075,10 @@ XLogInsertRecord(XLogRecData *rdata,
 		pgWalUsage.wal_bytes += rechdr->xl_tot_len;
 		pgWalUsage.wal_records++;
 		pgWalUsage.wal_fpi += num_fpi;
+
+		PendingWalStats.rmgrs[rechdr->xl_rmid].wal_bytes += rechdr->xl_tot_len;
+		PendingWalStats.rmgrs[rechdr->xl_rmid].wal_records++;
+		PendingWalStats.rmgrs[rechdr->xl_rmid].wal_fpi += num_fpi;
 	}
 
 	return EndPos;
@@ -1298,6 +1356,27 @@ CopyXLogRecordToWAL(int write_len, bool isLogSwitch, XLogRecData *rdata,
 		elog(PANIC, "space reserved for WAL record does not match what was written");
 }
 
+/*
+ * Choose the WAL insertion lock a backend tries first.
+ *
+ * When the PGPROCs are spread over NUMA nodes, give each node its own share
+ * of the locks, so that a lock's cache line mostly moves between CPUs on the
+ * same node.  Backends only stray to other nodes' locks under contention.
+ */
+static int
+WALInsertLockFirstToTry(void)
+{
+	int			nnodes = ShmemNumaNodes();
+	int			pernode;
+
+	if (nnodes <= 1 || wal_insert_locks < nnodes)
+		return MyProc->pgprocno % wal_insert_locks;
+
+	pernode = wal_insert_locks / nnodes;
+	return ProcNumaNode(MyProc->pgprocno) * pernode +
+		MyProc->pgprocno % pernode;
+}
+
 /*
  * Acquire a WAL insertion lock, for inserting to WAL.
  */
@@ -1320,7 +1399,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+		lockToTry = WALInsertLockFirstToTry();
 	MyLockNo = lockToTry;
 
 	/*
@@ -1338,7 +1417,7 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % wal_insert_locks;
 	}
 }
 
@@ -1356,7 +1435,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < wal_insert_locks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1382,7 +1461,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < wal_insert_locks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1410,8 +1489,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[wal_insert_locks - 1].l.lock,
+						&WALInsertLocks[wal_insert_locks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1478,7 +1557,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1568,19 +1647,15 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 	 * that doesn't happen.
 	 *
 	 * However, we don't hold a lock while we read the value. If someone has
-	 * just initialized the page, it's possible that we get a "torn read" of
-	 * the XLogRecPtr if 64-bit fetches are not atomic on this platform. In
-	 * that case we will see a bogus value. That's ok, we'll grab the mapping
-	 * lock (in AdvanceXLInsertBuffer) and retry if we see anything else than
-	 * the page we're looking for. But it means that when we do this unlocked
-	 * read, we might see a value that appears to be ahead of the page we're
-	 * looking for. Don't PANIC on that, until we've verified the value while
-	 * holding the lock.
+	 * just initialized the page, we may see the old value or the new one (the
+	 * entry is an atomic, so never a torn mix of both). That's ok, we'll grab
+	 * the mapping lock (in AdvanceXLInsertBuffer) and retry if we see
+	 * anything else than the page we're looking for.
 	 */
 	expectedEndPtr = ptr;
 	expectedEndPtr += XLOG_BLCKSZ - ptr % XLOG_BLCKSZ;
 
-	endptr = XLogCtl->xlblocks[idx];
+	endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
 	if (expectedEndPtr != endptr)
 	{
 		XLogRecPtr	initializedUpto;
@@ -1610,8 +1685,9 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 
 		WALInsertLockUpdateInsertingAt(initializedUpto);
 
-		AdvanceXLInsertBuffer(ptr, tli, false);
-		endptr = XLogCtl->xlblocks[idx];
+		PendingWalStats.wal_buffers_init +=
+			AdvanceXLInsertBuffer(ptr, tli, false);
+		endptr = pg_atomic_read_u64(&XLogCtl->xlblocks[idx]);
 
 		if (expectedEndPtr != endptr)
 			elog(PANIC, "could not find WAL buffer for %X/%X",
@@ -1626,6 +1702,18 @@ GetXLogBuffer(XLogRecPtr ptr, TimeLineID tli)
 		pg_memory_barrier();
 	}
 
+	/*
+	 * If we're getting close to the end of the pages initialized ahead, wake
+	 * up the WAL writer to prepare more, see XLogInitAheadWALBuffers().  The
+	 * unlocked read of InitializedUpTo may be torn, but that only results in
+	 * a spurious wakeup.
+	 */
+	if (wal_buffer_init_ahead > 0 &&
+		XLogCtl->InitializedUpTo - ptr <
+		(XLogRecPtr) (WALInitAheadPages() / 2) * XLOG_BLCKSZ &&
+		ProcGlobal->walwriterLatch)
+		SetLatch(ProcGlobal->walwriterLatch);
+
 	/*
 	 * Found the buffer holding this page. Return a pointer to the right
 	 * offset within the page.
@@ -1770,8 +1858,10 @@ XLogRecPtrToBytePos(XLogRecPtr ptr)
  * true, initialize as many pages as we can without having to write out
  * unwritten data. Any new pages are initialized to zeros, with pages headers
  * initialized properly.
+ *
+ * Returns the number of pages initialized.
  */
-static void
+static int
 AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 {
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
@@ -1781,7 +1871,7 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 	XLogRecPtr	NewPageEndPtr = InvalidXLogRecPtr;
 	XLogRecPtr	NewPageBeginPtr;
 	XLogPageHeader NewPage;
-	int			npages pg_attribute_unused() = 0;
+	int			npages = 0;
 
 	LWLockAcquire(WALBufMappingLock, LW_EXCLUSIVE);
 
@@ -1798,7 +1888,7 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 		 * be zero if the buffer hasn't been used yet).  Fall through if it's
 		 * already written out.
 		 */
-		OldPageRqstPtr = XLogCtl->xlblocks[nextidx];
+		OldPageRqstPtr = pg_atomic_read_u64(&XLogCtl->xlblocks[nextidx]);
 		if (LogwrtResult.Write < OldPageRqstPtr)
 		{
 			/*
@@ -1867,6 +1957,13 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 
 		NewPage = (XLogPageHeader) (XLogCtl->pages + nextidx * (Size) XLOG_BLCKSZ);
 
+		/*
+		 * Mark the buffer as not holding the old page anymore before zeroing
+		 * it, for the benefit of WALReadFromBuffers().
+		 */
+		pg_atomic_write_u64(&XLogCtl->xlblocks[nextidx], InvalidXLogRecPtr);
+		pg_write_barrier();
+
 		/*
 		 * Be sure to re-zero the buffer so that bytes beyond what we've
 		 * written will look like zeroes and not valid XLOG records...
@@ -1920,7 +2017,7 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 		 */
 		pg_write_barrier();
 
-		*((volatile XLogRecPtr *) &XLogCtl->xlblocks[nextidx]) = NewPageEndPtr;
+		pg_atomic_write_u64(&XLogCtl->xlblocks[nextidx], NewPageEndPtr);
 
 		XLogCtl->InitializedUpTo = NewPageEndPtr;
 
@@ -1935,6 +2032,8 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, TimeLineID tli, bool opportunistic)
 			 npages, LSN_FORMAT_ARGS(NewPageEndPtr));
 	}
 #endif
+
+	return npages;
 }
 
 /*
@@ -2108,7 +2207,7 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 		 * if we're passed a bogus WriteRqst.Write that is past the end of the
 		 * last page that's been initialized by AdvanceXLInsertBuffer.
 		 */
-		XLogRecPtr	EndPtr = XLogCtl->xlblocks[curridx];
+		XLogRecPtr	EndPtr = pg_atomic_read_u64(&XLogCtl->xlblocks[curridx]);
 
 		if (LogwrtResult.Write >= EndPtr)
 			elog(PANIC, "xlog write request %X/%X is past end of log %X/%X",
@@ -2136,6 +2235,10 @@ XLogWrite(XLogwrtRqst WriteRqst, TimeLineID tli, bool flexible)
 			/* create/use new log file */
 			openLogFile = XLogFileInit(openLogSegNo, tli);
 			ReserveExternalFD();
+
+			/* let the checkpointer replace the segment we just took */
+			if (wal_preallocate_segments > 0 && ProcGlobal->checkpointerLatch)
+				SetLatch(ProcGlobal->checkpointerLatch);
 		}
 
 		/* Make sure we have the current logfile open */
@@ -2445,9 +2548,12 @@ UpdateMinRecoveryPoint(XLogRecPtr lsn, bool force)
 	 * process as it should not update its own reference of minRecoveryPoint
 	 * until it has finished crash recovery to make sure that all WAL
 	 * available is replayed in this case.  This also saves from extra locks
-	 * taken on the control file from the startup process.
+	 * taken on the control file from the startup process.  Parallel redo
+	 * workers don't have a valid local copy to begin with, so they behave
+	 * like any other process here.
 	 */
-	if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery)
+	if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery &&
+		!InParallelRedoWorker)
 	{
 		updateMinRecoveryPoint = false;
 		return;
@@ -2504,44 +2610,19 @@ UpdateMinRecoveryPoint(XLogRecPtr lsn, bool force)
 }
 
 /*
- * Ensure that all XLOG data through the given position is flushed to disk.
+ * Workhorse of XLogFlush(): wait until we get the write lock, or someone else
+ * does the flush for us, and flush at least up to 'record'.
  *
- * NOTE: this differs from XLogWrite mainly in that the WALWriteLock is not
- * already held, and we try to avoid acquiring it if possible.
+ * If allowDelay is true, sleep for commit_delay before flushing, to let
+ * others' commits join this one.
+ *
+ * Must be called in a critical section.
  */
-void
-XLogFlush(XLogRecPtr record) // 确保截止到这个LSN的所有WAL记录已经被刷新到磁盘上了
+static void
+XLogFlushUpto(XLogRecPtr record, TimeLineID insertTLI, bool allowDelay)
 {
 	XLogRecPtr	WriteRqstPtr;
 	XLogwrtRqst WriteRqst;
-	TimeLineID	insertTLI = XLogCtl->InsertTimeLineID;
-
-	/*
-	 * During REDO, we are reading not writing WAL.  Therefore, instead of
-	 * trying to flush the WAL, we should update minRecoveryPoint instead. We
-	 * test XLogInsertAllowed(), not InRecovery, because we need checkpointer
-	 * to act this way too, and because when it tries to write the
-	 * end-of-recovery checkpoint, it should indeed flush.
-	 */
-	if (!XLogInsertAllowed())
-	{
-		UpdateMinRecoveryPoint(record, false);
-		return;
-	}
-
-	/* Quick exit if already known flushed */
-	if (record <= LogwrtResult.Flush)
-		return;
-
-#ifdef WAL_DEBUG
-	if (XLOG_DEBUG)
-		elog(LOG, "xlog flush request %X/%X; write %X/%X; flush %X/%X",
-			 LSN_FORMAT_ARGS(record),
-			 LSN_FORMAT_ARGS(LogwrtResult.Write),
-			 LSN_FORMAT_ARGS(LogwrtResult.Flush));
-#endif
-
-	START_CRIT_SECTION();
 
 	/*
 	 * Since fsync is usually a horribly expensive operation, we try to
@@ -2613,7 +2694,7 @@ XLogFlush(XLogRecPtr record) // 确保截止到这个LSN的所有WAL记录已经
 		 * We do not sleep if enableFsync is not turned on, nor if there are
 		 * fewer than CommitSiblings other backends with active transactions.
 		 */
-		if (CommitDelay > 0 && enableFsync &&
+		if (allowDelay && CommitDelay > 0 && enableFsync &&
 			MinimumActiveBackends(CommitSiblings))
 		{
 			pg_usleep(CommitDelay);
@@ -2641,6 +2722,210 @@ XLogFlush(XLogRecPtr record) // 确保截止到这个LSN的所有WAL记录已经
 		/* done */
 		break;
 	}
+}
+
+/*
+ * Sleep for the adaptive WAL flush group window, if worthwhile.
+ *
+ * While no flush is in progress, a group leader may wait a little to let more
+ * committers join its group, so that one fsync serves them all.  Doing so
+ * only pays off if there is concurrency to exploit, i.e. if the previous
+ * group had company and there are enough other active transactions (see
+ * commit_siblings).  The window is half the recently measured fsync time,
+ * so that it keeps up with the storage; commit_delay, if set, caps it.
+ */
+static void
+XLogFlushGroupDelay(void)
+{
+	uint32		delay;
+
+	if (!enableFsync || XLogCtl->walFlushGroupSize <= 1)
+		return;
+
+	delay = XLogCtl->walFsyncTime / 2;
+	delay = Min(delay, CommitDelay > 0 ? CommitDelay : XLOG_GROUP_MAX_DELAY);
+
+	/* not worth the system call for tiny delays */
+	if (delay < XLOG_GROUP_MIN_DELAY)
+		return;
+
+	if (!MinimumActiveBackends(CommitSiblings))
+		return;
+
+	pg_usleep(delay);
+}
+
+/*
+ * Flush the WAL up to 'record', together with everyone else who needs a
+ * flush at the same time.
+ *
+ * Backends add themselves to a lock-free list of processes waiting for a
+ * flush.  The one that finds the list empty becomes the leader: it waits for
+ * any flush that's already in progress to finish, allowing more members to
+ * join meanwhile, then takes the whole list, flushes as far as any member
+ * needs, and wakes up all the members.  The others just sleep until that has
+ * happened.  Compared to everyone queueing on WALWriteLock, that saves each
+ * waiter from waking up when the lock is released only to find out whether
+ * its own flush is done, and from competing for the lock if it isn't.
+ *
+ * This follows the same pattern as ProcArrayGroupClearXid().
+ *
+ * Must be called in a critical section.
+ */
+static void
+XLogFlushGroup(XLogRecPtr record, TimeLineID insertTLI)
+{
+	PROC_HDR   *procglobal = ProcGlobal;
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	uint32		nmembers = 0;
+	XLogRecPtr	upto = record;
+
+	/* Add ourselves to the list of processes needing a WAL flush. */
+	proc->walFlushGroupMember = true;
+	proc->walFlushGroupLsn = record;
+
+	nextidx = pg_atomic_read_u32(&procglobal->walFlushGroupFirst);
+	while (true)
+	{
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->walFlushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush the WAL for us.  Wait
+	 * until it has done so.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		pgstat_report_wait_start(WAIT_EVENT_WAL_FLUSH_GROUP);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(proc->sem);
+
+		/* let XLogFlush see how far the leader got */
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+		return;
+	}
+
+	/*
+	 * We are the leader.  If somebody is writing out WAL already, wait for
+	 * them to finish, while more members queue up behind us.  Otherwise
+	 * decide whether to give others a chance to join.
+	 */
+	if (LWLockAcquireOrWait(WALWriteLock, LW_EXCLUSIVE))
+	{
+		LWLockRelease(WALWriteLock);
+		XLogFlushGroupDelay();
+	}
+
+	/*
+	 * Now take the whole group off the list, and find out how far it needs
+	 * the WAL flushed.  Anyone arriving from here on starts the next group.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->walFlushGroupFirst,
+									 INVALID_PGPROCNO);
+	wakeidx = nextidx;
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[nextidx];
+
+		if (upto < member->walFlushGroupLsn)
+			upto = member->walFlushGroupLsn;
+		nmembers++;
+
+		nextidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+	}
+	XLogCtl->walFlushGroupSize = nmembers;
+
+	XLogFlushUpto(upto, insertTLI, false);
+
+	/*
+	 * Everyone in the group is satisfied now (unless it asked for a flush
+	 * past the end of WAL, which XLogFlush reports).  Wake them up.  We must
+	 * clear walFlushGroupNext first, as the member may be reused for another
+	 * group as soon as it sees walFlushGroupMember become false.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = &ProcGlobal->allProcs[wakeidx];
+
+		wakeidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+		pg_atomic_write_u32(&member->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->walFlushGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(member->sem);
+	}
+}
+
+/*
+ * Ensure that all XLOG data through the given position is flushed to disk.
+ *
+ * NOTE: this differs from XLogWrite mainly in that the WALWriteLock is not
+ * already held, and we try to avoid acquiring it if possible.
+ */
+void
+XLogFlush(XLogRecPtr record) // 确保截止到这个LSN的所有WAL记录已经被刷新到磁盘上了
+{
+	TimeLineID	insertTLI = XLogCtl->InsertTimeLineID;
+
+	/*
+	 * During REDO, we are reading not writing WAL.  Therefore, instead of
+	 * trying to flush the WAL, we should update minRecoveryPoint instead. We
+	 * test XLogInsertAllowed(), not InRecovery, because we need checkpointer
+	 * to act this way too, and because when it tries to write the
+	 * end-of-recovery checkpoint, it should indeed flush.
+	 */
+	if (!XLogInsertAllowed())
+	{
+		UpdateMinRecoveryPoint(record, false);
+		return;
+	}
+
+	/* Quick exit if already known flushed */
+	if (record <= LogwrtResult.Flush)
+		return;
+
+#ifdef WAL_DEBUG
+	if (XLOG_DEBUG)
+		elog(LOG, "xlog flush request %X/%X; write %X/%X; flush %X/%X",
+			 LSN_FORMAT_ARGS(record),
+			 LSN_FORMAT_ARGS(LogwrtResult.Write),
+			 LSN_FORMAT_ARGS(LogwrtResult.Flush));
+#endif
+
+	START_CRIT_SECTION();
+
+	if (wal_group_commit && MyProc != NULL)
+		XLogFlushGroup(record, insertTLI);
+	else
+		XLogFlushUpto(record, insertTLI, true);
 
 	END_CRIT_SECTION();
 
@@ -2832,6 +3117,62 @@ XLogBackgroundFlush(void) // 这个函数由WAL写进程walwriter周期性地执
 	return true;
 }
 
+/*
+ * Keep wal_buffer_init_ahead WAL buffer pages initialized beyond the current
+ * insert position.  This is called by the WAL writer.
+ *
+ * Without this, whoever inserts the first record on a page that isn't
+ * initialized yet must do it in GetXLogBuffer(), first writing out the old
+ * page in the buffer if the WAL writer hasn't, all while holding a WAL
+ * insertion lock.  Unlike the opportunistic initialization at the end of
+ * XLogBackgroundFlush(), this writes old pages out (without flushing them) if
+ * necessary.  Pages are initialized one at a time, so that WALBufMappingLock
+ * isn't held for long; inserters find them through xlblocks without taking
+ * any lock.
+ *
+ * Returns true if any pages were initialized.
+ */
+bool
+XLogInitAheadWALBuffers(void)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	XLogRecPtr	insertpos;
+	XLogRecPtr	upto;
+	TimeLineID	insertTLI;
+	int			npages = 0;
+
+	if (WALInitAheadPages() <= 0 || RecoveryInProgress())
+		return false;
+
+	insertTLI = XLogCtl->InsertTimeLineID;
+
+	SpinLockAcquire(&Insert->insertpos_lck);
+	insertpos = XLogBytePosToEndRecPtr(Insert->CurrBytePos);
+	SpinLockRelease(&Insert->insertpos_lck);
+
+	upto = insertpos + (XLogRecPtr) WALInitAheadPages() * XLOG_BLCKSZ;
+
+	START_CRIT_SECTION();
+
+	for (;;)
+	{
+		/*
+		 * AdvanceXLInsertBuffer() rechecks this under the lock.  A torn read
+		 * can only make us stop early, or ask for a page that is already
+		 * initialized or within our limit.
+		 */
+		XLogRecPtr	initializedUpTo = XLogCtl->InitializedUpTo;
+
+		if (initializedUpTo > upto)
+			break;
+		npages += AdvanceXLInsertBuffer(initializedUpTo, insertTLI, false);
+	}
+
+	END_CRIT_SECTION();
+
+	return npages > 0;
+}
+
 /*
  * Test whether XLOG data has been flushed up to (at least) the given position.
  *
@@ -2856,7 +3197,8 @@ XLogNeedsFlush(XLogRecPtr record) /// 该LSN是否需要被flush，true表示需
 		 * which cannot update its local copy of minRecoveryPoint as long as
 		 * it has not replayed all WAL available when doing crash recovery.
 		 */
-		if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery)
+		if (XLogRecPtrIsInvalid(LocalMinRecoveryPoint) && InRecovery &&
+			!InParallelRedoWorker)
 			updateMinRecoveryPoint = false;
 
 		/* Quick exit if already known to be updated or cannot be updated */
@@ -2976,6 +3318,19 @@ XLogFileInitInternal(XLogSegNo logsegno, TimeLineID logtli,
 	{
 		ssize_t		rc;
 
+#if defined(HAVE_POSIX_FALLOCATE) && defined(__linux__)
+
+		/*
+		 * Reserve the space in one go first, which gives the filesystem a
+		 * chance to allocate it contiguously and reports ENOSPC before we
+		 * write anything.  We still zero-fill below, as extents that were
+		 * only preallocated would need metadata updates on first write,
+		 * defeating fdatasync.  Failures are not fatal here; the writes
+		 * will report real problems.
+		 */
+		(void) posix_fallocate(fd, 0, wal_segment_size);
+#endif
+
 		/*
 		 * Zero-fill the file.  With this setting, we do this the hard way to
 		 * ensure that all the file space has really been allocated.  On
@@ -3100,6 +3455,9 @@ XLogFileInit(XLogSegNo logsegno, TimeLineID logtli)
 	if (fd >= 0)
 		return fd;
 
+	/* no segment was ready for us, so we had to create one */
+	PendingWalStats.wal_segments_created++;
+
 	/* Now open original target segment (might not be file I just made) */
 	fd = BasicOpenFile(path, O_RDWR | PG_BINARY | O_CLOEXEC |
 					   get_sync_bit(sync_method));
@@ -3422,6 +3780,91 @@ PreallocXlogFiles(XLogRecPtr endptr, TimeLineID tli)
 	}
 }
 
+/*
+ * Create future WAL segments in the background, between checkpoints.
+ *
+ * Recycling at checkpoints and PreallocXlogFiles() normally leave enough
+ * segments for the WAL written until the next checkpoint.  But during bursts
+ * of WAL, or before the first checkpoints have established the usual WAL
+ * volume, whoever switches to a segment that doesn't exist yet has to create
+ * and zero-fill it in XLogWrite(), while holding WALWriteLock.  To avoid
+ * that, the checkpointer calls this whenever a segment has been switched to,
+ * and makes sure that enough segments exist past the insert position to last
+ * WAL_PREALLOC_HORIZON_MS at the recent WAL rate.  That's at least one and at
+ * most wal_preallocate_segments segments, and never more than the next
+ * checkpoint would keep, per XLOGfileslop().
+ *
+ * The WAL rate is tracked like CheckPointDistanceEstimate is: a higher rate
+ * is adopted immediately, a lower one only gradually.
+ */
+void
+XLogPreallocSegments(void)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	XLogRecPtr	insertpos;
+	TimestampTz now;
+	TimeLineID	tli;
+	XLogSegNo	cursegno;
+	XLogSegNo	maxsegno;
+	int			nsegs;
+
+	if (wal_preallocate_segments <= 0 || RecoveryInProgress())
+		return;
+	if (!XLogCtl->InstallXLogFileSegmentActive)
+		return;					/* unlocked check says no */
+
+	tli = XLogCtl->InsertTimeLineID;
+
+	SpinLockAcquire(&Insert->insertpos_lck);
+	insertpos = XLogBytePosToEndRecPtr(Insert->CurrBytePos);
+	SpinLockRelease(&Insert->insertpos_lck);
+
+	/* update the estimate of the WAL rate, if we have a long enough sample */
+	now = GetCurrentTimestamp();
+	if (PreallocLastInsertPos == InvalidXLogRecPtr ||
+		insertpos < PreallocLastInsertPos)
+	{
+		PreallocLastInsertPos = insertpos;
+		PreallocLastTime = now;
+	}
+	else if (TimestampDifferenceExceeds(PreallocLastTime, now, 100))
+	{
+		double		rate;
+
+		rate = (double) (insertpos - PreallocLastInsertPos) * 1000.0 /
+			TimestampDifferenceMilliseconds(PreallocLastTime, now);
+		if (PreallocWalRateEstimate < rate)
+			PreallocWalRateEstimate = rate;
+		else
+			PreallocWalRateEstimate =
+				(0.90 * PreallocWalRateEstimate + 0.10 * rate);
+
+		PreallocLastInsertPos = insertpos;
+		PreallocLastTime = now;
+	}
+
+	nsegs = (int) ceil(PreallocWalRateEstimate * WAL_PREALLOC_HORIZON_MS /
+					   1000.0 / wal_segment_size);
+	nsegs = Max(nsegs, 1);
+	nsegs = Min(nsegs, wal_preallocate_segments);
+
+	XLByteToSeg(insertpos, cursegno, wal_segment_size);
+	maxsegno = Min(cursegno + nsegs, XLOGfileslop(GetRedoRecPtr()));
+
+	for (XLogSegNo segno = cursegno + 1; segno <= maxsegno; segno++)
+	{
+		char		path[MAXPGPATH];
+		bool		added;
+		int			fd;
+
+		fd = XLogFileInitInternal(segno, tli, &added, path);
+		if (fd >= 0)
+			close(fd);
+		if (added)
+			elog(DEBUG2, "preallocated WAL segment \"%s\"", path);
+	}
+}
+
 /*
  * Throws an error if the given log segment has already been removed or
  * recycled. The caller should only pass a segment that it knows to have
@@ -4516,9 +4959,9 @@ XLOGShmemSize(void)
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), wal_insert_locks + 1));
 	/* xlblocks array */
-	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
+	size = add_size(size, mul_size(sizeof(pg_atomic_uint64), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
 	size = add_size(size, Max(XLOG_BLCKSZ, PG_IO_ALIGN_SIZE));
 	/* and the buffers themselves */
@@ -4596,9 +5039,11 @@ XLOGShmemInit(void)
 	 * needed here.
 	 */
 	allocptr = ((char *) XLogCtl) + sizeof(XLogCtlData);
-	XLogCtl->xlblocks = (XLogRecPtr *) allocptr;
-	memset(XLogCtl->xlblocks, 0, sizeof(XLogRecPtr) * XLOGbuffers);
-	allocptr += sizeof(XLogRecPtr) * XLOGbuffers;
+	XLogCtl->xlblocks = (pg_atomic_uint64 *) allocptr;
+	allocptr += sizeof(pg_atomic_uint64) * XLOGbuffers;
+
+	for (i = 0; i < XLOGbuffers; i++)
+		pg_atomic_init_u64(&XLogCtl->xlblocks[i], InvalidXLogRecPtr);
 
 
 	/* WAL insertion locks. Ensure they're aligned to the full padded size */
@@ -4606,12 +5051,12 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * wal_insert_locks;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
-		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
+		pg_atomic_init_u64(&WALInsertLocks[i].l.insertingAt, InvalidXLogRecPtr);
 		WALInsertLocks[i].l.lastImportantAt = InvalidXLogRecPtr;
 	}
 
@@ -4622,6 +5067,13 @@ XLOGShmemInit(void)
 	 */
 	allocptr = (char *) TYPEALIGN(XLOG_BLCKSZ, allocptr);
 	XLogCtl->pages = allocptr;
+
+	/*
+	 * WAL is inserted by backends on every node, so spread the buffers
+	 * across them all, before they're touched.
+	 */
+	ShmemNumaInterleave("WAL Buffers", XLogCtl->pages,
+						(Size) XLOG_BLCKSZ * XLOGbuffers);
 	memset(XLogCtl->pages, 0, (Size) XLOG_BLCKSZ * XLOGbuffers);
 
 	/*
@@ -5046,7 +5498,7 @@ StartupXLOG(void) // 这个函数只在startup进程中调用一次
 	XLogRecPtr	abortedRecPtr;
 	XLogRecPtr	missingContrecPtr;
 	TransactionId oldestActiveXID;
-	bool		promoted = false;
+	bool		checkpoint_deferred = false;
 
 	/*
 	 * We should have an aux process resource owner to use, and we should not
@@ -5637,7 +6089,8 @@ StartupXLOG(void) // 这个函数只在startup进程中调用一次
 		memcpy(page, endOfRecoveryInfo->lastPage, len);
 		memset(page + len, 0, XLOG_BLCKSZ - len);
 
-		XLogCtl->xlblocks[firstIdx] = endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ;
+		pg_atomic_write_u64(&XLogCtl->xlblocks[firstIdx],
+							endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ);
 		XLogCtl->InitializedUpTo = endOfRecoveryInfo->lastPageBeginPtr + XLOG_BLCKSZ;
 	}
 	else
@@ -5722,7 +6175,7 @@ StartupXLOG(void) // 这个函数只在startup进程中调用一次
 	 * Emit checkpoint or end-of-recovery record in XLOG, if required.
 	 */
 	if (performedWalRecovery)
-		promoted = PerformRecoveryXLogAction();
+		checkpoint_deferred = PerformRecoveryXLogAction();
 
 	/*
 	 * If any of the critical GUCs have changed, log them before we allow
@@ -5784,12 +6237,13 @@ StartupXLOG(void) // 这个函数只在startup进程中调用一次
 	WalSndWakeup(true, true);
 
 	/*
-	 * If this was a promotion, request an (online) checkpoint now. This isn't
-	 * required for consistency, but the last restartpoint might be far back,
-	 * and in case of a crash, recovering from it might take a longer than is
-	 * appropriate now that we're not in standby mode anymore.
+	 * If this was a promotion, or crash recovery without the checkpoint,
+	 * request an (online) checkpoint now. This isn't required for
+	 * consistency, but the last restartpoint might be far back, and in case
+	 * of a crash, recovering from it might take a longer than is appropriate
+	 * now that we're not in standby mode anymore.
 	 */
-	if (promoted)
+	if (checkpoint_deferred)
 		RequestCheckpoint(CHECKPOINT_FORCE);
 }
 
@@ -5871,11 +6325,14 @@ ReachedEndOfBackup(XLogRecPtr EndRecPtr, TimeLineID tli)
  * but since we may be assigning a new TLI, using a shutdown checkpoint allows
  * us to have the rule that TLI only changes in shutdown checkpoints, which
  * allows some extra error checking in xlog_redo.
+ *
+ * Returns true if we only wrote an end-of-recovery record, and the caller
+ * should request a checkpoint once we're out of recovery.
  */
 static bool
 PerformRecoveryXLogAction(void)
 {
-	bool		promoted = false;
+	bool		checkpoint_deferred = false;
 
 	/*
 	 * Perform a checkpoint to update all our recovery activity to disk.
@@ -5888,12 +6345,13 @@ PerformRecoveryXLogAction(void)
 	 *
 	 * In promotion, only create a lightweight end-of-recovery record instead
 	 * of a full checkpoint. A checkpoint is requested later, after we're
-	 * fully out of recovery mode and already accepting queries.
+	 * fully out of recovery mode and already accepting queries.  With
+	 * end_of_recovery_checkpoint off, crash recovery does the same.
 	 */
 	if (ArchiveRecoveryRequested && IsUnderPostmaster &&
 		PromoteIsTriggered())
 	{
-		promoted = true;
+		checkpoint_deferred = true;
 
 		/*
 		 * Insert a special WAL record to mark the end of recovery, since we
@@ -5906,6 +6364,21 @@ PerformRecoveryXLogAction(void)
 		 */
 		CreateEndOfRecoveryRecord();
 	}
+	else if (!ArchiveRecoveryRequested && IsUnderPostmaster &&
+			 !end_of_recovery_checkpoint)
+	{
+		checkpoint_deferred = true;
+
+		/*
+		 * Writing out everything redo dirtied can take about as long as redo
+		 * itself, and we'd rather accept connections meanwhile.  That's safe
+		 * for the same reasons as in promotion: if we crash again before the
+		 * next checkpoint, crash recovery simply starts from the same
+		 * checkpoint as this time, and replays this record too, which keeps
+		 * the timeline.
+		 */
+		CreateEndOfRecoveryRecord();
+	}
 	else
 	{
 		RequestCheckpoint(CHECKPOINT_END_OF_RECOVERY |
@@ -5913,7 +6386,7 @@ PerformRecoveryXLogAction(void)
 						  CHECKPOINT_WAIT);
 	}
 
-	return promoted;
+	return checkpoint_deferred;
 }
 
 /*
@@ -6133,7 +6606,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -8178,8 +8651,11 @@ issue_xlog_fsync(int fd, XLogSegNo segno, TimeLineID tli)
 		sync_method == SYNC_METHOD_OPEN_DSYNC)
 		return;
 
-	/* Measure I/O timing to sync the WAL file */
-	if (track_wal_io_timing)
+	/*
+	 * Measure I/O timing to sync the WAL file, also needed to size the WAL
+	 * flush group window
+	 */
+	if (track_wal_io_timing || wal_group_commit)
 		INSTR_TIME_SET_CURRENT(start);
 	else
 		INSTR_TIME_SET_ZERO(start);
@@ -8229,12 +8705,25 @@ issue_xlog_fsync(int fd, XLogSegNo segno, TimeLineID tli)
 	/*
 	 * Increment the I/O timing and the number of times WAL files were synced.
 	 */
-	if (track_wal_io_timing)
+	if (track_wal_io_timing || wal_group_commit)
 	{
 		instr_time	duration;
 
 		INSTR_TIME_SET_CURRENT(duration);
-		INSTR_TIME_ACCUM_DIFF(PendingWalStats.wal_sync_time, duration, start);
+		INSTR_TIME_SUBTRACT(duration, start);
+
+		if (track_wal_io_timing)
+			INSTR_TIME_ADD(PendingWalStats.wal_sync_time, duration);
+
+		/* keep a moving average, weighting the new sample by 1/8 */
+		if (wal_group_commit && XLogCtl != NULL)
+		{
+			uint64		usec = INSTR_TIME_GET_MICROSEC(duration);
+
+			usec = Min(usec, PG_UINT32_MAX);
+			XLogCtl->walFsyncTime = (uint32)
+				(((uint64) XLogCtl->walFsyncTime * 7 + usec) / 8);
+		}
 	}
 
 	PendingWalStats.wal_sync++;
@@ -8925,6 +9414,72 @@ GetXLogWriteRecPtr(void)
 	return LogwrtResult.Write;
 }
 
+/*
+ * Copy WAL starting at startptr from the WAL buffers into buf, as far as it
+ * is still present there, on timeline tli.
+ *
+ * Returns the number of bytes copied, which may be less than count, or zero,
+ * if the pages have been replaced already.  The rest has to be read from WAL
+ * files.  Only WAL that has been written out can be requested.  Nothing is
+ * copied during recovery or for any but the current insertion timeline.
+ *
+ * No lock is taken.  Instead, the xlblocks entry of each page is checked
+ * before and after copying it: AdvanceXLInsertBuffer() invalidates the entry
+ * before it starts re-initializing the page.
+ */
+Size
+WALReadFromBuffers(char *buf, XLogRecPtr startptr, Size count,
+				   TimeLineID tli)
+{
+	char	   *dst = buf;
+	XLogRecPtr	recptr = startptr;
+	XLogRecPtr	written;
+	Size		nbytes = count;
+
+	if (RecoveryInProgress() || tli != GetWALInsertionTimeLine())
+		return 0;
+
+	Assert(!XLogRecPtrIsInvalid(startptr));
+
+	written = GetXLogWriteRecPtr();
+	if (startptr + count > written)
+		elog(ERROR, "cannot read WAL up to %X/%X from WAL buffers, written only up to %X/%X",
+			 LSN_FORMAT_ARGS(startptr + count), LSN_FORMAT_ARGS(written));
+
+	while (nbytes > 0)
+	{
+		uint32		offset = recptr % XLOG_BLCKSZ;
+		int			idx = XLogRecPtrToBufIdx(recptr);
+		XLogRecPtr	expectedEndPtr;
+		Size		npagebytes;
+
+		expectedEndPtr = recptr + (XLOG_BLCKSZ - offset);
+		npagebytes = Min(nbytes, XLOG_BLCKSZ - offset);
+
+		/* Is the page still in the buffer? */
+		if (pg_atomic_read_u64(&XLogCtl->xlblocks[idx]) != expectedEndPtr)
+			break;
+
+		/* Don't let the copy be reordered before the check ... */
+		pg_read_barrier();
+
+		memcpy(dst, XLogCtl->pages + idx * (Size) XLOG_BLCKSZ + offset,
+			   npagebytes);
+
+		/* ... or after the re-check, in case it was replaced meanwhile. */
+		pg_read_barrier();
+
+		if (pg_atomic_read_u64(&XLogCtl->xlblocks[idx]) != expectedEndPtr)
+			break;
+
+		dst += npagebytes;
+		recptr += npagebytes;
+		nbytes -= npagebytes;
+	}
+
+	return dst - buf;
+}
+
 /*
  * Returns the redo pointer of the last checkpoint or restartpoint. This is
  * the oldest point in WAL that we still need, if we have to restart recovery.
@@ -22,6 +22,7 @@
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogcompress.h"
 #include "common/archive.h"
 #include "common/percentrepl.h"
 #include "miscadmin.h"
@@ -184,6 +185,15 @@ RestoreArchivedFile(char *path, const char *xlogfname,
 
 	if (rc == 0) /// 拷贝成功了
 	{
+		/*
+		 * If the archive holds a compressed copy (see archive_compression),
+		 * decompress it.  Like a file of the wrong size, a file that doesn't
+		 * decompress in standby mode may still be being copied to the
+		 * archive, so keep trying in that case.
+		 */
+		if (!XLogDecompressFile(xlogpath, StandbyMode ? DEBUG1 : FATAL))
+			return false;
+
 		/*
 		 * command apparently succeeded, but let's make sure the file is
 		 * really there now and has the correct size.
@@ -0,0 +1,707 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogcompress.c
+ *		Compression of WAL data for streaming replication and archiving.
+ *
+ * wal_compression only compresses full-page images within WAL records.
+ * The routines here compress WAL as a byte stream instead: the messages a
+ * walsender sends when the walreceiver asked for it (wal_sender_compression),
+ * and the segments the archiver hands to the archive command or module
+ * (archive_compression).  The WAL in pg_wal is never compressed.
+ *
+ * Messages are compressed one at a time, so that each can be decompressed
+ * on its own.  Files are compressed into a standard lz4 or zstd frame with
+ * a content checksum, which the usual command line tools can decompress as
+ * well.  A restored file is decompressed if it starts with the magic number
+ * of one of these formats, which can't be mistaken for the header of an
+ * uncompressed WAL segment.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/backend/access/transam/xlogcompress.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#include <lz4frame.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "access/xlogcompress.h"
+#include "pgstat.h"
+#include "storage/fd.h"
+
+/* zstd level used for streaming, where speed matters most */
+#define XLOG_STREAM_ZSTD_LEVEL		1
+
+/* size of the chunks in which files are read */
+#define XLOG_COMPRESS_CHUNK_SIZE	(XLOG_BLCKSZ * 8)
+
+/* magic numbers at the start of lz4 and zstd frames, stored little-endian */
+#define LZ4_FRAME_MAGIC				0x184D2204
+#define ZSTD_FRAME_MAGIC			0xFD2FB528
+
+/* the files being compressed or decompressed */
+typedef struct XLogCompressIO
+{
+	int			srcfd;
+	const char *srcpath;
+	int			dstfd;
+	const char *dstpath;
+	int			elevel;
+} XLogCompressIO;
+
+#if defined(USE_LZ4) || defined(USE_ZSTD)
+static int	XLogCompressRead(XLogCompressIO *io, char *buf);
+static bool XLogCompressWrite(XLogCompressIO *io, const char *buf, size_t len);
+#endif
+#ifdef USE_LZ4
+static bool XLogCompressFileLZ4(XLogCompressIO *io);
+static bool XLogDecompressFileLZ4(XLogCompressIO *io);
+#endif
+#ifdef USE_ZSTD
+static bool XLogCompressFileZstd(XLogCompressIO *io);
+static bool XLogDecompressFileZstd(XLogCompressIO *io);
+#endif
+
+/*
+ * Name of a compression method, for messages and GUC values
+ */
+const char *
+XLogCompressionName(WalCompression method)
+{
+	switch (method)
+	{
+		case WAL_COMPRESSION_NONE:
+			return "off";
+		case WAL_COMPRESSION_PGLZ:
+			return "pglz";
+		case WAL_COMPRESSION_LZ4:
+			return "lz4";
+		case WAL_COMPRESSION_ZSTD:
+			return "zstd";
+	}
+
+	return "???";
+}
+
+/*
+ * Space needed to compress srclen bytes with XLogCompressData() in the worst
+ * case.  Returns 0 if the method isn't supported.
+ */
+int
+XLogCompressBound(WalCompression method, int srclen)
+{
+	switch (method)
+	{
+#ifdef USE_LZ4
+		case WAL_COMPRESSION_LZ4:
+			return LZ4_compressBound(srclen);
+#endif
+#ifdef USE_ZSTD
+		case WAL_COMPRESSION_ZSTD:
+			return ZSTD_compressBound(srclen);
+#endif
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Compress srclen bytes at src into dst, which has room for dstlen bytes.
+ *
+ * Returns the compressed length, or -1 if the data couldn't be compressed
+ * into the space given.
+ */
+int
+XLogCompressData(WalCompression method, const char *src, int srclen,
+				 char *dst, int dstlen)
+{
+	switch (method)
+	{
+#ifdef USE_LZ4
+		case WAL_COMPRESSION_LZ4:
+			{
+				int			len;
+
+				len = LZ4_compress_default(src, dst, srclen, dstlen);
+				return len > 0 ? len : -1;
+			}
+#endif
+#ifdef USE_ZSTD
+		case WAL_COMPRESSION_ZSTD:
+			{
+				size_t		len;
+
+				len = ZSTD_compress(dst, dstlen, src, srclen,
+									XLOG_STREAM_ZSTD_LEVEL);
+				return ZSTD_isError(len) ? -1 : (int) len;
+			}
+#endif
+		default:
+			break;
+	}
+
+	return -1;
+}
+
+/*
+ * Decompress srclen bytes at src, which must decompress to exactly rawlen
+ * bytes, into dst.  Returns false if the data is corrupt or the method isn't
+ * supported.
+ */
+bool
+XLogDecompressData(WalCompression method, const char *src, int srclen,
+				   char *dst, int rawlen)
+{
+	switch (method)
+	{
+#ifdef USE_LZ4
+		case WAL_COMPRESSION_LZ4:
+			return LZ4_decompress_safe(src, dst, srclen, rawlen) == rawlen;
+#endif
+#ifdef USE_ZSTD
+		case WAL_COMPRESSION_ZSTD:
+			{
+				size_t		len;
+
+				len = ZSTD_decompress(dst, rawlen, src, srclen);
+				return !ZSTD_isError(len) && len == rawlen;
+			}
+#endif
+		default:
+			break;
+	}
+
+	return false;
+}
+
+/*
+ * XLogCompressFile
+ *
+ * Write a compressed copy of the file at srcpath to dstpath.  On failure, an
+ * error is reported at elevel, dstpath is removed and false is returned.
+ */
+bool
+XLogCompressFile(WalCompression method, const char *srcpath,
+				 const char *dstpath, int elevel)
+{
+	XLogCompressIO io;
+	bool		ok = false;
+
+	io.srcpath = srcpath;
+	io.dstpath = dstpath;
+	io.elevel = elevel;
+
+	io.srcfd = OpenTransientFile(srcpath, O_RDONLY | PG_BINARY);
+	if (io.srcfd < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", srcpath)));
+		return false;
+	}
+
+	io.dstfd = OpenTransientFile(dstpath, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (io.dstfd < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", dstpath)));
+		CloseTransientFile(io.srcfd);
+		return false;
+	}
+
+	switch (method)
+	{
+#ifdef USE_LZ4
+		case WAL_COMPRESSION_LZ4:
+			ok = XLogCompressFileLZ4(&io);
+			break;
+#endif
+#ifdef USE_ZSTD
+		case WAL_COMPRESSION_ZSTD:
+			ok = XLogCompressFileZstd(&io);
+			break;
+#endif
+		default:
+			ereport(elevel,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("compression method %s not supported by this build",
+							XLogCompressionName(method))));
+			break;
+	}
+
+	CloseTransientFile(io.srcfd);
+	if (CloseTransientFile(io.dstfd) != 0 && ok)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", dstpath)));
+		ok = false;
+	}
+
+	if (!ok)
+		unlink(dstpath);
+
+	return ok;
+}
+
+/*
+ * XLogDecompressFile
+ *
+ * If the file at path is compressed, decompress it in place.  Nothing is done
+ * if it doesn't exist or isn't compressed.  On failure, an error is reported
+ * at elevel and false is returned.
+ */
+bool
+XLogDecompressFile(const char *path, int elevel)
+{
+	XLogCompressIO io;
+	char		tmppath[MAXPGPATH];
+	unsigned char magicbuf[4];
+	uint32		magic;
+	bool		ok = false;
+	int			r;
+
+	io.srcpath = path;
+	io.dstpath = tmppath;
+	io.elevel = elevel;
+
+	io.srcfd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+	if (io.srcfd < 0)
+	{
+		if (errno == ENOENT)
+			return true;
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+		return false;
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_COPY_READ);
+	r = pg_pread(io.srcfd, magicbuf, sizeof(magicbuf), 0);
+	pgstat_report_wait_end();
+	if (r < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", path)));
+		CloseTransientFile(io.srcfd);
+		return false;
+	}
+
+	magic = (uint32) magicbuf[0] | ((uint32) magicbuf[1] << 8) |
+		((uint32) magicbuf[2] << 16) | ((uint32) magicbuf[3] << 24);
+	if (r < sizeof(magicbuf) ||
+		(magic != LZ4_FRAME_MAGIC && magic != ZSTD_FRAME_MAGIC))
+	{
+		/* not compressed */
+		CloseTransientFile(io.srcfd);
+		return true;
+	}
+
+	snprintf(tmppath, MAXPGPATH, "%s.decompressed", path);
+	io.dstfd = OpenTransientFile(tmppath, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (io.dstfd < 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", tmppath)));
+		CloseTransientFile(io.srcfd);
+		return false;
+	}
+
+	if (magic == LZ4_FRAME_MAGIC)
+	{
+#ifdef USE_LZ4
+		ok = XLogDecompressFileLZ4(&io);
+#else
+		ereport(elevel,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("file \"%s\" is compressed with %s, which is not supported by this build",
+						path, "lz4")));
+#endif
+	}
+	else
+	{
+#ifdef USE_ZSTD
+		ok = XLogDecompressFileZstd(&io);
+#else
+		ereport(elevel,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("file \"%s\" is compressed with %s, which is not supported by this build",
+						path, "zstd")));
+#endif
+	}
+
+	CloseTransientFile(io.srcfd);
+	if (CloseTransientFile(io.dstfd) != 0 && ok)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", tmppath)));
+		ok = false;
+	}
+
+	if (ok && rename(tmppath, path) != 0)
+	{
+		ereport(elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						tmppath, path)));
+		ok = false;
+	}
+
+	if (!ok)
+		unlink(tmppath);
+
+	return ok;
+}
+
+#if defined(USE_LZ4) || defined(USE_ZSTD)
+/*
+ * Read the next chunk of the source file into buf, which must have room for
+ * XLOG_COMPRESS_CHUNK_SIZE bytes.  Returns the number of bytes read, 0 at
+ * the end of the file, or -1 on failure.
+ */
+static int
+XLogCompressRead(XLogCompressIO *io, char *buf)
+{
+	int			r;
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_COPY_READ);
+	r = read(io->srcfd, buf, XLOG_COMPRESS_CHUNK_SIZE);
+	pgstat_report_wait_end();
+	if (r < 0)
+		ereport(io->elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", io->srcpath)));
+
+	return r;
+}
+
+/*
+ * Write len bytes at buf to the destination file.
+ */
+static bool
+XLogCompressWrite(XLogCompressIO *io, const char *buf, size_t len)
+{
+	if (len == 0)
+		return true;
+
+	errno = 0;
+	pgstat_report_wait_start(WAIT_EVENT_WAL_COPY_WRITE);
+	if (write(io->dstfd, buf, len) != len)
+	{
+		pgstat_report_wait_end();
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(io->elevel,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", io->dstpath)));
+		return false;
+	}
+	pgstat_report_wait_end();
+
+	return true;
+}
+#endif
+
+#ifdef USE_LZ4
+static bool
+XLogCompressFileLZ4(XLogCompressIO *io)
+{
+	LZ4F_compressionContext_t cctx;
+	LZ4F_preferences_t prefs;
+	char	   *inbuf;
+	char	   *outbuf;
+	size_t		outbufsize;
+	size_t		len;
+	int			nread;
+	bool		ok = false;
+
+	len = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+	if (LZ4F_isError(len))
+	{
+		ereport(io->elevel,
+				(errmsg("could not create lz4 compression context: %s",
+						LZ4F_getErrorName(len))));
+		return false;
+	}
+
+	memset(&prefs, 0, sizeof(prefs));
+	prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+	inbuf = palloc(XLOG_COMPRESS_CHUNK_SIZE);
+	outbufsize = LZ4F_compressBound(XLOG_COMPRESS_CHUNK_SIZE, &prefs);
+	outbufsize = Max(outbufsize, LZ4F_HEADER_SIZE_MAX);
+	outbuf = palloc(outbufsize);
+
+	len = LZ4F_compressBegin(cctx, outbuf, outbufsize, &prefs);
+	if (LZ4F_isError(len))
+		goto lz4_error;
+	if (!XLogCompressWrite(io, outbuf, len))
+		goto done;
+
+	while ((nread = XLogCompressRead(io, inbuf)) > 0)
+	{
+		len = LZ4F_compressUpdate(cctx, outbuf, outbufsize, inbuf, nread, NULL);
+		if (LZ4F_isError(len))
+			goto lz4_error;
+		if (!XLogCompressWrite(io, outbuf, len))
+			goto done;
+	}
+	if (nread < 0)
+		goto done;
+
+	len = LZ4F_compressEnd(cctx, outbuf, outbufsize, NULL);
+	if (LZ4F_isError(len))
+		goto lz4_error;
+	ok = XLogCompressWrite(io, outbuf, len);
+	goto done;
+
+lz4_error:
+	ereport(io->elevel,
+			(errmsg("could not compress file \"%s\": %s",
+					io->srcpath, LZ4F_getErrorName(len))));
+
+done:
+	LZ4F_freeCompressionContext(cctx);
+	pfree(inbuf);
+	pfree(outbuf);
+
+	return ok;
+}
+
+static bool
+XLogDecompressFileLZ4(XLogCompressIO *io)
+{
+	LZ4F_decompressionContext_t dctx;
+	char	   *inbuf;
+	char	   *outbuf;
+	size_t		ret;
+	size_t		outlen;
+	size_t		inlen;
+	int			nread;
+	bool		ok = false;
+
+	ret = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+	if (LZ4F_isError(ret))
+	{
+		ereport(io->elevel,
+				(errmsg("could not create lz4 decompression context: %s",
+						LZ4F_getErrorName(ret))));
+		return false;
+	}
+
+	inbuf = palloc(XLOG_COMPRESS_CHUNK_SIZE);
+	outbuf = palloc(XLOG_COMPRESS_CHUNK_SIZE);
+
+	while ((nread = XLogCompressRead(io, inbuf)) > 0)
+	{
+		char	   *src = inbuf;
+		size_t		remaining = nread;
+
+		while (remaining > 0)
+		{
+			outlen = XLOG_COMPRESS_CHUNK_SIZE;
+			inlen = remaining;
+			ret = LZ4F_decompress(dctx, outbuf, &outlen, src, &inlen, NULL);
+			if (LZ4F_isError(ret))
+				goto lz4_error;
+			if (!XLogCompressWrite(io, outbuf, outlen))
+				goto done;
+			src += inlen;
+			remaining -= inlen;
+		}
+	}
+	if (nread < 0)
+		goto done;
+
+	/* flush whatever is still buffered in the context */
+	do
+	{
+		outlen = XLOG_COMPRESS_CHUNK_SIZE;
+		inlen = 0;
+		ret = LZ4F_decompress(dctx, outbuf, &outlen, inbuf, &inlen, NULL);
+		if (LZ4F_isError(ret))
+			goto lz4_error;
+		if (!XLogCompressWrite(io, outbuf, outlen))
+			goto done;
+	} while (outlen > 0);
+
+	/* a nonzero hint means that the frame isn't complete */
+	if (ret != 0)
+		ereport(io->elevel,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("compressed file \"%s\" is truncated", io->srcpath)));
+	else
+		ok = true;
+	goto done;
+
+lz4_error:
+	ereport(io->elevel,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("could not decompress file \"%s\": %s",
+					io->srcpath, LZ4F_getErrorName(ret))));
+
+done:
+	LZ4F_freeDecompressionContext(dctx);
+	pfree(inbuf);
+	pfree(outbuf);
+
+	return ok;
+}
+#endif							/* USE_LZ4 */
+
+#ifdef USE_ZSTD
+static bool
+XLogCompressFileZstd(XLogCompressIO *io)
+{
+	ZSTD_CCtx  *cctx;
+	char	   *inbuf;
+	char	   *outbuf;
+	size_t		outbufsize;
+	size_t		ret;
+	int			nread;
+	bool		ok = false;
+
+	cctx = ZSTD_createCCtx();
+	if (cctx == NULL)
+	{
+		ereport(io->elevel,
+				(errmsg("could not create zstd compression context")));
+		return false;
+	}
+	(void) ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+	inbuf = palloc(XLOG_COMPRESS_CHUNK_SIZE);
+	outbufsize = ZSTD_CStreamOutSize();
+	outbuf = palloc(outbufsize);
+
+	do
+	{
+		ZSTD_inBuffer in;
+		ZSTD_EndDirective mode;
+		bool		finished;
+
+		nread = XLogCompressRead(io, inbuf);
+		if (nread < 0)
+			goto done;
+
+		in.src = inbuf;
+		in.size = nread;
+		in.pos = 0;
+		mode = (nread == 0) ? ZSTD_e_end : ZSTD_e_continue;
+
+		do
+		{
+			ZSTD_outBuffer out = {outbuf, outbufsize, 0};
+
+			ret = ZSTD_compressStream2(cctx, &out, &in, mode);
+			if (ZSTD_isError(ret))
+			{
+				ereport(io->elevel,
+						(errmsg("could not compress file \"%s\": %s",
+								io->srcpath, ZSTD_getErrorName(ret))));
+				goto done;
+			}
+			if (!XLogCompressWrite(io, outbuf, out.pos))
+				goto done;
+
+			/* when ending the frame, ret is the amount left to flush */
+			finished = (mode == ZSTD_e_end) ? (ret == 0) : (in.pos == in.size);
+		} while (!finished);
+	} while (nread > 0);
+
+	ok = true;
+
+done:
+	ZSTD_freeCCtx(cctx);
+	pfree(inbuf);
+	pfree(outbuf);
+
+	return ok;
+}
+
+static bool
+XLogDecompressFileZstd(XLogCompressIO *io)
+{
+	ZSTD_DCtx  *dctx;
+	char	   *inbuf;
+	char	   *outbuf;
+	size_t		outbufsize;
+	size_t		ret = 1;
+	int			nread;
+	bool		ok = false;
+
+	dctx = ZSTD_createDCtx();
+	if (dctx == NULL)
+	{
+		ereport(io->elevel,
+				(errmsg("could not create zstd decompression context")));
+		return false;
+	}
+
+	inbuf = palloc(XLOG_COMPRESS_CHUNK_SIZE);
+	outbufsize = ZSTD_DStreamOutSize();
+	outbuf = palloc(outbufsize);
+
+	while ((nread = XLogCompressRead(io, inbuf)) > 0)
+	{
+		ZSTD_inBuffer in = {inbuf, nread, 0};
+		ZSTD_outBuffer out;
+
+		/* keep going while there's input, or the output might be pending */
+		do
+		{
+			out.dst = outbuf;
+			out.size = outbufsize;
+			out.pos = 0;
+
+			ret = ZSTD_decompressStream(dctx, &out, &in);
+			if (ZSTD_isError(ret))
+			{
+				ereport(io->elevel,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not decompress file \"%s\": %s",
+								io->srcpath, ZSTD_getErrorName(ret))));
+				goto done;
+			}
+			if (!XLogCompressWrite(io, outbuf, out.pos))
+				goto done;
+		} while (in.pos < in.size || out.pos == out.size);
+	}
+	if (nread < 0)
+		goto done;
+
+	/* zero means that a frame was completely decoded and flushed */
+	if (ret != 0)
+		ereport(io->elevel,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("compressed file \"%s\" is truncated", io->srcpath)));
+	else
+		ok = true;
+
+done:
+	ZSTD_freeDCtx(dctx);
+	pfree(inbuf);
+	pfree(outbuf);
+
+	return ok;
+}
+#endif							/* USE_ZSTD */
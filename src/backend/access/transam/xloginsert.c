@@ -36,6 +36,7 @@
 #include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "pgstat.h"
 #include "replication/origin.h"
 #include "storage/bufmgr.h"
 #include "storage/proc.h"
@@ -71,8 +72,10 @@ typedef struct
 	bool		in_use;			/* is this slot in use? */
 	uint8		flags;			/* REGBUF_* flags */
 	RelFileLocator rlocator;	/* identifies the relation and block */
+	BlockNumber block;			/* must directly follow rlocator, see below */
 	ForkNumber	forkno;
-	BlockNumber block;
+	uint8		fork_flags;		/* template of the block header's
+								 * fork_flags, see XLogRecordAssemble() */
 	Page		page;			/* page content */
 	uint32		rdata_len;		/* total length of data in rdata chain */
 	XLogRecData *rdata_head;	/* head of the chain of data registered with
@@ -87,6 +90,15 @@ typedef struct
 	char		compressed_page[COMPRESS_BUFSIZE];
 } registered_buffer;
 
+/*
+ * A block reference header ends with the RelFileLocator, unless it's the same
+ * as the previous block's, and the block number.  Those are laid out next to
+ * each other in registered_buffer, so that they can be copied in one go.
+ */
+StaticAssertDecl(offsetof(registered_buffer, block) ==
+				 offsetof(registered_buffer, rlocator) + sizeof(RelFileLocator),
+				 "block must directly follow rlocator in registered_buffer");
+
 static registered_buffer *registered_buffers;
 static int	max_registered_buffers; /* allocated size */
 static int	max_registered_block_id = 0;	/* highest block_id + 1 currently
@@ -260,6 +272,9 @@ XLogRegisterBuffer(uint8 block_id, Buffer buffer, uint8 flags)
 	BufferGetTag(buffer, &regbuf->rlocator, &regbuf->forkno, &regbuf->block);
 	regbuf->page = BufferGetPage(buffer);
 	regbuf->flags = flags;
+	regbuf->fork_flags = regbuf->forkno;
+	if ((flags & REGBUF_WILL_INIT) == REGBUF_WILL_INIT)
+		regbuf->fork_flags |= BKPBLOCK_WILL_INIT;
 	regbuf->rdata_tail = (XLogRecData *) &regbuf->rdata_head;
 	regbuf->rdata_len = 0;
 
@@ -313,6 +328,9 @@ XLogRegisterBlock(uint8 block_id, RelFileLocator *rlocator, ForkNumber forknum,
 	regbuf->block = blknum;
 	regbuf->page = page;
 	regbuf->flags = flags;
+	regbuf->fork_flags = regbuf->forkno;
+	if ((flags & REGBUF_WILL_INIT) == REGBUF_WILL_INIT)
+		regbuf->fork_flags |= BKPBLOCK_WILL_INIT;
 	regbuf->rdata_tail = (XLogRecData *) &regbuf->rdata_head;
 	regbuf->rdata_len = 0;
 
@@ -461,6 +479,8 @@ XLogRecPtr
 XLogInsert(RmgrId rmid, uint8 info) 
 {
 	XLogRecPtr	EndPos;
+	XLogRecData *rdt;
+	int			num_fpi;
 
 	/* XLogBeginInsert() must have been called. */
 	if (!begininsert_called)
@@ -494,8 +514,8 @@ XLogInsert(RmgrId rmid, uint8 info)
 		bool		doPageWrites;
 		bool		topxid_included = false;
 		XLogRecPtr	fpw_lsn;
-		XLogRecData *rdt;
-		int			num_fpi = 0;
+
+		num_fpi = 0;
 
 		/*
 		 * Get values needed to decide whether to do full-page writes. Since
@@ -511,6 +531,18 @@ XLogInsert(RmgrId rmid, uint8 info)
 								  topxid_included);
 	} while (EndPos == InvalidXLogRecPtr);
 
+	/* Charge the record to the relation of its first block reference */
+	for (int block_id = 0; block_id < max_registered_block_id; block_id++)
+	{
+		if (registered_buffers[block_id].in_use)
+		{
+			pgstat_count_wal_relation(&registered_buffers[block_id].rlocator,
+									  ((XLogRecord *) rdt->data)->xl_tot_len,
+									  num_fpi);
+			break;
+		}
+	}
+
 	XLogResetInsertion();
 
 	return EndPos;
@@ -620,13 +652,11 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 		else
 			needs_data = !needs_backup;
 
+		/* start from the header template built at registration */
 		bkpb.id = block_id;
-		bkpb.fork_flags = regbuf->forkno;
+		bkpb.fork_flags = regbuf->fork_flags;
 		bkpb.data_length = 0;
 
-		if ((regbuf->flags & REGBUF_WILL_INIT) == REGBUF_WILL_INIT)
-			bkpb.fork_flags |= BKPBLOCK_WILL_INIT;
-
 		/*
 		 * If needs_backup is true or WAL checking is enabled for current
 		 * resource manager, log a full-page write for the current block.
@@ -817,11 +847,15 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 		}
 		if (!samerel)
 		{
-			memcpy(scratch, &regbuf->rlocator, sizeof(RelFileLocator));
-			scratch += sizeof(RelFileLocator);
+			memcpy(scratch, &regbuf->rlocator,
+				   sizeof(RelFileLocator) + sizeof(BlockNumber));
+			scratch += sizeof(RelFileLocator) + sizeof(BlockNumber);
+		}
+		else
+		{
+			memcpy(scratch, &regbuf->block, sizeof(BlockNumber));
+			scratch += sizeof(BlockNumber);
 		}
-		memcpy(scratch, &regbuf->block, sizeof(BlockNumber));
-		scratch += sizeof(BlockNumber);
 	}
 
 	/* followed by the record's origin, if any */
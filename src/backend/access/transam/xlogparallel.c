@@ -0,0 +1,727 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.c
+ *		Parallel WAL redo.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogparallel.c
+ *
+ * With recovery_parallel_workers > 0, the startup process hands records
+ * that only modify a single data block over to a set of parallel redo
+ * workers, instead of replaying them itself.  The startup process keeps
+ * reading and decoding the WAL, and doing all the bookkeeping of
+ * ApplyWalRecord(); only the rm_redo call moves to the worker.  All records
+ * for the same block go to the same worker, through a shm_mq, so they are
+ * still replayed in WAL order.  Records for different blocks are replayed
+ * in whatever order the workers get to them.
+ *
+ * That's only safe for records whose redo affects nothing but their block.
+ * Everything else -- transaction commits, relation map and database
+ * changes, standby locks, checkpoints, records touching several blocks --
+ * is replayed by the startup process itself, after waiting for the workers
+ * to finish everything handed to them so far (a "barrier").  As commit
+ * records are never replayed before the changes preceding them, hot
+ * standby queries can't see the difference.  Records that need a cleanup
+ * lock or may cause recovery conflicts (pruning, vacuuming, freezing, index
+ * deletion) stay serial as well, since conflict resolution is tied to the
+ * startup process.  Currently, only the most common heap and B-tree records
+ * are eligible.
+ *
+ * Parallel redo is only used once recovery has reached a consistent state.
+ * Before that, the startup process has to keep track of references to
+ * missing pages on its own, see log_invalid_page().  This means that crash
+ * recovery is always serial; the intended users are standbys, which spend
+ * most of their life replaying WAL in a consistent state.
+ *
+ * The workers behave like the startup process when replaying, with a few
+ * exceptions for things it can only do because it is alone (see
+ * InParallelRedoWorker): relation sizes are not cached, as another worker
+ * may extend a relation at any time, extending a relation takes an LWLock
+ * shared by the workers, and minRecoveryPoint is updated like in any other
+ * process.  Conversely, the startup process forgets the cached sizes of the
+ * relations the workers touched at each barrier, and asks the workers to
+ * close their files before replaying records that may unlink or truncate
+ * relation files.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/heapam_xlog.h"
+#include "access/nbtxlog.h"
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
+#include "access/xlogrecovery.h"
+#include "access/xlogutils.h"
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/condition_variable.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/smgr.h"
+#include "tcop/tcopprot.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+/* size of the queue of each worker */
+#define PARALLEL_REDO_QUEUE_SIZE	(1024 * 1024)
+
+/* GUCs */
+int			recovery_parallel_workers = 0;
+
+/* State shared between the startup process and the workers */
+typedef struct ParallelRedoShared
+{
+	int			nworkers;
+	LWLock		extension_lock; /* held while extending a relation fork */
+	ConditionVariable idle_cv;	/* broadcast by workers running out of work */
+	/* number of messages each worker has processed */
+	pg_atomic_uint64 applied[FLEXIBLE_ARRAY_MEMBER];
+} ParallelRedoShared;
+
+/* the queues follow the ParallelRedoShared struct */
+#define PARALLEL_REDO_QUEUE_OFFSET(nworkers) \
+	MAXALIGN(offsetof(ParallelRedoShared, applied) + \
+			 (nworkers) * sizeof(pg_atomic_uint64))
+
+typedef enum ParallelRedoMsgKind
+{
+	PARALLEL_REDO_APPLY,		/* replay the record that follows */
+	PARALLEL_REDO_RELEASE_SMGR	/* close all relation files */
+} ParallelRedoMsgKind;
+
+/*
+ * Messages consist of this header, followed by the DecodedXLogRecord for
+ * PARALLEL_REDO_APPLY.  That is copied as is, so the worker has to adjust
+ * the pointers into it, using the address it had in the startup process.
+ */
+typedef struct ParallelRedoMsgHeader
+{
+	ParallelRedoMsgKind kind;
+	XLogRecPtr	ReadRecPtr;
+	XLogRecPtr	EndRecPtr;
+	DecodedXLogRecord *base;
+} ParallelRedoMsgHeader;
+
+/* Private state of the startup process */
+typedef struct ParallelRedoState
+{
+	dsm_segment *seg;
+	ParallelRedoShared *shared;
+	int			nworkers;
+	BackgroundWorkerHandle **handles;
+	shm_mq_handle **queues;
+	uint64	   *dispatched;		/* number of messages sent to each worker */
+	bool		pending;		/* anything dispatched since the last barrier? */
+	bool		files_open;		/* any record dispatched since the last
+								 * PARALLEL_REDO_RELEASE_SMGR? */
+	HTAB	   *touched;		/* relations touched since the last barrier */
+} ParallelRedoState;
+
+static ParallelRedoState *redo = NULL;
+
+/* set if starting the workers failed; don't try again */
+static bool parallel_redo_disabled = false;
+
+/* in a worker: the shared state */
+static ParallelRedoShared *worker_shared = NULL;
+
+static bool ParallelRedoStart(void);
+static bool ParallelRedoIsEligible(XLogReaderState *record);
+static bool ParallelRedoNeedsRelease(XLogReaderState *record);
+static void ParallelRedoSend(int worker, ParallelRedoMsgKind kind,
+							 XLogReaderState *record);
+static void ParallelRedoCheckWorker(int worker);
+static void ParallelRedoApply(XLogReaderState *reader, void *data, Size nbytes);
+static void parallel_redo_error_callback(void *arg);
+
+static inline shm_mq *
+ParallelRedoQueue(ParallelRedoShared *shared, int worker)
+{
+	return (shm_mq *) ((char *) shared +
+					   PARALLEL_REDO_QUEUE_OFFSET(shared->nworkers) +
+					   (Size) worker * PARALLEL_REDO_QUEUE_SIZE);
+}
+
+/*
+ * XLogParallelRedoDispatch
+ *		Hand a record over to a parallel redo worker, if possible
+ *
+ * Called from ApplyWalRecord() in place of the record's rm_redo function.
+ * Returns true if a worker is going to replay the record.  Otherwise, the
+ * workers have caught up with everything dispatched before, and the caller
+ * must replay the record itself.
+ *
+ * The caller must have published the end of the record as the current
+ * replay position already, so that flushing a page the worker changed
+ * never pushes minRecoveryPoint past GetCurrentReplayRecPtr().
+ */
+bool
+XLogParallelRedoDispatch(XLogReaderState *record)
+{
+	RelFileLocator rlocator;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+	int			worker;
+
+	if (recovery_parallel_workers == 0 || !reachedConsistency ||
+		parallel_redo_disabled)
+		return false;
+
+	if (!ParallelRedoIsEligible(record))
+	{
+		if (redo != NULL)
+		{
+			if (redo->files_open && ParallelRedoNeedsRelease(record))
+			{
+				for (int i = 0; i < redo->nworkers; i++)
+					ParallelRedoSend(i, PARALLEL_REDO_RELEASE_SMGR, NULL);
+				redo->files_open = false;
+			}
+			XLogParallelRedoBarrier();
+		}
+		return false;
+	}
+
+	if (redo == NULL && !ParallelRedoStart())
+		return false;
+
+	Assert(GetCurrentReplayRecPtr(NULL) >= record->EndRecPtr);
+
+	/* route by block, so that all changes to a block are replayed in order */
+	XLogRecGetBlockTag(record, 0, &rlocator, &forknum, &blkno);
+	worker = hash_combine(hash_bytes((const unsigned char *) &rlocator,
+									 sizeof(RelFileLocator)),
+						  murmurhash32(blkno)) % redo->nworkers;
+
+	/* remember to forget our cached size of the relation at the barrier */
+	(void) hash_search(redo->touched, &rlocator, HASH_ENTER, NULL);
+
+	ParallelRedoSend(worker, PARALLEL_REDO_APPLY, record);
+	redo->files_open = true;
+
+	return true;
+}
+
+/*
+ * XLogParallelRedoBarrier
+ *		Wait for the parallel redo workers to replay everything sent to them
+ *
+ * After this, the startup process can replay records itself.
+ */
+void
+XLogParallelRedoBarrier(void)
+{
+	HASH_SEQ_STATUS status;
+	RelFileLocator *rlocator;
+
+	if (redo == NULL || !redo->pending)
+		return;
+
+	for (int i = 0; i < redo->nworkers; i++)
+	{
+		if (pg_atomic_read_u64(&redo->shared->applied[i]) >= redo->dispatched[i])
+			continue;
+
+		ConditionVariablePrepareToSleep(&redo->shared->idle_cv);
+		while (pg_atomic_read_u64(&redo->shared->applied[i]) < redo->dispatched[i])
+		{
+			HandleStartupProcInterrupts();
+			ParallelRedoCheckWorker(i);
+			(void) ConditionVariableTimedSleep(&redo->shared->idle_cv, 1000,
+											   WAIT_EVENT_PARALLEL_REDO_BARRIER);
+		}
+		ConditionVariableCancelSleep();
+	}
+
+	/*
+	 * The workers may have extended the relations they touched, which would
+	 * make our cached sizes stale.
+	 */
+	hash_seq_init(&status, redo->touched);
+	while ((rlocator = (RelFileLocator *) hash_seq_search(&status)) != NULL)
+	{
+		smgrforgetnblocks(smgropen(*rlocator, InvalidBackendId));
+		(void) hash_search(redo->touched, rlocator, HASH_REMOVE, NULL);
+	}
+
+	redo->pending = false;
+}
+
+/*
+ * XLogParallelRedoShutdown
+ *		Wait for the parallel redo workers to finish, and stop them
+ *
+ * Called at the end of redo.
+ */
+void
+XLogParallelRedoShutdown(void)
+{
+	if (redo == NULL)
+		return;
+
+	XLogParallelRedoBarrier();
+
+	/* the workers exit when they see their queue detached */
+	for (int i = 0; i < redo->nworkers; i++)
+		shm_mq_detach(redo->queues[i]);
+	for (int i = 0; i < redo->nworkers; i++)
+		(void) WaitForBackgroundWorkerShutdown(redo->handles[i]);
+
+	dsm_detach(redo->seg);
+	hash_destroy(redo->touched);
+	pfree(redo->handles);
+	pfree(redo->queues);
+	pfree(redo->dispatched);
+	pfree(redo);
+	redo = NULL;
+}
+
+/*
+ * Set up the shared memory and start the workers.  On failure, log the
+ * reason and return false; we'll stay with serial redo then.
+ */
+static bool
+ParallelRedoStart(void)
+{
+	int			nworkers = recovery_parallel_workers;
+	Size		segsize;
+	dsm_segment *seg;
+	ParallelRedoShared *shared;
+	BackgroundWorker worker;
+	dsm_handle	handle;
+	HASHCTL		ctl;
+	MemoryContext oldcontext;
+	int			nstarted;
+	bool		failed = false;
+
+	Assert(redo == NULL);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	segsize = add_size(PARALLEL_REDO_QUEUE_OFFSET(nworkers),
+					   mul_size(nworkers, PARALLEL_REDO_QUEUE_SIZE));
+	seg = dsm_create(segsize, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+	{
+		ereport(LOG,
+				(errmsg("could not start parallel redo workers: out of dynamic shared memory segments")));
+		parallel_redo_disabled = true;
+		MemoryContextSwitchTo(oldcontext);
+		return false;
+	}
+	dsm_pin_mapping(seg);
+
+	shared = (ParallelRedoShared *) dsm_segment_address(seg);
+	shared->nworkers = nworkers;
+	LWLockInitialize(&shared->extension_lock, LWTRANCHE_PARALLEL_REDO_EXTENSION);
+	ConditionVariableInit(&shared->idle_cv);
+
+	redo = palloc0(sizeof(ParallelRedoState));
+	redo->seg = seg;
+	redo->shared = shared;
+	redo->handles = palloc0(sizeof(BackgroundWorkerHandle *) * nworkers);
+	redo->queues = palloc0(sizeof(shm_mq_handle *) * nworkers);
+	redo->dispatched = palloc0(sizeof(uint64) * nworkers);
+
+	ctl.keysize = sizeof(RelFileLocator);
+	ctl.entrysize = sizeof(RelFileLocator);
+	redo->touched = hash_create("parallel redo touched relations", 64, &ctl,
+								HASH_ELEM | HASH_BLOBS);
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	sprintf(worker.bgw_library_name, "postgres");
+	sprintf(worker.bgw_function_name, "ParallelRedoWorkerMain");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "parallel redo worker");
+	worker.bgw_notify_pid = MyProcPid;
+	handle = dsm_segment_handle(seg);
+	memcpy(worker.bgw_extra, &handle, sizeof(dsm_handle));
+
+	for (nstarted = 0; nstarted < nworkers; nstarted++)
+	{
+		shm_mq	   *mq;
+		pid_t		pid;
+
+		pg_atomic_init_u64(&shared->applied[nstarted], 0);
+		mq = shm_mq_create(ParallelRedoQueue(shared, nstarted),
+						   PARALLEL_REDO_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+
+		snprintf(worker.bgw_name, BGW_MAXLEN, "parallel redo worker %d",
+				 nstarted);
+		worker.bgw_main_arg = Int32GetDatum(nstarted);
+		if (!RegisterDynamicBackgroundWorker(&worker, &redo->handles[nstarted]))
+			break;
+		redo->queues[nstarted] = shm_mq_attach(mq, seg, redo->handles[nstarted]);
+
+		if (WaitForBackgroundWorkerStartup(redo->handles[nstarted], &pid) !=
+			BGWH_STARTED)
+		{
+			failed = true;
+			nstarted++;
+			break;
+		}
+	}
+	redo->nworkers = nstarted;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (failed || nstarted == 0)
+	{
+		ereport(LOG,
+				(errmsg("could not start parallel redo workers, continuing with serial redo"),
+				 nstarted == 0 ?
+				 errhint("You might need to increase max_worker_processes.") : 0));
+		XLogParallelRedoShutdown();
+		parallel_redo_disabled = true;
+		return false;
+	}
+
+	if (nstarted < nworkers)
+		ereport(LOG,
+				(errmsg("started only %d of %d parallel redo workers",
+						nstarted, nworkers),
+				 errhint("You might need to increase max_worker_processes.")));
+	else
+		ereport(LOG,
+				(errmsg("started %d parallel redo workers", nstarted)));
+
+	return true;
+}
+
+/*
+ * Can the record be replayed by a parallel redo worker?
+ *
+ * It must modify exactly one block and nothing else, and must not be
+ * subject to wal_consistency_checking, which is done by the startup
+ * process right after replay.
+ */
+static bool
+ParallelRedoIsEligible(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record);
+
+	if (XLogRecMaxBlockId(record) != 0 || !XLogRecHasBlockRef(record, 0) ||
+		(info & XLR_CHECK_CONSISTENCY) != 0)
+		return false;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+				case XLOG_HEAP_DELETE:
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+				case XLOG_HEAP_LOCK:
+				case XLOG_HEAP_INPLACE:
+				case XLOG_HEAP_CONFIRM:
+					return true;
+			}
+			break;
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_MULTI_INSERT:
+				case XLOG_HEAP2_LOCK_UPDATED:
+					return true;
+			}
+			break;
+		case RM_BTREE_ID:
+			switch (info & ~XLR_INFO_MASK)
+			{
+				case XLOG_BTREE_INSERT_LEAF:
+				case XLOG_BTREE_INSERT_POST:
+				case XLOG_BTREE_DEDUP:
+					return true;
+			}
+			break;
+	}
+
+	return false;
+}
+
+/*
+ * Can replaying the record unlink or truncate relation files?  If so, the
+ * workers must close the files first, or they could keep writing to
+ * unlinked files later.
+ */
+static bool
+ParallelRedoNeedsRelease(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record);
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_SMGR_ID:
+		case RM_DBASE_ID:
+		case RM_TBLSPC_ID:
+			return true;
+		case RM_XACT_ID:
+			switch (info & XLOG_XACT_OPMASK)
+			{
+				case XLOG_XACT_COMMIT:
+				case XLOG_XACT_COMMIT_PREPARED:
+					{
+						xl_xact_parsed_commit parsed;
+
+						ParseCommitRecord(info,
+										  (xl_xact_commit *) XLogRecGetData(record),
+										  &parsed);
+						return parsed.nrels > 0;
+					}
+				case XLOG_XACT_ABORT:
+				case XLOG_XACT_ABORT_PREPARED:
+					{
+						xl_xact_parsed_abort parsed;
+
+						ParseAbortRecord(info,
+										 (xl_xact_abort *) XLogRecGetData(record),
+										 &parsed);
+						return parsed.nrels > 0;
+					}
+			}
+			break;
+	}
+
+	return false;
+}
+
+/*
+ * Send a message to a worker.  This waits if its queue is full.
+ */
+static void
+ParallelRedoSend(int worker, ParallelRedoMsgKind kind, XLogReaderState *record)
+{
+	ParallelRedoMsgHeader hdr;
+	shm_mq_iovec iov[2];
+	int			iovcnt = 1;
+	shm_mq_result res;
+
+	hdr.kind = kind;
+	hdr.ReadRecPtr = InvalidXLogRecPtr;
+	hdr.EndRecPtr = InvalidXLogRecPtr;
+	hdr.base = NULL;
+	if (record != NULL)
+	{
+		hdr.ReadRecPtr = record->ReadRecPtr;
+		hdr.EndRecPtr = record->EndRecPtr;
+		hdr.base = record->record;
+		iov[1].data = (const char *) record->record;
+		iov[1].len = record->record->size;
+		iovcnt = 2;
+	}
+	iov[0].data = (const char *) &hdr;
+	iov[0].len = sizeof(hdr);
+
+	res = shm_mq_sendv(redo->queues[worker], iov, iovcnt, false, true);
+	if (res != SHM_MQ_SUCCESS)
+		ereport(FATAL,
+				(errmsg("parallel redo worker %d exited unexpectedly", worker)));
+
+	redo->dispatched[worker]++;
+	redo->pending = true;
+}
+
+/*
+ * Error out if the worker is gone, it won't make any more progress then.
+ */
+static void
+ParallelRedoCheckWorker(int worker)
+{
+	pid_t		pid;
+
+	if (GetBackgroundWorkerPid(redo->handles[worker], &pid) == BGWH_STOPPED)
+		ereport(FATAL,
+				(errmsg("parallel redo worker %d exited unexpectedly", worker)));
+}
+
+/*
+ * Extending a relation fork during recovery needs no lock in the startup
+ * process, but parallel redo workers may try to extend the same fork at the
+ * same time.
+ */
+void
+XLogParallelRedoLockExtension(void)
+{
+	Assert(InParallelRedoWorker);
+	LWLockAcquire(&worker_shared->extension_lock, LW_EXCLUSIVE);
+}
+
+void
+XLogParallelRedoUnlockExtension(void)
+{
+	Assert(InParallelRedoWorker);
+	LWLockRelease(&worker_shared->extension_lock);
+}
+
+/*
+ * Main entry point of a parallel redo worker
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			worker = DatumGetInt32(main_arg);
+	dsm_handle	handle;
+	dsm_segment *seg;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+	ErrorContextCallback errcallback;
+	uint64		napplied = 0;
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "parallel redo worker");
+
+	memcpy(&handle, MyBgworkerEntry->bgw_extra, sizeof(dsm_handle));
+	seg = dsm_attach(handle);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	worker_shared = (ParallelRedoShared *) dsm_segment_address(seg);
+
+	mq = ParallelRedoQueue(worker_shared, worker);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/*
+	 * Replay like the startup process does, once it's consistent.  We can't
+	 * get here before that, see XLogParallelRedoDispatch().
+	 */
+	InRecovery = true;
+	InParallelRedoWorker = true;
+	reachedConsistency = true;
+
+	RmgrStartup();
+
+	reader = palloc0(sizeof(XLogReaderState));
+	reader->errormsg_buf = palloc0(MAX_ERRORMSG_LEN + 1);
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "parallel redo",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	errcallback.callback = parallel_redo_error_callback;
+	errcallback.arg = (void *) reader;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	for (;;)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+
+		res = shm_mq_receive(mqh, &nbytes, &data, true);
+		if (res == SHM_MQ_WOULD_BLOCK)
+		{
+			/* out of work; the startup process may be waiting for that */
+			ConditionVariableBroadcast(&worker_shared->idle_cv);
+			res = shm_mq_receive(mqh, &nbytes, &data, false);
+		}
+		if (res == SHM_MQ_DETACHED)
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextSwitchTo(redo_context);
+		ParallelRedoApply(reader, data, nbytes);
+		MemoryContextSwitchTo(TopMemoryContext);
+		MemoryContextReset(redo_context);
+
+		pg_atomic_write_u64(&worker_shared->applied[worker], ++napplied);
+	}
+
+	error_context_stack = errcallback.previous;
+
+	RmgrCleanup();
+}
+
+/*
+ * Process one message received by a worker
+ */
+static void
+ParallelRedoApply(XLogReaderState *reader, void *data, Size nbytes)
+{
+	ParallelRedoMsgHeader hdr;
+	DecodedXLogRecord *decoded;
+	char	   *oldbase;
+	char	   *newbase;
+
+	Assert(nbytes >= sizeof(hdr));
+	memcpy(&hdr, data, sizeof(hdr));
+
+	if (hdr.kind == PARALLEL_REDO_RELEASE_SMGR)
+	{
+		smgrreleaseall();
+		return;
+	}
+
+	/* copy the record, it may not even be aligned in the queue */
+	decoded = (DecodedXLogRecord *) palloc(nbytes - sizeof(hdr));
+	memcpy(decoded, (char *) data + sizeof(hdr), nbytes - sizeof(hdr));
+	Assert(decoded->size == nbytes - sizeof(hdr));
+
+	/* make the pointers into the record point into our copy */
+	oldbase = (char *) hdr.base;
+	newbase = (char *) decoded;
+	decoded->next = NULL;
+	if (decoded->main_data != NULL)
+		decoded->main_data = newbase + (decoded->main_data - oldbase);
+	for (int block_id = 0; block_id <= decoded->max_block_id; block_id++)
+	{
+		DecodedBkpBlock *blk = &decoded->blocks[block_id];
+
+		if (blk->bkp_image != NULL)
+			blk->bkp_image = newbase + (blk->bkp_image - oldbase);
+		if (blk->data != NULL)
+			blk->data = newbase + (blk->data - oldbase);
+	}
+
+	reader->record = decoded;
+	reader->ReadRecPtr = hdr.ReadRecPtr;
+	reader->EndRecPtr = hdr.EndRecPtr;
+
+	GetRmgr(decoded->header.xl_rmid).rm_redo(reader);
+
+	reader->record = NULL;
+}
+
+/*
+ * Error context callback for errors occurring during parallel redo
+ */
+static void
+parallel_redo_error_callback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+
+	if (record->record == NULL)
+		return;
+
+	errcontext("WAL redo at %X/%X for %s in parallel redo worker",
+			   LSN_FORMAT_ARGS(record->ReadRecPtr),
+			   GetRmgr(XLogRecGetRmid(record)).rm_name);
+}
@@ -18,6 +18,12 @@
  * recorded in the decoded record so that XLogReadBufferForRedo() can try to
  * avoid a second buffer mapping table lookup.
  *
+ * Blocks referenced more than once within the window of records decoded but
+ * not yet replayed are only looked at the first time; later references get
+ * the same buffer hint.  Cache misses on adjacent blocks of a relation are
+ * collected into runs, so that the kernel is asked to read each run with a
+ * single call.
+ *
  * Currently, only the main fork is considered for prefetching.  Currently,
  * prefetching is only effective on systems where PrefetchBuffer() does
  * something useful (mainly Linux).
@@ -53,12 +59,6 @@
  */
 #define XLOGPREFETCHER_STATS_DISTANCE BLCKSZ
 
-/*
- * To detect repeated access to the same block and skip useless extra system
- * calls, we remember a small window of recently prefetched blocks.
- */
-#define XLOGPREFETCHER_SEQ_WINDOW_SIZE 4
-
 /*
  * When maintenance_io_concurrency is not saturated, we're prepared to look
  * ahead up to N times that number of block references.
@@ -139,10 +139,14 @@ struct XLogPrefetcher
 	HTAB	   *filter_table;
 	dlist_head	filter_queue;
 
-	/* Book-keeping to avoid repeat prefetches. */
-	RelFileLocator recent_rlocator[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
-	BlockNumber recent_block[XLOGPREFETCHER_SEQ_WINDOW_SIZE];
-	int			recent_idx;
+	/* Book-keeping to avoid repeat prefetches within the decode window. */
+	HTAB	   *recent_table;
+	dlist_head	recent_queue;
+
+	/* Run of adjacent blocks not yet handed to smgrprefetch(). */
+	RelFileLocator run_rlocator;
+	BlockNumber run_blkno;
+	int			run_nblocks;
 
 	/* Book-keeping to disable prefetching temporarily. */
 	XLogRecPtr	no_readahead_until;
@@ -169,6 +173,23 @@ typedef struct XLogPrefetcherFilter
 	dlist_node	link;
 } XLogPrefetcherFilter;
 
+/*
+ * A main fork block referenced by a WAL record that hasn't been replayed yet.
+ */
+typedef struct XLogPrefetcherRecentKey
+{
+	RelFileLocator rlocator;
+	BlockNumber blkno;
+} XLogPrefetcherRecentKey;
+
+typedef struct XLogPrefetcherRecent
+{
+	XLogPrefetcherRecentKey key;	/* hash key, must be first */
+	Buffer		recent_buffer;	/* where we found it, or InvalidBuffer */
+	XLogRecPtr	last_lsn;		/* last record referencing it */
+	dlist_node	link;
+} XLogPrefetcherRecent;
+
 /*
  * Counters exposed in shared memory for pg_stat_recovery_prefetch.
  */
@@ -197,6 +218,12 @@ static inline bool XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher,
 											BlockNumber blockno);
 static inline void XLogPrefetcherCompleteFilters(XLogPrefetcher *prefetcher,
 												 XLogRecPtr replaying_lsn);
+static inline void XLogPrefetcherCompleteRecent(XLogPrefetcher *prefetcher,
+												XLogRecPtr replaying_lsn);
+static void XLogPrefetcherResetRecent(XLogPrefetcher *prefetcher);
+static void XLogPrefetcherAddToRun(XLogPrefetcher *prefetcher,
+								   RelFileLocator rlocator, BlockNumber blkno);
+static void XLogPrefetcherFlushRun(XLogPrefetcher *prefetcher);
 static LsnReadQueueNextStatus XLogPrefetcherNextBlock(uintptr_t pgsr_private,
 													  XLogRecPtr *lsn);
 
@@ -370,6 +397,10 @@ XLogPrefetcherAllocate(XLogReaderState *reader)
 		.keysize = sizeof(RelFileLocator),
 		.entrysize = sizeof(XLogPrefetcherFilter)
 	};
+	static HASHCTL recent_table_ctl = {
+		.keysize = sizeof(XLogPrefetcherRecentKey),
+		.entrysize = sizeof(XLogPrefetcherRecent)
+	};
 
 	prefetcher = palloc0(sizeof(XLogPrefetcher));
 
@@ -378,6 +409,10 @@ XLogPrefetcherAllocate(XLogReaderState *reader)
 										   &hash_table_ctl,
 										   HASH_ELEM | HASH_BLOBS);
 	dlist_init(&prefetcher->filter_queue);
+	prefetcher->recent_table = hash_create("XLogPrefetcherRecentTable", 1024,
+										   &recent_table_ctl,
+										   HASH_ELEM | HASH_BLOBS);
+	dlist_init(&prefetcher->recent_queue);
 
 	SharedStats->wal_distance = 0;
 	SharedStats->block_distance = 0;
@@ -397,6 +432,7 @@ XLogPrefetcherFree(XLogPrefetcher *prefetcher)
 {
 	lrq_free(prefetcher->streaming_read);
 	hash_destroy(prefetcher->filter_table);
+	hash_destroy(prefetcher->recent_table);
 	pfree(prefetcher);
 }
 
@@ -452,10 +488,11 @@ XLogPrefetcherComputeStats(XLogPrefetcher *prefetcher)
  * Returns LRQ_NEXT_AGAIN if no more WAL data is available yet.
  *
  * Returns LRQ_NEXT_IO if the next block reference is for a main fork block
- * that isn't in the buffer pool, and the kernel has been asked to start
- * reading it to make a future read system call faster. An LSN is written to
- * *lsn, and the I/O will be considered to have completed once that LSN is
- * replayed.
+ * that isn't in the buffer pool, and the kernel will be asked to start
+ * reading it to make a future read system call faster.  The request may be
+ * held back to be combined with following adjacent blocks, until
+ * XLogPrefetcherFlushRun().  An LSN is written to *lsn, and the I/O will be
+ * considered to have completed once that LSN is replayed.
  *
  * Returns LRQ_NEXT_NO_IO if we examined the next block reference and found
  * that it was already in the buffer pool, or we decided for various reasons
@@ -652,8 +689,11 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 		{
 			int			block_id = prefetcher->next_block_id++;
 			DecodedBkpBlock *block = &record->blocks[block_id];
+			XLogPrefetcherRecentKey key;
+			XLogPrefetcherRecent *recent;
+			bool		found;
 			SMgrRelation reln;
-			PrefetchBufferResult result;
+			Buffer		recent_buffer;
 
 			if (!block->in_use)
 				continue;
@@ -697,25 +737,29 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 				return LRQ_NEXT_NO_IO;
 			}
 
-			/* There is no point in repeatedly prefetching the same block. */
-			for (int i = 0; i < XLOGPREFETCHER_SEQ_WINDOW_SIZE; ++i)
+			/*
+			 * There is no point in repeatedly prefetching the same block.  If
+			 * an earlier record in the window found it in the buffer pool,
+			 * pass on where it was, so that recovery can skip the buffer
+			 * table lookup this time too.  Either way, extend the entry's
+			 * lifetime to cover this record.
+			 */
+			memset(&key, 0, sizeof(key));
+			key.rlocator = block->rlocator;
+			key.blkno = block->blkno;
+			recent = hash_search(prefetcher->recent_table, &key, HASH_ENTER,
+								 &found);
+			if (found)
+				dlist_delete(&recent->link);
+			recent->last_lsn = record->lsn;
+			dlist_push_head(&prefetcher->recent_queue, &recent->link);
+			if (found)
 			{
-				if (block->blkno == prefetcher->recent_block[i] &&
-					RelFileLocatorEquals(block->rlocator, prefetcher->recent_rlocator[i]))
-				{
-					/*
-					 * XXX If we also remembered where it was, we could set
-					 * recent_buffer so that recovery could skip smgropen()
-					 * and a buffer table lookup.
-					 */
-					XLogPrefetchIncrement(&SharedStats->skip_rep);
-					return LRQ_NEXT_NO_IO;
-				}
+				block->prefetch_buffer = recent->recent_buffer;
+				XLogPrefetchIncrement(&SharedStats->skip_rep);
+				return LRQ_NEXT_NO_IO;
 			}
-			prefetcher->recent_rlocator[prefetcher->recent_idx] = block->rlocator;
-			prefetcher->recent_block[prefetcher->recent_idx] = block->blkno;
-			prefetcher->recent_idx =
-				(prefetcher->recent_idx + 1) % XLOGPREFETCHER_SEQ_WINDOW_SIZE;
+			recent->recent_buffer = InvalidBuffer;
 
 			/*
 			 * We could try to have a fast path for repeated references to the
@@ -769,38 +813,26 @@ XLogPrefetcherNextBlock(uintptr_t pgsr_private, XLogRecPtr *lsn)
 				return LRQ_NEXT_NO_IO;
 			}
 
-			/* Try to initiate prefetching. */
-			result = PrefetchSharedBuffer(reln, block->forknum, block->blkno);
-			if (BufferIsValid(result.recent_buffer))
+			/* Is it in the buffer pool already? */
+			recent_buffer = PeekSharedBuffer(reln, block->forknum,
+											 block->blkno);
+			if (BufferIsValid(recent_buffer))
 			{
 				/* Cache hit, nothing to do. */
 				XLogPrefetchIncrement(&SharedStats->hit);
-				block->prefetch_buffer = result.recent_buffer;
+				recent->recent_buffer = recent_buffer;
+				block->prefetch_buffer = recent_buffer;
 				return LRQ_NEXT_NO_IO;
 			}
-			else if (result.initiated_io)
+			else if ((io_direct_flags & IO_DIRECT_DATA) == 0)
 			{
-				/* Cache miss, I/O (presumably) started. */
+				/* Cache miss, I/O will be started with the current run. */
+				XLogPrefetcherAddToRun(prefetcher, block->rlocator,
+									   block->blkno);
 				XLogPrefetchIncrement(&SharedStats->prefetch);
 				block->prefetch_buffer = InvalidBuffer;
 				return LRQ_NEXT_IO;
 			}
-			else if ((io_direct_flags & IO_DIRECT_DATA) == 0)
-			{
-				/*
-				 * This shouldn't be possible, because we already determined
-				 * that the relation exists on disk and is big enough.
-				 * Something is wrong with the cache invalidation for
-				 * smgrexists(), smgrnblocks(), or the file was unlinked or
-				 * truncated beneath our feet?
-				 */
-				elog(ERROR,
-					 "could not prefetch relation %u/%u/%u block %u",
-					 reln->smgr_rlocator.locator.spcOid,
-					 reln->smgr_rlocator.locator.dbOid,
-					 reln->smgr_rlocator.locator.relNumber,
-					 block->blkno);
-			}
 		}
 
 		/*
@@ -961,6 +993,108 @@ XLogPrefetcherIsFiltered(XLogPrefetcher *prefetcher, RelFileLocator rlocator,
 	return false;
 }
 
+/*
+ * Forget about blocks referenced by records that have now been replayed.
+ * Later references to them will be looked up again.
+ */
+static inline void
+XLogPrefetcherCompleteRecent(XLogPrefetcher *prefetcher, XLogRecPtr replaying_lsn)
+{
+	while (!dlist_is_empty(&prefetcher->recent_queue))
+	{
+		XLogPrefetcherRecent *recent = dlist_tail_element(XLogPrefetcherRecent,
+														  link,
+														  &prefetcher->recent_queue);
+
+		if (recent->last_lsn >= replaying_lsn)
+			break;
+
+		dlist_delete(&recent->link);
+		hash_search(prefetcher->recent_table, recent, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * Forget about all blocks referenced in the window, and any run of blocks not
+ * prefetched yet, as when we start reading WAL at a new position.
+ */
+static void
+XLogPrefetcherResetRecent(XLogPrefetcher *prefetcher)
+{
+	while (!dlist_is_empty(&prefetcher->recent_queue))
+	{
+		XLogPrefetcherRecent *recent = dlist_head_element(XLogPrefetcherRecent,
+														  link,
+														  &prefetcher->recent_queue);
+
+		dlist_delete(&recent->link);
+		hash_search(prefetcher->recent_table, recent, HASH_REMOVE, NULL);
+	}
+
+	prefetcher->run_nblocks = 0;
+}
+
+/*
+ * Add a main fork block to the run of adjacent blocks to be prefetched,
+ * first issuing the current run if this block doesn't extend it.
+ */
+static void
+XLogPrefetcherAddToRun(XLogPrefetcher *prefetcher, RelFileLocator rlocator,
+					   BlockNumber blkno)
+{
+	if (prefetcher->run_nblocks > 0 &&
+		(prefetcher->run_nblocks >= io_combine_limit ||
+		 prefetcher->run_blkno + prefetcher->run_nblocks != blkno ||
+		 !RelFileLocatorEquals(prefetcher->run_rlocator, rlocator)))
+		XLogPrefetcherFlushRun(prefetcher);
+
+	if (prefetcher->run_nblocks == 0)
+	{
+		prefetcher->run_rlocator = rlocator;
+		prefetcher->run_blkno = blkno;
+	}
+	prefetcher->run_nblocks++;
+}
+
+/*
+ * Ask the kernel to start reading the current run of blocks, if any.
+ *
+ * This must be done before any of the records referencing them are
+ * returned for replay.
+ */
+static void
+XLogPrefetcherFlushRun(XLogPrefetcher *prefetcher)
+{
+	SMgrRelation reln;
+
+	if (prefetcher->run_nblocks == 0)
+		return;
+
+	/*
+	 * We already checked that the relation exists on disk and is big enough
+	 * for all these blocks.
+	 */
+	reln = smgropen(prefetcher->run_rlocator, InvalidBackendId);
+	if (!smgrprefetch(reln, MAIN_FORKNUM, prefetcher->run_blkno,
+					  prefetcher->run_nblocks))
+	{
+		/*
+		 * This shouldn't be possible.  Something is wrong with the cache
+		 * invalidation for smgrexists(), smgrnblocks(), or the file was
+		 * unlinked or truncated beneath our feet?
+		 */
+		elog(ERROR,
+			 "could not prefetch relation %u/%u/%u blocks %u..%u",
+			 prefetcher->run_rlocator.spcOid,
+			 prefetcher->run_rlocator.dbOid,
+			 prefetcher->run_rlocator.relNumber,
+			 prefetcher->run_blkno,
+			 prefetcher->run_blkno + prefetcher->run_nblocks - 1);
+	}
+
+	prefetcher->run_nblocks = 0;
+}
+
 /*
  * A wrapper for XLogBeginRead() that also resets the prefetcher.
  */
@@ -1000,6 +1134,7 @@ XLogPrefetcherReadRecord(XLogPrefetcher *prefetcher, char **errmsg)
 
 		if (prefetcher->streaming_read)
 			lrq_free(prefetcher->streaming_read);
+		XLogPrefetcherResetRecent(prefetcher);
 
 		if (RecoveryPrefetchEnabled())
 		{
@@ -1033,6 +1168,7 @@ XLogPrefetcherReadRecord(XLogPrefetcher *prefetcher, char **errmsg)
 	 * range.
 	 */
 	XLogPrefetcherCompleteFilters(prefetcher, replayed_up_to);
+	XLogPrefetcherCompleteRecent(prefetcher, replayed_up_to);
 
 	/*
 	 * All IO initiated by earlier WAL is now completed.  This might trigger
@@ -1051,6 +1187,9 @@ XLogPrefetcherReadRecord(XLogPrefetcher *prefetcher, char **errmsg)
 		lrq_prefetch(prefetcher->streaming_read);
 	}
 
+	/* Start the I/O for blocks still waiting for adjacent ones. */
+	XLogPrefetcherFlushRun(prefetcher);
+
 	/* Read the next record. */
 	record = XLogNextRecord(prefetcher->reader, errmsg);
 	if (!record)
@@ -56,9 +56,6 @@ static void ResetDecoder(XLogReaderState *state);
 static void WALOpenSegmentInit(WALOpenSegment *seg, WALSegmentContext *segcxt,
 							   int segsize, const char *waldir);
 
-/* size of the buffer allocated for error message. */
-#define MAX_ERRORMSG_LEN 1000
-
 /*
  * Default size; large enough that typical users of XLogReader won't often need
  * to use the 'oversized' memory allocation code path.
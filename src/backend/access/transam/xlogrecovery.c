@@ -36,6 +36,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
 #include "access/xlogrecovery.h"
@@ -1764,6 +1765,9 @@ PerformWalRecovery(void) // 执行恢复工作
 		 * end of main redo apply loop
 		 */
 
+		/* Wait for the parallel redo workers to finish, and stop them */
+		XLogParallelRedoShutdown();
+
 		if (reachedRecoveryTarget)
 		{
 			if (!reachedConsistency)
@@ -1837,6 +1841,7 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 {
 	ErrorContextCallback errcallback;
 	bool		switchedTLI = false;
+	bool		parallel;
 
 	/* Setup error traceback support for ereport() */
 	errcallback.callback = rm_redo_error_callback;
@@ -1894,7 +1899,11 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 
 	/*
 	 * Update shared replayEndRecPtr before replaying this record, so that
-	 * XLogFlush will update minRecoveryPoint correctly.
+	 * XLogFlush will update minRecoveryPoint correctly.  This must also
+	 * happen before the record is handed to a parallel redo worker: the
+	 * worker, or the bgwriter or checkpointer writing out the pages it
+	 * changed, can flush a page with this record's LSN at any time after
+	 * that, while lastReplayedEndRecPtr only says the record was dispatched.
 	 */
 	SpinLockAcquire(&XLogRecoveryCtl->info_lck);
 	XLogRecoveryCtl->replayEndRecPtr = xlogreader->EndRecPtr;
@@ -1908,6 +1917,12 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 		TransactionIdIsValid(record->xl_xid))
 		RecordKnownAssignedTransactionIds(record->xl_xid);
 
+	/*
+	 * Hand the record over to a parallel redo worker if possible.  If not,
+	 * this waits for the workers to catch up first.
+	 */
+	parallel = XLogParallelRedoDispatch(xlogreader);
+
 	/*
 	 * Some XLOG record types that are related to recovery are processed
 	 * directly here, rather than in xlog_redo()
@@ -1915,8 +1930,9 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 	if (record->xl_rmid == RM_XLOG_ID)
 		xlogrecovery_redo(xlogreader, *replayTLI);
 
-	/* Now apply the WAL record itself */
-	GetRmgr(record->xl_rmid).rm_redo(xlogreader); // 调用不同的指针函数去redo
+	/* Now apply the WAL record itself, unless a parallel redo worker does */
+	if (!parallel)
+		GetRmgr(record->xl_rmid).rm_redo(xlogreader); // 调用不同的指针函数去redo
 
 	/*
 	 * After redo, check whether the backup pages associated with the WAL
@@ -2852,6 +2868,9 @@ recoveryPausesHere(bool endOfRecovery)
 	if (LocalPromoteIsTriggered)
 		return;
 
+	/* Make sure that the state seen while paused is complete */
+	XLogParallelRedoBarrier();
+
 	if (endOfRecovery)
 		ereport(LOG,
 				(errmsg("pausing at the end of recovery"),
@@ -4477,7 +4496,8 @@ GetXLogReplayRecPtr(TimeLineID *replayTLI)
  * Get position of last applied, or the record being applied.
  *
  * This is different from GetXLogReplayRecPtr() in that if a WAL
- * record is currently being applied, this includes that record.
+ * record is currently being applied, this includes that record.  With
+ * parallel redo, it includes every record handed to a redo worker so far.
  */
 XLogRecPtr
 GetCurrentReplayRecPtr(TimeLineID *replayEndTLI)
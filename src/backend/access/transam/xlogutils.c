@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include "access/timeline.h"
+#include "access/xlogparallel.h"
 #include "access/xlogrecovery.h"
 #include "access/xlog_internal.h"
 #include "access/xlogprefetcher.h"
@@ -52,6 +53,9 @@ bool		ignore_invalid_pages = false;
  */
 bool		InRecovery = false;
 
+/* Are we a parallel redo worker? See xlogutils.h */
+bool		InParallelRedoWorker = false;
+
 /* Are we in Hot Standby mode? Only valid in startup process, see xlogutils.h */
 HotStandbyState standbyState = STANDBY_DISABLED;
 
@@ -478,6 +482,7 @@ XLogReadBufferExtended(RelFileLocator rlocator, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	bool		extension_locked = false;
 
 	Assert(blkno != P_NEW);
 
@@ -505,6 +510,19 @@ XLogReadBufferExtended(RelFileLocator rlocator, ForkNumber forknum,
 
 	lastblock = smgrnblocks(smgr, forknum);
 
+	/*
+	 * Other parallel redo workers may be extending the same fork, so a
+	 * worker has to hold the extension lock before deciding to extend, and
+	 * look at the size again.
+	 */
+	if (blkno >= lastblock && InParallelRedoWorker &&
+		mode != RBM_NORMAL && mode != RBM_NORMAL_NO_LOG)
+	{
+		XLogParallelRedoLockExtension();
+		extension_locked = true;
+		lastblock = smgrnblocks(smgr, forknum);
+	}
+
 	if (blkno < lastblock)
 	{
 		/* page exists in file */
@@ -533,6 +551,9 @@ XLogReadBufferExtended(RelFileLocator rlocator, ForkNumber forknum,
 									 mode);
 	}
 
+	if (extension_locked)
+		XLogParallelRedoUnlockExtension();
+
 recent_buffer_fast_path:
 	if (mode == RBM_NORMAL)
 	{
@@ -22,6 +22,8 @@
 #include "utils/json.h"
 
 static void AppendStringToManifest(backup_manifest_info *manifest, const char *s);
+static void AppendDataToManifest(backup_manifest_info *manifest,
+								 const char *data, size_t len);
 
 /*
  * Does the user want a backup manifest?
@@ -83,6 +85,26 @@ InitializeBackupManifest(backup_manifest_info *manifest,
 						 "\"Files\": [");
 }
 
+/*
+ * Initialize state so that a parallel backup worker can record the files it
+ * sends, for the leader to add to the real manifest with
+ * AddPartToBackupManifest.  The part holds nothing but file entries, written
+ * to the given BufFile, and isn't checksummed by itself.
+ */
+void
+InitializeBackupManifestPart(backup_manifest_info *manifest, BufFile *buffile,
+							 bool force_encode,
+							 pg_checksum_type manifest_checksum_type)
+{
+	memset(manifest, 0, sizeof(backup_manifest_info));
+	manifest->buffile = buffile;
+	manifest->checksum_type = manifest_checksum_type;
+	manifest->manifest_size = UINT64CONST(0);
+	manifest->force_encode = force_encode;
+	manifest->first_file = true;
+	manifest->still_checksumming = false;
+}
+
 /*
  * Free resources assigned to a backup manifest constructed.
  */
@@ -203,6 +225,37 @@ AddFileToBackupManifest(backup_manifest_info *manifest, const char *spcoid,
 	pfree(buf.data);
 }
 
+/*
+ * Add the file entries that a parallel backup worker recorded in part to the
+ * manifest.  The caller is responsible for closing part.
+ */
+void
+AddPartToBackupManifest(backup_manifest_info *manifest, BufFile *part)
+{
+	PGAlignedBlock buf;
+	size_t		nread;
+	bool		empty = true;
+
+	if (!IsManifestEnabled(manifest))
+		return;
+
+	while ((nread = BufFileRead(part, buf.data, sizeof(buf.data))) > 0)
+	{
+		/*
+		 * The part's first entry starts on a new line, like the first entry
+		 * AddFileToBackupManifest writes, so it only needs a comma if it
+		 * follows other entries.
+		 */
+		if (empty && !manifest->first_file)
+			AppendStringToManifest(manifest, ",");
+		AppendDataToManifest(manifest, buf.data, nread);
+		empty = false;
+	}
+
+	if (!empty)
+		manifest->first_file = false;
+}
+
 /*
  * Add information about the WAL that will need to be replayed when restoring
  * this backup to the manifest.
@@ -381,15 +434,24 @@ SendBackupManifest(backup_manifest_info *manifest, bbsink *sink)
 static void
 AppendStringToManifest(backup_manifest_info *manifest, const char *s)
 {
-	int			len = strlen(s);
+	AppendDataToManifest(manifest, s, strlen(s));
+}
 
+/*
+ * Append len bytes of data to the manifest.
+ */
+static void
+AppendDataToManifest(backup_manifest_info *manifest, const char *data,
+					 size_t len)
+{
 	Assert(manifest != NULL);
 	if (manifest->still_checksumming)
 	{
-		if (pg_cryptohash_update(manifest->manifest_ctx, (uint8 *) s, len) < 0)
+		if (pg_cryptohash_update(manifest->manifest_ctx, (const uint8 *) data,
+								 len) < 0)
 			elog(ERROR, "failed to update checksum of backup manifest: %s",
 				 pg_cryptohash_error(manifest->manifest_ctx));
 	}
-	BufFileWrite(manifest->buffile, s, len);
+	BufFileWrite(manifest->buffile, data, len);
 	manifest->manifest_size += len;
 }
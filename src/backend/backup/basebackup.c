@@ -20,11 +20,15 @@
 #include "access/xlogbackup.h"
 #include "backup/backup_manifest.h"
 #include "backup/basebackup.h"
+#include "backup/basebackup_incremental.h"
+#include "backup/basebackup_parallel.h"
 #include "backup/basebackup_sink.h"
 #include "backup/basebackup_target.h"
 #include "commands/defrem.h"
 #include "common/compression.h"
 #include "common/file_perm.h"
+#include "common/file_utils.h"
+#include "common/hashfn.h"
 #include "lib/stringinfo.h"
 #include "miscadmin.h"
 #include "nodes/pg_list.h"
@@ -42,6 +46,7 @@
 #include "storage/reinit.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/pg_lsn.h"
 #include "utils/ps_status.h"
 #include "utils/relcache.h"
 #include "utils/resowner.h"
@@ -73,6 +78,8 @@ typedef struct
 	pg_compress_algorithm compression;
 	pg_compress_specification compression_specification;
 	pg_checksum_type manifest_checksum_type;
+	int			parallel;		/* number of connections, counting this one */
+	XLogRecPtr	parallel_join;	/* start of the backup to join as worker */
 } basebackup_options;
 
 static int64 sendTablespace(bbsink *sink, char *path, char *spcoid, bool sizeonly,
@@ -80,6 +87,19 @@ static int64 sendTablespace(bbsink *sink, char *path, char *spcoid, bool sizeonl
 static int64 sendDir(bbsink *sink, const char *path, int basepathlen, bool sizeonly,
 					 List *tablespaces, bool sendtblspclinks,
 					 backup_manifest_info *manifest, const char *spcoid);
+static void perform_parallel_worker_backup(basebackup_options *opt,
+										   bbsink *sink);
+static List *get_worker_tablespaces(void);
+static bool skip_parallel_file(const char *pathbuf, int basepathlen);
+static bool is_incremental_file(const char *fullpath, const char *filename);
+static bool sendFileIncremental(bbsink *sink, int fd, const char *readfilename,
+								const char *tarfilename, struct stat *statbuf,
+								backup_manifest_info *manifest,
+								const char *spcoid,
+								pg_checksum_context *checksum_ctx);
+static void sendIncrementalData(bbsink *sink, const char *data, size_t len,
+								size_t *buffered,
+								pg_checksum_context *checksum_ctx);
 static bool sendFile(bbsink *sink, const char *readfilename, const char *tarfilename,
 					 struct stat *statbuf, bool missing_ok, Oid dboid,
 					 backup_manifest_info *manifest, const char *spcoid);
@@ -107,6 +127,19 @@ static long long int total_checksum_failures;
 /* Do not verify checksums. */
 static bool noverify_checksums = false;
 
+/*
+ * For an incremental backup, the start LSN of the backup it is relative to;
+ * relation blocks with older page LSNs are left out.  Invalid otherwise.
+ */
+static XLogRecPtr incremental_lsn = InvalidXLogRecPtr;
+
+/*
+ * In a parallel backup, the data files are divided among the connections;
+ * this one sends those numbered parallel_participant, the leader being 0.
+ */
+static int	parallel_participant = 0;
+static int	parallel_nparticipants = 1;
+
 /*
  * Definition of one element part of an exclusion list, used for paths part
  * of checksum validation or base backups.  "name" is the name of the file
@@ -277,6 +310,21 @@ perform_base_backup(basebackup_options *opt, bbsink *sink)
 		ListCell   *lc;
 		tablespaceinfo *newti;
 
+		if (incremental_lsn > state.startptr)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("incremental backup LSN %X/%X is after the start of this backup (%X/%X)",
+							LSN_FORMAT_ARGS(incremental_lsn),
+							LSN_FORMAT_ARGS(state.startptr))));
+
+		if (opt->parallel > 1)
+		{
+			ParallelBackupBegin(state.startptr, state.starttli, opt->parallel,
+								&manifest);
+			parallel_participant = 0;
+			parallel_nparticipants = opt->parallel;
+		}
+
 		/* Add a node for the base directory at the end */
 		newti = palloc0(sizeof(tablespaceinfo));
 		newti->size = -1;
@@ -323,6 +371,16 @@ perform_base_backup(basebackup_options *opt, bbsink *sink)
 
 				/* In the main tar, include the backup_label first... */
 				backup_label = build_backup_content(backup_state, false);
+				if (!XLogRecPtrIsInvalid(incremental_lsn))
+				{
+					/* keep this last; the server ignores lines it doesn't know */
+					char	   *old_label = backup_label;
+
+					backup_label = psprintf("%s%s%X/%X\n", old_label,
+											INCREMENTAL_LABEL_LINE,
+											LSN_FORMAT_ARGS(incremental_lsn));
+					pfree(old_label);
+				}
 				sendFileWithContent(sink, BACKUP_LABEL_FILE,
 									backup_label, &manifest);
 				pfree(backup_label);
@@ -339,7 +397,12 @@ perform_base_backup(basebackup_options *opt, bbsink *sink)
 				sendDir(sink, ".", 1, false, state.tablespaces,
 						sendtblspclinks, &manifest, NULL);
 
-				/* ... and pg_control after everything else. */
+				/*
+				 * ... and pg_control after everything else, including what
+				 * parallel workers are sending.
+				 */
+				if (opt->parallel > 1)
+					ParallelBackupWaitForWorkers(&manifest);
 				if (lstat(XLOG_CONTROL_FILE, &statbuf) != 0)
 					ereport(ERROR,
 							(errcode_for_file_access(),
@@ -666,6 +729,208 @@ perform_base_backup(basebackup_options *opt, bbsink *sink)
 	basebackup_progress_done();
 }
 
+/*
+ * Send a parallel worker's share of the data files of the base backup that
+ * opt->parallel_join is the start of.
+ *
+ * This produces the same stream as perform_base_backup, but with only the
+ * files that skip_parallel_file assigns to this worker, and without the
+ * backup_label, tablespace links, pg_control, WAL or a manifest, which the
+ * leader sends.  The files sent are recorded for the leader's manifest
+ * instead.  The leader doesn't end the backup until every worker has called
+ * ParallelBackupWorkerDone.  The start location is also reported as
+ * the end location, as the real one isn't known yet.
+ */
+static void
+perform_parallel_worker_backup(basebackup_options *opt, bbsink *sink)
+{
+	bbsink_state state;
+	backup_manifest_info manifest;
+	ListCell   *lc;
+	tablespaceinfo *newti;
+
+	state.startptr = opt->parallel_join;
+	state.tablespace_num = 0;
+	state.bytes_done = 0;
+	state.bytes_total = 0;
+	state.bytes_total_is_valid = false;
+
+	/* we may use a BufFile for the manifest, so we need a ResourceOwner */
+	Assert(CurrentResourceOwner == NULL);
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "base backup");
+
+	parallel_participant = ParallelBackupJoin(opt->parallel_join,
+											  &state.starttli,
+											  &parallel_nparticipants,
+											  &manifest);
+
+	backup_started_in_recovery = RecoveryInProgress();
+	total_checksum_failures = 0;
+
+	state.tablespaces = get_worker_tablespaces();
+	newti = palloc0(sizeof(tablespaceinfo));
+	newti->size = -1;
+	state.tablespaces = lappend(state.tablespaces, newti);
+
+	if (opt->progress)
+	{
+		basebackup_progress_estimate_backup_size();
+
+		foreach(lc, state.tablespaces)
+		{
+			tablespaceinfo *tmp = (tablespaceinfo *) lfirst(lc);
+
+			if (tmp->path == NULL)
+				tmp->size = sendDir(sink, ".", 1, true, state.tablespaces,
+									false, NULL, NULL);
+			else
+				tmp->size = sendTablespace(sink, tmp->path, tmp->oid, true,
+										   NULL);
+			state.bytes_total += tmp->size;
+		}
+		state.bytes_total_is_valid = true;
+	}
+
+	bbsink_begin_backup(sink, &state, SINK_BUFFER_LENGTH);
+
+	foreach(lc, state.tablespaces)
+	{
+		tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
+
+		if (ti->path == NULL)
+		{
+			bbsink_begin_archive(sink, "base.tar");
+			sendDir(sink, ".", 1, false, state.tablespaces, false,
+					&manifest, NULL);
+		}
+		else
+		{
+			char	   *archive_name = psprintf("%s.tar", ti->oid);
+
+			bbsink_begin_archive(sink, archive_name);
+			sendTablespace(sink, ti->path, ti->oid, false, &manifest);
+		}
+
+		memset(sink->bbs_buffer, 0, 2 * TAR_BLOCK_SIZE);
+		bbsink_archive_contents(sink, 2 * TAR_BLOCK_SIZE);
+		bbsink_end_archive(sink);
+	}
+
+	ParallelBackupWorkerDone(&manifest);
+
+	bbsink_end_backup(sink, state.startptr, state.starttli);
+
+	if (total_checksum_failures)
+	{
+		if (total_checksum_failures > 1)
+			ereport(WARNING,
+					(errmsg_plural("%lld total checksum verification failure",
+								   "%lld total checksum verification failures",
+								   total_checksum_failures,
+								   total_checksum_failures)));
+
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("checksum verification failure during base backup")));
+	}
+
+	FreeBackupManifest(&manifest);
+	WalSndResourceCleanup(true);
+
+	basebackup_progress_done();
+}
+
+/*
+ * Build the list of tablespaces for a parallel worker, like
+ * do_pg_backup_start does for the leader.  Only the fields sendDir and the
+ * client need are filled in.
+ */
+static List *
+get_worker_tablespaces(void)
+{
+	List	   *tablespaces = NIL;
+	DIR		   *dir;
+	struct dirent *de;
+	int			datadirpathlen = strlen(DataDir);
+
+	dir = AllocateDir("pg_tblspc");
+	while ((de = ReadDir(dir, "pg_tblspc")) != NULL)
+	{
+		char		fullpath[MAXPGPATH + 10];
+		char		linkpath[MAXPGPATH];
+		char	   *relpath = NULL;
+		PGFileType	de_type;
+		tablespaceinfo *ti;
+
+		/* Skip anything that doesn't look like a tablespace */
+		if (strspn(de->d_name, "0123456789") != strlen(de->d_name))
+			continue;
+
+		snprintf(fullpath, sizeof(fullpath), "pg_tblspc/%s", de->d_name);
+		de_type = get_dirent_type(fullpath, de, false, ERROR);
+
+		if (de_type == PGFILETYPE_LNK)
+		{
+			int			rllen;
+
+			rllen = readlink(fullpath, linkpath, sizeof(linkpath));
+			if (rllen < 0 || rllen >= sizeof(linkpath))
+				continue;		/* the leader has warned about it */
+			linkpath[rllen] = '\0';
+
+			if (rllen > datadirpathlen &&
+				strncmp(linkpath, DataDir, datadirpathlen) == 0 &&
+				IS_DIR_SEP(linkpath[datadirpathlen]))
+				relpath = pstrdup(linkpath + datadirpathlen + 1);
+		}
+		else if (de_type == PGFILETYPE_DIR)
+		{
+			/* an in-place tablespace, see do_pg_backup_start */
+			strlcpy(linkpath, fullpath, sizeof(linkpath));
+			relpath = pstrdup(linkpath);
+		}
+		else
+			continue;
+
+		ti = palloc(sizeof(tablespaceinfo));
+		ti->oid = pstrdup(de->d_name);
+		ti->path = pstrdup(linkpath);
+		ti->rpath = relpath;
+		ti->size = -1;
+		tablespaces = lappend(tablespaces, ti);
+	}
+	FreeDir(dir);
+
+	return tablespaces;
+}
+
+/*
+ * In a parallel backup, should this connection leave out the given file
+ * because another one sends it?
+ *
+ * Files are divided by a hash of their path, which every connection can
+ * work out for itself.  Top-level files of the data directory are left to
+ * the leader: they are small, and some of them are handled specially by
+ * the client, like postgresql.auto.conf when writing recovery settings.
+ */
+static bool
+skip_parallel_file(const char *pathbuf, int basepathlen)
+{
+	const char *relpath = pathbuf + basepathlen + 1;
+
+	if (parallel_nparticipants <= 1)
+		return false;
+
+	if (parallel_participant > 0)
+		ParallelBackupCheckAborted();
+
+	if (basepathlen == 1 && first_dir_separator(relpath) == NULL)
+		return parallel_participant != 0;
+
+	return hash_bytes((const unsigned char *) relpath, strlen(relpath)) %
+		parallel_nparticipants != parallel_participant;
+}
+
 /*
  * list_sort comparison function, to compare log/seg portion of WAL segment
  * filenames, ignoring the timeline portion.
@@ -703,8 +968,16 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 	bool		o_compression = false;
 	bool		o_compression_detail = false;
 	char	   *compression_detail_str = NULL;
+	bool		o_incremental = false;
+	bool		o_parallel = false;
+	bool		o_parallel_join = false;
 
 	MemSet(opt, 0, sizeof(*opt));
+	incremental_lsn = InvalidXLogRecPtr;
+	parallel_participant = 0;
+	parallel_nparticipants = 1;
+	opt->parallel = 1;
+	opt->parallel_join = InvalidXLogRecPtr;
 	opt->manifest = MANIFEST_OPTION_NO;
 	opt->manifest_checksum_type = CHECKSUM_TYPE_CRC32C;
 	opt->compression = PG_COMPRESSION_NONE;
@@ -891,6 +1164,60 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 			compression_detail_str = defGetString(defel);
 			o_compression_detail = true;
 		}
+		else if (strcmp(defel->defname, "incremental") == 0)
+		{
+			char	   *optval = defGetString(defel);
+			bool		have_error = false;
+
+			if (o_incremental)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			incremental_lsn = pg_lsn_in_internal(optval, &have_error);
+			if (have_error || XLogRecPtrIsInvalid(incremental_lsn))
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("invalid incremental backup LSN: \"%s\"",
+								optval)));
+			o_incremental = true;
+		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			int64		parallel;
+
+			if (o_parallel)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+
+			parallel = defGetInt64(defel);
+			if (parallel < 1 || parallel > MAX_PARALLEL_BACKUP_JOBS)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("%d is outside the valid range for parameter \"%s\" (%d .. %d)",
+								(int) parallel, "PARALLEL", 1,
+								MAX_PARALLEL_BACKUP_JOBS)));
+
+			opt->parallel = (int) parallel;
+			o_parallel = true;
+		}
+		else if (strcmp(defel->defname, "parallel_join") == 0)
+		{
+			char	   *optval = defGetString(defel);
+			bool		have_error = false;
+
+			if (o_parallel_join)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->parallel_join = pg_lsn_in_internal(optval, &have_error);
+			if (have_error || XLogRecPtrIsInvalid(opt->parallel_join))
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("invalid parallel backup start LSN: \"%s\"",
+								optval)));
+			o_parallel_join = true;
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -931,6 +1258,27 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 		opt->target_handle =
 			BaseBackupGetTargetHandle(target_str, target_detail_str);
 
+	if (opt->parallel > 1 || o_parallel_join)
+	{
+		if (o_parallel && o_parallel_join)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("options \"%s\" and \"%s\" cannot be used together",
+							"PARALLEL", "PARALLEL_JOIN")));
+		if (!opt->send_to_client)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("parallel base backups can only be sent to the client")));
+		if (o_parallel_join && opt->manifest != MANIFEST_OPTION_NO)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("the manifest can only be sent by the leader of a parallel base backup")));
+		if (o_parallel_join && o_wal && opt->includewal)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("WAL can only be included by the leader of a parallel base backup")));
+	}
+
 	if (o_compression_detail && !o_compression)
 		ereport(ERROR,
 				(errcode(ERRCODE_SYNTAX_ERROR),
@@ -1016,10 +1364,14 @@ SendBaseBackup(BaseBackupCmd *cmd)
 	 */
 	PG_TRY();
 	{
-		perform_base_backup(&opt, sink);
+		if (XLogRecPtrIsInvalid(opt.parallel_join))
+			perform_base_backup(&opt, sink);
+		else
+			perform_parallel_worker_backup(&opt, sink);
 	}
 	PG_FINALLY();
 	{
+		ParallelBackupRelease();
 		bbsink_cleanup(sink);
 	}
 	PG_END_TRY();
@@ -1408,6 +1760,9 @@ sendDir(bbsink *sink, const char *path, int basepathlen, bool sizeonly,
 		{
 			bool		sent = false;
 
+			if (skip_parallel_file(pathbuf, basepathlen))
+				continue;
+
 			if (!sizeonly)
 				sent = sendFile(sink, pathbuf, pathbuf + basepathlen + 1, &statbuf,
 								true, isDbDir ? atooid(lastDir + 1) : InvalidOid,
@@ -1467,6 +1822,180 @@ is_checksummed_file(const char *fullpath, const char *filename)
 		return false;
 }
 
+/*
+ * Check if a file can be sent incrementally: the main fork of a relation,
+ * in a tablespace.  Other forks are always sent whole; the free space map
+ * and visibility map are not reliably stamped with LSNs when they change.
+ */
+static bool
+is_incremental_file(const char *fullpath, const char *filename)
+{
+	int			relnumchars;
+	ForkNumber	fork;
+
+	if (strncmp(fullpath, "./global/", 9) != 0 &&
+		strncmp(fullpath, "./base/", 7) != 0 &&
+		strncmp(fullpath, "/", 1) != 0)
+		return false;
+
+	return parse_filename_for_nontemp_relation(filename, &relnumchars, &fork) &&
+		fork == MAIN_FORKNUM;
+}
+
+/*
+ * Send a relation file of an incremental backup as INCREMENTAL.<name>,
+ * holding just the blocks that changed since incremental_lsn; see
+ * basebackup_incremental.h for the format.
+ *
+ * A block is included if its page LSN is at or after incremental_lsn, or if
+ * it's a new page, which has no LSN to tell.  Pages with older LSNs haven't
+ * been modified since the earlier backup started, so its copy of them is
+ * good; pages that change while this backup runs are restored from WAL like
+ * in any base backup.
+ *
+ * The file is read twice: once to find the changed blocks, so that the size
+ * of the tar member is known before it's written, and then once more for
+ * just the blocks sent.  Returns false, having sent nothing, if leaving
+ * blocks out wouldn't save much; the caller then sends the whole file.
+ */
+static bool
+sendFileIncremental(bbsink *sink, int fd, const char *readfilename,
+					const char *tarfilename, struct stat *statbuf,
+					backup_manifest_info *manifest, const char *spcoid,
+					pg_checksum_context *checksum_ctx)
+{
+	BlockNumber nblocks;
+	BlockNumber *blocks;
+	uint32		nchanged = 0;
+	uint32		header[3];
+	pgoff_t		len = 0;
+	size_t		buffered = 0;
+	size_t		incsize;
+	struct stat incstat;
+	const char *filename;
+	char	   *incname;
+
+	if (statbuf->st_size % BLCKSZ != 0)
+		return false;
+	nblocks = statbuf->st_size / BLCKSZ;
+	blocks = palloc(sizeof(BlockNumber) * Max(nblocks, 1));
+
+	/* First pass: find the blocks to send */
+	while (len < statbuf->st_size)
+	{
+		int			cnt;
+
+		cnt = basebackup_read_file(fd, sink->bbs_buffer,
+								   Min(sink->bbs_buffer_length,
+									   statbuf->st_size - len),
+								   len, readfilename, true);
+		if (cnt < BLCKSZ)
+			break;				/* truncated meanwhile; WAL replay fixes it */
+
+		for (int i = 0; i < cnt / BLCKSZ; i++)
+		{
+			Page		page = sink->bbs_buffer + BLCKSZ * i;
+
+			if (PageIsNew(page) || PageGetLSN(page) >= incremental_lsn)
+				blocks[nchanged++] = len / BLCKSZ + i;
+		}
+		len += cnt - cnt % BLCKSZ;
+	}
+	nblocks = len / BLCKSZ;
+
+	/* Not worth it if we'd be sending most of the file anyway */
+	incsize = INCREMENTAL_HEADER_SIZE + sizeof(BlockNumber) * nchanged +
+		(size_t) BLCKSZ * nchanged;
+	if (incsize >= (size_t) statbuf->st_size / 10 * 9)
+	{
+		pfree(blocks);
+		return false;
+	}
+
+	filename = last_dir_separator(tarfilename);
+	filename = filename ? filename + 1 : tarfilename;
+	incname = psprintf("%.*s%s%s", (int) (filename - tarfilename), tarfilename,
+					   INCREMENTAL_PREFIX, filename);
+	incstat = *statbuf;
+	incstat.st_size = incsize;
+	_tarWriteHeader(sink, incname, NULL, &incstat, false);
+
+	header[0] = INCREMENTAL_MAGIC;
+	header[1] = nchanged;
+	header[2] = nblocks;
+	sendIncrementalData(sink, (char *) header, sizeof(header), &buffered,
+						checksum_ctx);
+	sendIncrementalData(sink, (char *) blocks, sizeof(BlockNumber) * nchanged,
+						&buffered, checksum_ctx);
+
+	/* Second pass: send the blocks */
+	for (uint32 i = 0; i < nchanged; i++)
+	{
+		int			cnt;
+
+		if (sink->bbs_buffer_length - buffered < BLCKSZ)
+			sendIncrementalData(sink, NULL, 0, &buffered, checksum_ctx);
+
+		cnt = basebackup_read_file(fd, sink->bbs_buffer + buffered, BLCKSZ,
+								   (pgoff_t) blocks[i] * BLCKSZ, readfilename,
+								   true);
+		/* if truncated since the first pass, send zeroes like sendFile */
+		if (cnt < BLCKSZ)
+			MemSet(sink->bbs_buffer + buffered + cnt, 0, BLCKSZ - cnt);
+		buffered += BLCKSZ;
+	}
+	sendIncrementalData(sink, NULL, 0, &buffered, checksum_ctx);
+
+	_tarWritePadding(sink, incsize);
+
+	AddFileToBackupManifest(manifest, spcoid, incname, incsize,
+							(pg_time_t) statbuf->st_mtime, checksum_ctx);
+
+	pfree(blocks);
+	pfree(incname);
+
+	return true;
+}
+
+/*
+ * Append len bytes of data to the sink's buffer, of which *buffered bytes
+ * are already in use, archiving the buffer whenever it fills up.  With data
+ * NULL, just archive whatever is buffered.
+ */
+static void
+sendIncrementalData(bbsink *sink, const char *data, size_t len,
+					size_t *buffered, pg_checksum_context *checksum_ctx)
+{
+	while (len > 0)
+	{
+		size_t		n = Min(len, sink->bbs_buffer_length - *buffered);
+
+		memcpy(sink->bbs_buffer + *buffered, data, n);
+		*buffered += n;
+		data += n;
+		len -= n;
+
+		/* leave a partly filled buffer for the next call */
+		if (*buffered < sink->bbs_buffer_length)
+			return;
+
+		if (pg_checksum_update(checksum_ctx, (uint8 *) sink->bbs_buffer,
+							   *buffered) < 0)
+			elog(ERROR, "could not update checksum of base backup");
+		bbsink_archive_contents(sink, *buffered);
+		*buffered = 0;
+	}
+
+	if (data == NULL && *buffered > 0)
+	{
+		if (pg_checksum_update(checksum_ctx, (uint8 *) sink->bbs_buffer,
+							   *buffered) < 0)
+			elog(ERROR, "could not update checksum of base backup");
+		bbsink_archive_contents(sink, *buffered);
+		*buffered = 0;
+	}
+}
+
 /*
  * Given the member, write the TAR header & send the file.
  *
@@ -1512,6 +2041,17 @@ sendFile(bbsink *sink, const char *readfilename, const char *tarfilename,
 				 errmsg("could not open file \"%s\": %m", readfilename)));
 	}
 
+	/* In an incremental backup, try sending only the changed blocks */
+	if (!XLogRecPtrIsInvalid(incremental_lsn) &&
+		is_incremental_file(readfilename,
+							last_dir_separator(readfilename) + 1) &&
+		sendFileIncremental(sink, fd, readfilename, tarfilename, statbuf,
+							manifest, spcoid, &checksum_ctx))
+	{
+		CloseTransientFile(fd);
+		return true;
+	}
+
 	_tarWriteHeader(sink, tarfilename, NULL, statbuf, false);
 
 	if (!noverify_checksums && DataChecksumsEnabled())
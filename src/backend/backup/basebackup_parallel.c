@@ -0,0 +1,395 @@
+/*-------------------------------------------------------------------------
+ *
+ * basebackup_parallel.c
+ *	  Coordination of a base backup sent over several connections.
+ *
+ * A parallel base backup is started by a BASE_BACKUP command with the
+ * PARALLEL option on one walsender, the leader, which does everything an
+ * ordinary base backup does.  Once the backup has started, the client opens
+ * more connections and runs BASE_BACKUP with PARALLEL_JOIN and the start
+ * LSN on each; those workers send their share of the data files, while the
+ * leader skips them.  Before ending the backup, the leader waits here for
+ * all the workers to finish, so that every file is copied between the start
+ * and the end of the backup, as recovery requires.
+ *
+ * If the backup has a manifest, each worker records the files it sends in a
+ * file of its own in a shared FileSet, and the leader adds those entries to
+ * the manifest once the workers are done.
+ *
+ * There's a single slot of shared state, so only one parallel backup can
+ * run at a time.  If any participant fails, the whole backup is aborted.
+ *
+ * Portions Copyright (c) 2010-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/backup/basebackup_parallel.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "backup/basebackup_parallel.h"
+#include "libpq/libpq.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/condition_variable.h"
+#include "storage/fd.h"
+#include "storage/fileset.h"
+#include "storage/ipc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+
+typedef struct ParallelBackupShared
+{
+	slock_t		mutex;
+
+	/* start LSN of the running parallel backup, or invalid if none */
+	XLogRecPtr	startptr;
+	TimeLineID	starttli;
+
+	int			nparticipants;	/* including the leader */
+	int			njoined;		/* workers that joined so far */
+	int			nfinished;		/* workers done sending */
+	bool		aborted;		/* some participant failed */
+
+	/* the leader's manifest options, and where workers write their parts */
+	bool		manifest;
+	bool		manifest_force_encode;
+	pg_checksum_type manifest_checksum_type;
+	FileSet		manifest_fileset;
+
+	/* signaled whenever a worker finishes or fails */
+	ConditionVariable cv;
+} ParallelBackupShared;
+
+static ParallelBackupShared *ParallelBackup = NULL;
+
+typedef enum
+{
+	PARALLEL_BACKUP_NONE,
+	PARALLEL_BACKUP_LEADER,
+	PARALLEL_BACKUP_WORKER
+} ParallelBackupRole;
+
+/* this process's part in the running parallel backup, if any */
+static ParallelBackupRole MyRole = PARALLEL_BACKUP_NONE;
+static XLogRecPtr MyStartptr = InvalidXLogRecPtr;
+static bool exit_callback_registered = false;
+
+static void parallel_backup_shmem_exit(int code, Datum arg);
+static void manifest_part_name(char *name, int participant);
+
+/* Report shared-memory space needed by BaseBackupParallelShmemInit */
+Size
+BaseBackupParallelShmemSize(void)
+{
+	return sizeof(ParallelBackupShared);
+}
+
+/* Allocate and initialize parallel base backup shared memory */
+void
+BaseBackupParallelShmemInit(void)
+{
+	bool		found;
+
+	ParallelBackup = (ParallelBackupShared *)
+		ShmemInitStruct("Parallel Base Backup", BaseBackupParallelShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		MemSet(ParallelBackup, 0, BaseBackupParallelShmemSize());
+		SpinLockInit(&ParallelBackup->mutex);
+		ParallelBackup->startptr = InvalidXLogRecPtr;
+		ConditionVariableInit(&ParallelBackup->cv);
+	}
+}
+
+/*
+ * Make sure whatever part this process has in a parallel backup is given up
+ * if it exits in the middle of it.
+ */
+static void
+register_exit_callback(void)
+{
+	if (!exit_callback_registered)
+	{
+		before_shmem_exit(parallel_backup_shmem_exit, 0);
+		exit_callback_registered = true;
+	}
+}
+
+/*
+ * Called by the leader once the backup has started, to let workers join it.
+ * The workers record their files for the leader's manifest, if it has one.
+ */
+void
+ParallelBackupBegin(XLogRecPtr startptr, TimeLineID starttli,
+					int nparticipants, backup_manifest_info *manifest)
+{
+	FileSet		fileset;
+
+	Assert(MyRole == PARALLEL_BACKUP_NONE);
+	Assert(nparticipants > 1);
+
+	register_exit_callback();
+
+	if (manifest->buffile != NULL)
+	{
+		/*
+		 * A walsender has no transaction in which to look up
+		 * temp_tablespaces, so the parts go to the default location.
+		 */
+		if (!TempTablespacesAreSet())
+			SetTempTablespaces(NULL, 0);
+		FileSetInit(&fileset);
+	}
+
+	SpinLockAcquire(&ParallelBackup->mutex);
+	if (!XLogRecPtrIsInvalid(ParallelBackup->startptr))
+	{
+		SpinLockRelease(&ParallelBackup->mutex);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("another parallel base backup is already in progress")));
+	}
+	ParallelBackup->startptr = startptr;
+	ParallelBackup->starttli = starttli;
+	ParallelBackup->nparticipants = nparticipants;
+	ParallelBackup->njoined = 0;
+	ParallelBackup->nfinished = 0;
+	ParallelBackup->aborted = false;
+	ParallelBackup->manifest = (manifest->buffile != NULL);
+	ParallelBackup->manifest_force_encode = manifest->force_encode;
+	ParallelBackup->manifest_checksum_type = manifest->checksum_type;
+	if (ParallelBackup->manifest)
+		ParallelBackup->manifest_fileset = fileset;
+	SpinLockRelease(&ParallelBackup->mutex);
+
+	MyRole = PARALLEL_BACKUP_LEADER;
+	MyStartptr = startptr;
+}
+
+/*
+ * Called by the leader after sending its own share of the files, to wait
+ * until all the workers have sent theirs, and add their files to the
+ * manifest.  This ends the parallel part of the backup; the shared slot is
+ * free again once this returns.
+ */
+void
+ParallelBackupWaitForWorkers(backup_manifest_info *manifest)
+{
+	Assert(MyRole == PARALLEL_BACKUP_LEADER);
+
+	for (;;)
+	{
+		bool		aborted;
+		bool		done;
+
+		SpinLockAcquire(&ParallelBackup->mutex);
+		aborted = ParallelBackup->aborted;
+		done = ParallelBackup->nfinished == ParallelBackup->nparticipants - 1;
+		SpinLockRelease(&ParallelBackup->mutex);
+
+		if (aborted)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("parallel base backup worker failed")));
+		if (done)
+			break;
+
+		/*
+		 * A worker that never manages to join can't report failure, so make
+		 * sure we notice if the client gave up on us.
+		 */
+		if (!pq_check_connection())
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("connection to client lost")));
+
+		ConditionVariableTimedSleep(&ParallelBackup->cv, 1000L,
+									WAIT_EVENT_BACKUP_WAIT_PARALLEL_WORKERS);
+	}
+	ConditionVariableCancelSleep();
+
+	/* The workers are done, so nobody else touches the shared state now */
+	if (ParallelBackup->manifest)
+	{
+		for (int i = 1; i < ParallelBackup->nparticipants; i++)
+		{
+			char		name[MAXPGPATH];
+			BufFile    *part;
+
+			manifest_part_name(name, i);
+			part = BufFileOpenFileSet(&ParallelBackup->manifest_fileset, name,
+									  O_RDONLY, false);
+			AddPartToBackupManifest(manifest, part);
+			BufFileClose(part);
+		}
+	}
+
+	ParallelBackupRelease();
+}
+
+/*
+ * Called by a worker to join the parallel backup that started at startptr.
+ * Returns this worker's number, counting the leader as 0, and sets the
+ * backup's timeline and number of participants.  manifest is set up to
+ * record the worker's files for the leader, if the backup has a manifest.
+ */
+int
+ParallelBackupJoin(XLogRecPtr startptr, TimeLineID *starttli,
+				   int *nparticipants, backup_manifest_info *manifest)
+{
+	int			participant;
+	bool		want_manifest;
+	bool		force_encode;
+	pg_checksum_type checksum_type;
+
+	Assert(MyRole == PARALLEL_BACKUP_NONE);
+
+	register_exit_callback();
+
+	SpinLockAcquire(&ParallelBackup->mutex);
+	if (ParallelBackup->startptr != startptr || ParallelBackup->aborted)
+	{
+		SpinLockRelease(&ParallelBackup->mutex);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("no parallel base backup starting at %X/%X is in progress",
+						LSN_FORMAT_ARGS(startptr))));
+	}
+	if (ParallelBackup->njoined >= ParallelBackup->nparticipants - 1)
+	{
+		SpinLockRelease(&ParallelBackup->mutex);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("all workers of the parallel base backup starting at %X/%X have already joined",
+						LSN_FORMAT_ARGS(startptr))));
+	}
+	participant = ++ParallelBackup->njoined;
+	*starttli = ParallelBackup->starttli;
+	*nparticipants = ParallelBackup->nparticipants;
+	want_manifest = ParallelBackup->manifest;
+	force_encode = ParallelBackup->manifest_force_encode;
+	checksum_type = ParallelBackup->manifest_checksum_type;
+	SpinLockRelease(&ParallelBackup->mutex);
+
+	MyRole = PARALLEL_BACKUP_WORKER;
+	MyStartptr = startptr;
+
+	if (want_manifest)
+	{
+		char		name[MAXPGPATH];
+
+		manifest_part_name(name, participant);
+		InitializeBackupManifestPart(manifest,
+									 BufFileCreateFileSet(&ParallelBackup->manifest_fileset,
+														  name),
+									 force_encode, checksum_type);
+	}
+	else
+		InitializeBackupManifest(manifest, MANIFEST_OPTION_NO,
+								 CHECKSUM_TYPE_NONE);
+
+	return participant;
+}
+
+/*
+ * Called by a worker now and then, to give up early if the backup failed
+ * elsewhere.
+ */
+void
+ParallelBackupCheckAborted(void)
+{
+	bool		aborted;
+
+	Assert(MyRole == PARALLEL_BACKUP_WORKER);
+
+	SpinLockAcquire(&ParallelBackup->mutex);
+	aborted = ParallelBackup->aborted ||
+		ParallelBackup->startptr != MyStartptr;
+	SpinLockRelease(&ParallelBackup->mutex);
+
+	if (aborted)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("parallel base backup was aborted")));
+}
+
+/*
+ * Called by a worker when it has sent all its files, and recorded them in
+ * manifest.
+ */
+void
+ParallelBackupWorkerDone(backup_manifest_info *manifest)
+{
+	Assert(MyRole == PARALLEL_BACKUP_WORKER);
+
+	ParallelBackupCheckAborted();
+
+	/* the leader can't read our part before it's flushed */
+	if (manifest->buffile != NULL)
+	{
+		BufFileClose(manifest->buffile);
+		manifest->buffile = NULL;
+	}
+
+	SpinLockAcquire(&ParallelBackup->mutex);
+	ParallelBackup->nfinished++;
+	SpinLockRelease(&ParallelBackup->mutex);
+	ConditionVariableBroadcast(&ParallelBackup->cv);
+
+	MyRole = PARALLEL_BACKUP_NONE;
+	MyStartptr = InvalidXLogRecPtr;
+}
+
+/*
+ * Give up this process's part in a parallel backup, if any.  A leader
+ * frees the shared slot; from a leader or worker that hasn't finished,
+ * this aborts the backup.
+ *
+ * Called after every BASE_BACKUP command, successful or not.
+ */
+void
+ParallelBackupRelease(void)
+{
+	if (MyRole == PARALLEL_BACKUP_NONE)
+		return;
+
+	/*
+	 * Workers are done with the manifest parts once the leader gives up, as
+	 * the backup is either complete or aborted then.
+	 */
+	if (MyRole == PARALLEL_BACKUP_LEADER && ParallelBackup->manifest)
+		FileSetDeleteAll(&ParallelBackup->manifest_fileset);
+
+	SpinLockAcquire(&ParallelBackup->mutex);
+	if (ParallelBackup->startptr == MyStartptr)
+	{
+		if (MyRole == PARALLEL_BACKUP_LEADER)
+			ParallelBackup->startptr = InvalidXLogRecPtr;
+		else
+			ParallelBackup->aborted = true;
+	}
+	SpinLockRelease(&ParallelBackup->mutex);
+	ConditionVariableBroadcast(&ParallelBackup->cv);
+
+	MyRole = PARALLEL_BACKUP_NONE;
+	MyStartptr = InvalidXLogRecPtr;
+}
+
+static void
+parallel_backup_shmem_exit(int code, Datum arg)
+{
+	ParallelBackupRelease();
+}
+
+/*
+ * Name of the file in which the given worker records its manifest entries.
+ */
+static void
+manifest_part_name(char *name, int participant)
+{
+	snprintf(name, MAXPGPATH, "manifest.%d", participant);
+}
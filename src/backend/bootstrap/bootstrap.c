@@ -323,6 +323,12 @@ BootstrapModeMain(int argc, char *argv[], bool check_only)
 
 	InitializeMaxBackends();
 
+	/* Initialize size of fast-path lock cache. */
+	InitializeFastPathLocks();
+
+	/* Choose the number of lock table partitions. */
+	InitializeLockPartitions();
+
 	CreateSharedMemoryAndSemaphores();
 
 	/*
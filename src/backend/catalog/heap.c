@@ -43,6 +43,7 @@
 #include "catalog/pg_am.h"
 #include "catalog/pg_attrdef.h"
 #include "catalog/pg_collation.h"
+#include "catalog/pg_compression_dictionary.h"
 #include "catalog/pg_constraint.h"
 #include "catalog/pg_foreign_table.h"
 #include "catalog/pg_inherits.h"
@@ -1891,6 +1892,12 @@ heap_drop_with_catalog(Oid relid)
 	 */
 	RemoveStatistics(relid, 0);
 
+	/*
+	 * detach compression dictionaries; they stay around for any values that
+	 * were copied elsewhere
+	 */
+	CompressionDictionaryDetachRelation(relid);
+
 	/*
 	 * delete attribute tuples
 	 */
@@ -2985,12 +2985,18 @@ index_build(Relation heapRelation,
 
 	/*
 	 * Determine worker process details for parallel CREATE INDEX.  Currently,
-	 * only btree has support for parallel builds.
+	 * btree, gin, brin, gist (sorted builds only), spgist and hash have
+	 * support for parallel builds.
 	 *
 	 * Note that planner considers parallel safety for us.
 	 */
 	if (parallel && IsNormalProcessingMode() &&
-		indexRelation->rd_rel->relam == BTREE_AM_OID)
+		(indexRelation->rd_rel->relam == BTREE_AM_OID ||
+		 indexRelation->rd_rel->relam == GIN_AM_OID ||
+		 indexRelation->rd_rel->relam == BRIN_AM_OID ||
+		 indexRelation->rd_rel->relam == GIST_AM_OID ||
+		 indexRelation->rd_rel->relam == SPGIST_AM_OID ||
+		 indexRelation->rd_rel->relam == HASH_AM_OID))
 		indexInfo->ii_ParallelWorkers =
 			plan_create_index_workers(RelationGetRelid(heapRelation),
 									  RelationGetRelid(indexRelation));
@@ -3307,10 +3313,11 @@ IndexCheckExclusion(Relation heapRelation,
  * not index).  Then we mark the index "indisvalid" and commit.  Subsequent
  * transactions will be able to use it for queries.
  *
- * Doing two full table scans is a brute-force strategy.  We could try to be
- * cleverer, eg storing new tuples in a special area of the table (perhaps
- * making the table append-only by setting use_fsm).  However that would
- * add yet more locking issues.
+ * Doing two full table scans is a brute-force strategy.  For btree indexes,
+ * CREATE INDEX CONCURRENTLY avoids the second one when it can: writers that
+ * see the index before it is ready log the TIDs of the tuples they insert,
+ * and index_tidlog_merge() checks just those tuples instead of calling
+ * validate_index().  See indextidlog.c.
  */
 void
 validate_index(Oid heapId, Oid indexId, Snapshot snapshot)
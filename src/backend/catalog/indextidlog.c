@@ -0,0 +1,540 @@
+/*-------------------------------------------------------------------------
+ *
+ * indextidlog.c
+ *	  Log of heap TIDs inserted during CREATE INDEX CONCURRENTLY
+ *
+ * A concurrent index build normally finishes with validate_index(), which
+ * collects all TIDs of the new index and then scans the whole heap for
+ * tuples that the build missed, that is, tuples inserted by transactions
+ * that committed after the build's snapshot was taken.  On a big table that
+ * second scan costs about as much as the build itself.
+ *
+ * Instead, DefineIndex() can open a TID log for the index before making it
+ * visible to other backends.  While the index exists but is not yet ready
+ * for inserts, ExecInsertIndexTuples() appends the TID of each tuple that it
+ * would otherwise have inserted into the index to the log.  Once the index is
+ * ready and all the transactions that could have been logging are gone, the
+ * log holds every TID that the build might have missed.  index_tidlog_merge()
+ * then sorts it, and inserts the tuples that are visible to the reference
+ * snapshot and not yet in the index.  Checking for the entry needs a
+ * descent of the index per TID, so this is only done for btree indexes,
+ * whose key space includes the heap TID.
+ *
+ * The log is kept in a DSA area created by the backend running the build,
+ * limited to maintenance_work_mem.  If it runs out of space, later TIDs are
+ * not logged and DefineIndex() falls back to validate_index().  Likewise if
+ * no log slot is free.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/catalog/indextidlog.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/nbtree.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/xact.h"
+#include "catalog/index.h"
+#include "catalog/indextidlog.h"
+#include "commands/progress.h"
+#include "executor/executor.h"
+#include "lib/qunique.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/* Number of concurrent index builds that can log at the same time */
+#define INDEX_TID_LOG_SLOTS			8
+
+/* Number of TIDs per chunk of the log */
+#define INDEX_TID_LOG_CHUNK_TIDS	1024
+
+typedef struct IndexTidLogChunk
+{
+	dsa_pointer next;			/* previous chunk, or InvalidDsaPointer */
+	int			ntids;			/* number of valid entries in tids[] */
+	ItemPointerData tids[INDEX_TID_LOG_CHUNK_TIDS];
+} IndexTidLogChunk;
+
+typedef struct IndexTidLogSlot
+{
+	LWLock		lock;			/* protects the fields below */
+	Oid			dbid;
+	Oid			indexrelid;		/* InvalidOid if the slot is free */
+	dsa_handle	handle;			/* area holding the chunks */
+	dsa_pointer head;			/* most recent chunk, or InvalidDsaPointer */
+	bool		overflowed;		/* some TIDs could not be logged */
+	uint64		ntids;			/* number of TIDs logged */
+} IndexTidLogSlot;
+
+static IndexTidLogSlot *IndexTidLogSlots = NULL;
+
+/* log owned by this backend, if any */
+static IndexTidLogSlot *owned_slot = NULL;
+static dsa_area *owned_area = NULL;
+
+/* area of some other backend's log, attached to for appending */
+static dsa_area *attached_area = NULL;
+static dsa_handle attached_handle = DSA_HANDLE_INVALID;
+
+static bool callback_registered = false;
+
+static void index_tidlog_xact_callback(XactEvent event, void *arg);
+static void index_tidlog_release(void);
+static int	tid_cmp(const void *a, const void *b);
+
+
+/*
+ * IndexTidLogShmemSize --- report amount of shared memory space needed
+ */
+Size
+IndexTidLogShmemSize(void)
+{
+	return mul_size(INDEX_TID_LOG_SLOTS, sizeof(IndexTidLogSlot));
+}
+
+/*
+ * IndexTidLogShmemInit --- initialize the log slots
+ */
+void
+IndexTidLogShmemInit(void)
+{
+	bool		found;
+
+	IndexTidLogSlots = (IndexTidLogSlot *)
+		ShmemInitStruct("Index TID Log Slots", IndexTidLogShmemSize(), &found);
+
+	if (!IsUnderPostmaster)
+	{
+		Assert(!found);
+		for (int i = 0; i < INDEX_TID_LOG_SLOTS; i++)
+		{
+			IndexTidLogSlot *slot = &IndexTidLogSlots[i];
+
+			LWLockInitialize(&slot->lock, LWTRANCHE_INDEX_TID_LOG);
+			slot->dbid = InvalidOid;
+			slot->indexrelid = InvalidOid;
+			slot->handle = DSA_HANDLE_INVALID;
+			slot->head = InvalidDsaPointer;
+			slot->overflowed = false;
+			slot->ntids = 0;
+		}
+	}
+	else
+		Assert(found);
+}
+
+/*
+ * index_tidlog_begin - start logging the TIDs inserted for an index
+ *
+ * Must be called before the transaction that creates the index commits, so
+ * that every backend that sees the index also sees the log.  Returns false
+ * if no log slot is free; the caller must then validate the index the usual
+ * way.  If the transaction, or any later one before index_tidlog_end(), is
+ * aborted, the log is discarded.
+ */
+bool
+index_tidlog_begin(Oid indexOid)
+{
+	IndexTidLogSlot *slot = NULL;
+	MemoryContext oldcontext;
+
+	Assert(owned_slot == NULL);
+
+	if (!callback_registered)
+	{
+		RegisterXactCallback(index_tidlog_xact_callback, NULL);
+		callback_registered = true;
+	}
+
+	/* the area must outlive this transaction */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	owned_area = dsa_create(LWTRANCHE_INDEX_TID_LOG);
+	dsa_pin_mapping(owned_area);
+	dsa_set_size_limit(owned_area, (size_t) maintenance_work_mem * 1024);
+	MemoryContextSwitchTo(oldcontext);
+
+	for (int i = 0; i < INDEX_TID_LOG_SLOTS; i++)
+	{
+		IndexTidLogSlot *cur = &IndexTidLogSlots[i];
+
+		LWLockAcquire(&cur->lock, LW_EXCLUSIVE);
+		if (!OidIsValid(cur->indexrelid))
+		{
+			cur->dbid = MyDatabaseId;
+			cur->indexrelid = indexOid;
+			cur->handle = dsa_get_handle(owned_area);
+			cur->head = InvalidDsaPointer;
+			cur->overflowed = false;
+			cur->ntids = 0;
+			slot = cur;
+		}
+		LWLockRelease(&cur->lock);
+
+		if (slot != NULL)
+			break;
+	}
+
+	if (slot == NULL)
+	{
+		dsa_detach(owned_area);
+		owned_area = NULL;
+		return false;
+	}
+
+	owned_slot = slot;
+	return true;
+}
+
+/*
+ * index_tidlog_end - stop logging, and discard the log
+ */
+void
+index_tidlog_end(Oid indexOid)
+{
+	Assert(owned_slot != NULL && owned_slot->indexrelid == indexOid);
+
+	index_tidlog_release();
+}
+
+/*
+ * index_tidlog_record - log a TID inserted into a not-ready index
+ *
+ * Called for each index that is not ready for inserts when a new heap tuple
+ * version is inserted.  Does nothing unless a concurrent build of the index
+ * has a log open.
+ */
+void
+index_tidlog_record(Relation indexRelation, ItemPointer tid)
+{
+	Oid			indexOid = RelationGetRelid(indexRelation);
+
+	for (int i = 0; i < INDEX_TID_LOG_SLOTS; i++)
+	{
+		IndexTidLogSlot *slot = &IndexTidLogSlots[i];
+		IndexTidLogChunk *chunk = NULL;
+
+		/*
+		 * The slot was filled in before the index became visible to us, so an
+		 * unlocked look is enough to skip the slots of other indexes.
+		 */
+		if (slot->indexrelid != indexOid || slot->dbid != MyDatabaseId)
+			continue;
+
+		LWLockAcquire(&slot->lock, LW_EXCLUSIVE);
+		if (slot->indexrelid != indexOid || slot->dbid != MyDatabaseId ||
+			slot->overflowed)
+		{
+			LWLockRelease(&slot->lock);
+			return;
+		}
+
+		/*
+		 * Attach to the log's area while holding the lock, so that the owner
+		 * can't detach from it meanwhile.  We stay attached until the end of
+		 * our transaction.
+		 */
+		if (attached_handle != slot->handle)
+		{
+			MemoryContext oldcontext;
+
+			if (attached_area != NULL)
+				dsa_detach(attached_area);
+			attached_area = NULL;
+			attached_handle = DSA_HANDLE_INVALID;
+
+			if (!callback_registered)
+			{
+				RegisterXactCallback(index_tidlog_xact_callback, NULL);
+				callback_registered = true;
+			}
+
+			oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+			attached_area = dsa_attach(slot->handle);
+			dsa_pin_mapping(attached_area);
+			MemoryContextSwitchTo(oldcontext);
+			attached_handle = slot->handle;
+		}
+
+		if (DsaPointerIsValid(slot->head))
+			chunk = dsa_get_address(attached_area, slot->head);
+
+		if (chunk == NULL || chunk->ntids >= INDEX_TID_LOG_CHUNK_TIDS)
+		{
+			dsa_pointer dp;
+
+			dp = dsa_allocate_extended(attached_area, sizeof(IndexTidLogChunk),
+									   DSA_ALLOC_NO_OOM);
+			if (!DsaPointerIsValid(dp))
+			{
+				slot->overflowed = true;
+				LWLockRelease(&slot->lock);
+				return;
+			}
+
+			chunk = dsa_get_address(attached_area, dp);
+			chunk->next = slot->head;
+			chunk->ntids = 0;
+			slot->head = dp;
+		}
+
+		chunk->tids[chunk->ntids++] = *tid;
+		slot->ntids++;
+		LWLockRelease(&slot->lock);
+		return;
+	}
+}
+
+/*
+ * index_tidlog_merge - insert the logged tuples missing from the index
+ *
+ * This does the job of validate_index() for an index with a TID log: every
+ * logged tuple that is visible to the reference snapshot, and that isn't in
+ * the index already, is inserted.  Caller must have waited out all
+ * transactions that might still be logging TIDs.  Returns false, without
+ * doing anything, if the log is incomplete; caller must then fall back to
+ * validate_index().
+ */
+bool
+index_tidlog_merge(Oid heapId, Oid indexId, Snapshot snapshot)
+{
+	IndexTidLogSlot *slot = owned_slot;
+	Relation	heapRelation,
+				indexRelation;
+	IndexInfo  *indexInfo;
+	ItemPointerData *tids;
+	uint64		ntids;
+	uint64		n;
+	dsa_pointer dp;
+	EState	   *estate;
+	ExprContext *econtext;
+	ExprState  *predicate;
+	TupleTableSlot *tupslot;
+	IndexFetchTableData *fetch;
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	double		tups_inserted = 0;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			save_nestlevel;
+
+	Assert(slot != NULL && slot->indexrelid == indexId);
+
+	/* Collect the TIDs */
+	LWLockAcquire(&slot->lock, LW_SHARED);
+	if (slot->overflowed)
+	{
+		LWLockRelease(&slot->lock);
+		return false;
+	}
+
+	ntids = slot->ntids;
+	tids = (ItemPointerData *)
+		palloc_extended(Max(ntids, 1) * sizeof(ItemPointerData),
+						MCXT_ALLOC_HUGE | MCXT_ALLOC_NO_OOM);
+	if (tids == NULL)
+	{
+		LWLockRelease(&slot->lock);
+		return false;
+	}
+
+	n = 0;
+	for (dp = slot->head; DsaPointerIsValid(dp);)
+	{
+		IndexTidLogChunk *chunk = dsa_get_address(owned_area, dp);
+
+		memcpy(&tids[n], chunk->tids, chunk->ntids * sizeof(ItemPointerData));
+		n += chunk->ntids;
+		dp = chunk->next;
+	}
+	LWLockRelease(&slot->lock);
+	Assert(n == ntids);
+
+	{
+		const int	progress_index[] = {
+			PROGRESS_CREATEIDX_PHASE,
+			PROGRESS_CREATEIDX_TUPLES_DONE,
+			PROGRESS_CREATEIDX_TUPLES_TOTAL,
+			PROGRESS_SCAN_BLOCKS_DONE,
+			PROGRESS_SCAN_BLOCKS_TOTAL
+		};
+		const int64 progress_vals[] = {
+			PROGRESS_CREATEIDX_PHASE_VALIDATE_SORT,
+			0, ntids, 0, 0
+		};
+
+		pgstat_progress_update_multi_param(5, progress_index, progress_vals);
+	}
+
+	/* a TID is logged twice if its line pointer was reused meanwhile */
+	qsort(tids, ntids, sizeof(ItemPointerData), tid_cmp);
+	ntids = qunique(tids, ntids, sizeof(ItemPointerData), tid_cmp);
+
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_PHASE,
+								 PROGRESS_CREATEIDX_PHASE_VALIDATE_TABLESCAN);
+
+	/* Open and lock the parent heap relation */
+	heapRelation = table_open(heapId, ShareUpdateExclusiveLock);
+
+	/* Run index functions as the table owner, as validate_index() does */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(heapRelation->rd_rel->relowner,
+						   save_sec_context | SECURITY_RESTRICTED_OPERATION);
+	save_nestlevel = NewGUCNestLevel();
+
+	indexRelation = index_open(indexId, RowExclusiveLock);
+	Assert(indexRelation->rd_rel->relam == BTREE_AM_OID);
+
+	indexInfo = BuildIndexInfo(indexRelation);
+	indexInfo->ii_Concurrent = true;
+
+	estate = CreateExecutorState();
+	econtext = GetPerTupleExprContext(estate);
+	tupslot = table_slot_create(heapRelation, NULL);
+	econtext->ecxt_scantuple = tupslot;
+	predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+
+	fetch = table_index_fetch_begin(heapRelation);
+
+	for (n = 0; n < ntids; n++)
+	{
+		ItemPointerData tid = tids[n];
+		bool		call_again = false;
+		bool		all_dead = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		ResetPerTupleExprContext(estate);
+
+		/*
+		 * The logged TID is the root of any HOT chain built on it since, and
+		 * that's what the index entry must point to.  All members of the
+		 * chain have the same index values.
+		 */
+		if (table_index_fetch_tuple(fetch, &tid, snapshot, tupslot,
+									&call_again, &all_dead))
+		{
+			MemoryContext oldcontext;
+			IndexTuple	itup;
+
+			oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+
+			if (predicate == NULL || ExecQual(predicate, econtext))
+			{
+				FormIndexDatum(indexInfo, tupslot, estate, values, isnull);
+
+				itup = index_form_tuple(RelationGetDescr(indexRelation),
+										values, isnull);
+				itup->t_tid = tids[n];
+
+				/* the build, or a writer, may have inserted it already */
+				if (!_bt_tid_exists(indexRelation, heapRelation, itup))
+				{
+					index_insert(indexRelation, values, isnull, &tids[n],
+								 heapRelation,
+								 indexInfo->ii_Unique ?
+								 UNIQUE_CHECK_YES : UNIQUE_CHECK_NO,
+								 false,
+								 indexInfo);
+					tups_inserted += 1;
+				}
+			}
+
+			MemoryContextSwitchTo(oldcontext);
+		}
+
+		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_DONE, n + 1);
+	}
+
+	table_index_fetch_end(fetch);
+	ExecDropSingleTupleTableSlot(tupslot);
+	FreeExecutorState(estate);
+	pfree(tids);
+
+	elog(DEBUG2,
+		 "index_tidlog_merge checked %.0f logged tuples; inserted %.0f missing tuples",
+		 (double) ntids, tups_inserted);
+
+	/* Roll back any GUC changes executed by index functions */
+	AtEOXact_GUC(false, save_nestlevel);
+
+	/* Restore userid and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	/* Close rels, but keep locks */
+	index_close(indexRelation, NoLock);
+	table_close(heapRelation, NoLock);
+
+	return true;
+}
+
+/*
+ * Detach from other backends' logs at the end of each transaction, and
+ * discard our own log if a transaction of the build aborts.
+ */
+static void
+index_tidlog_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PREPARE:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			if (attached_area != NULL)
+				dsa_detach(attached_area);
+			attached_area = NULL;
+			attached_handle = DSA_HANDLE_INVALID;
+
+			if (owned_slot != NULL &&
+				(event == XACT_EVENT_ABORT ||
+				 event == XACT_EVENT_PARALLEL_ABORT))
+				index_tidlog_release();
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Free our log slot, and detach from its area
+ */
+static void
+index_tidlog_release(void)
+{
+	IndexTidLogSlot *slot = owned_slot;
+
+	/* writers attach only while holding the lock, see index_tidlog_record */
+	LWLockAcquire(&slot->lock, LW_EXCLUSIVE);
+	slot->indexrelid = InvalidOid;
+	slot->dbid = InvalidOid;
+	slot->handle = DSA_HANDLE_INVALID;
+	slot->head = InvalidDsaPointer;
+	slot->overflowed = false;
+	slot->ntids = 0;
+	LWLockRelease(&slot->lock);
+
+	owned_slot = NULL;
+	dsa_detach(owned_area);
+	owned_area = NULL;
+}
+
+static int
+tid_cmp(const void *a, const void *b)
+{
+	return ItemPointerCompare((ItemPointer) a, (ItemPointer) b);
+}
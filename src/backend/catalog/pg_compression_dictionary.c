@@ -0,0 +1,255 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_compression_dictionary.c
+ *	  routines to support manipulation of the pg_compression_dictionary
+ *	  relation
+ *
+ * Dictionaries are created by ANALYZE (see analyze.c) and looked up by the
+ * toaster when it compresses a value of a column that uses zstd.  Entries
+ * are immutable once created and are never deleted; dropping the table
+ * only clears cdrelid, since values compressed with the dictionary may
+ * still exist elsewhere.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/catalog/pg_compression_dictionary.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "catalog/catalog.h"
+#include "catalog/indexing.h"
+#include "catalog/pg_compression_dictionary.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+
+/* Hash table mapping a column to the dictionary its values are compressed with */
+static HTAB *ColumnDictCacheHash = NULL;
+
+/* relid and attnum form the lookup key, and must appear first */
+typedef struct
+{
+	Oid			relid;
+	int			attnum;
+} ColumnDictCacheKey;
+
+typedef struct
+{
+	ColumnDictCacheKey key;		/* lookup key - must be first */
+	Oid			dictid;			/* dictionary, or InvalidOid if none */
+} ColumnDictCacheEntry;
+
+/*
+ * InvalidateColumnDictCacheCallback
+ *		Forget the dictionaries of a relation when its relcache entry is
+ *		invalidated.  ANALYZE sends a relcache invalidation after it creates
+ *		a dictionary, which is what makes other backends start using it.
+ */
+static void
+InvalidateColumnDictCacheCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	ColumnDictCacheEntry *entry;
+
+	hash_seq_init(&status, ColumnDictCacheHash);
+	while ((entry = (ColumnDictCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (OidIsValid(relid) && entry->key.relid != relid)
+			continue;
+		if (hash_search(ColumnDictCacheHash,
+						&entry->key,
+						HASH_REMOVE,
+						NULL) == NULL)
+			elog(ERROR, "hash table corrupted");
+	}
+}
+
+static void
+InitializeColumnDictCache(void)
+{
+	HASHCTL		ctl;
+
+	ctl.keysize = sizeof(ColumnDictCacheKey);
+	ctl.entrysize = sizeof(ColumnDictCacheEntry);
+	ColumnDictCacheHash =
+		hash_create("Column compression dictionary cache", 64, &ctl,
+					HASH_ELEM | HASH_BLOBS);
+
+	CacheRegisterRelcacheCallback(InvalidateColumnDictCacheCallback,
+								  (Datum) 0);
+}
+
+/*
+ * CompressionDictionaryCreate
+ *		Store a new dictionary for the given column and return its OID.
+ */
+Oid
+CompressionDictionaryCreate(Oid relid, AttrNumber attnum, bytea *dict)
+{
+	Relation	cdrel;
+	HeapTuple	tuple;
+	Datum		values[Natts_pg_compression_dictionary];
+	bool		nulls[Natts_pg_compression_dictionary];
+	Oid			dictid;
+
+	cdrel = table_open(CompressionDictionaryRelationId, RowExclusiveLock);
+
+	dictid = GetNewOidWithIndex(cdrel, CompressionDictionaryOidIndexId,
+								Anum_pg_compression_dictionary_oid);
+
+	memset(nulls, false, sizeof(nulls));
+	values[Anum_pg_compression_dictionary_oid - 1] = ObjectIdGetDatum(dictid);
+	values[Anum_pg_compression_dictionary_cdrelid - 1] = ObjectIdGetDatum(relid);
+	values[Anum_pg_compression_dictionary_cdattnum - 1] = Int16GetDatum(attnum);
+	values[Anum_pg_compression_dictionary_cddict - 1] = PointerGetDatum(dict);
+
+	tuple = heap_form_tuple(RelationGetDescr(cdrel), values, nulls);
+	CatalogTupleInsert(cdrel, tuple);
+	heap_freetuple(tuple);
+
+	table_close(cdrel, RowExclusiveLock);
+
+	return dictid;
+}
+
+/*
+ * GetColumnCompressionDictionary
+ *		Return the OID of the newest dictionary trained for the column, or
+ *		InvalidOid if it has none.
+ *
+ * This is called for every value the toaster compresses with zstd, so the
+ * answer is cached per backend.  System catalogs never get dictionaries.
+ */
+Oid
+GetColumnCompressionDictionary(Relation rel, AttrNumber attnum)
+{
+	ColumnDictCacheKey key;
+	ColumnDictCacheEntry *entry;
+	bool		found;
+	Relation	cdrel;
+	SysScanDesc scan;
+	ScanKeyData skey[2];
+	HeapTuple	tuple;
+	Oid			dictid = InvalidOid;
+
+	if (IsCatalogRelation(rel))
+		return InvalidOid;
+
+	if (!ColumnDictCacheHash)
+		InitializeColumnDictCache();
+
+	memset(&key, 0, sizeof(key));	/* make sure any padding bits are unset */
+	key.relid = RelationGetRelid(rel);
+	key.attnum = attnum;
+	entry = (ColumnDictCacheEntry *) hash_search(ColumnDictCacheHash, &key,
+												 HASH_FIND, NULL);
+	if (entry)
+		return entry->dictid;
+
+	cdrel = table_open(CompressionDictionaryRelationId, AccessShareLock);
+
+	ScanKeyInit(&skey[0],
+				Anum_pg_compression_dictionary_cdrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(key.relid));
+	ScanKeyInit(&skey[1],
+				Anum_pg_compression_dictionary_cdattnum,
+				BTEqualStrategyNumber, F_INT2EQ,
+				Int16GetDatum(attnum));
+
+	scan = systable_beginscan(cdrel, CompressionDictionaryRelidAttnumIndexId,
+							  true, NULL, 2, skey);
+	while (HeapTupleIsValid(tuple = systable_getnext(scan)))
+	{
+		Form_pg_compression_dictionary form;
+
+		form = (Form_pg_compression_dictionary) GETSTRUCT(tuple);
+		if (!OidIsValid(dictid) || form->oid > dictid)
+			dictid = form->oid;
+	}
+	systable_endscan(scan);
+
+	table_close(cdrel, AccessShareLock);
+
+	/* the scan may have processed invalidations, so look again */
+	entry = (ColumnDictCacheEntry *) hash_search(ColumnDictCacheHash, &key,
+												 HASH_ENTER, &found);
+	entry->dictid = dictid;
+
+	return dictid;
+}
+
+/*
+ * GetCompressionDictionaryData
+ *		Return a palloc'd copy of the contents of a dictionary.
+ */
+bytea *
+GetCompressionDictionaryData(Oid dictid)
+{
+	HeapTuple	tuple;
+	Datum		datum;
+	bytea	   *result;
+
+	tuple = SearchSysCache1(COMPRESSIONDICTOID, ObjectIdGetDatum(dictid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for compression dictionary %u",
+			 dictid);
+
+	datum = SysCacheGetAttrNotNull(COMPRESSIONDICTOID, tuple,
+								   Anum_pg_compression_dictionary_cddict);
+	result = DatumGetByteaPCopy(datum);
+
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
+/*
+ * CompressionDictionaryDetachRelation
+ *		Disassociate a relation's dictionaries from it, when it's dropped.
+ *
+ * The dictionaries themselves are kept, since compressed values referring
+ * to them may have been copied into other relations.
+ */
+void
+CompressionDictionaryDetachRelation(Oid relid)
+{
+	Relation	cdrel;
+	SysScanDesc scan;
+	ScanKeyData skey;
+	HeapTuple	tuple;
+
+	cdrel = table_open(CompressionDictionaryRelationId, RowExclusiveLock);
+
+	ScanKeyInit(&skey,
+				Anum_pg_compression_dictionary_cdrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(relid));
+
+	scan = systable_beginscan(cdrel, CompressionDictionaryRelidAttnumIndexId,
+							  true, NULL, 1, &skey);
+	while (HeapTupleIsValid(tuple = systable_getnext(scan)))
+	{
+		HeapTuple	newtuple;
+
+		newtuple = heap_copytuple(tuple);
+		((Form_pg_compression_dictionary) GETSTRUCT(newtuple))->cdrelid = InvalidOid;
+		CatalogTupleUpdate(cdrel, &newtuple->t_self, newtuple);
+		heap_freetuple(newtuple);
+	}
+	systable_endscan(scan);
+
+	table_close(cdrel, RowExclusiveLock);
+}
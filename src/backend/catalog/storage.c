@@ -290,7 +290,7 @@ RelationTruncate(Relation rel, BlockNumber nblocks)
 	bool		vm;
 	bool		need_fsm_vacuum = false;
 	ForkNumber	forks[MAX_FORKNUM];
-	BlockNumber blocks[MAX_FORKNUM];  // MAX_FORKNUM是3
+	BlockNumber blocks[MAX_FORKNUM];  // MAX_FORKNUM是4
 	int			nforks = 0;
 	SMgrRelation reln;
 
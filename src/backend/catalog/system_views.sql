@@ -639,6 +639,30 @@ GRANT SELECT ON pg_shmem_allocations TO pg_read_all_stats;
 REVOKE EXECUTE ON FUNCTION pg_get_shmem_allocations() FROM PUBLIC;
 GRANT EXECUTE ON FUNCTION pg_get_shmem_allocations() TO pg_read_all_stats;
 
+CREATE VIEW pg_shmem_allocations_numa AS
+    SELECT * FROM pg_get_shmem_allocations_numa();
+
+REVOKE ALL ON pg_shmem_allocations_numa FROM PUBLIC;
+GRANT SELECT ON pg_shmem_allocations_numa TO pg_read_all_stats;
+REVOKE EXECUTE ON FUNCTION pg_get_shmem_allocations_numa() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_get_shmem_allocations_numa() TO pg_read_all_stats;
+
+CREATE VIEW pg_stat_lwlock_profile AS
+    SELECT * FROM pg_get_lwlock_profile();
+
+REVOKE ALL ON pg_stat_lwlock_profile FROM PUBLIC;
+GRANT SELECT ON pg_stat_lwlock_profile TO pg_read_all_stats;
+REVOKE EXECUTE ON FUNCTION pg_get_lwlock_profile() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_get_lwlock_profile() TO pg_read_all_stats;
+
+CREATE VIEW pg_stat_profile_samples AS
+    SELECT * FROM pg_stat_get_profile_samples();
+
+REVOKE ALL ON pg_stat_profile_samples FROM PUBLIC;
+GRANT SELECT ON pg_stat_profile_samples TO pg_read_all_stats;
+REVOKE EXECUTE ON FUNCTION pg_stat_get_profile_samples() FROM PUBLIC;
+GRANT EXECUTE ON FUNCTION pg_stat_get_profile_samples() TO pg_read_all_stats;
+
 CREATE VIEW pg_backend_memory_contexts AS
     SELECT * FROM pg_get_backend_memory_contexts();
 
@@ -647,6 +671,14 @@ GRANT SELECT ON pg_backend_memory_contexts TO pg_read_all_stats;
 REVOKE EXECUTE ON FUNCTION pg_get_backend_memory_contexts() FROM PUBLIC;
 GRANT EXECUTE ON FUNCTION pg_get_backend_memory_contexts() TO pg_read_all_stats;
 
+CREATE VIEW pg_stat_backend_memory AS
+    SELECT
+            S.pid,
+            A.backend_type,
+            S.allocated_bytes
+    FROM pg_stat_get_backend_memory() S
+        LEFT JOIN pg_stat_activity A USING (pid);
+
 -- Statistics views
 
 CREATE VIEW pg_stat_all_tables AS
@@ -677,7 +709,9 @@ CREATE VIEW pg_stat_all_tables AS
             pg_stat_get_vacuum_count(C.oid) AS vacuum_count,
             pg_stat_get_autovacuum_count(C.oid) AS autovacuum_count,
             pg_stat_get_analyze_count(C.oid) AS analyze_count,
-            pg_stat_get_autoanalyze_count(C.oid) AS autoanalyze_count
+            pg_stat_get_autoanalyze_count(C.oid) AS autoanalyze_count,
+            pg_stat_get_eager_frozen_pages(C.oid) AS eager_frozen_pages,
+            pg_stat_get_freeze_debt_pages(C.oid) AS freeze_debt_pages
     FROM pg_class C LEFT JOIN
          pg_index I ON C.oid = I.indrelid
          LEFT JOIN pg_namespace N ON (N.oid = C.relnamespace)
@@ -725,6 +759,20 @@ CREATE VIEW pg_stat_xact_user_tables AS
     WHERE schemaname NOT IN ('pg_catalog', 'information_schema') AND
           schemaname !~ '^pg_toast';
 
+CREATE VIEW pg_stat_autovacuum_queue AS
+    SELECT
+            Q.relid,
+            N.nspname AS schemaname,
+            C.relname,
+            Q.needs_vacuum,
+            Q.needs_analyze,
+            Q.for_wraparound,
+            Q.priority
+    FROM pg_stat_get_autovacuum_queue() AS Q
+         JOIN pg_class C ON C.oid = Q.relid
+         LEFT JOIN pg_namespace N ON N.oid = C.relnamespace
+    ORDER BY Q.for_wraparound DESC, Q.priority DESC;
+
 CREATE VIEW pg_statio_all_tables AS
     SELECT
             C.oid AS relid,
@@ -867,7 +915,12 @@ CREATE VIEW pg_stat_activity AS
             s.backend_xmin,
             S.query_id,
             S.query,
-            S.backend_type
+            S.backend_type,
+            S.cpu_user_time,
+            S.cpu_system_time,
+            S.memory_allocated,
+            S.read_bytes,
+            S.write_bytes
     FROM pg_stat_get_activity(NULL) AS S
         LEFT JOIN pg_database AS D ON (S.datid = D.oid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
@@ -1016,6 +1069,7 @@ CREATE VIEW pg_stat_replication_slots AS
             s.stream_bytes,
             s.total_txns,
             s.total_bytes,
+            s.snapshot_build_time,
             s.stats_reset
     FROM pg_replication_slots as r,
         LATERAL pg_stat_get_replication_slot(slot_name) as s
@@ -1054,6 +1108,10 @@ CREATE VIEW pg_stat_database AS
             pg_stat_get_db_sessions_abandoned(D.oid) AS sessions_abandoned,
             pg_stat_get_db_sessions_fatal(D.oid) AS sessions_fatal,
             pg_stat_get_db_sessions_killed(D.oid) AS sessions_killed,
+            pg_stat_get_db_cpu_user_time(D.oid) AS cpu_user_time,
+            pg_stat_get_db_cpu_system_time(D.oid) AS cpu_system_time,
+            pg_stat_get_db_read_bytes(D.oid) AS read_bytes,
+            pg_stat_get_db_write_bytes(D.oid) AS write_bytes,
             pg_stat_get_db_stat_reset_time(D.oid) AS stats_reset
     FROM (
         SELECT 0 AS oid, NULL::name AS datname
@@ -1085,6 +1143,48 @@ CREATE VIEW pg_stat_user_functions AS
     WHERE P.prolang != 12  -- fast check to eliminate built-in functions
           AND pg_stat_get_function_calls(P.oid) IS NOT NULL;
 
+CREATE VIEW pg_stat_planning AS
+    SELECT
+            P.queryid,
+            P.plans,
+            P.total_plan_time,
+            P.expand_time,
+            P.path_time,
+            P.join_time,
+            P.selectivity_time,
+            P.selectivity_calls,
+            P.paths_considered,
+            P.joinrels_built,
+            P.max_memory,
+            P.stats_reset
+    FROM pg_stat_get_planning() P;
+
+CREATE VIEW pg_stat_queries AS
+    SELECT
+            Q.queryid,
+            Q.calls,
+            Q.total_exec_time,
+            Q.min_exec_time,
+            Q.max_exec_time,
+            Q.p50_exec_time,
+            Q.p90_exec_time,
+            Q.p99_exec_time,
+            Q.exec_time_histogram,
+            Q.rows,
+            Q.shared_blks_hit,
+            Q.shared_blks_read,
+            Q.shared_blks_dirtied,
+            Q.shared_blks_written,
+            Q.local_blks_hit,
+            Q.local_blks_read,
+            Q.temp_blks_read,
+            Q.temp_blks_written,
+            Q.wal_records,
+            Q.wal_fpi,
+            Q.wal_bytes,
+            Q.stats_reset
+    FROM pg_stat_get_queries() Q;
+
 CREATE VIEW pg_stat_xact_user_functions AS
     SELECT
             P.oid AS funcid,
@@ -1122,6 +1222,9 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_checkpointer_history AS
+    SELECT * FROM pg_stat_get_checkpointer_samples();
+
 CREATE VIEW pg_stat_io AS
 SELECT
        b.backend_type,
@@ -1144,12 +1247,45 @@ SELECT
        b.stats_reset
 FROM pg_stat_get_io() b;
 
+CREATE VIEW pg_stat_io_histogram AS
+SELECT
+       b.backend_type,
+       b.object,
+       b.context,
+       b.op,
+       b.time_histogram,
+       b.stats_reset
+FROM pg_stat_get_io_histogram() b;
+
+CREATE VIEW pg_stat_io_tablespace AS
+    SELECT
+            T.oid AS spcoid,
+            T.spcname,
+            S.op,
+            S.count,
+            S.total_time,
+            S.time_histogram,
+            S.stats_reset
+    FROM pg_tablespace T,
+         pg_stat_get_tablespace_io(T.oid) S;
+
+CREATE VIEW pg_stat_wait_events AS
+    SELECT
+        w.wait_event_type,
+        w.wait_event,
+        w.calls,
+        w.total_time,
+        w.stats_reset
+    FROM pg_stat_get_wait_events() w;
+
 CREATE VIEW pg_stat_wal AS
     SELECT
         w.wal_records,
         w.wal_fpi,
         w.wal_bytes,
         w.wal_buffers_full,
+        w.wal_buffers_init,
+        w.wal_segments_created,
         w.wal_write,
         w.wal_sync,
         w.wal_write_time,
@@ -1157,6 +1293,36 @@ CREATE VIEW pg_stat_wal AS
         w.stats_reset
     FROM pg_stat_get_wal() w;
 
+CREATE VIEW pg_stat_wal_rmgrs AS
+    SELECT
+        w.rmgr,
+        w.wal_records,
+        w.wal_fpi,
+        w.wal_bytes,
+        w.stats_reset
+    FROM pg_stat_get_wal_rmgrs() w;
+
+CREATE VIEW pg_stat_dsm_cache AS
+    SELECT
+        d.hits,
+        d.misses
+    FROM pg_stat_get_dsm_cache() d;
+
+CREATE VIEW pg_stat_wal_relations AS
+    SELECT
+            C.oid AS relid,
+            N.nspname AS schemaname,
+            C.relname AS relname,
+            C.relkind AS relkind,
+            W.wal_records,
+            W.wal_fpi,
+            W.wal_bytes,
+            W.stats_reset
+    FROM pg_class C LEFT JOIN pg_namespace N ON (N.oid = C.relnamespace),
+         pg_stat_get_wal_relation(C.relisshared,
+                                  pg_relation_filenode(C.oid)) W
+    WHERE C.relkind IN ('r', 't', 'm', 'i', 'S') AND W.wal_records > 0;
+
 CREATE VIEW pg_stat_progress_analyze AS
     SELECT
         S.pid AS pid, S.datid AS datid, D.datname AS datname,
@@ -1192,7 +1358,8 @@ CREATE VIEW pg_stat_progress_vacuum AS
                       END AS phase,
         S.param2 AS heap_blks_total, S.param3 AS heap_blks_scanned,
         S.param4 AS heap_blks_vacuumed, S.param5 AS index_vacuum_count,
-        S.param6 AS max_dead_tuples, S.param7 AS num_dead_tuples
+        S.param6 AS max_dead_tuple_bytes, S.param8 AS dead_tuple_bytes,
+        S.param7 AS num_dead_tuples
     FROM pg_stat_get_progress_info('VACUUM') AS S
         LEFT JOIN pg_database D ON S.datid = D.oid;
 
@@ -1294,6 +1461,14 @@ CREATE VIEW pg_stat_progress_copy AS
     FROM pg_stat_get_progress_info('COPY') AS S
         LEFT JOIN pg_database D ON S.datid = D.oid;
 
+CREATE VIEW pg_stat_progress_temp_files AS
+    SELECT
+        S.pid, S.datid, D.datname, S.query_id,
+        S.plan_node_id, S.node_type, S.files,
+        S.size, S.peak_size, S.bytes_written
+    FROM pg_stat_get_progress_temp_files() AS S
+        LEFT JOIN pg_database D ON S.datid = D.oid;
+
 CREATE VIEW pg_user_mappings AS
     SELECT
         U.oid       AS umid,
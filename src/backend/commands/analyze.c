@@ -19,10 +19,12 @@
 #include "access/detoast.h"
 #include "access/genam.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/relation.h"
 #include "access/sysattr.h"
 #include "access/table.h"
 #include "access/tableam.h"
+#include "access/toast_compression.h"
 #include "access/transam.h"
 #include "access/tupconvert.h"
 #include "access/visibilitymap.h"
@@ -31,6 +33,7 @@
 #include "catalog/index.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_collation.h"
+#include "catalog/pg_compression_dictionary.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_namespace.h"
 #include "catalog/pg_statistic_ext.h"
@@ -40,6 +43,7 @@
 #include "commands/vacuum.h"
 #include "common/pg_prng.h"
 #include "executor/executor.h"
+#include "executor/instrument.h"
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
@@ -53,18 +57,22 @@
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "storage/read_stream.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "tcop/tcopprot.h"
 #include "utils/acl.h"
 #include "utils/attoptcache.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/sampling.h"
 #include "utils/sortsupport.h"
-#include "utils/spccache.h"
 #include "utils/syscache.h"
 #include "utils/timestamp.h"
 
@@ -82,9 +90,86 @@ typedef struct AnlIndexData
 /* Default statistics target (GUC parameter) */
 int			default_statistics_target = 100;
 
+/*
+ * Compression dictionary training.  zstd suggests a sample of about 100
+ * times the dictionary size; fewer values than the minimum can't give a
+ * useful dictionary.
+ */
+#define COMPRESSION_DICT_SIZE				(32 * 1024)
+#define COMPRESSION_DICT_MAX_SAMPLE_BYTES	(100 * COMPRESSION_DICT_SIZE)
+#define COMPRESSION_DICT_MIN_SAMPLES		100
+
+/*
+ * Parallel sample acquisition.  The leader chooses the sample blocks as usual
+ * and publishes them in shared memory.  Each participant claims chunks of
+ * that list and keeps its own reservoir of rows; workers send theirs back
+ * through a tuple queue, and the leader combines all of them into a single
+ * sample.
+ */
+#define PARALLEL_ANALYZE_KEY_SHARED			1
+#define PARALLEL_ANALYZE_KEY_QUEUES			2
+#define PARALLEL_ANALYZE_KEY_BUFFER_USAGE	3
+#define PARALLEL_ANALYZE_KEY_WAL_USAGE		4
+#define PARALLEL_ANALYZE_KEY_QUERY_TEXT		5
+
+/* Size of each worker's tuple queue */
+#define PARALLEL_ANALYZE_QUEUE_SIZE			65536
+
+/* Number of sample blocks a participant claims at a time */
+#define PARALLEL_ANALYZE_CHUNK_BLOCKS		64
+
+/* Sample blocks per worker when the number of workers isn't specified */
+#define PARALLEL_ANALYZE_BLOCKS_PER_WORKER	8192
+
+/*
+ * Shared information for parallel sample acquisition
+ */
+typedef struct ParallelAnalyzeShared
+{
+	Oid			relid;
+	TransactionId OldestXmin;
+	int			targrows;
+	int			ring_nbuffers;	/* size of the leader's buffer ring */
+
+	/*
+	 * Cost-based delay parameters and shared cost balance, handled the same
+	 * way as in PVShared.
+	 */
+	double		cost_delay;
+	int			cost_limit;
+	pg_atomic_uint32 cost_balance;
+	pg_atomic_uint32 active_nworkers;
+
+	/* Next entry of blocks[] to hand out, and number of blocks sampled */
+	pg_atomic_uint32 nextblock;
+	pg_atomic_uint32 blocksdone;
+
+	/* The sample blocks, in increasing order */
+	BlockNumber nblocks;
+	BlockNumber blocks[FLEXIBLE_ARRAY_MEMBER];
+} ParallelAnalyzeShared;
+
+/* Chunk of the shared block list a participant is working on */
+typedef struct ParallelAnalyzeScan
+{
+	ParallelAnalyzeShared *shared;
+	BlockNumber next;
+	BlockNumber end;
+} ParallelAnalyzeScan;
+
+/* Totals of one worker, sent ahead of its sample rows */
+typedef struct ParallelAnalyzeResult
+{
+	double		samplerows;
+	double		liverows;
+	double		deadrows;
+	int			numrows;
+} ParallelAnalyzeResult;
+
 /* A few variables that don't seem worth passing around as parameters */
 static MemoryContext anl_context = NULL;
 static BufferAccessStrategy vac_strategy;
+static int	analyze_nworkers;
 
 
 static void do_analyze_rel(Relation onerel,
@@ -95,11 +180,27 @@ static void compute_index_stats(Relation onerel, double totalrows,
 								AnlIndexData *indexdata, int nindexes,
 								HeapTuple *rows, int numrows,
 								MemoryContext col_context);
+static void build_compression_dictionaries(Relation onerel, int elevel,
+										   HeapTuple *rows, int numrows,
+										   int attr_cnt,
+										   VacAttrStats **vacattrstats);
 static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 									   Node *index_expr);
 static int	acquire_sample_rows(Relation onerel, int elevel,
 								HeapTuple *rows, int targrows,
 								double *totalrows, double *totaldeadrows);
+static void sample_block_rows(Relation onerel, BufferAccessStrategy strategy,
+							  ReadStreamBlockNumberCB next_block_cb,
+							  void *cb_data, TransactionId OldestXmin,
+							  HeapTuple *rows, int targrows, int *numrows,
+							  double *samplerows, double *liverows,
+							  double *deadrows, pg_atomic_uint32 *blocksdone);
+static int	analyze_parallel_workers(Relation onerel, BlockNumber nblocks);
+static int	acquire_sample_rows_parallel(Relation onerel, int nworkers,
+										 BlockSamplerData *bs,
+										 TransactionId OldestXmin,
+										 HeapTuple *rows, int targrows,
+										 double *liverows, double *deadrows);
 static int	compare_rows(const void *a, const void *b, void *arg);
 static int	acquire_inherited_sample_rows(Relation onerel, int elevel,
 										  HeapTuple *rows, int targrows,
@@ -135,6 +236,7 @@ analyze_rel(Oid relid, RangeVar *relation,
 
 	/* Set up static variables */
 	vac_strategy = bstrategy;
+	analyze_nworkers = params->nworkers;
 
 	/*
 	 * Check for user-requested abort.
@@ -614,6 +716,11 @@ do_analyze_rel(Relation onerel, VacuumParams *params,
 		/* Build extended statistics (if there are any). */
 		BuildRelationExtStatistics(onerel, inh, totalrows, numrows, rows,
 								   attr_cnt, vacattrstats);
+
+		/* Train zstd dictionaries for columns that asked for one. */
+		if (!inh)
+			build_compression_dictionaries(onerel, elevel, rows, numrows,
+										   attr_cnt, vacattrstats);
 	}
 
 	pgstat_progress_update_param(PROGRESS_ANALYZE_PHASE,
@@ -988,6 +1095,114 @@ compute_index_stats(Relation onerel, double totalrows,
 	MemoryContextDelete(ind_context);
 }
 
+/*
+ * build_compression_dictionaries -- train zstd dictionaries from the sample
+ *
+ * A dictionary is built for each analyzed column that uses zstd compression,
+ * has the compression_dictionary option set, and doesn't have a dictionary
+ * yet.  Values compressed before the dictionary existed carry no dictionary
+ * reference and stay readable; only values toasted from now on use it.
+ */
+static void
+build_compression_dictionaries(Relation onerel, int elevel,
+							   HeapTuple *rows, int numrows,
+							   int attr_cnt, VacAttrStats **vacattrstats)
+{
+	MemoryContext dict_context;
+	MemoryContext old_context;
+	int			i;
+
+	if (IsCatalogRelation(onerel) ||
+		onerel->rd_rel->relkind == RELKIND_FOREIGN_TABLE ||
+		numrows < COMPRESSION_DICT_MIN_SAMPLES)
+		return;
+
+	dict_context = AllocSetContextCreate(anl_context,
+										 "Analyze Dictionary",
+										 ALLOCSET_DEFAULT_SIZES);
+	old_context = MemoryContextSwitchTo(dict_context);
+
+	for (i = 0; i < attr_cnt; i++)
+	{
+		Form_pg_attribute attr = vacattrstats[i]->attr;
+		AttrNumber	attnum = attr->attnum;
+		char		cmethod = attr->attcompression;
+		AttributeOpts *aopt;
+		char	   *samples;
+		size_t	   *samplesizes;
+		size_t		totalsize = 0;
+		int			nsamples = 0;
+		int			j;
+		bytea	   *dict;
+
+		if (attr->attlen != -1 || attr->attstorage == TYPSTORAGE_PLAIN)
+			continue;
+		if (!CompressionMethodIsValid(cmethod))
+			cmethod = default_toast_compression;
+		if (cmethod != TOAST_ZSTD_COMPRESSION)
+			continue;
+		aopt = get_attribute_options(onerel->rd_id, attnum);
+		if (aopt == NULL || !aopt->compression_dictionary)
+			continue;
+		if (OidIsValid(GetColumnCompressionDictionary(onerel, attnum)))
+			continue;
+
+		samples = palloc(COMPRESSION_DICT_MAX_SAMPLE_BYTES);
+		samplesizes = palloc(numrows * sizeof(size_t));
+
+		for (j = 0; j < numrows; j++)
+		{
+			Datum		value;
+			bool		isnull;
+			struct varlena *raw;
+			size_t		len;
+
+			value = heap_getattr(rows[j], attnum, onerel->rd_att, &isnull);
+			if (isnull)
+				continue;
+
+			raw = detoast_attr((struct varlena *) DatumGetPointer(value));
+			len = VARSIZE_ANY_EXHDR(raw);
+			if (len == 0 || totalsize + len > COMPRESSION_DICT_MAX_SAMPLE_BYTES)
+				continue;
+
+			memcpy(samples + totalsize, VARDATA_ANY(raw), len);
+			samplesizes[nsamples++] = len;
+			totalsize += len;
+
+			if ((Pointer) raw != DatumGetPointer(value))
+				pfree(raw);
+		}
+
+		if (nsamples >= COMPRESSION_DICT_MIN_SAMPLES)
+		{
+			dict = zstd_train_dictionary(samples, samplesizes, nsamples,
+										 COMPRESSION_DICT_SIZE);
+			if (dict != NULL)
+			{
+				Oid			dictid;
+
+				dictid = CompressionDictionaryCreate(RelationGetRelid(onerel),
+													 attnum, dict);
+				ereport(elevel,
+						(errmsg("created compression dictionary %u for column \"%s\" of \"%s.%s\" from %d values",
+								dictid, NameStr(attr->attname),
+								get_namespace_name(RelationGetNamespace(onerel)),
+								RelationGetRelationName(onerel),
+								nsamples)));
+
+				/* make every backend's toaster notice the new dictionary */
+				CacheInvalidateRelcache(onerel);
+			}
+		}
+
+		MemoryContextResetAndDeleteChildren(dict_context);
+	}
+
+	MemoryContextSwitchTo(old_context);
+	MemoryContextDelete(dict_context);
+}
+
 /*
  * examine_attribute -- pre-analysis of a single column
  *
@@ -1096,83 +1311,70 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 }
 
 /*
- * acquire_sample_rows -- acquire a random sample of rows from the table
- *
- * Selected rows are returned in the caller-allocated array rows[], which
- * must have at least targrows entries.
- * The actual number of rows selected is returned as the function result.
- * We also estimate the total numbers of live and dead rows in the table,
- * and return them into *totalrows and *totaldeadrows, respectively.
- *
- * The returned list of tuples is in order by physical position in the table.
- * (We will rely on this later to derive correlation estimates.)
- *
- * As of May 2004 we use a new two-stage method:  Stage one selects up
- * to targrows random blocks (or all blocks, if there aren't so many).
- * Stage two scans these blocks and uses the Vitter algorithm to create
- * a random sample of targrows rows (or less, if there are less in the
- * sample of blocks).  The two stages are executed simultaneously: each
- * block is processed as soon as stage one returns its number and while
- * the rows are read stage two controls which ones are to be inserted
- * into the sample.
+ * Read stream callback returning the next BlockNumber as chosen by the
+ * BlockSampling algorithm.
+ */
+static BlockNumber
+block_sampling_read_stream_next(ReadStream *stream,
+								void *callback_private_data,
+								void *per_buffer_data)
+{
+	BlockSamplerData *bs = callback_private_data;
+
+	return BlockSampler_HasMore(bs) ? BlockSampler_Next(bs) : InvalidBlockNumber;
+}
+
+/*
+ * Read stream callback handing out the sample blocks published for a
+ * parallel ANALYZE, a chunk at a time.
+ */
+static BlockNumber
+parallel_analyze_read_stream_next(ReadStream *stream,
+								  void *callback_private_data,
+								  void *per_buffer_data)
+{
+	ParallelAnalyzeScan *scan = callback_private_data;
+	ParallelAnalyzeShared *shared = scan->shared;
+
+	if (scan->next >= scan->end)
+	{
+		BlockNumber start;
+
+		start = pg_atomic_fetch_add_u32(&shared->nextblock,
+										PARALLEL_ANALYZE_CHUNK_BLOCKS);
+		if (start >= shared->nblocks)
+			return InvalidBlockNumber;
+		scan->next = start;
+		scan->end = Min(start + PARALLEL_ANALYZE_CHUNK_BLOCKS,
+						shared->nblocks);
+	}
+
+	return shared->blocks[scan->next++];
+}
+
+/*
+ * sample_block_rows -- collect a reservoir sample from a stream of blocks
  *
- * Although every row has an equal chance of ending up in the final
- * sample, this sampling method is not perfect: not every possible
- * sample has an equal chance of being selected.  For large relations
- * the number of different blocks represented by the sample tends to be
- * too small.  We can live with that for now.  Improvements are welcome.
+ * Reads the blocks returned by next_block_cb and keeps a random sample of at
+ * most targrows of their rows in rows[], returning its size in *numrows.  The
+ * numbers of rows seen are added to *samplerows, *liverows and *deadrows.
  *
- * An important property of this sampling method is that because we do
- * look at a statistically unbiased set of blocks, we should get
- * unbiased estimates of the average numbers of live and dead rows per
- * block.  The previous sampling method put too much credence in the row
- * density near the start of the table.
+ * If blocksdone is not NULL, it is a counter shared by the participants of a
+ * parallel ANALYZE, which only the leader reports as progress.
  */
-static int
-acquire_sample_rows(Relation onerel, int elevel,
-					HeapTuple *rows, int targrows,
-					double *totalrows, double *totaldeadrows)
+static void
+sample_block_rows(Relation onerel, BufferAccessStrategy strategy,
+				  ReadStreamBlockNumberCB next_block_cb, void *cb_data,
+				  TransactionId OldestXmin, HeapTuple *rows, int targrows,
+				  int *numrows, double *samplerows, double *liverows,
+				  double *deadrows, pg_atomic_uint32 *blocksdone)
 {
-	int			numrows = 0;	/* # rows now in reservoir */
-	double		samplerows = 0; /* total # rows collected */
-	double		liverows = 0;	/* # live rows seen */
-	double		deadrows = 0;	/* # dead rows seen */
 	double		rowstoskip = -1;	/* -1 means not set yet */
-	uint32		randseed;		/* Seed for block sampler(s) */
-	BlockNumber totalblocks;
-	TransactionId OldestXmin;
-	BlockSamplerData bs;
 	ReservoirStateData rstate;
 	TupleTableSlot *slot;
 	TableScanDesc scan;
-	BlockNumber nblocks;
 	BlockNumber blksdone = 0;
-#ifdef USE_PREFETCH
-	int			prefetch_maximum = 0;	/* blocks to prefetch if enabled */
-	BlockSamplerData prefetch_bs;
-#endif
-
-	Assert(targrows > 0);
-
-	totalblocks = RelationGetNumberOfBlocks(onerel);
-
-	/* Need a cutoff xmin for HeapTupleSatisfiesVacuum */
-	OldestXmin = GetOldestNonRemovableTransactionId(onerel);
-
-	/* Prepare for sampling block numbers */
-	randseed = pg_prng_uint32(&pg_global_prng_state);
-	nblocks = BlockSampler_Init(&bs, totalblocks, targrows, randseed);
-
-#ifdef USE_PREFETCH
-	prefetch_maximum = get_tablespace_maintenance_io_concurrency(onerel->rd_rel->reltablespace);
-	/* Create another BlockSampler, using the same seed, for prefetching */
-	if (prefetch_maximum)
-		(void) BlockSampler_Init(&prefetch_bs, totalblocks, targrows, randseed);
-#endif
-
-	/* Report sampling block numbers */
-	pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_TOTAL,
-								 nblocks);
+	ReadStream *stream;
 
 	/* Prepare for sampling rows */
 	reservoir_init_selection_state(&rstate, targrows);
@@ -1180,72 +1382,20 @@ acquire_sample_rows(Relation onerel, int elevel,
 	scan = table_beginscan_analyze(onerel);
 	slot = table_slot_create(onerel, NULL);
 
-#ifdef USE_PREFETCH
-
-	/*
-	 * If we are doing prefetching, then go ahead and tell the kernel about
-	 * the first set of pages we are going to want.  This also moves our
-	 * iterator out ahead of the main one being used, where we will keep it so
-	 * that we're always pre-fetching out prefetch_maximum number of blocks
-	 * ahead.
-	 */
-	if (prefetch_maximum)
-	{
-		for (int i = 0; i < prefetch_maximum; i++)
-		{
-			BlockNumber prefetch_block;
-
-			if (!BlockSampler_HasMore(&prefetch_bs))
-				break;
-
-			prefetch_block = BlockSampler_Next(&prefetch_bs);
-			PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM, prefetch_block);
-		}
-	}
-#endif
+	stream = read_stream_begin_relation(READ_STREAM_MAINTENANCE,
+										strategy,
+										scan->rs_rd,
+										MAIN_FORKNUM,
+										next_block_cb,
+										cb_data,
+										0);
 
 	/* Outer loop over blocks to sample */
-	while (BlockSampler_HasMore(&bs))
+	while (table_scan_analyze_next_block(scan, stream))
 	{
-		bool		block_accepted;
-		BlockNumber targblock = BlockSampler_Next(&bs);
-#ifdef USE_PREFETCH
-		BlockNumber prefetch_targblock = InvalidBlockNumber;
-
-		/*
-		 * Make sure that every time the main BlockSampler is moved forward
-		 * that our prefetch BlockSampler also gets moved forward, so that we
-		 * always stay out ahead.
-		 */
-		if (prefetch_maximum && BlockSampler_HasMore(&prefetch_bs))
-			prefetch_targblock = BlockSampler_Next(&prefetch_bs);
-#endif
-
 		vacuum_delay_point();
 
-		block_accepted = table_scan_analyze_next_block(scan, targblock, vac_strategy);
-
-#ifdef USE_PREFETCH
-
-		/*
-		 * When pre-fetching, after we get a block, tell the kernel about the
-		 * next one we will want, if there's any left.
-		 *
-		 * We want to do this even if the table_scan_analyze_next_block() call
-		 * above decides against analyzing the block it picked.
-		 */
-		if (prefetch_maximum && prefetch_targblock != InvalidBlockNumber)
-			PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM, prefetch_targblock);
-#endif
-
-		/*
-		 * Don't analyze if table_scan_analyze_next_block() indicated this
-		 * block is unsuitable for analyzing.
-		 */
-		if (!block_accepted)
-			continue;
-
-		while (table_scan_analyze_next_tuple(scan, OldestXmin, &liverows, &deadrows, slot))
+		while (table_scan_analyze_next_tuple(scan, OldestXmin, liverows, deadrows, slot))
 		{
 			/*
 			 * The first targrows sample rows are simply copied into the
@@ -1259,8 +1409,8 @@ acquire_sample_rows(Relation onerel, int elevel,
 			 * passed over so far, so when we fall off the end of the relation
 			 * we're done.
 			 */
-			if (numrows < targrows)
-				rows[numrows++] = ExecCopySlotHeapTuple(slot);
+			if (*numrows < targrows)
+				rows[(*numrows)++] = ExecCopySlotHeapTuple(slot);
 			else
 			{
 				/*
@@ -1269,7 +1419,7 @@ acquire_sample_rows(Relation onerel, int elevel,
 				 * use the not-yet-incremented value of samplerows as t.
 				 */
 				if (rowstoskip < 0)
-					rowstoskip = reservoir_get_next_S(&rstate, samplerows, targrows);
+					rowstoskip = reservoir_get_next_S(&rstate, *samplerows, targrows);
 
 				if (rowstoskip <= 0)
 				{
@@ -1287,25 +1437,552 @@ acquire_sample_rows(Relation onerel, int elevel,
 				rowstoskip -= 1;
 			}
 
-			samplerows += 1;
+			*samplerows += 1;
 		}
 
-		pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_DONE,
-									 ++blksdone);
+		if (blocksdone == NULL)
+			pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_DONE,
+										 ++blksdone);
+		else
+		{
+			blksdone = pg_atomic_add_fetch_u32(blocksdone, 1);
+			if (!IsParallelWorker())
+				pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_DONE,
+											 blksdone);
+		}
 	}
 
+	read_stream_end(stream);
+
 	ExecDropSingleTupleTableSlot(slot);
 	table_endscan(scan);
+}
+
+/*
+ * Compute the number of parallel workers to acquire the sample of a table
+ * from nblocks sample blocks.  Returns 0 when the sample should be acquired
+ * by the leader alone.
+ */
+static int
+analyze_parallel_workers(Relation onerel, BlockNumber nblocks)
+{
+	int			nworkers;
+
+	/*
+	 * Autovacuum never asks for workers, and neither can we launch any when
+	 * already in parallel mode or for a relation in local buffers.
+	 */
+	if (analyze_nworkers < 0 || IsInParallelMode() ||
+		max_parallel_maintenance_workers == 0 ||
+		RelationUsesLocalBuffers(onerel))
+		return 0;
+
+	if (analyze_nworkers > 0)
+		nworkers = analyze_nworkers;
+	else
+	{
+		/* Use the parallel_workers reloption, if set, else the sample size */
+		nworkers = RelationGetParallelWorkers(onerel, -1);
+		if (nworkers < 0)
+			nworkers = nblocks / PARALLEL_ANALYZE_BLOCKS_PER_WORKER;
+	}
+
+	return Min(nworkers, max_parallel_maintenance_workers);
+}
+
+/*
+ * Receive the next message from a parallel ANALYZE worker.
+ */
+static void *
+parallel_analyze_receive(shm_mq_handle *mqh, Size *nbytes)
+{
+	void	   *data;
+
+	if (shm_mq_receive(mqh, nbytes, &data, false) != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("lost connection to parallel worker")));
+
+	return data;
+}
+
+/*
+ * acquire_sample_rows_parallel -- acquire_sample_rows with parallel workers
+ *
+ * The sample blocks chosen by bs are read by the leader and nworkers workers
+ * together, each keeping a random sample of the rows it sees.  Participant i
+ * has seen n[i] rows; to turn the per-participant samples into a random
+ * sample of all rows, the number of rows taken from each is drawn from the
+ * multivariate hypergeometric distribution over n[], and that many rows are
+ * then chosen at random from the participant's sample.
+ *
+ * Returns the number of rows in rows[], whose order is arbitrary, and sets
+ * *liverows and *deadrows to the numbers of live and dead rows seen.
+ */
+static int
+acquire_sample_rows_parallel(Relation onerel, int nworkers,
+							 BlockSamplerData *bs, TransactionId OldestXmin,
+							 HeapTuple *rows, int targrows,
+							 double *liverows, double *deadrows)
+{
+	ParallelContext *pcxt;
+	ParallelAnalyzeShared *shared;
+	ParallelAnalyzeScan scan;
+	ParallelAnalyzeResult *results;
+	shm_mq_handle **mqhs;
+	char	   *queues;
+	BufferUsage *buffer_usage;
+	WalUsage   *wal_usage;
+	Size		est_shared;
+	Size		querylen = 0;
+	BlockNumber nblocks = 0;
+	int			nparticipants;
+	int		   *nselect;
+	double	   *remaining;
+	double		remtotal = 0;
+	int			ntarget;
+	int			numrows = 0;
+	int			nkept;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "parallel_analyze_main",
+								 nworkers);
+
+	/* Estimate size for shared information -- PARALLEL_ANALYZE_KEY_SHARED */
+	est_shared = add_size(offsetof(ParallelAnalyzeShared, blocks),
+						  mul_size(sizeof(BlockNumber), Min(bs->n, bs->N)));
+	shm_toc_estimate_chunk(&pcxt->estimator, est_shared);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for tuple queues -- PARALLEL_ANALYZE_KEY_QUEUES */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(PARALLEL_ANALYZE_QUEUE_SIZE,
+									pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/*
+	 * Estimate space for BufferUsage and WalUsage --
+	 * PARALLEL_ANALYZE_KEY_BUFFER_USAGE and PARALLEL_ANALYZE_KEY_WAL_USAGE.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_ANALYZE_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
+	InitializeParallelDSM(pcxt);
+
+	/* Publish the sample blocks */
+	shared = (ParallelAnalyzeShared *) shm_toc_allocate(pcxt->toc, est_shared);
+	while (BlockSampler_HasMore(bs))
+		shared->blocks[nblocks++] = BlockSampler_Next(bs);
+	shared->nblocks = nblocks;
+	shared->relid = RelationGetRelid(onerel);
+	shared->OldestXmin = OldestXmin;
+	shared->targrows = targrows;
+	shared->ring_nbuffers = GetAccessStrategyBufferCount(vac_strategy);
+	pg_atomic_init_u32(&shared->nextblock, 0);
+	pg_atomic_init_u32(&shared->blocksdone, 0);
+
+	/*
+	 * Set up shared cost balance and the number of active workers for vacuum
+	 * delay, and pass our delay parameters along.
+	 */
+	pg_atomic_init_u32(&shared->cost_balance, VacuumCostBalance);
+	pg_atomic_init_u32(&shared->active_nworkers, 0);
+	shared->cost_delay = VacuumCostActive ? vacuum_cost_delay : 0;
+	shared->cost_limit = vacuum_cost_limit;
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_SHARED, shared);
+
+	/* Create a tuple queue for each worker, with us as the receiver */
+	queues = shm_toc_allocate(pcxt->toc,
+							  mul_size(PARALLEL_ANALYZE_QUEUE_SIZE,
+									   pcxt->nworkers));
+	mqhs = palloc(sizeof(shm_mq_handle *) * Max(pcxt->nworkers, 1));
+	for (int i = 0; i < pcxt->nworkers; i++)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queues + i * PARALLEL_ANALYZE_QUEUE_SIZE,
+						   PARALLEL_ANALYZE_QUEUE_SIZE);
+		shm_mq_set_receiver(mq, MyProc);
+		mqhs[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_QUEUES, queues);
+
+	buffer_usage = shm_toc_allocate(pcxt->toc,
+									mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_BUFFER_USAGE, buffer_usage);
+	wal_usage = shm_toc_allocate(pcxt->toc,
+								 mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_WAL_USAGE, wal_usage);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		sharedquery[querylen] = '\0';
+		shm_toc_insert(pcxt->toc,
+					   PARALLEL_ANALYZE_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	LaunchParallelWorkers(pcxt);
+
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+		shm_mq_set_handle(mqhs[i], pcxt->worker[i].bgwhandle);
+
+	if (pcxt->nworkers_launched > 0)
+	{
+		/* Enable shared cost balance for the leader */
+		VacuumCostBalance = 0;
+		VacuumCostBalanceLocal = 0;
+		VacuumSharedCostBalance = &(shared->cost_balance);
+		VacuumActiveNWorkers = &(shared->active_nworkers);
+	}
+
+	/* Participate as a worker ourselves */
+	nparticipants = pcxt->nworkers_launched + 1;
+	results = palloc0(sizeof(ParallelAnalyzeResult) * nparticipants);
+
+	scan.shared = shared;
+	scan.next = scan.end = 0;
+	if (VacuumActiveNWorkers)
+		pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+	sample_block_rows(onerel, vac_strategy,
+					  parallel_analyze_read_stream_next, &scan,
+					  OldestXmin, rows, targrows, &results[0].numrows,
+					  &results[0].samplerows, &results[0].liverows,
+					  &results[0].deadrows, &shared->blocksdone);
+	if (VacuumActiveNWorkers)
+		pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+
+	/* Collect the totals of every worker */
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+	{
+		Size		nbytes;
+		void	   *data;
+
+		data = parallel_analyze_receive(mqhs[i], &nbytes);
+		Assert(nbytes == sizeof(ParallelAnalyzeResult));
+		memcpy(&results[i + 1], data, sizeof(ParallelAnalyzeResult));
+	}
+
+	/*
+	 * Decide how many sample rows to take from each participant, by drawing
+	 * the final sample's rows one at a time without replacement.
+	 */
+	nselect = palloc0(sizeof(int) * nparticipants);
+	remaining = palloc(sizeof(double) * nparticipants);
+	for (int i = 0; i < nparticipants; i++)
+	{
+		remaining[i] = results[i].samplerows;
+		remtotal += remaining[i];
+		*liverows += results[i].liverows;
+		*deadrows += results[i].deadrows;
+	}
+	ntarget = (remtotal < targrows) ? (int) remtotal : targrows;
+	for (int j = 0; j < ntarget; j++)
+	{
+		double		r = pg_prng_double(&pg_global_prng_state) * remtotal;
+		int			i;
+
+		for (i = 0; i < nparticipants - 1; i++)
+		{
+			if (r < remaining[i])
+				break;
+			r -= remaining[i];
+		}
+		/* guard against roundoff choosing an exhausted participant */
+		while (remaining[i] < 1)
+			i = (i + 1) % nparticipants;
+
+		remaining[i] -= 1;
+		remtotal -= 1;
+		nselect[i]++;
+	}
+
+	/*
+	 * Pick the chosen number of rows from each sample with Knuth's Algorithm
+	 * S; each sample is a random one, so its order doesn't matter.  Our own
+	 * rows are already in rows[] and only need to be compacted.
+	 */
+	nkept = 0;
+	for (int k = 0; k < results[0].numrows; k++)
+	{
+		if ((results[0].numrows - k) * pg_prng_double(&pg_global_prng_state) <
+			nselect[0] - nkept)
+			rows[nkept++] = rows[k];
+		else
+			heap_freetuple(rows[k]);
+	}
+	Assert(nkept == nselect[0]);
+	numrows = nkept;
+
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+	{
+		int			nrows = results[i + 1].numrows;
+
+		nkept = 0;
+		for (int k = 0; k < nrows; k++)
+		{
+			Size		nbytes;
+			char	   *data;
+			HeapTuple	tuple;
+			uint32		len;
+
+			data = parallel_analyze_receive(mqhs[i], &nbytes);
+			if ((nrows - k) * pg_prng_double(&pg_global_prng_state) >=
+				nselect[i + 1] - nkept)
+				continue;
+
+			/* The message is the tuple's TID followed by its contents */
+			Assert(nbytes > sizeof(ItemPointerData));
+			len = nbytes - sizeof(ItemPointerData);
+			tuple = (HeapTuple) palloc(HEAPTUPLESIZE + len);
+			tuple->t_len = len;
+			memcpy(&tuple->t_self, data, sizeof(ItemPointerData));
+			tuple->t_tableOid = RelationGetRelid(onerel);
+			tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+			memcpy(tuple->t_data, data + sizeof(ItemPointerData), len);
+			rows[numrows++] = tuple;
+			nkept++;
+		}
+		Assert(nkept == nselect[i + 1]);
+	}
+	Assert(numrows == ntarget);
+
+	/*
+	 * Wait for all launched workers to finish, then accumulate their buffer
+	 * and WAL usage.
+	 */
+	WaitForParallelWorkersToFinish(pcxt);
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&buffer_usage[i], &wal_usage[i]);
+
+	/* Carry the shared cost balance back to the leader */
+	if (VacuumSharedCostBalance)
+	{
+		VacuumCostBalance = pg_atomic_read_u32(VacuumSharedCostBalance);
+		VacuumSharedCostBalance = NULL;
+		VacuumActiveNWorkers = NULL;
+	}
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return numrows;
+}
+
+/*
+ * Perform work within a launched parallel process: sample rows from chunks
+ * of the shared block list and send them to the leader.
+ */
+void
+parallel_analyze_main(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelAnalyzeShared *shared;
+	ParallelAnalyzeScan scan;
+	ParallelAnalyzeResult result;
+	Relation	onerel;
+	BufferAccessStrategy strategy;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	HeapTuple  *rows;
+	BufferUsage *buffer_usage;
+	WalUsage   *wal_usage;
+	char	   *sharedquery;
+
+	elog(DEBUG1, "starting parallel analyze worker");
+
+	shared = (ParallelAnalyzeShared *) shm_toc_lookup(toc,
+													  PARALLEL_ANALYZE_KEY_SHARED,
+													  false);
+
+	/* Set debug_query_string for individual workers */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Attach to our tuple queue */
+	mq = (shm_mq *) ((char *) shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_QUEUES,
+											 false) +
+					 ParallelWorkerNumber * PARALLEL_ANALYZE_QUEUE_SIZE);
+	shm_mq_set_sender(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/*
+	 * Open table.  The leader holds a stronger lock, which doesn't conflict
+	 * with ours as we are in its lock group.
+	 */
+	onerel = table_open(shared->relid, AccessShareLock);
+
+	/*
+	 * Set cost-based vacuum delay.  Use the leader's delay parameters rather
+	 * than our own, see PVShared.
+	 */
+	VacuumUpdateCosts();
+	vacuum_cost_delay = shared->cost_delay;
+	vacuum_cost_limit = shared->cost_limit;
+	VacuumCostActive = (vacuum_cost_delay > 0);
+	VacuumCostBalance = 0;
+	VacuumPageHit = 0;
+	VacuumPageMiss = 0;
+	VacuumPageDirty = 0;
+	VacuumCostBalanceLocal = 0;
+	VacuumSharedCostBalance = &(shared->cost_balance);
+	VacuumActiveNWorkers = &(shared->active_nworkers);
+
+	/* Each worker gets its own access strategy */
+	strategy = GetAccessStrategyWithSize(BAS_VACUUM,
+										 shared->ring_nbuffers * (BLCKSZ / 1024));
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	rows = (HeapTuple *) palloc(shared->targrows * sizeof(HeapTuple));
+	memset(&result, 0, sizeof(result));
+	scan.shared = shared;
+	scan.next = scan.end = 0;
+
+	pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+	sample_block_rows(onerel, strategy,
+					  parallel_analyze_read_stream_next, &scan,
+					  shared->OldestXmin, rows, shared->targrows,
+					  &result.numrows, &result.samplerows,
+					  &result.liverows, &result.deadrows,
+					  &shared->blocksdone);
+	pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+
+	/* Report buffer/WAL usage during parallel execution */
+	buffer_usage = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_BUFFER_USAGE, false);
+	wal_usage = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&buffer_usage[ParallelWorkerNumber],
+						  &wal_usage[ParallelWorkerNumber]);
+
+	/*
+	 * Send our totals, then the sample rows.  If the leader has gone away,
+	 * there's nobody left to send them to.
+	 */
+	if (shm_mq_send(mqh, sizeof(result), &result, false, true) == SHM_MQ_SUCCESS)
+	{
+		for (int i = 0; i < result.numrows; i++)
+		{
+			shm_mq_iovec iov[2];
+
+			iov[0].data = (char *) &rows[i]->t_self;
+			iov[0].len = sizeof(ItemPointerData);
+			iov[1].data = (char *) rows[i]->t_data;
+			iov[1].len = rows[i]->t_len;
+			if (shm_mq_sendv(mqh, iov, 2, false, false) != SHM_MQ_SUCCESS)
+				break;
+		}
+	}
+	shm_mq_detach(mqh);
+
+	table_close(onerel, AccessShareLock);
+}
+
+/*
+ * acquire_sample_rows -- acquire a random sample of rows from the table
+ *
+ * Selected rows are returned in the caller-allocated array rows[], which
+ * must have at least targrows entries.
+ * The actual number of rows selected is returned as the function result.
+ * We also estimate the total numbers of live and dead rows in the table,
+ * and return them into *totalrows and *totaldeadrows, respectively.
+ *
+ * The returned list of tuples is in order by physical position in the table.
+ * (We will rely on this later to derive correlation estimates.)
+ *
+ * As of May 2004 we use a new two-stage method:  Stage one selects up
+ * to targrows random blocks (or all blocks, if there aren't so many).
+ * Stage two scans these blocks and uses the Vitter algorithm to create
+ * a random sample of targrows rows (or less, if there are less in the
+ * sample of blocks).  The two stages are executed simultaneously: each
+ * block is processed as soon as stage one returns its number and while
+ * the rows are read stage two controls which ones are to be inserted
+ * into the sample.
+ *
+ * Although every row has an equal chance of ending up in the final
+ * sample, this sampling method is not perfect: not every possible
+ * sample has an equal chance of being selected.  For large relations
+ * the number of different blocks represented by the sample tends to be
+ * too small.  We can live with that for now.  Improvements are welcome.
+ *
+ * An important property of this sampling method is that because we do
+ * look at a statistically unbiased set of blocks, we should get
+ * unbiased estimates of the average numbers of live and dead rows per
+ * block.  The previous sampling method put too much credence in the row
+ * density near the start of the table.
+ */
+static int
+acquire_sample_rows(Relation onerel, int elevel,
+					HeapTuple *rows, int targrows,
+					double *totalrows, double *totaldeadrows)
+{
+	int			numrows = 0;	/* # rows now in reservoir */
+	double		liverows = 0;	/* # live rows seen */
+	double		deadrows = 0;	/* # dead rows seen */
+	uint32		randseed;		/* Seed for block sampler(s) */
+	BlockNumber totalblocks;
+	TransactionId OldestXmin;
+	BlockSamplerData bs;
+	BlockNumber nblocks;
+	int			nworkers;
+
+	Assert(targrows > 0);
+
+	totalblocks = RelationGetNumberOfBlocks(onerel);
+
+	/* Need a cutoff xmin for HeapTupleSatisfiesVacuum */
+	OldestXmin = GetOldestNonRemovableTransactionId(onerel);
+
+	/* Prepare for sampling block numbers */
+	randseed = pg_prng_uint32(&pg_global_prng_state);
+	nblocks = BlockSampler_Init(&bs, totalblocks, targrows, randseed);
+
+	/* Report sampling block numbers */
+	pgstat_progress_update_param(PROGRESS_ANALYZE_BLOCKS_TOTAL,
+								 nblocks);
+
+	nworkers = analyze_parallel_workers(onerel, nblocks);
+	if (nworkers > 0)
+		numrows = acquire_sample_rows_parallel(onerel, nworkers, &bs,
+											   OldestXmin, rows, targrows,
+											   &liverows, &deadrows);
+	else
+	{
+		double		samplerows = 0;
+
+		sample_block_rows(onerel, vac_strategy,
+						  block_sampling_read_stream_next, &bs,
+						  OldestXmin, rows, targrows, &numrows,
+						  &samplerows, &liverows, &deadrows, NULL);
+	}
 
 	/*
 	 * If we didn't find as many tuples as we wanted then we're done. No sort
-	 * is needed, since they're already in order.
+	 * is needed, since they're already in order.  That doesn't hold for a
+	 * sample gathered by parallel workers, which read the blocks in chunks
+	 * and in no particular order.
 	 *
 	 * Otherwise we need to sort the collected tuples by position
 	 * (itempointer). It's not worth worrying about corner cases where the
 	 * tuples are already sorted.
 	 */
-	if (numrows == targrows)
+	if (numrows == targrows || nworkers > 0)
 		qsort_interruptible(rows, numrows, sizeof(HeapTuple),
 							compare_rows, NULL);
 
@@ -408,6 +408,19 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 		 */
 		cstate->line_buf_valid = false;
 
+		/*
+		 * When loading a file into a plain table, tell the heap how much is
+		 * still to come, so that it can extend the relation in large chunks.
+		 * The input size is only a rough guide to the size of the heap, but
+		 * good enough for that.  Not done for partitions, as we don't know
+		 * how the remaining rows will be distributed among them.
+		 */
+		if (cstate->bytes_total > 0 &&
+			resultRelInfo->ri_RelationDesc == cstate->rel)
+			SetBulkInsertStateExpectedSize(buffer->bistate,
+										   cstate->bytes_total > cstate->bytes_processed ?
+										   cstate->bytes_total - cstate->bytes_processed : 0);
+
 		/*
 		 * table_multi_insert may leak memory, so switch to short-lived memory
 		 * context before calling it.
@@ -664,7 +677,7 @@ CopyFrom(CopyFromState cstate)
 	if (cstate->rel->rd_rel->relkind != RELKIND_RELATION &&
 		cstate->rel->rd_rel->relkind != RELKIND_FOREIGN_TABLE &&
 		cstate->rel->rd_rel->relkind != RELKIND_PARTITIONED_TABLE &&
-		!(cstate->rel->trigdesc &&
+		!(RelationGetTriggerDesc(cstate->rel) &&
 		  cstate->rel->trigdesc->trig_insert_instead_row))
 	{
 		if (cstate->rel->rd_rel->relkind == RELKIND_VIEW)
@@ -812,7 +825,7 @@ CopyFrom(CopyFromState cstate)
 	 * passed to ExecFindPartition() below.
 	 */
 	cstate->transition_capture = mtstate->mt_transition_capture =
-		MakeTransitionCaptureState(cstate->rel->trigdesc,
+		MakeTransitionCaptureState(RelationGetTriggerDesc(cstate->rel),
 								   RelationGetRelid(cstate->rel),
 								   CMD_INSERT);
 
@@ -937,9 +950,21 @@ CopyFrom(CopyFromState cstate)
 	 * Check BEFORE STATEMENT insertion triggers. It's debatable whether we
 	 * should do this for COPY, since it's not really an "INSERT" statement as
 	 * such. However, executing these triggers maintains consistency with the
-	 * EACH ROW triggers that we already fire on COPY.
+	 * EACH ROW triggers that we already fire on COPY.  In a parallel COPY
+	 * FROM, statement triggers are fired by the leader only.
 	 */
-	ExecBSInsertTriggers(estate, resultRelInfo);
+	if (!IsParallelWorker())
+		ExecBSInsertTriggers(estate, resultRelInfo);
+
+	/*
+	 * If PARALLEL was given, try to hand the input over to parallel workers.
+	 * If they run, they consume all of the input, so the loop below finds
+	 * nothing left to insert.  ParallelCopyFrom() refuses, with a warning,
+	 * everything that makes us insert one row at a time above, so the
+	 * workers always use multi-inserts.
+	 */
+	if (cstate->opts.nworkers > 0 && !IsParallelWorker())
+		processed = ParallelCopyFrom(cstate, resultRelInfo);
 
 	econtext = GetPerTupleExprContext(estate);
 
@@ -1287,7 +1312,8 @@ CopyFrom(CopyFromState cstate)
 	MemoryContextSwitchTo(oldcontext);
 
 	/* Execute AFTER STATEMENT insertion triggers */
-	ExecASInsertTriggers(estate, target_resultRelInfo, cstate->transition_capture);
+	if (!IsParallelWorker())
+		ExecASInsertTriggers(estate, target_resultRelInfo, cstate->transition_capture);
 
 	/* Handle queued AFTER triggers */
 	AfterTriggerEndQuery(estate);
@@ -1492,6 +1518,8 @@ BeginCopyFrom(ParseState *pstate,
 	cstate->copy_src = COPY_FILE;	/* default */
 
 	cstate->whereClause = whereClause;
+	cstate->attnamelist = attnamelist;
+	cstate->options = options;
 
 	/* Initialize state variables */
 	cstate->eol_type = EOL_UNKNOWN;
@@ -1628,6 +1656,7 @@ BeginCopyFrom(ParseState *pstate,
 	pgstat_progress_start_command(PROGRESS_COMMAND_COPY,
 								  cstate->rel ? RelationGetRelid(cstate->rel) : InvalidOid);
 	cstate->bytes_processed = 0;
+	cstate->bytes_total = 0;
 
 	/* We keep those variables in cstate. */
 	cstate->in_functions = in_functions;
@@ -1699,12 +1728,18 @@ BeginCopyFrom(ParseState *pstate,
 						 errmsg("\"%s\" is a directory", cstate->filename)));
 
 			progress_vals[2] = st.st_size;
+			cstate->bytes_total = st.st_size;
 		}
 	}
 
 	pgstat_progress_update_multi_param(3, progress_cols, progress_vals);
 
-	if (cstate->opts.binary)
+	if (cstate->opts.columnar)
+	{
+		/* Read and verify columnar header */
+		ReceiveCopyColumnarHeader(cstate);
+	}
+	else if (cstate->opts.binary)
 	{
 		/* Read and verify binary header */
 		ReceiveCopyBinaryHeader(cstate);
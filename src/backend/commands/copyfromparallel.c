@@ -0,0 +1,737 @@
+/*-------------------------------------------------------------------------
+ *
+ * copyfromparallel.c
+ *		Parallel COPY FROM.
+ *
+ * With the PARALLEL option, COPY FROM in text or CSV format can be carried
+ * out by parallel workers.  The leader reads the input and cuts it into
+ * chunks of whole lines, taking the quoting rules of the format into
+ * account, and hands the chunks out to the workers in turn through message
+ * queues.  Each worker runs the regular COPY FROM code on every chunk it
+ * receives: it parses the lines, evaluates defaults and the WHERE clause,
+ * checks constraints and inserts the rows with multi-inserts.
+ *
+ * Every chunk carries the line number of its first line, so that an error
+ * in a worker reports the same line number as a serial COPY would.  The
+ * leader only looks at line ends, quotes and escapes; everything else,
+ * including the detection of malformed input, is left to the workers.
+ *
+ * Parallel workers can insert tuples only with the command ID that the
+ * leader has already marked used, and they can't fire triggers or assign
+ * OIDs in a way that would have to be reported back to the leader, so only
+ * COPY into plain tables without row-level triggers is done in parallel.
+ * Neither can volatile defaults or WHERE clauses, which might look at the
+ * rows loaded so far, be evaluated in parallel.  In other cases, COPY warns
+ * and runs serially.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/commands/copyfromparallel.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/parallel.h"
+#include "access/table.h"
+#include "access/xact.h"
+#include "catalog/pg_proc.h"
+#include "commands/copy.h"
+#include "commands/copyfrom_internal.h"
+#include "commands/progress.h"
+#include "executor/instrument.h"
+#include "mb/pg_wchar.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/pathnodes.h"
+#include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
+#include "parser/parse_relation.h"
+#include "pgstat.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "tcop/tcopprot.h"
+#include "utils/acl.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_COPY_KEY_SHARED		1
+#define PARALLEL_COPY_KEY_NODES			2
+#define PARALLEL_COPY_KEY_QUEUES		3
+#define PARALLEL_COPY_KEY_BUFFER_USAGE	4
+#define PARALLEL_COPY_KEY_WAL_USAGE		5
+#define PARALLEL_COPY_KEY_QUERY_TEXT	6
+
+/* Size of each worker's chunk queue */
+#define PARALLEL_COPY_QUEUE_SIZE		(1024 * 1024)
+
+/* A chunk is sent once it holds at least this many bytes of whole lines */
+#define PARALLEL_COPY_CHUNK_SIZE		65536
+
+/* Bytes of input read by the leader at a time */
+#define PARALLEL_COPY_READ_SIZE			65536
+
+/*
+ * Shared information for parallel COPY FROM
+ */
+typedef struct ParallelCopyShared
+{
+	Oid			relid;
+
+	/* Number of rows inserted by all workers, for progress reporting */
+	pg_atomic_uint64 processed;
+} ParallelCopyShared;
+
+/*
+ * Each message in a worker's queue is a chunk of input, preceded by this
+ * header.
+ */
+typedef struct ParallelCopyChunkHeader
+{
+	uint64		first_lineno;	/* line number of the chunk's first line */
+	EolType		eol_type;		/* newline style, if known by now */
+} ParallelCopyChunkHeader;
+
+/*
+ * The leader's state for cutting the input into lines.  It tracks just
+ * enough of the work of CopyReadLineText() to find the same line ends.
+ */
+typedef struct ParallelCopySplit
+{
+	bool		csv_mode;
+	char		quotec;
+	char		escapec;		/* '\0' if the same as quotec */
+	EolType		eol_type;
+	bool		in_quote;
+	bool		last_was_esc;
+	bool		first_char_in_line;
+	bool		found_eof_marker;	/* line at scanpos has \. */
+	int			scanpos;		/* next byte of the buffer to look at */
+	uint64		nlines;			/* physical lines before scanpos */
+} ParallelCopySplit;
+
+/* The chunk a worker is currently parsing, see parallel_copy_read_chunk */
+static char *chunk_data;
+static int	chunk_len;
+
+/*
+ * Decide whether the rows of cstate can be loaded by parallel workers.
+ * If not, and the user would have expected it, say why.
+ */
+static bool
+parallel_copy_allowed(CopyFromState cstate, ResultRelInfo *resultRelInfo)
+{
+	Relation	rel = cstate->rel;
+	TupleConstr *constr = RelationGetDescr(rel)->constr;
+	PlannerInfo *root;
+	const char *detail = NULL;
+	ListCell   *lc;
+
+	/* We can't launch workers from a worker, nor without a postmaster */
+	if (!IsUnderPostmaster || IsInParallelMode() ||
+		max_parallel_maintenance_workers == 0)
+		return false;
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION)
+		detail = _("Only plain tables can be copied into in parallel.");
+	else if (RelationUsesLocalBuffers(rel))
+		detail = _("Parallel workers cannot access temporary tables.");
+	else if (RelationIsPermanent(rel) && !RelationNeedsWAL(rel))
+		detail = _("The table was created or truncated in the current transaction.");
+	else if (cstate->opts.freeze)
+		detail = _("FREEZE cannot be used in parallel.");
+	else if (cstate->opts.header_line == COPY_HEADER_MATCH)
+		detail = _("HEADER MATCH cannot be used in parallel.");
+	else if (PG_ENCODING_IS_CLIENT_ONLY(cstate->file_encoding))
+		detail = _("The input encoding is not supported in parallel.");
+	else if (resultRelInfo->ri_TrigDesc &&
+			 (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
+			  resultRelInfo->ri_TrigDesc->trig_insert_instead_row))
+		detail = _("The table has row-level BEFORE or INSTEAD OF triggers.");
+	else if (resultRelInfo->ri_TrigDesc &&
+			 (resultRelInfo->ri_TrigDesc->trig_insert_after_row ||
+			  resultRelInfo->ri_TrigDesc->trig_insert_new_table))
+		detail = _("The table has row-level AFTER triggers or foreign keys.");
+	else if (cstate->volatile_defexprs)
+		detail = _("A column default expression is volatile.");
+	else if (contain_volatile_functions(cstate->whereClause))
+		detail = _("The WHERE clause is volatile.");
+
+	if (detail == NULL)
+	{
+		/* Set up largely-dummy planner state to check parallel safety */
+		root = makeNode(PlannerInfo);
+		root->glob = makeNode(PlannerGlobal);
+
+		/*
+		 * The workers evaluate the WHERE clause, defaults and generated
+		 * columns, check constraints and index expressions, and run the
+		 * input functions, all of which must be parallel safe.
+		 */
+		if (!is_parallel_safe(root, cstate->whereClause))
+			detail = _("The WHERE clause is not parallel safe.");
+
+		for (int i = 0; constr && i < constr->num_defval && !detail; i++)
+		{
+			if (!is_parallel_safe(root, stringToNode(constr->defval[i].adbin)))
+				detail = _("A column default or generation expression is not parallel safe.");
+		}
+
+		for (int i = 0; constr && i < constr->num_check && !detail; i++)
+		{
+			if (!is_parallel_safe(root, stringToNode(constr->check[i].ccbin)))
+				detail = _("A check constraint is not parallel safe.");
+		}
+
+		for (int i = 0; i < resultRelInfo->ri_NumIndices && !detail; i++)
+		{
+			Relation	index = resultRelInfo->ri_IndexRelationDescs[i];
+
+			if (!is_parallel_safe(root, (Node *) RelationGetIndexExpressions(index)) ||
+				!is_parallel_safe(root, (Node *) RelationGetIndexPredicate(index)))
+				detail = _("An index expression or predicate is not parallel safe.");
+		}
+
+		foreach(lc, cstate->attnumlist)
+		{
+			int			attnum = lfirst_int(lc);
+
+			if (detail)
+				break;
+			if (func_parallel(cstate->in_functions[attnum - 1].fn_oid) != PROPARALLEL_SAFE)
+				detail = _("The input function of a column is not parallel safe.");
+		}
+	}
+
+	if (detail)
+	{
+		ereport(WARNING,
+				(errmsg("disabling parallel option of COPY on \"%s\"",
+						RelationGetRelationName(rel)),
+				 errdetail_internal("%s", detail)));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Advance split->scanpos over the input in buf, up to and including the
+ * end of the next line.  The line end is recognized the same way as by
+ * CopyReadLineText(), which is all that is needed to cut the input into
+ * chunks that the workers can parse independently; stray carriage returns
+ * and the like are reported by the workers.
+ *
+ * Returns true if a line end was found, and false if more input is needed
+ * first.  At EOF, false means the rest of buf is a last line without a line
+ * end.
+ */
+static bool
+parallel_copy_split_line(ParallelCopySplit *split, StringInfo buf, bool eof)
+{
+	const char *data = buf->data;
+
+	while (split->scanpos < buf->len)
+	{
+		int			pos = split->scanpos;
+		char		c = data[pos];
+
+		if (split->csv_mode)
+		{
+			/*
+			 * In CSV mode, we only recognize \. alone on a line, so we need
+			 * to see the line end that follows it.
+			 */
+			if (c == '\\' && split->first_char_in_line && !split->in_quote)
+			{
+				if (pos + 2 >= buf->len && !eof)
+					return false;
+				if (pos + 1 < buf->len && data[pos + 1] == '.' &&
+					(pos + 2 >= buf->len ||
+					 data[pos + 2] == '\n' || data[pos + 2] == '\r'))
+					split->found_eof_marker = true;
+			}
+
+			/* See CopyReadLineText() for the dealing with quotes */
+			if (split->in_quote && c == split->escapec)
+				split->last_was_esc = !split->last_was_esc;
+			if (c == split->quotec && !split->last_was_esc)
+				split->in_quote = !split->in_quote;
+			if (c != split->escapec)
+				split->last_was_esc = false;
+		}
+		else if (c == '\\')
+		{
+			/* A backslashed character never ends the line */
+			if (pos + 1 >= buf->len)
+			{
+				if (!eof)
+					return false;
+			}
+			else
+			{
+				if (data[pos + 1] == '.')
+					split->found_eof_marker = true;
+				split->first_char_in_line = false;
+				split->scanpos += 2;
+				continue;
+			}
+		}
+
+		split->first_char_in_line = false;
+		split->scanpos++;
+
+		if (c != '\n' && c != '\r')
+			continue;
+
+		/* Count physical lines, even within a quoted field */
+		if (c == (split->eol_type == EOL_CR ? '\r' : '\n'))
+			split->nlines++;
+
+		if (split->csv_mode && split->in_quote)
+			continue;
+
+		/* Learn the newline style from the first line end */
+		if (split->eol_type == EOL_UNKNOWN)
+		{
+			if (c == '\n')
+				split->eol_type = EOL_NL;
+			else if (pos + 1 >= buf->len && !eof)
+			{
+				/* need to see if \n follows */
+				split->scanpos--;
+				return false;
+			}
+			else if (pos + 1 < buf->len && data[pos + 1] == '\n')
+				split->eol_type = EOL_CRNL;
+			else
+			{
+				split->eol_type = EOL_CR;
+				split->nlines++;
+			}
+		}
+
+		if (c == (split->eol_type == EOL_CR ? '\r' : '\n'))
+		{
+			split->first_char_in_line = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Send the first nbytes bytes of buf, which start at line first_lineno, to
+ * a worker's queue.
+ */
+static void
+parallel_copy_send_chunk(ParallelContext *pcxt, shm_mq_handle *mqh,
+						 StringInfo buf, int nbytes, uint64 first_lineno,
+						 EolType eol_type)
+{
+	ParallelCopyChunkHeader hdr;
+	shm_mq_iovec iov[2];
+
+	hdr.first_lineno = first_lineno;
+	hdr.eol_type = eol_type;
+	iov[0].data = (char *) &hdr;
+	iov[0].len = sizeof(hdr);
+	iov[1].data = buf->data;
+	iov[1].len = nbytes;
+
+	if (shm_mq_sendv(mqh, iov, 2, false, true) != SHM_MQ_SUCCESS)
+	{
+		/* The worker is gone; report its error, if it sent one */
+		WaitForParallelWorkersToFinish(pcxt);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("lost connection to parallel worker")));
+	}
+
+	/* Keep the rest of the input */
+	buf->len -= nbytes;
+	memmove(buf->data, buf->data + nbytes, buf->len);
+	buf->data[buf->len] = '\0';
+}
+
+/*
+ * ParallelCopyFrom -- load all of the input of cstate with parallel workers
+ *
+ * Returns the number of rows inserted.  If the rows can't be loaded in
+ * parallel, returns 0 without consuming any input, and the caller loads
+ * them itself.
+ */
+uint64
+ParallelCopyFrom(CopyFromState cstate, ResultRelInfo *resultRelInfo)
+{
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	ParallelCopySplit split;
+	shm_mq_handle **mqhs;
+	char	   *queues;
+	BufferUsage *buffer_usage;
+	WalUsage   *wal_usage;
+	List	   *options = NIL;
+	char	   *nodes;
+	char	   *sharednodes;
+	Size		nodeslen;
+	Size		querylen = 0;
+	int			nworkers;
+	int			next_worker = 0;
+	StringInfoData buf;
+	uint64		lineno = 1;
+	bool		skip_header;
+	bool		eof = false;
+	uint64		processed;
+	ListCell   *lc;
+
+	Assert(!cstate->opts.binary);
+
+	if (!parallel_copy_allowed(cstate, resultRelInfo))
+		return 0;
+
+	nworkers = Min(cstate->opts.nworkers, max_parallel_maintenance_workers);
+
+	/*
+	 * The workers parse the input given their own COPY options, without
+	 * PARALLEL, and with the encoding of the input spelled out.
+	 */
+	foreach(lc, cstate->options)
+	{
+		DefElem    *defel = lfirst_node(DefElem, lc);
+
+		if (strcmp(defel->defname, "parallel") == 0 ||
+			strcmp(defel->defname, "encoding") == 0)
+			continue;
+		options = lappend(options, defel);
+	}
+	options = lappend(options,
+					  makeDefElem("encoding",
+								  (Node *) makeString(pstrdup(pg_encoding_to_char(cstate->file_encoding))),
+								  -1));
+	nodes = nodeToString(list_make3(options, cstate->attnamelist,
+									cstate->whereClause));
+	nodeslen = strlen(nodes) + 1;
+
+	/*
+	 * The workers insert with our transaction ID and current command ID,
+	 * which they can't assign themselves.  CopyFrom() has already marked the
+	 * command ID used.
+	 */
+	(void) GetCurrentTransactionId();
+	Assert(IsCurrentCommandIdUsed());
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "ParallelCopyFromMain",
+								 nworkers);
+
+	/* Estimate size for shared information -- PARALLEL_COPY_KEY_SHARED */
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for the COPY options -- PARALLEL_COPY_KEY_NODES */
+	shm_toc_estimate_chunk(&pcxt->estimator, nodeslen);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for chunk queues -- PARALLEL_COPY_KEY_QUEUES */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(PARALLEL_COPY_QUEUE_SIZE, pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/*
+	 * Estimate space for BufferUsage and WalUsage --
+	 * PARALLEL_COPY_KEY_BUFFER_USAGE and PARALLEL_COPY_KEY_WAL_USAGE.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_COPY_KEY_QUERY_TEXT space */
+	if (debug_query_string)
+	{
+		querylen = strlen(debug_query_string);
+		shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (ParallelCopyShared *) shm_toc_allocate(pcxt->toc,
+													 sizeof(ParallelCopyShared));
+	shared->relid = RelationGetRelid(cstate->rel);
+	pg_atomic_init_u64(&shared->processed, 0);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_SHARED, shared);
+
+	sharednodes = (char *) shm_toc_allocate(pcxt->toc, nodeslen);
+	memcpy(sharednodes, nodes, nodeslen);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_NODES, sharednodes);
+
+	/* Create a chunk queue for each worker, with us as the sender */
+	queues = shm_toc_allocate(pcxt->toc,
+							  mul_size(PARALLEL_COPY_QUEUE_SIZE,
+									   pcxt->nworkers));
+	mqhs = palloc(sizeof(shm_mq_handle *) * Max(pcxt->nworkers, 1));
+	for (int i = 0; i < pcxt->nworkers; i++)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queues + i * PARALLEL_COPY_QUEUE_SIZE,
+						   PARALLEL_COPY_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+		mqhs[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_QUEUES, queues);
+
+	buffer_usage = shm_toc_allocate(pcxt->toc,
+									mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_BUFFER_USAGE, buffer_usage);
+	wal_usage = shm_toc_allocate(pcxt->toc,
+								 mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_WAL_USAGE, wal_usage);
+
+	/* Store query string for workers */
+	if (debug_query_string)
+	{
+		char	   *sharedquery;
+
+		sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+		memcpy(sharedquery, debug_query_string, querylen + 1);
+		sharedquery[querylen] = '\0';
+		shm_toc_insert(pcxt->toc,
+					   PARALLEL_COPY_KEY_QUERY_TEXT, sharedquery);
+	}
+
+	LaunchParallelWorkers(pcxt);
+
+	/* If no workers could be launched, just load the rows ourselves */
+	if (pcxt->nworkers_launched == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return 0;
+	}
+
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+		shm_mq_set_handle(mqhs[i], pcxt->worker[i].bgwhandle);
+
+	/*
+	 * Read all of the input, and send it to the workers a chunk of whole
+	 * lines at a time.
+	 */
+	memset(&split, 0, sizeof(split));
+	split.csv_mode = cstate->opts.csv_mode;
+	if (split.csv_mode)
+	{
+		split.quotec = cstate->opts.quote[0];
+		split.escapec = cstate->opts.escape[0];
+		if (split.escapec == split.quotec)
+			split.escapec = '\0';
+	}
+	split.eol_type = EOL_UNKNOWN;
+	split.first_char_in_line = true;
+	skip_header = (cstate->opts.header_line != COPY_HEADER_FALSE);
+
+	initStringInfo(&buf);
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (parallel_copy_split_line(&split, &buf, eof))
+		{
+			if (skip_header)
+			{
+				/* The header line is of no interest to the workers */
+				buf.len -= split.scanpos;
+				memmove(buf.data, buf.data + split.scanpos, buf.len);
+				buf.data[buf.len] = '\0';
+				split.scanpos = 0;
+				lineno += split.nlines;
+				split.nlines = 0;
+				skip_header = false;
+			}
+			else if (split.found_eof_marker)
+				break;
+			else if (split.scanpos >= PARALLEL_COPY_CHUNK_SIZE)
+			{
+				parallel_copy_send_chunk(pcxt, mqhs[next_worker], &buf,
+										 split.scanpos, lineno,
+										 split.eol_type);
+				next_worker = (next_worker + 1) % pcxt->nworkers_launched;
+				split.scanpos = 0;
+				lineno += split.nlines;
+				split.nlines = 0;
+
+				pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED,
+											 pg_atomic_read_u64(&shared->processed));
+			}
+			continue;
+		}
+
+		if (eof)
+			break;
+
+		enlargeStringInfo(&buf, PARALLEL_COPY_READ_SIZE);
+		buf.len += CopyReadRawData(cstate, buf.data + buf.len,
+								   PARALLEL_COPY_READ_SIZE);
+		buf.data[buf.len] = '\0';
+		eof = cstate->raw_reached_eof;
+	}
+
+	/*
+	 * Send the last lines.  After the end-of-copy marker, the rest of the
+	 * input is ignored.
+	 */
+	if (split.scanpos > 0 && !skip_header)
+		parallel_copy_send_chunk(pcxt, mqhs[next_worker], &buf,
+								 split.scanpos, lineno, split.eol_type);
+	lineno += split.nlines;
+
+	/* Like CopyReadLine(), drain the client's data after the marker */
+	if (!eof && cstate->copy_src == COPY_FRONTEND)
+	{
+		while (CopyReadRawData(cstate, buf.data, buf.maxlen - 1) > 0)
+			;
+	}
+	cstate->raw_reached_eof = true;
+	cstate->eol_type = split.eol_type;
+	cstate->cur_lineno = lineno - 1;
+
+	/* Tell the workers there's nothing more to come */
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+		shm_mq_detach(mqhs[i]);
+
+	/*
+	 * Wait for all launched workers to finish, then accumulate their buffer
+	 * and WAL usage.
+	 */
+	WaitForParallelWorkersToFinish(pcxt);
+	for (int i = 0; i < pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&buffer_usage[i], &wal_usage[i]);
+
+	processed = pg_atomic_read_u64(&shared->processed);
+	pgstat_progress_update_param(PROGRESS_COPY_TUPLES_PROCESSED, processed);
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	pfree(buf.data);
+
+	return processed;
+}
+
+/*
+ * copy_data_source_cb for the workers, returning the data of the current
+ * chunk.
+ */
+static int
+parallel_copy_read_chunk(void *outbuf, int minread, int maxread)
+{
+	int			nbytes = Min(maxread, chunk_len);
+
+	memcpy(outbuf, chunk_data, nbytes);
+	chunk_data += nbytes;
+	chunk_len -= nbytes;
+
+	return nbytes;
+}
+
+/*
+ * Perform work within a launched parallel process: load the rows of every
+ * chunk of input that the leader sends us.
+ */
+void
+ParallelCopyFromMain(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCopyShared *shared;
+	List	   *nodes;
+	Relation	rel;
+	ParseState *pstate;
+	ParseNamespaceItem *nsitem;
+	CopyFromState cstate;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	BufferUsage *buffer_usage;
+	WalUsage   *wal_usage;
+	char	   *sharedquery;
+
+	elog(DEBUG1, "starting parallel COPY FROM worker");
+
+	shared = (ParallelCopyShared *) shm_toc_lookup(toc,
+												   PARALLEL_COPY_KEY_SHARED,
+												   false);
+
+	/* Set debug_query_string for individual workers */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUERY_TEXT, true);
+	debug_query_string = sharedquery;
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Attach to our chunk queue */
+	mq = (shm_mq *) ((char *) shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUEUES,
+											 false) +
+					 ParallelWorkerNumber * PARALLEL_COPY_QUEUE_SIZE);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/* The COPY options, column list and WHERE clause */
+	nodes = (List *) stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_NODES,
+												 false));
+
+	/* The leader's lock doesn't conflict with ours in its lock group */
+	rel = table_open(shared->relid, RowExclusiveLock);
+
+	pstate = make_parsestate(NULL);
+	pstate->p_sourcetext = debug_query_string;
+	nsitem = addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										   NULL, false, false);
+	nsitem->p_perminfo->requiredPerms = ACL_INSERT;
+
+	cstate = BeginCopyFrom(pstate, rel, lthird(nodes), NULL, false,
+						   parallel_copy_read_chunk, lsecond(nodes),
+						   linitial(nodes));
+
+	/* Prepare to track buffer usage during parallel execution */
+	InstrStartParallelQuery();
+
+	for (;;)
+	{
+		ParallelCopyChunkHeader hdr;
+		Size		nbytes;
+		void	   *data;
+		uint64		processed;
+
+		/* Once the leader detaches, there's no more input */
+		if (shm_mq_receive(mqh, &nbytes, &data, false) != SHM_MQ_SUCCESS)
+			break;
+
+		Assert(nbytes >= sizeof(hdr));
+		memcpy(&hdr, data, sizeof(hdr));
+		chunk_data = (char *) data + sizeof(hdr);
+		chunk_len = nbytes - sizeof(hdr);
+
+		CopyResetInput(cstate, hdr.first_lineno);
+		cstate->eol_type = hdr.eol_type;
+
+		processed = CopyFrom(cstate);
+		pg_atomic_add_fetch_u64(&shared->processed, processed);
+	}
+
+	EndCopyFrom(cstate);
+
+	/* Report buffer/WAL usage during parallel execution */
+	buffer_usage = shm_toc_lookup(toc, PARALLEL_COPY_KEY_BUFFER_USAGE, false);
+	wal_usage = shm_toc_lookup(toc, PARALLEL_COPY_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&buffer_usage[ParallelWorkerNumber],
+						  &wal_usage[ParallelWorkerNumber]);
+
+	shm_mq_detach(mqh);
+	free_parsestate(pstate);
+	table_close(rel, RowExclusiveLock);
+}
@@ -62,6 +62,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "catalog/pg_type.h"
 #include "commands/copy.h"
 #include "commands/copyfrom_internal.h"
 #include "commands/progress.h"
@@ -72,9 +73,12 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/pg_bswap.h"
+#include "port/pg_lfind.h"
 #include "utils/builtins.h"
+#include "utils/date.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/timestamp.h"
 
 #define ISOCTAL(c) (((c) >= '0') && ((c) <= '7'))
 #define OCTVALUE(c) ((c) - '0')
@@ -144,8 +148,9 @@ if (1) \
 	goto not_end_of_copy; \
 } else ((void) 0)
 
-/* NOTE: there's a copy of this in copyto.c */
+/* NOTE: there's a copy of these in copyto.c */
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
+static const char ColumnarSignature[11] = "PGCOLS\n\377\r\n\0";
 
 
 /* non-export function prototypes */
@@ -156,6 +161,11 @@ static int	CopyReadAttributesCSV(CopyFromState cstate);
 static Datum CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 									 Oid typioparam, int32 typmod,
 									 bool *isnull);
+static bool CopyReadColumnarBatch(CopyFromState cstate);
+static Datum CopyReadColumnarAttribute(CopyFromState cstate, int fieldno,
+									   int row, Form_pg_attribute att,
+									   FmgrInfo *flinfo, Oid typioparam,
+									   bool *isnull);
 
 
 /* Low-level communications functions */
@@ -163,6 +173,9 @@ static int	CopyGetData(CopyFromState cstate, void *databuf,
 						int minread, int maxread);
 static inline bool CopyGetInt32(CopyFromState cstate, int32 *val);
 static inline bool CopyGetInt16(CopyFromState cstate, int16 *val);
+static inline bool CopyGetColumnarInt32(CopyFromState cstate, int32 *val);
+static inline bool CopyGetColumnarInt16(CopyFromState cstate, int16 *val);
+static void *CopyReadColumnarBuffer(CopyFromState cstate, uint64 nbytes);
 static void CopyLoadInputBuf(CopyFromState cstate);
 static int	CopyReadBinaryData(CopyFromState cstate, char *dest, int nbytes);
 
@@ -228,6 +241,81 @@ ReceiveCopyBinaryHeader(CopyFromState cstate)
 	}
 }
 
+/*
+ * Read and verify the header of a columnar COPY file
+ *
+ * Besides the signature and flags, the header declares the number of
+ * columns and the width each one is stored with.  A column of a type that
+ * CopyColumnarWidth() knows may be stored either packed at exactly that
+ * width or variable-width; any other column must be variable-width.
+ */
+void
+ReceiveCopyColumnarHeader(CopyFromState cstate)
+{
+	TupleDesc	tupDesc = RelationGetDescr(cstate->rel);
+	int			attr_count = list_length(cstate->attnumlist);
+	char		readSig[11];
+	int32		flags;
+	int16		ncolumns;
+	ListCell   *cur;
+	int			fieldno = 0;
+
+	/* Signature */
+	if (CopyReadBinaryData(cstate, readSig, 11) != 11 ||
+		memcmp(readSig, ColumnarSignature, 11) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("COPY file signature not recognized")));
+	/* Flags field, no flags are defined yet */
+	if (!CopyGetColumnarInt32(cstate, &flags))
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("invalid COPY file header (missing flags)")));
+	if (flags != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("unrecognized critical flags in COPY file header")));
+	/* Column count */
+	if (!CopyGetColumnarInt16(cstate, &ncolumns))
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("invalid COPY file header (missing column count)")));
+	if (ncolumns != attr_count)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("column count in COPY file header is %d, expected %d",
+						(int) ncolumns, attr_count)));
+
+	/* Column widths */
+	cstate->columnar_widths = (int16 *) palloc(attr_count * sizeof(int16));
+	foreach(cur, cstate->attnumlist)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupDesc, lfirst_int(cur) - 1);
+		int16		width;
+
+		if (!CopyGetColumnarInt16(cstate, &width))
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("invalid COPY file header (missing column width)")));
+		if (width != -1 &&
+			width != CopyColumnarWidth(att->atttypid, att->atttypmod))
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("invalid width %d for column \"%s\" in COPY file header",
+							(int) width, NameStr(att->attname))));
+		cstate->columnar_widths[fieldno++] = width;
+	}
+
+	cstate->columnar_validity = (uint8 **) palloc0(attr_count * sizeof(uint8 *));
+	cstate->columnar_data = (char **) palloc0(attr_count * sizeof(char *));
+	cstate->columnar_offsets = (int32 **) palloc0(attr_count * sizeof(int32 *));
+	cstate->columnar_nrows = 0;
+	cstate->columnar_nextrow = 0;
+	cstate->columnar_context = AllocSetContextCreate(CurrentMemoryContext,
+													 "COPY columnar batch",
+													 ALLOCSET_DEFAULT_SIZES);
+}
+
 /*
  * CopyGetData reads data from the source (file or frontend)
  *
@@ -389,6 +477,65 @@ CopyGetInt16(CopyFromState cstate, int16 *val)
 	return true;
 }
 
+/*
+ * CopyGetColumnarInt32 reads an int32 that appears in little-endian byte
+ * order, as all integers of the columnar format do
+ */
+static inline bool
+CopyGetColumnarInt32(CopyFromState cstate, int32 *val)
+{
+	uint32		buf;
+
+	if (CopyReadBinaryData(cstate, (char *) &buf, sizeof(buf)) != sizeof(buf))
+	{
+		*val = 0;				/* suppress compiler warning */
+		return false;
+	}
+	*val = (int32) pg_letoh32(buf);
+	return true;
+}
+
+/*
+ * CopyGetColumnarInt16 reads an int16 that appears in little-endian byte
+ * order
+ */
+static inline bool
+CopyGetColumnarInt16(CopyFromState cstate, int16 *val)
+{
+	uint16		buf;
+
+	if (CopyReadBinaryData(cstate, (char *) &buf, sizeof(buf)) != sizeof(buf))
+	{
+		*val = 0;				/* suppress compiler warning */
+		return false;
+	}
+	*val = (int16) pg_letoh16(buf);
+	return true;
+}
+
+/*
+ * CopyReadColumnarBuffer reads one buffer of a columnar batch, of the given
+ * size, into a fresh chunk of the current memory context
+ */
+static void *
+CopyReadColumnarBuffer(CopyFromState cstate, uint64 nbytes)
+{
+	char	   *buf;
+
+	if (nbytes > MaxAllocSize)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("COPY columnar batch is too large")));
+
+	buf = palloc(nbytes);
+	if (CopyReadBinaryData(cstate, buf, (int) nbytes) != (int) nbytes)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("unexpected EOF in COPY data")));
+
+	return buf;
+}
+
 
 /*
  * Perform encoding conversion on data in 'raw_buf', writing the converted
@@ -739,6 +886,59 @@ CopyReadBinaryData(CopyFromState cstate, char *dest, int nbytes)
 	return copied_bytes;
 }
 
+/*
+ * CopyReadRawData
+ *
+ * Reads up to 'maxread' bytes of raw input, bypassing raw_buf, for a caller
+ * that does its own parsing of the input.  Returns the number of bytes read,
+ * 0 meaning EOF.  Used by the leader of a parallel COPY FROM, which never
+ * loads raw_buf itself.
+ */
+int
+CopyReadRawData(CopyFromState cstate, char *dest, int maxread)
+{
+	int			nbytes;
+
+	Assert(cstate->raw_buf_len == 0);
+
+	if (cstate->raw_reached_eof)
+		return 0;
+
+	nbytes = CopyGetData(cstate, dest, 1, maxread);
+
+	cstate->bytes_processed += nbytes;
+	pgstat_progress_update_param(PROGRESS_COPY_BYTES_PROCESSED, cstate->bytes_processed);
+
+	if (nbytes == 0)
+		cstate->raw_reached_eof = true;
+
+	return nbytes;
+}
+
+/*
+ * CopyResetInput
+ *
+ * Discard all buffered input and the EOF state, so that parsing can start
+ * over on new data from the data source.  The first line of that data gets
+ * line number 'lineno'.  A parallel COPY FROM worker uses this between the
+ * chunks of input it gets from the leader.
+ */
+void
+CopyResetInput(CopyFromState cstate, uint64 lineno)
+{
+	Assert(!cstate->opts.binary);
+
+	cstate->raw_buf_index = cstate->raw_buf_len = 0;
+	cstate->raw_buf[0] = '\0';
+	cstate->raw_reached_eof = false;
+	cstate->input_buf_index = cstate->input_buf_len = 0;
+	cstate->input_buf[0] = '\0';
+	cstate->input_reached_eof = false;
+	cstate->input_reached_error = false;
+	cstate->line_buf_valid = false;
+	cstate->cur_lineno = lineno - 1;
+}
+
 /*
  * Read raw fields in the next line for COPY FROM in text or csv mode.
  * Return false if no more lines.
@@ -967,6 +1167,36 @@ NextCopyFrom(CopyFromState cstate, ExprContext *econtext,
 
 		Assert(fieldno == attr_count);
 	}
+	else if (cstate->opts.columnar)
+	{
+		/* columnar */
+		ListCell   *cur;
+		int			fieldno = 0;
+		int			row;
+
+		while (cstate->columnar_nextrow >= cstate->columnar_nrows)
+		{
+			if (!CopyReadColumnarBatch(cstate))
+				return false;
+		}
+		row = cstate->columnar_nextrow++;
+
+		cstate->cur_lineno++;
+
+		foreach(cur, cstate->attnumlist)
+		{
+			int			attnum = lfirst_int(cur);
+			int			m = attnum - 1;
+			Form_pg_attribute att = TupleDescAttr(tupDesc, m);
+
+			cstate->cur_attname = NameStr(att->attname);
+			values[m] = CopyReadColumnarAttribute(cstate, fieldno++, row, att,
+												  &in_functions[m],
+												  typioparams[m],
+												  &nulls[m]);
+			cstate->cur_attname = NULL;
+		}
+	}
 	else
 	{
 		/* binary */
@@ -1143,6 +1373,10 @@ CopyReadLineText(CopyFromState cstate)
 	char		quotec = '\0';
 	char		escapec = '\0';
 
+	/* characters that need a closer look, see below */
+	char		key1 = '\\';
+	char		key2 = '\\';
+
 	if (cstate->opts.csv_mode)
 	{
 		quotec = cstate->opts.quote[0];
@@ -1150,6 +1384,8 @@ CopyReadLineText(CopyFromState cstate)
 		/* ignore special escape processing if it's the same as quotec */
 		if (quotec == escapec)
 			escapec = '\0';
+		key1 = quotec;
+		key2 = escapec ? escapec : quotec;
 	}
 
 	/*
@@ -1179,6 +1415,11 @@ CopyReadLineText(CopyFromState cstate)
 	 *
 	 * For a little extra speed within the loop, we copy input_buf and
 	 * input_buf_len into local variables.
+	 *
+	 * Most bytes are none of \r, \n, the backslash in text mode, or the
+	 * quote and escape characters in CSV mode, and need nothing done to them
+	 * but to become part of the line.  We use SIMD instructions to skip over
+	 * runs of such bytes a vector at a time.
 	 */
 	copy_input_buf = cstate->input_buf;
 	input_buf_ptr = cstate->input_buf_index;
@@ -1219,6 +1460,27 @@ CopyReadLineText(CopyFromState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip over bytes that can't end the line or change the quoting
+		 * state.  In CSV mode, a backslash only matters at the start of a
+		 * line, so don't skip there.
+		 */
+		if (!cstate->opts.csv_mode || !first_char_in_line)
+		{
+			int			nskip;
+
+			nskip = pg_lfind8_skip4('\n', '\r', key1, key2,
+									(const uint8 *) copy_input_buf + input_buf_ptr,
+									copy_buf_len - input_buf_ptr);
+			if (nskip > 0)
+			{
+				input_buf_ptr += nskip;
+				/* none of the skipped bytes was the escape character */
+				last_was_esc = false;
+				continue;
+			}
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = input_buf_ptr;
 		c = copy_input_buf[input_buf_ptr++];
@@ -1566,6 +1828,18 @@ CopyReadAttributesText(CopyFromState cstate)
 		for (;;)
 		{
 			char		c;
+			int			nskip;
+
+			/* Copy runs of bytes without delimiters or backslashes at once */
+			nskip = pg_lfind8_skip4(delimc, '\\', delimc, '\\',
+									(const uint8 *) cur_ptr,
+									line_end_ptr - cur_ptr);
+			if (nskip > 0)
+			{
+				memcpy(output_ptr, cur_ptr, nskip);
+				output_ptr += nskip;
+				cur_ptr += nskip;
+			}
 
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
@@ -1818,10 +2092,21 @@ CopyReadAttributesCSV(CopyFromState cstate)
 		for (;;)
 		{
 			char		c;
+			int			nskip;
 
 			/* Not in quote */
 			for (;;)
 			{
+				nskip = pg_lfind8_skip4(delimc, quotec, delimc, quotec,
+										(const uint8 *) cur_ptr,
+										line_end_ptr - cur_ptr);
+				if (nskip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nskip);
+					output_ptr += nskip;
+					cur_ptr += nskip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -1845,6 +2130,16 @@ CopyReadAttributesCSV(CopyFromState cstate)
 			/* In quote */
 			for (;;)
 			{
+				nskip = pg_lfind8_skip4(escapec, quotec, escapec, quotec,
+										(const uint8 *) cur_ptr,
+										line_end_ptr - cur_ptr);
+				if (nskip > 0)
+				{
+					memcpy(output_ptr, cur_ptr, nskip);
+					output_ptr += nskip;
+					cur_ptr += nskip;
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -1988,3 +2283,253 @@ CopyReadBinaryAttribute(CopyFromState cstate, FmgrInfo *flinfo,
 	*isnull = false;
 	return result;
 }
+
+/*
+ * Read the next batch of a columnar COPY file
+ *
+ * A batch starts with its row count and then holds, for each column in
+ * turn, a validity bitmap of one bit per row (least significant bit first,
+ * set for non-null values), followed by either the packed fixed-width
+ * values or nrows + 1 offsets and the variable-width data they point into.
+ * The buffers are read as they are; values are only decoded as
+ * NextCopyFrom returns each row.
+ *
+ * Returns false at the end-of-data marker, or at EOF.
+ */
+static bool
+CopyReadColumnarBatch(CopyFromState cstate)
+{
+	int			attr_count = list_length(cstate->attnumlist);
+	int32		nrows;
+	uint64		bitmap_len;
+	MemoryContext oldcontext;
+	int			i;
+
+	if (!CopyGetColumnarInt32(cstate, &nrows))
+	{
+		/* EOF detected (end of file, or protocol-level EOF) */
+		return false;
+	}
+
+	if (nrows == -1)
+	{
+		/*
+		 * Received EOF marker.  As in binary mode, wait for the
+		 * protocol-level EOF, and complain if it doesn't come immediately.
+		 */
+		char		dummy;
+
+		if (CopyReadBinaryData(cstate, &dummy, 1) > 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("received copy data after EOF marker")));
+		return false;
+	}
+
+	if (nrows < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+				 errmsg("invalid row count %d in COPY columnar batch",
+						(int) nrows)));
+
+	/* release the previous batch */
+	MemoryContextReset(cstate->columnar_context);
+	oldcontext = MemoryContextSwitchTo(cstate->columnar_context);
+
+	bitmap_len = ((uint64) nrows + 7) / 8;
+	for (i = 0; i < attr_count; i++)
+	{
+		int16		width = cstate->columnar_widths[i];
+
+		cstate->columnar_validity[i] = CopyReadColumnarBuffer(cstate,
+															  bitmap_len);
+		if (width > 0)
+		{
+			cstate->columnar_data[i] =
+				CopyReadColumnarBuffer(cstate, (uint64) nrows * width);
+			cstate->columnar_offsets[i] = NULL;
+		}
+		else
+		{
+			int32	   *offsets;
+			int			j;
+
+			offsets = CopyReadColumnarBuffer(cstate,
+											 ((uint64) nrows + 1) * sizeof(int32));
+			for (j = 0; j <= nrows; j++)
+			{
+				offsets[j] = (int32) pg_letoh32((uint32) offsets[j]);
+				if (j == 0 ? offsets[j] != 0 : offsets[j] < offsets[j - 1])
+					ereport(ERROR,
+							(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+							 errmsg("invalid offsets in COPY columnar batch")));
+			}
+			cstate->columnar_data[i] =
+				CopyReadColumnarBuffer(cstate, (uint64) offsets[nrows]);
+			cstate->columnar_offsets[i] = offsets;
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	cstate->columnar_nrows = nrows;
+	cstate->columnar_nextrow = 0;
+
+	return true;
+}
+
+/*
+ * Decode one value of the current columnar batch
+ *
+ * Packed fixed-width values are converted directly, with the same range
+ * checks the types' receive functions apply.  Variable-width values are
+ * handed to the receive function, as in binary mode.
+ */
+static Datum
+CopyReadColumnarAttribute(CopyFromState cstate, int fieldno, int row,
+						  Form_pg_attribute att, FmgrInfo *flinfo,
+						  Oid typioparam, bool *isnull)
+{
+	uint8	   *validity = cstate->columnar_validity[fieldno];
+	char	   *data = cstate->columnar_data[fieldno];
+	int16		width = cstate->columnar_widths[fieldno];
+	Datum		result;
+
+	if ((validity[row / 8] & (1 << (row % 8))) == 0)
+	{
+		*isnull = true;
+		/* packed columns are never domains, so there's nothing to check */
+		if (width > 0)
+			return (Datum) 0;
+		return ReceiveFunctionCall(flinfo, NULL, typioparam, att->atttypmod);
+	}
+	*isnull = false;
+
+	if (width > 0)
+	{
+		char	   *ptr = data + (Size) row * width;
+
+		switch (att->atttypid)
+		{
+			case BOOLOID:
+				return BoolGetDatum(*ptr != 0);
+			case INT2OID:
+				{
+					uint16		val;
+
+					memcpy(&val, ptr, sizeof(val));
+					return Int16GetDatum((int16) pg_letoh16(val));
+				}
+			case INT4OID:
+				{
+					uint32		val;
+
+					memcpy(&val, ptr, sizeof(val));
+					return Int32GetDatum((int32) pg_letoh32(val));
+				}
+			case OIDOID:
+				{
+					uint32		val;
+
+					memcpy(&val, ptr, sizeof(val));
+					return ObjectIdGetDatum((Oid) pg_letoh32(val));
+				}
+			case FLOAT4OID:
+				{
+					uint32		val;
+					float4		fval;
+
+					memcpy(&val, ptr, sizeof(val));
+					val = pg_letoh32(val);
+					memcpy(&fval, &val, sizeof(fval));
+					return Float4GetDatum(fval);
+				}
+			case DATEOID:
+				{
+					uint32		val;
+					DateADT		date;
+
+					memcpy(&val, ptr, sizeof(val));
+					date = (DateADT) pg_letoh32(val);
+					/* Limit to the same range that date_in() accepts. */
+					if (!DATE_NOT_FINITE(date) && !IS_VALID_DATE(date))
+						ereport(ERROR,
+								(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+								 errmsg("date out of range")));
+					return DateADTGetDatum(date);
+				}
+			case INT8OID:
+				{
+					uint64		val;
+
+					memcpy(&val, ptr, sizeof(val));
+					return Int64GetDatum((int64) pg_letoh64(val));
+				}
+			case FLOAT8OID:
+				{
+					uint64		val;
+					float8		fval;
+
+					memcpy(&val, ptr, sizeof(val));
+					val = pg_letoh64(val);
+					memcpy(&fval, &val, sizeof(fval));
+					return Float8GetDatum(fval);
+				}
+			case TIMEOID:
+				{
+					uint64		val;
+					TimeADT		time;
+
+					memcpy(&val, ptr, sizeof(val));
+					time = (TimeADT) pg_letoh64(val);
+					if (time < INT64CONST(0) || time > USECS_PER_DAY)
+						ereport(ERROR,
+								(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+								 errmsg("time out of range")));
+					return TimeADTGetDatum(time);
+				}
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				{
+					uint64		val;
+					Timestamp	timestamp;
+
+					memcpy(&val, ptr, sizeof(val));
+					timestamp = (Timestamp) pg_letoh64(val);
+					/* range check: see if timestamp_out would like it */
+					if (!TIMESTAMP_NOT_FINITE(timestamp) &&
+						!IS_VALID_TIMESTAMP(timestamp))
+						ereport(ERROR,
+								(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
+								 errmsg("timestamp out of range")));
+					return TimestampGetDatum(timestamp);
+				}
+			default:
+				elog(ERROR, "unexpected fixed-width column type %u",
+					 att->atttypid);
+				return (Datum) 0;	/* keep compiler quiet */
+		}
+	}
+	else
+	{
+		int32	   *offsets = cstate->columnar_offsets[fieldno];
+		int32		fld_size = offsets[row + 1] - offsets[row];
+
+		/* load the value into attribute_buf, as CopyReadBinaryAttribute does */
+		resetStringInfo(&cstate->attribute_buf);
+		appendBinaryStringInfo(&cstate->attribute_buf,
+							   data + offsets[row], fld_size);
+
+		/* Call the column type's binary input converter */
+		result = ReceiveFunctionCall(flinfo, &cstate->attribute_buf,
+									 typioparam, att->atttypmod);
+
+		/* Trouble if it didn't eat the whole buffer */
+		if (cstate->attribute_buf.cursor != cstate->attribute_buf.len)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("incorrect binary data format")));
+	}
+
+	return result;
+}
@@ -23,6 +23,8 @@
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_type.h"
 #include "commands/copy.h"
 #include "commands/progress.h"
 #include "executor/execdesc.h"
@@ -32,8 +34,12 @@
 #include "libpq/pqformat.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
+#include "port/pg_bswap.h"
+#include "port/pg_lfind.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/fd.h"
 #include "tcop/tcopprot.h"
@@ -99,6 +105,19 @@ typedef struct CopyToStateData
 	FmgrInfo   *out_functions;	/* lookup info for output functions */
 	MemoryContext rowcontext;	/* per-row evaluation context */
 	uint64		bytes_processed;	/* number of bytes processed so far */
+
+	/*
+	 * In columnar COPY TO, rows are accumulated column by column and sent
+	 * out a batch at a time by CopyColumnarFlush.  All arrays are indexed by
+	 * position in attnumlist.
+	 */
+	int16	   *columnar_widths;	/* fixed width of each column, or -1 */
+	StringInfoData *columnar_validity;	/* validity bitmaps */
+	StringInfoData *columnar_values;	/* packed values, or variable-width
+										 * data */
+	StringInfoData *columnar_offsets;	/* end offsets of variable-width
+										 * values */
+	int			columnar_nrows; /* number of rows in the pending batch */
 } CopyToStateData;
 
 /* DestReceiver for COPY (query) TO */
@@ -109,14 +128,26 @@ typedef struct
 	uint64		processed;		/* # of tuples processed */
 } DR_copy;
 
-/* NOTE: there's a copy of this in copyfromparse.c */
+/* NOTE: there's a copy of these in copyfromparse.c */
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
+static const char ColumnarSignature[11] = "PGCOLS\n\377\r\n\0";
+
+/*
+ * A columnar batch is sent out once it holds this many rows, or once the
+ * variable-width data of some column grows past COPY_COLUMNAR_BATCH_BYTES.
+ */
+#define COPY_COLUMNAR_BATCH_ROWS	4096
+#define COPY_COLUMNAR_BATCH_BYTES	(16 * 1024 * 1024)
 
 
 /* non-export function prototypes */
 static void EndCopy(CopyToState cstate);
+static PlannedStmt *CopyPlanQuery(CopyToState cstate, Query *query,
+								  const char *sourcetext);
 static void ClosePipeToProgram(CopyToState cstate);
 static void CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot);
+static void CopyOneRowToColumnar(CopyToState cstate, TupleTableSlot *slot);
+static void CopyColumnarFlush(CopyToState cstate);
 static void CopyAttributeOutText(CopyToState cstate, const char *string);
 static void CopyAttributeOutCSV(CopyToState cstate, const char *string,
 								bool use_quote, bool single_attr);
@@ -130,6 +161,8 @@ static void CopySendChar(CopyToState cstate, char c);
 static void CopySendEndOfRow(CopyToState cstate);
 static void CopySendInt32(CopyToState cstate, int32 val);
 static void CopySendInt16(CopyToState cstate, int16 val);
+static void CopySendColumnarInt32(CopyToState cstate, int32 val);
+static void CopySendColumnarInt16(CopyToState cstate, int16 val);
 
 
 /*
@@ -289,6 +322,78 @@ CopySendInt16(CopyToState cstate, int16 val)
 	CopySendData(cstate, &buf, sizeof(buf));
 }
 
+/*
+ * CopySendColumnarInt32 sends an int32 in little-endian byte order, as all
+ * integers of the columnar format are
+ */
+static inline void
+CopySendColumnarInt32(CopyToState cstate, int32 val)
+{
+	uint32		buf;
+
+	buf = pg_htole32((uint32) val);
+	CopySendData(cstate, &buf, sizeof(buf));
+}
+
+/*
+ * CopySendColumnarInt16 sends an int16 in little-endian byte order
+ */
+static inline void
+CopySendColumnarInt16(CopyToState cstate, int16 val)
+{
+	uint16		buf;
+
+	buf = pg_htole16((uint16) val);
+	CopySendData(cstate, &buf, sizeof(buf));
+}
+
+/*
+ * Plan the query of COPY (query) TO.
+ *
+ * Formatting the output columns is often most of the work of such a COPY.
+ * For text and CSV output of a SELECT, we first try a plan whose target
+ * list converts every column to text, which COPY then writes as is.  If the
+ * planner chooses a parallel plan for that, the conversions, being part of
+ * the scan/join target, run in the workers instead of the leader.  If it
+ * doesn't, they would only add a detour through text, so we plan the query
+ * as written instead.
+ */
+static PlannedStmt *
+CopyPlanQuery(CopyToState cstate, Query *query, const char *sourcetext)
+{
+	if (!cstate->opts.binary && query->commandType == CMD_SELECT &&
+		!query->hasModifyingCTE && max_parallel_workers_per_gather > 0)
+	{
+		Query	   *textquery = copyObject(query);
+		PlannedStmt *plan;
+		ListCell   *lc;
+
+		foreach(lc, textquery->targetList)
+		{
+			TargetEntry *tle = lfirst_node(TargetEntry, lc);
+			CoerceViaIO *iocoerce;
+
+			if (tle->resjunk || exprType((Node *) tle->expr) == TEXTOID)
+				continue;
+
+			iocoerce = makeNode(CoerceViaIO);
+			iocoerce->arg = tle->expr;
+			iocoerce->resulttype = TEXTOID;
+			iocoerce->resultcollid = DEFAULT_COLLATION_OID;
+			iocoerce->coerceformat = COERCE_IMPLICIT_CAST;
+			iocoerce->location = -1;
+			tle->expr = (Expr *) iocoerce;
+		}
+
+		plan = pg_plan_query(textquery, sourcetext, CURSOR_OPT_PARALLEL_OK,
+							 NULL);
+		if (plan->parallelModeNeeded)
+			return plan;
+	}
+
+	return pg_plan_query(query, sourcetext, CURSOR_OPT_PARALLEL_OK, NULL);
+}
+
 /*
  * Closes the pipe to an external program, checking the pclose() return code.
  */
@@ -518,8 +623,7 @@ BeginCopyTo(ParseState *pstate,
 		}
 
 		/* plan the query */
-		plan = pg_plan_query(query, pstate->p_sourcetext,
-							 CURSOR_OPT_PARALLEL_OK, NULL);
+		plan = CopyPlanQuery(cstate, query, pstate->p_sourcetext);
 
 		/*
 		 * With row-level security and a user using "COPY relation TO", we
@@ -798,7 +902,44 @@ DoCopyTo(CopyToState cstate)
 											   "COPY TO",
 											   ALLOCSET_DEFAULT_SIZES);
 
-	if (cstate->opts.binary)
+	if (cstate->opts.columnar)
+	{
+		/* Generate header for a columnar copy */
+		int			attr_count = list_length(cstate->attnumlist);
+		int			i = 0;
+
+		cstate->columnar_widths = (int16 *) palloc(attr_count * sizeof(int16));
+		cstate->columnar_validity = (StringInfoData *)
+			palloc(attr_count * sizeof(StringInfoData));
+		cstate->columnar_values = (StringInfoData *)
+			palloc(attr_count * sizeof(StringInfoData));
+		cstate->columnar_offsets = (StringInfoData *)
+			palloc(attr_count * sizeof(StringInfoData));
+		cstate->columnar_nrows = 0;
+
+		/* Signature */
+		CopySendData(cstate, ColumnarSignature, 11);
+		/* Flags field */
+		CopySendColumnarInt32(cstate, 0);
+		/* Column count and widths */
+		CopySendColumnarInt16(cstate, attr_count);
+		foreach(cur, cstate->attnumlist)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupDesc,
+												   lfirst_int(cur) - 1);
+
+			cstate->columnar_widths[i] = CopyColumnarWidth(attr->atttypid,
+														   attr->atttypmod);
+			CopySendColumnarInt16(cstate, cstate->columnar_widths[i]);
+
+			initStringInfo(&cstate->columnar_validity[i]);
+			initStringInfo(&cstate->columnar_values[i]);
+			if (cstate->columnar_widths[i] < 0)
+				initStringInfo(&cstate->columnar_offsets[i]);
+			i++;
+		}
+	}
+	else if (cstate->opts.binary)
 	{
 		/* Generate header for a binary copy */
 		int32		tmp;
@@ -887,7 +1028,15 @@ DoCopyTo(CopyToState cstate)
 		processed = ((DR_copy *) cstate->queryDesc->dest)->processed;
 	}
 
-	if (cstate->opts.binary)
+	if (cstate->opts.columnar)
+	{
+		/* Send out the last partial batch, and the trailer with it */
+		if (cstate->columnar_nrows > 0)
+			CopyColumnarFlush(cstate);
+		CopySendColumnarInt32(cstate, -1);
+		CopySendEndOfRow(cstate);
+	}
+	else if (cstate->opts.binary)
 	{
 		/* Generate trailer for a binary copy */
 		CopySendInt16(cstate, -1);
@@ -915,6 +1064,12 @@ CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot)
 	ListCell   *cur;
 	char	   *string;
 
+	if (cstate->opts.columnar)
+	{
+		CopyOneRowToColumnar(cstate, slot);
+		return;
+	}
+
 	MemoryContextReset(cstate->rowcontext);
 	oldcontext = MemoryContextSwitchTo(cstate->rowcontext);
 
@@ -978,6 +1133,179 @@ CopyOneRowTo(CopyToState cstate, TupleTableSlot *slot)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Add one row to the pending columnar batch during DoCopyTo().
+ *
+ * Values of fixed-width columns are appended as little-endian integers of
+ * the column's width, straight from the Datum; the Datums of float4 and
+ * float8 hold the IEEE bit pattern, so the integer accessors of the same
+ * width yield it.  Other values go through the type's send function, as in
+ * binary mode.
+ */
+static void
+CopyOneRowToColumnar(CopyToState cstate, TupleTableSlot *slot)
+{
+	FmgrInfo   *out_functions = cstate->out_functions;
+	int			row = cstate->columnar_nrows;
+	bool		batch_full;
+	MemoryContext oldcontext;
+	ListCell   *cur;
+	int			i = 0;
+
+	MemoryContextReset(cstate->rowcontext);
+	oldcontext = MemoryContextSwitchTo(cstate->rowcontext);
+
+	/* Make sure the tuple is fully deconstructed */
+	slot_getallattrs(slot);
+
+	batch_full = (row + 1 >= COPY_COLUMNAR_BATCH_ROWS);
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+		Datum		value = slot->tts_values[attnum - 1];
+		bool		isnull = slot->tts_isnull[attnum - 1];
+		int16		width = cstate->columnar_widths[i];
+		StringInfo	validity = &cstate->columnar_validity[i];
+		StringInfo	values = &cstate->columnar_values[i];
+
+		/* Validity bit, least significant bit first */
+		if (row % 8 == 0)
+			appendStringInfoCharMacro(validity, 0);
+		if (!isnull)
+			validity->data[row / 8] |= (char) (1 << (row % 8));
+
+		if (width > 0 && isnull)
+		{
+			/* null values still take up their slot */
+			enlargeStringInfo(values, width);
+			memset(values->data + values->len, 0, width);
+			values->len += width;
+		}
+		else if (width > 0)
+		{
+			switch (width)
+			{
+				case 1:
+					appendStringInfoCharMacro(values,
+											  DatumGetBool(value) ? 1 : 0);
+					break;
+				case 2:
+					{
+						uint16		buf = pg_htole16((uint16) DatumGetInt16(value));
+
+						appendBinaryStringInfo(values, &buf, sizeof(buf));
+					}
+					break;
+				case 4:
+					{
+						uint32		buf = pg_htole32((uint32) DatumGetInt32(value));
+
+						appendBinaryStringInfo(values, &buf, sizeof(buf));
+					}
+					break;
+				case 8:
+					{
+						uint64		buf = pg_htole64((uint64) DatumGetInt64(value));
+
+						appendBinaryStringInfo(values, &buf, sizeof(buf));
+					}
+					break;
+				default:
+					elog(ERROR, "unexpected column width %d", width);
+			}
+		}
+		else
+		{
+			uint32		end;
+
+			if (!isnull)
+			{
+				bytea	   *outputbytes;
+
+				outputbytes = SendFunctionCall(&out_functions[attnum - 1],
+											   value);
+				appendBinaryStringInfo(values, VARDATA(outputbytes),
+									   VARSIZE(outputbytes) - VARHDRSZ);
+			}
+			end = pg_htole32((uint32) values->len);
+			appendBinaryStringInfo(&cstate->columnar_offsets[i],
+								   &end, sizeof(end));
+
+			if (values->len >= COPY_COLUMNAR_BATCH_BYTES)
+				batch_full = true;
+		}
+		i++;
+	}
+
+	cstate->columnar_nrows++;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (batch_full)
+		CopyColumnarFlush(cstate);
+}
+
+/*
+ * Send out the pending columnar batch, as one message.
+ *
+ * See CopyReadColumnarBatch() in copyfromparse.c for the layout.
+ */
+static void
+CopyColumnarFlush(CopyToState cstate)
+{
+	int			attr_count = list_length(cstate->attnumlist);
+	int			i;
+
+	CopySendColumnarInt32(cstate, cstate->columnar_nrows);
+	for (i = 0; i < attr_count; i++)
+	{
+		StringInfo	validity = &cstate->columnar_validity[i];
+		StringInfo	values = &cstate->columnar_values[i];
+
+		CopySendData(cstate, validity->data, validity->len);
+		if (cstate->columnar_widths[i] < 0)
+		{
+			StringInfo	offsets = &cstate->columnar_offsets[i];
+
+			CopySendColumnarInt32(cstate, 0);
+			CopySendData(cstate, offsets->data, offsets->len);
+			resetStringInfo(offsets);
+		}
+		CopySendData(cstate, values->data, values->len);
+
+		resetStringInfo(validity);
+		resetStringInfo(values);
+	}
+	CopySendEndOfRow(cstate);
+
+	cstate->columnar_nrows = 0;
+}
+
+/*
+ * Return the number of leading bytes of s[0..len) that are known to need no
+ * escaping by CopyAttributeOutText(), examining whole vectors only.
+ */
+static inline int
+CopyTextSkipLiteral(const char *s, int len, char delimc)
+{
+	int			i;
+
+	/* round down to multiple of vector length */
+	int			tail_idx = len & ~(sizeof(Vector8) - 1);
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load(&chunk, (const uint8 *) &s[i]);
+		if (vector8_has_le(chunk, 0x1F) || vector8_has(chunk, '\\') ||
+			vector8_has(chunk, delimc))
+			break;
+	}
+
+	return i;
+}
+
 /*
  * Send text representation of one attribute, with conversion and escaping
  */
@@ -1012,7 +1340,8 @@ CopyAttributeOutText(CopyToState cstate, const char *string)
 	 * in valid backend encodings, extra bytes of a multibyte character never
 	 * look like ASCII.  This loop is sufficiently performance-critical that
 	 * it's worth making two copies of it to get the IS_HIGHBIT_SET() test out
-	 * of the normal safe-encoding path.
+	 * of the normal safe-encoding path.  In that path, we also skip over runs
+	 * of bytes that need no escaping a vector at a time.
 	 */
 	if (cstate->encoding_embeds_ascii)
 	{
@@ -1076,6 +1405,8 @@ CopyAttributeOutText(CopyToState cstate, const char *string)
 	}
 	else
 	{
+		const char *end = ptr + strlen(ptr);
+
 		start = ptr;
 		while ((c = *ptr) != '\0')
 		{
@@ -1129,7 +1460,10 @@ CopyAttributeOutText(CopyToState cstate, const char *string)
 				start = ptr++;	/* we include char in next run */
 			}
 			else
+			{
 				ptr++;
+				ptr += CopyTextSkipLiteral(ptr, end - ptr, delimc);
+			}
 		}
 	}
 
@@ -1150,6 +1484,8 @@ CopyAttributeOutCSV(CopyToState cstate, const char *string,
 	char		delimc = cstate->opts.delim[0];
 	char		quotec = cstate->opts.quote[0];
 	char		escapec = cstate->opts.escape[0];
+	const char *end;
+	int			len;
 
 	/* force quoting if it matches null_print (before conversion!) */
 	if (!use_quote && strcmp(string, cstate->opts.null_print) == 0)
@@ -1159,9 +1495,13 @@ CopyAttributeOutCSV(CopyToState cstate, const char *string,
 		ptr = pg_server_to_any(string, strlen(string), cstate->file_encoding);
 	else
 		ptr = string;
+	len = strlen(ptr);
+	end = ptr + len;
 
 	/*
-	 * Make a preliminary pass to discover if it needs quoting
+	 * Make a preliminary pass to discover if it needs quoting.  As in
+	 * CopyAttributeOutText, when the encoding is safe, skip over bytes that
+	 * need no attention a vector at a time.
 	 */
 	if (!use_quote)
 	{
@@ -1175,6 +1515,10 @@ CopyAttributeOutCSV(CopyToState cstate, const char *string,
 		{
 			const char *tptr = ptr;
 
+			if (!cstate->encoding_embeds_ascii)
+				tptr += pg_lfind8_skip4(delimc, quotec, '\n', '\r',
+										(const uint8 *) tptr, len);
+
 			while ((c = *tptr) != '\0')
 			{
 				if (c == delimc || c == quotec || c == '\n' || c == '\r')
@@ -1208,8 +1552,14 @@ CopyAttributeOutCSV(CopyToState cstate, const char *string,
 			}
 			if (IS_HIGHBIT_SET(c) && cstate->encoding_embeds_ascii)
 				ptr += pg_encoding_mblen(cstate->file_encoding, ptr);
+			else if (cstate->encoding_embeds_ascii)
+				ptr++;
 			else
+			{
 				ptr++;
+				ptr += pg_lfind8_skip4(quotec, escapec, quotec, escapec,
+									   (const uint8 *) ptr, end - ptr);
+			}
 		}
 		DUMPSOFAR();
 
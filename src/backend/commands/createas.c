@@ -26,12 +26,14 @@
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/reloptions.h"
 #include "access/sysattr.h"
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_am_d.h"
 #include "catalog/toasting.h"
 #include "commands/createas.h"
 #include "commands/matview.h"
@@ -55,6 +57,8 @@ typedef struct
 {
 	DestReceiver pub;			/* publicly-known function pointers */
 	IntoClause *into;			/* target relation specification */
+	Oid			relid;			/* in parallel workers, relation to insert
+								 * into instead */
 	/* These fields are filled by intorel_startup: */
 	Relation	rel;			/* relation to write to */
 	ObjectAddress reladdr;		/* address of rel, for ExecCreateTableAs */
@@ -69,6 +73,8 @@ static ObjectAddress create_ctas_nodata(List *tlist, IntoClause *into);
 
 /* DestReceiver routines for collecting data */
 static void intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
+static void intorel_worker_startup(DestReceiver *self, int operation,
+								   TupleDesc typeinfo);
 static bool intorel_receive(TupleTableSlot *slot, DestReceiver *self);
 static void intorel_shutdown(DestReceiver *self);
 static void intorel_destroy(DestReceiver *self);
@@ -332,6 +338,18 @@ ExecCreateTableAs(ParseState *pstate, CreateTableAsStmt *stmt,
 		/* call ExecutorStart to prepare the plan for execution */
 		ExecutorStart(queryDesc, GetIntoRelEFlags(into));
 
+		/*
+		 * If the plan is a Gather, let it and its workers insert what they
+		 * produce directly, rather than funnel it all through the Gather to
+		 * be inserted by us alone.  That can't be done when the Gather has
+		 * to project, since workers don't do that for it, nor for a
+		 * single-copy Gather, whose one worker would gain us nothing.
+		 */
+		if (IsA(queryDesc->planstate, GatherState) &&
+			!((Gather *) queryDesc->planstate->plan)->single_copy &&
+			queryDesc->planstate->ps_ProjInfo == NULL)
+			((GatherState *) queryDesc->planstate)->insert_dest = dest;
+
 		/* run the plan to completion */
 		ExecutorRun(queryDesc, ForwardScanDirection, 0, true);
 
@@ -452,6 +470,45 @@ CreateIntoRelDestReceiver(IntoClause *intoClause)
 	return (DestReceiver *) self;
 }
 
+/*
+ * CreateIntoRelWorkerDestReceiver -- create a DestReceiver for a parallel
+ * worker inserting into the relation a CREATE TABLE AS created in the leader
+ */
+DestReceiver *
+CreateIntoRelWorkerDestReceiver(Oid relid)
+{
+	DR_intorel *self = (DR_intorel *) CreateIntoRelDestReceiver(NULL);
+
+	self->pub.rStartup = intorel_worker_startup;
+	self->relid = relid;
+
+	return (DestReceiver *) self;
+}
+
+/*
+ * IntoRelGetRelid -- the relation parallel workers can insert into
+ *
+ * Returns the OID of the relation intorel_startup created, if parallel
+ * workers can insert into it, else InvalidOid.  Workers can't access
+ * temporary relations, and other table AMs than heap might not be prepared
+ * to have several backends insert into a relation at once.
+ */
+Oid
+IntoRelGetRelid(DestReceiver *self)
+{
+	DR_intorel *myState = (DR_intorel *) self;
+	Relation	rel = myState->rel;
+
+	Assert(self->mydest == DestIntoRel && rel != NULL);
+
+	if (myState->bistate == NULL ||
+		rel->rd_rel->relpersistence == RELPERSISTENCE_TEMP ||
+		rel->rd_rel->relam != HEAP_TABLE_AM_OID)
+		return InvalidOid;
+
+	return RelationGetRelid(rel);
+}
+
 /*
  * intorel_startup --- executor startup
  */
@@ -576,6 +633,26 @@ intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 	Assert(RelationGetTargetBlock(intoRelationDesc) == InvalidBlockNumber);
 }
 
+/*
+ * intorel_worker_startup --- executor startup in a parallel worker
+ *
+ * The leader has created the relation already, and holds
+ * AccessExclusiveLock on it, which doesn't conflict with ours since we're
+ * in its lock group.  Its command ID is ours too.
+ */
+static void
+intorel_worker_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	DR_intorel *myState = (DR_intorel *) self;
+
+	Assert(IsParallelWorker());
+
+	myState->rel = table_open(myState->relid, RowExclusiveLock);
+	myState->output_cid = GetCurrentCommandId(true);
+	myState->ti_options = TABLE_INSERT_SKIP_FSM;
+	myState->bistate = GetBulkInsertState();
+}
+
 /*
  * intorel_receive --- receive one tuple
  */
@@ -585,7 +662,7 @@ intorel_receive(TupleTableSlot *slot, DestReceiver *self)
 	DR_intorel *myState = (DR_intorel *) self;
 
 	/* Nothing to insert if WITH NO DATA is specified. */
-	if (!myState->into->skipData)
+	if (myState->bistate != NULL)
 	{
 		/*
 		 * Note that the input slot might not be of the type of the target
@@ -614,9 +691,8 @@ static void
 intorel_shutdown(DestReceiver *self)
 {
 	DR_intorel *myState = (DR_intorel *) self;
-	IntoClause *into = myState->into;
 
-	if (!into->skipData)
+	if (myState->bistate != NULL)
 	{
 		FreeBulkInsertState(myState->bistate);
 		table_finish_bulk_insert(myState->rel, myState->ti_options);
@@ -67,6 +67,9 @@
 #include "utils/guc.h"
 #include "utils/pg_locale.h"
 #include "utils/relmapper.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
+#include "utils/sharedtypcache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -1557,6 +1560,7 @@ createdb_failure_callback(int code, Datum arg)
 	if (fparms->strategy == CREATEDB_WAL_LOG)
 	{
 		DropDatabaseBuffers(fparms->dest_dboid);
+		RelSizeDropDatabase(fparms->dest_dboid);
 		ForgetDatabaseSyncRequests(fparms->dest_dboid);
 
 		/* Release lock on the target database. */
@@ -1761,6 +1765,14 @@ dropdb(const char *dbname, bool missing_ok, bool force)
 	 */
 	DropDatabaseBuffers(db_id);
 
+	/* The cached sizes of its relations go too, as its files are removed */
+	RelSizeDropDatabase(db_id);
+
+	/* So do its catalog tuples in the shared catalog cache, and its plans */
+	SharedCatCacheDropDatabase(db_id);
+	SharedPlanCacheDropDatabase(db_id);
+	SharedTypeCacheDropDatabase(db_id);
+
 	/*
 	 * Tell checkpointer to forget any pending fsync and unlink requests for
 	 * files in the database; else the fsyncs will fail at next checkpoint, or
@@ -2042,6 +2054,7 @@ movedb(const char *dbname, const char *tblspcname)
 	 * src_tblspcoid, but bufmgr.c presently provides no API for that.
 	 */
 	DropDatabaseBuffers(db_id);
+	RelSizeDropDatabase(db_id);
 
 	/*
 	 * Check for existence of files in the target directory, i.e., objects of
@@ -3203,6 +3216,7 @@ dbase_redo(XLogReaderState *record)
 		 */
 		if (stat(dst_path, &st) == 0 && S_ISDIR(st.st_mode))
 		{
+			RelSizeDropDatabase(xlrec->db_id);
 			if (!rmtree(dst_path, true))
 				/* If this failed, copydir() below is going to error. */
 				ereport(WARNING,
@@ -3302,6 +3316,10 @@ dbase_redo(XLogReaderState *record)
 
 		/* Drop pages for this database that are in the shared buffer cache */
 		DropDatabaseBuffers(xlrec->db_id);
+		RelSizeDropDatabase(xlrec->db_id);
+		SharedCatCacheDropDatabase(xlrec->db_id);
+		SharedPlanCacheDropDatabase(xlrec->db_id);
+		SharedTypeCacheDropDatabase(xlrec->db_id);
 
 		/* Also, clean out any fsync requests that might be pending in md.c */
 		ForgetDatabaseSyncRequests(xlrec->db_id);
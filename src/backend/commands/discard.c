@@ -19,6 +19,8 @@
 #include "commands/discard.h"
 #include "commands/prepare.h"
 #include "commands/sequence.h"
+#include "executor/nodeSubplan.h"
+#include "tcop/stmtcache.h"
 #include "utils/guc.h"
 #include "utils/portal.h"
 
@@ -38,6 +40,8 @@ DiscardCommand(DiscardStmt *stmt, bool isTopLevel)
 
 		case DISCARD_PLANS:
 			ResetPlanCache();
+			StmtCacheReset();
+			ResetInitPlanCache();
 			break;
 
 		case DISCARD_SEQUENCES:
@@ -73,6 +77,8 @@ DiscardAll(bool isTopLevel)
 	Async_UnlistenAll();
 	LockReleaseAll(USER_LOCKMETHOD, true);
 	ResetPlanCache();
+	StmtCacheReset();
+	ResetInitPlanCache();
 	ResetTempTableNamespace();
 	ResetSequenceCaches();
 }
@@ -28,6 +28,7 @@
 #include "parser/parsetree.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/bufmgr.h"
+#include "storage/fd.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/guc_tables.h"
@@ -109,11 +110,15 @@ static void show_sort_info(SortState *sortstate, ExplainState *es);
 static void show_incremental_sort_info(IncrementalSortState *incrsortstate,
 									   ExplainState *es);
 static void show_hash_info(HashState *hashstate, ExplainState *es);
+static void show_nestloop_hash_info(NestLoopState *nlstate,
+									List *ancestors, ExplainState *es);
 static void show_memoize_info(MemoizeState *mstate, List *ancestors,
 							  ExplainState *es);
 static void show_hashagg_info(AggState *aggstate, ExplainState *es);
 static void show_tidbitmap_info(BitmapHeapScanState *planstate,
 								ExplainState *es);
+static void show_tuple_queue_stalls(uint64 full_stalls, uint64 empty_stalls,
+									ExplainState *es);
 static void show_instrumentation_count(const char *qlabel, int which,
 									   PlanState *planstate, ExplainState *es);
 static void show_foreignscan_info(ForeignScanState *fsstate, ExplainState *es);
@@ -121,7 +126,10 @@ static void show_eval_params(Bitmapset *bms_params, ExplainState *es);
 static const char *explain_get_index_name(Oid indexId);
 static void show_buffer_usage(ExplainState *es, const BufferUsage *usage,
 							  bool planning);
+static void show_planning_detail(ExplainState *es,
+								 const PlannerInstrumentation *planinstr);
 static void show_wal_usage(ExplainState *es, const WalUsage *usage);
+static void show_temp_file_usage(PlanState *planstate, ExplainState *es);
 static void ExplainIndexScanDetails(Oid indexid, ScanDirection indexorderdir,
 									ExplainState *es);
 static void ExplainScanTarget(Scan *plan, ExplainState *es);
@@ -192,11 +200,22 @@ ExplainQuery(ParseState *pstate, ExplainStmt *stmt,
 			es->settings = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "generic_plan") == 0)
 			es->generic = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "planning_detail") == 0)
+			es->planning_detail = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "timing") == 0)
 		{
 			timing_set = true;
 			es->timing = defGetBoolean(opt);
 		}
+		else if (strcmp(opt->defname, "timing_sample") == 0)
+		{
+			es->timing_sample = defGetInt32(opt);
+			if (es->timing_sample < 1)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("EXPLAIN option TIMING_SAMPLE must be at least 1"),
+						 parser_errposition(pstate, opt->location)));
+		}
 		else if (strcmp(opt->defname, "summary") == 0)
 		{
 			summary_set = true;
@@ -244,6 +263,12 @@ ExplainQuery(ParseState *pstate, ExplainStmt *stmt,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("EXPLAIN option TIMING requires ANALYZE")));
 
+	/* check that TIMING_SAMPLE is used with TIMING */
+	if (es->timing_sample > 1 && !es->timing)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("EXPLAIN option TIMING_SAMPLE requires TIMING")));
+
 	/* check that GENERIC_PLAN is not used with EXPLAIN ANALYZE */
 	if (es->generic && es->analyze)
 		ereport(ERROR,
@@ -397,13 +422,28 @@ ExplainOneQuery(Query *query, int cursorOptions,
 					planduration;
 		BufferUsage bufusage_start,
 					bufusage;
+		PlannerInstrumentation planinstr;
 
 		if (es->buffers)
 			bufusage_start = pgBufferUsage;
 		INSTR_TIME_SET_CURRENT(planstart);
 
-		/* plan the query */
-		plan = pg_plan_query(query, queryString, cursorOptions, params);
+		/* plan the query, collecting planner details if asked for */
+		if (es->planning_detail)
+		{
+			PlannerInstrumentBegin(&planinstr);
+			PG_TRY();
+			{
+				plan = pg_plan_query(query, queryString, cursorOptions, params);
+			}
+			PG_FINALLY();
+			{
+				PlannerInstrumentEnd(&planinstr);
+			}
+			PG_END_TRY();
+		}
+		else
+			plan = pg_plan_query(query, queryString, cursorOptions, params);
 
 		INSTR_TIME_SET_CURRENT(planduration);
 		INSTR_TIME_SUBTRACT(planduration, planstart);
@@ -417,7 +457,8 @@ ExplainOneQuery(Query *query, int cursorOptions,
 
 		/* run it (if needed) and produce output */
 		ExplainOnePlan(plan, into, es, queryString, params, queryEnv,
-					   &planduration, (es->buffers ? &bufusage : NULL));
+					   &planduration, (es->buffers ? &bufusage : NULL),
+					   (es->planning_detail ? &planinstr : NULL));
 	}
 }
 
@@ -527,7 +568,8 @@ void
 ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 			   const char *queryString, ParamListInfo params,
 			   QueryEnvironment *queryEnv, const instr_time *planduration,
-			   const BufferUsage *bufusage)
+			   const BufferUsage *bufusage,
+			   const PlannerInstrumentation *planinstr)
 {
 	DestReceiver *dest;
 	QueryDesc  *queryDesc;
@@ -575,6 +617,7 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 	queryDesc = CreateQueryDesc(plannedstmt, queryString,
 								GetActiveSnapshot(), InvalidSnapshot,
 								dest, params, queryEnv, instrument_option);
+	queryDesc->instrument_sample = es->timing_sample;
 
 	/* Select execution options */
 	if (es->analyze)
@@ -623,6 +666,10 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 		ExplainCloseGroup("Planning", "Planning", true, es);
 	}
 
+	/* Show where planning time and effort went */
+	if (planinstr)
+		show_planning_detail(es, planinstr);
+
 	if (es->summary && planduration)
 	{
 		double		plantime = INSTR_TIME_GET_DOUBLE(*planduration);
@@ -671,6 +718,10 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 		ExplainPropertyFloat("Execution Time", "ms", 1000.0 * totaltime, 3,
 							 es);
 
+	/* say so when the node times are extrapolated from a sample */
+	if (es->analyze && es->timing && es->timing_sample > 1)
+		ExplainPropertyInteger("Timing Sample", NULL, es->timing_sample, es);
+
 	ExplainCloseGroup("Query", NULL, true, es);
 }
 
@@ -1854,11 +1905,12 @@ ExplainNode(PlanState *planstate, List *ancestors,
 
 				if (es->analyze)
 				{
-					int			nworkers;
+					GatherState *gstate = (GatherState *) planstate;
 
-					nworkers = ((GatherState *) planstate)->nworkers_launched;
 					ExplainPropertyInteger("Workers Launched", NULL,
-										   nworkers, es);
+										   gstate->nworkers_launched, es);
+					show_tuple_queue_stalls(gstate->queue_full_stalls,
+											gstate->queue_empty_stalls, es);
 				}
 
 				if (gather->single_copy || es->format != EXPLAIN_FORMAT_TEXT)
@@ -1882,11 +1934,12 @@ ExplainNode(PlanState *planstate, List *ancestors,
 
 				if (es->analyze)
 				{
-					int			nworkers;
+					GatherMergeState *gmstate = (GatherMergeState *) planstate;
 
-					nworkers = ((GatherMergeState *) planstate)->nworkers_launched;
 					ExplainPropertyInteger("Workers Launched", NULL,
-										   nworkers, es);
+										   gmstate->nworkers_launched, es);
+					show_tuple_queue_stalls(gmstate->queue_full_stalls,
+											gmstate->queue_empty_stalls, es);
 				}
 			}
 			break;
@@ -1989,6 +2042,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			if (plan->qual)
 				show_instrumentation_count("Rows Removed by Filter", 2,
 										   planstate, es);
+			show_nestloop_hash_info(castNode(NestLoopState, planstate),
+									ancestors, es);
 			break;
 		case T_MergeJoin:
 			show_upper_qual(((MergeJoin *) plan)->mergeclauses,
@@ -2101,6 +2156,8 @@ ExplainNode(PlanState *planstate, List *ancestors,
 		show_buffer_usage(es, &planstate->instrument->bufusage, false);
 	if (es->wal && planstate->instrument)
 		show_wal_usage(es, &planstate->instrument->walusage);
+	if (es->buffers && planstate->instrument && planstate->temp_file_owner)
+		show_temp_file_usage(planstate, es);
 
 	/* Prepare per-worker buffer/WAL usage */
 	if (es->workers_state && (es->buffers || es->wal) && es->verbose)
@@ -3139,6 +3196,59 @@ show_hash_info(HashState *hashstate, ExplainState *es)
 	}
 }
 
+/*
+ * Show the clauses a nested loop can hash its inner side on, and whether it
+ * did switch to hashing.
+ */
+static void
+show_nestloop_hash_info(NestLoopState *nlstate, List *ancestors,
+						ExplainState *es)
+{
+	NestLoop   *plan = (NestLoop *) nlstate->js.ps.plan;
+
+	if (es->verbose)
+		show_upper_qual(plan->adaptive_hashclauses, "Adaptive Hash Cond",
+						(PlanState *) nlstate, ancestors, es);
+
+	if (!es->analyze)
+		return;
+
+	if (nlstate->nl_HashSwitchedAfter > 0)
+	{
+		int64		spacePeakKb = (nlstate->nl_HashSpaceUsed + 1023) / 1024;
+
+		if (es->format != EXPLAIN_FORMAT_TEXT)
+		{
+			ExplainPropertyInteger("Switched to Hash After", "rows",
+								   nlstate->nl_HashSwitchedAfter, es);
+			ExplainPropertyInteger("Hashed Inner Rows", NULL,
+								   nlstate->nl_HashInnerTuples, es);
+			ExplainPropertyInteger("Hash Memory Usage", "kB",
+								   spacePeakKb, es);
+		}
+		else
+		{
+			ExplainIndentText(es);
+			appendStringInfo(es->str,
+							 "Switched to Hash: after " INT64_FORMAT " outer rows  Inner Rows: " INT64_FORMAT "  Memory Usage: " INT64_FORMAT "kB\n",
+							 nlstate->nl_HashSwitchedAfter,
+							 nlstate->nl_HashInnerTuples,
+							 spacePeakKb);
+		}
+	}
+	else if (nlstate->nl_HashAbandoned)
+	{
+		if (es->format != EXPLAIN_FORMAT_TEXT)
+			ExplainPropertyBool("Hash Switch Abandoned", true, es);
+		else
+		{
+			ExplainIndentText(es);
+			appendStringInfoString(es->str,
+								   "Switch to Hash: abandoned, inner side exceeds hash memory\n");
+		}
+	}
+}
+
 /*
  * Show information on memoize hits/misses/evictions and memory usage.
  */
@@ -3432,6 +3542,34 @@ show_tidbitmap_info(BitmapHeapScanState *planstate, ExplainState *es)
 	}
 }
 
+/*
+ * Show how often a Gather or Gather Merge node's tuple queues stalled, with
+ * a worker waiting for room or the leader waiting for tuples
+ */
+static void
+show_tuple_queue_stalls(uint64 full_stalls, uint64 empty_stalls,
+						ExplainState *es)
+{
+	if (es->format != EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainPropertyUInteger("Queue Full Stalls", NULL, full_stalls, es);
+		ExplainPropertyUInteger("Queue Empty Stalls", NULL, empty_stalls, es);
+	}
+	else
+	{
+		if (full_stalls > 0 || empty_stalls > 0)
+		{
+			ExplainIndentText(es);
+			appendStringInfoString(es->str, "Queue Stalls:");
+			if (full_stalls > 0)
+				appendStringInfo(es->str, " full=" UINT64_FORMAT, full_stalls);
+			if (empty_stalls > 0)
+				appendStringInfo(es->str, " empty=" UINT64_FORMAT, empty_stalls);
+			appendStringInfoChar(es->str, '\n');
+		}
+	}
+}
+
 /*
  * If it's EXPLAIN ANALYZE, show instrumentation information for a plan node
  *
@@ -3698,6 +3836,69 @@ show_buffer_usage(ExplainState *es, const BufferUsage *usage, bool planning)
 	}
 }
 
+/*
+ * Show the planner's phase timings, counters and memory use.
+ */
+static void
+show_planning_detail(ExplainState *es, const PlannerInstrumentation *planinstr)
+{
+	int64		memoryKb = (planinstr->memory_allocated + 1023) / 1024;
+
+	ExplainOpenGroup("Planning Detail", "Planning Detail", true, es);
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainIndentText(es);
+		appendStringInfoString(es->str, "Planning Detail:\n");
+		es->indent++;
+
+		ExplainIndentText(es);
+		appendStringInfo(es->str,
+						 "Timing: expansion=%0.3f paths=%0.3f join search=%0.3f selectivity=%0.3f\n",
+						 INSTR_TIME_GET_MILLISEC(planinstr->expand_time),
+						 INSTR_TIME_GET_MILLISEC(planinstr->path_time),
+						 INSTR_TIME_GET_MILLISEC(planinstr->join_time),
+						 INSTR_TIME_GET_MILLISEC(planinstr->selectivity_time));
+
+		ExplainIndentText(es);
+		appendStringInfo(es->str,
+						 "Counts: paths=%lld join rels=%lld selectivity calls=%lld\n",
+						 (long long) planinstr->paths_considered,
+						 (long long) planinstr->joinrels_built,
+						 (long long) planinstr->selectivity_calls);
+
+		ExplainIndentText(es);
+		appendStringInfo(es->str, "Memory: allocated=" INT64_FORMAT "kB\n",
+						 memoryKb);
+
+		es->indent--;
+	}
+	else
+	{
+		ExplainPropertyFloat("Expansion Time", "ms",
+							 INSTR_TIME_GET_MILLISEC(planinstr->expand_time),
+							 3, es);
+		ExplainPropertyFloat("Path Generation Time", "ms",
+							 INSTR_TIME_GET_MILLISEC(planinstr->path_time),
+							 3, es);
+		ExplainPropertyFloat("Join Search Time", "ms",
+							 INSTR_TIME_GET_MILLISEC(planinstr->join_time),
+							 3, es);
+		ExplainPropertyFloat("Selectivity Time", "ms",
+							 INSTR_TIME_GET_MILLISEC(planinstr->selectivity_time),
+							 3, es);
+		ExplainPropertyInteger("Paths Considered", NULL,
+							   planinstr->paths_considered, es);
+		ExplainPropertyInteger("Join Rels Built", NULL,
+							   planinstr->joinrels_built, es);
+		ExplainPropertyInteger("Selectivity Calls", NULL,
+							   planinstr->selectivity_calls, es);
+		ExplainPropertyInteger("Memory Allocated", "kB", memoryKb, es);
+	}
+
+	ExplainCloseGroup("Planning Detail", "Planning Detail", true, es);
+}
+
 /*
  * Show WAL usage details.
  */
@@ -3736,6 +3937,41 @@ show_wal_usage(ExplainState *es, const WalUsage *usage)
 	}
 }
 
+/*
+ * Show the temporary files used by a node that spilled to them, as charged
+ * by fd.c.  Parallel workers' files are not included.
+ */
+static void
+show_temp_file_usage(PlanState *planstate, ExplainState *es)
+{
+	int			files;
+	int64		bytes_written;
+	int64		peak_size;
+	int64		writtenKb;
+	int64		peakKb;
+
+	if (!GetTempFileOwnerUsage(planstate->temp_file_owner, &files,
+							   &bytes_written, &peak_size))
+		return;
+
+	writtenKb = (bytes_written + 1023) / 1024;
+	peakKb = (peak_size + 1023) / 1024;
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		ExplainIndentText(es);
+		appendStringInfo(es->str,
+						 "Temp Files: %d  Written: " INT64_FORMAT "kB  Peak Size: " INT64_FORMAT "kB\n",
+						 files, writtenKb, peakKb);
+	}
+	else
+	{
+		ExplainPropertyInteger("Temp Files", NULL, files, es);
+		ExplainPropertyInteger("Temp Written", "kB", writtenKb, es);
+		ExplainPropertyInteger("Temp Peak Size", "kB", peakKb, es);
+	}
+}
+
 /*
  * Add some additional details about an IndexScan or IndexOnlyScan
  */
@@ -24,6 +24,7 @@
 #include "access/xact.h"
 #include "catalog/catalog.h"
 #include "catalog/index.h"
+#include "catalog/indextidlog.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_constraint.h"
@@ -572,6 +573,7 @@ DefineIndex(Oid relationId,
 	Oid			root_save_userid;
 	int			root_save_sec_context;
 	int			root_save_nestlevel;
+	bool		use_tidlog;
 
 	root_save_nestlevel = NewGUCNestLevel();
 
@@ -1592,6 +1594,16 @@ DefineIndex(Oid relationId,
 	 */
 	LockRelationIdForSession(&heaprelid, ShareUpdateExclusiveLock);
 
+	/*
+	 * For btree indexes, have the writers that see the index before it is
+	 * ready for inserts log the TIDs they insert, so that we can validate the
+	 * index from that log rather than by scanning the whole table again (see
+	 * indextidlog.c).  This must be set up before our commit makes the index
+	 * visible.
+	 */
+	use_tidlog = (accessMethodId == BTREE_AM_OID &&
+				  index_tidlog_begin(indexRelationId));
+
 	PopActiveSnapshot();
 	CommitTransactionCommand();
 	StartTransactionCommand();
@@ -1701,9 +1713,16 @@ DefineIndex(Oid relationId,
 	PushActiveSnapshot(snapshot);
 
 	/*
-	 * Scan the index and the heap, insert any missing index entries.
+	 * Insert any missing index entries.  If we have a complete log of the
+	 * TIDs inserted since the index became visible, only those tuples need
+	 * checking; all writers that were logging are gone by now.  Otherwise
+	 * scan the index and the heap.
 	 */
-	validate_index(relationId, indexRelationId, snapshot);
+	if (!use_tidlog ||
+		!index_tidlog_merge(relationId, indexRelationId, snapshot))
+		validate_index(relationId, indexRelationId, snapshot);
+	if (use_tidlog)
+		index_tidlog_end(indexRelationId);
 
 	/*
 	 * Drop the reference snapshot.  We must do this before waiting out other
@@ -204,7 +204,7 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 	 * are internal errors, so elog is sufficient.
 	 */
 	if (matviewRel->rd_rel->relhasrules == false ||
-		matviewRel->rd_rules->numLocks < 1)
+		RelationGetRuleLock(matviewRel)->numLocks < 1)
 		elog(ERROR,
 			 "materialized view \"%s\" is missing rewrite information",
 			 RelationGetRelationName(matviewRel));
@@ -558,6 +558,16 @@ DropAllPreparedStatements(void)
 	}
 }
 
+/*
+ * Are there any prepared statements in this session?
+ */
+bool
+HavePreparedStatements(void)
+{
+	return prepared_queries != NULL &&
+		hash_get_num_entries(prepared_queries) > 0;
+}
+
 /*
  * Implements the 'EXPLAIN EXECUTE' utility statement.
  *
@@ -583,6 +593,7 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 	instr_time	planduration;
 	BufferUsage bufusage_start,
 				bufusage;
+	PlannerInstrumentation planinstr;
 
 	if (es->buffers)
 		bufusage_start = pgBufferUsage;
@@ -617,9 +628,28 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 		paramLI = EvaluateParams(pstate, entry, execstmt->params, estate);
 	}
 
-	/* Replan if needed, and acquire a transient refcount */
-	cplan = GetCachedPlan(entry->plansource, paramLI,
-						  CurrentResourceOwner, queryEnv);
+	/*
+	 * Replan if needed, and acquire a transient refcount.  If a plan is
+	 * built, it lives in its own context, so the planner's memory use isn't
+	 * seen here.
+	 */
+	if (es->planning_detail)
+	{
+		PlannerInstrumentBegin(&planinstr);
+		PG_TRY();
+		{
+			cplan = GetCachedPlan(entry->plansource, paramLI,
+								  CurrentResourceOwner, queryEnv);
+		}
+		PG_FINALLY();
+		{
+			PlannerInstrumentEnd(&planinstr);
+		}
+		PG_END_TRY();
+	}
+	else
+		cplan = GetCachedPlan(entry->plansource, paramLI,
+							  CurrentResourceOwner, queryEnv);
 
 	INSTR_TIME_SET_CURRENT(planduration);
 	INSTR_TIME_SUBTRACT(planduration, planstart);
@@ -640,7 +670,8 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 
 		if (pstmt->commandType != CMD_UTILITY)
 			ExplainOnePlan(pstmt, into, es, query_string, paramLI, queryEnv,
-						   &planduration, (es->buffers ? &bufusage : NULL));
+						   &planduration, (es->buffers ? &bufusage : NULL),
+						   (es->planning_detail ? &planinstr : NULL));
 		else
 			ExplainOneUtility(pstmt->utilityStmt, into, es, query_string,
 							  paramLI, queryEnv);
@@ -83,12 +83,13 @@ CreateStatistics(CreateStatsStmt *stmt)
 	Oid			relid;
 	ObjectAddress parentobject,
 				myself;
-	Datum		types[4];		/* one for each possible type of statistic */
+	Datum		types[5];		/* one for each possible type of statistic */
 	int			ntypes;
 	ArrayType  *stxkind;
 	bool		build_ndistinct;
 	bool		build_dependencies;
 	bool		build_mcv;
+	bool		build_sketch;
 	bool		build_expressions;
 	bool		requested_type = false;
 	int			i;
@@ -329,26 +330,11 @@ CreateStatistics(CreateStatsStmt *stmt)
 		}
 	}
 
-	/*
-	 * Parse the statistics kinds.
-	 *
-	 * First check that if this is the case with a single expression, there
-	 * are no statistics kinds specified (we don't allow that for the simple
-	 * CREATE STATISTICS form).
-	 */
-	if ((list_length(stmt->exprs) == 1) && (list_length(stxexprs) == 1))
-	{
-		/* statistics kinds not specified */
-		if (stmt->stat_types != NIL)
-			ereport(ERROR,
-					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-					 errmsg("when building statistics on a single expression, statistics kinds may not be specified")));
-	}
-
-	/* OK, let's check that we recognize the statistics kinds. */
+	/* Parse the statistics kinds. */
 	build_ndistinct = false;
 	build_dependencies = false;
 	build_mcv = false;
+	build_sketch = false;
 	foreach(cell, stmt->stat_types)
 	{
 		char	   *type = strVal(lfirst(cell));
@@ -368,6 +354,11 @@ CreateStatistics(CreateStatsStmt *stmt)
 			build_mcv = true;
 			requested_type = true;
 		}
+		else if (strcmp(type, "sketch") == 0)
+		{
+			build_sketch = true;
+			requested_type = true;
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -375,6 +366,49 @@ CreateStatistics(CreateStatsStmt *stmt)
 							type)));
 	}
 
+	/*
+	 * A sketch is on a single column or expression, and can't be combined
+	 * with the other kinds, which need at least two.  Its values are hashed,
+	 * so the data type needs a default hash operator class.
+	 */
+	if (build_sketch)
+	{
+		Oid			atttype;
+
+		if (numcols != 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_OBJECT_DEFINITION),
+					 errmsg("sketch statistics require exactly one column or expression")));
+		if (build_ndistinct || build_dependencies || build_mcv)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_OBJECT_DEFINITION),
+					 errmsg("sketch statistics cannot be combined with other statistics kinds")));
+
+		if (nattnums == 1)
+			atttype = get_atttype(relid, attnums[0]);
+		else
+			atttype = exprType(linitial(stxexprs));
+		if (!OidIsValid(lookup_type_cache(atttype, TYPECACHE_HASH_OPFAMILY)->hash_opf))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("sketch statistics cannot be built on type %s because it has no default hash operator class",
+							format_type_be(atttype))));
+	}
+
+	/*
+	 * Check that if this is the case with a single expression, there are no
+	 * statistics kinds specified (we don't allow that for the simple CREATE
+	 * STATISTICS form), other than a sketch.
+	 */
+	if ((list_length(stmt->exprs) == 1) && (list_length(stxexprs) == 1))
+	{
+		/* statistics kinds not specified */
+		if (stmt->stat_types != NIL && !build_sketch)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("when building statistics on a single expression, statistics kinds may not be specified")));
+	}
+
 	/*
 	 * If no statistic type was specified, build them all (but only when the
 	 * statistics is defined on more than one column/expression).
@@ -397,7 +431,7 @@ CreateStatistics(CreateStatsStmt *stmt)
 	 * Check that at least two columns were specified in the statement, or
 	 * that we're building statistics on a single expression.
 	 */
-	if ((numcols < 2) && (list_length(stxexprs) != 1))
+	if ((numcols < 2) && (list_length(stxexprs) != 1) && !build_sketch)
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_OBJECT_DEFINITION),
 				 errmsg("extended statistics require at least 2 columns")));
@@ -467,6 +501,8 @@ CreateStatistics(CreateStatsStmt *stmt)
 		types[ntypes++] = CharGetDatum(STATS_EXT_DEPENDENCIES);
 	if (build_mcv)
 		types[ntypes++] = CharGetDatum(STATS_EXT_MCV);
+	if (build_sketch)
+		types[ntypes++] = CharGetDatum(STATS_EXT_SKETCH);
 	if (build_expressions)
 		types[ntypes++] = CharGetDatum(STATS_EXT_EXPRESSIONS);
 	Assert(ntypes > 0 && ntypes <= lengthof(types));
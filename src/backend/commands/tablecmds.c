@@ -1229,7 +1229,7 @@ DefineRelation(CreateStmt *stmt, char relkind, Oid ownerId,
 		 * If there are any row-level triggers, clone them to the new
 		 * partition.
 		 */
-		if (parent->trigdesc != NULL)
+		if (RelationGetTriggerDesc(parent) != NULL)
 			CloneRowTriggersToPartition(parent, rel);
 
 		/*
@@ -14977,7 +14977,7 @@ ATExecAddInherit(Relation child_rel, RangeVar *parent, LOCKMODE lockmode)
 	 * currently don't allow it to become an inheritance child.  See also
 	 * prohibitions in ATExecAttachPartition() and CreateTrigger().
 	 */
-	trigger_name = FindTriggerIncompatibleWithInheritance(child_rel->trigdesc);
+	trigger_name = FindTriggerIncompatibleWithInheritance(RelationGetTriggerDesc(child_rel));
 	if (trigger_name != NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
@@ -17892,7 +17892,7 @@ ATExecAttachPartition(List **wqueue, Relation rel, PartitionCmd *cmd,
 	 * currently don't allow it to become a partition.  See also prohibitions
 	 * in ATExecAddInherit() and CreateTrigger().
 	 */
-	trigger_name = FindTriggerIncompatibleWithInheritance(attachrel->trigdesc);
+	trigger_name = FindTriggerIncompatibleWithInheritance(RelationGetTriggerDesc(attachrel));
 	if (trigger_name != NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
@@ -72,6 +72,7 @@
 #include "commands/tablespace.h"
 #include "common/file_perm.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "postmaster/bgwriter.h"
 #include "storage/fd.h"
 #include "storage/lmgr.h"
@@ -486,6 +487,11 @@ DropTableSpace(DropTableSpaceStmt *stmt)
 	 */
 	deleteSharedDependencyRecordsFor(TableSpaceRelationId, tablespaceoid, 0);
 
+	/*
+	 * Drop the tablespace's IO statistics once the transaction commits.
+	 */
+	pgstat_drop_tablespace(tablespaceoid);
+
 	/*
 	 * Acquire TablespaceCreateLock to ensure that no TablespaceCreateDbspace
 	 * is running concurrently.
@@ -16,6 +16,11 @@
  * the parallel context is re-initialized so that the same DSM can be used for
  * multiple passes of index bulk-deletion and index cleanup.
  *
+ * The same workers can also share the first pass over the heap with the
+ * leader.  vacuumlazy.c owns the state of that scan, which lives in a chunk of
+ * the DSM segment whose size it tells us; we only launch the workers and hand
+ * them over to heap_vacuum_parallel_scan().
+ *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -27,7 +32,9 @@
 #include "postgres.h"
 
 #include "access/amapi.h"
+#include "access/heapam.h"
 #include "access/table.h"
+#include "access/tidstore.h"
 #include "access/xact.h"
 #include "catalog/index.h"
 #include "commands/vacuum.h"
@@ -44,11 +51,11 @@
  * use small integers.
  */
 #define PARALLEL_VACUUM_KEY_SHARED			1
-#define PARALLEL_VACUUM_KEY_DEAD_ITEMS		2
 #define PARALLEL_VACUUM_KEY_QUERY_TEXT		3
 #define PARALLEL_VACUUM_KEY_BUFFER_USAGE	4
 #define PARALLEL_VACUUM_KEY_WAL_USAGE		5
 #define PARALLEL_VACUUM_KEY_INDEX_STATS		6
+#define PARALLEL_VACUUM_KEY_HEAP_SCAN		7
 
 /*
  * Shared information among parallel workers.  So this is allocated in the DSM
@@ -93,6 +100,26 @@ typedef struct PVShared
 	 */
 	int			ring_nbuffers;
 
+	/*
+	 * DSA area and control data of the TidStore holding the dead items.  The
+	 * leader replaces the store after each round of index vacuuming, so
+	 * workers attach to it afresh each time they are launched.
+	 */
+	dsa_handle	dead_items_dsa_handle;
+	dsa_pointer dead_items_handle;
+
+	/*
+	 * Set by the leader before launching workers.  scanning_heap tells the
+	 * workers to join the first heap pass instead of processing indexes.
+	 * The leader's cost-based delay parameters are passed along because they
+	 * may come from autovacuum settings, or may have been disabled by the
+	 * wraparound failsafe, neither of which the workers could see by
+	 * themselves.
+	 */
+	bool		scanning_heap;
+	double		cost_delay;
+	int			cost_limit;
+
 	/*
 	 * Shared vacuum cost balance.  During parallel vacuum,
 	 * VacuumSharedCostBalance points to this value and it accumulates the
@@ -174,8 +201,19 @@ struct ParallelVacuumState
 	 */
 	PVIndStats *indstats;
 
-	/* Shared dead items space among parallel vacuum workers */
-	VacDeadItems *dead_items;
+	/*
+	 * Shared dead items space among parallel vacuum workers.  NULL if the
+	 * table has no indexes, in which case each process vacuums the pages it
+	 * prunes right away.
+	 */
+	TidStore   *dead_items;
+
+	/* Number of workers to use for the heap scan, and its state in DSM */
+	int			nheap_workers;
+	void	   *heap_scan_state;
+
+	/* Have workers been launched before (so the DSM must be reinitialized)? */
+	bool		need_reinit;
 
 	/* Points to buffer usage area in DSM */
 	BufferUsage *buffer_usage;
@@ -213,6 +251,8 @@ struct ParallelVacuumState
 
 static int	parallel_vacuum_compute_workers(Relation *indrels, int nindexes, int nrequested,
 											bool *will_parallel_vacuum);
+static void parallel_vacuum_launch_workers(ParallelVacuumState *pvs, int nworkers);
+static void parallel_vacuum_wait_for_workers(ParallelVacuumState *pvs);
 static void parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scans,
 												bool vacuum);
 static void parallel_vacuum_process_safe_indexes(ParallelVacuumState *pvs);
@@ -227,43 +267,49 @@ static void parallel_vacuum_error_callback(void *arg);
  * Try to enter parallel mode and create a parallel context.  Then initialize
  * shared memory state.
  *
+ * nheap_workers is the number of workers the caller wants for the first heap
+ * pass, and heap_scan_size the size of the shared state it needs for that
+ * (see parallel_vacuum_get_heap_scan_state).
+ *
  * On success, return parallel vacuum state.  Otherwise return NULL.
  */
 ParallelVacuumState *
 parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
-					 int nrequested_workers, int max_items,
+					 int nrequested_workers, int nheap_workers,
+					 Size heap_scan_size, int vac_work_mem,
 					 int elevel, BufferAccessStrategy bstrategy)
 {
 	ParallelVacuumState *pvs;
 	ParallelContext *pcxt;
 	PVShared   *shared;
-	VacDeadItems *dead_items;
+	TidStore   *dead_items;
 	PVIndStats *indstats;
 	BufferUsage *buffer_usage;
 	WalUsage   *wal_usage;
 	bool	   *will_parallel_vacuum;
 	Size		est_indstats_len;
 	Size		est_shared_len;
-	Size		est_dead_items_len;
 	int			nindexes_mwm = 0;
 	int			parallel_workers = 0;
 	int			querylen;
 
 	/*
-	 * A parallel vacuum must be requested and there must be indexes on the
-	 * relation
+	 * A parallel vacuum must be requested, and there must be indexes on the
+	 * relation unless the heap scan is to be done in parallel
 	 */
 	Assert(nrequested_workers >= 0);
-	Assert(nindexes > 0);
+	Assert(nindexes > 0 || nheap_workers > 0);
 
 	/*
-	 * Compute the number of parallel vacuum workers to launch
+	 * Compute the number of parallel vacuum workers to launch for index
+	 * processing
 	 */
 	will_parallel_vacuum = (bool *) palloc0(sizeof(bool) * nindexes);
-	parallel_workers = parallel_vacuum_compute_workers(indrels, nindexes,
-													   nrequested_workers,
-													   will_parallel_vacuum);
-	if (parallel_workers <= 0)
+	if (nindexes > 0)
+		parallel_workers = parallel_vacuum_compute_workers(indrels, nindexes,
+														   nrequested_workers,
+														   will_parallel_vacuum);
+	if (parallel_workers <= 0 && nheap_workers <= 0)
 	{
 		/* Can't perform vacuum in parallel -- return NULL */
 		pfree(will_parallel_vacuum);
@@ -276,10 +322,11 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	pvs->will_parallel_vacuum = will_parallel_vacuum;
 	pvs->bstrategy = bstrategy;
 	pvs->heaprel = rel;
+	pvs->nheap_workers = Max(nheap_workers, 0);
 
 	EnterParallelMode();
 	pcxt = CreateParallelContext("postgres", "parallel_vacuum_main",
-								 parallel_workers);
+								 Max(parallel_workers, pvs->nheap_workers));
 	Assert(pcxt->nworkers > 0);
 	pvs->pcxt = pcxt;
 
@@ -293,10 +340,13 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	shm_toc_estimate_chunk(&pcxt->estimator, est_shared_len);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 
-	/* Estimate size for dead_items -- PARALLEL_VACUUM_KEY_DEAD_ITEMS */
-	est_dead_items_len = vac_max_items_to_alloc_size(max_items);
-	shm_toc_estimate_chunk(&pcxt->estimator, est_dead_items_len);
-	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	/* Estimate size for the heap scan state -- PARALLEL_VACUUM_KEY_HEAP_SCAN */
+	if (pvs->nheap_workers > 0)
+	{
+		Assert(heap_scan_size > 0);
+		shm_toc_estimate_chunk(&pcxt->estimator, heap_scan_size);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
 
 	/*
 	 * Estimate space for BufferUsage and WalUsage --
@@ -367,7 +417,7 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	shared->relid = RelationGetRelid(rel);
 	shared->elevel = elevel;
 	shared->maintenance_work_mem_worker =
-		(nindexes_mwm > 0) ?
+		(nindexes_mwm > 0 && parallel_workers > 0) ?
 		maintenance_work_mem / Min(parallel_workers, nindexes_mwm) :
 		maintenance_work_mem;
 
@@ -381,14 +431,27 @@ parallel_vacuum_init(Relation rel, Relation *indrels, int nindexes,
 	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_SHARED, shared);
 	pvs->shared = shared;
 
-	/* Prepare the dead_items space */
-	dead_items = (VacDeadItems *) shm_toc_allocate(pcxt->toc,
-												   est_dead_items_len);
-	dead_items->max_items = max_items;
-	dead_items->num_items = 0;
-	MemSet(dead_items->items, 0, sizeof(ItemPointerData) * max_items);
-	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_DEAD_ITEMS, dead_items);
-	pvs->dead_items = dead_items;
+	/*
+	 * Prepare the dead_items space, in its own DSA area.  Without indexes
+	 * there is nothing to share: each process vacuums the heap pages it
+	 * prunes right away.
+	 */
+	if (nindexes > 0)
+	{
+		dead_items = TidStoreCreateShared((size_t) vac_work_mem * 1024,
+										  LWTRANCHE_SHARED_TIDSTORE);
+		shared->dead_items_dsa_handle = TidStoreGetDSAHandle(dead_items);
+		shared->dead_items_handle = TidStoreGetHandle(dead_items);
+		pvs->dead_items = dead_items;
+	}
+
+	/* Allocate the heap scan state; the caller initializes it */
+	if (pvs->nheap_workers > 0)
+	{
+		pvs->heap_scan_state = shm_toc_allocate(pcxt->toc, heap_scan_size);
+		shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_HEAP_SCAN,
+					   pvs->heap_scan_state);
+	}
 
 	/*
 	 * Allocate space for each worker's BufferUsage and WalUsage; no need to
@@ -447,6 +510,9 @@ parallel_vacuum_end(ParallelVacuumState *pvs, IndexBulkDeleteResult **istats)
 			istats[i] = NULL;
 	}
 
+	if (pvs->dead_items != NULL)
+		TidStoreDestroy(pvs->dead_items);
+
 	DestroyParallelContext(pvs->pcxt);
 	ExitParallelMode();
 
@@ -455,12 +521,103 @@ parallel_vacuum_end(ParallelVacuumState *pvs, IndexBulkDeleteResult **istats)
 }
 
 /* Returns the dead items space */
-VacDeadItems *
+TidStore *
 parallel_vacuum_get_dead_items(ParallelVacuumState *pvs)
 {
 	return pvs->dead_items;
 }
 
+/*
+ * Forget all dead items.  It's cheaper to replace the shared TidStore with a
+ * new, empty one than to free its contents piecemeal.  No workers can be
+ * attached to the old store at this point.
+ */
+void
+parallel_vacuum_reset_dead_items(ParallelVacuumState *pvs)
+{
+	size_t		max_bytes;
+
+	Assert(pvs->dead_items != NULL);
+	max_bytes = TidStoreMaxMemory(pvs->dead_items);
+
+	TidStoreDestroy(pvs->dead_items);
+
+	pvs->dead_items = TidStoreCreateShared(max_bytes,
+										   LWTRANCHE_SHARED_TIDSTORE);
+	pvs->shared->dead_items_dsa_handle = TidStoreGetDSAHandle(pvs->dead_items);
+	pvs->shared->dead_items_handle = TidStoreGetHandle(pvs->dead_items);
+}
+
+/* Returns the shared state of the parallel heap scan, or NULL if none */
+void *
+parallel_vacuum_get_heap_scan_state(ParallelVacuumState *pvs)
+{
+	return pvs->heap_scan_state;
+}
+
+/*
+ * Launch parallel workers to share the first pass over the heap with the
+ * leader.  The caller must have initialized the heap scan state, and must
+ * call parallel_vacuum_end_heap_scan once it is done with its own part of the
+ * scan.  Returns the number of workers launched.
+ */
+int
+parallel_vacuum_begin_heap_scan(ParallelVacuumState *pvs)
+{
+	int			nworkers;
+
+	Assert(!IsParallelWorker());
+
+	nworkers = Min(pvs->nheap_workers, pvs->pcxt->nworkers);
+	if (nworkers <= 0)
+		return 0;
+
+	pvs->shared->scanning_heap = true;
+	parallel_vacuum_launch_workers(pvs, nworkers);
+
+	ereport(pvs->shared->elevel,
+			(errmsg(ngettext("launched %d parallel vacuum worker for heap scanning (planned: %d)",
+							 "launched %d parallel vacuum workers for heap scanning (planned: %d)",
+							 pvs->pcxt->nworkers_launched),
+					pvs->pcxt->nworkers_launched, nworkers)));
+
+	/* The leader scans too */
+	if (VacuumActiveNWorkers)
+		pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+
+	return pvs->pcxt->nworkers_launched;
+}
+
+/*
+ * Wait for the workers launched by parallel_vacuum_begin_heap_scan to finish
+ * their part of the heap scan.
+ */
+void
+parallel_vacuum_end_heap_scan(ParallelVacuumState *pvs)
+{
+	Assert(!IsParallelWorker());
+
+	if (!pvs->shared->scanning_heap)
+		return;
+
+	if (VacuumActiveNWorkers)
+		pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+
+	parallel_vacuum_wait_for_workers(pvs);
+	pvs->shared->scanning_heap = false;
+
+	/*
+	 * Carry the shared balance value back to the leader and disable shared
+	 * costing
+	 */
+	if (VacuumSharedCostBalance)
+	{
+		VacuumCostBalance = pg_atomic_read_u32(VacuumSharedCostBalance);
+		VacuumSharedCostBalance = NULL;
+		VacuumActiveNWorkers = NULL;
+	}
+}
+
 /*
  * Do parallel index bulk-deletion with parallel workers.
  */
@@ -571,6 +728,68 @@ parallel_vacuum_compute_workers(Relation *indrels, int nindexes, int nrequested,
 	return parallel_workers;
 }
 
+/*
+ * Launch nworkers parallel workers, setting up the shared cost-based vacuum
+ * delay for them and for the leader.
+ */
+static void
+parallel_vacuum_launch_workers(ParallelVacuumState *pvs, int nworkers)
+{
+	Assert(nworkers > 0 && nworkers <= pvs->pcxt->nworkers);
+
+	/* Reinitialize parallel context to relaunch parallel workers */
+	if (pvs->need_reinit)
+		ReinitializeParallelDSM(pvs->pcxt);
+	pvs->need_reinit = true;
+
+	/*
+	 * Set up shared cost balance and the number of active workers for vacuum
+	 * delay, and pass our delay parameters along.  We need to do this before
+	 * launching workers as otherwise, they might not see the updated values
+	 * for these parameters.
+	 */
+	pg_atomic_write_u32(&(pvs->shared->cost_balance), VacuumCostBalance);
+	pg_atomic_write_u32(&(pvs->shared->active_nworkers), 0);
+	pvs->shared->cost_delay = VacuumCostActive ? vacuum_cost_delay : 0;
+	pvs->shared->cost_limit = vacuum_cost_limit;
+
+	/*
+	 * The number of workers can vary between the heap scan, bulkdelete and
+	 * cleanup phases.
+	 */
+	ReinitializeParallelWorkers(pvs->pcxt, nworkers);
+
+	LaunchParallelWorkers(pvs->pcxt);
+
+	if (pvs->pcxt->nworkers_launched > 0)
+	{
+		/*
+		 * Reset the local cost values for leader backend as we have already
+		 * accumulated the remaining balance of heap.
+		 */
+		VacuumCostBalance = 0;
+		VacuumCostBalanceLocal = 0;
+
+		/* Enable shared cost balance for leader backend */
+		VacuumSharedCostBalance = &(pvs->shared->cost_balance);
+		VacuumActiveNWorkers = &(pvs->shared->active_nworkers);
+	}
+}
+
+/*
+ * Wait for all launched workers to finish, then accumulate their buffer and
+ * WAL usage.  (This must wait for the workers to finish, or we might get
+ * incomplete data.)
+ */
+static void
+parallel_vacuum_wait_for_workers(ParallelVacuumState *pvs)
+{
+	WaitForParallelWorkersToFinish(pvs->pcxt);
+
+	for (int i = 0; i < pvs->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&pvs->buffer_usage[i], &pvs->wal_usage[i]);
+}
+
 /*
  * Perform index vacuum or index cleanup with parallel workers.  This function
  * must be used by the parallel vacuum leader process.
@@ -637,40 +856,7 @@ parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scan
 	/* Setup the shared cost-based vacuum delay and launch workers */
 	if (nworkers > 0)
 	{
-		/* Reinitialize parallel context to relaunch parallel workers */
-		if (num_index_scans > 0)
-			ReinitializeParallelDSM(pvs->pcxt);
-
-		/*
-		 * Set up shared cost balance and the number of active workers for
-		 * vacuum delay.  We need to do this before launching workers as
-		 * otherwise, they might not see the updated values for these
-		 * parameters.
-		 */
-		pg_atomic_write_u32(&(pvs->shared->cost_balance), VacuumCostBalance);
-		pg_atomic_write_u32(&(pvs->shared->active_nworkers), 0);
-
-		/*
-		 * The number of workers can vary between bulkdelete and cleanup
-		 * phase.
-		 */
-		ReinitializeParallelWorkers(pvs->pcxt, nworkers);
-
-		LaunchParallelWorkers(pvs->pcxt);
-
-		if (pvs->pcxt->nworkers_launched > 0)
-		{
-			/*
-			 * Reset the local cost values for leader backend as we have
-			 * already accumulated the remaining balance of heap.
-			 */
-			VacuumCostBalance = 0;
-			VacuumCostBalanceLocal = 0;
-
-			/* Enable shared cost balance for leader backend */
-			VacuumSharedCostBalance = &(pvs->shared->cost_balance);
-			VacuumActiveNWorkers = &(pvs->shared->active_nworkers);
-		}
+		parallel_vacuum_launch_workers(pvs, nworkers);
 
 		if (vacuum)
 			ereport(pvs->shared->elevel,
@@ -695,18 +881,9 @@ parallel_vacuum_process_all_indexes(ParallelVacuumState *pvs, int num_index_scan
 	 */
 	parallel_vacuum_process_safe_indexes(pvs);
 
-	/*
-	 * Next, accumulate buffer and WAL usage.  (This must wait for the workers
-	 * to finish, or we might get incomplete data.)
-	 */
+	/* Next, wait for the workers and accumulate buffer and WAL usage */
 	if (nworkers > 0)
-	{
-		/* Wait for all vacuum workers to finish */
-		WaitForParallelWorkersToFinish(pvs->pcxt);
-
-		for (int i = 0; i < pvs->pcxt->nworkers_launched; i++)
-			InstrAccumParallelQuery(&pvs->buffer_usage[i], &pvs->wal_usage[i]);
-	}
+		parallel_vacuum_wait_for_workers(pvs);
 
 	/*
 	 * Reset all index status back to initial (while checking that we have
@@ -943,8 +1120,8 @@ parallel_vacuum_index_is_parallel_safe(Relation indrel, int num_index_scans,
 /*
  * Perform work within a launched parallel process.
  *
- * Since parallel vacuum workers perform only index vacuum or index cleanup,
- * we don't need to report progress information.
+ * Workers either take part in the first heap pass or perform index vacuum or
+ * index cleanup.  The leader reports progress information for both.
  */
 void
 parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
@@ -954,7 +1131,7 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	Relation   *indrels;
 	PVIndStats *indstats;
 	PVShared   *shared;
-	VacDeadItems *dead_items;
+	TidStore   *dead_items;
 	BufferUsage *buffer_usage;
 	WalUsage   *wal_usage;
 	int			nindexes;
@@ -962,8 +1139,9 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	ErrorContextCallback errcallback;
 
 	/*
-	 * A parallel vacuum worker must have only PROC_IN_VACUUM flag since we
-	 * don't support parallel vacuum for autovacuum as of now.
+	 * A parallel vacuum worker must have only PROC_IN_VACUUM flag, even when
+	 * the leader is an autovacuum worker, since only the xmin-related flags
+	 * are inherited from the leader.
 	 */
 	Assert(MyProc->statusFlags == PROC_IN_VACUUM);
 
@@ -988,7 +1166,7 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	 * matched to the leader's one.
 	 */
 	vac_open_indexes(rel, RowExclusiveLock, &nindexes, &indrels);
-	Assert(nindexes > 0);
+	Assert(nindexes > 0 || shared->scanning_heap);
 
 	if (shared->maintenance_work_mem_worker > 0)
 		maintenance_work_mem = shared->maintenance_work_mem_worker;
@@ -998,13 +1176,20 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 											 PARALLEL_VACUUM_KEY_INDEX_STATS,
 											 false);
 
-	/* Set dead_items space */
-	dead_items = (VacDeadItems *) shm_toc_lookup(toc,
-												 PARALLEL_VACUUM_KEY_DEAD_ITEMS,
-												 false);
+	/* Attach to the dead_items space, if there is one */
+	dead_items = NULL;
+	if (DsaPointerIsValid(shared->dead_items_handle))
+		dead_items = TidStoreAttach(shared->dead_items_dsa_handle,
+									shared->dead_items_handle);
 
-	/* Set cost-based vacuum delay */
+	/*
+	 * Set cost-based vacuum delay.  Use the leader's delay parameters rather
+	 * than our own, see PVShared.
+	 */
 	VacuumUpdateCosts();
+	vacuum_cost_delay = shared->cost_delay;
+	vacuum_cost_limit = shared->cost_limit;
+	VacuumCostActive = (vacuum_cost_delay > 0);
 	VacuumCostBalance = 0;
 	VacuumPageHit = 0;
 	VacuumPageMiss = 0;
@@ -1040,8 +1225,24 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	/* Prepare to track buffer usage during parallel execution */
 	InstrStartParallelQuery();
 
-	/* Process indexes to perform vacuum/cleanup */
-	parallel_vacuum_process_safe_indexes(&pvs);
+	if (shared->scanning_heap)
+	{
+		void	   *heap_scan_state;
+
+		heap_scan_state = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_HEAP_SCAN,
+										 false);
+
+		/* Join the first pass over the heap */
+		pg_atomic_add_fetch_u32(VacuumActiveNWorkers, 1);
+		heap_vacuum_parallel_scan(rel, nindexes, dead_items,
+								  heap_scan_state, pvs.bstrategy);
+		pg_atomic_sub_fetch_u32(VacuumActiveNWorkers, 1);
+	}
+	else
+	{
+		/* Process indexes to perform vacuum/cleanup */
+		parallel_vacuum_process_safe_indexes(&pvs);
+	}
 
 	/* Report buffer/WAL usage during parallel execution */
 	buffer_usage = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_BUFFER_USAGE, false);
@@ -1052,6 +1253,9 @@ parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
 	/* Pop the error context stack */
 	error_context_stack = errcallback.previous;
 
+	if (dead_items != NULL)
+		TidStoreDetach(dead_items);
+
 	vac_close_indexes(nindexes, indrels, RowExclusiveLock);
 	table_close(rel, ShareUpdateExclusiveLock);
 	FreeAccessStrategy(pvs.bstrategy);
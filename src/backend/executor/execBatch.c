@@ -0,0 +1,536 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Support routines for batch-at-a-time execution between plan nodes
+ *
+ * The regular executor protocol hands over a single tuple per ExecProcNode
+ * call, so for narrow analytic queries the per-tuple call and slot overhead
+ * can dominate the actual work.  Nodes that implement an ExecProcNodeBatch
+ * method can instead fill a TupleBatch, an array of slots plus a selection
+ * vector, in one call.  A parent node that knows how to consume batches
+ * asks for one with ExecInitBatch when it's initialized, and gets NULL if
+ * its child can't produce them, in which case it just keeps using
+ * ExecProcNode.  Any node that doesn't participate thus falls back to the
+ * row protocol for its part of the plan tree.
+ *
+ * For scans, the simple comparisons of a column with a constant that make
+ * up most analytic quals are evaluated for the whole batch at once by
+ * ExecBatchQual, which gathers the column values of the selected tuples
+ * into an array and filters the selection vector in a tight loop.  Quals of
+ * any other shape are evaluated tuple by tuple as usual.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/stratnum.h"
+#include "catalog/pg_opfamily.h"
+#include "catalog/pg_type.h"
+#include "executor/execBatch.h"
+#include "executor/executor.h"
+#include "executor/instrument.h"
+#include "nodes/primnodes.h"
+#include "utils/float.h"
+#include "utils/lsyscache.h"
+
+/* GUC variable */
+int			executor_batch_size = 64;
+
+/* comparison of a BatchQualClause: btree strategy numbers, plus "<>" */
+#define BATCH_CMP_NE	(BTMaxStrategyNumber + 1)
+
+/*
+ * A "column op constant" clause of a vectorized qual.  Integer columns are
+ * compared as int64 and float columns as float8, using the same semantics
+ * as the cross-type operators of the integer_ops and float_ops families.
+ */
+typedef struct BatchQualClause
+{
+	int			attno;			/* column index, 0-based */
+	Oid			atttype;		/* type of the column */
+	int			cmp;			/* comparison, with the column on the left */
+	bool		isfloat;		/* compare as float8 rather than int64 */
+	bool		constisnull;	/* constant is NULL, so nothing qualifies */
+	int64		ival;			/* constant to compare with */
+	float8		fval;
+} BatchQualClause;
+
+struct BatchQual
+{
+	int			nclauses;
+	AttrNumber	maxattr;		/* highest column used by any clause */
+	int			maxrows;		/* allocated length of the workspace */
+	int64	   *ivals;			/* workspace for gathered column values */
+	float8	   *fvals;
+	BatchQualClause clauses[FLEXIBLE_ARRAY_MEMBER];
+};
+
+static bool batch_qual_clause(Expr *clause, BatchQualClause *bclause);
+
+
+/*
+ * Create a batch of maxrows slots of the given type.
+ *
+ * The slots are kept in the estate's tuple table, so they're released
+ * along with all the other slots at executor shutdown.
+ */
+TupleBatch *
+ExecCreateBatch(EState *estate, TupleDesc tupdesc,
+				const TupleTableSlotOps *tts_ops, int maxrows)
+{
+	TupleBatch *batch;
+
+	Assert(maxrows > 0);
+
+	batch = (TupleBatch *) palloc0(sizeof(TupleBatch));
+	batch->maxrows = maxrows;
+	batch->slots = (TupleTableSlot **)
+		palloc(sizeof(TupleTableSlot *) * batch->maxrows);
+	batch->sel = (int *) palloc(sizeof(int) * batch->maxrows);
+
+	for (int i = 0; i < batch->maxrows; i++)
+		batch->slots[i] = ExecAllocTableSlot(&estate->es_tupleTable,
+											 tupdesc, tts_ops);
+
+	return batch;
+}
+
+/*
+ * Set up a batch to receive the output of producer, to be fetched with
+ * ExecProcBatch or ExecProcNodeViaBatch.
+ *
+ * Returns NULL if batch execution is disabled or the producer doesn't
+ * support it; the caller must then use ExecProcNode.
+ */
+TupleBatch *
+ExecInitBatch(PlanState *producer)
+{
+	if (executor_batch_size <= 0 || producer->ExecProcNodeBatch == NULL)
+		return NULL;
+
+	return ExecCreateBatch(producer->state,
+						   ExecGetResultType(producer),
+						   ExecGetResultSlotOps(producer, NULL),
+						   executor_batch_size);
+}
+
+/*
+ * Forget the tuples of the batch, for a rescan of the producer.
+ */
+void
+ExecResetBatch(TupleBatch *batch)
+{
+	for (int i = 0; i < batch->maxrows; i++)
+		ExecClearTuple(batch->slots[i]);
+
+	batch->nrows = 0;
+	batch->nselected = 0;
+	batch->next = 0;
+}
+
+/*
+ * Fill the batch with the next tuples of the given node.
+ *
+ * Returns the number of selected tuples, 0 at the end of the node's output.
+ * This is the batch equivalent of ExecProcNode.
+ */
+int
+ExecProcBatch(PlanState *node, TupleBatch *batch)
+{
+	int			nselected;
+
+	Assert(node->ExecProcNodeBatch != NULL);
+
+	if (node->chgParam != NULL) /* something changed? */
+		ExecReScan(node);		/* let ReScan handle this */
+
+	/* must provide our own instrumentation support */
+	if (node->instrument)
+		InstrStartNode(node->instrument);
+
+	batch->nrows = 0;
+	batch->nselected = 0;
+	batch->next = 0;
+
+	nselected = node->ExecProcNodeBatch(node, batch);
+	Assert(nselected == batch->nselected);
+
+	/* at the end, don't keep any buffer pins of the last batch */
+	if (nselected == 0)
+	{
+		for (int i = 0; i < batch->maxrows; i++)
+			ExecClearTuple(batch->slots[i]);
+		batch->nrows = 0;
+	}
+
+	if (node->instrument)
+		InstrStopNode(node->instrument, (double) nselected);
+
+	return nselected;
+}
+
+/*
+ * Evaluate a qual tuple by tuple on the selected scan tuples of a batch,
+ * removing those that don't pass from the selection vector.
+ *
+ * The caller is responsible for resetting the per-tuple memory context,
+ * which the tuples of a batch share.
+ */
+void
+ExecBatchQualRows(ExprState *qual, ExprContext *econtext, TupleBatch *batch)
+{
+	int			n = 0;
+
+	for (int k = 0; k < batch->nselected; k++)
+	{
+		econtext->ecxt_scantuple = batch->slots[batch->sel[k]];
+		if (ExecQual(qual, econtext))
+			batch->sel[n++] = batch->sel[k];
+	}
+
+	batch->nselected = n;
+}
+
+/*
+ * Project the selected tuples of batch "in" into the slots of batch "out".
+ *
+ * The projection can refer to the input tuples either as the scan or as the
+ * outer tuple, as its expression context is set up for both.  The results
+ * may point into the per-tuple memory context, which the caller must
+ * therefore reset only once per batch.
+ */
+void
+ExecProjectBatch(ProjectionInfo *projInfo, TupleBatch *in, TupleBatch *out)
+{
+	ExprContext *econtext = projInfo->pi_exprContext;
+	TupleTableSlot *resultslot = projInfo->pi_state.resultslot;
+
+	Assert(in->nselected <= out->maxrows);
+
+	for (int k = 0; k < in->nselected; k++)
+	{
+		TupleTableSlot *slot = in->slots[in->sel[k]];
+
+		econtext->ecxt_scantuple = slot;
+		econtext->ecxt_outertuple = slot;
+
+		/* make the projection store its result into the next output slot */
+		projInfo->pi_state.resultslot = out->slots[out->nrows];
+		ExecProject(projInfo);
+
+		out->sel[out->nselected++] = out->nrows++;
+	}
+
+	projInfo->pi_state.resultslot = resultslot;
+}
+
+/*
+ * Prepare a qual (an implicit-AND list, as for ExecInitQual) for vectorized
+ * evaluation by ExecBatchQual.
+ *
+ * Returns NULL unless every clause is a simple comparison of a column with
+ * a constant that we know how to evaluate; the caller must then evaluate
+ * the qual tuple by tuple.  Such comparisons can't fail, so it doesn't
+ * matter that we evaluate all clauses over the whole batch one after the
+ * other rather than each tuple's clauses in turn.
+ */
+BatchQual *
+ExecInitBatchQual(List *qual, int maxrows)
+{
+	BatchQual  *bqual;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (qual == NIL)
+		return NULL;
+
+	bqual = (BatchQual *) palloc0(offsetof(BatchQual, clauses) +
+								  sizeof(BatchQualClause) * list_length(qual));
+
+	foreach(lc, qual)
+	{
+		BatchQualClause *bclause = &bqual->clauses[i++];
+
+		if (!batch_qual_clause((Expr *) lfirst(lc), bclause))
+		{
+			pfree(bqual);
+			return NULL;
+		}
+		bqual->maxattr = Max(bqual->maxattr, bclause->attno + 1);
+	}
+
+	bqual->nclauses = i;
+	bqual->maxrows = maxrows;
+	bqual->ivals = (int64 *) palloc(sizeof(int64) * maxrows);
+	bqual->fvals = (float8 *) palloc(sizeof(float8) * maxrows);
+
+	return bqual;
+}
+
+/*
+ * Check whether a qual clause is of the form "column op constant" (or the
+ * commuted form), where op is an integer or float comparison operator, and
+ * if so fill in *bclause.
+ */
+static bool
+batch_qual_clause(Expr *clause, BatchQualClause *bclause)
+{
+	OpExpr	   *opexpr;
+	Expr	   *leftop;
+	Expr	   *rightop;
+	Var		   *var;
+	Const	   *con;
+	Oid			opfamily;
+	int			strategy;
+	bool		commuted;
+
+	if (!IsA(clause, OpExpr))
+		return false;
+	opexpr = (OpExpr *) clause;
+	if (list_length(opexpr->args) != 2)
+		return false;
+
+	leftop = (Expr *) linitial(opexpr->args);
+	rightop = (Expr *) lsecond(opexpr->args);
+	if (IsA(leftop, Var) && IsA(rightop, Const))
+	{
+		var = (Var *) leftop;
+		con = (Const *) rightop;
+		commuted = false;
+	}
+	else if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		var = (Var *) rightop;
+		con = (Const *) leftop;
+		commuted = true;
+	}
+	else
+		return false;
+
+	/* must be a plain column of the scan tuple */
+	if (IS_SPECIAL_VARNO(var->varno) || var->varlevelsup != 0 ||
+		var->varattno <= 0)
+		return false;
+
+	switch (var->vartype)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			opfamily = INTEGER_BTREE_FAM_OID;
+			if (con->consttype != INT2OID && con->consttype != INT4OID &&
+				con->consttype != INT8OID)
+				return false;
+			break;
+		case FLOAT4OID:
+		case FLOAT8OID:
+			opfamily = FLOAT_BTREE_FAM_OID;
+			if (con->consttype != FLOAT4OID && con->consttype != FLOAT8OID)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	strategy = get_op_opfamily_strategy(opexpr->opno, opfamily);
+	if (strategy == 0)
+	{
+		Oid			negator = get_negator(opexpr->opno);
+
+		if (!OidIsValid(negator) ||
+			get_op_opfamily_strategy(negator, opfamily) != BTEqualStrategyNumber)
+			return false;
+		strategy = BATCH_CMP_NE;
+	}
+	else if (commuted)
+	{
+		/* "<" becomes ">", "<=" becomes ">=" and vice versa */
+		strategy = BTMaxStrategyNumber + 1 - strategy;
+	}
+
+	bclause->attno = var->varattno - 1;
+	bclause->atttype = var->vartype;
+	bclause->cmp = strategy;
+	bclause->isfloat = (opfamily == FLOAT_BTREE_FAM_OID);
+	bclause->constisnull = con->constisnull;
+	if (!con->constisnull)
+	{
+		switch (con->consttype)
+		{
+			case INT2OID:
+				bclause->ival = DatumGetInt16(con->constvalue);
+				break;
+			case INT4OID:
+				bclause->ival = DatumGetInt32(con->constvalue);
+				break;
+			case INT8OID:
+				bclause->ival = DatumGetInt64(con->constvalue);
+				break;
+			case FLOAT4OID:
+				bclause->fval = DatumGetFloat4(con->constvalue);
+				break;
+			case FLOAT8OID:
+				bclause->fval = DatumGetFloat8(con->constvalue);
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Gather the non-null values of column attno of the selected tuples into
+ * vals[], converted with conv, dropping tuples where it's null from the
+ * selection vector (a strict operator yields NULL for them).
+ */
+#define BATCH_GATHER(vals, conv) \
+	do { \
+		for (int k = 0; k < nsel; k++) \
+		{ \
+			TupleTableSlot *slot = batch->slots[sel[k]]; \
+			if (!slot->tts_isnull[attno]) \
+			{ \
+				(vals)[n] = conv(slot->tts_values[attno]); \
+				sel[n++] = sel[k]; \
+			} \
+		} \
+	} while (0)
+
+/*
+ * Keep only the selected tuples whose gathered value satisfies test, which
+ * refers to the value as vals[k].  This is written without a branch, so
+ * that the compiler can keep the loop tight.
+ */
+#define BATCH_FILTER(test) \
+	do { \
+		int			m = 0; \
+		for (int k = 0; k < n; k++) \
+		{ \
+			sel[m] = sel[k]; \
+			m += (test) ? 1 : 0; \
+		} \
+		n = m; \
+	} while (0)
+
+static void
+batch_filter_int(BatchQual *bqual, BatchQualClause *bclause, TupleBatch *batch)
+{
+	int		   *sel = batch->sel;
+	int			nsel = batch->nselected;
+	int			attno = bclause->attno;
+	int64	   *vals = bqual->ivals;
+	int64		c = bclause->ival;
+	int			n = 0;
+
+	switch (bclause->atttype)
+	{
+		case INT2OID:
+			BATCH_GATHER(vals, DatumGetInt16);
+			break;
+		case INT4OID:
+			BATCH_GATHER(vals, DatumGetInt32);
+			break;
+		default:
+			BATCH_GATHER(vals, DatumGetInt64);
+			break;
+	}
+
+	switch (bclause->cmp)
+	{
+		case BTLessStrategyNumber:
+			BATCH_FILTER(vals[k] < c);
+			break;
+		case BTLessEqualStrategyNumber:
+			BATCH_FILTER(vals[k] <= c);
+			break;
+		case BTEqualStrategyNumber:
+			BATCH_FILTER(vals[k] == c);
+			break;
+		case BTGreaterEqualStrategyNumber:
+			BATCH_FILTER(vals[k] >= c);
+			break;
+		case BTGreaterStrategyNumber:
+			BATCH_FILTER(vals[k] > c);
+			break;
+		case BATCH_CMP_NE:
+			BATCH_FILTER(vals[k] != c);
+			break;
+	}
+
+	batch->nselected = n;
+}
+
+static void
+batch_filter_float(BatchQual *bqual, BatchQualClause *bclause,
+				   TupleBatch *batch)
+{
+	int		   *sel = batch->sel;
+	int			nsel = batch->nselected;
+	int			attno = bclause->attno;
+	float8	   *vals = bqual->fvals;
+	float8		c = bclause->fval;
+	int			n = 0;
+
+	if (bclause->atttype == FLOAT4OID)
+		BATCH_GATHER(vals, DatumGetFloat4);
+	else
+		BATCH_GATHER(vals, DatumGetFloat8);
+
+	/* use the float.h comparisons, which treat NaN as the largest value */
+	switch (bclause->cmp)
+	{
+		case BTLessStrategyNumber:
+			BATCH_FILTER(float8_lt(vals[k], c));
+			break;
+		case BTLessEqualStrategyNumber:
+			BATCH_FILTER(float8_le(vals[k], c));
+			break;
+		case BTEqualStrategyNumber:
+			BATCH_FILTER(float8_eq(vals[k], c));
+			break;
+		case BTGreaterEqualStrategyNumber:
+			BATCH_FILTER(float8_ge(vals[k], c));
+			break;
+		case BTGreaterStrategyNumber:
+			BATCH_FILTER(float8_gt(vals[k], c));
+			break;
+		case BATCH_CMP_NE:
+			BATCH_FILTER(float8_ne(vals[k], c));
+			break;
+	}
+
+	batch->nselected = n;
+}
+
+/*
+ * Evaluate a qual prepared by ExecInitBatchQual on the selected scan tuples
+ * of a batch, removing those that don't pass from the selection vector.
+ */
+void
+ExecBatchQual(BatchQual *bqual, TupleBatch *batch)
+{
+	Assert(batch->nselected <= bqual->maxrows);
+
+	/* deform the columns we need, once per tuple */
+	for (int k = 0; k < batch->nselected; k++)
+		slot_getsomeattrs(batch->slots[batch->sel[k]], bqual->maxattr);
+
+	for (int i = 0; i < bqual->nclauses && batch->nselected > 0; i++)
+	{
+		BatchQualClause *bclause = &bqual->clauses[i];
+
+		if (bclause->constisnull)
+			batch->nselected = 0;
+		else if (bclause->isfloat)
+			batch_filter_float(bqual, bclause, batch);
+		else
+			batch_filter_int(bqual, bclause, batch);
+	}
+}
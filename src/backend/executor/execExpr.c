@@ -48,7 +48,9 @@
 #include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
 #include "utils/typcache.h"
 
 
@@ -68,6 +70,9 @@ static void ExecInitExprRec(Expr *node, ExprState *state,
 static void ExecInitFunc(ExprEvalStep *scratch, Expr *node, List *args,
 						 Oid funcid, Oid inputcollid,
 						 ExprState *state);
+static bool ExecInitCmpVar(ExprEvalStep *scratch, OpExpr *op,
+						   ExprState *state);
+static int	cmp_var_type(Oid type);
 static void ExecCreateExprSetupSteps(ExprState *state, Node *node);
 static void ExecPushExprSetupSteps(ExprState *state, ExprSetupInfo *info);
 static bool expr_setup_walker(Node *node, ExprSetupInfo *info);
@@ -1133,9 +1138,10 @@ ExecInitExprRec(Expr *node, ExprState *state,
 			{
 				OpExpr	   *op = (OpExpr *) node;
 
-				ExecInitFunc(&scratch, node,
-							 op->args, op->opfuncid, op->inputcollid,
-							 state);
+				if (!ExecInitCmpVar(&scratch, op, state))
+					ExecInitFunc(&scratch, node,
+								 op->args, op->opfuncid, op->inputcollid,
+								 state);
 				ExprEvalPushStep(state, &scratch);
 				break;
 			}
@@ -2646,6 +2652,201 @@ ExecInitFunc(ExprEvalStep *scratch, Expr *node, List *args, Oid funcid,
 	}
 }
 
+/*
+ * Prepare an EEOP_CMP_VAR_* step for a comparison operator, if it's one of
+ * the builtin comparisons of integer, float, date, timestamp or text types
+ * between user columns, or a user column and a Const.  Returns false if the
+ * operator needs to be called through fmgr.
+ *
+ * The operator is recognized by its membership in the type's default btree
+ * opfamily, so cross-type integer and float comparisons qualify too.  Text
+ * is compared bytewise, so only for deterministic collations, and only for
+ * equality unless the collation is "C".  Expressions that will be JIT
+ * compiled are better off with the operator's function inlined there.
+ */
+static bool
+ExecInitCmpVar(ExprEvalStep *scratch, OpExpr *op, ExprState *state)
+{
+	Expr	   *leftop;
+	Expr	   *rightop;
+	Oid			opno;
+	TypeCacheEntry *typentry;
+	Oid			ltypid;
+	Oid			rtypid;
+	int			ltype;
+	int			rtype;
+	int			strategy;
+	AclResult	aclresult;
+	Var		   *vars[2];
+
+	if (state->parent &&
+		(state->parent->state->es_jit_flags & PGJIT_EXPR))
+		return false;
+
+	if (list_length(op->args) != 2 || op->opretset)
+		return false;
+	leftop = (Expr *) linitial(op->args);
+	rightop = (Expr *) lsecond(op->args);
+
+	/* put the Var on the left, looking at the commutator instead */
+	opno = op->opno;
+	if (IsA(leftop, Const) && IsA(rightop, Var))
+	{
+		Expr	   *tmp = leftop;
+
+		opno = get_commutator(op->opno);
+		if (!OidIsValid(opno))
+			return false;
+		leftop = rightop;
+		rightop = tmp;
+	}
+	if (!IsA(leftop, Var) ||
+		!(IsA(rightop, Var) || IsA(rightop, Const)))
+		return false;
+
+	vars[0] = (Var *) leftop;
+	vars[1] = IsA(rightop, Var) ? (Var *) rightop : NULL;
+	for (int i = 0; i < 2; i++)
+	{
+		if (vars[i] &&
+			(vars[i]->varattno <= 0 || vars[i]->varlevelsup != 0))
+			return false;
+	}
+	if (IsA(rightop, Const) && ((Const *) rightop)->constisnull)
+		return false;
+
+	ltypid = exprType((Node *) leftop);
+	rtypid = exprType((Node *) rightop);
+	ltype = cmp_var_type(ltypid);
+	rtype = cmp_var_type(rtypid);
+	if (ltype < 0 || rtype < 0)
+		return false;
+
+	/*
+	 * Within the integer and float families values of different types are
+	 * compared in a common representation, but the datetime family's cross
+	 * type operators need conversions.
+	 */
+	if (ltypid != rtypid &&
+		!((ltypid == INT2OID || ltypid == INT4OID || ltypid == INT8OID) &&
+		  (rtypid == INT2OID || rtypid == INT4OID || rtypid == INT8OID)) &&
+		!((ltypid == FLOAT4OID || ltypid == FLOAT8OID) &&
+		  (rtypid == FLOAT4OID || rtypid == FLOAT8OID)))
+		return false;
+
+	typentry = lookup_type_cache(ltypid, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(typentry->btree_opf))
+		return false;
+	strategy = get_op_opfamily_strategy(opno, typentry->btree_opf);
+	if (strategy == 0)
+	{
+		Oid			negator = get_negator(opno);
+
+		if (!OidIsValid(negator) ||
+			get_op_opfamily_strategy(negator, typentry->btree_opf) !=
+			BTEqualStrategyNumber)
+			return false;
+		strategy = EEO_CMP_NE;
+	}
+
+	if (ltype == EEO_CMP_TEXT)
+	{
+		if (!OidIsValid(op->inputcollid) ||
+			!get_collation_isdeterministic(op->inputcollid))
+			return false;
+		if (strategy != BTEqualStrategyNumber && strategy != EEO_CMP_NE &&
+			!lc_collate_is_c(op->inputcollid))
+			return false;
+	}
+
+	/* Check permission to call the operator's function, as ExecInitFunc */
+	aclresult = object_aclcheck(ProcedureRelationId, op->opfuncid,
+								GetUserId(), ACL_EXECUTE);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, OBJECT_FUNCTION,
+					   get_func_name(op->opfuncid));
+	InvokeFunctionExecuteHook(op->opfuncid);
+
+	for (int i = 0; i < 2; i++)
+	{
+		uint16		slotoff;
+
+		if (vars[i] == NULL)
+			continue;
+
+		switch (vars[i]->varno)
+		{
+			case INNER_VAR:
+				slotoff = offsetof(ExprContext, ecxt_innertuple);
+				break;
+			case OUTER_VAR:
+				slotoff = offsetof(ExprContext, ecxt_outertuple);
+				break;
+
+				/* INDEX_VAR is handled by default case */
+
+			default:
+				slotoff = offsetof(ExprContext, ecxt_scantuple);
+				break;
+		}
+
+		if (i == 0)
+		{
+			scratch->d.cmp.lslotoff = slotoff;
+			scratch->d.cmp.lattnum = vars[i]->varattno - 1;
+			scratch->d.cmp.lvartype = vars[i]->vartype;
+		}
+		else
+		{
+			scratch->d.cmp.rslotoff = slotoff;
+			scratch->d.cmp.rattnum = vars[i]->varattno - 1;
+			scratch->d.cmp.rvartype = vars[i]->vartype;
+		}
+	}
+
+	if (vars[1] == NULL)
+	{
+		scratch->opcode = EEOP_CMP_VAR_CONST;
+		scratch->d.cmp.rattnum = -1;
+		scratch->d.cmp.constval = ((Const *) rightop)->constvalue;
+	}
+	else
+		scratch->opcode = EEOP_CMP_VAR_VAR;
+	scratch->d.cmp.ltype = ltype;
+	scratch->d.cmp.rtype = rtype;
+	scratch->d.cmp.strategy = strategy;
+
+	return true;
+}
+
+/*
+ * ExprCmpType to compare values of type as in EEOP_CMP_VAR_* steps, or -1.
+ */
+static int
+cmp_var_type(Oid type)
+{
+	switch (type)
+	{
+		case INT2OID:
+			return EEO_CMP_INT2;
+		case INT4OID:
+		case DATEOID:
+			return EEO_CMP_INT4;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return EEO_CMP_INT8;
+		case FLOAT4OID:
+			return EEO_CMP_FLOAT4;
+		case FLOAT8OID:
+			return EEO_CMP_FLOAT8;
+		case TEXTOID:
+			return EEO_CMP_TEXT;
+		default:
+			return -1;
+	}
+}
+
 /*
  * Add expression steps performing setup that's needed before any of the
  * main execution of the expression.
@@ -3827,6 +4028,22 @@ ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 				scratch->opcode = EEOP_AGG_PLAIN_TRANS_STRICT_BYVAL;
 			else
 				scratch->opcode = EEOP_AGG_PLAIN_TRANS_BYVAL;
+
+			/*
+			 * Inline the transition functions of count() and of sum() for
+			 * small integers, unless JIT compiling which can do the same.
+			 */
+			if (!(aggstate->ss.ps.state->es_jit_flags & PGJIT_EXPR))
+			{
+				Oid			transfn = fcinfo->flinfo->fn_oid;
+
+				if ((transfn == F_INT8INC || transfn == F_INT8INC_ANY) &&
+					scratch->opcode == EEOP_AGG_PLAIN_TRANS_STRICT_BYVAL)
+					scratch->opcode = EEOP_AGG_PLAIN_TRANS_COUNT;
+				else if ((transfn == F_INT2_SUM || transfn == F_INT4_SUM) &&
+						 scratch->opcode == EEOP_AGG_PLAIN_TRANS_BYVAL)
+					scratch->opcode = EEOP_AGG_PLAIN_TRANS_INT_SUM;
+			}
 		}
 		else
 		{
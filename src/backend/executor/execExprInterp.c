@@ -57,8 +57,10 @@
 #include "postgres.h"
 
 #include "access/heaptoast.h"
+#include "access/stratnum.h"
 #include "catalog/pg_type.h"
 #include "commands/sequence.h"
+#include "common/int.h"
 #include "executor/execExpr.h"
 #include "executor/nodeSubplan.h"
 #include "funcapi.h"
@@ -67,10 +69,13 @@
 #include "parser/parsetree.h"
 #include "pgstat.h"
 #include "utils/array.h"
+#include "utils/arrayaccess.h"
 #include "utils/builtins.h"
 #include "utils/date.h"
 #include "utils/datum.h"
 #include "utils/expandedrecord.h"
+#include "utils/float.h"
+#include "utils/fmgroids.h"
 #include "utils/json.h"
 #include "utils/jsonb.h"
 #include "utils/jsonfuncs.h"
@@ -180,6 +185,13 @@ static pg_attribute_always_inline void ExecAggPlainTransByRef(AggState *aggstate
 															  AggStatePerGroup pergroup,
 															  ExprContext *aggcontext,
 															  int setno);
+static pg_attribute_always_inline void ExecCmpVarInternal(ExprEvalStep *op,
+														  ExprContext *econtext,
+														  bool isconst);
+static pg_attribute_always_inline void ExecAggPlainTransCountInternal(AggState *aggstate,
+																	  ExprEvalStep *op);
+static pg_attribute_always_inline void ExecAggPlainTransIntSumInternal(AggState *aggstate,
+																	   ExprEvalStep *op);
 
 /*
  * ScalarArrayOpExprHashEntry
@@ -426,6 +438,8 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 		&&CASE_EEOP_FUNCEXPR_STRICT,
 		&&CASE_EEOP_FUNCEXPR_FUSAGE,
 		&&CASE_EEOP_FUNCEXPR_STRICT_FUSAGE,
+		&&CASE_EEOP_CMP_VAR_CONST,
+		&&CASE_EEOP_CMP_VAR_VAR,
 		&&CASE_EEOP_BOOL_AND_STEP_FIRST,
 		&&CASE_EEOP_BOOL_AND_STEP,
 		&&CASE_EEOP_BOOL_AND_STEP_LAST,
@@ -495,6 +509,8 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 		&&CASE_EEOP_AGG_PLAIN_TRANS_INIT_STRICT_BYREF,
 		&&CASE_EEOP_AGG_PLAIN_TRANS_STRICT_BYREF,
 		&&CASE_EEOP_AGG_PLAIN_TRANS_BYREF,
+		&&CASE_EEOP_AGG_PLAIN_TRANS_COUNT,
+		&&CASE_EEOP_AGG_PLAIN_TRANS_INT_SUM,
 		&&CASE_EEOP_AGG_PRESORTED_DISTINCT_SINGLE,
 		&&CASE_EEOP_AGG_PRESORTED_DISTINCT_MULTI,
 		&&CASE_EEOP_AGG_ORDERED_TRANS_DATUM,
@@ -763,6 +779,20 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 			EEO_NEXT();
 		}
 
+		EEO_CASE(EEOP_CMP_VAR_CONST)
+		{
+			ExecCmpVarInternal(op, econtext, true);
+
+			EEO_NEXT();
+		}
+
+		EEO_CASE(EEOP_CMP_VAR_VAR)
+		{
+			ExecCmpVarInternal(op, econtext, false);
+
+			EEO_NEXT();
+		}
+
 		EEO_CASE(EEOP_FUNCEXPR_FUSAGE)
 		{
 			/* not common enough to inline */
@@ -1796,6 +1826,24 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 			EEO_NEXT();
 		}
 
+		/* see comments above EEOP_AGG_PLAIN_TRANS_INIT_STRICT_BYVAL */
+		EEO_CASE(EEOP_AGG_PLAIN_TRANS_COUNT)
+		{
+			ExecAggPlainTransCountInternal(castNode(AggState, state->parent),
+										   op);
+
+			EEO_NEXT();
+		}
+
+		/* see comments above EEOP_AGG_PLAIN_TRANS_INIT_STRICT_BYVAL */
+		EEO_CASE(EEOP_AGG_PLAIN_TRANS_INT_SUM)
+		{
+			ExecAggPlainTransIntSumInternal(castNode(AggState, state->parent),
+											op);
+
+			EEO_NEXT();
+		}
+
 		EEO_CASE(EEOP_AGG_PRESORTED_DISTINCT_SINGLE)
 		{
 			AggStatePerTrans pertrans = op->d.agg_presorted_distinctcheck.pertrans;
@@ -1914,6 +1962,18 @@ CheckExprStillValid(ExprState *state, ExprContext *econtext)
 					CheckVarSlotCompatibility(scanslot, attnum + 1, op->d.var.vartype);
 					break;
 				}
+
+			case EEOP_CMP_VAR_VAR:
+				CheckVarSlotCompatibility(*(TupleTableSlot **) ((char *) econtext + op->d.cmp.rslotoff),
+										  op->d.cmp.rattnum + 1,
+										  op->d.cmp.rvartype);
+				/* FALLTHROUGH */
+			case EEOP_CMP_VAR_CONST:
+				CheckVarSlotCompatibility(*(TupleTableSlot **) ((char *) econtext + op->d.cmp.lslotoff),
+										  op->d.cmp.lattnum + 1,
+										  op->d.cmp.lvartype);
+				break;
+
 			default:
 				break;
 		}
@@ -2409,6 +2469,154 @@ ExecEvalFuncExprFusage(ExprState *state, ExprEvalStep *op,
 	pgstat_end_function_usage(&fcusage, true);
 }
 
+/*
+ * Value of one side of an EEOP_CMP_VAR_* step, for the integer types.
+ */
+static pg_attribute_always_inline int64
+cmp_var_int(Datum value, uint8 type)
+{
+	switch (type)
+	{
+		case EEO_CMP_INT2:
+			return DatumGetInt16(value);
+		case EEO_CMP_INT4:
+			return DatumGetInt32(value);
+		default:
+			return DatumGetInt64(value);
+	}
+}
+
+/*
+ * Compare two texts bytewise, as varstr_cmp does for the "C" collation.
+ */
+static int
+cmp_var_text(Datum l, Datum r)
+{
+	text	   *ltext = DatumGetTextPP(l);
+	text	   *rtext = DatumGetTextPP(r);
+	int			llen = VARSIZE_ANY_EXHDR(ltext);
+	int			rlen = VARSIZE_ANY_EXHDR(rtext);
+	int			result;
+
+	result = memcmp(VARDATA_ANY(ltext), VARDATA_ANY(rtext), Min(llen, rlen));
+	if (result == 0)
+		result = (llen > rlen) - (llen < rlen);
+
+	if ((Pointer) ltext != DatumGetPointer(l))
+		pfree(ltext);
+	if ((Pointer) rtext != DatumGetPointer(r))
+		pfree(rtext);
+
+	return result;
+}
+
+/*
+ * Evaluate EEOP_CMP_VAR_CONST and EEOP_CMP_VAR_VAR.
+ *
+ * The result is what the (strict) operator's function would have returned.
+ */
+static pg_attribute_always_inline void
+ExecCmpVarInternal(ExprEvalStep *op, ExprContext *econtext, bool isconst)
+{
+	TupleTableSlot *lslot;
+	Datum		l;
+	Datum		r;
+	int			cmp;
+	bool		result;
+
+	lslot = *(TupleTableSlot **) ((char *) econtext + op->d.cmp.lslotoff);
+	Assert(op->d.cmp.lattnum < lslot->tts_nvalid);
+	if (lslot->tts_isnull[op->d.cmp.lattnum])
+		goto isnull;
+	l = lslot->tts_values[op->d.cmp.lattnum];
+
+	if (isconst)
+		r = op->d.cmp.constval;
+	else
+	{
+		TupleTableSlot *rslot;
+
+		rslot = *(TupleTableSlot **) ((char *) econtext + op->d.cmp.rslotoff);
+		Assert(op->d.cmp.rattnum < rslot->tts_nvalid);
+		if (rslot->tts_isnull[op->d.cmp.rattnum])
+			goto isnull;
+		r = rslot->tts_values[op->d.cmp.rattnum];
+	}
+
+	switch (op->d.cmp.ltype)
+	{
+		case EEO_CMP_INT2:
+		case EEO_CMP_INT4:
+		case EEO_CMP_INT8:
+			{
+				int64		lval = cmp_var_int(l, op->d.cmp.ltype);
+				int64		rval = cmp_var_int(r, op->d.cmp.rtype);
+
+				cmp = (lval > rval) - (lval < rval);
+				break;
+			}
+		case EEO_CMP_FLOAT4:
+		case EEO_CMP_FLOAT8:
+			{
+				float8		lval;
+				float8		rval;
+
+				lval = op->d.cmp.ltype == EEO_CMP_FLOAT4 ?
+					DatumGetFloat4(l) : DatumGetFloat8(l);
+				rval = op->d.cmp.rtype == EEO_CMP_FLOAT4 ?
+					DatumGetFloat4(r) : DatumGetFloat8(r);
+
+				/* NaNs sort after everything else, as in float8_cmp_internal */
+				cmp = float8_gt(lval, rval) - float8_lt(lval, rval);
+				break;
+			}
+		default:
+			Assert(op->d.cmp.ltype == EEO_CMP_TEXT);
+			cmp = cmp_var_text(l, r);
+			break;
+	}
+
+	switch (op->d.cmp.strategy)
+	{
+		case BTLessStrategyNumber:
+			result = cmp < 0;
+			break;
+		case BTLessEqualStrategyNumber:
+			result = cmp <= 0;
+			break;
+		case BTEqualStrategyNumber:
+			result = cmp == 0;
+			break;
+		case BTGreaterEqualStrategyNumber:
+			result = cmp >= 0;
+			break;
+		case BTGreaterStrategyNumber:
+			result = cmp > 0;
+			break;
+		default:
+			Assert(op->d.cmp.strategy == EEO_CMP_NE);
+			result = cmp != 0;
+			break;
+	}
+
+	*op->resvalue = BoolGetDatum(result);
+	*op->resnull = false;
+	return;
+
+isnull:
+	*op->resvalue = (Datum) 0;
+	*op->resnull = true;
+}
+
+/*
+ * Out-of-line evaluation of EEOP_CMP_VAR_{CONST,VAR}
+ */
+void
+ExecEvalCmpVar(ExprState *state, ExprEvalStep *op, ExprContext *econtext)
+{
+	ExecCmpVarInternal(op, econtext, op->d.cmp.rattnum < 0);
+}
+
 /*
  * Evaluate EEOP_FUNCEXPR_STRICT_FUSAGE
  */
@@ -3347,16 +3555,14 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	FunctionCallInfo fcinfo = op->d.scalararrayop.fcinfo_data;
 	bool		useOr = op->d.scalararrayop.useOr;
 	bool		strictfunc = op->d.scalararrayop.finfo->fn_strict;
-	ArrayType  *arr;
+	AnyArrayType *arr;
+	array_iter	it;
 	int			nitems;
 	Datum		result;
 	bool		resultnull;
 	int16		typlen;
 	bool		typbyval;
 	char		typalign;
-	char	   *s;
-	bits8	   *bitmap;
-	int			bitmask;
 
 	/*
 	 * If the array is NULL then we return NULL --- it's not very meaningful
@@ -3365,8 +3571,11 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	if (*op->resnull)
 		return;
 
-	/* Else okay to fetch and detoast the array */
-	arr = DatumGetArrayTypeP(*op->resvalue);
+	/*
+	 * Else okay to fetch and detoast the array.  An expanded array, such as a
+	 * PL/pgSQL array variable, is read in place rather than flattened.
+	 */
+	arr = DatumGetAnyArrayP(*op->resvalue);
 
 	/*
 	 * If the array is empty, we return either FALSE or TRUE per the useOr
@@ -3374,7 +3583,7 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	 * evaluate the operator zero times, it matters not whether it would want
 	 * to return NULL.
 	 */
-	nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+	nitems = ArrayGetNItems(AARR_NDIM(arr), AARR_DIMS(arr));
 	if (nitems <= 0)
 	{
 		*op->resvalue = BoolGetDatum(!useOr);
@@ -3396,13 +3605,13 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	 * We arrange to look up info about the element type only once per series
 	 * of calls, assuming the element type doesn't change underneath us.
 	 */
-	if (op->d.scalararrayop.element_type != ARR_ELEMTYPE(arr))
+	if (op->d.scalararrayop.element_type != AARR_ELEMTYPE(arr))
 	{
-		get_typlenbyvalalign(ARR_ELEMTYPE(arr),
+		get_typlenbyvalalign(AARR_ELEMTYPE(arr),
 							 &op->d.scalararrayop.typlen,
 							 &op->d.scalararrayop.typbyval,
 							 &op->d.scalararrayop.typalign);
-		op->d.scalararrayop.element_type = ARR_ELEMTYPE(arr);
+		op->d.scalararrayop.element_type = AARR_ELEMTYPE(arr);
 	}
 
 	typlen = op->d.scalararrayop.typlen;
@@ -3414,29 +3623,15 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	resultnull = false;
 
 	/* Loop over the array elements */
-	s = (char *) ARR_DATA_PTR(arr);
-	bitmap = ARR_NULLBITMAP(arr);
-	bitmask = 1;
+	array_iter_setup(&it, arr);
 
 	for (int i = 0; i < nitems; i++)
 	{
-		Datum		elt;
 		Datum		thisresult;
 
 		/* Get array element, checking for NULL */
-		if (bitmap && (*bitmap & bitmask) == 0)
-		{
-			fcinfo->args[1].value = (Datum) 0;
-			fcinfo->args[1].isnull = true;
-		}
-		else
-		{
-			elt = fetch_att(s, typbyval, typlen);
-			s = att_addlength_pointer(s, typlen, s);
-			s = (char *) att_align_nominal(s, typalign);
-			fcinfo->args[1].value = elt;
-			fcinfo->args[1].isnull = false;
-		}
+		fcinfo->args[1].value = array_iter_next(&it, &fcinfo->args[1].isnull,
+												i, typlen, typbyval, typalign);
 
 		/* Call comparison function */
 		if (fcinfo->args[1].isnull && strictfunc)
@@ -3471,17 +3666,6 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 				break;			/* needn't look at any more elements */
 			}
 		}
-
-		/* advance bitmap pointer if any */
-		if (bitmap)
-		{
-			bitmask <<= 1;
-			if (bitmask == 0x100)
-			{
-				bitmap++;
-				bitmask = 1;
-			}
-		}
 	}
 
 	*op->resvalue = result;
@@ -3539,6 +3723,10 @@ saop_hash_element_match(struct saophash_hash *tb, Datum key1, Datum key2)
  * by subsequent lookups.  Unlike ExecEvalScalarArrayOp, this version only
  * supports OR semantics.
  *
+ * The array may also be an external Param, which keeps its value for the
+ * whole execution, so building the table once is just as valid.  Unlike a
+ * Const, it can be NULL though.
+ *
  * Source array is in our result area, scalar arg is already evaluated into
  * fcinfo->args[0].
  *
@@ -3557,8 +3745,9 @@ ExecEvalHashedScalarArrayOp(ExprState *state, ExprEvalStep *op, ExprContext *eco
 	bool		resultnull;
 	bool		hashfound;
 
-	/* We don't setup a hashed scalar array op if the array const is null. */
-	Assert(!*op->resnull);
+	/* A null array yields null, as in ExecEvalScalarArrayOp */
+	if (*op->resnull)
+		return;
 
 	/*
 	 * If the scalar is NULL, and the function is strict, return NULL; no
@@ -3587,6 +3776,13 @@ ExecEvalHashedScalarArrayOp(ExprState *state, ExprEvalStep *op, ExprContext *eco
 
 		saop = op->d.hashedscalararrayop.saop;
 
+		/*
+		 * The hash table points into the array for pass-by-reference
+		 * elements, so if the array needs detoasting, keep the copy as long
+		 * as the table.
+		 */
+		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+
 		arr = DatumGetArrayTypeP(*op->resvalue);
 		nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
 
@@ -3595,8 +3791,6 @@ ExecEvalHashedScalarArrayOp(ExprState *state, ExprEvalStep *op, ExprContext *eco
 							 &typbyval,
 							 &typalign);
 
-		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
-
 		elements_tab = (ScalarArrayOpExprHashTable *)
 			palloc0(offsetof(ScalarArrayOpExprHashTable, hash_fcinfo_data) +
 					SizeForFunctionCallInfo(1));
@@ -4633,6 +4827,79 @@ ExecAggPlainTransByVal(AggState *aggstate, AggStatePerTrans pertrans,
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ * Implementation of EEOP_AGG_PLAIN_TRANS_COUNT: int8inc or int8inc_any as a
+ * strict transition function, for a byval int8.
+ */
+static pg_attribute_always_inline void
+ExecAggPlainTransCountInternal(AggState *aggstate, ExprEvalStep *op)
+{
+	AggStatePerGroup pergroup =
+		&aggstate->all_pergroups[op->d.agg_trans.setoff][op->d.agg_trans.transno];
+	int64		result;
+
+	Assert(op->d.agg_trans.pertrans->transtypeByVal);
+
+	if (unlikely(pergroup->transValueIsNull))
+		return;
+
+	if (unlikely(pg_add_s64_overflow(DatumGetInt64(pergroup->transValue), 1,
+									 &result)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("bigint out of range")));
+
+	pergroup->transValue = Int64GetDatum(result);
+}
+
+/*
+ * Implementation of EEOP_AGG_PLAIN_TRANS_INT_SUM: int2_sum or int4_sum, for
+ * a byval int8.  These aren't strict, so handle nulls as they do.
+ */
+static pg_attribute_always_inline void
+ExecAggPlainTransIntSumInternal(AggState *aggstate, ExprEvalStep *op)
+{
+	AggStatePerTrans pertrans = op->d.agg_trans.pertrans;
+	AggStatePerGroup pergroup =
+		&aggstate->all_pergroups[op->d.agg_trans.setoff][op->d.agg_trans.transno];
+	NullableDatum *arg = &pertrans->transfn_fcinfo->args[1];
+	int64		newval;
+
+	Assert(pertrans->transtypeByVal);
+
+	if (arg->isnull)
+		return;
+
+	if (pertrans->transfn_oid == F_INT2_SUM)
+		newval = DatumGetInt16(arg->value);
+	else
+		newval = DatumGetInt32(arg->value);
+
+	if (pergroup->transValueIsNull)
+	{
+		pergroup->transValue = Int64GetDatum(newval);
+		pergroup->transValueIsNull = false;
+	}
+	else
+		pergroup->transValue =
+			Int64GetDatum(DatumGetInt64(pergroup->transValue) + newval);
+}
+
+/*
+ * Out-of-line evaluation of EEOP_AGG_PLAIN_TRANS_{COUNT,INT_SUM}
+ */
+void
+ExecEvalAggPlainTransCount(ExprState *state, ExprEvalStep *op)
+{
+	ExecAggPlainTransCountInternal(castNode(AggState, state->parent), op);
+}
+
+void
+ExecEvalAggPlainTransIntSum(ExprState *state, ExprEvalStep *op)
+{
+	ExecAggPlainTransIntSumInternal(castNode(AggState, state->parent), op);
+}
+
 /* implementation of transition function invocation for byref types */
 static pg_attribute_always_inline void
 ExecAggPlainTransByRef(AggState *aggstate, AggStatePerTrans pertrans,
@@ -14,6 +14,7 @@
  */
 #include "postgres.h"
 
+#include "access/hash.h"
 #include "access/parallel.h"
 #include "common/hashfn.h"
 #include "executor/executor.h"
@@ -184,12 +185,20 @@ BuildTupleHashTableExt(PlanState *parent,
 	hashtable->keyColIdx = keyColIdx;
 	hashtable->tab_hash_funcs = hashfunctions;
 	hashtable->tab_collations = collations;
+
+	/* use the builtin hash functions directly, where possible */
+	hashtable->tab_hash_direct = palloc(numCols * sizeof(DatumHashFunction));
+	for (int i = 0; i < numCols; i++)
+		hashtable->tab_hash_direct[i] =
+			hash_direct_function(hashfunctions[i].fn_oid, collations[i]);
+
 	hashtable->tablecxt = tablecxt;
 	hashtable->tempcxt = tempcxt;
 	hashtable->entrysize = entrysize;
 	hashtable->tableslot = NULL;	/* will be made on first lookup */
 	hashtable->inputslot = NULL;
 	hashtable->in_hash_funcs = NULL;
+	hashtable->in_hash_direct = NULL;
 	hashtable->cur_eq_func = NULL;
 
 	/*
@@ -316,6 +325,7 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 	/* set up data needed by hash and match functions */
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
+	hashtable->in_hash_direct = hashtable->tab_hash_direct;
 	hashtable->cur_eq_func = hashtable->tab_eq_func;
 
 	local_hash = TupleHashTableHash_internal(hashtable->hashtab, NULL);
@@ -342,6 +352,7 @@ TupleHashTableHash(TupleHashTable hashtable, TupleTableSlot *slot)
 
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
+	hashtable->in_hash_direct = hashtable->tab_hash_direct;
 
 	/* Need to run the hash functions in short-lived context */
 	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
@@ -370,6 +381,7 @@ LookupTupleHashEntryHash(TupleHashTable hashtable, TupleTableSlot *slot,
 	/* set up data needed by hash and match functions */
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
+	hashtable->in_hash_direct = hashtable->tab_hash_direct;
 	hashtable->cur_eq_func = hashtable->tab_eq_func;
 
 	entry = LookupTupleHashEntry_internal(hashtable, slot, isnew, hash);
@@ -404,6 +416,8 @@ FindTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 	/* Set up data needed by hash and match functions */
 	hashtable->inputslot = slot;
 	hashtable->in_hash_funcs = hashfunctions;
+	hashtable->in_hash_direct = (hashfunctions == hashtable->tab_hash_funcs) ?
+		hashtable->tab_hash_direct : NULL;
 	hashtable->cur_eq_func = eqcomp;
 
 	/* Search the hash table */
@@ -432,6 +446,7 @@ TupleHashTableHash_internal(struct tuplehash_hash *tb,
 	uint32		hashkey = hashtable->hash_iv;
 	TupleTableSlot *slot;
 	FmgrInfo   *hashfunctions;
+	DatumHashFunction *hashdirect;
 	int			i;
 
 	if (tuple == NULL)
@@ -439,6 +454,7 @@ TupleHashTableHash_internal(struct tuplehash_hash *tb,
 		/* Process the current input tuple for the table */
 		slot = hashtable->inputslot;
 		hashfunctions = hashtable->in_hash_funcs;
+		hashdirect = hashtable->in_hash_direct;
 	}
 	else
 	{
@@ -451,6 +467,7 @@ TupleHashTableHash_internal(struct tuplehash_hash *tb,
 		slot = hashtable->tableslot;
 		ExecStoreMinimalTuple(tuple, slot, false);
 		hashfunctions = hashtable->tab_hash_funcs;
+		hashdirect = hashtable->tab_hash_direct;
 	}
 
 	for (i = 0; i < numCols; i++)
@@ -468,9 +485,12 @@ TupleHashTableHash_internal(struct tuplehash_hash *tb,
 		{
 			uint32		hkey;
 
-			hkey = DatumGetUInt32(FunctionCall1Coll(&hashfunctions[i],
-													hashtable->tab_collations[i],
-													attr));
+			if (hashdirect && hashdirect[i])
+				hkey = hashdirect[i] (attr);
+			else
+				hkey = DatumGetUInt32(FunctionCall1Coll(&hashfunctions[i],
+														hashtable->tab_collations[i],
+														attr));
 			hashkey ^= hkey;
 		}
 	}
@@ -111,6 +111,7 @@
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "catalog/index.h"
+#include "catalog/indextidlog.h"
 #include "executor/executor.h"
 #include "nodes/nodeFuncs.h"
 #include "storage/lmgr.h"
@@ -349,9 +350,17 @@ ExecInsertIndexTuples(ResultRelInfo *resultRelInfo,
 
 		indexInfo = indexInfoArray[i];
 
-		/* If the index is marked as read-only, ignore it */
+		/*
+		 * If the index is marked as read-only, ignore it, but let a
+		 * concurrent build of it know about the new tuple, see
+		 * indextidlog.c.
+		 */
 		if (!indexInfo->ii_ReadyForInserts)
+		{
+			if (!onlySummarizing)
+				index_tidlog_record(indexRelation, tupleid);
 			continue;
+		}
 
 		/*
 		 * Skip processing of non-summarizing indexes if we only update
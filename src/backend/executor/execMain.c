@@ -38,6 +38,7 @@
 #include "postgres.h"
 
 #include "access/heapam.h"
+#include "access/parallel.h"
 #include "access/htup_details.h"
 #include "access/sysattr.h"
 #include "access/tableam.h"
@@ -49,6 +50,7 @@
 #include "commands/matview.h"
 #include "commands/trigger.h"
 #include "executor/execdebug.h"
+#include "executor/instrument.h"
 #include "executor/nodeSubplan.h"
 #include "foreign/fdwapi.h"
 #include "jit/jit.h"
@@ -56,6 +58,7 @@
 #include "miscadmin.h"
 #include "parser/parse_relation.h"
 #include "parser/parsetree.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "tcop/utility.h"
@@ -251,6 +254,7 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	estate->es_crosscheck_snapshot = RegisterSnapshot(queryDesc->crosscheck_snapshot);
 	estate->es_top_eflags = eflags;
 	estate->es_instrument = queryDesc->instrument_options;
+	estate->es_instrument_sample = queryDesc->instrument_sample;
 	estate->es_jit_flags = queryDesc->plannedstmt->jitFlags;
 
 	/*
@@ -265,6 +269,18 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	 */
 	InitPlan(queryDesc, eflags);
 
+	/*
+	 * Measure the whole query for the cumulative query statistics, unless a
+	 * plugin already does.  Parallel workers' usage is accounted for in the
+	 * leader.
+	 */
+	if (pgstat_track_queries &&
+		queryDesc->plannedstmt->queryId != UINT64CONST(0) &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY) &&
+		!IsParallelWorker() &&
+		queryDesc->totaltime == NULL)
+		queryDesc->totaltime = InstrAlloc(1, INSTRUMENT_ALL, false);
+
 	MemoryContextSwitchTo(oldcontext);
 }
 
@@ -495,6 +511,18 @@ standard_ExecutorEnd(QueryDesc *queryDesc)
 	Assert(estate->es_finished ||
 		   (estate->es_top_eflags & EXEC_FLAG_EXPLAIN_ONLY));
 
+	/* Report the execution to the cumulative query statistics */
+	if (queryDesc->totaltime &&
+		pgstat_track_queries &&
+		queryDesc->plannedstmt->queryId != UINT64CONST(0) &&
+		!(estate->es_top_eflags & EXEC_FLAG_EXPLAIN_ONLY) &&
+		!IsParallelWorker())
+	{
+		InstrEndLoop(queryDesc->totaltime);
+		pgstat_report_query(queryDesc->plannedstmt->queryId,
+							queryDesc->totaltime, estate->es_processed);
+	}
+
 	/*
 	 * Switch into per-query memory context to run ExecEndPlan
 	 */
@@ -1024,7 +1052,7 @@ void
 CheckValidResultRel(ResultRelInfo *resultRelInfo, CmdType operation)
 {
 	Relation	resultRel = resultRelInfo->ri_RelationDesc;
-	TriggerDesc *trigDesc = resultRel->trigdesc;
+	TriggerDesc *trigDesc = RelationGetTriggerDesc(resultRel);
 	FdwRoutine *fdwroutine;
 
 	switch (resultRel->rd_rel->relkind)
@@ -1236,7 +1264,7 @@ InitResultRelInfo(ResultRelInfo *resultRelInfo,
 	resultRelInfo->ri_IndexRelationDescs = NULL;
 	resultRelInfo->ri_IndexRelationInfo = NULL;
 	/* make a copy so as not to depend on relcache info not changing... */
-	resultRelInfo->ri_TrigDesc = CopyTriggerDesc(resultRelationDesc->trigdesc);
+	resultRelInfo->ri_TrigDesc = CopyTriggerDesc(RelationGetTriggerDesc(resultRelationDesc));
 	if (resultRelInfo->ri_TrigDesc)
 	{
 		int			n = resultRelInfo->ri_TrigDesc->numtriggers;
@@ -2881,6 +2909,7 @@ EvalPlanQualStart(EPQState *epqstate, Plan *planTree)
 	/* es_trig_target_relations must NOT be copied */
 	rcestate->es_top_eflags = parentestate->es_top_eflags;
 	rcestate->es_instrument = parentestate->es_instrument;
+	rcestate->es_instrument_sample = parentestate->es_instrument_sample;
 	/* es_auxmodifytables must NOT be copied */
 
 	/*
@@ -23,6 +23,7 @@
 
 #include "postgres.h"
 
+#include "commands/createas.h"
 #include "executor/execParallel.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -78,6 +79,9 @@ typedef struct FixedParallelExecutorState
 	dsa_pointer param_exec;
 	int			eflags;
 	int			jit_flags;
+	Oid			insert_relid;	/* relation to insert the output into, or
+								 * InvalidOid to send it to the leader */
+	pg_atomic_uint64 tuples_inserted;	/* summed over workers */
 } FixedParallelExecutorState;
 
 /*
@@ -85,6 +89,8 @@ typedef struct FixedParallelExecutorState
  *
  * instrument_options: Same meaning here as in instrument.c.
  *
+ * instrument_sample: Sampling rate of the node timing, as in EState.
+ *
  * instrument_offset: Offset, relative to the start of this structure,
  * of the first Instrumentation object.  This will depend on the length of
  * the plan_node_id array.
@@ -99,6 +105,7 @@ typedef struct FixedParallelExecutorState
 struct SharedExecutorInstrumentation
 {
 	int			instrument_options;
+	int			instrument_sample;
 	int			instrument_offset;
 	int			num_workers;
 	int			num_plan_nodes;
@@ -584,11 +591,15 @@ ExecParallelSetupTupleQueues(ParallelContext *pcxt, bool reinitialize)
 /*
  * Sets up the required infrastructure for backend workers to perform
  * execution and return results to the main backend.
+ *
+ * If insert_relid is valid, the workers instead insert their results into
+ * that relation, which must be the one a CREATE TABLE AS just created, and
+ * ExecParallelFinish adds up how many tuples they inserted.
  */
 ParallelExecutorInfo *
 ExecInitParallelPlan(PlanState *planstate, EState *estate,
 					 Bitmapset *sendParams, int nworkers,
-					 int64 tuples_needed)
+					 int64 tuples_needed, Oid insert_relid)
 {
 	ParallelExecutorInfo *pei;
 	ParallelContext *pcxt;
@@ -739,6 +750,8 @@ ExecInitParallelPlan(PlanState *planstate, EState *estate,
 	fpes->param_exec = InvalidDsaPointer;
 	fpes->eflags = estate->es_top_eflags;
 	fpes->jit_flags = estate->es_jit_flags;
+	fpes->insert_relid = insert_relid;
+	pg_atomic_init_u64(&fpes->tuples_inserted, 0);
 	shm_toc_insert(pcxt->toc, PARALLEL_KEY_EXECUTOR_FIXED, fpes);
 
 	/* Store query string */
@@ -786,6 +799,7 @@ ExecInitParallelPlan(PlanState *planstate, EState *estate,
 
 		instrumentation = shm_toc_allocate(pcxt->toc, instrumentation_len);
 		instrumentation->instrument_options = estate->es_instrument;
+		instrumentation->instrument_sample = estate->es_instrument_sample;
 		instrumentation->instrument_offset = instrument_offset;
 		instrumentation->num_workers = nworkers;
 		instrumentation->num_plan_nodes = e.nnodes;
@@ -919,6 +933,7 @@ ExecParallelReinitialize(PlanState *planstate,
 	pei->finished = false;
 
 	fpes = shm_toc_lookup(pei->pcxt->toc, PARALLEL_KEY_EXECUTOR_FIXED, false);
+	pg_atomic_write_u64(&fpes->tuples_inserted, 0);
 
 	/* Free any serialized parameters from the last round. */
 	if (DsaPointerIsValid(fpes->param_exec))
@@ -995,6 +1010,10 @@ ExecParallelReInitializeDSM(PlanState *planstate,
 				ExecHashJoinReInitializeDSM((HashJoinState *) planstate,
 											pcxt);
 			break;
+		case T_AggState:
+			if (planstate->plan->parallel_aware)
+				ExecAggReInitializeDSM((AggState *) planstate, pcxt);
+			break;
 		case T_HashState:
 		case T_SortState:
 		case T_IncrementalSortState:
@@ -1120,7 +1139,7 @@ ExecParallelRetrieveJitInstrumentation(PlanState *planstate,
 
 /*
  * Finish parallel execution.  We wait for parallel workers to finish, and
- * accumulate their buffer/WAL usage.
+ * accumulate their buffer/WAL usage and tuple queue waits.
  */
 void
 ExecParallelFinish(ParallelExecutorInfo *pei)
@@ -1166,6 +1185,39 @@ ExecParallelFinish(ParallelExecutorInfo *pei)
 	for (i = 0; i < nworkers; i++)
 		InstrAccumParallelQuery(&pei->buffer_usage[i], &pei->wal_usage[i]);
 
+	/*
+	 * Likewise the tuple queue waits.  We've detached from the queues, but
+	 * they're still there in the DSM.
+	 */
+	if (nworkers > 0)
+	{
+		char	   *tqueuespace;
+
+		tqueuespace = shm_toc_lookup(pei->pcxt->toc, PARALLEL_KEY_TUPLE_QUEUE,
+									 false);
+		for (i = 0; i < nworkers; i++)
+		{
+			uint64		send_stalls;
+			uint64		receive_stalls;
+
+			shm_mq_get_stalls((shm_mq *) (tqueuespace +
+										  ((Size) i) * PARALLEL_TUPLE_QUEUE_SIZE),
+							  &send_stalls, &receive_stalls);
+			pei->tqueue_send_stalls += send_stalls;
+			pei->tqueue_receive_stalls += receive_stalls;
+		}
+	}
+
+	/* And what the workers inserted themselves, if they did */
+	if (nworkers > 0)
+	{
+		FixedParallelExecutorState *fpes;
+
+		fpes = shm_toc_lookup(pei->pcxt->toc, PARALLEL_KEY_EXECUTOR_FIXED,
+							  false);
+		pei->tuples_inserted += pg_atomic_read_u64(&fpes->tuples_inserted);
+	}
+
 	pei->finished = true;
 }
 
@@ -1398,6 +1450,7 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 	BufferUsage *buffer_usage;
 	WalUsage   *wal_usage;
 	DestReceiver *receiver;
+	DestReceiver *insert_receiver = NULL;
 	QueryDesc  *queryDesc;
 	SharedExecutorInstrumentation *instrumentation;
 	SharedJitInstrumentation *jit_instrumentation;
@@ -1416,7 +1469,19 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 		instrument_options = instrumentation->instrument_options;
 	jit_instrumentation = shm_toc_lookup(toc, PARALLEL_KEY_JIT_INSTRUMENTATION,
 										 true);
-	queryDesc = ExecParallelGetQueryDesc(toc, receiver, instrument_options);
+
+	/*
+	 * If the leader asked us to insert our output into a relation ourselves,
+	 * nothing goes to the tuple queue; but we stay attached to it anyway
+	 * until we're done, which is how the leader knows that we are.
+	 */
+	if (OidIsValid(fpes->insert_relid))
+		insert_receiver = CreateIntoRelWorkerDestReceiver(fpes->insert_relid);
+	queryDesc = ExecParallelGetQueryDesc(toc,
+										 insert_receiver ? insert_receiver : receiver,
+										 instrument_options);
+	if (instrumentation != NULL)
+		queryDesc->instrument_sample = instrumentation->instrument_sample;
 
 	/* Setting debug_query_string for individual workers */
 	debug_query_string = queryDesc->sourceText;
@@ -1466,6 +1531,10 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 				fpes->tuples_needed < 0 ? (int64) 0 : fpes->tuples_needed,
 				true);
 
+	if (insert_receiver != NULL)
+		pg_atomic_fetch_add_u64(&fpes->tuples_inserted,
+								queryDesc->estate->es_processed);
+
 	/* Shut down the executor */
 	ExecutorFinish(queryDesc);
 
@@ -1494,5 +1563,7 @@ ParallelQueryMain(dsm_segment *seg, shm_toc *toc)
 	/* Cleanup. */
 	dsa_detach(area);
 	FreeQueryDesc(queryDesc);
+	if (insert_receiver != NULL)
+		insert_receiver->rDestroy(insert_receiver);
 	receiver->rDestroy(receiver);
 }
@@ -16,6 +16,7 @@
 #include "access/table.h"
 #include "access/tableam.h"
 #include "catalog/partition.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_type.h"
 #include "executor/execPartition.h"
@@ -30,6 +31,7 @@
 #include "partitioning/partprune.h"
 #include "rewrite/rewriteManip.h"
 #include "utils/acl.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
 #include "utils/partcache.h"
 #include "utils/rls.h"
@@ -154,6 +156,17 @@ typedef struct PartitionDispatchData
 	int			indexes[FLEXIBLE_ARRAY_MEMBER];
 }			PartitionDispatchData;
 
+/*
+ * PrunedLeafEntry - hash table entry used by ExecGetPrunedPartitionRelids()
+ * to decide which pruned leaf partitions need not be locked.
+ */
+typedef struct PrunedLeafEntry
+{
+	Oid			relid;			/* hash key; must be first */
+	int			npruned;		/* # of pruned subplans scanning it */
+	int			nrefs;			/* # of range table entries for it */
+} PrunedLeafEntry;
+
 
 static ResultRelInfo *ExecInitPartitionInfo(ModifyTableState *mtstate,
 											EState *estate, PartitionTupleRouting *proute,
@@ -195,6 +208,8 @@ static void InitPartitionPruneContext(PartitionPruneContext *context,
 static void PartitionPruneFixSubPlanMap(PartitionPruneState *prunestate,
 										Bitmapset *initially_valid_subplans,
 										int n_total_subplans);
+static void collect_initial_pruning(Plan *plan, List **pruneinfos,
+									List **nsubplans);
 static void find_matching_subplans_recurse(PartitionPruningData *prunedata,
 										   PartitionedRelPruningData *pprune,
 										   bool initial_prune,
@@ -2396,3 +2411,220 @@ find_matching_subplans_recurse(PartitionPruningData *prunedata,
 		}
 	}
 }
+
+/*
+ * ExecGetPrunedPartitionRelids
+ *		Find the leaf partitions that initial pruning will eliminate from a
+ *		plan, before the executor is started
+ *
+ * Returns the range table indexes of the leaf partitions that the initial
+ * pruning steps of the plan's Append and MergeAppend nodes eliminate for the
+ * given parameter values, and that no other part of the plan refers to.  The
+ * executor won't open those, so AcquireExecutorLocks() needn't lock them; if
+ * it does end up opening one, ExecGetRangeTableRelation() takes the lock.
+ *
+ * The caller must already hold the locks on the plan's partitioned tables.
+ */
+Bitmapset *
+ExecGetPrunedPartitionRelids(PlannedStmt *plannedstmt, ParamListInfo params)
+{
+	List	   *pruneinfos = NIL;
+	List	   *nsubplans = NIL;
+	EState	   *estate;
+	PlanState  *planstate;
+	MemoryContext oldcontext;
+	HTAB	   *leaves;
+	HASHCTL		ctl;
+	ListCell   *lc;
+	ListCell   *lc2;
+	Index		rti;
+	Bitmapset  *result = NULL;
+
+	collect_initial_pruning(plannedstmt->planTree, &pruneinfos, &nsubplans);
+	foreach(lc, plannedstmt->subplans)
+		collect_initial_pruning((Plan *) lfirst(lc), &pruneinfos, &nsubplans);
+	if (pruneinfos == NIL)
+		return NULL;
+
+	/*
+	 * Evaluate the initial pruning steps the way ExecInitAppend() will, in a
+	 * throwaway executor state.  Those steps don't depend on the parent plan
+	 * node, so a bare PlanState will do for that.
+	 */
+	estate = CreateExecutorState();
+	estate->es_param_list_info = params;
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	ExecInitRangeTable(estate, plannedstmt->rtable, plannedstmt->permInfos);
+	planstate = palloc0(sizeof(PlanState));
+	planstate->state = estate;
+
+	/* Count how many times each pruned leaf partition was pruned */
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(PrunedLeafEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	leaves = hash_create("pruned partitions", 64, &ctl,
+						 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	forboth(lc, pruneinfos, lc2, nsubplans)
+	{
+		PartitionPruneInfo *pruneinfo = lfirst_node(PartitionPruneInfo, lc);
+		int			n_total_subplans = lfirst_int(lc2);
+		Oid		   *subplan_relids;
+		Bitmapset  *validsubplans;
+		ListCell   *lc3;
+
+		(void) ExecInitPartitionPruning(planstate, n_total_subplans,
+										pruneinfo, &validsubplans);
+
+		/* Map subplan indexes to the leaf partitions they scan */
+		subplan_relids = palloc0(sizeof(Oid) * n_total_subplans);
+		foreach(lc3, pruneinfo->prune_infos)
+		{
+			List	   *partrelpruneinfos = lfirst_node(List, lc3);
+			ListCell   *lc4;
+
+			foreach(lc4, partrelpruneinfos)
+			{
+				PartitionedRelPruneInfo *pinfo = lfirst_node(PartitionedRelPruneInfo, lc4);
+
+				for (int k = 0; k < pinfo->nparts; k++)
+				{
+					if (pinfo->subplan_map[k] >= 0)
+						subplan_relids[pinfo->subplan_map[k]] =
+							pinfo->relid_map[k];
+				}
+			}
+		}
+
+		for (int i = 0; i < n_total_subplans; i++)
+		{
+			PrunedLeafEntry *entry;
+			bool		found;
+
+			if (!OidIsValid(subplan_relids[i]) ||
+				bms_is_member(i, validsubplans))
+				continue;
+
+			entry = hash_search(leaves, &subplan_relids[i], HASH_ENTER, &found);
+			if (!found)
+			{
+				entry->npruned = 0;
+				entry->nrefs = 0;
+			}
+			entry->npruned++;
+		}
+	}
+
+	/*
+	 * A pruned partition can go unlocked only if all the range table entries
+	 * for it belong to subplans that were pruned.
+	 */
+	foreach(lc, plannedstmt->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		PrunedLeafEntry *entry;
+
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+		entry = hash_search(leaves, &rte->relid, HASH_FIND, NULL);
+		if (entry)
+			entry->nrefs++;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	rti = 0;
+	foreach(lc, plannedstmt->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		PrunedLeafEntry *entry;
+
+		rti++;
+		if (rte->rtekind != RTE_RELATION ||
+			rte->relkind == RELKIND_PARTITIONED_TABLE)
+			continue;
+		entry = hash_search(leaves, &rte->relid, HASH_FIND, NULL);
+		if (entry && entry->nrefs == entry->npruned)
+			result = bms_add_member(result, rti);
+	}
+
+	ExecCloseRangeTableRelations(estate);
+	FreeExecutorState(estate);
+
+	return result;
+}
+
+/*
+ * collect_initial_pruning
+ *		Recursive worker for ExecGetPrunedPartitionRelids
+ *
+ * Adds the PartitionPruneInfos that have initial pruning steps, of the
+ * Append and MergeAppend nodes in the given plan tree, to *pruneinfos, and
+ * the numbers of subplans of those nodes to *nsubplans.
+ */
+static void
+collect_initial_pruning(Plan *plan, List **pruneinfos, List **nsubplans)
+{
+	PartitionPruneInfo *pruneinfo = NULL;
+	List	   *childplans = NIL;
+	ListCell   *lc;
+
+	if (plan == NULL)
+		return;
+
+	/* Guard against stack overflow due to overly complex plans */
+	check_stack_depth();
+
+	switch (nodeTag(plan))
+	{
+		case T_Append:
+			pruneinfo = ((Append *) plan)->part_prune_info;
+			childplans = ((Append *) plan)->appendplans;
+			break;
+		case T_MergeAppend:
+			pruneinfo = ((MergeAppend *) plan)->part_prune_info;
+			childplans = ((MergeAppend *) plan)->mergeplans;
+			break;
+		case T_SubqueryScan:
+			collect_initial_pruning(((SubqueryScan *) plan)->subplan,
+									pruneinfos, nsubplans);
+			break;
+		case T_CustomScan:
+			childplans = ((CustomScan *) plan)->custom_plans;
+			break;
+		default:
+			break;
+	}
+
+	if (pruneinfo != NULL && childplans != NIL)
+	{
+		foreach(lc, pruneinfo->prune_infos)
+		{
+			List	   *partrelpruneinfos = lfirst_node(List, lc);
+			ListCell   *lc2;
+			bool		found = false;
+
+			foreach(lc2, partrelpruneinfos)
+			{
+				PartitionedRelPruneInfo *pinfo = lfirst_node(PartitionedRelPruneInfo, lc2);
+
+				if (pinfo->initial_pruning_steps != NIL)
+				{
+					found = true;
+					break;
+				}
+			}
+			if (found)
+			{
+				*pruneinfos = lappend(*pruneinfos, pruneinfo);
+				*nsubplans = lappend_int(*nsubplans, list_length(childplans));
+				break;
+			}
+		}
+	}
+
+	foreach(lc, childplans)
+		collect_initial_pruning((Plan *) lfirst(lc), pruneinfos, nsubplans);
+	collect_initial_pruning(plan->lefttree, pruneinfos, nsubplans);
+	collect_initial_pruning(plan->righttree, pruneinfos, nsubplans);
+}
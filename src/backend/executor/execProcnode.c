@@ -118,9 +118,14 @@
 #include "executor/nodeWorktablescan.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "storage/fd.h"
+#include "utils/backend_profile.h"
 
+static TempFileOwner *ExecInitTempFileOwner(PlanState *node);
 static TupleTableSlot *ExecProcNodeFirst(PlanState *node);
 static TupleTableSlot *ExecProcNodeInstr(PlanState *node);
+static TupleTableSlot *ExecProcNodeTempFiles(PlanState *node);
+static TupleTableSlot *ExecProcNodeProfile(PlanState *node);
 static bool ExecShutdownNode_walker(PlanState *node, void *context);
 
 
@@ -408,12 +413,74 @@ ExecInitNode(Plan *node, EState *estate, int eflags)
 
 	/* Set up instrumentation for this node if requested */
 	if (estate->es_instrument)
+	{
 		result->instrument = InstrAlloc(1, estate->es_instrument,
 										result->async_capable);
+		result->instrument->sample_every = estate->es_instrument_sample;
+	}
+
+	result->temp_file_owner = ExecInitTempFileOwner(result);
 
 	return result;
 }
 
+/*
+ * Set up the charging of temporary files to a node of a type that may spill
+ * to them, so that its usage shows up in pg_stat_progress_temp_files and in
+ * EXPLAIN, and node_temp_file_limit applies.  Other nodes' temporary files,
+ * if any, are charged to the nearest such node above them.
+ */
+static TempFileOwner *
+ExecInitTempFileOwner(PlanState *node)
+{
+	TempFileOwner *owner;
+	const char *node_type;
+
+	switch (nodeTag(node))
+	{
+		case T_SortState:
+			node_type = "Sort";
+			break;
+		case T_IncrementalSortState:
+			node_type = "Incremental Sort";
+			break;
+		case T_AggState:
+			node_type = "Aggregate";
+			break;
+		case T_HashState:
+			node_type = "Hash";
+			break;
+		case T_HashJoinState:
+			node_type = "Hash Join";
+			break;
+		case T_MaterialState:
+			node_type = "Materialize";
+			break;
+		case T_WindowAggState:
+			node_type = "WindowAgg";
+			break;
+		case T_CteScanState:
+			node_type = "CTE Scan";
+			break;
+		case T_RecursiveUnionState:
+			node_type = "Recursive Union";
+			break;
+		case T_FunctionScanState:
+			node_type = "Function Scan";
+			break;
+		case T_TableFuncScanState:
+			node_type = "Table Function Scan";
+			break;
+		default:
+			return NULL;
+	}
+
+	owner = palloc(sizeof(TempFileOwner));
+	InitTempFileOwner(owner, node->plan->plan_node_id, node_type);
+
+	return owner;
+}
+
 
 /*
  * If a node wants to change its ExecProcNode function after ExecInitNode()
@@ -454,9 +521,15 @@ ExecProcNodeFirst(PlanState *node)
 	/*
 	 * If instrumentation is required, change the wrapper to one that just
 	 * does instrumentation.  Otherwise we can dispense with all wrappers and
-	 * have ExecProcNode() directly call the relevant function from now on.
+	 * have ExecProcNode() directly call the relevant function from now on,
+	 * unless the node's temporary files have to be charged to it or it has to
+	 * be visible to profile sampling.
 	 */
-	if (node->instrument)
+	if (profile_sample_interval > 0)
+		node->ExecProcNode = ExecProcNodeProfile;
+	else if (node->temp_file_owner)
+		node->ExecProcNode = ExecProcNodeTempFiles;
+	else if (node->instrument)
 		node->ExecProcNode = ExecProcNodeInstr;
 	else
 		node->ExecProcNode = node->ExecProcNodeReal;
@@ -485,6 +558,57 @@ ExecProcNodeInstr(PlanState *node)
 }
 
 
+/*
+ * ExecProcNode wrapper that charges the temporary files created while the
+ * node runs to it, and does instrumentation if required.
+ */
+static TupleTableSlot *
+ExecProcNodeTempFiles(PlanState *node)
+{
+	TempFileOwner *save_owner = CurrentTempFileOwner;
+	TupleTableSlot *result;
+
+	CurrentTempFileOwner = node->temp_file_owner;
+
+	if (node->instrument)
+		result = ExecProcNodeInstr(node);
+	else
+		result = node->ExecProcNodeReal(node);
+
+	CurrentTempFileOwner = save_owner;
+
+	return result;
+}
+
+
+/*
+ * ExecProcNode wrapper that makes the node the one profile sampling sees as
+ * executing, and then calls whatever other wrapper the node needs.
+ */
+static TupleTableSlot *
+ExecProcNodeProfile(PlanState *node)
+{
+	int			save_plan_node_id = ProfilePlanNodeId;
+	int			save_node_tag = ProfileNodeTag;
+	TupleTableSlot *result;
+
+	ProfilePlanNodeId = node->plan->plan_node_id;
+	ProfileNodeTag = (int) nodeTag(node);
+
+	if (node->temp_file_owner)
+		result = ExecProcNodeTempFiles(node);
+	else if (node->instrument)
+		result = ExecProcNodeInstr(node);
+	else
+		result = node->ExecProcNodeReal(node);
+
+	ProfilePlanNodeId = save_plan_node_id;
+	ProfileNodeTag = save_node_tag;
+
+	return result;
+}
+
+
 /* ----------------------------------------------------------------
  *		MultiExecProcNode
  *
@@ -502,6 +626,9 @@ Node *
 MultiExecProcNode(PlanState *node)
 {
 	Node	   *result;
+	TempFileOwner *save_owner = CurrentTempFileOwner;
+	int			save_plan_node_id = ProfilePlanNodeId;
+	int			save_node_tag = ProfileNodeTag;
 
 	check_stack_depth();
 
@@ -510,6 +637,14 @@ MultiExecProcNode(PlanState *node)
 	if (node->chgParam != NULL) /* something changed */
 		ExecReScan(node);		/* let ReScan handle this */
 
+	if (node->temp_file_owner)
+		CurrentTempFileOwner = node->temp_file_owner;
+	if (profile_sample_interval > 0)
+	{
+		ProfilePlanNodeId = node->plan->plan_node_id;
+		ProfileNodeTag = (int) nodeTag(node);
+	}
+
 	switch (nodeTag(node))
 	{
 			/*
@@ -538,6 +673,10 @@ MultiExecProcNode(PlanState *node)
 			break;
 	}
 
+	CurrentTempFileOwner = save_owner;
+	ProfilePlanNodeId = save_plan_node_id;
+	ProfileNodeTag = save_node_tag;
+
 	return result;
 }
 
@@ -761,6 +900,9 @@ ExecEndNode(PlanState *node)
 			elog(ERROR, "unrecognized node type: %d", (int) nodeTag(node));
 			break;
 	}
+
+	if (node->temp_file_owner)
+		ReleaseTempFileOwner(node->temp_file_owner);
 }
 
 /*
@@ -924,6 +1066,9 @@ ExecSetTupleBound(int64 tuples_needed, PlanState *child_node)
 		MergeAppendState *maState = (MergeAppendState *) child_node;
 		int			i;
 
+		/* The MergeAppend also uses the bound to prune its Sort children */
+		maState->ms_bound = tuples_needed;
+
 		for (i = 0; i < maState->ms_nplans; i++)
 			ExecSetTupleBound(tuples_needed, maState->mergeplans[i]);
 	}
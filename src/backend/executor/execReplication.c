@@ -503,6 +503,67 @@ ExecSimpleRelationInsert(ResultRelInfo *resultRelInfo,
 	}
 }
 
+/*
+ * Insert the tuples represented in the slots to the relation at once with
+ * table_multi_insert(), update the indexes, and execute any constraints and
+ * AFTER ROW triggers, like ExecSimpleRelationInsert() does for a single tuple.
+ *
+ * The relation must not have BEFORE ROW INSERT triggers.
+ *
+ * Caller is responsible for opening the indexes.
+ */
+void
+ExecSimpleRelationMultiInsert(ResultRelInfo *resultRelInfo, EState *estate,
+							  TupleTableSlot **slots, int nslots)
+{
+	Relation	rel = resultRelInfo->ri_RelationDesc;
+	int			i;
+
+	/* For now we support only tables. */
+	Assert(rel->rd_rel->relkind == RELKIND_RELATION);
+	Assert(resultRelInfo->ri_TrigDesc == NULL ||
+		   !resultRelInfo->ri_TrigDesc->trig_insert_before_row);
+
+	CheckCmdReplicaIdentity(rel, CMD_INSERT);
+
+	for (i = 0; i < nslots; i++)
+	{
+		/* Compute stored generated columns */
+		if (rel->rd_att->constr &&
+			rel->rd_att->constr->has_generated_stored)
+			ExecComputeStoredGenerated(resultRelInfo, estate, slots[i],
+									   CMD_INSERT);
+
+		/* Check the constraints of the tuple */
+		if (rel->rd_att->constr)
+			ExecConstraints(resultRelInfo, slots[i], estate);
+		if (rel->rd_rel->relispartition)
+			ExecPartitionCheck(resultRelInfo, slots[i], estate, true);
+
+		ResetPerTupleExprContext(estate);
+	}
+
+	/* OK, store the tuples and create index entries for them */
+	table_multi_insert(rel, slots, nslots, GetCurrentCommandId(true), 0, NULL);
+
+	for (i = 0; i < nslots; i++)
+	{
+		List	   *recheckIndexes = NIL;
+
+		if (resultRelInfo->ri_NumIndices > 0)
+			recheckIndexes = ExecInsertIndexTuples(resultRelInfo,
+												   slots[i], estate, false,
+												   false, NULL, NIL, false);
+
+		/* AFTER ROW INSERT Triggers */
+		ExecARInsertTriggers(estate, resultRelInfo, slots[i],
+							 recheckIndexes, NULL);
+
+		list_free(recheckIndexes);
+		ResetPerTupleExprContext(estate);
+	}
+}
+
 /*
  * Find the searchslot tuple and update it with data in the slot,
  * update the indexes, and execute any constraints and per-row triggers.
@@ -19,6 +19,7 @@
 #include "postgres.h"
 
 #include "executor/executor.h"
+#include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
 #include "utils/memutils.h"
 
@@ -172,10 +173,11 @@ ExecScan(ScanState *node,
 	/* interrupt checks are in ExecScanFetch */
 
 	/*
-	 * If we have neither a qual to check nor a projection to do, just skip
-	 * all the overhead and return the raw scan tuple.
+	 * If we have neither a qual to check nor a projection to do, nor a
+	 * runtime filter to apply, just skip all the overhead and return the raw
+	 * scan tuple.
 	 */
-	if (!qual && !projInfo)
+	if (!qual && !projInfo && !node->ss_runtimefilter)
 	{
 		ResetExprContext(econtext);
 		return ExecScanFetch(node, accessMtd, recheckMtd);
@@ -225,6 +227,8 @@ ExecScan(ScanState *node,
 		 */
 		if (qual == NULL || ExecQual(qual, econtext))
 		{
+			TupleTableSlot *result;
+
 			/*
 			 * Found a satisfactory scan tuple.
 			 */
@@ -234,15 +238,26 @@ ExecScan(ScanState *node,
 				 * Form a projection tuple, store it in the result tuple slot
 				 * and return it.
 				 */
-				return ExecProject(projInfo);
+				result = ExecProject(projInfo);
 			}
 			else
 			{
 				/*
 				 * Here, we aren't projecting, so just return scan tuple.
 				 */
-				return slot;
+				result = slot;
 			}
+
+			/*
+			 * If the hash join above us knows that the tuple can't have a
+			 * join partner, skip it right here.
+			 */
+			if (node->ss_runtimefilter == NULL ||
+				!ExecHashJoinRuntimeFilterLacks(node->ss_runtimefilter,
+												result, econtext))
+				return result;
+
+			InstrCountFiltered1(node, 1);
 		}
 		else
 			InstrCountFiltered1(node, 1);
@@ -63,6 +63,7 @@
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "nodes/nodeFuncs.h"
+#include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
 #include "utils/builtins.h"
 #include "utils/expandeddatum.h"
@@ -908,6 +909,69 @@ tts_buffer_heap_store_tuple(TupleTableSlot *slot, HeapTuple tuple,
 	}
 }
 
+/*
+ * slot_init_attoffs
+ *		Compute the offsets of the leading fixed-width attributes of the
+ *		slot's descriptor, valid for tuples without nulls among them.
+ *
+ * These are the same as the attcacheoff values, but are known before the
+ * first tuple is deformed, so the deforming needn't compute nor check them.
+ */
+static void
+slot_init_attoffs(TupleTableSlot *slot)
+{
+	TupleDesc	tupleDesc = slot->tts_tupleDescriptor;
+	uint32		off = 0;
+	int			nfixed;
+	int			attnum;
+
+	for (nfixed = 0; nfixed < tupleDesc->natts; nfixed++)
+	{
+		if (TupleDescAttr(tupleDesc, nfixed)->attlen <= 0)
+			break;
+	}
+
+	slot->tts_attoffs = NULL;
+	if (nfixed > 0)
+		slot->tts_attoffs = (uint32 *)
+			MemoryContextAlloc(slot->tts_mcxt, nfixed * sizeof(uint32));
+
+	for (attnum = 0; attnum < nfixed; attnum++)
+	{
+		Form_pg_attribute thisatt = TupleDescAttr(tupleDesc, attnum);
+
+		off = att_align_nominal(off, thisatt->attalign);
+		slot->tts_attoffs[attnum] = off;
+		off += thisatt->attlen;
+	}
+
+	slot->tts_nfixed = nfixed;
+}
+
+/*
+ * heap_first_null
+ *		Return the first attribute from attnum on that is null according to
+ *		the null bitmap bp, or natts if there's none before natts.
+ *
+ * This looks at a byte of the bitmap at a time, so runs of non-null
+ * attributes are skipped without testing every bit.
+ */
+static inline int
+heap_first_null(bits8 *bp, int attnum, int natts)
+{
+	while (attnum < natts)
+	{
+		uint32		nulls = ((~bp[attnum >> 3]) & 0xFF) >> (attnum & 7);
+
+		if (nulls != 0)
+			return Min(attnum + pg_rightmost_one_pos32(nulls), natts);
+
+		attnum = (attnum | 7) + 1;
+	}
+
+	return natts;
+}
+
 /*
  * slot_deform_heap_tuple
  *		Given a TupleTableSlot, extract data from the slot's physical tuple
@@ -919,6 +983,12 @@ tts_buffer_heap_store_tuple(TupleTableSlot *slot, HeapTuple tuple,
  *		re-computing information about previously extracted attributes.
  *		slot->tts_nvalid is the number of attributes already extracted.
  *
+ *		The leading fixed-width attributes not preceded by a null are
+ *		fetched from the offsets in slot->tts_attoffs, without any per
+ *		attribute alignment or null checks.  For the rest, the position of
+ *		the next null is found from the null bitmap, so only the nulls
+ *		themselves need special treatment.
+ *
  * This is marked as always inline, so the different offp for different types
  * of slots gets optimized away.
  */
@@ -932,6 +1002,7 @@ slot_deform_heap_tuple(TupleTableSlot *slot, HeapTuple tuple, uint32 *offp,
 	HeapTupleHeader tup = tuple->t_data;
 	bool		hasnulls = HeapTupleHasNulls(tuple);
 	int			attnum;
+	int			nextnull;		/* next null attribute, or natts */
 	char	   *tp;				/* ptr to tuple data */
 	uint32		off;			/* offset in tuple data */
 	bits8	   *bp = tup->t_bits;	/* ptr to null bitmap in tuple */
@@ -960,15 +1031,43 @@ slot_deform_heap_tuple(TupleTableSlot *slot, HeapTuple tuple, uint32 *offp,
 
 	tp = (char *) tup + tup->t_hoff;
 
+	nextnull = hasnulls ? heap_first_null(bp, attnum, natts) : natts;
+
+	/*
+	 * If no null or variable-width attribute precedes, fetch the fixed-width
+	 * attributes up to the next null straight from their known offsets.
+	 */
+	if (!slow)
+	{
+		int			nfast;
+
+		if (slot->tts_nfixed < 0)
+			slot_init_attoffs(slot);
+
+		nfast = Min(nextnull, slot->tts_nfixed);
+		if (attnum < nfast)
+		{
+			for (; attnum < nfast; attnum++)
+			{
+				values[attnum] = fetchatt(TupleDescAttr(tupleDesc, attnum),
+										  tp + slot->tts_attoffs[attnum]);
+				isnull[attnum] = false;
+			}
+			off = slot->tts_attoffs[attnum - 1] +
+				TupleDescAttr(tupleDesc, attnum - 1)->attlen;
+		}
+	}
+
 	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt = TupleDescAttr(tupleDesc, attnum);
 
-		if (hasnulls && att_isnull(attnum, bp))
+		if (attnum == nextnull)
 		{
 			values[attnum] = (Datum) 0;
 			isnull[attnum] = true;
 			slow = true;		/* can't use attcacheoff anymore */
+			nextnull = heap_first_null(bp, attnum + 1, natts);
 			continue;
 		}
 
@@ -1140,6 +1239,7 @@ MakeTupleTableSlot(TupleDesc tupleDesc,
 	slot->tts_tupleDescriptor = tupleDesc;
 	slot->tts_mcxt = CurrentMemoryContext;
 	slot->tts_nvalid = 0;
+	slot->tts_nfixed = -1;
 
 	if (tupleDesc != NULL)
 	{
@@ -1217,6 +1317,8 @@ ExecResetTupleTable(List *tupleTable,	/* tuple table */
 				if (slot->tts_isnull)
 					pfree(slot->tts_isnull);
 			}
+			if (slot->tts_attoffs)
+				pfree(slot->tts_attoffs);
 			pfree(slot);
 		}
 	}
@@ -1267,6 +1369,8 @@ ExecDropSingleTupleTableSlot(TupleTableSlot *slot)
 		if (slot->tts_isnull)
 			pfree(slot->tts_isnull);
 	}
+	if (slot->tts_attoffs)
+		pfree(slot->tts_attoffs);
 	pfree(slot);
 }
 
@@ -1306,6 +1410,10 @@ ExecSetSlotDescriptor(TupleTableSlot *slot, /* slot to change */
 		pfree(slot->tts_values);
 	if (slot->tts_isnull)
 		pfree(slot->tts_isnull);
+	if (slot->tts_attoffs)
+		pfree(slot->tts_attoffs);
+	slot->tts_attoffs = NULL;
+	slot->tts_nfixed = -1;
 
 	/*
 	 * Install the new descriptor; if it's refcounted, bump its refcount.
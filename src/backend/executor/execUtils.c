@@ -150,6 +150,7 @@ CreateExecutorState(void)
 
 	estate->es_top_eflags = 0;
 	estate->es_instrument = 0;
+	estate->es_instrument_sample = 0;
 	estate->es_finished = false;
 
 	estate->es_exprcontexts = NIL;
@@ -807,15 +808,15 @@ ExecGetRangeTableRelation(EState *estate, Index rti)
 		if (!IsParallelWorker())
 		{
 			/*
-			 * In a normal query, we should already have the appropriate lock,
-			 * but verify that through an Assert.  Since there's already an
-			 * Assert inside table_open that insists on holding some lock, it
-			 * seems sufficient to check this only when rellockmode is higher
-			 * than the minimum.
+			 * In a normal query, we should already have the appropriate lock.
+			 * But when a cached plan is reused, AcquireExecutorLocks() leaves
+			 * partitions unlocked that initial pruning is expected to
+			 * eliminate; if we do need one of those after all, lock it now.
 			 */
-			rel = table_open(rte->relid, NoLock);
-			Assert(rte->rellockmode == AccessShareLock ||
-				   CheckRelationLockedByMe(rel, rte->rellockmode, false));
+			if (CheckRelationOidLockedByMe(rte->relid, rte->rellockmode, true))
+				rel = table_open(rte->relid, NoLock);
+			else
+				rel = table_open(rte->relid, rte->rellockmode);
 		}
 		else
 		{
@@ -63,13 +63,33 @@ InstrInit(Instrumentation *instr, int instrument_options)
 	instr->need_timer = (instrument_options & INSTRUMENT_TIMER) != 0;
 }
 
-/* Entry to a plan node */
+/*
+ * Entry to a plan node
+ *
+ * With sample_every > 1, the first call of each cycle is timed, so that the
+ * startup time is exact, but only 1 in sample_every of the subsequent calls
+ * are.  InstrEndLoop() extrapolates the runtime of the others from those.
+ * Row counts and buffer and WAL usage are always exact.
+ */
 void
 InstrStartNode(Instrumentation *instr)
 {
-	if (instr->need_timer &&
-		!INSTR_TIME_SET_CURRENT_LAZY(instr->starttime))
-		elog(ERROR, "InstrStartNode called twice in a row");
+	if (instr->need_timer)
+	{
+		bool		timed = true;
+
+		if (instr->sample_every > 1 && instr->running)
+		{
+			instr->sample_calls += 1;
+			if (--instr->sample_countdown >= 0)
+				timed = false;
+			else
+				instr->sample_countdown = instr->sample_every - 1;
+		}
+
+		if (timed && !INSTR_TIME_SET_CURRENT_LAZY(instr->starttime))
+			elog(ERROR, "InstrStartNode called twice in a row");
+	}
 
 	/* save buffer usage totals at node entry, if needed */
 	if (instr->need_bufusage)
@@ -92,13 +112,25 @@ InstrStopNode(Instrumentation *instr, double nTuples)
 	/* let's update the time only if the timer was requested */
 	if (instr->need_timer)
 	{
-		if (INSTR_TIME_IS_ZERO(instr->starttime))
-			elog(ERROR, "InstrStopNode called without start");
-
-		INSTR_TIME_SET_CURRENT(endtime);
-		INSTR_TIME_ACCUM_DIFF(instr->counter, endtime, instr->starttime);
+		bool		sampled = instr->sample_every > 1 && instr->running;
 
-		INSTR_TIME_SET_ZERO(instr->starttime);
+		if (!INSTR_TIME_IS_ZERO(instr->starttime))
+		{
+			INSTR_TIME_SET_CURRENT(endtime);
+			if (sampled)
+			{
+				INSTR_TIME_ACCUM_DIFF(instr->sample_counter, endtime,
+									  instr->starttime);
+				instr->sample_timed += 1;
+			}
+			else
+				INSTR_TIME_ACCUM_DIFF(instr->counter, endtime,
+									  instr->starttime);
+
+			INSTR_TIME_SET_ZERO(instr->starttime);
+		}
+		else if (!sampled)
+			elog(ERROR, "InstrStopNode called without start");
 	}
 
 	/* Add delta of buffer usage since entry to node's totals */
@@ -151,6 +183,18 @@ InstrEndLoop(Instrumentation *instr)
 	/* Accumulate per-cycle statistics into totals */
 	totaltime = INSTR_TIME_GET_DOUBLE(instr->counter);
 
+	/*
+	 * Extrapolate the runtime of the calls that were not timed from the mean
+	 * of those that were in all cycles so far.  The first of such calls ever
+	 * is timed, so there's always one unless there were no such calls.
+	 */
+	if (instr->sample_calls > 0)
+	{
+		instr->sample_total += INSTR_TIME_GET_DOUBLE(instr->sample_counter);
+		totaltime += instr->sample_calls *
+			(instr->sample_total / instr->sample_timed);
+	}
+
 	instr->startup += instr->firsttuple;
 	instr->total += totaltime;
 	instr->ntuples += instr->tuplecount;
@@ -160,6 +204,8 @@ InstrEndLoop(Instrumentation *instr)
 	instr->running = false;
 	INSTR_TIME_SET_ZERO(instr->starttime);
 	INSTR_TIME_SET_ZERO(instr->counter);
+	INSTR_TIME_SET_ZERO(instr->sample_counter);
+	instr->sample_calls = 0;
 	instr->firsttuple = 0;
 	instr->tuplecount = 0;
 }
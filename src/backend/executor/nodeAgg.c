@@ -226,6 +226,21 @@
  *	  imposing a limit on the number of groups separately from the amount of
  *	  memory consumed.
  *
+ *	  Parallel Hash Aggregation
+ *
+ *	  A parallel-aware AGG_HASHED node aggregates the whole of a partial
+ *	  input plan without needing partial aggregation and combine functions.
+ *	  Every participant first reads its share of the input and writes each
+ *	  tuple to one of a number of SharedTuplestore partitions, chosen from the
+ *	  hash of its grouping key, so all the rows of a group land in the same
+ *	  partition.  Once everyone has finished (the partition barrier), the
+ *	  participants claim whole partitions one at a time, aggregate each one
+ *	  with the ordinary hash table code (including spilling, should a
+ *	  partition still not fit in hash_mem) and emit the finished groups.
+ *	  Each group is therefore finalized by exactly one participant.  The
+ *	  number of partitions is chosen so that a partition is expected to fit
+ *	  in hash_mem, with a few per participant to balance the work.
+ *
  *    Transition / Combine function invocation:
  *
  *    For performance reasons transition functions, including combine
@@ -248,6 +263,8 @@
 
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/htup_details.h"
 #include "access/parallel.h"
 #include "catalog/objectaccess.h"
@@ -255,6 +272,7 @@
 #include "catalog/pg_proc.h"
 #include "catalog/pg_type.h"
 #include "common/hashfn.h"
+#include "executor/execBatch.h"
 #include "executor/execExpr.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -265,14 +283,18 @@
 #include "optimizer/optimizer.h"
 #include "parser/parse_agg.h"
 #include "parser/parse_coerce.h"
+#include "pgstat.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
 #include "utils/dynahash.h"
 #include "utils/expandeddatum.h"
+#include "port/atomics.h"
+#include "storage/barrier.h"
 #include "utils/logtape.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/sharedtuplestore.h"
 #include "utils/syscache.h"
 #include "utils/tuplesort.h"
 
@@ -357,6 +379,52 @@ typedef struct HashAggBatch
 	double		input_card;		/* estimated group cardinality */
 } HashAggBatch;
 
+/*
+ * Phases of the barrier used by Parallel HashAgg.  Participants that attach
+ * while the barrier is still in PHA_PARTITION help to partition the input;
+ * afterwards they only claim partitions to aggregate.
+ */
+#define PHA_PARTITION			0
+#define PHA_AGGREGATE			1
+
+/* upper limit on the number of Parallel HashAgg partitions */
+#define PHA_MAX_PARTITIONS		256
+
+/*
+ * Shared state for Parallel HashAgg, in the DSM chunk registered under the
+ * node's plan_node_id.  It is followed by one SharedTuplestore for each
+ * partition, each sts_size bytes, and then, if instrumenting, by the
+ * SharedAggInfo at instrument_offset.
+ */
+typedef struct ParallelHashAggState
+{
+	int			nparticipants;	/* workers + leader */
+	int			npartitions;	/* number of SharedTuplestore partitions */
+	Size		sts_size;		/* MAXALIGN'd size of each SharedTuplestore */
+	Size		instrument_offset;	/* offset of SharedAggInfo, or 0 */
+	double		partition_groups;	/* estimated groups per partition */
+	pg_atomic_uint32 next_partition;	/* next partition to be claimed */
+	Barrier		barrier;		/* PHA_PARTITION -> PHA_AGGREGATE */
+	SharedFileSet fileset;		/* space for the partition files */
+} ParallelHashAggState;
+
+#define PHA_PARTITION_STS(pstate, i) \
+	((SharedTuplestore *) ((char *) (pstate) + \
+						   MAXALIGN(sizeof(ParallelHashAggState)) + \
+						   (i) * (pstate)->sts_size))
+
+/*
+ * Backend-local state for Parallel HashAgg.
+ */
+typedef struct HashAggParallelData
+{
+	ParallelHashAggState *pstate;
+	SharedTuplestoreAccessor **partitions;	/* one accessor per partition */
+	bool		partitioned;	/* finished with the partition phase? */
+	bool		reading;		/* reading curpartition as input? */
+	int			curpartition;	/* partition being aggregated */
+} HashAggParallelData;
+
 /* used to find referenced colnos */
 typedef struct FindColsContext
 {
@@ -421,6 +489,12 @@ static void agg_fill_hash_table(AggState *aggstate);
 static bool agg_refill_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_hash_table_in_memory(AggState *aggstate);
+static TupleTableSlot *agg_retrieve_parallel_hash_table(AggState *aggstate);
+static void hashagg_parallel_partition(AggState *aggstate);
+static bool hashagg_parallel_next_partition(AggState *aggstate);
+static int	hashagg_parallel_num_partitions(AggState *aggstate,
+											int nparticipants);
+static Size hashagg_parallel_size(int nparticipants, int npartitions);
 static void hash_agg_check_limits(AggState *aggstate);
 static void hash_agg_enter_spill_mode(AggState *aggstate);
 static void hash_agg_update_metrics(AggState *aggstate, bool from_tape,
@@ -537,9 +611,10 @@ initialize_phase(AggState *aggstate, int newphase)
 }
 
 /*
- * Fetch a tuple from either the outer plan (for phase 1) or from the sorter
- * populated by the previous phase.  Copy it to the sorter for the next phase
- * if any.
+ * Fetch a tuple from either the outer plan (for phase 1), from the sorter
+ * populated by the previous phase, or, in Parallel HashAgg, from the shared
+ * partition being aggregated.  Copy it to the sorter for the next phase if
+ * any.
  *
  * Callers cannot rely on memory for tuple in returned slot remaining valid
  * past any subsequently fetched tuple.
@@ -549,7 +624,23 @@ fetch_input_tuple(AggState *aggstate)
 {
 	TupleTableSlot *slot;
 
-	if (aggstate->sort_in)
+	if (aggstate->hash_parallel && aggstate->hash_parallel->reading)
+	{
+		HashAggParallelData *hp = aggstate->hash_parallel;
+		SharedTuplestoreAccessor *accessor = hp->partitions[hp->curpartition];
+		MinimalTuple tuple;
+
+		CHECK_FOR_INTERRUPTS();
+		tuple = sts_parallel_scan_next(accessor, NULL);
+		if (tuple == NULL)
+		{
+			sts_end_parallel_scan(accessor);
+			hp->reading = false;
+			return NULL;
+		}
+		slot = ExecStoreMinimalTuple(tuple, aggstate->hash_spill_rslot, false);
+	}
+	else if (aggstate->sort_in)
 	{
 		/* make sure we check for interrupts in either path through here */
 		CHECK_FOR_INTERRUPTS();
@@ -558,6 +649,9 @@ fetch_input_tuple(AggState *aggstate)
 			return NULL;
 		slot = aggstate->sort_slot;
 	}
+	else if (aggstate->input_batch)
+		slot = ExecProcNodeViaBatch(outerPlanState(aggstate),
+									aggstate->input_batch);
 	else
 		slot = ExecProcNode(outerPlanState(aggstate));
 
@@ -2169,6 +2263,11 @@ ExecAgg(PlanState *pstate)
 		switch (node->phase->aggstrategy)
 		{
 			case AGG_HASHED:
+				if (node->hash_parallel)
+				{
+					result = agg_retrieve_parallel_hash_table(node);
+					break;
+				}
 				if (!node->table_filled)
 					agg_fill_hash_table(node);
 				/* FALLTHROUGH */
@@ -2764,6 +2863,144 @@ agg_retrieve_hash_table(AggState *aggstate)
 	return result;
 }
 
+/*
+ * ExecAgg for Parallel HashAgg.
+ *
+ * Help to partition the input, then aggregate and return the groups of one
+ * claimed partition after another, until no unclaimed partitions remain.
+ */
+static TupleTableSlot *
+agg_retrieve_parallel_hash_table(AggState *aggstate)
+{
+	HashAggParallelData *hp = aggstate->hash_parallel;
+	TupleTableSlot *result;
+
+	if (!hp->partitioned)
+	{
+		hashagg_parallel_partition(aggstate);
+		if (!hashagg_parallel_next_partition(aggstate))
+		{
+			aggstate->agg_done = true;
+			return NULL;
+		}
+	}
+
+	for (;;)
+	{
+		if (!aggstate->table_filled)
+			agg_fill_hash_table(aggstate);
+
+		result = agg_retrieve_hash_table(aggstate);
+		if (!TupIsNull(result))
+			return result;
+
+		/* this partition is done, move on to the next one */
+		if (!hashagg_parallel_next_partition(aggstate))
+			break;
+	}
+
+	aggstate->agg_done = true;
+	return NULL;
+}
+
+/*
+ * Parallel HashAgg partition phase: if the input hasn't been partitioned
+ * yet, write our share of it to the shared partitions and wait for the
+ * other participants to do the same.
+ */
+static void
+hashagg_parallel_partition(AggState *aggstate)
+{
+	HashAggParallelData *hp = aggstate->hash_parallel;
+	ParallelHashAggState *pstate = hp->pstate;
+
+	if (BarrierAttach(&pstate->barrier) == PHA_PARTITION)
+	{
+		AggStatePerHash perhash = &aggstate->perhash[0];
+		TupleTableSlot *outerslot;
+		int			i;
+
+		for (;;)
+		{
+			MinimalTuple tuple;
+			bool		shouldFree;
+			uint32		hash;
+			int			partno;
+
+			outerslot = fetch_input_tuple(aggstate);
+			if (TupIsNull(outerslot))
+				break;
+
+			prepare_hash_slot(perhash, outerslot, perhash->hashslot);
+			hash = TupleHashTableHash(perhash->hashtable, perhash->hashslot);
+
+			/*
+			 * Remix the hash so that the partition number doesn't correlate
+			 * with the bits the hash table and spill code use.
+			 */
+			partno = murmurhash32(hash) % pstate->npartitions;
+
+			tuple = ExecFetchSlotMinimalTuple(outerslot, &shouldFree);
+			sts_puttuple(hp->partitions[partno], NULL, tuple);
+			if (shouldFree)
+				heap_free_minimal_tuple(tuple);
+
+			ResetExprContext(aggstate->tmpcontext);
+		}
+
+		for (i = 0; i < pstate->npartitions; i++)
+			sts_end_write(hp->partitions[i]);
+
+		BarrierArriveAndWait(&pstate->barrier, WAIT_EVENT_HASH_AGG_PARTITION);
+	}
+
+	Assert(BarrierPhase(&pstate->barrier) == PHA_AGGREGATE);
+	hp->partitioned = true;
+}
+
+/*
+ * Claim the next unaggregated Parallel HashAgg partition and get ready to
+ * aggregate it into an empty hash table.  Returns false, after detaching
+ * from the barrier, if all partitions have been claimed.
+ */
+static bool
+hashagg_parallel_next_partition(AggState *aggstate)
+{
+	HashAggParallelData *hp = aggstate->hash_parallel;
+	ParallelHashAggState *pstate = hp->pstate;
+	uint32		partno;
+
+	Assert(!hp->reading);
+
+	partno = pg_atomic_fetch_add_u32(&pstate->next_partition, 1);
+	if (partno >= pstate->npartitions)
+	{
+		BarrierDetach(&pstate->barrier);
+		return false;
+	}
+
+	/* reset the hash table as ExecReScanAgg does */
+	hashagg_reset_spill_state(aggstate);
+	aggstate->hash_spill_mode = false;
+	ReScanExprContext(aggstate->hashcontext);
+	hash_agg_set_limits(aggstate->hashentrysize, pstate->partition_groups, 0,
+						&aggstate->hash_mem_limit,
+						&aggstate->hash_ngroups_limit,
+						&aggstate->hash_planned_partitions);
+	build_hash_tables(aggstate);
+	aggstate->table_filled = false;
+	aggstate->agg_done = false;
+
+	/* the partition's tuples are read back as minimal tuples */
+	hashagg_recompile_expressions(aggstate, true, false);
+
+	hp->curpartition = partno;
+	sts_begin_parallel_scan(hp->partitions[partno]);
+	hp->reading = true;
+
+	return true;
+}
+
 /*
  * Retrieve the groups from the in-memory hash tables without considering any
  * spilled tuples.
@@ -3305,6 +3542,9 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 	outerPlan = outerPlan(node);
 	outerPlanState(aggstate) = ExecInitNode(outerPlan, estate, eflags);
 
+	/* read the input in batches, if the outer plan can produce them */
+	aggstate->input_batch = ExecInitBatch(outerPlanState(aggstate));
+
 	/*
 	 * initialize source tuple type.
 	 */
@@ -4383,7 +4623,17 @@ ExecReScanAgg(AggState *node)
 
 	node->agg_done = false;
 
-	if (node->aggstrategy == AGG_HASHED)
+	/*
+	 * For Parallel HashAgg, ExecAggReInitializeDSM has reset the shared
+	 * state; start over from the partition phase.
+	 */
+	if (node->hash_parallel)
+	{
+		node->hash_parallel->partitioned = false;
+		node->hash_parallel->reading = false;
+	}
+
+	if (node->aggstrategy == AGG_HASHED && node->hash_parallel == NULL)
 	{
 		/*
 		 * In the hashed case, if we haven't yet built the hash table then we
@@ -4491,6 +4741,9 @@ ExecReScanAgg(AggState *node)
 		node->projected_set = -1;
 	}
 
+	if (node->input_batch)
+		ExecResetBatch(node->input_batch);
+
 	if (outerPlan->chgParam == NULL)
 		ExecReScan(outerPlan);
 }
@@ -4687,20 +4940,35 @@ AggRegisterCallback(FunctionCallInfo fcinfo,
  /* ----------------------------------------------------------------
   *		ExecAggEstimate
   *
-  *		Estimate space required to propagate aggregate statistics.
+  *		Estimate space required to propagate aggregate statistics, and
+  *		for the shared state of Parallel HashAgg.
   * ----------------------------------------------------------------
   */
 void
 ExecAggEstimate(AggState *node, ParallelContext *pcxt)
 {
-	Size		size;
+	Size		size = 0;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		int			nparticipants = pcxt->nworkers + 1;
+
+		size = hashagg_parallel_size(nparticipants,
+									 hashagg_parallel_num_partitions(node,
+																	 nparticipants));
+	}
+
+	/* don't need instrumentation if not instrumenting or no workers */
+	if (node->ss.ps.instrument && pcxt->nworkers > 0)
+	{
+		size = add_size(size, offsetof(SharedAggInfo, sinstrument));
+		size = add_size(size, mul_size(pcxt->nworkers,
+									   sizeof(AggregateInstrumentation)));
+	}
+
+	if (size == 0)
 		return;
 
-	size = mul_size(pcxt->nworkers, sizeof(AggregateInstrumentation));
-	size = add_size(size, offsetof(SharedAggInfo, sinstrument));
 	shm_toc_estimate_chunk(&pcxt->estimator, size);
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 }
@@ -4708,39 +4976,188 @@ ExecAggEstimate(AggState *node, ParallelContext *pcxt)
 /* ----------------------------------------------------------------
  *		ExecAggInitializeDSM
  *
- *		Initialize DSM space for aggregate statistics.
+ *		Initialize DSM space for aggregate statistics and for Parallel
+ *		HashAgg.
  * ----------------------------------------------------------------
  */
 void
 ExecAggInitializeDSM(AggState *node, ParallelContext *pcxt)
 {
-	Size		size;
+	ParallelHashAggState *pstate = NULL;
+	Size		size = 0;
+	Size		instrument_size = 0;
+	int			nparticipants = pcxt->nworkers + 1;
+	int			npartitions = 0;
+	char	   *chunk;
+
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		npartitions = hashagg_parallel_num_partitions(node, nparticipants);
+		size = hashagg_parallel_size(nparticipants, npartitions);
+	}
+
+	/* don't need instrumentation if not instrumenting or no workers */
+	if (node->ss.ps.instrument && pcxt->nworkers > 0)
+		instrument_size = offsetof(SharedAggInfo, sinstrument)
+			+ pcxt->nworkers * sizeof(AggregateInstrumentation);
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	if (size + instrument_size == 0)
 		return;
 
-	size = offsetof(SharedAggInfo, sinstrument)
-		+ pcxt->nworkers * sizeof(AggregateInstrumentation);
-	node->shared_info = shm_toc_allocate(pcxt->toc, size);
-	/* ensure any unfilled slots will contain zeroes */
-	memset(node->shared_info, 0, size);
-	node->shared_info->num_workers = pcxt->nworkers;
-	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id,
-				   node->shared_info);
+	chunk = shm_toc_allocate(pcxt->toc, size + instrument_size);
+
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		HashAggParallelData *hp;
+		int			i;
+
+		pstate = (ParallelHashAggState *) chunk;
+		pstate->nparticipants = nparticipants;
+		pstate->npartitions = npartitions;
+		pstate->sts_size = MAXALIGN(sts_estimate(nparticipants));
+		pstate->instrument_offset = instrument_size > 0 ? size : 0;
+		pstate->partition_groups =
+			Max((double) node->perhash[0].aggnode->numGroups *
+				nparticipants / npartitions, 1.0);
+		pg_atomic_init_u32(&pstate->next_partition, 0);
+		BarrierInit(&pstate->barrier, PHA_PARTITION);
+		SharedFileSetInit(&pstate->fileset, pcxt->seg);
+
+		hp = palloc0(sizeof(HashAggParallelData));
+		hp->pstate = pstate;
+		hp->partitions = palloc(sizeof(SharedTuplestoreAccessor *) * npartitions);
+		for (i = 0; i < npartitions; i++)
+		{
+			char		name[MAXPGPATH];
+
+			snprintf(name, MAXPGPATH, "hashagg%d", i);
+			/* the leader is participant 0 */
+			hp->partitions[i] = sts_initialize(PHA_PARTITION_STS(pstate, i),
+											   nparticipants, 0, 0,
+											   SHARED_TUPLESTORE_SINGLE_PASS,
+											   &pstate->fileset, name);
+		}
+		node->hash_parallel = hp;
+	}
+
+	if (instrument_size > 0)
+	{
+		node->shared_info = (SharedAggInfo *) (chunk + size);
+		/* ensure any unfilled slots will contain zeroes */
+		memset(node->shared_info, 0, instrument_size);
+		node->shared_info->num_workers = pcxt->nworkers;
+	}
+
+	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, chunk);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecAggReInitializeDSM
+ *
+ *		Reset the shared state of Parallel HashAgg before a rescan.
+ * ----------------------------------------------------------------
+ */
+void
+ExecAggReInitializeDSM(AggState *node, ParallelContext *pcxt)
+{
+	HashAggParallelData *hp = node->hash_parallel;
+	ParallelHashAggState *pstate;
+	int			i;
+
+	if (hp == NULL)
+		return;
+	pstate = hp->pstate;
+
+	/* Clear any partition files left behind by the previous scan. */
+	SharedFileSetDeleteAll(&pstate->fileset);
+
+	for (i = 0; i < pstate->npartitions; i++)
+	{
+		char		name[MAXPGPATH];
+
+		snprintf(name, MAXPGPATH, "hashagg%d", i);
+		hp->partitions[i] = sts_initialize(PHA_PARTITION_STS(pstate, i),
+										   pstate->nparticipants, 0, 0,
+										   SHARED_TUPLESTORE_SINGLE_PASS,
+										   &pstate->fileset, name);
+	}
+	pg_atomic_write_u32(&pstate->next_partition, 0);
+	BarrierInit(&pstate->barrier, PHA_PARTITION);
 }
 
 /* ----------------------------------------------------------------
  *		ExecAggInitializeWorker
  *
- *		Attach worker to DSM space for aggregate statistics.
+ *		Attach worker to DSM space for aggregate statistics and for
+ *		Parallel HashAgg.
  * ----------------------------------------------------------------
  */
 void
 ExecAggInitializeWorker(AggState *node, ParallelWorkerContext *pwcxt)
 {
-	node->shared_info =
-		shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	char	   *chunk;
+
+	chunk = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	if (chunk == NULL)
+		return;
+
+	if (node->ss.ps.plan->parallel_aware)
+	{
+		ParallelHashAggState *pstate = (ParallelHashAggState *) chunk;
+		HashAggParallelData *hp;
+		int			i;
+
+		SharedFileSetAttach(&pstate->fileset, pwcxt->seg);
+
+		hp = palloc0(sizeof(HashAggParallelData));
+		hp->pstate = pstate;
+		hp->partitions = palloc(sizeof(SharedTuplestoreAccessor *) *
+								pstate->npartitions);
+		for (i = 0; i < pstate->npartitions; i++)
+			hp->partitions[i] = sts_attach(PHA_PARTITION_STS(pstate, i),
+										   ParallelWorkerNumber + 1,
+										   &pstate->fileset);
+		node->hash_parallel = hp;
+
+		if (pstate->instrument_offset > 0)
+			node->shared_info =
+				(SharedAggInfo *) (chunk + pstate->instrument_offset);
+	}
+	else
+		node->shared_info = (SharedAggInfo *) chunk;
+}
+
+/*
+ * Choose the number of Parallel HashAgg partitions: enough for each to be
+ * expected to fit in hash_mem, and a few per participant so that the work
+ * balances out even when group sizes vary.
+ */
+static int
+hashagg_parallel_num_partitions(AggState *aggstate, int nparticipants)
+{
+	double		total_groups;
+	double		dpartitions;
+
+	/* the plan's estimate is per participant */
+	total_groups = (double) aggstate->perhash[0].aggnode->numGroups *
+		nparticipants;
+	dpartitions = ceil(total_groups * aggstate->hashentrysize /
+					   get_hash_memory_limit());
+	dpartitions = Max(dpartitions, nparticipants * 4);
+	dpartitions = Min(dpartitions, PHA_MAX_PARTITIONS);
+
+	return (int) dpartitions;
+}
+
+/*
+ * Size of the Parallel HashAgg shared state, including the partitions.
+ */
+static Size
+hashagg_parallel_size(int nparticipants, int npartitions)
+{
+	return add_size(MAXALIGN(sizeof(ParallelHashAggState)),
+					mul_size(npartitions,
+							 MAXALIGN(sts_estimate(nparticipants))));
 }
 
 /* ----------------------------------------------------------------
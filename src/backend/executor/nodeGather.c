@@ -22,6 +22,12 @@
  * return the results.  Therefore, a plan used with a single-copy Gather
  * node need not be parallel-aware.
  *
+ * Finally, CREATE TABLE AS can ask a Gather node at the top of its plan to
+ * insert into the new relation itself.  The workers then insert what they
+ * produce directly, each with its own bulk-insert state, instead of sending
+ * it through their tuple queues to be inserted by the leader alone; and the
+ * node inserts whatever it produces locally, and returns no tuples.
+ *
  * IDENTIFICATION
  *	  src/backend/executor/nodeGather.c
  *
@@ -32,6 +38,7 @@
 
 #include "access/relscan.h"
 #include "access/xact.h"
+#include "commands/createas.h"
 #include "executor/execdebug.h"
 #include "executor/execParallel.h"
 #include "executor/nodeGather.h"
@@ -40,11 +47,13 @@
 #include "miscadmin.h"
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
+#include "portability/instr_time.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 
 
 static TupleTableSlot *ExecGather(PlanState *pstate);
+static TupleTableSlot *ExecGatherInsert(GatherState *node);
 static TupleTableSlot *gather_getnext(GatherState *gatherstate);
 static MinimalTuple gather_readnext(GatherState *gatherstate);
 static void ExecShutdownGatherWorkers(GatherState *node);
@@ -172,7 +181,10 @@ ExecGather(PlanState *pstate)
 												 estate,
 												 gather->initParam,
 												 gather->num_workers,
-												 node->tuples_needed);
+												 node->tuples_needed,
+												 node->insert_dest ?
+												 IntoRelGetRelid(node->insert_dest) :
+												 InvalidOid);
 			else
 				ExecParallelReinitialize(outerPlanState(node),
 										 node->pei,
@@ -213,6 +225,9 @@ ExecGather(PlanState *pstate)
 		node->initialized = true;
 	}
 
+	if (node->insert_dest != NULL)
+		return ExecGatherInsert(node);
+
 	/*
 	 * Reset per-tuple memory context to free any expression evaluation
 	 * storage allocated in the previous tuple cycle.
@@ -239,6 +254,48 @@ ExecGather(PlanState *pstate)
 	return ExecProject(node->ps.ps_ProjInfo);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecGatherInsert
+ *
+ *		Inserts the tuples produced locally into insert_dest while the
+ *		workers insert theirs, and waits for the workers to finish.  The
+ *		tuples inserted in all are counted in es_processed, as if we had
+ *		returned them, but we return none.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecGatherInsert(GatherState *node)
+{
+	DestReceiver *dest = node->insert_dest;
+	uint64		ntuples = 0;
+	TupleTableSlot *slot;
+
+	for (;;)
+	{
+		ResetExprContext(node->ps.ps_ExprContext);
+
+		/* workers send us nothing, so this only waits for them once done */
+		slot = gather_getnext(node);
+		if (TupIsNull(slot))
+			break;
+
+		if (!dest->receiveSlot(slot, dest))
+			break;
+		ntuples++;
+	}
+
+	ExecShutdownGatherWorkers(node);
+	if (node->pei != NULL)
+		ntuples += node->pei->tuples_inserted;
+
+	node->ps.state->es_processed += ntuples;
+
+	/* if we're called again, there is nothing more to return */
+	node->insert_dest = NULL;
+
+	return NULL;
+}
+
 /* ----------------------------------------------------------------
  *		ExecEndGather
  *
@@ -312,6 +369,8 @@ static MinimalTuple
 gather_readnext(GatherState *gatherstate)
 {
 	int			nvisited = 0;
+	bool		polling = false;
+	instr_time	poll_start;
 
 	for (;;)
 	{
@@ -382,7 +441,34 @@ gather_readnext(GatherState *gatherstate)
 			if (gatherstate->need_to_scan_locally)
 				return NULL;
 
+			/*
+			 * Workers running on other CPUs are likely to send more tuples
+			 * within microseconds, so keep polling the queues for a little
+			 * while before paying for a sleep and a wakeup.
+			 */
+			if (!polling)
+			{
+				INSTR_TIME_SET_CURRENT(poll_start);
+				polling = true;
+			}
+			else
+			{
+				instr_time	now;
+
+				INSTR_TIME_SET_CURRENT(now);
+				INSTR_TIME_SUBTRACT(now, poll_start);
+				if (INSTR_TIME_GET_MICROSEC(now) >= SHM_MQ_BUSY_POLL_USEC)
+					polling = false;
+			}
+			if (polling)
+			{
+				pg_spin_delay();
+				nvisited = 0;
+				continue;
+			}
+
 			/* Nothing to do except wait for developments. */
+			gatherstate->queue_empty_stalls++;
 			(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, 0,
 							 WAIT_EVENT_EXECUTE_GATHER);
 			ResetLatch(MyLatch);
@@ -423,6 +509,10 @@ ExecShutdownGather(GatherState *node)
 	/* Now destroy the parallel context. */
 	if (node->pei != NULL)
 	{
+		/* Keep the tuple queue waits for EXPLAIN ANALYZE */
+		node->queue_full_stalls += node->pei->tqueue_send_stalls;
+		node->queue_empty_stalls += node->pei->tqueue_receive_stalls;
+
 		ExecParallelCleanup(node->pei);
 		node->pei = NULL;
 	}
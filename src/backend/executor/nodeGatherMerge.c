@@ -216,7 +216,8 @@ ExecGatherMerge(PlanState *pstate)
 												 estate,
 												 gm->initParam,
 												 gm->num_workers,
-												 node->tuples_needed);
+												 node->tuples_needed,
+												 InvalidOid);
 			else
 				ExecParallelReinitialize(outerPlanState(node),
 										 node->pei,
@@ -309,6 +310,10 @@ ExecShutdownGatherMerge(GatherMergeState *node)
 	/* Now destroy the parallel context. */
 	if (node->pei != NULL)
 	{
+		/* Keep the tuple queue waits for EXPLAIN ANALYZE */
+		node->queue_full_stalls += node->pei->tqueue_send_stalls;
+		node->queue_empty_stalls += node->pei->tqueue_receive_stalls;
+
 		ExecParallelCleanup(node->pei);
 		node->pei = NULL;
 	}
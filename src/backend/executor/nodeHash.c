@@ -26,10 +26,12 @@
 #include <math.h>
 #include <limits.h>
 
+#include "access/hash.h"
 #include "access/htup_details.h"
 #include "access/parallel.h"
 #include "catalog/pg_statistic.h"
 #include "commands/tablespace.h"
+#include "executor/execBatch.h"
 #include "executor/execdebug.h"
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
@@ -66,7 +68,9 @@ static inline HashJoinTuple ExecParallelHashFirstTuple(HashJoinTable hashtable,
 													   int bucketno);
 static inline HashJoinTuple ExecParallelHashNextTuple(HashJoinTable hashtable,
 													  HashJoinTuple tuple);
-static inline void ExecParallelHashPushTuple(dsa_pointer_atomic *head,
+static inline void ExecHashPushTuple(HashJoinBucketData *bucket,
+									 HashJoinTuple tuple);
+static inline void ExecParallelHashPushTuple(ParallelHashJoinBucket *bucket,
 											 HashJoinTuple tuple,
 											 dsa_pointer tuple_shared);
 static void ExecParallelHashJoinSetUpBatches(HashJoinTable hashtable, int nbatch);
@@ -163,7 +167,10 @@ MultiExecPrivateHash(HashState *node)
 	 */
 	for (;;)
 	{
-		slot = ExecProcNode(outerNode);
+		if (node->hs_batch)
+			slot = ExecProcNodeViaBatch(outerNode, node->hs_batch);
+		else
+			slot = ExecProcNode(outerNode);
 		if (TupIsNull(slot))
 			break;
 		/* We have to compute the hash value */
@@ -174,6 +181,11 @@ MultiExecPrivateHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			if (hashtable->bloom_build)
+				bloom_add_element(hashtable->bloom_build,
+								  (unsigned char *) &hashvalue,
+								  sizeof(hashvalue));
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -196,11 +208,14 @@ MultiExecPrivateHash(HashState *node)
 		ExecHashIncreaseNumBuckets(hashtable);
 
 	/* Account for the buckets in spaceUsed (reported in EXPLAIN ANALYZE) */
-	hashtable->spaceUsed += hashtable->nbuckets * sizeof(HashJoinTuple);
+	hashtable->spaceUsed += hashtable->nbuckets * sizeof(HashJoinBucketData);
 	if (hashtable->spaceUsed > hashtable->spacePeak)
 		hashtable->spacePeak = hashtable->spaceUsed;
 
 	hashtable->partialTuples = hashtable->totalTuples;
+
+	/* The bloom filter is complete, so let the runtime filter use it. */
+	hashtable->bloom = hashtable->bloom_build;
 }
 
 /* ----------------------------------------------------------------
@@ -280,14 +295,23 @@ MultiExecParallelHash(HashState *node)
 			ExecParallelHashTableSetCurrentBatch(hashtable, 0);
 			for (;;)
 			{
-				slot = ExecProcNode(outerNode);
+				if (node->hs_batch)
+					slot = ExecProcNodeViaBatch(outerNode, node->hs_batch);
+				else
+					slot = ExecProcNode(outerNode);
 				if (TupIsNull(slot))
 					break;
 				econtext->ecxt_outertuple = slot;
 				if (ExecHashGetHashValue(hashtable, econtext, hashkeys,
 										 false, hashtable->keepNulls,
 										 &hashvalue))
+				{
+					if (hashtable->bloom_build)
+						bloom_add_element(hashtable->bloom_build,
+										  (unsigned char *) &hashvalue,
+										  sizeof(hashvalue));
 					ExecParallelHashTableInsert(hashtable, slot, hashvalue);
+				}
 				hashtable->partialTuples++;
 			}
 
@@ -304,6 +328,15 @@ MultiExecParallelHash(HashState *node)
 			 */
 			ExecParallelHashMergeCounters(hashtable);
 
+			/* Add our part of the bloom filter to the shared one. */
+			if (hashtable->bloom_build && DsaPointerIsValid(pstate->bloom))
+			{
+				LWLockAcquire(&pstate->lock, LW_EXCLUSIVE);
+				bloom_union(dsa_get_address(hashtable->area, pstate->bloom),
+							hashtable->bloom_build);
+				LWLockRelease(&pstate->lock);
+			}
+
 			BarrierDetach(&pstate->grow_buckets_barrier);
 			BarrierDetach(&pstate->grow_batches_barrier);
 
@@ -339,8 +372,17 @@ MultiExecParallelHash(HashState *node)
 	 * sure we have accessors.
 	 */
 	if (BarrierPhase(build_barrier) < PHJ_BUILD_FREE)
+	{
 		ExecParallelHashEnsureBatchAccessors(hashtable);
 
+		/*
+		 * Everyone has merged their part of the bloom filter by now, and it
+		 * can't be freed while we're still attached to build_barrier.
+		 */
+		if (hashtable->bloom_build && DsaPointerIsValid(pstate->bloom))
+			hashtable->bloom = dsa_get_address(hashtable->area, pstate->bloom);
+	}
+
 	/*
 	 * The next synchronization point is in ExecHashJoin's HJ_BUILD_HASHTABLE
 	 * case, which will bring the build phase to PHJ_BUILD_RUN (if it isn't
@@ -387,6 +429,9 @@ ExecInitHash(Hash *node, EState *estate, int eflags)
 	 */
 	outerPlanState(hashstate) = ExecInitNode(outerPlan(node), estate, eflags);
 
+	/* read the input in batches, if the outer plan can produce them */
+	hashstate->hs_batch = ExecInitBatch(outerPlanState(hashstate));
+
 	/*
 	 * initialize our result slot and type. No need to build projection
 	 * because this node doesn't do projections.
@@ -504,6 +549,8 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	hashtable->nbatch_original = nbatch;
 	hashtable->nbatch_outstart = nbatch;
 	hashtable->growEnabled = true;
+	hashtable->curstripe = 0;
+	hashtable->moreStripes = false;
 	hashtable->totalTuples = 0;
 	hashtable->partialTuples = 0;
 	hashtable->skewTuples = 0;
@@ -553,6 +600,8 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	nkeys = list_length(hashOperators);
 	hashtable->outer_hashfunctions = palloc_array(FmgrInfo, nkeys);
 	hashtable->inner_hashfunctions = palloc_array(FmgrInfo, nkeys);
+	hashtable->outer_hashdirect = palloc_array(DatumHashFunction, nkeys);
+	hashtable->inner_hashdirect = palloc_array(DatumHashFunction, nkeys);
 	hashtable->hashStrict = palloc_array(bool, nkeys);
 	hashtable->collations = palloc_array(Oid, nkeys);
 	i = 0;
@@ -569,9 +618,26 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 		fmgr_info(right_hashfn, &hashtable->inner_hashfunctions[i]);
 		hashtable->hashStrict[i] = op_strict(hashop);
 		hashtable->collations[i] = lfirst_oid(hc);
+		/* use the builtin hash functions directly, where possible */
+		hashtable->outer_hashdirect[i] =
+			hash_direct_function(left_hashfn, hashtable->collations[i]);
+		hashtable->inner_hashdirect[i] =
+			hash_direct_function(right_hashfn, hashtable->collations[i]);
 		i++;
 	}
 
+	/*
+	 * Set up the bloom filter for the runtime filter of our hash join, if it
+	 * has one.  Its size must only depend on the plan, as in Parallel Hash
+	 * all participants' filters are merged bit by bit.
+	 */
+	hashtable->bloom = NULL;
+	hashtable->bloom_build = NULL;
+	if (state->hs_want_bloom)
+		hashtable->bloom_build = bloom_create((int64) Min(Max(rows, 1.0),
+														  (double) PG_INT32_MAX),
+											  work_mem, 0);
+
 	if (nbatch > 1 && hashtable->parallel_state == NULL)
 	{
 		MemoryContext oldctx;
@@ -633,6 +699,16 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 			 */
 			pstate->nbuckets = nbuckets;
 			ExecParallelHashTableAlloc(hashtable, 0);
+
+			/* Allocate the shared bloom filter, copying our empty one. */
+			if (hashtable->bloom_build)
+			{
+				Size		size = bloom_size(hashtable->bloom_build);
+
+				pstate->bloom = dsa_allocate(hashtable->area, size);
+				memcpy(dsa_get_address(hashtable->area, pstate->bloom),
+					   hashtable->bloom_build, size);
+			}
 		}
 
 		/*
@@ -650,7 +726,7 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 		 */
 		MemoryContextSwitchTo(hashtable->batchCxt);
 
-		hashtable->buckets.unshared = palloc0_array(HashJoinTuple, nbuckets);
+		hashtable->buckets.unshared = palloc0_array(HashJoinBucketData, nbuckets);
 
 		/*
 		 * Set up for skew optimization, if possible and there's a need for
@@ -793,8 +869,8 @@ ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 	 * Note that both nbuckets and nbatch must be powers of 2 to make
 	 * ExecHashGetBucketAndBatch fast.
 	 */
-	max_pointers = hash_table_bytes / sizeof(HashJoinTuple);
-	max_pointers = Min(max_pointers, MaxAllocSize / sizeof(HashJoinTuple));
+	max_pointers = hash_table_bytes / sizeof(HashJoinBucketData);
+	max_pointers = Min(max_pointers, MaxAllocSize / sizeof(HashJoinBucketData));
 	/* If max_pointers isn't a power of 2, must round it down to one */
 	max_pointers = pg_prevpower2_size_t(max_pointers);
 
@@ -814,7 +890,7 @@ ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 	 * If there's not enough space to store the projected number of tuples and
 	 * the required bucket headers, we will need multiple batches.
 	 */
-	bucket_bytes = sizeof(HashJoinTuple) * nbuckets;
+	bucket_bytes = sizeof(HashJoinBucketData) * nbuckets;
 	if (inner_rel_bytes + bucket_bytes > hash_table_bytes)
 	{
 		/* We'll need multiple batches */
@@ -844,7 +920,7 @@ ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 		 * NTUP_PER_BUCKET tuples, whose projected size already includes
 		 * overhead for the hash code, pointer to the next tuple, etc.
 		 */
-		bucket_size = (tupsize * NTUP_PER_BUCKET + sizeof(HashJoinTuple));
+		bucket_size = (tupsize * NTUP_PER_BUCKET + sizeof(HashJoinBucketData));
 		if (hash_table_bytes <= bucket_size)
 			sbuckets = 1;		/* avoid pg_nextpower2_size_t(0) */
 		else
@@ -852,7 +928,7 @@ ExecChooseHashTableSize(double ntuples, int tupwidth, bool useskew,
 		sbuckets = Min(sbuckets, max_pointers);
 		nbuckets = (int) sbuckets;
 		nbuckets = pg_nextpower2_32(nbuckets);
-		bucket_bytes = nbuckets * sizeof(HashJoinTuple);
+		bucket_bytes = nbuckets * sizeof(HashJoinBucketData);
 
 		/*
 		 * Buckets are simple pointers to hashjoin tuples, while tupsize
@@ -983,7 +1059,7 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 
 		hashtable->buckets.unshared =
 			repalloc_array(hashtable->buckets.unshared,
-						   HashJoinTuple, hashtable->nbuckets);
+						   HashJoinBucketData, hashtable->nbuckets);
 	}
 
 	/*
@@ -992,7 +1068,7 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 	 * already been processed. We will free the old chunks as we go.
 	 */
 	memset(hashtable->buckets.unshared, 0,
-		   sizeof(HashJoinTuple) * hashtable->nbuckets);
+		   sizeof(HashJoinBucketData) * hashtable->nbuckets);
 	oldchunks = hashtable->chunks;
 	hashtable->chunks = NULL;
 
@@ -1026,8 +1102,7 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 				memcpy(copyTuple, hashTuple, hashTupleSize);
 
 				/* and add it back to the appropriate bucket */
-				copyTuple->next.unshared = hashtable->buckets.unshared[bucketno];
-				hashtable->buckets.unshared[bucketno] = copyTuple;
+				ExecHashPushTuple(&hashtable->buckets.unshared[bucketno], copyTuple);
 			}
 			else
 			{
@@ -1064,8 +1139,9 @@ ExecHashIncreaseNumBatches(HashJoinTable hashtable)
 	 * further expansion of nbatch.  This situation implies that we have
 	 * enough tuples of identical hashvalues to overflow spaceAllowed.
 	 * Increasing nbatch will not fix it since there's no way to subdivide the
-	 * group any more finely. We have to just gut it out and hope the server
-	 * has enough RAM.
+	 * group any more finely.  This only concerns the current batch, so growth
+	 * is enabled again for the next one; and ExecHashJoinNewBatch may load
+	 * the rest of this batch in several stripes, if the join type allows.
 	 */
 	if (nfreed == 0 || nfreed == ninmemory)
 	{
@@ -1107,7 +1183,7 @@ ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable)
 			if (BarrierArriveAndWait(&pstate->grow_batches_barrier,
 									 WAIT_EVENT_HASH_GROW_BATCHES_ELECT))
 			{
-				dsa_pointer_atomic *buckets;
+				ParallelHashJoinBucket *buckets;
 				ParallelHashJoinBatch *old_batch0;
 				int			new_nbatch;
 				int			i;
@@ -1174,29 +1250,37 @@ ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable)
 					dtuples = (old_batch0->ntuples * 2.0) / new_nbatch;
 					dbuckets = ceil(dtuples / NTUP_PER_BUCKET);
 					dbuckets = Min(dbuckets,
-								   MaxAllocSize / sizeof(dsa_pointer_atomic));
+								   MaxAllocSize / sizeof(ParallelHashJoinBucket));
 					new_nbuckets = (int) dbuckets;
 					new_nbuckets = Max(new_nbuckets, 1024);
 					new_nbuckets = pg_nextpower2_32(new_nbuckets);
 					dsa_free(hashtable->area, old_batch0->buckets);
 					hashtable->batches[0].shared->buckets =
 						dsa_allocate(hashtable->area,
-									 sizeof(dsa_pointer_atomic) * new_nbuckets);
-					buckets = (dsa_pointer_atomic *)
+									 sizeof(ParallelHashJoinBucket) * new_nbuckets);
+					buckets = (ParallelHashJoinBucket *)
 						dsa_get_address(hashtable->area,
 										hashtable->batches[0].shared->buckets);
 					for (i = 0; i < new_nbuckets; ++i)
-						dsa_pointer_atomic_init(&buckets[i], InvalidDsaPointer);
+					{
+						dsa_pointer_atomic_init(&buckets[i].tuples,
+												InvalidDsaPointer);
+						pg_atomic_init_u32(&buckets[i].tags, 0);
+					}
 					pstate->nbuckets = new_nbuckets;
 				}
 				else
 				{
 					/* Recycle the existing bucket array. */
 					hashtable->batches[0].shared->buckets = old_batch0->buckets;
-					buckets = (dsa_pointer_atomic *)
+					buckets = (ParallelHashJoinBucket *)
 						dsa_get_address(hashtable->area, old_batch0->buckets);
 					for (i = 0; i < hashtable->nbuckets; ++i)
-						dsa_pointer_atomic_write(&buckets[i], InvalidDsaPointer);
+					{
+						dsa_pointer_atomic_write(&buckets[i].tuples,
+												 InvalidDsaPointer);
+						pg_atomic_write_u32(&buckets[i].tags, 0);
+					}
 				}
 
 				/* Move all chunks to the work queue for parallel processing. */
@@ -1242,7 +1326,6 @@ ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable)
 									 WAIT_EVENT_HASH_GROW_BATCHES_DECIDE))
 			{
 				bool		space_exhausted = false;
-				bool		extreme_skew_detected = false;
 
 				/* Make sure that we have the current dimensions and buckets. */
 				ExecParallelHashEnsureBatchAccessors(hashtable);
@@ -1258,22 +1341,24 @@ ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable)
 					{
 						int			parent;
 
-						space_exhausted = true;
-
 						/*
 						 * Did this batch receive ALL of the tuples from its
 						 * parent batch?  That would indicate that further
 						 * repartitioning isn't going to help (the hash values
-						 * are probably all the same).
+						 * are probably all the same).  Mark it as hot, so
+						 * that it no longer asks for more batches; but the
+						 * other batches may still grow.
 						 */
 						parent = i % pstate->old_nbatch;
 						if (batch->ntuples == hashtable->batches[parent].shared->old_ntuples)
-							extreme_skew_detected = true;
+							batch->hot = true;
+						else
+							space_exhausted = true;
 					}
 				}
 
 				/* Don't keep growing if it's not helping or we'd overflow. */
-				if (extreme_skew_detected || hashtable->nbatch >= INT_MAX / 2)
+				if (hashtable->nbatch >= INT_MAX / 2)
 					pstate->growth = PHJ_GROWTH_DISABLED;
 				else if (space_exhausted)
 					pstate->growth = PHJ_GROWTH_NEED_MORE_BATCHES;
@@ -1484,10 +1569,10 @@ ExecHashIncreaseNumBuckets(HashJoinTable hashtable)
 	 */
 	hashtable->buckets.unshared =
 		repalloc_array(hashtable->buckets.unshared,
-					   HashJoinTuple, hashtable->nbuckets);
+					   HashJoinBucketData, hashtable->nbuckets);
 
 	memset(hashtable->buckets.unshared, 0,
-		   hashtable->nbuckets * sizeof(HashJoinTuple));
+		   hashtable->nbuckets * sizeof(HashJoinBucketData));
 
 	/* scan through all tuples in all chunks to rebuild the hash table */
 	for (chunk = hashtable->chunks; chunk != NULL; chunk = chunk->next.unshared)
@@ -1505,8 +1590,7 @@ ExecHashIncreaseNumBuckets(HashJoinTable hashtable)
 									  &bucketno, &batchno);
 
 			/* add the tuple to the proper bucket */
-			hashTuple->next.unshared = hashtable->buckets.unshared[bucketno];
-			hashtable->buckets.unshared[bucketno] = hashTuple;
+			ExecHashPushTuple(&hashtable->buckets.unshared[bucketno], hashTuple);
 
 			/* advance index past the tuple */
 			idx += MAXALIGN(HJTUPLE_OVERHEAD +
@@ -1541,20 +1625,24 @@ ExecParallelHashIncreaseNumBuckets(HashJoinTable hashtable)
 									 WAIT_EVENT_HASH_GROW_BUCKETS_ELECT))
 			{
 				size_t		size;
-				dsa_pointer_atomic *buckets;
+				ParallelHashJoinBucket *buckets;
 
 				/* Double the size of the bucket array. */
 				pstate->nbuckets *= 2;
-				size = pstate->nbuckets * sizeof(dsa_pointer_atomic);
+				size = pstate->nbuckets * sizeof(ParallelHashJoinBucket);
 				hashtable->batches[0].shared->size += size / 2;
 				dsa_free(hashtable->area, hashtable->batches[0].shared->buckets);
 				hashtable->batches[0].shared->buckets =
 					dsa_allocate(hashtable->area, size);
-				buckets = (dsa_pointer_atomic *)
+				buckets = (ParallelHashJoinBucket *)
 					dsa_get_address(hashtable->area,
 									hashtable->batches[0].shared->buckets);
 				for (i = 0; i < pstate->nbuckets; ++i)
-					dsa_pointer_atomic_init(&buckets[i], InvalidDsaPointer);
+				{
+					dsa_pointer_atomic_init(&buckets[i].tuples,
+											InvalidDsaPointer);
+					pg_atomic_init_u32(&buckets[i].tags, 0);
+				}
 
 				/* Put the chunk list onto the work queue. */
 				pstate->chunk_work_queue = hashtable->batches[0].shared->chunks;
@@ -1658,8 +1746,7 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(hashTuple));
 
 		/* Push it onto the front of the bucket's list */
-		hashTuple->next.unshared = hashtable->buckets.unshared[bucketno];
-		hashtable->buckets.unshared[bucketno] = hashTuple;
+		ExecHashPushTuple(&hashtable->buckets.unshared[bucketno], hashTuple);
 
 		/*
 		 * Increase the (optimal) number of buckets if we just exceeded the
@@ -1671,7 +1758,7 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		{
 			/* Guard against integer overflow and alloc size overflow */
 			if (hashtable->nbuckets_optimal <= INT_MAX / 2 &&
-				hashtable->nbuckets_optimal * 2 <= MaxAllocSize / sizeof(HashJoinTuple))
+				hashtable->nbuckets_optimal * 2 <= MaxAllocSize / sizeof(HashJoinBucketData))
 			{
 				hashtable->nbuckets_optimal *= 2;
 				hashtable->log2_nbuckets_optimal += 1;
@@ -1683,7 +1770,7 @@ ExecHashTableInsert(HashJoinTable hashtable,
 		if (hashtable->spaceUsed > hashtable->spacePeak)
 			hashtable->spacePeak = hashtable->spaceUsed;
 		if (hashtable->spaceUsed +
-			hashtable->nbuckets_optimal * sizeof(HashJoinTuple)
+			hashtable->nbuckets_optimal * sizeof(HashJoinBucketData)
 			> hashtable->spaceAllowed)
 			ExecHashIncreaseNumBatches(hashtable);
 	}
@@ -1827,6 +1914,7 @@ ExecHashGetHashValue(HashJoinTable hashtable,
 {
 	uint32		hashkey = 0;
 	FmgrInfo   *hashfunctions;
+	DatumHashFunction *hashdirect;
 	ListCell   *hk;
 	int			i = 0;
 	MemoryContext oldContext;
@@ -1840,9 +1928,15 @@ ExecHashGetHashValue(HashJoinTable hashtable,
 	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
 
 	if (outer_tuple)
+	{
 		hashfunctions = hashtable->outer_hashfunctions;
+		hashdirect = hashtable->outer_hashdirect;
+	}
 	else
+	{
 		hashfunctions = hashtable->inner_hashfunctions;
+		hashdirect = hashtable->inner_hashdirect;
+	}
 
 	foreach(hk, hashkeys)
 	{
@@ -1885,7 +1979,10 @@ ExecHashGetHashValue(HashJoinTable hashtable,
 			/* Compute the hash function */
 			uint32		hkey;
 
-			hkey = DatumGetUInt32(FunctionCall1Coll(&hashfunctions[i], hashtable->collations[i], keyval));
+			if (hashdirect[i])
+				hkey = hashdirect[i] (keyval);
+			else
+				hkey = DatumGetUInt32(FunctionCall1Coll(&hashfunctions[i], hashtable->collations[i], keyval));
 			hashkey ^= hkey;
 		}
 
@@ -1978,7 +2075,15 @@ ExecScanHashBucket(HashJoinState *hjstate,
 	else if (hjstate->hj_CurSkewBucketNo != INVALID_SKEW_BUCKET_NO)
 		hashTuple = hashtable->skewBucket[hjstate->hj_CurSkewBucketNo]->tuples;
 	else
-		hashTuple = hashtable->buckets.unshared[hjstate->hj_CurBucketNo];
+	{
+		HashJoinBucketData *bucket =
+			&hashtable->buckets.unshared[hjstate->hj_CurBucketNo];
+
+		/* skip the chain if the tag shows our hash value isn't in it */
+		if ((bucket->tags & HJ_HASH_TAG(hashvalue)) == 0)
+			return false;
+		hashTuple = bucket->tuples;
+	}
 
 	while (hashTuple != NULL)
 	{
@@ -2034,8 +2139,16 @@ ExecParallelScanHashBucket(HashJoinState *hjstate,
 	if (hashTuple != NULL)
 		hashTuple = ExecParallelHashNextTuple(hashtable, hashTuple);
 	else
+	{
+		ParallelHashJoinBucket *bucket =
+			&hashtable->buckets.shared[hjstate->hj_CurBucketNo];
+
+		/* skip the chain if the tag shows our hash value isn't in it */
+		if ((pg_atomic_read_u32(&bucket->tags) & HJ_HASH_TAG(hashvalue)) == 0)
+			return false;
 		hashTuple = ExecParallelHashFirstTuple(hashtable,
 											   hjstate->hj_CurBucketNo);
+	}
 
 	while (hashTuple != NULL)
 	{
@@ -2122,7 +2235,7 @@ ExecParallelPrepHashTableForUnmatched(HashJoinState *hjstate)
 		 */
 		hashtable->spacePeak =
 			Max(hashtable->spacePeak,
-				batch->size + sizeof(dsa_pointer_atomic) * hashtable->nbuckets);
+				batch->size + sizeof(ParallelHashJoinBucket) * hashtable->nbuckets);
 		hashtable->curbatch = -1;
 		return false;
 	}
@@ -2172,7 +2285,7 @@ ExecScanHashTableForUnmatched(HashJoinState *hjstate, ExprContext *econtext)
 			hashTuple = hashTuple->next.unshared;
 		else if (hjstate->hj_CurBucketNo < hashtable->nbuckets)
 		{
-			hashTuple = hashtable->buckets.unshared[hjstate->hj_CurBucketNo];
+			hashTuple = hashtable->buckets.unshared[hjstate->hj_CurBucketNo].tuples;
 			hjstate->hj_CurBucketNo++;
 		}
 		else if (hjstate->hj_CurSkewBucketNo < hashtable->nSkewBuckets)
@@ -2306,7 +2419,7 @@ ExecHashTableReset(HashJoinTable hashtable)
 	oldcxt = MemoryContextSwitchTo(hashtable->batchCxt);
 
 	/* Reallocate and reinitialize the hash bucket headers. */
-	hashtable->buckets.unshared = palloc0_array(HashJoinTuple, nbuckets);
+	hashtable->buckets.unshared = palloc0_array(HashJoinBucketData, nbuckets);
 
 	hashtable->spaceUsed = 0;
 
@@ -2329,7 +2442,7 @@ ExecHashTableResetMatchFlags(HashJoinTable hashtable)
 	/* Reset all flags in the main table ... */
 	for (i = 0; i < hashtable->nbuckets; i++)
 	{
-		for (tuple = hashtable->buckets.unshared[i]; tuple != NULL;
+		for (tuple = hashtable->buckets.unshared[i].tuples; tuple != NULL;
 			 tuple = tuple->next.unshared)
 			HeapTupleHeaderClearMatch(HJTUPLE_MINTUPLE(tuple));
 	}
@@ -2355,6 +2468,9 @@ ExecReScanHash(HashState *node)
 	 * if chgParam of subnode is not null then plan will be re-scanned by
 	 * first ExecProcNode.
 	 */
+	if (node->hs_batch)
+		ExecResetBatch(node->hs_batch);
+
 	if (outerPlan->chgParam == NULL)
 		ExecReScan(outerPlan);
 }
@@ -2666,8 +2782,7 @@ ExecHashRemoveNextSkewBucket(HashJoinTable hashtable)
 			memcpy(copyTuple, hashTuple, tupleSize);
 			pfree(hashTuple);
 
-			copyTuple->next.unshared = hashtable->buckets.unshared[bucketno];
-			hashtable->buckets.unshared[bucketno] = copyTuple;
+			ExecHashPushTuple(&hashtable->buckets.unshared[bucketno], copyTuple);
 
 			/* We have reduced skew space, but overall space doesn't change */
 			hashtable->spaceUsedSkew -= tupleSize;
@@ -3019,6 +3134,7 @@ ExecParallelHashTupleAlloc(HashJoinTable hashtable, size_t size,
 		 * each backend to allocate at least one chunk.
 		 */
 		if (hashtable->batches[0].at_least_one_chunk &&
+			!hashtable->batches[0].shared->hot &&
 			hashtable->batches[0].shared->size +
 			chunk_size > pstate->space_allowed)
 		{
@@ -3039,7 +3155,7 @@ ExecParallelHashTupleAlloc(HashJoinTable hashtable, size_t size,
 				hashtable->nbuckets * NTUP_PER_BUCKET &&
 				hashtable->nbuckets < (INT_MAX / 2) &&
 				hashtable->nbuckets * 2 <=
-				MaxAllocSize / sizeof(dsa_pointer_atomic))
+				MaxAllocSize / sizeof(ParallelHashJoinBucket))
 			{
 				pstate->growth = PHJ_GROWTH_NEED_MORE_BUCKETS;
 				LWLockRelease(&pstate->lock);
@@ -3259,16 +3375,19 @@ void
 ExecParallelHashTableAlloc(HashJoinTable hashtable, int batchno)
 {
 	ParallelHashJoinBatch *batch = hashtable->batches[batchno].shared;
-	dsa_pointer_atomic *buckets;
+	ParallelHashJoinBucket *buckets;
 	int			nbuckets = hashtable->parallel_state->nbuckets;
 	int			i;
 
 	batch->buckets =
-		dsa_allocate(hashtable->area, sizeof(dsa_pointer_atomic) * nbuckets);
-	buckets = (dsa_pointer_atomic *)
+		dsa_allocate(hashtable->area, sizeof(ParallelHashJoinBucket) * nbuckets);
+	buckets = (ParallelHashJoinBucket *)
 		dsa_get_address(hashtable->area, batch->buckets);
 	for (i = 0; i < nbuckets; ++i)
-		dsa_pointer_atomic_init(&buckets[i], InvalidDsaPointer);
+	{
+		dsa_pointer_atomic_init(&buckets[i].tuples, InvalidDsaPointer);
+		pg_atomic_init_u32(&buckets[i].tags, 0);
+	}
 }
 
 /*
@@ -3357,7 +3476,7 @@ ExecHashTableDetachBatch(HashJoinTable hashtable)
 		 */
 		hashtable->spacePeak =
 			Max(hashtable->spacePeak,
-				batch->size + sizeof(dsa_pointer_atomic) * hashtable->nbuckets);
+				batch->size + sizeof(ParallelHashJoinBucket) * hashtable->nbuckets);
 
 		/* Remember that we are not attached to a batch. */
 		hashtable->curbatch = -1;
@@ -3409,8 +3528,14 @@ ExecHashTableDetach(HashJoinTable hashtable)
 				dsa_free(hashtable->area, pstate->batches);
 				pstate->batches = InvalidDsaPointer;
 			}
+			if (DsaPointerIsValid(pstate->bloom))
+			{
+				dsa_free(hashtable->area, pstate->bloom);
+				pstate->bloom = InvalidDsaPointer;
+			}
 		}
 	}
+	hashtable->bloom = NULL;
 	hashtable->parallel_state = NULL;
 }
 
@@ -3424,7 +3549,7 @@ ExecParallelHashFirstTuple(HashJoinTable hashtable, int bucketno)
 	dsa_pointer p;
 
 	Assert(hashtable->parallel_state);
-	p = dsa_pointer_atomic_read(&hashtable->buckets.shared[bucketno]);
+	p = dsa_pointer_atomic_read(&hashtable->buckets.shared[bucketno].tuples);
 	tuple = (HashJoinTuple) dsa_get_address(hashtable->area, p);
 
 	return tuple;
@@ -3444,22 +3569,36 @@ ExecParallelHashNextTuple(HashJoinTable hashtable, HashJoinTuple tuple)
 	return next;
 }
 
+/*
+ * Insert a tuple at the front of a bucket's chain, and set its tag bit.
+ */
+static inline void
+ExecHashPushTuple(HashJoinBucketData *bucket, HashJoinTuple tuple)
+{
+	tuple->next.unshared = bucket->tuples;
+	bucket->tuples = tuple;
+	bucket->tags |= HJ_HASH_TAG(tuple->hashvalue);
+}
+
 /*
  * Insert a tuple at the front of a chain of tuples in DSA memory atomically.
+ * The tag bit only needs to be visible once the hash table is probed, which
+ * happens after a barrier.
  */
 static inline void
-ExecParallelHashPushTuple(dsa_pointer_atomic *head,
+ExecParallelHashPushTuple(ParallelHashJoinBucket *bucket,
 						  HashJoinTuple tuple,
 						  dsa_pointer tuple_shared)
 {
 	for (;;)
 	{
-		tuple->next.shared = dsa_pointer_atomic_read(head);
-		if (dsa_pointer_atomic_compare_exchange(head,
+		tuple->next.shared = dsa_pointer_atomic_read(&bucket->tuples);
+		if (dsa_pointer_atomic_compare_exchange(&bucket->tuples,
 												&tuple->next.shared,
 												tuple_shared))
 			break;
 	}
+	pg_atomic_fetch_or_u32(&bucket->tags, HJ_HASH_TAG(tuple->hashvalue));
 }
 
 /*
@@ -3471,7 +3610,7 @@ ExecParallelHashTableSetCurrentBatch(HashJoinTable hashtable, int batchno)
 	Assert(hashtable->batches[batchno].shared->buckets != InvalidDsaPointer);
 
 	hashtable->curbatch = batchno;
-	hashtable->buckets.shared = (dsa_pointer_atomic *)
+	hashtable->buckets.shared = (ParallelHashJoinBucket *)
 		dsa_get_address(hashtable->area,
 						hashtable->batches[batchno].shared->buckets);
 	hashtable->nbuckets = hashtable->parallel_state->nbuckets;
@@ -3557,6 +3696,7 @@ ExecParallelHashTuplePrealloc(HashJoinTable hashtable, int batchno, size_t size)
 
 	if (pstate->growth != PHJ_GROWTH_DISABLED &&
 		batch->at_least_one_chunk &&
+		!batch->shared->hot &&
 		(batch->shared->estimated_size + want + HASH_CHUNK_HEADER_SIZE
 		 > pstate->space_allowed))
 	{
@@ -164,6 +164,7 @@
 
 #include "access/htup_details.h"
 #include "access/parallel.h"
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/hashjoin.h"
 #include "executor/nodeHash.h"
@@ -189,6 +190,29 @@
 /* Returns true if doing null-fill on inner relation */
 #define HJ_FILL_INNER(hjstate)	((hjstate)->hj_NullOuterTupleSlot != NULL)
 
+/*
+ * Returns true if an inner batch may be joined in several stripes, each
+ * probed with the whole outer batch.  That works as long as each outer tuple
+ * may be emitted once per matching inner tuple, and unmatched inner tuples
+ * can be found stripe by stripe; but not if we have to know whether an outer
+ * tuple had a match in any stripe.
+ */
+#define HJ_CAN_STRIPE(hjstate) \
+	((hjstate)->js.jointype == JOIN_INNER || \
+	 (hjstate)->js.jointype == JOIN_RIGHT || \
+	 (hjstate)->js.jointype == JOIN_RIGHT_ANTI)
+
+/*
+ * A runtime filter that doesn't reject at least one of RUNTIME_FILTER_RATIO
+ * of the first RUNTIME_FILTER_MIN_TESTS tuples is not worth its hashing cost,
+ * and switches itself off.
+ */
+#define RUNTIME_FILTER_MIN_TESTS	4096
+#define RUNTIME_FILTER_RATIO		8
+
+/* GUC parameter */
+bool		hashjoin_runtime_filter = true;
+
 static TupleTableSlot *ExecHashJoinOuterGetTuple(PlanState *outerNode,
 												 HashJoinState *hjstate,
 												 uint32 *hashvalue);
@@ -200,8 +224,17 @@ static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
 												 uint32 *hashvalue,
 												 TupleTableSlot *tupleSlot);
 static bool ExecHashJoinNewBatch(HashJoinState *hjstate);
+static void ExecHashJoinLoadInnerBatch(HashJoinState *hjstate,
+									   BufFile *innerFile);
 static bool ExecParallelHashJoinNewBatch(HashJoinState *hjstate);
 static void ExecParallelHashJoinPartitionOuter(HashJoinState *hjstate);
+static bool ExecHashJoinPushDownFilter(PlanState *node, HashRuntimeFilter *rf);
+static TupleTableSlot *ExecHashJoinFetchOuter(PlanState *outerNode,
+											  HashJoinState *hjstate);
+static TupleTableSlot *ExecHashJoinOuterBatchGetTuple(PlanState *outerNode,
+													  HashJoinState *hjstate,
+													  uint32 *hashvalue);
+static void ExecHashJoinHashOuterBatch(HashJoinState *hjstate);
 
 
 /* ----------------------------------------------------------------
@@ -315,7 +348,8 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 						 (outerNode->plan->startup_cost < hashNode->ps.plan->total_cost &&
 						  !node->hj_OuterNotEmpty))
 				{
-					node->hj_FirstOuterTupleSlot = ExecProcNode(outerNode);
+					node->hj_FirstOuterTupleSlot =
+						ExecHashJoinFetchOuter(outerNode, node);
 					if (TupIsNull(node->hj_FirstOuterTupleSlot))
 					{
 						node->hj_OuterNotEmpty = false;
@@ -490,13 +524,16 @@ ExecHashJoinImpl(PlanState *pstate, bool parallel)
 
 					/*
 					 * Need to postpone this outer tuple to a later batch.
-					 * Save it in the corresponding outer-batch file.
+					 * Save it in the corresponding outer-batch file, unless
+					 * we already did that while probing an earlier stripe of
+					 * this batch.
 					 */
 					Assert(parallel_state == NULL);
 					Assert(batchno > hashtable->curbatch);
-					ExecHashJoinSaveTuple(mintuple, hashvalue,
-										  &hashtable->outerBatchFile[batchno],
-										  hashtable);
+					if (hashtable->curstripe == 0)
+						ExecHashJoinSaveTuple(mintuple, hashvalue,
+											  &hashtable->outerBatchFile[batchno],
+											  hashtable);
 
 					if (shouldFree)
 						heap_free_minimal_tuple(mintuple);
@@ -846,9 +883,287 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
 
+	/*
+	 * Read the outer plan in batches if it can produce them, so that we can
+	 * prefetch the hash buckets of many outer tuples at once.
+	 */
+	hjstate->hj_OuterBatch = ExecInitBatch(outerPlanState(hjstate));
+	if (hjstate->hj_OuterBatch)
+	{
+		int			maxrows = hjstate->hj_OuterBatch->maxrows;
+
+		hjstate->hj_OuterHashValues = palloc_array(uint32, maxrows);
+		hjstate->hj_OuterHashValid = palloc_array(bool, maxrows);
+	}
+	hjstate->hj_OuterBatchHashed = false;
+
+	/*
+	 * If outer tuples without a join partner are simply thrown away, let the
+	 * scans below us throw them away as soon as they're produced, using a
+	 * bloom filter of the inner side's hash values.
+	 */
+	hjstate->hj_RuntimeFilter = NULL;
+	if (hashjoin_runtime_filter &&
+		(node->join.jointype == JOIN_INNER ||
+		 node->join.jointype == JOIN_SEMI ||
+		 node->join.jointype == JOIN_RIGHT ||
+		 node->join.jointype == JOIN_RIGHT_ANTI))
+	{
+		HashRuntimeFilter *rf = palloc0_object(HashRuntimeFilter);
+
+		rf->hjstate = hjstate;
+		if (ExecHashJoinPushDownFilter(outerPlanState(hjstate), rf))
+		{
+			((HashState *) innerPlanState(hjstate))->hs_want_bloom = true;
+			hjstate->hj_RuntimeFilter = rf;
+		}
+		else
+			pfree(rf);
+	}
+
 	return hjstate;
 }
 
+/*
+ * ExecHashJoinPushDownFilter
+ *		Attach a runtime filter to the scans directly producing our outer
+ *		tuples, looking through Append nodes.  Returns true if there was
+ *		at least one.
+ */
+static bool
+ExecHashJoinPushDownFilter(PlanState *node, HashRuntimeFilter *rf)
+{
+	switch (nodeTag(node))
+	{
+		case T_SeqScanState:
+		case T_SampleScanState:
+		case T_IndexScanState:
+		case T_IndexOnlyScanState:
+		case T_BitmapHeapScanState:
+		case T_TidScanState:
+		case T_TidRangeScanState:
+			((ScanState *) node)->ss_runtimefilter = rf;
+			return true;
+
+		case T_AppendState:
+			{
+				AppendState *astate = (AppendState *) node;
+				bool		found = false;
+
+				for (int i = 0; i < astate->as_nplans; i++)
+					found |= ExecHashJoinPushDownFilter(astate->appendplans[i],
+														rf);
+				return found;
+			}
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Is the runtime filter to be used for the given hash table?
+ */
+static inline bool
+ExecHashJoinRuntimeFilterActive(HashRuntimeFilter *rf, HashJoinTable hashtable)
+{
+	if (rf->disabled || hashtable == NULL || hashtable->bloom == NULL)
+		return false;
+
+	/* Start counting afresh for each new hash table. */
+	if (rf->hashtable != hashtable)
+	{
+		rf->hashtable = hashtable;
+		rf->ntested = 0;
+		rf->nrejected = 0;
+	}
+
+	return true;
+}
+
+/*
+ * Count a test of the runtime filter, and disable it if it doesn't pay off.
+ * Returns 'lacks'.
+ */
+static inline bool
+ExecHashJoinRuntimeFilterCount(HashRuntimeFilter *rf, bool lacks)
+{
+	rf->ntested++;
+	if (lacks)
+		rf->nrejected++;
+	if (rf->ntested == RUNTIME_FILTER_MIN_TESTS &&
+		rf->nrejected < rf->ntested / RUNTIME_FILTER_RATIO)
+		rf->disabled = true;
+
+	return lacks;
+}
+
+/*
+ * ExecHashJoinRuntimeFilterLacks
+ *		Does the hash join's bloom filter prove that the outer tuple in
+ *		'slot' has no join partner?
+ *
+ * This is called by the scans the filter was pushed down to, with their own
+ * expression context.  Until the hash table has been built, or if the filter
+ * turned out not to reject enough tuples, we pass everything.
+ */
+bool
+ExecHashJoinRuntimeFilterLacks(HashRuntimeFilter *rf, TupleTableSlot *slot,
+							   ExprContext *econtext)
+{
+	HashJoinState *hjstate = rf->hjstate;
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	TupleTableSlot *save_outertuple;
+	uint32		hashvalue;
+	bool		lacks;
+
+	if (!ExecHashJoinRuntimeFilterActive(rf, hashtable))
+		return false;
+
+	save_outertuple = econtext->ecxt_outertuple;
+	econtext->ecxt_outertuple = slot;
+	if (!ExecHashGetHashValue(hashtable, econtext, hjstate->hj_OuterHashKeys,
+							  true, false, &hashvalue))
+		lacks = true;			/* NULL join key never matches */
+	else
+		lacks = bloom_lacks_element(hashtable->bloom,
+									(unsigned char *) &hashvalue,
+									sizeof(hashvalue));
+	econtext->ecxt_outertuple = save_outertuple;
+
+	return ExecHashJoinRuntimeFilterCount(rf, lacks);
+}
+
+/*
+ * ExecHashJoinFetchOuter
+ *		Fetch the next tuple from the outer plan, the same as ExecProcNode,
+ *		using our outer batch if we have one.
+ */
+static TupleTableSlot *
+ExecHashJoinFetchOuter(PlanState *outerNode, HashJoinState *hjstate)
+{
+	if (hjstate->hj_OuterBatch)
+		return ExecProcNodeViaBatch(outerNode, hjstate->hj_OuterBatch);
+	return ExecProcNode(outerNode);
+}
+
+/*
+ * ExecHashJoinOuterBatchGetTuple
+ *		Return the next outer tuple that may have a match, and its hash
+ *		value, reading the outer plan in batches.  NULL at the end of the
+ *		outer plan.
+ *
+ * The hash values of a whole batch are computed before we probe the hash
+ * table for any of its tuples, and the buckets they hash to are prefetched
+ * at the same time.  For a hash table much larger than the CPU caches, the
+ * cache misses of the probes then overlap instead of being taken one after
+ * another.
+ */
+static TupleTableSlot *
+ExecHashJoinOuterBatchGetTuple(PlanState *outerNode, HashJoinState *hjstate,
+							   uint32 *hashvalue)
+{
+	TupleBatch *batch = hjstate->hj_OuterBatch;
+
+	for (;;)
+	{
+		int			i;
+
+		if (batch->next >= batch->nselected)
+		{
+			if (ExecProcBatch(outerNode, batch) == 0)
+				return NULL;
+			hjstate->hj_OuterBatchHashed = false;
+		}
+
+		/*
+		 * The batch might have been fetched before the hash table was built,
+		 * to check whether the outer relation is empty; so hash it now.
+		 */
+		if (!hjstate->hj_OuterBatchHashed)
+		{
+			ExecHashJoinHashOuterBatch(hjstate);
+			hjstate->hj_OuterBatchHashed = true;
+		}
+
+		i = batch->next++;
+		if (hjstate->hj_OuterHashValid[i])
+		{
+			TupleTableSlot *slot = batch->slots[batch->sel[i]];
+
+			/* remember outer relation is not empty for possible rescan */
+			hjstate->hj_OuterNotEmpty = true;
+
+			*hashvalue = hjstate->hj_OuterHashValues[i];
+			return slot;
+		}
+
+		/*
+		 * That tuple couldn't match because of a NULL, or because our
+		 * runtime filter doesn't know its hash value, so discard it and
+		 * continue with the next one.
+		 */
+	}
+}
+
+/*
+ * ExecHashJoinHashOuterBatch
+ *		Compute the hash values of the outer batch's remaining tuples, and
+ *		prefetch the hash table buckets they will probe.
+ */
+static void
+ExecHashJoinHashOuterBatch(HashJoinState *hjstate)
+{
+	TupleBatch *batch = hjstate->hj_OuterBatch;
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	ExprContext *econtext = hjstate->js.ps.ps_ExprContext;
+	HashRuntimeFilter *rf = hjstate->hj_RuntimeFilter;
+	bool		use_filter;
+
+	use_filter = rf != NULL && ExecHashJoinRuntimeFilterActive(rf, hashtable);
+
+	for (int i = batch->next; i < batch->nselected; i++)
+	{
+		uint32		hashvalue;
+		int			bucketno;
+		bool		valid;
+
+		econtext->ecxt_outertuple = batch->slots[batch->sel[i]];
+		valid = ExecHashGetHashValue(hashtable, econtext,
+									 hjstate->hj_OuterHashKeys,
+									 true,	/* outer tuple */
+									 HJ_FILL_OUTER(hjstate),
+									 &hashvalue);
+
+		/*
+		 * The scans below us skip the runtime filter when producing batches,
+		 * as it needs the hash value that we compute anyway.
+		 */
+		if (valid && use_filter)
+		{
+			bool		lacks;
+
+			lacks = bloom_lacks_element(hashtable->bloom,
+										(unsigned char *) &hashvalue,
+										sizeof(hashvalue));
+			valid = !ExecHashJoinRuntimeFilterCount(rf, lacks);
+		}
+
+		hjstate->hj_OuterHashValues[i] = hashvalue;
+		hjstate->hj_OuterHashValid[i] = valid;
+
+		if (!valid)
+			continue;
+
+		/* buckets of tuples of later batches are as good as any to touch */
+		bucketno = hashvalue & (hashtable->nbuckets - 1);
+		if (hashtable->parallel_state)
+			pg_prefetch_mem(&hashtable->buckets.shared[bucketno]);
+		else
+			pg_prefetch_mem(&hashtable->buckets.unshared[bucketno]);
+	}
+}
+
 /* ----------------------------------------------------------------
  *		ExecEndHashJoin
  *
@@ -916,6 +1231,9 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 		slot = hjstate->hj_FirstOuterTupleSlot;
 		if (!TupIsNull(slot))
 			hjstate->hj_FirstOuterTupleSlot = NULL;
+		else if (hjstate->hj_OuterBatch)
+			return ExecHashJoinOuterBatchGetTuple(outerNode, hjstate,
+												  hashvalue);
 		else
 			slot = ExecProcNode(outerNode);
 
@@ -943,6 +1261,9 @@ ExecHashJoinOuterGetTuple(PlanState *outerNode,
 			 * That tuple couldn't match because of a NULL, so discard it and
 			 * continue with the next one.
 			 */
+			if (hjstate->hj_OuterBatch)
+				return ExecHashJoinOuterBatchGetTuple(outerNode, hjstate,
+													  hashvalue);
 			slot = ExecProcNode(outerNode);
 		}
 	}
@@ -988,6 +1309,10 @@ ExecParallelHashJoinOuterGetTuple(PlanState *outerNode,
 	 */
 	if (curbatch == 0 && hashtable->nbatch == 1)
 	{
+		if (hjstate->hj_OuterBatch)
+			return ExecHashJoinOuterBatchGetTuple(outerNode, hjstate,
+												  hashvalue);
+
 		slot = ExecProcNode(outerNode);
 
 		while (!TupIsNull(slot))
@@ -1046,12 +1371,32 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 	int			nbatch;
 	int			curbatch;
 	BufFile    *innerFile;
-	TupleTableSlot *slot;
-	uint32		hashvalue;
 
 	nbatch = hashtable->nbatch;
 	curbatch = hashtable->curbatch;
 
+	if (hashtable->moreStripes)
+	{
+		/*
+		 * The inner side of the current batch didn't fit in memory, and
+		 * splitting the batch didn't help.  Load its next stripe, and probe
+		 * it with the whole outer batch again.
+		 */
+		Assert(curbatch > 0);
+		ExecHashTableReset(hashtable);
+		hashtable->curstripe++;
+		ExecHashJoinLoadInnerBatch(hjstate,
+								   hashtable->innerBatchFile[curbatch]);
+
+		if (hashtable->outerBatchFile[curbatch] != NULL &&
+			BufFileSeek(hashtable->outerBatchFile[curbatch], 0, 0, SEEK_SET))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not rewind hash-join temporary file")));
+
+		return true;
+	}
+
 	if (curbatch > 0)
 	{
 		/*
@@ -1127,6 +1472,13 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 		return false;			/* no more batches */
 
 	hashtable->curbatch = curbatch;
+	hashtable->curstripe = 0;
+
+	/*
+	 * If some earlier batch was too skewed to split, that doesn't mean this
+	 * one is.
+	 */
+	hashtable->growEnabled = true;
 
 	/*
 	 * Reload the hash table with the new inner batch (which could be empty)
@@ -1142,24 +1494,7 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 					(errcode_for_file_access(),
 					 errmsg("could not rewind hash-join temporary file")));
 
-		while ((slot = ExecHashJoinGetSavedTuple(hjstate,
-												 innerFile,
-												 &hashvalue,
-												 hjstate->hj_HashTupleSlot)))
-		{
-			/*
-			 * NOTE: some tuples may be sent to future batches.  Also, it is
-			 * possible for hashtable->nbatch to be increased here!
-			 */
-			ExecHashTableInsert(hashtable, slot, hashvalue);
-		}
-
-		/*
-		 * after we build the hash table, the inner batch file is no longer
-		 * needed
-		 */
-		BufFileClose(innerFile);
-		hashtable->innerBatchFile[curbatch] = NULL;
+		ExecHashJoinLoadInnerBatch(hjstate, innerFile);
 	}
 
 	/*
@@ -1176,6 +1511,54 @@ ExecHashJoinNewBatch(HashJoinState *hjstate)
 	return true;
 }
 
+/*
+ * ExecHashJoinLoadInnerBatch
+ *		Load the current batch's inner tuples from innerFile into the hash
+ *		table, starting at the file's current position.
+ *
+ * If the hash table outgrows its memory budget after we had to give up on
+ * splitting the batch, and the join type allows it, we stop after this
+ * stripe of the batch and leave the file open for the next one.  Otherwise
+ * the file is no longer needed when we're done, and we close it.
+ */
+static void
+ExecHashJoinLoadInnerBatch(HashJoinState *hjstate, BufFile *innerFile)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	int			curbatch = hashtable->curbatch;
+	TupleTableSlot *slot;
+	uint32		hashvalue;
+
+	hashtable->moreStripes = false;
+
+	while ((slot = ExecHashJoinGetSavedTuple(hjstate,
+											 innerFile,
+											 &hashvalue,
+											 hjstate->hj_HashTupleSlot)))
+	{
+		/*
+		 * NOTE: some tuples may be sent to future batches.  Also, it is
+		 * possible for hashtable->nbatch to be increased here!
+		 */
+		ExecHashTableInsert(hashtable, slot, hashvalue);
+
+		if (!hashtable->growEnabled &&
+			hashtable->spaceUsed > hashtable->spaceAllowed &&
+			HJ_CAN_STRIPE(hjstate))
+		{
+			hashtable->moreStripes = true;
+			return;
+		}
+	}
+
+	/*
+	 * after we build the hash table, the inner batch file is no longer
+	 * needed
+	 */
+	BufFileClose(innerFile);
+	hashtable->innerBatchFile[curbatch] = NULL;
+}
+
 /*
  * Choose a batch to work on, and attach to it.  Returns true if successful,
  * false if there are no more batches.
@@ -1347,7 +1730,7 @@ ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
 	{
 		MemoryContext oldctx = MemoryContextSwitchTo(hashtable->spillCxt);
 
-		file = BufFileCreateTemp(false);
+		file = BufFileCreateCompressedTemp(false, temp_file_compression);
 		*fileptr = file;
 
 		MemoryContextSwitchTo(oldctx);
@@ -1483,6 +1866,10 @@ ExecReScanHashJoin(HashJoinState *node)
 	node->hj_MatchedOuter = false;
 	node->hj_FirstOuterTupleSlot = NULL;
 
+	if (node->hj_OuterBatch)
+		ExecResetBatch(node->hj_OuterBatch);
+	node->hj_OuterBatchHashed = false;
+
 	/*
 	 * if chgParam of subnode is not null then plan will be re-scanned by
 	 * first ExecProcNode.
@@ -1521,7 +1908,7 @@ ExecParallelHashJoinPartitionOuter(HashJoinState *hjstate)
 	/* Execute outer plan, writing all tuples to shared tuplestores. */
 	for (;;)
 	{
-		slot = ExecProcNode(outerState);
+		slot = ExecHashJoinFetchOuter(outerState, hjstate);
 		if (TupIsNull(slot))
 			break;
 		econtext->ecxt_outertuple = slot;
@@ -1594,6 +1981,7 @@ ExecHashJoinInitializeDSM(HashJoinState *state, ParallelContext *pcxt)
 	pstate->nbuckets = 0;
 	pstate->growth = PHJ_GROWTH_OK;
 	pstate->chunk_work_queue = InvalidDsaPointer;
+	pstate->bloom = InvalidDsaPointer;
 	pg_atomic_init_u32(&pstate->distributor, 0);
 	pstate->nparticipants = pcxt->nworkers + 1;
 	pstate->total_tuples = 0;
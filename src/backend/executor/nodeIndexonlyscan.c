@@ -43,6 +43,7 @@
 #include "storage/predicate.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
 
 
 static TupleTableSlot *IndexOnlyNext(IndexOnlyScanState *node);
@@ -100,6 +101,8 @@ IndexOnlyNext(IndexOnlyScanState *node)
 		/* Set it up for index-only scan */
 		node->ioss_ScanDesc->xs_want_itup = true;
 		node->ioss_VMBuffer = InvalidBuffer;
+		if (node->ioss_PrefetchMaximum > 0)
+			index_set_prefetch(scandesc, node->ioss_PrefetchMaximum);
 
 		/*
 		 * If no run-time keys to calculate or they are ready, go ahead and
@@ -155,8 +158,12 @@ IndexOnlyNext(IndexOnlyScanState *node)
 		 *
 		 * It's worth going through this complexity to avoid needing to lock
 		 * the VM buffer, which could cause significant contention.
+		 *
+		 * The index AM may already know that the heap page is all-visible,
+		 * see _bt_set_allvisible_hint(), in which case we can skip the test.
 		 */
-		if (!VM_ALL_VISIBLE(scandesc->heapRelation,
+		if (!scandesc->xs_heap_allvisible &&
+			!VM_ALL_VISIBLE(scandesc->heapRelation,
 							ItemPointerGetBlockNumber(tid),
 							&node->ioss_VMBuffer))
 		{
@@ -347,6 +354,10 @@ ExecReScanIndexOnlyScan(IndexOnlyScanState *node)
 	}
 	node->ioss_RuntimeKeysReady = true;
 
+	/* forget any position a merge join made us seek to */
+	if (node->ioss_SeekKey)
+		ExecIndexResetSeekKey(node->ioss_SeekKey);
+
 	/* reset index scan */
 	if (node->ioss_ScanDesc)
 		index_rescan(node->ioss_ScanDesc,
@@ -356,6 +367,46 @@ ExecReScanIndexOnlyScan(IndexOnlyScanState *node)
 	ExecScanReScan(&node->ss);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecIndexOnlyScanReserveSeekKey
+ *
+ *		Prepare the scan for ExecIndexOnlyScanSeek; see
+ *		ExecIndexScanReserveSeekKey.
+ * ----------------------------------------------------------------
+ */
+void
+ExecIndexOnlyScanReserveSeekKey(IndexOnlyScanState *node)
+{
+	Assert(node->ioss_ScanDesc == NULL);
+	Assert(node->ioss_SeekKey == NULL);
+
+	node->ioss_SeekKey = ExecIndexReserveSeekKey(&node->ioss_ScanKeys,
+												 &node->ioss_NumScanKeys,
+												 node->ioss_RuntimeKeys,
+												 node->ioss_NumRuntimeKeys);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecIndexOnlyScanSeek
+ *
+ *		Restart a running forward scan at the first tuple satisfying
+ *		seekkey; see ExecIndexScanSeek.
+ * ----------------------------------------------------------------
+ */
+void
+ExecIndexOnlyScanSeek(IndexOnlyScanState *node, ScanKey seekkey)
+{
+	Assert(node->ioss_SeekKey != NULL);
+	Assert(node->ioss_ScanDesc != NULL && node->ioss_RuntimeKeysReady);
+	Assert(seekkey->sk_attno == 1);
+
+	memcpy(node->ioss_SeekKey, seekkey, sizeof(ScanKeyData));
+
+	index_rescan(node->ioss_ScanDesc,
+				 node->ioss_ScanKeys, node->ioss_NumScanKeys,
+				 node->ioss_OrderByKeys, node->ioss_NumOrderByKeys);
+}
+
 
 /* ----------------------------------------------------------------
  *		ExecEndIndexOnlyScan
@@ -566,6 +617,17 @@ ExecInitIndexOnlyScan(IndexOnlyScan *node, EState *estate, int eflags)
 	lockmode = exec_rt_fetch(node->scan.scanrelid, estate)->rellockmode;
 	indexstate->ioss_RelationDesc = index_open(node->indexid, lockmode);
 
+	/*
+	 * Prefetch heap blocks ahead of the scan, as in ExecInitIndexScan.  Only
+	 * blocks that aren't all-visible are prefetched.
+	 */
+	if (!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) &&
+		node->indexorderby == NIL)
+		indexstate->ioss_PrefetchMaximum =
+			get_tablespace_io_concurrency(currentRelation->rd_rel->reltablespace);
+	else
+		indexstate->ioss_PrefetchMaximum = 0;
+
 	/*
 	 * Initialize index-specific scan state
 	 */
@@ -677,6 +739,8 @@ ExecIndexOnlyScanInitializeDSM(IndexOnlyScanState *node,
 								 piscan);
 	node->ioss_ScanDesc->xs_want_itup = true;
 	node->ioss_VMBuffer = InvalidBuffer;
+	if (node->ioss_PrefetchMaximum > 0)
+		index_set_prefetch(node->ioss_ScanDesc, node->ioss_PrefetchMaximum);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -721,6 +785,8 @@ ExecIndexOnlyScanInitializeWorker(IndexOnlyScanState *node,
 								 node->ioss_NumOrderByKeys,
 								 piscan);
 	node->ioss_ScanDesc->xs_want_itup = true;
+	if (node->ioss_PrefetchMaximum > 0)
+		index_set_prefetch(node->ioss_ScanDesc, node->ioss_PrefetchMaximum);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -43,6 +43,7 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
 
 /*
  * When an ordering operator is used, tuples fetched from the index that
@@ -114,6 +115,8 @@ IndexNext(IndexScanState *node)
 								   node->iss_NumOrderByKeys);
 
 		node->iss_ScanDesc = scandesc;
+		if (node->iss_PrefetchMaximum > 0)
+			index_set_prefetch(scandesc, node->iss_PrefetchMaximum);
 
 		/*
 		 * If no run-time keys to calculate or they are ready, go ahead and
@@ -581,6 +584,10 @@ ExecReScanIndexScan(IndexScanState *node)
 		}
 	}
 
+	/* forget any position a merge join made us seek to */
+	if (node->iss_SeekKey)
+		ExecIndexResetSeekKey(node->iss_SeekKey);
+
 	/* reset index scan */
 	if (node->iss_ScanDesc)
 		index_rescan(node->iss_ScanDesc,
@@ -591,6 +598,185 @@ ExecReScanIndexScan(IndexScanState *node)
 	ExecScanReScan(&node->ss);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecIndexScanReserveSeekKey
+ *
+ *		Prepare the scan for ExecIndexScanSeek.  Must be called before the
+ *		scan is started.  From then on, the scan doesn't return tuples
+ *		having a null in the first index column.
+ * ----------------------------------------------------------------
+ */
+void
+ExecIndexScanReserveSeekKey(IndexScanState *node)
+{
+	Assert(node->iss_ScanDesc == NULL);
+	Assert(node->iss_SeekKey == NULL);
+
+	node->iss_SeekKey = ExecIndexReserveSeekKey(&node->iss_ScanKeys,
+												&node->iss_NumScanKeys,
+												node->iss_RuntimeKeys,
+												node->iss_NumRuntimeKeys);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecIndexScanSeek
+ *
+ *		Restart a running forward scan at the first tuple satisfying
+ *		seekkey, a condition on the first index column in addition to the
+ *		scan's own quals.  That lets a merge join skip a long run of tuples
+ *		that can't join with a descent of the index, instead of reading
+ *		them all.  The seek lasts until the next seek or rescan; the caller
+ *		must keep the key's argument valid until then.
+ * ----------------------------------------------------------------
+ */
+void
+ExecIndexScanSeek(IndexScanState *node, ScanKey seekkey)
+{
+	Assert(node->iss_SeekKey != NULL);
+	Assert(node->iss_ScanDesc != NULL && node->iss_RuntimeKeysReady);
+	Assert(seekkey->sk_attno == 1);
+
+	memcpy(node->iss_SeekKey, seekkey, sizeof(ScanKeyData));
+
+	index_rescan(node->iss_ScanDesc,
+				 node->iss_ScanKeys, node->iss_NumScanKeys,
+				 node->iss_OrderByKeys, node->iss_NumOrderByKeys);
+}
+
+
+/*
+ * ExecIndexReserveSeekKey
+ *		Append a key to an index scan's scankeys for seeking the scan forward
+ *		later, and return it.
+ *
+ * Until it is set for a seek, the key just requires the first index column
+ * to be non-null, which merge joins don't mind as nulls can't join.  The
+ * runtime keys point into the scankey array, so they are moved along.
+ */
+ScanKey
+ExecIndexReserveSeekKey(ScanKey *scanKeys, int *numScanKeys,
+						IndexRuntimeKeyInfo *runtimeKeys, int numRuntimeKeys)
+{
+	ScanKey		oldkeys = *scanKeys;
+	int			nkeys = *numScanKeys;
+	ScanKey		newkeys;
+	int			i;
+
+	newkeys = (ScanKey) palloc((nkeys + 1) * sizeof(ScanKeyData));
+	if (nkeys > 0)
+		memcpy(newkeys, oldkeys, nkeys * sizeof(ScanKeyData));
+
+	/* row comparison subkeys live in separate arrays, leave those alone */
+	for (i = 0; i < numRuntimeKeys; i++)
+	{
+		ScanKey		key = runtimeKeys[i].scan_key;
+
+		if (key >= oldkeys && key < oldkeys + nkeys)
+			runtimeKeys[i].scan_key = newkeys + (key - oldkeys);
+	}
+
+	ExecIndexResetSeekKey(&newkeys[nkeys]);
+
+	if (oldkeys)
+		pfree(oldkeys);
+	*scanKeys = newkeys;
+	*numScanKeys = nkeys + 1;
+
+	return &newkeys[nkeys];
+}
+
+/*
+ * ExecIndexResetSeekKey
+ *		Reset a key reserved by ExecIndexReserveSeekKey to IS NOT NULL.
+ */
+void
+ExecIndexResetSeekKey(ScanKey seekkey)
+{
+	ScanKeyEntryInitialize(seekkey,
+						   SK_ISNULL | SK_SEARCHNOTNULL,
+						   1,	/* first index column */
+						   InvalidStrategy, /* no strategy */
+						   InvalidOid,	/* no strategy subtype */
+						   InvalidOid,	/* no collation */
+						   InvalidOid,	/* no reg proc for this */
+						   (Datum) 0);	/* constant */
+}
+
+/*
+ * ExecIndexFindParamKey
+ *		Find the "indexcol = $paramid" key of an index or index-only scan.
+ *
+ * This is for nested loops that probe a btree with many values at once, by
+ * turning the key into a "= ANY" array key (see nodeNestloop.c).  Returns
+ * false unless the node is such a scan with exactly one plain equality key
+ * computed from the given PARAM_EXEC param alone.  Otherwise returns the key,
+ * the index, and the attribute number of the key's column in the node's
+ * scan tuple.
+ */
+bool
+ExecIndexFindParamKey(PlanState *node, int paramid, ScanKey *scankey,
+					  AttrNumber *scanattno, Relation *indexrel)
+{
+	IndexRuntimeKeyInfo *runtimeKeys;
+	int			numRuntimeKeys;
+	Relation	index;
+	ScanKey		found = NULL;
+	int			i;
+
+	if (IsA(node, IndexScanState))
+	{
+		runtimeKeys = ((IndexScanState *) node)->iss_RuntimeKeys;
+		numRuntimeKeys = ((IndexScanState *) node)->iss_NumRuntimeKeys;
+		index = ((IndexScanState *) node)->iss_RelationDesc;
+	}
+	else if (IsA(node, IndexOnlyScanState))
+	{
+		runtimeKeys = ((IndexOnlyScanState *) node)->ioss_RuntimeKeys;
+		numRuntimeKeys = ((IndexOnlyScanState *) node)->ioss_NumRuntimeKeys;
+		index = ((IndexOnlyScanState *) node)->ioss_RelationDesc;
+	}
+	else
+		return false;
+
+	/* index isn't opened for EXPLAIN */
+	if (index == NULL ||
+		index->rd_rel->relam != BTREE_AM_OID ||
+		!index->rd_indam->amsearcharray)
+		return false;
+
+	for (i = 0; i < numRuntimeKeys; i++)
+	{
+		Expr	   *expr = runtimeKeys[i].key_expr->expr;
+
+		if (!IsA(expr, Param) ||
+			((Param *) expr)->paramkind != PARAM_EXEC ||
+			((Param *) expr)->paramid != paramid)
+			continue;
+		if (found)
+			return false;
+		found = runtimeKeys[i].scan_key;
+	}
+
+	if (found == NULL ||
+		(found->sk_flags & (SK_ROW_HEADER | SK_ROW_MEMBER | SK_SEARCHARRAY |
+							SK_SEARCHNULL | SK_SEARCHNOTNULL | SK_ORDER_BY)) ||
+		found->sk_strategy != BTEqualStrategyNumber)
+		return false;
+
+	if (IsA(node, IndexScanState))
+	{
+		/* the heap column, which mustn't be an expression */
+		*scanattno = index->rd_index->indkey.values[found->sk_attno - 1];
+		if (*scanattno == 0)
+			return false;
+	}
+	else
+		*scanattno = found->sk_attno;
+
+	*scankey = found;
+	*indexrel = index;
+	return true;
+}
 
 /*
  * ExecIndexEvalRuntimeKeys
@@ -971,6 +1157,19 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 	lockmode = exec_rt_fetch(node->scan.scanrelid, estate)->rellockmode;
 	indexstate->iss_RelationDesc = index_open(node->indexid, lockmode);
 
+	/*
+	 * Prefetch heap blocks ahead of the scan, as far as the tablespace's
+	 * effective_io_concurrency allows.  The lookahead can't support moving
+	 * backwards or mark/restore, and scans with ORDER BY operators already
+	 * buffer their tuples in the reorder queue.
+	 */
+	if (!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) &&
+		node->indexorderby == NIL)
+		indexstate->iss_PrefetchMaximum =
+			get_tablespace_io_concurrency(currentRelation->rd_rel->reltablespace);
+	else
+		indexstate->iss_PrefetchMaximum = 0;
+
 	/*
 	 * Initialize index-specific scan state
 	 */
@@ -1691,6 +1890,8 @@ ExecIndexScanInitializeDSM(IndexScanState *node,
 								 node->iss_NumScanKeys,
 								 node->iss_NumOrderByKeys,
 								 piscan);
+	if (node->iss_PrefetchMaximum > 0)
+		index_set_prefetch(node->iss_ScanDesc, node->iss_PrefetchMaximum);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -1734,6 +1935,8 @@ ExecIndexScanInitializeWorker(IndexScanState *node,
 								 node->iss_NumScanKeys,
 								 node->iss_NumOrderByKeys,
 								 piscan);
+	if (node->iss_PrefetchMaximum > 0)
+		index_set_prefetch(node->iss_ScanDesc, node->iss_PrefetchMaximum);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -15,12 +15,14 @@
 /*
  * INTERFACE ROUTINES
  *		ExecLimit		- extract a limited range of tuples
+ *		ExecLimitBatch	- same in batch mode
  *		ExecInitLimit	- initialize node and subnodes..
  *		ExecEndLimit	- shutdown node and subnodes
  */
 
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeLimit.h"
 #include "miscadmin.h"
@@ -345,6 +347,83 @@ ExecLimit(PlanState *pstate)
 	return slot;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecLimitBatch
+ *
+ *		Batch equivalent of ExecLimit, used only for plain LIMIT/OFFSET
+ *		over an outer plan that supports batch mode.  Our caller's batch
+ *		is filled by the subplan directly; we just cut the part outside
+ *		the window off the selection vector.  As batches are only ever
+ *		read forwards, the state machine is much simpler than the above.
+ * ----------------------------------------------------------------
+ */
+static int
+ExecLimitBatch(PlanState *pstate, TupleBatch *batch)
+{
+	LimitState *node = castNode(LimitState, pstate);
+	PlanState  *outerPlan = outerPlanState(node);
+
+	CHECK_FOR_INTERRUPTS();
+
+	Assert(node->limitOption == LIMIT_OPTION_COUNT);
+
+	if (node->lstate == LIMIT_INITIAL)
+		recompute_limits(node);
+
+	if (node->lstate == LIMIT_RESCAN)
+	{
+		/* check for empty window, as in ExecLimit */
+		if (node->count <= 0 && !node->noCount)
+		{
+			node->lstate = LIMIT_EMPTY;
+			return 0;
+		}
+		node->lstate = LIMIT_INWINDOW;
+	}
+
+	while (node->lstate == LIMIT_INWINDOW)
+	{
+		int			nrows;
+		int			skip;
+		int			take;
+
+		/* check for stepping off end of window */
+		if (!node->noCount && node->position - node->offset >= node->count)
+		{
+			node->lstate = LIMIT_WINDOWEND;
+			break;
+		}
+
+		nrows = ExecProcBatch(outerPlan, batch);
+		if (nrows == 0)
+		{
+			node->lstate = LIMIT_SUBPLANEOF;
+			break;
+		}
+
+		/* skip tuples before the window, and those after it */
+		skip = 0;
+		if (node->position < node->offset)
+			skip = (int) Min((int64) nrows, node->offset - node->position);
+		take = nrows - skip;
+		if (!node->noCount)
+			take = (int) Min((int64) take,
+							 node->count - (node->position + skip - node->offset));
+		node->position += skip + take;
+
+		if (take > 0)
+		{
+			if (skip > 0)
+				memmove(batch->sel, batch->sel + skip, sizeof(int) * take);
+			batch->nselected = take;
+			return take;
+		}
+	}
+
+	batch->nselected = 0;
+	return 0;
+}
+
 /*
  * Evaluate the limit/offset expressions --- done at startup or rescan.
  *
@@ -501,6 +580,12 @@ ExecInitLimit(Limit *node, EState *estate, int eflags)
 	 */
 	limitstate->ps.ps_ProjInfo = NULL;
 
+	/* plain LIMIT/OFFSET can work in batch mode if our outer plan can */
+	if (executor_batch_size > 0 &&
+		node->limitOption == LIMIT_OPTION_COUNT &&
+		outerPlanState(limitstate)->ExecProcNodeBatch != NULL)
+		limitstate->ps.ExecProcNodeBatch = ExecLimitBatch;
+
 	/*
 	 * Initialize the equality evaluation, to detect ties.
 	 */
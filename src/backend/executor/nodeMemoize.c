@@ -19,11 +19,21 @@
  * to warrant adding the additional node.
  *
  * The method of cache we use is a hash table.  When the cache fills, we never
- * spill tuples to disk, instead, we choose to evict the least recently used
- * cache entry from the cache.  We remember the least recently used entry by
- * always pushing new entries and entries we look for onto the tail of a
- * doubly linked list.  This means that older items always bubble to the top
- * of this LRU list.
+ * spill tuples to disk, instead, we choose to evict a cache entry from the
+ * cache.  We remember the least recently used entries by always pushing new
+ * entries and entries we look for onto the tail of a doubly linked list.
+ * This means that older items always bubble to the top of this LRU list.
+ *
+ * Not all entries are equally worth keeping, though: one that took the
+ * subplan a long time to compute saves more on its next hit than one that
+ * was cheap to compute, for the same amount of memory.  So each entry gets
+ * an eviction priority, the time the subplan spent producing its tuples per
+ * byte of cache memory they use, plus an "inflation" value, which is the
+ * priority of the last entry evicted.  We evict the entry with the lowest
+ * priority among the few least recently used ones.  A hit recomputes the
+ * entry's priority against the current inflation, so entries that are not
+ * used again eventually fall behind the new ones, however expensive they
+ * were (this is the GreedyDual-Size policy).
  *
  * Sometimes our callers won't run their scans to completion. For example a
  * semi-join only needs to run until it finds a matching tuple, and once it
@@ -50,6 +60,16 @@
  * demanding, then that may allow us to start putting useful entries back into
  * the cache again.
  *
+ * In a parallel query, each process runs its own copy of the memoize node,
+ * and with a private cache each of them would compute every entry again.
+ * Unless memoize_shared_cache is off, the processes instead share one cache,
+ * kept in a dshash table in the query's DSA area (see "Shared Cache" below).
+ * Entries are only added to it once complete, so a process that misses just
+ * fills the entry privately and publishes it at the end of its scan; if two
+ * processes happen to fill the same entry at once, the second copy is simply
+ * discarded.  This is only done if the subplan depends on no parameters but
+ * the cache keys, as other parameters may differ between the processes.
+ *
  *
  * INTERFACE ROUTINES
  *		ExecMemoize			- lookup cache, exec subplan when not found
@@ -69,8 +89,10 @@
 #include "common/hashfn.h"
 #include "executor/executor.h"
 #include "executor/nodeMemoize.h"
+#include "lib/dshash.h"
 #include "lib/ilist.h"
 #include "miscadmin.h"
+#include "port/atomics.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
 
@@ -90,6 +112,15 @@
 #define CACHE_TUPLE_BYTES(t)			(sizeof(MemoizeTuple) + \
 										 (t)->mintuple->t_len)
 
+/* Number of least recently used entries to choose an eviction victim from */
+#define MEMO_EVICTION_SAMPLE		8
+
+/* Scale of eviction priorities, in units per microsecond per byte */
+#define MEMO_PRIORITY_SCALE			65536.0
+
+/* GUC parameter */
+bool		memoize_shared_cache = true;
+
  /* MemoizeTuple Stores an individually cached tuple */
 typedef struct MemoizeTuple
 {
@@ -106,6 +137,9 @@ typedef struct MemoizeKey
 {
 	MinimalTuple params;
 	dlist_node	lru_node;		/* Pointer to next/prev key in LRU list */
+	uint64		priority;		/* eviction priority, lowest goes first */
+	uint64		density;		/* cost of the entry per byte, see
+								 * cache_entry_density() */
 } MemoizeKey;
 
 /*
@@ -148,6 +182,94 @@ static bool MemoizeHash_equal(struct memoize_hash *tb,
 #define SH_DEFINE
 #include "lib/simplehash.h"
 
+/*
+ * Shared Cache
+ *
+ * The key of a shared cache entry.  Lookups always use the probeslot, like
+ * for the private cache, so the search key has no params tuple; only entries
+ * in the table have one.
+ */
+typedef struct SharedMemoizeKey
+{
+	uint32		hash;			/* hash of the cache key values */
+	dsa_pointer params;			/* MinimalTuple of the cache key values, or
+								 * InvalidDsaPointer for the search key */
+} SharedMemoizeKey;
+
+/*
+ * SharedMemoizeEntry
+ *		The data struct that the shared cache's dshash table stores.  The
+ *		cached tuples are stored one after another in one DSA chunk, each
+ *		MAXALIGN'd.
+ */
+typedef struct SharedMemoizeEntry
+{
+	SharedMemoizeKey key;		/* must be first */
+	dsa_pointer tuples;			/* the cached tuples, or InvalidDsaPointer */
+	Size		tupleslen;		/* total length of the tuples */
+	uint64		mem;			/* memory accounted for the entry */
+	uint64		density;		/* cost of the entry per byte */
+	pg_atomic_uint64 priority;	/* eviction priority, set on each hit */
+} SharedMemoizeEntry;
+
+/*
+ * ParallelMemoizeState
+ *		The part of a memoize node's state in the parallel query's DSM
+ *		segment.  The SharedMemoizeInfo for EXPLAIN ANALYZE, if any, follows
+ *		at PARALLEL_MEMOIZE_INFO_OFFSET.
+ */
+typedef struct ParallelMemoizeState
+{
+	bool		has_cache;		/* is there a shared cache? */
+	bool		has_instrumentation;	/* is there a SharedMemoizeInfo? */
+	dshash_table_handle cache_handle;	/* the shared cache */
+	uint64		mem_limit;		/* memory limit in bytes for the cache */
+	pg_atomic_uint64 mem_used;	/* bytes of memory used by the cache */
+	pg_atomic_uint64 inflation; /* eviction priority of the last entry
+								 * evicted */
+	pg_atomic_flag evicting;	/* set while a process is evicting entries */
+} ParallelMemoizeState;
+
+#define PARALLEL_MEMOIZE_INFO_OFFSET	MAXALIGN(sizeof(ParallelMemoizeState))
+
+/*
+ * MemoizeSharedData
+ *		A process's local state for the shared cache.  The tuples of the
+ *		current scan, whether copied out of a cache entry for a hit or being
+ *		collected to publish as a new one, are kept in 'data', laid out like
+ *		in a SharedMemoizeEntry.
+ */
+typedef struct MemoizeSharedData
+{
+	ParallelMemoizeState *pstate;
+	dsa_area   *area;
+	dshash_table *table;
+	MemoryContext cxt;			/* memory for the current scan */
+	MinimalTuple params;		/* the current scan's cache key values */
+	uint32		hash;			/* and their hash */
+	char	   *data;			/* the current scan's tuples */
+	Size		datalen;		/* bytes used in 'data' */
+	Size		dataspace;		/* bytes allocated for 'data' */
+	Size		next;			/* offset of the next tuple to return */
+} MemoizeSharedData;
+
+static int	SharedMemoizeHash_compare(const void *a, const void *b,
+									  size_t size, void *arg);
+static dshash_hash SharedMemoizeHash_hash(const void *key, size_t size,
+										  void *arg);
+
+static const dshash_parameters shared_memoize_params = {
+	sizeof(SharedMemoizeKey),
+	sizeof(SharedMemoizeEntry),
+	SharedMemoizeHash_compare,
+	SharedMemoizeHash_hash,
+	LWTRANCHE_PARALLEL_MEMOIZE
+};
+
+static uint32 probe_slot_hash(MemoizeState *mstate);
+static bool probe_slot_equal(MemoizeState *mstate, MinimalTuple params);
+static TupleTableSlot *ExecMemoizeShared(PlanState *pstate);
+
 /*
  * MemoizeHash_hash
  *		Hash function for simplehash hashtable.  'key' is unused here as we
@@ -157,7 +279,16 @@ static bool MemoizeHash_equal(struct memoize_hash *tb,
 static uint32
 MemoizeHash_hash(struct memoize_hash *tb, const MemoizeKey *key)
 {
-	MemoizeState *mstate = (MemoizeState *) tb->private_data;
+	return probe_slot_hash((MemoizeState *) tb->private_data);
+}
+
+/*
+ * probe_slot_hash
+ *		Compute the hash value of the key values in mstate's probeslot.
+ */
+static uint32
+probe_slot_hash(MemoizeState *mstate)
+{
 	ExprContext *econtext = mstate->ss.ps.ps_ExprContext;
 	MemoryContext oldcontext;
 	TupleTableSlot *pslot = mstate->probeslot;
@@ -222,13 +353,23 @@ static bool
 MemoizeHash_equal(struct memoize_hash *tb, const MemoizeKey *key1,
 				  const MemoizeKey *key2)
 {
-	MemoizeState *mstate = (MemoizeState *) tb->private_data;
+	return probe_slot_equal((MemoizeState *) tb->private_data, key1->params);
+}
+
+/*
+ * probe_slot_equal
+ *		Check if the key values in 'params' match those in mstate's
+ *		probeslot.
+ */
+static bool
+probe_slot_equal(MemoizeState *mstate, MinimalTuple params)
+{
 	ExprContext *econtext = mstate->ss.ps.ps_ExprContext;
 	TupleTableSlot *tslot = mstate->tableslot;
 	TupleTableSlot *pslot = mstate->probeslot;
 
 	/* probeslot should have already been prepared by prepare_probe_slot() */
-	ExecStoreMinimalTuple(key1->params, tslot, false);
+	ExecStoreMinimalTuple(params, tslot, false);
 
 	if (mstate->binary_mode)
 	{
@@ -333,6 +474,59 @@ prepare_probe_slot(MemoizeState *mstate, MemoizeKey *key)
 	ExecStoreVirtualTuple(pslot);
 }
 
+/*
+ * memoize_fetch_outer
+ *		Fetch the next tuple from the subplan while filling a cache entry,
+ *		adding the time it took to mstate's fill_time.
+ */
+static inline TupleTableSlot *
+memoize_fetch_outer(MemoizeState *mstate)
+{
+	TupleTableSlot *slot;
+	instr_time	starttime;
+	instr_time	endtime;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+	slot = ExecProcNode(outerPlanState(mstate));
+	INSTR_TIME_SET_CURRENT(endtime);
+	INSTR_TIME_ACCUM_DIFF(mstate->fill_time, endtime, starttime);
+
+	return slot;
+}
+
+/*
+ * cache_entry_density
+ *		The cost of an entry of 'mem' bytes just filled, per byte, for its
+ *		eviction priority.  That's the time the subplan spent producing its
+ *		tuples, rather than any cost estimate, as it varies with the key.
+ */
+static inline uint64
+cache_entry_density(MemoizeState *mstate, uint64 mem)
+{
+	double		usecs = INSTR_TIME_GET_MICROSEC(mstate->fill_time);
+
+	return (uint64) ((usecs + 1.0) * MEMO_PRIORITY_SCALE / Max(mem, 1));
+}
+
+/*
+ * cache_entry_complete
+ *		Mark 'entry' as complete, and set its eviction priority.
+ */
+static void
+cache_entry_complete(MemoizeState *mstate, MemoizeEntry *entry)
+{
+	MemoizeTuple *tuple;
+	uint64		mem;
+
+	mem = EMPTY_ENTRY_MEMORY_BYTES(entry);
+	for (tuple = entry->tuplehead; tuple != NULL; tuple = tuple->next)
+		mem += CACHE_TUPLE_BYTES(tuple);
+
+	entry->complete = true;
+	entry->key->density = cache_entry_density(mstate, mem);
+	entry->key->priority = mstate->inflation + entry->key->density;
+}
+
 /*
  * entry_purge_tuples
  *		Remove all tuples from the cache entry pointed to by 'entry'.  This
@@ -426,9 +620,10 @@ cache_purge_all(MemoizeState *mstate)
 
 /*
  * cache_reduce_memory
- *		Evict older and less recently used items from the cache in order to
+ *		Evict older and less valuable items from the cache in order to
  *		reduce the memory consumption back to something below the
- *		MemoizeState's mem_limit.
+ *		MemoizeState's mem_limit.  Each victim is the entry with the lowest
+ *		priority among the MEMO_EVICTION_SAMPLE least recently used ones.
  *
  * 'specialkey', if not NULL, causes the function to return false if the entry
  * which the key belongs to is removed from the cache.
@@ -437,7 +632,6 @@ static bool
 cache_reduce_memory(MemoizeState *mstate, MemoizeKey *specialkey)
 {
 	bool		specialkey_intact = true;	/* for now */
-	dlist_mutable_iter iter;
 	uint64		evictions = 0;
 
 	/* Update peak memory usage */
@@ -447,11 +641,24 @@ cache_reduce_memory(MemoizeState *mstate, MemoizeKey *specialkey)
 	/* We expect only to be called when we've gone over budget on memory */
 	Assert(mstate->mem_used > mstate->mem_limit);
 
-	/* Start the eviction process starting at the head of the LRU list. */
-	dlist_foreach_modify(iter, &mstate->lru_list)
+	/* Evict entries from near the head of the LRU list until under budget */
+	while (!dlist_is_empty(&mstate->lru_list))
 	{
-		MemoizeKey *key = dlist_container(MemoizeKey, lru_node, iter.cur);
+		MemoizeKey *key = NULL;
 		MemoizeEntry *entry;
+		dlist_iter	iter;
+		int			nsampled = 0;
+
+		dlist_foreach(iter, &mstate->lru_list)
+		{
+			MemoizeKey *candidate = dlist_container(MemoizeKey, lru_node,
+													iter.cur);
+
+			if (key == NULL || candidate->priority < key->priority)
+				key = candidate;
+			if (++nsampled >= MEMO_EVICTION_SAMPLE)
+				break;
+		}
 
 		/*
 		 * Populate the hash probe slot in preparation for looking up this LRU
@@ -492,6 +699,9 @@ cache_reduce_memory(MemoizeState *mstate, MemoizeKey *specialkey)
 		if (key == specialkey)
 			specialkey_intact = false;
 
+		/* Entries filled or hit from now on rank above this one */
+		mstate->inflation = Max(mstate->inflation, key->priority);
+
 		/*
 		 * Finally remove the entry.  This will remove from the LRU list too.
 		 */
@@ -553,6 +763,8 @@ cache_lookup(MemoizeState *mstate, bool *found)
 	/* Allocate a new key */
 	entry->key = key = (MemoizeKey *) palloc(sizeof(MemoizeKey));
 	key->params = ExecCopySlotMinimalTuple(mstate->probeslot);
+	key->priority = mstate->inflation;
+	key->density = 0;
 
 	/* Update the total cache memory utilization */
 	mstate->mem_used += EMPTY_ENTRY_MEMORY_BYTES(entry);
@@ -727,6 +939,9 @@ ExecMemoize(PlanState *pstate)
 				{
 					node->stats.cache_hits += 1;	/* stats update */
 
+					/* rank the entry against the current inflation */
+					entry->key->priority = node->inflation + entry->key->density;
+
 					/*
 					 * Set last_tuple and entry so that the state
 					 * MEMO_CACHE_FETCH_NEXT_TUPLE can easily find the next
@@ -769,8 +984,8 @@ ExecMemoize(PlanState *pstate)
 				}
 
 				/* Scan the outer node for a tuple to cache */
-				outerNode = outerPlanState(node);
-				outerslot = ExecProcNode(outerNode);
+				INSTR_TIME_SET_ZERO(node->fill_time);
+				outerslot = memoize_fetch_outer(node);
 				if (TupIsNull(outerslot))
 				{
 					/*
@@ -781,7 +996,7 @@ ExecMemoize(PlanState *pstate)
 					 * scan.
 					 */
 					if (likely(entry))
-						entry->complete = true;
+						cache_entry_complete(node, entry);
 
 					node->mstatus = MEMO_END_OF_SCAN;
 					return NULL;
@@ -813,7 +1028,8 @@ ExecMemoize(PlanState *pstate)
 					 * cache lookups to work even when the scan has not been
 					 * executed to completion.
 					 */
-					entry->complete = node->singlerow;
+					if (node->singlerow)
+						cache_entry_complete(node, entry);
 					node->mstatus = MEMO_FILLING_CACHE;
 				}
 
@@ -858,12 +1074,11 @@ ExecMemoize(PlanState *pstate)
 				 * cache miss and are populating the cache with the current
 				 * scan tuples.
 				 */
-				outerNode = outerPlanState(node);
-				outerslot = ExecProcNode(outerNode);
+				outerslot = memoize_fetch_outer(node);
 				if (TupIsNull(outerslot))
 				{
 					/* No more tuples.  Mark it as complete */
-					entry->complete = true;
+					cache_entry_complete(node, entry);
 					node->mstatus = MEMO_END_OF_SCAN;
 					return NULL;
 				}
@@ -932,6 +1147,468 @@ ExecMemoize(PlanState *pstate)
 	}							/* switch */
 }
 
+/* ----------------------------------------------------------------
+ *						Shared Cache
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * SharedMemoizeHash_compare
+ *		Comparison function for the shared cache's dshash table.  One of the
+ *		keys is always the search key, whose values are in the probeslot.
+ */
+static int
+SharedMemoizeHash_compare(const void *a, const void *b, size_t size,
+						  void *arg)
+{
+	MemoizeState *mstate = (MemoizeState *) arg;
+	const SharedMemoizeKey *key1 = (const SharedMemoizeKey *) a;
+	const SharedMemoizeKey *key2 = (const SharedMemoizeKey *) b;
+	dsa_pointer params;
+
+	if (key1->hash != key2->hash)
+		return 1;
+
+	if (!DsaPointerIsValid(key1->params))
+		params = key2->params;
+	else
+	{
+		Assert(!DsaPointerIsValid(key2->params));
+		params = key1->params;
+	}
+
+	if (probe_slot_equal(mstate,
+						 dsa_get_address(mstate->shared->area, params)))
+		return 0;
+	return 1;
+}
+
+/*
+ * SharedMemoizeHash_hash
+ *		Hash function for the shared cache's dshash table.  The hash value is
+ *		computed from the probeslot before the lookup.
+ */
+static dshash_hash
+SharedMemoizeHash_hash(const void *key, size_t size, void *arg)
+{
+	return ((const SharedMemoizeKey *) key)->hash;
+}
+
+/*
+ * shared_cache_attach
+ *		Set up mstate to use the shared cache 'table' of the given
+ *		ParallelMemoizeState, and run with ExecMemoizeShared.
+ */
+static void
+shared_cache_attach(MemoizeState *mstate, ParallelMemoizeState *pstate,
+					dsa_area *area, dshash_table *table)
+{
+	MemoizeSharedData *shared = mstate->shared;
+
+	if (shared == NULL)
+	{
+		MemoryContext querycxt = mstate->ss.ps.state->es_query_cxt;
+
+		shared = MemoryContextAllocZero(querycxt, sizeof(MemoizeSharedData));
+		shared->cxt = AllocSetContextCreate(querycxt,
+											"MemoizeSharedCache",
+											ALLOCSET_DEFAULT_SIZES);
+		mstate->shared = shared;
+	}
+	else
+	{
+		/* a new parallel context for a rescan; forget the old one's table */
+		dshash_detach(shared->table);
+		MemoryContextReset(shared->cxt);
+	}
+
+	shared->pstate = pstate;
+	shared->area = area;
+	shared->table = table;
+	shared->params = NULL;
+	shared->data = NULL;
+	shared->datalen = shared->dataspace = shared->next = 0;
+
+	ExecSetExecProcNode(&mstate->ss.ps, ExecMemoizeShared);
+}
+
+/*
+ * shared_cache_lookup
+ *		Look up the scan's current parameters in the shared cache.  If
+ *		there's an entry, copy its tuples out for the scan to return and
+ *		return true.  Either way, remember the key values for
+ *		shared_cache_store.
+ */
+static bool
+shared_cache_lookup(MemoizeState *mstate)
+{
+	MemoizeSharedData *shared = mstate->shared;
+	SharedMemoizeKey skey;
+	SharedMemoizeEntry *entry;
+	MemoizeKey key;
+	MemoryContext oldcontext;
+
+	MemoryContextReset(shared->cxt);
+	shared->data = NULL;
+	shared->datalen = shared->dataspace = shared->next = 0;
+
+	/*
+	 * Keep a copy of the key values, and point the probeslot at it, so that
+	 * it stays valid until the scan is over.
+	 */
+	prepare_probe_slot(mstate, NULL);
+	oldcontext = MemoryContextSwitchTo(shared->cxt);
+	shared->params = ExecCopySlotMinimalTuple(mstate->probeslot);
+	MemoryContextSwitchTo(oldcontext);
+	key.params = shared->params;
+	prepare_probe_slot(mstate, &key);
+	shared->hash = probe_slot_hash(mstate);
+
+	skey.hash = shared->hash;
+	skey.params = InvalidDsaPointer;
+	entry = dshash_find(shared->table, &skey, false);
+	if (entry == NULL)
+		return false;
+
+	if (entry->tupleslen > 0)
+	{
+		shared->data = MemoryContextAlloc(shared->cxt, entry->tupleslen);
+		memcpy(shared->data, dsa_get_address(shared->area, entry->tuples),
+			   entry->tupleslen);
+		shared->datalen = shared->dataspace = entry->tupleslen;
+	}
+
+	/* rank the entry against the current inflation */
+	pg_atomic_write_u64(&entry->priority,
+						pg_atomic_read_u64(&shared->pstate->inflation) +
+						entry->density);
+
+	dshash_release_lock(shared->table, entry);
+
+	return true;
+}
+
+/*
+ * shared_cache_add_tuple
+ *		Add the tuple in 'slot' to the ones collected for a new shared cache
+ *		entry.  Returns false if the entry would be too large to cache.
+ */
+static bool
+shared_cache_add_tuple(MemoizeState *mstate, TupleTableSlot *slot)
+{
+	MemoizeSharedData *shared = mstate->shared;
+	MinimalTuple tuple;
+	bool		shouldFree;
+	Size		len;
+
+	tuple = ExecFetchSlotMinimalTuple(slot, &shouldFree);
+	len = MAXALIGN(tuple->t_len);
+
+	if (sizeof(SharedMemoizeEntry) + shared->params->t_len +
+		shared->datalen + len > shared->pstate->mem_limit)
+	{
+		if (shouldFree)
+			pfree(tuple);
+		return false;
+	}
+
+	if (shared->datalen + len > shared->dataspace)
+	{
+		Size		newspace = Max(shared->dataspace * 2, 1024);
+
+		newspace = Max(newspace, shared->datalen + len);
+		if (shared->data == NULL)
+			shared->data = MemoryContextAlloc(shared->cxt, newspace);
+		else
+			shared->data = repalloc(shared->data, newspace);
+		shared->dataspace = newspace;
+	}
+
+	memcpy(shared->data + shared->datalen, tuple, tuple->t_len);
+	shared->datalen += len;
+
+	if (shouldFree)
+		pfree(tuple);
+
+	return true;
+}
+
+/*
+ * shared_cache_next_tuple
+ *		Return the next tuple of a shared cache hit, or NULL at the end.
+ */
+static TupleTableSlot *
+shared_cache_next_tuple(MemoizeState *mstate)
+{
+	MemoizeSharedData *shared = mstate->shared;
+	MinimalTuple tuple;
+	TupleTableSlot *slot;
+
+	if (shared->next >= shared->datalen)
+	{
+		mstate->mstatus = MEMO_END_OF_SCAN;
+		return NULL;
+	}
+
+	tuple = (MinimalTuple) (shared->data + shared->next);
+	shared->next += MAXALIGN(tuple->t_len);
+
+	slot = mstate->ss.ps.ps_ResultTupleSlot;
+	ExecStoreMinimalTuple(tuple, slot, false);
+	return slot;
+}
+
+/* qsort comparator for shared_cache_reduce_memory */
+static int
+shared_cache_victim_cmp(const void *a, const void *b)
+{
+	uint64		pa = ((const uint64 *) a)[0];
+	uint64		pb = ((const uint64 *) b)[0];
+
+	if (pa < pb)
+		return -1;
+	if (pa > pb)
+		return 1;
+	return 0;
+}
+
+/*
+ * shared_cache_reduce_memory
+ *		Evict the entries of lowest priority from the shared cache, to bring
+ *		its memory use some way below the limit so that we don't have to do
+ *		this again for every new entry.  Only one process evicts at a time;
+ *		the others just go over budget a bit while it works.
+ *
+ * There's no LRU list to pick victims from, since maintaining one would
+ * serialize all lookups.  Instead we scan the whole table once to find the
+ * priority below which enough memory would be freed, then again to remove
+ * the entries below it.
+ */
+static void
+shared_cache_reduce_memory(MemoizeState *mstate)
+{
+	MemoizeSharedData *shared = mstate->shared;
+	ParallelMemoizeState *pstate = shared->pstate;
+	dshash_seq_status status;
+	SharedMemoizeEntry *entry;
+	uint64	   *victims;		/* pairs of priority and memory */
+	int			nvictims = 0;
+	int			maxvictims = 256;
+	uint64		mem_used;
+	uint64		target;
+	uint64		tofree;
+	uint64		freed = 0;
+	uint64		threshold = 0;
+	uint64		evictions = 0;
+
+	if (!pg_atomic_test_set_flag(&pstate->evicting))
+		return;
+
+	mem_used = pg_atomic_read_u64(&pstate->mem_used);
+	target = pstate->mem_limit - pstate->mem_limit / 10;
+	if (mem_used <= target)
+	{
+		pg_atomic_clear_flag(&pstate->evicting);
+		return;
+	}
+	tofree = mem_used - target;
+
+	/* Collect the priorities of all entries */
+	victims = palloc(maxvictims * 2 * sizeof(uint64));
+	dshash_seq_init(&status, shared->table, false);
+	while ((entry = dshash_seq_next(&status)) != NULL)
+	{
+		if (nvictims >= maxvictims)
+		{
+			maxvictims *= 2;
+			victims = repalloc(victims, maxvictims * 2 * sizeof(uint64));
+		}
+		victims[nvictims * 2] = pg_atomic_read_u64(&entry->priority);
+		victims[nvictims * 2 + 1] = entry->mem;
+		nvictims++;
+	}
+	dshash_seq_term(&status);
+
+	/* Find the priority up to which we must evict */
+	qsort(victims, nvictims, 2 * sizeof(uint64), shared_cache_victim_cmp);
+	for (int i = 0; i < nvictims; i++)
+	{
+		threshold = victims[i * 2];
+		freed += victims[i * 2 + 1];
+		if (freed >= tofree)
+			break;
+	}
+	pfree(victims);
+
+	/* And evict */
+	freed = 0;
+	dshash_seq_init(&status, shared->table, true);
+	while ((entry = dshash_seq_next(&status)) != NULL)
+	{
+		dsa_pointer params = entry->key.params;
+		dsa_pointer tuples = entry->tuples;
+
+		if (pg_atomic_read_u64(&entry->priority) > threshold)
+			continue;
+
+		freed += entry->mem;
+		evictions++;
+		dshash_delete_current(&status);
+		dsa_free(shared->area, params);
+		if (DsaPointerIsValid(tuples))
+			dsa_free(shared->area, tuples);
+	}
+	dshash_seq_term(&status);
+
+	pg_atomic_sub_fetch_u64(&pstate->mem_used, freed);
+	if (threshold > pg_atomic_read_u64(&pstate->inflation))
+		pg_atomic_write_u64(&pstate->inflation, threshold);
+	pg_atomic_clear_flag(&pstate->evicting);
+
+	mstate->stats.cache_evictions += evictions; /* Update Stats */
+}
+
+/*
+ * shared_cache_store
+ *		Publish the tuples collected by the current scan as a new shared
+ *		cache entry, unless another process got there first.
+ */
+static void
+shared_cache_store(MemoizeState *mstate)
+{
+	MemoizeSharedData *shared = mstate->shared;
+	ParallelMemoizeState *pstate = shared->pstate;
+	SharedMemoizeKey skey;
+	SharedMemoizeEntry *entry;
+	MemoizeKey	key;
+	dsa_pointer params;
+	dsa_pointer tuples = InvalidDsaPointer;
+	uint64		mem;
+	uint64		density;
+	bool		found;
+
+	mem = sizeof(SharedMemoizeEntry) + shared->params->t_len + shared->datalen;
+	density = cache_entry_density(mstate, mem);
+
+	/* Copy the key and the tuples into the DSA area */
+	params = dsa_allocate(shared->area, shared->params->t_len);
+	memcpy(dsa_get_address(shared->area, params), shared->params,
+		   shared->params->t_len);
+	if (shared->datalen > 0)
+	{
+		tuples = dsa_allocate(shared->area, shared->datalen);
+		memcpy(dsa_get_address(shared->area, tuples), shared->data,
+			   shared->datalen);
+	}
+
+	key.params = shared->params;
+	prepare_probe_slot(mstate, &key);
+	skey.hash = shared->hash;
+	skey.params = InvalidDsaPointer;
+	entry = dshash_find_or_insert(shared->table, &skey, &found);
+	if (found)
+	{
+		dshash_release_lock(shared->table, entry);
+		dsa_free(shared->area, params);
+		if (DsaPointerIsValid(tuples))
+			dsa_free(shared->area, tuples);
+		return;
+	}
+
+	entry->key.params = params;
+	entry->tuples = tuples;
+	entry->tupleslen = shared->datalen;
+	entry->mem = mem;
+	entry->density = density;
+	pg_atomic_init_u64(&entry->priority,
+					   pg_atomic_read_u64(&pstate->inflation) + density);
+	dshash_release_lock(shared->table, entry);
+
+	mem = pg_atomic_add_fetch_u64(&pstate->mem_used, mem);
+	if (mem > mstate->stats.mem_peak)
+		mstate->stats.mem_peak = mem;
+	if (mem > pstate->mem_limit)
+		shared_cache_reduce_memory(mstate);
+}
+
+/*
+ * ExecMemoizeShared
+ *		ExecMemoize for a node using the shared cache.
+ */
+static TupleTableSlot *
+ExecMemoizeShared(PlanState *pstate)
+{
+	MemoizeState *node = castNode(MemoizeState, pstate);
+	TupleTableSlot *outerslot;
+	TupleTableSlot *slot;
+
+	switch (node->mstatus)
+	{
+		case MEMO_CACHE_LOOKUP:
+			if (shared_cache_lookup(node))
+			{
+				node->stats.cache_hits += 1;	/* stats update */
+				node->mstatus = MEMO_CACHE_FETCH_NEXT_TUPLE;
+				return shared_cache_next_tuple(node);
+			}
+
+			/* Handle cache miss, collecting the tuples to publish */
+			node->stats.cache_misses += 1;	/* stats update */
+			INSTR_TIME_SET_ZERO(node->fill_time);
+			node->mstatus = MEMO_FILLING_CACHE;
+			/* FALLTHROUGH */
+
+		case MEMO_FILLING_CACHE:
+			outerslot = memoize_fetch_outer(node);
+			if (TupIsNull(outerslot))
+			{
+				shared_cache_store(node);
+				node->mstatus = MEMO_END_OF_SCAN;
+				return NULL;
+			}
+
+			if (unlikely(!shared_cache_add_tuple(node, outerslot)))
+			{
+				/* Too large to cache; read the rest without collecting */
+				node->stats.cache_overflows += 1;	/* stats update */
+				node->mstatus = MEMO_CACHE_BYPASS_MODE;
+			}
+			else if (node->singlerow)
+			{
+				/* The entry is complete after the first tuple */
+				shared_cache_store(node);
+				node->mstatus = MEMO_CACHE_BYPASS_MODE;
+			}
+
+			slot = node->ss.ps.ps_ResultTupleSlot;
+			ExecCopySlot(slot, outerslot);
+			return slot;
+
+		case MEMO_CACHE_FETCH_NEXT_TUPLE:
+			return shared_cache_next_tuple(node);
+
+		case MEMO_CACHE_BYPASS_MODE:
+			outerslot = ExecProcNode(outerPlanState(node));
+			if (TupIsNull(outerslot))
+			{
+				node->mstatus = MEMO_END_OF_SCAN;
+				return NULL;
+			}
+
+			slot = node->ss.ps.ps_ResultTupleSlot;
+			ExecCopySlot(slot, outerslot);
+			return slot;
+
+		case MEMO_END_OF_SCAN:
+			return NULL;
+
+		default:
+			elog(ERROR, "unrecognized memoize state: %d",
+				 (int) node->mstatus);
+			return NULL;
+	}							/* switch */
+}
+
 MemoizeState *
 ExecInitMemoize(Memoize *node, EState *estate, int eflags)
 {
@@ -1030,6 +1707,8 @@ ExecInitMemoize(Memoize *node, EState *estate, int eflags)
 	dlist_init(&mstate->lru_list);
 	mstate->last_tuple = NULL;
 	mstate->entry = NULL;
+	mstate->inflation = 0;
+	mstate->shared = NULL;
 
 	/*
 	 * Mark if we can assume the cache entry is completed after we get the
@@ -1169,63 +1848,139 @@ ExecEstimateCacheEntryOverheadBytes(double ntuples)
  * ----------------------------------------------------------------
  */
 
+/*
+ * Can the processes of a parallel query share the node's cache?  Only if
+ * the subplan's results depend on no parameters but the cache keys; others,
+ * such as those of a correlated subquery run within each process, could
+ * have different values in different processes.
+ */
+static bool
+ExecMemoizeCanShare(MemoizeState *node)
+{
+	return memoize_shared_cache &&
+		bms_is_subset(outerPlanState(node)->plan->extParam,
+					  node->keyparamids);
+}
+
+/*
+ * Size of the node's DSM chunk: the ParallelMemoizeState, followed by the
+ * SharedMemoizeInfo if instrumenting.
+ */
+static Size
+ExecMemoizeDSMSize(MemoizeState *node, ParallelContext *pcxt)
+{
+	Size		size = PARALLEL_MEMOIZE_INFO_OFFSET;
+
+	if (node->ss.ps.instrument)
+	{
+		size = add_size(size, offsetof(SharedMemoizeInfo, sinstrument));
+		size = add_size(size, mul_size(pcxt->nworkers,
+									   sizeof(MemoizeInstrumentation)));
+	}
+	return size;
+}
+
  /* ----------------------------------------------------------------
   *		ExecMemoizeEstimate
   *
-  *		Estimate space required to propagate memoize statistics.
+  *		Estimate space required to propagate memoize statistics and to
+  *		share the cache.
   * ----------------------------------------------------------------
   */
 void
 ExecMemoizeEstimate(MemoizeState *node, ParallelContext *pcxt)
 {
-	Size		size;
-
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need this if neither instrumenting nor sharing, or no workers */
+	if ((!node->ss.ps.instrument && !ExecMemoizeCanShare(node)) ||
+		pcxt->nworkers == 0)
 		return;
 
-	size = mul_size(pcxt->nworkers, sizeof(MemoizeInstrumentation));
-	size = add_size(size, offsetof(SharedMemoizeInfo, sinstrument));
-	shm_toc_estimate_chunk(&pcxt->estimator, size);
+	shm_toc_estimate_chunk(&pcxt->estimator, ExecMemoizeDSMSize(node, pcxt));
 	shm_toc_estimate_keys(&pcxt->estimator, 1);
 }
 
 /* ----------------------------------------------------------------
  *		ExecMemoizeInitializeDSM
  *
- *		Initialize DSM space for memoize statistics.
+ *		Initialize DSM space for memoize statistics, and create the shared
+ *		cache.
  * ----------------------------------------------------------------
  */
 void
 ExecMemoizeInitializeDSM(MemoizeState *node, ParallelContext *pcxt)
 {
+	ParallelMemoizeState *pstate;
 	Size		size;
 
-	/* don't need this if not instrumenting or no workers */
-	if (!node->ss.ps.instrument || pcxt->nworkers == 0)
+	/* don't need this if neither instrumenting nor sharing, or no workers */
+	if ((!node->ss.ps.instrument && !ExecMemoizeCanShare(node)) ||
+		pcxt->nworkers == 0)
 		return;
 
-	size = offsetof(SharedMemoizeInfo, sinstrument)
-		+ pcxt->nworkers * sizeof(MemoizeInstrumentation);
-	node->shared_info = shm_toc_allocate(pcxt->toc, size);
+	size = ExecMemoizeDSMSize(node, pcxt);
+	pstate = shm_toc_allocate(pcxt->toc, size);
 	/* ensure any unfilled slots will contain zeroes */
-	memset(node->shared_info, 0, size);
-	node->shared_info->num_workers = pcxt->nworkers;
-	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id,
-				   node->shared_info);
+	memset(pstate, 0, size);
+
+	if (node->ss.ps.instrument)
+	{
+		pstate->has_instrumentation = true;
+		node->shared_info = (SharedMemoizeInfo *)
+			((char *) pstate + PARALLEL_MEMOIZE_INFO_OFFSET);
+		node->shared_info->num_workers = pcxt->nworkers;
+	}
+
+	if (ExecMemoizeCanShare(node))
+	{
+		dsa_area   *area = node->ss.ps.state->es_query_dsa;
+		dshash_table *table;
+
+		Assert(area != NULL);
+		table = dshash_create(area, &shared_memoize_params, node);
+
+		pstate->has_cache = true;
+		pstate->cache_handle = dshash_get_hash_table_handle(table);
+		/* the cache stands in for one private cache per process */
+		pstate->mem_limit = node->mem_limit * (pcxt->nworkers + 1);
+		pg_atomic_init_u64(&pstate->mem_used, 0);
+		pg_atomic_init_u64(&pstate->inflation, 0);
+		pg_atomic_init_flag(&pstate->evicting);
+
+		shared_cache_attach(node, pstate, area, table);
+	}
+
+	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, pstate);
 }
 
 /* ----------------------------------------------------------------
  *		ExecMemoizeInitializeWorker
  *
- *		Attach worker to DSM space for memoize statistics.
+ *		Attach worker to DSM space for memoize statistics and to the shared
+ *		cache.
  * ----------------------------------------------------------------
  */
 void
 ExecMemoizeInitializeWorker(MemoizeState *node, ParallelWorkerContext *pwcxt)
 {
-	node->shared_info =
-		shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	ParallelMemoizeState *pstate;
+
+	pstate = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, true);
+	if (pstate == NULL)
+		return;
+
+	if (pstate->has_instrumentation)
+		node->shared_info = (SharedMemoizeInfo *)
+			((char *) pstate + PARALLEL_MEMOIZE_INFO_OFFSET);
+
+	if (pstate->has_cache)
+	{
+		dsa_area   *area = node->ss.ps.state->es_query_dsa;
+		dshash_table *table;
+
+		table = dshash_attach(area, &shared_memoize_params,
+							  pstate->cache_handle, node);
+		shared_cache_attach(node, pstate, area, table);
+	}
 }
 
 /* ----------------------------------------------------------------
@@ -24,6 +24,14 @@
  *		to a common sort key.  The MergeAppend node merges these streams
  *		to produce output sorted the same way.
  *
+ *		If the MergeAppend is bounded (see ExecSetTupleBound), its Sort
+ *		children are bounded too.  Since the children are started one
+ *		after the other, once a child has sorted at least bound tuples in
+ *		memory, its bound'th tuple is a threshold that no tuple the parent
+ *		needs can sort after.  Sort children started later discard input
+ *		tuples beyond the lowest such threshold seen so far, rather than
+ *		sorting them.
+ *
  *		MergeAppend nodes don't make use of their left and right
  *		subtrees, rather they maintain a list of subplans so
  *		a typical MergeAppend node looks like this in the plan tree:
@@ -41,6 +49,7 @@
 #include "executor/execdebug.h"
 #include "executor/execPartition.h"
 #include "executor/nodeMergeAppend.h"
+#include "executor/nodeSort.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
 
@@ -53,6 +62,11 @@ typedef int32 SlotNumber;
 
 static TupleTableSlot *ExecMergeAppend(PlanState *pstate);
 static int	heap_compare_slots(Datum a, Datum b, void *arg);
+static int	compare_slots(MergeAppendState *node, TupleTableSlot *s1,
+						  TupleTableSlot *s2);
+static SortThreshold *merge_append_threshold(MergeAppendState *node);
+static void merge_append_tighten_threshold(MergeAppendState *node,
+										   PlanState *subnode);
 
 
 /* ----------------------------------------------------------------
@@ -186,6 +200,9 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 	 * initialize to show we have not run the subplans yet
 	 */
 	mergestate->ms_initialized = false;
+	mergestate->ms_bound = -1;
+	mergestate->ms_threshold = NULL;
+	mergestate->ms_peekslot = NULL;
 
 	return mergestate;
 }
@@ -201,6 +218,7 @@ ExecMergeAppend(PlanState *pstate)
 {
 	MergeAppendState *node = castNode(MergeAppendState, pstate);
 	TupleTableSlot *result;
+	SortThreshold *threshold;
 	SlotNumber	i;
 
 	CHECK_FOR_INTERRUPTS();
@@ -222,14 +240,25 @@ ExecMergeAppend(PlanState *pstate)
 
 		/*
 		 * First time through: pull the first tuple from each valid subplan,
-		 * and set up the heap.
+		 * and set up the heap.  If we are bounded, let each Sort child prune
+		 * its input by what the children before it have sorted.
 		 */
+		threshold = merge_append_threshold(node);
 		i = -1;
 		while ((i = bms_next_member(node->ms_valid_subplans, i)) >= 0)
 		{
-			node->ms_slots[i] = ExecProcNode(node->mergeplans[i]);
+			PlanState  *subnode = node->mergeplans[i];
+
+			if (IsA(subnode, SortState))
+				((SortState *) subnode)->threshold = threshold;
+
+			node->ms_slots[i] = ExecProcNode(subnode);
 			if (!TupIsNull(node->ms_slots[i]))
+			{
 				binaryheap_add_unordered(node->ms_heap, Int32GetDatum(i));
+				if (threshold)
+					merge_append_tighten_threshold(node, subnode);
+			}
 		}
 		binaryheap_build(node->ms_heap);
 		node->ms_initialized = true;
@@ -275,9 +304,19 @@ heap_compare_slots(Datum a, Datum b, void *arg)
 	MergeAppendState *node = (MergeAppendState *) arg;
 	SlotNumber	slot1 = DatumGetInt32(a);
 	SlotNumber	slot2 = DatumGetInt32(b);
+	int			compare;
 
-	TupleTableSlot *s1 = node->ms_slots[slot1];
-	TupleTableSlot *s2 = node->ms_slots[slot2];
+	compare = compare_slots(node, node->ms_slots[slot1], node->ms_slots[slot2]);
+	INVERT_COMPARE_RESULT(compare);
+	return compare;
+}
+
+/*
+ * Compare the tuples in the two given slots, by the MergeAppend's sort keys.
+ */
+static int
+compare_slots(MergeAppendState *node, TupleTableSlot *s1, TupleTableSlot *s2)
+{
 	int			nkey;
 
 	Assert(!TupIsNull(s1));
@@ -300,14 +339,65 @@ heap_compare_slots(Datum a, Datum b, void *arg)
 									  datum2, isNull2,
 									  sortKey);
 		if (compare != 0)
-		{
-			INVERT_COMPARE_RESULT(compare);
 			return compare;
-		}
 	}
 	return 0;
 }
 
+/*
+ * Get the threshold to share with our Sort children, emptied, or NULL if we
+ * are not bounded or there is nothing to prune by.
+ */
+static SortThreshold *
+merge_append_threshold(MergeAppendState *node)
+{
+	SortThreshold *threshold = node->ms_threshold;
+
+	if (node->ms_bound <= 0 || bms_num_members(node->ms_valid_subplans) < 2)
+		return NULL;
+
+	if (threshold == NULL)
+	{
+		EState	   *estate = node->ps.state;
+		TupleDesc	tupdesc = ExecGetResultType(&node->ps);
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+		threshold = (SortThreshold *) palloc(sizeof(SortThreshold));
+		threshold->slot = ExecInitExtraTupleSlot(estate, tupdesc,
+												 &TTSOpsMinimalTuple);
+		threshold->nkeys = node->ms_nkeys;
+		threshold->sortkeys = node->ms_sortkeys;
+		node->ms_threshold = threshold;
+		node->ms_peekslot = ExecInitExtraTupleSlot(estate, tupdesc,
+												   &TTSOpsMinimalTuple);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	ExecClearTuple(threshold->slot);
+	return threshold;
+}
+
+/*
+ * After a child has produced its first tuple, lower the threshold to the
+ * child's bound'th tuple, if it is a Sort that has that many tuples in memory.
+ */
+static void
+merge_append_tighten_threshold(MergeAppendState *node, PlanState *subnode)
+{
+	SortThreshold *threshold = node->ms_threshold;
+
+	if (!IsA(subnode, SortState) ||
+		!ExecSortPeekTuple((SortState *) subnode, node->ms_bound,
+						   node->ms_peekslot))
+		return;
+
+	if (TupIsNull(threshold->slot) ||
+		compare_slots(node, node->ms_peekslot, threshold->slot) < 0)
+		ExecCopySlot(threshold->slot, node->ms_peekslot);
+	ExecClearTuple(node->ms_peekslot);
+}
+
 /* ----------------------------------------------------------------
  *		ExecEndMergeAppend
  *
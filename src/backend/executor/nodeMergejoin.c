@@ -93,11 +93,18 @@
 #include "postgres.h"
 
 #include "access/nbtree.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_index.h"
 #include "executor/execdebug.h"
+#include "executor/nodeIndexonlyscan.h"
+#include "executor/nodeIndexscan.h"
 #include "executor/nodeMergejoin.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/rel.h"
 
 
 /*
@@ -149,6 +156,31 @@ typedef enum
 } MJEvalResult;
 
 
+/*
+ * Seeking an input that lags behind the other.  When an input is a forward
+ * btree scan whose first index column is the first merge key, and the join
+ * needn't emit that input's unmatched tuples, we don't have to read through
+ * a long run of its tuples that are lower than the other input's current
+ * key.  After skipping MJ_SEEK_THRESHOLD of them in a row, we restart the
+ * index scan at the first tuple >= the other input's key, which takes one
+ * descent of the btree.  That pays off when the other input's keys are
+ * sparse.  (Inputs that can only be read in order leave us nothing better
+ * than stepping through them.)
+ */
+typedef struct MergeJoinSeekData
+{
+	PlanState  *scan;			/* IndexScanState or IndexOnlyScanState */
+	ScanKeyData key;			/* first index column >= other input's key */
+	int16		typlen;			/* type info of the other input's key */
+	bool		typbyval;
+	MemoryContext cxt;			/* holds the copy of the key's argument */
+	int			nskipped;		/* tuples skipped in a row */
+}			MergeJoinSeekData;
+
+/* GUC parameter */
+bool		mergejoin_seek = true;
+
+
 #define MarkInnerTuple(innerTupleSlot, mergestate) \
 	ExecCopySlot((mergestate)->mj_MarkedTupleSlot, (innerTupleSlot))
 
@@ -444,6 +476,174 @@ MJCompare(MergeJoinState *mergestate)
 	return result;
 }
 
+/*
+ * MJInitSeek
+ *
+ * Decide whether we can seek the outer or inner input of the join (see
+ * MergeJoinSeekData), and set that up if so.  The input's merge expression
+ * for the first clause must be its first index column, the index must be
+ * in the order the join wants, and its opfamily must have a >= operator
+ * against the other input's key type.
+ */
+static MergeJoinSeek
+MJInitSeek(MergeJoinState *mergestate, MergeJoin *node, bool outer)
+{
+	PlanState  *child;
+	Relation	indexRel;
+	Index		scanrelid;
+	OpExpr	   *qual;
+	Expr	   *expr;
+	Expr	   *otherexpr;
+	Var		   *var;
+	TargetEntry *tle;
+	Oid			othertype;
+	Oid			opno;
+	MergeJoinSeek seek;
+
+	if (!mergejoin_seek || node->mergeclauses == NIL)
+		return NULL;
+
+	/* we must read all the tuples of an input we fill nulls for */
+	if (outer ? mergestate->mj_FillOuter : mergestate->mj_FillInner)
+		return NULL;
+
+	/* only ascending merges */
+	if (node->mergeStrategies[0] != BTLessStrategyNumber)
+		return NULL;
+
+	child = outer ? outerPlanState(mergestate) : innerPlanState(mergestate);
+	if (child->plan->parallel_aware)
+		return NULL;
+	if (IsA(child, IndexScanState))
+	{
+		IndexScan  *plan = (IndexScan *) child->plan;
+
+		if (plan->indexorderby != NIL ||
+			!ScanDirectionIsForward(plan->indexorderdir))
+			return NULL;
+		indexRel = ((IndexScanState *) child)->iss_RelationDesc;
+		scanrelid = plan->scan.scanrelid;
+	}
+	else if (IsA(child, IndexOnlyScanState))
+	{
+		IndexOnlyScan *plan = (IndexOnlyScan *) child->plan;
+
+		if (plan->indexorderby != NIL ||
+			!ScanDirectionIsForward(plan->indexorderdir))
+			return NULL;
+		indexRel = ((IndexOnlyScanState *) child)->ioss_RelationDesc;
+		scanrelid = INDEX_VAR;
+	}
+	else
+		return NULL;
+
+	/* index isn't opened for EXPLAIN */
+	if (indexRel == NULL)
+		return NULL;
+	if (indexRel->rd_rel->relam != BTREE_AM_OID ||
+		(indexRel->rd_indoption[0] & INDOPTION_DESC) != 0 ||
+		indexRel->rd_opfamily[0] != node->mergeFamilies[0] ||
+		indexRel->rd_indcollation[0] != node->mergeCollations[0])
+		return NULL;
+
+	/* Is the input's merge key its first index column? */
+	qual = linitial_node(OpExpr, node->mergeclauses);
+	expr = outer ? linitial(qual->args) : lsecond(qual->args);
+	otherexpr = outer ? lsecond(qual->args) : linitial(qual->args);
+	while (IsA(expr, RelabelType))
+		expr = ((RelabelType *) expr)->arg;
+	if (!IsA(expr, Var))
+		return NULL;
+	var = (Var *) expr;
+	if (var->varno != (outer ? OUTER_VAR : INNER_VAR) ||
+		var->varattno < 1 ||
+		var->varattno > list_length(child->plan->targetlist))
+		return NULL;
+	tle = list_nth_node(TargetEntry, child->plan->targetlist,
+						var->varattno - 1);
+	if (!IsA(tle->expr, Var))
+		return NULL;
+	var = (Var *) tle->expr;
+	if (var->varno != scanrelid ||
+		var->varattno != (scanrelid == INDEX_VAR ? 1 :
+						  indexRel->rd_index->indkey.values[0]))
+		return NULL;
+
+	othertype = exprType((Node *) otherexpr);
+	opno = get_opfamily_member(node->mergeFamilies[0],
+							   indexRel->rd_opcintype[0], othertype,
+							   BTGreaterEqualStrategyNumber);
+	if (!OidIsValid(opno))
+		return NULL;
+
+	seek = (MergeJoinSeek) palloc0(sizeof(MergeJoinSeekData));
+	seek->scan = child;
+	ScanKeyEntryInitialize(&seek->key,
+						   0,
+						   1,	/* first index column */
+						   BTGreaterEqualStrategyNumber,
+						   othertype,
+						   node->mergeCollations[0],
+						   get_opcode(opno),
+						   (Datum) 0);	/* filled in by MJSeek */
+	get_typlenbyval(othertype, &seek->typlen, &seek->typbyval);
+	seek->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "MergeJoin seek",
+									  ALLOCSET_SMALL_SIZES);
+	seek->nskipped = 0;
+
+	if (IsA(child, IndexScanState))
+		ExecIndexScanReserveSeekKey((IndexScanState *) child);
+	else
+		ExecIndexOnlyScanReserveSeekKey((IndexOnlyScanState *) child);
+
+	return seek;
+}
+
+/*
+ * MJSeek
+ *
+ * Called before advancing a seekable input past a tuple that is lower than
+ * the other input's current tuple.  Once we have done that enough times in a
+ * row, seek the input to the other input's first merge key instead.  That's
+ * only safe if the current tuple is lower on the first merge key, else the
+ * seek could move the input backwards.
+ */
+static void
+MJSeek(MergeJoinState *mergestate, MergeJoinSeek seek, bool outer)
+{
+	MergeJoinClause clause = &mergestate->mj_Clauses[0];
+	MemoryContext oldContext;
+	int			cmp;
+
+	if (++seek->nskipped < MJ_SEEK_THRESHOLD)
+		return;
+	seek->nskipped = 0;
+
+	if (clause->lisnull || clause->risnull)
+		return;
+
+	oldContext = MemoryContextSwitchTo(mergestate->js.ps.ps_ExprContext->ecxt_per_tuple_memory);
+	cmp = ApplySortComparator(clause->ldatum, false,
+							  clause->rdatum, false,
+							  &clause->ssup);
+	MemoryContextSwitchTo(oldContext);
+	if (outer ? cmp >= 0 : cmp <= 0)
+		return;
+
+	/* the scan keeps pointing at the argument until the next seek */
+	MemoryContextReset(seek->cxt);
+	oldContext = MemoryContextSwitchTo(seek->cxt);
+	seek->key.sk_argument = datumCopy(outer ? clause->rdatum : clause->ldatum,
+									  seek->typbyval, seek->typlen);
+	MemoryContextSwitchTo(oldContext);
+
+	if (IsA(seek->scan, IndexScanState))
+		ExecIndexScanSeek((IndexScanState *) seek->scan, &seek->key);
+	else
+		ExecIndexOnlyScanSeek((IndexOnlyScanState *) seek->scan, &seek->key);
+}
+
 
 /*
  * Generate a fake join tuple with nulls for the inner tuple,
@@ -1190,6 +1390,12 @@ ExecMergeJoin(PlanState *pstate)
 				compareResult = MJCompare(node);
 				MJ_DEBUG_COMPARE(compareResult);
 
+				/* only count tuples skipped in a row on one side */
+				if (node->mj_OuterSeek && compareResult >= 0)
+					node->mj_OuterSeek->nskipped = 0;
+				if (node->mj_InnerSeek && compareResult <= 0)
+					node->mj_InnerSeek->nskipped = 0;
+
 				if (compareResult == 0)
 				{
 					if (!node->mj_SkipMarkRestore)
@@ -1231,6 +1437,10 @@ ExecMergeJoin(PlanState *pstate)
 						return result;
 				}
 
+				/* skip ahead in the outer index, if worthwhile */
+				if (node->mj_OuterSeek)
+					MJSeek(node, node->mj_OuterSeek, true);
+
 				/*
 				 * now we get the next outer tuple, if any
 				 */
@@ -1297,6 +1507,10 @@ ExecMergeJoin(PlanState *pstate)
 				if (node->mj_ExtraMarks)
 					ExecMarkPos(innerPlan);
 
+				/* skip ahead in the inner index, if worthwhile */
+				if (node->mj_InnerSeek)
+					MJSeek(node, node->mj_InnerSeek, false);
+
 				/*
 				 * now we get the next inner tuple, if any
 				 */
@@ -1612,6 +1826,10 @@ ExecInitMergeJoin(MergeJoin *node, EState *estate, int eflags)
 											node->mergeNullsFirst,
 											(PlanState *) mergestate);
 
+	/* see if we can seek either input */
+	mergestate->mj_OuterSeek = MJInitSeek(mergestate, node, true);
+	mergestate->mj_InnerSeek = MJInitSeek(mergestate, node, false);
+
 	/*
 	 * initialize join state
 	 */
@@ -1677,6 +1895,10 @@ ExecReScanMergeJoin(MergeJoinState *node)
 	node->mj_MatchedInner = false;
 	node->mj_OuterTupleSlot = NULL;
 	node->mj_InnerTupleSlot = NULL;
+	if (node->mj_OuterSeek)
+		node->mj_OuterSeek->nskipped = 0;
+	if (node->mj_InnerSeek)
+		node->mj_InnerSeek->nskipped = 0;
 
 	/*
 	 * if chgParam of subnodes is not null then plans will be re-scanned by
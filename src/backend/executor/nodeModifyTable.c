@@ -366,7 +366,8 @@ ExecInitStoredGenerated(ResultRelInfo *resultRelInfo,
 	 * columns.
 	 */
 	if (cmdtype == CMD_UPDATE &&
-		!(rel->trigdesc && rel->trigdesc->trig_update_before_row))
+		!(RelationGetTriggerDesc(rel) &&
+		  rel->trigdesc->trig_update_before_row))
 		updatedCols = ExecGetUpdatedCols(resultRelInfo, estate);
 	else
 		updatedCols = NULL;
@@ -17,14 +17,137 @@
  *		ExecNestLoop	 - process a nestloop join of two plans
  *		ExecInitNestLoop - initialize the join
  *		ExecEndNestLoop  - shut down the join
+ *
+ *		A nested loop can switch to hashing its inner side at run time if
+ *		the outer side is much bigger than estimated; see "Switching to
+ *		hashing" below.
  */
 
 #include "postgres.h"
 
+#include "access/nbtree.h"
 #include "executor/execdebug.h"
+#include "executor/nodeHash.h"
+#include "executor/nodeIndexscan.h"
 #include "executor/nodeNestloop.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "port/pg_bitutils.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/sortsupport.h"
+
+
+/*
+ * Batched inner index probes.  When the inner side is a btree index scan
+ * whose only use of the outer tuple is an "indexcol = $param" key, calling
+ * ExecReScan for every outer tuple descends the btree once per outer tuple.
+ * Instead we read up to nestloop_batch_size outer tuples ahead, sort and
+ * deduplicate their parameter values, and scan the index once with the key
+ * turned into "indexcol = ANY(values)", which nbtree handles natively.  The
+ * inner tuples are kept in memory, chained by the value they matched, and
+ * then joined to the batch's outer tuples in their original order, so the
+ * output is the same as without batching.  If the inner tuples of a batch
+ * don't fit in work_mem, we fall back to rescanning per outer tuple.
+ */
+typedef struct NestLoopBatchData
+{
+	int			maxouter;		/* outer tuples per batch */
+	int			paramno;		/* the PARAM_EXEC param we set */
+	AttrNumber	outerattno;		/* its value in the outer tuple */
+	ScanKey		scankey;		/* inner index key that uses the param */
+	AttrNumber	scanattno;		/* its column in the inner scan tuple */
+	Oid			elemtype;		/* type of the param values */
+	int16		elemlen;
+	bool		elembyval;
+	char		elemalign;
+	SortSupportData sortkey;	/* to sort the param values */
+	SortSupportData probekey;	/* to compare inner columns with them */
+	bool		streaming;		/* gave up on batching, rescan per tuple */
+	TupleTableSlot *innerslot;	/* holds the stored inner tuples */
+	MemoryContext cxt;			/* per-batch storage */
+
+	/* the current batch of outer tuples */
+	TupleTableSlot **outerslots;
+	Datum	   *outervalues;	/* their param values */
+	bool	   *outerisnull;
+	int		   *outerkey;		/* index of each value in keys[], or -1 */
+	int			nouter;
+	int			curouter;		/* the outer tuple being joined */
+
+	/* the distinct param values, sorted, and their inner tuples */
+	Datum	   *keys;
+	int			nkeys;
+	int		   *keyfirst;		/* first and last inner tuple of each key */
+	int		   *keylast;
+	MinimalTuple *innertuples;
+	int		   *innernext;		/* next inner tuple of the same key, or -1 */
+	int			ninner;
+	int			maxinner;
+	int			curinner;		/* next inner tuple to join, or -1 */
+} NestLoopBatchData;
+
+/* GUC parameter */
+int			nestloop_batch_size = 64;
+
+static NestLoopBatch ExecNestLoopInitBatch(NestLoopState *nlstate,
+										   NestLoop *node);
+static TupleTableSlot *ExecNestLoopBatchNextOuter(NestLoopState *node);
+static TupleTableSlot *ExecNestLoopBatchNextInner(NestLoopState *node);
+
+/*
+ * Switching to hashing.  A nested loop without parameters rescans its inner
+ * side for every outer tuple, which is fine when the planner has it right
+ * that only a few outer tuples arrive, and terrible when it's wrong by
+ * orders of magnitude.  So once the outer side has produced
+ * adaptive_nestloop_factor times as many tuples as estimated, we read the
+ * inner side one last time into a hash table on the join's hashable
+ * clauses (chosen by the planner, see NestLoop), and from then on each
+ * outer tuple only looks at the inner tuples in its hash chain.  The
+ * joinquals are still checked as usual, so hash collisions don't matter,
+ * and the outer-join, semi- and antijoin logic stays the same.  If the
+ * inner side doesn't fit in hash memory, we stay a plain nested loop.
+ */
+#define ADAPTIVE_NESTLOOP_MIN_OUTER		1000
+
+typedef struct NestLoopHashEntry
+{
+	struct NestLoopHashEntry *next; /* next entry in the same bucket */
+	uint32		hashvalue;
+	MinimalTuple tuple;
+} NestLoopHashEntry;
+
+typedef struct NestLoopHashData
+{
+	int64		threshold;		/* switch after this many outer tuples */
+	int64		nouter;			/* outer tuples read so far */
+	bool		tried;			/* built the table, or gave up */
+	bool		active;			/* the table is in use */
+	int			nkeys;			/* number of hash clauses */
+	ExprState **outerkeys;		/* outer argument of each clause */
+	ExprState **innerkeys;		/* inner argument of each clause */
+	FmgrInfo   *outerhashfns;
+	FmgrInfo   *innerhashfns;
+	Oid		   *collations;
+	TupleTableSlot *innerslot;	/* holds the stored inner tuples */
+	MemoryContext cxt;			/* the hash table */
+	NestLoopHashEntry **buckets;
+	uint32		nbuckets;		/* always a power of 2 */
+	int64		ntuples;
+	NestLoopHashEntry *cur;		/* next candidate for the outer tuple */
+	uint32		curhash;		/* hash value of the outer tuple */
+} NestLoopHashData;
+
+/* GUC parameter */
+double		adaptive_nestloop_factor = 100.0;
+
+static NestLoopHash ExecNestLoopInitHash(NestLoopState *nlstate,
+										 NestLoop *node);
+static bool ExecNestLoopHashNewOuter(NestLoopState *node);
+static TupleTableSlot *ExecNestLoopHashNextInner(NestLoopState *node);
+static void ExecNestLoopResetHash(NestLoopState *node);
 
 
 /* ----------------------------------------------------------------
@@ -103,7 +226,18 @@ ExecNestLoop(PlanState *pstate)
 		 * If we don't have an outer tuple, get the next one and reset the
 		 * inner scan.
 		 */
-		if (node->nl_NeedNewOuter)
+		if (node->nl_NeedNewOuter && node->nl_Batch)
+		{
+			/* the batch sets up the inner side for the new outer tuple */
+			outerTupleSlot = ExecNestLoopBatchNextOuter(node);
+			if (TupIsNull(outerTupleSlot))
+				return NULL;
+
+			econtext->ecxt_outertuple = outerTupleSlot;
+			node->nl_NeedNewOuter = false;
+			node->nl_MatchedOuter = false;
+		}
+		else if (node->nl_NeedNewOuter)
 		{
 			ENL1_printf("getting new outer tuple");
 			outerTupleSlot = ExecProcNode(outerPlan);
@@ -146,10 +280,14 @@ ExecNestLoop(PlanState *pstate)
 			}
 
 			/*
-			 * now rescan the inner plan
+			 * now rescan the inner plan, unless we've switched to hashing it
+			 * (there are no nestParams in that case)
 			 */
-			ENL1_printf("rescanning inner plan");
-			ExecReScan(innerPlan);
+			if (node->nl_Hash == NULL || !ExecNestLoopHashNewOuter(node))
+			{
+				ENL1_printf("rescanning inner plan");
+				ExecReScan(innerPlan);
+			}
 		}
 
 		/*
@@ -157,7 +295,12 @@ ExecNestLoop(PlanState *pstate)
 		 */
 		ENL1_printf("getting new inner tuple");
 
-		innerTupleSlot = ExecProcNode(innerPlan);
+		if (node->nl_Batch)
+			innerTupleSlot = ExecNestLoopBatchNextInner(node);
+		else if (node->nl_Hash && node->nl_Hash->active)
+			innerTupleSlot = ExecNestLoopHashNextInner(node);
+		else
+			innerTupleSlot = ExecProcNode(innerPlan);
 		econtext->ecxt_innertuple = innerTupleSlot;
 
 		if (TupIsNull(innerTupleSlot))
@@ -340,6 +483,12 @@ ExecInitNestLoop(NestLoop *node, EState *estate, int eflags)
 				 (int) node->join.jointype);
 	}
 
+	/* see if we can probe the inner index in batches */
+	nlstate->nl_Batch = ExecNestLoopInitBatch(nlstate, node);
+
+	/* and whether we can switch to hashing the inner side */
+	nlstate->nl_Hash = ExecNestLoopInitHash(nlstate, node);
+
 	/*
 	 * finally, wipe the current outer tuple clean.
 	 */
@@ -408,4 +557,702 @@ ExecReScanNestLoop(NestLoopState *node)
 
 	node->nl_NeedNewOuter = true;
 	node->nl_MatchedOuter = false;
+
+	/* forget the current batch */
+	if (node->nl_Batch)
+	{
+		node->nl_Batch->nouter = 0;
+		node->nl_Batch->curouter = 0;
+		node->nl_Batch->curinner = -1;
+	}
+
+	/*
+	 * The hash table stays valid unless a param the join depends on has
+	 * changed; otherwise start over as a plain nested loop.
+	 */
+	if (node->nl_Hash)
+	{
+		if (node->js.ps.chgParam != NULL)
+			ExecNestLoopResetHash(node);
+		else
+			node->nl_Hash->cur = NULL;
+	}
+}
+
+/*
+ * Count the references to PARAM_EXEC param *paramid in an expression tree,
+ * into context[1].
+ */
+static bool
+count_param_refs_walker(Node *node, int *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param) &&
+		((Param *) node)->paramkind == PARAM_EXEC &&
+		((Param *) node)->paramid == context[0])
+		context[1]++;
+	return expression_tree_walker(node, count_param_refs_walker, context);
+}
+
+static int
+count_param_refs(Node *node, int paramid)
+{
+	int			context[2];
+
+	context[0] = paramid;
+	context[1] = 0;
+	(void) count_param_refs_walker(node, context);
+	return context[1];
+}
+
+/*
+ * ExecNestLoopInitBatch
+ *
+ * Set up batched inner index probes, if the join allows them.  The join
+ * must have a single parameter, used by the inner index or index-only scan
+ * only in an equality index qual (see ExecIndexFindParamKey), so the inner
+ * tuples that match a value don't depend on the outer tuple otherwise.
+ */
+static NestLoopBatch
+ExecNestLoopInitBatch(NestLoopState *nlstate, NestLoop *node)
+{
+	EState	   *estate = nlstate->js.ps.state;
+	PlanState  *innerPlan = innerPlanState(nlstate);
+	Plan	   *innerNode = innerPlan->plan;
+	NestLoopParam *nlp;
+	ScanKey		scankey;
+	AttrNumber	scanattno;
+	Relation	index;
+	Oid			opfamily;
+	Oid			opcintype;
+	Oid			elemtype;
+	Oid			sortproc;
+	Oid			probeproc;
+	int			nparamrefs;
+	NestLoopBatch batch;
+	int			i;
+
+	if (nestloop_batch_size <= 1 ||
+		list_length(node->nestParams) != 1 ||
+		estate->es_epq_active != NULL ||
+		innerNode->parallel_aware ||
+		innerNode->initPlan != NIL)
+		return NULL;
+	nlp = linitial_node(NestLoopParam, node->nestParams);
+
+	if (!ExecIndexFindParamKey(innerPlan, nlp->paramno,
+							   &scankey, &scanattno, &index))
+		return NULL;
+
+	/* The param mustn't be used anywhere else in the inner scan. */
+	nparamrefs = count_param_refs((Node *) innerNode->targetlist,
+								  nlp->paramno) +
+		count_param_refs((Node *) innerNode->qual, nlp->paramno);
+	if (IsA(innerNode, IndexScan))
+		nparamrefs +=
+			count_param_refs((Node *) ((IndexScan *) innerNode)->indexqual,
+							 nlp->paramno) +
+			count_param_refs((Node *) ((IndexScan *) innerNode)->indexorderby,
+							 nlp->paramno);
+	else
+		nparamrefs +=
+			count_param_refs((Node *) ((IndexOnlyScan *) innerNode)->indexqual,
+							 nlp->paramno) +
+			count_param_refs((Node *) ((IndexOnlyScan *) innerNode)->indexorderby,
+							 nlp->paramno);
+	if (nparamrefs != 1)
+		return NULL;
+
+	/* we need to sort the values, and compare the index column with them */
+	opfamily = index->rd_opfamily[scankey->sk_attno - 1];
+	opcintype = index->rd_opcintype[scankey->sk_attno - 1];
+	elemtype = OidIsValid(scankey->sk_subtype) ? scankey->sk_subtype : opcintype;
+	sortproc = get_opfamily_proc(opfamily, elemtype, elemtype, BTORDER_PROC);
+	probeproc = get_opfamily_proc(opfamily, opcintype, elemtype, BTORDER_PROC);
+	if (!OidIsValid(sortproc) || !OidIsValid(probeproc))
+		return NULL;
+
+	batch = (NestLoopBatch) palloc0(sizeof(NestLoopBatchData));
+	batch->maxouter = nestloop_batch_size;
+	batch->paramno = nlp->paramno;
+	Assert(IsA(nlp->paramval, Var));
+	Assert(nlp->paramval->varno == OUTER_VAR);
+	batch->outerattno = nlp->paramval->varattno;
+	batch->scankey = scankey;
+	batch->scanattno = scanattno;
+	batch->elemtype = elemtype;
+	get_typlenbyvalalign(elemtype, &batch->elemlen, &batch->elembyval,
+						 &batch->elemalign);
+
+	batch->sortkey.ssup_cxt = CurrentMemoryContext;
+	batch->sortkey.ssup_collation = scankey->sk_collation;
+	PrepareSortSupportComparisonShim(sortproc, &batch->sortkey);
+	batch->probekey.ssup_cxt = CurrentMemoryContext;
+	batch->probekey.ssup_collation = scankey->sk_collation;
+	PrepareSortSupportComparisonShim(probeproc, &batch->probekey);
+
+	batch->innerslot = ExecInitExtraTupleSlot(estate,
+											  ExecGetResultType(innerPlan),
+											  &TTSOpsMinimalTuple);
+	batch->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									   "NestLoop batch",
+									   ALLOCSET_DEFAULT_SIZES);
+
+	batch->outerslots = palloc(batch->maxouter * sizeof(TupleTableSlot *));
+	for (i = 0; i < batch->maxouter; i++)
+		batch->outerslots[i] =
+			ExecInitExtraTupleSlot(estate,
+								   ExecGetResultType(outerPlanState(nlstate)),
+								   &TTSOpsMinimalTuple);
+	batch->outervalues = palloc(batch->maxouter * sizeof(Datum));
+	batch->outerisnull = palloc(batch->maxouter * sizeof(bool));
+	batch->outerkey = palloc(batch->maxouter * sizeof(int));
+	batch->keys = palloc(batch->maxouter * sizeof(Datum));
+	batch->keyfirst = palloc(batch->maxouter * sizeof(int));
+	batch->keylast = palloc(batch->maxouter * sizeof(int));
+	batch->curinner = -1;
+
+	return batch;
+}
+
+/* qsort comparator for the param values of a batch */
+static int
+batch_key_cmp(const void *a, const void *b, void *arg)
+{
+	return ApplySortComparator(*(const Datum *) a, false,
+							   *(const Datum *) b, false,
+							   (SortSupport) arg);
+}
+
+/*
+ * Binary-search the batch's keys for a value, using the given comparator;
+ * -1 if it's not there.
+ */
+static int
+batch_key_search(NestLoopBatch batch, Datum value, SortSupport ssup)
+{
+	int			lo = 0;
+	int			hi = batch->nkeys - 1;
+
+	while (lo <= hi)
+	{
+		int			mid = (lo + hi) / 2;
+		int			cmp;
+
+		cmp = ApplySortComparator(value, false, batch->keys[mid], false, ssup);
+		if (cmp == 0)
+			return mid;
+		if (cmp < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	return -1;
+}
+
+/*
+ * ExecNestLoopFillBatch
+ *
+ * Read the next batch of outer tuples, and unless we're streaming, fetch
+ * all the inner tuples matching their param values with one index scan.
+ */
+static void
+ExecNestLoopFillBatch(NestLoopState *node)
+{
+	NestLoopBatch batch = node->nl_Batch;
+	PlanState  *outerPlan = outerPlanState(node);
+	PlanState  *innerPlan = innerPlanState(node);
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	TupleTableSlot *scanslot = ((ScanState *) innerPlan)->ss_ScanTupleSlot;
+	ParamExecData *prm;
+	MemoryContext oldcxt;
+	ArrayType  *array;
+	int			i;
+
+	MemoryContextReset(batch->cxt);
+	batch->nouter = 0;
+	batch->curouter = 0;
+	batch->curinner = -1;
+	batch->nkeys = 0;
+	batch->innertuples = NULL;
+	batch->innernext = NULL;
+	batch->ninner = 0;
+	batch->maxinner = 0;
+
+	while (batch->nouter < batch->maxouter)
+	{
+		TupleTableSlot *slot = ExecProcNode(outerPlan);
+
+		if (TupIsNull(slot))
+			break;
+
+		i = batch->nouter++;
+		ExecCopySlot(batch->outerslots[i], slot);
+		batch->outervalues[i] = slot_getattr(batch->outerslots[i],
+											 batch->outerattno,
+											 &batch->outerisnull[i]);
+		batch->outerkey[i] = -1;
+		if (!batch->outerisnull[i])
+			batch->keys[batch->nkeys++] = batch->outervalues[i];
+	}
+
+	if (batch->streaming || batch->nkeys == 0)
+		return;
+
+	/* sort and deduplicate the values */
+	qsort_arg(batch->keys, batch->nkeys, sizeof(Datum), batch_key_cmp,
+			  &batch->sortkey);
+	if (batch->nkeys > 1)
+	{
+		int			n = 1;
+
+		for (i = 1; i < batch->nkeys; i++)
+		{
+			if (batch_key_cmp(&batch->keys[i], &batch->keys[n - 1],
+							  &batch->sortkey) != 0)
+				batch->keys[n++] = batch->keys[i];
+		}
+		batch->nkeys = n;
+	}
+	for (i = 0; i < batch->nkeys; i++)
+		batch->keyfirst[i] = batch->keylast[i] = -1;
+	for (i = 0; i < batch->nouter; i++)
+	{
+		if (!batch->outerisnull[i])
+			batch->outerkey[i] = batch_key_search(batch, batch->outervalues[i],
+												  &batch->sortkey);
+	}
+
+	/* scan the index once for all the values */
+	oldcxt = MemoryContextSwitchTo(batch->cxt);
+	array = construct_array(batch->keys, batch->nkeys, batch->elemtype,
+							batch->elemlen, batch->elembyval,
+							batch->elemalign);
+	MemoryContextSwitchTo(oldcxt);
+
+	prm = &(econtext->ecxt_param_exec_vals[batch->paramno]);
+	prm->value = PointerGetDatum(array);
+	prm->isnull = false;
+	batch->scankey->sk_flags |= SK_SEARCHARRAY;
+	innerPlan->chgParam = bms_add_member(innerPlan->chgParam, batch->paramno);
+	ExecReScan(innerPlan);
+
+	for (;;)
+	{
+		TupleTableSlot *slot = ExecProcNode(innerPlan);
+		Datum		value;
+		bool		isnull;
+		int			k;
+
+		if (TupIsNull(slot))
+			break;
+
+		/* which value did it match? */
+		value = slot_getattr(scanslot, batch->scanattno, &isnull);
+		if (isnull)
+			continue;
+		k = batch_key_search(batch, value, &batch->probekey);
+		if (k < 0)
+			continue;
+
+		oldcxt = MemoryContextSwitchTo(batch->cxt);
+		if (batch->ninner >= batch->maxinner)
+		{
+			if (batch->maxinner == 0)
+			{
+				batch->maxinner = batch->maxouter;
+				batch->innertuples = palloc(batch->maxinner * sizeof(MinimalTuple));
+				batch->innernext = palloc(batch->maxinner * sizeof(int));
+			}
+			else
+			{
+				batch->maxinner *= 2;
+				batch->innertuples = repalloc(batch->innertuples,
+											  batch->maxinner * sizeof(MinimalTuple));
+				batch->innernext = repalloc(batch->innernext,
+											batch->maxinner * sizeof(int));
+			}
+		}
+		batch->innertuples[batch->ninner] = ExecCopySlotMinimalTuple(slot);
+		MemoryContextSwitchTo(oldcxt);
+
+		batch->innernext[batch->ninner] = -1;
+		if (batch->keylast[k] < 0)
+			batch->keyfirst[k] = batch->ninner;
+		else
+			batch->innernext[batch->keylast[k]] = batch->ninner;
+		batch->keylast[k] = batch->ninner;
+		batch->ninner++;
+
+		/* too much to keep?  probe per outer tuple from now on instead */
+		if (MemoryContextMemAllocated(batch->cxt, true) > work_mem * 1024L)
+		{
+			batch->streaming = true;
+			break;
+		}
+	}
+
+	batch->scankey->sk_flags &= ~SK_SEARCHARRAY;
+}
+
+/*
+ * ExecNestLoopBatchNextOuter
+ *
+ * Return the next outer tuple, reading a new batch if needed, and set up the
+ * inner side for it: either point at its stored inner tuples, or rescan the
+ * inner plan if we're streaming.
+ */
+static TupleTableSlot *
+ExecNestLoopBatchNextOuter(NestLoopState *node)
+{
+	NestLoopBatch batch = node->nl_Batch;
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	ParamExecData *prm;
+	int			i;
+
+	if (++batch->curouter >= batch->nouter)
+	{
+		ExecNestLoopFillBatch(node);
+		if (batch->nouter == 0)
+			return NULL;
+	}
+	i = batch->curouter;
+
+	prm = &(econtext->ecxt_param_exec_vals[batch->paramno]);
+	prm->value = batch->outervalues[i];
+	prm->isnull = batch->outerisnull[i];
+
+	if (batch->streaming)
+	{
+		PlanState  *innerPlan = innerPlanState(node);
+
+		innerPlan->chgParam = bms_add_member(innerPlan->chgParam,
+											 batch->paramno);
+		ExecReScan(innerPlan);
+	}
+	else if (batch->outerkey[i] >= 0)
+		batch->curinner = batch->keyfirst[batch->outerkey[i]];
+	else
+		batch->curinner = -1;
+
+	return batch->outerslots[i];
+}
+
+/*
+ * ExecNestLoopBatchNextInner
+ *
+ * Return the next inner tuple for the current outer tuple, or NULL.
+ */
+static TupleTableSlot *
+ExecNestLoopBatchNextInner(NestLoopState *node)
+{
+	NestLoopBatch batch = node->nl_Batch;
+	int			i = batch->curinner;
+
+	if (batch->streaming)
+		return ExecProcNode(innerPlanState(node));
+
+	if (i < 0)
+		return NULL;
+
+	batch->curinner = batch->innernext[i];
+	return ExecStoreMinimalTuple(batch->innertuples[i], batch->innerslot,
+								 false);
+}
+
+/*
+ * ExecNestLoopInitHash
+ *
+ * Set up switching to hashing, if the planner found hashable join clauses.
+ * The table itself is only built once we decide to switch.
+ */
+static NestLoopHash
+ExecNestLoopInitHash(NestLoopState *nlstate, NestLoop *node)
+{
+	EState	   *estate = nlstate->js.ps.state;
+	Plan	   *outerNode = outerPlan(node);
+	NestLoopHash hash;
+	double		threshold;
+	ListCell   *lc;
+	int			i;
+
+	if (node->adaptive_hashclauses == NIL ||
+		nlstate->nl_Batch != NULL ||
+		estate->es_epq_active != NULL)
+		return NULL;
+
+	hash = (NestLoopHash) palloc0(sizeof(NestLoopHashData));
+
+	threshold = outerNode->plan_rows * adaptive_nestloop_factor;
+	if (threshold < ADAPTIVE_NESTLOOP_MIN_OUTER)
+		hash->threshold = ADAPTIVE_NESTLOOP_MIN_OUTER;
+	else if (threshold >= (double) PG_INT64_MAX)
+		hash->threshold = PG_INT64_MAX;
+	else
+		hash->threshold = (int64) threshold;
+
+	hash->nkeys = list_length(node->adaptive_hashclauses);
+	hash->outerkeys = palloc(hash->nkeys * sizeof(ExprState *));
+	hash->innerkeys = palloc(hash->nkeys * sizeof(ExprState *));
+	hash->outerhashfns = palloc(hash->nkeys * sizeof(FmgrInfo));
+	hash->innerhashfns = palloc(hash->nkeys * sizeof(FmgrInfo));
+	hash->collations = palloc(hash->nkeys * sizeof(Oid));
+
+	i = 0;
+	foreach(lc, node->adaptive_hashclauses)
+	{
+		OpExpr	   *hclause = lfirst_node(OpExpr, lc);
+		Oid			left_hashfn;
+		Oid			right_hashfn;
+
+		Assert(list_length(hclause->args) == 2);
+		if (!get_op_hash_functions(hclause->opno, &left_hashfn, &right_hashfn))
+			elog(ERROR, "could not find hash function for hash operator %u",
+				 hclause->opno);
+		fmgr_info(left_hashfn, &hash->outerhashfns[i]);
+		fmgr_info(right_hashfn, &hash->innerhashfns[i]);
+		hash->outerkeys[i] = ExecInitExpr(linitial(hclause->args),
+										  (PlanState *) nlstate);
+		hash->innerkeys[i] = ExecInitExpr(lsecond(hclause->args),
+										  (PlanState *) nlstate);
+		hash->collations[i] = hclause->inputcollid;
+		i++;
+	}
+
+	hash->innerslot = ExecInitExtraTupleSlot(estate,
+											 ExecGetResultType(innerPlanState(nlstate)),
+											 &TTSOpsMinimalTuple);
+	hash->cxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "NestLoop hash table",
+									  ALLOCSET_DEFAULT_SIZES);
+
+	return hash;
+}
+
+/*
+ * Compute the hash value of the keys for the current outer or inner tuple.
+ * Returns false if a key is NULL, which can't match anything since the
+ * hash clauses are strict.
+ */
+static bool
+nestloop_hash_keys(NestLoopHash hash, ExprContext *econtext, bool outer,
+				   uint32 *hashvalue)
+{
+	ExprState **keys = outer ? hash->outerkeys : hash->innerkeys;
+	FmgrInfo   *hashfns = outer ? hash->outerhashfns : hash->innerhashfns;
+	uint32		hashkey = 0;
+	int			i;
+
+	for (i = 0; i < hash->nkeys; i++)
+	{
+		Datum		keyval;
+		bool		isnull;
+
+		/* combine successive hashkeys by rotating */
+		hashkey = pg_rotate_left32(hashkey, 1);
+
+		keyval = ExecEvalExprSwitchContext(keys[i], econtext, &isnull);
+		if (isnull)
+			return false;
+
+		hashkey ^= DatumGetUInt32(FunctionCall1Coll(&hashfns[i],
+													hash->collations[i],
+													keyval));
+	}
+
+	*hashvalue = hashkey;
+	return true;
+}
+
+/* Double the number of buckets and redistribute the entries. */
+static void
+nestloop_hash_grow(NestLoopHash hash)
+{
+	uint32		newnbuckets = hash->nbuckets * 2;
+	NestLoopHashEntry **newbuckets;
+	uint32		i;
+
+	newbuckets = MemoryContextAllocZero(hash->cxt,
+										newnbuckets * sizeof(NestLoopHashEntry *));
+	for (i = 0; i < hash->nbuckets; i++)
+	{
+		NestLoopHashEntry *entry = hash->buckets[i];
+
+		while (entry)
+		{
+			NestLoopHashEntry *next = entry->next;
+			uint32		b = entry->hashvalue & (newnbuckets - 1);
+
+			entry->next = newbuckets[b];
+			newbuckets[b] = entry;
+			entry = next;
+		}
+	}
+	pfree(hash->buckets);
+	hash->buckets = newbuckets;
+	hash->nbuckets = newnbuckets;
+}
+
+/*
+ * ExecNestLoopBuildHash
+ *
+ * Read the whole inner side into the hash table.  Returns false, leaving
+ * the table empty and the inner side rescanned, if it doesn't fit in hash
+ * memory.
+ */
+static bool
+ExecNestLoopBuildHash(NestLoopState *node)
+{
+	NestLoopHash hash = node->nl_Hash;
+	PlanState  *innerPlan = innerPlanState(node);
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	TupleTableSlot *saveinner = econtext->ecxt_innertuple;
+	Size		hash_mem_limit = get_hash_memory_limit();
+	bool		fits = true;
+
+	MemoryContextReset(hash->cxt);
+	hash->nbuckets = 1024;
+	hash->buckets = MemoryContextAllocZero(hash->cxt,
+										   hash->nbuckets * sizeof(NestLoopHashEntry *));
+	hash->ntuples = 0;
+
+	ExecReScan(innerPlan);
+	for (;;)
+	{
+		TupleTableSlot *slot = ExecProcNode(innerPlan);
+		NestLoopHashEntry *entry;
+		MemoryContext oldcxt;
+		uint32		hashvalue;
+		uint32		b;
+		Size		spaceUsed;
+
+		if (TupIsNull(slot))
+			break;
+
+		econtext->ecxt_innertuple = slot;
+		if (!nestloop_hash_keys(hash, econtext, false, &hashvalue))
+		{
+			ResetExprContext(econtext);
+			continue;
+		}
+		ResetExprContext(econtext);
+
+		oldcxt = MemoryContextSwitchTo(hash->cxt);
+		entry = palloc(sizeof(NestLoopHashEntry));
+		entry->hashvalue = hashvalue;
+		entry->tuple = ExecCopySlotMinimalTuple(slot);
+		MemoryContextSwitchTo(oldcxt);
+
+		b = hashvalue & (hash->nbuckets - 1);
+		entry->next = hash->buckets[b];
+		hash->buckets[b] = entry;
+		if (++hash->ntuples > hash->nbuckets &&
+			hash->nbuckets < MaxAllocSize / sizeof(NestLoopHashEntry *) / 2)
+			nestloop_hash_grow(hash);
+
+		spaceUsed = MemoryContextMemAllocated(hash->cxt, true);
+		node->nl_HashSpaceUsed = Max(node->nl_HashSpaceUsed, spaceUsed);
+		if (spaceUsed > hash_mem_limit)
+		{
+			fits = false;
+			break;
+		}
+	}
+	econtext->ecxt_innertuple = saveinner;
+
+	if (!fits)
+	{
+		MemoryContextReset(hash->cxt);
+		hash->buckets = NULL;
+		hash->nbuckets = 0;
+		hash->ntuples = 0;
+		node->nl_HashAbandoned = true;
+		ExecReScan(innerPlan);
+		return false;
+	}
+
+	node->nl_HashInnerTuples = hash->ntuples;
+	return true;
+}
+
+/*
+ * ExecNestLoopHashNewOuter
+ *
+ * Count a new outer tuple, switching to hashing if it's time, and if we're
+ * hashing, find its hash chain.  Returns false if the caller must rescan
+ * the inner side as usual.
+ */
+static bool
+ExecNestLoopHashNewOuter(NestLoopState *node)
+{
+	NestLoopHash hash = node->nl_Hash;
+	ExprContext *econtext = node->js.ps.ps_ExprContext;
+	uint32		hashvalue;
+
+	hash->nouter++;
+	if (!hash->tried && hash->nouter > hash->threshold)
+	{
+		hash->tried = true;
+		if (ExecNestLoopBuildHash(node))
+		{
+			hash->active = true;
+			node->nl_HashSwitchedAfter = hash->nouter - 1;
+		}
+	}
+	if (!hash->active)
+		return false;
+
+	if (nestloop_hash_keys(hash, econtext, true, &hashvalue))
+	{
+		hash->curhash = hashvalue;
+		hash->cur = hash->buckets[hashvalue & (hash->nbuckets - 1)];
+	}
+	else
+		hash->cur = NULL;
+
+	return true;
+}
+
+/*
+ * ExecNestLoopHashNextInner
+ *
+ * Return the next inner tuple in the hash chain of the current outer tuple
+ * whose hash value matches, or NULL.
+ */
+static TupleTableSlot *
+ExecNestLoopHashNextInner(NestLoopState *node)
+{
+	NestLoopHash hash = node->nl_Hash;
+
+	while (hash->cur)
+	{
+		NestLoopHashEntry *entry = hash->cur;
+
+		hash->cur = entry->next;
+		if (entry->hashvalue == hash->curhash)
+			return ExecStoreMinimalTuple(entry->tuple, hash->innerslot, false);
+	}
+
+	return NULL;
+}
+
+/*
+ * ExecNestLoopResetHash
+ *
+ * Throw away the hash table and start counting outer tuples again.
+ */
+static void
+ExecNestLoopResetHash(NestLoopState *node)
+{
+	NestLoopHash hash = node->nl_Hash;
+
+	MemoryContextReset(hash->cxt);
+	hash->buckets = NULL;
+	hash->nbuckets = 0;
+	hash->ntuples = 0;
+	hash->cur = NULL;
+	hash->nouter = 0;
+	hash->tried = false;
+	hash->active = false;
 }
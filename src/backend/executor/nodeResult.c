@@ -45,6 +45,7 @@
 
 #include "postgres.h"
 
+#include "executor/execBatch.h"
 #include "executor/executor.h"
 #include "executor/nodeResult.h"
 #include "miscadmin.h"
@@ -139,6 +140,57 @@ ExecResult(PlanState *pstate)
 	return NULL;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecResultBatch(node)
+ *
+ *		Batch equivalent of ExecResult, used only when there is an
+ *		outer plan that supports batch mode: fetches a batch of outer
+ *		tuples and projects them all into the caller's batch.
+ * ----------------------------------------------------------------
+ */
+static int
+ExecResultBatch(PlanState *pstate, TupleBatch *batch)
+{
+	ResultState *node = castNode(ResultState, pstate);
+	ExprContext *econtext = node->ps.ps_ExprContext;
+	PlanState  *outerPlan = outerPlanState(node);
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* check constant qualifications, as in ExecResult */
+	if (node->rs_checkqual)
+	{
+		bool		qualResult = ExecQual(node->resconstantqual, econtext);
+
+		node->rs_checkqual = false;
+		if (!qualResult)
+			node->rs_done = true;
+	}
+
+	if (node->rs_done)
+		return 0;
+
+	/* create the batch for the outer tuples on first use */
+	if (node->rs_batch == NULL)
+		node->rs_batch = ExecCreateBatch(node->ps.state,
+										 ExecGetResultType(outerPlan),
+										 ExecGetResultSlotOps(outerPlan, NULL),
+										 batch->maxrows);
+
+	/*
+	 * Reset per-tuple memory context to free any expression evaluation
+	 * storage allocated for the previous batch.
+	 */
+	ResetExprContext(econtext);
+
+	if (ExecProcBatch(outerPlan, node->rs_batch) == 0)
+		return 0;
+
+	ExecProjectBatch(node->ps.ps_ProjInfo, node->rs_batch, batch);
+
+	return batch->nselected;
+}
+
 /* ----------------------------------------------------------------
  *		ExecResultMarkPos
  * ----------------------------------------------------------------
@@ -228,6 +280,11 @@ ExecInitResult(Result *node, EState *estate, int eflags)
 	resstate->resconstantqual =
 		ExecInitQual((List *) node->resconstantqual, (PlanState *) resstate);
 
+	/* we can work in batch mode if our outer plan can */
+	if (executor_batch_size > 0 && outerPlanState(resstate) != NULL &&
+		outerPlanState(resstate)->ExecProcNodeBatch != NULL)
+		resstate->ps.ExecProcNodeBatch = ExecResultBatch;
+
 	return resstate;
 }
 
@@ -263,6 +320,8 @@ ExecReScanResult(ResultState *node)
 
 	node->rs_done = false;
 	node->rs_checkqual = (node->resconstantqual != NULL);
+	if (node->rs_batch)
+		ExecResetBatch(node->rs_batch);
 
 	/*
 	 * If chgParam of subnode is not null then plan will be re-scanned by
@@ -16,6 +16,7 @@
  * INTERFACE ROUTINES
  *		ExecSeqScan				sequentially scans a relation.
  *		ExecSeqNext				retrieve next tuple in sequential order.
+ *		ExecSeqScanBatch		scans a batch of tuples at a time.
  *		ExecInitSeqScan			creates and initializes a seqscan node.
  *		ExecEndSeqScan			releases any storage allocated.
  *		ExecReScanSeqScan		rescans the relation
@@ -28,18 +29,55 @@
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/skey.h"
+#include "access/sysattr.h"
 #include "access/tableam.h"
+#include "executor/execBatch.h"
 #include "executor/execdebug.h"
 #include "executor/nodeSeqscan.h"
+#include "catalog/pg_type.h"
+#include "miscadmin.h"
+#include "optimizer/optimizer.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/typcache.h"
 
 static TupleTableSlot *SeqNext(SeqScanState *node);
+static TableScanDesc SeqScanBegin(SeqScanState *node);
+static List *SeqScanPushDownQuals(SeqScanState *node, List *qual);
+static int	ExecSeqScanBatch(PlanState *pstate, TupleBatch *batch);
 
 /* ----------------------------------------------------------------
  *						Scan Support
  * ----------------------------------------------------------------
  */
 
+/*
+ * SeqScanBegin - start a non-parallel scan of the relation
+ *
+ * If we only need to know how many tuples there are, as for count(*), let
+ * the table AM know, so that it can skip reading blocks whose tuple count it
+ * knows otherwise.
+ */
+static TableScanDesc
+SeqScanBegin(SeqScanState *node)
+{
+	EState	   *estate = node->ss.ps.state;
+	TableScanDesc scan;
+
+	if (!node->ss_need_tuples)
+		return table_beginscan_count(node->ss.ss_currentRelation,
+									 estate->es_snapshot);
+
+	scan = table_beginscan(node->ss.ss_currentRelation,
+						   estate->es_snapshot,
+						   node->ss_nkeys, node->ss_scankeys);
+	if (node->ss_project)
+		table_scan_set_projection(scan, node->ss_projection);
+
+	return scan;
+}
+
 /* ----------------------------------------------------------------
  *		SeqNext
  *
@@ -68,9 +106,7 @@ SeqNext(SeqScanState *node)
 		 * We reach here if the scan is not parallel, or if we're serially
 		 * executing a scan that was planned to be parallel.
 		 */
-		scandesc = table_beginscan(node->ss.ss_currentRelation,
-								   estate->es_snapshot,
-								   0, NULL);
+		scandesc = SeqScanBegin(node);
 		node->ss.ss_currentScanDesc = scandesc;
 	}
 
@@ -82,6 +118,44 @@ SeqNext(SeqScanState *node)
 	return NULL;
 }
 
+/* ----------------------------------------------------------------
+ *		SeqNextBatch
+ *
+ *		Like SeqNext, but fills up to maxrows slots of the batch.
+ *		Returns the number of tuples fetched and selects all of them.
+ * ----------------------------------------------------------------
+ */
+static int
+SeqNextBatch(SeqScanState *node, TupleBatch *batch, int maxrows)
+{
+	TableScanDesc scandesc;
+	EState	   *estate;
+	ScanDirection direction;
+
+	scandesc = node->ss.ss_currentScanDesc;
+	estate = node->ss.ps.state;
+	direction = estate->es_direction;
+
+	if (scandesc == NULL)
+	{
+		/* see SeqNext */
+		scandesc = SeqScanBegin(node);
+		node->ss.ss_currentScanDesc = scandesc;
+	}
+
+	batch->nrows = 0;
+	while (batch->nrows < maxrows &&
+		   table_scan_getnextslot(scandesc, direction,
+								  batch->slots[batch->nrows]))
+	{
+		batch->sel[batch->nrows] = batch->nrows;
+		batch->nrows++;
+	}
+	batch->nselected = batch->nrows;
+
+	return batch->nrows;
+}
+
 /*
  * SeqRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
@@ -89,12 +163,129 @@ static bool
 SeqRecheck(SeqScanState *node, TupleTableSlot *slot)
 {
 	/*
-	 * Note that unlike IndexScan, SeqScan never use keys in heap_beginscan
-	 * (and this is very bad) - so, here we do not check are keys ok or not.
+	 * We never push quals down into the scan during EvalPlanQual (see
+	 * SeqScanPushDownQuals), so they're all in the node's qual and there's
+	 * nothing to recheck here.
 	 */
+	Assert(node->ss_nkeys == 0);
 	return true;
 }
 
+/* ----------------------------------------------------------------
+ *		SeqScanPushDownQuals
+ *
+ *		Turn the simple "column op constant" clauses of the qual into
+ *		scan keys, so that the heap can evaluate them for a whole page
+ *		at a time, right after the visibility checks; see
+ *		heap_prepare_pagescan.  Returns the remaining clauses.
+ *
+ *		We only push down comparisons on fixed-width columns using
+ *		strict, leakproof operators, which can't fail or reveal
+ *		anything about rows that other quals would filter out, so it's
+ *		safe to evaluate them first.  Other table AMs don't necessarily
+ *		honor scan keys, and EvalPlanQual rechecks must evaluate the
+ *		whole qual on the test tuple, so neither get any.  The
+ *		columnar AM honors them too, and also uses the btree strategy
+ *		of the operator, when it has one, to skip chunk groups by their
+ *		minimum and maximum.
+ * ----------------------------------------------------------------
+ */
+static List *
+SeqScanPushDownQuals(SeqScanState *node, List *qual)
+{
+	Relation	rel = node->ss.ss_currentRelation;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	List	   *residual = NIL;
+	ListCell   *lc;
+
+	if ((rel->rd_tableam != GetHeapamTableAmRoutine() &&
+		 rel->rd_tableam != GetColumnarTableAmRoutine()) ||
+		node->ss.ps.state->es_epq_active != NULL)
+		return qual;
+
+	foreach(lc, qual)
+	{
+		Expr	   *clause = (Expr *) lfirst(lc);
+		OpExpr	   *opexpr;
+		Expr	   *leftop;
+		Expr	   *rightop;
+		Var		   *var;
+		Const	   *con;
+		Oid			opno;
+		RegProcedure opfuncid;
+		StrategyNumber strategy = InvalidStrategy;
+		TypeCacheEntry *typentry;
+
+		if (!IsA(clause, OpExpr) ||
+			list_length(((OpExpr *) clause)->args) != 2)
+		{
+			residual = lappend(residual, clause);
+			continue;
+		}
+		opexpr = (OpExpr *) clause;
+		leftop = (Expr *) linitial(opexpr->args);
+		rightop = (Expr *) lsecond(opexpr->args);
+
+		/* the column must be the left argument of the scan key function */
+		opno = InvalidOid;
+		if (IsA(leftop, Var) && IsA(rightop, Const))
+		{
+			var = (Var *) leftop;
+			con = (Const *) rightop;
+			opno = opexpr->opno;
+		}
+		else if (IsA(leftop, Const) && IsA(rightop, Var))
+		{
+			var = (Var *) rightop;
+			con = (Const *) leftop;
+			opno = get_commutator(opexpr->opno);
+		}
+
+		if (!OidIsValid(opno) ||
+			opexpr->opresulttype != BOOLOID || opexpr->opretset ||
+			IS_SPECIAL_VARNO(var->varno) || var->varlevelsup != 0 ||
+			var->varattno <= 0 || var->varattno > tupdesc->natts ||
+			TupleDescAttr(tupdesc, var->varattno - 1)->attlen <= 0 ||
+			con->constisnull)
+		{
+			residual = lappend(residual, clause);
+			continue;
+		}
+
+		opfuncid = get_opcode(opno);
+		if (!RegProcedureIsValid(opfuncid) ||
+			!func_strict(opfuncid) || !get_func_leakproof(opfuncid))
+		{
+			residual = lappend(residual, clause);
+			continue;
+		}
+
+		if (con->consttype == var->vartype)
+		{
+			typentry = lookup_type_cache(var->vartype,
+										 TYPECACHE_BTREE_OPFAMILY);
+			if (OidIsValid(typentry->btree_opf))
+				strategy = get_op_opfamily_strategy(opno,
+													typentry->btree_opf);
+		}
+
+		if (node->ss_scankeys == NULL)
+			node->ss_scankeys = (ScanKey)
+				palloc(sizeof(ScanKeyData) * list_length(qual));
+
+		ScanKeyEntryInitialize(&node->ss_scankeys[node->ss_nkeys++],
+							   0,
+							   var->varattno,
+							   strategy,
+							   InvalidOid,
+							   opexpr->inputcollid,
+							   opfuncid,
+							   con->constvalue);
+	}
+
+	return residual;
+}
+
 /* ----------------------------------------------------------------
  *		ExecSeqScan(node)
  *
@@ -114,6 +305,77 @@ ExecSeqScan(PlanState *pstate)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatch(node)
+ *
+ *		Fills the batch with the next qualifying tuples, the batch
+ *		equivalent of ExecSeqScan.  Without a projection, the tuples are
+ *		scanned directly into the caller's slots; otherwise they're
+ *		scanned into our own batch first and projected from there.
+ *		All tuples of a batch share the per-tuple memory context, which
+ *		we reset only when starting the next batch.
+ * ----------------------------------------------------------------
+ */
+static int
+ExecSeqScanBatch(PlanState *pstate, TupleBatch *batch)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	ProjectionInfo *projInfo = node->ss.ps.ps_ProjInfo;
+	ExprState  *qual = node->ss.ps.qual;
+	TupleBatch *scanbatch = batch;
+	int			maxrows;
+
+	if (projInfo)
+	{
+		/* create our own batch on first use, sized like the caller's */
+		if (node->ss_batch == NULL)
+		{
+			Relation	rel = node->ss.ss_currentRelation;
+
+			node->ss_batch = ExecCreateBatch(node->ss.ps.state,
+											 RelationGetDescr(rel),
+											 table_slot_callbacks(rel),
+											 batch->maxrows);
+		}
+		scanbatch = node->ss_batch;
+	}
+	Assert(scanbatch->slots[0]->tts_ops ==
+		   node->ss.ss_ScanTupleSlot->tts_ops);
+	maxrows = Min(scanbatch->maxrows, batch->maxrows);
+
+	for (;;)
+	{
+		int			nrows;
+
+		CHECK_FOR_INTERRUPTS();
+
+		ResetExprContext(econtext);
+
+		nrows = SeqNextBatch(node, scanbatch, maxrows);
+		if (nrows == 0)
+		{
+			batch->nselected = 0;
+			return 0;
+		}
+
+		if (node->ss_batchqual)
+			ExecBatchQual(node->ss_batchqual, scanbatch);
+		else if (qual)
+			ExecBatchQualRows(qual, econtext, scanbatch);
+
+		InstrCountFiltered1(node, nrows - scanbatch->nselected);
+
+		if (scanbatch->nselected == 0)
+			continue;
+
+		if (projInfo)
+			ExecProjectBatch(projInfo, scanbatch, batch);
+
+		return batch->nselected;
+	}
+}
+
 
 /* ----------------------------------------------------------------
  *		ExecInitSeqScan
@@ -123,6 +385,7 @@ SeqScanState *
 ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 {
 	SeqScanState *scanstate;
+	List	   *qual;
 
 	/*
 	 * Once upon a time it was possible to have an outerPlan of a SeqScan, but
@@ -168,8 +431,48 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	/*
 	 * initialize child expressions
 	 */
-	scanstate->ss.ps.qual =
-		ExecInitQual(node->scan.plan.qual, (PlanState *) scanstate);
+	qual = SeqScanPushDownQuals(scanstate, node->scan.plan.qual);
+	scanstate->ss.ps.qual = ExecInitQual(qual, (PlanState *) scanstate);
+
+	/*
+	 * With no quals and an empty tlist, only the number of tuples matters.
+	 * Backward scans and EvalPlanQual rechecks need the actual tuples.
+	 */
+	scanstate->ss_need_tuples =
+		qual != NIL || scanstate->ss_nkeys > 0 ||
+		node->scan.plan.targetlist != NIL ||
+		(eflags & EXEC_FLAG_BACKWARD) ||
+		estate->es_epq_active != NULL;
+
+	/*
+	 * Tell the table AM which columns we need, so that a column-oriented AM
+	 * can skip reading the others.  A whole-row reference needs them all.
+	 */
+	if (scanstate->ss_need_tuples && estate->es_epq_active == NULL)
+	{
+		Bitmapset  *attrs = NULL;
+
+		pull_varattnos((Node *) node->scan.plan.targetlist,
+					   node->scan.scanrelid, &attrs);
+		pull_varattnos((Node *) qual, node->scan.scanrelid, &attrs);
+		if (!bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber,
+						   attrs))
+		{
+			scanstate->ss_project = true;
+			scanstate->ss_projection = attrs;
+		}
+	}
+
+	/*
+	 * Offer batch mode to our parent, unless we're running an EvalPlanQual
+	 * recheck, which has to go through ExecScan for each tuple.
+	 */
+	if (executor_batch_size > 0 && estate->es_epq_active == NULL)
+	{
+		scanstate->ss.ps.ExecProcNodeBatch = ExecSeqScanBatch;
+		scanstate->ss_batchqual = ExecInitBatchQual(qual,
+													executor_batch_size);
+	}
 
 	return scanstate;
 }
@@ -276,8 +579,18 @@ ExecSeqScanInitializeDSM(SeqScanState *node,
 								  pscan,
 								  estate->es_snapshot);
 	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, pscan);
-	node->ss.ss_currentScanDesc =
-		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	if (!node->ss_need_tuples)
+		node->ss.ss_currentScanDesc =
+			table_beginscan_parallel_count(node->ss.ss_currentRelation, pscan);
+	else
+	{
+		node->ss.ss_currentScanDesc =
+			table_beginscan_parallel_keys(node->ss.ss_currentRelation, pscan,
+										  node->ss_nkeys, node->ss_scankeys);
+		if (node->ss_project)
+			table_scan_set_projection(node->ss.ss_currentScanDesc,
+									  node->ss_projection);
+	}
 }
 
 /* ----------------------------------------------------------------
@@ -309,6 +622,16 @@ ExecSeqScanInitializeWorker(SeqScanState *node,
 	ParallelTableScanDesc pscan;
 
 	pscan = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, false);
-	node->ss.ss_currentScanDesc =
-		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	if (!node->ss_need_tuples)
+		node->ss.ss_currentScanDesc =
+			table_beginscan_parallel_count(node->ss.ss_currentRelation, pscan);
+	else
+	{
+		node->ss.ss_currentScanDesc =
+			table_beginscan_parallel_keys(node->ss.ss_currentRelation, pscan,
+										  node->ss_nkeys, node->ss_scankeys);
+		if (node->ss_project)
+			table_scan_set_projection(node->ss.ss_currentScanDesc,
+									  node->ss_projection);
+	}
 }
@@ -21,6 +21,9 @@
 #include "miscadmin.h"
 #include "utils/tuplesort.h"
 
+static bool sort_beyond_threshold(SortThreshold *threshold,
+								  TupleTableSlot *slot);
+
 
 /* ----------------------------------------------------------------
  *		ExecSort
@@ -54,6 +57,7 @@ ExecSort(PlanState *pstate)
 	ScanDirection dir;
 	Tuplesortstate *tuplesortstate;
 	TupleTableSlot *slot;
+	SortThreshold *threshold;
 
 	CHECK_FOR_INTERRUPTS();
 
@@ -124,6 +128,16 @@ ExecSort(PlanState *pstate)
 			tuplesort_set_bound(tuplesortstate, node->bound);
 		node->tuplesortstate = (void *) tuplesortstate;
 
+		/*
+		 * If a bounded MergeAppend above us already knows enough tuples from
+		 * other children, input tuples that sort after its threshold can't be
+		 * needed.
+		 */
+		threshold = node->threshold;
+		if (threshold != NULL && TupIsNull(threshold->slot))
+			threshold = NULL;
+		node->threshold_Done = (threshold != NULL);
+
 		/*
 		 * Scan the subplan and feed all the tuples to tuplesort using the
 		 * appropriate method based on the type of sort we're doing.
@@ -136,6 +150,8 @@ ExecSort(PlanState *pstate)
 
 				if (TupIsNull(slot))
 					break;
+				if (threshold && sort_beyond_threshold(threshold, slot))
+					continue;
 				slot_getsomeattrs(slot, 1);
 				tuplesort_putdatum(tuplesortstate,
 								   slot->tts_values[0],
@@ -150,6 +166,8 @@ ExecSort(PlanState *pstate)
 
 				if (TupIsNull(slot))
 					break;
+				if (threshold && sort_beyond_threshold(threshold, slot))
+					continue;
 				tuplesort_puttupleslot(tuplesortstate, slot);
 			}
 		}
@@ -210,6 +228,55 @@ ExecSort(PlanState *pstate)
 	return slot;
 }
 
+/*
+ * Does the tuple in slot sort after the threshold tuple?
+ */
+static bool
+sort_beyond_threshold(SortThreshold *threshold, TupleTableSlot *slot)
+{
+	int			nkey;
+
+	for (nkey = 0; nkey < threshold->nkeys; nkey++)
+	{
+		SortSupport sortKey = threshold->sortkeys + nkey;
+		AttrNumber	attno = sortKey->ssup_attno;
+		Datum		datum1,
+					datum2;
+		bool		isNull1,
+					isNull2;
+		int			compare;
+
+		datum1 = slot_getattr(slot, attno, &isNull1);
+		datum2 = slot_getattr(threshold->slot, attno, &isNull2);
+
+		compare = ApplySortComparator(datum1, isNull1,
+									  datum2, isNull2,
+									  sortKey);
+		if (compare != 0)
+			return compare > 0;
+	}
+	return false;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSortPeekTuple
+ *
+ *		Stores the n'th tuple of the sort result into slot (which must
+ *		accept minimal tuples), if the sort has been done in memory and
+ *		has that many tuples.  The slot points into the sort's memory, so
+ *		the caller must copy the tuple before the sort node is run again.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecSortPeekTuple(SortState *node, int64 n, TupleTableSlot *slot)
+{
+	if (!node->sort_Done || node->datumSort)
+		return false;
+
+	return tuplesort_peektupleslot((Tuplesortstate *) node->tuplesortstate,
+								   n, slot);
+}
+
 /* ----------------------------------------------------------------
  *		ExecInitSort
  *
@@ -246,6 +313,8 @@ ExecInitSort(Sort *node, EState *estate, int eflags)
 	sortstate->bounded = false;
 	sortstate->sort_Done = false;
 	sortstate->tuplesortstate = NULL;
+	sortstate->threshold = NULL;
+	sortstate->threshold_Done = false;
 
 	/*
 	 * Miscellaneous initialization
@@ -384,13 +453,16 @@ ExecReScanSort(SortState *node)
 	/*
 	 * If subnode is to be rescanned then we forget previous sort results; we
 	 * have to re-read the subplan and re-sort.  Also must re-sort if the
-	 * bounded-sort parameters changed or we didn't select randomAccess.
+	 * bounded-sort parameters changed or we didn't select randomAccess, or
+	 * if we discarded tuples by a threshold taken from our siblings' output,
+	 * which might change.
 	 *
 	 * Otherwise we can just rewind and rescan the sorted output.
 	 */
 	if (outerPlan->chgParam != NULL ||
 		node->bounded != node->bounded_Done ||
 		node->bound != node->bound_Done ||
+		node->threshold_Done ||
 		!node->randomAccess)
 	{
 		node->sort_Done = false;
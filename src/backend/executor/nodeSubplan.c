@@ -29,15 +29,21 @@
 #include <math.h>
 
 #include "access/htup_details.h"
+#include "access/xact.h"
+#include "common/hashfn.h"
 #include "executor/executor.h"
 #include "executor/nodeSubplan.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
 #include "utils/array.h"
+#include "utils/datum.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 
 static Datum ExecHashSubPlan(SubPlanState *node,
 							 ExprContext *econtext,
@@ -51,6 +57,27 @@ static bool findPartialMatch(TupleHashTable hashtable, TupleTableSlot *slot,
 static bool slotAllNulls(TupleTableSlot *slot);
 static bool slotNoNulls(TupleTableSlot *slot);
 
+/* Key of the cache entry an initplan would use */
+typedef struct InitPlanCacheKey
+{
+	char	   *key;			/* user, relations and plan tree, as text */
+	uint32		hashvalue;
+	int			nrelids;
+	Oid		   *relids;			/* relations used by the query */
+} InitPlanCacheKey;
+
+static bool initplan_cache_prepare(SubPlanState *node, InitPlanCacheKey *key);
+static bool initplan_cache_fetch(SubPlanState *node, ExprContext *econtext,
+								 InitPlanCacheKey *key);
+static void initplan_cache_store(SubPlanState *node, ExprContext *econtext,
+								 InitPlanCacheKey *key);
+
+/* GUC parameter: lifetime of cached initplan results in ms, 0 disables */
+int			initplan_cache_ttl = 0;
+
+/* Maximum number of cached initplan results */
+#define INITPLAN_CACHE_MAX_ENTRIES	256
+
 
 /* ----------------------------------------------------------------
  *		ExecSubPlan
@@ -1101,6 +1128,8 @@ ExecSetParamPlan(SubPlanState *node, ExprContext *econtext)
 	ListCell   *l;
 	bool		found = false;
 	ArrayBuildStateAny *astate = NULL;
+	InitPlanCacheKey cachekey;
+	bool		use_cache;
 
 	if (subLinkType == ANY_SUBLINK ||
 		subLinkType == ALL_SUBLINK)
@@ -1110,6 +1139,11 @@ ExecSetParamPlan(SubPlanState *node, ExprContext *econtext)
 	if (subplan->parParam || node->args)
 		elog(ERROR, "correlated subplans should not be executed via ExecSetParamPlan");
 
+	/* Use the result of an earlier execution, if we may and can */
+	use_cache = initplan_cache_prepare(node, &cachekey);
+	if (use_cache && initplan_cache_fetch(node, econtext, &cachekey))
+		return;
+
 	/*
 	 * Enforce forward scan direction regardless of caller. It's hard but not
 	 * impossible to get here in backward scan, so make it work anyway.
@@ -1251,6 +1285,9 @@ ExecSetParamPlan(SubPlanState *node, ExprContext *econtext)
 
 	/* restore scan direction */
 	estate->es_direction = dir;
+
+	if (use_cache)
+		initplan_cache_store(node, econtext, &cachekey);
 }
 
 /*
@@ -1326,3 +1363,365 @@ ExecReScanSetParamPlan(SubPlanState *node, PlanState *parent)
 		parent->chgParam = bms_add_member(parent->chgParam, paramid);
 	}
 }
+
+/* ----------------------------------------------------------------
+ *		InitPlan result cache
+ *
+ * When initplan_cache_ttl is set, the results of initplans marked
+ * result_cacheable by the planner are remembered per backend and reused by
+ * later executions of the same plan with the same query parameters, such as
+ * repeated executions of a prepared statement.  Entries are identified by
+ * the text of the initplan's plan tree together with the query's relations,
+ * the user and the parameter values, so a replanned query can still use
+ * them.  They are dropped on relcache invalidation of any relation the query
+ * uses, and otherwise when they get older than initplan_cache_ttl; since
+ * ordinary data changes don't cause invalidations, results can be that much
+ * out of date.  Transactions using a transaction snapshot don't use the
+ * cache, nor do transactions that have changed anything themselves, whose
+ * results could include rows that never get committed.  For the same
+ * reason, the whole cache is dropped when a transaction aborts.
+ *
+ * Initplans that depend on other initplans or on outer query levels, or
+ * that contain subplans or CTE scans of their own, are not cached.
+ * ----------------------------------------------------------------
+ */
+
+typedef struct InitPlanCacheEntry
+{
+	dlist_node	node;			/* most recently used is at the head */
+	MemoryContext context;		/* holds the entry and all it points to */
+	InitPlanCacheKey key;
+	TimestampTz stored_at;
+	int			nparams;		/* the query's parameters */
+	ParamExternData *params;
+	int16	   *paramtyplens;
+	bool	   *paramtypbyvals;
+	int			nvalues;		/* the initplan's output parameters */
+	Datum	   *values;
+	bool	   *isnull;
+	int16	   *typlens;
+	bool	   *typbyvals;
+} InitPlanCacheEntry;
+
+static MemoryContext InitPlanCacheContext = NULL;
+static dlist_head InitPlanCache = DLIST_STATIC_INIT(InitPlanCache);
+static int	InitPlanCacheCount = 0;
+
+/*
+ * initplan_cache_walker
+ *		Check that a plan tree contains nothing that keeps its result from
+ *		being cached.
+ */
+static bool
+initplan_cache_walker(PlanState *planstate, void *context)
+{
+	if (planstate->initPlan != NIL || planstate->subPlan != NIL ||
+		IsA(planstate, CteScanState) ||
+		IsA(planstate, WorkTableScanState) ||
+		IsA(planstate, NamedTuplestoreScanState))
+		return true;
+
+	return planstate_tree_walker(planstate, initplan_cache_walker, context);
+}
+
+/*
+ * initplan_cache_prepare
+ *		Decide whether to use the cache for an initplan, and if so, compute
+ *		the key of its entry.
+ */
+static bool
+initplan_cache_prepare(SubPlanState *node, InitPlanCacheKey *key)
+{
+	PlanState  *planstate = node->planstate;
+	EState	   *estate = planstate->state;
+	ParamListInfo params = estate->es_param_list_info;
+	StringInfoData buf;
+	char	   *plantext;
+	ListCell   *lc;
+
+	if (initplan_cache_ttl <= 0 || !node->subplan->result_cacheable ||
+		IsolationUsesXactSnapshot() ||
+		TransactionIdIsValid(GetTopTransactionIdIfAny()) ||
+		!bms_is_empty(planstate->plan->extParam) ||
+		(params != NULL && params->paramFetch != NULL) ||
+		initplan_cache_walker(planstate, NULL))
+		return false;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "%u", GetUserId());
+
+	key->nrelids = 0;
+	key->relids = palloc(Max(list_length(estate->es_range_table), 1) * sizeof(Oid));
+	foreach(lc, estate->es_range_table)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+		key->relids[key->nrelids++] = rte->relid;
+		appendStringInfo(&buf, " %u", rte->relid);
+	}
+
+	plantext = nodeToString(planstate->plan);
+	appendStringInfo(&buf, " %s", plantext);
+	pfree(plantext);
+
+	key->key = buf.data;
+	key->hashvalue = hash_bytes((const unsigned char *) buf.data, buf.len);
+
+	return true;
+}
+
+/*
+ * initplan_cache_remove
+ *		Drop a cache entry.
+ */
+static void
+initplan_cache_remove(InitPlanCacheEntry *entry)
+{
+	dlist_delete(&entry->node);
+	InitPlanCacheCount--;
+	MemoryContextDelete(entry->context);
+}
+
+/*
+ * initplan_cache_relcache_callback
+ *		Drop the entries that depend on an invalidated relation.
+ */
+static void
+initplan_cache_relcache_callback(Datum arg, Oid relid)
+{
+	dlist_mutable_iter iter;
+
+	dlist_foreach_modify(iter, &InitPlanCache)
+	{
+		InitPlanCacheEntry *entry = dlist_container(InitPlanCacheEntry, node,
+													iter.cur);
+		bool		found = (relid == InvalidOid);
+
+		for (int i = 0; !found && i < entry->key.nrelids; i++)
+			found = (entry->key.relids[i] == relid);
+		if (found)
+			initplan_cache_remove(entry);
+	}
+}
+
+/*
+ * initplan_cache_xact_callback
+ *		Drop all entries when a transaction aborts.
+ */
+static void
+initplan_cache_xact_callback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+		initplan_cache_relcache_callback((Datum) 0, InvalidOid);
+}
+
+/*
+ * initplan_cache_fetch
+ *		Set an initplan's output parameters from the cache, if possible.
+ */
+static bool
+initplan_cache_fetch(SubPlanState *node, ExprContext *econtext,
+					 InitPlanCacheKey *key)
+{
+	ParamListInfo params = node->planstate->state->es_param_list_info;
+	int			nparams = params != NULL ? params->numParams : 0;
+	dlist_iter	iter;
+	InitPlanCacheEntry *entry = NULL;
+	ListCell   *l;
+
+	dlist_foreach(iter, &InitPlanCache)
+	{
+		InitPlanCacheEntry *cand = dlist_container(InitPlanCacheEntry, node,
+												   iter.cur);
+
+		if (cand->key.hashvalue != key->hashvalue ||
+			strcmp(cand->key.key, key->key) != 0 ||
+			cand->nparams != nparams)
+			continue;
+
+		for (int i = 0; cand != NULL && i < nparams; i++)
+		{
+			ParamExternData *prm = &params->params[i];
+			ParamExternData *cprm = &cand->params[i];
+
+			if (prm->ptype != cprm->ptype || prm->isnull != cprm->isnull ||
+				(!prm->isnull &&
+				 !datumIsEqual(prm->value, cprm->value,
+							   cand->paramtypbyvals[i],
+							   cand->paramtyplens[i])))
+				cand = NULL;
+		}
+		if (cand != NULL)
+		{
+			entry = cand;
+			break;
+		}
+	}
+
+	if (entry == NULL)
+		return false;
+
+	if (TimestampDifferenceExceeds(entry->stored_at, GetCurrentTimestamp(),
+								   initplan_cache_ttl))
+	{
+		initplan_cache_remove(entry);
+		return false;
+	}
+
+	/*
+	 * Copy the values, as the entry could be invalidated while the query
+	 * still uses them.
+	 */
+	foreach(l, node->subplan->setParam)
+	{
+		int			i = foreach_current_index(l);
+		ParamExecData *prm = &(econtext->ecxt_param_exec_vals[lfirst_int(l)]);
+
+		prm->execPlan = NULL;
+		prm->isnull = entry->isnull[i];
+		if (entry->isnull[i])
+			prm->value = (Datum) 0;
+		else
+			prm->value = datumCopy(entry->values[i], entry->typbyvals[i],
+								   entry->typlens[i]);
+	}
+
+	dlist_move_head(&InitPlanCache, &entry->node);
+
+	return true;
+}
+
+/*
+ * initplan_cache_store
+ *		Remember the output parameters an initplan has just set.
+ */
+static void
+initplan_cache_store(SubPlanState *node, ExprContext *econtext,
+					 InitPlanCacheKey *key)
+{
+	SubPlan    *subplan = node->subplan;
+	ParamListInfo params = node->planstate->state->es_param_list_info;
+	TupleDesc	tdesc = ExecGetResultType(node->planstate);
+	MemoryContext context;
+	MemoryContext oldcontext;
+	InitPlanCacheEntry *entry;
+	Size		size = 0;
+	ListCell   *l;
+
+	if (InitPlanCacheContext == NULL)
+	{
+		InitPlanCacheContext = AllocSetContextCreate(CacheMemoryContext,
+													 "InitPlan result cache",
+													 ALLOCSET_DEFAULT_SIZES);
+		CacheRegisterRelcacheCallback(initplan_cache_relcache_callback,
+									  (Datum) 0);
+		RegisterXactCallback(initplan_cache_xact_callback, NULL);
+	}
+
+	context = AllocSetContextCreate(InitPlanCacheContext,
+									"InitPlan result cache entry",
+									ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(context);
+
+	entry = palloc(sizeof(InitPlanCacheEntry));
+	entry->context = context;
+	entry->key.key = pstrdup(key->key);
+	entry->key.hashvalue = key->hashvalue;
+	entry->key.nrelids = key->nrelids;
+	entry->key.relids = palloc(Max(key->nrelids, 1) * sizeof(Oid));
+	memcpy(entry->key.relids, key->relids, key->nrelids * sizeof(Oid));
+	entry->stored_at = GetCurrentTimestamp();
+
+	entry->nparams = params != NULL ? params->numParams : 0;
+	entry->params = palloc(Max(entry->nparams, 1) * sizeof(ParamExternData));
+	entry->paramtyplens = palloc(Max(entry->nparams, 1) * sizeof(int16));
+	entry->paramtypbyvals = palloc(Max(entry->nparams, 1) * sizeof(bool));
+	for (int i = 0; i < entry->nparams; i++)
+	{
+		ParamExternData *prm = &params->params[i];
+
+		entry->params[i] = *prm;
+		if (OidIsValid(prm->ptype))
+			get_typlenbyval(prm->ptype, &entry->paramtyplens[i],
+							&entry->paramtypbyvals[i]);
+		else
+		{
+			/* An unused parameter, which has to be null */
+			entry->paramtyplens[i] = sizeof(Datum);
+			entry->paramtypbyvals[i] = true;
+		}
+		if (!prm->isnull)
+		{
+			entry->params[i].value = datumCopy(prm->value,
+											   entry->paramtypbyvals[i],
+											   entry->paramtyplens[i]);
+			size += datumGetSize(prm->value, entry->paramtypbyvals[i],
+								 entry->paramtyplens[i]);
+		}
+	}
+
+	entry->nvalues = list_length(subplan->setParam);
+	entry->values = palloc(entry->nvalues * sizeof(Datum));
+	entry->isnull = palloc(entry->nvalues * sizeof(bool));
+	entry->typlens = palloc(entry->nvalues * sizeof(int16));
+	entry->typbyvals = palloc(entry->nvalues * sizeof(bool));
+	foreach(l, subplan->setParam)
+	{
+		int			i = foreach_current_index(l);
+		ParamExecData *prm = &(econtext->ecxt_param_exec_vals[lfirst_int(l)]);
+
+		/* The output parameters have the types of the subplan's columns */
+		if (subplan->subLinkType == EXISTS_SUBLINK)
+		{
+			entry->typlens[i] = 1;
+			entry->typbyvals[i] = true;
+		}
+		else if (subplan->subLinkType == ARRAY_SUBLINK)
+		{
+			entry->typlens[i] = -1;
+			entry->typbyvals[i] = false;
+		}
+		else
+		{
+			entry->typlens[i] = TupleDescAttr(tdesc, i)->attlen;
+			entry->typbyvals[i] = TupleDescAttr(tdesc, i)->attbyval;
+		}
+
+		entry->isnull[i] = prm->isnull;
+		entry->values[i] = (Datum) 0;
+		if (!prm->isnull)
+		{
+			entry->values[i] = datumCopy(prm->value, entry->typbyvals[i],
+										 entry->typlens[i]);
+			size += datumGetSize(prm->value, entry->typbyvals[i],
+								 entry->typlens[i]);
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Don't let a single entry take more than work_mem */
+	if (size > (Size) work_mem * 1024)
+	{
+		MemoryContextDelete(context);
+		return;
+	}
+
+	dlist_push_head(&InitPlanCache, &entry->node);
+	InitPlanCacheCount++;
+	while (InitPlanCacheCount > INITPLAN_CACHE_MAX_ENTRIES)
+		initplan_cache_remove(dlist_container(InitPlanCacheEntry, node,
+											  dlist_tail_node(&InitPlanCache)));
+}
+
+/*
+ * ResetInitPlanCache
+ *		Drop all cached initplan results.
+ */
+void
+ResetInitPlanCache(void)
+{
+	initplan_cache_relcache_callback((Datum) 0, InvalidOid);
+}
@@ -109,6 +109,7 @@ typedef struct WindowStatePerAggData
 	Oid			transfn_oid;
 	Oid			invtransfn_oid; /* may be InvalidOid */
 	Oid			finalfn_oid;	/* may be InvalidOid */
+	Oid			combinefn_oid;	/* only valid for sliding aggregates */
 
 	/*
 	 * fmgr lookup data for transition functions --- only valid when
@@ -118,6 +119,7 @@ typedef struct WindowStatePerAggData
 	FmgrInfo	transfn;
 	FmgrInfo	invtransfn;
 	FmgrInfo	finalfn;
+	FmgrInfo	combinefn;
 
 	int			numFinalArgs;	/* number of arguments to pass to finalfn */
 
@@ -155,6 +157,20 @@ typedef struct WindowStatePerAggData
 
 	int64		transValueCount;	/* number of currently-aggregated rows */
 
+	/*
+	 * Sliding aggregates have no inverse transition function, but can combine
+	 * transition values, so we keep the frame as two parts: transValue holds
+	 * the rows from frontpos up to aggregatedupto, and frontValues[i] holds
+	 * the combined transition value of the rows from frontbase + i up to
+	 * frontpos.  See eval_windowaggregates().
+	 */
+	bool		sliding;		/* use the combine function for moving head? */
+	MemoryContext frontcontext; /* holds frontValues and their data */
+	Datum	   *frontValues;
+	bool	   *frontIsNull;
+	int64		frontbase;		/* row number of frontValues[0] */
+	int64		frontpos;		/* first row not covered by frontValues */
+
 	/* Data local to eval_windowaggregates() */
 	bool		restart;		/* need to restart this agg in this cycle? */
 } WindowStatePerAggData;
@@ -168,6 +184,16 @@ static void advance_windowaggregate(WindowAggState *winstate,
 static bool advance_windowaggregate_base(WindowAggState *winstate,
 										 WindowStatePerFunc perfuncstate,
 										 WindowStatePerAgg peraggstate);
+static void combine_windowaggregate(WindowAggState *winstate,
+									WindowStatePerFunc perfuncstate,
+									WindowStatePerAgg peraggstate,
+									Datum *value, bool *isnull,
+									Datum newValue, bool newIsNull,
+									MemoryContext context);
+static void rebuild_windowaggregate_front(WindowAggState *winstate,
+										  WindowStatePerFunc perfuncstate,
+										  WindowStatePerAgg peraggstate,
+										  int64 endpos);
 static void finalize_windowaggregate(WindowAggState *winstate,
 									 WindowStatePerFunc perfuncstate,
 									 WindowStatePerAgg peraggstate,
@@ -574,6 +600,160 @@ advance_windowaggregate_base(WindowAggState *winstate,
 	return true;
 }
 
+/*
+ * combine_windowaggregate
+ * Merge the transition value newValue into *value using the aggregate's
+ * combine function, parallel to the combine step of nodeAgg.c.
+ *
+ * *value must be a modifiable value stored in 'context', which also receives
+ * the result; newValue is not modified.
+ */
+static void
+combine_windowaggregate(WindowAggState *winstate,
+						WindowStatePerFunc perfuncstate,
+						WindowStatePerAgg peraggstate,
+						Datum *value, bool *isnull,
+						Datum newValue, bool newIsNull,
+						MemoryContext context)
+{
+	LOCAL_FCINFO(fcinfo, 2);
+	MemoryContext oldContext;
+	Datum		newVal;
+
+	if (peraggstate->combinefn.fn_strict)
+	{
+		/*
+		 * A strict combine function ignores NULL inputs, and a NULL state
+		 * simply takes over the other value, as in nodeAgg.c.
+		 */
+		if (newIsNull)
+			return;
+		if (*isnull)
+		{
+			oldContext = MemoryContextSwitchTo(context);
+			*value = datumCopy(newValue,
+							   peraggstate->transtypeByVal,
+							   peraggstate->transtypeLen);
+			*isnull = false;
+			MemoryContextSwitchTo(oldContext);
+			return;
+		}
+	}
+
+	oldContext = MemoryContextSwitchTo(winstate->tmpcontext->ecxt_per_tuple_memory);
+
+	InitFunctionCallInfoData(*fcinfo, &(peraggstate->combinefn), 2,
+							 perfuncstate->winCollation,
+							 (void *) winstate, NULL);
+	fcinfo->args[0].value = *value;
+	fcinfo->args[0].isnull = *isnull;
+	fcinfo->args[1].value = MakeExpandedObjectReadOnly(newValue,
+													   newIsNull,
+													   peraggstate->transtypeLen);
+	fcinfo->args[1].isnull = newIsNull;
+	winstate->curaggcontext = context;
+	newVal = FunctionCallInvoke(fcinfo);
+	winstate->curaggcontext = NULL;
+
+	/*
+	 * Copy a pass-by-ref result into the target context, unless the combine
+	 * function just modified and returned its first input.  The old value is
+	 * not freed; the caller resets 'context' as a whole.
+	 */
+	if (!peraggstate->transtypeByVal && !fcinfo->isnull &&
+		DatumGetPointer(newVal) != DatumGetPointer(*value))
+	{
+		MemoryContextSwitchTo(context);
+		newVal = datumCopy(newVal,
+						   peraggstate->transtypeByVal,
+						   peraggstate->transtypeLen);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+	*value = newVal;
+	*isnull = fcinfo->isnull;
+}
+
+/*
+ * rebuild_windowaggregate_front
+ * Move the rows from the frame head up to endpos into the front part of a
+ * sliding aggregate.
+ *
+ * This is done when the frame head has passed frontpos, i.e. no row of the
+ * old front part is left in the frame.  We compute the transition value of
+ * every single row and combine them from the end, so that frontValues[i]
+ * covers the rows from frameheadpos + i up to endpos; the transition value
+ * proper is then reset to cover no rows.  Each row is moved into the front
+ * part at most once, so the cost is amortized constant per row, whereas a
+ * restart costs the whole frame for every current row.
+ */
+static void
+rebuild_windowaggregate_front(WindowAggState *winstate,
+							  WindowStatePerFunc perfuncstate,
+							  WindowStatePerAgg peraggstate,
+							  int64 endpos)
+{
+	TupleTableSlot *slot = winstate->temp_slot_1;
+	MemoryContext frontcontext = peraggstate->frontcontext;
+	int64		base = winstate->frameheadpos;
+	int64		nrows = endpos - base;
+	int64		i;
+
+	Assert(nrows > 0);
+
+	MemoryContextReset(frontcontext);
+	peraggstate->frontValues = (Datum *)
+		MemoryContextAllocHuge(frontcontext, nrows * sizeof(Datum));
+	peraggstate->frontIsNull = (bool *)
+		MemoryContextAllocHuge(frontcontext, nrows * sizeof(bool));
+
+	/* First compute the transition value of each row by itself */
+	for (i = 0; i < nrows; i++)
+	{
+		if (!window_gettupleslot(winstate->agg_winobj, base + i, slot))
+			elog(ERROR, "could not re-fetch previously fetched frame row");
+
+		/* Set tuple context for evaluation of aggregate arguments */
+		winstate->tmpcontext->ecxt_outertuple = slot;
+
+		initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+		advance_windowaggregate(winstate, perfuncstate, peraggstate);
+
+		peraggstate->frontIsNull[i] = peraggstate->transValueIsNull;
+		if (peraggstate->transValueIsNull)
+			peraggstate->frontValues[i] = (Datum) 0;
+		else
+		{
+			MemoryContext oldContext = MemoryContextSwitchTo(frontcontext);
+
+			peraggstate->frontValues[i] = datumCopy(peraggstate->transValue,
+													peraggstate->transtypeByVal,
+													peraggstate->transtypeLen);
+			MemoryContextSwitchTo(oldContext);
+		}
+
+		ResetExprContext(winstate->tmpcontext);
+		ExecClearTuple(slot);
+	}
+
+	/* Then fold them into suffix values, from the last row backwards */
+	for (i = nrows - 2; i >= 0; i--)
+	{
+		combine_windowaggregate(winstate, perfuncstate, peraggstate,
+								&peraggstate->frontValues[i],
+								&peraggstate->frontIsNull[i],
+								peraggstate->frontValues[i + 1],
+								peraggstate->frontIsNull[i + 1],
+								frontcontext);
+		ResetExprContext(winstate->tmpcontext);
+	}
+
+	/* The rows now all live in the front part */
+	initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+	peraggstate->frontbase = base;
+	peraggstate->frontpos = endpos;
+}
+
 /*
  * finalize_windowaggregate
  * parallel to finalize_aggregate in nodeAgg.c
@@ -666,6 +846,7 @@ eval_windowaggregates(WindowAggState *winstate)
 	int			wfuncno,
 				numaggs,
 				numaggs_restart,
+				numaggs_sliding,
 				i;
 	int64		aggregatedupto_nonrestarted;
 	MemoryContext oldContext;
@@ -710,6 +891,17 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * must perform the aggregation all over again for all tuples within the
 	 * new frame boundaries.
 	 *
+	 * Aggregates that have no inverse transition function but do have a
+	 * combine function (and a transition type we can copy) are run as
+	 * "sliding" aggregates instead of being restarted.  The frame is then
+	 * kept in two parts, like a queue made of two stacks: a front part of
+	 * precomputed combined values, one for each possible frame head, and a
+	 * back part that is the ordinary running transition value.  Rows leaving
+	 * the frame are dropped from the front part just by moving the head;
+	 * when the front part is used up, the rows of the back part are moved
+	 * into it (see rebuild_windowaggregate_front).  The aggregate value is
+	 * then the front value for the current head combined with the back part.
+	 *
 	 * If there's any exclusion clause, then we may have to aggregate over a
 	 * non-contiguous set of rows, so we punt and recalculate for every row.
 	 * (For some frame end choices, it might be that the frame is always
@@ -781,12 +973,14 @@ eval_windowaggregates(WindowAggState *winstate)
 	 *----------
 	 */
 	numaggs_restart = 0;
+	numaggs_sliding = 0;
 	for (i = 0; i < numaggs; i++)
 	{
 		peraggstate = &winstate->peragg[i];
 		if (winstate->currentpos == 0 ||
 			(winstate->aggregatedbase != winstate->frameheadpos &&
-			 !OidIsValid(peraggstate->invtransfn_oid)) ||
+			 !OidIsValid(peraggstate->invtransfn_oid) &&
+			 !peraggstate->sliding) ||
 			(winstate->frameOptions & FRAMEOPTION_EXCLUSION) ||
 			winstate->aggregatedupto <= winstate->frameheadpos)
 		{
@@ -794,7 +988,11 @@ eval_windowaggregates(WindowAggState *winstate)
 			numaggs_restart++;
 		}
 		else
+		{
 			peraggstate->restart = false;
+			if (peraggstate->sliding)
+				numaggs_sliding++;
+		}
 	}
 
 	/*
@@ -802,9 +1000,10 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * aggregatedbase to match the frame's head by removing input rows that
 	 * fell off the top of the frame from the aggregations.  This can fail,
 	 * i.e. advance_windowaggregate_base() can return false, in which case
-	 * we'll restart that aggregate below.
+	 * we'll restart that aggregate below.  Sliding aggregates don't need
+	 * this; they just follow the frame head.
 	 */
-	while (numaggs_restart < numaggs &&
+	while (numaggs_restart + numaggs_sliding < numaggs &&
 		   winstate->aggregatedbase < winstate->frameheadpos)
 	{
 		/*
@@ -827,7 +1026,7 @@ eval_windowaggregates(WindowAggState *winstate)
 			bool		ok;
 
 			peraggstate = &winstate->peragg[i];
-			if (peraggstate->restart)
+			if (peraggstate->restart || peraggstate->sliding)
 				continue;
 
 			wfuncno = peraggstate->wfuncno;
@@ -891,6 +1090,15 @@ eval_windowaggregates(WindowAggState *winstate)
 			initialize_windowaggregate(winstate,
 									   &winstate->perfunc[wfuncno],
 									   peraggstate);
+			if (peraggstate->sliding)
+			{
+				/* start over with an empty front part */
+				MemoryContextReset(peraggstate->frontcontext);
+				peraggstate->frontValues = NULL;
+				peraggstate->frontIsNull = NULL;
+				peraggstate->frontbase = winstate->frameheadpos;
+				peraggstate->frontpos = winstate->frameheadpos;
+			}
 		}
 		else if (!peraggstate->resultValueIsNull)
 		{
@@ -919,6 +1127,24 @@ eval_windowaggregates(WindowAggState *winstate)
 		ExecClearTuple(agg_row_slot);
 	}
 
+	/*
+	 * If the frame head of a sliding aggregate has moved beyond its front
+	 * part, move the rows it has aggregated so far into the front part.
+	 */
+	for (i = 0; i < numaggs && numaggs_sliding > 0; i++)
+	{
+		peraggstate = &winstate->peragg[i];
+		if (peraggstate->sliding && !peraggstate->restart &&
+			winstate->frameheadpos >= peraggstate->frontpos)
+		{
+			wfuncno = peraggstate->wfuncno;
+			rebuild_windowaggregate_front(winstate,
+										  &winstate->perfunc[wfuncno],
+										  peraggstate,
+										  aggregatedupto_nonrestarted);
+		}
+	}
+
 	/*
 	 * Advance until we reach a row not in frame (or end of partition).
 	 *
@@ -991,10 +1217,50 @@ next_tuple:
 		wfuncno = peraggstate->wfuncno;
 		result = &econtext->ecxt_aggvalues[wfuncno];
 		isnull = &econtext->ecxt_aggnulls[wfuncno];
-		finalize_windowaggregate(winstate,
-								 &winstate->perfunc[wfuncno],
-								 peraggstate,
-								 result, isnull);
+
+		if (peraggstate->sliding &&
+			winstate->frameheadpos < peraggstate->frontpos)
+		{
+			int64		frontno = winstate->frameheadpos - peraggstate->frontbase;
+			Datum		transValue = peraggstate->transValue;
+			bool		transValueIsNull = peraggstate->transValueIsNull;
+			Datum		value = (Datum) 0;
+			bool		valueIsNull = peraggstate->frontIsNull[frontno];
+
+			/*
+			 * Combine a copy of the front value for this frame head with the
+			 * back part, in the output tuple's memory, and finalize that.
+			 */
+			if (!valueIsNull)
+			{
+				oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+				value = datumCopy(peraggstate->frontValues[frontno],
+								  peraggstate->transtypeByVal,
+								  peraggstate->transtypeLen);
+				MemoryContextSwitchTo(oldContext);
+			}
+			combine_windowaggregate(winstate,
+									&winstate->perfunc[wfuncno],
+									peraggstate,
+									&value, &valueIsNull,
+									transValue, transValueIsNull,
+									econtext->ecxt_per_tuple_memory);
+			ResetExprContext(winstate->tmpcontext);
+
+			peraggstate->transValue = value;
+			peraggstate->transValueIsNull = valueIsNull;
+			finalize_windowaggregate(winstate,
+									 &winstate->perfunc[wfuncno],
+									 peraggstate,
+									 result, isnull);
+			peraggstate->transValue = transValue;
+			peraggstate->transValueIsNull = transValueIsNull;
+		}
+		else
+			finalize_windowaggregate(winstate,
+									 &winstate->perfunc[wfuncno],
+									 peraggstate,
+									 result, isnull);
 
 		/*
 		 * save the result in case next row shares the same frame.
@@ -1357,6 +1623,12 @@ release_partition(WindowAggState *winstate)
 	{
 		if (winstate->peragg[i].aggcontext != winstate->aggcontext)
 			MemoryContextResetAndDeleteChildren(winstate->peragg[i].aggcontext);
+		if (winstate->peragg[i].sliding)
+		{
+			MemoryContextResetAndDeleteChildren(winstate->peragg[i].frontcontext);
+			winstate->peragg[i].frontValues = NULL;
+			winstate->peragg[i].frontIsNull = NULL;
+		}
 	}
 
 	if (winstate->buffer)
@@ -2776,12 +3048,14 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	bool		use_ma_code;
 	Oid			transfn_oid,
 				invtransfn_oid,
-				finalfn_oid;
+				finalfn_oid,
+				combinefn_oid;
 	bool		finalextra;
 	char		finalmodify;
 	Expr	   *transfnexpr,
 			   *invtransfnexpr,
-			   *finalfnexpr;
+			   *finalfnexpr,
+			   *combinefnexpr;
 	Datum		textInitVal;
 	int			i;
 	ListCell   *lc;
@@ -2852,6 +3126,26 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		initvalAttNo = Anum_pg_aggregate_agginitval;
 	}
 
+	/*
+	 * Without moving-aggregate support, we can still avoid restarting the
+	 * aggregation for each frame head if the aggregate has a combine
+	 * function; see eval_windowaggregates().  The same concerns about
+	 * volatile arguments apply as above, and we need to copy transition
+	 * values, so an INTERNAL transtype won't do.  EXCLUDE frames restart
+	 * anyway.
+	 */
+	if (!use_ma_code &&
+		OidIsValid(aggform->aggcombinefn) &&
+		aggtranstype != INTERNALOID &&
+		!(winstate->frameOptions & (FRAMEOPTION_START_UNBOUNDED_PRECEDING |
+									FRAMEOPTION_EXCLUSION)) &&
+		!contain_volatile_functions((Node *) wfunc) &&
+		!contain_subplans((Node *) wfunc))
+		peraggstate->combinefn_oid = combinefn_oid = aggform->aggcombinefn;
+	else
+		peraggstate->combinefn_oid = combinefn_oid = InvalidOid;
+	peraggstate->sliding = OidIsValid(combinefn_oid);
+
 	/*
 	 * ExecInitWindowAgg already checked permission to call aggregate function
 	 * ... but we still need to check the component functions
@@ -2887,6 +3181,16 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 			InvokeFunctionExecuteHook(invtransfn_oid);
 		}
 
+		if (OidIsValid(combinefn_oid))
+		{
+			aclresult = object_aclcheck(ProcedureRelationId, combinefn_oid, aggOwner,
+										ACL_EXECUTE);
+			if (aclresult != ACLCHECK_OK)
+				aclcheck_error(aclresult, OBJECT_FUNCTION,
+							   get_func_name(combinefn_oid));
+			InvokeFunctionExecuteHook(combinefn_oid);
+		}
+
 		if (OidIsValid(finalfn_oid))
 		{
 			aclresult = object_aclcheck(ProcedureRelationId, finalfn_oid, aggOwner,
@@ -2943,6 +3247,23 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		fmgr_info_set_expr((Node *) invtransfnexpr, &peraggstate->invtransfn);
 	}
 
+	if (OidIsValid(combinefn_oid))
+	{
+		/* the combine function takes two values of the transition type */
+		build_aggregate_transfn_expr(&aggtranstype,
+									 1,
+									 0,
+									 false,
+									 aggtranstype,
+									 wfunc->inputcollid,
+									 combinefn_oid,
+									 InvalidOid,
+									 &combinefnexpr,
+									 NULL);
+		fmgr_info(combinefn_oid, &peraggstate->combinefn);
+		fmgr_info_set_expr((Node *) combinefnexpr, &peraggstate->combinefn);
+	}
+
 	if (OidIsValid(finalfn_oid))
 	{
 		build_aggregate_finalfn_expr(inputTypes,
@@ -3022,7 +3343,7 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	 * they have historically been for plain aggregates, but that seems grotty
 	 * and likely to lead to memory leaks.
 	 */
-	if (OidIsValid(invtransfn_oid))
+	if (OidIsValid(invtransfn_oid) || peraggstate->sliding)
 		peraggstate->aggcontext =
 			AllocSetContextCreate(CurrentMemoryContext,
 								  "WindowAgg Per Aggregate",
@@ -3030,6 +3351,19 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	else
 		peraggstate->aggcontext = winstate->aggcontext;
 
+	/* Sliding aggregates also keep their front part separately */
+	if (peraggstate->sliding)
+		peraggstate->frontcontext =
+			AllocSetContextCreate(CurrentMemoryContext,
+								  "WindowAgg Sliding Aggregate",
+								  ALLOCSET_DEFAULT_SIZES);
+	else
+		peraggstate->frontcontext = NULL;
+	peraggstate->frontValues = NULL;
+	peraggstate->frontIsNull = NULL;
+	peraggstate->frontbase = 0;
+	peraggstate->frontpos = 0;
+
 	ReleaseSysCache(aggTuple);
 
 	return peraggstate;
@@ -8,6 +8,14 @@
  *
  * A TupleQueueReader reads tuples from a shm_mq and returns the tuples.
  *
+ * Small tuples are not sent as messages of their own: the sender collects
+ * them into a batch of up to TQUEUE_BATCH_SIZE bytes, which goes into the
+ * queue as a single message, so that the per-message work on both sides is
+ * paid once per batch rather than once per tuple.  A message is just a
+ * sequence of MinimalTuples, each starting at a MAXALIGN'd offset, whose
+ * t_len fields delimit them; a large tuple travels alone in a message of
+ * the same form.
+ *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -22,29 +30,72 @@
 #include "access/htup_details.h"
 #include "executor/tqueue.h"
 
+/*
+ * Size of a batch of tuples.  This is well below the size of a parallel
+ * tuple queue, and shm_mq doesn't publish what's been written until a
+ * quarter of the queue is full anyway, so batching adds no latency.
+ */
+#define TQUEUE_BATCH_SIZE		8192
+
 /*
  * DestReceiver object's private contents
  *
- * queue is a pointer to data supplied by DestReceiver's caller.
+ * queue is a pointer to data supplied by DestReceiver's caller.  batch holds
+ * batch_len bytes of tuples not sent yet.
  */
 typedef struct TQueueDestReceiver
 {
 	DestReceiver pub;			/* public fields */
 	shm_mq_handle *queue;		/* shm_mq to send to */
+	char	   *batch;			/* TQUEUE_BATCH_SIZE bytes, or NULL */
+	Size		batch_len;		/* bytes used in batch */
 } TQueueDestReceiver;
 
 /*
  * TupleQueueReader object's private contents
  *
- * queue is a pointer to data supplied by reader's caller.
+ * queue is a pointer to data supplied by reader's caller.  message and
+ * message_len describe the last message received, of which message_off
+ * bytes have been returned as tuples.
  *
  * "typedef struct TupleQueueReader TupleQueueReader" is in tqueue.h
  */
 struct TupleQueueReader
 {
 	shm_mq_handle *queue;		/* shm_mq to receive from */
+	char	   *message;		/* last message received */
+	Size		message_len;	/* its length */
+	Size		message_off;	/* offset of the next tuple in it */
 };
 
+/*
+ * Send the pending batch of tuples, if any.
+ *
+ * Returns true if successful, false if shm_mq has been detached.
+ */
+static bool
+tqueueFlushBatch(TQueueDestReceiver *tqueue)
+{
+	shm_mq_result result;
+
+	if (tqueue->batch_len == 0)
+		return true;
+
+	result = shm_mq_send(tqueue->queue, tqueue->batch_len, tqueue->batch,
+						 false, false);
+	tqueue->batch_len = 0;
+
+	/* Check for failure. */
+	if (result == SHM_MQ_DETACHED)
+		return false;
+	else if (result != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not send tuple to shared-memory queue")));
+
+	return true;
+}
+
 /*
  * Receive a tuple from a query, and send it to the designated shm_mq.
  *
@@ -57,9 +108,43 @@ tqueueReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
 	MinimalTuple tuple;
 	shm_mq_result result;
 	bool		should_free;
+	Size		offset;
 
-	/* Send the tuple itself. */
 	tuple = ExecFetchSlotMinimalTuple(slot, &should_free);
+
+	/*
+	 * If the tuple doesn't fit in the batch, or is going to be sent by
+	 * itself, send what we have so far; Gather Merge relies on each worker's
+	 * tuples arriving in order.
+	 */
+	offset = MAXALIGN(tqueue->batch_len);
+	if (tqueue->batch_len > 0 &&
+		(offset + tuple->t_len > TQUEUE_BATCH_SIZE ||
+		 tuple->t_len > TQUEUE_BATCH_SIZE / 2))
+	{
+		if (!tqueueFlushBatch(tqueue))
+		{
+			if (should_free)
+				pfree(tuple);
+			return false;
+		}
+		offset = 0;
+	}
+
+	/* Add the tuple to the batch, unless it's too large to share one. */
+	if (tuple->t_len <= TQUEUE_BATCH_SIZE / 2)
+	{
+		if (tqueue->batch == NULL)
+			tqueue->batch = palloc(TQUEUE_BATCH_SIZE);
+		memcpy(tqueue->batch + offset, tuple, tuple->t_len);
+		tqueue->batch_len = offset + tuple->t_len;
+
+		if (should_free)
+			pfree(tuple);
+		return true;
+	}
+
+	/* Send the tuple itself. */
 	result = shm_mq_send(tqueue->queue, tuple->t_len, tuple, false, false);
 
 	if (should_free)
@@ -94,7 +179,10 @@ tqueueShutdownReceiver(DestReceiver *self)
 	TQueueDestReceiver *tqueue = (TQueueDestReceiver *) self;
 
 	if (tqueue->queue != NULL)
+	{
+		(void) tqueueFlushBatch(tqueue);
 		shm_mq_detach(tqueue->queue);
+	}
 	tqueue->queue = NULL;
 }
 
@@ -109,6 +197,8 @@ tqueueDestroyReceiver(DestReceiver *self)
 	/* We probably already detached from queue, but let's be sure */
 	if (tqueue->queue != NULL)
 		shm_mq_detach(tqueue->queue);
+	if (tqueue->batch != NULL)
+		pfree(tqueue->batch);
 	pfree(self);
 }
 
@@ -183,6 +273,15 @@ TupleQueueReaderNext(TupleQueueReader *reader, bool nowait, bool *done)
 	if (done != NULL)
 		*done = false;
 
+	/* Return the next tuple of the last message, if there's one left. */
+	if (reader->message_off < reader->message_len)
+	{
+		tuple = (MinimalTuple) (reader->message + reader->message_off);
+		reader->message_off = MAXALIGN(reader->message_off + tuple->t_len);
+		Assert(reader->message_off <= MAXALIGN(reader->message_len));
+		return tuple;
+	}
+
 	/* Attempt to read a message. */
 	result = shm_mq_receive(reader->queue, &nbytes, &data, nowait);
 
@@ -201,10 +300,14 @@ TupleQueueReaderNext(TupleQueueReader *reader, bool nowait, bool *done)
 
 	/*
 	 * Return a pointer to the queue memory directly (which had better be
-	 * sufficiently aligned).
+	 * sufficiently aligned).  The message stays valid until the next call to
+	 * shm_mq_receive(), so the rest of a batch is returned from there too.
 	 */
 	tuple = (MinimalTuple) data;
-	Assert(tuple->t_len == nbytes);
+	Assert(tuple->t_len <= nbytes);
+	reader->message = (char *) data;
+	reader->message_len = nbytes;
+	reader->message_off = MAXALIGN(tuple->t_len);
 
 	return tuple;
 }
@@ -7,6 +7,12 @@
  * knowledge of the tuple descriptor. Fixed column widths, NOT NULLness, etc
  * can be taken advantage of.
  *
+ * The generated code depends only on the shape of the tuple descriptor, the
+ * slot type and the number of columns to deform; it contains no pointers to
+ * query-lifetime data.  So, unlike expressions, deform functions are kept in
+ * a backend-lifetime cache (see jit_cache_size), and a query that deforms
+ * tuples of a shape seen before calls the function compiled back then.
+ *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -22,17 +28,275 @@
 
 #include "access/htup_details.h"
 #include "access/tupdesc_details.h"
+#include "common/hashfn.h"
 #include "executor/tuptable.h"
 #include "jit/llvmjit.h"
 #include "jit/llvmjit_emit.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
 
 
 /*
- * Create a function that deforms a tuple of type desc up to natts columns.
+ * Cache of compiled deform functions.  The key describes everything the
+ * generated code depends on.
+ */
+typedef struct DeformCacheAttr
+{
+	int16		attlen;
+	char		attalign;
+	bool		attbyval;
+	bool		attnotnull;
+} DeformCacheAttr;
+
+typedef struct DeformCacheKey
+{
+	const TupleTableSlotOps *ops;
+	int			natts;			/* number of columns to deform */
+	int			guaranteed;		/* last column guaranteed to exist */
+	DeformCacheAttr *atts;		/* natts entries */
+} DeformCacheKey;
+
+typedef struct DeformCacheEntry
+{
+	DeformCacheKey key;			/* must be first */
+	void	   *fn;				/* compiled function */
+} DeformCacheEntry;
+
+static HTAB *deform_cache = NULL;
+
+/* context that owns the cached functions, never released */
+static LLVMJitContext *deform_cache_context = NULL;
+
+static LLVMValueRef slot_build_deform(LLVMJitContext *context, TupleDesc desc,
+									  const TupleTableSlotOps *ops, int natts,
+									  bool cached);
+static int	deform_guaranteed_column(TupleDesc desc);
+static void *deform_cache_lookup(LLVMJitContext *context, TupleDesc desc,
+								 const TupleTableSlotOps *ops, int natts);
+static uint32 deform_cache_hash(const void *key, Size keysize);
+static int	deform_cache_match(const void *key1, const void *key2, Size keysize);
+
+
+/*
+ * Return a function that deforms a tuple of type desc up to natts columns,
+ * or NULL if we don't JIT deforming for this kind of slot.
+ *
+ * The result is either a function created in context's module, or a pointer
+ * to a cached function; either way, it has the type returned by
+ * slot_deform_func_type().
  */
 LLVMValueRef
 slot_compile_deform(LLVMJitContext *context, TupleDesc desc,
 					const TupleTableSlotOps *ops, int natts)
+{
+	void	   *fn;
+
+	/* virtual tuples never need deforming, so don't generate code */
+	if (ops == &TTSOpsVirtual)
+		return NULL;
+
+	/* decline to JIT for slot types we don't know to handle */
+	if (ops != &TTSOpsHeapTuple && ops != &TTSOpsBufferHeapTuple &&
+		ops != &TTSOpsMinimalTuple)
+		return NULL;
+
+	if (jit_cache_size > 0 &&
+		(fn = deform_cache_lookup(context, desc, ops, natts)) != NULL)
+		return l_ptr_const(fn, l_ptr(slot_deform_func_type()));
+
+	return slot_build_deform(context, desc, ops, natts, false);
+}
+
+/*
+ * Type of deform functions.
+ */
+LLVMTypeRef
+slot_deform_func_type(void)
+{
+	LLVMTypeRef param_types[1];
+
+	param_types[0] = l_ptr(StructTupleTableSlot);
+
+	return LLVMFunctionType(LLVMVoidType(), param_types,
+							lengthof(param_types), 0);
+}
+
+/*
+ * Check which columns have to exist, so we don't have to check the row's
+ * natts unnecessarily.  Returns the last such column (0 indexed), or -1.
+ */
+static int
+deform_guaranteed_column(TupleDesc desc)
+{
+	int			guaranteed_column_number = -1;
+	int			attnum;
+
+	for (attnum = 0; attnum < desc->natts; attnum++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, attnum);
+
+		/*
+		 * If the column is declared NOT NULL then it must be present in every
+		 * tuple, unless there's a "missing" entry that could provide a
+		 * non-NULL value for it. That in turn guarantees that the NULL bitmap
+		 * - if there are any NULLable columns - is at least long enough to
+		 * cover columns up to attnum.
+		 *
+		 * Be paranoid and also check !attisdropped, even though the
+		 * combination of attisdropped && attnotnull combination shouldn't
+		 * exist.
+		 */
+		if (att->attnotnull &&
+			!att->atthasmissing &&
+			!att->attisdropped)
+			guaranteed_column_number = attnum;
+	}
+
+	return guaranteed_column_number;
+}
+
+/*
+ * Look up the deform function for desc, ops and natts in the cache,
+ * compiling and adding it if there's room.  Returns NULL if it's neither
+ * cached nor added.
+ *
+ * Cached functions are compiled in a context of their own, with full
+ * optimization since the cost is amortized over many queries.  The time
+ * spent is accounted to context's instrumentation.
+ */
+static void *
+deform_cache_lookup(LLVMJitContext *context, TupleDesc desc,
+					const TupleTableSlotOps *ops, int natts)
+{
+	DeformCacheKey key;
+	DeformCacheEntry *entry;
+	LLVMValueRef v_deform_fn;
+	char	   *funcname;
+	void	   *fn;
+	bool		found;
+	int			attnum;
+
+	if (deform_cache == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(DeformCacheKey);
+		ctl.entrysize = sizeof(DeformCacheEntry);
+		ctl.hash = deform_cache_hash;
+		ctl.match = deform_cache_match;
+		deform_cache = hash_create("JIT deform cache", 64, &ctl,
+								   HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+	}
+
+	key.ops = ops;
+	key.natts = natts;
+	key.guaranteed = deform_guaranteed_column(desc);
+	key.atts = palloc(sizeof(DeformCacheAttr) * Max(natts, 1));
+	for (attnum = 0; attnum < natts; attnum++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, attnum);
+
+		/* zero padding, as the entries are hashed and compared bytewise */
+		memset(&key.atts[attnum], 0, sizeof(DeformCacheAttr));
+		key.atts[attnum].attlen = att->attlen;
+		key.atts[attnum].attalign = att->attalign;
+		key.atts[attnum].attbyval = att->attbyval;
+		key.atts[attnum].attnotnull = att->attnotnull;
+	}
+
+	entry = (DeformCacheEntry *) hash_search(deform_cache, &key, HASH_FIND,
+											 NULL);
+	if (entry != NULL)
+	{
+		pfree(key.atts);
+		return entry->fn;
+	}
+
+	if (hash_get_num_entries(deform_cache) >= jit_cache_size)
+	{
+		pfree(key.atts);
+		return NULL;
+	}
+
+	if (deform_cache_context == NULL)
+	{
+		deform_cache_context = MemoryContextAllocZero(TopMemoryContext,
+													  sizeof(LLVMJitContext));
+		deform_cache_context->base.flags =
+			PGJIT_PERFORM | PGJIT_OPT3 | PGJIT_DEFORM;
+	}
+
+	/* forget a module left behind by an error while building one */
+	if (deform_cache_context->module)
+	{
+		LLVMDisposeModule(deform_cache_context->module);
+		deform_cache_context->module = NULL;
+	}
+
+	v_deform_fn = slot_build_deform(deform_cache_context, desc, ops, natts,
+									true);
+	funcname = pstrdup(LLVMGetValueName(v_deform_fn));
+	fn = llvm_get_function(deform_cache_context, funcname);
+	pfree(funcname);
+
+	/* account the work to the query that needed it */
+	INSTR_TIME_ADD(context->base.instr.optimization_counter,
+				   deform_cache_context->base.instr.optimization_counter);
+	INSTR_TIME_ADD(context->base.instr.emission_counter,
+				   deform_cache_context->base.instr.emission_counter);
+	context->base.instr.created_functions +=
+		deform_cache_context->base.instr.created_functions;
+	memset(&deform_cache_context->base.instr, 0, sizeof(JitInstrumentation));
+
+	entry = (DeformCacheEntry *) hash_search(deform_cache, &key, HASH_ENTER,
+											 &found);
+	Assert(!found);
+	entry->key.atts = MemoryContextAlloc(TopMemoryContext,
+										 sizeof(DeformCacheAttr) * Max(natts, 1));
+	memcpy(entry->key.atts, key.atts, sizeof(DeformCacheAttr) * natts);
+	entry->fn = fn;
+	pfree(key.atts);
+
+	return fn;
+}
+
+static uint32
+deform_cache_hash(const void *key, Size keysize)
+{
+	const DeformCacheKey *k = (const DeformCacheKey *) key;
+	uint32		hash;
+
+	hash = hash_bytes((const unsigned char *) k->atts,
+					  sizeof(DeformCacheAttr) * k->natts);
+	hash = hash_combine(hash, hash_bytes_uint32((uint32) k->natts));
+	hash = hash_combine(hash, hash_bytes_uint32((uint32) k->guaranteed));
+	hash = hash_combine(hash,
+						hash_bytes_uint32((uint32) (uintptr_t) k->ops));
+
+	return hash;
+}
+
+static int
+deform_cache_match(const void *key1, const void *key2, Size keysize)
+{
+	const DeformCacheKey *k1 = (const DeformCacheKey *) key1;
+	const DeformCacheKey *k2 = (const DeformCacheKey *) key2;
+
+	if (k1->ops != k2->ops || k1->natts != k2->natts ||
+		k1->guaranteed != k2->guaranteed)
+		return 1;
+
+	return memcmp(k1->atts, k2->atts, sizeof(DeformCacheAttr) * k1->natts);
+}
+
+/*
+ * Create a function that deforms a tuple of type desc up to natts columns,
+ * in context's module.  Unless it's for the cache, the function is internal
+ * to the module.
+ */
+static LLVMValueRef
+slot_build_deform(LLVMJitContext *context, TupleDesc desc,
+				  const TupleTableSlotOps *ops, int natts, bool cached)
 {
 	char	   *funcname;
 
@@ -79,7 +343,7 @@ slot_compile_deform(LLVMJitContext *context, TupleDesc desc,
 	LLVMValueRef v_hasnulls;
 
 	/* last column (0 indexed) guaranteed to exist */
-	int			guaranteed_column_number = -1;
+	int			guaranteed_column_number;
 
 	/* current known alignment */
 	int			known_alignment = 0;
@@ -89,55 +353,17 @@ slot_compile_deform(LLVMJitContext *context, TupleDesc desc,
 
 	int			attnum;
 
-	/* virtual tuples never need deforming, so don't generate code */
-	if (ops == &TTSOpsVirtual)
-		return NULL;
-
-	/* decline to JIT for slot types we don't know to handle */
-	if (ops != &TTSOpsHeapTuple && ops != &TTSOpsBufferHeapTuple &&
-		ops != &TTSOpsMinimalTuple)
-		return NULL;
-
 	mod = llvm_mutable_module(context);
 
 	funcname = llvm_expand_funcname(context, "deform");
 
-	/*
-	 * Check which columns have to exist, so we don't have to check the row's
-	 * natts unnecessarily.
-	 */
-	for (attnum = 0; attnum < desc->natts; attnum++)
-	{
-		Form_pg_attribute att = TupleDescAttr(desc, attnum);
-
-		/*
-		 * If the column is declared NOT NULL then it must be present in every
-		 * tuple, unless there's a "missing" entry that could provide a
-		 * non-NULL value for it. That in turn guarantees that the NULL bitmap
-		 * - if there are any NULLable columns - is at least long enough to
-		 * cover columns up to attnum.
-		 *
-		 * Be paranoid and also check !attisdropped, even though the
-		 * combination of attisdropped && attnotnull combination shouldn't
-		 * exist.
-		 */
-		if (att->attnotnull &&
-			!att->atthasmissing &&
-			!att->attisdropped)
-			guaranteed_column_number = attnum;
-	}
+	guaranteed_column_number = deform_guaranteed_column(desc);
 
 	/* Create the signature and function */
-	{
-		LLVMTypeRef param_types[1];
-
-		param_types[0] = l_ptr(StructTupleTableSlot);
-
-		deform_sig = LLVMFunctionType(LLVMVoidType(), param_types,
-									  lengthof(param_types), 0);
-	}
+	deform_sig = slot_deform_func_type();
 	v_deform_fn = LLVMAddFunction(mod, funcname, deform_sig);
-	LLVMSetLinkage(v_deform_fn, LLVMInternalLinkage);
+	if (!cached)
+		LLVMSetLinkage(v_deform_fn, LLVMInternalLinkage);
 	LLVMSetParamAlignment(LLVMGetParam(v_deform_fn, 0), MAXIMUM_ALIGNOF);
 	llvm_copy_attributes(AttributeTemplate, v_deform_fn);
 
@@ -49,10 +49,16 @@ typedef struct CompiledExprState
 {
 	LLVMJitContext *context;
 	const char *funcname;
+
+	/* interpreted execution until the code is emitted, see ExecRunTieredExpr */
+	ExprStateEvalFunc interp_func;
+	int			interp_calls_left;
+	bool		checked;
 } CompiledExprState;
 
 
 static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull);
+static Datum ExecRunTieredExpr(ExprState *state, ExprContext *econtext, bool *isNull);
 
 static LLVMValueRef BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 								LLVMModuleRef mod, FunctionCallInfo fcinfo,
@@ -364,7 +370,7 @@ llvm_compile_expr(ExprState *state)
 						params[0] = v_slot;
 
 						l_call(b,
-							   LLVMGetFunctionType(l_jit_deform),
+							   slot_deform_func_type(),
 							   l_jit_deform,
 							   params, lengthof(params), "");
 					}
@@ -673,6 +679,17 @@ llvm_compile_expr(ExprState *state)
 				LLVMBuildBr(b, opblocks[opno + 1]);
 				break;
 
+				/*
+				 * Not generated for expressions to be JIT compiled, as
+				 * inlining the operator's function works better.
+				 */
+			case EEOP_CMP_VAR_CONST:
+			case EEOP_CMP_VAR_VAR:
+				build_EvalXFunc(b, mod, "ExecEvalCmpVar",
+								v_state, op, v_econtext);
+				LLVMBuildBr(b, opblocks[opno + 1]);
+				break;
+
 				/*
 				 * Treat them the same for now, optimizer can remove
 				 * redundancy. Could be worthwhile to optimize during emission
@@ -2473,6 +2490,19 @@ llvm_compile_expr(ExprState *state)
 					break;
 				}
 
+				/* likewise only used without JIT */
+			case EEOP_AGG_PLAIN_TRANS_COUNT:
+				build_EvalXFunc(b, mod, "ExecEvalAggPlainTransCount",
+								v_state, op);
+				LLVMBuildBr(b, opblocks[opno + 1]);
+				break;
+
+			case EEOP_AGG_PLAIN_TRANS_INT_SUM:
+				build_EvalXFunc(b, mod, "ExecEvalAggPlainTransIntSum",
+								v_state, op);
+				LLVMBuildBr(b, opblocks[opno + 1]);
+				break;
+
 			case EEOP_AGG_ORDERED_TRANS_DATUM:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransDatum",
 								v_state, op, v_econtext);
@@ -2506,7 +2536,22 @@ llvm_compile_expr(ExprState *state)
 		cstate->context = context;
 		cstate->funcname = funcname;
 
-		state->evalfunc = ExecRunCompiledExpr;
+		if (jit_warmup_evaluations > 0)
+		{
+			/*
+			 * Evaluate with the interpreter for the first evaluations, so
+			 * that queries ending soon don't pay for emitting the code at
+			 * all.  The interpreter's entry point doesn't use
+			 * evalfunc_private, so that can point to our state.
+			 */
+			ExecReadyInterpretedExpr(state);
+			cstate->interp_func = (ExprStateEvalFunc) state->evalfunc_private;
+			cstate->interp_calls_left = jit_warmup_evaluations;
+
+			state->evalfunc = ExecRunTieredExpr;
+		}
+		else
+			state->evalfunc = ExecRunCompiledExpr;
 		state->evalfunc_private = cstate;
 	}
 
@@ -2547,6 +2592,35 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 	return func(state, econtext, isNull);
 }
 
+/*
+ * Run an expression for which code has been generated, but not yet emitted.
+ *
+ * The expression is evaluated by the interpreter until it has been called
+ * jit_warmup_evaluations times, then we switch to the compiled code.  The
+ * switch happens between evaluations, so no evaluation ever sees a mix of
+ * both.  If another expression of the same context has already triggered
+ * emission, switching costs nothing, so it's done right away.
+ */
+static Datum
+ExecRunTieredExpr(ExprState *state, ExprContext *econtext, bool *isNull)
+{
+	CompiledExprState *cstate = state->evalfunc_private;
+
+	if (cstate->interp_calls_left > 0 && !cstate->context->compiled)
+	{
+		if (!cstate->checked)
+		{
+			CheckExprStillValid(state, econtext);
+			cstate->checked = true;
+		}
+		cstate->interp_calls_left--;
+
+		return cstate->interp_func(state, econtext, isNull);
+	}
+
+	return ExecRunCompiledExpr(state, econtext, isNull);
+}
+
 static LLVMValueRef
 BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
 			LLVMModuleRef mod, FunctionCallInfo fcinfo,
@@ -143,8 +143,11 @@ void	   *referenced_functions[] =
 	ExecEvalPreOrderedDistinctMulti,
 	ExecEvalAggOrderedTransDatum,
 	ExecEvalAggOrderedTransTuple,
+	ExecEvalAggPlainTransCount,
+	ExecEvalAggPlainTransIntSum,
 	ExecEvalArrayCoerce,
 	ExecEvalArrayExpr,
+	ExecEvalCmpVar,
 	ExecEvalConstraintCheck,
 	ExecEvalConstraintNotNull,
 	ExecEvalConvertRowtype,
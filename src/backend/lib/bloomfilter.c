@@ -128,6 +128,36 @@ bloom_free(bloom_filter *filter)
 	pfree(filter);
 }
 
+/*
+ * Size of the Bloom filter in bytes, including bookkeeping fields
+ *
+ * A filter is a single chunk of memory without pointers, so it can be copied
+ * elsewhere, such as into shared memory, and used there.
+ */
+Size
+bloom_size(bloom_filter *filter)
+{
+	return offsetof(bloom_filter, bitset) + filter->m / BITS_PER_BYTE;
+}
+
+/*
+ * Add all elements of src to dst
+ *
+ * Both filters must have been created with the same arguments.
+ */
+void
+bloom_union(bloom_filter *dst, bloom_filter *src)
+{
+	uint64		bitset_bytes = dst->m / BITS_PER_BYTE;
+
+	Assert(dst->m == src->m);
+	Assert(dst->k_hash_funcs == src->k_hash_funcs);
+	Assert(dst->seed == src->seed);
+
+	for (uint64 i = 0; i < bitset_bytes; i++)
+		dst->bitset[i] |= src->bitset[i];
+}
+
 /*
  * Add element to Bloom filter
  */
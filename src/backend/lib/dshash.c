@@ -9,16 +9,22 @@
  * supported: the hash table never becomes smaller.
  *
  * To deal with concurrency, it has a fixed size set of partitions, each of
- * which is independently locked.  Each bucket maps to a partition; so insert,
- * find and iterate operations normally only acquire one lock.  Therefore,
- * good concurrency is achieved whenever such operations don't collide at the
- * lock partition level.  However, when a resize operation begins, all
- * partition locks must be acquired simultaneously for a brief period.  This
- * is only expected to happen a small number of times until a stable size is
- * found, since growth is geometric.
+ * which is independently locked.  The partition of a key is chosen by the
+ * highest order bits of its hash, and each partition has its own array of
+ * buckets, indexed by the following bits; so insert, find and iterate
+ * operations only acquire one lock.  Therefore, good concurrency is achieved
+ * whenever such operations don't collide at the lock partition level.
  *
- * Future versions may support iterators and incremental resizing; for now
- * the implementation is minimalist.
+ * Resizing is incremental: a partition whose buckets get too full doubles
+ * its own bucket array while holding just its own lock, which the inserting
+ * backend holds anyway.  So growing the table never stops the whole table,
+ * and a lookup can only wait for the rehashing of the items of one
+ * partition, a small fraction of the table.
+ *
+ * Tables whose entries are never deleted, nor changed once the inserting
+ * backend has released the lock, can be created with unlocked_reads, which
+ * lets dshash_find_unlocked() look entries up without taking any lock.  See
+ * there for details.
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -33,6 +39,7 @@
 
 #include "common/hashfn.h"
 #include "lib/dshash.h"
+#include "port/atomics.h"
 #include "storage/ipc.h"
 #include "storage/lwlock.h"
 #include "utils/dsa.h"
@@ -64,10 +71,21 @@ struct dshash_table_item
 /* A magic value used to identify our hash tables. */
 #define DSHASH_MAGIC 0x75ff6a20
 
+/*
+ * Unlocked reads depend on bucket and next pointers being read and written
+ * atomically.
+ */
+#if SIZEOF_DSA_POINTER == 4 || defined(PG_HAVE_8BYTE_SINGLE_COPY_ATOMICITY)
+#define DSHASH_UNLOCKED_READS_SUPPORTED
+#endif
+
 /*
  * Tracking information for each lock partition.  Initially, each partition
- * corresponds to one bucket, but each time the hash table grows, the buckets
- * covered by each partition split so the number of buckets covered doubles.
+ * has one bucket, which is kept right here; each time the partition grows,
+ * its buckets split so the number of buckets doubles.  Bucket arrays
+ * allocated in the area have one extra element at the end, holding the
+ * previous, retired bucket array of tables with unlocked reads, which
+ * concurrent readers may still be looking at.
  *
  * We might want to add padding here so that each partition is on a different
  * cache line, but doing so would bloat this structure considerably.
@@ -76,6 +94,15 @@ typedef struct dshash_partition
 {
 	LWLock		lock;			/* Protects all buckets in this partition. */
 	size_t		count;			/* # of items in this partition's buckets */
+	size_t		size_log2;		/* log2(number of buckets) */
+	dsa_pointer buckets;		/* bucket array, unless size_log2 is 0 */
+	dsa_pointer bucket0;		/* the only bucket, if size_log2 is 0 */
+
+	/*
+	 * With unlocked reads, odd while the partition's buckets are being
+	 * changed, and advanced each time a change completes.
+	 */
+	pg_atomic_uint32 changecount;
 } dshash_partition;
 
 /*
@@ -88,15 +115,7 @@ typedef struct dshash_table_control
 	uint32		magic;
 	dshash_partition partitions[DSHASH_NUM_PARTITIONS];
 	int			lwlock_tranche_id;
-
-	/*
-	 * The following members are written to only when ALL partitions locks are
-	 * held.  They can be read when any one partition lock is held.
-	 */
-
-	/* Number of buckets expressed as power of 2 (8 = 256 buckets). */
-	size_t		size_log2;		/* log2(number of buckets) */
-	dsa_pointer buckets;		/* current bucket array */
+	bool		unlocked_reads; /* see dshash_find_unlocked() */
 } dshash_table_control;
 
 /*
@@ -108,8 +127,6 @@ struct dshash_table
 	dshash_parameters params;	/* Parameters. */
 	void	   *arg;			/* User-supplied data pointer. */
 	dshash_table_control *control;	/* Control object in DSM. */
-	dsa_pointer *buckets;		/* Current bucket pointers in DSM. */
-	size_t		size_log2;		/* log2(number of buckets) */
 };
 
 /* Given a pointer to an item, find the entry (user data) it holds. */
@@ -121,54 +138,52 @@ struct dshash_table
 	((dshash_table_item *)((char *)(entry) -							\
 							 MAXALIGN(sizeof(dshash_table_item))))
 
-/* How many resize operations (bucket splits) have there been? */
-#define NUM_SPLITS(size_log2)					\
-	(size_log2 - DSHASH_NUM_PARTITIONS_LOG2)
-
 /* How many buckets are there in a given size? */
 #define NUM_BUCKETS(size_log2)		\
 	(((size_t) 1) << (size_log2))
 
-/* How many buckets are there in each partition at a given size? */
-#define BUCKETS_PER_PARTITION(size_log2)		\
-	(((size_t) 1) << NUM_SPLITS(size_log2))
+/* The largest size of a partition, using up all the bits of the hash. */
+#define MAX_PARTITION_SIZE_LOG2		\
+	(sizeof(dshash_hash) * CHAR_BIT - DSHASH_NUM_PARTITIONS_LOG2)
 
 /* Max entries before we need to grow.  Half + quarter = 75% load factor. */
-#define MAX_COUNT_PER_PARTITION(hash_table)				\
-	(BUCKETS_PER_PARTITION(hash_table->size_log2) / 2 + \
-	 BUCKETS_PER_PARTITION(hash_table->size_log2) / 4)
+#define MAX_COUNT_PER_PARTITION(partition)				\
+	(NUM_BUCKETS((partition)->size_log2) / 2 +			\
+	 NUM_BUCKETS((partition)->size_log2) / 4)
 
 /* Choose partition based on the highest order bits of the hash. */
 #define PARTITION_FOR_HASH(hash)										\
 	(hash >> ((sizeof(dshash_hash) * CHAR_BIT) - DSHASH_NUM_PARTITIONS_LOG2))
 
 /*
- * Find the bucket index for a given hash and table size.  Each time the table
- * doubles in size, the appropriate bucket for a given hash value doubles and
- * possibly adds one, depending on the newly revealed bit, so that all buckets
- * are split.
+ * Find the bucket index within its partition for a given hash and partition
+ * size, from the bits that follow those choosing the partition.  Each time a
+ * partition doubles in size, the appropriate bucket for a given hash value
+ * doubles and possibly adds one, depending on the newly revealed bit, so that
+ * all buckets are split.
  */
-#define BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)		\
-	(hash >> ((sizeof(dshash_hash) * CHAR_BIT) - (size_log2)))
+#define BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)					\
+	((size_log2) == 0 ? 0 :												\
+	 ((dshash_hash) ((hash) << DSHASH_NUM_PARTITIONS_LOG2)) >>			\
+	 ((sizeof(dshash_hash) * CHAR_BIT) - (size_log2)))
 
-/* The index of the first bucket in a given partition. */
-#define BUCKET_INDEX_FOR_PARTITION(partition, size_log2)	\
-	((partition) << NUM_SPLITS(size_log2))
-
-/* Choose partition based on bucket index. */
-#define PARTITION_FOR_BUCKET_INDEX(bucket_idx, size_log2)				\
-	((bucket_idx) >> NUM_SPLITS(size_log2))
-
-/* The head of the active bucket for a given hash value (lvalue). */
-#define BUCKET_FOR_HASH(hash_table, hash)								\
-	(hash_table->buckets[												\
-		BUCKET_INDEX_FOR_HASH_AND_SIZE(hash,							\
-									   hash_table->size_log2)])
+/* The head of the bucket for a given hash value in its partition (lvalue). */
+#define BUCKET_FOR_HASH(hash_table, partition, hash)					\
+	(partition_buckets(hash_table, partition)[							\
+		BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, (partition)->size_log2)])
 
 static void delete_item(dshash_table *hash_table,
 						dshash_table_item *item);
-static void resize(dshash_table *hash_table, size_t new_size_log2);
-static inline void ensure_valid_bucket_pointers(dshash_table *hash_table);
+static void resize_partition(dshash_table *hash_table,
+							 dshash_partition *partition);
+static inline dsa_pointer *partition_buckets(dshash_table *hash_table,
+											 dshash_partition *partition);
+static inline void begin_change(dshash_table *hash_table,
+								dshash_partition *partition);
+static inline void end_change(dshash_table *hash_table,
+							  dshash_partition *partition);
+static inline void end_abandoned_change(dshash_table *hash_table,
+										dshash_partition *partition);
 static inline dshash_table_item *find_in_bucket(dshash_table *hash_table,
 												const void *key,
 												dsa_pointer item_pointer);
@@ -178,6 +193,7 @@ static void insert_item_into_bucket(dshash_table *hash_table,
 									dsa_pointer *bucket);
 static dshash_table_item *insert_into_bucket(dshash_table *hash_table,
 											 const void *key,
+											 dshash_hash hash,
 											 dsa_pointer *bucket);
 static bool delete_key_from_bucket(dshash_table *hash_table,
 								   const void *key,
@@ -222,8 +238,12 @@ dshash_create(dsa_area *area, const dshash_parameters *params, void *arg)
 	hash_table->control->handle = control;
 	hash_table->control->magic = DSHASH_MAGIC;
 	hash_table->control->lwlock_tranche_id = params->tranche_id;
+	hash_table->control->unlocked_reads = params->unlocked_reads;
 
-	/* Set up the array of lock partitions. */
+	/*
+	 * Set up the array of lock partitions.  Each starts out with just its
+	 * inline bucket, so there's nothing else to allocate.
+	 */
 	{
 		dshash_partition *partitions = hash_table->control->partitions;
 		int			tranche_id = hash_table->control->lwlock_tranche_id;
@@ -233,31 +253,13 @@ dshash_create(dsa_area *area, const dshash_parameters *params, void *arg)
 		{
 			LWLockInitialize(&partitions[i].lock, tranche_id);
 			partitions[i].count = 0;
+			partitions[i].size_log2 = 0;
+			partitions[i].buckets = InvalidDsaPointer;
+			partitions[i].bucket0 = InvalidDsaPointer;
+			pg_atomic_init_u32(&partitions[i].changecount, 0);
 		}
 	}
 
-	/*
-	 * Set up the initial array of buckets.  Our initial size is the same as
-	 * the number of partitions.
-	 */
-	hash_table->control->size_log2 = DSHASH_NUM_PARTITIONS_LOG2;
-	hash_table->control->buckets =
-		dsa_allocate_extended(area,
-							  sizeof(dsa_pointer) * DSHASH_NUM_PARTITIONS,
-							  DSA_ALLOC_NO_OOM | DSA_ALLOC_ZERO);
-	if (!DsaPointerIsValid(hash_table->control->buckets))
-	{
-		dsa_free(area, control);
-		ereport(ERROR,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("out of memory"),
-				 errdetail("Failed on DSA request of size %zu.",
-						   sizeof(dsa_pointer) * DSHASH_NUM_PARTITIONS)));
-	}
-	hash_table->buckets = dsa_get_address(area,
-										  hash_table->control->buckets);
-	hash_table->size_log2 = hash_table->control->size_log2;
-
 	return hash_table;
 }
 
@@ -286,14 +288,6 @@ dshash_attach(dsa_area *area, const dshash_parameters *params,
 	hash_table->control = dsa_get_address(area, control);
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 
-	/*
-	 * These will later be set to the correct values by
-	 * ensure_valid_bucket_pointers(), at which time we'll be holding a
-	 * partition lock for interlocking against concurrent resizing.
-	 */
-	hash_table->buckets = NULL;
-	hash_table->size_log2 = 0;
-
 	return hash_table;
 }
 
@@ -322,27 +316,46 @@ dshash_detach(dshash_table *hash_table)
 void
 dshash_destroy(dshash_table *hash_table)
 {
-	size_t		size;
 	size_t		i;
+	size_t		j;
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
-	ensure_valid_bucket_pointers(hash_table);
 
-	/* Free all the entries. */
-	size = NUM_BUCKETS(hash_table->size_log2);
-	for (i = 0; i < size; ++i)
+	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 	{
-		dsa_pointer item_pointer = hash_table->buckets[i];
+		dshash_partition *partition = &hash_table->control->partitions[i];
+		dsa_pointer *buckets = partition_buckets(hash_table, partition);
+		size_t		size = NUM_BUCKETS(partition->size_log2);
+		dsa_pointer buckets_pointer;
 
-		while (DsaPointerIsValid(item_pointer))
+		/* Free all the entries. */
+		for (j = 0; j < size; ++j)
 		{
-			dshash_table_item *item;
-			dsa_pointer next_item_pointer;
+			dsa_pointer item_pointer = buckets[j];
 
-			item = dsa_get_address(hash_table->area, item_pointer);
-			next_item_pointer = item->next;
-			dsa_free(hash_table->area, item_pointer);
-			item_pointer = next_item_pointer;
+			while (DsaPointerIsValid(item_pointer))
+			{
+				dshash_table_item *item;
+				dsa_pointer next_item_pointer;
+
+				item = dsa_get_address(hash_table->area, item_pointer);
+				next_item_pointer = item->next;
+				dsa_free(hash_table->area, item_pointer);
+				item_pointer = next_item_pointer;
+			}
+		}
+
+		/* Free the bucket array, and any retired ones it links to. */
+		buckets_pointer = partition->buckets;
+		while (DsaPointerIsValid(buckets_pointer))
+		{
+			dsa_pointer prev_pointer;
+
+			buckets = dsa_get_address(hash_table->area, buckets_pointer);
+			prev_pointer = buckets[size];
+			dsa_free(hash_table->area, buckets_pointer);
+			buckets_pointer = prev_pointer;
+			size /= 2;
 		}
 	}
 
@@ -352,8 +365,7 @@ dshash_destroy(dshash_table *hash_table)
 	 */
 	hash_table->control->magic = 0;
 
-	/* Free the active table and control object. */
-	dsa_free(hash_table->area, hash_table->control->buckets);
+	/* Free the control object. */
 	dsa_free(hash_table->area, hash_table->control->handle);
 
 	pfree(hash_table);
@@ -390,26 +402,29 @@ void *
 dshash_find(dshash_table *hash_table, const void *key, bool exclusive)
 {
 	dshash_hash hash;
-	size_t		partition;
+	size_t		partition_index;
+	dshash_partition *partition;
 	dshash_table_item *item;
 
 	hash = hash_key(hash_table, key);
-	partition = PARTITION_FOR_HASH(hash);
+	partition_index = PARTITION_FOR_HASH(hash);
+	partition = &hash_table->control->partitions[partition_index];
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
-	LWLockAcquire(PARTITION_LOCK(hash_table, partition),
+	LWLockAcquire(PARTITION_LOCK(hash_table, partition_index),
 				  exclusive ? LW_EXCLUSIVE : LW_SHARED);
-	ensure_valid_bucket_pointers(hash_table);
+	end_abandoned_change(hash_table, partition);
 
 	/* Search the active bucket. */
-	item = find_in_bucket(hash_table, key, BUCKET_FOR_HASH(hash_table, hash));
+	item = find_in_bucket(hash_table, key,
+						  BUCKET_FOR_HASH(hash_table, partition, hash));
 
 	if (!item)
 	{
 		/* Not found. */
-		LWLockRelease(PARTITION_LOCK(hash_table, partition));
+		LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
 		return NULL;
 	}
 	else
@@ -419,6 +434,75 @@ dshash_find(dshash_table *hash_table, const void *key, bool exclusive)
 	}
 }
 
+/*
+ * Look up an entry without taking any lock, in a table created with
+ * unlocked_reads.  Returns a pointer to the entry, which stays valid as long
+ * as the table exists, or NULL if the key is not found.  There is nothing to
+ * release.
+ *
+ * Entries of such tables must never be deleted, and must not be changed
+ * after the backend that inserted them has called dshash_release_lock.
+ * Readers check the partition's change counter around the search, so they
+ * never see entries that are being inserted or moved around by resizing; if
+ * it indicates a change, or if this platform can't read dsa_pointers
+ * atomically, we fall back to a search under a shared lock.
+ */
+void *
+dshash_find_unlocked(dshash_table *hash_table, const void *key)
+{
+	dshash_table_item *item;
+
+	Assert(hash_table->control->magic == DSHASH_MAGIC);
+	Assert(hash_table->control->unlocked_reads);
+
+#ifdef DSHASH_UNLOCKED_READS_SUPPORTED
+	{
+		dshash_hash hash = hash_key(hash_table, key);
+		dshash_partition *partition;
+		uint32		changecount;
+		size_t		size_log2;
+		dsa_pointer item_pointer;
+
+		partition = &hash_table->control->partitions[PARTITION_FOR_HASH(hash)];
+
+		changecount = pg_atomic_read_u32(&partition->changecount);
+		if (changecount % 2 == 0)
+		{
+			pg_read_barrier();
+
+			/*
+			 * Read the size before the bucket array; resize_partition()
+			 * publishes them in the opposite order, so the array is at least
+			 * as large as the size we use to index it.
+			 */
+			size_log2 = partition->size_log2;
+			if (size_log2 == 0)
+				item_pointer = partition->bucket0;
+			else
+			{
+				dsa_pointer *buckets;
+
+				pg_read_barrier();
+				buckets = dsa_get_address(hash_table->area, partition->buckets);
+				item_pointer =
+					buckets[BUCKET_INDEX_FOR_HASH_AND_SIZE(hash, size_log2)];
+			}
+			item = find_in_bucket(hash_table, key, item_pointer);
+
+			pg_read_barrier();
+			if (pg_atomic_read_u32(&partition->changecount) == changecount)
+				return item ? ENTRY_FROM_ITEM(item) : NULL;
+		}
+	}
+#endif
+
+	/* Concurrent change, do it the slow way. */
+	item = dshash_find(hash_table, key, false);
+	if (item)
+		dshash_release_lock(hash_table, item);
+	return item;
+}
+
 /*
  * Returns a pointer to an exclusively locked item which must be released with
  * dshash_release_lock.  If the key is found in the hash table, 'found' is set
@@ -446,13 +530,13 @@ dshash_find_or_insert(dshash_table *hash_table,
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
-restart:
 	LWLockAcquire(PARTITION_LOCK(hash_table, partition_index),
 				  LW_EXCLUSIVE);
-	ensure_valid_bucket_pointers(hash_table);
+	end_abandoned_change(hash_table, partition);
 
 	/* Search the active bucket. */
-	item = find_in_bucket(hash_table, key, BUCKET_FOR_HASH(hash_table, hash));
+	item = find_in_bucket(hash_table, key,
+						  BUCKET_FOR_HASH(hash_table, partition, hash));
 
 	if (item)
 		*found = true;
@@ -460,30 +544,41 @@ restart:
 	{
 		*found = false;
 
-		/* Check if we are getting too full. */
-		if (partition->count > MAX_COUNT_PER_PARTITION(hash_table))
+		/*
+		 * Unlocked readers mustn't look at this partition until the caller
+		 * has filled in the new entry; dshash_release_lock() ends this.
+		 */
+		begin_change(hash_table, partition);
+
+		/*
+		 * If allocating memory for the new bucket array or the item fails,
+		 * nothing has been changed yet, so we can let readers back in.
+		 */
+		PG_TRY();
 		{
-			/*
-			 * The load factor (= keys / buckets) for all buckets protected by
-			 * this partition is > 0.75.  Presumably the same applies
-			 * generally across the whole hash table (though we don't attempt
-			 * to track that directly to avoid contention on some kind of
-			 * central counter; we just assume that this partition is
-			 * representative).  This is a good time to resize.
-			 *
-			 * Give up our existing lock first, because resizing needs to
-			 * reacquire all the locks in the right order to avoid deadlocks.
-			 */
-			LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
-			resize(hash_table, hash_table->size_log2 + 1);
+			/* Check if we are getting too full. */
+			if (partition->count > MAX_COUNT_PER_PARTITION(partition) &&
+				partition->size_log2 < MAX_PARTITION_SIZE_LOG2)
+			{
+				/*
+				 * The load factor (= keys / buckets) of this partition is >
+				 * 0.75.  This is a good time to resize it.  As we hold its
+				 * lock anyway, that doesn't require any other lock, and other
+				 * partitions are unaffected.
+				 */
+				resize_partition(hash_table, partition);
+			}
 
-			goto restart;
+			/* Finally we can try to insert the new item. */
+			item = insert_into_bucket(hash_table, key, hash,
+									  &BUCKET_FOR_HASH(hash_table, partition, hash));
 		}
-
-		/* Finally we can try to insert the new item. */
-		item = insert_into_bucket(hash_table, key,
-								  &BUCKET_FOR_HASH(hash_table, hash));
-		item->hash = hash;
+		PG_CATCH();
+		{
+			end_change(hash_table, partition);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
 		/* Adjust per-lock-partition counter for load factor knowledge. */
 		++partition->count;
 	}
@@ -503,29 +598,31 @@ bool
 dshash_delete_key(dshash_table *hash_table, const void *key)
 {
 	dshash_hash hash;
-	size_t		partition;
+	size_t		partition_index;
+	dshash_partition *partition;
 	bool		found;
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
+	Assert(!hash_table->control->unlocked_reads);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
 	hash = hash_key(hash_table, key);
-	partition = PARTITION_FOR_HASH(hash);
+	partition_index = PARTITION_FOR_HASH(hash);
+	partition = &hash_table->control->partitions[partition_index];
 
-	LWLockAcquire(PARTITION_LOCK(hash_table, partition), LW_EXCLUSIVE);
-	ensure_valid_bucket_pointers(hash_table);
+	LWLockAcquire(PARTITION_LOCK(hash_table, partition_index), LW_EXCLUSIVE);
 
 	if (delete_key_from_bucket(hash_table, key,
-							   &BUCKET_FOR_HASH(hash_table, hash)))
+							   &BUCKET_FOR_HASH(hash_table, partition, hash)))
 	{
-		Assert(hash_table->control->partitions[partition].count > 0);
+		Assert(partition->count > 0);
 		found = true;
-		--hash_table->control->partitions[partition].count;
+		--partition->count;
 	}
 	else
 		found = false;
 
-	LWLockRelease(PARTITION_LOCK(hash_table, partition));
+	LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
 
 	return found;
 }
@@ -559,9 +656,18 @@ dshash_release_lock(dshash_table *hash_table, void *entry)
 {
 	dshash_table_item *item = ITEM_FROM_ENTRY(entry);
 	size_t		partition_index = PARTITION_FOR_HASH(item->hash);
+	dshash_partition *partition;
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 
+	/* If we inserted this entry, let unlocked readers see it now. */
+	partition = &hash_table->control->partitions[partition_index];
+	if (hash_table->control->unlocked_reads &&
+		pg_atomic_read_u32(&partition->changecount) % 2 != 0 &&
+		LWLockHeldByMeInMode(PARTITION_LOCK(hash_table, partition_index),
+							 LW_EXCLUSIVE))
+		end_change(hash_table, partition);
+
 	LWLockRelease(PARTITION_LOCK(hash_table, partition_index));
 }
 
@@ -613,78 +719,71 @@ dshash_seq_init(dshash_seq_status *status, dshash_table *hash_table,
 void *
 dshash_seq_next(dshash_seq_status *status)
 {
+	dshash_table *hash_table = status->hash_table;
+	dshash_partition *partition;
 	dsa_pointer next_item_pointer;
 
 	/*
-	 * Not yet holding any partition locks. Need to determine the size of the
-	 * hash table, it could have been resized since we were looking last.
-	 * Since we iterate in partition order, we can start by unconditionally
-	 * lock partition 0.
-	 *
-	 * Once we hold the lock, no resizing can happen until the scan ends. So
-	 * we don't need to repeatedly call ensure_valid_bucket_pointers().
+	 * Not yet holding any partition locks.  Since we iterate in partition
+	 * order, we can start by unconditionally locking partition 0.  While we
+	 * hold a partition's lock, it can't be resized, so its number of buckets
+	 * stays the same until we move on to the next partition.
 	 */
 	if (status->curpartition == -1)
 	{
 		Assert(status->curbucket == 0);
-		ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(status->hash_table);
+		ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
 
 		status->curpartition = 0;
 
-		LWLockAcquire(PARTITION_LOCK(status->hash_table,
-									 status->curpartition),
+		LWLockAcquire(PARTITION_LOCK(hash_table, status->curpartition),
 					  status->exclusive ? LW_EXCLUSIVE : LW_SHARED);
 
-		ensure_valid_bucket_pointers(status->hash_table);
-
-		status->nbuckets =
-			NUM_BUCKETS(status->hash_table->control->size_log2);
-		next_item_pointer = status->hash_table->buckets[status->curbucket];
+		partition = &hash_table->control->partitions[status->curpartition];
+		status->nbuckets = NUM_BUCKETS(partition->size_log2);
+		next_item_pointer =
+			partition_buckets(hash_table, partition)[status->curbucket];
 	}
 	else
 		next_item_pointer = status->pnextitem;
 
-	Assert(LWLockHeldByMeInMode(PARTITION_LOCK(status->hash_table,
+	Assert(LWLockHeldByMeInMode(PARTITION_LOCK(hash_table,
 											   status->curpartition),
 								status->exclusive ? LW_EXCLUSIVE : LW_SHARED));
 
 	/* Move to the next bucket if we finished the current bucket */
 	while (!DsaPointerIsValid(next_item_pointer))
 	{
-		int			next_partition;
-
 		if (++status->curbucket >= status->nbuckets)
 		{
-			/* all buckets have been scanned. finish. */
-			return NULL;
-		}
-
-		/* Check if move to the next partition */
-		next_partition =
-			PARTITION_FOR_BUCKET_INDEX(status->curbucket,
-									   status->hash_table->size_log2);
+			/* Move to the next partition, if there's one. */
+			if (status->curpartition + 1 >= DSHASH_NUM_PARTITIONS)
+			{
+				/* all buckets have been scanned. finish. */
+				return NULL;
+			}
 
-		if (status->curpartition != next_partition)
-		{
 			/*
-			 * Move to the next partition. Lock the next partition then
-			 * release the current, not in the reverse order to avoid
-			 * concurrent resizing.  Avoid dead lock by taking lock in the
-			 * same order with resize().
+			 * Lock the next partition then release the current, in the same
+			 * order as dshash_dump() to avoid deadlocks.
 			 */
-			LWLockAcquire(PARTITION_LOCK(status->hash_table,
-										 next_partition),
+			LWLockAcquire(PARTITION_LOCK(hash_table, status->curpartition + 1),
 						  status->exclusive ? LW_EXCLUSIVE : LW_SHARED);
-			LWLockRelease(PARTITION_LOCK(status->hash_table,
-										 status->curpartition));
-			status->curpartition = next_partition;
+			LWLockRelease(PARTITION_LOCK(hash_table, status->curpartition));
+			status->curpartition++;
+
+			partition = &hash_table->control->partitions[status->curpartition];
+			status->curbucket = 0;
+			status->nbuckets = NUM_BUCKETS(partition->size_log2);
 		}
+		else
+			partition = &hash_table->control->partitions[status->curpartition];
 
-		next_item_pointer = status->hash_table->buckets[status->curbucket];
+		next_item_pointer =
+			partition_buckets(hash_table, partition)[status->curbucket];
 	}
 
-	status->curitem =
-		dsa_get_address(status->hash_table->area, next_item_pointer);
+	status->curitem = dsa_get_address(hash_table->area, next_item_pointer);
 
 	/*
 	 * The caller may delete the item. Store the next item in case of
@@ -736,6 +835,7 @@ dshash_dump(dshash_table *hash_table)
 {
 	size_t		i;
 	size_t		j;
+	size_t		total_size = 0;
 
 	Assert(hash_table->control->magic == DSHASH_MAGIC);
 	ASSERT_NO_PARTITION_LOCKS_HELD_BY_ME(hash_table);
@@ -744,26 +844,25 @@ dshash_dump(dshash_table *hash_table)
 	{
 		Assert(!LWLockHeldByMe(PARTITION_LOCK(hash_table, i)));
 		LWLockAcquire(PARTITION_LOCK(hash_table, i), LW_SHARED);
+		total_size += NUM_BUCKETS(hash_table->control->partitions[i].size_log2);
 	}
 
-	ensure_valid_bucket_pointers(hash_table);
-
-	fprintf(stderr,
-			"hash table size = %zu\n", (size_t) 1 << hash_table->size_log2);
+	fprintf(stderr, "hash table size = %zu\n", total_size);
 	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
 	{
 		dshash_partition *partition = &hash_table->control->partitions[i];
-		size_t		begin = BUCKET_INDEX_FOR_PARTITION(i, hash_table->size_log2);
-		size_t		end = BUCKET_INDEX_FOR_PARTITION(i + 1, hash_table->size_log2);
+		dsa_pointer *buckets = partition_buckets(hash_table, partition);
+		size_t		size = NUM_BUCKETS(partition->size_log2);
 
 		fprintf(stderr, "  partition %zu\n", i);
 		fprintf(stderr,
-				"    active buckets (key count = %zu)\n", partition->count);
+				"    active buckets (key count = %zu, bucket count = %zu)\n",
+				partition->count, size);
 
-		for (j = begin; j < end; ++j)
+		for (j = 0; j < size; ++j)
 		{
 			size_t		count = 0;
-			dsa_pointer bucket = hash_table->buckets[j];
+			dsa_pointer bucket = buckets[j];
 
 			while (DsaPointerIsValid(bucket))
 			{
@@ -788,16 +887,19 @@ dshash_dump(dshash_table *hash_table)
 static void
 delete_item(dshash_table *hash_table, dshash_table_item *item)
 {
-	size_t		hash = item->hash;
-	size_t		partition = PARTITION_FOR_HASH(hash);
+	dshash_hash hash = item->hash;
+	size_t		partition_index = PARTITION_FOR_HASH(hash);
+	dshash_partition *partition;
 
-	Assert(LWLockHeldByMe(PARTITION_LOCK(hash_table, partition)));
+	Assert(!hash_table->control->unlocked_reads);
+	Assert(LWLockHeldByMe(PARTITION_LOCK(hash_table, partition_index)));
 
+	partition = &hash_table->control->partitions[partition_index];
 	if (delete_item_from_bucket(hash_table, item,
-								&BUCKET_FOR_HASH(hash_table, hash)))
+								&BUCKET_FOR_HASH(hash_table, partition, hash)))
 	{
-		Assert(hash_table->control->partitions[partition].count > 0);
-		--hash_table->control->partitions[partition].count;
+		Assert(partition->count > 0);
+		--partition->count;
 	}
 	else
 	{
@@ -806,56 +908,41 @@ delete_item(dshash_table *hash_table, dshash_table_item *item)
 }
 
 /*
- * Grow the hash table if necessary to the requested number of buckets.  The
- * requested size must be double some previously observed size.
- *
- * Must be called without any partition lock held.
+ * Double the number of buckets of a partition.  The caller must hold the
+ * partition's lock exclusively, and must have called begin_change().
  */
 static void
-resize(dshash_table *hash_table, size_t new_size_log2)
+resize_partition(dshash_table *hash_table, dshash_partition *partition)
 {
-	dsa_pointer old_buckets;
+	dsa_pointer old_buckets_shared = partition->buckets;
+	dsa_pointer *old_buckets = partition_buckets(hash_table, partition);
 	dsa_pointer new_buckets_shared;
 	dsa_pointer *new_buckets;
-	size_t		size;
-	size_t		new_size = ((size_t) 1) << new_size_log2;
+	size_t		size = NUM_BUCKETS(partition->size_log2);
+	size_t		new_size_log2 = partition->size_log2 + 1;
+	size_t		new_size = NUM_BUCKETS(new_size_log2);
 	size_t		i;
 
+	Assert(LWLockHeldByMeInMode(&partition->lock, LW_EXCLUSIVE));
+	Assert(!hash_table->control->unlocked_reads ||
+		   pg_atomic_read_u32(&partition->changecount) % 2 != 0);
+
 	/*
-	 * Acquire the locks for all lock partitions.  This is expensive, but we
-	 * shouldn't have to do it many times.
+	 * Allocate the space for the new array, plus the link to the previous
+	 * one.
 	 */
-	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
-	{
-		Assert(!LWLockHeldByMe(PARTITION_LOCK(hash_table, i)));
-
-		LWLockAcquire(PARTITION_LOCK(hash_table, i), LW_EXCLUSIVE);
-		if (i == 0 && hash_table->control->size_log2 >= new_size_log2)
-		{
-			/*
-			 * Another backend has already increased the size; we can avoid
-			 * obtaining all the locks and return early.
-			 */
-			LWLockRelease(PARTITION_LOCK(hash_table, 0));
-			return;
-		}
-	}
-
-	Assert(new_size_log2 == hash_table->control->size_log2 + 1);
-
-	/* Allocate the space for the new table. */
 	new_buckets_shared = dsa_allocate0(hash_table->area,
-									   sizeof(dsa_pointer) * new_size);
+									   sizeof(dsa_pointer) * (new_size + 1));
 	new_buckets = dsa_get_address(hash_table->area, new_buckets_shared);
 
 	/*
 	 * We've allocated the new bucket array; all that remains to do now is to
-	 * reinsert all items, which amounts to adjusting all the pointers.
+	 * reinsert this partition's items, which amounts to adjusting their
+	 * pointers.
 	 */
-	size = ((size_t) 1) << hash_table->control->size_log2;
 	for (i = 0; i < size; ++i)
 	{
-		dsa_pointer item_pointer = hash_table->buckets[i];
+		dsa_pointer item_pointer = old_buckets[i];
 
 		while (DsaPointerIsValid(item_pointer))
 		{
@@ -871,32 +958,87 @@ resize(dshash_table *hash_table, size_t new_size_log2)
 		}
 	}
 
-	/* Swap the hash table into place and free the old one. */
-	old_buckets = hash_table->control->buckets;
-	hash_table->control->buckets = new_buckets_shared;
-	hash_table->control->size_log2 = new_size_log2;
-	hash_table->buckets = new_buckets;
-	dsa_free(hash_table->area, old_buckets);
+	/*
+	 * Swap the new array into place.  Unlocked readers may still be looking
+	 * at the old one, so then it's retired rather than freed.
+	 */
+	if (hash_table->control->unlocked_reads)
+		new_buckets[new_size] = old_buckets_shared;
+	else
+	{
+		new_buckets[new_size] = InvalidDsaPointer;
+		if (DsaPointerIsValid(old_buckets_shared))
+			dsa_free(hash_table->area, old_buckets_shared);
+	}
+	partition->buckets = new_buckets_shared;
+	pg_write_barrier();
+	partition->size_log2 = new_size_log2;
+}
 
-	/* Release all the locks. */
-	for (i = 0; i < DSHASH_NUM_PARTITIONS; ++i)
-		LWLockRelease(PARTITION_LOCK(hash_table, i));
+/*
+ * Get the bucket array of a partition.  The caller must hold its lock.
+ */
+static inline dsa_pointer *
+partition_buckets(dshash_table *hash_table, dshash_partition *partition)
+{
+	if (partition->size_log2 == 0)
+		return &partition->bucket0;
+	return dsa_get_address(hash_table->area, partition->buckets);
 }
 
 /*
- * Make sure that our backend-local bucket pointers are up to date.  The
- * caller must have locked one lock partition, which prevents resize() from
- * running concurrently.
+ * Mark the start of a change to a partition's buckets, which unlocked readers
+ * must not look at until end_change() is called.  The caller must hold the
+ * partition's lock exclusively.
  */
 static inline void
-ensure_valid_bucket_pointers(dshash_table *hash_table)
+begin_change(dshash_table *hash_table, dshash_partition *partition)
 {
-	if (hash_table->size_log2 != hash_table->control->size_log2)
-	{
-		hash_table->buckets = dsa_get_address(hash_table->area,
-											  hash_table->control->buckets);
-		hash_table->size_log2 = hash_table->control->size_log2;
-	}
+	if (!hash_table->control->unlocked_reads)
+		return;
+	Assert(pg_atomic_read_u32(&partition->changecount) % 2 == 0);
+	/* a full barrier, so that readers see this before the change itself */
+	pg_atomic_fetch_add_u32(&partition->changecount, 1);
+}
+
+/*
+ * Mark the end of a change started by begin_change().
+ */
+static inline void
+end_change(dshash_table *hash_table, dshash_partition *partition)
+{
+	if (!hash_table->control->unlocked_reads)
+		return;
+	Assert(pg_atomic_read_u32(&partition->changecount) % 2 != 0);
+	pg_atomic_fetch_add_u32(&partition->changecount, 1);
+}
+
+/*
+ * End a change that its backend never ended, because an error was raised
+ * after dshash_find_or_insert() returned a new entry but before the caller
+ * got to dshash_release_lock(); error recovery then released the partition
+ * lock without telling us.  Otherwise, unlocked lookups in the partition
+ * would fall back to taking the lock until the next insert there.
+ *
+ * Changes are only made while holding the lock exclusively, so if the
+ * counter is odd when we have just acquired the lock in any mode, nobody is
+ * making one anymore.  Several shared lockers may notice at the same time,
+ * hence the compare-and-exchange.  The abandoned entry itself may be only
+ * partially filled in, but lookups under the lock would find it just the
+ * same.
+ */
+static inline void
+end_abandoned_change(dshash_table *hash_table, dshash_partition *partition)
+{
+	uint32		changecount;
+
+	if (!hash_table->control->unlocked_reads)
+		return;
+
+	changecount = pg_atomic_read_u32(&partition->changecount);
+	if (changecount % 2 != 0)
+		pg_atomic_compare_exchange_u32(&partition->changecount,
+									   &changecount, changecount + 1);
 }
 
 /*
@@ -930,6 +1072,9 @@ insert_item_into_bucket(dshash_table *hash_table,
 	Assert(item == dsa_get_address(hash_table->area, item_pointer));
 
 	item->next = *bucket;
+	/* Make the item valid before unlocked readers can reach it. */
+	if (hash_table->control->unlocked_reads)
+		pg_write_barrier();
 	*bucket = item_pointer;
 }
 
@@ -940,6 +1085,7 @@ insert_item_into_bucket(dshash_table *hash_table,
 static dshash_table_item *
 insert_into_bucket(dshash_table *hash_table,
 				   const void *key,
+				   dshash_hash hash,
 				   dsa_pointer *bucket)
 {
 	dsa_pointer item_pointer;
@@ -950,6 +1096,7 @@ insert_into_bucket(dshash_table *hash_table,
 								MAXALIGN(sizeof(dshash_table_item)));
 	item = dsa_get_address(hash_table->area, item_pointer);
 	memcpy(ENTRY_FROM_ITEM(item), key, hash_table->params.key_size);
+	item->hash = hash;
 	insert_item_into_bucket(hash_table, item_pointer, item, bucket);
 	return item;
 }
@@ -221,6 +221,23 @@ estimateHyperLogLog(hyperLogLogState *cState)
 	return result;
 }
 
+/*
+ * Merges the state of another estimator into cState, which then estimates
+ * the cardinality of the union of both sets.  Both must have the same
+ * register width.
+ */
+void
+mergeHyperLogLog(hyperLogLogState *cState, const hyperLogLogState *oState)
+{
+	Size		i;
+
+	if (cState->registerWidth != oState->registerWidth)
+		elog(ERROR, "cannot merge HyperLogLog states of different bit widths");
+
+	for (i = 0; i < cState->nRegisters; i++)
+		cState->hashesArr[i] = Max(cState->hashesArr[i], oState->hashesArr[i]);
+}
+
 /*
  * Worker for addHyperLogLog().
  *
@@ -649,7 +649,14 @@ ClientAuthentication(Port *port)
 		(*ClientAuthentication_hook) (port, status);
 
 	if (status == STATUS_OK)
+	{
 		sendAuthRequest(port, AUTH_REQ_OK, NULL, 0);
+
+		/* the client starts decompressing right after AuthenticationOk */
+		if (port->compression_algorithm != PG_COMPRESSION_NONE)
+			pq_enable_compression(port->compression_algorithm,
+								  port->compression_level);
+	}
 	else
 		auth_failed(port, status, logdetail);
 }
@@ -290,6 +290,27 @@ be_tls_init(bool isServerStart)
 	if (SSLPreferServerCiphers)
 		SSL_CTX_set_options(context, SSL_OP_CIPHER_SERVER_PREFERENCE);
 
+	/*
+	 * Let OpenSSL hand record encryption over to the kernel (Linux kTLS)
+	 * once the handshake is done, option available since OpenSSL 3.0.  Our
+	 * writes then go from the send buffer to the kernel without passing
+	 * through OpenSSL's own buffers.  OpenSSL silently falls back to doing
+	 * the work itself if the kernel or the negotiated cipher doesn't support
+	 * offload.
+	 */
+	if (ssl_ktls)
+	{
+#ifdef SSL_OP_ENABLE_KTLS
+		SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+#else
+		ereport(isServerStart ? FATAL : LOG,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("\"%s\" is not supported by this build's SSL library",
+						"ssl_ktls")));
+		goto error;
+#endif
+	}
+
 	/*
 	 * Load CA store, so we can verify client certificates if needed.
 	 */
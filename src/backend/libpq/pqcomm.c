@@ -73,6 +73,7 @@
 #include <mstcpip.h>
 #endif
 
+#include "common/compression_stream.h"
 #include "common/ip.h"
 #include "libpq/libpq.h"
 #include "miscadmin.h"
@@ -105,6 +106,7 @@
  */
 int			Unix_socket_permissions;
 char	   *Unix_socket_group;
+int			send_buffer_size = 8;	/* kB */
 
 /* Where the Unix socket files are (list of palloc'd strings) */
 static List *sock_paths = NIL;
@@ -112,11 +114,13 @@ static List *sock_paths = NIL;
 /*
  * Buffers for low-level I/O.
  *
- * The receive buffer is fixed size. Send buffer is usually 8k, but can be
- * enlarged by pq_putmessage_noblock() if the message doesn't fit otherwise.
+ * The receive buffer is fixed size.  The send buffer's size is set by
+ * send_buffer_size when the connection starts, but can be enlarged by
+ * pq_putmessage_noblock() if the message doesn't fit otherwise.  A larger
+ * send buffer means fewer, larger writes for bulk output; with SSL, it also
+ * lets each SSL_write() fill whole 16kB TLS records.
  */
 
-#define PQ_SEND_BUFFER_SIZE 8192
 #define PQ_RECV_BUFFER_SIZE 8192
 
 static char *PqSendBuffer;
@@ -128,6 +132,21 @@ static char PqRecvBuffer[PQ_RECV_BUFFER_SIZE];
 static int	PqRecvPointer;		/* Next index to read a byte from PqRecvBuffer */
 static int	PqRecvLength;		/* End of data available in PqRecvBuffer */
 
+/*
+ * Protocol compression state, see pq_enable_compression().  When compression
+ * is in use, PqSendBuffer and PqRecvBuffer still hold plain protocol data;
+ * internal_flush() compresses the former into PqZSendData, and pq_recvbuf()
+ * decompresses from PqZRecvBuffer into the latter.
+ */
+static ZStream *PqZStream;
+static const char *PqZSendData; /* compressed data, owned by PqZStream */
+static int	PqZSendStart;		/* Next index to send a byte in PqZSendData */
+static int	PqZSendEnd;			/* End of data in PqZSendData */
+
+static char PqZRecvBuffer[PQ_RECV_BUFFER_SIZE];
+static int	PqZRecvPointer;		/* Next index to decompress in PqZRecvBuffer */
+static int	PqZRecvLength;		/* End of data available in PqZRecvBuffer */
+
 /*
  * Message status
  */
@@ -146,6 +165,8 @@ static int	socket_putmessage(char msgtype, const char *s, size_t len);
 static void socket_putmessage_noblock(char msgtype, const char *s, size_t len);
 static int	internal_putbytes(const char *s, size_t len);
 static int	internal_flush(void);
+static int	internal_flush_buffer(const char *buf, int *start, int *end);
+static ssize_t pq_read_compressed(char *ptr, size_t len);
 
 static int	Lock_AF_UNIX(const char *unixSocketDir, const char *unixSocketPath);
 static int	Setup_AF_UNIX(const char *sock_path);
@@ -175,7 +196,7 @@ pq_init(void)
 	int			latch_pos PG_USED_FOR_ASSERTS_ONLY;
 
 	/* initialize state variables */
-	PqSendBufferSize = PQ_SEND_BUFFER_SIZE;
+	PqSendBufferSize = send_buffer_size * 1024;
 	PqSendBuffer = MemoryContextAlloc(TopMemoryContext, PqSendBufferSize);
 	PqSendPointer = PqSendStart = PqRecvPointer = PqRecvLength = 0;
 	PqCommBusy = false;
@@ -766,8 +787,8 @@ StreamConnection(pgsocket server_fd, Port *port)
 		 * performance suffers.  The Postgres send buffer can be enlarged if a
 		 * very large message needs to be sent, but we won't attempt to
 		 * enlarge the OS buffer if that happens, so somewhat arbitrarily
-		 * ensure that the OS buffer is at least PQ_SEND_BUFFER_SIZE * 4.
-		 * (That's 32kB with the current default).
+		 * ensure that the OS buffer is at least send_buffer_size * 4.
+		 * (That's 32kB with the default setting).
 		 *
 		 * The default OS buffer size used to be 8kB in earlier Windows
 		 * versions, but was raised to 64kB in Windows 2012.  So it shouldn't
@@ -789,7 +810,7 @@ StreamConnection(pgsocket server_fd, Port *port)
 					(errmsg("%s(%s) failed: %m", "getsockopt", "SO_SNDBUF")));
 			return STATUS_ERROR;
 		}
-		newopt = PQ_SEND_BUFFER_SIZE * 4;
+		newopt = send_buffer_size * 1024 * 4;
 		if (oldopt < newopt)
 		{
 			if (setsockopt(port->sock, SOL_SOCKET, SO_SNDBUF, (char *) &newopt,
@@ -818,6 +839,52 @@ StreamConnection(pgsocket server_fd, Port *port)
 	return STATUS_OK;
 }
 
+/*
+ * StreamResumeConnection -- set up a connection for a parked session being
+ *		resumed, whose socket StreamConnection() accepted earlier in some
+ *		other process.  Set port->sock to sock.
+ *
+ * The socket options set by StreamConnection() are still in effect, so only
+ * the addresses and the keepalive state in the port need filling in.
+ *
+ * RETURNS: STATUS_OK or STATUS_ERROR
+ */
+int
+StreamResumeConnection(pgsocket sock, Port *port)
+{
+	port->sock = sock;
+
+	port->raddr.salen = sizeof(port->raddr.addr);
+	if (getpeername(port->sock,
+					(struct sockaddr *) &port->raddr.addr,
+					&port->raddr.salen) < 0)
+	{
+		ereport(LOG,
+				(errmsg("%s() failed: %m", "getpeername")));
+		return STATUS_ERROR;
+	}
+
+	port->laddr.salen = sizeof(port->laddr.addr);
+	if (getsockname(port->sock,
+					(struct sockaddr *) &port->laddr.addr,
+					&port->laddr.salen) < 0)
+	{
+		ereport(LOG,
+				(errmsg("%s() failed: %m", "getsockname")));
+		return STATUS_ERROR;
+	}
+
+	if (port->laddr.addr.ss_family != AF_UNIX)
+	{
+		(void) pq_setkeepalivesidle(tcp_keepalives_idle, port);
+		(void) pq_setkeepalivesinterval(tcp_keepalives_interval, port);
+		(void) pq_setkeepalivescount(tcp_keepalives_count, port);
+		(void) pq_settcpusertimeout(tcp_user_timeout, port);
+	}
+
+	return STATUS_OK;
+}
+
 /*
  * StreamClose -- close a client/backend connection
  *
@@ -936,8 +1003,12 @@ pq_recvbuf(void)
 	{
 		int			r;
 
-		r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
-						PQ_RECV_BUFFER_SIZE - PqRecvLength);
+		if (PqZStream)
+			r = pq_read_compressed(PqRecvBuffer + PqRecvLength,
+								   PQ_RECV_BUFFER_SIZE - PqRecvLength);
+		else
+			r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
+							PQ_RECV_BUFFER_SIZE - PqRecvLength);
 
 		if (r < 0)
 		{
@@ -968,6 +1039,89 @@ pq_recvbuf(void)
 	}
 }
 
+/* --------------------------------
+ *		pq_read_compressed - read and decompress data from the client
+ *
+ *		Works like secure_read(): returns the number of bytes stored at ptr,
+ *		0 on EOF, or -1 with errno set.  Data that can be decompressed from
+ *		input already received is returned without touching the socket.
+ * --------------------------------
+ */
+static ssize_t
+pq_read_compressed(char *ptr, size_t len)
+{
+	for (;;)
+	{
+		size_t		consumed;
+		ssize_t		n;
+		ssize_t		r;
+
+		n = zs_decompress(PqZStream, PqZRecvBuffer + PqZRecvPointer,
+						  PqZRecvLength - PqZRecvPointer, &consumed,
+						  ptr, len);
+		if (n < 0)
+		{
+			/* treat it like a broken connection; see pq_recvbuf() */
+			ereport(COMMERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("could not decompress data from client: %s",
+							zs_errmsg(PqZStream))));
+			return 0;
+		}
+		PqZRecvPointer += consumed;
+		if (n > 0)
+			return n;
+
+		/* Need more compressed input; left-justify what's left of it */
+		if (PqZRecvPointer > 0)
+		{
+			memmove(PqZRecvBuffer, PqZRecvBuffer + PqZRecvPointer,
+					PqZRecvLength - PqZRecvPointer);
+			PqZRecvLength -= PqZRecvPointer;
+			PqZRecvPointer = 0;
+		}
+
+		r = secure_read(MyProcPort, PqZRecvBuffer + PqZRecvLength,
+						PQ_RECV_BUFFER_SIZE - PqZRecvLength);
+		if (r <= 0)
+			return r;
+		PqZRecvLength += r;
+	}
+}
+
+/* --------------------------------
+ *		pq_enable_compression - start compressing the connection
+ *
+ * Everything sent and received after this call goes through the given
+ * compression algorithm.  Output queued before the call is flushed out
+ * uncompressed first.  This is called right after AuthenticationOk has been
+ * queued, which is where the client switches over too.
+ * --------------------------------
+ */
+void
+pq_enable_compression(pg_compress_algorithm algorithm, int level)
+{
+	ZStream    *zs;
+
+	Assert(PqZStream == NULL);
+
+	zs = zs_create(algorithm, level);
+	if (zs == NULL)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("could not initialize protocol compression")));
+
+	if (pq_flush())
+		ereport(FATAL,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not send data to client")));
+
+	PqZStream = zs;
+	PqZSendData = NULL;
+	PqZSendStart = PqZSendEnd = 0;
+	PqZRecvPointer = PqZRecvLength = 0;
+}
+
 /* --------------------------------
  *		pq_getbyte	- get a single byte from connection, or return EOF
  * --------------------------------
@@ -1028,7 +1182,20 @@ pq_getbyte_if_available(unsigned char *c)
 	/* Put the socket into non-blocking mode */
 	socket_set_nonblocking(true); // 把socket变成非阻塞模式
 
-	r = secure_read(MyProcPort, c, 1);
+	if (PqZStream)
+	{
+		/* decompress whatever is available into the (empty) buffer */
+		PqRecvPointer = PqRecvLength = 0;
+		r = pq_read_compressed(PqRecvBuffer, PQ_RECV_BUFFER_SIZE);
+		if (r > 0)
+		{
+			PqRecvLength = r;
+			*c = PqRecvBuffer[PqRecvPointer++];
+			r = 1;
+		}
+	}
+	else
+		r = secure_read(MyProcPort, c, 1);
 	if (r < 0)
 	{
 		/*
@@ -1333,17 +1500,73 @@ socket_flush(void)
  */
 static int
 internal_flush(void)
+{
+	if (PqZStream == NULL)
+		return internal_flush_buffer(PqSendBuffer,
+									 &PqSendStart, &PqSendPointer);
+
+	/*
+	 * With compression, send the previously compressed data first; only
+	 * once that's all gone, compress what has accumulated in PqSendBuffer
+	 * since.
+	 */
+	for (;;)
+	{
+		size_t		len;
+		int			r;
+
+		if (PqZSendStart < PqZSendEnd)
+		{
+			r = internal_flush_buffer(PqZSendData,
+									  &PqZSendStart, &PqZSendEnd);
+			if (r != 0 || PqZSendStart < PqZSendEnd)
+				return r;
+		}
+
+		if (PqSendStart == PqSendPointer)
+			return 0;
+
+		PqZSendData = zs_compress(PqZStream, PqSendBuffer + PqSendStart,
+								  PqSendPointer - PqSendStart, &len);
+		if (PqZSendData == NULL)
+		{
+			/* Treat it like a send failure, see internal_flush_buffer() */
+			ereport(COMMERROR,
+					(errmsg("could not compress data for client: %s",
+							zs_errmsg(PqZStream))));
+			PqSendStart = PqSendPointer = 0;
+			ClientConnectionLost = 1;
+			InterruptPending = 1;
+			return EOF;
+		}
+		PqZSendStart = 0;
+		PqZSendEnd = len;
+		PqSendStart = PqSendPointer = 0;
+	}
+}
+
+/* --------------------------------
+ *		internal_flush_buffer - write buf[*start..*end) to the socket
+ *
+ * *start is advanced over whatever was sent.  Returns 0 if OK (meaning
+ * everything was sent, or operation would block and the socket is in
+ * non-blocking mode), or EOF if trouble.
+ * --------------------------------
+ */
+static int
+internal_flush_buffer(const char *buf, int *start, int *end)
 {
 	static int	last_reported_send_errno = 0;
 
-	char	   *bufptr = PqSendBuffer + PqSendStart;
-	char	   *bufend = PqSendBuffer + PqSendPointer;
+	const char *bufptr = buf + *start;
+	const char *bufend = buf + *end;
 
 	while (bufptr < bufend)
 	{
 		int			r;
 
-		r = secure_write(MyProcPort, bufptr, bufend - bufptr);
+		r = secure_write(MyProcPort, unconstify(char *, bufptr),
+						 bufend - bufptr);
 
 		if (r <= 0)
 		{
@@ -1383,7 +1606,7 @@ internal_flush(void)
 			 * flag that'll cause the next CHECK_FOR_INTERRUPTS to terminate
 			 * the connection.
 			 */
-			PqSendStart = PqSendPointer = 0;
+			*start = *end = 0;
 			ClientConnectionLost = 1;
 			InterruptPending = 1;
 			return EOF;
@@ -1391,10 +1614,10 @@ internal_flush(void)
 
 		last_reported_send_errno = 0;	/* reset after any successful send */
 		bufptr += r;
-		PqSendStart += r;
+		*start += r;
 	}
 
-	PqSendStart = PqSendPointer = 0;
+	*start = *end = 0;
 	return 0;
 }
 
@@ -1410,7 +1633,7 @@ socket_flush_if_writable(void)
 	int			res;
 
 	/* Quick exit if nothing to do */
-	if (PqSendPointer == PqSendStart)
+	if (!socket_is_send_pending())
 		return 0;
 
 	/* No-op if reentrant call */
@@ -1433,7 +1656,7 @@ socket_flush_if_writable(void)
 static bool
 socket_is_send_pending(void)
 {
-	return (PqSendStart < PqSendPointer);
+	return (PqSendStart < PqSendPointer || PqZSendStart < PqZSendEnd);
 }
 
 /* --------------------------------
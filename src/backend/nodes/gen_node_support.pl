@@ -106,8 +106,8 @@ my @nodetag_only_files = qw(
 # In HEAD, these variables should be left undef, since we don't promise
 # ABI stability during development.
 
-my $last_nodetag = 'WindowObjectData';
-my $last_nodetag_no = 454;
+my $last_nodetag = 'BumpContext';
+my $last_nodetag_no = 455;
 
 # output file names
 my @output_files;
@@ -152,6 +152,7 @@ my @extra_tags = qw(
   AllocSetContext GenerationContext SlabContext
   TIDBitmap
   WindowObjectData
+  BumpContext
 );
 
 # This is a regular node, but we skip parsing it from its header file
@@ -176,6 +176,14 @@ make_one_rel(PlannerInfo *root, List *joinlist)
 	RelOptInfo *rel;
 	Index		rti;
 	double		total_pages;
+	bool		instrument;
+	instr_time	start;
+	instr_time	end;
+
+	/* Only the top query level's phases are timed; see optimizer.h */
+	instrument = (planner_instrument != NULL && root->query_level == 1);
+	if (instrument)
+		INSTR_TIME_SET_CURRENT(start);
 
 	/* Mark base rels as to whether we care about fast-start plans */
 	set_base_rel_consider_startup(root);
@@ -223,11 +231,24 @@ make_one_rel(PlannerInfo *root, List *joinlist)
 	 */
 	set_base_rel_pathlists(root);
 
+	if (instrument)
+	{
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(planner_instrument->path_time, end, start);
+		start = end;
+	}
+
 	/*
 	 * Generate access paths for the entire join tree.
 	 */
 	rel = make_rel_from_joinlist(root, joinlist);
 
+	if (instrument)
+	{
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(planner_instrument->join_time, end, start);
+	}
+
 	/*
 	 * The result should join all and only the query's base + outer-join rels.
 	 */
@@ -1237,6 +1258,7 @@ set_append_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 {
 	int			parentRTindex = rti;
 	List	   *live_childrels = NIL;
+	RelOptInfo *sibling = NULL;
 	ListCell   *l;
 
 	/*
@@ -1269,9 +1291,24 @@ set_append_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 			childrel->consider_parallel = false;
 
 		/*
-		 * Compute the child's access paths.
+		 * Compute the child's access paths.  If it looks like the last child
+		 * whose paths we had to search for, we can build the same paths for
+		 * it instead; otherwise, it's the one to compare the next children
+		 * with.  Any set_rel_pathlist_hook still gets its say.
 		 */
-		set_rel_pathlist(root, childrel, childRTindex, childRTE);
+		if (sibling != NULL &&
+			reuse_sibling_paths(root, childrel, sibling))
+		{
+			if (set_rel_pathlist_hook)
+				(*set_rel_pathlist_hook) (root, childrel, childRTindex, childRTE);
+			set_cheapest(childrel);
+		}
+		else
+		{
+			set_rel_pathlist(root, childrel, childRTindex, childRTE);
+			if (enable_partition_path_reuse && !IS_DUMMY_REL(childrel))
+				sibling = childrel;
+		}
 
 		/*
 		 * If child is dummy, ignore it.
@@ -3370,7 +3407,8 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 	{
 		/*
 		 * Consider the different orders in which we could join the rels,
-		 * using a plugin, GEQO, or the regular join search code.
+		 * using a plugin, GEQO or the greedy search, or the regular join
+		 * search code.
 		 *
 		 * We put the initial_rels list into a PlannerInfo field because
 		 * has_legal_joinclause() needs to look at it (ugly :-().
@@ -3380,7 +3418,11 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 		if (join_search_hook)
 			return (*join_search_hook) (root, levels_needed, initial_rels);
 		else if (enable_geqo && levels_needed >= geqo_threshold)
+		{
+			if (join_search_method == JOIN_SEARCH_GREEDY)
+				return greedy_join_search(root, levels_needed, initial_rels);
 			return geqo(root, levels_needed, initial_rels);
+		}
 		else
 			return standard_join_search(root, levels_needed, initial_rels);
 	}
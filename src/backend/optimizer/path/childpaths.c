@@ -0,0 +1,468 @@
+/*-------------------------------------------------------------------------
+ *
+ * childpaths.c
+ *	  Reuse of access paths between structurally identical partitions
+ *
+ * A query on a table with many partitions has to generate access paths for
+ * each partition that survives pruning, and most of that work is the same
+ * for every one of them: the partitions usually have the same columns, the
+ * same indexes and the same quals once translated, and only their sizes
+ * differ.  So when a child rel of an appendrel is found to match one of its
+ * siblings for which paths have already been generated, we don't search for
+ * paths again; we rebuild the sibling's surviving paths for the child
+ * instead, which costs them for the child's own statistics but skips index
+ * matching and the comparison of the alternatives.
+ *
+ * Since paths that lost to the sibling's survivors aren't reconsidered, we
+ * insist that the sizes be similar, besides the structure being identical.
+ * We also only handle the common kinds of paths: sequential scans, and
+ * plain and bitmap index scans using the rel's own restriction clauses.
+ * If the sibling has any other kind of path, such as a parameterized one,
+ * the child's paths are generated the normal way.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/path/childpaths.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "catalog/pg_class.h"
+#include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "parser/parsetree.h"
+#include "rewrite/rewriteManip.h"
+
+/*
+ * Sizes are similar if they differ by at most this fraction of the larger
+ * of them.
+ */
+#define SIBLING_SIZE_TOLERANCE	0.1
+
+static bool sibling_rels_match(PlannerInfo *root, RelOptInfo *rel,
+							   RelOptInfo *sibling);
+static bool sibling_indexes_match(RelOptInfo *rel, IndexOptInfo *index,
+								  RelOptInfo *sibling, IndexOptInfo *sibindex);
+static bool sibling_exprs_match(RelOptInfo *rel, List *exprs,
+								RelOptInfo *sibling, List *sibexprs);
+static bool sibling_rinfos_match(RelOptInfo *rel, List *rinfos,
+								 RelOptInfo *sibling, List *sibrinfos);
+static bool sizes_similar(double a, double b);
+static int	list_position_ptr(List *list, void *datum);
+static Path *rebuild_sibling_path(PlannerInfo *root, RelOptInfo *rel,
+								  RelOptInfo *sibling, Path *path,
+								  bool partial);
+static IndexPath *rebuild_sibling_index_path(PlannerInfo *root,
+											 RelOptInfo *rel,
+											 RelOptInfo *sibling,
+											 IndexPath *ipath,
+											 bool partial);
+static Path *rebuild_sibling_bitmapqual(PlannerInfo *root, RelOptInfo *rel,
+										RelOptInfo *sibling, Path *bitmapqual);
+
+
+/*
+ * reuse_sibling_paths
+ *	  Build the access paths of child rel "rel" from those of "sibling", a
+ *	  child of the same appendrel whose paths have already been built.
+ *
+ * Returns false if "rel" and "sibling" don't match or the sibling's paths
+ * can't be rebuilt, in which case nothing has been done to "rel".  On
+ * success, the caller still has to call set_cheapest().
+ */
+bool
+reuse_sibling_paths(PlannerInfo *root, RelOptInfo *rel, RelOptInfo *sibling)
+{
+	List	   *paths = NIL;
+	List	   *partial_paths = NIL;
+	ListCell   *lc;
+
+	if (!sibling_rels_match(root, rel, sibling))
+		return false;
+
+	/*
+	 * Rebuild all of the sibling's paths before adding any of them, so that
+	 * we can still give up without having changed anything.
+	 */
+	foreach(lc, sibling->pathlist)
+	{
+		Path	   *path = rebuild_sibling_path(root, rel, sibling,
+												(Path *) lfirst(lc), false);
+
+		if (path == NULL)
+			return false;
+		paths = lappend(paths, path);
+	}
+	foreach(lc, sibling->partial_pathlist)
+	{
+		Path	   *path = rebuild_sibling_path(root, rel, sibling,
+												(Path *) lfirst(lc), true);
+
+		if (path == NULL)
+			return false;
+		/* The child may be too small to be worth scanning in parallel */
+		if (path->parallel_workers > 0)
+			partial_paths = lappend(partial_paths, path);
+	}
+
+	if (paths == NIL)
+		return false;
+
+	foreach(lc, paths)
+		add_path(rel, (Path *) lfirst(lc));
+	foreach(lc, partial_paths)
+		add_partial_path(rel, (Path *) lfirst(lc));
+
+	return true;
+}
+
+/*
+ * Are "rel" and "sibling" plain relations that the same paths are good for?
+ */
+static bool
+sibling_rels_match(PlannerInfo *root, RelOptInfo *rel, RelOptInfo *sibling)
+{
+	RangeTblEntry *rte = planner_rt_fetch(rel->relid, root);
+	RangeTblEntry *sibrte = planner_rt_fetch(sibling->relid, root);
+	ListCell   *lc1,
+			   *lc2;
+
+	/* Both must be plain tables, scanned without parameterization */
+	if (rte->rtekind != RTE_RELATION || sibrte->rtekind != RTE_RELATION ||
+		rte->inh || sibrte->inh ||
+		rte->relkind != RELKIND_RELATION || sibrte->relkind != RELKIND_RELATION ||
+		rte->tablesample != NULL || sibrte->tablesample != NULL ||
+		IS_DUMMY_REL(rel) || IS_DUMMY_REL(sibling) ||
+		!bms_is_empty(rel->lateral_relids) ||
+		!bms_is_empty(sibling->lateral_relids))
+		return false;
+
+	/* Properties that affect which paths are built and how they're costed */
+	if (rel->consider_parallel != sibling->consider_parallel ||
+		rel->rel_parallel_workers != sibling->rel_parallel_workers ||
+		rel->reltablespace != sibling->reltablespace ||
+		rel->amflags != sibling->amflags ||
+		rel->has_eclass_joins != sibling->has_eclass_joins ||
+		!sizes_similar(rel->pages, sibling->pages) ||
+		!sizes_similar(rel->tuples, sibling->tuples) ||
+		!sizes_similar(rel->rows, sibling->rows) ||
+		fabs(rel->allvisfrac - sibling->allvisfrac) > SIBLING_SIZE_TOLERANCE)
+		return false;
+
+	/* Same columns needed, same quals */
+	if (!sibling_exprs_match(rel, rel->reltarget->exprs,
+							 sibling, sibling->reltarget->exprs) ||
+		!sibling_rinfos_match(rel, rel->baserestrictinfo,
+							  sibling, sibling->baserestrictinfo) ||
+		!sibling_rinfos_match(rel, rel->joininfo,
+							  sibling, sibling->joininfo))
+		return false;
+
+	/* Same indexes, in the same order */
+	if (list_length(rel->indexlist) != list_length(sibling->indexlist))
+		return false;
+	forboth(lc1, rel->indexlist, lc2, sibling->indexlist)
+	{
+		if (!sibling_indexes_match(rel, (IndexOptInfo *) lfirst(lc1),
+								   sibling, (IndexOptInfo *) lfirst(lc2)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Are two indexes of sibling rels alike?
+ */
+static bool
+sibling_indexes_match(RelOptInfo *rel, IndexOptInfo *index,
+					  RelOptInfo *sibling, IndexOptInfo *sibindex)
+{
+	if (index->relam != sibindex->relam ||
+		index->ncolumns != sibindex->ncolumns ||
+		index->nkeycolumns != sibindex->nkeycolumns ||
+		index->reltablespace != sibindex->reltablespace ||
+		index->tree_height != sibindex->tree_height ||
+		index->predOK != sibindex->predOK ||
+		index->unique != sibindex->unique ||
+		index->immediate != sibindex->immediate ||
+		index->hypothetical != sibindex->hypothetical ||
+		index->amcostestimate != sibindex->amcostestimate ||
+		list_length(index->indrestrictinfo) != list_length(sibindex->indrestrictinfo) ||
+		!sizes_similar(index->pages, sibindex->pages) ||
+		!sizes_similar(index->tuples, sibindex->tuples))
+		return false;
+
+	if (memcmp(index->indexkeys, sibindex->indexkeys,
+			   index->ncolumns * sizeof(int)) != 0 ||
+		memcmp(index->canreturn, sibindex->canreturn,
+			   index->ncolumns * sizeof(bool)) != 0 ||
+		memcmp(index->indexcollations, sibindex->indexcollations,
+			   index->nkeycolumns * sizeof(Oid)) != 0 ||
+		memcmp(index->opfamily, sibindex->opfamily,
+			   index->nkeycolumns * sizeof(Oid)) != 0 ||
+		memcmp(index->opcintype, sibindex->opcintype,
+			   index->nkeycolumns * sizeof(Oid)) != 0)
+		return false;
+
+	if ((index->sortopfamily == NULL) != (sibindex->sortopfamily == NULL) ||
+		(index->sortopfamily != NULL &&
+		 (memcmp(index->sortopfamily, sibindex->sortopfamily,
+				 index->nkeycolumns * sizeof(Oid)) != 0 ||
+		  memcmp(index->reverse_sort, sibindex->reverse_sort,
+				 index->nkeycolumns * sizeof(bool)) != 0 ||
+		  memcmp(index->nulls_first, sibindex->nulls_first,
+				 index->nkeycolumns * sizeof(bool)) != 0)))
+		return false;
+
+	return sibling_exprs_match(rel, index->indexprs,
+							   sibling, sibindex->indexprs) &&
+		sibling_exprs_match(rel, index->indpred,
+							sibling, sibindex->indpred);
+}
+
+/*
+ * Are two lists of expressions of sibling rels the same, except for the
+ * rel they reference?
+ */
+static bool
+sibling_exprs_match(RelOptInfo *rel, List *exprs,
+					RelOptInfo *sibling, List *sibexprs)
+{
+	List	   *mapped;
+
+	if (list_length(exprs) != list_length(sibexprs))
+		return false;
+	if (exprs == NIL)
+		return true;
+
+	mapped = copyObject(exprs);
+	ChangeVarNodes((Node *) mapped, rel->relid, sibling->relid, 0);
+
+	return equal(mapped, sibexprs);
+}
+
+/*
+ * Likewise for two lists of RestrictInfos.
+ */
+static bool
+sibling_rinfos_match(RelOptInfo *rel, List *rinfos,
+					 RelOptInfo *sibling, List *sibrinfos)
+{
+	ListCell   *lc1,
+			   *lc2;
+
+	if (list_length(rinfos) != list_length(sibrinfos))
+		return false;
+
+	forboth(lc1, rinfos, lc2, sibrinfos)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc1);
+		RestrictInfo *sibrinfo = lfirst_node(RestrictInfo, lc2);
+		Node	   *mapped;
+
+		if (rinfo->is_pushed_down != sibrinfo->is_pushed_down ||
+			rinfo->pseudoconstant != sibrinfo->pseudoconstant ||
+			rinfo->security_level != sibrinfo->security_level)
+			return false;
+
+		mapped = copyObject((Node *) rinfo->clause);
+		ChangeVarNodes(mapped, rel->relid, sibling->relid, 0);
+		if (!equal(mapped, sibrinfo->clause))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+sizes_similar(double a, double b)
+{
+	return fabs(a - b) <= SIBLING_SIZE_TOLERANCE * Max(a, b);
+}
+
+/*
+ * Return the position of a pointer in a list, or -1 if it's not there.
+ */
+static int
+list_position_ptr(List *list, void *datum)
+{
+	ListCell   *lc;
+
+	foreach(lc, list)
+	{
+		if (lfirst(lc) == datum)
+			return foreach_current_index(lc);
+	}
+
+	return -1;
+}
+
+/*
+ * Rebuild one of the sibling's paths for "rel".  Returns NULL if we don't
+ * know how.
+ */
+static Path *
+rebuild_sibling_path(PlannerInfo *root, RelOptInfo *rel, RelOptInfo *sibling,
+					 Path *path, bool partial)
+{
+	if (path->param_info != NULL)
+		return NULL;
+
+	switch (nodeTag(path))
+	{
+		case T_Path:
+			if (path->pathtype == T_SeqScan)
+			{
+				int			parallel_workers = 0;
+
+				/* As in create_plain_partial_paths() */
+				if (partial)
+					parallel_workers = compute_parallel_worker(rel, rel->pages, -1,
+															   max_parallel_workers_per_gather);
+				return create_seqscan_path(root, rel, NULL, parallel_workers);
+			}
+			break;
+		case T_IndexPath:
+			return (Path *) rebuild_sibling_index_path(root, rel, sibling,
+													   (IndexPath *) path,
+													   partial);
+		case T_BitmapHeapPath:
+			{
+				BitmapHeapPath *bpath = (BitmapHeapPath *) path;
+				Path	   *bitmapqual;
+				int			parallel_workers = 0;
+
+				bitmapqual = rebuild_sibling_bitmapqual(root, rel, sibling,
+														bpath->bitmapqual);
+				if (bitmapqual == NULL)
+					return NULL;
+
+				/* As in create_partial_bitmap_paths() */
+				if (partial)
+				{
+					double		pages_fetched;
+
+					pages_fetched = compute_bitmap_pages(root, rel, bitmapqual,
+														 1.0, NULL, NULL);
+					parallel_workers = compute_parallel_worker(rel, pages_fetched, -1,
+															   max_parallel_workers_per_gather);
+				}
+				return (Path *) create_bitmap_heap_path(root, rel, bitmapqual,
+														NULL, 1.0,
+														parallel_workers);
+			}
+		default:
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Rebuild an index path of the sibling for the corresponding index of "rel".
+ *
+ * We only handle index clauses that are restriction clauses of the sibling
+ * used as they are, so they can be matched up by their position in the two
+ * rels' baserestrictinfo lists.
+ */
+static IndexPath *
+rebuild_sibling_index_path(PlannerInfo *root, RelOptInfo *rel,
+						   RelOptInfo *sibling, IndexPath *ipath,
+						   bool partial)
+{
+	IndexOptInfo *index;
+	List	   *indexclauses = NIL;
+	List	   *pathkeys = NIL;
+	ListCell   *lc;
+
+	if (ipath->indexorderbys != NIL)
+		return NULL;
+
+	index = list_nth(rel->indexlist,
+					 list_position_ptr(sibling->indexlist, ipath->indexinfo));
+
+	foreach(lc, ipath->indexclauses)
+	{
+		IndexClause *iclause = lfirst_node(IndexClause, lc);
+		IndexClause *newclause;
+		int			pos;
+
+		if (iclause->lossy || iclause->indexcols != NIL ||
+			list_length(iclause->indexquals) != 1 ||
+			linitial(iclause->indexquals) != iclause->rinfo)
+			return NULL;
+
+		pos = list_position_ptr(sibling->baserestrictinfo, iclause->rinfo);
+		if (pos < 0)
+			return NULL;
+
+		newclause = makeNode(IndexClause);
+		newclause->rinfo = list_nth_node(RestrictInfo,
+										 rel->baserestrictinfo, pos);
+		newclause->indexquals = list_make1(newclause->rinfo);
+		newclause->lossy = false;
+		newclause->indexcol = iclause->indexcol;
+		newclause->indexcols = NIL;
+		indexclauses = lappend(indexclauses, newclause);
+	}
+
+	/* As in build_index_paths() */
+	if (ipath->path.pathkeys != NIL)
+	{
+		pathkeys = build_index_pathkeys(root, index, ipath->indexscandir);
+		pathkeys = truncate_useless_pathkeys(root, rel, pathkeys);
+		if (list_length(pathkeys) != list_length(ipath->path.pathkeys))
+			return NULL;
+	}
+
+	return create_index_path(root, index, indexclauses, NIL, NIL, pathkeys,
+							 ipath->indexscandir,
+							 ipath->path.pathtype == T_IndexOnlyScan,
+							 NULL, 1.0, partial);
+}
+
+/*
+ * Rebuild the tree of index paths under a bitmap heap path of the sibling.
+ */
+static Path *
+rebuild_sibling_bitmapqual(PlannerInfo *root, RelOptInfo *rel,
+						   RelOptInfo *sibling, Path *bitmapqual)
+{
+	List	   *bitmapquals = NIL;
+	List	   *subpaths;
+	ListCell   *lc;
+
+	if (IsA(bitmapqual, IndexPath))
+		return (Path *) rebuild_sibling_index_path(root, rel, sibling,
+												   (IndexPath *) bitmapqual,
+												   false);
+	else if (IsA(bitmapqual, BitmapAndPath))
+		subpaths = ((BitmapAndPath *) bitmapqual)->bitmapquals;
+	else if (IsA(bitmapqual, BitmapOrPath))
+		subpaths = ((BitmapOrPath *) bitmapqual)->bitmapquals;
+	else
+		return NULL;
+
+	foreach(lc, subpaths)
+	{
+		Path	   *subpath = rebuild_sibling_bitmapqual(root, rel, sibling,
+														 (Path *) lfirst(lc));
+
+		if (subpath == NULL)
+			return NULL;
+		bitmapquals = lappend(bitmapquals, subpath);
+	}
+
+	if (IsA(bitmapqual, BitmapAndPath))
+		return (Path *) create_bitmap_and_path(root, rel, bitmapquals);
+	else
+		return (Path *) create_bitmap_or_path(root, rel, bitmapquals);
+}
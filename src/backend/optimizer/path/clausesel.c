@@ -105,8 +105,33 @@ clauselist_selectivity(PlannerInfo *root,
 					   JoinType jointype,
 					   SpecialJoinInfo *sjinfo)
 {
-	return clauselist_selectivity_ext(root, clauses, varRelid,
-									  jointype, sjinfo, true);
+	static int	depth = 0;
+	instr_time	start;
+	instr_time	end;
+	Selectivity s;
+
+	/* Time only the outermost call, as estimation can recurse into here */
+	if (likely(planner_instrument == NULL) || depth > 0)
+		return clauselist_selectivity_ext(root, clauses, varRelid,
+										  jointype, sjinfo, true);
+
+	planner_instrument->selectivity_calls++;
+	INSTR_TIME_SET_CURRENT(start);
+	depth++;
+	PG_TRY();
+	{
+		s = clauselist_selectivity_ext(root, clauses, varRelid,
+									   jointype, sjinfo, true);
+	}
+	PG_FINALLY();
+	{
+		depth--;
+	}
+	PG_END_TRY();
+	INSTR_TIME_SET_CURRENT(end);
+	INSTR_TIME_ACCUM_DIFF(planner_instrument->selectivity_time, end, start);
+
+	return s;
 }
 
 /*
@@ -77,10 +77,12 @@
 #include "access/amapi.h"
 #include "access/htup_details.h"
 #include "access/tsmapi.h"
+#include "catalog/pg_am.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
 #include "executor/nodeHash.h"
 #include "executor/nodeMemoize.h"
+#include "executor/nodeMergejoin.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -135,6 +137,7 @@ int			max_parallel_workers_per_gather = 2;
 bool		enable_seqscan = true;
 bool		enable_indexscan = true;
 bool		enable_indexonlyscan = true;
+bool		enable_indexskipscan = true;
 bool		enable_bitmapscan = true;
 bool		enable_tidscan = true;
 bool		enable_sort = true;
@@ -143,6 +146,7 @@ bool		enable_hashagg = true;
 bool		enable_nestloop = true;
 bool		enable_material = true;
 bool		enable_memoize = true;
+bool		enable_adaptive_nestloop = true;
 bool		enable_mergejoin = true;
 bool		enable_hashjoin = true;
 bool		enable_gathermerge = true;
@@ -150,7 +154,10 @@ bool		enable_partitionwise_join = false;
 bool		enable_partitionwise_aggregate = false;
 bool		enable_parallel_append = true;
 bool		enable_parallel_hash = true;
+bool		enable_parallel_hashagg = true;
 bool		enable_partition_pruning = true;
+bool		enable_partition_path_reuse = true;
+bool		enable_eager_aggregate = true;
 bool		enable_presorted_aggregate = true;
 bool		enable_async_append = true;
 
@@ -161,6 +168,7 @@ typedef struct
 } cost_qual_eval_context;
 
 static List *extract_nonindex_conditions(List *qual_clauses, List *indexclauses);
+static bool mergejoin_inner_can_seek(MergePath *path);
 static MergeScanSelCache *cached_scansel(PlannerInfo *root,
 										 RestrictInfo *rinfo,
 										 PathKey *pathkey);
@@ -2809,6 +2817,53 @@ cost_agg(Path *path, PlannerInfo *root,
 	path->total_cost = total_cost;
 }
 
+/*
+ * cost_parallel_hashagg
+ *		Determines and returns the cost of a Parallel HashAgg, an AGG_HASHED
+ *		and AGGSPLIT_SIMPLE Agg whose participants first distribute the
+ *		partial input path 'subpath' among shared partitions by hashing the
+ *		grouping columns, then each aggregate whole partitions.
+ *
+ * 'numGroups' is the total number of groups, which the participants
+ * compute their shares of; we return the number each participant is
+ * expected to compute.  The other arguments are as for cost_agg.
+ */
+double
+cost_parallel_hashagg(Path *path, PlannerInfo *root,
+					  const AggClauseCosts *aggcosts,
+					  int numGroupCols, double numGroups,
+					  List *quals, Path *subpath)
+{
+	double		input_tuples = subpath->rows;
+	double		input_pages = page_size(input_tuples,
+										subpath->pathtarget->width);
+	double		participant_groups;
+	Cost		redistribute_cost;
+
+	participant_groups = clamp_row_est(numGroups /
+									   get_parallel_divisor(subpath));
+
+	cost_agg(path, root, AGG_HASHED, aggcosts,
+			 numGroupCols, participant_groups,
+			 quals,
+			 subpath->startup_cost, subpath->total_cost,
+			 input_tuples, subpath->pathtarget->width);
+
+	/*
+	 * Each input tuple is hashed and written to a partition, then read back
+	 * by whichever participant aggregates that partition, all before the
+	 * first group can be returned.
+	 */
+	redistribute_cost = input_tuples *
+		(cpu_operator_cost * numGroupCols + 2 * cpu_tuple_cost) +
+		2 * seq_page_cost * input_pages;
+
+	path->startup_cost += redistribute_cost;
+	path->total_cost += redistribute_cost;
+
+	return participant_groups;
+}
+
 /*
  * cost_windowagg
  *		Determines and returns the cost of performing a WindowAgg plan node,
@@ -3609,6 +3664,41 @@ final_cost_mergejoin(PlannerInfo *root, MergePath *path,
 	 */
 	bare_inner_cost = inner_run_cost * rescanratio;
 
+	/*
+	 * If the executor can seek the inner index scan past runs of inner
+	 * tuples that join to nothing (see MJInitSeek), it reads at most about
+	 * MJ_SEEK_THRESHOLD inner tuples per outer key besides the ones that
+	 * join, paying a btree descent for each seek.  That can be a lot less
+	 * than reading the whole inner range when the outer keys are sparse.
+	 * The seeks aren't possible through a Material node, so this only
+	 * applies to the bare inner cost.
+	 */
+	if (mergejoin_inner_can_seek(path))
+	{
+		double		scanned_rows = inner_rows - inner_skip_rows;
+		double		seek_rows = outer_rows - outer_skip_rows;
+		double		fetched_rows;
+
+		fetched_rows = Min(scanned_rows, mergejointuples) +
+			seek_rows * MJ_SEEK_THRESHOLD;
+		if (fetched_rows < scanned_rows)
+		{
+			IndexOptInfo *index = ((IndexPath *) inner_path)->indexinfo;
+			double		spc_random_page_cost;
+			Cost		descent_cost;
+			Cost		seek_inner_cost;
+
+			get_tablespace_page_costs(index->reltablespace,
+									  &spc_random_page_cost, NULL);
+			descent_cost = spc_random_page_cost +
+				ceil(log(inner_path_rows) / log(2.0)) * cpu_operator_cost;
+			seek_inner_cost = inner_run_cost * (fetched_rows / scanned_rows) +
+				seek_rows * descent_cost;
+			bare_inner_cost = Min(bare_inner_cost,
+								  seek_inner_cost * rescanratio);
+		}
+	}
+
 	/*
 	 * When we interpose a Material node the re-fetch cost is assumed to be
 	 * just cpu_operator_cost per tuple, independently of the underlying
@@ -3718,6 +3808,71 @@ final_cost_mergejoin(PlannerInfo *root, MergePath *path,
 	path->jpath.path.total_cost = startup_cost + run_cost;
 }
 
+/*
+ * mergejoin_inner_can_seek
+ *	  Will the executor be able to seek the mergejoin's inner input?
+ *
+ * This has to agree with MJInitSeek: the inner must be a plain forward
+ * btree scan whose first index column is the first merge key, used without
+ * an explicit sort, and the join mustn't emit unmatched inner tuples.
+ */
+static bool
+mergejoin_inner_can_seek(MergePath *path)
+{
+	Path	   *inner_path = path->jpath.innerjoinpath;
+	JoinType	jointype = path->jpath.jointype;
+	IndexPath  *ipath;
+	IndexOptInfo *index;
+	PathKey    *pathkey;
+	ListCell   *lc;
+
+	if (!mergejoin_seek ||
+		path->path_mergeclauses == NIL ||
+		path->innersortkeys != NIL ||
+		jointype == JOIN_RIGHT ||
+		jointype == JOIN_RIGHT_ANTI ||
+		jointype == JOIN_FULL)
+		return false;
+
+	if (!IsA(inner_path, IndexPath) || inner_path->parallel_aware ||
+		inner_path->pathkeys == NIL)
+		return false;
+	ipath = (IndexPath *) inner_path;
+	index = ipath->indexinfo;
+	if (index->relam != BTREE_AM_OID ||
+		ipath->indexorderbys != NIL ||
+		!ScanDirectionIsForward(ipath->indexscandir) ||
+		index->reverse_sort[0] ||
+		index->indexkeys[0] == 0)
+		return false;
+
+	pathkey = (PathKey *) linitial(inner_path->pathkeys);
+	if (pathkey->pk_strategy != BTLessStrategyNumber ||
+		pathkey->pk_opfamily != index->sortopfamily[0] ||
+		pathkey->pk_eclass->ec_collation != index->indexcollations[0])
+		return false;
+
+	/*
+	 * The first pathkey could come from a later index column if the earlier
+	 * ones are equated to constants, so make sure it is the first column.
+	 */
+	foreach(lc, pathkey->pk_eclass->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+		Expr	   *expr = em->em_expr;
+
+		while (IsA(expr, RelabelType))
+			expr = ((RelabelType *) expr)->arg;
+		if (IsA(expr, Var) &&
+			((Var *) expr)->varno == index->rel->relid &&
+			((Var *) expr)->varattno == index->indexkeys[0] &&
+			((Var *) expr)->varlevelsup == 0)
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * run mergejoinscansel() with caching
  */
@@ -0,0 +1,428 @@
+/*-------------------------------------------------------------------------
+ *
+ * joinsearch.c
+ *	  Deterministic join order search for large join problems
+ *
+ * standard_join_search() considers every legal way of joining the jointree
+ * items, which becomes too expensive once there are more than a dozen or so
+ * of them.  GEQO bounds the effort with a randomized search, but the plans
+ * it finds can be poor, and vary with geqo_seed.  The code here is a cheaper
+ * deterministic alternative, selected by join_search_method.
+ *
+ * We first build a join tree greedily: among all pairs of items that could
+ * be joined now, we repeatedly perform the join with the cheapest result
+ * ("greedy operator ordering").  The leaves of that tree, read left to right,
+ * give an ordering of the items in which every greedy join covers a
+ * contiguous run.  We then repeat the search with dynamic programming, but
+ * consider only joinrels that cover such runs ("linearized DP").  This takes
+ * O(N^3) join attempts rather than exponentially many, and since the greedy
+ * tree is among the candidates, the result is never worse than it.  The
+ * cost of the greedy plan also gives an upper bound that lets us skip
+ * splits which cannot lead anywhere useful.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/path/joinsearch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "optimizer/geqo.h"
+#include "optimizer/joininfo.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "utils/memutils.h"
+
+/* GUC parameter */
+int			join_search_method = JOIN_SEARCH_GEQO;
+
+/*
+ * A group of jointree items already joined together by the greedy search.
+ * "members" lists the items as RelOptInfo pointers, in leaf order.
+ */
+typedef struct GreedyUnit
+{
+	RelOptInfo *rel;			/* rel representing the whole unit */
+	List	   *members;		/* jointree items, in leaf order */
+	struct GreedyUnit *left;	/* units joined to form this one, or NULL */
+	struct GreedyUnit *right;
+} GreedyUnit;
+
+/* A join the greedy search could perform next */
+typedef struct GreedyCandidate
+{
+	GreedyUnit *left;
+	GreedyUnit *right;
+	RelOptInfo *joinrel;
+} GreedyCandidate;
+
+static bool greedy_join_order(PlannerInfo *root, List *initial_rels,
+							  RelOptInfo **order, int *splits, Cost *bound);
+static List *greedy_consider_join(PlannerInfo *root, List *candidates,
+								  GreedyUnit *left, GreedyUnit *right,
+								  bool force);
+static void greedy_record_splits(GreedyUnit *unit, int start,
+								 int nitems, int *splits);
+static RelOptInfo *linearized_join_search(PlannerInfo *root, int nitems,
+										  RelOptInfo **order, int *splits,
+										  Cost bound);
+static void finish_join_rel(PlannerInfo *root, RelOptInfo *joinrel);
+
+
+/*
+ * greedy_join_search
+ *	  Find a join order for a large join problem by a greedy search refined
+ *	  with linearized dynamic programming.
+ *
+ * The API is the same as for standard_join_search().
+ */
+RelOptInfo *
+greedy_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	MemoryContext mycontext;
+	MemoryContext oldcxt;
+	int			savelength;
+	struct HTAB *savehash;
+	RelOptInfo **order;
+	int		   *splits;
+	Cost		bound;
+	bool		found;
+
+	Assert(levels_needed == list_length(initial_rels));
+
+	/*
+	 * order[] receives the leaf order of the greedy join tree, and
+	 * splits[i * levels_needed + j], if nonzero, is one more than the
+	 * position of the last item on the left side of the greedy join that
+	 * covers items i..j.  These must outlive the greedy search.
+	 */
+	order = (RelOptInfo **) palloc(levels_needed * sizeof(RelOptInfo *));
+	splits = (int *) palloc0(levels_needed * levels_needed * sizeof(int));
+
+	/*
+	 * The greedy search builds joinrels that include only the paths for one
+	 * particular way of forming them, and we will want to build those same
+	 * joinrels again with all their paths.  So do the greedy search in a
+	 * private memory context and throw away everything it builds, as
+	 * geqo_eval() does for each tour.
+	 */
+	mycontext = AllocSetContextCreate(CurrentMemoryContext,
+									  "greedy join search",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(mycontext);
+
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	Assert(root->join_rel_level == NULL);
+
+	root->join_rel_hash = NULL;
+
+	found = greedy_join_order(root, initial_rels, order, splits, &bound);
+
+	root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+	root->join_rel_hash = savehash;
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(mycontext);
+
+	/*
+	 * The greedy search fails only if outer-join restrictions prevent
+	 * completing the tree it started; let GEQO deal with such cases.
+	 */
+	if (!found)
+		return geqo(root, levels_needed, initial_rels);
+
+	return linearized_join_search(root, levels_needed, order, splits, bound);
+}
+
+/*
+ * greedy_join_order
+ *	  Build a join tree by repeatedly making the cheapest available join.
+ *
+ * On success, fills order[] and splits[] as described in greedy_join_search,
+ * sets *bound to the cost of the cheapest path of the completed tree, and
+ * returns true.  Returns false if no complete tree could be built.
+ */
+static bool
+greedy_join_order(PlannerInfo *root, List *initial_rels,
+				  RelOptInfo **order, int *splits, Cost *bound)
+{
+	int			nitems = list_length(initial_rels);
+	List	   *units = NIL;
+	List	   *candidates = NIL;
+	GreedyUnit *final;
+	ListCell   *lc;
+	int			i;
+
+	foreach(lc, initial_rels)
+	{
+		GreedyUnit *unit = palloc0_object(GreedyUnit);
+
+		unit->rel = (RelOptInfo *) lfirst(lc);
+		unit->members = list_make1(unit->rel);
+		units = lappend(units, unit);
+	}
+
+	/* Start with every pair of items that there's a reason to join */
+	for (i = 0; i < nitems; i++)
+	{
+		int			j;
+
+		for (j = i + 1; j < nitems; j++)
+			candidates = greedy_consider_join(root, candidates,
+											  list_nth(units, i),
+											  list_nth(units, j),
+											  false);
+	}
+
+	while (list_length(units) > 1)
+	{
+		GreedyCandidate *best = NULL;
+		GreedyUnit *unit;
+		ListCell   *lc2;
+
+		/*
+		 * If no join with a join clause or order restriction is possible,
+		 * fall back to clauseless joins, as join_search_one_level() does.
+		 */
+		if (candidates == NIL)
+		{
+			foreach(lc, units)
+			{
+				for_each_cell(lc2, units, lnext(units, lc))
+					candidates = greedy_consider_join(root, candidates,
+													  lfirst(lc), lfirst(lc2),
+													  true);
+			}
+			if (candidates == NIL)
+				return false;
+		}
+
+		/*
+		 * Choose the cheapest candidate, preferring fewer rows on a cost tie
+		 * and otherwise the first one found, so that the result does not
+		 * depend on anything but the input.
+		 */
+		foreach(lc, candidates)
+		{
+			GreedyCandidate *cand = (GreedyCandidate *) lfirst(lc);
+
+			if (best == NULL)
+				best = cand;
+			else
+			{
+				Cost		cand_cost = cand->joinrel->cheapest_total_path->total_cost;
+				Cost		best_cost = best->joinrel->cheapest_total_path->total_cost;
+
+				if (cand_cost < best_cost ||
+					(cand_cost == best_cost &&
+					 cand->joinrel->rows < best->joinrel->rows))
+					best = cand;
+			}
+		}
+
+		unit = palloc0_object(GreedyUnit);
+		unit->rel = best->joinrel;
+		unit->members = list_concat_copy(best->left->members,
+										 best->right->members);
+		unit->left = best->left;
+		unit->right = best->right;
+
+		units = list_delete_ptr(units, unit->left);
+		units = list_delete_ptr(units, unit->right);
+
+		/* Forget candidates involving either unit we just consumed */
+		foreach(lc, candidates)
+		{
+			GreedyCandidate *cand = (GreedyCandidate *) lfirst(lc);
+
+			if (cand->left == unit->left || cand->left == unit->right ||
+				cand->right == unit->left || cand->right == unit->right)
+				candidates = foreach_delete_current(candidates, lc);
+		}
+
+		foreach(lc, units)
+			candidates = greedy_consider_join(root, candidates,
+											  unit, lfirst(lc), false);
+
+		units = lappend(units, unit);
+	}
+
+	final = (GreedyUnit *) linitial(units);
+
+	i = 0;
+	foreach(lc, final->members)
+		order[i++] = (RelOptInfo *) lfirst(lc);
+	greedy_record_splits(final, 0, nitems, splits);
+	*bound = final->rel->cheapest_total_path->total_cost;
+
+	return true;
+}
+
+/*
+ * greedy_consider_join
+ *	  Add the join of two units to the candidate list, if it's legal.
+ *
+ * Unless 'force' is true, we consider only joins that have a join clause or
+ * are required by a join order restriction.
+ */
+static List *
+greedy_consider_join(PlannerInfo *root, List *candidates,
+					 GreedyUnit *left, GreedyUnit *right, bool force)
+{
+	GreedyCandidate *cand;
+	RelOptInfo *joinrel;
+
+	if (!force &&
+		!have_relevant_joinclause(root, left->rel, right->rel) &&
+		!have_join_order_restriction(root, left->rel, right->rel))
+		return candidates;
+
+	/*
+	 * The units partition the jointree items, so no joinrel for this set of
+	 * relids can exist yet, and the paths added here are for just this join.
+	 */
+	joinrel = make_join_rel(root, left->rel, right->rel);
+	if (joinrel == NULL)
+		return candidates;
+
+	finish_join_rel(root, joinrel);
+
+	cand = palloc_object(GreedyCandidate);
+	cand->left = left;
+	cand->right = right;
+	cand->joinrel = joinrel;
+
+	return lappend(candidates, cand);
+}
+
+/*
+ * greedy_record_splits
+ *	  Record the joins of a greedy join tree, whose items start at position
+ *	  'start' in the leaf order, into splits[].
+ */
+static void
+greedy_record_splits(GreedyUnit *unit, int start, int nitems, int *splits)
+{
+	int			nleft;
+	int			end;
+
+	if (unit->left == NULL)
+		return;
+
+	nleft = list_length(unit->left->members);
+	end = start + list_length(unit->members) - 1;
+	splits[start * nitems + end] = start + nleft;
+
+	greedy_record_splits(unit->left, start, nitems, splits);
+	greedy_record_splits(unit->right, start + nleft, nitems, splits);
+}
+
+/*
+ * linearized_join_search
+ *	  Dynamic programming over the joins of contiguous runs of order[].
+ *
+ * Every join made by the greedy search is always tried, so this cannot fail.
+ * Other splits are skipped if one side already costs at least 'bound', the
+ * cost of the greedy plan: any join using them must read at least one of
+ * the two sides completely.
+ */
+static RelOptInfo *
+linearized_join_search(PlannerInfo *root, int nitems, RelOptInfo **order,
+					   int *splits, Cost bound)
+{
+	RelOptInfo **runs;
+	RelOptInfo *result;
+	int			len;
+	int			i;
+
+	/* runs[i * nitems + j] is the joinrel covering items i..j, if any */
+	runs = (RelOptInfo **) palloc0(nitems * nitems * sizeof(RelOptInfo *));
+	for (i = 0; i < nitems; i++)
+		runs[i * nitems + i] = order[i];
+
+	for (len = 2; len <= nitems; len++)
+	{
+		for (i = 0; i + len <= nitems; i++)
+		{
+			int			j = i + len - 1;
+			RelOptInfo *joinrel = NULL;
+			bool		connected = false;
+			int			pass;
+
+			/*
+			 * In the first pass, consider only splits with a join clause or
+			 * join order restriction between the sides.  If there were none
+			 * at all, allow clauseless joins in a second pass.
+			 */
+			for (pass = 0; pass < 2 && !connected; pass++)
+			{
+				int			k;
+
+				for (k = i; k < j; k++)
+				{
+					RelOptInfo *left = runs[i * nitems + k];
+					RelOptInfo *right = runs[(k + 1) * nitems + j];
+					bool		greedy = (splits[i * nitems + j] == k + 1);
+					RelOptInfo *rel;
+
+					if (left == NULL || right == NULL)
+						continue;
+
+					if (!greedy && pass == 0 &&
+						!have_relevant_joinclause(root, left, right) &&
+						!have_join_order_restriction(root, left, right))
+						continue;
+					connected = true;
+
+					if (!greedy &&
+						Min(left->cheapest_total_path->total_cost,
+							right->cheapest_total_path->total_cost) >= bound)
+						continue;
+
+					rel = make_join_rel(root, left, right);
+					if (rel)
+						joinrel = rel;
+				}
+			}
+
+			if (joinrel)
+				finish_join_rel(root, joinrel);
+			runs[i * nitems + j] = joinrel;
+		}
+	}
+
+	result = runs[nitems - 1];
+	if (result == NULL)
+		elog(ERROR, "failed to build any %d-way joins", nitems);
+
+	pfree(runs);
+
+	return result;
+}
+
+/*
+ * finish_join_rel
+ *	  Complete a joinrel once all the paths we mean to try have been added.
+ */
+static void
+finish_join_rel(PlannerInfo *root, RelOptInfo *joinrel)
+{
+	/* Create paths for partitionwise joins. */
+	generate_partitionwise_join_paths(root, joinrel);
+
+	/*
+	 * Except for the topmost scan/join rel, consider gathering partial paths.
+	 * We'll do the same for the topmost scan/join rel once we know the final
+	 * targetlist (see grouping_planner).
+	 */
+	if (!bms_equal(joinrel->relids, root->all_query_rels))
+		generate_useful_gather_paths(root, joinrel, false);
+
+	/* Find and save the cheapest paths for this joinrel */
+	set_cheapest(joinrel);
+}
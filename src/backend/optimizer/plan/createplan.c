@@ -18,8 +18,10 @@
 
 #include <math.h>
 
+#include "access/htup_details.h"
 #include "access/sysattr.h"
 #include "catalog/pg_class.h"
+#include "executor/nodeHash.h"
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
 #include "nodes/extensible.h"
@@ -172,6 +174,7 @@ static Node *fix_indexqual_clause(PlannerInfo *root,
 								  Node *clause, List *indexcolnos);
 static Node *fix_indexqual_operand(Node *node, IndexOptInfo *index, int indexcol);
 static List *get_switched_clauses(List *clauses, Relids outerrelids);
+static List *get_adaptive_hashclauses(NestPath *best_path, Plan *inner_plan);
 static List *order_qual_clauses(PlannerInfo *root, List *clauses);
 static void copy_generic_path_info(Plan *dest, Path *src);
 static void copy_plan_costsize(Plan *dest, Plan *src);
@@ -883,14 +886,23 @@ use_physical_tlist(PlannerInfo *root, Path *path, int flags)
 		return false;
 
 	/*
-	 * If a bitmap scan's tlist is empty, keep it as-is.  This may allow the
-	 * executor to skip heap page fetches, and in any case, the benefit of
-	 * using a physical tlist instead would be minimal.
+	 * If a bitmap scan's or a sequential scan's tlist is empty, keep it
+	 * as-is.  This may allow the executor to skip heap page fetches, and in
+	 * any case, the benefit of using a physical tlist instead would be
+	 * minimal.
 	 */
-	if (IsA(path, BitmapHeapPath) &&
+	if ((IsA(path, BitmapHeapPath) || path->pathtype == T_SeqScan) &&
 		path->pathtarget->exprs == NIL)
 		return false;
 
+	/*
+	 * A table AM that can read only some of the columns would have to read
+	 * them all for a physical tlist.
+	 */
+	if (rel->rtekind == RTE_RELATION &&
+		(rel->amflags & AMFLAG_HAS_PROJECTION))
+		return false;
+
 	/*
 	 * Can't do it if any system columns or whole-row Vars are requested.
 	 * (This could possibly be fixed but would take some fragile assumptions
@@ -4388,11 +4400,99 @@ create_nestloop_plan(PlannerInfo *root,
 							  best_path->jpath.jointype,
 							  best_path->jpath.inner_unique);
 
+	/* let the executor switch to hashing the inner side, if it can */
+	if (nestParams == NIL)
+		join_plan->adaptive_hashclauses =
+			get_adaptive_hashclauses(best_path, inner_plan);
+
 	copy_generic_path_info(&join_plan->join.plan, &best_path->jpath.path);
 
 	return join_plan;
 }
 
+/*
+ * get_adaptive_hashclauses
+ *	  Pick the join clauses of an unparameterized nestloop that the executor
+ *	  could use to hash the inner side, if the outer side turns out to be
+ *	  much bigger than estimated.
+ *
+ * The clauses are returned in plain expression form with the outer argument
+ * on the left, commuting them if necessary.  They are also part of the
+ * joinquals, which the executor still checks, so hashing only has to find a
+ * superset of the matching inner tuples.  We give up if the inner side is
+ * expected not to fit in hash memory anyway.
+ */
+static List *
+get_adaptive_hashclauses(NestPath *best_path, Plan *inner_plan)
+{
+	Relids		outerrelids = best_path->jpath.outerjoinpath->parent->relids;
+	Relids		innerrelids = best_path->jpath.innerjoinpath->parent->relids;
+	Relids		joinrelids = best_path->jpath.path.parent->relids;
+	List	   *result = NIL;
+	double		inner_bytes;
+	ListCell   *lc;
+
+	if (!enable_adaptive_nestloop ||
+		best_path->jpath.path.param_info != NULL)
+		return NIL;
+
+	inner_bytes = inner_plan->plan_rows *
+		(MAXALIGN(inner_plan->plan_width) + MAXALIGN(SizeofMinimalTupleHeader) +
+		 3 * sizeof(void *));
+	if (inner_bytes > (double) get_hash_memory_limit())
+		return NIL;
+
+	foreach(lc, best_path->jpath.joinrestrictinfo)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		OpExpr	   *clause = (OpExpr *) rinfo->clause;
+		Oid			lhs_hashfn;
+		Oid			rhs_hashfn;
+
+		/* only actual join clauses of an outer join can be used */
+		if (rinfo->pseudoconstant ||
+			(IS_OUTER_JOIN(best_path->jpath.jointype) &&
+			 RINFO_IS_PUSHED_DOWN(rinfo, joinrelids)))
+			continue;
+		if (!rinfo->can_join || !OidIsValid(rinfo->hashjoinoperator) ||
+			contain_subplans((Node *) clause))
+			continue;
+
+		if (bms_is_subset(rinfo->left_relids, outerrelids) &&
+			bms_is_subset(rinfo->right_relids, innerrelids))
+		{
+			/* already the right way around */
+		}
+		else if (bms_is_subset(rinfo->left_relids, innerrelids) &&
+				 bms_is_subset(rinfo->right_relids, outerrelids) &&
+				 OidIsValid(get_commutator(clause->opno)))
+		{
+			/* as in get_switched_clauses, copy just enough to commute it */
+			OpExpr	   *temp = makeNode(OpExpr);
+
+			temp->opno = clause->opno;
+			temp->opfuncid = InvalidOid;
+			temp->opresulttype = clause->opresulttype;
+			temp->opretset = clause->opretset;
+			temp->opcollid = clause->opcollid;
+			temp->inputcollid = clause->inputcollid;
+			temp->args = list_copy(clause->args);
+			temp->location = clause->location;
+			CommuteOpExpr(temp);
+			clause = temp;
+		}
+		else
+			continue;
+
+		if (!get_op_hash_functions(clause->opno, &lhs_hashfn, &rhs_hashfn))
+			continue;
+
+		result = lappend(result, clause);
+	}
+
+	return result;
+}
+
 static MergeJoin *
 create_mergejoin_plan(PlannerInfo *root,
 					  MergePath *best_path)
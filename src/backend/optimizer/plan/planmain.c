@@ -58,6 +58,9 @@ query_planner(PlannerInfo *root,
 	Query	   *parse = root->parse;
 	List	   *joinlist;
 	RelOptInfo *final_rel;
+	bool		instrument;
+	instr_time	start;
+	instr_time	end;
 
 	/*
 	 * Init planner lists to empty.
@@ -263,8 +266,18 @@ query_planner(PlannerInfo *root,
 	 * Also note that some information such as lateral_relids is propagated
 	 * from baserels to otherrels here, so we must have computed it already.
 	 */
+	instrument = (planner_instrument != NULL && root->query_level == 1);
+	if (instrument)
+		INSTR_TIME_SET_CURRENT(start);
+
 	add_other_rels_to_query(root);
 
+	if (instrument)
+	{
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(planner_instrument->expand_time, end, start);
+	}
+
 	/*
 	 * Distribute any UPDATE/DELETE/MERGE row identity variables to the target
 	 * relations.  This can't be done till we've finished expansion of
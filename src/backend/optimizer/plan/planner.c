@@ -20,6 +20,7 @@
 
 #include "access/genam.h"
 #include "access/htup_details.h"
+#include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/table.h"
@@ -46,6 +47,7 @@
 #include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/inherit.h"
+#include "optimizer/joininfo.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/paramassign.h"
 #include "optimizer/pathnode.h"
@@ -58,20 +60,32 @@
 #include "optimizer/tlist.h"
 #include "parser/analyze.h"
 #include "parser/parse_agg.h"
+#include "parser/parse_oper.h"
 #include "parser/parse_relation.h"
 #include "parser/parsetree.h"
 #include "partitioning/partdesc.h"
+#include "pgstat.h"
 #include "rewrite/rewriteManip.h"
 #include "storage/dsm_impl.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/selfuncs.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
 /* GUC parameters */
 double		cursor_tuple_fraction = DEFAULT_CURSOR_TUPLE_FRACTION;
 int			debug_parallel_query = DEBUG_PARALLEL_OFF;
 bool		parallel_leader_participation = true;
+bool		track_planning_detail = false;
+
+PlannerInstrumentation *planner_instrument = NULL;
+
+/*
+ * Eager aggregation has to at least halve the number of rows of the
+ * aggregated relation to be considered.
+ */
+#define EAGER_AGG_MIN_GROUP_SIZE	2.0
 
 /* Hook for plugins to get control in planner() */
 planner_hook_type planner_hook = NULL;
@@ -234,6 +248,20 @@ static RelOptInfo *create_partial_grouping_paths(PlannerInfo *root,
 												 grouping_sets_data *gd,
 												 GroupPathExtraData *extra,
 												 bool force_rel_creation);
+static void create_eager_grouping_paths(PlannerInfo *root,
+										RelOptInfo *input_rel,
+										RelOptInfo *partially_grouped_rel,
+										GroupPathExtraData *extra);
+static RelOptInfo *make_eager_grouped_rel(PlannerInfo *root,
+										  RelOptInfo *aggrel,
+										  List *upper_vars, List *aggrefs,
+										  GroupPathExtraData *extra);
+static bool eager_grouping_key_is_image(Oid type, Oid collation);
+static RelOptInfo *make_eager_grouped_joinrel(PlannerInfo *root,
+											  RelOptInfo *outer_rel,
+											  RelOptInfo *inner_rel,
+											  List *upper_vars,
+											  double group_fraction);
 static void gather_grouping_paths(PlannerInfo *root, RelOptInfo *rel);
 static bool can_partial_agg(PlannerInfo *root);
 static void apply_scanjoin_target_to_paths(PlannerInfo *root,
@@ -274,14 +302,84 @@ planner(Query *parse, const char *query_string, int cursorOptions,
 		ParamListInfo boundParams)
 {
 	PlannedStmt *result;
+	PlannerInstrumentation instr;
+	instr_time	start;
+	instr_time	duration;
+	uint64		queryId = parse->queryId;
+
+	/*
+	 * With track_planning_detail, collect the planner's counters for the
+	 * cumulative stats, unless EXPLAIN or an outer planning is collecting
+	 * them already.  Note that standard_planner() may scribble on parse.
+	 */
+	if (!track_planning_detail || planner_instrument != NULL ||
+		queryId == UINT64CONST(0))
+	{
+		if (planner_hook)
+			result = (*planner_hook) (parse, query_string, cursorOptions, boundParams);
+		else
+			result = standard_planner(parse, query_string, cursorOptions, boundParams);
+		return result;
+	}
+
+	INSTR_TIME_SET_CURRENT(start);
+	PlannerInstrumentBegin(&instr);
+	PG_TRY();
+	{
+		if (planner_hook)
+			result = (*planner_hook) (parse, query_string, cursorOptions, boundParams);
+		else
+			result = standard_planner(parse, query_string, cursorOptions, boundParams);
+	}
+	PG_FINALLY();
+	{
+		PlannerInstrumentEnd(&instr);
+	}
+	PG_END_TRY();
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	pgstat_report_planning(queryId, duration, &instr);
 
-	if (planner_hook)
-		result = (*planner_hook) (parse, query_string, cursorOptions, boundParams);
-	else
-		result = standard_planner(parse, query_string, cursorOptions, boundParams);
 	return result;
 }
 
+/*
+ * PlannerInstrumentBegin
+ *	  Start collecting PlannerInstrumentation for planning done in the
+ *	  current memory context.
+ *
+ * The caller must make sure PlannerInstrumentEnd() is called even if
+ * planning fails, as planner_instrument points to *instr meanwhile.
+ */
+void
+PlannerInstrumentBegin(PlannerInstrumentation *instr)
+{
+	memset(instr, 0, sizeof(PlannerInstrumentation));
+	instr->prev = planner_instrument;
+	instr->context = CurrentMemoryContext;
+	instr->context_start = MemoryContextMemAllocated(CurrentMemoryContext,
+													 true);
+	planner_instrument = instr;
+}
+
+/*
+ * PlannerInstrumentEnd
+ *	  Stop collecting, and fill in the memory allocated meanwhile.
+ */
+void
+PlannerInstrumentEnd(PlannerInstrumentation *instr)
+{
+	Size		allocated;
+
+	Assert(planner_instrument == instr);
+
+	allocated = MemoryContextMemAllocated(instr->context, true);
+	if (allocated > instr->context_start)
+		instr->memory_allocated = allocated - instr->context_start;
+	planner_instrument = instr->prev;
+}
+
 PlannedStmt *
 standard_planner(Query *parse, const char *query_string, int cursorOptions,
 				 ParamListInfo boundParams)
@@ -3971,13 +4069,25 @@ create_ordinary_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
 	if ((extra->flags & GROUPING_CAN_PARTIAL_AGG) != 0)
 	{
 		bool		force_rel_creation;
+		bool		try_eager_agg;
+
+		/*
+		 * Eager aggregation works on the joins of the topmost scan/join rel,
+		 * and only for plain GROUP BY.
+		 */
+		try_eager_agg = (enable_eager_aggregate &&
+						 input_rel->reloptkind == RELOPT_JOINREL &&
+						 extra->patype == PARTITIONWISE_AGGREGATE_NONE &&
+						 patype == PARTITIONWISE_AGGREGATE_NONE &&
+						 gd == NULL);
 
 		/*
 		 * If we're doing partitionwise aggregation at this level, force
 		 * creation of a partially_grouped_rel so we can add partitionwise
-		 * paths to it.
+		 * paths to it.  Likewise for eager aggregation paths.
 		 */
-		force_rel_creation = (patype == PARTITIONWISE_AGGREGATE_PARTIAL);
+		force_rel_creation = (patype == PARTITIONWISE_AGGREGATE_PARTIAL ||
+							  try_eager_agg);
 
 		partially_grouped_rel =
 			create_partial_grouping_paths(root,
@@ -3986,6 +4096,10 @@ create_ordinary_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
 										  gd,
 										  extra,
 										  force_rel_creation);
+
+		if (try_eager_agg)
+			create_eager_grouping_paths(root, input_rel,
+										partially_grouped_rel, extra);
 	}
 
 	/* Set out parameter. */
@@ -4014,6 +4128,8 @@ create_ordinary_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
 		gather_grouping_paths(root, partially_grouped_rel);
 		set_cheapest(partially_grouped_rel);
 	}
+	else if (partially_grouped_rel && partially_grouped_rel->pathlist)
+		set_cheapest(partially_grouped_rel);
 
 	/*
 	 * Estimate number of groups.
@@ -6614,7 +6730,8 @@ plan_cluster_use_sort(Oid tableOid, Oid indexOid)
  *		CREATE INDEX should request for use
  *
  * tableOid is the table on which the index is to be built.  indexOid is the
- * OID of an index to be created or reindexed (which must be a btree index).
+ * OID of an index to be created or reindexed (which must be of an
+ * access method that supports parallel builds).
  *
  * Return value is the number of parallel worker processes to request.  It
  * may be unsafe to proceed if this is 0.  Note that this does not include the
@@ -6971,6 +7088,35 @@ add_paths_to_grouping_rel(PlannerInfo *root, RelOptInfo *input_rel,
 									 havingQual,
 									 agg_costs,
 									 dNumGroups));
+
+			/*
+			 * Also consider a Parallel HashAgg over the cheapest partial
+			 * input path.  Its participants partition the input among
+			 * themselves by grouping key and each aggregates whole
+			 * partitions, so every group is computed just once and no
+			 * combine functions are needed.  That beats Partial and Finalize
+			 * steps when there are so many groups that partial aggregation
+			 * hardly reduces the input.  It's a partial path, gathered
+			 * below.  We leave partitionwise aggregation of child relations
+			 * alone, as Parallel Append may move participants between
+			 * children.
+			 */
+			if (enable_parallel_hashagg && grouped_rel->consider_parallel &&
+				input_rel->partial_pathlist != NIL &&
+				!IS_OTHER_REL(grouped_rel))
+			{
+				Path	   *partial_path = linitial(input_rel->partial_pathlist);
+
+				add_partial_path(grouped_rel, (Path *)
+								 create_parallel_hashagg_path(root,
+															  grouped_rel,
+															  partial_path,
+															  grouped_rel->reltarget,
+															  root->processed_groupClause,
+															  havingQual,
+															  agg_costs,
+															  dNumGroups));
+			}
 		}
 
 		/*
@@ -7331,6 +7477,359 @@ create_partial_grouping_paths(PlannerInfo *root,
 	return partially_grouped_rel;
 }
 
+/*
+ * create_eager_grouping_paths
+ *
+ * Consider "eager aggregation": partially aggregating the one base relation
+ * that all the aggregates reference before joining it to the others, and
+ * finalizing the aggregation above the joins.  This pays off when the joins
+ * don't filter out many rows of the aggregated relation but that relation is
+ * large, as fact tables in a star schema are.
+ *
+ * The partial aggregation groups by all the columns of the relation that
+ * are needed above the scan other than in aggregates, including the join
+ * columns.  Since all the rows of such a group join to the same rows, the
+ * joins duplicate the partial aggregate state as they would have duplicated
+ * the aggregated rows, so combining the states gives the same result as
+ * aggregating the joined rows.  That requires the values of a group to be
+ * identical, not just equal: join clauses and upper expressions only get to
+ * see one of them, and could well tell apart, say, numeric 1.0 and 1.00.  See
+ * eager_grouping_key_is_image().  Outer joins could yield null-extended rows
+ * for which there's no partial state, so we only handle inner joins.
+ *
+ * The other relations are joined in one at a time, as long as the joinrels
+ * built by the regular join search for the same sets of relations can serve
+ * as templates.  The resulting paths emit the same target as partially
+ * grouped paths, so they are added to partially_grouped_rel and finalized
+ * along with the others.
+ */
+static void
+create_eager_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
+							RelOptInfo *partially_grouped_rel,
+							GroupPathExtraData *extra)
+{
+	PathTarget *partial_target = partially_grouped_rel->reltarget;
+	List	   *aggrefs = NIL;
+	List	   *upper_vars = NIL;
+	Relids		aggrelids = NULL;
+	Relids		remaining;
+	RelOptInfo *aggrel;
+	RelOptInfo *current;
+	double		group_fraction;
+	ListCell   *lc;
+
+	if (root->join_info_list != NIL || root->parse->hasTargetSRFs)
+		return;
+
+	/*
+	 * Find the partial Aggrefs and the relation they reference, and the Vars
+	 * the final aggregation needs otherwise.
+	 */
+	foreach(lc, partial_target->exprs)
+	{
+		Node	   *expr = (Node *) lfirst(lc);
+
+		if (IsA(expr, Aggref))
+		{
+			if (contain_volatile_functions(expr))
+				return;
+			aggrelids = bms_add_members(aggrelids, pull_varnos(root, expr));
+			aggrefs = lappend(aggrefs, expr);
+		}
+		else
+		{
+			List	   *vars = pull_var_clause(expr, PVC_INCLUDE_PLACEHOLDERS);
+			ListCell   *lc2;
+
+			foreach(lc2, vars)
+			{
+				if (!IsA(lfirst(lc2), Var))
+					return;
+			}
+			upper_vars = list_concat(upper_vars, vars);
+		}
+	}
+
+	if (bms_membership(aggrelids) != BMS_SINGLETON)
+		return;
+	aggrel = find_base_rel(root, bms_singleton_member(aggrelids));
+	if (aggrel->reloptkind != RELOPT_BASEREL ||
+		aggrel->fdwroutine != NULL ||
+		aggrel->cheapest_total_path == NULL ||
+		aggrel->cheapest_total_path->param_info != NULL ||
+		!bms_is_subset(aggrel->relids, input_rel->relids))
+		return;
+
+	current = make_eager_grouped_rel(root, aggrel, upper_vars, aggrefs, extra);
+	if (current == NULL)
+		return;
+	group_fraction = current->rows / aggrel->rows;
+
+	/* Join in the other relations */
+	remaining = bms_difference(input_rel->relids, aggrel->relids);
+	while (!bms_is_empty(remaining))
+	{
+		RelOptInfo *other = NULL;
+		int			relid = -1;
+
+		while ((relid = bms_next_member(remaining, relid)) >= 0)
+		{
+			RelOptInfo *rel = root->simple_rel_array[relid];
+
+			if (rel != NULL && rel->reloptkind == RELOPT_BASEREL &&
+				have_relevant_joinclause(root, current, rel))
+			{
+				other = rel;
+				break;
+			}
+		}
+		if (other == NULL)
+			return;
+
+		current = make_eager_grouped_joinrel(root, current, other, upper_vars,
+											 group_fraction);
+		if (current == NULL)
+			return;
+		remaining = bms_del_members(remaining, other->relids);
+	}
+
+	add_path(partially_grouped_rel, (Path *)
+			 create_projection_path(root, partially_grouped_rel,
+									current->cheapest_total_path,
+									partial_target));
+}
+
+/*
+ * make_eager_grouped_rel
+ *		Build a RelOptInfo for the partially aggregated rows of aggrel.
+ *
+ * Returns NULL if the partial aggregation can't be done by hashing or
+ * wouldn't reduce the number of rows enough to be worth considering.
+ */
+static RelOptInfo *
+make_eager_grouped_rel(PlannerInfo *root, RelOptInfo *aggrel,
+					   List *upper_vars, List *aggrefs,
+					   GroupPathExtraData *extra)
+{
+	PathTarget *input_target = copy_pathtarget(aggrel->reltarget);
+	PathTarget *target = create_empty_pathtarget();
+	Relids		local_relids = bms_add_member(bms_copy(aggrel->relids), 0);
+	List	   *groupClause = NIL;
+	List	   *groupExprs = NIL;
+	Index		sortgroupref = 0;
+	double		numGroups;
+	RelOptInfo *grouped_rel;
+	Path	   *path;
+	ListCell   *lc;
+
+	input_target->sortgrouprefs =
+		(Index *) palloc0(list_length(input_target->exprs) * sizeof(Index));
+
+	foreach(lc, input_target->exprs)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+		SortGroupClause *sgc;
+		Oid			sortop;
+		Oid			eqop;
+		bool		hashable;
+
+		if (!IsA(var, Var) || var->varattno <= 0)
+			return NULL;
+
+		/* Columns used above the scan other than in aggregates are keys */
+		if (!list_member(upper_vars, var) &&
+			!bms_nonempty_difference(aggrel->attr_needed[var->varattno - aggrel->min_attr],
+									 local_relids))
+			continue;
+
+		if (!eager_grouping_key_is_image(var->vartype, var->varcollid))
+			return NULL;
+
+		get_sort_group_operators(exprType((Node *) var),
+								 false, false, false,
+								 &sortop, &eqop, NULL,
+								 &hashable);
+		if (!OidIsValid(eqop) || !hashable)
+			return NULL;
+
+		sgc = makeNode(SortGroupClause);
+		sgc->tleSortGroupRef = ++sortgroupref;
+		sgc->eqop = eqop;
+		sgc->sortop = sortop;
+		sgc->nulls_first = false;
+		sgc->hashable = true;
+		groupClause = lappend(groupClause, sgc);
+		groupExprs = lappend(groupExprs, var);
+
+		input_target->sortgrouprefs[foreach_current_index(lc)] = sortgroupref;
+		add_column_to_pathtarget(target, (Expr *) var, sortgroupref);
+	}
+	foreach(lc, aggrefs)
+		add_column_to_pathtarget(target, (Expr *) lfirst(lc), 0);
+	set_pathtarget_cost_width(root, target);
+
+	numGroups = estimate_num_groups(root, groupExprs, aggrel->rows,
+									NULL, NULL);
+	if (numGroups * EAGER_AGG_MIN_GROUP_SIZE > aggrel->rows)
+		return NULL;
+
+	/* The grouped rel looks like aggrel, but with fewer and wider rows */
+	grouped_rel = makeNode(RelOptInfo);
+	memcpy(grouped_rel, aggrel, sizeof(RelOptInfo));
+	grouped_rel->reltarget = target;
+	grouped_rel->rows = numGroups;
+	grouped_rel->consider_parallel = false;
+	grouped_rel->pathlist = NIL;
+	grouped_rel->ppilist = NIL;
+	grouped_rel->partial_pathlist = NIL;
+	grouped_rel->cheapest_startup_path = NULL;
+	grouped_rel->cheapest_total_path = NULL;
+	grouped_rel->cheapest_unique_path = NULL;
+	grouped_rel->cheapest_parameterized_paths = NIL;
+	grouped_rel->part_scheme = NULL;
+
+	path = (Path *) create_projection_path(root, aggrel,
+										   aggrel->cheapest_total_path,
+										   input_target);
+	add_path(grouped_rel, (Path *)
+			 create_agg_path(root,
+							 grouped_rel,
+							 path,
+							 target,
+							 AGG_HASHED,
+							 AGGSPLIT_INITIAL_SERIAL,
+							 groupClause,
+							 NIL,
+							 &extra->agg_partial_costs,
+							 numGroups));
+	set_cheapest(grouped_rel);
+
+	return grouped_rel;
+}
+
+/*
+ * eager_grouping_key_is_image
+ *		Can values of the given type and collation only be grouped together
+ *		by the type's default equality if they are identical?
+ *
+ * This is what the BTEQUALIMAGE_PROC of the type's default btree opclass
+ * tells us, the same test that btree deduplication relies on.  Types such as
+ * numeric or float, whose equal values can differ in their display or in the
+ * results of functions, lack it or deny it, and so do nondeterministic
+ * collations.
+ */
+static bool
+eager_grouping_key_is_image(Oid type, Oid collation)
+{
+	TypeCacheEntry *tce;
+	Oid			equalimageproc;
+
+	if (OidIsValid(collation) && !get_collation_isdeterministic(collation))
+		return false;
+
+	tce = lookup_type_cache(type, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tce->btree_opf) || !OidIsValid(tce->btree_opintype))
+		return false;
+
+	equalimageproc = get_opfamily_proc(tce->btree_opf,
+									   tce->btree_opintype,
+									   tce->btree_opintype,
+									   BTEQUALIMAGE_PROC);
+	if (!OidIsValid(equalimageproc))
+		return false;
+
+	return DatumGetBool(OidFunctionCall1Coll(equalimageproc, collation,
+											 ObjectIdGetDatum(tce->btree_opintype)));
+}
+
+/*
+ * make_eager_grouped_joinrel
+ *		Build a RelOptInfo for joining partially aggregated rows to a base
+ *		relation.
+ *
+ * Returns NULL if the regular join search didn't consider the join.
+ */
+static RelOptInfo *
+make_eager_grouped_joinrel(PlannerInfo *root, RelOptInfo *outer_rel,
+						   RelOptInfo *inner_rel, List *upper_vars,
+						   double group_fraction)
+{
+	Relids		joinrelids = bms_union(outer_rel->relids, inner_rel->relids);
+	Relids		local_relids = bms_add_member(bms_copy(joinrelids), 0);
+	RelOptInfo *template_rel = find_join_rel(root, joinrelids);
+	RelOptInfo *joinrel;
+	SpecialJoinInfo *sjinfo;
+	PathTarget *target;
+	List	   *restrictlist;
+	ListCell   *lc;
+
+	if (template_rel == NULL)
+		return NULL;
+
+	/* Emit the Aggrefs and whatever Vars are still needed */
+	target = create_empty_pathtarget();
+	foreach(lc, list_concat_copy(outer_rel->reltarget->exprs,
+								 inner_rel->reltarget->exprs))
+	{
+		Node	   *expr = (Node *) lfirst(lc);
+		Var		   *var = (Var *) expr;
+		RelOptInfo *rel;
+
+		if (IsA(expr, Aggref))
+		{
+			add_column_to_pathtarget(target, (Expr *) expr, 0);
+			continue;
+		}
+		if (!IsA(expr, Var))
+			return NULL;
+
+		rel = find_base_rel(root, var->varno);
+		if (list_member(upper_vars, var) ||
+			bms_nonempty_difference(rel->attr_needed[var->varattno - rel->min_attr],
+									local_relids))
+			add_column_to_pathtarget(target, (Expr *) var, 0);
+	}
+	set_pathtarget_cost_width(root, target);
+
+	/* Dummy SpecialJoinInfo for inner join, as in make_join_rel() */
+	sjinfo = makeNode(SpecialJoinInfo);
+	sjinfo->min_lefthand = outer_rel->relids;
+	sjinfo->min_righthand = inner_rel->relids;
+	sjinfo->syn_lefthand = outer_rel->relids;
+	sjinfo->syn_righthand = inner_rel->relids;
+	sjinfo->jointype = JOIN_INNER;
+	sjinfo->ojrelid = 0;
+
+	/* This just computes the restrictlist, as the joinrel exists */
+	(void) build_join_rel(root, joinrelids, outer_rel, inner_rel, sjinfo,
+						  NIL, &restrictlist);
+
+	joinrel = makeNode(RelOptInfo);
+	memcpy(joinrel, template_rel, sizeof(RelOptInfo));
+	joinrel->reltarget = target;
+	joinrel->rows = clamp_row_est(template_rel->rows * group_fraction);
+	joinrel->consider_parallel = false;
+	joinrel->pathlist = NIL;
+	joinrel->ppilist = NIL;
+	joinrel->partial_pathlist = NIL;
+	joinrel->cheapest_startup_path = NULL;
+	joinrel->cheapest_total_path = NULL;
+	joinrel->cheapest_unique_path = NULL;
+	joinrel->cheapest_parameterized_paths = NIL;
+	joinrel->fdwroutine = NULL;
+	joinrel->part_scheme = NULL;
+
+	add_paths_to_joinrel(root, joinrel, outer_rel, inner_rel,
+						 JOIN_INNER, sjinfo, restrictlist);
+	add_paths_to_joinrel(root, joinrel, inner_rel, outer_rel,
+						 JOIN_INNER, sjinfo, restrictlist);
+	if (joinrel->pathlist == NIL)
+		return NULL;
+	set_cheapest(joinrel);
+
+	return joinrel;
+}
+
 /*
  * Generate Gather and Gather Merge paths for a grouping relation or partial
  * grouping relation.
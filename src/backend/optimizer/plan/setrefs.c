@@ -2280,6 +2280,15 @@ set_join_references(PlannerInfo *root, Join *join, int rtoffset)
 		NestLoop   *nl = (NestLoop *) join;
 		ListCell   *lc;
 
+		nl->adaptive_hashclauses = fix_join_expr(root,
+												 nl->adaptive_hashclauses,
+												 outer_itlist,
+												 inner_itlist,
+												 (Index) 0,
+												 rtoffset,
+												 NRM_EQUAL,
+												 NUM_EXEC_QUAL((Plan *) join));
+
 		foreach(lc, nl->nestParams)
 		{
 			NestLoopParam *nlp = (NestLoopParam *) lfirst(lc);
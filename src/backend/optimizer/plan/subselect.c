@@ -548,6 +548,19 @@ build_subplan(PlannerInfo *root, Plan *plan, PlannerInfo *subroot,
 	if (isInitPlan)
 		root->init_plans = lappend(root->init_plans, splan);
 
+	/*
+	 * An initplan's result depends only on the data and the query parameters
+	 * unless it calls mutable functions or locks rows; the executor can cache
+	 * such results (see ExecSetParamPlan).  Stable functions are excluded as
+	 * well since their results, such as now() or current_setting(), can
+	 * change between statements, which is all the cache is about.
+	 */
+	splan->result_cacheable = (isInitPlan &&
+							   subLinkType != MULTIEXPR_SUBLINK &&
+							   subroot->rowMarks == NIL &&
+							   !subroot->parse->hasModifyingCTE &&
+							   !contain_mutable_functions((Node *) subroot->parse));
+
 	/*
 	 * A parameterless subplan (not initplan) should be prepared to handle
 	 * REWIND efficiently.  If it has direct parameters then there's no point
@@ -935,7 +935,7 @@ add_row_identity_columns(PlannerInfo *root, Index rtindex,
 		 * Alas, this misses system columns.
 		 */
 		if (commandType == CMD_UPDATE ||
-			(target_relation->trigdesc &&
+			(RelationGetTriggerDesc(target_relation) &&
 			 (target_relation->trigdesc->trig_delete_after_row ||
 			  target_relation->trigdesc->trig_delete_before_row)))
 		{
@@ -111,6 +111,7 @@ static Relids find_nonnullable_rels_walker(Node *node, bool top_level);
 static List *find_nonnullable_vars_walker(Node *node, bool top_level);
 static bool is_strict_saop(ScalarArrayOpExpr *expr, bool falseOK);
 static bool convert_saop_to_hashed_saop_walker(Node *node, void *context);
+static int	saop_array_nitems(Expr *arrayarg);
 static Node *eval_const_expressions_mutator(Node *node,
 											eval_const_expressions_context *context);
 static bool contain_non_const_walker(Node *node, void *context);
@@ -2192,13 +2193,16 @@ eval_const_expressions(PlannerInfo *root, Node *node)
  * evaluate using a hash table rather than a linear search.
  *
  * We'll use a hash table if all of the following conditions are met:
- * 1. The 2nd argument of the array contain only Consts.
+ * 1. The 2nd argument of the array contain only Consts, or is an external
+ *	  Param, whose value can't change during an execution.
  * 2. useOr is true or there is a valid negator operator for the
  *	  ScalarArrayOpExpr's opno.
  * 3. There's valid hash function for both left and righthand operands and
  *	  these hash functions are the same.
  * 4. If the array contains enough elements for us to consider it to be
- *	  worthwhile using a hash table rather than a linear search.
+ *	  worthwhile using a hash table rather than a linear search.  We can't
+ *	  tell for a Param; applications typically pass long lists that way, so
+ *	  assume it does.
  */
 void
 convert_saop_to_hashed_saop(Node *node)
@@ -2218,27 +2222,26 @@ convert_saop_to_hashed_saop_walker(Node *node, void *context)
 		Expr	   *arrayarg = (Expr *) lsecond(saop->args);
 		Oid			lefthashfunc;
 		Oid			righthashfunc;
+		bool		isparam;
 
-		if (arrayarg && IsA(arrayarg, Const) &&
-			!((Const *) arrayarg)->constisnull)
+		isparam = (arrayarg && IsA(arrayarg, Param) &&
+				   ((Param *) arrayarg)->paramkind == PARAM_EXTERN);
+
+		if ((arrayarg && IsA(arrayarg, Const) &&
+			 !((Const *) arrayarg)->constisnull) || isparam)
 		{
 			if (saop->useOr)
 			{
 				if (get_op_hash_functions(saop->opno, &lefthashfunc, &righthashfunc) &&
 					lefthashfunc == righthashfunc)
 				{
-					Datum		arrdatum = ((Const *) arrayarg)->constvalue;
-					ArrayType  *arr = (ArrayType *) DatumGetPointer(arrdatum);
-					int			nitems;
-
 					/*
 					 * Only fill in the hash functions if the array looks
 					 * large enough for it to be worth hashing instead of
 					 * doing a linear search.
 					 */
-					nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
-
-					if (nitems >= MIN_ARRAY_SIZE_FOR_HASHED_SAOP)
+					if (isparam || saop_array_nitems(arrayarg) >=
+						MIN_ARRAY_SIZE_FOR_HASHED_SAOP)
 					{
 						/* Looks good. Fill in the hash functions */
 						saop->hashfuncid = lefthashfunc;
@@ -2259,18 +2262,13 @@ convert_saop_to_hashed_saop_walker(Node *node, void *context)
 					get_op_hash_functions(negator, &lefthashfunc, &righthashfunc) &&
 					lefthashfunc == righthashfunc)
 				{
-					Datum		arrdatum = ((Const *) arrayarg)->constvalue;
-					ArrayType  *arr = (ArrayType *) DatumGetPointer(arrdatum);
-					int			nitems;
-
 					/*
 					 * Only fill in the hash functions if the array looks
 					 * large enough for it to be worth hashing instead of
 					 * doing a linear search.
 					 */
-					nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
-
-					if (nitems >= MIN_ARRAY_SIZE_FOR_HASHED_SAOP)
+					if (isparam || saop_array_nitems(arrayarg) >=
+						MIN_ARRAY_SIZE_FOR_HASHED_SAOP)
 					{
 						/* Looks good. Fill in the hash functions */
 						saop->hashfuncid = lefthashfunc;
@@ -2290,6 +2288,18 @@ convert_saop_to_hashed_saop_walker(Node *node, void *context)
 	return expression_tree_walker(node, convert_saop_to_hashed_saop_walker, NULL);
 }
 
+/*
+ * Number of elements of the non-null array Const arrayarg
+ */
+static int
+saop_array_nitems(Expr *arrayarg)
+{
+	Datum		arrdatum = ((Const *) arrayarg)->constvalue;
+	ArrayType  *arr = (ArrayType *) DatumGetPointer(arrdatum);
+
+	return ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+}
+
 
 /*--------------------
  * estimate_expression_value
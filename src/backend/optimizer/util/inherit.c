@@ -372,6 +372,23 @@ expand_partitioned_rtentry(PlannerInfo *root, RelOptInfo *relinfo,
 	relinfo->part_rels = (RelOptInfo **)
 		palloc0(relinfo->nparts * sizeof(RelOptInfo *));
 
+	/*
+	 * Opening many partitions one at a time would do a separate set of
+	 * catalog lookups for each to build its relcache entry, so fetch their
+	 * catalog rows in bulk first.
+	 */
+	if (num_live_parts > 1)
+	{
+		Oid		   *childoids = palloc(num_live_parts * sizeof(Oid));
+		int			nchildoids = 0;
+
+		i = -1;
+		while ((i = bms_next_member(live_parts, i)) >= 0)
+			childoids[nchildoids++] = partdesc->oids[i];
+		RelationCachePrefetch(childoids, nchildoids);
+		pfree(childoids);
+	}
+
 	/*
 	 * Create a child RTE for each live partition.  Note that unlike
 	 * traditional inheritance, we don't need a child RTE for the partitioned
@@ -517,6 +517,9 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 		relation->rd_tableam->scan_set_tidrange != NULL &&
 		relation->rd_tableam->scan_getnextslot_tidrange != NULL)
 		rel->amflags |= AMFLAG_HAS_TID_RANGE;
+	if (relation->rd_tableam &&
+		relation->rd_tableam->scan_set_projection != NULL)
+		rel->amflags |= AMFLAG_HAS_PROJECTION;
 
 	/*
 	 * Collect info about relation's partitioning scheme, if any. Only
@@ -1394,6 +1397,20 @@ get_relation_statistics_worker(List **stainfos, RelOptInfo *rel,
 		*stainfos = lappend(*stainfos, info);
 	}
 
+	if (statext_is_kind_built(dtup, STATS_EXT_SKETCH))
+	{
+		StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+		info->statOid = statOid;
+		info->inherit = dataForm->stxdinherit;
+		info->rel = rel;
+		info->kind = STATS_EXT_SKETCH;
+		info->keys = bms_copy(keys);
+		info->exprs = exprs;
+
+		*stainfos = lappend(*stainfos, info);
+	}
+
 	if (statext_is_kind_built(dtup, STATS_EXT_EXPRESSIONS))
 	{
 		StatisticExtInfo *info = makeNode(StatisticExtInfo);
@@ -2199,7 +2216,7 @@ has_row_triggers(PlannerInfo *root, Index rti, CmdType event)
 	/* Assume we already have adequate lock */
 	relation = table_open(rte->relid, NoLock);
 
-	trigDesc = relation->trigdesc;
+	trigDesc = RelationGetTriggerDesc(relation);
 	switch (event)
 	{
 		case CMD_INSERT:
@@ -142,7 +142,12 @@ transformExprRecurse(ParseState *pstate, Node *expr)
 			break;
 
 		case T_A_Const:
-			result = (Node *) make_const(pstate, (A_Const *) expr);
+			/* A hook may want to replace the constant, e.g. by a Param */
+			result = NULL;
+			if (pstate->p_aconst_hook != NULL)
+				result = pstate->p_aconst_hook(pstate, (A_Const *) expr);
+			if (result == NULL)
+				result = (Node *) make_const(pstate, (A_Const *) expr);
 			break;
 
 		case T_A_Indirection:
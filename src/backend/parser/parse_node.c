@@ -61,6 +61,7 @@ make_parsestate(ParseState *parentParseState)
 		pstate->p_post_columnref_hook = parentParseState->p_post_columnref_hook;
 		pstate->p_paramref_hook = parentParseState->p_paramref_hook;
 		pstate->p_coerce_param_hook = parentParseState->p_coerce_param_hook;
+		pstate->p_aconst_hook = parentParseState->p_aconst_hook;
 		pstate->p_ref_hook_state = parentParseState->p_ref_hook_state;
 		/* query environment stays in context for the whole parse analysis */
 		pstate->p_queryEnv = parentParseState->p_queryEnv;
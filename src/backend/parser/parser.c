@@ -23,8 +23,10 @@
 
 #include "mb/pg_wchar.h"
 #include "gramparse.h"
+#include "nodes/miscnodes.h"
 #include "parser/parser.h"
 #include "parser/scansup.h"
+#include "utils/builtins.h"
 
 static bool check_uescapechar(unsigned char escape);
 static char *str_udeescape(const char *str, char escape,
@@ -85,6 +87,109 @@ raw_parser(const char *str, RawParseMode mode)
 	return yyextra.parsetree;
 }
 
+/*
+ * scan_query_literals
+ *		Find the literal constants of a single SQL command.
+ *
+ * Only lexical analysis is done, so this is much cheaper than raw_parser().
+ * The literals are returned in order of appearance in *literals, a palloc'd
+ * array of *nliterals entries.
+ *
+ * Returns false if the string contains more than one command or any
+ * parameter symbol ($n), in which case *literals is not meaningful.
+ */
+bool
+scan_query_literals(const char *str, QueryLiteral **literals, int *nliterals)
+{
+	core_yyscan_t yyscanner;
+	core_yy_extra_type yyextra;
+	core_YYSTYPE yylval;
+	YYLTYPE		yylloc;
+	int			maxliterals = 16;
+	bool		seen_semicolon = false;
+	bool		result = true;
+
+	*literals = palloc(maxliterals * sizeof(QueryLiteral));
+	*nliterals = 0;
+
+	yyscanner = scanner_init(str, &yyextra, &ScanKeywords, ScanKeywordTokens);
+
+	for (;;)
+	{
+		int			tok = core_yylex(&yylval, &yylloc, yyscanner);
+		QueryLiteral *lit;
+
+		if (tok == 0)
+			break;
+
+		/* Nothing but more semicolons may follow the first one */
+		if (tok == ';')
+		{
+			seen_semicolon = true;
+			continue;
+		}
+		if (seen_semicolon || tok == PARAM)
+		{
+			result = false;
+			break;
+		}
+
+		if (tok != ICONST && tok != FCONST && tok != SCONST &&
+			tok != BCONST && tok != XCONST)
+			continue;
+
+		if (*nliterals >= maxliterals)
+		{
+			maxliterals *= 2;
+			*literals = repalloc(*literals, maxliterals * sizeof(QueryLiteral));
+		}
+		lit = &(*literals)[(*nliterals)++];
+		lit->location = yylloc;
+
+		/*
+		 * Like pg_stat_statements, we rely on flex having placed a zero byte
+		 * after the text of the current token in scanbuf.
+		 */
+		lit->length = strlen(yyextra.scanbuf + yylloc);
+
+		switch (tok)
+		{
+			case ICONST:
+				lit->kind = QUERY_LITERAL_INT4;
+				lit->value = psprintf("%d", yylval.ival);
+				break;
+			case FCONST:
+				{
+					/* same classification as make_const() */
+					ErrorSaveContext escontext = {T_ErrorSaveContext};
+					int64		val64;
+
+					val64 = pg_strtoint64_safe(yylval.str, (Node *) &escontext);
+					if (escontext.error_occurred)
+						lit->kind = QUERY_LITERAL_NUMERIC;
+					else if (val64 == (int64) ((int32) val64))
+						lit->kind = QUERY_LITERAL_INT4;
+					else
+						lit->kind = QUERY_LITERAL_INT8;
+					lit->value = yylval.str;
+				}
+				break;
+			case SCONST:
+				lit->kind = QUERY_LITERAL_STRING;
+				lit->value = yylval.str;
+				break;
+			default:
+				lit->kind = QUERY_LITERAL_BITSTRING;
+				lit->value = yylval.str;
+				break;
+		}
+	}
+
+	scanner_finish(yyscanner);
+
+	return result;
+}
+
 
 /*
  * Intermediate filter between parser and core lexer (core_yylex in scan.l).
@@ -18,12 +18,14 @@
 #include "access/htup_details.h"
 #include "access/table.h"
 #include "catalog/partition.h"
+#include "catalog/pg_class.h"
 #include "catalog/pg_inherits.h"
 #include "partitioning/partbounds.h"
 #include "partitioning/partdesc.h"
 #include "storage/bufmgr.h"
 #include "storage/sinval.h"
 #include "utils/builtins.h"
+#include "utils/catcache.h"
 #include "utils/fmgroids.h"
 #include "utils/hsearch.h"
 #include "utils/inval.h"
@@ -47,8 +49,55 @@ typedef struct PartitionDirectoryEntry
 	PartitionDesc pd;
 } PartitionDirectoryEntry;
 
+/*
+ * Cache of the parsed bound specs of partitions.
+ *
+ * Rebuilding the descriptor of a partitioned table after any invalidation
+ * of it would otherwise parse every partition's relpartbound again, while
+ * typically just one partition has been attached or detached.  So we keep
+ * the parsed specs here, keyed by partition OID, and reuse them as long as
+ * the pg_class tuple they came from is the current one.  A relcache
+ * invalidation of a partition removes its entry.
+ *
+ * We also remember where each partition went in the last descriptor built,
+ * and feed the specs to partition_bounds_create() in that order.  The sort
+ * there then finds the input nearly sorted, which it handles in close to
+ * linear time.
+ *
+ * The specs live in PartitionBoundCacheContext.  Removing an entry doesn't
+ * free its spec, since a descriptor being built may still be using it;
+ * instead, once enough garbage has accumulated, the live specs are copied
+ * into a new context and the old one is left to go away with the current
+ * transaction.
+ */
+typedef struct PartitionBoundCacheEntry
+{
+	Oid			relid;			/* hash key: OID of the partition */
+	ItemPointerData tid;		/* pg_class tuple the spec came from */
+	TransactionId xmin;			/* ... and its xmin */
+	int			position;		/* index in last descriptor, or -1 */
+	PartitionBoundSpec *boundspec;	/* the parsed relpartbound */
+} PartitionBoundCacheEntry;
+
+static HTAB *PartitionBoundCacheHash = NULL;
+static MemoryContext PartitionBoundCacheContext = NULL;
+static long PartitionBoundCacheGarbage = 0;
+
+/* working data of RelationBuildPartitionDesc for one partition */
+typedef struct PartitionBuildItem
+{
+	Oid			oid;
+	bool		is_leaf;
+	int			position;
+	PartitionBoundSpec *boundspec;
+} PartitionBuildItem;
+
 static PartitionDesc RelationBuildPartitionDesc(Relation rel,
 												bool omit_detached);
+static void PartitionBoundCacheInit(void);
+static void PartitionBoundCacheCompact(void);
+static void PartitionBoundCacheCallback(Datum arg, Oid relid);
+static int	partition_build_item_cmp(const void *a, const void *b);
 
 
 /*
@@ -137,9 +186,9 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 	PartitionDesc partdesc;
 	PartitionBoundInfo boundinfo = NULL;
 	List	   *inhoids;
+	PartitionBuildItem *items = NULL;
 	PartitionBoundSpec **boundspecs = NULL;
-	Oid		   *oids = NULL;
-	bool	   *is_leaf = NULL;
+	bool		presorted = true;
 	bool		detached_exist;
 	bool		is_omit;
 	TransactionId detached_xmin;
@@ -166,14 +215,16 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 
 	nparts = list_length(inhoids);
 
-	/* Allocate working arrays for OIDs, leaf flags, and boundspecs. */
+	/* Allocate working arrays for partitions and their boundspecs. */
 	if (nparts > 0)
 	{
-		oids = (Oid *) palloc(nparts * sizeof(Oid));
-		is_leaf = (bool *) palloc(nparts * sizeof(bool));
+		items = (PartitionBuildItem *)
+			palloc(nparts * sizeof(PartitionBuildItem));
 		boundspecs = palloc(nparts * sizeof(PartitionBoundSpec *));
 	}
 
+	PartitionBoundCacheInit();
+
 	/* Collect bound spec nodes for each partition. */
 	i = 0;
 	foreach(cell, inhoids)
@@ -181,19 +232,56 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 		Oid			inhrelid = lfirst_oid(cell);
 		HeapTuple	tuple;
 		PartitionBoundSpec *boundspec = NULL;
+		bool		is_leaf = false;
+		int			position = -1;
 
 		/* Try fetching the tuple from the catcache, for speed. */
 		tuple = SearchSysCache1(RELOID, inhrelid);
 		if (HeapTupleIsValid(tuple))
 		{
-			Datum		datum;
-			bool		isnull;
-
-			datum = SysCacheGetAttr(RELOID, tuple,
-									Anum_pg_class_relpartbound,
-									&isnull);
-			if (!isnull)
-				boundspec = stringToNode(TextDatumGetCString(datum));
+			PartitionBoundCacheEntry *entry;
+			bool		found;
+
+			is_leaf = ((Form_pg_class) GETSTRUCT(tuple))->relkind !=
+				RELKIND_PARTITIONED_TABLE;
+
+			/* Reuse the spec we parsed before, if the tuple is the same. */
+			entry = hash_search(PartitionBoundCacheHash, &inhrelid,
+								HASH_FIND, NULL);
+			if (entry != NULL &&
+				ItemPointerEquals(&entry->tid, &tuple->t_self) &&
+				entry->xmin == HeapTupleHeaderGetRawXmin(tuple->t_data))
+			{
+				boundspec = entry->boundspec;
+				position = entry->position;
+			}
+			else
+			{
+				Datum		datum;
+				bool		isnull;
+
+				datum = SysCacheGetAttr(RELOID, tuple,
+										Anum_pg_class_relpartbound,
+										&isnull);
+				if (!isnull)
+				{
+					oldcxt = MemoryContextSwitchTo(PartitionBoundCacheContext);
+					boundspec = stringToNode(TextDatumGetCString(datum));
+					MemoryContextSwitchTo(oldcxt);
+				}
+
+				if (boundspec != NULL && IsA(boundspec, PartitionBoundSpec))
+				{
+					entry = hash_search(PartitionBoundCacheHash, &inhrelid,
+										HASH_ENTER, &found);
+					if (found)
+						PartitionBoundCacheGarbage++;
+					entry->tid = tuple->t_self;
+					entry->xmin = HeapTupleHeaderGetRawXmin(tuple->t_data);
+					entry->position = -1;
+					entry->boundspec = boundspec;
+				}
+			}
 			ReleaseSysCache(tuple);
 		}
 
@@ -218,6 +306,7 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 			ScanKeyData key[1];
 			Datum		datum;
 			bool		isnull;
+			Form_pg_class classForm;
 
 			pg_class = table_open(RelationRelationId, AccessShareLock);
 			ScanKeyInit(&key[0],
@@ -231,6 +320,8 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 								 RelationGetDescr(pg_class), &isnull);
 			if (!isnull)
 				boundspec = stringToNode(TextDatumGetCString(datum));
+			classForm = (Form_pg_class) GETSTRUCT(tuple);
+			is_leaf = classForm->relkind != RELKIND_PARTITIONED_TABLE;
 			systable_endscan(scan);
 			table_close(pg_class, AccessShareLock);
 		}
@@ -257,12 +348,26 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 		}
 
 		/* Save results. */
-		oids[i] = inhrelid;
-		is_leaf[i] = (get_rel_relkind(inhrelid) != RELKIND_PARTITIONED_TABLE);
-		boundspecs[i] = boundspec;
+		items[i].oid = inhrelid;
+		items[i].is_leaf = is_leaf;
+		items[i].position = position;
+		items[i].boundspec = boundspec;
+		if (i > 0 && partition_build_item_cmp(&items[i - 1], &items[i]) > 0)
+			presorted = false;
 		++i;
 	}
 
+	/*
+	 * Present the partitions in the order of the last descriptor we built,
+	 * with any new ones at the end, so that partition_bounds_create() sorts
+	 * nearly sorted input.
+	 */
+	if (!presorted)
+		qsort(items, nparts, sizeof(PartitionBuildItem),
+			  partition_build_item_cmp);
+	for (i = 0; i < nparts; i++)
+		boundspecs[i] = items[i].boundspec;
+
 	/*
 	 * Create PartitionBoundInfo and mapping, working in the caller's context.
 	 * This could fail, but we haven't done any damage if so.
@@ -310,10 +415,21 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 		{
 			int			index = mapping[i];
 
-			partdesc->oids[index] = oids[i];
-			partdesc->is_leaf[index] = is_leaf[i];
+			partdesc->oids[index] = items[i].oid;
+			partdesc->is_leaf[index] = items[i].is_leaf;
 		}
 		MemoryContextSwitchTo(oldcxt);
+
+		/* Remember the partitions' positions for the next rebuild */
+		for (i = 0; i < nparts; i++)
+		{
+			PartitionBoundCacheEntry *entry;
+
+			entry = hash_search(PartitionBoundCacheHash, &items[i].oid,
+								HASH_FIND, NULL);
+			if (entry != NULL && entry->boundspec == items[i].boundspec)
+				entry->position = mapping[i];
+		}
 	}
 
 	/*
@@ -375,6 +491,122 @@ RelationBuildPartitionDesc(Relation rel, bool omit_detached)
 	return partdesc;
 }
 
+/*
+ * PartitionBoundCacheInit
+ *		Set up the partition bound cache if not done yet, and compact it if
+ *		it holds too much garbage.
+ */
+static void
+PartitionBoundCacheInit(void)
+{
+	if (PartitionBoundCacheHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (!CacheMemoryContext)
+			CreateCacheMemoryContext();
+
+		PartitionBoundCacheContext =
+			AllocSetContextCreate(CacheMemoryContext,
+								  "partition bound cache",
+								  ALLOCSET_DEFAULT_SIZES);
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(PartitionBoundCacheEntry);
+		ctl.hcxt = CacheMemoryContext;
+		PartitionBoundCacheHash = hash_create("partition bound cache", 256,
+											  &ctl,
+											  HASH_ELEM | HASH_BLOBS |
+											  HASH_CONTEXT);
+
+		CacheRegisterRelcacheCallback(PartitionBoundCacheCallback,
+									  (Datum) 0);
+	}
+	else if (PartitionBoundCacheGarbage >
+			 hash_get_num_entries(PartitionBoundCacheHash) + 1024)
+		PartitionBoundCacheCompact();
+}
+
+/*
+ * PartitionBoundCacheCompact
+ *		Copy the live bound specs into a new context.
+ *
+ * Descriptors being built further up the stack may still point into the old
+ * context, so it isn't deleted right away but made to go away with the
+ * current transaction.
+ */
+static void
+PartitionBoundCacheCompact(void)
+{
+	MemoryContext oldbcxt = PartitionBoundCacheContext;
+	MemoryContext newbcxt;
+	MemoryContext oldcxt;
+	HASH_SEQ_STATUS status;
+	PartitionBoundCacheEntry *entry;
+
+	newbcxt = AllocSetContextCreate(CacheMemoryContext,
+									"partition bound cache",
+									ALLOCSET_DEFAULT_SIZES);
+
+	oldcxt = MemoryContextSwitchTo(newbcxt);
+	hash_seq_init(&status, PartitionBoundCacheHash);
+	while ((entry = hash_seq_search(&status)) != NULL)
+		entry->boundspec = copyObject(entry->boundspec);
+	MemoryContextSwitchTo(oldcxt);
+
+	MemoryContextSetParent(oldbcxt, TopTransactionContext);
+	PartitionBoundCacheContext = newbcxt;
+	PartitionBoundCacheGarbage = 0;
+}
+
+/*
+ * PartitionBoundCacheCallback
+ *		Relcache inval callback: forget the bound spec of a partition
+ */
+static void
+PartitionBoundCacheCallback(Datum arg, Oid relid)
+{
+	if (OidIsValid(relid))
+	{
+		if (hash_search(PartitionBoundCacheHash, &relid, HASH_REMOVE,
+						NULL) != NULL)
+			PartitionBoundCacheGarbage++;
+	}
+	else
+	{
+		HASH_SEQ_STATUS status;
+		PartitionBoundCacheEntry *entry;
+
+		hash_seq_init(&status, PartitionBoundCacheHash);
+		while ((entry = hash_seq_search(&status)) != NULL)
+		{
+			hash_search(PartitionBoundCacheHash, &entry->relid, HASH_REMOVE,
+						NULL);
+			PartitionBoundCacheGarbage++;
+		}
+	}
+}
+
+/*
+ * qsort comparator for PartitionBuildItems: by position in the previous
+ * descriptor, with partitions that weren't in it last, in OID order.
+ */
+static int
+partition_build_item_cmp(const void *a, const void *b)
+{
+	const PartitionBuildItem *ia = (const PartitionBuildItem *) a;
+	const PartitionBuildItem *ib = (const PartitionBuildItem *) b;
+	uint32		pa = (uint32) ia->position;
+	uint32		pb = (uint32) ib->position;
+
+	/* -1 becomes the largest value */
+	if (pa != pb)
+		return pa < pb ? -1 : 1;
+	if (ia->oid != ib->oid)
+		return ia->oid < ib->oid ? -1 : 1;
+	return 0;
+}
+
 /*
  * CreatePartitionDirectory
  *		Create a new partition directory object.
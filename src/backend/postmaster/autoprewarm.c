@@ -0,0 +1,663 @@
+/*-------------------------------------------------------------------------
+ *
+ * autoprewarm.c
+ *
+ * Saves the list of blocks held in shared buffers, and loads them back in
+ * after a restart, so that a restarted server doesn't have to warm up its
+ * cache from scratch.
+ *
+ * With autoprewarm enabled, the checkpointer writes the list ("the buffer
+ * map") to AUTOPREWARM_FILE every autoprewarm_interval, and at shutdown.
+ * The entries are sorted by database, tablespace, relation, fork and block,
+ * so that reloading them reads each relation fork in order.
+ *
+ * At startup, the postmaster registers the autoprewarm leader.  It reads the
+ * buffer map into a DSM segment, and then starts one worker per database in
+ * turn, since the relations can only be looked up and locked from within
+ * their database.  Blocks of shared catalogs are loaded by whichever worker
+ * goes first.  Each worker reads its relation forks using read streams, so
+ * that runs of consecutive blocks are loaded with large vectored reads.
+ * Loading stops early once there are no free buffers left, as it would then
+ * only be evicting blocks it loaded itself.
+ *
+ * The checkpointer doesn't overwrite the buffer map while the leader is
+ * still loading it, as it would then lose the blocks not loaded yet.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/autoprewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/relation.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/pg_crc32c.h"
+#include "postmaster/autoprewarm.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/buf_internals.h"
+#include "storage/dsm.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/read_stream.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/rel.h"
+#include "utils/relfilenumbermap.h"
+
+/* GUCs */
+bool		autoprewarm = false;
+int			autoprewarm_interval = 300;
+
+/* One block in the buffer map */
+typedef struct BufferMapEntry
+{
+	Oid			database;
+	Oid			tablespace;
+	RelFileNumber filenumber;
+	ForkNumber	forknum;
+	BlockNumber blocknum;
+} BufferMapEntry;
+
+/* Header of AUTOPREWARM_FILE, followed by nentries BufferMapEntry */
+typedef struct BufferMapHeader
+{
+	uint32		magic;
+	uint32		nentries;
+	pg_crc32c	crc;			/* CRC of the entries */
+} BufferMapHeader;
+
+#define BUFFER_MAP_MAGIC		0x50574D31	/* "PWM1" */
+
+/*
+ * Shared state.  The leader fills in the part describing the blocks for the
+ * next database before starting its worker, and waits for that worker to
+ * exit before reusing it.
+ */
+typedef struct AutoPrewarmShared
+{
+	slock_t		mutex;
+	bool		loading;		/* leader hasn't finished yet */
+
+	dsm_handle	entries_handle;
+	Oid			database;
+	int			first_entry;
+	int			end_entry;		/* one past the last one */
+	int			prewarmed_blocks;
+} AutoPrewarmShared;
+
+/* Private state of a read stream over one relation fork's entries */
+typedef struct AutoPrewarmStreamState
+{
+	BufferMapEntry *entries;
+	int			pos;
+	int			end;
+	BlockNumber nblocks;
+} AutoPrewarmStreamState;
+
+static AutoPrewarmShared *AutoPrewarmState = NULL;
+
+static int	buffer_map_entry_cmp(const void *a, const void *b);
+static BufferMapEntry *read_buffer_map(int *nentries);
+static bool start_database_worker(void);
+static void autoprewarm_leader_exit(int code, Datum arg);
+static BlockNumber autoprewarm_stream_next_block(ReadStream *stream,
+												 void *callback_private_data,
+												 void *per_buffer_data);
+
+/*
+ * Calculate shared memory needed.
+ */
+Size
+AutoPrewarmShmemSize(void)
+{
+	return sizeof(AutoPrewarmShared);
+}
+
+/*
+ * Allocate and initialize shared memory.
+ */
+void
+AutoPrewarmShmemInit(void)
+{
+	bool		found;
+
+	AutoPrewarmState = (AutoPrewarmShared *)
+		ShmemInitStruct("Autoprewarm Data", AutoPrewarmShmemSize(), &found);
+
+	if (!found)
+	{
+		SpinLockInit(&AutoPrewarmState->mutex);
+
+		/*
+		 * If the leader is going to run, consider it to be loading from the
+		 * start, so that the buffer map isn't overwritten before it has read
+		 * it.
+		 */
+		AutoPrewarmState->loading = autoprewarm;
+		AutoPrewarmState->entries_handle = DSM_HANDLE_INVALID;
+		AutoPrewarmState->database = InvalidOid;
+		AutoPrewarmState->first_entry = 0;
+		AutoPrewarmState->end_entry = 0;
+		AutoPrewarmState->prewarmed_blocks = 0;
+	}
+}
+
+/*
+ * Register the autoprewarm leader, if enabled.  Called by the postmaster at
+ * startup.
+ */
+void
+AutoPrewarmRegister(void)
+{
+	BackgroundWorker bgw;
+
+	if (!autoprewarm)
+		return;
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	bgw.bgw_start_time = BgWorkerStart_ConsistentState;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "AutoPrewarmLeaderMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN, "autoprewarm leader");
+	snprintf(bgw.bgw_type, BGW_MAXLEN, "autoprewarm leader");
+	bgw.bgw_restart_time = BGW_NEVER_RESTART;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = (Datum) 0;
+
+	RegisterBackgroundWorker(&bgw);
+}
+
+/*
+ * May the buffer map be written now?  Not while it's still being loaded.
+ */
+bool
+AutoPrewarmDumpAllowed(void)
+{
+	bool		loading;
+
+	if (!autoprewarm)
+		return false;
+
+	SpinLockAcquire(&AutoPrewarmState->mutex);
+	loading = AutoPrewarmState->loading;
+	SpinLockRelease(&AutoPrewarmState->mutex);
+
+	return !loading;
+}
+
+/*
+ * Write the list of blocks currently in shared buffers to AUTOPREWARM_FILE.
+ *
+ * This is called by the checkpointer, including after the shutdown
+ * checkpoint, so it never throws an error; the buffer map is only an
+ * optimization.  Only valid buffers of permanent relations are included, as
+ * others wouldn't survive a restart anyway.
+ */
+void
+AutoPrewarmDumpBufferMap(void)
+{
+	BufferMapEntry *entries;
+	BufferMapHeader hdr;
+	int			nentries = 0;
+	char		transient_path[MAXPGPATH];
+	int			fd;
+
+	entries = palloc_extended(sizeof(BufferMapEntry) * NBuffers,
+							  MCXT_ALLOC_HUGE | MCXT_ALLOC_NO_OOM);
+	if (entries == NULL)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory while saving buffer map")));
+		return;
+	}
+
+	for (int i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state;
+
+		/* Lock each buffer header before inspecting. */
+		buf_state = LockBufHdr(bufHdr);
+
+		if ((buf_state & BM_TAG_VALID) &&
+			(buf_state & BM_VALID) &&
+			(buf_state & BM_PERMANENT))
+		{
+			entries[nentries].database = bufHdr->tag.dbOid;
+			entries[nentries].tablespace = bufHdr->tag.spcOid;
+			entries[nentries].filenumber = BufTagGetRelNumber(&bufHdr->tag);
+			entries[nentries].forknum = BufTagGetForkNum(&bufHdr->tag);
+			entries[nentries].blocknum = bufHdr->tag.blockNum;
+			nentries++;
+		}
+
+		UnlockBufHdr(bufHdr, buf_state);
+	}
+
+	qsort(entries, nentries, sizeof(BufferMapEntry), buffer_map_entry_cmp);
+
+	hdr.magic = BUFFER_MAP_MAGIC;
+	hdr.nentries = nentries;
+	INIT_CRC32C(hdr.crc);
+	COMP_CRC32C(hdr.crc, entries, sizeof(BufferMapEntry) * nentries);
+	FIN_CRC32C(hdr.crc);
+
+	/* Write to a temporary file first, so a crash can't leave it torn. */
+	snprintf(transient_path, MAXPGPATH, "%s.tmp", AUTOPREWARM_FILE);
+	fd = OpenTransientFile(transient_path, O_CREAT | O_WRONLY | O_TRUNC | PG_BINARY);
+	if (fd < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", transient_path)));
+		pfree(entries);
+		return;
+	}
+
+	errno = 0;
+	pgstat_report_wait_start(WAIT_EVENT_AUTOPREWARM_DUMP_WRITE);
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		write(fd, entries, sizeof(BufferMapEntry) * nentries) !=
+		sizeof(BufferMapEntry) * nentries)
+	{
+		pgstat_report_wait_end();
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", transient_path)));
+		CloseTransientFile(fd);
+		unlink(transient_path);
+		pfree(entries);
+		return;
+	}
+	pgstat_report_wait_end();
+
+	pfree(entries);
+
+	if (CloseTransientFile(fd) != 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", transient_path)));
+		unlink(transient_path);
+		return;
+	}
+
+	if (durable_rename(transient_path, AUTOPREWARM_FILE, LOG) != 0)
+		return;
+
+	elog(DEBUG1, "saved %d blocks to buffer map", nentries);
+}
+
+/*
+ * Main entry point of the autoprewarm leader.
+ */
+void
+AutoPrewarmLeaderMain(Datum main_arg)
+{
+	BufferMapEntry *entries;
+	int			nentries;
+	int			pos;
+	int			prewarmed = 0;
+	dsm_segment *seg;
+
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	/* Whatever happens, let the checkpointer write the buffer map again. */
+	on_shmem_exit(autoprewarm_leader_exit, (Datum) 0);
+
+	entries = read_buffer_map(&nentries);
+	if (entries == NULL || nentries == 0)
+		proc_exit(0);
+
+	seg = dsm_create(sizeof(BufferMapEntry) * nentries, 0);
+	memcpy(dsm_segment_address(seg), entries,
+		   sizeof(BufferMapEntry) * nentries);
+	pfree(entries);
+	entries = dsm_segment_address(seg);
+
+	/*
+	 * Start a worker for each database in turn.  Entries with an invalid
+	 * database are for shared catalogs; they sort first and are loaded
+	 * together with the first database's.
+	 */
+	pos = 0;
+	while (pos < nentries && !ShutdownRequestPending)
+	{
+		int			end = pos;
+		Oid			database;
+
+		if (!have_free_buffer())
+			break;
+
+		while (end < nentries && entries[end].database == InvalidOid)
+			end++;
+
+		/*
+		 * Without any database to connect to, we couldn't look up the shared
+		 * catalogs either.  That only happens if there's nothing else in the
+		 * map, so don't bother.
+		 */
+		if (end == nentries)
+			break;
+
+		database = entries[end].database;
+		while (end < nentries && entries[end].database == database)
+			end++;
+
+		SpinLockAcquire(&AutoPrewarmState->mutex);
+		AutoPrewarmState->entries_handle = dsm_segment_handle(seg);
+		AutoPrewarmState->database = database;
+		AutoPrewarmState->first_entry = pos;
+		AutoPrewarmState->end_entry = end;
+		AutoPrewarmState->prewarmed_blocks = 0;
+		SpinLockRelease(&AutoPrewarmState->mutex);
+
+		if (!start_database_worker())
+			break;
+
+		SpinLockAcquire(&AutoPrewarmState->mutex);
+		prewarmed += AutoPrewarmState->prewarmed_blocks;
+		SpinLockRelease(&AutoPrewarmState->mutex);
+
+		pos = end;
+	}
+
+	dsm_detach(seg);
+
+	ereport(LOG,
+			(errmsg("autoprewarm loaded %d of %d previously-loaded blocks",
+					prewarmed, nentries)));
+
+	proc_exit(0);
+}
+
+/*
+ * Main entry point of a per-database autoprewarm worker.
+ */
+void
+AutoPrewarmDatabaseMain(Datum main_arg)
+{
+	dsm_handle	handle;
+	dsm_segment *seg;
+	BufferMapEntry *entries;
+	Oid			database;
+	int			pos;
+	int			end;
+	int			prewarmed = 0;
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	SpinLockAcquire(&AutoPrewarmState->mutex);
+	handle = AutoPrewarmState->entries_handle;
+	database = AutoPrewarmState->database;
+	pos = AutoPrewarmState->first_entry;
+	end = AutoPrewarmState->end_entry;
+	SpinLockRelease(&AutoPrewarmState->mutex);
+
+	seg = dsm_attach(handle);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	entries = dsm_segment_address(seg);
+
+	BackgroundWorkerInitializeConnectionByOid(database, InvalidOid, 0);
+
+	while (pos < end && have_free_buffer())
+	{
+		BufferMapEntry *first = &entries[pos];
+		int			rel_end = pos;
+		Oid			reloid;
+		Relation	rel = NULL;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Find all the entries for this relation. */
+		while (rel_end < end &&
+			   entries[rel_end].database == first->database &&
+			   entries[rel_end].tablespace == first->tablespace &&
+			   entries[rel_end].filenumber == first->filenumber)
+			rel_end++;
+
+		StartTransactionCommand();
+
+		/*
+		 * The relation may have been dropped or rewritten since the buffer
+		 * map was written, in which case it's skipped.
+		 */
+		reloid = RelidByRelfilenumber(first->tablespace, first->filenumber);
+		if (OidIsValid(reloid))
+			rel = try_relation_open(reloid, AccessShareLock);
+
+		if (rel != NULL && RELKIND_HAS_STORAGE(rel->rd_rel->relkind))
+		{
+			while (pos < rel_end)
+			{
+				ForkNumber	forknum = entries[pos].forknum;
+				int			fork_end = pos;
+
+				while (fork_end < rel_end && entries[fork_end].forknum == forknum)
+					fork_end++;
+
+				if (forknum <= MAX_FORKNUM &&
+					smgrexists(RelationGetSmgr(rel), forknum))
+				{
+					AutoPrewarmStreamState state;
+					ReadStream *stream;
+					Buffer		buf;
+
+					state.entries = entries;
+					state.pos = pos;
+					state.end = fork_end;
+					state.nblocks = RelationGetNumberOfBlocksInFork(rel, forknum);
+
+					stream = read_stream_begin_relation(READ_STREAM_FULL |
+														READ_STREAM_MAINTENANCE,
+														NULL,
+														rel,
+														forknum,
+														autoprewarm_stream_next_block,
+														&state,
+														0);
+					while ((buf = read_stream_next_buffer(stream, NULL)) != InvalidBuffer)
+					{
+						ReleaseBuffer(buf);
+						prewarmed++;
+					}
+					read_stream_end(stream);
+				}
+
+				pos = fork_end;
+			}
+		}
+
+		if (rel != NULL)
+			relation_close(rel, AccessShareLock);
+
+		CommitTransactionCommand();
+
+		pos = rel_end;
+	}
+
+	SpinLockAcquire(&AutoPrewarmState->mutex);
+	AutoPrewarmState->prewarmed_blocks = prewarmed;
+	SpinLockRelease(&AutoPrewarmState->mutex);
+
+	dsm_detach(seg);
+}
+
+/*
+ * Read stream callback, returning the next block of the fork that still
+ * exists, as long as there are free buffers to load it into.
+ */
+static BlockNumber
+autoprewarm_stream_next_block(ReadStream *stream,
+							  void *callback_private_data,
+							  void *per_buffer_data)
+{
+	AutoPrewarmStreamState *state = callback_private_data;
+
+	while (state->pos < state->end && have_free_buffer())
+	{
+		BlockNumber blocknum = state->entries[state->pos++].blocknum;
+
+		if (blocknum < state->nblocks)
+			return blocknum;
+	}
+
+	return InvalidBlockNumber;
+}
+
+/*
+ * Start the worker for the database described in shared memory, and wait
+ * for it to finish.  Returns false if it couldn't be started.
+ */
+static bool
+start_database_worker(void)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "AutoPrewarmDatabaseMain");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "autoprewarm worker");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "autoprewarm worker");
+	worker.bgw_notify_pid = MyProcPid;
+
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not register background worker for autoprewarm"),
+				 errhint("You may need to increase max_worker_processes.")));
+		return false;
+	}
+
+	/* Ignore the result; if the worker failed, we just move on. */
+	(void) WaitForBackgroundWorkerShutdown(handle);
+
+	return true;
+}
+
+/*
+ * Read and check AUTOPREWARM_FILE.  Returns NULL if there's none, or it's
+ * not usable.
+ */
+static BufferMapEntry *
+read_buffer_map(int *nentries)
+{
+	BufferMapHeader hdr;
+	BufferMapEntry *entries;
+	pg_crc32c	crc;
+	int			fd;
+	Size		len;
+
+	fd = OpenTransientFile(AUTOPREWARM_FILE, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		if (errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", AUTOPREWARM_FILE)));
+		return NULL;
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_AUTOPREWARM_DUMP_READ);
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		hdr.magic != BUFFER_MAP_MAGIC)
+	{
+		pgstat_report_wait_end();
+		ereport(LOG,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("invalid buffer map file \"%s\"", AUTOPREWARM_FILE)));
+		CloseTransientFile(fd);
+		return NULL;
+	}
+
+	len = sizeof(BufferMapEntry) * (Size) hdr.nentries;
+	entries = palloc_extended(Max(len, 1), MCXT_ALLOC_HUGE);
+	if (read(fd, entries, len) != len)
+	{
+		pgstat_report_wait_end();
+		ereport(LOG,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("could not read buffer map file \"%s\"", AUTOPREWARM_FILE)));
+		CloseTransientFile(fd);
+		pfree(entries);
+		return NULL;
+	}
+	pgstat_report_wait_end();
+	CloseTransientFile(fd);
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, entries, len);
+	FIN_CRC32C(crc);
+	if (!EQ_CRC32C(crc, hdr.crc))
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("incorrect checksum in buffer map file \"%s\"",
+						AUTOPREWARM_FILE)));
+		pfree(entries);
+		return NULL;
+	}
+
+	*nentries = hdr.nentries;
+	return entries;
+}
+
+/*
+ * on_shmem_exit callback of the leader.
+ */
+static void
+autoprewarm_leader_exit(int code, Datum arg)
+{
+	SpinLockAcquire(&AutoPrewarmState->mutex);
+	AutoPrewarmState->loading = false;
+	SpinLockRelease(&AutoPrewarmState->mutex);
+}
+
+/*
+ * qsort comparator for buffer map entries.
+ */
+static int
+buffer_map_entry_cmp(const void *a, const void *b)
+{
+	const BufferMapEntry *ea = (const BufferMapEntry *) a;
+	const BufferMapEntry *eb = (const BufferMapEntry *) b;
+
+	if (ea->database != eb->database)
+		return ea->database < eb->database ? -1 : 1;
+	if (ea->tablespace != eb->tablespace)
+		return ea->tablespace < eb->tablespace ? -1 : 1;
+	if (ea->filenumber != eb->filenumber)
+		return ea->filenumber < eb->filenumber ? -1 : 1;
+	if (ea->forknum != eb->forknum)
+		return ea->forknum < eb->forknum ? -1 : 1;
+	if (ea->blocknum != eb->blocknum)
+		return ea->blocknum < eb->blocknum ? -1 : 1;
+	return 0;
+}
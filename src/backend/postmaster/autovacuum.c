@@ -78,6 +78,7 @@
 #include "catalog/pg_database.h"
 #include "commands/dbcommands.h"
 #include "commands/vacuum.h"
+#include "funcapi.h"
 #include "lib/ilist.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
@@ -97,6 +98,7 @@
 #include "storage/sinvaladt.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
+#include "utils/backend_memory.h"
 #include "utils/fmgroids.h"
 #include "utils/fmgrprotos.h"
 #include "utils/guc_hooks.h"
@@ -210,6 +212,16 @@ typedef struct autovac_table
 	char	   *at_datname;
 } autovac_table;
 
+/* a table found to need vacuum or analyze, with how urgently */
+typedef struct av_candidate
+{
+	Oid			relid;
+	bool		dovacuum;
+	bool		doanalyze;
+	bool		wraparound;
+	double		priority;		/* see relation_needs_vacanalyze */
+} av_candidate;
+
 /*-------------
  * This struct holds information about a single worker's whereabouts.  We keep
  * an array of these in shared memory, sized according to
@@ -333,6 +345,17 @@ static void rebuild_database_list(Oid newdb);
 static int	db_comparator(const void *a, const void *b);
 static void autovac_recalculate_workers_for_balance(void);
 
+static int	collect_autovac_candidates(Relation classRel,
+									   TupleDesc pg_class_desc,
+									   HTAB *table_toast_map,
+									   int effective_multixact_freeze_max_age,
+									   List **orphan_oids,
+									   av_candidate **candidates);
+static void add_autovac_candidate(av_candidate **cands, int *ncands,
+								  int *maxcands, Oid relid, bool dovacuum,
+								  bool doanalyze, bool wraparound,
+								  double priority);
+static int	av_candidate_comparator(const void *a, const void *b);
 static void do_autovacuum(void);
 static void FreeWorkerInfo(int code, Datum arg);
 
@@ -347,7 +370,8 @@ static void relation_needs_vacanalyze(Oid relid, AutoVacOpts *relopts,
 									  Form_pg_class classForm,
 									  PgStat_StatTabEntry *tabentry,
 									  int effective_multixact_freeze_max_age,
-									  bool *dovacuum, bool *doanalyze, bool *wraparound);
+									  bool *dovacuum, bool *doanalyze, bool *wraparound,
+									  double *priority);
 
 static void autovacuum_do_vac_analyze(autovac_table *tab,
 									  BufferAccessStrategy bstrategy);
@@ -842,6 +866,10 @@ HandleAutoVacLauncherInterrupts(void)
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
 
+	/* Publish our largest memory contexts if asked to */
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
+
 	/* Process sinval catchup interrupts that happened while sleeping */
 	ProcessCatchupInterrupt();
 }
@@ -2017,94 +2045,28 @@ get_database_list(void)
 }
 
 /*
- * Process a database table-by-table
+ * collect_autovac_candidates
+ *		Find the tables of the current database that need vacuum or analyze
  *
- * Note that CHECK_FOR_INTERRUPTS is supposed to be used in certain spots in
- * order not to ignore shutdown commands for too long.
+ * Returns the number of them, and a palloc'd array of them into *candidates,
+ * most urgent first; see av_candidate_comparator.  The TOAST to main relid
+ * mapping is entered into table_toast_map.  If orphan_oids isn't NULL,
+ * orphaned temp tables are appended to it.
  */
-static void
-do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张表
+static int
+collect_autovac_candidates(Relation classRel, TupleDesc pg_class_desc,
+						   HTAB *table_toast_map,
+						   int effective_multixact_freeze_max_age,
+						   List **orphan_oids, av_candidate **candidates)
 {
-	Relation	classRel;
 	HeapTuple	tuple;
 	TableScanDesc relScan;
-	Form_pg_database dbForm;
-	List	   *table_oids = NIL;
-	List	   *orphan_oids = NIL;
-	HASHCTL		ctl;
-	HTAB	   *table_toast_map;
-	ListCell   *volatile cell;
-	BufferAccessStrategy bstrategy;
 	ScanKeyData key;
-	TupleDesc	pg_class_desc;
-	int			effective_multixact_freeze_max_age;
-	bool		did_vacuum = false;
-	bool		found_concurrent_worker = false;
-	int			i;
+	av_candidate *cands;
+	int			ncands = 0;
+	int			maxcands = 64;
 
-	/*
-	 * StartTransactionCommand and CommitTransactionCommand will automatically
-	 * switch to other contexts.  We need this one to keep the list of
-	 * relations to vacuum/analyze across transactions.
-	 */
-	AutovacMemCxt = AllocSetContextCreate(TopMemoryContext,
-										  "Autovacuum worker",
-										  ALLOCSET_DEFAULT_SIZES); // 创建一个专有的内存池
-	MemoryContextSwitchTo(AutovacMemCxt);
-
-	/* Start a transaction so our commands have one to play into. */
-	StartTransactionCommand();
-
-	/*
-	 * Compute the multixact age for which freezing is urgent.  This is
-	 * normally autovacuum_multixact_freeze_max_age, but may be less if we are
-	 * short of multixact member space.
-	 */
-	effective_multixact_freeze_max_age = MultiXactMemberFreezeThreshold();
-
-	/*
-	 * Find the pg_database entry and select the default freeze ages. We use
-	 * zero in template and nonconnectable databases, else the system-wide
-	 * default.
-	 */
-	tuple = SearchSysCache1(DATABASEOID, ObjectIdGetDatum(MyDatabaseId));
-	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for database %u", MyDatabaseId);
-	dbForm = (Form_pg_database) GETSTRUCT(tuple);
-
-	if (dbForm->datistemplate || !dbForm->datallowconn) /// 这个数据库是模板数据库，或者不允许连接
-	{
-		default_freeze_min_age = 0;
-		default_freeze_table_age = 0;
-		default_multixact_freeze_min_age = 0;
-		default_multixact_freeze_table_age = 0;
-	}
-	else
-	{
-		default_freeze_min_age = vacuum_freeze_min_age;
-		default_freeze_table_age = vacuum_freeze_table_age;
-		default_multixact_freeze_min_age = vacuum_multixact_freeze_min_age;
-		default_multixact_freeze_table_age = vacuum_multixact_freeze_table_age;
-	}
-
-	ReleaseSysCache(tuple);
-
-	/* StartTransactionCommand changed elsewhere */
-	MemoryContextSwitchTo(AutovacMemCxt);
-
-	classRel = table_open(RelationRelationId, AccessShareLock);
-
-	/* create a copy so we can use it after closing pg_class */
-	pg_class_desc = CreateTupleDescCopy(RelationGetDescr(classRel));
-
-	/* create hash table for toast <-> main relid mapping */
-	ctl.keysize = sizeof(Oid);
-	ctl.entrysize = sizeof(av_relation);
-
-	table_toast_map = hash_create("TOAST to main relid map",
-								  100,
-								  &ctl,
-								  HASH_ELEM | HASH_BLOBS); // 创建一个本地哈希表
+	cands = palloc(maxcands * sizeof(av_candidate));
 
 	/*
 	 * Scan pg_class to determine which tables to vacuum.
@@ -2135,6 +2097,7 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
+		double		priority;
 
 		if (classForm->relkind != RELKIND_RELATION &&
 			classForm->relkind != RELKIND_MATVIEW) /// 只查找堆表和MV
@@ -2153,7 +2116,8 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 			 * using the temporary schema.  Also, for safety, ignore it if the
 			 * namespace doesn't exist or isn't a temp namespace after all.
 			 */
-			if (checkTempNamespaceStatus(classForm->relnamespace) == TEMP_NAMESPACE_IDLE)
+			if (orphan_oids != NULL &&
+				checkTempNamespaceStatus(classForm->relnamespace) == TEMP_NAMESPACE_IDLE)
 			{
 				/*
 				 * The table seems to be orphaned -- although it might be that
@@ -2162,7 +2126,7 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 				 * anymore, so we could be looking at a committed-dead entry.
 				 * Remember it so we can try to delete it later.
 				 */
-				orphan_oids = lappend_oid(orphan_oids, relid);
+				*orphan_oids = lappend_oid(*orphan_oids, relid);
 			}
 			continue;
 		}
@@ -2175,11 +2139,13 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 		/* Check if it needs vacuum or analyze */
 		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
 								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
 
-		/* Relations that need work are added to table_oids */
+		/* Relations that need work are added to the candidates */
 		if (dovacuum || doanalyze)
-			table_oids = lappend_oid(table_oids, relid);
+			add_autovac_candidate(&cands, &ncands, &maxcands, relid,
+								  dovacuum, doanalyze, wraparound, priority);
 
 		/*
 		 * Remember TOAST associations for the second pass.  Note: we must do
@@ -2228,6 +2194,7 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
+		double		priority;
 
 		/*
 		 * We cannot safely process other backends' temp tables, so skip 'em.
@@ -2258,14 +2225,169 @@ do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张
 
 		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
 								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
 
 		/* ignore analyze for toast tables */
 		if (dovacuum)
-			table_oids = lappend_oid(table_oids, relid);
+			add_autovac_candidate(&cands, &ncands, &maxcands, relid,
+								  dovacuum, false, wraparound, priority);
 	}
 
 	table_endscan(relScan);
+
+	qsort(cands, ncands, sizeof(av_candidate), av_candidate_comparator);
+
+	*candidates = cands;
+	return ncands;
+}
+
+/*
+ * add_autovac_candidate
+ *		Append a table to the array built by collect_autovac_candidates
+ */
+static void
+add_autovac_candidate(av_candidate **cands, int *ncands, int *maxcands,
+					  Oid relid, bool dovacuum, bool doanalyze,
+					  bool wraparound, double priority)
+{
+	av_candidate *cand;
+
+	if (*ncands >= *maxcands)
+	{
+		*maxcands *= 2;
+		*cands = repalloc(*cands, *maxcands * sizeof(av_candidate));
+	}
+
+	cand = &(*cands)[(*ncands)++];
+	cand->relid = relid;
+	cand->dovacuum = dovacuum;
+	cand->doanalyze = doanalyze;
+	cand->wraparound = wraparound;
+	cand->priority = priority;
+}
+
+/*
+ * qsort comparator for av_candidate: tables at risk of wraparound first,
+ * then by decreasing priority.  Ties go by OID, just to be deterministic.
+ */
+static int
+av_candidate_comparator(const void *a, const void *b)
+{
+	const av_candidate *ca = (const av_candidate *) a;
+	const av_candidate *cb = (const av_candidate *) b;
+
+	if (ca->wraparound != cb->wraparound)
+		return ca->wraparound ? -1 : 1;
+	if (ca->priority != cb->priority)
+		return ca->priority > cb->priority ? -1 : 1;
+	if (ca->relid != cb->relid)
+		return ca->relid < cb->relid ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Process a database table-by-table
+ *
+ * Note that CHECK_FOR_INTERRUPTS is supposed to be used in certain spots in
+ * order not to ignore shutdown commands for too long.
+ */
+static void
+do_autovacuum(void) /// 在一个数据库上做vacuum，一张表接着一张表
+{
+	Relation	classRel;
+	HeapTuple	tuple;
+	Form_pg_database dbForm;
+	av_candidate *candidates;
+	int			ncandidates;
+	List	   *table_oids = NIL;
+	List	   *orphan_oids = NIL;
+	HASHCTL		ctl;
+	HTAB	   *table_toast_map;
+	ListCell   *volatile cell;
+	BufferAccessStrategy bstrategy;
+	TupleDesc	pg_class_desc;
+	int			effective_multixact_freeze_max_age;
+	bool		did_vacuum = false;
+	bool		found_concurrent_worker = false;
+	int			i;
+
+	/*
+	 * StartTransactionCommand and CommitTransactionCommand will automatically
+	 * switch to other contexts.  We need this one to keep the list of
+	 * relations to vacuum/analyze across transactions.
+	 */
+	AutovacMemCxt = AllocSetContextCreate(TopMemoryContext,
+										  "Autovacuum worker",
+										  ALLOCSET_DEFAULT_SIZES); // 创建一个专有的内存池
+	MemoryContextSwitchTo(AutovacMemCxt);
+
+	/* Start a transaction so our commands have one to play into. */
+	StartTransactionCommand();
+
+	/*
+	 * Compute the multixact age for which freezing is urgent.  This is
+	 * normally autovacuum_multixact_freeze_max_age, but may be less if we are
+	 * short of multixact member space.
+	 */
+	effective_multixact_freeze_max_age = MultiXactMemberFreezeThreshold();
+
+	/*
+	 * Find the pg_database entry and select the default freeze ages. We use
+	 * zero in template and nonconnectable databases, else the system-wide
+	 * default.
+	 */
+	tuple = SearchSysCache1(DATABASEOID, ObjectIdGetDatum(MyDatabaseId));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for database %u", MyDatabaseId);
+	dbForm = (Form_pg_database) GETSTRUCT(tuple);
+
+	if (dbForm->datistemplate || !dbForm->datallowconn) /// 这个数据库是模板数据库，或者不允许连接
+	{
+		default_freeze_min_age = 0;
+		default_freeze_table_age = 0;
+		default_multixact_freeze_min_age = 0;
+		default_multixact_freeze_table_age = 0;
+	}
+	else
+	{
+		default_freeze_min_age = vacuum_freeze_min_age;
+		default_freeze_table_age = vacuum_freeze_table_age;
+		default_multixact_freeze_min_age = vacuum_multixact_freeze_min_age;
+		default_multixact_freeze_table_age = vacuum_multixact_freeze_table_age;
+	}
+
+	ReleaseSysCache(tuple);
+
+	/* StartTransactionCommand changed elsewhere */
+	MemoryContextSwitchTo(AutovacMemCxt);
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+
+	/* create a copy so we can use it after closing pg_class */
+	pg_class_desc = CreateTupleDescCopy(RelationGetDescr(classRel));
+
+	/* create hash table for toast <-> main relid mapping */
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(av_relation);
+
+	table_toast_map = hash_create("TOAST to main relid map",
+								  100,
+								  &ctl,
+								  HASH_ELEM | HASH_BLOBS); // 创建一个本地哈希表
+
+	/*
+	 * Find the tables that need work, most urgent first, so that a backlog
+	 * of small tables doesn't hold up one close to wraparound or badly
+	 * bloated.
+	 */
+	ncandidates = collect_autovac_candidates(classRel, pg_class_desc,
+											 table_toast_map,
+											 effective_multixact_freeze_max_age,
+											 &orphan_oids, &candidates);
+	for (i = 0; i < ncandidates; i++)
+		table_oids = lappend_oid(table_oids, candidates[i].relid);
+	pfree(candidates);
 	table_close(classRel, AccessShareLock);
 
 	/*
@@ -2743,6 +2865,10 @@ perform_work_item(AutoVacuumWorkItem *workitem)
 									ObjectIdGetDatum(workitem->avw_relation),
 									Int64GetDatum((int64) workitem->avw_blockNumber));
 				break;
+			case AVW_GINCleanPendingList:
+				DirectFunctionCall1(gin_clean_pending_list,
+									ObjectIdGetDatum(workitem->avw_relation));
+				break;
 			default:
 				elog(WARNING, "unrecognized work item found: type %d",
 					 workitem->avw_type);
@@ -2937,8 +3063,12 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 		 */
 		tab->at_params.index_cleanup = VACOPTVALUE_UNSPECIFIED;
 		tab->at_params.truncate = VACOPTVALUE_UNSPECIFIED;
-		/* As of now, we don't support parallel vacuum for autovacuum */
-		tab->at_params.nworkers = -1;
+		/*
+		 * Parallel vacuum is only used for tables that ask for it, with the
+		 * autovacuum_parallel_workers reloption as their worker budget.
+		 */
+		tab->at_params.nworkers = (avopts && avopts->parallel_workers > 0) ?
+			avopts->parallel_workers : -1;
 		tab->at_params.freeze_min_age = freeze_min_age;
 		tab->at_params.freeze_table_age = freeze_table_age;
 		tab->at_params.multixact_freeze_min_age = multixact_freeze_min_age;
@@ -2991,7 +3121,7 @@ recheck_relation_needs_vacanalyze(Oid relid,
 
 	relation_needs_vacanalyze(relid, avopts, classForm, tabentry,
 							  effective_multixact_freeze_max_age,
-							  dovacuum, doanalyze, wraparound);
+							  dovacuum, doanalyze, wraparound, NULL);
 
 	/* ignore ANALYZE for toast tables */
 	if (classForm->relkind == RELKIND_TOASTVALUE)
@@ -3034,6 +3164,11 @@ recheck_relation_needs_vacanalyze(Oid relid,
  * autovacuum_vacuum_threshold GUC variable.  Similarly, a vac_scale_factor
  * value < 0 is substituted with the value of
  * autovacuum_vacuum_scale_factor GUC variable.  Ditto for analyze.
+ *
+ * If priority isn't NULL, it receives how urgent the work is: the largest of
+ * the ratios of dead tuples, inserted tuples and modified tuples to their
+ * thresholds, and of the table's XID and multixact ages to the ages at which
+ * vacuum is forced.  So anything above 1 is due.
  */
 static void
 relation_needs_vacanalyze(Oid relid,
@@ -3044,7 +3179,8 @@ relation_needs_vacanalyze(Oid relid,
  /* output params below */
 						  bool *dovacuum,
 						  bool *doanalyze,
-						  bool *wraparound)
+						  bool *wraparound,
+						  double *priority)
 {
 	bool		force_vacuum;
 	bool		av_enabled;
@@ -3136,6 +3272,20 @@ relation_needs_vacanalyze(Oid relid,
 	}
 	*wraparound = force_vacuum;
 
+	if (priority)
+	{
+		*priority = 0;
+		if (TransactionIdIsNormal(classForm->relfrozenxid) && freeze_max_age > 0)
+			*priority = Max(*priority,
+							(double) (int32) (recentXid - classForm->relfrozenxid) /
+							freeze_max_age);
+		if (MultiXactIdIsValid(classForm->relminmxid) &&
+			multixact_freeze_max_age > 0)
+			*priority = Max(*priority,
+							(double) (int32) (recentMulti - classForm->relminmxid) /
+							multixact_freeze_max_age);
+	}
+
 	/* User disabled it in pg_class.reloptions?  (But ignore if at risk) */
 	if (!av_enabled && !force_vacuum)
 	{
@@ -3184,6 +3334,15 @@ relation_needs_vacanalyze(Oid relid,
 		*dovacuum = force_vacuum || (vactuples > vacthresh) ||
 			(vac_ins_base_thresh >= 0 && instuples > vacinsthresh);
 		*doanalyze = (anltuples > anlthresh);
+
+		if (priority)
+		{
+			*priority = Max(*priority, vactuples / Max(vacthresh, 1));
+			if (vac_ins_base_thresh >= 0)
+				*priority = Max(*priority, instuples / Max(vacinsthresh, 1));
+			if (relid != StatisticRelationId)
+				*priority = Max(*priority, anltuples / Max(anlthresh, 1));
+		}
 	}
 	else
 	{
@@ -3293,6 +3452,10 @@ autovac_report_workitem(AutoVacuumWorkItem *workitem,
 			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
 					 "autovacuum: BRIN summarize");
 			break;
+		case AVW_GINCleanPendingList:
+			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
+					 "autovacuum: GIN clean pending list");
+			break;
 	}
 
 	/*
@@ -3329,37 +3492,54 @@ AutoVacuumingActive(void) // 这由两个参数控制
 
 /*
  * Request one work item to the next autovacuum run processing our database.
- * Return false if the request can't be recorded.
+ * Return false if the request can't be recorded.  An identical request that
+ * is still waiting to be processed counts as recorded.
  */
 bool
 AutoVacuumRequestWork(AutoVacuumWorkItemType type, Oid relationId,
 					  BlockNumber blkno)
 {
+	AutoVacuumWorkItem *freeitem = NULL;
 	int			i;
 	bool		result = false;
 
 	LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
 
 	/*
-	 * Locate an unused work item and fill it with the given data.
+	 * Locate an unused work item, and check for a duplicate of this one.
 	 */
 	for (i = 0; i < NUM_WORKITEMS; i++)
 	{
 		AutoVacuumWorkItem *workitem = &AutoVacuumShmem->av_workItems[i];
 
-		if (workitem->avw_used)
+		if (!workitem->avw_used)
+		{
+			if (freeitem == NULL)
+				freeitem = workitem;
 			continue;
+		}
 
-		workitem->avw_used = true;
-		workitem->avw_active = false;
-		workitem->avw_type = type;
-		workitem->avw_database = MyDatabaseId;
-		workitem->avw_relation = relationId;
-		workitem->avw_blockNumber = blkno;
-		result = true;
+		if (!workitem->avw_active &&
+			workitem->avw_type == type &&
+			workitem->avw_database == MyDatabaseId &&
+			workitem->avw_relation == relationId &&
+			workitem->avw_blockNumber == blkno)
+		{
+			result = true;
+			break;
+		}
+	}
 
-		/* done */
-		break;
+	/* Fill the unused work item with the given data */
+	if (!result && freeitem != NULL)
+	{
+		freeitem->avw_used = true;
+		freeitem->avw_active = false;
+		freeitem->avw_type = type;
+		freeitem->avw_database = MyDatabaseId;
+		freeitem->avw_relation = relationId;
+		freeitem->avw_blockNumber = blkno;
+		result = true;
 	}
 
 	LWLockRelease(AutovacuumLock);
@@ -3490,3 +3670,62 @@ check_autovacuum_work_mem(int *newval, void **extra, GucSource source)
 
 	return true;
 }
+
+/*
+ * SQL function returning the tables of the current database that need
+ * vacuum or analyze now, in the order an autovacuum worker would process
+ * them.
+ */
+Datum
+pg_stat_get_autovacuum_queue(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_AUTOVACUUM_QUEUE_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Relation	classRel;
+	HASHCTL		ctl;
+	HTAB	   *table_toast_map;
+	av_candidate *candidates;
+	int			ncandidates;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	/* ages are measured as a worker starting now would, cf. do_start_worker */
+	recentXid = ReadNextTransactionId();
+	recentMulti = ReadNextMultiXactId();
+
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(av_relation);
+	ctl.hcxt = CurrentMemoryContext;
+	table_toast_map = hash_create("TOAST to main relid map",
+								  100,
+								  &ctl,
+								  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	ncandidates = collect_autovac_candidates(classRel,
+											 RelationGetDescr(classRel),
+											 table_toast_map,
+											 MultiXactMemberFreezeThreshold(),
+											 NULL, &candidates);
+	table_close(classRel, AccessShareLock);
+
+	for (int i = 0; i < ncandidates; i++)
+	{
+		Datum		values[PG_STAT_GET_AUTOVACUUM_QUEUE_COLS] = {0};
+		bool		nulls[PG_STAT_GET_AUTOVACUUM_QUEUE_COLS] = {0};
+
+		values[0] = ObjectIdGetDatum(candidates[i].relid);
+		values[1] = BoolGetDatum(candidates[i].dovacuum);
+		values[2] = BoolGetDatum(candidates[i].doanalyze);
+		values[3] = BoolGetDatum(candidates[i].wraparound);
+		values[4] = Float8GetDatum(candidates[i].priority);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	pfree(candidates);
+	hash_destroy(table_toast_map);
+
+	return (Datum) 0;
+}
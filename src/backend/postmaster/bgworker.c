@@ -13,13 +13,16 @@
 #include "postgres.h"
 
 #include "access/parallel.h"
+#include "access/xlogparallel.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "postmaster/autoprewarm.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/interrupt.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/sessionkeeper.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalworker.h"
 #include "storage/dsm.h"
@@ -131,6 +134,18 @@ static const struct
 	},
 	{
 		"ParallelApplyWorkerMain", ParallelApplyWorkerMain
+	},
+	{
+		"AutoPrewarmLeaderMain", AutoPrewarmLeaderMain
+	},
+	{
+		"AutoPrewarmDatabaseMain", AutoPrewarmDatabaseMain
+	},
+	{
+		"ParallelRedoWorkerMain", ParallelRedoWorkerMain
+	},
+	{
+		"SessionKeeperMain", SessionKeeperMain
 	}
 };
 
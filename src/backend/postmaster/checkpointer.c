@@ -39,12 +39,16 @@
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
 #include "access/xlogrecovery.h"
+#include "common/hashfn.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/autoprewarm.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/interrupt.h"
 #include "replication/syncrep.h"
+#include "portability/instr_time.h"
+#include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/condition_variable.h"
 #include "storage/fd.h"
@@ -55,6 +59,7 @@
 #include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "storage/spin.h"
+#include "utils/backend_memory.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/resowner.h"
@@ -100,8 +105,15 @@
  * The requests array holds fsync requests sent by backends and not yet
  * absorbed by the checkpointer.
  *
- * Unlike the checkpoint fields, num_backend_writes, num_backend_fsync, and
- * the requests fields are protected by CheckpointerCommLock.
+ * Unlike the checkpoint fields, num_backend_fsync and the requests fields
+ * are protected by CheckpointerCommLock.  num_backend_writes is atomic, so
+ * that writes whose request needn't be forwarded can be counted without
+ * taking the lock.
+ *
+ * samples[] is a ring of the last CHECKPOINTER_NUM_SAMPLES per-second
+ * samples of write activity, filled in by the checkpointer and protected by
+ * sample_lck.  bgwriter_writes counts the buffers the bgwriter has written,
+ * for the samples.
  *----------
  */
 typedef struct {
@@ -123,9 +135,16 @@ typedef struct {
   ConditionVariable start_cv; /* signaled when ckpt_started advances */
   ConditionVariable done_cv;  /* signaled when ckpt_done advances */
 
-  uint32 num_backend_writes; /* counts user backend buffer writes */
+  pg_atomic_uint32 num_backend_writes; /* counts user backend buffer writes */
   uint32 num_backend_fsync;  /* counts user backend fsync calls */
 
+  pg_atomic_uint64 bgwriter_writes; /* counts bgwriter buffer writes */
+
+  slock_t sample_lck; /* protects the sample ring */
+  int sample_next;    /* next slot of samples[] to fill */
+  int num_samples;    /* valid entries in samples[] */
+  CheckpointerSample samples[CHECKPOINTER_NUM_SAMPLES];
+
   int num_requests; /* current # of requests */
   int max_requests; /* allocated array size */
   CheckpointerRequest requests[FLEXIBLE_ARRAY_MEMBER];
@@ -133,15 +152,34 @@ typedef struct {
 
 static CheckpointerShmemStruct *CheckpointerShmem;
 
+/*
+ * Number of entries in the cache of sync requests recently forwarded by this
+ * process, see ForwardSyncRequest.  Must be a power of 2.
+ */
+#define FORWARDED_CACHE_SIZE 64
+
 /* interval for calling AbsorbSyncRequests in CheckpointWriteDelay */
 #define WRITES_PER_ABSORB 1000
 
+/*
+ * With checkpoint_adaptive_pacing, the sync phase is given this many times
+ * the time the fsyncs are expected to take, so that they can be spread out
+ * with pauses in between; and at most this fraction of
+ * checkpoint_completion_target is taken away from the write phase for it.
+ */
+#define SYNC_SPREAD_FACTOR 2.0
+#define MAX_SYNC_RESERVE 0.5
+
+/* weight of the latest measurement in the pacing averages */
+#define PACING_EWMA_WEIGHT 0.3
+
 /*
  * GUC parameters
  */
 int CheckPointTimeout = 300;
 int CheckPointWarning = 30;
 double CheckPointCompletionTarget = 0.9;
+bool checkpoint_adaptive_pacing = false;
 
 /*
  * Private state
@@ -152,15 +190,58 @@ static bool ckpt_active = false;
 static pg_time_t ckpt_start_time;
 static XLogRecPtr ckpt_start_recptr;
 static double ckpt_cached_elapsed;
+static int ckpt_flags;
+
+/*
+ * Pacing of the current checkpoint, also valid when ckpt_active is true.
+ * The writes are to be done by ckpt_write_target, and the fsyncs by
+ * ckpt_write_target + ckpt_sync_reserve, as fractions of the checkpoint
+ * interval.  Without checkpoint_adaptive_pacing, ckpt_write_target is
+ * checkpoint_completion_target and the fsyncs aren't paced.
+ */
+static double ckpt_write_target;
+static double ckpt_sync_reserve;
+static int64 ckpt_buffers_processed;
+static double ckpt_buffer_time; /* average time per buffer, in us */
+static instr_time ckpt_last_buffer;
+
+/* average time the sync phase of a checkpoint spends in fsync, in us */
+static double sync_time_avg = 0.0;
+
+/* the write activity sample being accumulated */
+static bool sample_started = false;
+static instr_time sample_start;
+static uint64 sample_bgwriter_start;
+static int64 sample_checkpoint_writes;
+static instr_time sample_write_time;
+static int64 sample_fsyncs;
+static uint64 sample_fsync_time; /* in us */
+static uint64 sample_fsync_max_time;
+
+/*
+ * Sync requests this process forwarded since no checkpoint was in progress
+ * and ckpt_started was forwarded_ckpt_started, in a direct-mapped cache.
+ */
+static FileTag forwarded_tags[FORWARDED_CACHE_SIZE];
+static bool forwarded_used[FORWARDED_CACHE_SIZE];
+static bool forwarded_valid = false;
+static int forwarded_ckpt_started;
 
 static pg_time_t last_checkpoint_time;
+static pg_time_t last_buffer_map_time;
 static pg_time_t last_xlog_switch_time;
 
 /* Prototypes for private functions */
 
 static void HandleCheckpointerInterrupts(void);
 static void CheckArchiveTimeout(void);
+static void CheckBufferMapDump(void);
 static bool IsCheckpointOnSchedule(double progress);
+static bool IsSyncOnSchedule(double progress);
+static double CheckpointElapsed(void);
+static void CheckpointPacingStart(void);
+static void CheckpointPacingEnd(void);
+static void SampleWriteActivity(void);
 static bool ImmediateCheckpointRequested(void);
 static bool CompactCheckpointerRequestQueue(void);
 static void UpdateSharedMemoryConfig(void);
@@ -208,6 +289,7 @@ void CheckpointerMain(void) // 检查点进程的入口函数
    * Initialize so that first time-driven event happens at the correct time.
    */
   last_checkpoint_time = last_xlog_switch_time = (pg_time_t)time(NULL);
+  last_buffer_map_time = last_checkpoint_time;
 
   /*
    * Write out stats after shutdown. This needs to be called by exactly one
@@ -445,6 +527,8 @@ void CheckpointerMain(void) // 检查点进程的入口函数
         ckpt_start_recptr = GetInsertRecPtr();
       ckpt_start_time = now;
       ckpt_cached_elapsed = 0;
+      ckpt_flags = flags;
+      CheckpointPacingStart();
 
       /*
        * Do the checkpoint.
@@ -456,6 +540,9 @@ void CheckpointerMain(void) // 检查点进程的入口函数
       } else
         ckpt_performed = CreateRestartPoint(flags); // 备库上做restart point
 
+      if (ckpt_performed)
+        CheckpointPacingEnd();
+
       /*
        * After any checkpoint, close all smgr files.  This is so we
        * won't hang onto smgr references to deleted files indefinitely.
@@ -497,10 +584,19 @@ void CheckpointerMain(void) // 检查点进程的入口函数
     /* Check for archive_timeout and switch xlog files if necessary. */
     CheckArchiveTimeout(); // 检查归档超时的问题
 
+    /* Make sure there are future WAL segments ready for the inserters. */
+    XLogPreallocSegments();
+
+    /* Save the list of buffers for autoprewarm, if it's time to. */
+    CheckBufferMapDump();
+
     /* Report pending statistics to the cumulative stats system */
     pgstat_report_checkpointer(); // 更新一下统计信息
     pgstat_report_wal(true);
 
+    /* Close the write activity sample, if it's time to. */
+    SampleWriteActivity();
+
     /*
      * If any checkpoint flags have been set, redo the loop to handle the
      * checkpoint without sleeping.
@@ -525,6 +621,12 @@ void CheckpointerMain(void) // 检查点进程的入口函数
         continue; /* no sleep for us ... */
       cur_timeout = Min(cur_timeout, XLogArchiveTimeout - elapsed_secs);
     }
+    if (autoprewarm && autoprewarm_interval > 0) {
+      elapsed_secs = now - last_buffer_map_time;
+      if (elapsed_secs >= autoprewarm_interval)
+        continue; /* no sleep for us ... */
+      cur_timeout = Min(cur_timeout, autoprewarm_interval - elapsed_secs);
+    }
 
     (void)WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
                     cur_timeout * 1000L /* convert to ms */,
@@ -575,6 +677,13 @@ static void HandleCheckpointerInterrupts(void) {
     pgstat_report_checkpointer();
     pgstat_report_wal(true);
 
+    /*
+     * Save the final list of buffers for autoprewarm.  Everything else has
+     * exited by now, so it's what the next startup should load.
+     */
+    if (AutoPrewarmDumpAllowed())
+      AutoPrewarmDumpBufferMap();
+
     /* Normal exit from the checkpointer is here */
     proc_exit(0); /* done */
   }
@@ -582,6 +691,29 @@ static void HandleCheckpointerInterrupts(void) {
   /* Perform logging of memory contexts of this process */
   if (LogMemoryContextPending)
     ProcessLogMemoryContextInterrupt();
+
+  /* Publish our largest memory contexts if asked to */
+  if (PublishMemoryContextsPending)
+    ProcessPublishMemoryContextsInterrupt();
+}
+
+/*
+ * CheckBufferMapDump -- save the list of buffers for autoprewarm, if
+ * autoprewarm_interval has passed since we did last
+ */
+static void CheckBufferMapDump(void) {
+  pg_time_t now;
+
+  if (!autoprewarm || autoprewarm_interval <= 0)
+    return;
+
+  now = (pg_time_t)time(NULL);
+  if (now - last_buffer_map_time < autoprewarm_interval)
+    return;
+  last_buffer_map_time = now;
+
+  if (AutoPrewarmDumpAllowed())
+    AutoPrewarmDumpBufferMap();
 }
 
 /*
@@ -683,15 +815,42 @@ static bool ImmediateCheckpointRequested(
  * examined is CHECKPOINT_IMMEDIATE, which disables delays between writes.
  *
  * 'progress' is an estimate of how much of the work has been done, as a
- * fraction between 0.0 meaning none, and 1.0 meaning all done.
+ * fraction between 0.0 meaning none, and 1.0 meaning all done.  'written'
+ * tells whether the buffer processed last was written, and 'wb_context' is
+ * where its writeback was scheduled.
  */
-void CheckpointWriteDelay(int flags, double progress) {
+void CheckpointWriteDelay(int flags, double progress, bool written,
+                          struct WritebackContext *wb_context) {
   static int absorb_counter = WRITES_PER_ABSORB;
+  instr_time now;
 
   /* Do nothing if checkpoint is being executed by non-checkpointer process */
   if (!AmCheckpointerProcess())
     return;
 
+  /*
+   * Measure the time spent on the last buffer, since we returned from the
+   * previous call.  That leaves our naps out.
+   */
+  INSTR_TIME_SET_CURRENT(now);
+  if (ckpt_buffers_processed > 0) {
+    instr_time elapsed = now;
+    double usecs;
+
+    INSTR_TIME_SUBTRACT(elapsed, ckpt_last_buffer);
+    usecs = (double)INSTR_TIME_GET_MICROSEC(elapsed);
+    if (ckpt_buffers_processed == 1)
+      ckpt_buffer_time = usecs;
+    else
+      ckpt_buffer_time += (usecs - ckpt_buffer_time) / WRITES_PER_ABSORB;
+
+    if (written)
+      INSTR_TIME_ADD(sample_write_time, elapsed);
+  }
+  ckpt_buffers_processed++;
+  if (written)
+    sample_checkpoint_writes++;
+
   /*
    * Perform the usual duties and take a nap, unless we're behind schedule,
    * in which case we just try to catch up as quickly as possible.
@@ -710,9 +869,19 @@ void CheckpointWriteDelay(int flags, double progress) {
 
     CheckArchiveTimeout();
 
+    XLogPreallocSegments();
+
     /* Report interim statistics to the cumulative stats system */
     pgstat_report_checkpointer();
 
+    /*
+     * With adaptive pacing, hand the writes done so far over to the kernel
+     * before napping, so that it writes them out while we sleep rather than
+     * leaving them all for the fsyncs.
+     */
+    if (checkpoint_adaptive_pacing)
+      IssuePendingWritebacks(wb_context, IOCONTEXT_NORMAL);
+
     /*
      * This sleep used to be connected to bgwriter_delay, typically 200ms.
      * That resulted in more frequent wakeups if not much work to do.
@@ -732,11 +901,106 @@ void CheckpointWriteDelay(int flags, double progress) {
     absorb_counter = WRITES_PER_ABSORB;
   }
 
+  SampleWriteActivity();
+
+  /* Check for barrier events. */
+  if (ProcSignalBarrierPending)
+    ProcessProcSignalBarrier();
+
+  INSTR_TIME_SET_CURRENT(ckpt_last_buffer);
+}
+
+/*
+ * CheckpointSyncDelay -- control rate of checkpoint fsyncs
+ *
+ * This function is called after each fsync performed by
+ * ProcessSyncRequests(), which took 'sync_time' microseconds.  With
+ * checkpoint_adaptive_pacing, it naps until the fsyncs fall behind their
+ * schedule, so that they are spread over the time reserved for them at the
+ * start of the checkpoint rather than issued back to back.  A burst of
+ * fsyncs each flushing lots of data can otherwise starve other I/O for
+ * seconds.
+ *
+ * 'progress' is the fraction of the fsyncs done so far.
+ */
+void CheckpointSyncDelay(double progress, uint64 sync_time) {
+  /* Do nothing if checkpoint is being executed by non-checkpointer process */
+  if (!AmCheckpointerProcess())
+    return;
+
+  sample_fsyncs++;
+  sample_fsync_time += sync_time;
+  if (sync_time > sample_fsync_max_time)
+    sample_fsync_max_time = sync_time;
+
+  while (ckpt_active && ckpt_sync_reserve > 0.0 &&
+         !(ckpt_flags & CHECKPOINT_IMMEDIATE) && !ShutdownRequestPending &&
+         !ImmediateCheckpointRequested() && IsSyncOnSchedule(progress)) {
+    if (ConfigReloadPending) {
+      ConfigReloadPending = false;
+      ProcessConfigFile(PGC_SIGHUP);
+      /* update shmem copies of config variables */
+      UpdateSharedMemoryConfig();
+    }
+
+    AbsorbSyncRequests();
+
+    CheckArchiveTimeout();
+
+    pgstat_report_checkpointer();
+
+    SampleWriteActivity();
+
+    WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH | WL_TIMEOUT, 100,
+              WAIT_EVENT_CHECKPOINT_SYNC_DELAY);
+    ResetLatch(MyLatch);
+  }
+
+  SampleWriteActivity();
+
   /* Check for barrier events. */
   if (ProcSignalBarrierPending)
     ProcessProcSignalBarrier();
 }
 
+/*
+ * CheckpointPacingStart -- set up the pacing of a checkpoint
+ *
+ * With checkpoint_adaptive_pacing, the end of the write phase is moved ahead
+ * to leave room for spreading the fsyncs, according to how long the fsyncs
+ * of the previous checkpoints took.
+ */
+static void CheckpointPacingStart(void) {
+  ckpt_write_target = CheckPointCompletionTarget;
+  ckpt_sync_reserve = 0.0;
+  ckpt_buffers_processed = 0;
+  ckpt_buffer_time = 0.0;
+
+  if (checkpoint_adaptive_pacing && !(ckpt_flags & CHECKPOINT_IMMEDIATE)) {
+    ckpt_sync_reserve =
+        Min(SYNC_SPREAD_FACTOR * sync_time_avg / 1000000.0 / CheckPointTimeout,
+            MAX_SYNC_RESERVE * CheckPointCompletionTarget);
+    ckpt_write_target -= ckpt_sync_reserve;
+  }
+}
+
+/*
+ * CheckpointPacingEnd -- learn from a completed checkpoint
+ *
+ * Checkpoints with nothing to fsync don't tell us anything.
+ */
+static void CheckpointPacingEnd(void) {
+  double sync_time = (double)CheckpointStats.ckpt_agg_sync_time;
+
+  if (CheckpointStats.ckpt_sync_rels == 0)
+    return;
+
+  if (sync_time_avg == 0.0)
+    sync_time_avg = sync_time;
+  else
+    sync_time_avg += PACING_EWMA_WEIGHT * (sync_time - sync_time_avg);
+}
+
 /*
  * IsCheckpointOnSchedule -- are we on schedule to finish this checkpoint
  *		 (or restartpoint) in time?
@@ -749,11 +1013,15 @@ static bool IsCheckpointOnSchedule(double progress) {
   XLogRecPtr recptr;
   struct timeval now;
   double elapsed_xlogs, elapsed_time;
+  double buffers_progress = progress;
 
   Assert(ckpt_active);
 
-  /* Scale progress according to checkpoint_completion_target. */
-  progress *= CheckPointCompletionTarget;
+  /*
+   * Scale progress according to checkpoint_completion_target, less the time
+   * reserved for the fsyncs.
+   */
+  progress *= ckpt_write_target;
 
   /*
    * Check against the cached value first. Only do the more expensive
@@ -809,10 +1077,122 @@ static bool IsCheckpointOnSchedule(double progress) {
     return false;
   }
 
+  /*
+   * With adaptive pacing, also check that the buffers left can be written
+   * by the deadline at the rate we have been writing them.  A slow device
+   * then makes us keep writing early instead of falling behind at the end.
+   */
+  if (checkpoint_adaptive_pacing && buffers_progress > 0.0 &&
+      ckpt_buffer_time > 0.0) {
+    double remaining = ckpt_buffers_processed * (1.0 - buffers_progress) /
+                       buffers_progress;
+
+    if (elapsed_time + remaining * ckpt_buffer_time / 1000000.0 /
+                           CheckPointTimeout >
+        ckpt_write_target)
+      return false;
+  }
+
   /* It looks like we're on schedule. */
   return true;
 }
 
+/*
+ * IsSyncOnSchedule -- are the fsyncs of this checkpoint ahead of schedule?
+ *
+ * The fsyncs are spread between the end of the write phase and the end of
+ * the time reserved for them.
+ */
+static bool IsSyncOnSchedule(double progress) {
+  Assert(ckpt_active);
+
+  return ckpt_write_target + progress * ckpt_sync_reserve >
+         CheckpointElapsed();
+}
+
+/*
+ * CheckpointElapsed -- how far into the checkpoint interval we are
+ *
+ * This is the larger of the time and WAL elapsed since the checkpoint
+ * started, as fractions of checkpoint_timeout and max_wal_size; see
+ * IsCheckpointOnSchedule.
+ */
+static double CheckpointElapsed(void) {
+  XLogRecPtr recptr;
+  struct timeval now;
+  double elapsed_xlogs, elapsed_time;
+
+  if (RecoveryInProgress())
+    recptr = GetXLogReplayRecPtr(NULL);
+  else
+    recptr = GetInsertRecPtr();
+  elapsed_xlogs = (((double)(recptr - ckpt_start_recptr)) / wal_segment_size) /
+                  CheckPointSegments;
+
+  gettimeofday(&now, NULL);
+  elapsed_time = ((double)((pg_time_t)now.tv_sec - ckpt_start_time) +
+                  now.tv_usec / 1000000.0) /
+                 CheckPointTimeout;
+
+  return Max(elapsed_xlogs, elapsed_time);
+}
+
+/*
+ * SampleWriteActivity -- add a sample of write activity to the ring
+ *
+ * Called now and then by the checkpointer; every time a second or more has
+ * passed since the last sample, the activity since then is added to the
+ * ring in shared memory.
+ */
+static void SampleWriteActivity(void) {
+  instr_time now, elapsed;
+  uint64 bgwriter_writes;
+  TimestampTz sample_time;
+  int fsyncs_pending;
+  CheckpointerSample *sample;
+
+  INSTR_TIME_SET_CURRENT(now);
+  bgwriter_writes = pg_atomic_read_u64(&CheckpointerShmem->bgwriter_writes);
+
+  if (sample_started) {
+    elapsed = now;
+    INSTR_TIME_SUBTRACT(elapsed, sample_start);
+    if (INSTR_TIME_GET_MICROSEC(elapsed) < 1000000)
+      return;
+
+    sample_time = GetCurrentTimestamp();
+    fsyncs_pending = NumPendingSyncRequests();
+
+    SpinLockAcquire(&CheckpointerShmem->sample_lck);
+    sample = &CheckpointerShmem->samples[CheckpointerShmem->sample_next];
+    sample->sample_time = sample_time;
+    sample->seconds = INSTR_TIME_GET_DOUBLE(elapsed);
+    sample->checkpoint_writes = sample_checkpoint_writes;
+    sample->bgwriter_writes = bgwriter_writes - sample_bgwriter_start;
+    sample->write_time = INSTR_TIME_GET_MILLISEC(sample_write_time);
+    sample->fsyncs = sample_fsyncs;
+    sample->fsync_time = sample_fsync_time / 1000.0;
+    sample->fsync_max_time = sample_fsync_max_time / 1000.0;
+    /* read without CheckpointerCommLock; it's only a sample */
+    sample->sync_requests = CheckpointerShmem->num_requests;
+    sample->fsyncs_pending = fsyncs_pending;
+    CheckpointerShmem->sample_next =
+        (CheckpointerShmem->sample_next + 1) % CHECKPOINTER_NUM_SAMPLES;
+    if (CheckpointerShmem->num_samples < CHECKPOINTER_NUM_SAMPLES)
+      CheckpointerShmem->num_samples++;
+    SpinLockRelease(&CheckpointerShmem->sample_lck);
+  }
+
+  sample_started = true;
+  sample_start = now;
+  sample_bgwriter_start = bgwriter_writes;
+  sample_checkpoint_writes = 0;
+  INSTR_TIME_SET_ZERO(sample_write_time);
+  sample_fsyncs = 0;
+  sample_fsync_time = 0;
+  sample_fsync_max_time = 0;
+}
+
 /* --------------------------------
  *		signal handler routines
  * --------------------------------
@@ -872,6 +1252,9 @@ void CheckpointerShmemInit(void) {
      */
     MemSet(CheckpointerShmem, 0, size);
     SpinLockInit(&CheckpointerShmem->ckpt_lck);
+    SpinLockInit(&CheckpointerShmem->sample_lck);
+    pg_atomic_init_u32(&CheckpointerShmem->num_backend_writes, 0);
+    pg_atomic_init_u64(&CheckpointerShmem->bgwriter_writes, 0);
     CheckpointerShmem->max_requests = NBuffers;
     ConditionVariableInit(&CheckpointerShmem->start_cv);
     ConditionVariableInit(&CheckpointerShmem->done_cv);
@@ -1044,10 +1427,21 @@ void RequestCheckpoint(
  * is theoretically possible a backend fsync might still be necessary, if
  * the queue is full and contains no duplicate entries.  In that case, we
  * let the backend know by returning false.
+ *
+ * Most of the duplicates are a process writing one segment over and over,
+ * so before taking the lock we check a small cache of the fsync requests
+ * this process forwarded recently.  A repeated request can be dropped as
+ * long as no checkpoint has started since the earlier one was queued, and
+ * none was in progress then: the earlier request will be fsync'd by a
+ * checkpoint that starts after the write we're registering now.  (Once a
+ * checkpoint has started, its sync phase may have fsync'd the file before
+ * our write, which is why the cache is emptied then.)
  */
 bool ForwardSyncRequest(const FileTag *ftag, SyncRequestType type) {
   CheckpointerRequest *request;
   bool too_full;
+  bool cacheable = false;
+  int slot = 0;
 
   if (!IsUnderPostmaster)
     return false; /* probably shouldn't even get here */
@@ -1055,11 +1449,45 @@ bool ForwardSyncRequest(const FileTag *ftag, SyncRequestType type) {
   if (AmCheckpointerProcess())
     elog(ERROR, "ForwardSyncRequest must not be called in checkpointer");
 
-  LWLockAcquire(CheckpointerCommLock, LW_EXCLUSIVE);
+  if (type == SYNC_REQUEST) {
+    int started;
+    int done;
+
+    SpinLockAcquire(&CheckpointerShmem->ckpt_lck);
+    started = CheckpointerShmem->ckpt_started;
+    done = CheckpointerShmem->ckpt_done;
+    SpinLockRelease(&CheckpointerShmem->ckpt_lck);
+
+    if (started != done) {
+      /* checkpoint in progress, see above */
+      forwarded_valid = false;
+    } else {
+      if (!forwarded_valid || forwarded_ckpt_started != started) {
+        memset(forwarded_used, 0, sizeof(forwarded_used));
+        forwarded_ckpt_started = started;
+        forwarded_valid = true;
+      }
+
+      slot = hash_bytes((const unsigned char *)ftag, sizeof(FileTag)) &
+             (FORWARDED_CACHE_SIZE - 1);
+      if (forwarded_used[slot] &&
+          memcmp(&forwarded_tags[slot], ftag, sizeof(FileTag)) == 0) {
+        if (!AmBackgroundWriterProcess())
+          pg_atomic_fetch_add_u32(&CheckpointerShmem->num_backend_writes, 1);
+        return true;
+      }
+      cacheable = true;
+    }
+  } else {
+    /* be conservative about requests that cancel earlier ones */
+    forwarded_valid = false;
+  }
 
   /* Count all backend writes regardless of if they fit in the queue */
   if (!AmBackgroundWriterProcess())
-    CheckpointerShmem->num_backend_writes++;
+    pg_atomic_fetch_add_u32(&CheckpointerShmem->num_backend_writes, 1);
+
+  LWLockAcquire(CheckpointerCommLock, LW_EXCLUSIVE);
 
   /*
    * If the checkpointer isn't running or the request queue is full, the
@@ -1090,6 +1518,11 @@ bool ForwardSyncRequest(const FileTag *ftag, SyncRequestType type) {
 
   LWLockRelease(CheckpointerCommLock);
 
+  if (cacheable) {
+    forwarded_tags[slot] = *ftag;
+    forwarded_used[slot] = true;
+  }
+
   /* ... but not till after we release the lock */
   if (too_full && ProcGlobal->checkpointerLatch)
     SetLatch(ProcGlobal->checkpointerLatch);
@@ -1224,11 +1657,10 @@ void AbsorbSyncRequests(void) {
 
   /* Transfer stats counts into pending pgstats message */
   PendingCheckpointerStats.buf_written_backend +=
-      CheckpointerShmem->num_backend_writes;
+      pg_atomic_exchange_u32(&CheckpointerShmem->num_backend_writes, 0);
   PendingCheckpointerStats.buf_fsync_backend +=
       CheckpointerShmem->num_backend_fsync;
 
-  CheckpointerShmem->num_backend_writes = 0;
   CheckpointerShmem->num_backend_fsync = 0;
 
   /*
@@ -1299,3 +1731,35 @@ bool FirstCallSinceLastCheckpoint(void) {
 
   return FirstCall;
 }
+
+/*
+ * CountBgWriterWrites
+ *		Called by the bgwriter to count the buffers it wrote, for the
+ *		write activity samples
+ */
+void CountBgWriterWrites(int num_written) {
+  if (num_written > 0)
+    pg_atomic_fetch_add_u64(&CheckpointerShmem->bgwriter_writes, num_written);
+}
+
+/*
+ * GetCheckpointerSamples
+ *		Copy the write activity samples, oldest first, into 'samples',
+ *		which must have room for CHECKPOINTER_NUM_SAMPLES of them
+ *
+ * Returns the number of samples copied.
+ */
+int GetCheckpointerSamples(CheckpointerSample *samples) {
+  int nsamples;
+  int first;
+
+  SpinLockAcquire(&CheckpointerShmem->sample_lck);
+  nsamples = CheckpointerShmem->num_samples;
+  first = (CheckpointerShmem->sample_next - nsamples + CHECKPOINTER_NUM_SAMPLES) %
+          CHECKPOINTER_NUM_SAMPLES;
+  for (int i = 0; i < nsamples; i++)
+    samples[i] = CheckpointerShmem->samples[(first + i) % CHECKPOINTER_NUM_SAMPLES];
+  SpinLockRelease(&CheckpointerShmem->sample_lck);
+
+  return nsamples;
+}
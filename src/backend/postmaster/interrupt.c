@@ -21,6 +21,7 @@
 #include "storage/ipc.h"
 #include "storage/latch.h"
 #include "storage/procsignal.h"
+#include "utils/backend_memory.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 
@@ -48,6 +49,10 @@ HandleMainLoopInterrupts(void)
 	/* Perform logging of memory contexts of this process */
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
+
+	/* Publish our largest memory contexts if asked to */
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
 }
 
 /*
@@ -31,6 +31,7 @@
 
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
+#include "access/xlogcompress.h"
 #include "archive/archive_module.h"
 #include "archive/shell_archive.h"
 #include "lib/binaryheap.h"
@@ -46,6 +47,7 @@
 #include "storage/procsignal.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
+#include "utils/backend_memory.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
@@ -91,6 +93,7 @@ typedef struct PgArchData
 } PgArchData;
 
 char	   *XLogArchiveLibrary = "";
+int			archive_compression = WAL_COMPRESSION_NONE;
 
 
 /* ----------
@@ -143,6 +146,7 @@ static void pgarch_ArchiverCopyLoop(void);
 static bool pgarch_archiveXlog(char *xlog);
 static bool pgarch_readyXlog(char *xlog);
 static void pgarch_archiveDone(char *xlog);
+static void pgarch_removeCompressed(void);
 static void pgarch_die(int code, Datum arg);
 static void HandlePgArchInterrupts(void);
 static int	ready_file_comparator(Datum a, Datum b, void *arg);
@@ -255,6 +259,9 @@ PgArchiverMain(void)
 	/* Load the archive_library. */
 	LoadArchiveLibrary();
 
+	/* Remove compressed copies left behind by a previous archiver */
+	pgarch_removeCompressed();
+
 	pgarch_MainLoop();
 
 	proc_exit(0);
@@ -502,7 +509,9 @@ static bool
 pgarch_archiveXlog(char *xlog)
 {
 	char		pathname[MAXPGPATH];
+	char		compressedpath[MAXPGPATH];
 	char		activitymsg[MAXFNAMELEN + 16];
+	bool		compressed = false;
 	bool		ret;
 
 	snprintf(pathname, MAXPGPATH, XLOGDIR "/%s", xlog);
@@ -511,7 +520,38 @@ pgarch_archiveXlog(char *xlog)
 	snprintf(activitymsg, sizeof(activitymsg), "archiving %s", xlog);
 	set_ps_display(activitymsg);
 
+	/*
+	 * With archive_compression, hand a compressed copy of WAL segments to the
+	 * archive command or module instead, under the same file name.  History
+	 * and backup history files are small and meant to be human-readable, so
+	 * they are left alone.  Recovery decompresses restored files as needed.
+	 *
+	 * The copy goes into archive_status, where nothing mistakes it for WAL.
+	 * If we fail to remove it because of an error or a crash, the next
+	 * archiver removes it at startup.
+	 */
+	if (archive_compression != WAL_COMPRESSION_NONE && IsXLogFileName(xlog))
+	{
+		snprintf(compressedpath, MAXPGPATH, XLOGDIR "/archive_status/%s.compressed",
+				 xlog);
+		if (!XLogCompressFile((WalCompression) archive_compression,
+							  pathname, compressedpath, WARNING))
+		{
+			snprintf(activitymsg, sizeof(activitymsg), "failed on %s", xlog);
+			set_ps_display(activitymsg);
+			return false;
+		}
+		strlcpy(pathname, compressedpath, MAXPGPATH);
+		compressed = true;
+	}
+
 	ret = ArchiveCallbacks->archive_file_cb(archive_module_state, xlog, pathname);
+
+	if (compressed && unlink(pathname) != 0 && errno != ENOENT)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", pathname)));
+
 	if (ret)
 		snprintf(activitymsg, sizeof(activitymsg), "last was %s", xlog);
 	else
@@ -521,6 +561,44 @@ pgarch_archiveXlog(char *xlog)
 	return ret;
 }
 
+/*
+ * pgarch_removeCompressed
+ *
+ * Remove compressed copies of WAL segments from archive_status that
+ * pgarch_archiveXlog() didn't get to remove itself.
+ */
+static void
+pgarch_removeCompressed(void)
+{
+	char		XLogArchiveStatusDir[MAXPGPATH];
+	DIR		   *rldir;
+	struct dirent *rlde;
+
+	snprintf(XLogArchiveStatusDir, MAXPGPATH, XLOGDIR "/archive_status");
+	rldir = AllocateDir(XLogArchiveStatusDir);
+
+	while ((rlde = ReadDir(rldir, XLogArchiveStatusDir)) != NULL)
+	{
+		int			basenamelen = (int) strlen(rlde->d_name) - 11;
+		char		path[MAXPGPATH];
+
+		/* Only bother with what pgarch_archiveXlog() creates */
+		if (basenamelen != XLOG_FNAME_LEN ||
+			strcmp(rlde->d_name + basenamelen, ".compressed") != 0)
+			continue;
+
+		snprintf(path, MAXPGPATH, "%s/%s", XLogArchiveStatusDir, rlde->d_name);
+		if (unlink(path) != 0 && errno != ENOENT)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+		else
+			elog(DEBUG2, "removed leftover compressed WAL file \"%s\"", path);
+	}
+
+	FreeDir(rldir);
+}
+
 /*
  * pgarch_readyXlog
  *
@@ -777,6 +855,10 @@ HandlePgArchInterrupts(void)
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
 
+	/* Publish our largest memory contexts if asked to */
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
+
 	if (ConfigReloadPending)
 	{
 		char	   *archiveLib = pstrdup(XLogArchiveLibrary);
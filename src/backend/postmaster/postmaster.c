@@ -93,6 +93,7 @@
 #include "access/xlog.h"
 #include "access/xlogrecovery.h"
 #include "catalog/pg_control.h"
+#include "common/compression_stream.h"
 #include "common/file_perm.h"
 #include "common/ip.h"
 #include "common/pg_prng.h"
@@ -106,6 +107,7 @@
 #include "pg_getopt.h"
 #include "pgstat.h"
 #include "port/pg_bswap.h"
+#include "postmaster/autoprewarm.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/auxprocess.h"
 #include "postmaster/bgworker_internals.h"
@@ -113,6 +115,7 @@
 #include "postmaster/interrupt.h"
 #include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/sessionkeeper.h"
 #include "postmaster/syslogger.h"
 #include "replication/logicallauncher.h"
 #include "replication/walsender.h"
@@ -167,6 +170,11 @@
  * they will never become live backends.  dead_end children are not assigned a
  * PMChildSlot.  dead_end children have bkend_type NORMAL.
  *
+ * So are pre-forked backends waiting to be handed a connection; see
+ * prefork_backends.  They have a PMChildSlot and bkend_type NORMAL, and
+ * prefork_sock is our end of the socket pair over which the connection will
+ * be passed, until it has been.
+ *
  * "Special" children such as the startup, bgwriter and autovacuum launcher
  * tasks are not in this list.  They are tracked via StartupPID and other
  * pid_t variables below.  (Thus, there can't be more than one of any given
@@ -181,14 +189,21 @@ typedef struct bkend
 	int			bkend_type;		/* child process flavor, see above */
 	bool		dead_end;		/* is it going to send an error and quit? */
 	bool		bgworker_notify;	/* gets bgworker start/stop notifications */
+	pgsocket	prefork_sock;	/* socket to an idle pre-forked backend */
+	int			session_pid;	/* PID the client of a resumed session knows
+								 * it by, or 0 */
 	dlist_node	elem;			/* list link in BackendList */ /// 双向链表指针
 } Backend;
 
 static dlist_head BackendList = DLIST_STATIC_INIT(BackendList); /// 初始化，指向它自己
 
-#ifdef EXEC_BACKEND
+/*
+ * A copy of the BackendList entries that have a PMChildSlot, in shared
+ * memory, for processCancelRequest() in children that can't rely on their
+ * own copy of BackendList: all with EXEC_BACKEND, and pre-forked backends,
+ * whose copy dates from their fork rather than their connection.
+ */
 static Backend *ShmemBackendArray; /// 这是一个在共享内存中的数组，记录了每一个backend进程的情况
-#endif
 
 BackgroundWorker *MyBgworkerEntry = NULL;
 
@@ -224,6 +239,16 @@ char	   *ListenAddresses;
 int			SuperuserReservedConnections;
 int			ReservedConnections;
 
+/*
+ * Number of backends forked ahead of time, waiting for a connection from us
+ * so that a new connection doesn't have to wait for fork() and process setup.
+ * Not supported in EXEC_BACKEND builds.
+ */
+int			prefork_backends = 0;
+
+/* Number of BackendList entries with a valid prefork_sock */
+static int	NumIdlePreforkBackends = 0;
+
 /* The socket(s) we're listening to. */
 #define MAXLISTEN	64
 static pgsocket ListenSocket[MAXLISTEN];
@@ -399,6 +424,7 @@ static void unlink_external_pid_file(int status, Datum arg);
 static void getInstallationPaths(const char *argv0);
 static void checkControlFile(void);
 static Port *ConnCreate(int serverFd);
+static Port *ResumedConnCreate(pgsocket sock, char *session, int session_len);
 static void ConnFree(Port *port);
 static void handle_pm_pmsignal_signal(SIGNAL_ARGS);
 static void handle_pm_child_exit_signal(SIGNAL_ARGS);
@@ -422,6 +448,12 @@ static void BackendRun(Port *port) pg_attribute_noreturn();
 static void ExitPostmaster(int status) pg_attribute_noreturn();
 static int	ServerLoop(void);
 static int	BackendStartup(Port *port);
+#ifndef EXEC_BACKEND
+static bool HandOffConnection(Port *port);
+static void MaintainPreforkBackends(void);
+static bool StartPreforkBackend(void);
+static Port *PreforkBackendWait(pgsocket sock);
+#endif
 static int	ProcessStartupPacket(Port *port, bool ssl_done, bool gss_done);
 static void SendNegotiateProtocolVersion(List *unrecognized_protocol_options);
 static void processCancelRequest(Port *port, void *pkt);
@@ -530,6 +562,9 @@ typedef struct
 	bool		query_id_enabled;
 	int			max_safe_fds;
 	int			MaxBackends;
+	int			FastPathLockGroupsPerBackend;
+	int			NumLockPartitions;
+	int			Log2NumLockPartitions;
 #ifdef WIN32
 	HANDLE		PostmasterHandle;
 	HANDLE		initial_signal_pipe;
@@ -551,10 +586,10 @@ static bool save_backend_variables(BackendParameters *param, Port *port);
 static bool save_backend_variables(BackendParameters *param, Port *port,
 								   HANDLE childProcess, pid_t childPid);
 #endif
+#endif							/* EXEC_BACKEND */
 
 static void ShmemBackendArrayAdd(Backend *bn);
 static void ShmemBackendArrayRemove(Backend *bn);
-#endif							/* EXEC_BACKEND */
 
 #define StartupDataBase()		StartChildProcess(StartupProcess)
 #define StartArchiver()			StartChildProcess(ArchiverProcess)
@@ -1002,6 +1037,13 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	ApplyLauncherRegister();
 
+	/* Likewise for the autoprewarm leader, if enabled. */
+	AutoPrewarmRegister();
+
+	/* And the session keeper, if session parking is enabled. */
+	SessionKeeperInit();
+	SessionKeeperRegister();
+
 	/*
 	 * process any libraries that should be preloaded at postmaster start
 	 */
@@ -1024,6 +1066,12 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	InitializeMaxBackends(); /// 根据配置的信息，计算MaxBackends的值
 
+	/* Size the fast-path lock arrays from max_locks_per_transaction. */
+	InitializeFastPathLocks();
+
+	/* Choose the number of lock table partitions. */
+	InitializeLockPartitions();
+
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
 	 */
@@ -1711,7 +1759,7 @@ ConfigurePostmasterWaitSet(bool accept_connections)
 			++nsockets;
 	}
 
-	pm_wait_set = CreateWaitEventSet(CurrentMemoryContext, 1 + nsockets);
+	pm_wait_set = CreateWaitEventSet(CurrentMemoryContext, 2 + nsockets);
 	AddWaitEventToSet(pm_wait_set, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch,
 					  NULL);
 
@@ -1720,6 +1768,11 @@ ConfigurePostmasterWaitSet(bool accept_connections)
 		for (int i = 0; i < nsockets; i++)
 			AddWaitEventToSet(pm_wait_set, WL_SOCKET_ACCEPT, ListenSocket[i],
 							  NULL, NULL);
+
+		/* Parked sessions to resume come in like new connections */
+		if (SessionKeeperPostmasterSocket() != PGINVALID_SOCKET)
+			AddWaitEventToSet(pm_wait_set, WL_SOCKET_READABLE,
+							  SessionKeeperPostmasterSocket(), NULL, NULL);
 	}
 }
 
@@ -1731,7 +1784,7 @@ ServerLoop(void)
 {
 	time_t		last_lockfile_recheck_time,
 				last_touch_time;
-	WaitEvent	events[MAXLISTEN];
+	WaitEvent	events[MAXLISTEN + 2];
 	int			nevents;
 
 	ConfigurePostmasterWaitSet(true);
@@ -1772,14 +1825,37 @@ ServerLoop(void)
 			if (pending_pm_pmsignal) // 如果有来自子进程的请求，就处理它们的请求
 				process_pm_pmsignal();
 
-			if (events[i].events & WL_SOCKET_ACCEPT)
+			if ((events[i].events & WL_SOCKET_READABLE) &&
+				events[i].fd == SessionKeeperPostmasterSocket())
+			{
+				pgsocket	sock;
+				char	   *session;
+				int			session_len;
+
+				while (SessionKeeperReceive(&sock, &session, &session_len))
+				{
+					Port	   *port;
+
+					port = ResumedConnCreate(sock, session, session_len);
+					if (port)
+					{
+						BackendStartup(port);
+						StreamClose(port->sock);
+						ConnFree(port);
+					}
+				}
+			}
+			else if (events[i].events & WL_SOCKET_ACCEPT)
 			{
 				Port	   *port;
 
 				port = ConnCreate(events[i].fd);
 				if (port)
 				{
-					BackendStartup(port); // 启动子进程
+#ifndef EXEC_BACKEND
+					if (!HandOffConnection(port))
+#endif
+						BackendStartup(port); // 启动子进程
 
 					/*
 					 * We no longer need the open socket or port structure in
@@ -1852,6 +1928,11 @@ ServerLoop(void)
 		if (StartWorkerNeeded || HaveCrashedWorker)
 			maybe_start_bgworkers();
 
+#ifndef EXEC_BACKEND
+		/* Keep the pool of pre-forked backends at the requested size */
+		MaintainPreforkBackends();
+#endif
+
 #ifdef HAVE_PTHREAD_IS_THREADED_NP
 
 		/*
@@ -2213,12 +2294,27 @@ retry1:
 									valptr),
 							 errhint("Valid values are: \"false\", 0, \"true\", 1, \"database\".")));
 			}
+			else if (strcmp(nameptr, "_pq_.compression") == 0)
+			{
+				/*
+				 * Protocol compression, which pq_enable_compression() starts
+				 * after authentication.  Refuse algorithms we can't do here
+				 * rather than ignoring them, since the client would go on to
+				 * send compressed data.
+				 */
+				if (!zs_parse_spec(valptr, &port->compression_algorithm,
+								   &port->compression_level))
+					ereport(FATAL,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("unsupported protocol compression \"%s\"",
+									valptr)));
+			}
 			else if (strncmp(nameptr, "_pq_.", 5) == 0)
 			{
 				/*
-				 * Any option beginning with _pq_. is reserved for use as a
-				 * protocol-level option, but at present no such options are
-				 * defined.
+				 * Any other option beginning with _pq_. is reserved for use
+				 * as a protocol-level option, but at present no other such
+				 * options are defined.
 				 */
 				unrecognized_protocol_options =
 					lappend(unrecognized_protocol_options, pstrdup(nameptr));
@@ -2410,57 +2506,51 @@ processCancelRequest(Port *port, void *pkt)
 	int			backendPID;
 	int32		cancelAuthCode;
 	Backend    *bp;
-
-#ifndef EXEC_BACKEND
-	dlist_iter	iter;
-#else
+	bool		found_pid = false;
 	int			i;
-#endif
 
 	backendPID = (int) pg_ntoh32(canc->backendPID);
 	cancelAuthCode = (int32) pg_ntoh32(canc->cancelAuthCode);
 
 	/*
-	 * See if we have a matching backend.  In the EXEC_BACKEND case, we can no
-	 * longer access the postmaster's own backend list, and must rely on the
-	 * duplicate array in shared memory.
+	 * See if we have a matching backend.  We can't rely on our copy of the
+	 * postmaster's own backend list: in the EXEC_BACKEND case, we have none,
+	 * and a pre-forked backend's copy is from before it was handed this
+	 * connection.  So use the duplicate array in shared memory.
 	 */
-#ifndef EXEC_BACKEND
-	dlist_foreach(iter, &BackendList)
-	{
-		bp = dlist_container(Backend, elem, iter.cur);
-#else
 	for (i = MaxLivePostmasterChildren() - 1; i >= 0; i--)
 	{
 		bp = (Backend *) &ShmemBackendArray[i];
-#endif
-		if (bp->pid == backendPID)
+
+		/*
+		 * A resumed session goes by the PID of the backend its client first
+		 * connected to, which some other process may have been given since.
+		 */
+		if ((bp->session_pid ? bp->session_pid : bp->pid) == backendPID)
 		{
 			if (bp->cancel_key == cancelAuthCode)
 			{
 				/* Found a match; signal that backend to cancel current op */
 				ereport(DEBUG2,
 						(errmsg_internal("processing cancel request: sending SIGINT to process %d",
-										 backendPID)));
+										 (int) bp->pid)));
 				signal_child(bp->pid, SIGINT);
+				return;
 			}
-			else
-				/* Right PID, wrong key: no way, Jose */
-				ereport(LOG,
-						(errmsg("wrong key in cancel request for process %d",
-								backendPID)));
-			return;
+			found_pid = true;
 		}
-#ifndef EXEC_BACKEND			/* make GNU Emacs 26.1 see brace balance */
-	}
-#else
 	}
-#endif
 
-	/* No matching backend */
-	ereport(LOG,
-			(errmsg("PID %d in cancel request did not match any process",
-					backendPID)));
+	if (found_pid)
+		/* Right PID, wrong key: no way, Jose */
+		ereport(LOG,
+				(errmsg("wrong key in cancel request for process %d",
+						backendPID)));
+	else
+		/* No matching backend */
+		ereport(LOG,
+				(errmsg("PID %d in cancel request did not match any process",
+						backendPID)));
 }
 
 /*
@@ -2550,6 +2640,39 @@ ConnCreate(int serverFd)
 }
 
 
+/*
+ * ResumedConnCreate -- create a local connection data structure for a
+ *		parked session to resume, which takes ownership of "session"
+ *
+ * Returns NULL on failure, other than out-of-memory which is fatal.
+ */
+static Port *
+ResumedConnCreate(pgsocket sock, char *session, int session_len)
+{
+	Port	   *port;
+
+	if (!(port = (Port *) calloc(1, sizeof(Port))))
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+		ExitPostmaster(1);
+	}
+
+	port->parked_session = session;
+	port->parked_session_len = session_len;
+
+	if (StreamResumeConnection(sock, port) != STATUS_OK)
+	{
+		StreamClose(sock);
+		ConnFree(port);
+		return NULL;
+	}
+
+	return port;
+}
+
+
 /*
  * ConnFree -- free a local connection data structure
  *
@@ -2559,6 +2682,8 @@ ConnCreate(int serverFd)
 static void
 ConnFree(Port *port)
 {
+	if (port->parked_session)
+		free(port->parked_session);
 	free(port);
 }
 
@@ -2636,6 +2761,23 @@ ClosePostmasterPorts(bool am_syslogger)
 	if (bonjour_sdref)
 		close(DNSServiceRefSockFD(bonjour_sdref));
 #endif
+
+	/* Close our ends of the sockets to idle pre-forked backends */
+	{
+		dlist_iter	iter;
+
+		dlist_foreach(iter, &BackendList)
+		{
+			Backend    *bp = dlist_container(Backend, elem, iter.cur);
+
+			if (bp->prefork_sock != PGINVALID_SOCKET)
+			{
+				closesocket(bp->prefork_sock);
+				bp->prefork_sock = PGINVALID_SOCKET;
+			}
+		}
+		NumIdlePreforkBackends = 0;
+	}
 }
 
 
@@ -3348,9 +3490,7 @@ CleanupBackgroundWorker(int pid,
 
 		/* Get it out of the BackendList and clear out remaining data */
 		dlist_delete(&rw->rw_backend->elem);
-#ifdef EXEC_BACKEND
 		ShmemBackendArrayRemove(rw->rw_backend);
-#endif
 
 		/*
 		 * It's possible that this background worker started some OTHER
@@ -3436,9 +3576,7 @@ CleanupBackend(int pid,
 					HandleChildCrash(pid, exitstatus, _("server process"));
 					return;
 				}
-#ifdef EXEC_BACKEND
 				ShmemBackendArrayRemove(bp);
-#endif
 			}
 			if (bp->bgworker_notify)
 			{
@@ -3452,6 +3590,11 @@ CleanupBackend(int pid,
 				 */
 				BackgroundWorkerStopNotifications(bp->pid);
 			}
+			if (bp->prefork_sock != PGINVALID_SOCKET)
+			{
+				closesocket(bp->prefork_sock);
+				NumIdlePreforkBackends--;
+			}
 			dlist_delete(iter.cur);
 			free(bp);
 			break;
@@ -3506,9 +3649,7 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 			 */
 			(void) ReleasePostmasterChildSlot(rw->rw_child_slot);
 			dlist_delete(&rw->rw_backend->elem);
-#ifdef EXEC_BACKEND
 			ShmemBackendArrayRemove(rw->rw_backend);
-#endif
 			free(rw->rw_backend);
 			rw->rw_backend = NULL;
 			rw->rw_pid = 0;
@@ -3541,9 +3682,12 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 			if (!bp->dead_end)
 			{
 				(void) ReleasePostmasterChildSlot(bp->child_slot);
-#ifdef EXEC_BACKEND
 				ShmemBackendArrayRemove(bp);
-#endif
+			}
+			if (bp->prefork_sock != PGINVALID_SOCKET)
+			{
+				closesocket(bp->prefork_sock);
+				NumIdlePreforkBackends--;
 			}
 			dlist_delete(iter.cur);
 			free(bp);
@@ -4134,9 +4278,14 @@ BackendStartup(Port *port) /// 主进程启动一个子进程
 	/*
 	 * Compute the cancel key that will be assigned to this backend. The
 	 * backend will have its own copy in the forked-off process' value of
-	 * MyCancelKey, so that it can transmit the key to the frontend.
+	 * MyCancelKey, so that it can transmit the key to the frontend.  A
+	 * resumed session keeps the PID and key its client already has.
 	 */
-	if (!RandomCancelKey(&MyCancelKey))
+	bn->session_pid = 0;
+	if (port->parked_session)
+		ParkedSessionCancelKey(port->parked_session, &bn->session_pid,
+							   &MyCancelKey);
+	else if (!RandomCancelKey(&MyCancelKey))
 	{
 		free(bn);
 		ereport(LOG,
@@ -4161,6 +4310,7 @@ BackendStartup(Port *port) /// 主进程启动一个子进程
 
 	/* Hasn't asked to be notified about any bgworkers yet */
 	bn->bgworker_notify = false;
+	bn->prefork_sock = PGINVALID_SOCKET;
 
 #ifdef EXEC_BACKEND
 	pid = backend_forkexec(port);
@@ -4221,10 +4371,8 @@ BackendStartup(Port *port) /// 主进程启动一个子进程
 	bn->bkend_type = BACKEND_TYPE_NORMAL;	/* Can change later to WALSND */
 	dlist_push_head(&BackendList, &bn->elem);
 
-#ifdef EXEC_BACKEND
 	if (!bn->dead_end)
 		ShmemBackendArrayAdd(bn); // 父进程负责账簿登记工作
-#endif
 
 	return STATUS_OK;
 }
@@ -4259,6 +4407,336 @@ report_fork_failure_to_client(Port *port, int errnum)
 	} while (rc < 0 && errno == EINTR);
 }
 
+#ifndef EXEC_BACKEND
+
+/*
+ * HandOffConnection -- pass a new connection to an idle pre-forked backend
+ *
+ * returns: true if a pre-forked backend took the connection; false if there
+ * was none or connections can't be accepted right now, in which case the
+ * caller should start a backend for it the usual way.
+ */
+static bool
+HandOffConnection(Port *port)
+{
+	dlist_iter	iter;
+
+	if (NumIdlePreforkBackends == 0)
+		return false;
+
+	/* Let BackendStartup() do the rejecting, if there's a reason to. */
+	port->canAcceptConnections = canAcceptConnections(BACKEND_TYPE_NORMAL);
+	if (port->canAcceptConnections != CAC_OK)
+		return false;
+
+	dlist_foreach(iter, &BackendList)
+	{
+		Backend    *bp = dlist_container(Backend, elem, iter.cur);
+		struct msghdr msg;
+		struct iovec iov;
+		union
+		{
+			struct cmsghdr hdr;
+			char		buf[CMSG_SPACE(sizeof(pgsocket))];
+		}			cmsgbuf;
+		struct cmsghdr *cmsg;
+		ssize_t		rc;
+
+		if (bp->prefork_sock == PGINVALID_SOCKET)
+			continue;
+
+		/* Send the Port contents, with the client socket attached. */
+		memset(&msg, 0, sizeof(msg));
+		memset(&cmsgbuf, 0, sizeof(cmsgbuf));
+		iov.iov_base = (char *) port;
+		iov.iov_len = sizeof(Port);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgbuf.buf;
+		msg.msg_controllen = sizeof(cmsgbuf.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(pgsocket));
+		memcpy(CMSG_DATA(cmsg), &port->sock, sizeof(pgsocket));
+
+		do
+		{
+			rc = sendmsg(bp->prefork_sock, &msg, 0);
+		} while (rc < 0 && errno == EINTR);
+
+		/*
+		 * Either way, this backend is no longer idle.  If the send failed or
+		 * was short, it will exit on seeing the end of the stream.
+		 */
+		closesocket(bp->prefork_sock);
+		bp->prefork_sock = PGINVALID_SOCKET;
+		NumIdlePreforkBackends--;
+
+		if (rc == sizeof(Port))
+		{
+			ereport(DEBUG2,
+					(errmsg_internal("handed connection to pre-forked backend, pid=%d socket=%d",
+									 (int) bp->pid, (int) port->sock)));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * MaintainPreforkBackends -- start or stop idle pre-forked backends
+ *
+ * Keeps prefork_backends of them around while connections can be accepted,
+ * and none otherwise, so they don't hold up a smart shutdown.  Backends we
+ * don't need anymore exit when we close our end of their socket.
+ */
+static void
+MaintainPreforkBackends(void)
+{
+	CAC_state	cac;
+	int			target;
+	int			nidle = 0;
+	dlist_iter	iter;
+
+	if (prefork_backends == 0 && NumIdlePreforkBackends == 0)
+		return;
+
+	/*
+	 * Having too many children isn't a reason to get rid of the ones that are
+	 * ready for the next connection.
+	 */
+	cac = canAcceptConnections(BACKEND_TYPE_NORMAL);
+	if (cac == CAC_OK || cac == CAC_TOOMANY)
+		target = Min(prefork_backends, MaxConnections);
+	else
+		target = 0;
+
+	dlist_foreach(iter, &BackendList)
+	{
+		Backend    *bp = dlist_container(Backend, elem, iter.cur);
+
+		if (bp->prefork_sock == PGINVALID_SOCKET)
+			continue;
+		if (nidle < target)
+			nidle++;
+		else
+		{
+			closesocket(bp->prefork_sock);
+			bp->prefork_sock = PGINVALID_SOCKET;
+			NumIdlePreforkBackends--;
+		}
+	}
+
+	while (nidle < target &&
+		   canAcceptConnections(BACKEND_TYPE_NORMAL) == CAC_OK &&
+		   StartPreforkBackend())
+		nidle++;
+}
+
+/*
+ * StartPreforkBackend -- start a backend that waits for a connection
+ *
+ * This does everything BackendStartup() does ahead of time, except for what
+ * depends on the connection itself, which is then done by the child once it
+ * receives it from HandOffConnection().
+ *
+ * returns: false if the fork failed.
+ */
+static bool
+StartPreforkBackend(void)
+{
+	Backend    *bn;
+	pgsocket	socks[2];
+	pid_t		pid;
+
+	bn = (Backend *) malloc(sizeof(Backend));
+	if (!bn)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+		return false;
+	}
+
+	if (!RandomCancelKey(&MyCancelKey))
+	{
+		free(bn);
+		ereport(LOG,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("could not generate random cancel key")));
+		return false;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) < 0)
+	{
+		free(bn);
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket pair for pre-forked backend: %m")));
+		return false;
+	}
+
+	/* The postmaster must never block on it */
+	if (!pg_set_noblock(socks[0]))
+	{
+		closesocket(socks[0]);
+		closesocket(socks[1]);
+		free(bn);
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not set socket to nonblocking mode: %m")));
+		return false;
+	}
+
+	bn->cancel_key = MyCancelKey;
+	bn->dead_end = false;
+	bn->child_slot = MyPMChildSlot = AssignPostmasterChildSlot();
+	bn->bgworker_notify = false;
+	bn->prefork_sock = socks[0];
+	bn->session_pid = 0;
+
+	pid = fork_process();
+	if (pid == 0)				/* child */
+	{
+		Port	   *port;
+
+		free(bn);
+
+		/* Detangle from postmaster */
+		InitPostmasterChild();
+
+		/* Close the postmaster's sockets */
+		ClosePostmasterPorts(false);
+		closesocket(socks[0]);
+
+		/* Wait for a connection */
+		port = PreforkBackendWait(socks[1]);
+		closesocket(socks[1]);
+
+		/* The connection, rather than the fork, starts this backend */
+		InitProcessGlobals();
+
+		/* From here on, same as BackendStartup() */
+		BackendInitialize(port);
+		InitProcess();
+		BackendRun(port);
+	}
+
+	closesocket(socks[1]);
+
+	if (pid < 0)
+	{
+		/* in parent, fork failed */
+		int			save_errno = errno;
+
+		(void) ReleasePostmasterChildSlot(bn->child_slot);
+		closesocket(socks[0]);
+		free(bn);
+		errno = save_errno;
+		ereport(LOG,
+				(errmsg("could not fork pre-forked backend: %m")));
+		return false;
+	}
+
+	/* in parent, successful fork */
+	ereport(DEBUG2,
+			(errmsg_internal("forked new pre-forked backend, pid=%d",
+							 (int) pid)));
+
+	bn->pid = pid;
+	bn->bkend_type = BACKEND_TYPE_NORMAL;
+	dlist_push_head(&BackendList, &bn->elem);
+	ShmemBackendArrayAdd(bn);
+	NumIdlePreforkBackends++;
+
+	return true;
+}
+
+/*
+ * PreforkBackendWait -- in a pre-forked backend, wait for a connection
+ *
+ * Returns the Port sent by HandOffConnection(), with the client socket we
+ * received filled in.  Exits if the postmaster closes its end first.
+ */
+static Port *
+PreforkBackendWait(pgsocket sock)
+{
+	Port	   *port;
+	size_t		received = 0;
+	pgsocket	client_sock = PGINVALID_SOCKET;
+
+	if (!(port = (Port *) calloc(1, sizeof(Port))))
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	/*
+	 * We haven't touched shared memory, so SIGTERM can just make us exit;
+	 * see BackendInitialize().
+	 */
+	pqsignal(SIGTERM, process_startup_packet_die);
+	sigprocmask(SIG_SETMASK, &StartupBlockSig, NULL);
+
+	while (received < sizeof(Port))
+	{
+		struct msghdr msg;
+		struct iovec iov;
+		union
+		{
+			struct cmsghdr hdr;
+			char		buf[CMSG_SPACE(sizeof(pgsocket))];
+		}			cmsgbuf;
+		struct cmsghdr *cmsg;
+		ssize_t		rc;
+
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = (char *) port + received;
+		iov.iov_len = sizeof(Port) - received;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgbuf.buf;
+		msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+		rc = recvmsg(sock, &msg, 0);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(FATAL,
+					(errcode_for_socket_access(),
+					 errmsg("could not receive connection from postmaster: %m")));
+		}
+		if (rc == 0)
+		{
+			/* The postmaster doesn't need us anymore */
+			if (client_sock != PGINVALID_SOCKET)
+				closesocket(client_sock);
+			proc_exit(0);
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+			 cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+				cmsg->cmsg_type == SCM_RIGHTS)
+				memcpy(&client_sock, CMSG_DATA(cmsg), sizeof(pgsocket));
+		}
+		received += rc;
+	}
+
+	sigprocmask(SIG_SETMASK, &BlockSig, NULL);
+
+	if (client_sock == PGINVALID_SOCKET)
+		ereport(FATAL,
+				(errmsg_internal("no client socket received from postmaster")));
+	port->sock = client_sock;
+
+	return port;
+}
+
+#endif							/* !EXEC_BACKEND */
 
 /*
  * BackendInitialize -- initialize an interactive (postmaster-child)
@@ -4287,6 +4765,9 @@ BackendInitialize(Port *port)
 	/* Tell fd.c about the long-lived FD associated with the port */
 	ReserveExternalFD();
 
+	/* Backends only ever send to the session keeper */
+	SessionKeeperCloseKeeperSocket();
+
 	/*
 	 * PreAuthDelay is a debugging aid for investigating problems in the
 	 * authentication cycle: it can be set in postgresql.conf to allow time to
@@ -4397,9 +4878,12 @@ BackendInitialize(Port *port)
 
 	/*
 	 * Receive the startup packet (which might turn out to be a cancel request
-	 * packet).
+	 * packet).  A resumed session has its descriptor instead.
 	 */
-	status = ProcessStartupPacket(port, false, false);
+	if (port->parked_session)
+		status = RestoreParkedSession(port);
+	else
+		status = ProcessStartupPacket(port, false, false);
 
 	/*
 	 * Disable the timeout, and prevent SIGTERM again.
@@ -5472,15 +5956,15 @@ StartAutovacuumWorker(void)
 			bn->dead_end = false;
 			bn->child_slot = MyPMChildSlot = AssignPostmasterChildSlot();
 			bn->bgworker_notify = false;
+			bn->prefork_sock = PGINVALID_SOCKET;
+			bn->session_pid = 0;
 
 			bn->pid = StartAutoVacWorker();
 			if (bn->pid > 0)
 			{
 				bn->bkend_type = BACKEND_TYPE_AUTOVAC;
 				dlist_push_head(&BackendList, &bn->elem);
-#ifdef EXEC_BACKEND
 				ShmemBackendArrayAdd(bn);
-#endif
 				/* all OK */
 				return;
 			}
@@ -5582,7 +6066,7 @@ CreateOptsFile(int argc, char *argv[], char *fullprogname)
  * MaxLivePostmasterChildren
  *
  * This reports the number of entries needed in per-child-process arrays
- * (the PMChildFlags array, and if EXEC_BACKEND the ShmemBackendArray).
+ * (the PMChildFlags array and the ShmemBackendArray).
  * These arrays include regular backends, autovac workers, walsenders
  * and background workers, but not special children nor dead_end children.
  * This allows the arrays to have a fixed maximum size, to wit the same
@@ -5774,9 +6258,7 @@ do_start_bgworker(RegisteredBgWorker *rw)
 			ReportBackgroundWorkerPID(rw);
 			/* add new worker to lists of backends */
 			dlist_push_head(&BackendList, &rw->rw_backend->elem);
-#ifdef EXEC_BACKEND
 			ShmemBackendArrayAdd(rw->rw_backend);
-#endif
 			return true;
 	}
 
@@ -5875,6 +6357,8 @@ assign_backendlist_entry(RegisteredBgWorker *rw)
 	bn->bkend_type = BACKEND_TYPE_BGWORKER;
 	bn->dead_end = false;
 	bn->bgworker_notify = false;
+	bn->prefork_sock = PGINVALID_SOCKET;
+	bn->session_pid = 0;
 
 	rw->rw_backend = bn;
 	rw->rw_child_slot = bn->child_slot;
@@ -6107,6 +6591,9 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->max_safe_fds = max_safe_fds;
 
 	param->MaxBackends = MaxBackends;
+	param->FastPathLockGroupsPerBackend = FastPathLockGroupsPerBackend;
+	param->NumLockPartitions = NumLockPartitions;
+	param->Log2NumLockPartitions = Log2NumLockPartitions;
 
 #ifdef WIN32
 	param->PostmasterHandle = PostmasterHandle;
@@ -6340,6 +6827,9 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	max_safe_fds = param->max_safe_fds;
 
 	MaxBackends = param->MaxBackends;
+	FastPathLockGroupsPerBackend = param->FastPathLockGroupsPerBackend;
+	NumLockPartitions = param->NumLockPartitions;
+	Log2NumLockPartitions = param->Log2NumLockPartitions;
 
 #ifdef WIN32
 	PostmasterHandle = param->PostmasterHandle;
@@ -6368,6 +6858,8 @@ restore_backend_variables(BackendParameters *param, Port *port)
 #endif
 }
 
+#endif							/* EXEC_BACKEND */
+
 
 Size
 ShmemBackendArraySize(void) /// 计算数组的大小
@@ -6404,7 +6896,6 @@ ShmemBackendArrayRemove(Backend *bn)
 	/* Mark the slot as empty */
 	ShmemBackendArray[i].pid = 0; /// 简单地把pid变成0就可以了。
 }
-#endif							/* EXEC_BACKEND */
 
 
 #ifdef WIN32
@@ -0,0 +1,783 @@
+/*-------------------------------------------------------------------------
+ *
+ * sessionkeeper.c
+ *
+ * Parks idle sessions, so that they don't hold a backend while their client
+ * isn't sending anything, and resumes them in a new backend when it does.
+ *
+ * With session_parking enabled, a backend whose session has stayed idle
+ * outside a transaction for session_park_timeout, and holds no state that a
+ * new backend couldn't rebuild from the startup packet, sends the client
+ * socket and a description of the session ("the session descriptor") to the
+ * session keeper, and exits.  The session keeper is a background worker that
+ * does nothing but wait for parked clients to send something.  When one
+ * does, it passes the socket and descriptor on to the postmaster, which
+ * forks a backend for it as for a new connection.  That backend takes the
+ * database, user and options from the descriptor instead of a startup
+ * packet, and doesn't authenticate the client again, nor greet it; the
+ * client just sees the answer to the query it sent.  The session keeps the
+ * cancel key the client got when it first connected.
+ *
+ * State a session can't be parked with: an open transaction, prepared
+ * statements, open cursors, temporary tables, LISTEN, session-level locks
+ * and options changed with SET.  Sessions using SSL, GSSAPI encryption or
+ * protocol compression aren't parked either, since their stream state can't
+ * be handed over.  What's lost on parking is state nobody tracks, such as
+ * the values currval() would return and anything extensions keep per
+ * session.
+ *
+ * The postmaster, the session keeper and backends talk over one datagram
+ * socket pair, created at startup.  Backends send parked sessions to the
+ * session keeper's end, and the session keeper sends them back to be resumed,
+ * which only the postmaster reads.  Each message is the session descriptor,
+ * with the client socket attached.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/postmaster/sessionkeeper.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "commands/async.h"
+#include "commands/prepare.h"
+#include "lib/stringinfo.h"
+#include "libpq/libpq.h"
+#include "libpq/pqcomm.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "postmaster/sessionkeeper.h"
+#include "replication/walsender.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lock.h"
+#include "storage/pmsignal.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/portal.h"
+#include "utils/timestamp.h"
+
+/* GUCs */
+bool		session_parking = false;
+int			session_park_timeout = 60000;
+
+/*
+ * Header of a session descriptor.  It's followed by the serialized
+ * ClientConnectionInfo, conninfo_len bytes, and then by the database name,
+ * user name, command-line options and application name, and the name and
+ * value of each option from the startup packet, as null-terminated strings.
+ * An empty option name ends the list.
+ */
+typedef struct ParkedSessionHeader
+{
+	uint32		magic;
+	int32		cancel_pid;		/* PID the client sends cancel requests for */
+	int32		cancel_key;
+	ProtocolVersion proto;
+	int32		conninfo_len;
+} ParkedSessionHeader;
+
+#define PARKED_SESSION_MAGIC	0x50534B31	/* "PSK1" */
+
+/* Largest session descriptor we send or accept */
+#define PARKED_SESSION_MAX_SIZE (MAX_STARTUP_PACKET_LENGTH + 2048)
+
+/* A session parked in the session keeper */
+typedef struct ParkedSession
+{
+	pgsocket	sock;			/* client socket, PGINVALID_SOCKET if gone */
+	char	   *session;		/* session descriptor */
+	int			session_len;
+} ParkedSession;
+
+/*
+ * The socket pair; [0] is the session keeper's end, [1] the postmaster's.
+ * Both are PGINVALID_SOCKET unless session parking is enabled.
+ */
+static pgsocket SessionKeeperSockets[2] = {PGINVALID_SOCKET, PGINVALID_SOCKET};
+
+/* The PID the client of a resumed session knows it by, or 0 */
+static int	session_cancel_pid = 0;
+
+/* Serialized ClientConnectionInfo of a resumed session */
+static char *session_conninfo = NULL;
+
+static bool SessionCanPark(void);
+static bool WaitForParkTimeout(void);
+static ssize_t send_session(pgsocket sock, const char *session,
+							size_t len, pgsocket client);
+static ssize_t recv_session(pgsocket sock, char *buf, size_t size,
+							pgsocket *client);
+static const char *read_session_string(const char **ptr, const char *end);
+
+
+/*
+ * Create the socket pair, in the postmaster at startup.
+ */
+void
+SessionKeeperInit(void)
+{
+	int			socks[2];
+
+	if (!session_parking)
+		return;
+
+#ifdef EXEC_BACKEND
+	/* A Port can't carry the session descriptor through exec() */
+	ereport(WARNING,
+			(errmsg("session parking is not supported on this platform")));
+	return;
+#endif
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, socks) < 0)
+		ereport(FATAL,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket pair for session keeper: %m")));
+
+	SessionKeeperSockets[0] = socks[0];
+	SessionKeeperSockets[1] = socks[1];
+}
+
+/*
+ * Register the session keeper, in the postmaster at startup.
+ */
+void
+SessionKeeperRegister(void)
+{
+	BackgroundWorker bgw;
+
+	if (SessionKeeperSockets[0] == PGINVALID_SOCKET)
+		return;
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	bgw.bgw_start_time = BgWorkerStart_PostmasterStart;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "SessionKeeperMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN, "session keeper");
+	snprintf(bgw.bgw_type, BGW_MAXLEN, "session keeper");
+
+	/*
+	 * Restart it after a crash; sessions parked in the meantime wait in the
+	 * socket pair until it's back.
+	 */
+	bgw.bgw_restart_time = 5;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = (Datum) 0;
+
+	RegisterBackgroundWorker(&bgw);
+}
+
+/*
+ * The socket the postmaster receives sessions to resume on, to wait for.
+ */
+pgsocket
+SessionKeeperPostmasterSocket(void)
+{
+	return SessionKeeperSockets[1];
+}
+
+/*
+ * Receive a session to resume, in the postmaster.
+ *
+ * Returns false if there is none.  Otherwise the client socket is returned
+ * in *sock, and a malloc'd copy of the session descriptor in *session.
+ */
+bool
+SessionKeeperReceive(pgsocket *sock, char **session, int *session_len)
+{
+	static char buf[PARKED_SESSION_MAX_SIZE];
+
+	for (;;)
+	{
+		ssize_t		rc;
+
+		rc = recv_session(SessionKeeperSockets[1], buf, sizeof(buf), sock);
+		if (rc < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				ereport(LOG,
+						(errcode_for_socket_access(),
+						 errmsg("could not receive session from session keeper: %m")));
+			return false;
+		}
+
+		if (*sock == PGINVALID_SOCKET || rc < sizeof(ParkedSessionHeader))
+		{
+			ereport(LOG,
+					(errmsg("invalid session received from session keeper")));
+			if (*sock != PGINVALID_SOCKET)
+				closesocket(*sock);
+			continue;
+		}
+
+		if (!(*session = malloc(rc)))
+		{
+			ereport(LOG,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+			closesocket(*sock);
+			return false;
+		}
+		memcpy(*session, buf, rc);
+		*session_len = (int) rc;
+
+		return true;
+	}
+}
+
+/*
+ * Get the PID and cancel key a resumed session's client knows.
+ */
+void
+ParkedSessionCancelKey(const char *session, int *pid, int32 *cancel_key)
+{
+	ParkedSessionHeader hdr;
+
+	memcpy(&hdr, session, sizeof(hdr));
+	*pid = hdr.cancel_pid;
+	*cancel_key = hdr.cancel_key;
+}
+
+/*
+ * Close the session keeper's end of the socket pair, in a backend.
+ */
+void
+SessionKeeperCloseKeeperSocket(void)
+{
+	if (SessionKeeperSockets[0] != PGINVALID_SOCKET)
+	{
+		closesocket(SessionKeeperSockets[0]);
+		SessionKeeperSockets[0] = PGINVALID_SOCKET;
+	}
+}
+
+/*
+ * Set up a resumed session from its descriptor, in place of reading a
+ * startup packet; see ProcessStartupPacket().
+ */
+int
+RestoreParkedSession(Port *port)
+{
+	ParkedSessionHeader hdr;
+	const char *ptr = port->parked_session;
+	const char *end = ptr + port->parked_session_len;
+	const char *application_name;
+	MemoryContext oldcontext;
+
+	memcpy(&hdr, ptr, sizeof(hdr));
+	ptr += sizeof(hdr);
+	if (hdr.magic != PARKED_SESSION_MAGIC ||
+		hdr.conninfo_len < 0 || hdr.conninfo_len > end - ptr)
+		elog(FATAL, "invalid parked session descriptor");
+
+	/* Everything must survive into PostgresMain, like the startup packet's */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	session_conninfo = palloc(hdr.conninfo_len);
+	memcpy(session_conninfo, ptr, hdr.conninfo_len);
+	ptr += hdr.conninfo_len;
+
+	port->database_name = pstrdup(read_session_string(&ptr, end));
+	port->user_name = pstrdup(read_session_string(&ptr, end));
+	port->cmdline_options = pstrdup(read_session_string(&ptr, end));
+	application_name = read_session_string(&ptr, end);
+	if (application_name[0] != '\0')
+		port->application_name = pstrdup(application_name);
+
+	port->guc_options = NIL;
+	for (;;)
+	{
+		const char *name = read_session_string(&ptr, end);
+
+		if (name[0] == '\0')
+			break;
+		port->guc_options = lappend(port->guc_options, pstrdup(name));
+		port->guc_options = lappend(port->guc_options,
+									pstrdup(read_session_string(&ptr, end)));
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	port->proto = FrontendProtocol = hdr.proto;
+	session_cancel_pid = hdr.cancel_pid;
+	MyBackendType = B_BACKEND;
+
+	if (port->canAcceptConnections == CAC_TOOMANY)
+		ereport(FATAL,
+				(errcode(ERRCODE_TOO_MANY_CONNECTIONS),
+				 errmsg("sorry, too many clients already")));
+	else if (port->canAcceptConnections != CAC_OK)
+		ereport(FATAL,
+				(errcode(ERRCODE_CANNOT_CONNECT_NOW),
+				 errmsg("the database system is not accepting connections")));
+
+	return STATUS_OK;
+}
+
+/*
+ * Restore what authentication established when the client of a resumed
+ * session first connected, in place of authenticating it again.
+ */
+void
+RestoreParkedSessionAuthentication(Port *port)
+{
+	Assert(session_conninfo != NULL);
+
+	RestoreClientConnectionInfo(session_conninfo);
+	pfree(session_conninfo);
+	session_conninfo = NULL;
+
+	ereport(DEBUG1,
+			(errmsg_internal("resumed parked session: user=%s database=%s",
+							 port->user_name, port->database_name)));
+}
+
+/*
+ * Park the session if it stays idle for session_park_timeout, in a backend
+ * that has reached idle state outside a transaction and is about to wait for
+ * the next command.  Does not return if the session was parked.
+ */
+void
+ParkSessionIfIdle(void)
+{
+	Port	   *port = MyProcPort;
+	ParkedSessionHeader hdr;
+	StringInfoData buf;
+	Size		conninfo_len;
+	ListCell   *lc;
+
+	if (!session_parking || session_park_timeout <= 0 ||
+		SessionKeeperSockets[1] == PGINVALID_SOCKET)
+		return;
+
+	if (!SessionCanPark() || !WaitForParkTimeout())
+		return;
+
+	/* The wait might have processed interrupts; check again. */
+	if (!SessionCanPark())
+		return;
+
+	conninfo_len = EstimateClientConnectionInfoSpace();
+
+	hdr.magic = PARKED_SESSION_MAGIC;
+	hdr.cancel_pid = session_cancel_pid ? session_cancel_pid : MyProcPid;
+	hdr.cancel_key = MyCancelKey;
+	hdr.proto = FrontendProtocol;
+	hdr.conninfo_len = (int32) conninfo_len;
+
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, &hdr, sizeof(hdr));
+	enlargeStringInfo(&buf, conninfo_len);
+	SerializeClientConnectionInfo(conninfo_len, buf.data + buf.len);
+	buf.len += conninfo_len;
+
+	appendBinaryStringInfo(&buf, port->database_name,
+						   strlen(port->database_name) + 1);
+	appendBinaryStringInfo(&buf, port->user_name,
+						   strlen(port->user_name) + 1);
+	appendBinaryStringInfo(&buf, port->cmdline_options ? port->cmdline_options : "",
+						   strlen(port->cmdline_options ? port->cmdline_options : "") + 1);
+	appendBinaryStringInfo(&buf, port->application_name ? port->application_name : "",
+						   strlen(port->application_name ? port->application_name : "") + 1);
+	foreach(lc, port->guc_options)
+	{
+		const char *str = (const char *) lfirst(lc);
+
+		appendBinaryStringInfo(&buf, str, strlen(str) + 1);
+	}
+	appendStringInfoChar(&buf, '\0');
+
+	if (buf.len > PARKED_SESSION_MAX_SIZE)
+	{
+		pfree(buf.data);
+		return;
+	}
+
+	/* If the session keeper can't take it right now, stay. */
+	if (send_session(SessionKeeperSockets[1], buf.data, buf.len,
+					 port->sock) != buf.len)
+	{
+		ereport(DEBUG1,
+				(errmsg_internal("could not park session: %m")));
+		pfree(buf.data);
+		return;
+	}
+
+	ereport(DEBUG1,
+			(errmsg_internal("parked session after %d ms idle",
+							 session_park_timeout)));
+
+	/* The client belongs to the session keeper now; don't talk to it. */
+	whereToSendOutput = DestNone;
+	proc_exit(0);
+}
+
+/*
+ * Does the session hold only state that a new backend rebuilds by itself?
+ */
+static bool
+SessionCanPark(void)
+{
+	Port	   *port = MyProcPort;
+	Oid			tempNamespaceId;
+	Oid			tempToastNamespaceId;
+
+	if (port == NULL || am_walsender || whereToSendOutput != DestRemote)
+		return false;
+
+	/* Stream state we can't hand over */
+	if (port->ssl_in_use ||
+		port->compression_algorithm != PG_COMPRESSION_NONE)
+		return false;
+#ifdef ENABLE_GSS
+	if (port->gss && be_gssapi_get_enc(port))
+		return false;
+#endif
+
+	/* Input the client already sent */
+	if (pq_buffer_has_data())
+		return false;
+
+	if (IsTransactionOrTransactionBlock())
+		return false;
+
+	GetTempNamespaceState(&tempNamespaceId, &tempToastNamespaceId);
+	if (OidIsValid(tempNamespaceId))
+		return false;
+
+	return !HavePreparedStatements() &&
+		!HavePortals() &&
+		!IsListeningOnAnyChannel() &&
+		!AnyLocksHeld() &&
+		!AnyOptionsSetInSession();
+}
+
+/*
+ * Wait for session_park_timeout, or for the client to send something,
+ * processing interrupts meanwhile as ReadCommand() would.  Returns true if
+ * the timeout was reached.
+ */
+static bool
+WaitForParkTimeout(void)
+{
+	TimestampTz deadline;
+
+	deadline = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+										   session_park_timeout);
+
+	ModifyWaitEvent(FeBeWaitSet, FeBeWaitSetSocketPos, WL_SOCKET_READABLE,
+					NULL);
+
+	for (;;)
+	{
+		WaitEvent	event;
+		long		timeout;
+
+		timeout = TimestampDifferenceMilliseconds(GetCurrentTimestamp(),
+												  deadline);
+		if (timeout <= 0)
+			return true;
+
+		if (WaitEventSetWait(FeBeWaitSet, timeout, &event, 1,
+							 WAIT_EVENT_CLIENT_READ) == 0)
+			continue;
+
+		if (event.events & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+			ProcessClientReadInterrupt(true);
+			continue;
+		}
+
+		/* Client input, or postmaster death; leave those to ReadCommand() */
+		return false;
+	}
+}
+
+/*
+ * Main entry point of the session keeper.
+ */
+void
+SessionKeeperMain(Datum main_arg)
+{
+	ParkedSession *parked;
+	int			nparked = 0;
+	int			maxparked = 64;
+	struct pollfd *fds;
+	bool		resume_blocked = false;
+	pgsocket	keeper_sock = SessionKeeperSockets[0];
+	char	   *buf;
+
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	BackgroundWorkerUnblockSignals();
+
+	/* Only the postmaster reads the other end. */
+	closesocket(SessionKeeperSockets[1]);
+	SessionKeeperSockets[1] = PGINVALID_SOCKET;
+
+	if (keeper_sock == PGINVALID_SOCKET)
+		proc_exit(0);
+
+	parked = palloc(sizeof(ParkedSession) * maxparked);
+	fds = palloc(sizeof(struct pollfd) * (maxparked + 1));
+	buf = palloc(PARKED_SESSION_MAX_SIZE);
+
+	while (!ShutdownRequestPending)
+	{
+		int			nfds;
+		int			rc;
+		int			i;
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (!PostmasterIsAlive())
+			proc_exit(1);
+
+		/*
+		 * Wait for new sessions to park and for parked clients to send
+		 * something, or, if the postmaster isn't taking sessions to resume
+		 * right now, only until it does.  Signals interrupt poll(), and the
+		 * timeout bounds the delay if one arrives before we get there.
+		 */
+		fds[0].fd = keeper_sock;
+		fds[0].events = POLLIN | (resume_blocked ? POLLOUT : 0);
+		fds[0].revents = 0;
+		nfds = 1;
+		if (!resume_blocked)
+		{
+			for (i = 0; i < nparked; i++)
+			{
+				fds[nfds].fd = parked[i].sock;
+				fds[nfds].events = POLLIN;
+				fds[nfds].revents = 0;
+				nfds++;
+			}
+		}
+
+		rc = poll(fds, nfds, 1000);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(FATAL,
+					(errcode_for_socket_access(),
+					 errmsg("%s() failed: %m", "poll")));
+		}
+
+		if (fds[0].revents & POLLOUT)
+			resume_blocked = false;
+
+		/* Resume the sessions whose clients sent something, or drop them */
+		for (i = 1; i < nfds && !resume_blocked; i++)
+		{
+			ParkedSession *ps = &parked[i - 1];
+			char		c;
+			ssize_t		n;
+
+			if (fds[i].revents == 0)
+				continue;
+
+			n = recv(ps->sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+						  errno == EINTR))
+				continue;
+
+			if (n > 0 &&
+				send_session(keeper_sock, ps->session, ps->session_len,
+							 ps->sock) < 0)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+					resume_blocked = true;
+					continue;
+				}
+				ereport(LOG,
+						(errcode_for_socket_access(),
+						 errmsg("could not send session to postmaster: %m")));
+			}
+
+			/* Resumed, or the client went away */
+			closesocket(ps->sock);
+			ps->sock = PGINVALID_SOCKET;
+			pfree(ps->session);
+		}
+
+		/* Forget the sessions we are done with */
+		for (i = 0; i < nparked;)
+		{
+			if (parked[i].sock == PGINVALID_SOCKET)
+				parked[i] = parked[--nparked];
+			else
+				i++;
+		}
+
+		/* Take in new sessions */
+		if (fds[0].revents & POLLIN)
+		{
+			for (;;)
+			{
+				pgsocket	client;
+				ssize_t		n;
+
+				n = recv_session(keeper_sock, buf, PARKED_SESSION_MAX_SIZE,
+								 &client);
+				if (n < 0)
+				{
+					if (errno != EAGAIN && errno != EWOULDBLOCK)
+						ereport(LOG,
+								(errcode_for_socket_access(),
+								 errmsg("could not receive parked session: %m")));
+					break;
+				}
+				if (client == PGINVALID_SOCKET)
+					continue;
+
+				if (nparked == maxparked)
+				{
+					maxparked *= 2;
+					parked = repalloc(parked, sizeof(ParkedSession) * maxparked);
+					fds = repalloc(fds, sizeof(struct pollfd) * (maxparked + 1));
+				}
+				parked[nparked].sock = client;
+				parked[nparked].session = palloc(n);
+				memcpy(parked[nparked].session, buf, n);
+				parked[nparked].session_len = (int) n;
+				nparked++;
+			}
+		}
+	}
+
+	/*
+	 * Shutting down.  The parked clients see their connection closed, as
+	 * they would if their backends had exited.
+	 */
+	proc_exit(0);
+}
+
+/*
+ * Send a session descriptor with the client socket attached, without
+ * blocking.  Returns the number of bytes sent, or -1 with errno set.
+ */
+static ssize_t
+send_session(pgsocket sock, const char *session, size_t len, pgsocket client)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union
+	{
+		struct cmsghdr hdr;
+		char		buf[CMSG_SPACE(sizeof(pgsocket))];
+	}			cmsgbuf;
+	struct cmsghdr *cmsg;
+	ssize_t		rc;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&cmsgbuf, 0, sizeof(cmsgbuf));
+	iov.iov_base = unconstify(char *, session);
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(pgsocket));
+	memcpy(CMSG_DATA(cmsg), &client, sizeof(pgsocket));
+
+	do
+	{
+		rc = sendmsg(sock, &msg, MSG_DONTWAIT);
+	} while (rc < 0 && errno == EINTR);
+
+	return rc;
+}
+
+/*
+ * Receive a session descriptor and the client socket attached to it, without
+ * blocking.  Returns the length of the descriptor, or -1 with errno set.
+ * *client is PGINVALID_SOCKET if the message was truncated or had no socket
+ * attached; the caller should skip it then.
+ */
+static ssize_t
+recv_session(pgsocket sock, char *buf, size_t size, pgsocket *client)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	union
+	{
+		struct cmsghdr hdr;
+		char		buf[CMSG_SPACE(sizeof(pgsocket))];
+	}			cmsgbuf;
+	struct cmsghdr *cmsg;
+	ssize_t		rc;
+
+	*client = PGINVALID_SOCKET;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf.buf;
+	msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+	do
+	{
+		rc = recvmsg(sock, &msg, MSG_DONTWAIT);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc < 0)
+		return rc;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+		 cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_RIGHTS)
+			memcpy(client, CMSG_DATA(cmsg), sizeof(pgsocket));
+	}
+
+	if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) &&
+		*client != PGINVALID_SOCKET)
+	{
+		closesocket(*client);
+		*client = PGINVALID_SOCKET;
+	}
+
+	return rc;
+}
+
+/*
+ * Read a null-terminated string from a session descriptor.
+ */
+static const char *
+read_session_string(const char **ptr, const char *end)
+{
+	const char *str = *ptr;
+	size_t		len = strnlen(str, end - str);
+
+	if (len == end - str)
+		elog(FATAL, "invalid parked session descriptor");
+	*ptr += len + 1;
+
+	return str;
+}
@@ -34,6 +34,7 @@
 #include "storage/pmsignal.h"
 #include "storage/procsignal.h"
 #include "storage/standby.h"
+#include "utils/backend_memory.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/timeout.h"
@@ -221,6 +222,10 @@ HandleStartupProcInterrupts(void)
 	/* Perform logging of memory contexts of this process */
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
+
+	/* Publish our largest memory contexts if asked to */
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
 }
 
 
@@ -58,6 +58,7 @@
 #include "storage/proc.h"
 #include "storage/procsignal.h"
 #include "storage/smgr.h"
+#include "utils/backend_memory.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
 #include "utils/memutils.h"
@@ -225,6 +226,7 @@ WalWriterMain(void)
 	for (;;)
 	{
 		long		cur_timeout;
+		bool		did_work;
 
 		/*
 		 * Advertise whether we might hibernate in this cycle.  We do this
@@ -248,10 +250,14 @@ WalWriterMain(void)
 		HandleWalWriterInterrupts();
 
 		/*
-		 * Do what we're here for; then, if XLogBackgroundFlush() found useful
-		 * work to do, reset hibernation counter.
+		 * Do what we're here for, and prepare WAL buffer pages for the
+		 * inserters; then, if either found useful work to do, reset
+		 * hibernation counter.
 		 */
-		if (XLogBackgroundFlush()) // 这里是主力函数，做了真正的工作
+		did_work = XLogBackgroundFlush(); // 这里是主力函数，做了真正的工作
+		if (XLogInitAheadWALBuffers())
+			did_work = true;
+		if (did_work)
 			left_till_hibernate = LOOPS_UNTIL_HIBERNATE;
 		else if (left_till_hibernate > 0)
 			left_till_hibernate--;
@@ -297,4 +303,8 @@ HandleWalWriterInterrupts(void)
 	/* Perform logging of memory contexts of this process */
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
+
+	/* Publish our largest memory contexts if asked to */
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
 }
@@ -20,6 +20,7 @@
 #include <sys/time.h>
 
 #include "access/xlog.h"
+#include "access/xlogcompress.h"
 #include "catalog/pg_type.h"
 #include "common/connect.h"
 #include "funcapi.h"
@@ -106,6 +107,7 @@ static WalReceiverFunctionsType PQWalReceiverFunctions = /// 写死了函数指
 static PGresult *libpqrcv_PQexec(PGconn *streamConn, const char *query);
 static PGresult *libpqrcv_PQgetResult(PGconn *streamConn);
 static char *stringlist_to_identifierstr(PGconn *conn, List *strings);
+static char *libpqrcv_compression_options(const char *conninfo);
 
 /*
  * Module initialization function
@@ -157,6 +159,12 @@ libpqrcv_connect(const char *conninfo, bool logical, bool must_use_password,
 	}
 	keys[++i] = "fallback_application_name";
 	vals[i] = appname;
+	if (!logical && wal_receiver_compression != WAL_COMPRESSION_NONE)
+	{
+		/* Ask the primary to compress the WAL it sends */
+		keys[++i] = "options";
+		vals[i] = libpqrcv_compression_options(conninfo);
+	}
 	if (logical)
 	{
 		/* Tell the publisher to translate to our encoding */
@@ -231,6 +239,41 @@ bad_connection:
 	return NULL;
 }
 
+/*
+ * Build the value of the "options" connection parameter asking the primary
+ * to compress the WAL it streams to us with wal_receiver_compression, in
+ * addition to any options given in the connection string.
+ */
+static char *
+libpqrcv_compression_options(const char *conninfo)
+{
+	PQconninfoOption *opts;
+	const char *useroptions = NULL;
+	char	   *result;
+
+	/* if this fails, connecting will fail too and report the problem */
+	opts = PQconninfoParse(conninfo, NULL);
+	if (opts != NULL)
+	{
+		for (PQconninfoOption *opt = opts; opt->keyword != NULL; opt++)
+		{
+			if (strcmp(opt->keyword, "options") == 0 && opt->val != NULL &&
+				opt->val[0] != '\0')
+				useroptions = opt->val;
+		}
+	}
+
+	result = psprintf("%s%s-c wal_sender_compression=%s",
+					  useroptions ? useroptions : "",
+					  useroptions ? " " : "",
+					  XLogCompressionName((WalCompression) wal_receiver_compression));
+
+	if (opts != NULL)
+		PQconninfoFree(opts);
+
+	return result;
+}
+
 /*
  * Validate connection info string, and determine whether it might cause
  * local filesystem access to be attempted.
@@ -493,6 +536,10 @@ libpqrcv_startstreaming(WalReceiverConn *conn,
 			PQserverVersion(conn->streamConn) >= 140000)
 			appendStringInfoString(&cmd, ", binary 'true'");
 
+		if (options->proto.logical.row_batches &&
+			PQserverVersion(conn->streamConn) >= 160000)
+			appendStringInfoString(&cmd, ", row_batches 'on'");
+
 		appendStringInfoChar(&cmd, ')');
 	}
 	else
@@ -1089,6 +1136,7 @@ libpqrcv_exec(WalReceiverConn *conn, const char *query,
 	switch (PQresultStatus(pgres))
 	{
 		case PGRES_SINGLE_TUPLE:
+		case PGRES_TUPLES_CHUNK:
 		case PGRES_TUPLES_OK:
 			walres->status = WALRCV_OK_TUPLES;
 			libpqrcv_processTuples(pgres, walres, nRetTypes, retTypes);
@@ -39,6 +39,8 @@
  * check the list for any available worker. Note that we retain a maximum of
  * half the max_parallel_apply_workers_per_subscription workers in the pool and
  * after that, we simply exit the worker after applying the transaction.
+ * With parallel_apply_non_streamed, all the workers are retained, as they
+ * are used for most transactions.
  *
  * XXX This worker pool threshold is arbitrary and we can provide a GUC
  * variable for this in the future if required.
@@ -152,11 +154,38 @@
  * session-level locks because both locks could be acquired outside the
  * transaction, and the stream lock in the leader needs to persist across
  * transaction boundaries i.e. until the end of the streaming transaction.
+ *
+ * Non-streamed transactions
+ * -------------------------
+ * With parallel_apply_non_streamed, the leader also hands ordinary
+ * transactions of a subscription using parallel streaming mode over to
+ * parallel apply workers, starting at BEGIN, and moves on to the next
+ * transaction after sending the COMMIT instead of waiting for the worker.
+ * Several transactions can so be applied at once, and the leader tracks
+ * them in commit order (see ParallelApplyCommittedXact).
+ *
+ * The commit order is still preserved: the leader holds the stream lock of
+ * each such transaction until all earlier ones have finished, and the
+ * parallel apply worker waits for that lock before committing.  The
+ * transaction dependencies described above are handled with a write set:
+ * for each change the leader computes the hash of the replica identity key
+ * of the rows involved and remembers the last transaction that wrote each
+ * key.  A change touching a key written by an earlier transaction that is
+ * still being applied isn't sent until that transaction has finished.
+ * Dependencies not visible in the replica identity, such as constraints
+ * that exist only on the subscriber, are resolved by the lock waits of the
+ * apply workers; those waits only ever go towards earlier transactions,
+ * whose changes have all been sent, except while the leader waits for an
+ * earlier transaction in the middle of a later one.  In that case the
+ * parallel apply worker of the later transaction waits on its stream lock
+ * when it runs out of changes, so that the deadlock detector can see the
+ * cycle.
  *-------------------------------------------------------------------------
  */
 
 #include "postgres.h"
 
+#include "common/hashfn.h"
 #include "libpq/pqformat.h"
 #include "libpq/pqmq.h"
 #include "pgstat.h"
@@ -254,9 +283,57 @@ static ParallelApplyWorkerInfo *stream_apply_worker = NULL;
 /* A list to maintain subtransactions, if any. */
 static List *subxactlist = NIL;
 
+/* GUC parameter */
+bool		parallel_apply_non_streamed = false;
+
+/*
+ * A non-streamed transaction that the leader apply worker handed over to a
+ * parallel apply worker.
+ */
+typedef struct ParallelApplyCommittedXact
+{
+	uint64		seqno;			/* position in commit order */
+	TransactionId xid;			/* remote transaction id */
+	ParallelApplyWorkerInfo *winfo;
+	XLogRecPtr	end_lsn;		/* end of the commit, once known */
+	bool		commit_sent;	/* has the COMMIT been sent? */
+	bool		stream_locked;	/* do we hold its stream lock? */
+} ParallelApplyCommittedXact;
+
+/*
+ * The non-streamed transactions being applied by parallel apply workers, in
+ * commit order, the one whose changes are being received, and the last
+ * sequence number assigned.
+ */
+static List *committed_xacts = NIL;
+static ParallelApplyCommittedXact *committed_xact_current = NULL;
+static uint64 committed_xact_seqno = 0;
+
+/*
+ * The last transaction whose write set could not be tracked completely.
+ * Later transactions wait for it to finish before they start.
+ */
+static uint64 committed_xact_barrier = 0;
+
+/*
+ * Write set of the transactions being applied: maps the hash of a replica
+ * identity key to the last transaction that wrote it.
+ */
+typedef struct ParallelApplyWriteSetEntry
+{
+	uint32		keyhash;		/* Hash key -- must be first */
+	uint64		seqno;
+} ParallelApplyWriteSetEntry;
+
+static HTAB *ParallelApplyWriteSet = NULL;
+
+/* Maximum number of keys tracked in the write set */
+#define PARALLEL_APPLY_MAX_WRITESET		(256 * 1024)
+
 static void pa_free_worker_info(ParallelApplyWorkerInfo *winfo);
 static ParallelTransState pa_get_xact_state(ParallelApplyWorkerShared *wshared);
 static PartialFileSetState pa_get_fileset_state(void);
+static bool pa_leader_is_waiting(void);
 
 /*
  * Returns true if it is OK to start a parallel apply worker, false otherwise.
@@ -369,6 +446,7 @@ pa_setup_dsm(ParallelApplyWorkerInfo *winfo)
 	pg_atomic_init_u32(&(shared->pending_stream_count), 0);
 	shared->last_commit_end = InvalidXLogRecPtr;
 	shared->fileset_state = FS_EMPTY;
+	shared->leader_waiting = false;
 
 	shm_toc_insert(toc, PARALLEL_APPLY_KEY_SHARED, shared);
 
@@ -575,7 +653,9 @@ pa_free_worker(ParallelApplyWorkerInfo *winfo)
 	 */
 	if (winfo->serialize_changes ||
 		list_length(ParallelApplyWorkerPool) >
-		(max_parallel_apply_workers_per_subscription / 2))
+		(parallel_apply_non_streamed ?
+		 max_parallel_apply_workers_per_subscription :
+		 max_parallel_apply_workers_per_subscription / 2))
 	{
 		logicalrep_pa_worker_stop(winfo);
 		pa_free_worker_info(winfo);
@@ -801,6 +881,18 @@ LogicalParallelApplyLoop(shm_mq_handle *mqh)
 		}
 		else if (shmq_res == SHM_MQ_WOULD_BLOCK)
 		{
+			/*
+			 * If the leader waits for an earlier transaction before sending
+			 * the rest of ours, wait on our stream lock to let the deadlock
+			 * detector see us waiting for the leader.  See comments atop
+			 * this file.
+			 */
+			if (pa_leader_is_waiting())
+			{
+				pa_lock_stream(MyParallelShared->xid, AccessShareLock);
+				pa_unlock_stream(MyParallelShared->xid, AccessShareLock);
+			}
+
 			/* Replay the changes from the file, if any. */
 			if (!pa_process_spooled_messages_if_required())
 			{
@@ -1640,3 +1732,481 @@ pa_xact_finish(ParallelApplyWorkerInfo *winfo, XLogRecPtr remote_lsn)
 
 	pa_free_worker(winfo);
 }
+
+/*
+ * Is the leader apply worker waiting for an earlier transaction while we
+ * apply a non-streamed transaction?
+ */
+static bool
+pa_leader_is_waiting(void)
+{
+	bool		leader_waiting;
+
+	SpinLockAcquire(&MyParallelShared->mutex);
+	leader_waiting = MyParallelShared->leader_waiting;
+	SpinLockRelease(&MyParallelShared->mutex);
+
+	return leader_waiting;
+}
+
+/*
+ * Set whether the leader waits for an earlier transaction in the middle of
+ * the non-streamed transaction being applied by the given worker.
+ */
+static void
+pa_set_leader_waiting(ParallelApplyWorkerInfo *winfo, bool leader_waiting)
+{
+	SpinLockAcquire(&winfo->shared->mutex);
+	winfo->shared->leader_waiting = leader_waiting;
+	SpinLockRelease(&winfo->shared->mutex);
+}
+
+/*
+ * Send a message of a non-streamed transaction to its parallel apply worker.
+ *
+ * Unlike for streaming transactions, we don't switch to serializing the
+ * changes on timeout but keep trying: the worker can only be waiting for
+ * earlier transactions, all of whose changes have been sent already, so it
+ * will make progress.
+ */
+static void
+pa_send_committed_data(ParallelApplyWorkerInfo *winfo, StringInfo s)
+{
+	while (!pa_send_data(winfo, s->len, s->data))
+		;
+}
+
+/*
+ * Is the non-streamed transaction with the given sequence number still
+ * being applied?
+ */
+static bool
+pa_committed_xact_running(uint64 seqno)
+{
+	ParallelApplyCommittedXact *oldest;
+
+	if (committed_xacts == NIL)
+		return false;
+
+	oldest = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+
+	return seqno >= oldest->seqno;
+}
+
+/*
+ * Clean up after the oldest non-streamed transaction, which has finished,
+ * and give the next one its turn to commit.
+ */
+static void
+pa_committed_xact_done(void)
+{
+	ParallelApplyCommittedXact *xact;
+
+	xact = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+
+	Assert(xact->commit_sent);
+	Assert(!xact->stream_locked);
+
+	store_flush_position(xact->end_lsn, xact->winfo->shared->last_commit_end);
+	pa_free_worker(xact->winfo);
+
+	committed_xacts = list_delete_first(committed_xacts);
+	pfree(xact);
+
+	if (committed_xacts != NIL)
+	{
+		xact = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+
+		if (xact->stream_locked)
+		{
+			pa_unlock_stream(xact->xid, AccessExclusiveLock);
+			xact->stream_locked = false;
+		}
+	}
+	else if (ParallelApplyWriteSet)
+	{
+		/* Nothing is being applied, so the write set is of no use anymore */
+		hash_destroy(ParallelApplyWriteSet);
+		ParallelApplyWriteSet = NULL;
+	}
+}
+
+/*
+ * Wait until the non-streamed transactions up to the given sequence number
+ * have finished.
+ *
+ * We wait for one transaction after the other in commit order, so we only
+ * ever wait for the transaction whose turn it is to commit.
+ */
+static void
+pa_wait_for_committed_xact(uint64 seqno)
+{
+	ParallelApplyCommittedXact *current = committed_xact_current;
+
+	if (!pa_committed_xact_running(seqno))
+		return;
+
+	if (current)
+		pa_set_leader_waiting(current->winfo, true);
+
+	while (pa_committed_xact_running(seqno))
+	{
+		ParallelApplyCommittedXact *oldest;
+
+		oldest = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+		pa_wait_for_xact_finish(oldest->winfo);
+		pa_committed_xact_done();
+	}
+
+	if (current)
+		pa_set_leader_waiting(current->winfo, false);
+}
+
+/*
+ * Hand a non-streamed transaction over to a parallel apply worker, if we can,
+ * and send it the BEGIN message.
+ *
+ * Returns false if the leader has to apply the transaction itself, in which
+ * case all the transactions being applied by parallel apply workers have
+ * finished.
+ */
+bool
+pa_begin_committed_xact(TransactionId xid, StringInfo s)
+{
+	ParallelApplyWorkerEntry *entry;
+	ParallelApplyCommittedXact *xact;
+	MemoryContext oldcontext;
+
+	Assert(committed_xact_current == NULL);
+
+	pa_process_committed_xacts();
+
+	if (!parallel_apply_non_streamed ||
+		debug_logical_replication_streaming == DEBUG_LOGICAL_REP_STREAMING_IMMEDIATE)
+	{
+		pa_wait_for_committed_xacts();
+		return false;
+	}
+
+	/* Wait for the transactions whose write set wasn't fully tracked. */
+	pa_wait_for_committed_xact(committed_xact_barrier);
+
+	/*
+	 * Get a worker, waiting for the oldest transaction to release its worker
+	 * if all of them are busy.
+	 */
+	for (;;)
+	{
+		pa_allocate_worker(xid);
+
+		entry = ParallelApplyTxnHash ?
+			hash_search(ParallelApplyTxnHash, &xid, HASH_FIND, NULL) : NULL;
+		if (entry)
+			break;
+
+		if (committed_xacts == NIL)
+			return false;
+
+		xact = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+		pa_wait_for_committed_xact(xact->seqno);
+	}
+
+	oldcontext = MemoryContextSwitchTo(ApplyContext);
+
+	xact = (ParallelApplyCommittedXact *) palloc0(sizeof(ParallelApplyCommittedXact));
+	xact->seqno = ++committed_xact_seqno;
+	xact->xid = xid;
+	xact->winfo = entry->winfo;
+	xact->end_lsn = InvalidXLogRecPtr;
+
+	/*
+	 * Unless it's the oldest, hold the stream lock of the transaction until
+	 * the earlier ones have finished, so that the worker can't commit before
+	 * them.
+	 */
+	if (committed_xacts != NIL)
+	{
+		pa_lock_stream(xid, AccessExclusiveLock);
+		xact->stream_locked = true;
+	}
+
+	committed_xacts = lappend(committed_xacts, xact);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	committed_xact_current = xact;
+
+	pa_send_committed_data(xact->winfo, s);
+
+	return true;
+}
+
+/*
+ * Remove the write set entries of the transactions that have finished.
+ */
+static void
+pa_prune_writeset(void)
+{
+	HASH_SEQ_STATUS status;
+	ParallelApplyWriteSetEntry *entry;
+
+	hash_seq_init(&status, ParallelApplyWriteSet);
+	while ((entry = (ParallelApplyWriteSetEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (!pa_committed_xact_running(entry->seqno))
+			hash_search(ParallelApplyWriteSet, &entry->keyhash, HASH_REMOVE,
+						NULL);
+	}
+}
+
+/*
+ * Add a key to the write set of the current transaction, after waiting for
+ * the earlier transaction that wrote it, if it's still being applied.
+ */
+static void
+pa_writeset_add(uint32 keyhash)
+{
+	ParallelApplyCommittedXact *xact = committed_xact_current;
+	ParallelApplyWriteSetEntry *entry;
+
+	if (!ParallelApplyWriteSet)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(ParallelApplyWriteSetEntry);
+		ctl.hcxt = ApplyContext;
+
+		ParallelApplyWriteSet = hash_create("logical replication parallel apply write set",
+											1024, &ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = hash_search(ParallelApplyWriteSet, &keyhash, HASH_FIND, NULL);
+
+	if (entry && entry->seqno != xact->seqno)
+		pa_wait_for_committed_xact(entry->seqno);
+
+	/* Nothing to do if this transaction's write set isn't tracked anymore */
+	if (committed_xact_barrier == xact->seqno)
+		return;
+
+	if (!entry &&
+		hash_get_num_entries(ParallelApplyWriteSet) >= PARALLEL_APPLY_MAX_WRITESET)
+	{
+		pa_prune_writeset();
+
+		/*
+		 * If it's still too large, stop tracking the write set of this
+		 * transaction and make the later ones wait for it instead.
+		 */
+		if (hash_get_num_entries(ParallelApplyWriteSet) >= PARALLEL_APPLY_MAX_WRITESET)
+		{
+			committed_xact_barrier = xact->seqno;
+			return;
+		}
+	}
+
+	entry = hash_search(ParallelApplyWriteSet, &keyhash, HASH_ENTER, NULL);
+	entry->seqno = xact->seqno;
+}
+
+/*
+ * Compute the hash of the replica identity key of a tuple of the given
+ * remote relation.
+ *
+ * Key columns sent as unchanged TOAST data are taken from oldtup, if given.
+ * Returns false if the key can't be determined.
+ */
+static bool
+pa_tuple_key_hash(LogicalRepRelation *remoterel, LogicalRepTupleData *tup,
+				  LogicalRepTupleData *oldtup, uint32 *keyhash)
+{
+	uint32		hashvalue = hash_uint32(remoterel->remoteid);
+	int			i = -1;
+
+	while ((i = bms_next_member(remoterel->attkeys, i)) >= 0)
+	{
+		LogicalRepTupleData *src = tup;
+
+		if (i < tup->ncols && tup->colstatus[i] == LOGICALREP_COLUMN_UNCHANGED)
+			src = oldtup;
+
+		if (src == NULL || i >= src->ncols ||
+			src->colstatus[i] == LOGICALREP_COLUMN_UNCHANGED)
+			return false;
+
+		hashvalue = hash_combine(hashvalue, (uint32) src->colstatus[i]);
+		if (src->colstatus[i] != LOGICALREP_COLUMN_NULL)
+			hashvalue = hash_combine(hashvalue,
+									 hash_bytes((unsigned char *) src->colvalues[i].data,
+												src->colvalues[i].len));
+	}
+
+	*keyhash = hashvalue;
+	return true;
+}
+
+/*
+ * Add the key of a tuple to the write set of the current transaction.
+ */
+static void
+pa_writeset_add_tuple(LogicalRepRelId relid, LogicalRepTupleData *tup,
+					  LogicalRepTupleData *oldtup)
+{
+	LogicalRepRelation *remoterel = logicalrep_get_remoterel(relid);
+	uint32		keyhash;
+
+	/*
+	 * Without a replica identity, the publisher doesn't send updates or
+	 * deletes, so the inserted rows can't be touched by later changes.
+	 */
+	if (remoterel && bms_is_empty(remoterel->attkeys))
+		return;
+
+	if (remoterel && pa_tuple_key_hash(remoterel, tup, oldtup, &keyhash))
+		pa_writeset_add(keyhash);
+	else
+	{
+		/*
+		 * We can't tell which rows the change touches, so let all the earlier
+		 * transactions finish first.  Later transactions modifying the same
+		 * row will wait for our row lock.
+		 */
+		pa_wait_for_committed_xact(committed_xact_current->seqno - 1);
+	}
+}
+
+/*
+ * Send a change of the current non-streamed transaction to its parallel apply
+ * worker, once the transactions it depends on have finished.
+ */
+void
+pa_send_committed_change(LogicalRepMsgType action, StringInfo s)
+{
+	StringInfoData change = *s;
+	LogicalRepRelId relid;
+	LogicalRepTupleData oldtup;
+	LogicalRepTupleData newtup;
+	bool		has_oldtup;
+
+	Assert(committed_xact_current);
+
+	switch (action)
+	{
+		case LOGICAL_REP_MSG_INSERT:
+			relid = logicalrep_read_insert(&change, &newtup);
+			pa_writeset_add_tuple(relid, &newtup, NULL);
+			break;
+
+		case LOGICAL_REP_MSG_INSERT_BATCH:
+			{
+				int			nrows;
+
+				relid = logicalrep_read_insert_batch(&change, &nrows);
+				for (int i = 0; i < nrows; i++)
+				{
+					logicalrep_read_batch_tuple(&change, &newtup);
+					pa_writeset_add_tuple(relid, &newtup, NULL);
+				}
+			}
+			break;
+
+		case LOGICAL_REP_MSG_UPDATE:
+			relid = logicalrep_read_update(&change, &has_oldtup, &oldtup,
+										   &newtup);
+			if (has_oldtup)
+				pa_writeset_add_tuple(relid, &oldtup, NULL);
+			pa_writeset_add_tuple(relid, &newtup, has_oldtup ? &oldtup : NULL);
+			break;
+
+		case LOGICAL_REP_MSG_DELETE:
+			relid = logicalrep_read_delete(&change, &oldtup);
+			pa_writeset_add_tuple(relid, &oldtup, NULL);
+			break;
+
+		default:
+
+			/*
+			 * Changes that don't touch individual rows, like TRUNCATE, wait
+			 * for the locks of the earlier transactions in the worker.
+			 */
+			break;
+	}
+
+	pa_send_committed_data(committed_xact_current->winfo, s);
+}
+
+/*
+ * Send the COMMIT of the current non-streamed transaction to its parallel
+ * apply worker, without waiting for the worker to apply it.
+ */
+void
+pa_commit_committed_xact(XLogRecPtr end_lsn, StringInfo s)
+{
+	ParallelApplyCommittedXact *xact = committed_xact_current;
+
+	Assert(xact);
+
+	xact->end_lsn = end_lsn;
+	pa_send_committed_data(xact->winfo, s);
+	xact->commit_sent = true;
+
+	committed_xact_current = NULL;
+
+	pa_process_committed_xacts();
+}
+
+/*
+ * Return the parallel apply worker applying the non-streamed transaction
+ * whose changes are being received, if any.
+ */
+ParallelApplyWorkerInfo *
+pa_committed_xact_worker(void)
+{
+	return committed_xact_current ? committed_xact_current->winfo : NULL;
+}
+
+/*
+ * Are there non-streamed transactions being applied by parallel apply
+ * workers?
+ */
+bool
+pa_committed_xacts_pending(void)
+{
+	return committed_xacts != NIL;
+}
+
+/*
+ * Clean up after the non-streamed transactions that have finished, without
+ * waiting.
+ */
+void
+pa_process_committed_xacts(void)
+{
+	while (committed_xacts != NIL)
+	{
+		ParallelApplyCommittedXact *oldest;
+
+		oldest = (ParallelApplyCommittedXact *) linitial(committed_xacts);
+
+		if (!oldest->commit_sent ||
+			pa_get_xact_state(oldest->winfo->shared) != PARALLEL_TRANS_FINISHED)
+			break;
+
+		pa_committed_xact_done();
+	}
+}
+
+/*
+ * Wait for all the non-streamed transactions being applied by parallel apply
+ * workers to finish.  This must be done before the leader applies or commits
+ * anything itself, to keep the commit order.
+ */
+void
+pa_wait_for_committed_xacts(void)
+{
+	Assert(committed_xact_current == NULL);
+
+	pa_wait_for_committed_xact(committed_xact_seqno);
+}
@@ -451,6 +451,182 @@ logicalrep_read_insert(StringInfo in, LogicalRepTupleData *newtup)
 	return relid;
 }
 
+/*
+ * Look up the output functions for writing tuples of the relation with
+ * logicalrep_write_batch_tuple().
+ *
+ * The result is allocated in the current memory context, and is only valid as
+ * long as the relation's descriptor and column list don't change.
+ */
+LogicalRepTupleOutput *
+logicalrep_tuple_output_init(Relation rel, bool binary, Bitmapset *columns)
+{
+	TupleDesc	desc = RelationGetDescr(rel);
+	LogicalRepTupleOutput *output;
+	int			i;
+
+	output = palloc(sizeof(LogicalRepTupleOutput));
+	output->natts = desc->natts;
+	output->nliveatts = 0;
+	output->columns = palloc0(desc->natts * sizeof(LogicalRepColumnOutput));
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(desc, i);
+		LogicalRepColumnOutput *column = &output->columns[i];
+		HeapTuple	typtup;
+		Form_pg_type typclass;
+
+		if (att->attisdropped || att->attgenerated)
+			continue;
+
+		if (!column_in_column_list(att->attnum, columns))
+			continue;
+
+		output->nliveatts++;
+		column->isvarlena = (att->attlen == -1);
+
+		typtup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(att->atttypid));
+		if (!HeapTupleIsValid(typtup))
+			elog(ERROR, "cache lookup failed for type %u", att->atttypid);
+		typclass = (Form_pg_type) GETSTRUCT(typtup);
+
+		/* Same choice as logicalrep_write_tuple() makes for each value. */
+		if (binary && OidIsValid(typclass->typsend))
+		{
+			column->format = LOGICALREP_COLUMN_BINARY;
+			fmgr_info(typclass->typsend, &column->finfo);
+		}
+		else
+		{
+			column->format = LOGICALREP_COLUMN_TEXT;
+			fmgr_info(typclass->typoutput, &column->finfo);
+		}
+
+		ReleaseSysCache(typtup);
+	}
+
+	return output;
+}
+
+/*
+ * Write a tuple for an INSERT BATCH message, in the same format as
+ * logicalrep_write_tuple() but using the output functions looked up by
+ * logicalrep_tuple_output_init().
+ */
+void
+logicalrep_write_batch_tuple(StringInfo out, TupleTableSlot *slot,
+							 LogicalRepTupleOutput *output)
+{
+	Datum	   *values;
+	bool	   *isnull;
+	int			i;
+
+	Assert(slot->tts_tupleDescriptor->natts == output->natts);
+
+	pq_sendint16(out, output->nliveatts);
+
+	slot_getallattrs(slot);
+	values = slot->tts_values;
+	isnull = slot->tts_isnull;
+
+	for (i = 0; i < output->natts; i++)
+	{
+		LogicalRepColumnOutput *column = &output->columns[i];
+
+		if (column->format == '\0')
+			continue;
+
+		if (isnull[i])
+		{
+			pq_sendbyte(out, LOGICALREP_COLUMN_NULL);
+			continue;
+		}
+
+		/* Unchanged toasted datum, see logicalrep_write_tuple(). */
+		if (column->isvarlena && VARATT_IS_EXTERNAL_ONDISK(values[i]))
+		{
+			pq_sendbyte(out, LOGICALREP_COLUMN_UNCHANGED);
+			continue;
+		}
+
+		if (column->format == LOGICALREP_COLUMN_BINARY)
+		{
+			bytea	   *outputbytes;
+			int			len;
+
+			pq_sendbyte(out, LOGICALREP_COLUMN_BINARY);
+			outputbytes = SendFunctionCall(&column->finfo, values[i]);
+			len = VARSIZE(outputbytes) - VARHDRSZ;
+			pq_sendint(out, len, 4);	/* length */
+			pq_sendbytes(out, VARDATA(outputbytes), len);	/* data */
+			pfree(outputbytes);
+		}
+		else
+		{
+			char	   *outputstr;
+
+			pq_sendbyte(out, LOGICALREP_COLUMN_TEXT);
+			outputstr = OutputFunctionCall(&column->finfo, values[i]);
+			pq_sendcountedtext(out, outputstr, strlen(outputstr), false);
+			pfree(outputstr);
+		}
+	}
+}
+
+/*
+ * Write INSERT BATCH to the output stream.
+ *
+ * rows holds nrows tuples of the relation, each written by
+ * logicalrep_write_batch_tuple().
+ */
+void
+logicalrep_write_insert_batch(StringInfo out, TransactionId xid, Oid relid,
+							  int nrows, StringInfo rows)
+{
+	pq_sendbyte(out, LOGICAL_REP_MSG_INSERT_BATCH);
+
+	/* transaction ID (if not valid, we're not streaming) */
+	if (TransactionIdIsValid(xid))
+		pq_sendint32(out, xid);
+
+	/* use Oid as relation identifier */
+	pq_sendint32(out, relid);
+
+	pq_sendint32(out, nrows);
+	pq_sendbytes(out, rows->data, rows->len);
+}
+
+/*
+ * Read the header of INSERT BATCH from stream.
+ *
+ * Returns the relation the rows are for; the caller is to read each of the
+ * nrows tuples with logicalrep_read_batch_tuple().
+ */
+LogicalRepRelId
+logicalrep_read_insert_batch(StringInfo in, int *nrows)
+{
+	LogicalRepRelId relid;
+
+	/* read the relation id */
+	relid = pq_getmsgint(in, 4);
+
+	*nrows = pq_getmsgint(in, 4);
+	if (*nrows <= 0)
+		elog(ERROR, "invalid number of rows %d in insert batch", *nrows);
+
+	return relid;
+}
+
+/*
+ * Read the next tuple of INSERT BATCH from stream.
+ */
+void
+logicalrep_read_batch_tuple(StringInfo in, LogicalRepTupleData *tuple)
+{
+	logicalrep_read_tuple(in, tuple);
+}
+
 /*
  * Write UPDATE to the output stream.
  */
@@ -1228,6 +1404,8 @@ logicalrep_message_type(LogicalRepMsgType action)
 			return "ORIGIN";
 		case LOGICAL_REP_MSG_INSERT:
 			return "INSERT";
+		case LOGICAL_REP_MSG_INSERT_BATCH:
+			return "INSERT BATCH";
 		case LOGICAL_REP_MSG_UPDATE:
 			return "UPDATE";
 		case LOGICAL_REP_MSG_DELETE:
@@ -198,6 +198,25 @@ logicalrep_relmap_update(LogicalRepRelation *remoterel)
 	MemoryContextSwitchTo(oldctx);
 }
 
+/*
+ * Look up the remote relation info received for the given remote relation
+ * id, without opening the local relation.
+ *
+ * Returns NULL if no RELATION message has been received for it.
+ */
+LogicalRepRelation *
+logicalrep_get_remoterel(LogicalRepRelId remoteid)
+{
+	LogicalRepRelMapEntry *entry;
+
+	if (LogicalRepRelMap == NULL)
+		return NULL;
+
+	entry = hash_search(LogicalRepRelMap, &remoteid, HASH_FIND, NULL);
+
+	return entry ? &entry->remoterel : NULL;
+}
+
 /*
  * Find attribute index in TupleDesc struct by attribute name.
  *
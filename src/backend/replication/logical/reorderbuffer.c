@@ -34,7 +34,9 @@
  *	  big as the available memory - this module supports spooling the contents
  *	  of a large transactions to disk. When the transaction is replayed the
  *	  contents of individual (sub-)transactions will be read from disk in
- *	  chunks.
+ *	  chunks.  Serialized changes are collected into blocks of roughly
+ *	  REORDER_BUFFER_SPILL_BLOCK_SIZE, each written with a single write and
+ *	  compressed according to logical_decoding_spill_compression.
  *
  *	  This module also has to deal with reassembling toast records from the
  *	  individual chunks stored in WAL. When a new (or initial) version of a
@@ -90,6 +92,7 @@
 #include "access/transam.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogcompress.h"
 #include "catalog/catalog.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
@@ -137,6 +140,10 @@ typedef struct TXNEntryFile
 	File		vfd;			/* -1 when the file is closed */
 	off_t		curOffset;		/* offset for next write or read. Reset to 0
 								 * when vfd is opened. */
+	char	   *block;			/* changes of the block last read */
+	Size		blocksize;		/* allocated size of block */
+	Size		blocklen;		/* length of the changes in block */
+	Size		blockoff;		/* offset of the next change to restore */
 } TXNEntryFile;
 
 /* k-way in-order change iteration support structures */
@@ -178,6 +185,24 @@ typedef struct ReorderBufferDiskChange
 	/* data follows */
 } ReorderBufferDiskChange;
 
+/*
+ * Spill files are a sequence of blocks, each holding a number of whole
+ * ReorderBufferDiskChanges, compressed with the given method.
+ */
+typedef struct ReorderBufferDiskBlock
+{
+	uint32		rawsize;		/* length of the changes in the block */
+	uint32		size;			/* length of the block on disk, after the
+								 * header */
+	int32		method;			/* WalCompression the block was written with */
+} ReorderBufferDiskBlock;
+
+/*
+ * Changes being spilled are written out once this much has been collected.
+ * A single change larger than this makes a block of its own.
+ */
+#define REORDER_BUFFER_SPILL_BLOCK_SIZE		(64 * 1024)
+
 #define IsSpecInsert(action) \
 ( \
 	((action) == REORDER_BUFFER_CHANGE_INTERNAL_SPEC_INSERT) \
@@ -211,6 +236,7 @@ static const Size max_changes_in_memory = 4096; /* XXX for restore only */
 
 /* GUC variable */
 int			debug_logical_replication_streaming = DEBUG_LOGICAL_REP_STREAMING_BUFFERED;
+int			logical_decoding_spill_compression = WAL_COMPRESSION_NONE;
 
 /* ---------------------------------------
  * primary reorderbuffer support routines
@@ -248,6 +274,11 @@ static void ReorderBufferExecuteInvalidations(uint32 nmsgs, SharedInvalidationMe
  */
 static void ReorderBufferCheckMemoryLimit(ReorderBuffer *rb);
 static void ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferSpillWrite(ReorderBuffer *rb, ReorderBufferTXN *txn,
+								   int fd, char *data, Size len);
+static void ReorderBufferSpillFlush(ReorderBuffer *rb, ReorderBufferTXN *txn,
+									int fd);
+static bool ReorderBufferReadBlock(ReorderBuffer *rb, TXNEntryFile *file);
 static void ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 										 int fd, ReorderBufferChange *change);
 static Size ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
@@ -354,6 +385,11 @@ ReorderBufferAllocate(void) // 先分配一个内存池，再在其中分配内
 
 	buffer->outbuf = NULL;
 	buffer->outbufsize = 0;
+	buffer->spillbuf = NULL;
+	buffer->spillbufsize = 0;
+	buffer->spilllen = 0;
+	buffer->compressbuf = NULL;
+	buffer->compressbufsize = 0;
 	buffer->size = 0;
 
 	buffer->spillTxns = 0;
@@ -364,6 +400,7 @@ ReorderBufferAllocate(void) // 先分配一个内存池，再在其中分配内
 	buffer->streamBytes = 0;
 	buffer->totalTxns = 0;
 	buffer->totalBytes = 0;
+	buffer->snapBuildTime = 0;
 
 	buffer->current_restart_decoding_lsn = InvalidXLogRecPtr;
 
@@ -1475,6 +1512,8 @@ ReorderBufferIterTXNFinish(ReorderBuffer *rb,
 	{
 		if (state->entries[off].file.vfd != -1)
 			FileClose(state->entries[off].file.vfd);
+		if (state->entries[off].file.block)
+			pfree(state->entries[off].file.block);
 	}
 
 	/* free memory we might have "leaked" in the last *Next call */
@@ -3685,7 +3724,10 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn) /// 把txn
 			char		path[MAXPGPATH];
 
 			if (fd != -1)
+			{
+				ReorderBufferSpillFlush(rb, txn, fd);
 				CloseTransientFile(fd);
+			}
 
 			XLByteToSeg(change->lsn, curOpenSegNo, wal_segment_size);
 
@@ -3732,7 +3774,127 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn) /// 把txn
 	txn->txn_flags |= RBTXN_IS_SERIALIZED;
 
 	if (fd != -1)
+	{
+		ReorderBufferSpillFlush(rb, txn, fd);
 		CloseTransientFile(fd); /// 关闭一个文件句柄，就是调用close()这个系统调用来完成
+	}
+}
+
+/*
+ * Add a serialized change to the block being collected for the spill file
+ * fd, writing the block out once it is large enough.
+ */
+static void
+ReorderBufferSpillWrite(ReorderBuffer *rb, ReorderBufferTXN *txn, int fd,
+						char *data, Size len)
+{
+	Size		needed;
+
+	/* leave room for the block header, filled in by ReorderBufferSpillFlush */
+	if (rb->spilllen == 0)
+		rb->spilllen = sizeof(ReorderBufferDiskBlock);
+
+	needed = rb->spilllen + len;
+	if (rb->spillbufsize < needed)
+	{
+		Size		newsize = Max(needed, REORDER_BUFFER_SPILL_BLOCK_SIZE +
+								  sizeof(ReorderBufferDiskBlock));
+
+		if (rb->spillbuf == NULL)
+			rb->spillbuf = MemoryContextAlloc(rb->context, newsize);
+		else
+			rb->spillbuf = repalloc(rb->spillbuf, newsize);
+		rb->spillbufsize = newsize;
+	}
+
+	memcpy(rb->spillbuf + rb->spilllen, data, len);
+	rb->spilllen += len;
+
+	if (rb->spilllen - sizeof(ReorderBufferDiskBlock) >=
+		REORDER_BUFFER_SPILL_BLOCK_SIZE)
+		ReorderBufferSpillFlush(rb, txn, fd);
+}
+
+/*
+ * Write out the block of changes collected for the spill file fd, if any.
+ */
+static void
+ReorderBufferSpillFlush(ReorderBuffer *rb, ReorderBufferTXN *txn, int fd)
+{
+	ReorderBufferDiskBlock *hdr;
+	WalCompression method = logical_decoding_spill_compression;
+	Size		rawsize;
+	char	   *block;
+	Size		blocklen;
+
+	if (rb->spilllen == 0)
+		return;
+
+	rawsize = rb->spilllen - sizeof(ReorderBufferDiskBlock);
+	block = rb->spillbuf;
+	blocklen = rb->spilllen;
+
+	/* Compress the block, if configured and if it's small enough to. */
+	if (method != WAL_COMPRESSION_NONE && rawsize <= MaxAllocSize / 2)
+	{
+		Size		bound = XLogCompressBound(method, (int) rawsize);
+		int			len = -1;
+
+		if (bound > 0)
+		{
+			bound += sizeof(ReorderBufferDiskBlock);
+			if (rb->compressbufsize < bound)
+			{
+				if (rb->compressbuf == NULL)
+					rb->compressbuf = MemoryContextAlloc(rb->context, bound);
+				else
+					rb->compressbuf = repalloc(rb->compressbuf, bound);
+				rb->compressbufsize = bound;
+			}
+
+			len = XLogCompressData(method,
+								   rb->spillbuf + sizeof(ReorderBufferDiskBlock),
+								   (int) rawsize,
+								   rb->compressbuf + sizeof(ReorderBufferDiskBlock),
+								   (int) (bound - sizeof(ReorderBufferDiskBlock)));
+		}
+
+		/* store the block as is if it didn't get any smaller */
+		if (len > 0 && len < rawsize)
+		{
+			block = rb->compressbuf;
+			blocklen = sizeof(ReorderBufferDiskBlock) + len;
+		}
+		else
+			method = WAL_COMPRESSION_NONE;
+	}
+	else
+		method = WAL_COMPRESSION_NONE;
+
+	hdr = (ReorderBufferDiskBlock *) block;
+	hdr->rawsize = (uint32) rawsize;
+	hdr->size = (uint32) (blocklen - sizeof(ReorderBufferDiskBlock));
+	hdr->method = (int32) method;
+
+	/* the buffer may be reused right away, even if the write fails */
+	rb->spilllen = 0;
+
+	errno = 0;
+	pgstat_report_wait_start(WAIT_EVENT_REORDER_BUFFER_WRITE);
+	if (write(fd, block, blocklen) != blocklen) /// 调用write()系统调用来写入数据到磁盘
+	{
+		int			save_errno = errno;
+
+		CloseTransientFile(fd);
+
+		/* if write didn't set errno, assume problem is no disk space */
+		errno = save_errno ? save_errno : ENOSPC;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to data file for XID %u: %m",
+						txn->xid)));
+	}
+	pgstat_report_wait_end();
 }
 
 /*
@@ -3921,22 +4083,7 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	ondisk->size = sz;
 
-	errno = 0;
-	pgstat_report_wait_start(WAIT_EVENT_REORDER_BUFFER_WRITE);
-	if (write(fd, rb->outbuf, ondisk->size) != ondisk->size) /// 调用write()系统调用来写入数据到磁盘
-	{
-		int			save_errno = errno;
-
-		CloseTransientFile(fd);
-
-		/* if write didn't set errno, assume problem is no disk space */
-		errno = save_errno ? save_errno : ENOSPC;
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not write to data file for XID %u: %m",
-						txn->xid)));
-	}
-	pgstat_report_wait_end();
+	ReorderBufferSpillWrite(rb, txn, fd, rb->outbuf, ondisk->size);
 
 	/*
 	 * Keep the transaction's final_lsn up to date with each change we send to
@@ -4218,11 +4365,38 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	while (restored < max_changes_in_memory && *segno <= last_segno)
 	{
-		int			readBytes;
-		ReorderBufferDiskChange *ondisk;
+		Size		size;
 
 		CHECK_FOR_INTERRUPTS();
 
+		/* restore the changes left in the block read last, first */
+		if (file->blockoff < file->blocklen)
+		{
+			/*
+			 * Changes aren't aligned within the block, so copy each into the
+			 * maxaligned outbuf before restoring it.
+			 */
+			memcpy(&size, file->block + file->blockoff, sizeof(Size));
+			if (size < sizeof(ReorderBufferDiskChange) ||
+				size > file->blocklen - file->blockoff)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid change of %zu bytes in reorderbuffer spill file",
+								size)));
+
+			ReorderBufferSerializeReserve(rb, size);
+			memcpy(rb->outbuf, file->block + file->blockoff, size);
+			file->blockoff += size;
+
+			/*
+			 * ok, read a full change from disk, now restore it into proper
+			 * in-memory format
+			 */
+			ReorderBufferRestoreChange(rb, txn, rb->outbuf);
+			restored++;
+			continue;
+		}
+
 		if (*fd == -1)
 		{
 			char		path[MAXPGPATH];
@@ -4258,71 +4432,105 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 								path)));
 		}
 
-		/*
-		 * Read the statically sized part of a change which has information
-		 * about the total size. If we couldn't read a record, we're at the
-		 * end of this file.
-		 */
-		ReorderBufferSerializeReserve(rb, sizeof(ReorderBufferDiskChange));
-		readBytes = FileRead(file->vfd, rb->outbuf,
-							 sizeof(ReorderBufferDiskChange),
-							 file->curOffset, WAIT_EVENT_REORDER_BUFFER_READ);
-
-		/* eof */
-		if (readBytes == 0)
+		/* If we couldn't read another block, we're at the end of this file. */
+		if (!ReorderBufferReadBlock(rb, file))
 		{
 			FileClose(*fd);
 			*fd = -1;
 			(*segno)++;
 			continue;
 		}
-		else if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != sizeof(ReorderBufferDiskChange))
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-							(uint32) sizeof(ReorderBufferDiskChange))));
+	}
+
+	return restored;
+}
+
+/*
+ * Read the next block of changes from a spill file into file->block,
+ * decompressing it if needed.  Returns false at the end of the file.
+ */
+static bool
+ReorderBufferReadBlock(ReorderBuffer *rb, TXNEntryFile *file)
+{
+	ReorderBufferDiskBlock hdr;
+	int			readBytes;
+	char	   *dest;
 
-		file->curOffset += readBytes;
+	readBytes = FileRead(file->vfd, &hdr, sizeof(ReorderBufferDiskBlock),
+						 file->curOffset, WAIT_EVENT_REORDER_BUFFER_READ);
 
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+	/* eof */
+	if (readBytes == 0)
+		return false;
+	else if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != sizeof(ReorderBufferDiskBlock))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes,
+						(uint32) sizeof(ReorderBufferDiskBlock))));
 
-		ReorderBufferSerializeReserve(rb,
-									  sizeof(ReorderBufferDiskChange) + ondisk->size);
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+	file->curOffset += readBytes;
 
-		readBytes = FileRead(file->vfd,
-							 rb->outbuf + sizeof(ReorderBufferDiskChange),
-							 ondisk->size - sizeof(ReorderBufferDiskChange),
-							 file->curOffset,
-							 WAIT_EVENT_REORDER_BUFFER_READ);
+	if (file->blocksize < hdr.rawsize)
+	{
+		if (file->block)
+			pfree(file->block);
+		file->block = MemoryContextAlloc(rb->context, hdr.rawsize);
+		file->blocksize = hdr.rawsize;
+	}
 
-		if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != ondisk->size - sizeof(ReorderBufferDiskChange))
+	/* compressed blocks are read into compressbuf first */
+	if (hdr.method == WAL_COMPRESSION_NONE)
+	{
+		if (hdr.size != hdr.rawsize)
 			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-							(uint32) (ondisk->size - sizeof(ReorderBufferDiskChange)))));
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid block in reorderbuffer spill file")));
+		dest = file->block;
+	}
+	else
+	{
+		if (rb->compressbufsize < hdr.size)
+		{
+			if (rb->compressbuf == NULL)
+				rb->compressbuf = MemoryContextAlloc(rb->context, hdr.size);
+			else
+				rb->compressbuf = repalloc(rb->compressbuf, hdr.size);
+			rb->compressbufsize = hdr.size;
+		}
+		dest = rb->compressbuf;
+	}
 
-		file->curOffset += readBytes;
+	readBytes = FileRead(file->vfd, dest, hdr.size, file->curOffset,
+						 WAIT_EVENT_REORDER_BUFFER_READ);
+	if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != hdr.size)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes, hdr.size)));
 
-		/*
-		 * ok, read a full change from disk, now restore it into proper
-		 * in-memory format
-		 */
-		ReorderBufferRestoreChange(rb, txn, rb->outbuf);
-		restored++;
-	}
+	file->curOffset += readBytes;
 
-	return restored;
+	if (hdr.method != WAL_COMPRESSION_NONE &&
+		!XLogDecompressData((WalCompression) hdr.method, rb->compressbuf,
+							(int) hdr.size, file->block, (int) hdr.rawsize))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("could not decompress %s block in reorderbuffer spill file",
+						XLogCompressionName((WalCompression) hdr.method))));
+
+	file->blocklen = hdr.rawsize;
+	file->blockoff = 0;
+
+	return true;
 }
 
 /*
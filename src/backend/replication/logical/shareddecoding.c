@@ -0,0 +1,633 @@
+/*-------------------------------------------------------------------------
+ * shareddecoding.c
+ *	  PostgreSQL logical replication: sharing decoded changes between
+ *	  WAL senders
+ *
+ * Copyright (c) 2012-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/shareddecoding.c
+ *
+ * NOTES
+ *	  Every logical WAL sender normally reads and decodes all of the WAL on
+ *	  its own, even when several subscribers consume the same publications.
+ *	  With logical_decoding_shared, WAL senders of the same database that
+ *	  start replication with the same output plugin and the same plugin
+ *	  options form a group, whose output is identical from any given WAL
+ *	  position on.  The first of them becomes the group's leader and decodes
+ *	  as usual.  The others start out decoding on their own too, but once one
+ *	  of them has processed the WAL up to exactly the record the leader
+ *	  finished last, it attaches to the leader and stops decoding: from then
+ *	  on the leader forwards every message its output plugin writes to the
+ *	  follower's shm_mq, and the follower sends it on to its own client.
+ *
+ *	  The output from that point on is the same only if both WAL senders
+ *	  have reached a consistent snapshot and are past the position they
+ *	  started sending changes at, so those are conditions for attaching.
+ *	  Streaming of in-progress transactions and two-phase decoding make the
+ *	  output depend on what each WAL sender did before attaching, so WAL
+ *	  senders using either never share.  The leader invalidates its caches
+ *	  when a follower attaches, so that the output plugin describes every
+ *	  relation again before sending changes for it.
+ *
+ *	  Each slot keeps its own position: the follower's slot still advances
+ *	  as its client confirms what it received, and it takes over the
+ *	  leader's restart_lsn and catalog_xmin once it has confirmed the
+ *	  leader's confirmed_flush, as the leader's slot guarantees that
+ *	  everything committed after that can be decoded.
+ *
+ *	  The leader never waits for followers.  If a follower's queue is full,
+ *	  the leader detaches from it, and the follower errors out; the client
+ *	  reconnects and the follower decodes on its own until it can attach
+ *	  again.  If the leader goes away, its followers error out the same
+ *	  way.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xlogdefs.h"
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "replication/shareddecoding.h"
+#include "replication/slot.h"
+#include "replication/snapbuild.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+
+/* maximum length of the plugin name and options identifying a group */
+#define SHARED_DECODING_KEY_LEN			1024
+
+/* maximum number of followers of a leader */
+#define SHARED_DECODING_MAX_FOLLOWERS	16
+
+/* size of the queue a follower receives the leader's output through */
+#define SHARED_DECODING_QUEUE_SIZE		(8 * 1024 * 1024)
+
+typedef struct SharedDecodingFollower
+{
+	pid_t		pid;			/* 0 if unused */
+	dsm_handle	handle;			/* segment with the follower's queue */
+	bool		attached;		/* has the leader attached to the queue? */
+} SharedDecodingFollower;
+
+typedef struct SharedDecodingGroup
+{
+	slock_t		mutex;			/* protects the fields below */
+	pid_t		leader_pid;		/* 0 if the group is unused */
+	Oid			dboid;
+	uint32		keyhash;
+	char		key[SHARED_DECODING_KEY_LEN];
+	int			leader_slot;	/* index of the leader's replication slot */
+
+	/*
+	 * End of the last record the leader has completely decoded, or invalid
+	 * while it is decoding one or if it can't be followed yet.
+	 */
+	XLogRecPtr	decoded_upto;
+
+	bool		new_followers;	/* did followers attach since last checked? */
+	SharedDecodingFollower followers[SHARED_DECODING_MAX_FOLLOWERS];
+} SharedDecodingGroup;
+
+typedef struct SharedDecodingCtlData
+{
+	slock_t		mutex;			/* protects allocating groups */
+	int			ngroups;
+	SharedDecodingGroup groups[FLEXIBLE_ARRAY_MEMBER];
+} SharedDecodingCtlData;
+
+typedef enum SharedDecodingRole
+{
+	SHARED_DECODING_NONE,
+	SHARED_DECODING_LEADER,
+	SHARED_DECODING_CANDIDATE,	/* decoding until it can follow */
+	SHARED_DECODING_FOLLOWER
+} SharedDecodingRole;
+
+/* GUC variable */
+bool		logical_decoding_shared = false;
+
+static SharedDecodingCtlData *SharedDecodingCtl = NULL;
+
+/* state of this WAL sender */
+static SharedDecodingRole MyRole = SHARED_DECODING_NONE;
+static SharedDecodingGroup *MyGroup = NULL;
+static pid_t MyLeaderPid = 0;
+static int	MyFollowerIndex = -1;
+static Oid	MyKeyDboid = InvalidOid;
+static uint32 MyKeyHash = 0;
+static char *MyKey = NULL;
+static bool exit_callback_registered = false;
+
+/* a candidate's or follower's queue */
+static dsm_segment *follower_seg = NULL;
+static shm_mq_handle *follower_mqh = NULL;
+static XLogRecPtr last_leader_confirmed = InvalidXLogRecPtr;
+
+/* a leader's queues, by follower index */
+static dsm_segment *leader_segs[SHARED_DECODING_MAX_FOLLOWERS];
+static shm_mq_handle *leader_mqhs[SHARED_DECODING_MAX_FOLLOWERS];
+
+static void SharedDecodingJoin(void);
+static void SharedDecodingDetachFollower(int i);
+static void SharedDecodingExit(int code, Datum arg);
+
+Size
+SharedDecodingShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(SharedDecodingCtlData, groups);
+	size = add_size(size, mul_size(max_wal_senders,
+								   sizeof(SharedDecodingGroup)));
+
+	return size;
+}
+
+void
+SharedDecodingShmemInit(void)
+{
+	bool		found;
+
+	SharedDecodingCtl = (SharedDecodingCtlData *)
+		ShmemInitStruct("Shared Logical Decoding",
+						SharedDecodingShmemSize(), &found);
+
+	if (!found)
+	{
+		SpinLockInit(&SharedDecodingCtl->mutex);
+		SharedDecodingCtl->ngroups = max_wal_senders;
+		for (int i = 0; i < max_wal_senders; i++)
+		{
+			SharedDecodingGroup *group = &SharedDecodingCtl->groups[i];
+
+			memset(group, 0, sizeof(SharedDecodingGroup));
+			SpinLockInit(&group->mutex);
+			group->decoded_upto = InvalidXLogRecPtr;
+		}
+	}
+}
+
+/*
+ * Called when a WAL sender starts logical replication, after creating its
+ * decoding context, to join the group of WAL senders with the same output.
+ */
+void
+SharedDecodingStart(LogicalDecodingContext *ctx, List *options)
+{
+	StringInfoData key;
+	ListCell   *lc;
+
+	Assert(MyRole == SHARED_DECODING_NONE);
+
+	if (!logical_decoding_shared || ctx->streaming || ctx->twophase ||
+		ctx->fast_forward)
+		return;
+
+	/* Identify the output by the plugin and its options. */
+	initStringInfo(&key);
+	appendStringInfoString(&key, NameStr(ctx->slot->data.plugin));
+	foreach(lc, options)
+	{
+		DefElem    *defel = (DefElem *) lfirst(lc);
+
+		appendStringInfo(&key, "\n%s=", defel->defname);
+		if (defel->arg && IsA(defel->arg, String))
+			appendStringInfoString(&key, strVal(defel->arg));
+	}
+
+	if (key.len >= SHARED_DECODING_KEY_LEN)
+	{
+		pfree(key.data);
+		return;
+	}
+
+	if (MyKey == NULL)
+		MyKey = MemoryContextAlloc(TopMemoryContext, SHARED_DECODING_KEY_LEN);
+	strlcpy(MyKey, key.data, SHARED_DECODING_KEY_LEN);
+	MyKeyDboid = MyDatabaseId;
+	MyKeyHash = hash_bytes((const unsigned char *) key.data, key.len);
+	pfree(key.data);
+
+	if (!exit_callback_registered)
+	{
+		on_shmem_exit(SharedDecodingExit, 0);
+		exit_callback_registered = true;
+	}
+
+	SharedDecodingJoin();
+}
+
+/*
+ * Become the leader of the group for our key, or a candidate for following
+ * its current leader.
+ */
+static void
+SharedDecodingJoin(void)
+{
+	SharedDecodingGroup *free_group = NULL;
+
+	MyGroup = NULL;
+
+	SpinLockAcquire(&SharedDecodingCtl->mutex);
+	for (int i = 0; i < SharedDecodingCtl->ngroups; i++)
+	{
+		SharedDecodingGroup *group = &SharedDecodingCtl->groups[i];
+
+		if (group->leader_pid == 0)
+		{
+			if (free_group == NULL)
+				free_group = group;
+			continue;
+		}
+
+		if (group->dboid == MyKeyDboid && group->keyhash == MyKeyHash &&
+			strcmp(group->key, MyKey) == 0)
+		{
+			MyGroup = group;
+			MyLeaderPid = group->leader_pid;
+			break;
+		}
+	}
+
+	if (MyGroup == NULL && free_group != NULL)
+	{
+		SharedDecodingGroup *group = free_group;
+
+		SpinLockAcquire(&group->mutex);
+		group->leader_pid = MyProcPid;
+		group->dboid = MyKeyDboid;
+		group->keyhash = MyKeyHash;
+		strlcpy(group->key, MyKey, SHARED_DECODING_KEY_LEN);
+		group->leader_slot = MyReplicationSlot - ReplicationSlotCtl->replication_slots;
+		group->decoded_upto = InvalidXLogRecPtr;
+		group->new_followers = false;
+		memset(group->followers, 0, sizeof(group->followers));
+		SpinLockRelease(&group->mutex);
+
+		MyGroup = group;
+		MyLeaderPid = MyProcPid;
+	}
+	SpinLockRelease(&SharedDecodingCtl->mutex);
+
+	if (MyGroup == NULL)
+	{
+		MyRole = SHARED_DECODING_NONE;
+		return;
+	}
+
+	if (MyLeaderPid == MyProcPid)
+	{
+		MyRole = SHARED_DECODING_LEADER;
+		elog(DEBUG1, "leading shared logical decoding");
+		return;
+	}
+
+	/*
+	 * Set up the queue to receive the leader's output in right away, so that
+	 * attaching to the leader is cheap.
+	 */
+	MyRole = SHARED_DECODING_CANDIDATE;
+	if (follower_seg == NULL)
+	{
+		shm_mq	   *mq;
+
+		follower_seg = dsm_create(SHARED_DECODING_QUEUE_SIZE, 0);
+		dsm_pin_mapping(follower_seg);
+		mq = shm_mq_create(dsm_segment_address(follower_seg),
+						   SHARED_DECODING_QUEUE_SIZE);
+		shm_mq_set_receiver(mq, MyProc);
+		follower_mqh = shm_mq_attach(mq, follower_seg, NULL);
+	}
+}
+
+/*
+ * Stop taking part in shared decoding, when replication ends.
+ */
+void
+SharedDecodingStop(void)
+{
+	if (MyRole == SHARED_DECODING_LEADER)
+	{
+		for (int i = 0; i < SHARED_DECODING_MAX_FOLLOWERS; i++)
+			SharedDecodingDetachFollower(i);
+
+		SpinLockAcquire(&SharedDecodingCtl->mutex);
+		SpinLockAcquire(&MyGroup->mutex);
+		MyGroup->leader_pid = 0;
+		MyGroup->decoded_upto = InvalidXLogRecPtr;
+		SpinLockRelease(&MyGroup->mutex);
+		SpinLockRelease(&SharedDecodingCtl->mutex);
+	}
+	else if (MyRole == SHARED_DECODING_FOLLOWER)
+	{
+		SpinLockAcquire(&MyGroup->mutex);
+		if (MyGroup->leader_pid == MyLeaderPid &&
+			MyGroup->followers[MyFollowerIndex].pid == MyProcPid)
+			MyGroup->followers[MyFollowerIndex].pid = 0;
+		SpinLockRelease(&MyGroup->mutex);
+	}
+
+	/* The queue can't be reused once the leader has attached to it. */
+	if (follower_seg != NULL)
+	{
+		dsm_detach(follower_seg);
+		follower_seg = NULL;
+		follower_mqh = NULL;
+	}
+
+	MyRole = SHARED_DECODING_NONE;
+	MyGroup = NULL;
+	MyLeaderPid = 0;
+	MyFollowerIndex = -1;
+	last_leader_confirmed = InvalidXLogRecPtr;
+}
+
+static void
+SharedDecodingExit(int code, Datum arg)
+{
+	SharedDecodingStop();
+}
+
+/*
+ * Leader: called before decoding a record.  Attaches to the queues of the
+ * followers that joined since the last record.
+ */
+void
+SharedDecodingBeginRecord(void)
+{
+	SharedDecodingFollower newfollowers[SHARED_DECODING_MAX_FOLLOWERS];
+	bool		have_new;
+	bool		attached = false;
+
+	if (MyRole != SHARED_DECODING_LEADER)
+		return;
+
+	SpinLockAcquire(&MyGroup->mutex);
+	MyGroup->decoded_upto = InvalidXLogRecPtr;
+	have_new = MyGroup->new_followers;
+	if (have_new)
+	{
+		for (int i = 0; i < SHARED_DECODING_MAX_FOLLOWERS; i++)
+		{
+			SharedDecodingFollower *follower = &MyGroup->followers[i];
+
+			newfollowers[i] = *follower;
+			if (follower->pid != 0)
+				follower->attached = true;
+		}
+		MyGroup->new_followers = false;
+	}
+	SpinLockRelease(&MyGroup->mutex);
+
+	if (!have_new)
+		return;
+
+	for (int i = 0; i < SHARED_DECODING_MAX_FOLLOWERS; i++)
+	{
+		dsm_segment *seg;
+		shm_mq	   *mq;
+
+		if (newfollowers[i].pid == 0 || newfollowers[i].attached)
+			continue;
+
+		/* a leftover queue of an earlier follower in this place */
+		if (leader_segs[i] != NULL)
+		{
+			shm_mq_detach(leader_mqhs[i]);
+			dsm_detach(leader_segs[i]);
+			leader_segs[i] = NULL;
+			leader_mqhs[i] = NULL;
+		}
+
+		seg = dsm_attach(newfollowers[i].handle);
+		if (seg == NULL)
+		{
+			/* the follower has gone away already */
+			SpinLockAcquire(&MyGroup->mutex);
+			if (MyGroup->followers[i].pid == newfollowers[i].pid)
+				MyGroup->followers[i].pid = 0;
+			SpinLockRelease(&MyGroup->mutex);
+			continue;
+		}
+		dsm_pin_mapping(seg);
+
+		mq = dsm_segment_address(seg);
+		shm_mq_set_sender(mq, MyProc);
+		leader_segs[i] = seg;
+		leader_mqhs[i] = shm_mq_attach(mq, seg, NULL);
+		attached = true;
+	}
+
+	/*
+	 * The new followers' clients may not know the relations we have already
+	 * described to ours, so make the output plugin describe them again.
+	 */
+	if (attached)
+		InvalidateSystemCaches();
+}
+
+/*
+ * Called after decoding a record.  The leader publishes how far it has
+ * decoded; a candidate checks whether it has reached the same position, and
+ * if so, attaches to the leader.
+ */
+void
+SharedDecodingEndRecord(LogicalDecodingContext *ctx)
+{
+	XLogRecPtr	endptr = ctx->reader->EndRecPtr;
+	bool		can_follow;
+
+	if (MyRole != SHARED_DECODING_LEADER &&
+		MyRole != SHARED_DECODING_CANDIDATE)
+		return;
+
+	/* Is our output from here on what the leader's is? */
+	can_follow = SnapBuildCurrentState(ctx->snapshot_builder) == SNAPBUILD_CONSISTENT &&
+		!SnapBuildXactNeedsSkip(ctx->snapshot_builder, endptr);
+
+	if (MyRole == SHARED_DECODING_LEADER)
+	{
+		if (can_follow)
+		{
+			SpinLockAcquire(&MyGroup->mutex);
+			MyGroup->decoded_upto = endptr;
+			SpinLockRelease(&MyGroup->mutex);
+		}
+		return;
+	}
+
+	if (!can_follow)
+		return;
+
+	SpinLockAcquire(&MyGroup->mutex);
+	if (MyGroup->leader_pid != MyLeaderPid)
+	{
+		/* the leader is gone, look for a new one */
+		SpinLockRelease(&MyGroup->mutex);
+		SharedDecodingJoin();
+		return;
+	}
+
+	if (MyGroup->decoded_upto == endptr)
+	{
+		for (int i = 0; i < SHARED_DECODING_MAX_FOLLOWERS; i++)
+		{
+			SharedDecodingFollower *follower = &MyGroup->followers[i];
+
+			if (follower->pid != 0)
+				continue;
+
+			follower->pid = MyProcPid;
+			follower->handle = dsm_segment_handle(follower_seg);
+			follower->attached = false;
+			MyGroup->new_followers = true;
+			MyFollowerIndex = i;
+			MyRole = SHARED_DECODING_FOLLOWER;
+			break;
+		}
+	}
+	SpinLockRelease(&MyGroup->mutex);
+
+	if (MyRole == SHARED_DECODING_FOLLOWER)
+		ereport(LOG,
+				(errmsg("following shared logical decoding of process %d at %X/%X",
+						(int) MyLeaderPid, LSN_FORMAT_ARGS(endptr))));
+}
+
+/*
+ * Leader: forward a message written by the output plugin to the followers.
+ */
+void
+SharedDecodingForward(const char *data, Size len)
+{
+	if (MyRole != SHARED_DECODING_LEADER)
+		return;
+
+	for (int i = 0; i < SHARED_DECODING_MAX_FOLLOWERS; i++)
+	{
+		if (leader_mqhs[i] == NULL)
+			continue;
+
+		if (shm_mq_send(leader_mqhs[i], len, data, true, true) != SHM_MQ_SUCCESS)
+		{
+			elog(DEBUG1, "shared logical decoding follower %d fell behind",
+				 i);
+			SharedDecodingDetachFollower(i);
+		}
+	}
+}
+
+/*
+ * Leader: stop forwarding to a follower.  The follower notices that we
+ * detached from its queue.
+ */
+static void
+SharedDecodingDetachFollower(int i)
+{
+	if (leader_segs[i] == NULL)
+		return;
+
+	shm_mq_detach(leader_mqhs[i]);
+	dsm_detach(leader_segs[i]);
+	leader_segs[i] = NULL;
+	leader_mqhs[i] = NULL;
+
+	SpinLockAcquire(&MyGroup->mutex);
+	if (MyGroup->followers[i].attached)
+		MyGroup->followers[i].pid = 0;
+	SpinLockRelease(&MyGroup->mutex);
+}
+
+bool
+SharedDecodingIsFollower(void)
+{
+	return MyRole == SHARED_DECODING_FOLLOWER;
+}
+
+/*
+ * Follower: receive the next message forwarded by the leader without
+ * waiting.  Returns false if there is none; *upto is then set to the
+ * position up to which everything the leader decoded has been received, or
+ * InvalidXLogRecPtr if that isn't known.  The message remains valid until
+ * the next call.
+ */
+bool
+SharedDecodingReceive(char **data, Size *len, XLogRecPtr *upto)
+{
+	shm_mq_result res;
+	XLogRecPtr	decoded_upto;
+	bool		leader_alive;
+	void	   *msg;
+
+	Assert(MyRole == SHARED_DECODING_FOLLOWER);
+
+	/*
+	 * Read the leader's position first: whatever it produced up to there is
+	 * in the queue already.
+	 */
+	SpinLockAcquire(&MyGroup->mutex);
+	leader_alive = MyGroup->leader_pid == MyLeaderPid;
+	decoded_upto = MyGroup->decoded_upto;
+	SpinLockRelease(&MyGroup->mutex);
+
+	res = shm_mq_receive(follower_mqh, len, &msg, true);
+	if (res == SHM_MQ_SUCCESS)
+	{
+		*data = msg;
+		*upto = InvalidXLogRecPtr;
+		return true;
+	}
+
+	if (res == SHM_MQ_DETACHED || !leader_alive)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("lost connection to shared logical decoding process %d",
+						(int) MyLeaderPid),
+				 errhint("The client should reconnect to continue decoding.")));
+
+	*upto = decoded_upto;
+	return false;
+}
+
+/*
+ * Follower: take over the leader's restart_lsn and catalog_xmin, to become
+ * effective once our client has confirmed the leader's confirmed_flush.
+ */
+void
+SharedDecodingAdvanceSlot(void)
+{
+	ReplicationSlot *slot;
+	XLogRecPtr	confirmed_flush = InvalidXLogRecPtr;
+	XLogRecPtr	restart_lsn = InvalidXLogRecPtr;
+	TransactionId catalog_xmin = InvalidTransactionId;
+
+	Assert(MyRole == SHARED_DECODING_FOLLOWER);
+
+	slot = &ReplicationSlotCtl->replication_slots[MyGroup->leader_slot];
+	SpinLockAcquire(&slot->mutex);
+	if (slot->active_pid == MyLeaderPid)
+	{
+		confirmed_flush = slot->data.confirmed_flush;
+		restart_lsn = slot->data.restart_lsn;
+		catalog_xmin = slot->data.catalog_xmin;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (XLogRecPtrIsInvalid(confirmed_flush) ||
+		confirmed_flush == last_leader_confirmed)
+		return;
+	last_leader_confirmed = confirmed_flush;
+
+	if (TransactionIdIsValid(catalog_xmin))
+		LogicalIncreaseXminForSlot(confirmed_flush, catalog_xmin);
+	if (!XLogRecPtrIsInvalid(restart_lsn))
+		LogicalIncreaseRestartDecodingForSlot(confirmed_flush, restart_lsn);
+}
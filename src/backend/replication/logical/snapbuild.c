@@ -135,11 +135,34 @@
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/standby.h"
+#include "portability/instr_time.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
 #include "utils/snapshot.h"
 
+/*
+ * Storage behind the committed.xip array of a snapshot builder.
+ *
+ * Historic snapshots built by SnapBuildBuildSnapshot() don't copy the array
+ * but point their ->xip into it, holding a reference each, so building a
+ * snapshot costs the same regardless of how many committed transactions are
+ * tracked.  The first nvisible entries may be seen by such snapshots and
+ * therefore must never change while another reference exists; the builder
+ * makes a private copy of the array before modifying them (see
+ * SnapBuildCommittedMakeWritable()).  Appending, the common case, never
+ * needs a copy.
+ */
+typedef struct SnapBuildXidArray
+{
+	int			refcount;		/* builder's reference plus one per snapshot */
+	size_t		nvisible;		/* leading entries visible to snapshots */
+	TransactionId xip[FLEXIBLE_ARRAY_MEMBER];
+} SnapBuildXidArray;
+
+#define SnapBuildXidArrayFromXip(x) \
+	((SnapBuildXidArray *) ((char *) (x) - offsetof(SnapBuildXidArray, xip)))
+
 /*
  * This struct contains the current state of the snapshot building
  * machinery. Besides a forward declaration in the header, it is not exposed
@@ -229,16 +252,9 @@ struct SnapBuild
 		/*
 		 * Array of committed transactions that have modified the catalog.
 		 *
-		 * As this array is frequently modified we do *not* keep it in
-		 * xidComparator order. Instead we sort the array when building &
-		 * distributing a snapshot.
-		 *
-		 * TODO: It's unclear whether that reasoning has much merit. Every
-		 * time we add something here after becoming consistent will also
-		 * require distributing a snapshot. Storing them sorted would
-		 * potentially also make it easier to purge (but more complicated wrt
-		 * wraparound?). Should be improved if sorting while building the
-		 * snapshot shows up in profiles.
+		 * The array is kept in xidComparator order, so that snapshots can
+		 * share it instead of copying and sorting it on every build.  It is
+		 * the xip member of a SnapBuildXidArray.
 		 */
 		TransactionId *xip;
 	}			committed;
@@ -288,6 +304,11 @@ static void SnapBuildFreeSnapshot(Snapshot snap);
 
 static void SnapBuildSnapIncRefcount(Snapshot snap);
 
+static TransactionId *SnapBuildAllocXids(SnapBuild *builder, size_t space);
+static void SnapBuildReleaseXids(TransactionId *xip);
+static void SnapBuildCommittedMakeWritable(SnapBuild *builder, size_t off,
+										   size_t space);
+
 static void SnapBuildDistributeNewCatalogSnapshot(SnapBuild *builder, XLogRecPtr lsn);
 
 static inline bool SnapBuildXidHasCatalogChanges(SnapBuild *builder, TransactionId xid,
@@ -336,7 +357,7 @@ AllocateSnapshotBuilder(ReorderBuffer *reorder,
 	builder->committed.xcnt = 0;
 	builder->committed.xcnt_space = 128;	/* arbitrary number */
 	builder->committed.xip =
-		palloc0(builder->committed.xcnt_space * sizeof(TransactionId));
+		SnapBuildAllocXids(builder, builder->committed.xcnt_space);
 	builder->committed.includes_all_transactions = true;
 
 	builder->catchange.xcnt = 0;
@@ -393,6 +414,7 @@ SnapBuildFreeSnapshot(Snapshot snap)
 	if (snap->active_count)
 		elog(ERROR, "cannot free an active snapshot");
 
+	SnapBuildReleaseXids(snap->xip);
 	pfree(snap);
 }
 
@@ -486,15 +508,15 @@ static Snapshot
 SnapBuildBuildSnapshot(SnapBuild *builder) // 先分配一块内存，再把已经提交的事务的事务号数组拷贝到snap中，返回这个snap
 {
 	Snapshot	snapshot;
-	Size		ssize;
+	SnapBuildXidArray *xids;
+	instr_time	start_time;
+	instr_time	duration;
 
 	Assert(builder->state >= SNAPBUILD_FULL_SNAPSHOT);
 
-	ssize = sizeof(SnapshotData)
-		+ sizeof(TransactionId) * builder->committed.xcnt // 这是一个事务号的数组
-		+ sizeof(TransactionId) * 1 /* toplevel xid */ ; 
+	INSTR_TIME_SET_CURRENT(start_time);
 
-	snapshot = MemoryContextAllocZero(builder->context, ssize); // snapshot的内存就在snapbuilder的内存池中分配
+	snapshot = MemoryContextAllocZero(builder->context, sizeof(SnapshotData)); // snapshot的内存就在snapbuilder的内存池中分配
 
 	snapshot->snapshot_type = SNAPSHOT_HISTORIC_MVCC;
 
@@ -525,16 +547,16 @@ SnapBuildBuildSnapshot(SnapBuild *builder) // 先分配一块内存，再把已
 	snapshot->xmin = builder->xmin;
 	snapshot->xmax = builder->xmax;
 
-	/* store all transactions to be treated as committed by this snapshot */
-	snapshot->xip =
-		(TransactionId *) ((char *) snapshot + sizeof(SnapshotData));
+	/*
+	 * Store all transactions to be treated as committed by this snapshot.
+	 * The builder's array is already sorted so we can bsearch() it, and we
+	 * just share it; see SnapBuildXidArray.
+	 */
+	xids = SnapBuildXidArrayFromXip(builder->committed.xip);
+	xids->refcount++;
+	xids->nvisible = Max(xids->nvisible, builder->committed.xcnt);
+	snapshot->xip = builder->committed.xip;
 	snapshot->xcnt = builder->committed.xcnt;
-	memcpy(snapshot->xip,
-		   builder->committed.xip,
-		   builder->committed.xcnt * sizeof(TransactionId)); // 把builder中的committed.xip数组的内容拷贝到snap的xip数组中
-
-	/* sort so we can bsearch() */
-	qsort(snapshot->xip, snapshot->xcnt, sizeof(TransactionId), xidComparator); // 对xip数组进行快速排序，所以xip数组是排序的
 
 	/*
 	 * Initially, subxip is empty, i.e. it's a snapshot to be used by
@@ -552,9 +574,89 @@ SnapBuildBuildSnapshot(SnapBuild *builder) // 先分配一块内存，再把已
 	snapshot->regd_count = 0;
 	snapshot->snapXactCompletionCount = 0;
 
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start_time);
+	builder->reorder->snapBuildTime += INSTR_TIME_GET_MICROSEC(duration);
+
 	return snapshot;
 }
 
+/*
+ * Allocate storage for a committed.xip array with room for space xids,
+ * returning the xip array of a SnapBuildXidArray with one reference.
+ */
+static TransactionId *
+SnapBuildAllocXids(SnapBuild *builder, size_t space)
+{
+	SnapBuildXidArray *xids;
+
+	xids = MemoryContextAllocZero(builder->context,
+								  offsetof(SnapBuildXidArray, xip) +
+								  space * sizeof(TransactionId));
+	xids->refcount = 1;
+	xids->nvisible = 0;
+
+	return xids->xip;
+}
+
+/*
+ * Drop a reference to the SnapBuildXidArray containing xip, freeing it once
+ * nobody references it anymore.
+ */
+static void
+SnapBuildReleaseXids(TransactionId *xip)
+{
+	SnapBuildXidArray *xids = SnapBuildXidArrayFromXip(xip);
+
+	Assert(xids->refcount > 0);
+	if (--xids->refcount == 0)
+		pfree(xids);
+}
+
+/*
+ * Make sure the builder's committed.xip array can hold space xids and that
+ * the entries from index off onwards may be modified.
+ *
+ * If snapshots might see any of those entries, or the array has to grow but
+ * snapshots still point into it, the builder switches to a private copy.
+ */
+static void
+SnapBuildCommittedMakeWritable(SnapBuild *builder, size_t off, size_t space)
+{
+	SnapBuildXidArray *xids = SnapBuildXidArrayFromXip(builder->committed.xip);
+	TransactionId *newxip;
+
+	/* nobody else can see the array, so forget about earlier snapshots */
+	if (xids->refcount == 1)
+		xids->nvisible = 0;
+
+	if (off >= xids->nvisible && space <= builder->committed.xcnt_space)
+		return;
+
+	if (space > builder->committed.xcnt_space)
+	{
+		builder->committed.xcnt_space = Max(space,
+											builder->committed.xcnt_space * 2 + 1);
+
+		elog(DEBUG1, "increasing space for committed transactions to %u",
+			 (uint32) builder->committed.xcnt_space);
+	}
+
+	if (xids->refcount == 1)
+	{
+		xids = repalloc(xids, offsetof(SnapBuildXidArray, xip) +
+						builder->committed.xcnt_space * sizeof(TransactionId));
+		builder->committed.xip = xids->xip;
+		return;
+	}
+
+	newxip = SnapBuildAllocXids(builder, builder->committed.xcnt_space);
+	memcpy(newxip, builder->committed.xip,
+		   builder->committed.xcnt * sizeof(TransactionId));
+	SnapBuildReleaseXids(builder->committed.xip);
+	builder->committed.xip = newxip;
+}
+
 /*
  * Build the initial slot snapshot and convert it to a normal snapshot that
  * is understood by HeapTupleSatisfiesMVCC.
@@ -646,6 +748,7 @@ SnapBuildInitialSnapshot(SnapBuild *builder)
 	}
 
 	/* adjust remaining snapshot fields as needed */
+	SnapBuildReleaseXids(snap->xip);
 	snap->snapshot_type = SNAPSHOT_MVCC;
 	snap->xcnt = newxcnt;
 	snap->xip = newxip;
@@ -909,25 +1012,26 @@ SnapBuildDistributeNewCatalogSnapshot(SnapBuild *builder, XLogRecPtr lsn)
 static void
 SnapBuildAddCommittedTxn(SnapBuild *builder, TransactionId xid)
 {
-	Assert(TransactionIdIsValid(xid));
-
-	if (builder->committed.xcnt == builder->committed.xcnt_space)
-	{
-		builder->committed.xcnt_space = builder->committed.xcnt_space * 2 + 1;
+	size_t		off;
 
-		elog(DEBUG1, "increasing space for committed transactions to %u",
-			 (uint32) builder->committed.xcnt_space);
-
-		builder->committed.xip = repalloc(builder->committed.xip,
-										  builder->committed.xcnt_space * sizeof(TransactionId));
-	}
+	Assert(TransactionIdIsValid(xid));
 
 	/*
-	 * TODO: It might make sense to keep the array sorted here instead of
-	 * doing it every time we build a new snapshot. On the other hand this
-	 * gets called repeatedly when a transaction with subtransactions commits.
+	 * Find the insertion point that keeps the array in xidComparator order.
+	 * Catalog modifying transactions mostly commit in xid order, so this is
+	 * usually the end of the array, and otherwise close to it.
 	 */
-	builder->committed.xip[builder->committed.xcnt++] = xid;
+	off = builder->committed.xcnt;
+	while (off > 0 && builder->committed.xip[off - 1] > xid)
+		off--;
+
+	SnapBuildCommittedMakeWritable(builder, off, builder->committed.xcnt + 1);
+
+	if (off < builder->committed.xcnt)
+		memmove(&builder->committed.xip[off + 1], &builder->committed.xip[off],
+				(builder->committed.xcnt - off) * sizeof(TransactionId));
+	builder->committed.xip[off] = xid;
+	builder->committed.xcnt++;
 }
 
 /*
@@ -944,38 +1048,45 @@ static void
 SnapBuildPurgeOlderTxn(SnapBuild *builder)
 {
 	int			off;
-	TransactionId *workspace;
 	int			surviving_xids = 0;
 
 	/* not ready yet */
 	if (!TransactionIdIsNormal(builder->xmin))
 		return;
 
-	/* TODO: Neater algorithm than just copying and iterating? */
-	workspace =
-		MemoryContextAlloc(builder->context,
-						   builder->committed.xcnt * sizeof(TransactionId));
-
-	/* copy xids that still are interesting to workspace */
+	/* find the first xid that needs to be removed, if any */
 	for (off = 0; off < builder->committed.xcnt; off++)
 	{
 		if (NormalTransactionIdPrecedes(builder->committed.xip[off],
 										builder->xmin))
-			;					/* remove */
-		else
-			workspace[surviving_xids++] = builder->committed.xip[off];
+			break;
 	}
 
-	/* copy workspace back to persistent state */
-	memcpy(builder->committed.xip, workspace,
-		   surviving_xids * sizeof(TransactionId));
+	/*
+	 * Compact the xids that still are interesting, keeping their order.
+	 * Snapshots may still be looking at the array, so get a private copy
+	 * first if needed.
+	 */
+	if (off < builder->committed.xcnt)
+	{
+		SnapBuildCommittedMakeWritable(builder, off, builder->committed.xcnt);
 
-	elog(DEBUG3, "purged committed transactions from %u to %u, xmin: %u, xmax: %u",
-		 (uint32) builder->committed.xcnt, (uint32) surviving_xids,
-		 builder->xmin, builder->xmax);
-	builder->committed.xcnt = surviving_xids;
+		surviving_xids = off;
+		for (; off < builder->committed.xcnt; off++)
+		{
+			if (NormalTransactionIdPrecedes(builder->committed.xip[off],
+											builder->xmin))
+				;				/* remove */
+			else
+				builder->committed.xip[surviving_xids++] =
+					builder->committed.xip[off];
+		}
 
-	pfree(workspace);
+		elog(DEBUG3, "purged committed transactions from %u to %u, xmin: %u, xmax: %u",
+			 (uint32) builder->committed.xcnt, (uint32) surviving_xids,
+			 builder->xmin, builder->xmax);
+		builder->committed.xcnt = surviving_xids;
+	}
 
 	/*
 	 * Purge xids in ->catchange as well. The purged array must also be sorted
@@ -1903,7 +2014,8 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 	if (ondisk.builder.committed.xcnt > 0)
 	{
 		sz = sizeof(TransactionId) * ondisk.builder.committed.xcnt;
-		ondisk.builder.committed.xip = MemoryContextAllocZero(builder->context, sz);
+		ondisk.builder.committed.xip =
+			SnapBuildAllocXids(builder, ondisk.builder.committed.xcnt);
 		SnapBuildRestoreContents(fd, (char *) ondisk.builder.committed.xip, sz, path);
 		COMP_CRC32C(checksum, ondisk.builder.committed.xip, sz);
 	}
@@ -1968,9 +2080,13 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 	/* don't overwrite preallocated xip, if we don't have anything here */
 	if (builder->committed.xcnt > 0)
 	{
-		pfree(builder->committed.xip);
+		SnapBuildReleaseXids(builder->committed.xip);
 		builder->committed.xcnt_space = ondisk.builder.committed.xcnt;
 		builder->committed.xip = ondisk.builder.committed.xip;
+
+		/* files written by older releases didn't keep the array sorted */
+		qsort(builder->committed.xip, builder->committed.xcnt,
+			  sizeof(TransactionId), xidComparator);
 	}
 	ondisk.builder.committed.xip = NULL;
 
@@ -2001,7 +2117,7 @@ SnapBuildRestore(SnapBuild *builder, XLogRecPtr lsn)
 
 snapshot_not_interesting:
 	if (ondisk.builder.committed.xip != NULL)
-		pfree(ondisk.builder.committed.xip);
+		SnapBuildReleaseXids(ondisk.builder.committed.xip);
 	if (ondisk.builder.catchange.xip != NULL)
 		pfree(ondisk.builder.catchange.xip);
 	return false;
@@ -54,6 +54,14 @@
  *	  So the state progression is always: INIT -> DATASYNC -> FINISHEDCOPY
  *	  -> SYNCWAIT -> CATCHUP -> SYNCDONE -> READY.
  *
+ *	  A large table can be copied over several publisher connections at once
+ *	  (see max_sync_copy_streams_per_table).  The snapshot the tablesync slot
+ *	  was created with is exported and imported by the additional
+ *	  connections, and each connection copies a range of ctids, which the
+ *	  publisher can read with a TID Range Scan.  The rows of all the streams
+ *	  are loaded by a single COPY FROM in the sync worker's transaction, so
+ *	  the table still moves to FINISHEDCOPY only once all the ranges are in.
+ *
  *	  The catalog pg_subscription_rel is used to keep information about
  *	  subscribed tables and their state.  The catalog holds all states
  *	  except SYNCWAIT and CATCHUP which are only in shared memory.
@@ -106,6 +114,7 @@
 #include "pgstat.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalrelation.h"
+#include "replication/logicalworker.h"
 #include "replication/walreceiver.h"
 #include "replication/worker_internal.h"
 #include "replication/slot.h"
@@ -128,6 +137,35 @@ static bool FetchTableStates(bool *started_tx);
 
 static StringInfo copybuf = NULL; // 使用StringInfo数据结构来表示拷贝的数据
 
+/* GUC variable */
+int			max_sync_copy_streams_per_table = 1;
+
+/*
+ * Minimum number of publisher pages each stream of a parallel copy should
+ * get (1GB with the default block size).  Smaller tables are copied over the
+ * sync worker's own connection only.
+ */
+#define COPY_STREAM_MIN_PAGES	131072
+
+/*
+ * Publisher connection the initial data is read from.  The first stream is
+ * always LogRepWorkerWalRcvConn.
+ */
+typedef struct CopyStream
+{
+	WalReceiverConn *conn;
+	pgsocket	fd;				/* socket to wait on for more data */
+	bool		done;			/* has the COPY on this connection ended? */
+} CopyStream;
+
+static CopyStream *copy_streams = NULL;
+static int	ncopy_streams = 0;
+static int	ncopy_streams_active = 0;
+static int	copy_stream_current = 0;
+
+static void next_copy_stream(void);
+static void wait_for_copy_streams(void);
+
 /*
  * Exit routine for synchronization worker.
  */
@@ -704,21 +742,46 @@ copy_read_data(void *outbuf, int minread, int maxread) // COPY命令获取数据
 
 	while (maxread > 0 && bytesread < minread) // 读取的字节数还不够minread
 	{
-		pgsocket	fd = PGINVALID_SOCKET;
+		int			nidle = 0;
 		int			len;
 		char	   *buf = NULL;
 
 		for (;;)
 		{
+			CopyStream *stream;
+
+			/* All the streams have reached the end of their COPY. */
+			if (ncopy_streams_active == 0)
+				return bytesread;
+
+			stream = &copy_streams[copy_stream_current];
+			if (stream->done)
+			{
+				next_copy_stream();
+				continue;
+			}
+
 			/* Try read the data. */
-			len = walrcv_receive(LogRepWorkerWalRcvConn, &buf, &fd); // 从publisher端读取数据
+			len = walrcv_receive(stream->conn, &buf, &stream->fd); // 从publisher端读取数据
 
 			CHECK_FOR_INTERRUPTS();
 
 			if (len == 0)
-				break;
+			{
+				/* Wait once none of the streams has data available. */
+				if (++nidle >= ncopy_streams_active)
+					break;
+				next_copy_stream();
+				continue;
+			}
 			else if (len < 0)
-				return bytesread;
+			{
+				stream->done = true;
+				ncopy_streams_active--;
+				nidle = 0;
+				next_copy_stream();
+				continue;
+			}
 			else // 我们已经读到数据了
 			{
 				/* Process the data */
@@ -734,6 +797,13 @@ copy_read_data(void *outbuf, int minread, int maxread) // COPY命令获取数据
 				copybuf->cursor += avail;
 				maxread -= avail;
 				bytesread += avail;
+				nidle = 0;
+
+				/*
+				 * The publisher sends one row per CopyData message, so the
+				 * streams can be interleaved at message boundaries.
+				 */
+				next_copy_stream();
 			}
 
 			if (maxread <= 0 || bytesread >= minread)
@@ -743,15 +813,62 @@ copy_read_data(void *outbuf, int minread, int maxread) // COPY命令获取数据
 		/*
 		 * Wait for more data or latch.
 		 */
+		wait_for_copy_streams();
+	}
+
+	return bytesread;
+}
+
+/*
+ * Advance copy_stream_current to the next stream whose COPY is still going
+ * on, if any.
+ */
+static void
+next_copy_stream(void)
+{
+	for (int i = 0; i < ncopy_streams; i++)
+	{
+		copy_stream_current = (copy_stream_current + 1) % ncopy_streams;
+		if (!copy_streams[copy_stream_current].done)
+			break;
+	}
+}
+
+/*
+ * Wait until one of the streams becomes readable, or the latch is set.
+ */
+static void
+wait_for_copy_streams(void)
+{
+	if (ncopy_streams == 1)
 		(void) WaitLatchOrSocket(MyLatch,
 								 WL_SOCKET_READABLE | WL_LATCH_SET |
 								 WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
-								 fd, 1000L, WAIT_EVENT_LOGICAL_SYNC_DATA);
+								 copy_streams[0].fd, 1000L,
+								 WAIT_EVENT_LOGICAL_SYNC_DATA);
+	else
+	{
+		WaitEventSet *set;
+		WaitEvent	event;
+
+		set = CreateWaitEventSet(CurrentMemoryContext, ncopy_streams + 2);
+		AddWaitEventToSet(set, WL_LATCH_SET, PGINVALID_SOCKET, MyLatch, NULL);
+		AddWaitEventToSet(set, WL_EXIT_ON_PM_DEATH, PGINVALID_SOCKET,
+						  NULL, NULL);
+		for (int i = 0; i < ncopy_streams; i++)
+		{
+			if (copy_streams[i].done || copy_streams[i].fd == PGINVALID_SOCKET)
+				continue;
+			AddWaitEventToSet(set, WL_SOCKET_READABLE, copy_streams[i].fd,
+							  NULL, NULL);
+		}
 
-		ResetLatch(MyLatch);
+		(void) WaitEventSetWait(set, 1000L, &event, 1,
+								WAIT_EVENT_LOGICAL_SYNC_DATA);
+		FreeWaitEventSet(set);
 	}
 
-	return bytesread;
+	ResetLatch(MyLatch);
 }
 
 
@@ -1077,56 +1194,201 @@ fetch_remote_table_info(char *nspname, char *relname,
 }
 
 /*
- * Copy existing data of a table from publisher.
+ * Decide over how many publisher connections to copy the table.
  *
- * Caller is responsible for locking the local relation.
+ * Only plain tables large enough to give each stream COPY_STREAM_MIN_PAGES
+ * are split up, and only in text format: every binary COPY has its own
+ * header and trailer, so binary streams cannot simply be interleaved.  The
+ * ctid range quals need a publisher with TID Range Scans.  On return,
+ * *nblocks is the publisher's size of the table.
+ */
+static int
+copy_table_num_streams(LogicalRepRelation *lrel, bool binary,
+					   BlockNumber *nblocks)
+{
+	WalRcvExecResult *res;
+	TupleTableSlot *slot;
+	Oid			sizeRow[] = {INT8OID};
+	char	   *cmd;
+	bool		isnull;
+	int64		npages;
+
+	*nblocks = 0;
+
+	if (max_sync_copy_streams_per_table <= 1 ||
+		lrel->relkind != RELKIND_RELATION || binary ||
+		walrcv_server_version(LogRepWorkerWalRcvConn) < 140000)
+		return 1;
+
+	cmd = psprintf("SELECT pg_catalog.pg_relation_size(%u) /"
+				   " pg_catalog.current_setting('block_size')::pg_catalog.int8",
+				   lrel->remoteid);
+	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd, lengthof(sizeRow), sizeRow);
+	pfree(cmd);
+
+	if (res->status != WALRCV_OK_TUPLES)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not fetch size of table \"%s.%s\" from publisher: %s",
+						lrel->nspname, lrel->relname, res->err)));
+
+	slot = MakeSingleTupleTableSlot(res->tupledesc, &TTSOpsMinimalTuple);
+	if (!tuplestore_gettupleslot(res->tuplestore, true, false, slot))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("table \"%s.%s\" not found on publisher",
+						lrel->nspname, lrel->relname)));
+
+	npages = DatumGetInt64(slot_getattr(slot, 1, &isnull));
+	Assert(!isnull);
+
+	ExecDropSingleTupleTableSlot(slot);
+	walrcv_clear_result(res);
+
+	*nblocks = (BlockNumber) npages;
+
+	return (int) Max(Min(npages / COPY_STREAM_MIN_PAGES,
+						 max_sync_copy_streams_per_table), 1);
+}
+
+/*
+ * Open the additional connections of a parallel copy.
+ *
+ * Each of them reads in a transaction using the snapshot the tablesync slot
+ * was created with, exported from LogRepWorkerWalRcvConn.  The exported
+ * snapshot remains valid until that connection's transaction ends, which
+ * happens only once the copy is done.
  */
 static void
-copy_table(Relation rel) // 从publisher端拷贝数据
+copy_table_open_streams(void)
 {
-	LogicalRepRelMapEntry *relmapentry;
-	LogicalRepRelation lrel;
-	List	   *qual = NIL;
 	WalRcvExecResult *res;
-	StringInfoData cmd;
-	CopyFromState cstate;
-	List	   *attnamelist;
-	ParseState *pstate;
-	List	   *options = NIL;
+	TupleTableSlot *slot;
+	Oid			snapRow[] = {TEXTOID};
+	char		appname[NAMEDATALEN];
+	char	   *snapshot;
+	char	   *cmd;
+	bool		must_use_password;
+	bool		isnull;
 
-	/* Get the publisher relation info. */
-	fetch_remote_table_info(get_namespace_name(RelationGetNamespace(rel)),
-							RelationGetRelationName(rel), &lrel, &qual); // 从publisher出获得表的信息
+	res = walrcv_exec(LogRepWorkerWalRcvConn,
+					  "SELECT pg_catalog.pg_export_snapshot()",
+					  lengthof(snapRow), snapRow);
+	if (res->status != WALRCV_OK_TUPLES)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("table copy could not export snapshot on publisher: %s",
+						res->err)));
 
-	/* Put the relation into relmap. */
-	logicalrep_relmap_update(&lrel);
+	slot = MakeSingleTupleTableSlot(res->tupledesc, &TTSOpsMinimalTuple);
+	if (!tuplestore_gettupleslot(res->tuplestore, true, false, slot))
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("table copy could not export snapshot on publisher")));
+	snapshot = TextDatumGetCString(slot_getattr(slot, 1, &isnull));
+	Assert(!isnull);
+	ExecDropSingleTupleTableSlot(slot);
+	walrcv_clear_result(res);
 
-	/* Map the publisher relation to local one. */
-	relmapentry = logicalrep_rel_open(lrel.remoteid, NoLock);
-	Assert(rel == relmapentry->localrel);
+	cmd = psprintf("SET TRANSACTION SNAPSHOT %s", quote_literal_cstr(snapshot));
 
-	/* Start copy on the publisher. */
-	initStringInfo(&cmd); // 为cmd分配1KB的内存
+	/* Same rules as for the sync worker's own connection. */
+	must_use_password = MySubscription->passwordrequired &&
+		!superuser_arg(MySubscription->owner);
+	ReplicationSlotNameForTablesync(MySubscription->oid,
+									MyLogicalRepWorker->relid,
+									appname, sizeof(appname));
 
+	for (int i = 1; i < ncopy_streams; i++)
+	{
+		WalReceiverConn *conn;
+		char	   *err;
+
+		conn = walrcv_connect(MySubscription->conninfo, true,
+							  must_use_password, appname, &err);
+		if (conn == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("could not connect to the publisher: %s", err)));
+		copy_streams[i].conn = conn;
+
+		res = walrcv_exec(conn,
+						  "BEGIN READ ONLY ISOLATION LEVEL REPEATABLE READ",
+						  0, NULL);
+		if (res->status != WALRCV_OK_COMMAND)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("table copy could not start transaction on publisher: %s",
+							res->err)));
+		walrcv_clear_result(res);
+
+		res = walrcv_exec(conn, cmd, 0, NULL);
+		if (res->status != WALRCV_OK_COMMAND)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("table copy could not import snapshot on publisher: %s",
+							res->err)));
+		walrcv_clear_result(res);
+	}
+
+	pfree(cmd);
+}
+
+/*
+ * End the transactions of the additional connections of a parallel copy and
+ * close them.
+ */
+static void
+copy_table_close_streams(void)
+{
+	for (int i = 1; i < ncopy_streams; i++)
+	{
+		WalRcvExecResult *res;
+
+		res = walrcv_exec(copy_streams[i].conn, "COMMIT", 0, NULL);
+		if (res->status != WALRCV_OK_COMMAND)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("table copy could not finish transaction on publisher: %s",
+							res->err)));
+		walrcv_clear_result(res);
+
+		walrcv_disconnect(copy_streams[i].conn);
+	}
+
+	pfree(copy_streams);
+	copy_streams = NULL;
+	ncopy_streams = ncopy_streams_active = 0;
+}
+
+/*
+ * Build the COPY command for one of nstreams streams.  With more than one
+ * stream, the table's nblocks pages are divided evenly among them; the first
+ * and the last range are left open so that no row is missed.
+ */
+static void
+make_copy_command(StringInfo cmd, LogicalRepRelation *lrel, List *qual,
+				  int stream, int nstreams, BlockNumber nblocks)
+{
 	/* Regular table with no row filter */
-	if (lrel.relkind == RELKIND_RELATION && qual == NIL)
+	if (lrel->relkind == RELKIND_RELATION && qual == NIL && nstreams == 1)
 	{
-		appendStringInfo(&cmd, "COPY %s (",
-						 quote_qualified_identifier(lrel.nspname, lrel.relname));
+		appendStringInfo(cmd, "COPY %s (",
+						 quote_qualified_identifier(lrel->nspname, lrel->relname));
 
 		/*
 		 * XXX Do we need to list the columns in all cases? Maybe we're
 		 * replicating all columns?
 		 */
-		for (int i = 0; i < lrel.natts; i++)
+		for (int i = 0; i < lrel->natts; i++)
 		{
 			if (i > 0)
-				appendStringInfoString(&cmd, ", ");
+				appendStringInfoString(cmd, ", ");
 
-			appendStringInfoString(&cmd, quote_identifier(lrel.attnames[i]));
+			appendStringInfoString(cmd, quote_identifier(lrel->attnames[i]));
 		}
 
-		appendStringInfoString(&cmd, ") TO STDOUT"); // 命令是： COPY table_name(col1, col2, ... ,coln) TO STDOUT
+		appendStringInfoString(cmd, ") TO STDOUT"); // 命令是： COPY table_name(col1, col2, ... ,coln) TO STDOUT
 	}
 	else
 	{
@@ -1136,62 +1398,140 @@ copy_table(Relation rel) // 从publisher端拷贝数据
 		 * copy generated columns. For tables with any row filters, build a
 		 * SELECT query with OR'ed row filters for COPY.
 		 */
-		appendStringInfoString(&cmd, "COPY (SELECT ");
-		for (int i = 0; i < lrel.natts; i++)
+		appendStringInfoString(cmd, "COPY (SELECT ");
+		for (int i = 0; i < lrel->natts; i++)
 		{
-			appendStringInfoString(&cmd, quote_identifier(lrel.attnames[i]));
-			if (i < lrel.natts - 1)
-				appendStringInfoString(&cmd, ", ");
+			appendStringInfoString(cmd, quote_identifier(lrel->attnames[i]));
+			if (i < lrel->natts - 1)
+				appendStringInfoString(cmd, ", ");
 		}
 
-		appendStringInfoString(&cmd, " FROM ");
+		appendStringInfoString(cmd, " FROM ");
 
 		/*
 		 * For regular tables, make sure we don't copy data from a child that
 		 * inherits the named table as those will be copied separately.
 		 */
-		if (lrel.relkind == RELKIND_RELATION)
-			appendStringInfoString(&cmd, "ONLY ");
+		if (lrel->relkind == RELKIND_RELATION)
+			appendStringInfoString(cmd, "ONLY ");
+
+		appendStringInfoString(cmd, quote_qualified_identifier(lrel->nspname, lrel->relname));
+
+		/* ctid range of this stream */
+		if (nstreams > 1)
+		{
+			BlockNumber startblk = (uint64) nblocks * stream / nstreams;
+			BlockNumber endblk = (uint64) nblocks * (stream + 1) / nstreams;
+
+			appendStringInfoString(cmd, " WHERE ");
+			if (stream > 0)
+				appendStringInfo(cmd, "ctid >= '(%u,0)'::pg_catalog.tid",
+								 startblk);
+			if (stream > 0 && stream < nstreams - 1)
+				appendStringInfoString(cmd, " AND ");
+			if (stream < nstreams - 1)
+				appendStringInfo(cmd, "ctid < '(%u,0)'::pg_catalog.tid",
+								 endblk);
+		}
 
-		appendStringInfoString(&cmd, quote_qualified_identifier(lrel.nspname, lrel.relname));
 		/* list of OR'ed filters */
 		if (qual != NIL)
 		{
 			ListCell   *lc;
-			char	   *q = strVal(linitial(qual));
 
-			appendStringInfo(&cmd, " WHERE %s", q);
-			for_each_from(lc, qual, 1)
+			appendStringInfoString(cmd, nstreams > 1 ? " AND (" : " WHERE ");
+			foreach(lc, qual)
 			{
-				q = strVal(lfirst(lc));
-				appendStringInfo(&cmd, " OR %s", q);
+				if (foreach_current_index(lc) > 0)
+					appendStringInfoString(cmd, " OR ");
+				appendStringInfoString(cmd, strVal(lfirst(lc)));
 			}
-			list_free_deep(qual);
+			if (nstreams > 1)
+				appendStringInfoChar(cmd, ')');
 		}
 
-		appendStringInfoString(&cmd, ") TO STDOUT");
+		appendStringInfoString(cmd, ") TO STDOUT");
 	}
+}
+
+/*
+ * Copy existing data of a table from publisher.
+ *
+ * Caller is responsible for locking the local relation.
+ */
+static void
+copy_table(Relation rel) // 从publisher端拷贝数据
+{
+	LogicalRepRelMapEntry *relmapentry;
+	LogicalRepRelation lrel;
+	List	   *qual = NIL;
+	WalRcvExecResult *res;
+	StringInfoData cmd;
+	CopyFromState cstate;
+	List	   *attnamelist;
+	ParseState *pstate;
+	List	   *options = NIL;
+	bool		binary;
+	int			nstreams;
+	BlockNumber nblocks;
+
+	/* Get the publisher relation info. */
+	fetch_remote_table_info(get_namespace_name(RelationGetNamespace(rel)),
+							RelationGetRelationName(rel), &lrel, &qual); // 从publisher出获得表的信息
+
+	/* Put the relation into relmap. */
+	logicalrep_relmap_update(&lrel);
+
+	/* Map the publisher relation to local one. */
+	relmapentry = logicalrep_rel_open(lrel.remoteid, NoLock);
+	Assert(rel == relmapentry->localrel);
 
 	/*
 	 * Prior to v16, initial table synchronization will use text format even
 	 * if the binary option is enabled for a subscription.
 	 */
-	if (walrcv_server_version(LogRepWorkerWalRcvConn) >= 160000 &&  // PG 16的COPY命令增强了
-		MySubscription->binary)
-	{
-		appendStringInfoString(&cmd, " WITH (FORMAT binary)");
+	binary = walrcv_server_version(LogRepWorkerWalRcvConn) >= 160000 &&  // PG 16的COPY命令增强了
+		MySubscription->binary;
+	if (binary)
 		options = list_make1(makeDefElem("format",
 										 (Node *) makeString("binary"), -1));
+
+	/* Set up the streams to copy the table over. */
+	nstreams = copy_table_num_streams(&lrel, binary, &nblocks);
+	copy_streams = palloc0(sizeof(CopyStream) * nstreams);
+	for (int i = 0; i < nstreams; i++)
+		copy_streams[i].fd = PGINVALID_SOCKET;
+	copy_streams[0].conn = LogRepWorkerWalRcvConn;
+	ncopy_streams = ncopy_streams_active = nstreams;
+	copy_stream_current = 0;
+
+	if (nstreams > 1)
+	{
+		elog(DEBUG1, "copying table \"%s.%s\" over %d connections",
+			 lrel.nspname, lrel.relname, nstreams);
+		copy_table_open_streams();
 	}
 
-	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd.data, 0, NULL); // 在源端执行COPY命令
+	/* Start copy on the publisher. */
+	initStringInfo(&cmd); // 为cmd分配1KB的内存
+
+	for (int i = 0; i < nstreams; i++)
+	{
+		resetStringInfo(&cmd);
+		make_copy_command(&cmd, &lrel, qual, i, nstreams, nblocks);
+		if (binary)
+			appendStringInfoString(&cmd, " WITH (FORMAT binary)");
+
+		res = walrcv_exec(copy_streams[i].conn, cmd.data, 0, NULL); // 在源端执行COPY命令
+		if (res->status != WALRCV_OK_COPY_OUT)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("could not start initial contents copy for table \"%s.%s\": %s",
+							lrel.nspname, lrel.relname, res->err)));
+		walrcv_clear_result(res);
+	}
 	pfree(cmd.data);
-	if (res->status != WALRCV_OK_COPY_OUT)
-		ereport(ERROR,
-				(errcode(ERRCODE_CONNECTION_FAILURE),
-				 errmsg("could not start initial contents copy for table \"%s.%s\": %s",
-						lrel.nspname, lrel.relname, res->err)));
-	walrcv_clear_result(res);
+	list_free_deep(qual);
 
 	copybuf = makeStringInfo();
 
@@ -1205,6 +1545,8 @@ copy_table(Relation rel) // 从publisher端拷贝数据
 	/* Do the copy */
 	(void) CopyFrom(cstate);
 
+	copy_table_close_streams();
+
 	logicalrep_rel_close(relmapentry, NoLock);
 }
 
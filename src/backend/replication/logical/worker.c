@@ -279,6 +279,11 @@ typedef struct ApplyErrorCallbackArg
  * TRANS_PARALLEL_APPLY:
  * This action means that we are in the parallel apply worker and changes of
  * the transaction are applied directly by the worker.
+ *
+ * TRANS_LEADER_SEND_COMMITTED:
+ * This action means that we are in the leader apply worker and need to send
+ * the changes of a non-streamed transaction to the parallel apply worker it
+ * was handed over to at BEGIN (see parallel_apply_non_streamed).
  */
 typedef enum
 {
@@ -289,7 +294,10 @@ typedef enum
 	TRANS_LEADER_SERIALIZE,
 	TRANS_LEADER_SEND_TO_PARALLEL,
 	TRANS_LEADER_PARTIAL_SERIALIZE,
-	TRANS_PARALLEL_APPLY
+	TRANS_PARALLEL_APPLY,
+
+	/* The action for non-streamed transactions applied in parallel. */
+	TRANS_LEADER_SEND_COMMITTED
 } TransApplyAction;
 
 /* errcontext tracker */
@@ -335,6 +343,9 @@ static uint32 parallel_stream_nchanges = 0;
 /* Are we initializing a apply worker? */
 bool		InitializingApplyWorker = false;
 
+/* GUC variable: ask the publisher to send inserts in INSERT BATCH messages */
+bool		logical_replication_row_batches = false;
+
 /*
  * We enable skipping all data modification changes (INSERT, UPDATE, etc.) for
  * the subscription if the remote transaction's finish LSN matches the subskiplsn.
@@ -374,6 +385,27 @@ typedef struct ApplySubXactData
 
 static ApplySubXactData subxact_data = {0, 0, InvalidTransactionId, NULL};
 
+/*
+ * Consecutive INSERTs into the same table are buffered and inserted at once
+ * with table_multi_insert(), like COPY FROM does, unless the table has
+ * triggers that must see each row before it is inserted.  The buffer is
+ * flushed before any other message is applied, and when it is full.
+ */
+#define MAX_BUFFERED_INSERTS		1000
+#define MAX_BUFFERED_INSERT_BYTES	65535
+
+typedef struct ApplyInsertBuffer
+{
+	MemoryContext context;		/* holds the buffer and the tuples */
+	LogicalRepRelId relid;		/* remote relation the tuples are for */
+	TupleDesc	tupdesc;		/* copy of the local relation's descriptor */
+	TupleTableSlot *slots[MAX_BUFFERED_INSERTS];
+	int			nused;
+	Size		bytes;			/* size of the remote data buffered */
+} ApplyInsertBuffer;
+
+static ApplyInsertBuffer *apply_insert_buffer = NULL;
+
 static inline void subxact_filename(char *path, Oid subid, TransactionId xid);
 static inline void changes_filename(char *path, Oid subid, TransactionId xid);
 
@@ -399,6 +431,13 @@ static void send_feedback(XLogRecPtr recvpos, bool force, bool requestReply);
 static void DisableSubscriptionAndExit(void);
 
 static void apply_handle_commit_internal(LogicalRepCommitData *commit_data);
+static bool apply_can_buffer_insert(ApplyExecutionData *edata);
+static void apply_buffer_insert(ApplyExecutionData *edata,
+								TupleTableSlot *remoteslot,
+								LogicalRepTupleData *newtup);
+static void apply_flush_insert_buffer(void);
+static void apply_insert_tuple(LogicalRepRelId relid,
+							   LogicalRepTupleData *newtup);
 static void apply_handle_insert_internal(ApplyExecutionData *edata,
 										 ResultRelInfo *relinfo,
 										 TupleTableSlot *remoteslot);
@@ -580,6 +619,19 @@ handle_streamed_transaction(LogicalRepMsgType action, StringInfo s) // LogicalRe
 	if (apply_action == TRANS_LEADER_APPLY)
 		return false;
 
+	/*
+	 * A non-streamed transaction applied by a parallel apply worker. Like for
+	 * streaming transactions, the leader also applies relation/type updates.
+	 */
+	if (apply_action == TRANS_LEADER_SEND_COMMITTED)
+	{
+		pa_send_committed_change(action, s);
+		return (action != LOGICAL_REP_MSG_RELATION &&
+				action != LOGICAL_REP_MSG_TYPE);
+	}
+	else if (apply_action == TRANS_PARALLEL_APPLY && !in_streamed_transaction)
+		return false;
+
 	Assert(TransactionIdIsValid(stream_xid));
 
 	/*
@@ -1015,6 +1067,26 @@ apply_handle_begin(StringInfo s) // 处理BEGIN的逻辑
 
 	in_remote_transaction = true;
 
+	if (am_leader_apply_worker())
+	{
+		/*
+		 * Try to hand the transaction over to a parallel apply worker. If we
+		 * can't, all the transactions being applied by parallel apply
+		 * workers have finished when this returns, so we can apply this one
+		 * ourselves.
+		 */
+		(void) pa_begin_committed_xact(begin_data.xid, s);
+	}
+	else if (am_parallel_apply_worker())
+	{
+		/* Hold the lock until the end of the transaction. */
+		pa_lock_transaction(MyParallelShared->xid, AccessExclusiveLock);
+		pa_set_xact_state(MyParallelShared, PARALLEL_TRANS_STARTED);
+
+		/* Signal the leader apply worker, as it may be waiting for us. */
+		logicalrep_worker_wakeup(MyLogicalRepWorker->subid, InvalidOid);
+	}
+
 	pgstat_report_activity(STATE_RUNNING, NULL);
 }
 
@@ -1037,10 +1109,44 @@ apply_handle_commit(StringInfo s)
 								 LSN_FORMAT_ARGS(commit_data.commit_lsn),
 								 LSN_FORMAT_ARGS(remote_final_lsn))));
 
-	apply_handle_commit_internal(&commit_data); // 处理提交事务
+	if (pa_committed_xact_worker())
+	{
+		/*
+		 * The transaction was handed over to a parallel apply worker, which
+		 * will commit it once the earlier transactions have finished.
+		 */
+		pa_commit_committed_xact(commit_data.end_lsn, s);
+		in_remote_transaction = false;
+	}
+	else if (am_parallel_apply_worker())
+	{
+		/* Wait for our turn to commit, see pa_begin_committed_xact(). */
+		pa_lock_stream(MyParallelShared->xid, AccessShareLock);
+		pa_unlock_stream(MyParallelShared->xid, AccessShareLock);
 
-	/* Process any tables that are being synchronized in parallel. */
-	process_syncing_tables(commit_data.end_lsn); // sync进程会也会执行
+		apply_handle_commit_internal(&commit_data);
+
+		MyParallelShared->last_commit_end = XactLastCommitEnd;
+
+		/*
+		 * It is important to set the transaction state as finished before
+		 * releasing the lock. See pa_wait_for_xact_finish.
+		 */
+		pa_set_xact_state(MyParallelShared, PARALLEL_TRANS_FINISHED);
+		pa_unlock_transaction(MyParallelShared->xid, AccessExclusiveLock);
+
+		/* Signal the leader apply worker, as it may be waiting for us. */
+		logicalrep_worker_wakeup(MyLogicalRepWorker->subid, InvalidOid);
+	}
+	else
+		apply_handle_commit_internal(&commit_data); // 处理提交事务
+
+	/*
+	 * Process any tables that are being synchronized in parallel, unless
+	 * transactions are still being applied by parallel apply workers.
+	 */
+	if (!pa_committed_xacts_pending())
+		process_syncing_tables(commit_data.end_lsn); // sync进程会也会执行
 
 	pgstat_report_activity(STATE_IDLE, NULL);
 	reset_apply_error_context_info();
@@ -2128,6 +2234,9 @@ apply_spooled_messages(FileSet *stream_fileset, TransactionId xid,
 				 nchanges, path);
 	}
 
+	/* The transaction end is handled by our caller. */
+	apply_flush_insert_buffer();
+
 	if (stream_fd)
 		stream_close_file();
 
@@ -2383,15 +2492,8 @@ TargetPrivilegesCheck(Relation rel, AclMode mode)
 static void // 处理INSERT的函数
 apply_handle_insert(StringInfo s)
 {
-	LogicalRepRelMapEntry *rel;
 	LogicalRepTupleData newtup;
 	LogicalRepRelId relid;
-	UserContext ucxt;
-	ApplyExecutionData *edata;
-	EState	   *estate;
-	TupleTableSlot *remoteslot;
-	MemoryContext oldctx;
-	bool		run_as_owner;
 
 	/*
 	 * Quick return if we are skipping data modification changes or handling
@@ -2401,9 +2503,62 @@ apply_handle_insert(StringInfo s)
 		handle_streamed_transaction(LOGICAL_REP_MSG_INSERT, s))
 		return;
 
+	relid = logicalrep_read_insert(s, &newtup); // relid就是表的Oid，我们知道这条记录要插入哪张表
+
+	apply_insert_tuple(relid, &newtup);
+}
+
+/*
+ * Handle INSERT BATCH message.
+ *
+ * The rows are applied one by one like the tuples of INSERT messages, so
+ * they end up in the insert buffer where possible.
+ */
+static void
+apply_handle_insert_batch(StringInfo s)
+{
+	LogicalRepRelId relid;
+	int			nrows;
+
+	/*
+	 * Quick return if we are skipping data modification changes or handling
+	 * streamed transactions.
+	 */
+	if (is_skipping_changes() ||
+		handle_streamed_transaction(LOGICAL_REP_MSG_INSERT_BATCH, s))
+		return;
+
+	relid = logicalrep_read_insert_batch(s, &nrows);
+
+	for (int i = 0; i < nrows; i++)
+	{
+		LogicalRepTupleData newtup;
+
+		logicalrep_read_batch_tuple(s, &newtup);
+		apply_insert_tuple(relid, &newtup);
+	}
+}
+
+/*
+ * Apply an inserted tuple received in an INSERT or INSERT BATCH message.
+ */
+static void
+apply_insert_tuple(LogicalRepRelId relid, LogicalRepTupleData *newtup)
+{
+	LogicalRepRelMapEntry *rel;
+	UserContext ucxt;
+	ApplyExecutionData *edata;
+	EState	   *estate;
+	TupleTableSlot *remoteslot;
+	MemoryContext oldctx;
+	bool		run_as_owner;
+
+	/* An insert into another table ends the current batch. */
+	if (apply_insert_buffer && apply_insert_buffer->relid != relid)
+		apply_flush_insert_buffer();
+
 	begin_replication_step();
 
-	relid = logicalrep_read_insert(s, &newtup); // relid就是表的Oid，我们知道这条记录要插入哪张表
 	rel = logicalrep_rel_open(relid, RowExclusiveLock); // 以独占的方式打开表？
 	if (!should_apply_changes_for_rel(rel))
 	{
@@ -2436,7 +2591,7 @@ apply_handle_insert(StringInfo s)
 
 	/* Process and store remote tuple in the slot */
 	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	slot_store_data(remoteslot, rel, &newtup);
+	slot_store_data(remoteslot, rel, newtup);
 	slot_fill_defaults(rel, estate, remoteslot);
 	MemoryContextSwitchTo(oldctx);
 
@@ -2444,6 +2599,8 @@ apply_handle_insert(StringInfo s)
 	if (rel->localrel->rd_rel->relkind == RELKIND_PARTITIONED_TABLE)
 		apply_handle_tuple_routing(edata,
 								   remoteslot, NULL, CMD_INSERT);
+	else if (apply_can_buffer_insert(edata))
+		apply_buffer_insert(edata, remoteslot, newtup);
 	else
 		apply_handle_insert_internal(edata, edata->targetRelInfo,
 									 remoteslot);
@@ -2459,6 +2616,144 @@ apply_handle_insert(StringInfo s)
 	logicalrep_rel_close(rel, NoLock);
 
 	end_replication_step();
+
+	/* Insert the buffered tuples if the buffer is full. */
+	if (apply_insert_buffer &&
+		(apply_insert_buffer->nused >= MAX_BUFFERED_INSERTS ||
+		 apply_insert_buffer->bytes >= MAX_BUFFERED_INSERT_BYTES))
+		apply_flush_insert_buffer();
+}
+
+/*
+ * Can the tuples inserted into the relation be buffered?
+ *
+ * BEFORE ROW triggers could modify or skip the tuple, or look at the rows
+ * inserted before it, so those have to be inserted one at a time.
+ */
+static bool
+apply_can_buffer_insert(ApplyExecutionData *edata)
+{
+	ResultRelInfo *relinfo = edata->targetRelInfo;
+	TriggerDesc *trigdesc = relinfo->ri_TrigDesc;
+
+	if (relinfo->ri_RelationDesc->rd_rel->relkind != RELKIND_RELATION)
+		return false;
+
+	if (trigdesc &&
+		(trigdesc->trig_insert_before_row || trigdesc->trig_insert_instead_row))
+		return false;
+
+	return true;
+}
+
+/*
+ * Add a tuple to the insert buffer, creating it if needed.
+ */
+static void
+apply_buffer_insert(ApplyExecutionData *edata, TupleTableSlot *remoteslot,
+					LogicalRepTupleData *newtup)
+{
+	ApplyInsertBuffer *buffer = apply_insert_buffer;
+	Relation	localrel = edata->targetRelInfo->ri_RelationDesc;
+	MemoryContext oldctx;
+	TupleTableSlot *slot;
+
+	TargetPrivilegesCheck(localrel, ACL_INSERT);
+
+	if (buffer == NULL)
+	{
+		MemoryContext context;
+
+		context = AllocSetContextCreate(ApplyContext,
+										"ApplyInsertBuffer",
+										ALLOCSET_DEFAULT_SIZES);
+		oldctx = MemoryContextSwitchTo(context);
+		buffer = palloc0(sizeof(ApplyInsertBuffer));
+		buffer->context = context;
+		buffer->relid = edata->targetRel->remoterel.remoteid;
+		buffer->tupdesc = CreateTupleDescCopy(RelationGetDescr(localrel));
+		MemoryContextSwitchTo(oldctx);
+
+		apply_insert_buffer = buffer;
+	}
+
+	Assert(buffer->nused < MAX_BUFFERED_INSERTS);
+
+	/* Copy the tuple into a slot living as long as the buffer. */
+	oldctx = MemoryContextSwitchTo(buffer->context);
+	if (buffer->slots[buffer->nused] == NULL)
+		buffer->slots[buffer->nused] =
+			MakeSingleTupleTableSlot(buffer->tupdesc,
+									 table_slot_callbacks(localrel));
+	slot = buffer->slots[buffer->nused++];
+	ExecCopySlot(slot, remoteslot);
+	MemoryContextSwitchTo(oldctx);
+
+	for (int i = 0; i < newtup->ncols; i++)
+	{
+		if (newtup->colstatus[i] != LOGICALREP_COLUMN_NULL)
+			buffer->bytes += newtup->colvalues[i].len;
+	}
+}
+
+/*
+ * Insert the buffered tuples, if any.
+ */
+static void
+apply_flush_insert_buffer(void)
+{
+	ApplyInsertBuffer *buffer = apply_insert_buffer;
+	LogicalRepRelMapEntry *rel;
+	ApplyExecutionData *edata;
+	ResultRelInfo *relinfo;
+	UserContext ucxt;
+	bool		run_as_owner;
+	LogicalRepMsgType saved_command;
+
+	if (buffer == NULL)
+		return;
+
+	/* Forget the buffer first, in case of errors. */
+	apply_insert_buffer = NULL;
+
+	begin_replication_step();
+
+	/* We already hold the lock taken for the buffered inserts. */
+	rel = logicalrep_rel_open(buffer->relid, RowExclusiveLock);
+
+	run_as_owner = MySubscription->runasowner;
+	if (!run_as_owner)
+		SwitchToUntrustedUser(rel->localrel->rd_rel->relowner, &ucxt);
+
+	/* Set relation and command for error callback */
+	saved_command = apply_error_callback_arg.command;
+	apply_error_callback_arg.command = LOGICAL_REP_MSG_INSERT;
+	apply_error_callback_arg.rel = rel;
+
+	edata = create_edata_for_relation(rel);
+	relinfo = edata->targetRelInfo;
+
+	ExecOpenIndices(relinfo, false);
+	ExecSimpleRelationMultiInsert(relinfo, edata->estate, buffer->slots,
+								  buffer->nused);
+	ExecCloseIndices(relinfo);
+
+	finish_edata(edata);
+
+	/* Reset relation and command for error callback */
+	apply_error_callback_arg.rel = NULL;
+	apply_error_callback_arg.command = saved_command;
+
+	if (!run_as_owner)
+		RestoreUserContext(&ucxt);
+
+	logicalrep_rel_close(rel, NoLock);
+
+	for (int i = 0; i < MAX_BUFFERED_INSERTS && buffer->slots[i] != NULL; i++)
+		ExecDropSingleTupleTableSlot(buffer->slots[i]);
+	MemoryContextDelete(buffer->context);
+
+	end_replication_step();
 }
 
 /*
@@ -3295,6 +3590,24 @@ apply_dispatch(StringInfo s) // 根据s中的第一个字节来决定执行何
 	saved_command = apply_error_callback_arg.command;
 	apply_error_callback_arg.command = action;
 
+	/* Any message but another INSERT ends the current batch of inserts. */
+	if (action != LOGICAL_REP_MSG_INSERT &&
+		action != LOGICAL_REP_MSG_INSERT_BATCH)
+		apply_flush_insert_buffer();
+
+	/*
+	 * Transactions that the leader applies itself, or waits for a parallel
+	 * apply worker to finish, must not commit before the non-streamed
+	 * transactions still being applied by parallel apply workers.
+	 */
+	if (pa_committed_xacts_pending() &&
+		(action == LOGICAL_REP_MSG_BEGIN_PREPARE ||
+		 action == LOGICAL_REP_MSG_COMMIT_PREPARED ||
+		 action == LOGICAL_REP_MSG_ROLLBACK_PREPARED ||
+		 action == LOGICAL_REP_MSG_STREAM_COMMIT ||
+		 action == LOGICAL_REP_MSG_STREAM_PREPARE))
+		pa_wait_for_committed_xacts();
+
 	switch (action)
 	{
 		case LOGICAL_REP_MSG_BEGIN:
@@ -3309,6 +3622,10 @@ apply_dispatch(StringInfo s) // 根据s中的第一个字节来决定执行何
 			apply_handle_insert(s);
 			break;
 
+		case LOGICAL_REP_MSG_INSERT_BATCH:
+			apply_handle_insert_batch(s);
+			break;
+
 		case LOGICAL_REP_MSG_UPDATE:
 			apply_handle_update(s);
 			break;
@@ -3627,10 +3944,14 @@ LogicalRepApplyLoop(XLogRecPtr last_received)
 			}
 		}
 
+		/* Clean up after the transactions parallel apply workers finished. */
+		pa_process_committed_xacts();
+
 		/* confirm all writes so far */
 		send_feedback(last_received, false, false);
 
-		if (!in_remote_transaction && !in_streamed_transaction)
+		if (!in_remote_transaction && !in_streamed_transaction &&
+			!pa_committed_xacts_pending())
 		{
 			/*
 			 * If we didn't get any transactions for a while there might be
@@ -4647,6 +4968,17 @@ ApplyWorkerMain(Datum main_arg) // worker进程的入口函数, 输入参数是
 	options.proto.logical.publication_names = MySubscription->publications;
 	options.proto.logical.binary = MySubscription->binary;
 
+	/*
+	 * Row batches need a publisher of this version that knows about them,
+	 * which the server version doesn't tell us, hence the GUC.
+	 */
+	options.proto.logical.row_batches = false;
+	if (server_version >= 160000 && logical_replication_row_batches)
+	{
+		options.proto.logical.proto_version = LOGICALREP_PROTO_BATCH_VERSION_NUM;
+		options.proto.logical.row_batches = true;
+	}
+
 	/*
 	 * Assign the appropriate option value for streaming option according to
 	 * the 'streaming' mode and the publisher's ability to support that mode.
@@ -5079,6 +5411,15 @@ get_transaction_apply_action(TransactionId xid, ParallelApplyWorkerInfo **winfo)
 		return TRANS_PARALLEL_APPLY;
 	}
 
+	/*
+	 * A non-streamed transaction that we have handed over to a parallel
+	 * apply worker.
+	 */
+	if (!in_streamed_transaction && (*winfo = pa_committed_xact_worker()) != NULL)
+	{
+		return TRANS_LEADER_SEND_COMMITTED;
+	}
+
 	/*
 	 * If we are processing this transaction using a parallel apply worker
 	 * then either we send the changes to the parallel worker or if the worker
@@ -93,6 +93,13 @@ static void send_repl_origin(LogicalDecodingContext *ctx,
 							 RepOriginId origin_id, XLogRecPtr origin_lsn,
 							 bool send_origin);
 
+/*
+ * With row_batches, consecutive INSERTs into the same relation are collected
+ * and sent as a single INSERT BATCH message of up to this many rows or bytes.
+ */
+#define PGOUTPUT_BATCH_MAX_ROWS		1000
+#define PGOUTPUT_BATCH_MAX_BYTES	(64 * 1024)
+
 /*
  * Only 3 publication actions are used for row filtering ("insert", "update",
  * "delete"). See RelationSyncEntry.exprstate[].
@@ -172,6 +179,12 @@ typedef struct RelationSyncEntry
 	 */
 	Bitmapset  *columns;
 
+	/*
+	 * Output functions for the columns sent in INSERT BATCH rows, looked up
+	 * on first use; NULL if not yet done.
+	 */
+	LogicalRepTupleOutput *tuple_output;
+
 	/*
 	 * Private context to store additional data for this entry - state for the
 	 * row filter expressions, column list, etc.
@@ -242,6 +255,13 @@ static void pgoutput_column_list_init(PGOutputData *data,
 									  List *publications,
 									  RelationSyncEntry *entry);
 
+/* row batching routines */
+static void pgoutput_batch_insert(LogicalDecodingContext *ctx,
+								  TransactionId xid, Relation relation,
+								  TupleTableSlot *slot,
+								  RelationSyncEntry *relentry);
+static void pgoutput_flush_batch(LogicalDecodingContext *ctx);
+
 /*
  * Specify output plugin callbacks
  */
@@ -285,11 +305,13 @@ parse_output_parameters(List *options, PGOutputData *data)
 	bool		streaming_given = false;
 	bool		two_phase_option_given = false;
 	bool		origin_option_given = false;
+	bool		row_batches_option_given = false;
 
 	data->binary = false;
 	data->streaming = LOGICALREP_STREAM_OFF;
 	data->messages = false;
 	data->two_phase = false;
+	data->row_batches = false;
 
 	foreach(lc, options) /// 依次循环遍历options
 	{
@@ -394,6 +416,16 @@ parse_output_parameters(List *options, PGOutputData *data)
 						errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 						errmsg("unrecognized origin value: \"%s\"", data->origin));
 		}
+		else if (strcmp(defel->defname, "row_batches") == 0)
+		{
+			if (row_batches_option_given)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			row_batches_option_given = true;
+
+			data->row_batches = defGetBoolean(defel);
+		}
 		else
 			elog(ERROR, "unrecognized pgoutput option: %s", defel->defname);
 	}
@@ -408,6 +440,7 @@ pgoutput_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
 {
 	PGOutputData *data = palloc0(sizeof(PGOutputData)); // 这个内存在ctx的内存池中分配
 	static bool publication_callback_registered = false; /// 注意这里是static变量
+	MemoryContext oldctx;
 
 	/* Create our memory context for private allocations. */
 	data->context = AllocSetContextCreate(ctx->context,
@@ -500,6 +533,22 @@ pgoutput_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
 		else
 			ctx->twophase_opt_given = true;
 
+		/*
+		 * Row batches need a client that knows the INSERT BATCH message.
+		 */
+		if (data->row_batches)
+		{
+			if (data->protocol_version < LOGICALREP_PROTO_BATCH_VERSION_NUM)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("requested proto_version=%d does not support row batches, need %d or higher",
+								data->protocol_version, LOGICALREP_PROTO_BATCH_VERSION_NUM)));
+
+			oldctx = MemoryContextSwitchTo(data->cachectx);
+			data->batch = makeStringInfo();
+			MemoryContextSwitchTo(oldctx);
+		}
+
 		/* Init publication state. */
 		data->publications = NIL;
 		publications_valid = false;
@@ -600,6 +649,8 @@ pgoutput_commit_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 		return;
 	}
 
+	pgoutput_flush_batch(ctx);
+
 	OutputPluginPrepareWrite(ctx, true);
 	logicalrep_write_commit(ctx->out, txn, commit_lsn);
 	OutputPluginWrite(ctx, true);
@@ -630,6 +681,7 @@ pgoutput_prepare_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 					 XLogRecPtr prepare_lsn)
 {
 	OutputPluginUpdateProgress(ctx, false);
+	pgoutput_flush_batch(ctx);
 
 	OutputPluginPrepareWrite(ctx, true);
 	logicalrep_write_prepare(ctx->out, txn, prepare_lsn);
@@ -717,6 +769,9 @@ maybe_send_schema(LogicalDecodingContext *ctx,
 	if (schema_sent)
 		return;
 
+	/* Rows collected so far must reach the subscriber with the old schema. */
+	pgoutput_flush_batch(ctx);
+
 	/*
 	 * Send the schema.  If the changes will be published using an ancestor's
 	 * schema, not the relation's own, send that ancestor's schema before
@@ -1519,6 +1574,16 @@ pgoutput_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 	 */
 	maybe_send_schema(ctx, change, relation, relentry);
 
+	/* Collect inserts into a batch, if requested. */
+	if (data->row_batches && action == REORDER_BUFFER_CHANGE_INSERT)
+	{
+		pgoutput_batch_insert(ctx, xid, targetrel, new_slot, relentry);
+		goto cleanup;
+	}
+
+	/* Any other change goes after the rows collected so far. */
+	pgoutput_flush_batch(ctx);
+
 	OutputPluginPrepareWrite(ctx, true);
 
 	/* Send the data */
@@ -1553,6 +1618,69 @@ cleanup:
 	MemoryContextReset(data->context);
 }
 
+/*
+ * Add an inserted tuple to the batch of rows to send, starting a new batch if
+ * the current one is for another relation or (sub)transaction.
+ */
+static void
+pgoutput_batch_insert(LogicalDecodingContext *ctx, TransactionId xid,
+					  Relation relation, TupleTableSlot *slot,
+					  RelationSyncEntry *relentry)
+{
+	PGOutputData *data = (PGOutputData *) ctx->output_plugin_private;
+	Oid			relid = RelationGetRelid(relation);
+
+	if (data->batch_nrows > 0 &&
+		(data->batch_relid != relid || data->batch_xid != xid))
+		pgoutput_flush_batch(ctx);
+
+	/* Look up the output functions once for all the rows of the relation. */
+	if (relentry->tuple_output == NULL)
+	{
+		MemoryContext oldctx;
+
+		pgoutput_ensure_entry_cxt(data, relentry);
+
+		oldctx = MemoryContextSwitchTo(relentry->entry_cxt);
+		relentry->tuple_output = logicalrep_tuple_output_init(relation,
+																data->binary,
+																relentry->columns);
+		MemoryContextSwitchTo(oldctx);
+	}
+
+	data->batch_relid = relid;
+	data->batch_xid = xid;
+	logicalrep_write_batch_tuple(data->batch, slot, relentry->tuple_output);
+	data->batch_nrows++;
+
+	if (data->batch_nrows >= PGOUTPUT_BATCH_MAX_ROWS ||
+		data->batch->len >= PGOUTPUT_BATCH_MAX_BYTES)
+		pgoutput_flush_batch(ctx);
+}
+
+/*
+ * Send the rows collected for an INSERT BATCH message, if any.
+ *
+ * This has to be done before anything else is written in the transaction.
+ */
+static void
+pgoutput_flush_batch(LogicalDecodingContext *ctx)
+{
+	PGOutputData *data = (PGOutputData *) ctx->output_plugin_private;
+
+	if (data->batch_nrows == 0)
+		return;
+
+	OutputPluginPrepareWrite(ctx, true);
+	logicalrep_write_insert_batch(ctx->out, data->batch_xid,
+								  data->batch_relid, data->batch_nrows,
+								  data->batch);
+	OutputPluginWrite(ctx, true);
+
+	data->batch_nrows = 0;
+	resetStringInfo(data->batch);
+}
+
 static void
 pgoutput_truncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 				  int nrelations, Relation relations[], ReorderBufferChange *change)
@@ -1607,6 +1735,8 @@ pgoutput_truncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 
 	if (nrelids > 0)
 	{
+		pgoutput_flush_batch(ctx);
+
 		OutputPluginPrepareWrite(ctx, true);
 		logicalrep_write_truncate(ctx->out,
 								  xid,
@@ -1651,6 +1781,8 @@ pgoutput_message(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
 			pgoutput_send_begin(ctx, txn);
 	}
 
+	pgoutput_flush_batch(ctx);
+
 	OutputPluginPrepareWrite(ctx, true);
 	logicalrep_write_message(ctx->out,
 							 xid,
@@ -1774,6 +1906,8 @@ pgoutput_stream_stop(struct LogicalDecodingContext *ctx,
 	/* we should be streaming a transaction */
 	Assert(in_streaming);
 
+	pgoutput_flush_batch(ctx);
+
 	OutputPluginPrepareWrite(ctx, true);
 	logicalrep_write_stream_stop(ctx->out);
 	OutputPluginWrite(ctx, true);
@@ -1981,6 +2115,7 @@ get_rel_sync_entry(PGOutputData *data, Relation relation)
 		entry->publish_as_relid = InvalidOid;
 		entry->columns = NULL;
 		entry->attrmap = NULL;
+		entry->tuple_output = NULL;
 	}
 
 	/* Validate the entry */
@@ -2056,6 +2191,7 @@ get_rel_sync_entry(PGOutputData *data, Relation relation)
 		entry->entry_cxt = NULL;
 		entry->estate = NULL;
 		memset(entry->exprstate, 0, sizeof(entry->exprstate));
+		entry->tuple_output = NULL;
 
 		/*
 		 * Build publication cache. We can't use one provided by relcache as
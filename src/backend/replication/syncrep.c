@@ -85,6 +85,7 @@
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/guc_hooks.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 
 /* User-settable parameters for sync rep */
@@ -100,7 +101,7 @@ static int	SyncRepWaitMode = SYNC_REP_NO_WAIT;
 
 static void SyncRepQueueInsert(int mode);
 static void SyncRepCancelWait(void);
-static int	SyncRepWakeQueue(bool all, int mode);
+static int	SyncRepWakeQueue(bool all, int mode, int *wakeups);
 
 static bool SyncRepGetSyncRecPtr(XLogRecPtr *writePtr,
 								 XLogRecPtr *flushPtr,
@@ -183,6 +184,15 @@ SyncRepWaitForLSN(XLogRecPtr lsn, bool commit)
 	Assert(dlist_node_is_detached(&MyProc->syncRepLinks));
 	Assert(WalSndCtl != NULL);
 
+	/*
+	 * The released-up-to position only moves forward, so if the standbys
+	 * have already confirmed our LSN there is no need to touch the queue or
+	 * its lock at all.  With many concurrent committers this is common,
+	 * because one standby reply usually covers several commits.
+	 */
+	if (lsn <= pg_atomic_read_u64(&WalSndCtl->lsn[mode]))
+		return;
+
 	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
 	Assert(MyProc->syncRepState == SYNC_REP_NOT_WAITING);
 
@@ -195,7 +205,7 @@ SyncRepWaitForLSN(XLogRecPtr lsn, bool commit)
 	 * to be a low cost check.
 	 */
 	if (!WalSndCtl->sync_standbys_defined ||
-		lsn <= WalSndCtl->lsn[mode])
+		lsn <= pg_atomic_read_u64(&WalSndCtl->lsn[mode]))
 	{
 		LWLockRelease(SyncRepLock);
 		return;
@@ -440,6 +450,8 @@ SyncRepReleaseWaiters(void)
 	int			numwrite = 0;
 	int			numflush = 0;
 	int			numapply = 0;
+	int			nwakeups;
+	static int *wakeups = NULL;
 
 	/*
 	 * If this WALSender is serving a standby that is not on the list of
@@ -460,16 +472,12 @@ SyncRepReleaseWaiters(void)
 	/*
 	 * We're a potential sync standby. Release waiters if there are enough
 	 * sync standbys and we are considered as sync.
-	 */
-	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
-
-	/*
+	 *
 	 * Check whether we are a sync standby or not, and calculate the synced
-	 * positions among all sync standbys.  (Note: although this step does not
-	 * of itself require holding SyncRepLock, it seems like a good idea to do
-	 * it after acquiring the lock.  This ensures that the WAL pointers we use
-	 * to release waiters are newer than any previous execution of this
-	 * routine used.)
+	 * positions among all sync standbys.  This doesn't require SyncRepLock.
+	 * The positions we compute may be older than those used by a concurrent
+	 * execution of this routine in another walsender, but that's harmless
+	 * because the released-up-to LSNs are only ever advanced.
 	 */
 	got_recptr = SyncRepGetSyncRecPtr(&writePtr, &flushPtr, &applyPtr, &am_sync);
 
@@ -497,33 +505,67 @@ SyncRepReleaseWaiters(void)
 	 */
 	if (!got_recptr || !am_sync)
 	{
-		LWLockRelease(SyncRepLock);
 		announce_next_takeover = !am_sync;
 		return;
 	}
 
+	/*
+	 * With several sync standbys, most replies don't move the synced
+	 * position (a quorum or priority position only advances once enough
+	 * standbys have caught up), and replies are frequent anyway.  Skip the
+	 * lock entirely unless there is something to release.
+	 */
+	if (pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_WRITE]) >= writePtr &&
+		pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_FLUSH]) >= flushPtr &&
+		pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_APPLY]) >= applyPtr)
+		return;
+
+	/*
+	 * Wakeups are collected while holding the lock and issued after
+	 * releasing it, so that waking backends don't immediately contend with
+	 * us for SyncRepLock.  A backend waits in at most one queue, so one slot
+	 * per PGPROC is enough.
+	 */
+	if (wakeups == NULL)
+		wakeups = MemoryContextAlloc(TopMemoryContext,
+									 sizeof(int) * ProcGlobal->allProcCount);
+
+	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
+
 	/*
 	 * Set the lsn first so that when we wake backends they will release up to
-	 * this location.
+	 * this location.  Recheck against the current values, since they may
+	 * have been advanced by another walsender since we looked.
 	 */
-	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] < writePtr)
+	if (pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_WRITE]) < writePtr)
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_WRITE] = writePtr;
-		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE);
+		pg_atomic_write_u64(&walsndctl->lsn[SYNC_REP_WAIT_WRITE], writePtr);
+		numwrite = SyncRepWakeQueue(false, SYNC_REP_WAIT_WRITE, wakeups);
 	}
-	if (walsndctl->lsn[SYNC_REP_WAIT_FLUSH] < flushPtr)
+	if (pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_FLUSH]) < flushPtr)
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] = flushPtr;
-		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH);
+		pg_atomic_write_u64(&walsndctl->lsn[SYNC_REP_WAIT_FLUSH], flushPtr);
+		numflush = SyncRepWakeQueue(false, SYNC_REP_WAIT_FLUSH,
+									wakeups + numwrite);
 	}
-	if (walsndctl->lsn[SYNC_REP_WAIT_APPLY] < applyPtr)
+	if (pg_atomic_read_u64(&walsndctl->lsn[SYNC_REP_WAIT_APPLY]) < applyPtr)
 	{
-		walsndctl->lsn[SYNC_REP_WAIT_APPLY] = applyPtr;
-		numapply = SyncRepWakeQueue(false, SYNC_REP_WAIT_APPLY);
+		pg_atomic_write_u64(&walsndctl->lsn[SYNC_REP_WAIT_APPLY], applyPtr);
+		numapply = SyncRepWakeQueue(false, SYNC_REP_WAIT_APPLY,
+									wakeups + numwrite + numflush);
 	}
 
 	LWLockRelease(SyncRepLock);
 
+	/*
+	 * Wake only after the lock is released.  A woken backend may already
+	 * have exited and its PGPROC been reused by the time we get here; that
+	 * just causes a spurious latch wakeup, which every latch user tolerates.
+	 */
+	nwakeups = numwrite + numflush + numapply;
+	for (int i = 0; i < nwakeups; i++)
+		SetLatch(&GetPGProcByNumber(wakeups[i])->procLatch);
+
 	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X, %d procs up to apply %X/%X",
 		 numwrite, LSN_FORMAT_ARGS(writePtr),
 		 numflush, LSN_FORMAT_ARGS(flushPtr),
@@ -864,10 +906,14 @@ SyncRepGetStandbyPriority(void)
  * Pass all = true to wake whole queue; otherwise, just wake up to
  * the walsender's LSN.
  *
+ * If wakeups is not NULL, the backends' latches are not set here; instead
+ * their pgprocnos are stored into wakeups[], and the caller must set their
+ * latches once it has released the lock.
+ *
  * The caller must hold SyncRepLock in exclusive mode.
  */
 static int
-SyncRepWakeQueue(bool all, int mode)
+SyncRepWakeQueue(bool all, int mode, int *wakeups)
 {
 	volatile WalSndCtlData *walsndctl = WalSndCtl;
 	int			numprocs = 0;
@@ -884,7 +930,7 @@ SyncRepWakeQueue(bool all, int mode)
 		/*
 		 * Assume the queue is ordered by LSN
 		 */
-		if (!all && walsndctl->lsn[mode] < proc->waitLSN)
+		if (!all && pg_atomic_read_u64(&walsndctl->lsn[mode]) < proc->waitLSN)
 			return numprocs;
 
 		/*
@@ -908,7 +954,10 @@ SyncRepWakeQueue(bool all, int mode)
 		/*
 		 * Wake only when we have set state and removed from queue.
 		 */
-		SetLatch(&(proc->procLatch));
+		if (wakeups)
+			wakeups[numprocs] = proc->pgprocno;
+		else
+			SetLatch(&(proc->procLatch));
 
 		numprocs++;
 	}
@@ -942,7 +991,7 @@ SyncRepUpdateSyncStandbysDefined(void)
 			int			i;
 
 			for (i = 0; i < NUM_SYNC_REP_WAIT_MODE; i++)
-				SyncRepWakeQueue(true, i);
+				SyncRepWakeQueue(true, i, NULL);
 		}
 
 		/*
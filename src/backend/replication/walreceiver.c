@@ -56,6 +56,7 @@
 #include "access/transam.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogcompress.h"
 #include "access/xlogrecovery.h"
 #include "catalog/pg_authid.h"
 #include "catalog/pg_type.h"
@@ -90,6 +91,7 @@
 int			wal_receiver_status_interval;
 int			wal_receiver_timeout;
 bool		hot_standby_feedback;
+int			wal_receiver_compression = WAL_COMPRESSION_NONE;
 
 /* libpqwalreceiver connection */
 static WalReceiverConn *wrconn = NULL;
@@ -133,6 +135,7 @@ static TimestampTz wakeup[NUM_WALRCV_WAKEUPS]; // 这是一个数组，里面是
 
 static StringInfoData reply_message;
 static StringInfoData incoming_message;
+static StringInfoData decompressed_message;
 
 /* Prototypes for private functions */
 static void WalRcvFetchTimeLineHistoryFiles(TimeLineID first, TimeLineID last);
@@ -430,6 +433,7 @@ WalReceiverMain(void) // wr进程的主入口函数
 			LogstreamResult.Write = LogstreamResult.Flush = GetXLogReplayRecPtr(NULL); // 获得startup进程最后的apply的LSN，时间线我们不关心，已经有了
 			initStringInfo(&reply_message);
 			initStringInfo(&incoming_message);
+			initStringInfo(&decompressed_message);
 
 			/* Initialize nap wakeup times. */
 			now = GetCurrentTimestamp();
@@ -872,6 +876,47 @@ XLogWalRcvProcessMsg(unsigned char type, char *buf, Size len, TimeLineID tli)
 				XLogWalRcvWrite(buf, len, dataStart, tli); // 写入本地磁盘的WAL文件中
 				break;
 			}
+		case 'z':				/* compressed WAL records */
+			{
+				WalCompression method;
+				int			rawlen;
+
+				/* copy message to StringInfo */
+				hdrlen = sizeof(int64) + sizeof(int64) + sizeof(int64) +
+					sizeof(uint8) + sizeof(int32);
+				if (len < hdrlen)
+					ereport(ERROR,
+							(errcode(ERRCODE_PROTOCOL_VIOLATION),
+							 errmsg_internal("invalid WAL message received from primary")));
+				appendBinaryStringInfo(&incoming_message, buf, hdrlen);
+
+				/* read the fields */
+				dataStart = pq_getmsgint64(&incoming_message);
+				walEnd = pq_getmsgint64(&incoming_message);
+				sendTime = pq_getmsgint64(&incoming_message);
+				method = (WalCompression) pq_getmsgbyte(&incoming_message);
+				rawlen = pq_getmsgint(&incoming_message, 4);
+				ProcessWalSndrMessage(walEnd, sendTime);
+
+				buf += hdrlen;
+				len -= hdrlen;
+
+				if (rawlen <= 0 || rawlen >= MaxAllocSize)
+					ereport(ERROR,
+							(errcode(ERRCODE_PROTOCOL_VIOLATION),
+							 errmsg_internal("invalid WAL message received from primary")));
+				resetStringInfo(&decompressed_message);
+				enlargeStringInfo(&decompressed_message, rawlen);
+				if (!XLogDecompressData(method, buf, len,
+										decompressed_message.data, rawlen))
+					ereport(ERROR,
+							(errcode(ERRCODE_PROTOCOL_VIOLATION),
+							 errmsg("could not decompress WAL message received from primary using %s",
+									XLogCompressionName(method))));
+
+				XLogWalRcvWrite(decompressed_message.data, rawlen, dataStart, tli);
+				break;
+			}
 		case 'k':				/* Keepalive */   // k表示keepalive，心跳功能
 			{
 				/* copy message to StringInfo */
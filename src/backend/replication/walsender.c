@@ -54,6 +54,7 @@
 #include "access/transam.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogcompress.h"
 #include "access/xlogreader.h"
 #include "access/xlogrecovery.h"
 #include "access/xlogutils.h"
@@ -71,6 +72,7 @@
 #include "postmaster/interrupt.h"
 #include "replication/decode.h"
 #include "replication/logical.h"
+#include "replication/shareddecoding.h"
 #include "replication/slot.h"
 #include "replication/snapbuild.h"
 #include "replication/syncrep.h"
@@ -124,6 +126,8 @@ int			max_wal_senders = 10;	/* the maximum number of concurrent
 int			wal_sender_timeout = 60 * 1000; /* maximum time to send one WAL
 											 * data message */
 bool		log_replication_commands = false;
+int			wal_sender_compression = WAL_COMPRESSION_NONE;	/* compress WAL
+															 * messages? */
 
 /*
  * State for WalSndWakeupRequest
@@ -159,6 +163,9 @@ static StringInfoData output_message;
 static StringInfoData reply_message;
 static StringInfoData tmpbuf;
 
+/* Buffer for the compressed version of a WAL data message. */
+static StringInfoData compressed_message;
+
 /* Timestamp of last ProcessRepliesIfAny(). */
 static TimestampTz last_processing = 0;
 
@@ -229,7 +236,10 @@ static void InitWalSenderSlot(void);
 static void WalSndKill(int code, Datum arg);
 static void WalSndShutdown(void) pg_attribute_noreturn();
 static void XLogSendPhysical(void);
+static bool WalSndCompressData(XLogRecPtr startptr, XLogRecPtr walEnd,
+							   Size nbytes);
 static void XLogSendLogical(void);
+static void XLogSendShared(void);
 static void WalSndDone(WalSndSendDataCallback send_data);
 static XLogRecPtr GetStandbyFlushRecPtr(TimeLineID *tli);
 static void IdentifySystem(void);
@@ -321,6 +331,8 @@ WalSndErrorCleanup(void) /// 如果失败，做一些清理工作
 	if (xlogreader != NULL && xlogreader->seg.ws_file >= 0)
 		wal_segment_close(xlogreader);
 
+	SharedDecodingStop();
+
 	if (MyReplicationSlot != NULL)
 		ReplicationSlotRelease();
 
@@ -1314,6 +1326,9 @@ StartLogicalReplication(StartReplicationCmd *cmd) /// 开始逻辑复制
 	 */
 	sentPtr = MyReplicationSlot->data.confirmed_flush;
 
+	/* Share decoding with WAL senders producing the same output, if enabled */
+	SharedDecodingStart(logical_decoding_ctx, cmd->options);
+
 	/* Also update the sent position status in shared memory */
 	SpinLockAcquire(&MyWalSnd->mutex);
 	MyWalSnd->sentPtr = MyReplicationSlot->data.restart_lsn;
@@ -1326,6 +1341,7 @@ StartLogicalReplication(StartReplicationCmd *cmd) /// 开始逻辑复制
 	/* Main loop of walsender */
 	WalSndLoop(XLogSendLogical); // 主要的循环在这里 ================= ！！！！！！！！！！！！！！！！！！
 
+	SharedDecodingStop();
 	FreeDecodingContext(logical_decoding_ctx); // 释放各种资源
 	ReplicationSlotRelease();
 
@@ -1394,6 +1410,9 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 	/* output previously gathered data in a CopyData packet */
 	pq_putmessage_noblock('d', ctx->out->data, ctx->out->len);
 
+	/* and hand it to the WAL senders sharing our decoding */
+	SharedDecodingForward(ctx->out->data, ctx->out->len);
+
 	CHECK_FOR_INTERRUPTS();
 
 	/* Try to flush pending output to the client */
@@ -1784,6 +1803,7 @@ exec_replication_command(const char *cmd_string) // 执行复制命令，cmd_str
 	initStringInfo(&output_message); // 初始化这三个缓冲区，每个分配1KB的内存
 	initStringInfo(&reply_message);
 	initStringInfo(&tmpbuf);
+	initStringInfo(&compressed_message);
 
 	switch (cmd_node->type) // 根据解析的类型
 	{
@@ -2752,8 +2772,10 @@ XLogSendPhysical(void)
 	XLogRecPtr	startptr;
 	XLogRecPtr	endptr;
 	Size		nbytes;
+	Size		nbuffered;
 	XLogSegNo	segno;
 	WALReadError errinfo;
+	StringInfo	msg;
 
 	/* If requested switch the WAL sender to the stopping state. */
 	if (got_STOPPING)
@@ -2968,11 +2990,22 @@ XLogSendPhysical(void)
 	 */
 	enlargeStringInfo(&output_message, nbytes);
 
+	/*
+	 * On a primary, recent WAL is usually still in the WAL buffers.  Copy as
+	 * much as is there, so that every standby doesn't read it from the WAL
+	 * files again.
+	 */
+	nbuffered = 0;
+	if (!am_cascading_walsender && !sendTimeLineIsHistoric)
+		nbuffered = WALReadFromBuffers(&output_message.data[output_message.len],
+									   startptr, nbytes, sendTimeLine);
+
 retry:
-	if (!WALRead(xlogreader,
-				 &output_message.data[output_message.len],
-				 startptr,
-				 nbytes,
+	if (nbuffered < nbytes &&
+		!WALRead(xlogreader,
+				 &output_message.data[output_message.len + nbuffered],
+				 startptr + nbuffered,
+				 nbytes - nbuffered,
 				 xlogreader->seg.ws_tli,	/* Pass the current TLI because
 											 * only WalSndSegmentOpen controls
 											 * whether new TLI is needed. */
@@ -3010,15 +3043,22 @@ retry:
 	output_message.len += nbytes;
 	output_message.data[output_message.len] = '\0';
 
+	/* Send it compressed instead, if the receiver asked for that */
+	msg = &output_message;
+	if (wal_sender_compression != WAL_COMPRESSION_NONE &&
+		WalSndCompressData(startptr, SendRqstPtr, nbytes))
+		msg = &compressed_message;
+
 	/*
 	 * Fill the send timestamp last, so that it is taken as late as possible.
+	 * It's at the same place in both message formats.
 	 */
 	resetStringInfo(&tmpbuf);
 	pq_sendint64(&tmpbuf, GetCurrentTimestamp());
-	memcpy(&output_message.data[1 + sizeof(int64) + sizeof(int64)],
+	memcpy(&msg->data[1 + sizeof(int64) + sizeof(int64)],
 		   tmpbuf.data, sizeof(int64));
 
-	pq_putmessage_noblock('d', output_message.data, output_message.len);
+	pq_putmessage_noblock('d', msg->data, msg->len);
 
 	sentPtr = endptr;
 
@@ -3042,6 +3082,45 @@ retry:
 	}
 }
 
+/*
+ * Build a compressed version of the WAL data message in output_message, with
+ * nbytes of WAL, in compressed_message.
+ *
+ * The format is that of the 'w' message, with type 'z' and the compression
+ * method and the uncompressed length added to the header.  Returns false if
+ * the data doesn't compress, in which case output_message should be sent.
+ */
+static bool
+WalSndCompressData(XLogRecPtr startptr, XLogRecPtr walEnd, Size nbytes)
+{
+	WalCompression method = (WalCompression) wal_sender_compression;
+	int			bound = XLogCompressBound(method, nbytes);
+	int			len;
+
+	resetStringInfo(&compressed_message);
+	pq_sendbyte(&compressed_message, 'z');
+
+	pq_sendint64(&compressed_message, startptr);	/* dataStart */
+	pq_sendint64(&compressed_message, walEnd);	/* walEnd */
+	pq_sendint64(&compressed_message, 0);	/* sendtime, filled in last */
+	pq_sendbyte(&compressed_message, (uint8) method);
+	pq_sendint32(&compressed_message, (uint32) nbytes);
+
+	enlargeStringInfo(&compressed_message, bound);
+	len = XLogCompressData(method,
+						   &output_message.data[output_message.len - nbytes],
+						   nbytes,
+						   &compressed_message.data[compressed_message.len],
+						   bound);
+	if (len < 0 || len >= nbytes)
+		return false;
+
+	compressed_message.len += len;
+	compressed_message.data[compressed_message.len] = '\0';
+
+	return true;
+}
+
 /*
  * Stream out logically decoded data.
  */
@@ -3059,6 +3138,13 @@ XLogSendLogical(void) // 发送逻辑解码的数据， 这个是回调函数
 	 */
 	static XLogRecPtr flushPtr = InvalidXLogRecPtr; // 注意是static变量
 
+	/* Just pass on the output of the WAL sender we're sharing decoding with */
+	if (SharedDecodingIsFollower())
+	{
+		XLogSendShared();
+		return;
+	}
+
 	/*
 	 * Don't know whether we've caught up yet. We'll set WalSndCaughtUp to
 	 * true in WalSndWaitForWal, if we're actually waiting. We also set to
@@ -3081,7 +3167,9 @@ XLogSendLogical(void) // 发送逻辑解码的数据， 这个是回调函数
 		 * WalSndUpdateProgress which is called by output plugin through
 		 * logical decoding write api.
 		 */
+		SharedDecodingBeginRecord();
 		LogicalDecodingProcessRecord(logical_decoding_ctx, logical_decoding_ctx->reader);
+		SharedDecodingEndRecord(logical_decoding_ctx);
 
 		sentPtr = logical_decoding_ctx->reader->EndRecPtr;
 	}
@@ -3121,6 +3209,57 @@ XLogSendLogical(void) // 发送逻辑解码的数据， 这个是回调函数
 	}
 }
 
+/*
+ * Stream out the logically decoded data another WAL sender forwards to us,
+ * see shareddecoding.c.
+ */
+static void
+XLogSendShared(void)
+{
+	char	   *data;
+	Size		len;
+	XLogRecPtr	upto;
+
+	WalSndCaughtUp = false;
+
+	if (SharedDecodingReceive(&data, &len, &upto))
+	{
+		XLogRecPtr	lsn;
+
+		/* the message starts with the header written by WalSndPrepareWrite */
+		memcpy(&lsn, data + 1 + sizeof(int64), sizeof(int64));
+		lsn = pg_ntoh64(lsn);
+
+		pq_putmessage_noblock('d', data, len);
+		if (pq_flush_if_writable() != 0)
+			WalSndShutdown();
+
+		if (lsn > sentPtr)
+			sentPtr = lsn;
+	}
+	else
+	{
+		/* we've sent everything the other WAL sender decoded up to upto */
+		if (upto > sentPtr)
+			sentPtr = upto;
+		WalSndCaughtUp = true;
+	}
+
+	SharedDecodingAdvanceSlot();
+
+	if (WalSndCaughtUp && got_STOPPING)
+		got_SIGUSR2 = true;
+
+	/* Update shared memory status */
+	{
+		WalSnd	   *walsnd = MyWalSnd;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->sentPtr = sentPtr;
+		SpinLockRelease(&walsnd->mutex);
+	}
+}
+
 /*
  * Shutdown if the sender is caught up.
  *
@@ -3304,7 +3443,10 @@ WalSndShmemInit(void) // 初始化walsender的共享内存
 		MemSet(WalSndCtl, 0, WalSndShmemSize());
 
 		for (i = 0; i < NUM_SYNC_REP_WAIT_MODE; i++)
+		{
 			dlist_init(&(WalSndCtl->SyncRepQueue[i]));
+			pg_atomic_init_u64(&WalSndCtl->lsn[i], InvalidXLogRecPtr);
+		}
 
 		for (i = 0; i < max_wal_senders; i++)
 		{
@@ -376,7 +376,7 @@ DefineQueryRewrite(const char *rulename,
 		/*
 		 * ... there must not be another ON SELECT rule already ...
 		 */
-		if (!replace && event_relation->rd_rules != NULL)
+		if (!replace && RelationGetRuleLock(event_relation) != NULL)
 		{
 			int			i;
 
@@ -1487,7 +1487,7 @@ rewriteValuesRTE(Query *parsetree, RangeTblEntry *rte, int rti,
 		ListCell   *l;
 
 		/* Look for an unconditional DO INSTEAD rule */
-		locks = matchLocks(CMD_INSERT, target_relation->rd_rules,
+		locks = matchLocks(CMD_INSERT, RelationGetRuleLock(target_relation),
 						   parsetree->resultRelation, parsetree, &hasUpdate);
 
 		found = false;
@@ -2093,7 +2093,7 @@ fireRIRrules(Query *parsetree, List *activeRIRs)
 		/*
 		 * Collect the RIR rules that we must apply
 		 */
-		rules = rel->rd_rules;
+		rules = RelationGetRuleLock(rel);
 		if (rules != NULL)
 		{
 			locks = NIL;
@@ -2438,13 +2438,14 @@ fireRules(Query *parsetree,
 Query *
 get_view_query(Relation view)
 {
+	RuleLock   *rules = RelationGetRuleLock(view);
 	int			i;
 
 	Assert(view->rd_rel->relkind == RELKIND_VIEW);
 
-	for (i = 0; i < view->rd_rules->numLocks; i++)
+	for (i = 0; i < rules->numLocks; i++)
 	{
-		RewriteRule *rule = view->rd_rules->rules[i];
+		RewriteRule *rule = rules->rules[i];
 
 		if (rule->event == CMD_SELECT)
 		{
@@ -2471,7 +2472,7 @@ get_view_query(Relation view)
 static bool
 view_has_instead_trigger(Relation view, CmdType event)
 {
-	TriggerDesc *trigDesc = view->trigdesc;
+	TriggerDesc *trigDesc = RelationGetTriggerDesc(view);
 
 	switch (event)
 	{
@@ -2827,7 +2828,7 @@ relation_is_updatable(Oid reloid,
 	}
 
 	/* Look for unconditional DO INSTEAD rules, and note supported events */
-	rulelocks = rel->rd_rules;
+	rulelocks = RelationGetRuleLock(rel);
 	if (rulelocks != NULL)
 	{
 		int			i;
@@ -2852,7 +2853,7 @@ relation_is_updatable(Oid reloid,
 	/* Similarly look for INSTEAD OF triggers, if they are to be included */
 	if (include_triggers)
 	{
-		TriggerDesc *trigDesc = rel->trigdesc;
+		TriggerDesc *trigDesc = RelationGetTriggerDesc(rel);
 
 		if (trigDesc)
 		{
@@ -3864,7 +3865,7 @@ RewriteQuery(Query *parsetree, List *rewrite_events, int orig_rt_length)
 		/*
 		 * Collect and apply the appropriate rules.
 		 */
-		locks = matchLocks(event, rt_entry_relation->rd_rules,
+		locks = matchLocks(event, RelationGetRuleLock(rt_entry_relation),
 						   result_relation, parsetree, &hasUpdate);
 
 		product_orig_rt_length = list_length(parsetree->rtable);
@@ -545,7 +545,7 @@ get_policies_for_relation(Relation relation, CmdType cmd, Oid user_id,
 	*restrictive_policies = NIL;
 
 	/* First find all internal policies for the relation. */
-	foreach(item, relation->rd_rsdesc->policies)
+	foreach(item, RelationGetRowSecurity(relation)->policies)
 	{
 		bool		cmd_matches = false;
 		RowSecurityPolicy *policy = (RowSecurityPolicy *) lfirst(item);
@@ -81,7 +81,8 @@ static VacAttrStats **lookup_var_attr_stats(Relation rel, Bitmapset *attrs, List
 											int nvacatts, VacAttrStats **vacatts);
 static void statext_store(Oid statOid, bool inh,
 						  MVNDistinct *ndistinct, MVDependencies *dependencies,
-						  MCVList *mcv, Datum exprs, VacAttrStats **stats);
+						  MCVList *mcv, MVSketch *sketch, Datum exprs,
+						  VacAttrStats **stats);
 static int	statext_compute_stattarget(int stattarget,
 									   int nattrs, VacAttrStats **stats);
 
@@ -159,6 +160,7 @@ BuildRelationExtStatistics(Relation onerel, bool inh, double totalrows,
 		MVNDistinct *ndistinct = NULL;
 		MVDependencies *dependencies = NULL;
 		MCVList    *mcv = NULL;
+		MVSketch   *sketch = NULL;
 		Datum		exprstats = (Datum) 0;
 		VacAttrStats **stats;
 		ListCell   *lc2;
@@ -211,6 +213,8 @@ BuildRelationExtStatistics(Relation onerel, bool inh, double totalrows,
 				dependencies = statext_dependencies_build(data);
 			else if (t == STATS_EXT_MCV)
 				mcv = statext_mcv_build(data, totalrows, stattarget);
+			else if (t == STATS_EXT_SKETCH)
+				sketch = statext_sketch_build(onerel, inh, data, stat->exprs);
 			else if (t == STATS_EXT_EXPRESSIONS)
 			{
 				AnlExprData *exprdata;
@@ -233,7 +237,7 @@ BuildRelationExtStatistics(Relation onerel, bool inh, double totalrows,
 
 		/* store the statistics in the catalog */
 		statext_store(stat->statOid, inh,
-					  ndistinct, dependencies, mcv, exprstats, stats);
+					  ndistinct, dependencies, mcv, sketch, exprstats, stats);
 
 		/* for reporting progress */
 		pgstat_progress_update_param(PROGRESS_ANALYZE_EXT_STATS_COMPUTED,
@@ -407,6 +411,10 @@ statext_is_kind_built(HeapTuple htup, char type)
 			attnum = Anum_pg_statistic_ext_data_stxdmcv;
 			break;
 
+		case STATS_EXT_SKETCH:
+			attnum = Anum_pg_statistic_ext_data_stxdsketch;
+			break;
+
 		case STATS_EXT_EXPRESSIONS:
 			attnum = Anum_pg_statistic_ext_data_stxdexpr;
 			break;
@@ -478,6 +486,7 @@ fetch_statentries_for_relation(Relation pg_statext, Oid relid)
 			Assert((enabled[i] == STATS_EXT_NDISTINCT) ||
 				   (enabled[i] == STATS_EXT_DEPENDENCIES) ||
 				   (enabled[i] == STATS_EXT_MCV) ||
+				   (enabled[i] == STATS_EXT_SKETCH) ||
 				   (enabled[i] == STATS_EXT_EXPRESSIONS));
 			entry->types = lappend_int(entry->types, (int) enabled[i]);
 		}
@@ -785,7 +794,8 @@ lookup_var_attr_stats(Relation rel, Bitmapset *attrs, List *exprs,
 static void
 statext_store(Oid statOid, bool inh,
 			  MVNDistinct *ndistinct, MVDependencies *dependencies,
-			  MCVList *mcv, Datum exprs, VacAttrStats **stats)
+			  MCVList *mcv, MVSketch *sketch, Datum exprs,
+			  VacAttrStats **stats)
 {
 	Relation	pg_stextdata;
 	HeapTuple	stup;
@@ -830,6 +840,13 @@ statext_store(Oid statOid, bool inh,
 		nulls[Anum_pg_statistic_ext_data_stxdmcv - 1] = (data == NULL);
 		values[Anum_pg_statistic_ext_data_stxdmcv - 1] = PointerGetDatum(data);
 	}
+	if (sketch != NULL)
+	{
+		bytea	   *data = statext_sketch_serialize(sketch);
+
+		nulls[Anum_pg_statistic_ext_data_stxdsketch - 1] = false;
+		values[Anum_pg_statistic_ext_data_stxdsketch - 1] = PointerGetDatum(data);
+	}
 	if (exprs != (Datum) 0)
 	{
 		nulls[Anum_pg_statistic_ext_data_stxdexpr - 1] = false;
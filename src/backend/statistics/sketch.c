@@ -0,0 +1,386 @@
+/*-------------------------------------------------------------------------
+ *
+ * sketch.c
+ *	  POSTGRES join cardinality sketches
+ *
+ * The equality join selectivity estimate in eqjoinsel() assumes that the
+ * distinct values of the join column with fewer of them are all present in
+ * the other one ("containment").  That's a fine assumption for foreign
+ * keys, but it's far off for columns that just happen to be joined, e.g.
+ * two tables that each hold the orders of a different set of customers.
+ *
+ * A sketch statistics object on a single column or expression keeps a
+ * HyperLogLog estimator that has seen the hashes of all its values.  Two
+ * estimators can be merged into one for the union of the two sets, so with
+ * sketches on both sides of a join clause we can estimate how many distinct
+ * values the sides have in common, which replaces the containment
+ * assumption.  The values are hashed with the default hash opclass of the
+ * column's type, so the sketches can only be combined for join operators
+ * of that operator family.
+ *
+ * Unlike the other kinds of extended statistics, the sketch is built from
+ * the whole table rather than from the ANALYZE sample, since the number of
+ * distinct values seen in a sample says little about how the values of two
+ * tables overlap.  That costs an extra sequential scan, which is why it has
+ * to be asked for.  For inheritance trees and foreign tables we fall back
+ * to hashing the sample rows.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/statistics/sketch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/tableam.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_statistic_ext.h"
+#include "catalog/pg_statistic_ext_data.h"
+#include "commands/vacuum.h"
+#include "executor/executor.h"
+#include "lib/hyperloglog.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/parsetree.h"
+#include "statistics/extended_stats_internal.h"
+#include "statistics/statistics.h"
+#include "utils/fmgrprotos.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+
+/* size of the serialized header, before the registers */
+#define SizeOfSketchHeader	offsetof(MVSketch, registers)
+
+static void sketch_to_hll(MVSketch *sketch, hyperLogLogState *hll);
+static MVSketch *find_sketch(PlannerInfo *root, VariableStatData *vardata);
+
+
+/*
+ * statext_sketch_build
+ *		Build the sketch for the single column or expression of a statistics
+ *		object.
+ *
+ * Returns NULL if the data type has no default hash opclass.
+ */
+MVSketch *
+statext_sketch_build(Relation onerel, bool inh, StatsBuildData *data,
+					 List *exprs)
+{
+	VacAttrStats *stats = data->stats[0];
+	TypeCacheEntry *typentry;
+	hyperLogLogState hll;
+	MVSketch   *sketch;
+	Size		nregisters;
+
+	Assert(data->nattnums == 1);
+
+	typentry = lookup_type_cache(stats->attrtypid,
+								 TYPECACHE_HASH_PROC_FINFO |
+								 TYPECACHE_HASH_OPFAMILY);
+	if (!OidIsValid(typentry->hash_proc))
+		return NULL;
+
+	initHyperLogLog(&hll, STATS_SKETCH_BWIDTH);
+
+	if (!inh && ActiveSnapshotSet() &&
+		(onerel->rd_rel->relkind == RELKIND_RELATION ||
+		 onerel->rd_rel->relkind == RELKIND_MATVIEW))
+	{
+		TupleTableSlot *slot;
+		TableScanDesc scan;
+		EState	   *estate = NULL;
+		ExprContext *econtext = NULL;
+		ExprState  *exprstate = NULL;
+
+		slot = table_slot_create(onerel, NULL);
+		if (exprs != NIL)
+		{
+			estate = CreateExecutorState();
+			econtext = GetPerTupleExprContext(estate);
+			econtext->ecxt_scantuple = slot;
+			exprstate = ExecPrepareExpr(linitial(exprs), estate);
+		}
+
+		scan = table_beginscan(onerel, GetActiveSnapshot(), 0, NULL);
+		while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+		{
+			Datum		value;
+			bool		isnull;
+
+			vacuum_delay_point();
+
+			if (exprstate)
+			{
+				value = ExecEvalExprSwitchContext(exprstate, econtext, &isnull);
+				if (!isnull)
+					addHyperLogLog(&hll,
+								   DatumGetUInt32(FunctionCall1Coll(&typentry->hash_proc_finfo,
+																	stats->attrcollid,
+																	value)));
+				ResetExprContext(econtext);
+			}
+			else
+			{
+				value = slot_getattr(slot, data->attnums[0], &isnull);
+				if (!isnull)
+					addHyperLogLog(&hll,
+								   DatumGetUInt32(FunctionCall1Coll(&typentry->hash_proc_finfo,
+																	stats->attrcollid,
+																	value)));
+			}
+		}
+		table_endscan(scan);
+
+		ExecDropSingleTupleTableSlot(slot);
+		if (estate)
+			FreeExecutorState(estate);
+	}
+	else
+	{
+		int			i;
+
+		for (i = 0; i < data->numrows; i++)
+		{
+			if (data->nulls[0][i])
+				continue;
+			addHyperLogLog(&hll,
+						   DatumGetUInt32(FunctionCall1Coll(&typentry->hash_proc_finfo,
+															stats->attrcollid,
+															data->values[0][i])));
+		}
+	}
+
+	nregisters = hll.nRegisters;
+	sketch = palloc0(SizeOfSketchHeader + nregisters);
+	sketch->magic = STATS_SKETCH_MAGIC;
+	sketch->type = STATS_SKETCH_TYPE_BASIC;
+	sketch->opfamily = typentry->hash_opf;
+	sketch->collation = stats->attrcollid;
+	sketch->bwidth = STATS_SKETCH_BWIDTH;
+	memcpy(sketch->registers, hll.hashesArr, nregisters);
+	freeHyperLogLog(&hll);
+
+	return sketch;
+}
+
+/*
+ * statext_sketch_serialize
+ *		Serialize a sketch into a bytea value.
+ *
+ * The struct has no pointers, so this is just a copy behind a varlena
+ * header.
+ */
+bytea *
+statext_sketch_serialize(MVSketch *sketch)
+{
+	Size		len = SizeOfSketchHeader + ((Size) 1 << sketch->bwidth);
+	bytea	   *output;
+
+	output = (bytea *) palloc(VARHDRSZ + len);
+	SET_VARSIZE(output, VARHDRSZ + len);
+	memcpy(VARDATA(output), sketch, len);
+
+	return output;
+}
+
+/*
+ * statext_sketch_deserialize
+ *		Read a serialized sketch into a palloc'd, properly aligned struct.
+ */
+MVSketch *
+statext_sketch_deserialize(bytea *data)
+{
+	Size		len = VARSIZE_ANY_EXHDR(data);
+	MVSketch	header;
+	MVSketch   *sketch;
+
+	if (len < SizeOfSketchHeader)
+		elog(ERROR, "invalid sketch size %zu (expected at least %zu)",
+			 len, SizeOfSketchHeader);
+
+	memcpy(&header, VARDATA_ANY(data), SizeOfSketchHeader);
+	if (header.magic != STATS_SKETCH_MAGIC)
+		elog(ERROR, "invalid sketch magic %08x (expected %08x)",
+			 header.magic, STATS_SKETCH_MAGIC);
+	if (header.type != STATS_SKETCH_TYPE_BASIC)
+		elog(ERROR, "invalid sketch type %d (expected %d)",
+			 header.type, STATS_SKETCH_TYPE_BASIC);
+	if (header.bwidth < 4 || header.bwidth > 16 ||
+		len != SizeOfSketchHeader + ((Size) 1 << header.bwidth))
+		elog(ERROR, "invalid sketch size %zu for register width %d",
+			 len, header.bwidth);
+
+	sketch = palloc(len);
+	memcpy(sketch, VARDATA_ANY(data), len);
+
+	return sketch;
+}
+
+/*
+ * statext_sketch_load
+ *		Load the sketch for the indicated pg_statistic_ext tuple.
+ */
+MVSketch *
+statext_sketch_load(Oid mvoid, bool inh)
+{
+	MVSketch   *result;
+	bool		isnull;
+	Datum		sketch;
+	HeapTuple	htup;
+
+	htup = SearchSysCache2(STATEXTDATASTXOID,
+						   ObjectIdGetDatum(mvoid), BoolGetDatum(inh));
+	if (!HeapTupleIsValid(htup))
+		elog(ERROR, "cache lookup failed for statistics object %u", mvoid);
+
+	sketch = SysCacheGetAttr(STATEXTDATASTXOID, htup,
+							 Anum_pg_statistic_ext_data_stxdsketch, &isnull);
+	if (isnull)
+		elog(ERROR,
+			 "requested statistics kind \"%c\" is not yet built for statistics object %u",
+			 STATS_EXT_SKETCH, mvoid);
+
+	result = statext_sketch_deserialize(DatumGetByteaPP(sketch));
+
+	ReleaseSysCache(htup);
+
+	return result;
+}
+
+/* Set up a HyperLogLog estimator with the registers of a sketch. */
+static void
+sketch_to_hll(MVSketch *sketch, hyperLogLogState *hll)
+{
+	initHyperLogLog(hll, sketch->bwidth);
+	memcpy(hll->hashesArr, sketch->registers, hll->nRegisters);
+}
+
+/*
+ * Find a sketch on the column or expression described by vardata, or NULL.
+ */
+static MVSketch *
+find_sketch(PlannerInfo *root, VariableStatData *vardata)
+{
+	RelOptInfo *rel = vardata->rel;
+	RangeTblEntry *rte;
+	ListCell   *lc;
+
+	if (rel == NULL || rel->statlist == NIL || vardata->var == NULL ||
+		(rel->reloptkind != RELOPT_BASEREL &&
+		 rel->reloptkind != RELOPT_OTHER_MEMBER_REL))
+		return NULL;
+
+	rte = planner_rt_fetch(rel->relid, root);
+
+	foreach(lc, rel->statlist)
+	{
+		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
+
+		if (info->kind != STATS_EXT_SKETCH || info->inherit != rte->inh)
+			continue;
+
+		if (info->exprs == NIL)
+		{
+			Var		   *var = (Var *) vardata->var;
+
+			if (IsA(var, Var) &&
+				var->varno == rel->relid &&
+				bms_is_member(var->varattno, info->keys))
+				return statext_sketch_load(info->statOid, info->inherit);
+		}
+		else
+		{
+			Node	   *expr = (Node *) linitial(info->exprs);
+
+			if (IsA(expr, RelabelType))
+				expr = (Node *) ((RelabelType *) expr)->arg;
+			if (equal(expr, vardata->var))
+				return statext_sketch_load(info->statOid, info->inherit);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * statext_sketch_containment
+ *		Estimate which fraction of the distinct values of the side of an
+ *		equality join clause that has fewer of them also appears on the
+ *		other side, using sketches on both.
+ *
+ * Returns false, leaving *containment alone, if there are no usable
+ * sketches.  eqjoinsel() assumes a containment of 1.
+ */
+bool
+statext_sketch_containment(PlannerInfo *root,
+						   VariableStatData *vardata1,
+						   VariableStatData *vardata2,
+						   Oid operator, Oid collation,
+						   double *containment)
+{
+	MVSketch   *sketch1;
+	MVSketch   *sketch2 = NULL;
+	hyperLogLogState hll1;
+	hyperLogLogState hll2;
+	double		nd1;
+	double		nd2;
+	double		ndunion;
+	double		overlap;
+	double		result;
+	bool		found = false;
+
+	sketch1 = find_sketch(root, vardata1);
+	if (sketch1)
+		sketch2 = find_sketch(root, vardata2);
+	if (sketch1 == NULL || sketch2 == NULL)
+		goto done;
+
+	/* both sides must have been hashed alike, compatibly with the operator */
+	if (sketch1->opfamily != sketch2->opfamily ||
+		sketch1->bwidth != sketch2->bwidth ||
+		sketch1->collation != sketch2->collation ||
+		(OidIsValid(collation) && OidIsValid(sketch1->collation) &&
+		 collation != sketch1->collation) ||
+		!op_in_opfamily(operator, sketch1->opfamily))
+		goto done;
+
+	sketch_to_hll(sketch1, &hll1);
+	sketch_to_hll(sketch2, &hll2);
+	nd1 = estimateHyperLogLog(&hll1);
+	nd2 = estimateHyperLogLog(&hll2);
+	mergeHyperLogLog(&hll1, &hll2);
+	ndunion = estimateHyperLogLog(&hll1);
+	freeHyperLogLog(&hll1);
+	freeHyperLogLog(&hll2);
+
+	if (Min(nd1, nd2) < 1.0)
+		goto done;
+
+	/*
+	 * The estimate of the intersection is the difference of two estimates,
+	 * so it's noisy when the overlap is small; don't go below one common
+	 * value.
+	 */
+	overlap = nd1 + nd2 - ndunion;
+	overlap = Max(overlap, 1.0);
+	result = overlap / Min(nd1, nd2);
+	CLAMP_PROBABILITY(result);
+
+	*containment = result;
+	found = true;
+
+done:
+	if (sketch1)
+		pfree(sketch1);
+	if (sketch2)
+		pfree(sketch2);
+
+	return found;
+}
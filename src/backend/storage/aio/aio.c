@@ -0,0 +1,857 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Asynchronous I/O on data files
+ *
+ * A process that wants to perform I/O without waiting for it acquires a
+ * handle with pgaio_io_acquire(), describes what should happen when the I/O
+ * completes with pgaio_io_set_callback() and friends, and starts it with one
+ * of the pgaio_io_start_*() functions.  From then on the handle belongs to
+ * the AIO subsystem: once the I/O has completed and its completion callback
+ * has run, the handle is recycled.  Code that wants to wait for the I/O
+ * remembers a PgAioWaitRef before starting it.
+ *
+ * Handles live in shared memory, io_max_concurrency of them for each PGPROC,
+ * so that any process can complete I/O started by any other.  That matters:
+ * the buffer manager marks buffers as having I/O in progress while an
+ * asynchronous read is under way, and a backend that finds such a buffer
+ * must be able to wait for the read to finish even if the process that
+ * started it is itself blocked, say on a lock the waiter holds.
+ *
+ * Which mechanism actually performs the I/O is selected by io_method:
+ *
+ * - "sync" performs it right away, inside pgaio_io_start_*().  This works
+ *	 everywhere and is the default.
+ *
+ * - "io_uring" submits it to a Linux io_uring.  The postmaster creates one
+ *	 ring per PGPROC before forking, so every process inherits every ring and
+ *	 can reap completions from any of them; the completion queue of each ring
+ *	 is protected by an LWLock.  Only the owning process submits to a ring.
+ *	 We use the system calls directly, so no library is needed.
+ *
+ * Completion callbacks may run in any process and must not throw errors;
+ * anything that can fail in a way that should be reported to the user, such
+ * as a page failing verification, must be left for the issuing process to
+ * notice and deal with.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/aio/aio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/aio.h"
+#include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+
+/* GUCs */
+int			io_method = DEFAULT_IO_METHOD;
+int			io_max_concurrency = 32;
+
+const struct config_enum_entry io_method_options[] = {
+	{"sync", IOMETHOD_SYNC, false},
+#ifdef USE_IO_URING
+	{"io_uring", IOMETHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
+/* States of a handle */
+#define PGAIO_HS_IDLE			0	/* available to be acquired */
+#define PGAIO_HS_HANDED_OUT		1	/* acquired, I/O not yet started */
+#define PGAIO_HS_INFLIGHT		2	/* I/O started, not yet completed */
+
+struct PgAioHandle
+{
+	pg_atomic_uint32 state;		/* PGAIO_HS_* */
+
+	/*
+	 * Incremented each time an I/O completes, so that waiters can tell that
+	 * the I/O they were interested in is done even if the handle has since
+	 * been reused.
+	 */
+	pg_atomic_uint64 generation;
+
+	int			owner_procno;	/* pgprocno of the owning process */
+	PgAioOp		op;
+	PgAioCallbackID cb;
+	int			result;			/* bytes transferred, or -errno */
+
+	/* What to do */
+	int			fd;
+	off_t		offset;
+	int			iovcnt;
+	struct iovec iov[PG_IOV_MAX];
+
+	/* Buffers targeted by the I/O, for completion callbacks */
+	int			nbuffers;
+	Buffer		buffers[PG_IOV_MAX];
+
+	/* Broadcast on completion */
+	ConditionVariable cv;
+};
+
+typedef struct PgAioCtl
+{
+	int			nprocs;			/* number of PGPROCs with handles */
+#ifdef USE_IO_URING
+	LWLockPadded *uring_locks;	/* completion queue lock, one per ring */
+#endif
+	PgAioHandle handles[FLEXIBLE_ARRAY_MEMBER];
+} PgAioCtl;
+
+static PgAioCtl *AioCtl = NULL;
+
+/* Range of handles belonging to this process, or -1 if none */
+static int	my_first_handle = -1;
+static int	my_next_handle = 0;
+
+static void pgaio_io_execute_sync(PgAioHandle *ioh);
+static void pgaio_io_complete(PgAioHandle *ioh, int result);
+static void pgaio_io_wait(PgAioHandle *ioh, uint64 generation);
+static void pgaio_shmem_exit(int code, Datum arg);
+
+#ifdef USE_IO_URING
+/*
+ * Process-local view of a ring.  The mappings are created by the postmaster
+ * and inherited by every child process.
+ */
+typedef struct PgAioUring
+{
+	int			fd;
+
+	void	   *sq_ring;
+	size_t		sq_ring_size;
+	void	   *cq_ring;
+	size_t		cq_ring_size;
+	struct io_uring_sqe *sqes;
+	size_t		sqes_size;
+
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned   *sq_mask;
+	unsigned   *sq_array;
+
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned   *cq_mask;
+	struct io_uring_cqe *cqes;
+} PgAioUring;
+
+static PgAioUring *pgaio_uring_rings = NULL;
+static int	pgaio_uring_nrings = 0;
+
+static void pgaio_uring_create_rings(int nrings);
+static void pgaio_uring_close_rings(void);
+static void pgaio_uring_submit(PgAioHandle *ioh);
+static int	pgaio_uring_reap(PgAioUring *ring);
+static void pgaio_uring_wait(PgAioHandle *ioh, uint64 generation);
+#endif
+
+static inline PgAioHandle *
+pgaio_handle_at(int index)
+{
+	return &AioCtl->handles[index];
+}
+
+/*
+ * AioShmemSize --- report amount of shared memory space needed
+ */
+Size
+AioShmemSize(void)
+{
+	Size		size;
+	int			nprocs = MaxBackends + NUM_AUXILIARY_PROCS;
+
+	size = offsetof(PgAioCtl, handles);
+	size = add_size(size, mul_size(mul_size(nprocs, io_max_concurrency),
+								   sizeof(PgAioHandle)));
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+	{
+		size = MAXALIGN(size);
+		size = add_size(size, mul_size(nprocs, sizeof(LWLockPadded)));
+	}
+#endif
+
+	return size;
+}
+
+/*
+ * AioShmemInit --- initialize AIO shared memory, and create the io_uring
+ * rings if they're used
+ */
+void
+AioShmemInit(void)
+{
+	bool		found;
+	int			nprocs = MaxBackends + NUM_AUXILIARY_PROCS;
+	int			nhandles = nprocs * io_max_concurrency;
+
+	AioCtl = (PgAioCtl *) ShmemInitStruct("AIO Control", AioShmemSize(), &found);
+
+	if (found)
+		return;
+
+	AioCtl->nprocs = nprocs;
+	for (int i = 0; i < nhandles; i++)
+	{
+		PgAioHandle *ioh = pgaio_handle_at(i);
+
+		pg_atomic_init_u32(&ioh->state, PGAIO_HS_IDLE);
+		pg_atomic_init_u64(&ioh->generation, 1);
+		ioh->owner_procno = i / io_max_concurrency;
+		ioh->op = PGAIO_OP_INVALID;
+		ioh->cb = PGAIO_CB_NONE;
+		ioh->nbuffers = 0;
+		ConditionVariableInit(&ioh->cv);
+	}
+
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+	{
+		AioCtl->uring_locks = (LWLockPadded *)
+			((char *) AioCtl +
+			 MAXALIGN(offsetof(PgAioCtl, handles) +
+					  sizeof(PgAioHandle) * nhandles));
+		for (int i = 0; i < nprocs; i++)
+			LWLockInitialize(&AioCtl->uring_locks[i].lock,
+							 LWTRANCHE_AIO_URING_COMPLETION);
+
+		/* Forget rings from before a crash restart, then make new ones. */
+		pgaio_uring_close_rings();
+		pgaio_uring_create_rings(nprocs);
+	}
+#endif
+}
+
+/*
+ * Set up this process's use of AIO.  Called once MyProc is known.
+ */
+void
+pgaio_init_backend(void)
+{
+	Assert(AioCtl != NULL);
+
+	if (MyProc == NULL || MyProc->pgprocno >= AioCtl->nprocs)
+		return;
+
+	my_first_handle = MyProc->pgprocno * io_max_concurrency;
+	my_next_handle = 0;
+
+	/*
+	 * Make sure the kernel isn't still transferring data into memory we're
+	 * about to give up, such as pinned buffers, when we exit.  This must run
+	 * before the buffer manager's exit callback, so register it afterwards.
+	 */
+	on_shmem_exit(pgaio_shmem_exit, 0);
+}
+
+/*
+ * Can this process start I/O asynchronously?
+ */
+bool
+pgaio_enabled(void)
+{
+	return io_method != IOMETHOD_SYNC && my_first_handle >= 0;
+}
+
+/*
+ * Acquire a handle for starting a new I/O.  If all of this process's handles
+ * are busy, waits for the oldest I/O to complete.
+ */
+PgAioHandle *
+pgaio_io_acquire(void)
+{
+	if (my_first_handle < 0)
+		elog(ERROR, "asynchronous I/O is not available in this process");
+
+	for (;;)
+	{
+		for (int i = 0; i < io_max_concurrency; i++)
+		{
+			PgAioHandle *ioh;
+
+			ioh = pgaio_handle_at(my_first_handle + my_next_handle);
+			if (++my_next_handle == io_max_concurrency)
+				my_next_handle = 0;
+
+			if (pg_atomic_read_u32(&ioh->state) == PGAIO_HS_IDLE)
+			{
+				pg_atomic_write_u32(&ioh->state, PGAIO_HS_HANDED_OUT);
+				ioh->op = PGAIO_OP_INVALID;
+				ioh->cb = PGAIO_CB_NONE;
+				ioh->nbuffers = 0;
+				return ioh;
+			}
+		}
+
+		/*
+		 * All handles are in flight.  The one we'd look at next is the one we
+		 * handed out longest ago, so wait for that.
+		 */
+		pgaio_wait_index(my_first_handle + my_next_handle);
+	}
+}
+
+/*
+ * Give back a handle that was acquired but not used to start an I/O.
+ */
+void
+pgaio_io_release(PgAioHandle *ioh)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT);
+	Assert(ioh->owner_procno == MyProc->pgprocno);
+
+	pg_atomic_write_u32(&ioh->state, PGAIO_HS_IDLE);
+}
+
+/*
+ * Return the index of a handle, suitable for pgaio_wait_index().
+ */
+int
+pgaio_io_get_index(PgAioHandle *ioh)
+{
+	return ioh - AioCtl->handles;
+}
+
+/*
+ * Remember the I/O a handle is about to perform, so that it can be waited
+ * for after the handle has been given to pgaio_io_start_*().
+ */
+void
+pgaio_io_get_wref(PgAioHandle *ioh, PgAioWaitRef *wref)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT);
+
+	wref->aio_index = pgaio_io_get_index(ioh);
+	wref->generation = pg_atomic_read_u64(&ioh->generation);
+}
+
+void
+pgaio_io_set_callback(PgAioHandle *ioh, PgAioCallbackID cb)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT);
+
+	ioh->cb = cb;
+}
+
+/*
+ * Record the buffers an I/O is for, for use by its completion callback.
+ */
+void
+pgaio_io_set_buffers(PgAioHandle *ioh, const Buffer *buffers, int nbuffers)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT);
+	Assert(nbuffers <= lengthof(ioh->buffers));
+
+	memcpy(ioh->buffers, buffers, sizeof(Buffer) * nbuffers);
+	ioh->nbuffers = nbuffers;
+}
+
+/*
+ * For completion callbacks: the buffers recorded by pgaio_io_set_buffers().
+ */
+int
+pgaio_io_get_buffers(PgAioHandle *ioh, Buffer **buffers)
+{
+	*buffers = ioh->buffers;
+	return ioh->nbuffers;
+}
+
+/*
+ * For completion callbacks: the number of bytes transferred, or a negative
+ * errno value.
+ */
+int
+pgaio_io_get_result(PgAioHandle *ioh)
+{
+	return ioh->result;
+}
+
+/*
+ * Common part of starting an I/O.
+ */
+static void
+pgaio_io_start(PgAioHandle *ioh, PgAioOp op, int fd,
+			   const struct iovec *iov, int iovcnt, off_t offset)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT);
+	Assert(iovcnt > 0 && iovcnt <= lengthof(ioh->iov));
+
+	ioh->op = op;
+	ioh->fd = fd;
+	ioh->offset = offset;
+	ioh->iovcnt = iovcnt;
+	memcpy(ioh->iov, iov, sizeof(struct iovec) * iovcnt);
+
+	/* make the description visible before anyone can see it's in flight */
+	pg_write_barrier();
+	pg_atomic_write_u32(&ioh->state, PGAIO_HS_INFLIGHT);
+
+	switch (io_method)
+	{
+		case IOMETHOD_SYNC:
+			pgaio_io_execute_sync(ioh);
+			break;
+#ifdef USE_IO_URING
+		case IOMETHOD_IO_URING:
+			pgaio_uring_submit(ioh);
+			break;
+#endif
+		default:
+			elog(ERROR, "unrecognized io_method: %d", io_method);
+	}
+}
+
+/*
+ * Start reading into iov from fd at offset.  fd must stay open until the
+ * I/O is submitted, which happens before this returns.
+ */
+void
+pgaio_io_start_readv(PgAioHandle *ioh, int fd,
+					 const struct iovec *iov, int iovcnt, off_t offset)
+{
+	pgaio_io_start(ioh, PGAIO_OP_READV, fd, iov, iovcnt, offset);
+}
+
+/*
+ * Start writing iov to fd at offset.
+ */
+void
+pgaio_io_start_writev(PgAioHandle *ioh, int fd,
+					  const struct iovec *iov, int iovcnt, off_t offset)
+{
+	pgaio_io_start(ioh, PGAIO_OP_WRITEV, fd, iov, iovcnt, offset);
+}
+
+/*
+ * Perform an I/O synchronously, as io_method=sync does for every I/O.
+ */
+static void
+pgaio_io_execute_sync(PgAioHandle *ioh)
+{
+	ssize_t		rc;
+
+	pgstat_report_wait_start(WAIT_EVENT_AIO_IO_COMPLETION);
+	do
+	{
+		if (ioh->op == PGAIO_OP_READV)
+			rc = pg_preadv(ioh->fd, ioh->iov, ioh->iovcnt, ioh->offset);
+		else
+			rc = pg_pwritev(ioh->fd, ioh->iov, ioh->iovcnt, ioh->offset);
+	} while (rc < 0 && errno == EINTR);
+	pgstat_report_wait_end();
+
+	pgaio_io_complete(ioh, rc < 0 ? -errno : (int) rc);
+}
+
+/*
+ * An I/O has completed: run its callback, and recycle the handle.  This may
+ * run in any process.
+ */
+static void
+pgaio_io_complete(PgAioHandle *ioh, int result)
+{
+	Assert(pg_atomic_read_u32(&ioh->state) == PGAIO_HS_INFLIGHT);
+
+	ioh->result = result;
+
+	switch (ioh->cb)
+	{
+		case PGAIO_CB_NONE:
+			break;
+		case PGAIO_CB_SHARED_BUFFER_READV:
+			shared_buffer_readv_complete(ioh);
+			break;
+	}
+
+	ioh->op = PGAIO_OP_INVALID;
+	ioh->cb = PGAIO_CB_NONE;
+	ioh->nbuffers = 0;
+
+	/*
+	 * Advance the generation before marking the handle idle, so that anyone
+	 * who sees it idle also sees that their I/O is done.
+	 */
+	pg_atomic_fetch_add_u64(&ioh->generation, 1);
+	pg_atomic_write_u32(&ioh->state, PGAIO_HS_IDLE);
+
+	ConditionVariableBroadcast(&ioh->cv);
+}
+
+/*
+ * Has the I/O referenced by wref completed?
+ */
+bool
+pgaio_wref_check_done(PgAioWaitRef *wref)
+{
+	PgAioHandle *ioh;
+
+	if (wref->aio_index < 0)
+		return true;
+
+	ioh = pgaio_handle_at(wref->aio_index);
+	return pg_atomic_read_u64(&ioh->generation) != wref->generation;
+}
+
+/*
+ * Wait for the I/O referenced by wref to complete.
+ */
+void
+pgaio_wref_wait(PgAioWaitRef *wref)
+{
+	if (wref->aio_index < 0)
+		return;
+
+	pgaio_io_wait(pgaio_handle_at(wref->aio_index), wref->generation);
+}
+
+/*
+ * Wait for whatever I/O the handle with the given index is performing, if
+ * any.  This is for code that finds an index in shared state, such as a
+ * buffer header, and may be racing with the handle being recycled; at worst
+ * it waits for an unrelated I/O that its owner would have waited for soon.
+ */
+void
+pgaio_wait_index(int aio_index)
+{
+	PgAioHandle *ioh = pgaio_handle_at(aio_index);
+	uint64		generation;
+
+	generation = pg_atomic_read_u64(&ioh->generation);
+	pg_read_barrier();
+	if (pg_atomic_read_u32(&ioh->state) != PGAIO_HS_INFLIGHT)
+		return;
+
+	pgaio_io_wait(ioh, generation);
+}
+
+/*
+ * Wait for all I/O started by this process to complete.
+ */
+void
+pgaio_wait_all(void)
+{
+	if (my_first_handle < 0)
+		return;
+
+	for (int i = 0; i < io_max_concurrency; i++)
+		pgaio_wait_index(my_first_handle + i);
+}
+
+/*
+ * Clean up after an error: the kernel may still be transferring data for
+ * I/Os we started, which mustn't outlive the buffer pins we're about to
+ * release, and handles acquired but never used must be given back.
+ */
+void
+pgaio_at_abort(void)
+{
+	if (my_first_handle < 0)
+		return;
+
+	pgaio_wait_all();
+
+	for (int i = 0; i < io_max_concurrency; i++)
+	{
+		PgAioHandle *ioh = pgaio_handle_at(my_first_handle + i);
+
+		if (pg_atomic_read_u32(&ioh->state) == PGAIO_HS_HANDED_OUT)
+			pg_atomic_write_u32(&ioh->state, PGAIO_HS_IDLE);
+	}
+}
+
+static void
+pgaio_shmem_exit(int code, Datum arg)
+{
+	pgaio_at_abort();
+	my_first_handle = -1;
+}
+
+/*
+ * Wait for an I/O with the given generation to complete.
+ */
+static void
+pgaio_io_wait(PgAioHandle *ioh, uint64 generation)
+{
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+	{
+		pgaio_uring_wait(ioh, generation);
+		return;
+	}
+#endif
+
+	/*
+	 * With io_method=sync, I/O is only ever in flight while the process that
+	 * started it is performing it, so just wait to be told it's done.
+	 */
+	ConditionVariablePrepareToSleep(&ioh->cv);
+	while (pg_atomic_read_u64(&ioh->generation) == generation)
+		ConditionVariableSleep(&ioh->cv, WAIT_EVENT_AIO_IO_COMPLETION);
+	ConditionVariableCancelSleep();
+}
+
+#ifdef USE_IO_URING
+
+static inline int
+pgaio_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int
+pgaio_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+				  unsigned flags)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+						 flags, NULL, 0);
+}
+
+/*
+ * Create one ring per PGPROC.  This happens in the postmaster, so that all
+ * children inherit them.
+ */
+static void
+pgaio_uring_create_rings(int nrings)
+{
+	pgaio_uring_rings = (PgAioUring *)
+		MemoryContextAllocZero(TopMemoryContext, sizeof(PgAioUring) * nrings);
+
+	for (int i = 0; i < nrings; i++)
+	{
+		PgAioUring *ring = &pgaio_uring_rings[i];
+		struct io_uring_params p;
+
+		memset(&p, 0, sizeof(p));
+		ring->fd = pgaio_uring_setup(io_max_concurrency, &p);
+		if (ring->fd < 0)
+		{
+			int			save_errno = errno;
+
+			ereport(FATAL,
+					(errcode_for_file_access(),
+					 errmsg("could not create io_uring queue: %m"),
+					 (save_errno == ENOMEM || save_errno == EPERM) ?
+					 errhint("This may be caused by the amount of locked memory permitted by the kernel. Consider lowering io_max_concurrency or max_connections, or setting io_method = sync.") : 0));
+		}
+		pgaio_uring_nrings = i + 1;
+
+		ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		ring->cq_ring_size = p.cq_off.cqes +
+			p.cq_entries * sizeof(struct io_uring_cqe);
+		if (p.features & IORING_FEAT_SINGLE_MMAP)
+			ring->sq_ring_size = ring->cq_ring_size =
+				Max(ring->sq_ring_size, ring->cq_ring_size);
+		ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+		ring->sq_ring = mmap(NULL, ring->sq_ring_size,
+							 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							 ring->fd, IORING_OFF_SQ_RING);
+		if (ring->sq_ring == MAP_FAILED)
+			ereport(FATAL,
+					(errmsg("could not map io_uring submission queue: %m")));
+
+		if (p.features & IORING_FEAT_SINGLE_MMAP)
+			ring->cq_ring = ring->sq_ring;
+		else
+		{
+			ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+								 PROT_READ | PROT_WRITE,
+								 MAP_SHARED | MAP_POPULATE,
+								 ring->fd, IORING_OFF_CQ_RING);
+			if (ring->cq_ring == MAP_FAILED)
+				ereport(FATAL,
+						(errmsg("could not map io_uring completion queue: %m")));
+		}
+
+		ring->sqes = mmap(NULL, ring->sqes_size,
+						  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						  ring->fd, IORING_OFF_SQES);
+		if (ring->sqes == MAP_FAILED)
+			ereport(FATAL,
+					(errmsg("could not map io_uring submission entries: %m")));
+
+		ring->sq_head = (unsigned *) ((char *) ring->sq_ring + p.sq_off.head);
+		ring->sq_tail = (unsigned *) ((char *) ring->sq_ring + p.sq_off.tail);
+		ring->sq_mask = (unsigned *) ((char *) ring->sq_ring + p.sq_off.ring_mask);
+		ring->sq_array = (unsigned *) ((char *) ring->sq_ring + p.sq_off.array);
+
+		ring->cq_head = (unsigned *) ((char *) ring->cq_ring + p.cq_off.head);
+		ring->cq_tail = (unsigned *) ((char *) ring->cq_ring + p.cq_off.tail);
+		ring->cq_mask = (unsigned *) ((char *) ring->cq_ring + p.cq_off.ring_mask);
+		ring->cqes = (struct io_uring_cqe *)
+			((char *) ring->cq_ring + p.cq_off.cqes);
+	}
+}
+
+/*
+ * Close the rings of a previous incarnation of shared memory.
+ */
+static void
+pgaio_uring_close_rings(void)
+{
+	for (int i = 0; i < pgaio_uring_nrings; i++)
+	{
+		PgAioUring *ring = &pgaio_uring_rings[i];
+
+		if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+			munmap(ring->sqes, ring->sqes_size);
+		if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED &&
+			ring->cq_ring != ring->sq_ring)
+			munmap(ring->cq_ring, ring->cq_ring_size);
+		if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+			munmap(ring->sq_ring, ring->sq_ring_size);
+		close(ring->fd);
+	}
+
+	if (pgaio_uring_rings)
+		pfree(pgaio_uring_rings);
+	pgaio_uring_rings = NULL;
+	pgaio_uring_nrings = 0;
+}
+
+/*
+ * Submit an I/O to this process's ring.  There's always room in the
+ * submission queue, because it has as many entries as we have handles.
+ */
+static void
+pgaio_uring_submit(PgAioHandle *ioh)
+{
+	PgAioUring *ring = &pgaio_uring_rings[ioh->owner_procno];
+	struct io_uring_sqe *sqe;
+	unsigned	tail;
+	unsigned	index;
+	int			rc;
+
+	Assert(ioh->owner_procno == MyProc->pgprocno);
+
+	tail = *ring->sq_tail;
+	index = tail & *ring->sq_mask;
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = ioh->op == PGAIO_OP_READV ? IORING_OP_READV : IORING_OP_WRITEV;
+	sqe->fd = ioh->fd;
+	sqe->addr = (uint64) (uintptr_t) ioh->iov;
+	sqe->len = ioh->iovcnt;
+	sqe->off = ioh->offset;
+	sqe->user_data = pgaio_io_get_index(ioh);
+	ring->sq_array[index] = index;
+
+	/* publish the entry before the new tail */
+	pg_write_barrier();
+	*ring->sq_tail = tail + 1;
+
+	for (;;)
+	{
+		rc = pgaio_uring_enter(ring->fd, 1, 0, 0);
+		if (rc >= 0)
+			break;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EBUSY)
+		{
+			/* the kernel wants us to make room by reaping completions */
+			LWLockAcquire(&AioCtl->uring_locks[ioh->owner_procno].lock,
+						  LW_EXCLUSIVE);
+			pgaio_uring_reap(ring);
+			LWLockRelease(&AioCtl->uring_locks[ioh->owner_procno].lock);
+			continue;
+		}
+
+		/*
+		 * The kernel hasn't consumed the entry, so take it back and give up.
+		 */
+		*ring->sq_tail = tail;
+		pg_atomic_write_u32(&ioh->state, PGAIO_HS_HANDED_OUT);
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not submit I/O to io_uring: %m")));
+	}
+}
+
+/*
+ * Process all available completions.  Caller must hold the ring's lock.
+ * Returns the number of completions processed.
+ */
+static int
+pgaio_uring_reap(PgAioUring *ring)
+{
+	unsigned	head = *ring->cq_head;
+	unsigned	tail;
+	int			nreaped = 0;
+
+	tail = *(volatile unsigned *) ring->cq_tail;
+	pg_read_barrier();
+
+	while (head != tail)
+	{
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+		pgaio_io_complete(pgaio_handle_at((int) cqe->user_data), cqe->res);
+		head++;
+		nreaped++;
+	}
+
+	/* let the kernel reuse the entries */
+	pg_memory_barrier();
+	*ring->cq_head = head;
+
+	return nreaped;
+}
+
+/*
+ * Wait for an I/O on the ring of its owner, reaping completions ourselves if
+ * nobody else is.
+ */
+static void
+pgaio_uring_wait(PgAioHandle *ioh, uint64 generation)
+{
+	int			procno = ioh->owner_procno;
+	PgAioUring *ring = &pgaio_uring_rings[procno];
+
+	while (pg_atomic_read_u64(&ioh->generation) == generation)
+	{
+		LWLockAcquire(&AioCtl->uring_locks[procno].lock, LW_EXCLUSIVE);
+
+		if (pgaio_uring_reap(ring) == 0 &&
+			pg_atomic_read_u64(&ioh->generation) == generation)
+		{
+			int			rc;
+
+			pgstat_report_wait_start(WAIT_EVENT_AIO_IO_COMPLETION);
+			rc = pgaio_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+			pgstat_report_wait_end();
+
+			if (rc < 0 && errno != EINTR)
+				elog(PANIC, "could not wait for io_uring completion: %m");
+
+			pgaio_uring_reap(ring);
+		}
+
+		LWLockRelease(&AioCtl->uring_locks[procno].lock);
+	}
+}
+
+#endif							/* USE_IO_URING */
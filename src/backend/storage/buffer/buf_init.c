@@ -112,6 +112,19 @@ InitBufferPool(void) // 创建共享池的函数，只在主进程启动时调
 	{
 		int			i;
 
+		/*
+		 * With numa enabled, spread the buffers, and their descriptors, over
+		 * all nodes so that no one node's memory bandwidth becomes the
+		 * bottleneck.  This has to happen before the memory is first touched
+		 * below, or the pages would have to be migrated.
+		 */
+		ShmemNumaInterleave("Buffer Descriptors", BufferDescriptors,
+							NBuffers * sizeof(BufferDescPadded));
+		ShmemNumaInterleave("Buffer Blocks", BufferBlocks,
+							NBuffers * (Size) BLCKSZ);
+		ShmemNumaInterleave("Buffer IO Condition Variables", BufferIOCVArray,
+							NBuffers * sizeof(ConditionVariableMinimallyPadded));
+
 		/*
 		 * Initialize all the buffer headers.
 		 */
@@ -123,6 +136,7 @@ InitBufferPool(void) // 创建共享池的函数，只在主进程启动时调
 
 			pg_atomic_init_u32(&buf->state, 0);
 			buf->wait_backend_pgprocno = INVALID_PGPROCNO;
+			buf->io_handle = -1;
 
 			buf->buf_id = i;
 
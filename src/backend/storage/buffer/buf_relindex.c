@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------
+ *
+ * buf_relindex.c
+ *	  routines for finding the shared buffers belonging to a relation.
+ *
+ * Operations that have to act on all cached pages of a relation or database
+ * (dropping, truncating or flushing it) used to scan the whole buffer pool,
+ * which takes a long time with a large shared_buffers, however little of
+ * the relation is actually cached.  To avoid that, every shared buffer with
+ * a valid tag is also kept on a doubly-linked list for its relation file.
+ * The lists are found through a small shared hash table keyed by
+ * RelFileLocator; the links themselves live in an array parallel to the
+ * buffer descriptors, so that membership costs no allocation.
+ *
+ * A buffer is added when it gets a valid tag and removed when the tag is
+ * cleared, both while the caller holds the exclusive buffer mapping lock
+ * for the tag (see BufferAlloc and InvalidateBuffer).  That means that
+ * nobody can find a buffer through the mapping table without also finding
+ * it here.  The index has its own partition locks, always taken after the
+ * mapping lock and never while holding a buffer header spinlock.
+ *
+ * Readers take a snapshot of the buffer IDs of a relation under a share
+ * lock and must recheck each buffer's tag under the buffer header lock,
+ * just like the old full scans did, as the buffers may have been evicted
+ * in the meantime.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/buf_relindex.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "storage/buf_internals.h"
+#include "storage/bufmgr.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+/* number of partitions of the relation index; must be a power of 2 */
+#define NUM_BUF_REL_INDEX_PARTITIONS	NUM_BUFFER_PARTITIONS
+
+/* entry of the relation index hashtable */
+typedef struct BufRelIndexEnt
+{
+	RelFileLocator key;			/* relation file, hash key */
+	int			head;			/* first buffer of the relation, or -1 */
+	int			nbuffers;		/* number of buffers in the list */
+} BufRelIndexEnt;
+
+/* per-buffer links of the relation lists */
+typedef struct BufRelIndexLink
+{
+	int			prev;
+	int			next;
+} BufRelIndexLink;
+
+static HTAB *SharedBufRelIndex;
+static BufRelIndexLink *BufRelIndexLinks;
+static LWLockPadded *BufRelIndexLocks;
+
+static inline LWLock *
+BufRelIndexPartitionLock(uint32 hashcode)
+{
+	return &BufRelIndexLocks[hashcode % NUM_BUF_REL_INDEX_PARTITIONS].lock;
+}
+
+/*
+ * Estimate space needed for the relation index
+ */
+Size
+BufRelIndexShmemSize(void)
+{
+	Size		size = 0;
+
+	/* at most one entry per buffer can be in use at any time */
+	size = add_size(size, hash_estimate_size(NBuffers, sizeof(BufRelIndexEnt)));
+	size = add_size(size, mul_size(NBuffers, sizeof(BufRelIndexLink)));
+	size = add_size(size, mul_size(NUM_BUF_REL_INDEX_PARTITIONS,
+								   sizeof(LWLockPadded)));
+
+	return size;
+}
+
+/*
+ * Initialize the relation index in shared memory
+ */
+void
+InitBufRelIndex(void)
+{
+	HASHCTL		info;
+	bool		foundLinks;
+	bool		foundLocks;
+
+	/* assume no locking is needed yet */
+
+	info.keysize = sizeof(RelFileLocator);
+	info.entrysize = sizeof(BufRelIndexEnt);
+	info.num_partitions = NUM_BUF_REL_INDEX_PARTITIONS;
+
+	SharedBufRelIndex = ShmemInitHash("Shared Buffer Relation Index",
+									  NBuffers, NBuffers,
+									  &info,
+									  HASH_ELEM | HASH_BLOBS |
+									  HASH_PARTITION | HASH_FIXED_SIZE);
+
+	BufRelIndexLinks = (BufRelIndexLink *)
+		ShmemInitStruct("Shared Buffer Relation Index Links",
+						mul_size(NBuffers, sizeof(BufRelIndexLink)),
+						&foundLinks);
+	BufRelIndexLocks = (LWLockPadded *)
+		ShmemInitStruct("Shared Buffer Relation Index Locks",
+						mul_size(NUM_BUF_REL_INDEX_PARTITIONS,
+								 sizeof(LWLockPadded)),
+						&foundLocks);
+
+	if (!foundLinks)
+	{
+		for (int i = 0; i < NBuffers; i++)
+		{
+			BufRelIndexLinks[i].prev = -1;
+			BufRelIndexLinks[i].next = -1;
+		}
+	}
+
+	if (!foundLocks)
+	{
+		for (int i = 0; i < NUM_BUF_REL_INDEX_PARTITIONS; i++)
+			LWLockInitialize(&BufRelIndexLocks[i].lock,
+							 LWTRANCHE_BUFFER_REL_INDEX);
+	}
+}
+
+/*
+ * BufRelIndexAdd
+ *		Put the buffer on the list of the relation its new tag belongs to
+ *
+ * Caller must hold exclusive lock on BufMappingLock for tag's partition,
+ * and must just have set the buffer's tag to *tagPtr.
+ */
+void
+BufRelIndexAdd(int buf_id, const BufferTag *tagPtr)
+{
+	RelFileLocator rlocator = BufTagGetRelFileLocator(tagPtr);
+	uint32		hashcode = get_hash_value(SharedBufRelIndex, &rlocator);
+	LWLock	   *partitionLock = BufRelIndexPartitionLock(hashcode);
+	BufRelIndexLink *link = &BufRelIndexLinks[buf_id];
+	BufRelIndexEnt *ent;
+	bool		found;
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+
+	ent = (BufRelIndexEnt *)
+		hash_search_with_hash_value(SharedBufRelIndex, &rlocator, hashcode,
+									HASH_ENTER, &found);
+	if (!found)
+	{
+		ent->head = -1;
+		ent->nbuffers = 0;
+	}
+
+	link->prev = -1;
+	link->next = ent->head;
+	if (ent->head >= 0)
+		BufRelIndexLinks[ent->head].prev = buf_id;
+	ent->head = buf_id;
+	ent->nbuffers++;
+
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * BufRelIndexRemove
+ *		Take the buffer off the list of the relation its old tag belonged to
+ *
+ * Caller must hold exclusive lock on BufMappingLock for tag's partition.
+ */
+void
+BufRelIndexRemove(int buf_id, const BufferTag *tagPtr)
+{
+	RelFileLocator rlocator = BufTagGetRelFileLocator(tagPtr);
+	uint32		hashcode = get_hash_value(SharedBufRelIndex, &rlocator);
+	LWLock	   *partitionLock = BufRelIndexPartitionLock(hashcode);
+	BufRelIndexLink *link = &BufRelIndexLinks[buf_id];
+	BufRelIndexEnt *ent;
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+
+	ent = (BufRelIndexEnt *)
+		hash_search_with_hash_value(SharedBufRelIndex, &rlocator, hashcode,
+									HASH_FIND, NULL);
+	if (!ent)					/* shouldn't happen */
+		elog(ERROR, "shared buffer relation index corrupted");
+
+	if (link->prev >= 0)
+		BufRelIndexLinks[link->prev].next = link->next;
+	else
+		ent->head = link->next;
+	if (link->next >= 0)
+		BufRelIndexLinks[link->next].prev = link->prev;
+	link->prev = -1;
+	link->next = -1;
+
+	if (--ent->nbuffers == 0)
+	{
+		Assert(ent->head == -1);
+		hash_search_with_hash_value(SharedBufRelIndex, &rlocator, hashcode,
+									HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(partitionLock);
+}
+
+/*
+ * Append the buffer IDs on the list of *ent to the array *buffers of
+ * *nbuffers entries, which has room for *maxbuffers.
+ */
+static void
+BufRelIndexCollectEntry(BufRelIndexEnt *ent, int **buffers, int *nbuffers,
+						int *maxbuffers)
+{
+	if (*nbuffers + ent->nbuffers > *maxbuffers)
+	{
+		int			newmax = Max(*nbuffers + ent->nbuffers, *maxbuffers * 2);
+
+		*buffers = (int *) repalloc_huge(*buffers, sizeof(int) * newmax);
+		*maxbuffers = newmax;
+	}
+
+	for (int id = ent->head; id >= 0; id = BufRelIndexLinks[id].next)
+		(*buffers)[(*nbuffers)++] = id;
+}
+
+/*
+ * BufRelIndexCollect
+ *		Return the IDs of the buffers currently holding pages of the relation
+ *
+ * The result is a palloc'd array stored into *buffers; the function result
+ * is its length.  The caller must recheck the tag of each buffer under the
+ * buffer header lock, as any of them may have been evicted since.
+ */
+int
+BufRelIndexCollect(const RelFileLocator *rlocator, int **buffers)
+{
+	uint32		hashcode = get_hash_value(SharedBufRelIndex, rlocator);
+	LWLock	   *partitionLock = BufRelIndexPartitionLock(hashcode);
+	BufRelIndexEnt *ent;
+	int			nbuffers = 0;
+	int			maxbuffers = 16;
+
+	*buffers = (int *) palloc(sizeof(int) * maxbuffers);
+
+	LWLockAcquire(partitionLock, LW_SHARED);
+
+	ent = (BufRelIndexEnt *)
+		hash_search_with_hash_value(SharedBufRelIndex, rlocator, hashcode,
+									HASH_FIND, NULL);
+	if (ent)
+		BufRelIndexCollectEntry(ent, buffers, &nbuffers, &maxbuffers);
+
+	LWLockRelease(partitionLock);
+
+	return nbuffers;
+}
+
+/*
+ * BufRelIndexCollectDatabase
+ *		Like BufRelIndexCollect, for all relations of a database
+ *
+ * This needs to look at every relation in the index, but that's still far
+ * fewer than the buffers in a large buffer pool.
+ */
+int
+BufRelIndexCollectDatabase(Oid dbid, int **buffers)
+{
+	HASH_SEQ_STATUS status;
+	BufRelIndexEnt *ent;
+	int			nbuffers = 0;
+	int			maxbuffers = 16;
+
+	*buffers = (int *) palloc(sizeof(int) * maxbuffers);
+
+	/* a consistent scan of the hashtable needs all partition locks */
+	for (int i = 0; i < NUM_BUF_REL_INDEX_PARTITIONS; i++)
+		LWLockAcquire(&BufRelIndexLocks[i].lock, LW_SHARED);
+
+	hash_seq_init(&status, SharedBufRelIndex);
+	while ((ent = (BufRelIndexEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (ent->key.dbOid == dbid)
+			BufRelIndexCollectEntry(ent, buffers, &nbuffers, &maxbuffers);
+	}
+
+	for (int i = NUM_BUF_REL_INDEX_PARTITIONS; --i >= 0;)
+		LWLockRelease(&BufRelIndexLocks[i].lock);
+
+	return nbuffers;
+}
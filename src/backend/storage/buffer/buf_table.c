@@ -9,6 +9,21 @@
  * in most cases the caller needs to adjust the buffer header contents
  * before the lock is released (see notes in README).
  *
+ * The table is an open-addressing hash table with linear probing, split
+ * into one fixed-size region of slots per BufMappingLock partition; a tag
+ * is only ever placed within its partition's region.  That way inserting
+ * and deleting under a partition lock never touches slots that other
+ * partitions' writers might be changing, and the table never needs to grow
+ * or allocate.  Deletion moves later entries of the probe sequence back
+ * into the freed slot (rather than leaving tombstones), so lookups never
+ * slow down as the table ages.
+ *
+ * Because slots are only ever overwritten in place, the table can also be
+ * probed without any lock, see BufTableLookupLockless().  Such a lookup
+ * can be wrong, in both directions, if it races with changes in the
+ * partition, so the caller has to verify the result against the buffer
+ * header once the buffer is pinned, and retry with the lock on a miss.
+ *
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -21,18 +36,43 @@
  */
 #include "postgres.h"
 
+#include "common/hashfn.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 
-/* entry for buffer lookup hashtable */
-typedef struct
+/* slot of the buffer lookup table */
+typedef struct BufferLookupEnt
 {
 	BufferTag	key;			/* Tag of a disk page */
-	int			id;				/* Associated buffer ID */
+	uint32		hashcode;		/* hash of key, to skip most key compares */
+	int			id;				/* Associated buffer ID, or -1 if empty */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+static BufferLookupEnt *SharedBufTable;
+
+/* number of slots per partition; a power of 2 */
+static uint32 BufTablePartitionSlots;
+
+/*
+ * Number of slots per partition needed for a table of the given size.
+ *
+ * Aim for a load factor well below 2/3, where linear probing starts to
+ * suffer, with some headroom for entries not spreading evenly over the
+ * partitions.  But never more than enough for all entries to end up in one
+ * partition, which is what small tables get.
+ */
+static uint32
+BufTableSlotsPerPartition(int size)
+{
+	uint32		nslots;
+
+	nslots = (size / NUM_BUFFER_PARTITIONS) * 3 / 2 + 64;
+	nslots = Min(nslots, (uint32) size + 1);
 
+	return pg_nextpower2_32(nslots);
+}
 
 /*
  * Estimate space needed for mapping hashtable
@@ -41,7 +81,9 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	return mul_size(sizeof(BufferLookupEnt),
+					mul_size(NUM_BUFFER_PARTITIONS,
+							 BufTableSlotsPerPartition(size)));
 }
 
 /*
@@ -51,19 +93,42 @@ BufTableShmemSize(int size)
 void // 初始化数据页查找的哈希表，这个哈希表根据BufferTag找到数据页的编号
 InitBufTable(int size)
 {
-	HASHCTL		info;
+	bool		found;
 
 	/* assume no locking is needed yet */
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt); // K是tag, V是一个整型，表示数据页的编号
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	BufTablePartitionSlots = BufTableSlotsPerPartition(size);
+
+	SharedBufTable = (BufferLookupEnt *)
+		ShmemInitStruct("Shared Buffer Lookup Table",
+						BufTableShmemSize(size),
+						&found);
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+	if (!found)
+	{
+		Size		nslots = (Size) NUM_BUFFER_PARTITIONS * BufTablePartitionSlots;
+
+		for (Size i = 0; i < nslots; i++)
+			SharedBufTable[i].id = -1;
+	}
+}
+
+/* first slot of the region for the hash code's partition */
+static inline BufferLookupEnt *
+BufTablePartitionStart(uint32 hashcode)
+{
+	return &SharedBufTable[(Size) BufTableHashPartition(hashcode) *
+						   BufTablePartitionSlots];
+}
+
+/*
+ * Preferred slot within the partition.  The partition number is taken from
+ * the low-order bits of the hash code, so use the others here.
+ */
+static inline uint32
+BufTableHomeSlot(uint32 hashcode)
+{
+	return (hashcode / NUM_BUFFER_PARTITIONS) & (BufTablePartitionSlots - 1);
 }
 
 /*
@@ -78,7 +143,7 @@ InitBufTable(int size)
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr); // 计算哈希值，每个哈希表都包含一个计算哈希值的函数，就是利用这个函数来进行计算
+	return tag_hash(tagPtr, sizeof(BufferTag));
 }
 
 /*
@@ -90,19 +155,71 @@ BufTableHashCode(BufferTag *tagPtr)
 int // 根据tag的值在哈希表中快速搜索这个数据页，如果没有找到，就返回-1
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *part = BufTablePartitionStart(hashcode);
+	uint32		mask = BufTablePartitionSlots - 1;
+	uint32		i = BufTableHomeSlot(hashcode);
+
+	for (uint32 n = 0; n < BufTablePartitionSlots; n++, i = (i + 1) & mask)
+	{
+		BufferLookupEnt *ent = &part[i];
+
+		if (ent->id < 0)
+			break;
+		if (ent->hashcode == hashcode && BufferTagsEqual(&ent->key, tagPtr))
+			return ent->id;
+	}
+
+	return -1;
+}
+
+/*
+ * BufTableLookupLockless
+ *		Like BufTableLookup, without holding the BufMappingLock
+ *
+ * The result is only a hint: if an entry is being moved concurrently, it can
+ * be missed, and the buffer ID returned may be stale or belong to another
+ * entry.  The caller must pin the buffer and check its tag before trusting
+ * it, and fall back to BufTableLookup() under the lock if that fails or
+ * nothing is found.
+ */
+int
+BufTableLookupLockless(BufferTag *tagPtr, uint32 hashcode)
+{
+	BufferLookupEnt *part = BufTablePartitionStart(hashcode);
+	uint32		mask = BufTablePartitionSlots - 1;
+	uint32		i = BufTableHomeSlot(hashcode);
+
+	for (uint32 n = 0; n < BufTablePartitionSlots; n++, i = (i + 1) & mask)
+	{
+		volatile BufferLookupEnt *ent = &part[i];
+		int			id = ent->id;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+		if (id < 0)
+			break;
 
-	if (!result)
-		return -1;
+		/* pairs with the write barrier in BufTableSetSlot() */
+		pg_read_barrier();
 
-	return result->id;
+		if (ent->hashcode == hashcode &&
+			BufferTagsEqual((BufferTag *) &ent->key, tagPtr))
+			return id;
+	}
+
+	return -1;
+}
+
+/*
+ * Fill a slot, in an order that lockless readers can cope with: a reader
+ * that sees the new ID also sees at least the new key.
+ */
+static inline void
+BufTableSetSlot(BufferLookupEnt *ent, BufferTag *tagPtr, uint32 hashcode,
+				int buf_id)
+{
+	ent->key = *tagPtr;
+	ent->hashcode = hashcode;
+	pg_write_barrier();
+	ent->id = buf_id;
 }
 
 /*
@@ -118,25 +235,31 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 int // 返回值-1表示没有找到，就把这一个数据页的tag插入到哈希表中。如果返回的不是-1，说明这个数据页以前已经插入到这个哈希表中了
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	BufferLookupEnt *part = BufTablePartitionStart(hashcode);
+	uint32		mask = BufTablePartitionSlots - 1;
+	uint32		i = BufTableHomeSlot(hashcode);
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
-
-	if (found)					/* found something already in the table */
-		return result->id;
+	for (uint32 n = 0; n < BufTablePartitionSlots; n++, i = (i + 1) & mask)
+	{
+		BufferLookupEnt *ent = &part[i];
 
-	result->id = buf_id;
+		if (ent->id < 0)
+		{
+			BufTableSetSlot(ent, tagPtr, hashcode, buf_id);
+			return -1;
+		}
+		if (ent->hashcode == hashcode && BufferTagsEqual(&ent->key, tagPtr))
+			return ent->id;		/* found something already in the table */
+	}
 
-	return -1;
+	/* shouldn't happen, the table is sized generously */
+	ereport(ERROR,
+			(errcode(ERRCODE_OUT_OF_MEMORY),
+			 errmsg("out of slots in shared buffer lookup table partition")));
+	return -1;					/* keep compiler quiet */
 }
 
 /*
@@ -148,15 +271,44 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void // 从哈希表中删除某一个元素，如果没有找到，说明这个哈希表的内容损坏了
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *part = BufTablePartitionStart(hashcode);
+	uint32		mask = BufTablePartitionSlots - 1;
+	uint32		hole = BufTableHomeSlot(hashcode);
+	uint32		n;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+	for (n = 0; n < BufTablePartitionSlots; n++, hole = (hole + 1) & mask)
+	{
+		BufferLookupEnt *ent = &part[hole];
 
-	if (!result)				/* shouldn't happen */
+		if (ent->id < 0)
+			n = BufTablePartitionSlots;
+		else if (ent->hashcode == hashcode && BufferTagsEqual(&ent->key, tagPtr))
+			break;
+	}
+	if (n >= BufTablePartitionSlots)	/* shouldn't happen */
 		elog(ERROR, "shared buffer hash table corrupted");
+
+	/*
+	 * Close the gap: walk the rest of the probe sequence, moving back into
+	 * the hole each entry whose home slot is not between the hole and its
+	 * current position (cyclically), as it could otherwise no longer be
+	 * found.  The moved entry then leaves a new hole.
+	 */
+	for (uint32 j = (hole + 1) & mask; j != hole; j = (j + 1) & mask)
+	{
+		BufferLookupEnt *ent = &part[j];
+		uint32		home;
+
+		if (ent->id < 0)
+			break;
+
+		home = BufTableHomeSlot(ent->hashcode);
+		if (hole <= j ? (home <= hole || home > j) : (home <= hole && home > j))
+		{
+			BufTableSetSlot(&part[hole], &ent->key, ent->hashcode, ent->id);
+			hole = j;
+		}
+	}
+
+	part[hole].id = -1;
 }
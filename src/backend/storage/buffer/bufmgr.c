@@ -53,6 +53,7 @@
 #include "storage/smgr.h"
 #include "storage/standby.h"
 #include "utils/memdebug.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
@@ -71,11 +72,9 @@
 #define BUF_WRITTEN				0x01
 #define BUF_REUSABLE			0x02
 
-#define RELS_BSEARCH_THRESHOLD		20
-
 /*
- * This is the size (in the number of blocks) above which we scan the
- * entire buffer pool to remove the buffers for all the pages of relation
+ * This is the size (in the number of blocks) above which we walk the
+ * relation index to remove the buffers for all the pages of relation
  * being dropped. For the relations with size below this threshold, we find
  * the buffers by doing lookups in BufMapping table.
  */
@@ -118,19 +117,6 @@ typedef struct CkptTsStatus
 	int			index;
 } CkptTsStatus;
 
-/*
- * Type for array used to sort SMgrRelations
- *
- * FlushRelationsAllBuffers shares the same comparator function with
- * DropRelationsAllBuffers. Pointer to this struct and RelFileLocator must be
- * compatible.
- */
-typedef struct SMgrSortArray
-{
-	RelFileLocator rlocator;	/* This must be the first member */
-	SMgrRelation srel;
-} SMgrSortArray;
-
 /* GUC variables */
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
@@ -152,6 +138,12 @@ int			effective_io_concurrency = DEFAULT_EFFECTIVE_IO_CONCURRENCY;
  */
 int			maintenance_io_concurrency = DEFAULT_MAINTENANCE_IO_CONCURRENCY;
 
+/*
+ * Limit on how many adjacent blocks StartReadBuffers() may combine into a single
+ * vectored read.
+ */
+int			io_combine_limit = DEFAULT_IO_COMBINE_LIMIT;
+
 /*
  * GUC variables about triggering kernel writeback for buffers written; OS
  * dependent defaults are set via the GUC mechanism.
@@ -451,6 +443,10 @@ static Buffer ReadBuffer_common(SMgrRelation smgr, char relpersistence,
 								ForkNumber forkNum, BlockNumber blockNum,
 								ReadBufferMode mode, BufferAccessStrategy strategy,
 								bool *hit);
+static void ReadBuffersRun(SMgrRelation smgr, ForkNumber forkNum,
+						   BlockNumber blockNum, BufferDesc **run, int nrun,
+						   bool isLocalBuf, IOObject io_object,
+						   IOContext io_context);
 static BlockNumber ExtendBufferedRelCommon(BufferManagerRelation bmr,
 										   ForkNumber fork,
 										   BufferAccessStrategy strategy,
@@ -474,10 +470,13 @@ static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
 						  WritebackContext *wb_context);
+static int	SyncBufferRun(CkptSortItem *items, int nitems,
+						  WritebackContext *wb_context, int *nwritten);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
+static bool ConditionalStartBufferIO(BufferDesc *buf);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
-							  uint32 set_flag_bits);
+							  uint32 set_flag_bits, bool forget_owner);
 static void shared_buffer_write_error_callback(void *arg);
 static void local_buffer_write_error_callback(void *arg);
 static BufferDesc *BufferAlloc(SMgrRelation smgr,
@@ -487,6 +486,7 @@ static BufferDesc *BufferAlloc(SMgrRelation smgr,
 							   BufferAccessStrategy strategy,
 							   bool *foundPtr, IOContext io_context);
 static Buffer GetVictimBuffer(BufferAccessStrategy strategy, IOContext io_context);
+static void LimitAdditionalPins(uint32 *additional_pins);
 static void FlushBuffer(BufferDesc *buf, SMgrRelation reln,
 						IOObject io_object, IOContext io_context);
 static void FindAndDropRelationBuffers(RelFileLocator rlocator,
@@ -505,17 +505,19 @@ static int	ts_ckpt_progress_comparator(Datum a, Datum b, void *arg);
 
 
 /*
- * Implementation of PrefetchBuffer() for shared buffers.
+ * PeekSharedBuffer -- find out which shared buffer holds a block, if any
+ *
+ * Returns InvalidBuffer if the block is not in the buffer pool.  The buffer
+ * is not pinned, so the result is only a hint that may be passed to
+ * ReadRecentBuffer(); it must be rechecked!
  */
-PrefetchBufferResult
-PrefetchSharedBuffer(SMgrRelation smgr_reln,
-					 ForkNumber forkNum,
-					 BlockNumber blockNum)
+Buffer
+PeekSharedBuffer(SMgrRelation smgr_reln,
+				 ForkNumber forkNum,
+				 BlockNumber blockNum)
 {
-	PrefetchBufferResult result = {InvalidBuffer, false};
 	BufferTag	newTag;			/* identity of requested block */
 	uint32		newHash;		/* hash value for newTag */
-	LWLock	   *newPartitionLock;	/* buffer partition lock for it */
 	int			buf_id;
 
 	Assert(BlockNumberIsValid(blockNum));
@@ -524,17 +526,31 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 	InitBufferTag(&newTag, &smgr_reln->smgr_rlocator.locator,
 				  forkNum, blockNum);
 
-	/* determine its hash code and partition lock ID */
+	/* determine its hash code */
 	newHash = BufTableHashCode(&newTag);
-	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
-	LWLockRelease(newPartitionLock);
+	/* no need for the mapping lock, as the answer is only a hint */
+	buf_id = BufTableLookupLockless(&newTag, newHash);
+
+	return buf_id < 0 ? InvalidBuffer : buf_id + 1;
+}
+
+/*
+ * Implementation of PrefetchBuffer() for shared buffers.
+ */
+PrefetchBufferResult
+PrefetchSharedBuffer(SMgrRelation smgr_reln,
+					 ForkNumber forkNum,
+					 BlockNumber blockNum)
+{
+	PrefetchBufferResult result = {InvalidBuffer, false};
+	Buffer		recent_buffer;
+
+	/* See if the block is in the buffer pool already. */
+	recent_buffer = PeekSharedBuffer(smgr_reln, forkNum, blockNum);
 
 	/* If not in buffers, initiate prefetch */
-	if (buf_id < 0)
+	if (!BufferIsValid(recent_buffer))
 	{
 #ifdef USE_PREFETCH
 		/*
@@ -542,7 +558,7 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 		 * recovery if the relation file doesn't exist.
 		 */
 		if ((io_direct_flags & IO_DIRECT_DATA) == 0 &&
-			smgrprefetch(smgr_reln, forkNum, blockNum))
+			smgrprefetch(smgr_reln, forkNum, blockNum, 1))
 		{
 			result.initiated_io = true;
 		}
@@ -555,7 +571,7 @@ PrefetchSharedBuffer(SMgrRelation smgr_reln,
 		 * to avoid a buffer table lookup, but it's not pinned and it must be
 		 * rechecked!
 		 */
-		result.recent_buffer = buf_id + 1;
+		result.recent_buffer = recent_buffer;
 	}
 
 	/*
@@ -805,6 +821,318 @@ ReadBufferWithoutRelcache(RelFileLocator rlocator, ForkNumber forkNum,
 							 mode, strategy, &hit);
 }
 
+/*
+ * StartReadBuffers -- begin reading a run of consecutive blocks
+ *
+ * Pins the buffers for blocks blocknum .. blocknum + *nblocks - 1 of
+ * operation->forknum, storing them in buffers[].  The caller must have
+ * filled in operation->smgr (or operation->rel), persistence, forknum and
+ * strategy; the rest of the struct is private to bufmgr.c.
+ *
+ * *nblocks may be reduced to avoid running out of pins, or because a block
+ * that is already cached interrupts the run:
+ *
+ * - If the first block is already valid, it is the only one pinned, *nblocks
+ *	 is set to 1 and false is returned.  Nothing more needs to be done.
+ *
+ * - Otherwise the pinned blocks are all ones that were not valid when we
+ *	 looked, and true is returned.  The caller must then call
+ *	 WaitReadBuffers() before looking at any of them.
+ *
+ * With asynchronous I/O, the read is started here and completes in the
+ * background until WaitReadBuffers() is called.  Without it, the read is
+ * performed by WaitReadBuffers(), and if READ_BUFFERS_ISSUE_ADVICE is passed
+ * in flags, the kernel is told about it here so that it can get started.
+ *
+ * The caller must call WaitReadBuffers() before releasing the pins, even if
+ * it's no longer interested in the data.
+ */
+bool
+StartReadBuffers(ReadBuffersOperation *operation, Buffer *buffers,
+				 BlockNumber blocknum, int *nblocks, int flags)
+{
+	BufferDesc *run[MAX_IO_COMBINE_LIMIT];
+	uint32		additional_pins;
+	IOContext	io_context;
+	IOObject	io_object;
+	bool		isLocalBuf;
+	int			nrun = 0;
+
+	Assert(*nblocks >= 1 && *nblocks <= MAX_IO_COMBINE_LIMIT);
+
+	if (operation->smgr == NULL)
+	{
+		/* See ReadBufferExtended() */
+		if (RELATION_IS_OTHER_TEMP(operation->rel))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot access temporary tables of other sessions")));
+
+		operation->smgr = RelationGetSmgr(operation->rel);
+		operation->persistence = operation->rel->rd_rel->relpersistence;
+	}
+	isLocalBuf = SmgrIsTemp(operation->smgr);
+
+	/* Don't let a single call pin an unreasonable share of the pool. */
+	additional_pins = *nblocks - 1;
+	if (isLocalBuf)
+		LimitAdditionalLocalPins(&additional_pins);
+	else
+		LimitAdditionalPins(&additional_pins);
+
+	/* A vectored read can't cross a segment boundary. */
+	*nblocks = Min(additional_pins + 1,
+				   smgrmaxcombine(operation->smgr, operation->forknum,
+								  blocknum));
+
+	if (isLocalBuf)
+	{
+		/* See ReadBuffer_common() for why we don't use the strategy here. */
+		io_context = IOCONTEXT_NORMAL;
+		io_object = IOOBJECT_TEMP_RELATION;
+	}
+	else
+	{
+		io_context = IOContextForStrategy(operation->strategy);
+		io_object = IOOBJECT_RELATION;
+	}
+
+	for (int i = 0; i < *nblocks; i++)
+	{
+		BlockNumber blkno = blocknum + i;
+		BufferDesc *bufHdr;
+		bool		found;
+
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		TRACE_POSTGRESQL_BUFFER_READ_START(operation->forknum, blkno,
+										   operation->smgr->smgr_rlocator.locator.spcOid,
+										   operation->smgr->smgr_rlocator.locator.dbOid,
+										   operation->smgr->smgr_rlocator.locator.relNumber,
+										   operation->smgr->smgr_rlocator.backend);
+
+		if (isLocalBuf)
+			bufHdr = LocalBufferAlloc(operation->smgr, operation->forknum,
+									  blkno, &found);
+		else
+			bufHdr = BufferAlloc(operation->smgr, operation->persistence,
+								 operation->forknum, blkno,
+								 operation->strategy, &found, io_context);
+
+		if (found && i > 0)
+		{
+			/*
+			 * A hit ends the run of misses.  Give the buffer back; the caller
+			 * will find it again in a later call.
+			 */
+			ReleaseBuffer(BufferDescriptorGetBuffer(bufHdr));
+			*nblocks = i;
+			break;
+		}
+
+		buffers[i] = BufferDescriptorGetBuffer(bufHdr);
+
+		if (found)
+		{
+			if (isLocalBuf)
+				pgBufferUsage.local_blks_hit++;
+			else
+				pgBufferUsage.shared_blks_hit++;
+			VacuumPageHit++;
+			pgstat_count_io_op(io_object, io_context, IOOP_HIT);
+
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+
+			if (operation->rel)
+			{
+				pgstat_count_buffer_read(operation->rel);
+				pgstat_count_buffer_hit(operation->rel);
+			}
+
+			TRACE_POSTGRESQL_BUFFER_READ_DONE(operation->forknum, blkno,
+											  operation->smgr->smgr_rlocator.locator.spcOid,
+											  operation->smgr->smgr_rlocator.locator.dbOid,
+											  operation->smgr->smgr_rlocator.locator.relNumber,
+											  operation->smgr->smgr_rlocator.backend,
+											  true);
+
+			*nblocks = 1;
+			return false;
+		}
+
+		if (isLocalBuf)
+			pgBufferUsage.local_blks_read++;
+		else
+			pgBufferUsage.shared_blks_read++;
+		if (operation->rel)
+			pgstat_count_buffer_read(operation->rel);
+
+		run[nrun++] = bufHdr;
+	}
+
+	operation->buffers = buffers;
+	operation->blocknum = blocknum;
+	operation->nblocks = *nblocks;
+	operation->flags = flags;
+	operation->io_wref.aio_index = -1;
+
+	/*
+	 * BufferAlloc() has marked the shared buffers as having I/O in progress.
+	 * If we can start the read asynchronously, it stays that way until the
+	 * completion callback clears it, in whichever process that happens to
+	 * run, so the resource owner must forget about it once the read has been
+	 * started.
+	 */
+	if (!isLocalBuf && pgaio_enabled())
+	{
+		PgAioHandle *ioh = pgaio_io_acquire();
+		void	   *blocks[MAX_IO_COMBINE_LIMIT];
+		int			aio_index = pgaio_io_get_index(ioh);
+
+		pgaio_io_get_wref(ioh, &operation->io_wref);
+		pgaio_io_set_callback(ioh, PGAIO_CB_SHARED_BUFFER_READV);
+		pgaio_io_set_buffers(ioh, buffers, nrun);
+
+		for (int i = 0; i < nrun; i++)
+		{
+			uint32		buf_state;
+
+			/* let WaitIO() in other backends know what to wait for */
+			buf_state = LockBufHdr(run[i]);
+			run[i]->io_handle = aio_index;
+			UnlockBufHdr(run[i], buf_state);
+
+			blocks[i] = BufHdrGetBlock(run[i]);
+		}
+
+		smgrstartreadv(ioh, operation->smgr, operation->forknum, blocknum,
+					   blocks, nrun);
+
+		for (int i = 0; i < nrun; i++)
+			ResourceOwnerForgetBufferIO(CurrentResourceOwner, buffers[i]);
+
+		return true;
+	}
+
+	/*
+	 * Otherwise the read will be done by WaitReadBuffers().  Don't keep the
+	 * buffers marked as having I/O in progress until then: the caller may
+	 * want to do other things first, including waiting for I/O on other
+	 * buffers, and a backend wanting one of these blocks might be waiting
+	 * for us in turn.
+	 */
+	if (!isLocalBuf)
+	{
+		for (int i = 0; i < nrun; i++)
+			TerminateBufferIO(run[i], false, 0, true);
+	}
+
+	if (flags & READ_BUFFERS_ISSUE_ADVICE)
+		smgrprefetch(operation->smgr, operation->forknum, blocknum, nrun);
+
+	return true;
+}
+
+/*
+ * WaitReadBuffers -- finish a read begun by StartReadBuffers()
+ *
+ * On return, all the buffers pinned by StartReadBuffers() are valid.  Errors
+ * are reported here rather than in the completion callback, which may have
+ * run in another process; to get a single place that does that, any block
+ * whose asynchronous read failed is simply read again synchronously.
+ */
+void
+WaitReadBuffers(ReadBuffersOperation *operation)
+{
+	BufferDesc *run[MAX_IO_COMBINE_LIMIT];
+	BlockNumber run_start = InvalidBlockNumber;
+	int			nrun = 0;
+	IOContext	io_context;
+	IOObject	io_object;
+	bool		isLocalBuf = SmgrIsTemp(operation->smgr);
+
+	if (isLocalBuf)
+	{
+		io_context = IOCONTEXT_NORMAL;
+		io_object = IOOBJECT_TEMP_RELATION;
+	}
+	else
+	{
+		io_context = IOContextForStrategy(operation->strategy);
+		io_object = IOOBJECT_RELATION;
+	}
+
+	if (operation->io_wref.aio_index >= 0)
+	{
+		instr_time	io_start = pgstat_prepare_io_time();
+
+		pgaio_wref_wait(&operation->io_wref);
+		operation->io_wref.aio_index = -1;
+
+		pgstat_count_io_op_time(io_object, io_context, IOOP_READ,
+								operation->smgr->smgr_rlocator.locator.spcOid,
+								io_start, operation->nblocks);
+	}
+
+	for (int i = 0; i < operation->nblocks; i++)
+	{
+		BlockNumber blkno = operation->blocknum + i;
+		BufferDesc *bufHdr;
+		bool		need_io;
+
+		if (isLocalBuf)
+		{
+			bufHdr = GetLocalBufferDescriptor(-operation->buffers[i] - 1);
+			need_io = !(pg_atomic_read_u32(&bufHdr->state) & BM_VALID);
+		}
+		else
+		{
+			/*
+			 * This waits for anyone else who is reading the block, including
+			 * the completion of our own asynchronous read if someone else
+			 * collected it.  Runs are built in ascending block order, so we
+			 * never wait for a block below one we hold I/O in progress on.
+			 */
+			bufHdr = GetBufferDescriptor(operation->buffers[i] - 1);
+			need_io = StartBufferIO(bufHdr, true);
+		}
+
+		if (need_io)
+		{
+			if (nrun == 0)
+				run_start = blkno;
+			Assert(run_start + nrun == blkno);
+			run[nrun++] = bufHdr;
+			continue;
+		}
+
+		/* Valid already, so it ends the current run, if any. */
+		if (nrun > 0)
+		{
+			ReadBuffersRun(operation->smgr, operation->forknum, run_start,
+						   run, nrun, isLocalBuf, io_object, io_context);
+			nrun = 0;
+		}
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(operation->forknum, blkno,
+										  operation->smgr->smgr_rlocator.locator.spcOid,
+										  operation->smgr->smgr_rlocator.locator.dbOid,
+										  operation->smgr->smgr_rlocator.locator.relNumber,
+										  operation->smgr->smgr_rlocator.backend,
+										  false);
+	}
+
+	if (nrun > 0)
+		ReadBuffersRun(operation->smgr, operation->forknum, run_start,
+					   run, nrun, isLocalBuf, io_object, io_context);
+}
+
 /*
  * Convenience wrapper around ExtendBufferedRelBy() extending by one block.
  */
@@ -1123,8 +1451,9 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 		smgrread(smgr, forkNum, blockNum, bufBlock);
 
-		pgstat_count_io_op_time(io_object, io_context,
-								IOOP_READ, io_start, 1);
+		pgstat_count_io_op_time(io_object, io_context, IOOP_READ,
+								smgr->smgr_rlocator.locator.spcOid,
+								io_start, 1);
 
 		/* check for garbage data */
 		if (!PageIsVerifiedExtended((Page) bufBlock, blockNum,
@@ -1176,7 +1505,7 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	else
 	{
 		/* Set BM_VALID, terminate IO, and wake up any waiters */
-		TerminateBufferIO(bufHdr, false, BM_VALID);
+		TerminateBufferIO(bufHdr, false, BM_VALID, true);
 	}
 
 	VacuumPageMiss++;
@@ -1193,6 +1522,155 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	return BufferDescriptorGetBuffer(bufHdr);
 }
 
+/*
+ * ReadBuffersRun -- read a run of adjacent blocks into the given buffers
+ *
+ * The buffers must already be pinned and tagged with blocks blockNum ..
+ * blockNum + nrun - 1, and (for shared buffers) have I/O in progress.  On
+ * return, all of them are valid.
+ */
+static void
+ReadBuffersRun(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
+			   BufferDesc **run, int nrun, bool isLocalBuf,
+			   IOObject io_object, IOContext io_context)
+{
+	void	   *blocks[MAX_IO_COMBINE_LIMIT];
+	instr_time	io_start;
+
+	Assert(nrun >= 1 && nrun <= MAX_IO_COMBINE_LIMIT);
+
+	for (int i = 0; i < nrun; i++)
+	{
+		Assert(!(pg_atomic_read_u32(&run[i]->state) & BM_VALID));
+
+		blocks[i] = isLocalBuf ? LocalBufHdrGetBlock(run[i]) :
+			BufHdrGetBlock(run[i]);
+	}
+
+	io_start = pgstat_prepare_io_time();
+	smgrreadv(smgr, forkNum, blockNum, blocks, nrun);
+	pgstat_count_io_op_time(io_object, io_context, IOOP_READ,
+							smgr->smgr_rlocator.locator.spcOid, io_start, nrun);
+
+	for (int i = 0; i < nrun; i++)
+	{
+		BlockNumber blkno = blockNum + i;
+		BufferDesc *bufHdr = run[i];
+
+		/* check for garbage data */
+		if (!PageIsVerifiedExtended((Page) blocks[i], blkno,
+									PIV_LOG_WARNING | PIV_REPORT_STAT))
+		{
+			if (zero_damaged_pages)
+			{
+				ereport(WARNING,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s; zeroing out page",
+								blkno,
+								relpath(smgr->smgr_rlocator, forkNum))));
+				MemSet((char *) blocks[i], 0, BLCKSZ);
+			}
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blkno,
+								relpath(smgr->smgr_rlocator, forkNum))));
+		}
+
+		if (isLocalBuf)
+		{
+			/* Only need to adjust flags */
+			uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+			buf_state |= BM_VALID;
+			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+		}
+		else
+		{
+			/* Set BM_VALID, terminate IO, and wake up any waiters */
+			TerminateBufferIO(bufHdr, false, BM_VALID, true);
+		}
+
+		VacuumPageMiss++;
+		if (VacuumCostActive)
+			VacuumCostBalance += VacuumCostPageMiss;
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blkno,
+										  smgr->smgr_rlocator.locator.spcOid,
+										  smgr->smgr_rlocator.locator.dbOid,
+										  smgr->smgr_rlocator.locator.relNumber,
+										  smgr->smgr_rlocator.backend,
+										  false);
+	}
+}
+
+/*
+ * shared_buffer_readv_complete -- completion callback for StartReadBuffers()
+ *
+ * Runs in whichever process collects the completion, possibly not the one
+ * that started the read, so it must not throw errors.  Buffers whose data
+ * didn't arrive or doesn't pass verification are marked BM_IO_ERROR, and
+ * WaitReadBuffers() in the issuing backend reads them again to report the
+ * problem properly.
+ */
+void
+shared_buffer_readv_complete(PgAioHandle *ioh)
+{
+	Buffer	   *buffers;
+	int			nbuffers;
+	int			result;
+
+	nbuffers = pgaio_io_get_buffers(ioh, &buffers);
+	result = pgaio_io_get_result(ioh);
+
+	for (int i = 0; i < nbuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(buffers[i] - 1);
+		bool		ok;
+
+		/* The tag can't change while the buffer is pinned. */
+		ok = result >= (i + 1) * BLCKSZ &&
+			PageIsVerifiedExtended((Page) BufHdrGetBlock(bufHdr),
+								   bufHdr->tag.blockNum, 0);
+
+		TerminateBufferIO(bufHdr, false, ok ? BM_VALID : BM_IO_ERROR, false);
+	}
+}
+
+/*
+ * BufferAllocFound -- subroutine for BufferAlloc, once it has found and
+ *		pinned the buffer already holding the page.
+ *
+ * valid is what PinBuffer() returned.
+ */
+static BufferDesc *
+BufferAllocFound(BufferDesc *buf, bool valid, bool *foundPtr)
+{
+	*foundPtr = true;
+
+	if (!valid)
+	{
+		/*
+		 * We can only get here if (a) someone else is still reading in the
+		 * page, or (b) a previous read attempt failed.  We have to wait for
+		 * any active read attempt to finish, and then set up our own read
+		 * attempt if the page is still not BM_VALID.  StartBufferIO does it
+		 * all.
+		 */
+		if (StartBufferIO(buf, true))
+		{
+			/*
+			 * If we get here, previous attempts to read the buffer must have
+			 * failed ... but we shall bravely try again.
+			 */
+			*foundPtr = false;
+		}
+	}
+
+	return buf;
+}
+
 /*
  * BufferAlloc -- subroutine for ReadBuffer.  Handles lookup of a shared
  *		buffer.  If no buffer exists already, selects a replacement
@@ -1237,7 +1715,37 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag); // 计算哈希值，应该可以加速查找
 	newPartitionLock = BufMappingPartitionLock(newHash); // 根据哈希值找到对应的分区。共享内存中的哈希表要分区，减少冲突的可能性
 
-	/* see if the block is in the buffer pool already */
+	/*
+	 * See if the block is in the buffer pool already.  As that's the common
+	 * case, first try without taking the mapping lock.  The lockless lookup
+	 * can return the wrong buffer if it races with changes to the mapping,
+	 * but once pinned, a buffer can't be given to another page behind our
+	 * back, so we can check it's the right one afterwards.
+	 */
+	existing_buf_id = BufTableLookupLockless(&newTag, newHash);
+	if (existing_buf_id >= 0)
+	{
+		BufferDesc *buf;
+		bool		valid;
+		uint32		buf_state;
+		bool		match;
+
+		buf = GetBufferDescriptor(existing_buf_id);
+
+		valid = PinBuffer(buf, strategy);
+
+		buf_state = LockBufHdr(buf);
+		match = (buf_state & BM_TAG_VALID) &&
+			BufferTagsEqual(&buf->tag, &newTag);
+		UnlockBufHdr(buf, buf_state);
+
+		if (match)
+			return BufferAllocFound(buf, valid, foundPtr);
+
+		/* lost a race, do it the slow way */
+		UnpinBuffer(buf);
+	}
+
 	LWLockAcquire(newPartitionLock, LW_SHARED);
 	existing_buf_id = BufTableLookup(&newTag, newHash);
 	if (existing_buf_id >= 0) // 找到这个数据页了
@@ -1257,28 +1765,7 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
 
-		*foundPtr = true;
-
-		if (!valid)
-		{
-			/*
-			 * We can only get here if (a) someone else is still reading in
-			 * the page, or (b) a previous read attempt failed.  We have to
-			 * wait for any active read attempt to finish, and then set up our
-			 * own read attempt if the page is still not BM_VALID.
-			 * StartBufferIO does it all.
-			 */
-			if (StartBufferIO(buf, true))
-			{
-				/*
-				 * If we get here, previous attempts to read the buffer must
-				 * have failed ... but we shall bravely try again.
-				 */
-				*foundPtr = false;
-			}
-		}
-
-		return buf;
+		return BufferAllocFound(buf, valid, foundPtr);
 	}
 	// 没有找到这个数据页，就要初始化一个
 	/*
@@ -1382,6 +1869,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	UnlockBufHdr(victim_buf_hdr, victim_buf_state);
 
+	BufRelIndexAdd(victim_buf_hdr->buf_id, &newTag);
+
 	LWLockRelease(newPartitionLock);
 
 	/*
@@ -1488,10 +1977,14 @@ retry:
 	UnlockBufHdr(buf, buf_state);
 
 	/*
-	 * Remove the buffer from the lookup hashtable, if it was in there.
+	 * Remove the buffer from the lookup hashtable and the relation index, if
+	 * it was in there.
 	 */
 	if (oldFlags & BM_TAG_VALID)
+	{
 		BufTableDelete(&oldTag, oldHash);
+		BufRelIndexRemove(buf->buf_id, &oldTag);
+	}
 
 	/*
 	 * Done with mapping lock.
@@ -1571,6 +2064,7 @@ InvalidateVictimBuffer(BufferDesc *buf_hdr)
 
 	/* finally delete buffer from the buffer mapping table */
 	BufTableDelete(&tag, hash);
+	BufRelIndexRemove(buf_hdr->buf_id, &tag);
 
 	LWLockRelease(partition_lock);
 
@@ -1959,7 +2453,7 @@ ExtendBufferedRelShared(BufferManagerRelation bmr,
 		 * We get here only in the corner case where we are trying to extend
 		 * the relation but we found a pre-existing buffer. This can happen
 		 * because a prior attempt at extending the relation failed, and
-		 * because mdread doesn't complain about reads beyond EOF (when
+		 * because mdreadv doesn't complain about reads beyond EOF (when
 		 * zero_damaged_pages is ON) and so a previous attempt to read a block
 		 * beyond EOF could have left a "valid" zero-filled buffer.
 		 * Unfortunately, we have also seen this case occurring because of
@@ -2035,6 +2529,8 @@ ExtendBufferedRelShared(BufferManagerRelation bmr,
 
 			UnlockBufHdr(victim_buf_hdr, buf_state);
 
+			BufRelIndexAdd(victim_buf_hdr->buf_id, &tag);
+
 			LWLockRelease(partition_lock);
 
 			/* XXX: could combine the locked operations in it with the above */
@@ -2067,6 +2563,7 @@ ExtendBufferedRelShared(BufferManagerRelation bmr,
 		UnlockRelationForExtension(bmr.rel, ExclusiveLock);
 
 	pgstat_count_io_op_time(IOOBJECT_RELATION, io_context, IOOP_EXTEND,
+							bmr.smgr->smgr_rlocator.locator.spcOid,
 							io_start, extend_by);
 
 	/* Set BM_VALID, terminate IO, and wake up any waiters */
@@ -2088,7 +2585,7 @@ ExtendBufferedRelShared(BufferManagerRelation bmr,
 		if (lock)
 			LWLockAcquire(BufferDescriptorGetContentLock(buf_hdr), LW_EXCLUSIVE);
 
-		TerminateBufferIO(buf_hdr, false, BM_VALID);
+		TerminateBufferIO(buf_hdr, false, BM_VALID, true);
 	}
 
 	pgBufferUsage.shared_blks_written += extend_by;
@@ -2667,13 +3164,15 @@ BufferSync(int flags)
 		BufferDesc *bufHdr = NULL;
 		CkptTsStatus *ts_stat = (CkptTsStatus *)
 			DatumGetPointer(binaryheap_first(ts_heap));
+		bool		written = false;
+		int			nprocessed;
 
 		buf_id = CkptBufferIds[ts_stat->index].buf_id;
 		Assert(buf_id != -1);
 
 		bufHdr = GetBufferDescriptor(buf_id);
 
-		num_processed++;
+		nprocessed = 1;
 
 		/*
 		 * We don't need to acquire the lock here, because we're only looking
@@ -2689,21 +3188,55 @@ BufferSync(int flags)
 		 */
 		if (pg_atomic_read_u32(&bufHdr->state) & BM_CHECKPOINT_NEEDED)
 		{
-			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
+			CkptSortItem *item = &CkptBufferIds[ts_stat->index];
+			int			maxrun;
+			int			nrun;
+
+			/*
+			 * Find the run of to-be-checkpointed buffers holding consecutive
+			 * blocks of the same relation fork, which can be written with a
+			 * single vectored write.  The sort order puts them next to each
+			 * other.
+			 */
+			maxrun = Min(io_combine_limit,
+						 ts_stat->num_to_scan - ts_stat->num_scanned);
+			for (nrun = 1; nrun < maxrun; nrun++)
+			{
+				if (item[nrun].relNumber != item[0].relNumber ||
+					item[nrun].forkNum != item[0].forkNum ||
+					item[nrun].blockNum != item[0].blockNum + nrun)
+					break;
+			}
+
+			if (nrun > 1)
+			{
+				int			nwritten;
+
+				nprocessed = SyncBufferRun(item, nrun, &wb_context, &nwritten);
+				for (int j = 0; j < nwritten; j++)
+					TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(item[j].buf_id);
+				PendingCheckpointerStats.buf_written_checkpoints += nwritten;
+				num_written += nwritten;
+				written = (nwritten > 0);
+			}
+			else if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
 			{
 				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
 				PendingCheckpointerStats.buf_written_checkpoints++;
 				num_written++;
+				written = true;
 			}
 		}
 
+		num_processed += nprocessed;
+
 		/*
 		 * Measure progress independent of actually having to flush the buffer
 		 * - otherwise writing become unbalanced.
 		 */
-		ts_stat->progress += ts_stat->progress_slice;
-		ts_stat->num_scanned++;
-		ts_stat->index++;
+		ts_stat->progress += ts_stat->progress_slice * nprocessed;
+		ts_stat->num_scanned += nprocessed;
+		ts_stat->index += nprocessed;
 
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
@@ -2717,11 +3250,13 @@ BufferSync(int flags)
 		}
 
 		/*
-		 * Sleep to throttle our I/O rate.
+		 * Sleep to throttle our I/O rate.  This may also issue the pending
+		 * writebacks.
 		 *
 		 * (This will check for barrier events even if it doesn't sleep.)
 		 */
-		CheckpointWriteDelay(flags, (double) num_processed / num_to_scan);
+		CheckpointWriteDelay(flags, (double) num_processed / num_to_scan,
+							 written, &wb_context);
 	}
 
 	/*
@@ -2743,6 +3278,25 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_scan);
 }
 
+/*
+ * State BgBufferSync() keeps for each clock sweep partition between calls,
+ * so it can determine the advance rate of the partition's strategy point
+ * and avoid scanning already-cleaned buffers.  Buffer positions are
+ * relative to the start of the partition.
+ */
+typedef struct BgSyncPartition
+{
+	int			first_buffer;	/* the partition's range of buffers */
+	int			num_buffers;
+	int			prev_strategy_buf_id;
+	uint32		prev_strategy_passes;
+	int			next_to_clean;
+	uint32		next_passes;
+	/* for the current call: */
+	int			bufs_to_lap;
+	int			reusable_buffers_est;
+} BgSyncPartition;
+
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
  *
@@ -2753,6 +3307,11 @@ BufferSync(int flags)
  * has been "lapped" and no buffer allocations have occurred recently,
  * or if the bgwriter has been effectively disabled by setting
  * bgwriter_lru_maxpages to 0.)
+ *
+ * With a partitioned clock sweep, we keep ahead of each partition's hand
+ * separately, but estimate the allocation rate and the density of reusable
+ * buffers over the whole pool, and divide the buffers to clean between the
+ * partitions in proportion to their size.
  */
 bool
 BgBufferSync(WritebackContext *wb_context)
@@ -2764,13 +3323,11 @@ BgBufferSync(WritebackContext *wb_context)
 
 	/*
 	 * Information saved between calls so we can determine the strategy
-	 * point's advance rate and avoid scanning already-cleaned buffers.
+	 * points' advance rate and avoid scanning already-cleaned buffers.
 	 */
 	static bool saved_info_valid = false;
-	static int	prev_strategy_buf_id;
-	static uint32 prev_strategy_passes;
-	static int	next_to_clean;
-	static uint32 next_passes;
+	static BgSyncPartition *parts = NULL;
+	static int	nparts;
 
 	/* Moving averages of allocation rate and clean-buffer density */
 	static float smoothed_alloc = 0;
@@ -2783,14 +3340,13 @@ BgBufferSync(WritebackContext *wb_context)
 	/* Used to compute how far we scan ahead */
 	long		strategy_delta;
 	int			bufs_to_lap;
-	int			bufs_ahead;
 	float		scans_per_alloc;
 	int			reusable_buffers_est;
 	int			upcoming_alloc_est;
 	int			min_scan_buffers;
 
 	/* Variables for the scanning loop proper */
-	int			num_to_scan;
+	int			num_scanned;
 	int			num_written;
 	int			reusable_buffers;
 
@@ -2798,102 +3354,125 @@ BgBufferSync(WritebackContext *wb_context)
 	long		new_strategy_delta;
 	uint32		new_recent_alloc;
 
-	/*
-	 * Find out where the freelist clock sweep currently is, and how many
-	 * buffer allocations have happened since our last call.
-	 */
-	strategy_buf_id = StrategySyncStart(&strategy_passes, &recent_alloc);
-
-	/* Report buffer alloc counts to pgstat */
-	PendingBgWriterStats.buf_alloc += recent_alloc;
-
-	/*
-	 * If we're not running the LRU scan, just stop after doing the stats
-	 * stuff.  We mark the saved state invalid so that we can recover sanely
-	 * if LRU scan is turned back on later.
-	 */
-	if (bgwriter_lru_maxpages <= 0)
+	if (parts == NULL)
 	{
-		saved_info_valid = false;
-		return true;
+		nparts = StrategySyncPartitions();
+		parts = (BgSyncPartition *)
+			MemoryContextAllocZero(TopMemoryContext,
+								   nparts * sizeof(BgSyncPartition));
 	}
 
 	/*
-	 * Compute strategy_delta = how many buffers have been scanned by the
-	 * clock sweep since last time.  If first time through, assume none. Then
-	 * see if we are still ahead of the clock sweep, and if so, how many
-	 * buffers we could scan before we'd catch up with it and "lap" it. Note:
-	 * weird-looking coding of xxx_passes comparisons are to avoid bogus
+	 * Find out where the freelist clock sweep currently is in each
+	 * partition, and how many buffer allocations have happened since our
+	 * last call.  Compute strategy_delta = how many buffers have been scanned
+	 * by the clock sweep since last time.  If first time through, assume
+	 * none. Then see if we are still ahead of the clock sweep, and if so, how
+	 * many buffers we could scan before we'd catch up with it and "lap" it.
+	 * Note: weird-looking coding of xxx_passes comparisons are to avoid bogus
 	 * behavior when the passes counts wrap around.
 	 */
-	if (saved_info_valid)
+	recent_alloc = 0;
+	strategy_delta = 0;
+	bufs_to_lap = 0;
+	for (int i = 0; i < nparts; i++)
 	{
-		int32		passes_delta = strategy_passes - prev_strategy_passes;
+		BgSyncPartition *part = &parts[i];
+		uint32		part_alloc;
 
-		strategy_delta = strategy_buf_id - prev_strategy_buf_id;
-		strategy_delta += (long) passes_delta * NBuffers;
+		strategy_buf_id = StrategySyncStart(i, &part->first_buffer,
+											&part->num_buffers,
+											&strategy_passes, &part_alloc);
+		recent_alloc += part_alloc;
 
-		Assert(strategy_delta >= 0);
-
-		if ((int32) (next_passes - strategy_passes) > 0)
+		if (saved_info_valid)
 		{
-			/* we're one pass ahead of the strategy point */
-			bufs_to_lap = strategy_buf_id - next_to_clean;
+			int32		passes_delta = strategy_passes - part->prev_strategy_passes;
+			long		part_delta;
+
+			part_delta = strategy_buf_id - part->prev_strategy_buf_id;
+			part_delta += (long) passes_delta * part->num_buffers;
+
+			Assert(part_delta >= 0);
+			strategy_delta += part_delta;
+
+			if ((int32) (part->next_passes - strategy_passes) > 0)
+			{
+				/* we're one pass ahead of the strategy point */
+				part->bufs_to_lap = strategy_buf_id - part->next_to_clean;
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
-				 strategy_passes, strategy_buf_id,
-				 strategy_delta, bufs_to_lap);
+				elog(DEBUG2, "bgwriter ahead: partition %d bgw %u-%u strategy %u-%u delta=%ld lap=%d",
+					 i, part->next_passes, part->next_to_clean,
+					 strategy_passes, strategy_buf_id,
+					 part_delta, part->bufs_to_lap);
 #endif
-		}
-		else if (next_passes == strategy_passes &&
-				 next_to_clean >= strategy_buf_id)
-		{
-			/* on same pass, but ahead or at least not behind */
-			bufs_to_lap = NBuffers - (next_to_clean - strategy_buf_id);
+			}
+			else if (part->next_passes == strategy_passes &&
+					 part->next_to_clean >= strategy_buf_id)
+			{
+				/* on same pass, but ahead or at least not behind */
+				part->bufs_to_lap = part->num_buffers -
+					(part->next_to_clean - strategy_buf_id);
+#ifdef BGW_DEBUG
+				elog(DEBUG2, "bgwriter ahead: partition %d bgw %u-%u strategy %u-%u delta=%ld lap=%d",
+					 i, part->next_passes, part->next_to_clean,
+					 strategy_passes, strategy_buf_id,
+					 part_delta, part->bufs_to_lap);
+#endif
+			}
+			else
+			{
+				/*
+				 * We're behind, so skip forward to the strategy point and
+				 * start cleaning from there.
+				 */
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
-				 strategy_passes, strategy_buf_id,
-				 strategy_delta, bufs_to_lap);
+				elog(DEBUG2, "bgwriter behind: partition %d bgw %u-%u strategy %u-%u delta=%ld",
+					 i, part->next_passes, part->next_to_clean,
+					 strategy_passes, strategy_buf_id,
+					 part_delta);
 #endif
+				part->next_to_clean = strategy_buf_id;
+				part->next_passes = strategy_passes;
+				part->bufs_to_lap = part->num_buffers;
+			}
 		}
 		else
 		{
 			/*
-			 * We're behind, so skip forward to the strategy point and start
-			 * cleaning from there.
+			 * Initializing at startup or after LRU scanning had been off.
+			 * Always start at the strategy point.
 			 */
 #ifdef BGW_DEBUG
-			elog(DEBUG2, "bgwriter behind: bgw %u-%u strategy %u-%u delta=%ld",
-				 next_passes, next_to_clean,
-				 strategy_passes, strategy_buf_id,
-				 strategy_delta);
+			elog(DEBUG2, "bgwriter initializing: partition %d strategy %u-%u",
+				 i, strategy_passes, strategy_buf_id);
 #endif
-			next_to_clean = strategy_buf_id;
-			next_passes = strategy_passes;
-			bufs_to_lap = NBuffers;
+			part->next_to_clean = strategy_buf_id;
+			part->next_passes = strategy_passes;
+			part->bufs_to_lap = part->num_buffers;
 		}
+
+		/* Update saved info for next time */
+		part->prev_strategy_buf_id = strategy_buf_id;
+		part->prev_strategy_passes = strategy_passes;
+
+		bufs_to_lap += part->bufs_to_lap;
 	}
-	else
+
+	/* Report buffer alloc counts to pgstat */
+	PendingBgWriterStats.buf_alloc += recent_alloc;
+
+	/*
+	 * If we're not running the LRU scan, just stop after doing the stats
+	 * stuff.  We mark the saved state invalid so that we can recover sanely
+	 * if LRU scan is turned back on later.
+	 */
+	if (bgwriter_lru_maxpages <= 0)
 	{
-		/*
-		 * Initializing at startup or after LRU scanning had been off. Always
-		 * start at the strategy point.
-		 */
-#ifdef BGW_DEBUG
-		elog(DEBUG2, "bgwriter initializing: strategy %u-%u",
-			 strategy_passes, strategy_buf_id);
-#endif
-		strategy_delta = 0;
-		next_to_clean = strategy_buf_id;
-		next_passes = strategy_passes;
-		bufs_to_lap = NBuffers;
+		saved_info_valid = false;
+		return true;
 	}
 
-	/* Update saved info for next time */
-	prev_strategy_buf_id = strategy_buf_id;
-	prev_strategy_passes = strategy_passes;
 	saved_info_valid = true;
 
 	/*
@@ -2911,11 +3490,18 @@ BgBufferSync(WritebackContext *wb_context)
 
 	/*
 	 * Estimate how many reusable buffers there are between the current
-	 * strategy point and where we've scanned ahead to, based on the smoothed
+	 * strategy points and where we've scanned ahead to, based on the smoothed
 	 * density estimate.
 	 */
-	bufs_ahead = NBuffers - bufs_to_lap;
-	reusable_buffers_est = (float) bufs_ahead / smoothed_density;
+	reusable_buffers_est = 0;
+	for (int i = 0; i < nparts; i++)
+	{
+		BgSyncPartition *part = &parts[i];
+
+		part->reusable_buffers_est =
+			(float) (part->num_buffers - part->bufs_to_lap) / smoothed_density;
+		reusable_buffers_est += part->reusable_buffers_est;
+	}
 
 	/*
 	 * Track a moving average of recent buffer allocations.  Here, rather than
@@ -2964,52 +3550,69 @@ BgBufferSync(WritebackContext *wb_context)
 	}
 
 	/*
-	 * Now write out dirty reusable buffers, working forward from the
-	 * next_to_clean point, until we have lapped the strategy scan, or cleaned
-	 * enough buffers to match our estimate of the next cycle's allocation
-	 * requirements, or hit the bgwriter_lru_maxpages limit.
+	 * Now write out dirty reusable buffers, working forward from each
+	 * partition's next_to_clean point, until we have lapped its strategy
+	 * scan, or cleaned enough buffers to match its share of our estimate of
+	 * the next cycle's allocation requirements, or hit the
+	 * bgwriter_lru_maxpages limit.
 	 */
 
 	/* Make sure we can handle the pin inside SyncOneBuffer */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
 
-	num_to_scan = bufs_to_lap;
+	num_scanned = 0;
 	num_written = 0;
 	reusable_buffers = reusable_buffers_est;
 
 	/* Execute the LRU scan */
-	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
+	for (int i = 0; i < nparts && num_written < bgwriter_lru_maxpages; i++)
 	{
-		int			sync_state = SyncOneBuffer(next_to_clean, true,
-											   wb_context);
+		BgSyncPartition *part = &parts[i];
+		int			num_to_scan = part->bufs_to_lap;
+		int			part_reusable = part->reusable_buffers_est;
+		int			part_alloc_est;
 
-		if (++next_to_clean >= NBuffers)
-		{
-			next_to_clean = 0;
-			next_passes++;
-		}
-		num_to_scan--;
+		part_alloc_est = (int) ((double) upcoming_alloc_est *
+								part->num_buffers / NBuffers + 0.5);
 
-		if (sync_state & BUF_WRITTEN)
+		while (num_to_scan > 0 && part_reusable < part_alloc_est)
 		{
-			reusable_buffers++;
-			if (++num_written >= bgwriter_lru_maxpages)
+			int			sync_state = SyncOneBuffer(part->first_buffer +
+												   part->next_to_clean,
+												   true, wb_context);
+
+			if (++part->next_to_clean >= part->num_buffers)
 			{
-				PendingBgWriterStats.maxwritten_clean++;
-				break;
+				part->next_to_clean = 0;
+				part->next_passes++;
+			}
+			num_to_scan--;
+
+			if (sync_state & BUF_WRITTEN)
+			{
+				part_reusable++;
+				if (++num_written >= bgwriter_lru_maxpages)
+				{
+					PendingBgWriterStats.maxwritten_clean++;
+					break;
+				}
 			}
+			else if (sync_state & BUF_REUSABLE)
+				part_reusable++;
 		}
-		else if (sync_state & BUF_REUSABLE)
-			reusable_buffers++;
+
+		num_scanned += part->bufs_to_lap - num_to_scan;
+		reusable_buffers += part_reusable - part->reusable_buffers_est;
 	}
 
 	PendingBgWriterStats.buf_written_clean += num_written;
+	CountBgWriterWrites(num_written);
 
 #ifdef BGW_DEBUG
 	elog(DEBUG1, "bgwriter: recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
-		 recent_alloc, smoothed_alloc, strategy_delta, bufs_ahead,
+		 recent_alloc, smoothed_alloc, strategy_delta, NBuffers - bufs_to_lap,
 		 smoothed_density, reusable_buffers_est, upcoming_alloc_est,
-		 bufs_to_lap - num_to_scan,
+		 num_scanned,
 		 num_written,
 		 reusable_buffers - reusable_buffers_est);
 #endif
@@ -3022,7 +3625,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 * which is helpful because a long memory isn't as desirable on the
 	 * density estimates.
 	 */
-	new_strategy_delta = bufs_to_lap - num_to_scan;
+	new_strategy_delta = num_scanned;
 	new_recent_alloc = reusable_buffers - reusable_buffers_est;
 	if (new_strategy_delta > 0 && new_recent_alloc > 0)
 	{
@@ -3121,6 +3724,166 @@ SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *wb_context)
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * SyncBufferRun -- write a run of checkpoint buffers with one vectored write.
+ *
+ * items[] are nitems >= 2 entries of CkptBufferIds that were sorted next to
+ * each other and hold consecutive blocks of the same relation fork, as far as
+ * the sort keys can tell.  We write as long a prefix of them as we can in a
+ * single smgrwritev() call.  A buffer that has been written or replaced since
+ * it was marked, whose content lock or I/O is busy, or that doesn't really
+ * belong to the same relation (the sort doesn't look at the database) ends
+ * the run; it is left for the caller's next iteration, which will wait for it
+ * the ordinary way.  If not even the first buffer can be taken without
+ * waiting, it is written with SyncOneBuffer() instead.
+ *
+ * Returns the number of items processed, and sets *nwritten to the number
+ * of buffers written.
+ *
+ * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ */
+static int
+SyncBufferRun(CkptSortItem *items, int nitems, WritebackContext *wb_context,
+			  int *nwritten)
+{
+	static char *staging = NULL;
+	BufferDesc *bufs[MAX_IO_COMBINE_LIMIT];
+	const void *pages[MAX_IO_COMBINE_LIMIT];
+	BufferTag	tag;
+	XLogRecPtr	maxlsn = InvalidXLogRecPtr;
+	ErrorContextCallback errcallback;
+	SMgrRelation reln;
+	instr_time	io_start;
+	int			n;
+
+	Assert(nitems > 1 && nitems <= MAX_IO_COMBINE_LIMIT);
+
+	for (n = 0; n < nitems; n++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(items[n].buf_id);
+		uint32		buf_state;
+
+		if (n > 0)
+			ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		ReservePrivateRefCountEntry();
+
+		buf_state = LockBufHdr(bufHdr);
+		if ((buf_state & (BM_VALID | BM_DIRTY | BM_CHECKPOINT_NEEDED)) !=
+			(BM_VALID | BM_DIRTY | BM_CHECKPOINT_NEEDED) ||
+			(buf_state & BM_IO_IN_PROGRESS))
+		{
+			UnlockBufHdr(bufHdr, buf_state);
+			break;
+		}
+		if (n == 0)
+			tag = bufHdr->tag;
+		else
+		{
+			BufferTag	expected = tag;
+
+			expected.blockNum += n;
+			if (!BufferTagsEqual(&bufHdr->tag, &expected))
+			{
+				UnlockBufHdr(bufHdr, buf_state);
+				break;
+			}
+		}
+		PinBuffer_Locked(bufHdr);
+
+		if (!LWLockConditionalAcquire(BufferDescriptorGetContentLock(bufHdr),
+									  LW_SHARED))
+		{
+			UnpinBuffer(bufHdr);
+			break;
+		}
+		if (!ConditionalStartBufferIO(bufHdr))
+		{
+			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+			UnpinBuffer(bufHdr);
+			break;
+		}
+
+		/* as in FlushBuffer */
+		buf_state = LockBufHdr(bufHdr);
+		if ((buf_state & BM_PERMANENT) && BufferGetLSN(bufHdr) > maxlsn)
+			maxlsn = BufferGetLSN(bufHdr);
+		buf_state &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(bufHdr, buf_state);
+
+		bufs[n] = bufHdr;
+	}
+
+	if (n == 0)
+	{
+		*nwritten = (SyncOneBuffer(items[0].buf_id, false, wb_context) &
+					 BUF_WRITTEN) ? 1 : 0;
+		return 1;
+	}
+
+	/* Setup error traceback support for ereport() */
+	errcallback.callback = shared_buffer_write_error_callback;
+	errcallback.arg = (void *) bufs[0];
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	reln = smgropen(BufTagGetRelFileLocator(&tag), InvalidBackendId);
+
+	/* one WAL flush covers the whole run */
+	if (!XLogRecPtrIsInvalid(maxlsn))
+		XLogFlush(maxlsn);
+
+	/*
+	 * With checksums, copy the pages to private storage before checksumming
+	 * them, for the same reason as PageSetChecksumCopy().
+	 */
+	if (DataChecksumsEnabled())
+	{
+		if (staging == NULL)
+			staging = MemoryContextAllocAligned(TopMemoryContext,
+												MAX_IO_COMBINE_LIMIT * BLCKSZ,
+												PG_IO_ALIGN_SIZE, 0);
+		for (int i = 0; i < n; i++)
+		{
+			char	   *page = staging + (Size) i * BLCKSZ;
+
+			memcpy(page, BufHdrGetBlock(bufs[i]), BLCKSZ);
+			PageSetChecksumInplace((Page) page, tag.blockNum + i);
+			pages[i] = page;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < n; i++)
+			pages[i] = BufHdrGetBlock(bufs[i]);
+	}
+
+	io_start = pgstat_prepare_io_time();
+
+	smgrwritev(reln, BufTagGetForkNum(&tag), tag.blockNum, pages, n, false);
+
+	pgstat_count_io_op_time(IOOBJECT_RELATION, IOCONTEXT_NORMAL, IOOP_WRITE,
+							reln->smgr_rlocator.locator.spcOid, io_start, n);
+
+	pgBufferUsage.shared_blks_written += n;
+
+	for (int i = 0; i < n; i++)
+	{
+		BufferTag	buftag = bufs[i]->tag;
+
+		TerminateBufferIO(bufs[i], true, 0, true);
+		LWLockRelease(BufferDescriptorGetContentLock(bufs[i]));
+		UnpinBuffer(bufs[i]);
+
+		ScheduleBufferTagForWriteback(wb_context, IOCONTEXT_NORMAL, &buftag);
+	}
+
+	/* Pop the error context stack */
+	error_context_stack = errcallback.previous;
+
+	*nwritten = n;
+	return n;
+}
+
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
  *
@@ -3456,8 +4219,8 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln, IOObject io_object,
 	 * When a strategy is not in use, the write can only be a "regular" write
 	 * of a dirty shared buffer (IOCONTEXT_NORMAL IOOP_WRITE).
 	 */
-	pgstat_count_io_op_time(IOOBJECT_RELATION, io_context,
-							IOOP_WRITE, io_start, 1);
+	pgstat_count_io_op_time(IOOBJECT_RELATION, io_context, IOOP_WRITE,
+							reln->smgr_rlocator.locator.spcOid, io_start, 1);
 
 	pgBufferUsage.shared_blks_written++;
 
@@ -3465,7 +4228,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln, IOObject io_object,
 	 * Mark the buffer as clean (unless BM_JUST_DIRTIED has become set) and
 	 * end the BM_IO_IN_PROGRESS state.
 	 */
-	TerminateBufferIO(buf, true, 0);
+	TerminateBufferIO(buf, true, 0, true);
 
 	TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(BufTagGetForkNum(&buf->tag),
 									   buf->tag.blockNum,
@@ -3602,6 +4365,8 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 	RelFileLocatorBackend rlocator;
 	BlockNumber nForkBlock[MAX_FORKNUM];
 	uint64		nBlocksToInvalidate = 0;
+	int		   *buffers;
+	int			nbuffers;
 
 	rlocator = smgr_reln->smgr_rlocator;
 
@@ -3619,8 +4384,9 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 
 	/*
 	 * To remove all the pages of the specified relation forks from the buffer
-	 * pool, we need to scan the entire buffer pool but we can optimize it by
-	 * finding the buffers from BufMapping table provided we know the exact
+	 * pool, we need to visit all its buffers listed in the relation index but
+	 * we can optimize it by finding the buffers from BufMapping table when
+	 * only a few blocks are to be removed, provided we know the exact
 	 * size of each fork of the relation. The exact size is required to ensure
 	 * that we don't leave any buffer for the relation being dropped as
 	 * otherwise the background writer or checkpointer can lead to a PANIC
@@ -3667,30 +4433,23 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 		return;
 	}
 
-	for (i = 0; i < NBuffers; i++)
+	/*
+	 * Otherwise visit all buffers of the relation, as found in the relation
+	 * index.  That's safe because the caller must have AccessExclusiveLock
+	 * on the relation, or some other reason to be certain that no one is
+	 * loading new pages of the rel into the buffer pool.  (Otherwise we might
+	 * well miss such pages entirely.)  Therefore, while the buffers might be
+	 * evicted after we collected them, none can start holding a page we care
+	 * about.  So false negatives are impossible, and false positives are safe
+	 * because we'll recheck after getting the buffer lock.
+	 */
+	nbuffers = BufRelIndexCollect(&rlocator.locator, &buffers);
+
+	for (i = 0; i < nbuffers; i++)
 	{
-		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		BufferDesc *bufHdr = GetBufferDescriptor(buffers[i]);
 		uint32		buf_state;
 
-		/*
-		 * We can make this a tad faster by prechecking the buffer tag before
-		 * we attempt to lock the buffer; this saves a lot of lock
-		 * acquisitions in typical cases.  It should be safe because the
-		 * caller must have AccessExclusiveLock on the relation, or some other
-		 * reason to be certain that no one is loading new pages of the rel
-		 * into the buffer pool.  (Otherwise we might well miss such pages
-		 * entirely.)  Therefore, while the tag might be changing while we
-		 * look at it, it can't be changing *to* a value we care about, only
-		 * *away* from such a value.  So false negatives are impossible, and
-		 * false positives are safe because we'll recheck after getting the
-		 * buffer lock.
-		 *
-		 * We could check forkNum and blockNum as well as the rlocator, but
-		 * the incremental win from doing so seems small.
-		 */
-		if (!BufTagMatchesRelFileLocator(&bufHdr->tag, &rlocator.locator))
-			continue;
-
 		buf_state = LockBufHdr(bufHdr);
 
 		for (j = 0; j < nforks; j++)
@@ -3706,6 +4465,8 @@ DropRelationBuffers(SMgrRelation smgr_reln, ForkNumber *forkNum,
 		if (j >= nforks)
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	pfree(buffers);
 }
 
 /* ---------------------------------------------------------------------
@@ -3724,9 +4485,7 @@ DropRelationsAllBuffers(SMgrRelation *smgr_reln, int nlocators)
 	SMgrRelation *rels;
 	BlockNumber (*block)[MAX_FORKNUM + 1];
 	uint64		nBlocksToInvalidate = 0;
-	RelFileLocator *locators;
 	bool		cached = true;
-	bool		use_bsearch;
 
 	if (nlocators == 0)
 		return;
@@ -3763,7 +4522,7 @@ DropRelationsAllBuffers(SMgrRelation *smgr_reln, int nlocators)
 		palloc(sizeof(BlockNumber) * n * (MAX_FORKNUM + 1));
 
 	/*
-	 * We can avoid scanning the entire buffer pool if we know the exact size
+	 * We can avoid walking the relation index if we know the exact size
 	 * of each of the given relation forks. See DropRelationBuffers.
 	 */
 	for (i = 0; i < n && cached; i++)
@@ -3813,68 +4572,34 @@ DropRelationsAllBuffers(SMgrRelation *smgr_reln, int nlocators)
 	}
 
 	pfree(block);
-	locators = palloc(sizeof(RelFileLocator) * n);	/* non-local relations */
-	for (i = 0; i < n; i++)
-		locators[i] = rels[i]->smgr_rlocator.locator;
 
 	/*
-	 * For low number of relations to drop just use a simple walk through, to
-	 * save the bsearch overhead. The threshold to use is rather a guess than
-	 * an exactly determined value, as it depends on many factors (CPU and RAM
-	 * speeds, amount of shared buffers etc.).
+	 * Otherwise visit the buffers of each relation, as found in the relation
+	 * index.  See DropRelationBuffers for why that's enough.
 	 */
-	use_bsearch = n > RELS_BSEARCH_THRESHOLD;
-
-	/* sort the list of rlocators if necessary */
-	if (use_bsearch)
-		pg_qsort(locators, n, sizeof(RelFileLocator), rlocator_comparator);
-
-	for (i = 0; i < NBuffers; i++)
+	for (i = 0; i < n; i++)
 	{
-		RelFileLocator *rlocator = NULL;
-		BufferDesc *bufHdr = GetBufferDescriptor(i);
-		uint32		buf_state;
-
-		/*
-		 * As in DropRelationBuffers, an unlocked precheck should be safe and
-		 * saves some cycles.
-		 */
+		RelFileLocator *rlocator = &rels[i]->smgr_rlocator.locator;
+		int		   *buffers;
+		int			nbuffers;
 
-		if (!use_bsearch)
-		{
-			int			j;
+		nbuffers = BufRelIndexCollect(rlocator, &buffers);
 
-			for (j = 0; j < n; j++)
-			{
-				if (BufTagMatchesRelFileLocator(&bufHdr->tag, &locators[j]))
-				{
-					rlocator = &locators[j];
-					break;
-				}
-			}
-		}
-		else
+		for (int j = 0; j < nbuffers; j++)
 		{
-			RelFileLocator locator;
+			BufferDesc *bufHdr = GetBufferDescriptor(buffers[j]);
+			uint32		buf_state;
 
-			locator = BufTagGetRelFileLocator(&bufHdr->tag);
-			rlocator = bsearch((const void *) &(locator),
-							   locators, n, sizeof(RelFileLocator),
-							   rlocator_comparator);
+			buf_state = LockBufHdr(bufHdr);
+			if (BufTagMatchesRelFileLocator(&bufHdr->tag, rlocator))
+				InvalidateBuffer(bufHdr);	/* releases spinlock */
+			else
+				UnlockBufHdr(bufHdr, buf_state);
 		}
 
-		/* buffer doesn't belong to any of the given relfilelocators; skip it */
-		if (rlocator == NULL)
-			continue;
-
-		buf_state = LockBufHdr(bufHdr);
-		if (BufTagMatchesRelFileLocator(&bufHdr->tag, rlocator))
-			InvalidateBuffer(bufHdr);	/* releases spinlock */
-		else
-			UnlockBufHdr(bufHdr, buf_state);
+		pfree(buffers);
 	}
 
-	pfree(locators);
 	pfree(rels);
 }
 
@@ -3952,30 +4677,29 @@ void
 DropDatabaseBuffers(Oid dbid)
 {
 	int			i;
+	int		   *buffers;
+	int			nbuffers;
 
 	/*
 	 * We needn't consider local buffers, since by assumption the target
 	 * database isn't our own.
 	 */
 
-	for (i = 0; i < NBuffers; i++)
+	nbuffers = BufRelIndexCollectDatabase(dbid, &buffers);
+
+	for (i = 0; i < nbuffers; i++)
 	{
-		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		BufferDesc *bufHdr = GetBufferDescriptor(buffers[i]);
 		uint32		buf_state;
 
-		/*
-		 * As in DropRelationBuffers, an unlocked precheck should be safe and
-		 * saves some cycles.
-		 */
-		if (bufHdr->tag.dbOid != dbid)
-			continue;
-
 		buf_state = LockBufHdr(bufHdr);
 		if (bufHdr->tag.dbOid == dbid)
 			InvalidateBuffer(bufHdr);	/* releases spinlock */
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	pfree(buffers);
 }
 
 /* -----------------------------------------------------------------
@@ -4048,10 +4772,9 @@ PrintPinnedBufs(void)
  *		more blocks of the relation; the effects can't be expected to last
  *		after the lock is released.
  *
- *		XXX currently it sequentially searches the buffer pool, should be
- *		changed to more clever ways of searching.  This routine is not
- *		used in any performance-critical code paths, so it's not worth
- *		adding additional overhead to normal paths to make it go faster.
+ *		The shared buffers of the relation are found through the relation
+ *		index, so this costs time proportional to how much of the relation
+ *		is cached rather than to the size of the buffer pool.
  * --------------------------------------------------------------------
  */
 void
@@ -4059,6 +4782,8 @@ FlushRelationBuffers(Relation rel)
 {
 	int			i;
 	BufferDesc *bufHdr;
+	int		   *buffers;
+	int			nbuffers;
 
 	if (RelationUsesLocalBuffers(rel))
 	{
@@ -4095,7 +4820,7 @@ FlushRelationBuffers(Relation rel)
 
 				pgstat_count_io_op_time(IOOBJECT_TEMP_RELATION,
 										IOCONTEXT_NORMAL, IOOP_WRITE,
-										io_start, 1);
+										rel->rd_locator.spcOid, io_start, 1);
 
 				buf_state &= ~(BM_DIRTY | BM_JUST_DIRTIED);
 				pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
@@ -4113,18 +4838,14 @@ FlushRelationBuffers(Relation rel)
 	/* Make sure we can handle the pin inside the loop */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
 
-	for (i = 0; i < NBuffers; i++)
+	/* As in DropRelationBuffers, the relation index has all we need */
+	nbuffers = BufRelIndexCollect(&rel->rd_locator, &buffers);
+
+	for (i = 0; i < nbuffers; i++)
 	{
 		uint32		buf_state;
 
-		bufHdr = GetBufferDescriptor(i);
-
-		/*
-		 * As in DropRelationBuffers, an unlocked precheck should be safe and
-		 * saves some cycles.
-		 */
-		if (!BufTagMatchesRelFileLocator(&bufHdr->tag, &rel->rd_locator))
-			continue;
+		bufHdr = GetBufferDescriptor(buffers[i]);
 
 		ReservePrivateRefCountEntry();
 
@@ -4141,6 +4862,8 @@ FlushRelationBuffers(Relation rel)
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	pfree(buffers);
 }
 
 /* ---------------------------------------------------------------------
@@ -4156,91 +4879,48 @@ void
 FlushRelationsAllBuffers(SMgrRelation *smgrs, int nrels)
 {
 	int			i;
-	SMgrSortArray *srels;
-	bool		use_bsearch;
-
-	if (nrels == 0)
-		return;
-
-	/* fill-in array for qsort */
-	srels = palloc(sizeof(SMgrSortArray) * nrels);
-
-	for (i = 0; i < nrels; i++)
-	{
-		Assert(!RelFileLocatorBackendIsTemp(smgrs[i]->smgr_rlocator));
-
-		srels[i].rlocator = smgrs[i]->smgr_rlocator.locator;
-		srels[i].srel = smgrs[i];
-	}
-
-	/*
-	 * Save the bsearch overhead for low number of relations to sync. See
-	 * DropRelationsAllBuffers for details.
-	 */
-	use_bsearch = nrels > RELS_BSEARCH_THRESHOLD;
-
-	/* sort the list of SMgrRelations if necessary */
-	if (use_bsearch)
-		pg_qsort(srels, nrels, sizeof(SMgrSortArray), rlocator_comparator);
 
 	/* Make sure we can handle the pin inside the loop */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
 
-	for (i = 0; i < NBuffers; i++)
+	/*
+	 * Visit the buffers of each relation, as found in the relation index.
+	 * See FlushRelationBuffers.
+	 */
+	for (i = 0; i < nrels; i++)
 	{
-		SMgrSortArray *srelent = NULL;
-		BufferDesc *bufHdr = GetBufferDescriptor(i);
-		uint32		buf_state;
+		SMgrRelation srel = smgrs[i];
+		RelFileLocator *rlocator = &srel->smgr_rlocator.locator;
+		int		   *buffers;
+		int			nbuffers;
 
-		/*
-		 * As in DropRelationBuffers, an unlocked precheck should be safe and
-		 * saves some cycles.
-		 */
+		Assert(!RelFileLocatorBackendIsTemp(srel->smgr_rlocator));
+
+		nbuffers = BufRelIndexCollect(rlocator, &buffers);
 
-		if (!use_bsearch)
+		for (int j = 0; j < nbuffers; j++)
 		{
-			int			j;
+			BufferDesc *bufHdr = GetBufferDescriptor(buffers[j]);
+			uint32		buf_state;
+
+			ReservePrivateRefCountEntry();
 
-			for (j = 0; j < nrels; j++)
+			buf_state = LockBufHdr(bufHdr);
+			if (BufTagMatchesRelFileLocator(&bufHdr->tag, rlocator) &&
+				(buf_state & (BM_VALID | BM_DIRTY)) == (BM_VALID | BM_DIRTY))
 			{
-				if (BufTagMatchesRelFileLocator(&bufHdr->tag, &srels[j].rlocator))
-				{
-					srelent = &srels[j];
-					break;
-				}
+				PinBuffer_Locked(bufHdr);
+				LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
+				FlushBuffer(bufHdr, srel, IOOBJECT_RELATION, IOCONTEXT_NORMAL);
+				LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
+				UnpinBuffer(bufHdr);
 			}
+			else
+				UnlockBufHdr(bufHdr, buf_state);
 		}
-		else
-		{
-			RelFileLocator rlocator;
-
-			rlocator = BufTagGetRelFileLocator(&bufHdr->tag);
-			srelent = bsearch((const void *) &(rlocator),
-							  srels, nrels, sizeof(SMgrSortArray),
-							  rlocator_comparator);
-		}
-
-		/* buffer doesn't belong to any of the given relfilelocators; skip it */
-		if (srelent == NULL)
-			continue;
-
-		ReservePrivateRefCountEntry();
 
-		buf_state = LockBufHdr(bufHdr);
-		if (BufTagMatchesRelFileLocator(&bufHdr->tag, &srelent->rlocator) &&
-			(buf_state & (BM_VALID | BM_DIRTY)) == (BM_VALID | BM_DIRTY))
-		{
-			PinBuffer_Locked(bufHdr);
-			LWLockAcquire(BufferDescriptorGetContentLock(bufHdr), LW_SHARED);
-			FlushBuffer(bufHdr, srelent->srel, IOOBJECT_RELATION, IOCONTEXT_NORMAL);
-			LWLockRelease(BufferDescriptorGetContentLock(bufHdr));
-			UnpinBuffer(bufHdr);
-		}
-		else
-			UnlockBufHdr(bufHdr, buf_state);
+		pfree(buffers);
 	}
-
-	pfree(srels);
 }
 
 /* ---------------------------------------------------------------------
@@ -4418,22 +5098,19 @@ FlushDatabaseBuffers(Oid dbid)
 {
 	int			i;
 	BufferDesc *bufHdr;
+	int		   *buffers;
+	int			nbuffers;
 
 	/* Make sure we can handle the pin inside the loop */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
 
-	for (i = 0; i < NBuffers; i++)
+	nbuffers = BufRelIndexCollectDatabase(dbid, &buffers);
+
+	for (i = 0; i < nbuffers; i++)
 	{
 		uint32		buf_state;
 
-		bufHdr = GetBufferDescriptor(i);
-
-		/*
-		 * As in DropRelationBuffers, an unlocked precheck should be safe and
-		 * saves some cycles.
-		 */
-		if (bufHdr->tag.dbOid != dbid)
-			continue;
+		bufHdr = GetBufferDescriptor(buffers[i]);
 
 		ReservePrivateRefCountEntry();
 
@@ -4450,6 +5127,8 @@ FlushDatabaseBuffers(Oid dbid)
 		else
 			UnlockBufHdr(bufHdr, buf_state);
 	}
+
+	pfree(buffers);
 }
 
 /*
@@ -5053,14 +5732,19 @@ IsBufferCleanupOK(Buffer buffer)
 /*
  *	Functions for buffer I/O handling
  *
- *	Note: We assume that nested buffer I/O never occurs.
- *	i.e at most one BM_IO_IN_PROGRESS bit is set per proc.
+ *	Note: A process may have BM_IO_IN_PROGRESS set on several buffers at
+ *	once, when reading a run of blocks with StartReadBuffers().  Those are
+ *	always acquired in ascending block order.
  *
  *	Also note that these are used only for shared buffers, not local ones.
  */
 
 /*
  * WaitIO -- Block until the IO_IN_PROGRESS flag on 'buf' is cleared.
+ *
+ * If the I/O was started asynchronously, its completion might have to be
+ * collected by somebody first, so we wait on the AIO handle rather than
+ * just sleeping until the owner gets around to it.
  */
 static void
 WaitIO(BufferDesc *buf)
@@ -5071,6 +5755,7 @@ WaitIO(BufferDesc *buf)
 	for (;;)
 	{
 		uint32		buf_state;
+		int			io_handle;
 
 		/*
 		 * It may not be necessary to acquire the spinlock to check the flag
@@ -5078,10 +5763,30 @@ WaitIO(BufferDesc *buf)
 		 * play it safe.
 		 */
 		buf_state = LockBufHdr(buf);
+		io_handle = buf->io_handle;
 		UnlockBufHdr(buf, buf_state);
 
 		if (!(buf_state & BM_IO_IN_PROGRESS))
 			break;
+
+		/*
+		 * If the handle hasn't been submitted yet, this returns immediately.
+		 * Sleep only briefly in that case, since after submission it may be
+		 * up to us to collect the completion.
+		 */
+		if (io_handle >= 0)
+		{
+			pgaio_wait_index(io_handle);
+
+			buf_state = LockBufHdr(buf);
+			UnlockBufHdr(buf, buf_state);
+			if (!(buf_state & BM_IO_IN_PROGRESS))
+				break;
+
+			ConditionVariableTimedSleep(cv, 10, WAIT_EVENT_BUFFER_IO);
+			continue;
+		}
+
 		ConditionVariableSleep(cv, WAIT_EVENT_BUFFER_IO);
 	}
 	ConditionVariableCancelSleep();
@@ -5140,6 +5845,36 @@ StartBufferIO(BufferDesc *buf, bool forInput)
 	return true;
 }
 
+/*
+ * ConditionalStartBufferIO: begin output on this buffer, without waiting
+ *
+ * Like StartBufferIO(buf, false), except that if someone else has I/O in
+ * progress on the buffer, we return false rather than wait for it.
+ */
+static bool
+ConditionalStartBufferIO(BufferDesc *buf)
+{
+	uint32		buf_state;
+
+	ResourceOwnerEnlargeBufferIOs(CurrentResourceOwner);
+
+	buf_state = LockBufHdr(buf);
+
+	if ((buf_state & BM_IO_IN_PROGRESS) || !(buf_state & BM_DIRTY))
+	{
+		UnlockBufHdr(buf, buf_state);
+		return false;
+	}
+
+	buf_state |= BM_IO_IN_PROGRESS;
+	UnlockBufHdr(buf, buf_state);
+
+	ResourceOwnerRememberBufferIO(CurrentResourceOwner,
+								  BufferDescriptorGetBuffer(buf));
+
+	return true;
+}
+
 /*
  * TerminateBufferIO: release a buffer we were doing I/O on
  *	(Assumptions)
@@ -5155,9 +5890,15 @@ StartBufferIO(BufferDesc *buf, bool forInput)
  * set_flag_bits gets ORed into the buffer's flags.  It must include
  * BM_IO_ERROR in a failure case.  For successful completion it could
  * be 0, or BM_VALID if we just finished reading in the page.
+ *
+ * If forget_owner is true, the I/O is removed from the current resource
+ * owner.  Completion callbacks for asynchronous I/O pass false, because the
+ * I/O was handed over to the AIO subsystem when it was started, and they
+ * may be running in a different process anyway.
  */
 static void
-TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
+TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits,
+				  bool forget_owner)
 {
 	uint32		buf_state;
 
@@ -5170,10 +5911,12 @@ TerminateBufferIO(BufferDesc *buf, bool clear_dirty, uint32 set_flag_bits)
 		buf_state &= ~(BM_DIRTY | BM_CHECKPOINT_NEEDED);
 
 	buf_state |= set_flag_bits;
+	buf->io_handle = -1;
 	UnlockBufHdr(buf, buf_state);
 
-	ResourceOwnerForgetBufferIO(CurrentResourceOwner,
-								BufferDescriptorGetBuffer(buf));
+	if (forget_owner)
+		ResourceOwnerForgetBufferIO(CurrentResourceOwner,
+									BufferDescriptorGetBuffer(buf));
 
 	ConditionVariableBroadcast(BufferDescriptorGetIOCV(buf));
 }
@@ -5223,7 +5966,7 @@ AbortBufferIO(Buffer buffer)
 		}
 	}
 
-	TerminateBufferIO(buf_hdr, false, BM_IO_ERROR);
+	TerminateBufferIO(buf_hdr, false, BM_IO_ERROR, true);
 }
 
 /*
@@ -5568,10 +6311,12 @@ IssuePendingWritebacks(WritebackContext *wb_context, IOContext io_context)
 
 	/*
 	 * Assume that writeback requests are only issued for buffers containing
-	 * blocks of permanent relations.
+	 * blocks of permanent relations.  They may span tablespaces, so they're
+	 * not counted per tablespace.
 	 */
 	pgstat_count_io_op_time(IOOBJECT_RELATION, io_context,
-							IOOP_WRITEBACK, io_start, wb_context->nr_pending);
+							IOOP_WRITEBACK, InvalidOid,
+							io_start, wb_context->nr_pending);
 
 	wb_context->nr_pending = 0;
 }
@@ -23,22 +23,60 @@
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
-
 /*
- * The shared freelist control information.
+ * The clock sweep is split into partitions, each with its own hand sweeping
+ * a disjoint range of buffers, so that backends evicting buffers at a high
+ * rate don't all hammer the same cache line.  Each backend starts in a home
+ * partition chosen by its pgprocno, and moves on to the following partitions
+ * if a whole pass over its home partition doesn't turn up a victim.
+ *
+ * Small buffer pools are not split up, since a partition must be large
+ * enough for the usage counts in it to mean something.
  */
+#define MAX_CLOCK_SWEEP_PARTITIONS			64
+#define MIN_CLOCK_SWEEP_PARTITION_BUFFERS	4096
+
 typedef struct
 {
-	/* Spinlock: protects the values below */
-	slock_t		buffer_strategy_lock;
+	/* Spinlock: protects completePasses */
+	slock_t		mutex;
+
+	/* The range of buffers swept by this partition's hand */
+	int			firstBuffer;
+	int			numBuffers;
 
 	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
+	 * Clock sweep hand: index, relative to firstBuffer, of next buffer to
+	 * consider grabbing.  Note that this isn't a concrete buffer - we only
+	 * ever increase the value. So, to get an actual buffer, it needs to be
+	 * used modulo numBuffers.
 	 */
 	pg_atomic_uint32 nextVictimBuffer;
 
+	/*
+	 * Statistics.  These counters should be wide enough that they can't
+	 * overflow during a single bgwriter cycle.
+	 */
+	uint32		completePasses; /* Complete cycles of this partition's hand */
+	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+} ClockSweepPartition;
+
+/* Padded to a full cache line each, to avoid false sharing */
+typedef union ClockSweepPartitionPadded
+{
+	ClockSweepPartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} ClockSweepPartitionPadded;
+
+
+/*
+ * The shared freelist control information.
+ */
+typedef struct
+{
+	/* Spinlock: protects the values below */
+	slock_t		buffer_strategy_lock;
+
 	int			firstFreeBuffer;	/* Head of list of unused buffers */
 	int			lastFreeBuffer; /* Tail of list of unused buffers */
 
@@ -47,12 +85,8 @@ typedef struct
 	 * when the list is empty)
 	 */
 
-	/*
-	 * Statistics.  These counters should be wide enough that they can't
-	 * overflow during a single bgwriter cycle.
-	 */
-	uint32		completePasses; /* Complete cycles of the clock sweep */
-	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+	/* Number of clock sweep partitions; doesn't change after startup */
+	int			numPartitions;
 
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
@@ -63,6 +97,7 @@ typedef struct
 
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
+static ClockSweepPartitionPadded *ClockSweepPartitions = NULL;
 
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
@@ -98,14 +133,25 @@ static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 static void AddBufferToRing(BufferAccessStrategy strategy,
 							BufferDesc *buf);
 
+/*
+ * StrategyHomePartition - the clock sweep partition this process starts in
+ */
+static inline int
+StrategyHomePartition(void)
+{
+	if (MyProc == NULL)
+		return 0;
+	return MyProc->pgprocno % StrategyControl->numPartitions;
+}
+
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the partition's clock hand one buffer ahead of its current position
+ * and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(ClockSweepPartition *part)
 {
 	uint32		victim;
 
@@ -115,14 +161,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&part->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= part->numBuffers)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % part->numBuffers;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -148,19 +194,19 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&part->mutex);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % part->numBuffers;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&part->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					part->completePasses++;
+				SpinLockRelease(&part->mutex);
 			}
 		}
 	}
-	return victim;
+	return part->firstBuffer + victim;
 }
 
 /*
@@ -198,6 +244,9 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 	BufferDesc *buf;
 	int			bgwprocno;
 	int			trycounter;
+	int			partno;
+	ClockSweepPartition *part;
+	int			partcounter;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
 
 	*from_ring = false;
@@ -245,9 +294,12 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 	/*
 	 * We count buffer allocation requests so that the bgwriter can estimate
 	 * the rate of buffer consumption.  Note that buffers recycled by a
-	 * strategy object are intentionally not counted here.
+	 * strategy object are intentionally not counted here.  The count is kept
+	 * per partition, so as not to make every backend touch the same counter.
 	 */
-	pg_atomic_fetch_add_u32(&StrategyControl->numBufferAllocs, 1);
+	partno = StrategyHomePartition();
+	part = &ClockSweepPartitions[partno].part;
+	pg_atomic_fetch_add_u32(&part->numBufferAllocs, 1);
 
 	/*
 	 * First check, without acquiring the lock, whether there's buffers in the
@@ -311,11 +363,24 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state, bool *from_r
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
+	/*
+	 * Nothing on the freelist, so run the "clock sweep" algorithm, starting
+	 * in our home partition.  If a whole pass over a partition doesn't find a
+	 * victim, it's busier than the others, so steal from the next one.
+	 */
 	trycounter = NBuffers;
+	partcounter = part->numBuffers;
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		if (partcounter-- == 0)
+		{
+			if (++partno == StrategyControl->numPartitions)
+				partno = 0;
+			part = &ClockSweepPartitions[partno].part;
+			partcounter = part->numBuffers - 1;
+		}
+
+		buf = GetBufferDescriptor(ClockSweepTick(part));
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
@@ -379,43 +444,64 @@ StrategyFreeBuffer(BufferDesc *buf)
 	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
 }
 
+/*
+ * StrategySyncPartitions -- number of clock sweep partitions
+ *
+ * The bgwriter keeps ahead of each partition's hand separately; see
+ * StrategySyncStart().  This doesn't change after startup.
+ */
+int
+StrategySyncPartitions(void)
+{
+	return StrategyControl->numPartitions;
+}
+
 /*
  * StrategySyncStart -- tell BufferSync where to start syncing
  *
- * The result is the buffer index of the best buffer to sync first.
- * BufferSync() will proceed circularly around the buffer array from there.
+ * The result is the index, relative to *first_buffer, of the best buffer to
+ * sync first in clock sweep partition partno, which consists of the
+ * *num_buffers buffers from *first_buffer on.  BgBufferSync() will proceed
+ * circularly around the partition from there.
  *
- * In addition, we return the completed-pass count (which is effectively
- * the higher-order bits of nextVictimBuffer) and the count of recent buffer
- * allocs if non-NULL pointers are passed.  The alloc count is reset after
- * being read.
+ * In addition, we return the completed-pass count of the partition's hand
+ * (which is effectively the higher-order bits of its nextVictimBuffer) and
+ * the count of its recent buffer allocs if non-NULL pointers are passed.
+ * The alloc count is reset after being read.
  */
 int
-StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
+StrategySyncStart(int partno, int *first_buffer, int *num_buffers,
+				  uint32 *complete_passes, uint32 *num_buf_alloc)
 {
+	ClockSweepPartition *part;
 	uint32		nextVictimBuffer;
 	int			result;
 
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
+	Assert(partno >= 0 && partno < StrategyControl->numPartitions);
+	part = &ClockSweepPartitions[partno].part;
+
+	SpinLockAcquire(&part->mutex);
+	nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
+	result = nextVictimBuffer % part->numBuffers;
 
 	if (complete_passes)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		*complete_passes = part->completePasses;
 
 		/*
 		 * Additionally add the number of wraparounds that happened before
 		 * completePasses could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		*complete_passes += nextVictimBuffer / part->numBuffers;
 	}
+	SpinLockRelease(&part->mutex);
 
 	if (num_buf_alloc)
-	{
-		*num_buf_alloc = pg_atomic_exchange_u32(&StrategyControl->numBufferAllocs, 0);
-	}
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+		*num_buf_alloc = pg_atomic_exchange_u32(&part->numBufferAllocs, 0);
+
+	*first_buffer = part->firstBuffer;
+	*num_buffers = part->numBuffers;
+
 	return result;
 }
 
@@ -441,6 +527,20 @@ StrategyNotifyBgWriter(int bgwprocno)
 }
 
 
+/*
+ * StrategyNumPartitions -- number of clock sweep partitions to use
+ */
+static int
+StrategyNumPartitions(void)
+{
+	int			nparts;
+
+	nparts = NBuffers / MIN_CLOCK_SWEEP_PARTITION_BUFFERS;
+	nparts = Min(nparts, MAX_CLOCK_SWEEP_PARTITIONS);
+
+	return Max(nparts, 1);
+}
+
 /*
  * StrategyShmemSize
  *
@@ -457,9 +557,16 @@ StrategyShmemSize(void)
 	/* size of lookup hash table ... see comment in StrategyInitialize */
 	size = add_size(size, BufTableShmemSize(NBuffers + NUM_BUFFER_PARTITIONS));
 
+	/* and so is the index of buffers by relation */
+	size = add_size(size, BufRelIndexShmemSize());
+
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the clock sweep partitions */
+	size = add_size(size, mul_size(StrategyNumPartitions(),
+								   sizeof(ClockSweepPartitionPadded)));
+
 	return size;
 }
 
@@ -474,6 +581,8 @@ void
 StrategyInitialize(bool init)
 {
 	bool		found;
+	bool		foundParts;
+	int			nparts = StrategyNumPartitions();
 
 	/*
 	 * Initialize the shared buffer lookup hashtable.
@@ -487,6 +596,12 @@ StrategyInitialize(bool init)
 	 */
 	InitBufTable(NBuffers + NUM_BUFFER_PARTITIONS);
 
+	/*
+	 * Initialize the index of buffers by relation.  Unlike the lookup table,
+	 * a buffer is only entered there once its old tag has been removed.
+	 */
+	InitBufRelIndex();
+
 	/*
 	 * Get or create the shared strategy control block
 	 */
@@ -494,9 +609,15 @@ StrategyInitialize(bool init)
 		ShmemInitStruct("Buffer Strategy Status",
 						sizeof(BufferStrategyControl),
 						&found);
+	ClockSweepPartitions = (ClockSweepPartitionPadded *)
+		ShmemInitStruct("Buffer Clock Sweep Partitions",
+						nparts * sizeof(ClockSweepPartitionPadded),
+						&foundParts);
 
 	if (!found)
 	{
+		int			firstBuffer = 0;
+
 		/*
 		 * Only done once, usually in postmaster
 		 */
@@ -511,12 +632,26 @@ StrategyInitialize(bool init)
 		StrategyControl->firstFreeBuffer = 0;
 		StrategyControl->lastFreeBuffer = NBuffers - 1;
 
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
+		/*
+		 * Divide the buffers between the clock sweep partitions as evenly as
+		 * possible, and initialize their hands and statistics.
+		 */
+		Assert(!foundParts);
+		StrategyControl->numPartitions = nparts;
+		for (int i = 0; i < nparts; i++)
+		{
+			ClockSweepPartition *part = &ClockSweepPartitions[i].part;
 
-		/* Clear statistics */
-		StrategyControl->completePasses = 0;
-		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+			SpinLockInit(&part->mutex);
+			part->firstBuffer = firstBuffer;
+			part->numBuffers = NBuffers / nparts + (i < NBuffers % nparts ? 1 : 0);
+			firstBuffer += part->numBuffers;
+
+			pg_atomic_init_u32(&part->nextVictimBuffer, 0);
+			part->completePasses = 0;
+			pg_atomic_init_u32(&part->numBufferAllocs, 0);
+		}
+		Assert(firstBuffer == NBuffers);
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
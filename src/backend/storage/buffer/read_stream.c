@@ -0,0 +1,503 @@
+/*-------------------------------------------------------------------------
+ *
+ * read_stream.c
+ *	  Mechanism for accessing buffered relation data with look-ahead
+ *
+ * Code that needs to access relation data typically pins blocks one at a
+ * time, often in a predictable order that might be sequential or data-driven.
+ * Calling the simple ReadBuffer() function for each block is inefficient,
+ * because blocks that are not yet in the buffer pool require I/O operations
+ * that are small and might stall waiting for storage.  This mechanism looks
+ * into the future and calls StartReadBuffers() and WaitReadBuffers() to read
+ * neighboring blocks together and ahead of time, with an adaptive look-ahead
+ * distance.
+ *
+ * A user-provided callback generates a stream of block numbers that is used
+ * to form reads of up to io_combine_limit blocks, by merging consecutive
+ * block numbers.  Each such read is started as soon as it has been formed,
+ * and waited for only when the consumer gets to its first block.  With
+ * io_method=sync that wait is where the I/O actually happens, and starting
+ * it early just gives us a chance to issue posix_fadvise() advice; with
+ * asynchronous I/O, the read proceeds in the background in the meantime.
+ *
+ * The look-ahead distance is the number of blocks that have been returned
+ * by the callback but not yet consumed.  It follows a simple set of rules:
+ *
+ * A) No I/O is necessary: every block we look at is already in the buffer
+ * pool.  There is no point in looking ahead far, so the distance decays
+ * towards one.
+ *
+ * B) Sequential I/O is detected: with synchronous I/O there is no point in
+ * issuing advice, because the kernel's own read-ahead does a better job of
+ * that, but we want at least io_combine_limit blocks queued so that we can
+ * form reads of that size.
+ *
+ * C) I/O that can be overlapped with the consumer's work is detected: either
+ * random access for which advice is issued, or any access with asynchronous
+ * I/O.  The distance doubles every time a read is needed, up to the
+ * tablespace's io_concurrency setting (or io_combine_limit, if higher), so
+ * that several reads can be under way while the consumer works on earlier
+ * blocks.
+ *
+ * Every queued block is pinned once its read has been started, so a stream
+ * holds at most as many pins as its queue is long, plus whatever pins the
+ * consumer holds itself.  StartReadBuffers() may pin fewer buffers than
+ * asked for, if we're running short.
+ *
+ * The callback may also store some data about each block in space provided
+ * by the stream.  It is returned along with the buffer, and remains valid
+ * until the next call to read_stream_next_buffer().
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/buffer/read_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "storage/fd.h"
+#include "storage/read_stream.h"
+#include "utils/rel.h"
+#include "utils/spccache.h"
+
+/*
+ * A read that has been started but not yet waited for.  Its buffers are also
+ * stored in the queue, starting at buffer_index.
+ */
+typedef struct InProgressIO
+{
+	int			buffer_index;
+	ReadBuffersOperation op;
+	Buffer		buffers[MAX_IO_COMBINE_LIMIT];
+} InProgressIO;
+
+/*
+ * State for managing a stream of reads.
+ *
+ * The queue is a circular array of queue_size entries.  Entries
+ * oldest .. oldest + nqueued - 1 hold block numbers that the callback has
+ * returned but the consumer hasn't received yet; the first npinned of those
+ * have had their reads started and hold a pinned buffer.  Reads that still
+ * need to be waited for are kept in another circular array, in queue order.
+ */
+struct ReadStream
+{
+	int			queue_size;		/* size of the circular queue */
+	int			max_distance;	/* upper limit for distance */
+	int			distance;		/* current look-ahead distance */
+	int			initial_distance;	/* distance after a reset */
+	int			combine_limit;	/* io_combine_limit at start of stream */
+	bool		advice_enabled; /* issue posix_fadvise() advice? */
+	bool		at_end;			/* has the callback reported end of stream? */
+	BlockNumber seq_blocknum;	/* block following the last read started */
+
+	/* The relation and fork we're reading, and buffer access strategy */
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+
+	/* The callback that generates block numbers */
+	ReadStreamBlockNumberCB callback;
+	void	   *callback_private_data;
+
+	/* Optional space for callback data, one per queue entry */
+	size_t		per_buffer_data_size;
+	char	   *per_buffer_data;
+
+	/* Circular array of reads being waited for */
+	int			max_ios;
+	int			ios_in_progress;
+	int			oldest_io;
+	InProgressIO *ios;
+
+	/* Circular queue of blocks and (for the first npinned) their buffers */
+	int			oldest;
+	int			nqueued;
+	int			npinned;
+	Buffer	   *buffers;
+	BlockNumber blocknums[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/*
+ * Return a pointer to the per-buffer data for the queue entry at index.
+ */
+static inline void *
+get_per_buffer_data(ReadStream *stream, int index)
+{
+	return stream->per_buffer_data + stream->per_buffer_data_size * index;
+}
+
+/*
+ * Return the queue index following index.
+ */
+static inline int
+read_stream_next_index(ReadStream *stream, int index)
+{
+	if (++index == stream->queue_size)
+		index = 0;
+	return index;
+}
+
+/*
+ * Return the queue index that is n entries after index.
+ */
+static inline int
+read_stream_advance_index(ReadStream *stream, int index, int n)
+{
+	index += n;
+	if (index >= stream->queue_size)
+		index -= stream->queue_size;
+	return index;
+}
+
+/*
+ * Return the number of consecutive blocks, up to io_combine_limit, at the
+ * start of the part of the queue that hasn't been pinned yet.
+ */
+static int
+read_stream_run_length(ReadStream *stream)
+{
+	BlockNumber blocknum;
+	int			index;
+	int			nblocks;
+
+	Assert(stream->npinned < stream->nqueued);
+
+	index = read_stream_advance_index(stream, stream->oldest, stream->npinned);
+	blocknum = stream->blocknums[index];
+	nblocks = 1;
+	while (stream->npinned + nblocks < stream->nqueued &&
+		   nblocks < stream->combine_limit)
+	{
+		index = read_stream_next_index(stream, index);
+		if (stream->blocknums[index] != blocknum + nblocks)
+			break;
+		nblocks++;
+	}
+
+	return nblocks;
+}
+
+/*
+ * Start a read of nblocks blocks at the start of the part of the queue that
+ * hasn't been pinned yet, and adjust the look-ahead distance according to
+ * whether any I/O turned out to be needed.
+ */
+static void
+read_stream_start_read(ReadStream *stream, int nblocks)
+{
+	InProgressIO *io;
+	BlockNumber blocknum;
+	int			index;
+	int			flags = 0;
+	bool		need_wait;
+
+	Assert(stream->ios_in_progress < stream->max_ios);
+
+	index = read_stream_advance_index(stream, stream->oldest, stream->npinned);
+	blocknum = stream->blocknums[index];
+
+	/* Sequential access is best left to the kernel's read-ahead. */
+	if (stream->advice_enabled && blocknum != stream->seq_blocknum)
+		flags |= READ_BUFFERS_ISSUE_ADVICE;
+
+	io = &stream->ios[(stream->oldest_io + stream->ios_in_progress) %
+					  stream->max_ios];
+	io->buffer_index = index;
+	io->op.rel = stream->rel;
+	io->op.smgr = NULL;
+	io->op.forknum = stream->forknum;
+	io->op.strategy = stream->strategy;
+
+	/*
+	 * StartReadBuffers() might decide to pin fewer buffers than we asked for,
+	 * if we're running short or part of the run is already cached.  The rest
+	 * stay in the queue for the next read.
+	 */
+	need_wait = StartReadBuffers(&io->op, io->buffers, blocknum, &nblocks,
+								 flags);
+	Assert(nblocks >= 1);
+
+	for (int i = 0; i < nblocks; i++)
+	{
+		stream->buffers[index] = io->buffers[i];
+		index = read_stream_next_index(stream, index);
+	}
+	stream->npinned += nblocks;
+	stream->seq_blocknum = blocknum + nblocks;
+
+	if (!need_wait)
+	{
+		/* Cache hit: not much point in looking further ahead. */
+		if (stream->distance > 1)
+			stream->distance--;
+		return;
+	}
+
+	stream->ios_in_progress++;
+
+	if (pgaio_enabled() || (flags & READ_BUFFERS_ISSUE_ADVICE))
+	{
+		/* The I/O can overlap with the consumer's work: look further. */
+		stream->distance = Min(stream->distance * 2, stream->max_distance);
+	}
+	else if (stream->distance < stream->combine_limit)
+	{
+		/* Only combining can help, so build full-sized reads. */
+		stream->distance = Min(stream->combine_limit, stream->max_distance);
+	}
+}
+
+/*
+ * Ask the callback for more block numbers, until the look-ahead distance is
+ * reached or the stream ends, and start reads for as many of them as we can.
+ *
+ * A run of blocks that might still grow is left alone until it reaches
+ * io_combine_limit, unless the consumer would otherwise have to wait for
+ * it.
+ */
+static void
+read_stream_look_ahead(ReadStream *stream)
+{
+	for (;;)
+	{
+		int			nblocks;
+
+		while (!stream->at_end && stream->nqueued < stream->distance)
+		{
+			int			index;
+			BlockNumber blocknum;
+
+			index = read_stream_advance_index(stream, stream->oldest,
+											  stream->nqueued);
+
+			blocknum = stream->callback(stream,
+										stream->callback_private_data,
+										stream->per_buffer_data_size > 0 ?
+										get_per_buffer_data(stream, index) : NULL);
+			if (blocknum == InvalidBlockNumber)
+			{
+				stream->at_end = true;
+				break;
+			}
+
+			stream->blocknums[index] = blocknum;
+			stream->nqueued++;
+		}
+
+		if (stream->npinned == stream->nqueued ||
+			stream->ios_in_progress == stream->max_ios)
+			break;
+
+		nblocks = read_stream_run_length(stream);
+		if (nblocks < stream->combine_limit &&
+			stream->npinned + nblocks == stream->nqueued &&
+			stream->npinned > 0 &&
+			!stream->at_end)
+			break;
+
+		/* This may increase the distance, so go around again. */
+		read_stream_start_read(stream, nblocks);
+	}
+}
+
+/*
+ * Create a new read stream for reading a relation.
+ *
+ * The callback is called to find out which block to read next, and may
+ * return InvalidBlockNumber to signal the end of the stream.  If
+ * per_buffer_data_size is non-zero, the callback is given space to store
+ * that much data for each block, which read_stream_next_buffer() hands back
+ * along with the buffer.
+ */
+ReadStream *
+read_stream_begin_relation(int flags,
+						   BufferAccessStrategy strategy,
+						   Relation rel,
+						   ForkNumber forknum,
+						   ReadStreamBlockNumberCB callback,
+						   void *callback_private_data,
+						   size_t per_buffer_data_size)
+{
+	ReadStream *stream;
+	Oid			tablespace_id;
+	int			max_ios;
+	int			queue_size;
+	size_t		size;
+
+	/*
+	 * Decide how many I/Os we will allow to run concurrently.  That probably
+	 * isn't the right question to ask, since it's the number of blocks of
+	 * look-ahead that really matters, but for now that's what the GUCs and
+	 * tablespace options are expressed in.
+	 */
+	tablespace_id = rel->rd_rel->reltablespace;
+	if (flags & READ_STREAM_MAINTENANCE)
+		max_ios = get_tablespace_maintenance_io_concurrency(tablespace_id);
+	else
+		max_ios = get_tablespace_io_concurrency(tablespace_id);
+
+	/*
+	 * We need to be able to look at least io_combine_limit blocks ahead to
+	 * form full-sized reads, and max_ios blocks ahead to keep that many reads
+	 * in progress when access is random.
+	 */
+	queue_size = Max(max_ios, io_combine_limit);
+
+	/* Keep each queue entry's per-buffer data suitably aligned. */
+	per_buffer_data_size = MAXALIGN(per_buffer_data_size);
+
+	size = offsetof(ReadStream, blocknums) + sizeof(BlockNumber) * queue_size;
+	size = MAXALIGN(size);
+	size += sizeof(Buffer) * queue_size;
+	size = MAXALIGN(size);
+	size += per_buffer_data_size * queue_size;
+
+	stream = (ReadStream *) palloc0(size);
+	stream->buffers = (Buffer *)
+		((char *) stream +
+		 MAXALIGN(offsetof(ReadStream, blocknums) +
+				  sizeof(BlockNumber) * queue_size));
+	stream->per_buffer_data = (char *) stream->buffers +
+		MAXALIGN(sizeof(Buffer) * queue_size);
+	stream->per_buffer_data_size = per_buffer_data_size;
+
+	stream->queue_size = queue_size;
+	stream->max_distance = queue_size;
+	stream->combine_limit = io_combine_limit;
+
+	/* Every read pins at least one buffer, so we can't have more than that. */
+	stream->max_ios = Max(max_ios, 1);
+	stream->ios = (InProgressIO *)
+		palloc(sizeof(InProgressIO) * stream->max_ios);
+
+#ifdef USE_PREFETCH
+
+	/*
+	 * Advice is only useful if the OS will act on it: not if prefetching is
+	 * disabled for this tablespace, not when the caller knows the access is
+	 * sequential, and not with direct I/O, where the kernel's cache isn't
+	 * used at all.  Nor is it needed if reads are asynchronous anyway.
+	 */
+	if ((io_direct_flags & IO_DIRECT_DATA) == 0 &&
+		(flags & READ_STREAM_SEQUENTIAL) == 0 &&
+		max_ios > 0 &&
+		!pgaio_enabled())
+		stream->advice_enabled = true;
+#endif
+
+	if (flags & READ_STREAM_FULL)
+		stream->initial_distance = stream->max_distance;
+	else
+		stream->initial_distance = 1;
+	stream->distance = stream->initial_distance;
+	stream->seq_blocknum = InvalidBlockNumber;
+
+	stream->rel = rel;
+	stream->forknum = forknum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private_data = callback_private_data;
+
+	return stream;
+}
+
+/*
+ * Pull one pinned buffer out of a stream.  Each call returns successive
+ * blocks in the order specified by the callback.  If per_buffer_data_size
+ * was set to a non-zero size, *per_buffer_data receives a pointer to the
+ * extra per-buffer data that the callback had a chance to populate, which
+ * remains valid until the next call to read_stream_next_buffer().  When the
+ * stream runs out of data, InvalidBuffer is returned.  The caller may
+ * decide to end the stream early at any time by calling read_stream_end().
+ */
+Buffer
+read_stream_next_buffer(ReadStream *stream, void **per_buffer_data)
+{
+	Buffer		buffer;
+	int			index;
+
+	/* Top up the queue first, so that more reads are started before we wait. */
+	read_stream_look_ahead(stream);
+
+	if (stream->nqueued == 0)
+	{
+		Assert(stream->at_end);
+		if (per_buffer_data)
+			*per_buffer_data = NULL;
+		return InvalidBuffer;
+	}
+
+	/* The look-ahead always starts the read the consumer needs next. */
+	Assert(stream->npinned > 0);
+	index = stream->oldest;
+
+	/* If this is the first block of a read, wait for it to finish. */
+	if (stream->ios_in_progress > 0 &&
+		stream->ios[stream->oldest_io].buffer_index == index)
+	{
+		WaitReadBuffers(&stream->ios[stream->oldest_io].op);
+		if (++stream->oldest_io == stream->max_ios)
+			stream->oldest_io = 0;
+		stream->ios_in_progress--;
+	}
+
+	buffer = stream->buffers[index];
+	Assert(BufferIsValid(buffer));
+	if (per_buffer_data)
+		*per_buffer_data = get_per_buffer_data(stream, index);
+
+	stream->oldest = read_stream_next_index(stream, index);
+	stream->nqueued--;
+	stream->npinned--;
+
+	return buffer;
+}
+
+/*
+ * Reset a read stream by releasing any queued up buffers, allowing the stream
+ * to be used again for different blocks.  This can be used to clear an
+ * end-of-stream condition and start again, or to throw away blocks that were
+ * speculatively read and read some different blocks instead.
+ */
+void
+read_stream_reset(ReadStream *stream)
+{
+	int			index = stream->oldest;
+
+	/* Reads must be finished before their buffers can be released. */
+	while (stream->ios_in_progress > 0)
+	{
+		WaitReadBuffers(&stream->ios[stream->oldest_io].op);
+		if (++stream->oldest_io == stream->max_ios)
+			stream->oldest_io = 0;
+		stream->ios_in_progress--;
+	}
+
+	while (stream->npinned > 0)
+	{
+		ReleaseBuffer(stream->buffers[index]);
+		index = read_stream_next_index(stream, index);
+		stream->npinned--;
+	}
+
+	stream->oldest = 0;
+	stream->nqueued = 0;
+	stream->at_end = false;
+	stream->distance = stream->initial_distance;
+	stream->seq_blocknum = InvalidBlockNumber;
+}
+
+/*
+ * Release and free a read stream.
+ */
+void
+read_stream_end(ReadStream *stream)
+{
+	read_stream_reset(stream);
+	pfree(stream->ios);
+	pfree(stream);
+}
@@ -40,11 +40,25 @@
  * when the corresponding files need to be survived across the transaction and
  * need to be opened and closed multiple times.  Such files need to be created
  * as a member of a FileSet.
+ *
+ * Reads and writes of at least a buffer's worth that find the buffer empty
+ * bypass it, so that callers handling data in large units get I/O in those
+ * units, without a copy.
+ *
+ * Finally, BufFiles can be compressed, see BufFileCreateCompressedTemp.  Each
+ * bufferload written out is then stored as a frame of its own, compressed
+ * with one of the methods of WAL compression.  Positions seen by callers are
+ * still those in the uncompressed contents, and seeks to any of them work,
+ * but writes have to go to the end of the file.  Frames are found by
+ * following their headers from the closest of the frames we remember the
+ * position of, which are one in every BUFFILE_CKPT_FRAMES.  While a file is
+ * read sequentially, we read ahead in units of BUFFILE_READAHEAD_SIZE.
  *-------------------------------------------------------------------------
  */
 
 #include "postgres.h"
 
+#include "access/xlogcompress.h"
 #include "commands/tablespace.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
@@ -52,6 +66,7 @@
 #include "storage/buf_internals.h"
 #include "storage/buffile.h"
 #include "storage/fd.h"
+#include "utils/memutils.h"
 #include "utils/resowner.h"
 
 /*
@@ -62,6 +77,31 @@
 #define MAX_PHYSICAL_FILESIZE	0x40000000
 #define BUFFILE_SEG_SIZE		(MAX_PHYSICAL_FILESIZE / BLCKSZ)
 
+/*
+ * A compressed file remembers where every BUFFILE_CKPT_FRAMES'th frame starts.
+ * Once BUFFILE_READAHEAD_FRAMES frames in a row have been read sequentially,
+ * it reads BUFFILE_READAHEAD_SIZE bytes at a time.
+ */
+#define BUFFILE_CKPT_FRAMES			64
+#define BUFFILE_READAHEAD_FRAMES	8
+#define BUFFILE_READAHEAD_SIZE		(256 * 1024)
+
+/* Header of each frame of a compressed file, followed by the frame's data. */
+typedef struct BufFileFrameHeader
+{
+	uint32		rawlen;			/* length of the data, uncompressed */
+	uint32		len;			/* length of the data as stored */
+	int32		method;			/* WalCompression the data is stored with */
+} BufFileFrameHeader;
+
+/* Position of a frame of a compressed file. */
+typedef struct BufFileFramePos
+{
+	int64		frameno;		/* number of frames before this one */
+	int64		logical;		/* offset in the uncompressed contents */
+	int64		physical;		/* offset of the frame header in the files */
+} BufFileFramePos;
+
 /*
  * This data structure represents a buffered file that consists of one or
  * more physical files (each accessed through a virtual file descriptor
@@ -96,6 +136,27 @@ struct BufFile
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
 
+	/*
+	 * For compressed files, curFile and curOffset above refer to the
+	 * uncompressed contents, with files of MAX_PHYSICAL_FILESIZE bytes each,
+	 * and the buffer always holds the contents of a single frame.  The
+	 * following fields locate the frames in the physical files.
+	 */
+	bool		compressed;		/* is this a compressed file? */
+	int			compression;	/* WalCompression for frames we write */
+	BufFileFramePos *ckpts;		/* every BUFFILE_CKPT_FRAMES'th frame */
+	int64		nckpts;			/* number of valid entries in ckpts */
+	int64		maxckpts;		/* allocated length of ckpts */
+	int64		nframes;		/* number of frames we wrote */
+	BufFileFramePos hint;		/* some frame start, likely useful next */
+	int64		logicalEnd;		/* uncompressed size, or -1 if not known */
+	int64		physEnd;		/* physical size */
+	int64		loadedEnd;		/* physical end of the last frame we loaded */
+	int			seqFrames;		/* frames loaded in a row sequentially */
+	char	   *readahead;		/* physical data read ahead, or NULL */
+	int64		raStart;		/* physical offset of readahead data */
+	int			raLen;			/* length of readahead data */
+
 	/*
 	 * XXX Should ideally us PGIOAlignedBlock, but might need a way to avoid
 	 * wasting per-file alignment padding when some users create many files.
@@ -103,6 +164,12 @@ struct BufFile
 	PGAlignedBlock buffer;
 };
 
+/* GUC parameter */
+int			temp_file_compression = WAL_COMPRESSION_NONE;
+
+/* A frame of a compressed file, as written or read */
+static char frame_buffer[sizeof(BufFileFrameHeader) + BLCKSZ];
+
 static BufFile *makeBufFileCommon(int nfiles);
 static BufFile *makeBufFile(File firstfile);
 static void extendBufFile(BufFile *file);
@@ -110,6 +177,21 @@ static void BufFileLoadBuffer(BufFile *file);
 static void BufFileDumpBuffer(BufFile *file);
 static void BufFileFlush(BufFile *file);
 static File MakeNewFileSetSegment(BufFile *buffile, int segment);
+static size_t BufFileReadAt(BufFile *file, int *fileno, off_t *offset,
+							char *ptr, size_t len);
+static void BufFileWriteAt(BufFile *file, int *fileno, off_t *offset,
+						   const char *ptr, size_t len);
+static void BufFilePhysicalPosition(int64 physical, int *fileno,
+									off_t *offset);
+static void BufFileReadPhysical(BufFile *file, int64 physical, char *ptr,
+								size_t len, bool readahead);
+static void BufFileAddCheckpoint(BufFile *file, const BufFileFramePos *frame);
+static void BufFileInitCompression(BufFile *file, int method, bool created);
+static void BufFileLoadFrame(BufFile *file);
+static void BufFileDumpFrame(BufFile *file);
+static bool BufFileFindFrame(BufFile *file, int64 target,
+							 BufFileFramePos *frame, BufFileFrameHeader *hdr);
+static int	BufFileSeekCompressed(BufFile *file, int64 target);
 
 /*
  * Create BufFile and perform the common initialization.
@@ -127,6 +209,10 @@ makeBufFileCommon(int nfiles)
 	file->curOffset = 0;
 	file->pos = 0;
 	file->nbytes = 0;
+	file->compressed = false;
+	file->compression = WAL_COMPRESSION_NONE;
+	file->ckpts = NULL;
+	file->readahead = NULL;
 
 	return file;
 }
@@ -215,6 +301,50 @@ BufFileCreateTemp(bool interXact)
 	return file;
 }
 
+/*
+ * Create a BufFile like BufFileCreateTemp, whose contents are compressed with
+ * the given WalCompression method, if it isn't WAL_COMPRESSION_NONE.
+ *
+ * A compressed file can only be written at its end, but its contents can be
+ * read in any order.
+ */
+BufFile *
+BufFileCreateCompressedTemp(bool interXact, int method)
+{
+	BufFile    *file = BufFileCreateTemp(interXact);
+
+	if (method != WAL_COMPRESSION_NONE)
+		BufFileInitCompression(file, method, true);
+
+	return file;
+}
+
+/*
+ * Set up a BufFile we made, or opened, to be compressed.
+ */
+static void
+BufFileInitCompression(BufFile *file, int method, bool created)
+{
+	Assert(file->numFiles == 1 || !created);
+
+	file->physEnd = created ? 0 : BufFileSize(file);
+	file->logicalEnd = file->physEnd == 0 ? 0 : -1;
+
+	file->compressed = true;
+	file->compression = method;
+	file->maxckpts = 16;
+	file->ckpts = palloc(sizeof(BufFileFramePos) * file->maxckpts);
+	file->ckpts[0].frameno = 0;
+	file->ckpts[0].logical = 0;
+	file->ckpts[0].physical = 0;
+	file->nckpts = 1;
+	file->nframes = 0;
+	file->hint = file->ckpts[0];
+	file->loadedEnd = -1;
+	file->seqFrames = 0;
+	file->raLen = 0;
+}
+
 /*
  * Build the name for a given segment of a given BufFile.
  */
@@ -278,6 +408,22 @@ BufFileCreateFileSet(FileSet *fileset, const char *name)
 	return file;
 }
 
+/*
+ * Like BufFileCreateFileSet, but compress the file with the given
+ * WalCompression method, as in BufFileCreateCompressedTemp.  The file must be
+ * opened with BufFileOpenCompressedFileSet, giving the same method.
+ */
+BufFile *
+BufFileCreateCompressedFileSet(FileSet *fileset, const char *name, int method)
+{
+	BufFile    *file = BufFileCreateFileSet(fileset, name);
+
+	if (method != WAL_COMPRESSION_NONE)
+		BufFileInitCompression(file, method, true);
+
+	return file;
+}
+
 /*
  * Open a file that was previously created in another backend (or this one)
  * with BufFileCreateFileSet in the same FileSet using the same name.
@@ -348,6 +494,21 @@ BufFileOpenFileSet(FileSet *fileset, const char *name, int mode,
 	return file;
 }
 
+/*
+ * Open a file created with BufFileCreateCompressedFileSet, read-only, like
+ * BufFileOpenFileSet.
+ */
+BufFile *
+BufFileOpenCompressedFileSet(FileSet *fileset, const char *name, int method)
+{
+	BufFile    *file = BufFileOpenFileSet(fileset, name, O_RDONLY, false);
+
+	if (method != WAL_COMPRESSION_NONE)
+		BufFileInitCompression(file, method, false);
+
+	return file;
+}
+
 /*
  * Delete a BufFile that was created by BufFileCreateFileSet in the given
  * FileSet using the given name.
@@ -420,6 +581,10 @@ BufFileClose(BufFile *file)
 		FileClose(file->files[i]);
 	/* release the buffer space */
 	pfree(file->files);
+	if (file->ckpts)
+		pfree(file->ckpts);
+	if (file->readahead)
+		pfree(file->readahead);
 	pfree(file);
 }
 
@@ -437,6 +602,12 @@ BufFileLoadBuffer(BufFile *file)
 	instr_time	io_start;
 	instr_time	io_time;
 
+	if (file->compressed)
+	{
+		BufFileLoadFrame(file);
+		return;
+	}
+
 	/*
 	 * Advance to next component file if necessary and possible.
 	 */
@@ -497,6 +668,12 @@ BufFileDumpBuffer(BufFile *file)
 	int			bytestowrite;
 	File		thisfile;
 
+	if (file->compressed)
+	{
+		BufFileDumpFrame(file);
+		return;
+	}
+
 	/*
 	 * Unlike BufFileLoadBuffer, we must dump the whole buffer even if it
 	 * crosses a component-file boundary; so we need a loop.
@@ -602,10 +779,24 @@ BufFileReadCommon(BufFile *file, void *ptr, size_t size, bool exact, bool eofOK)
 	{
 		if (file->pos >= file->nbytes)
 		{
-			/* Try to load more data into buffer. */
 			file->curOffset += file->pos;
 			file->pos = 0;
 			file->nbytes = 0;
+
+			/* Read at least a bufferload straight into the caller's memory. */
+			if (size >= BLCKSZ && !file->compressed)
+			{
+				nthistime = BufFileReadAt(file, &file->curFile,
+										  &file->curOffset, ptr, size);
+				if (nthistime == 0)
+					break;		/* no more data available */
+				ptr = (char *) ptr + nthistime;
+				size -= nthistime;
+				nread += nthistime;
+				continue;
+			}
+
+			/* Try to load more data into buffer. */
 			BufFileLoadBuffer(file);
 			if (file->nbytes <= 0)
 				break;			/* no more data available */
@@ -679,6 +870,17 @@ BufFileWrite(BufFile *file, const void *ptr, size_t size)
 
 	Assert(!file->readOnly);
 
+	/*
+	 * Frames of a compressed file are never rewritten, so rather than adding
+	 * to a frame we've read, start a new one where it ends.
+	 */
+	if (file->compressed && !file->dirty && file->nbytes > 0)
+	{
+		file->curOffset += file->pos;
+		file->pos = 0;
+		file->nbytes = 0;
+	}
+
 	while (size > 0)
 	{
 		if (file->pos >= BLCKSZ)
@@ -695,6 +897,17 @@ BufFileWrite(BufFile *file, const void *ptr, size_t size)
 			}
 		}
 
+		/* Write whole bufferloads directly, if there's nothing buffered. */
+		if (file->nbytes == 0 && size >= BLCKSZ && !file->compressed)
+		{
+			nthistime = size - size % BLCKSZ;
+			BufFileWriteAt(file, &file->curFile, &file->curOffset,
+						   ptr, nthistime);
+			ptr = (const char *) ptr + nthistime;
+			size -= nthistime;
+			continue;
+		}
+
 		nthistime = BLCKSZ - file->pos;
 		if (nthistime > size)
 			nthistime = size;
@@ -761,6 +974,18 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 			newOffset = (file->curOffset + file->pos) + offset;
 			break;
 		case SEEK_END:
+			if (file->compressed)
+			{
+				BufFileFramePos frame;
+				BufFileFrameHeader hdr;
+
+				BufFileFlush(file);
+				if (file->logicalEnd < 0)
+					(void) BufFileFindFrame(file, PG_INT64_MAX, &frame, &hdr);
+				newFile = file->logicalEnd / MAX_PHYSICAL_FILESIZE;
+				newOffset = file->logicalEnd % MAX_PHYSICAL_FILESIZE;
+				break;
+			}
 
 			/*
 			 * The file size of the last file gives us the end offset of that
@@ -779,6 +1004,9 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 			elog(ERROR, "invalid whence: %d", whence);
 			return EOF;
 	}
+	if (file->compressed)
+		return BufFileSeekCompressed(file, (int64) newFile * MAX_PHYSICAL_FILESIZE +
+									 newOffset);
 	while (newOffset < 0)
 	{
 		if (--newFile < 0)
@@ -886,6 +1114,7 @@ BufFileSize(BufFile *file)
 	int64		lastFileSize;
 
 	Assert(file->fileset != NULL);
+	Assert(!file->compressed);
 
 	/* Get the size of the last physical file. */
 	lastFileSize = FileSize(file->files[file->numFiles - 1]);
@@ -927,6 +1156,7 @@ BufFileAppend(BufFile *target, BufFile *source)
 	int			i;
 
 	Assert(target->fileset != NULL);
+	Assert(!target->compressed && !source->compressed);
 	Assert(source->readOnly);
 	Assert(!source->dirty);
 	Assert(source->fileset != NULL);
@@ -956,6 +1186,8 @@ BufFileTruncateFileSet(BufFile *file, int fileno, off_t offset)
 	char		segment_name[MAXPGPATH];
 	int			i;
 
+	Assert(!file->compressed);
+
 	/*
 	 * Loop over all the files up to the given fileno and remove the files
 	 * that are greater than the fileno and truncate the given file up to the
@@ -1037,3 +1269,426 @@ BufFileTruncateFileSet(BufFile *file, int fileno, off_t offset)
 	}
 	/* Nothing to do, if the truncate point is beyond current file. */
 }
+
+/*
+ * Read up to len bytes at the given position in the physical files, crossing
+ * into later files as needed, and advance the position past them.  Returns
+ * the number of bytes read, which is less than len only at end of file.
+ */
+static size_t
+BufFileReadAt(BufFile *file, int *fileno, off_t *offset, char *ptr,
+			  size_t len)
+{
+	size_t		nread = 0;
+
+	while (nread < len)
+	{
+		File		thisfile;
+		size_t		nthistime;
+		int			nbytes;
+		instr_time	io_start;
+		instr_time	io_time;
+
+		/*
+		 * Advance to next component file if necessary and possible.
+		 */
+		if (*offset >= MAX_PHYSICAL_FILESIZE)
+		{
+			if (*fileno + 1 >= file->numFiles)
+				break;
+			(*fileno)++;
+			*offset = 0;
+		}
+
+		thisfile = file->files[*fileno];
+		nthistime = Min(len - nread,
+						(size_t) (MAX_PHYSICAL_FILESIZE - *offset));
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+		else
+			INSTR_TIME_SET_ZERO(io_start);
+
+		nbytes = FileRead(thisfile, ptr + nread, nthistime, *offset,
+						  WAIT_EVENT_BUFFILE_READ);
+		if (nbytes < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							FilePathName(thisfile))));
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_ACCUM_DIFF(pgBufferUsage.temp_blk_read_time, io_time, io_start);
+		}
+
+		if (nbytes == 0)
+			break;				/* end of file */
+
+		*offset += nbytes;
+		nread += nbytes;
+		pgBufferUsage.temp_blks_read += (nbytes + BLCKSZ - 1) / BLCKSZ;
+	}
+
+	return nread;
+}
+
+/*
+ * Write len bytes at the given position in the physical files, adding files
+ * as needed, and advance the position past them.
+ */
+static void
+BufFileWriteAt(BufFile *file, int *fileno, off_t *offset, const char *ptr,
+			   size_t len)
+{
+	size_t		nwritten = 0;
+
+	while (nwritten < len)
+	{
+		File		thisfile;
+		size_t		nthistime;
+		int			nbytes;
+		instr_time	io_start;
+		instr_time	io_time;
+
+		/*
+		 * Advance to next component file if necessary and possible.
+		 */
+		if (*offset >= MAX_PHYSICAL_FILESIZE)
+		{
+			while (*fileno + 1 >= file->numFiles)
+				extendBufFile(file);
+			(*fileno)++;
+			*offset = 0;
+		}
+
+		thisfile = file->files[*fileno];
+		nthistime = Min(len - nwritten,
+						(size_t) (MAX_PHYSICAL_FILESIZE - *offset));
+
+		if (track_io_timing)
+			INSTR_TIME_SET_CURRENT(io_start);
+		else
+			INSTR_TIME_SET_ZERO(io_start);
+
+		nbytes = FileWrite(thisfile, ptr + nwritten, nthistime, *offset,
+						   WAIT_EVENT_BUFFILE_WRITE);
+		if (nbytes <= 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							FilePathName(thisfile))));
+
+		if (track_io_timing)
+		{
+			INSTR_TIME_SET_CURRENT(io_time);
+			INSTR_TIME_ACCUM_DIFF(pgBufferUsage.temp_blk_write_time, io_time, io_start);
+		}
+
+		*offset += nbytes;
+		nwritten += nbytes;
+		pgBufferUsage.temp_blks_written += (nbytes + BLCKSZ - 1) / BLCKSZ;
+	}
+}
+
+/*
+ * Convert a physical offset in a compressed file to a position in its files.
+ * An offset at the boundary of two files is taken to be the end of the first,
+ * since the second might not exist yet.
+ */
+static void
+BufFilePhysicalPosition(int64 physical, int *fileno, off_t *offset)
+{
+	*fileno = physical / MAX_PHYSICAL_FILESIZE;
+	*offset = physical % MAX_PHYSICAL_FILESIZE;
+	if (*offset == 0 && *fileno > 0)
+	{
+		(*fileno)--;
+		*offset = MAX_PHYSICAL_FILESIZE;
+	}
+}
+
+/*
+ * Read len bytes at the given physical offset of a compressed file, from the
+ * data read ahead if it has them.  Otherwise, if readahead is true, read
+ * BUFFILE_READAHEAD_SIZE bytes from there, and take the data from those.
+ */
+static void
+BufFileReadPhysical(BufFile *file, int64 physical, char *ptr, size_t len,
+					bool readahead)
+{
+	int			fileno;
+	off_t		offset;
+	size_t		nread;
+
+	if (file->raLen > 0 && physical >= file->raStart &&
+		physical + len <= file->raStart + file->raLen)
+	{
+		memcpy(ptr, file->readahead + (physical - file->raStart), len);
+		return;
+	}
+
+	BufFilePhysicalPosition(physical, &fileno, &offset);
+	if (readahead)
+	{
+		if (file->readahead == NULL)
+			file->readahead = MemoryContextAlloc(GetMemoryChunkContext(file),
+												 BUFFILE_READAHEAD_SIZE);
+		file->raStart = physical;
+		file->raLen = BufFileReadAt(file, &fileno, &offset, file->readahead,
+									Min(BUFFILE_READAHEAD_SIZE,
+										file->physEnd - physical));
+		nread = Min(len, file->raLen);
+		memcpy(ptr, file->readahead, nread);
+	}
+	else
+		nread = BufFileReadAt(file, &fileno, &offset, ptr, len);
+
+	if (nread != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from temporary file: read only %zu of %zu bytes",
+						nread, len)));
+}
+
+/*
+ * Remember the position of frame, which must be the next one to remember.
+ */
+static void
+BufFileAddCheckpoint(BufFile *file, const BufFileFramePos *frame)
+{
+	Assert(frame->frameno == file->nckpts * BUFFILE_CKPT_FRAMES);
+
+	if (file->nckpts >= file->maxckpts)
+	{
+		file->maxckpts *= 2;
+		file->ckpts = repalloc(file->ckpts,
+							   sizeof(BufFileFramePos) * file->maxckpts);
+	}
+	file->ckpts[file->nckpts++] = *frame;
+}
+
+/*
+ * Find the frame of a compressed file that holds the given offset of the
+ * uncompressed contents, and read its header.  If the offset is at or past
+ * the end of the contents, return false, with the end of the file in *frame,
+ * otherwise true.
+ *
+ * We start from the hint or the closest remembered frame before the offset,
+ * whichever is closer, and follow the frame headers from there.
+ */
+static bool
+BufFileFindFrame(BufFile *file, int64 target, BufFileFramePos *frame,
+				 BufFileFrameHeader *hdr)
+{
+	BufFileFramePos pos;
+	int64		lo = 0;
+	int64		hi = file->nckpts - 1;
+
+	while (lo < hi)
+	{
+		int64		mid = (lo + hi + 1) / 2;
+
+		if (file->ckpts[mid].logical <= target)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	pos = file->ckpts[lo];
+	if (file->hint.logical <= target && file->hint.logical > pos.logical)
+		pos = file->hint;
+
+	for (;;)
+	{
+		bool		readahead;
+
+		if (pos.physical >= file->physEnd)
+		{
+			file->logicalEnd = pos.logical;
+			*frame = pos;
+			return false;
+		}
+
+		if (pos.frameno == file->nckpts * BUFFILE_CKPT_FRAMES)
+			BufFileAddCheckpoint(file, &pos);
+
+		/* while reading sequentially, the header comes first */
+		readahead = (pos.physical == file->loadedEnd &&
+					 file->seqFrames >= BUFFILE_READAHEAD_FRAMES);
+		BufFileReadPhysical(file, pos.physical, (char *) hdr,
+							sizeof(BufFileFrameHeader), readahead);
+		if (hdr->rawlen == 0 || hdr->rawlen > BLCKSZ ||
+			(hdr->method == WAL_COMPRESSION_NONE ?
+			 hdr->len != hdr->rawlen : hdr->len >= hdr->rawlen))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg_internal("invalid frame header in temporary file \"%s\" at offset " INT64_FORMAT,
+									 FilePathName(file->files[0]),
+									 pos.physical)));
+
+		if (target < pos.logical + hdr->rawlen)
+		{
+			*frame = pos;
+			return true;
+		}
+
+		pos.frameno++;
+		pos.logical += hdr->rawlen;
+		pos.physical += sizeof(BufFileFrameHeader) + hdr->len;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * BufFileLoadBuffer for compressed files: load the frame holding the position
+ * curFile/curOffset, and point curFile/curOffset at its start and pos at the
+ * position.  At end of file, nbytes is left 0.
+ */
+static void
+BufFileLoadFrame(BufFile *file)
+{
+	int64		target;
+	BufFileFramePos frame;
+	BufFileFrameHeader hdr;
+	char	   *data;
+
+	target = (int64) file->curFile * MAX_PHYSICAL_FILESIZE + file->curOffset;
+	if (!BufFileFindFrame(file, target, &frame, &hdr))
+		return;
+
+	if (frame.physical == file->loadedEnd)
+		file->seqFrames++;
+	else
+		file->seqFrames = 0;
+
+	data = hdr.method == WAL_COMPRESSION_NONE ? file->buffer.data :
+		frame_buffer;
+	BufFileReadPhysical(file, frame.physical + sizeof(BufFileFrameHeader),
+						data, hdr.len,
+						file->seqFrames >= BUFFILE_READAHEAD_FRAMES);
+	if (hdr.method != WAL_COMPRESSION_NONE &&
+		!XLogDecompressData(hdr.method, data, hdr.len,
+							file->buffer.data, hdr.rawlen))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg_internal("could not decompress frame of temporary file \"%s\" at offset " INT64_FORMAT,
+								 FilePathName(file->files[0]),
+								 frame.physical)));
+
+	/* the next frame is the likely one to be wanted next */
+	file->hint.frameno = frame.frameno + 1;
+	file->hint.logical = frame.logical + hdr.rawlen;
+	file->hint.physical = frame.physical + sizeof(BufFileFrameHeader) + hdr.len;
+	file->loadedEnd = file->hint.physical;
+
+	file->curFile = frame.logical / MAX_PHYSICAL_FILESIZE;
+	file->curOffset = frame.logical % MAX_PHYSICAL_FILESIZE;
+	file->pos = (int) (target - frame.logical);
+	file->nbytes = hdr.rawlen;
+}
+
+/*
+ * BufFileDumpBuffer for compressed files: write the buffer out as a new frame
+ * at the end of the file, compressed unless that doesn't make it smaller.
+ */
+static void
+BufFileDumpFrame(BufFile *file)
+{
+	int64		start;
+	BufFileFramePos frame;
+	BufFileFrameHeader hdr;
+	int			len;
+	int			fileno;
+	off_t		offset;
+
+	start = (int64) file->curFile * MAX_PHYSICAL_FILESIZE + file->curOffset;
+	if (start != file->logicalEnd)
+		elog(ERROR, "compressed temporary file can only be written at its end");
+
+	frame.frameno = file->nframes;
+	frame.logical = file->logicalEnd;
+	frame.physical = file->physEnd;
+
+	len = XLogCompressData(file->compression, file->buffer.data, file->nbytes,
+						   frame_buffer + sizeof(BufFileFrameHeader),
+						   file->nbytes - 1);
+	if (len < 0)
+	{
+		hdr.method = WAL_COMPRESSION_NONE;
+		len = file->nbytes;
+		memcpy(frame_buffer + sizeof(BufFileFrameHeader), file->buffer.data,
+			   len);
+	}
+	else
+		hdr.method = file->compression;
+	hdr.rawlen = file->nbytes;
+	hdr.len = len;
+	memcpy(frame_buffer, &hdr, sizeof(BufFileFrameHeader));
+
+	if (frame.frameno == file->nckpts * BUFFILE_CKPT_FRAMES)
+		BufFileAddCheckpoint(file, &frame);
+
+	BufFilePhysicalPosition(frame.physical, &fileno, &offset);
+	BufFileWriteAt(file, &fileno, &offset, frame_buffer,
+				   sizeof(BufFileFrameHeader) + len);
+
+	file->nframes++;
+	file->physEnd += sizeof(BufFileFrameHeader) + len;
+	file->logicalEnd += file->nbytes;
+	file->hint.frameno = file->nframes;
+	file->hint.logical = file->logicalEnd;
+	file->hint.physical = file->physEnd;
+	file->dirty = false;
+
+	/* as in BufFileDumpBuffer, the position is left where the caller was */
+	start += file->pos;
+	file->curFile = start / MAX_PHYSICAL_FILESIZE;
+	file->curOffset = start % MAX_PHYSICAL_FILESIZE;
+	file->pos = 0;
+	file->nbytes = 0;
+}
+
+/*
+ * BufFileSeek for compressed files, to the given offset of the uncompressed
+ * contents.
+ */
+static int
+BufFileSeekCompressed(BufFile *file, int64 target)
+{
+	int64		start;
+
+	if (target < 0)
+		return EOF;
+
+	start = (int64) file->curFile * MAX_PHYSICAL_FILESIZE + file->curOffset;
+	if (target >= start && target <= start + file->nbytes)
+	{
+		/* Seek is within current buffer; nothing to do. */
+		file->pos = (int) (target - start);
+		return 0;
+	}
+
+	/* Otherwise, must reposition buffer, so flush any dirty data */
+	BufFileFlush(file);
+
+	if (file->logicalEnd < 0 || target > file->logicalEnd)
+	{
+		BufFileFramePos frame;
+		BufFileFrameHeader hdr;
+
+		if (file->logicalEnd >= 0)
+			return EOF;
+		if (BufFileFindFrame(file, target, &frame, &hdr))
+			file->hint = frame;
+		else if (target > frame.logical)
+			return EOF;
+	}
+
+	file->curFile = target / MAX_PHYSICAL_FILESIZE;
+	file->curOffset = target % MAX_PHYSICAL_FILESIZE;
+	file->pos = 0;
+	file->nbytes = 0;
+	return 0;
+}
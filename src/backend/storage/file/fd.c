@@ -206,6 +206,8 @@ typedef struct vfd
 	/* NB: fileName is malloc'd, and must be free'd when closing the VFD */
 	int			fileFlags;		/* open(2) flags for (re)opening the file */
 	mode_t		fileMode;		/* mode to pass to open(2) */
+	int			ownerSlot;		/* temp file owner slot charged, or -1 */
+	uint32		ownerGeneration;	/* generation of that slot */
 } Vfd;
 
 /*
@@ -235,6 +237,26 @@ static bool have_xact_temporary_files = false;
  */
 static uint64 temporary_files_size = 0;
 
+/*
+ * Temporary file usage of the TempFileOwners that have created temporary
+ * files, indexed by TempFileOwner.slot.  A slot is taken when a temporary
+ * file is first created under an owner, and mirrored in our backend status
+ * entry for pg_stat_progress_temp_files.  Its generation is advanced when
+ * it's released, so that the files still charged to it are left alone from
+ * then on.  When all slots are in use, further owners' files are charged to
+ * nobody but temp_file_limit.
+ */
+typedef struct TempFileOwnerSlot
+{
+	bool		in_use;
+	uint32		generation;
+	PgBackendTempFileNode usage;
+} TempFileOwnerSlot;
+
+static TempFileOwnerSlot tempFileOwnerSlots[PGSTAT_NUM_TEMP_FILE_NODES];
+
+TempFileOwner *CurrentTempFileOwner = NULL;
+
 /* Temporary file access initialized and not yet shut down? */
 #ifdef USE_ASSERT_CHECKING
 static bool temporary_files_allowed = false;
@@ -333,6 +355,11 @@ static void FreeVfd(File file);
 
 static int	FileAccess(File file);
 static File OpenTemporaryFileInTablespace(Oid tblspcOid, bool rejectError);
+static void ChargeTemporaryFile(File file);
+static void UpdateTempFileOwnerUsage(Vfd *vfdP, int64 size_delta,
+									 int64 bytes_written);
+static int	TempFileOwnerDetail(Vfd *vfdP);
+static void ReleaseTempFileOwnerSlot(int slotno);
 static bool reserveAllocatedDesc(void);
 static int	FreeDesc(AllocateDesc *desc);
 
@@ -1508,6 +1535,165 @@ RegisterTemporaryFile(File file)
 	have_xact_temporary_files = true;
 }
 
+/*
+ * Set up a TempFileOwner.  It doesn't take a slot until a temporary file is
+ * created under it.
+ */
+void
+InitTempFileOwner(TempFileOwner *owner, int plan_node_id,
+				  const char *node_type)
+{
+	owner->plan_node_id = plan_node_id;
+	owner->node_type = node_type;
+	owner->slot = -1;
+	owner->generation = 0;
+}
+
+/*
+ * Charge a newly created temporary file to CurrentTempFileOwner, taking a
+ * slot for the owner if it doesn't have one yet.
+ */
+static void
+ChargeTemporaryFile(File file)
+{
+	TempFileOwner *owner = CurrentTempFileOwner;
+	TempFileOwnerSlot *slot;
+	Vfd		   *vfdP = &VfdCache[file];
+
+	if (owner == NULL)
+		return;
+
+	if (owner->slot < 0 ||
+		tempFileOwnerSlots[owner->slot].generation != owner->generation)
+	{
+		int			slotno;
+
+		for (slotno = 0; slotno < PGSTAT_NUM_TEMP_FILE_NODES; slotno++)
+		{
+			if (!tempFileOwnerSlots[slotno].in_use)
+				break;
+		}
+		if (slotno >= PGSTAT_NUM_TEMP_FILE_NODES)
+			return;
+
+		slot = &tempFileOwnerSlots[slotno];
+		slot->in_use = true;
+		memset(&slot->usage, 0, sizeof(slot->usage));
+		slot->usage.plan_node_id = owner->plan_node_id;
+		strlcpy(slot->usage.node_type, owner->node_type,
+				sizeof(slot->usage.node_type));
+
+		owner->slot = slotno;
+		owner->generation = slot->generation;
+	}
+
+	slot = &tempFileOwnerSlots[owner->slot];
+	slot->usage.files++;
+	vfdP->ownerSlot = owner->slot;
+	vfdP->ownerGeneration = owner->generation;
+
+	pgstat_progress_report_temp_files(owner->slot, &slot->usage);
+}
+
+/*
+ * Account for a change in size of a temporary file, and for bytes written
+ * to it, in the usage of the owner it's charged to.
+ */
+static void
+UpdateTempFileOwnerUsage(Vfd *vfdP, int64 size_delta, int64 bytes_written)
+{
+	TempFileOwnerSlot *slot;
+
+	if (vfdP->ownerSlot < 0)
+		return;
+
+	slot = &tempFileOwnerSlots[vfdP->ownerSlot];
+	if (slot->generation != vfdP->ownerGeneration)
+		return;
+
+	slot->usage.size += size_delta;
+	slot->usage.peak_size = Max(slot->usage.peak_size, slot->usage.size);
+	slot->usage.bytes_written += bytes_written;
+
+	pgstat_progress_report_temp_files(vfdP->ownerSlot, &slot->usage);
+}
+
+/*
+ * errdetail() naming the owner of a temporary file, for the errors about
+ * temporary file limits.
+ */
+static int
+TempFileOwnerDetail(Vfd *vfdP)
+{
+	TempFileOwnerSlot *slot;
+
+	if (vfdP->ownerSlot < 0)
+		return 0;
+
+	slot = &tempFileOwnerSlots[vfdP->ownerSlot];
+	if (slot->generation != vfdP->ownerGeneration)
+		return 0;
+
+	return errdetail("The file was being written by plan node %d (%s), whose temporary files take %lld kB.",
+					 slot->usage.plan_node_id, slot->usage.node_type,
+					 (long long) (slot->usage.size / 1024));
+}
+
+static void
+ReleaseTempFileOwnerSlot(int slotno)
+{
+	TempFileOwnerSlot *slot = &tempFileOwnerSlots[slotno];
+
+	slot->in_use = false;
+	slot->generation++;
+	memset(&slot->usage, 0, sizeof(slot->usage));
+	slot->usage.plan_node_id = -1;
+
+	pgstat_progress_report_temp_files(slotno, &slot->usage);
+}
+
+/*
+ * Give up the slot of a TempFileOwner going away.  Its files that are still
+ * open aren't charged to anybody from then on.
+ */
+void
+ReleaseTempFileOwner(TempFileOwner *owner)
+{
+	if (owner->slot >= 0 &&
+		tempFileOwnerSlots[owner->slot].generation == owner->generation)
+		ReleaseTempFileOwnerSlot(owner->slot);
+
+	owner->slot = -1;
+
+	if (CurrentTempFileOwner == owner)
+		CurrentTempFileOwner = NULL;
+}
+
+/*
+ * Get the temporary file usage of a TempFileOwner: the number of files
+ * created, bytes written, and the largest total size of its files.  Returns
+ * false if it has never had any temporary files charged, or has given up
+ * its slot already.
+ */
+bool
+GetTempFileOwnerUsage(TempFileOwner *owner, int *files,
+					  int64 *bytes_written, int64 *peak_size)
+{
+	TempFileOwnerSlot *slot;
+
+	if (owner->slot < 0)
+		return false;
+
+	slot = &tempFileOwnerSlots[owner->slot];
+	if (slot->generation != owner->generation)
+		return false;
+
+	*files = slot->usage.files;
+	*bytes_written = slot->usage.bytes_written;
+	*peak_size = slot->usage.peak_size;
+	return true;
+}
+
 /*
  *	Called when we get a shared invalidation message on some relation.
  */
@@ -1591,6 +1777,7 @@ PathNameOpenFilePerm(const char *fileName, int fileFlags, mode_t fileMode)
 	vfdP->fileFlags = fileFlags & ~(O_CREAT | O_TRUNC | O_EXCL);
 	vfdP->fileMode = fileMode;
 	vfdP->fileSize = 0;
+	vfdP->ownerSlot = -1;
 	vfdP->fdstate = 0x0;
 	vfdP->resowner = NULL;
 
@@ -1719,6 +1906,9 @@ OpenTemporaryFile(bool interXact)
 	/* Mark it for deletion at close and temporary file size limit */
 	VfdCache[file].fdstate |= FD_DELETE_AT_CLOSE | FD_TEMP_FILE_LIMIT;
 
+	/* Charge it to its owner, if any */
+	ChargeTemporaryFile(file);
+
 	/* Register it with the current resource owner */
 	if (!interXact)
 		RegisterTemporaryFile(file);
@@ -1839,6 +2029,9 @@ PathNameCreateTemporaryFile(const char *path, bool error_on_failure)
 	/* Mark it for temp_file_limit accounting. */
 	VfdCache[file].fdstate |= FD_TEMP_FILE_LIMIT;
 
+	/* Charge it to its owner, if any */
+	ChargeTemporaryFile(file);
+
 	/* Register it for automatic close. */
 	RegisterTemporaryFile(file);
 
@@ -1964,6 +2157,8 @@ FileClose(File file)
 	{
 		/* Subtract its size from current usage (do first in case of error) */
 		temporary_files_size -= vfdP->fileSize;
+		UpdateTempFileOwnerUsage(vfdP, -vfdP->fileSize, 0);
+		vfdP->ownerSlot = -1;
 		vfdP->fileSize = 0;
 	}
 
@@ -2087,18 +2282,18 @@ FileWriteback(File file, off_t offset, off_t nbytes, uint32 wait_event_info)
 }
 
 int
-FileRead(File file, void *buffer, size_t amount, off_t offset,
-		 uint32 wait_event_info)
+FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		  uint32 wait_event_info)
 {
 	int			returnCode;
 	Vfd		   *vfdP;
 
 	Assert(FileIsValid(file));
 
-	DO_DB(elog(LOG, "FileRead: %d (%s) " INT64_FORMAT " %zu %p",
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d",
 			   file, VfdCache[file].fileName,
 			   (int64) offset,
-			   amount, buffer));
+			   iovcnt));
 
 	returnCode = FileAccess(file);
 	if (returnCode < 0)
@@ -2108,7 +2303,7 @@ FileRead(File file, void *buffer, size_t amount, off_t offset,
 
 retry:
 	pgstat_report_wait_start(wait_event_info);
-	returnCode = pg_pread(vfdP->fd, buffer, amount, offset);
+	returnCode = pg_preadv(vfdP->fd, iov, iovcnt, offset);
 	pgstat_report_wait_end();
 
 	if (returnCode < 0)
@@ -2142,19 +2337,81 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileStartReadV - start an asynchronous read into iov
+ *
+ * The I/O is handed to the AIO subsystem using the given handle, which
+ * belongs to it from then on; see storage/aio.h.  Returns 0, or -1 with
+ * errno set if the file couldn't be made accessible, in which case the
+ * handle is still the caller's.
+ */
 int
-FileWrite(File file, const void *buffer, size_t amount, off_t offset,
-		  uint32 wait_event_info)
+FileStartReadV(PgAioHandle *ioh, File file, const struct iovec *iov,
+			   int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileStartReadV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	pgaio_io_start_readv(ioh, VfdCache[file].fd, iov, iovcnt, offset);
+
+	return 0;
+}
+
+/*
+ * FileStartWriteV - start an asynchronous write of iov
+ *
+ * Like FileStartReadV().  Unlike FileWrite(), this doesn't enforce
+ * temp_file_limit, so it mustn't be used to extend temporary files.
+ */
+int
+FileStartWriteV(PgAioHandle *ioh, File file, const struct iovec *iov,
+				int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileStartWriteV: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset,
+			   iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	pgaio_io_start_writev(ioh, VfdCache[file].fd, iov, iovcnt, offset);
+
+	return 0;
+}
+
+int
+FileWriteV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		   uint32 wait_event_info)
 {
 	int			returnCode;
 	Vfd		   *vfdP;
+	size_t		amount = 0;
 
 	Assert(FileIsValid(file));
 
-	DO_DB(elog(LOG, "FileWrite: %d (%s) " INT64_FORMAT " %zu %p",
+	DO_DB(elog(LOG, "FileWriteV: %d (%s) " INT64_FORMAT " %d",
 			   file, VfdCache[file].fileName,
 			   (int64) offset,
-			   amount, buffer));
+			   iovcnt));
+
+	for (int i = 0; i < iovcnt; i++)
+		amount += iov[i].iov_len;
 
 	returnCode = FileAccess(file);
 	if (returnCode < 0)
@@ -2183,14 +2440,32 @@ FileWrite(File file, const void *buffer, size_t amount, off_t offset,
 				ereport(ERROR,
 						(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
 						 errmsg("temporary file size exceeds temp_file_limit (%dkB)",
-								temp_file_limit)));
+								temp_file_limit),
+						 TempFileOwnerDetail(vfdP)));
 		}
 	}
 
+	/* Likewise for node_temp_file_limit, if the file has an owner */
+	if (node_temp_file_limit >= 0 && vfdP->ownerSlot >= 0)
+	{
+		off_t		past_write = offset + amount;
+		TempFileOwnerSlot *slot = &tempFileOwnerSlots[vfdP->ownerSlot];
+
+		if (past_write > vfdP->fileSize &&
+			slot->generation == vfdP->ownerGeneration &&
+			slot->usage.size + (past_write - vfdP->fileSize) >
+			(int64) node_temp_file_limit * 1024)
+			ereport(ERROR,
+					(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+					 errmsg("temporary file size exceeds node_temp_file_limit (%dkB)",
+							node_temp_file_limit),
+					 TempFileOwnerDetail(vfdP)));
+	}
+
 retry:
 	errno = 0;
 	pgstat_report_wait_start(wait_event_info);
-	returnCode = pg_pwrite(VfdCache[file].fd, buffer, amount, offset);
+	returnCode = pg_pwritev(VfdCache[file].fd, iov, iovcnt, offset);
 	pgstat_report_wait_end();
 
 	/* if write didn't set errno, assume problem is no disk space */
@@ -2205,12 +2480,15 @@ retry:
 		if (vfdP->fdstate & FD_TEMP_FILE_LIMIT)
 		{
 			off_t		past_write = offset + amount;
+			int64		growth = 0;
 
 			if (past_write > vfdP->fileSize)
 			{
-				temporary_files_size += past_write - vfdP->fileSize;
+				growth = past_write - vfdP->fileSize;
+				temporary_files_size += growth;
 				vfdP->fileSize = past_write;
 			}
+			UpdateTempFileOwnerUsage(vfdP, growth, returnCode);
 		}
 	}
 	else
@@ -2392,6 +2670,8 @@ FileTruncate(File file, off_t offset, uint32 wait_event_info)
 		/* adjust our state for truncation of a temp file */
 		Assert(VfdCache[file].fdstate & FD_TEMP_FILE_LIMIT);
 		temporary_files_size -= VfdCache[file].fileSize - offset;
+		UpdateTempFileOwnerUsage(&VfdCache[file],
+								 offset - VfdCache[file].fileSize, 0);
 		VfdCache[file].fileSize = offset;
 	}
 
@@ -3094,6 +3374,14 @@ AtEOSubXact_Files(bool isCommit, SubTransactionId mySubid,
 			}
 		}
 	}
+
+	/*
+	 * The owner may have been a plan node of the executor that failed, whose
+	 * memory is going away.  Temporary files created in the rest of the
+	 * parent's current node aren't charged to it, then.
+	 */
+	if (!isCommit)
+		CurrentTempFileOwner = NULL;
 }
 
 /*
@@ -3114,6 +3402,14 @@ AtEOXact_Files(bool isCommit)
 	CleanupTempFiles(isCommit, false);
 	tempTableSpaces = NULL;
 	numTempTableSpaces = -1;
+
+	/* Release any temp file owner slots left behind by failed queries */
+	CurrentTempFileOwner = NULL;
+	for (int i = 0; i < PGSTAT_NUM_TEMP_FILE_NODES; i++)
+	{
+		if (tempFileOwnerSlots[i].in_use)
+			ReleaseTempFileOwnerSlot(i);
+	}
 }
 
 /*
@@ -3886,7 +4182,7 @@ data_sync_elevel(int elevel)
 }
 
 bool
-check_debug_io_direct(char **newval, void **extra, GucSource source)
+check_io_direct(char **newval, void **extra, GucSource source)
 {
 	bool		result = true;
 	int			flags;
@@ -3894,7 +4190,7 @@ check_debug_io_direct(char **newval, void **extra, GucSource source)
 #if PG_O_DIRECT == 0
 	if (strcmp(*newval, "") != 0)
 	{
-		GUC_check_errdetail("debug_io_direct is not supported on this platform.");
+		GUC_check_errdetail("io_direct is not supported on this platform.");
 		result = false;
 	}
 	flags = 0;
@@ -3909,7 +4205,7 @@ check_debug_io_direct(char **newval, void **extra, GucSource source)
 	if (!SplitGUCList(rawstring, ',', &elemlist))
 	{
 		GUC_check_errdetail("invalid list syntax in parameter \"%s\"",
-							"debug_io_direct");
+							"io_direct");
 		pfree(rawstring);
 		list_free(elemlist);
 		return false;
@@ -3941,14 +4237,14 @@ check_debug_io_direct(char **newval, void **extra, GucSource source)
 #if XLOG_BLCKSZ < PG_IO_ALIGN_SIZE
 	if (result && (flags & (IO_DIRECT_WAL | IO_DIRECT_WAL_INIT)))
 	{
-		GUC_check_errdetail("debug_io_direct is not supported for WAL because XLOG_BLCKSZ is too small");
+		GUC_check_errdetail("io_direct is not supported for WAL because XLOG_BLCKSZ is too small");
 		result = false;
 	}
 #endif
 #if BLCKSZ < PG_IO_ALIGN_SIZE
 	if (result && (flags & IO_DIRECT_DATA))
 	{
-		GUC_check_errdetail("debug_io_direct is not supported for data because BLCKSZ is too small");
+		GUC_check_errdetail("io_direct is not supported for data because BLCKSZ is too small");
 		result = false;
 	}
 #endif
@@ -3960,15 +4256,15 @@ check_debug_io_direct(char **newval, void **extra, GucSource source)
 	if (!result)
 		return result;
 
-	/* Save the flags in *extra, for use by assign_debug_io_direct */
+	/* Save the flags in *extra, for use by assign_io_direct */
 	*extra = guc_malloc(ERROR, sizeof(int));
 	*((int *) *extra) = flags;
 
 	return result;
 }
 
-extern void
-assign_debug_io_direct(const char *newval, void *extra)
+void
+assign_io_direct(const char *newval, void *extra)
 {
 	int		   *flags = (int *) extra;
 
@@ -19,6 +19,13 @@
  *	index access methods that need it (see also indexfsm.c). See README for
  *	more information.
  *
+ *	Concurrent searches for free space tend to all be sent to the same page,
+ *	and the inserters then queue up for its buffer lock.  Unless
+ *	fsm_spread_inserts is turned off, each backend therefore starts its
+ *	searches of an FSM page at its own offset and breaks ties randomly on
+ *	the way down, and pages that were just handed out to some other backend
+ *	are avoided, see fsm_search_spread().
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -26,10 +33,14 @@
 #include "access/htup_details.h"
 #include "access/xloginsert.h"
 #include "access/xlogutils.h"
+#include "common/hashfn.h"
 #include "miscadmin.h"
+#include "port/atomics.h"
 #include "storage/freespace.h"
 #include "storage/fsm_internals.h"
 #include "storage/lmgr.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
 
 
@@ -90,6 +101,29 @@ typedef struct
 /* Address of the root page. */
 static const FSMAddress FSM_ROOT_ADDRESS = {FSM_ROOT_LEVEL, 0};
 
+/*
+ * Recently handed out pages.  Each backend advertises the page it was last
+ * given by a search in a small shared hash table, keyed by relation and
+ * block number, and a search that lands on a page some other backend was
+ * just given tries again, up to FSM_HANDOUT_RETRIES times.  The entries are
+ * just hints: colliding pages overwrite each other, and an entry is
+ * withdrawn when its backend is given its next page.
+ *
+ * Each entry holds the hash of the page in the high half and the pgprocno
+ * of the backend plus one in the low half; zero is unused.
+ */
+#define FSM_HANDOUT_SLOTS	1024
+#define FSM_HANDOUT_RETRIES 2
+
+static pg_atomic_uint64 *FreeSpaceMapHandouts = NULL;
+
+/* our own entry in FreeSpaceMapHandouts, if any */
+static int	fsm_my_handout_slot = -1;
+static uint64 fsm_my_handout = 0;
+
+/* GUC */
+bool		fsm_spread_inserts = true;
+
 /* functions to navigate the tree */
 static FSMAddress fsm_get_child(FSMAddress parent, uint16 slot);
 static FSMAddress fsm_get_parent(FSMAddress child, uint16 *slot);
@@ -109,6 +143,12 @@ static Size fsm_space_cat_to_avail(uint8 cat);
 static int	fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 							   uint8 newValue, uint8 minValue);
 static BlockNumber fsm_search(Relation rel, uint8 min_cat);
+static BlockNumber fsm_search_spread(Relation rel, uint8 min_cat);
+static int	fsm_search_multi(Relation rel, FSMAddress addr, uint8 min_cat,
+							 BlockNumber *pages, int npages);
+static uint32 fsm_handout_hash(Relation rel, BlockNumber heapBlk);
+static bool fsm_handed_out_elsewhere(Relation rel, BlockNumber heapBlk);
+static void fsm_record_handout(Relation rel, BlockNumber heapBlk);
 static uint8 fsm_vacuum_page(Relation rel, FSMAddress addr,
 							 BlockNumber start, BlockNumber end,
 							 bool *eof_p);
@@ -134,7 +174,29 @@ GetPageWithFreeSpace(Relation rel, Size spaceNeeded)
 {
 	uint8		min_cat = fsm_space_needed_to_cat(spaceNeeded);
 
-	return fsm_search(rel, min_cat);
+	return fsm_search_spread(rel, min_cat);
+}
+
+/*
+ * GetPagesWithFreeSpace - try to find up to npages pages in the given
+ *		relation with at least the specified amount of free space.
+ *
+ * This is for callers that know they are going to fill several pages, like
+ * heap_multi_insert().  All the pages are collected in one walk of the FSM
+ * tree and stored in pages[]; returns how many were found.  As with
+ * GetPageWithFreeSpace, any of them may turn out to have too little space
+ * by the time the caller gets to it.
+ */
+int
+GetPagesWithFreeSpace(Relation rel, Size spaceNeeded, BlockNumber *pages,
+					  int npages)
+{
+	uint8		min_cat = fsm_space_needed_to_cat(spaceNeeded);
+
+	if (npages <= 0)
+		return 0;
+
+	return fsm_search_multi(rel, FSM_ROOT_ADDRESS, min_cat, pages, npages);
 }
 
 /*
@@ -162,13 +224,23 @@ RecordAndGetPageWithFreeSpace(Relation rel, BlockNumber oldPage,
 	search_slot = fsm_set_and_search(rel, addr, slot, old_cat, search_cat);
 
 	/*
-	 * If fsm_set_and_search found a suitable new block, return that.
-	 * Otherwise, search as usual.
+	 * If fsm_set_and_search found a suitable new block, return that, unless
+	 * some other backend was just given it.  Otherwise, search as usual.
 	 */
 	if (search_slot != -1)
-		return fsm_get_heap_blk(addr, search_slot);
-	else
-		return fsm_search(rel, search_cat);
+	{
+		BlockNumber blkno = fsm_get_heap_blk(addr, search_slot);
+
+		if (!fsm_spread_inserts)
+			return blkno;
+		if (!fsm_handed_out_elsewhere(rel, blkno))
+		{
+			fsm_record_handout(rel, blkno);
+			return blkno;
+		}
+	}
+
+	return fsm_search_spread(rel, search_cat);
 }
 
 /*
@@ -191,6 +263,48 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * RecordRangeWithFreeSpace - update info about a range of pages.
+ *
+ * Like RecordPageWithFreeSpace, setting the same value for each block from
+ * startBlk to endBlk (inclusive).  Each FSM page is locked only once, which
+ * matters when registering the many new pages of a bulk relation extension.
+ */
+void
+RecordRangeWithFreeSpace(Relation rel, BlockNumber startBlk,
+						 BlockNumber endBlk, Size spaceAvail)
+{
+	int			new_cat = fsm_space_avail_to_cat(spaceAvail);
+	BlockNumber blkno = startBlk;
+
+	while (blkno <= endBlk)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		changed = false;
+
+		addr = fsm_get_location(blkno, &slot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		/* set all the slots for our range that are on this FSM page */
+		for (; slot < SlotsPerFSMPage && blkno <= endBlk; slot++, blkno++)
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				changed = true;
+		}
+
+		if (changed)
+			MarkBufferDirtyHint(buf, false);
+
+		UnlockReleaseBuffer(buf);
+	}
+}
+
 /*
  * XLogRecordPageWithFreeSpace - like RecordPageWithFreeSpace, for use in
  *		WAL replay
@@ -360,6 +474,38 @@ FreeSpaceMapVacuumRange(Relation rel, BlockNumber start, BlockNumber end)
 		(void) fsm_vacuum_page(rel, FSM_ROOT_ADDRESS, start, end, &dummy);
 }
 
+/*
+ * FreeSpaceMapShmemSize --- report amount of shared memory space needed
+ */
+Size
+FreeSpaceMapShmemSize(void)
+{
+	return mul_size(FSM_HANDOUT_SLOTS, sizeof(pg_atomic_uint64));
+}
+
+/*
+ * FreeSpaceMapShmemInit --- initialize the recently-handed-out page table
+ */
+void
+FreeSpaceMapShmemInit(void)
+{
+	bool		found;
+
+	FreeSpaceMapHandouts = (pg_atomic_uint64 *)
+		ShmemInitStruct("Free Space Map Handouts",
+						FreeSpaceMapShmemSize(),
+						&found);
+
+	if (!IsUnderPostmaster)
+	{
+		Assert(!found);
+		for (int i = 0; i < FSM_HANDOUT_SLOTS; i++)
+			pg_atomic_init_u64(&FreeSpaceMapHandouts[i], 0);
+	}
+	else
+		Assert(found);
+}
+
 /******** Internal routines ********/
 
 /*
@@ -647,7 +793,7 @@ fsm_set_and_search(Relation rel, FSMAddress addr, uint16 slot,
 		/* Search while we still hold the lock */
 		newslot = fsm_search_avail(buf, minValue,
 								   addr.level == FSM_BOTTOM_LEVEL,
-								   true);
+								   true, fsm_spread_inserts);
 	}
 
 	UnlockReleaseBuffer(buf);
@@ -679,7 +825,7 @@ fsm_search(Relation rel, uint8 min_cat)
 			LockBuffer(buf, BUFFER_LOCK_SHARE);
 			slot = fsm_search_avail(buf, min_cat,
 									(addr.level == FSM_BOTTOM_LEVEL),
-									false);
+									false, fsm_spread_inserts);
 			if (slot == -1)
 				max_avail = fsm_get_max_avail(BufferGetPage(buf));
 			UnlockReleaseBuffer(buf);
@@ -743,6 +889,154 @@ fsm_search(Relation rel, uint8 min_cat)
 }
 
 
+/*
+ * Like fsm_search, but try to hand out different pages to backends that are
+ * searching concurrently.
+ */
+static BlockNumber
+fsm_search_spread(Relation rel, uint8 min_cat)
+{
+	BlockNumber blkno = fsm_search(rel, min_cat);
+
+	if (!fsm_spread_inserts || blkno == InvalidBlockNumber)
+		return blkno;
+
+	/*
+	 * If some other backend was just given the same page, it's probably busy
+	 * inserting into it.  Search again; since the bottom-level search
+	 * advanced the page's next-slot pointer, we'll likely get the next
+	 * suitable page.  If we keep bumping into pages in use, settle for the
+	 * last one.
+	 */
+	for (int retries = 0;
+		 retries < FSM_HANDOUT_RETRIES && fsm_handed_out_elsewhere(rel, blkno);
+		 retries++)
+	{
+		BlockNumber retry = fsm_search(rel, min_cat);
+
+		if (retry == InvalidBlockNumber)
+			break;
+		blkno = retry;
+	}
+
+	fsm_record_handout(rel, blkno);
+
+	return blkno;
+}
+
+/*
+ * Recursive guts of GetPagesWithFreeSpace
+ *
+ * Collect up to npages heap pages with at least min_cat free space from the
+ * part of the tree below the FSM page indicated by addr.  Upper-level pages
+ * are only ever asked for as many slots as pages are still needed, since
+ * each slot should lead to at least one page; if the upper levels are out of
+ * date, we might return fewer pages than are available, which is fine.
+ */
+static int
+fsm_search_multi(Relation rel, FSMAddress addr, uint8 min_cat,
+				 BlockNumber *pages, int npages)
+{
+	Buffer		buf;
+	uint16	   *slots;
+	int			nslots;
+	int			nfound = 0;
+
+	buf = fsm_readbuf(rel, addr, false);
+	if (!BufferIsValid(buf))
+		return 0;
+
+	slots = palloc(sizeof(uint16) * npages);
+
+	LockBuffer(buf, BUFFER_LOCK_SHARE);
+	nslots = fsm_search_avail_slots(buf, min_cat, fsm_spread_inserts,
+									slots, npages);
+	UnlockReleaseBuffer(buf);
+
+	for (int i = 0; i < nslots && nfound < npages; i++)
+	{
+		if (addr.level == FSM_BOTTOM_LEVEL)
+			pages[nfound++] = fsm_get_heap_blk(addr, slots[i]);
+		else
+			nfound += fsm_search_multi(rel, fsm_get_child(addr, slots[i]),
+									   min_cat, pages + nfound,
+									   npages - nfound);
+	}
+
+	pfree(slots);
+
+	return nfound;
+}
+
+/*
+ * Hash a heap page for FreeSpaceMapHandouts.
+ */
+static uint32
+fsm_handout_hash(Relation rel, BlockNumber heapBlk)
+{
+	struct
+	{
+		RelFileLocator locator;
+		BlockNumber blkno;
+	}			key;
+
+	key.locator = rel->rd_locator;
+	key.blkno = heapBlk;
+
+	return hash_bytes((const unsigned char *) &key, sizeof(key));
+}
+
+/*
+ * Has some other backend been handed out heapBlk by its last search?
+ */
+static bool
+fsm_handed_out_elsewhere(Relation rel, BlockNumber heapBlk)
+{
+	uint32		hash;
+	uint64		entry;
+
+	if (FreeSpaceMapHandouts == NULL || MyProc == NULL)
+		return false;
+
+	hash = fsm_handout_hash(rel, heapBlk);
+	entry = pg_atomic_read_u64(&FreeSpaceMapHandouts[hash % FSM_HANDOUT_SLOTS]);
+
+	return entry != 0 && (uint32) (entry >> 32) == hash &&
+		(uint32) entry != (uint32) MyProc->pgprocno + 1;
+}
+
+/*
+ * Advertise that heapBlk was handed out to us, withdrawing our previous
+ * entry.
+ */
+static void
+fsm_record_handout(Relation rel, BlockNumber heapBlk)
+{
+	uint32		hash;
+	int			slot;
+	uint64		entry;
+
+	if (FreeSpaceMapHandouts == NULL || MyProc == NULL)
+		return;
+
+	hash = fsm_handout_hash(rel, heapBlk);
+	slot = hash % FSM_HANDOUT_SLOTS;
+	entry = ((uint64) hash << 32) | ((uint32) MyProc->pgprocno + 1);
+
+	/* Withdraw the old entry, unless somebody else has overwritten it */
+	if (fsm_my_handout_slot >= 0 && fsm_my_handout_slot != slot)
+	{
+		uint64		expected = fsm_my_handout;
+
+		pg_atomic_compare_exchange_u64(&FreeSpaceMapHandouts[fsm_my_handout_slot],
+									   &expected, 0);
+	}
+
+	pg_atomic_write_u64(&FreeSpaceMapHandouts[slot], entry);
+	fsm_my_handout_slot = slot;
+	fsm_my_handout = entry;
+}
+
 /*
  * Recursive guts of FreeSpaceMapVacuum
  *
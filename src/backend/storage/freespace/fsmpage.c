@@ -16,12 +16,14 @@
  *	structure of a FSM page. This allows freespace.c to treat each FSM page
  *	as a black box with SlotsPerPage "slots". fsm_set_avail() and
  *	fsm_get_avail() let you get/set the value of a slot, and
- *	fsm_search_avail() lets you search for a slot with value >= X.
+ *	fsm_search_avail() lets you search for a slot with value >= X, and
+ *	fsm_search_avail_slots() for several of them at once.
  *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
 
+#include "common/pg_prng.h"
 #include "storage/bufmgr.h"
 #include "storage/fsm_internals.h"
 
@@ -30,6 +32,9 @@
 #define rightchild(x)	(2 * (x) + 2)
 #define parentof(x)		(((x) - 1) / 2)
 
+/* This backend's rotation of search start points, see fsm_search_start() */
+static int	fsm_start_offset = -1;
+
 /*
  * Find right neighbor of x, wrapping around within the level
  */
@@ -143,45 +148,68 @@ fsm_get_max_avail(Page page)
 }
 
 /*
- * Searches for a slot with category at least minvalue.
- * Returns slot number, or -1 if none found.
- *
- * The caller must hold at least a shared lock on the page, and this
- * function can unlock and lock the page again in exclusive mode if it
- * needs to be updated. exclusive_lock_held should be set to true if the
- * caller is already holding an exclusive lock, to avoid extra work.
+ * Returns the slot to start a search of the page from.
  *
- * If advancenext is false, fp_next_slot is set to point to the returned
- * slot, and if it's true, to the slot after the returned slot.
+ * Normally this is fp_next_slot.  If spread is true, each backend sees the
+ * slots of the page rotated by its own random offset, so that backends
+ * searching the same page concurrently start from different points.
+ * fp_next_slot is then stored in rotated form too, see fsm_set_next_slot().
  */
-int
-fsm_search_avail(Buffer buf, uint8 minvalue, bool advancenext,
-				 bool exclusive_lock_held)
+static int
+fsm_search_start(FSMPage fsmpage, bool spread)
 {
-	Page		page = BufferGetPage(buf);
-	FSMPage		fsmpage = (FSMPage) PageGetContents(page);
-	int			nodeno;
 	int			target;
-	uint16		slot;
-
-restart:
 
 	/*
-	 * Check the root first, and exit quickly if there's no leaf with enough
-	 * free space
-	 */
-	if (fsmpage->fp_nodes[0] < minvalue)
-		return -1;
-
-	/*
-	 * Start search using fp_next_slot.  It's just a hint, so check that it's
-	 * sane.  (This also handles wrapping around when the prior call returned
-	 * the last slot on the page.)
+	 * fp_next_slot is just a hint, so check that it's sane.  (This also
+	 * handles wrapping around when the prior call returned the last slot on
+	 * the page.)
 	 */
 	target = fsmpage->fp_next_slot;
 	if (target < 0 || target >= LeafNodesPerPage)
 		target = 0;
-	target += NonLeafNodesPerPage;
+
+	if (spread)
+	{
+		if (fsm_start_offset < 0)
+			fsm_start_offset = (int) pg_prng_uint64_range(&pg_global_prng_state,
+														  0, LeafNodesPerPage - 1);
+		target = (target + fsm_start_offset) % LeafNodesPerPage;
+	}
+
+	return target;
+}
+
+/*
+ * Update the next-target pointer of the page to slot, which may be one past
+ * the last slot.
+ *
+ * Note that we do this even if we're only holding a shared lock, on the
+ * grounds that it's better to use a shared lock and get a garbled next
+ * pointer every now and then, than take the concurrency hit of an exclusive
+ * lock.  Wrap-around is handled by fsm_search_start().
+ */
+static void
+fsm_set_next_slot(FSMPage fsmpage, int slot, bool spread)
+{
+	if (spread)
+		slot = (slot - fsm_start_offset + LeafNodesPerPage) % LeafNodesPerPage;
+	fsmpage->fp_next_slot = slot;
+}
+
+/*
+ * Searches the page for a slot with category at least minvalue, starting
+ * from slot target and moving right.  Returns the slot number, or -1 if the
+ * upper nodes of the page turn out to be inconsistent with the leaves.  The
+ * caller must have checked that the root has enough space.
+ *
+ * If randomize is true, the descent picks a random child whenever both have
+ * enough space, instead of the left one.
+ */
+static int
+fsm_search_from(FSMPage fsmpage, int target, uint8 minvalue, bool randomize)
+{
+	int			nodeno;
 
 	/*----------
 	 * Start the search from the target slot.  At every step, move one
@@ -224,7 +252,7 @@ restart:
 	 * to the right of (allowing for wraparound) our start point.
 	 *----------
 	 */
-	nodeno = target;
+	nodeno = target + NonLeafNodesPerPage;
 	while (nodeno > 0)
 	{
 		if (fsmpage->fp_nodes[nodeno] >= minvalue)
@@ -240,71 +268,158 @@ restart:
 	/*
 	 * We're now at a node with enough free space, somewhere in the middle of
 	 * the tree. Descend to the bottom, following a path with enough free
-	 * space, preferring to move left if there's a choice.
+	 * space, preferring to move left if there's a choice.  When spreading
+	 * the load, a coin toss decides instead, so that concurrent searches
+	 * reaching the same node tend to land on different pages below it.
 	 */
 	while (nodeno < NonLeafNodesPerPage)
 	{
-		int			childnodeno = leftchild(nodeno);
-
-		if (childnodeno < NodesPerPage &&
-			fsmpage->fp_nodes[childnodeno] >= minvalue)
-		{
-			nodeno = childnodeno;
-			continue;
-		}
-		childnodeno++;			/* point to right child */
-		if (childnodeno < NodesPerPage &&
-			fsmpage->fp_nodes[childnodeno] >= minvalue)
-		{
-			nodeno = childnodeno;
-		}
+		int			leftno = leftchild(nodeno);
+		int			rightno = leftno + 1;
+		bool		left_ok;
+		bool		right_ok;
+
+		left_ok = (leftno < NodesPerPage &&
+				   fsmpage->fp_nodes[leftno] >= minvalue);
+		right_ok = (rightno < NodesPerPage &&
+					fsmpage->fp_nodes[rightno] >= minvalue);
+
+		if (left_ok &&
+			(!right_ok || !randomize || !pg_prng_bool(&pg_global_prng_state)))
+			nodeno = leftno;
+		else if (right_ok)
+			nodeno = rightno;
 		else
 		{
 			/*
 			 * Oops. The parent node promised that either left or right child
-			 * has enough space, but neither actually did. This can happen in
-			 * case of a "torn page", IOW if we crashed earlier while writing
-			 * the page to disk, and only part of the page made it to disk.
-			 *
-			 * Fix the corruption and restart.
+			 * has enough space, but neither actually did.
 			 */
-			RelFileLocator rlocator;
-			ForkNumber	forknum;
-			BlockNumber blknum;
-
-			BufferGetTag(buf, &rlocator, &forknum, &blknum);
-			elog(DEBUG1, "fixing corrupt FSM block %u, relation %u/%u/%u",
-				 blknum, rlocator.spcOid, rlocator.dbOid, rlocator.relNumber);
-
-			/* make sure we hold an exclusive lock */
-			if (!exclusive_lock_held)
-			{
-				LockBuffer(buf, BUFFER_LOCK_UNLOCK);
-				LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
-				exclusive_lock_held = true;
-			}
-			fsm_rebuild_page(page);
-			MarkBufferDirtyHint(buf, false);
-			goto restart;
+			return -1;
 		}
 	}
 
 	/* We're now at the bottom level, at a node with enough space. */
-	slot = nodeno - NonLeafNodesPerPage;
+	return nodeno - NonLeafNodesPerPage;
+}
+
+/*
+ * Searches for a slot with category at least minvalue.
+ * Returns slot number, or -1 if none found.
+ *
+ * The caller must hold at least a shared lock on the page, and this
+ * function can unlock and lock the page again in exclusive mode if it
+ * needs to be updated. exclusive_lock_held should be set to true if the
+ * caller is already holding an exclusive lock, to avoid extra work.
+ *
+ * If advancenext is false, fp_next_slot is set to point to the returned
+ * slot, and if it's true, to the slot after the returned slot.
+ *
+ * If spread is true, try to send concurrent searchers to different slots,
+ * see fsm_search_start() and fsm_search_from().
+ */
+int
+fsm_search_avail(Buffer buf, uint8 minvalue, bool advancenext,
+				 bool exclusive_lock_held, bool spread)
+{
+	Page		page = BufferGetPage(buf);
+	FSMPage		fsmpage = (FSMPage) PageGetContents(page);
+	int			slot;
+
+restart:
 
 	/*
-	 * Update the next-target pointer. Note that we do this even if we're only
-	 * holding a shared lock, on the grounds that it's better to use a shared
-	 * lock and get a garbled next pointer every now and then, than take the
-	 * concurrency hit of an exclusive lock.
-	 *
-	 * Wrap-around is handled at the beginning of this function.
+	 * Check the root first, and exit quickly if there's no leaf with enough
+	 * free space
 	 */
-	fsmpage->fp_next_slot = slot + (advancenext ? 1 : 0);
+	if (fsmpage->fp_nodes[0] < minvalue)
+		return -1;
+
+	slot = fsm_search_from(fsmpage, fsm_search_start(fsmpage, spread),
+						   minvalue, spread);
+	if (slot < 0)
+	{
+		/*
+		 * The upper nodes didn't match the leaves. This can happen in case of
+		 * a "torn page", IOW if we crashed earlier while writing the page to
+		 * disk, and only part of the page made it to disk.
+		 *
+		 * Fix the corruption and restart.
+		 */
+		RelFileLocator rlocator;
+		ForkNumber	forknum;
+		BlockNumber blknum;
+
+		BufferGetTag(buf, &rlocator, &forknum, &blknum);
+		elog(DEBUG1, "fixing corrupt FSM block %u, relation %u/%u/%u",
+			 blknum, rlocator.spcOid, rlocator.dbOid, rlocator.relNumber);
+
+		/* make sure we hold an exclusive lock */
+		if (!exclusive_lock_held)
+		{
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+			exclusive_lock_held = true;
+		}
+		fsm_rebuild_page(page);
+		MarkBufferDirtyHint(buf, false);
+		goto restart;
+	}
+
+	fsm_set_next_slot(fsmpage, slot + (advancenext ? 1 : 0), spread);
 
 	return slot;
 }
 
+/*
+ * Searches for up to maxslots slots with category at least minvalue, in one
+ * pass over the page.  The slots are stored in slots[] in the order found,
+ * going right from the usual start point and wrapping around; returns their
+ * number.  fp_next_slot is advanced past the last one.
+ *
+ * The caller must hold at least a shared lock on the page.  Unlike
+ * fsm_search_avail, this doesn't fix a corrupt page, it just returns the
+ * slots found so far.
+ */
+int
+fsm_search_avail_slots(Buffer buf, uint8 minvalue, bool spread,
+					   uint16 *slots, int maxslots)
+{
+	Page		page = BufferGetPage(buf);
+	FSMPage		fsmpage = (FSMPage) PageGetContents(page);
+	int			start;
+	int			target;
+	int			nslots = 0;
+	int			lastdist = -1;
+
+	if (fsmpage->fp_nodes[0] < minvalue)
+		return 0;
+
+	start = target = fsm_search_start(fsmpage, spread);
+	while (nslots < maxslots)
+	{
+		int			slot = fsm_search_from(fsmpage, target, minvalue, false);
+		int			dist;
+
+		if (slot < 0)
+			break;
+
+		/* Stop when the search wraps around past the start point */
+		dist = (slot - start + LeafNodesPerPage) % LeafNodesPerPage;
+		if (dist <= lastdist)
+			break;
+
+		slots[nslots++] = slot;
+		lastdist = dist;
+		target = (slot + 1) % LeafNodesPerPage;
+	}
+
+	if (nslots > 0)
+		fsm_set_next_slot(fsmpage, slots[nslots - 1] + 1, spread);
+
+	return nslots;
+}
+
 /*
  * Sets the available space to zero for all slots numbered >= nslots.
  * Returns true if the page was modified.
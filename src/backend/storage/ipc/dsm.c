@@ -14,6 +14,12 @@
  * hard postmaster crash, remaining segments will be removed, if they
  * still exist, at the next postmaster startup.
  *
+ * Segments created with DSM_CREATE_CACHED are not destroyed when the last
+ * mapping goes away, but stay mapped in the process that detached last, up
+ * to dynamic_shared_memory_cache_size, so that its next dsm_create() of a
+ * similar size can hand one out again instead of creating, sizing and
+ * mapping a new segment and faulting in its pages.
+ *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -36,6 +42,7 @@
 #include "common/pg_prng.h"
 #include "lib/ilist.h"
 #include "miscadmin.h"
+#include "port/atomics.h"
 #include "port/pg_bitutils.h"
 #include "storage/dsm.h"
 #include "storage/ipc.h"
@@ -53,6 +60,9 @@
 
 #define INVALID_CONTROL_SLOT		((uint32) -1)
 
+/* Smallest size class of segments created with DSM_CREATE_CACHED. */
+#define DSM_CACHE_MIN_SEGMENT_SIZE	(64 * 1024)
+
 /* Backend-local tracking for on-detach callbacks. */
 typedef struct dsm_segment_detach_callback
 {
@@ -83,6 +93,7 @@ typedef struct dsm_control_item
 	size_t		npages;
 	void	   *impl_private_pm_handle; /* only needed on Windows */
 	bool		pinned;
+	bool		cacheable;		/* created with DSM_CREATE_CACHED? */
 } dsm_control_item;
 
 /* Layout of the dynamic shared memory control segment. */
@@ -91,12 +102,19 @@ typedef struct dsm_control_header
 	uint32		magic;
 	uint32		nitems;
 	uint32		maxitems;
+	pg_atomic_uint64 cache_hits;	/* see dsm_cache_lookup */
+	pg_atomic_uint64 cache_misses;
 	dsm_control_item item[FLEXIBLE_ARRAY_MEMBER];
 } dsm_control_header;
 
 static void dsm_cleanup_for_mmap(void);
 static void dsm_postmaster_shutdown(int code, Datum arg);
 static dsm_segment *dsm_create_descriptor(void);
+static void dsm_release_segment(dsm_segment *seg);
+static Size dsm_cache_class_size(Size size);
+static dsm_segment *dsm_cache_lookup(Size size);
+static bool dsm_cache_keep(dsm_segment *seg);
+static void dsm_cache_trim(Size keep);
 static bool dsm_control_segment_sane(dsm_control_header *control,
 									 Size mapped_size);
 static uint64 dsm_control_bytes_needed(uint32 nitems);
@@ -128,6 +146,14 @@ static void *dsm_main_space_begin = NULL;
  */
 static dlist_head dsm_segment_list = DLIST_STATIC_INIT(dsm_segment_list);
 
+/*
+ * Segments created with DSM_CREATE_CACHED that nobody is attached to anymore
+ * but us, most recently detached first, and the total size of their mappings.
+ * They're not on dsm_segment_list, nor owned by any resource owner.
+ */
+static dlist_head dsm_cached_list = DLIST_STATIC_INIT(dsm_cached_list);
+static Size dsm_cached_bytes = 0;
+
 /*
  * Control segment information.
  *
@@ -200,6 +226,8 @@ dsm_postmaster_startup(PGShmemHeader *shim)
 	dsm_control->magic = PG_DYNSHMEM_CONTROL_MAGIC;
 	dsm_control->nitems = 0;
 	dsm_control->maxitems = maxitems;
+	pg_atomic_init_u64(&dsm_control->cache_hits, 0);
+	pg_atomic_init_u64(&dsm_control->cache_misses, 0);
 }
 
 /*
@@ -484,6 +512,12 @@ dsm_shmem_init(void)
  * remains attached until explicitly detached or the session ends.
  * Creating with a NULL CurrentResourceOwner is equivalent to creating
  * with a non-NULL CurrentResourceOwner and then calling dsm_pin_mapping.
+ *
+ * With DSM_CREATE_CACHED, the segment may be one this backend kept from an
+ * earlier user, and may be larger than requested.  Its contents are then not
+ * zeroed.  Such a segment may only be attached by its handle while somebody
+ * is still attached to it; once everyone has detached, the handle might
+ * refer to the segment's next use.
  */
 dsm_segment *
 dsm_create(Size size, int flags)
@@ -495,6 +529,7 @@ dsm_create(Size size, int flags)
 	size_t		first_page = 0;
 	FreePageManager *dsm_main_space_fpm = dsm_main_space_begin;
 	bool		using_main_dsm_region = false;
+	Size		cached_size = 0;
 
 	/*
 	 * Unsafe in postmaster. It might seem pointless to allow use of dsm in
@@ -506,6 +541,18 @@ dsm_create(Size size, int flags)
 	if (!dsm_init_done)
 		dsm_backend_startup();
 
+	/* Reuse a segment of the right size class if we have one. */
+	if ((flags & DSM_CREATE_CACHED) != 0)
+	{
+		cached_size = dsm_cache_class_size(size);
+		if (cached_size != 0)
+		{
+			seg = dsm_cache_lookup(cached_size);
+			if (seg != NULL)
+				return seg;
+		}
+	}
+
 	/* Create a new segment descriptor. */
 	seg = dsm_create_descriptor();
 
@@ -535,10 +582,14 @@ dsm_create(Size size, int flags)
 	{
 		/*
 		 * We need to create a new memory segment.  Loop until we find an
-		 * unused segment identifier.
+		 * unused segment identifier.  A segment we might cache is created in
+		 * the size of its size class, so that it fits any later request of
+		 * that class.
 		 */
 		if (dsm_main_space_fpm)
 			LWLockRelease(DynamicSharedMemoryControlLock);
+		if (cached_size != 0)
+			size = cached_size;
 		for (;;)
 		{
 			Assert(seg->mapped_address == NULL && seg->mapped_size == 0);
@@ -572,6 +623,8 @@ dsm_create(Size size, int flags)
 			dsm_control->item[i].refcnt = 2;
 			dsm_control->item[i].impl_private_pm_handle = NULL;
 			dsm_control->item[i].pinned = false;
+			dsm_control->item[i].cacheable =
+				(cached_size != 0 && !using_main_dsm_region);
 			seg->control_slot = i;
 			LWLockRelease(DynamicSharedMemoryControlLock);
 			return seg;
@@ -611,6 +664,8 @@ dsm_create(Size size, int flags)
 	dsm_control->item[nitems].refcnt = 2;
 	dsm_control->item[nitems].impl_private_pm_handle = NULL;
 	dsm_control->item[nitems].pinned = false;
+	dsm_control->item[nitems].cacheable =
+		(cached_size != 0 && !using_main_dsm_region);
 	seg->control_slot = nitems;
 	dsm_control->nitems++;
 	LWLockRelease(DynamicSharedMemoryControlLock);
@@ -729,6 +784,8 @@ dsm_attach(dsm_handle h)
 void
 dsm_backend_shutdown(void)
 {
+	dsm_cache_trim(0);
+
 	while (!dlist_is_empty(&dsm_segment_list))
 	{
 		dsm_segment *seg;
@@ -749,6 +806,8 @@ dsm_detach_all(void)
 {
 	void	   *control_address = dsm_control;
 
+	dsm_cache_trim(0);
+
 	while (!dlist_is_empty(&dsm_segment_list))
 	{
 		dsm_segment *seg;
@@ -765,7 +824,8 @@ dsm_detach_all(void)
 
 /*
  * Detach from a shared memory segment, destroying the segment if we
- * remove the last reference.
+ * remove the last reference, unless we can keep it for reuse; see
+ * dsm_cache_keep.
  *
  * This function should never fail.  It will often be invoked when aborting
  * a transaction, and a further error won't serve any purpose.  It's not a
@@ -801,6 +861,17 @@ dsm_detach(dsm_segment *seg)
 	}
 	RESUME_INTERRUPTS();
 
+	if (!dsm_cache_keep(seg))
+		dsm_release_segment(seg);
+}
+
+/*
+ * Remove our mapping of a segment whose on-detach callbacks have run, and
+ * our reference to it, destroying the segment if that was the last one.
+ */
+static void
+dsm_release_segment(dsm_segment *seg)
+{
 	/*
 	 * Try to remove the mapping, if one exists.  Normally, there will be, but
 	 * maybe not, if we failed partway through a create or attach operation.
@@ -1255,3 +1326,154 @@ is_main_region_dsm_handle(dsm_handle handle)
 {
 	return handle & 1;
 }
+
+/*
+ * Size class of a segment requested with DSM_CREATE_CACHED, or 0 if we
+ * won't cache a segment of that size.
+ *
+ * Classes are powers of two, which is also how dsa.c sizes its segments.
+ */
+static Size
+dsm_cache_class_size(Size size)
+{
+	Size		limit = (Size) dynamic_shared_memory_cache_size * 1024 * 1024;
+	Size		class_size;
+
+	if (size > limit)
+		return 0;
+	class_size = pg_nextpower2_size_t(Max(size, DSM_CACHE_MIN_SEGMENT_SIZE));
+	return class_size <= limit ? class_size : 0;
+}
+
+/*
+ * Hand out a kept segment of the given size, if we have one.
+ */
+static dsm_segment *
+dsm_cache_lookup(Size size)
+{
+	dlist_mutable_iter iter;
+
+	if (CurrentResourceOwner)
+		ResourceOwnerEnlargeDSMs(CurrentResourceOwner);
+
+	dlist_foreach_modify(iter, &dsm_cached_list)
+	{
+		dsm_segment *seg = dlist_container(dsm_segment, node, iter.cur);
+		uint32		refcnt;
+
+		if (seg->mapped_size != size)
+			continue;
+
+		dlist_delete(&seg->node);
+		dsm_cached_bytes -= seg->mapped_size;
+
+		/*
+		 * Someone who still had the handle from the segment's previous use
+		 * may have attached to it since we kept it.  It was cleared by
+		 * dsm_cache_keep, so that's harmless, but we can't reuse it now.
+		 */
+		LWLockAcquire(DynamicSharedMemoryControlLock, LW_SHARED);
+		Assert(dsm_control->item[seg->control_slot].handle == seg->handle);
+		refcnt = dsm_control->item[seg->control_slot].refcnt;
+		LWLockRelease(DynamicSharedMemoryControlLock);
+		if (refcnt != 2)
+		{
+			dlist_push_head(&dsm_segment_list, &seg->node);
+			dsm_release_segment(seg);
+			continue;
+		}
+
+		dlist_push_head(&dsm_segment_list, &seg->node);
+		seg->resowner = CurrentResourceOwner;
+		if (CurrentResourceOwner)
+			ResourceOwnerRememberDSM(CurrentResourceOwner, seg);
+
+		pg_atomic_fetch_add_u64(&dsm_control->cache_hits, 1);
+		return seg;
+	}
+
+	pg_atomic_fetch_add_u64(&dsm_control->cache_misses, 1);
+	return NULL;
+}
+
+/*
+ * Keep a segment we're detaching from for reuse, if it was created with
+ * DSM_CREATE_CACHED, nobody else is attached to it, and it fits in
+ * dynamic_shared_memory_cache_size along with the most recently kept others.
+ * Its on-detach callbacks have run already.
+ *
+ * Segments in the main shared memory area aren't worth keeping, since they
+ * are cheap to allocate and other backends might need the space.
+ */
+static bool
+dsm_cache_keep(dsm_segment *seg)
+{
+	Size		limit = (Size) dynamic_shared_memory_cache_size * 1024 * 1024;
+	dsm_control_item *item;
+	bool		keep;
+
+	if (seg->mapped_address == NULL ||
+		seg->control_slot == INVALID_CONTROL_SLOT ||
+		is_main_region_dsm_handle(seg->handle) ||
+		seg->mapped_size > limit ||
+		proc_exit_inprogress)
+		return false;
+
+	LWLockAcquire(DynamicSharedMemoryControlLock, LW_SHARED);
+	item = &dsm_control->item[seg->control_slot];
+	Assert(item->handle == seg->handle);
+	keep = item->cacheable && !item->pinned && item->refcnt == 2;
+	LWLockRelease(DynamicSharedMemoryControlLock);
+	if (!keep)
+		return false;
+
+	/* Make room, dropping the segments we kept longest ago. */
+	dsm_cache_trim(limit - seg->mapped_size);
+
+	/*
+	 * Clear the start of the segment, where its users keep their magic
+	 * numbers, so that anyone attaching late by the old handle can't mistake
+	 * what's left for live state.
+	 */
+	memset(seg->mapped_address, 0, Min(seg->mapped_size, BLCKSZ));
+
+	if (seg->resowner != NULL)
+		ResourceOwnerForgetDSM(seg->resowner, seg);
+	seg->resowner = NULL;
+	dlist_delete(&seg->node);
+	dlist_push_head(&dsm_cached_list, &seg->node);
+	dsm_cached_bytes += seg->mapped_size;
+
+	return true;
+}
+
+/*
+ * Destroy kept segments, oldest first, until they take up no more than the
+ * given number of bytes.
+ */
+static void
+dsm_cache_trim(Size keep)
+{
+	while (dsm_cached_bytes > keep)
+	{
+		dsm_segment *seg;
+
+		seg = dlist_tail_element(dsm_segment, node, &dsm_cached_list);
+		dsm_cached_bytes -= seg->mapped_size;
+		dsm_release_segment(seg);
+	}
+}
+
+/*
+ * Report how often dsm_create() could and couldn't reuse a kept segment,
+ * across all backends.
+ */
+void
+dsm_cache_stats(uint64 *hits, uint64 *misses)
+{
+	if (!dsm_init_done)
+		dsm_backend_startup();
+
+	*hits = pg_atomic_read_u64(&dsm_control->cache_hits);
+	*misses = pg_atomic_read_u64(&dsm_control->cache_misses);
+}
@@ -114,6 +114,9 @@ int			dynamic_shared_memory_type = DEFAULT_DYNAMIC_SHARED_MEMORY_TYPE;
 /* Amount of space reserved for DSM segments in the main area. */
 int			min_dynamic_shared_memory;
 
+/* Amount of space each backend may keep in segments for reuse. */
+int			dynamic_shared_memory_cache_size = 0;
+
 /* Size of buffer to be used for zero-filling. */
 #define ZBUFFER_SIZE				8192
 
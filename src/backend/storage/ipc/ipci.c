@@ -19,25 +19,33 @@
 #include "access/heapam.h"
 #include "access/multixact.h"
 #include "access/nbtree.h"
+#include "access/parallel.h"
 #include "access/subtrans.h"
 #include "access/syncscan.h"
 #include "access/twophase.h"
+#include "access/visibilitymap.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
+#include "backup/basebackup_parallel.h"
+#include "catalog/indextidlog.h"
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/autoprewarm.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
 #include "replication/logicallauncher.h"
 #include "replication/origin.h"
+#include "replication/shareddecoding.h"
 #include "replication/slot.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/dsm.h"
+#include "storage/freespace.h"
 #include "storage/ipc.h"
 #include "storage/pg_shmem.h"
 #include "storage/pmsignal.h"
@@ -46,8 +54,14 @@
 #include "storage/procarray.h"
 #include "storage/procsignal.h"
 #include "storage/sinvaladt.h"
+#include "storage/smgr.h"
 #include "storage/spin.h"
+#include "utils/backend_memory.h"
+#include "utils/backend_profile.h"
 #include "utils/guc.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
+#include "utils/sharedtypcache.h"
 #include "utils/snapmgr.h"
 
 /* GUCs */
@@ -111,6 +125,7 @@ CalculateShmemSize(int *num_semaphores)
 											 sizeof(ShmemIndexEnt)));
 	size = add_size(size, dsm_estimate_size());
 	size = add_size(size, BufferShmemSize());
+	size = add_size(size, AioShmemSize());
 	size = add_size(size, LockShmemSize());
 	size = add_size(size, PredicateLockShmemSize());
 	size = add_size(size, ProcGlobalShmemSize());
@@ -122,10 +137,15 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, SUBTRANSShmemSize());
 	size = add_size(size, TwoPhaseShmemSize());
 	size = add_size(size, BackgroundWorkerShmemSize());
+	size = add_size(size, ParallelWorkerPoolShmemSize());
+	size = add_size(size, AutoPrewarmShmemSize());
 	size = add_size(size, MultiXactShmemSize());
 	size = add_size(size, LWLockShmemSize());
+	size = add_size(size, LWLockProfileShmemSize());
+	size = add_size(size, BackendProfileShmemSize());
 	size = add_size(size, ProcArrayShmemSize());
 	size = add_size(size, BackendStatusShmemSize());
+	size = add_size(size, BackendMemoryShmemSize());
 	size = add_size(size, SInvalShmemSize());
 	size = add_size(size, PMSignalShmemSize());
 	size = add_size(size, ProcSignalShmemSize());
@@ -134,17 +154,24 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, ReplicationSlotsShmemSize());
 	size = add_size(size, ReplicationOriginShmemSize());
 	size = add_size(size, WalSndShmemSize());
+	size = add_size(size, BaseBackupParallelShmemSize());
+	size = add_size(size, SharedDecodingShmemSize());
 	size = add_size(size, WalRcvShmemSize());
 	size = add_size(size, PgArchShmemSize());
 	size = add_size(size, ApplyLauncherShmemSize());
 	size = add_size(size, SnapMgrShmemSize());
 	size = add_size(size, BTreeShmemSize());
+	size = add_size(size, VisibilityMapShmemSize());
+	size = add_size(size, FreeSpaceMapShmemSize());
+	size = add_size(size, RelSizeShmemSize());
+	size = add_size(size, SharedCatCacheShmemSize());
+	size = add_size(size, SharedPlanCacheShmemSize());
+	size = add_size(size, SharedTypeCacheShmemSize());
+	size = add_size(size, IndexTidLogShmemSize());
 	size = add_size(size, SyncScanShmemSize());
 	size = add_size(size, AsyncShmemSize());
 	size = add_size(size, StatsShmemSize());
-#ifdef EXEC_BACKEND
 	size = add_size(size, ShmemBackendArraySize());
-#endif
 
 	/* include additional requested shmem from preload libraries */
 	size = add_size(size, total_addin_request);
@@ -246,6 +273,7 @@ CreateSharedMemoryAndSemaphores(void)
 	SUBTRANSShmemInit();
 	MultiXactShmemInit();
 	InitBufferPool(); // 最大个的共享池的创建
+	AioShmemInit();
 
 	/*
 	 * Set up lock manager
@@ -264,8 +292,13 @@ CreateSharedMemoryAndSemaphores(void)
 		InitProcGlobal();
 	CreateSharedProcArray();
 	CreateSharedBackendStatus();
+	BackendMemoryShmemInit();
+	LWLockProfileShmemInit();
+	BackendProfileShmemInit();
 	TwoPhaseShmemInit();
 	BackgroundWorkerShmemInit();
+	ParallelWorkerPoolShmemInit();
+	AutoPrewarmShmemInit();
 
 	/*
 	 * Set up shared-inval messaging
@@ -282,6 +315,8 @@ CreateSharedMemoryAndSemaphores(void)
 	ReplicationSlotsShmemInit(); // 初始化复制槽的共享内存
 	ReplicationOriginShmemInit(); /// 初始化复制槽状态的共享内存，这个和上一行是不一样的
 	WalSndShmemInit(); // 初始化walsender的共享内存
+	BaseBackupParallelShmemInit();
+	SharedDecodingShmemInit();
 	WalRcvShmemInit(); // 初始化walreceiver进程的共享内存
 	PgArchShmemInit();
 	ApplyLauncherShmemInit();
@@ -291,18 +326,22 @@ CreateSharedMemoryAndSemaphores(void)
 	 */
 	SnapMgrInit();
 	BTreeShmemInit();
+	VisibilityMapShmemInit();
+	FreeSpaceMapShmemInit();
+	RelSizeShmemInit();
+	SharedCatCacheShmemInit();
+	SharedPlanCacheShmemInit();
+	SharedTypeCacheShmemInit();
+	IndexTidLogShmemInit();
 	SyncScanShmemInit();
 	AsyncShmemInit();
 	StatsShmemInit();
 
-#ifdef EXEC_BACKEND
-
 	/*
-	 * Alloc the win32 shared backend array
+	 * Alloc the shared backend array
 	 */
 	if (!IsUnderPostmaster)
 		ShmemBackendArrayAllocation(); /// 分配后台进程的描述数组
-#endif
 
 	/* Initialize dynamic shared memory facilities. */
 	if (!IsUnderPostmaster)
@@ -313,6 +352,14 @@ CreateSharedMemoryAndSemaphores(void)
 	 */
 	if (shmem_startup_hook)
 		shmem_startup_hook();
+
+	/*
+	 * Fault in all of shared memory now, if requested, rather than leaving
+	 * that to the first queries to touch each page.  This is done last, so
+	 * that any NUMA placement set up above applies.
+	 */
+	if (!IsUnderPostmaster && shared_memory_prefault)
+		ShmemPrefault();
 }
 
 /*
@@ -48,6 +48,7 @@
 #include <signal.h>
 
 #include "access/clog.h"
+#include "access/parallel.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/twophase.h"
@@ -102,6 +103,51 @@ typedef struct ProcArrayStruct
 	int			pgprocnos[FLEXIBLE_ARRAY_MEMBER];
 } ProcArrayStruct;
 
+/*
+ * List of the top-level xids currently assigned to members of the ProcArray.
+ *
+ * ProcGlobal->xids[] has an entry for every proc in the array, whether or not
+ * it is running a transaction with an xid, so building a snapshot from it
+ * costs time proportional to the number of connections.  This list only has
+ * an entry for each proc that has an xid, which lets GetSnapshotDataFast()
+ * build a snapshot in time proportional to the number of running write
+ * transactions, and without acquiring ProcArrayLock.
+ *
+ * Entries are appended when an xid is assigned (under XidGenLock, see
+ * GetNewTransactionId()) or a live 2PC gxact is added to the array, and
+ * removed, by moving the last entry into the hole, when the xid is cleared
+ * again (under exclusive ProcArrayLock).  The mutex serializes the two.
+ * PGPROC->runningXidIndex is the position of the proc's entry, or -1.
+ *
+ * Lock-free readers are coordinated with changeCount, which works like a
+ * seqlock: every change of the set of running xids that GetSnapshotData()
+ * would notice, i.e. everything that increments xactCompletionCount, makes it
+ * odd before and even again after changing anything.  A reader that sees the
+ * same even value before and after copying the list (and latestCompletedXid)
+ * got a consistent picture.  Appending an entry doesn't need to bump
+ * changeCount: a concurrent reader may or may not see the new entry, like a
+ * reader holding ProcArrayLock may or may not see a concurrently assigned
+ * xid, and either way the xid is >= the snapshot's xmax.  The write barrier
+ * before numXids is incremented makes sure a reader never sees an
+ * uninitialized entry.
+ */
+typedef struct RunningXidEntry
+{
+	TransactionId xid;
+	int			pgprocno;
+} RunningXidEntry;
+
+typedef struct RunningXidsData
+{
+	slock_t		mutex;			/* protects numXids and xids[] changes */
+	pg_atomic_uint64 changeCount;	/* odd while running xids change */
+	int			numXids;		/* number of valid entries */
+	RunningXidEntry xids[FLEXIBLE_ARRAY_MEMBER];	/* PROCARRAY_MAXPROCS */
+} RunningXidsData;
+
+/* How often GetSnapshotDataFast() retries before taking ProcArrayLock */
+#define SNAPSHOT_FAST_MAX_ATTEMPTS	4
+
 /*
  * State for the GlobalVisTest* family of functions. Those functions can
  * e.g. be used to decide if a deleted row can be removed without violating
@@ -271,6 +317,8 @@ typedef enum KAXCompressReason
 
 static ProcArrayStruct *procArray;
 
+static RunningXidsData *runningXids;
+
 static PGPROC *allProcs;
 
 /*
@@ -283,6 +331,7 @@ static TransactionId cachedXidIsNotInProgress = InvalidTransactionId;
  */
 static TransactionId *KnownAssignedXids;
 static bool *KnownAssignedXidsValid;
+static int32 *KnownAssignedXidsNext;
 static TransactionId latestObservedXid = InvalidTransactionId;
 
 /*
@@ -364,7 +413,9 @@ static TransactionId KnownAssignedXidsGetOldestXmin(void);
 static void KnownAssignedXidsDisplay(int trace_level);
 static void KnownAssignedXidsReset(void);
 static inline void ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid);
-static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
+static void ProcArrayRemoveInternal(PGPROC *proc, TransactionId latestXid);
+static void ProcArrayGroupClearXid(PGPROC *proc, PGPROC *removeProc,
+								   TransactionId latestXid);
 static void MaintainLatestCompletedXid(TransactionId latestXid);
 static void MaintainLatestCompletedXidRecovery(TransactionId latestXid);
 
@@ -386,29 +437,44 @@ ProcArrayShmemSize(void)
 	size = offsetof(ProcArrayStruct, pgprocnos);
 	size = add_size(size, mul_size(sizeof(int), PROCARRAY_MAXPROCS));
 
+	/* the list of running xids */
+	size = add_size(size, offsetof(RunningXidsData, xids));
+	size = add_size(size, mul_size(sizeof(RunningXidEntry), PROCARRAY_MAXPROCS));
+
 	/*
 	 * During Hot Standby processing we have a data structure called
 	 * KnownAssignedXids, created in shared memory. Local data structures are
 	 * also created in various backends during GetSnapshotData(),
 	 * TransactionIdIsInProgress() and GetRunningTransactionData(). All of the
-	 * main structures created in those functions must be identically sized,
-	 * since we may at times copy the whole of the data structures around. We
-	 * refer to this size as TOTAL_MAX_CACHED_SUBXIDS.
+	 * main structures created in those functions must be at least as large
+	 * as KnownAssignedXids, since we may at times copy the whole of it
+	 * around.  We refer to its size as TOTAL_MAX_KNOWN_ASSIGNED_XIDS.  It
+	 * only depends on PGPROC_MAX_CACHED_SUBXIDS, because primaries log the
+	 * subxids of a transaction in XLOG_XACT_ASSIGNMENT records that often
+	 * and no running-xacts record lists more than that many subxids per
+	 * transaction, however large max_cached_subxids is.
+	 *
+	 * Snapshots taken outside recovery can hold all the cached subxids of
+	 * all backends; we refer to that size as TOTAL_MAX_CACHED_SUBXIDS.
 	 *
 	 * Ideally we'd only create this structure if we were actually doing hot
 	 * standby in the current run, but we don't know that yet at the time
 	 * shared memory is being set up.
 	 */
-#define TOTAL_MAX_CACHED_SUBXIDS \
+#define TOTAL_MAX_KNOWN_ASSIGNED_XIDS \
 	((PGPROC_MAX_CACHED_SUBXIDS + 1) * PROCARRAY_MAXPROCS)
+#define TOTAL_MAX_CACHED_SUBXIDS \
+	((max_cached_subxids + 1) * PROCARRAY_MAXPROCS)
 
 	if (EnableHotStandby)
 	{
 		size = add_size(size,
 						mul_size(sizeof(TransactionId),
-								 TOTAL_MAX_CACHED_SUBXIDS));
+								 TOTAL_MAX_KNOWN_ASSIGNED_XIDS));
+		size = add_size(size,
+						mul_size(sizeof(bool), TOTAL_MAX_KNOWN_ASSIGNED_XIDS));
 		size = add_size(size,
-						mul_size(sizeof(bool), TOTAL_MAX_CACHED_SUBXIDS));
+						mul_size(sizeof(int32), TOTAL_MAX_KNOWN_ASSIGNED_XIDS));
 	}
 
 	return size;
@@ -437,7 +503,7 @@ CreateSharedProcArray(void)
 		 */
 		procArray->numProcs = 0;
 		procArray->maxProcs = PROCARRAY_MAXPROCS;
-		procArray->maxKnownAssignedXids = TOTAL_MAX_CACHED_SUBXIDS;
+		procArray->maxKnownAssignedXids = TOTAL_MAX_KNOWN_ASSIGNED_XIDS;
 		procArray->numKnownAssignedXids = 0;
 		procArray->tailKnownAssignedXids = 0;
 		procArray->headKnownAssignedXids = 0;
@@ -448,6 +514,19 @@ CreateSharedProcArray(void)
 		ShmemVariableCache->xactCompletionCount = 1;
 	}
 
+	runningXids = (RunningXidsData *)
+		ShmemInitStruct("Running Xids",
+						add_size(offsetof(RunningXidsData, xids),
+								 mul_size(sizeof(RunningXidEntry),
+										  PROCARRAY_MAXPROCS)),
+						&found);
+	if (!found)
+	{
+		SpinLockInit(&runningXids->mutex);
+		pg_atomic_init_u64(&runningXids->changeCount, 0);
+		runningXids->numXids = 0;
+	}
+
 	allProcs = ProcGlobal->allProcs;
 
 	/* Create or attach to the KnownAssignedXids arrays too, if needed */
@@ -456,13 +535,98 @@ CreateSharedProcArray(void)
 		KnownAssignedXids = (TransactionId *)
 			ShmemInitStruct("KnownAssignedXids",
 							mul_size(sizeof(TransactionId),
-									 TOTAL_MAX_CACHED_SUBXIDS),
+									 TOTAL_MAX_KNOWN_ASSIGNED_XIDS),
 							&found);
 		KnownAssignedXidsValid = (bool *)
 			ShmemInitStruct("KnownAssignedXidsValid",
-							mul_size(sizeof(bool), TOTAL_MAX_CACHED_SUBXIDS),
+							mul_size(sizeof(bool),
+									 TOTAL_MAX_KNOWN_ASSIGNED_XIDS),
 							&found);
+		KnownAssignedXidsNext = (int32 *)
+			ShmemInitStruct("KnownAssignedXidsNext",
+							mul_size(sizeof(int32),
+									 TOTAL_MAX_KNOWN_ASSIGNED_XIDS),
+							&found);
+	}
+}
+
+/*
+ * Start and finish a change of the set of running xids, for the benefit of
+ * lock-free readers of the running xids list.  The caller must hold
+ * ProcArrayLock exclusively, which serializes the changes.
+ */
+static inline void
+RunningXidsBeginChange(void)
+{
+	Assert(LWLockHeldByMeInMode(ProcArrayLock, LW_EXCLUSIVE));
+	Assert((pg_atomic_read_u64(&runningXids->changeCount) & 1) == 0);
+
+	/* acts as a full barrier, so that readers see this before our changes */
+	pg_atomic_fetch_add_u64(&runningXids->changeCount, 1);
+}
+
+static inline void
+RunningXidsEndChange(void)
+{
+	/* acts as a full barrier, so that readers see our changes before this */
+	pg_atomic_fetch_add_u64(&runningXids->changeCount, 1);
+}
+
+/*
+ * ProcArrayAddRunningXid -- enter a newly assigned top-level xid into the
+ * list of running xids.
+ *
+ * The caller must hold XidGenLock, so that the entry is in place before any
+ * later xid can be assigned (and so before it can complete), or exclusive
+ * ProcArrayLock.
+ */
+void
+ProcArrayAddRunningXid(PGPROC *proc, TransactionId xid)
+{
+	int			index;
+
+	Assert(TransactionIdIsNormal(xid));
+	Assert(proc->runningXidIndex < 0);
+
+	SpinLockAcquire(&runningXids->mutex);
+	index = runningXids->numXids;
+	Assert(index < procArray->maxProcs);
+	runningXids->xids[index].xid = xid;
+	runningXids->xids[index].pgprocno = proc->pgprocno;
+	proc->runningXidIndex = index;
+	/* see RunningXidsData */
+	pg_write_barrier();
+	runningXids->numXids = index + 1;
+	SpinLockRelease(&runningXids->mutex);
+}
+
+/*
+ * Remove the proc's entry, if any, from the list of running xids.  Must be
+ * called between RunningXidsBeginChange() and RunningXidsEndChange().
+ */
+static void
+RunningXidsRemove(PGPROC *proc)
+{
+	int			index;
+	int			last;
+
+	SpinLockAcquire(&runningXids->mutex);
+	index = proc->runningXidIndex;
+	if (index >= 0)
+	{
+		Assert(index < runningXids->numXids);
+		Assert(runningXids->xids[index].pgprocno == proc->pgprocno);
+
+		last = runningXids->numXids - 1;
+		if (index != last)
+		{
+			runningXids->xids[index] = runningXids->xids[last];
+			allProcs[runningXids->xids[index].pgprocno].runningXidIndex = index;
+		}
+		runningXids->numXids = last;
+		proc->runningXidIndex = -1;
 	}
+	SpinLockRelease(&runningXids->mutex);
 }
 
 /*
@@ -532,6 +696,10 @@ ProcArrayAdd(PGPROC *proc)
 	ProcGlobal->subxidStates[index] = proc->subxidStatus;
 	ProcGlobal->statusFlags[index] = proc->statusFlags;
 
+	/* a live 2PC gxact keeps its xid running */
+	if (TransactionIdIsValid(proc->xid))
+		ProcArrayAddRunningXid(proc, proc->xid);
+
 	arrayP->numProcs++;
 
 	/* adjust pgxactoff for all following PGPROCs */
@@ -562,25 +730,54 @@ ProcArrayAdd(PGPROC *proc)
  * case we must advance latestCompletedXid.  (This is essentially the same
  * as ProcArrayEndTransaction followed by removal of the PGPROC, but we take
  * the ProcArrayLock only once, and don't damage the content of the PGPROC;
- * twophase.c depends on the latter.)
+ * twophase.c depends on the latter.)  Like ProcArrayEndTransaction, that
+ * case uses group XID clearing if ProcArrayLock is contended.
  */
 void
 ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 {
-	ProcArrayStruct *arrayP = procArray;
-	int			myoff;
-	int			movecount;
-
 #ifdef XIDCACHE_DEBUG
 	/* dump stats at backend shutdown, but not prepared-xact end */
 	if (proc->pid != 0)
 		DisplayXidCache();
 #endif
 
+	if (!TransactionIdIsValid(latestXid))
+		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	else if (!LWLockConditionalAcquire(ProcArrayLock, LW_EXCLUSIVE))
+	{
+		ProcArrayGroupClearXid(MyProc, proc, latestXid);
+		return;
+	}
+
 	/* See ProcGlobal comment explaining why both locks are held */
-	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
 
+	ProcArrayRemoveInternal(proc, latestXid);
+
+	/*
+	 * Release in reversed acquisition order, to reduce frequency of having to
+	 * wait for XidGenLock while holding ProcArrayLock.
+	 */
+	LWLockRelease(XidGenLock);
+	LWLockRelease(ProcArrayLock);
+}
+
+/*
+ * Remove a PGPROC from the shared array.
+ *
+ * Caller must hold ProcArrayLock and XidGenLock exclusively.
+ */
+static void
+ProcArrayRemoveInternal(PGPROC *proc, TransactionId latestXid)
+{
+	ProcArrayStruct *arrayP = procArray;
+	int			myoff;
+	int			movecount;
+
+	Assert(LWLockHeldByMeInMode(ProcArrayLock, LW_EXCLUSIVE));
+	Assert(LWLockHeldByMeInMode(XidGenLock, LW_EXCLUSIVE));
+
 	myoff = proc->pgxactoff;
 
 	Assert(myoff >= 0 && myoff < arrayP->numProcs);
@@ -590,6 +787,8 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 	{
 		Assert(TransactionIdIsValid(ProcGlobal->xids[myoff]));
 
+		RunningXidsBeginChange();
+
 		/* Advance global latestCompletedXid while holding the lock */
 		MaintainLatestCompletedXid(latestXid);
 
@@ -599,11 +798,15 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		ProcGlobal->xids[myoff] = InvalidTransactionId;
 		ProcGlobal->subxidStates[myoff].overflowed = false;
 		ProcGlobal->subxidStates[myoff].count = 0;
+		RunningXidsRemove(proc);
+
+		RunningXidsEndChange();
 	}
 	else
 	{
 		/* Shouldn't be trying to remove a live transaction here */
 		Assert(!TransactionIdIsValid(ProcGlobal->xids[myoff]));
+		Assert(proc->runningXidIndex < 0);
 	}
 
 	Assert(!TransactionIdIsValid(ProcGlobal->xids[myoff]));
@@ -643,13 +846,6 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 
 		allProcs[procno].pgxactoff = index;
 	}
-
-	/*
-	 * Release in reversed acquisition order, to reduce frequency of having to
-	 * wait for XidGenLock while holding ProcArrayLock.
-	 */
-	LWLockRelease(XidGenLock);
-	LWLockRelease(ProcArrayLock);
 }
 
 
@@ -690,7 +886,7 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 			LWLockRelease(ProcArrayLock);
 		}
 		else
-			ProcArrayGroupClearXid(proc, latestXid);
+			ProcArrayGroupClearXid(proc, NULL, latestXid);
 	}
 	else
 	{
@@ -743,7 +939,10 @@ ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid)
 	Assert(TransactionIdIsValid(ProcGlobal->xids[pgxactoff]));
 	Assert(ProcGlobal->xids[pgxactoff] == proc->xid);
 
+	RunningXidsBeginChange();
+
 	ProcGlobal->xids[pgxactoff] = InvalidTransactionId;
+	RunningXidsRemove(proc);
 	proc->xid = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	proc->xmin = InvalidTransactionId;
@@ -777,6 +976,8 @@ ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid)
 
 	/* Same with xactCompletionCount  */
 	ShmemVariableCache->xactCompletionCount++;
+
+	RunningXidsEndChange();
 }
 
 /*
@@ -790,20 +991,27 @@ ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid)
  * around ProcArrayLock when many processes are trying to commit at once,
  * since the lock need not be repeatedly handed off from one committing
  * process to the next.
+ *
+ * If removeProc isn't NULL, we are finishing a prepared transaction, and the
+ * leader removes its dummy PGPROC from the array instead of clearing our
+ * XID, as ProcArrayRemove does.  For that it needs XidGenLock as well.
  */
 static void
-ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
+ProcArrayGroupClearXid(PGPROC *proc, PGPROC *removeProc,
+					   TransactionId latestXid)
 {
 	PROC_HDR   *procglobal = ProcGlobal;
 	uint32		nextidx;
 	uint32		wakeidx;
+	bool		xidGenLockHeld = false;
 
 	/* We should definitely have an XID to clear. */
-	Assert(TransactionIdIsValid(proc->xid));
+	Assert(TransactionIdIsValid(removeProc ? removeProc->xid : proc->xid));
 
 	/* Add ourselves to the list of processes needing a group XID clear. */
 	proc->procArrayGroupMember = true;
 	proc->procArrayGroupMemberXid = latestXid;
+	proc->procArrayGroupMemberRemove = removeProc;
 	nextidx = pg_atomic_read_u32(&procglobal->procArrayGroupFirst);
 	while (true)
 	{
@@ -864,13 +1072,27 @@ ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid)
 	{
 		PGPROC	   *nextproc = &allProcs[nextidx];
 
-		ProcArrayEndTransactionInternal(nextproc, nextproc->procArrayGroupMemberXid);
+		if (nextproc->procArrayGroupMemberRemove != NULL)
+		{
+			if (!xidGenLockHeld)
+			{
+				LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
+				xidGenLockHeld = true;
+			}
+			ProcArrayRemoveInternal(nextproc->procArrayGroupMemberRemove,
+									nextproc->procArrayGroupMemberXid);
+		}
+		else
+			ProcArrayEndTransactionInternal(nextproc,
+											nextproc->procArrayGroupMemberXid);
 
 		/* Move to next proc in list. */
 		nextidx = pg_atomic_read_u32(&nextproc->procArrayGroupNext);
 	}
 
-	/* We're done with the lock now. */
+	/* We're done with the locks now. */
+	if (xidGenLockHeld)
+		LWLockRelease(XidGenLock);
 	LWLockRelease(ProcArrayLock);
 
 	/*
@@ -928,7 +1150,10 @@ ProcArrayClearTransaction(PGPROC *proc)
 
 	pgxactoff = proc->pgxactoff;
 
+	RunningXidsBeginChange();
+
 	ProcGlobal->xids[pgxactoff] = InvalidTransactionId;
+	RunningXidsRemove(proc);
 	proc->xid = InvalidTransactionId;
 
 	proc->lxid = InvalidLocalTransactionId;
@@ -958,6 +1183,8 @@ ProcArrayClearTransaction(PGPROC *proc)
 		proc->subxidStatus.overflowed = false;
 	}
 
+	RunningXidsEndChange();
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -1440,7 +1667,7 @@ TransactionIdIsInProgress(TransactionId xid)
 		 * known-assigned list. If we later finish recovery, we no longer need
 		 * the bigger array, but we don't bother to shrink it.
 		 */
-		int			maxxids = RecoveryInProgress() ? TOTAL_MAX_CACHED_SUBXIDS : arrayP->maxProcs;
+		int			maxxids = RecoveryInProgress() ? TOTAL_MAX_KNOWN_ASSIGNED_XIDS : arrayP->maxProcs;
 
 		xids = (TransactionId *) malloc(maxxids * sizeof(TransactionId));
 		if (xids == NULL)
@@ -2094,6 +2321,104 @@ GetSnapshotDataInitOldSnapshot(Snapshot snapshot)
 	}
 }
 
+/*
+ * Helper function for GetSnapshotData() and GetSnapshotDataFast(), which
+ * advances the bounds of GlobalVis{Shared,Catalog,Data,Temp}Rels from the
+ * contents of a new snapshot.
+ *
+ * oldestxid is ShmemVariableCache->oldestXid as read while holding
+ * ProcArrayLock, or InvalidTransactionId if the caller doesn't hold it; the
+ * lower bounds are left alone in the latter case.
+ */
+static void
+GetSnapshotDataUpdateGlobalVis(FullTransactionId latest_completed,
+							   TransactionId xmin, TransactionId myxid,
+							   TransactionId replication_slot_xmin,
+							   TransactionId replication_slot_catalog_xmin,
+							   TransactionId oldestxid)
+{
+	TransactionId def_vis_xid;
+	TransactionId def_vis_xid_data;
+	FullTransactionId def_vis_fxid;
+	FullTransactionId def_vis_fxid_data;
+
+	/* Check whether there's a replication slot requiring an older xmin. */
+	def_vis_xid_data =
+		TransactionIdOlder(xmin, replication_slot_xmin);
+
+	/*
+	 * Rows in non-shared, non-catalog tables possibly could be vacuumed
+	 * if older than this xid.
+	 */
+	def_vis_xid = def_vis_xid_data;
+
+	/*
+	 * Check whether there's a replication slot requiring an older catalog
+	 * xmin.
+	 */
+	def_vis_xid =
+		TransactionIdOlder(replication_slot_catalog_xmin, def_vis_xid);
+
+	def_vis_fxid = FullXidRelativeTo(latest_completed, def_vis_xid);
+	def_vis_fxid_data = FullXidRelativeTo(latest_completed, def_vis_xid_data);
+
+	/*
+	 * Check if we can increase upper bound. As a previous
+	 * GlobalVisUpdate() might have computed more aggressive values, don't
+	 * overwrite them if so.
+	 */
+	GlobalVisSharedRels.definitely_needed =
+		FullTransactionIdNewer(def_vis_fxid,
+							   GlobalVisSharedRels.definitely_needed);
+	GlobalVisCatalogRels.definitely_needed =
+		FullTransactionIdNewer(def_vis_fxid,
+							   GlobalVisCatalogRels.definitely_needed);
+	GlobalVisDataRels.definitely_needed =
+		FullTransactionIdNewer(def_vis_fxid_data,
+							   GlobalVisDataRels.definitely_needed);
+	/* See temp_oldest_nonremovable computation in ComputeXidHorizons() */
+	if (TransactionIdIsNormal(myxid))
+		GlobalVisTempRels.definitely_needed =
+			FullXidRelativeTo(latest_completed, myxid);
+	else
+	{
+		GlobalVisTempRels.definitely_needed = latest_completed;
+		FullTransactionIdAdvance(&GlobalVisTempRels.definitely_needed);
+	}
+
+	/*
+	 * Check if we know that we can initialize or increase the lower
+	 * bound. Currently the only cheap way to do so is to use
+	 * ShmemVariableCache->oldestXid as input.
+	 *
+	 * We should definitely be able to do better. We could e.g. put a
+	 * global lower bound value into ShmemVariableCache.
+	 */
+	if (TransactionIdIsValid(oldestxid))
+	{
+		/*
+		 * Converting oldestXid is only safe when xid horizon cannot
+		 * advance, i.e. holding locks. While the caller doesn't hold the
+		 * lock anymore, all the necessary data has been gathered with lock
+		 * held.
+		 */
+		FullTransactionId oldestfxid = FullXidRelativeTo(latest_completed,
+														 oldestxid);
+
+		GlobalVisSharedRels.maybe_needed =
+			FullTransactionIdNewer(GlobalVisSharedRels.maybe_needed,
+								   oldestfxid);
+		GlobalVisCatalogRels.maybe_needed =
+			FullTransactionIdNewer(GlobalVisCatalogRels.maybe_needed,
+								   oldestfxid);
+		GlobalVisDataRels.maybe_needed =
+			FullTransactionIdNewer(GlobalVisDataRels.maybe_needed,
+								   oldestfxid);
+	}
+	/* accurate value known */
+	GlobalVisTempRels.maybe_needed = GlobalVisTempRels.definitely_needed;
+}
+
 /*
  * Helper function for GetSnapshotData() that checks if the bulk of the
  * visibility information in the snapshot is still valid. If so, it updates
@@ -2153,6 +2478,181 @@ GetSnapshotDataReuse(Snapshot snapshot)
 	return true;
 }
 
+/*
+ * Helper function for GetSnapshotData() that tries to build the snapshot
+ * from the list of running xids, without acquiring ProcArrayLock.  Returns
+ * false if the caller has to do it the hard way.
+ *
+ * The list is copied optimistically, and the copy is only used if the
+ * list's changeCount didn't change meanwhile; see RunningXidsData.  Like
+ * GetSnapshotDataReuse(), we don't need to copy anything if no transaction
+ * with an xid has completed since the snapshot was last built.
+ *
+ * Holding ProcArrayLock while computing the snapshot's xmin and entering it
+ * into MyProc->xmin normally prevents the xids the snapshot considers running
+ * from completing, and the xmin horizon from advancing past them, before our
+ * xmin is visible to others.  Without the lock, we recheck changeCount after
+ * storing MyProc->xmin, with a full barrier in between: if it is still the
+ * same, no transaction completed before the store became visible.  If it
+ * changed, we have to copy the list again; that copy is safe, because all the
+ * xids it sees running were still running after our xmin was visible, and
+ * they can't precede it, as they were running (or not assigned yet) when the
+ * first copy was made.  The first xmin may have been too old by then, which
+ * just holds back the horizon slightly longer than necessary.
+ *
+ * This is not used during recovery, where snapshots are built from
+ * KnownAssignedXids, nor for the first snapshot taken by a backend, which
+ * has to initialize the lower bounds of GlobalVis* while holding the lock.
+ */
+static bool
+GetSnapshotDataFast(Snapshot snapshot)
+{
+	TransactionId myxid = MyProc->xid;
+	bool		setxmin = !TransactionIdIsValid(MyProc->xmin);
+
+	if (!TransactionIdIsValid(RecentXmin) || RecoveryInProgress())
+		return false;
+
+	for (int attempt = 0; attempt < SNAPSHOT_FAST_MAX_ATTEMPTS; attempt++)
+	{
+		uint64		changeCount;
+		uint64		curXactCompletionCount;
+		FullTransactionId latest_completed;
+		TransactionId xmin;
+		TransactionId xmax;
+		int			count = 0;
+		int			subcount = 0;
+		bool		suboverflowed = false;
+
+		changeCount = pg_atomic_read_u64(&runningXids->changeCount);
+		if (changeCount & 1)
+		{
+			/* someone is changing the list right now */
+			pg_spin_delay();
+			continue;
+		}
+		pg_read_barrier();
+
+		latest_completed = ShmemVariableCache->latestCompletedXid;
+		curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
+		if (snapshot->snapXactCompletionCount != 0 &&
+			curXactCompletionCount == snapshot->snapXactCompletionCount)
+		{
+			/* same contents as last time, see GetSnapshotDataReuse() */
+			xmin = snapshot->xmin;
+			xmax = snapshot->xmax;
+			count = snapshot->xcnt;
+			subcount = snapshot->subxcnt;
+			suboverflowed = snapshot->suboverflowed;
+		}
+		else
+		{
+			int			numXids = runningXids->numXids;
+			TransactionId *xip = snapshot->xip;
+
+			/* the contents are going to be overwritten */
+			snapshot->snapXactCompletionCount = 0;
+
+			/* xmax is always latestCompletedXid + 1 */
+			xmax = XidFromFullTransactionId(latest_completed);
+			TransactionIdAdvance(xmax);
+			Assert(TransactionIdIsNormal(xmax));
+
+			/* initialize xmin calculation with xmax */
+			xmin = xmax;
+
+			/* take own xid into account, saves a check inside the loop */
+			if (TransactionIdIsNormal(myxid) &&
+				NormalTransactionIdPrecedes(myxid, xmin))
+				xmin = myxid;
+
+			pg_read_barrier();	/* pairs with ProcArrayAddRunningXid */
+
+			/* see the equivalent loop in GetSnapshotData() */
+			for (int i = 0; i < numXids; i++)
+			{
+				TransactionId xid = runningXids->xids[i].xid;
+				int			pgprocno = runningXids->xids[i].pgprocno;
+				PGPROC	   *proc = &allProcs[pgprocno];
+
+				if (pgprocno == MyProc->pgprocno)
+					continue;
+				if (!NormalTransactionIdPrecedes(xid, xmax))
+					continue;
+				if (proc->statusFlags & (PROC_IN_LOGICAL_DECODING | PROC_IN_VACUUM))
+					continue;
+
+				if (NormalTransactionIdPrecedes(xid, xmin))
+					xmin = xid;
+
+				xip[count++] = xid;
+
+				if (!suboverflowed)
+				{
+					if (proc->subxidStatus.overflowed)
+						suboverflowed = true;
+					else
+					{
+						int			nsubxids = proc->subxidStatus.count;
+
+						if (nsubxids > 0)
+						{
+							pg_read_barrier();	/* pairs with GetNewTransactionId */
+
+							memcpy(snapshot->subxip + subcount,
+								   proc->subxids.xids,
+								   nsubxids * sizeof(TransactionId));
+							subcount += nsubxids;
+						}
+					}
+				}
+			}
+		}
+
+		pg_read_barrier();
+		if (pg_atomic_read_u64(&runningXids->changeCount) != changeCount)
+			continue;
+
+		if (setxmin)
+		{
+			MyProc->xmin = TransactionXmin = xmin;
+			setxmin = false;
+
+			pg_memory_barrier();
+			if (pg_atomic_read_u64(&runningXids->changeCount) != changeCount)
+				continue;
+		}
+
+		GetSnapshotDataUpdateGlobalVis(latest_completed, xmin, myxid,
+									   procArray->replication_slot_xmin,
+									   procArray->replication_slot_catalog_xmin,
+									   InvalidTransactionId);
+
+		RecentXmin = xmin;
+		Assert(TransactionIdPrecedesOrEquals(TransactionXmin, RecentXmin));
+
+		snapshot->xmin = xmin;
+		snapshot->xmax = xmax;
+		snapshot->xcnt = count;
+		snapshot->subxcnt = subcount;
+		snapshot->suboverflowed = suboverflowed;
+		snapshot->snapXactCompletionCount = curXactCompletionCount;
+		snapshot->takenDuringRecovery = false;
+
+		snapshot->curcid = GetCurrentCommandId(false);
+		snapshot->active_count = 0;
+		snapshot->regd_count = 0;
+		snapshot->copied = false;
+
+		GetSnapshotDataInitOldSnapshot(snapshot);
+
+		return true;
+	}
+
+	return false;
+}
+
 /*
  * GetSnapshotData -- returns information about running transactions.
  *
@@ -2240,6 +2740,10 @@ GetSnapshotData(Snapshot snapshot) // snapshot是一个指针
 					 errmsg("out of memory")));
 	}
 
+	/* Usually we can do without ProcArrayLock */
+	if (GetSnapshotDataFast(snapshot))
+		return snapshot;
+
 	/*
 	 * It is sufficient to get shared lock on ProcArrayLock, even if we are
 	 * going to set MyProc->xmin.
@@ -2432,84 +2936,10 @@ GetSnapshotData(Snapshot snapshot) // snapshot是一个指针
 	LWLockRelease(ProcArrayLock);
 
 	/* maintain state for GlobalVis* */
-	{
-		TransactionId def_vis_xid;
-		TransactionId def_vis_xid_data;
-		FullTransactionId def_vis_fxid;
-		FullTransactionId def_vis_fxid_data;
-		FullTransactionId oldestfxid;
-
-		/*
-		 * Converting oldestXid is only safe when xid horizon cannot advance,
-		 * i.e. holding locks. While we don't hold the lock anymore, all the
-		 * necessary data has been gathered with lock held.
-		 */
-		oldestfxid = FullXidRelativeTo(latest_completed, oldestxid);
-
-		/* Check whether there's a replication slot requiring an older xmin. */
-		def_vis_xid_data =
-			TransactionIdOlder(xmin, replication_slot_xmin);
-
-		/*
-		 * Rows in non-shared, non-catalog tables possibly could be vacuumed
-		 * if older than this xid.
-		 */
-		def_vis_xid = def_vis_xid_data;
-
-		/*
-		 * Check whether there's a replication slot requiring an older catalog
-		 * xmin.
-		 */
-		def_vis_xid =
-			TransactionIdOlder(replication_slot_catalog_xmin, def_vis_xid);
-
-		def_vis_fxid = FullXidRelativeTo(latest_completed, def_vis_xid);
-		def_vis_fxid_data = FullXidRelativeTo(latest_completed, def_vis_xid_data);
-
-		/*
-		 * Check if we can increase upper bound. As a previous
-		 * GlobalVisUpdate() might have computed more aggressive values, don't
-		 * overwrite them if so.
-		 */
-		GlobalVisSharedRels.definitely_needed =
-			FullTransactionIdNewer(def_vis_fxid,
-								   GlobalVisSharedRels.definitely_needed);
-		GlobalVisCatalogRels.definitely_needed =
-			FullTransactionIdNewer(def_vis_fxid,
-								   GlobalVisCatalogRels.definitely_needed);
-		GlobalVisDataRels.definitely_needed =
-			FullTransactionIdNewer(def_vis_fxid_data,
-								   GlobalVisDataRels.definitely_needed);
-		/* See temp_oldest_nonremovable computation in ComputeXidHorizons() */
-		if (TransactionIdIsNormal(myxid))
-			GlobalVisTempRels.definitely_needed =
-				FullXidRelativeTo(latest_completed, myxid);
-		else
-		{
-			GlobalVisTempRels.definitely_needed = latest_completed;
-			FullTransactionIdAdvance(&GlobalVisTempRels.definitely_needed);
-		}
-
-		/*
-		 * Check if we know that we can initialize or increase the lower
-		 * bound. Currently the only cheap way to do so is to use
-		 * ShmemVariableCache->oldestXid as input.
-		 *
-		 * We should definitely be able to do better. We could e.g. put a
-		 * global lower bound value into ShmemVariableCache.
-		 */
-		GlobalVisSharedRels.maybe_needed =
-			FullTransactionIdNewer(GlobalVisSharedRels.maybe_needed,
-								   oldestfxid);
-		GlobalVisCatalogRels.maybe_needed =
-			FullTransactionIdNewer(GlobalVisCatalogRels.maybe_needed,
-								   oldestfxid);
-		GlobalVisDataRels.maybe_needed =
-			FullTransactionIdNewer(GlobalVisDataRels.maybe_needed,
-								   oldestfxid);
-		/* accurate value known */
-		GlobalVisTempRels.maybe_needed = GlobalVisTempRels.definitely_needed;
-	}
+	GetSnapshotDataUpdateGlobalVis(latest_completed, xmin, myxid,
+								   replication_slot_xmin,
+								   replication_slot_catalog_xmin,
+								   oldestxid);
 
 	RecentXmin = xmin;
 	Assert(TransactionIdPrecedesOrEquals(TransactionXmin, RecentXmin));
@@ -2781,7 +3211,14 @@ GetRunningTransactionData(void)
 		if (TransactionIdPrecedes(xid, oldestRunningXid))
 			oldestRunningXid = xid;
 
-		if (ProcGlobal->subxidStates[index].overflowed)
+		/*
+		 * A standby's KnownAssignedXids has room for only
+		 * PGPROC_MAX_CACHED_SUBXIDS subxids per transaction, so report a
+		 * larger cache as overflowed.  The standby learns about the subxids
+		 * from the XLOG_XACT_ASSIGNMENT records instead.
+		 */
+		if (ProcGlobal->subxidStates[index].overflowed ||
+			ProcGlobal->subxidStates[index].count > PGPROC_MAX_CACHED_SUBXIDS)
 			suboverflowed = true;
 
 		/*
@@ -3666,8 +4103,9 @@ CountUserBackends(Oid roleid)
  * CountOtherDBBackends -- check for other backends running in the given DB
  *
  * If there are other backends in the DB, we will wait a maximum of 5 seconds
- * for them to exit.  Autovacuum backends are encouraged to exit early by
- * sending them SIGTERM, but normal user backends are just waited for.
+ * for them to exit.  Autovacuum backends and idle pooled parallel workers are
+ * encouraged to exit early by sending them SIGTERM, but normal user backends
+ * are just waited for.
  *
  * The current backend is always ignored; it is caller's responsibility to
  * check whether the current backend uses the given DB, if it's important.
@@ -3744,6 +4182,7 @@ CountOtherDBBackends(Oid databaseId, int *nbackends, int *nprepared)
 		 */
 		for (index = 0; index < nautovacs; index++)
 			(void) kill(autovac_pids[index], SIGTERM);	/* ignore any error */
+		TerminateIdleParallelWorkers(databaseId);
 
 		/* sleep, then try again */
 		pg_usleep(100 * 1000L); /* 100ms */
@@ -3948,6 +4387,8 @@ XidCacheRemoveRunningXids(TransactionId xid,
 	 */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 
+	RunningXidsBeginChange();
+
 	mysubxidstat = &ProcGlobal->subxidStates[MyProc->pgxactoff];
 
 	/*
@@ -4003,6 +4444,8 @@ XidCacheRemoveRunningXids(TransactionId xid,
 	/* ... and xactCompletionCount */
 	ShmemVariableCache->xactCompletionCount++;
 
+	RunningXidsEndChange();
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -4553,6 +4996,19 @@ KnownAssignedTransactionIdsIdleMaintenance(void)
  * immediately moving the array contents.  In most cases only a small fraction
  * of the array contains valid entries at any instant.
  *
+ * To let scans step over gaps without visiting every invalid slot, a third
+ * parallel array KnownAssignedXidsNext[] holds, for each element i, an offset
+ * such that every element strictly between i and i + KnownAssignedXidsNext[i]
+ * is known to be invalid.  Offsets are 1 when elements are added or moved by
+ * compression, and scans that find a run of invalid elements lengthen the
+ * offset of the valid element preceding it, so later scans jump straight
+ * over the run.  Because an element that is invalid stays invalid until the
+ * next compression, any offset that was once correct remains correct.
+ * Backends holding only shared ProcArrayLock are allowed to store into
+ * KnownAssignedXidsNext[]: every value any of them can compute respects the
+ * invariant, and an int32 store is atomic, so racing updates are harmless.
+ * Elements at or beyond head are never touched by readers.
+ *
  * Although only the startup process can ever change the KnownAssignedXids
  * data structure, we still need interlocking so that standby backends will
  * not observe invalid intermediate states.  The convention is that backends
@@ -4574,13 +5030,14 @@ KnownAssignedTransactionIdsIdleMaintenance(void)
  * Algorithmic analysis:
  *
  * If we have a maximum of M slots, with N XIDs currently spread across
- * S elements then we have N <= S <= M always.
+ * S elements then we have N <= S <= M always.  Let G be the number of runs
+ * of invalid elements that no scan has yet stepped over.
  *
  *	* Adding a new XID is O(1) and needs little locking (unless compression
  *		must happen)
- *	* Compressing the array is O(S) and requires exclusive lock
+ *	* Compressing the array is O(N + G) and requires exclusive lock
  *	* Removing an XID is O(logS) and requires exclusive lock
- *	* Taking a snapshot is O(S) and requires shared lock
+ *	* Taking a snapshot is O(N + G) and requires shared lock
  *	* Checking for an XID is O(logS) and requires shared lock
  *
  * In comparison, using a hash table for KnownAssignedXids would mean that
@@ -4591,8 +5048,11 @@ KnownAssignedTransactionIdsIdleMaintenance(void)
  * decide when to compress the array, though trimming also helps reduce
  * frequency of compressing. The heuristic requires us to track the number of
  * currently valid XIDs in the array (N).  Except in special cases, we'll
- * compress when S >= 2N.  Bounding S at 2N in turn bounds the time for
- * taking a snapshot to be O(N), which it would have to be anyway.
+ * compress when S >= 2N and more than half of the array has been used up.
+ * Since the skip offsets keep snapshots close to O(N) regardless of S, the
+ * latter condition mainly serves to keep the forced KAX_NO_SPACE compression,
+ * which happens without warning while adding XIDs, rare; most compression is
+ * done when the startup process is about to go idle.
  */
 
 
@@ -4659,9 +5119,11 @@ KnownAssignedXidsCompress(KAXCompressReason reason, bool haveLock)
 
 		/*
 		 * Furthermore, compress only if the used part of the array is less
-		 * than 50% full (see comments above).
+		 * than 50% full, and only once head has passed the middle of the
+		 * array (see comments above).
 		 */
-		if (nelements < 2 * pArray->numKnownAssignedXids)
+		if (nelements < 2 * pArray->numKnownAssignedXids ||
+			head < pArray->maxKnownAssignedXids / 2)
 			return;
 	}
 	else if (reason == KAX_STARTUP_PROCESS_IDLE)
@@ -4691,12 +5153,13 @@ KnownAssignedXidsCompress(KAXCompressReason reason, bool haveLock)
 	 * re-aligning data to 0th element.
 	 */
 	compress_index = 0;
-	for (i = tail; i < head; i++)
+	for (i = tail; i < head; i += KnownAssignedXidsNext[i])
 	{
 		if (KnownAssignedXidsValid[i])
 		{
 			KnownAssignedXids[compress_index] = KnownAssignedXids[i];
 			KnownAssignedXidsValid[compress_index] = true;
+			KnownAssignedXidsNext[compress_index] = 1;
 			compress_index++;
 		}
 	}
@@ -4799,6 +5262,7 @@ KnownAssignedXidsAdd(TransactionId from_xid, TransactionId to_xid,
 	{
 		KnownAssignedXids[head] = next_xid;
 		KnownAssignedXidsValid[head] = true;
+		KnownAssignedXidsNext[head] = 1;
 		TransactionIdAdvance(next_xid);
 		head++;
 	}
@@ -4903,9 +5367,9 @@ KnownAssignedXidsSearch(TransactionId xid, bool remove)
 		 */
 		if (result_index == tail)
 		{
-			tail++;
+			tail += KnownAssignedXidsNext[tail];
 			while (tail < head && !KnownAssignedXidsValid[tail])
-				tail++;
+				tail += KnownAssignedXidsNext[tail];
 			if (tail >= head)
 			{
 				/* Array is empty, so we can reset both pointers */
@@ -5014,7 +5478,7 @@ KnownAssignedXidsRemovePreceding(TransactionId removeXid)
 	tail = pArray->tailKnownAssignedXids;
 	head = pArray->headKnownAssignedXids;
 
-	for (i = tail; i < head; i++)
+	for (i = tail; i < head; i += KnownAssignedXidsNext[i])
 	{
 		if (KnownAssignedXidsValid[i])
 		{
@@ -5037,7 +5501,7 @@ KnownAssignedXidsRemovePreceding(TransactionId removeXid)
 	/*
 	 * Advance the tail pointer if we've marked the tail item invalid.
 	 */
-	for (i = tail; i < head; i++)
+	for (i = tail; i < head; i += KnownAssignedXidsNext[i])
 	{
 		if (KnownAssignedXidsValid[i])
 			break;
@@ -5088,6 +5552,7 @@ KnownAssignedXidsGetAndSetXmin(TransactionId *xarray, TransactionId *xmin,
 	int			head,
 				tail;
 	int			i;
+	int			prev;
 
 	/*
 	 * Fetch head just once, since it may change while we loop. We can stop
@@ -5103,13 +5568,24 @@ KnownAssignedXidsGetAndSetXmin(TransactionId *xarray, TransactionId *xmin,
 	head = procArray->headKnownAssignedXids;
 	SpinLockRelease(&procArray->known_assigned_xids_lck);
 
-	for (i = tail; i < head; i++)
+	prev = tail;
+	for (i = tail; i < head; i += KnownAssignedXidsNext[i])
 	{
 		/* Skip any gaps in the array */
 		if (KnownAssignedXidsValid[i])
 		{
 			TransactionId knownXid = KnownAssignedXids[i];
 
+			/*
+			 * Everything between the previous valid element and this one is
+			 * invalid, so let later scans jump straight here.  Avoid the
+			 * store when it wouldn't change anything, to keep the cache line
+			 * shared among concurrent snapshot takers.
+			 */
+			if (i - prev > KnownAssignedXidsNext[prev])
+				KnownAssignedXidsNext[prev] = i - prev;
+			prev = i;
+
 			/*
 			 * Update xmin if required.  Only the first XID need be checked,
 			 * since the array is sorted.
@@ -5153,7 +5629,7 @@ KnownAssignedXidsGetOldestXmin(void)
 	head = procArray->headKnownAssignedXids;
 	SpinLockRelease(&procArray->known_assigned_xids_lck);
 
-	for (i = tail; i < head; i++)
+	for (i = tail; i < head; i += KnownAssignedXidsNext[i])
 	{
 		/* Skip any gaps in the array */
 		if (KnownAssignedXidsValid[i])
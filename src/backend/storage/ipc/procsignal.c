@@ -32,6 +32,7 @@
 #include "storage/smgr.h"
 #include "storage/sinval.h"
 #include "tcop/tcopprot.h"
+#include "utils/backend_memory.h"
 #include "utils/memutils.h"
 
 /*
@@ -658,6 +659,9 @@ procsignal_sigusr1_handler(SIGNAL_ARGS)
 	if (CheckProcSignal(PROCSIG_LOG_MEMORY_CONTEXT))
 		HandleLogMemoryContextInterrupt();
 
+	if (CheckProcSignal(PROCSIG_PUBLISH_MEMORY_CONTEXTS))
+		HandlePublishMemoryContextsInterrupt();
+
 	if (CheckProcSignal(PROCSIG_PARALLEL_APPLY_MESSAGE))
 		HandleParallelApplyMessageInterrupt();
 
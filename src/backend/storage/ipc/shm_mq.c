@@ -21,6 +21,7 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/pg_bitutils.h"
+#include "portability/instr_time.h"
 #include "postmaster/bgworker.h"
 #include "storage/procsignal.h"
 #include "storage/shm_mq.h"
@@ -50,6 +51,19 @@
  * after waking up.  Since SetLatch begins with a memory barrier and ResetLatch
  * ends with one, this should be OK.
  *
+ * mq_receiver_waiting and mq_sender_waiting let each side skip setting the
+ * counterparty's latch unless the counterparty is actually about to wait for
+ * it.  A process that finds nothing to do sets its own flag, issues a full
+ * memory barrier and then rechecks the counter it is waiting on before
+ * sleeping; the counterparty advances that counter, issues a full barrier and
+ * then tests the flag.  So either the waiter sees the new counter value or
+ * the counterparty sees the flag, clears it and sets the latch.  Detaching
+ * always sets the latch, regardless of the flags.
+ *
+ * mq_send_stalls and mq_receive_stalls count how many times the sender found
+ * the queue full, or the receiver found it empty, and had to go to sleep;
+ * each is only written by its own side, and is only meant for reporting.
+ *
  * mq_ring_size and mq_ring_offset never change after initialization, and
  * can therefore be read without the lock.
  *
@@ -76,6 +90,10 @@ struct shm_mq
 	PGPROC	   *mq_sender;
 	pg_atomic_uint64 mq_bytes_read;
 	pg_atomic_uint64 mq_bytes_written;
+	pg_atomic_uint32 mq_receiver_waiting;
+	pg_atomic_uint32 mq_sender_waiting;
+	uint64		mq_send_stalls;
+	uint64		mq_receive_stalls;
 	Size		mq_ring_size;
 	bool		mq_detached;
 	uint8		mq_ring_offset;
@@ -161,6 +179,11 @@ static bool shm_mq_counterparty_gone(shm_mq *mq,
 									 BackgroundWorkerHandle *handle);
 static bool shm_mq_wait_internal(shm_mq *mq, PGPROC **ptr,
 								 BackgroundWorkerHandle *handle);
+static bool shm_mq_busy_poll(shm_mq *mq, pg_atomic_uint64 *counter,
+							 uint64 seen);
+static bool shm_mq_prepare_wait(shm_mq *mq, pg_atomic_uint32 *waiting,
+								pg_atomic_uint64 *counter, uint64 seen);
+static void shm_mq_wake(pg_atomic_uint32 *waiting, PGPROC *proc);
 static void shm_mq_inc_bytes_read(shm_mq *mq, Size n);
 static void shm_mq_inc_bytes_written(shm_mq *mq, Size n);
 static void shm_mq_detach_callback(dsm_segment *seg, Datum arg);
@@ -192,6 +215,10 @@ shm_mq_create(void *address, Size size)
 	mq->mq_sender = NULL;
 	pg_atomic_init_u64(&mq->mq_bytes_read, 0);
 	pg_atomic_init_u64(&mq->mq_bytes_written, 0);
+	pg_atomic_init_u32(&mq->mq_receiver_waiting, 0);
+	pg_atomic_init_u32(&mq->mq_sender_waiting, 0);
+	mq->mq_send_stalls = 0;
+	mq->mq_receive_stalls = 0;
 	mq->mq_ring_size = size - data_offset;
 	mq->mq_detached = false;
 	mq->mq_ring_offset = data_offset - offsetof(shm_mq, mq_ring);
@@ -534,13 +561,13 @@ shm_mq_sendv(shm_mq_handle *mqh, shm_mq_iovec *iov, int iovcnt, bool nowait,
 	/*
 	 * If the caller has requested force flush or we have written more than
 	 * 1/4 of the ring size, mark it as written in shared memory and notify
-	 * the receiver.
+	 * the receiver, if it's waiting for data.
 	 */
 	if (force_flush || mqh->mqh_send_pending > (mq->mq_ring_size >> 2))
 	{
 		shm_mq_inc_bytes_written(mq, mqh->mqh_send_pending);
 		if (receiver != NULL)
-			SetLatch(&receiver->procLatch);
+			shm_mq_wake(&mq->mq_receiver_waiting, receiver);
 		mqh->mqh_send_pending = 0;
 	}
 
@@ -908,6 +935,18 @@ shm_mq_get_queue(shm_mq_handle *mqh)
 	return mqh->mqh_queue;
 }
 
+/*
+ * Report how many times the sender had to wait because the queue was full,
+ * and the receiver because it was empty.  The counts are only stable once
+ * both sides are done with the queue, but the queue itself must still exist.
+ */
+void
+shm_mq_get_stalls(shm_mq *mq, uint64 *send_stalls, uint64 *receive_stalls)
+{
+	*send_stalls = mq->mq_send_stalls;
+	*receive_stalls = mq->mq_receive_stalls;
+}
+
 /*
  * Write bytes into a shared message queue.
  */
@@ -994,7 +1033,7 @@ shm_mq_send_bytes(shm_mq_handle *mqh, Size nbytes, const void *data,
 			 * Therefore, we can read it without acquiring the spinlock.
 			 */
 			Assert(mqh->mqh_counterparty_attached);
-			SetLatch(&mq->mq_receiver->procLatch);
+			shm_mq_wake(&mq->mq_receiver_waiting, mq->mq_receiver);
 
 			/*
 			 * We have just updated the mqh_send_pending bytes in the shared
@@ -1002,13 +1041,32 @@ shm_mq_send_bytes(shm_mq_handle *mqh, Size nbytes, const void *data,
 			 */
 			mqh->mqh_send_pending = 0;
 
-			/* Skip manipulation of our latch if nowait = true. */
+			/*
+			 * Skip manipulation of our latch if nowait = true; but the caller
+			 * is going to wait for it to be set, so ask the receiver to do
+			 * that once it has made room.
+			 */
 			if (nowait)
 			{
+				if (!shm_mq_prepare_wait(mq, &mq->mq_sender_waiting,
+										 &mq->mq_bytes_read, rb))
+					continue;
 				*bytes_written = sent;
 				return SHM_MQ_WOULD_BLOCK;
 			}
 
+			/*
+			 * A receiver running on another CPU often makes room within a
+			 * few microseconds, much sooner than a sleep and a wakeup would
+			 * take, so spin for a little while before going to sleep.
+			 */
+			if (shm_mq_busy_poll(mq, &mq->mq_bytes_read, rb))
+				continue;
+			if (!shm_mq_prepare_wait(mq, &mq->mq_sender_waiting,
+									 &mq->mq_bytes_read, rb))
+				continue;
+			mq->mq_send_stalls++;
+
 			/*
 			 * Wait for our latch to be set.  It might already be set for some
 			 * unrelated reason, but that'll just result in one extra trip
@@ -1151,9 +1209,26 @@ shm_mq_receive_bytes(shm_mq_handle *mqh, Size bytes_needed, bool nowait,
 			mqh->mqh_consume_pending = 0;
 		}
 
-		/* Skip manipulation of our latch if nowait = true. */
+		/*
+		 * Skip manipulation of our latch if nowait = true; but the caller is
+		 * going to wait for it to be set, so ask the sender to do that once
+		 * it has written more data.
+		 */
 		if (nowait)
+		{
+			if (!shm_mq_prepare_wait(mq, &mq->mq_receiver_waiting,
+									 &mq->mq_bytes_written, written))
+				continue;
 			return SHM_MQ_WOULD_BLOCK;
+		}
+
+		/* As in shm_mq_send_bytes, spin for a little while first. */
+		if (shm_mq_busy_poll(mq, &mq->mq_bytes_written, written))
+			continue;
+		if (!shm_mq_prepare_wait(mq, &mq->mq_receiver_waiting,
+								 &mq->mq_bytes_written, written))
+			continue;
+		mq->mq_receive_stalls++;
 
 		/*
 		 * Wait for our latch to be set.  It might already be set for some
@@ -1264,6 +1339,80 @@ shm_mq_wait_internal(shm_mq *mq, PGPROC **ptr, BackgroundWorkerHandle *handle)
 	return result;
 }
 
+/*
+ * Spin for up to SHM_MQ_BUSY_POLL_USEC microseconds, waiting for *counter to
+ * move on from the value we last saw.  Returns true if it did, or if the queue
+ * was detached, false if we gave up.
+ */
+static bool
+shm_mq_busy_poll(shm_mq *mq, pg_atomic_uint64 *counter, uint64 seen)
+{
+	instr_time	start;
+	instr_time	now;
+	int			spins = 0;
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (;;)
+	{
+		pg_spin_delay();
+		pg_compiler_barrier();
+		if (pg_atomic_read_u64(counter) != seen || mq->mq_detached)
+			return true;
+
+		/* Don't read the clock on every iteration. */
+		if (++spins % 32 == 0)
+		{
+			INSTR_TIME_SET_CURRENT(now);
+			INSTR_TIME_SUBTRACT(now, start);
+			if (INSTR_TIME_GET_MICROSEC(now) >= SHM_MQ_BUSY_POLL_USEC)
+				return false;
+		}
+	}
+}
+
+/*
+ * Advertise that we're about to wait for the counterparty to move *counter on
+ * from the value we last saw, and then recheck it.  Returns false, without
+ * leaving the flag set, if we need not wait after all, because the counter
+ * has moved meanwhile or the queue has been detached.
+ */
+static bool
+shm_mq_prepare_wait(shm_mq *mq, pg_atomic_uint32 *waiting,
+					pg_atomic_uint64 *counter, uint64 seen)
+{
+	pg_atomic_write_u32(waiting, 1);
+
+	/* Pairs with the barrier in shm_mq_wake. */
+	pg_memory_barrier();
+
+	if (pg_atomic_read_u64(counter) != seen || mq->mq_detached)
+	{
+		pg_atomic_write_u32(waiting, 0);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Set the latch of the counterparty, if it has said that it's waiting for us
+ * to make progress.  The caller must have advanced the relevant counter.
+ */
+static void
+shm_mq_wake(pg_atomic_uint32 *waiting, PGPROC *proc)
+{
+	/*
+	 * Separate the counter update from the test of the flag.  Pairs with the
+	 * barrier in shm_mq_prepare_wait.
+	 */
+	pg_memory_barrier();
+
+	if (pg_atomic_read_u32(waiting) != 0)
+	{
+		pg_atomic_write_u32(waiting, 0);
+		SetLatch(&proc->procLatch);
+	}
+}
+
 /*
  * Increment the number of bytes read.
  */
@@ -1294,7 +1443,7 @@ shm_mq_inc_bytes_read(shm_mq *mq, Size n)
 	 */
 	sender = mq->mq_sender;
 	Assert(sender != NULL);
-	SetLatch(&sender->procLatch);
+	shm_mq_wake(&mq->mq_sender_waiting, sender);
 }
 
 /*
@@ -65,15 +65,19 @@
 
 #include "postgres.h"
 
+#include <unistd.h>
+
 #include "access/transam.h"
 #include "fmgr.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "port/pg_numa.h"
 #include "storage/lwlock.h"
 #include "storage/pg_shmem.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
 #include "utils/builtins.h"
+#include "utils/guc_hooks.h"
 
 static void *ShmemAllocRaw(Size size, Size *allocated_size);
 
@@ -88,6 +92,10 @@ static void *ShmemEnd;			/* end+1 address of shared memory */
 slock_t    *ShmemLock;			/* spinlock for shared memory and LWLock
 								 * allocation */
 
+/* NUMA placement state, set up by ShmemNumaAvailable() */
+static int	numa_state = 0;		/* 0 = not checked, 1 = usable, -1 = not */
+static int	numa_nodes = 1;
+
 static HTAB *ShmemIndex = NULL; /* primary index hashtable for shmem */
 
 
@@ -584,3 +592,248 @@ pg_get_shmem_allocations(PG_FUNCTION_ARGS)
 
 	return (Datum) 0;
 }
+
+/*
+ * GUC check_hook for numa and numa_pin_backends
+ */
+bool
+check_numa(bool *newval, void **extra, GucSource source)
+{
+#ifndef USE_LIBNUMA
+	if (*newval)
+	{
+		GUC_check_errdetail("NUMA support is not compiled into this build.");
+		return false;
+	}
+#endif
+	return true;
+}
+
+/*
+ * ShmemNumaAvailable -- should shared memory be placed on NUMA nodes?
+ *
+ * True if the numa setting is on and the system supports it.  If it's on but
+ * NUMA turns out to be unavailable, we complain once and carry on without.
+ */
+bool
+ShmemNumaAvailable(void)
+{
+	if (!numa_enabled)
+		return false;
+
+	if (numa_state == 0)
+	{
+		if (pg_numa_init() == -1)
+		{
+			ereport(WARNING,
+					(errmsg("NUMA is not available on this system"),
+					 errdetail("Shared memory will not be placed on NUMA nodes.")));
+			numa_state = -1;
+		}
+		else
+		{
+			numa_nodes = pg_numa_get_max_node() + 1;
+			numa_state = 1;
+		}
+	}
+
+	return numa_state == 1;
+}
+
+/*
+ * ShmemNumaNodes -- number of NUMA nodes to spread shared memory over
+ */
+int
+ShmemNumaNodes(void)
+{
+	return ShmemNumaAvailable() ? numa_nodes : 1;
+}
+
+/*
+ * The granularity at which memory can be placed on nodes.  Huge pages can't
+ * be split, so if they may be in use, work in units of them, which is just
+ * coarser than needed otherwise.
+ */
+static Size
+ShmemNumaPageSize(void)
+{
+	Size		pagesize = (Size) sysconf(_SC_PAGESIZE);
+
+	if (huge_pages != HUGE_PAGES_OFF)
+	{
+		Size		hugepagesize;
+
+		/* reports 0 where huge pages aren't supported */
+		GetHugePageSize(&hugepagesize, NULL);
+		pagesize = Max(pagesize, hugepagesize);
+	}
+
+	return pagesize;
+}
+
+/*
+ * ShmemNumaInterleave -- spread a shared memory area across all NUMA nodes
+ *
+ * Pages are distributed round-robin.  Call this before the area is first
+ * touched, if possible; pages already faulted in have to be moved.  Failure
+ * is not fatal, since this only affects performance.
+ */
+void
+ShmemNumaInterleave(const char *name, void *ptr, Size size)
+{
+	if (!ShmemNumaAvailable())
+		return;
+
+	if (pg_numa_interleave_memory(ptr, size, ShmemNumaPageSize()) != 0)
+		ereport(WARNING,
+				(errmsg("could not interleave shared memory area \"%s\" across NUMA nodes: %m",
+						name)));
+}
+
+/*
+ * ShmemNumaBind -- place a shared memory area on one NUMA node
+ *
+ * Like ShmemNumaInterleave(), but for memory used mostly by processes running
+ * on that node.  Only whole pages inside the area are affected.
+ */
+void
+ShmemNumaBind(const char *name, void *ptr, Size size, int node)
+{
+	if (!ShmemNumaAvailable())
+		return;
+
+	if (pg_numa_bind_memory(ptr, size, ShmemNumaPageSize(), node) != 0)
+		ereport(WARNING,
+				(errmsg("could not place shared memory area \"%s\" on NUMA node %d: %m",
+						name, node)));
+}
+
+/*
+ * ShmemPrefault -- fault in every page of the main shared memory segment
+ *
+ * The pages are only read, so this can be done after the contents have been
+ * initialized; for shared memory, a read fault allocates the page just as a
+ * write fault would.  We step by the OS page size even if huge pages are in
+ * use, since we don't know whether the attempt to get them succeeded.
+ */
+void
+ShmemPrefault(void)
+{
+	Size		os_page_size = (Size) sysconf(_SC_PAGESIZE);
+	char	   *startptr = (char *) TYPEALIGN_DOWN(os_page_size, ShmemBase);
+
+	for (char *ptr = startptr; ptr < (char *) ShmemEnd; ptr += os_page_size)
+		(void) *(volatile char *) ptr;
+}
+
+/* SQL SRF showing NUMA placement of allocated shared memory */
+Datum
+pg_get_shmem_allocations_numa(PG_FUNCTION_ARGS)
+{
+#define PG_GET_SHMEM_NUMA_SIZES_COLS 3
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	HASH_SEQ_STATUS hstat;
+	ShmemIndexEnt *ent;
+	Datum		values[PG_GET_SHMEM_NUMA_SIZES_COLS];
+	bool		nulls[PG_GET_SHMEM_NUMA_SIZES_COLS];
+	Size		os_page_size;
+	int			max_nodes;
+	Size	   *nodes;
+	void	  **page_ptrs;
+	int		   *pages_status;
+	uint64		max_pages;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (pg_numa_init() == -1)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("NUMA is not available on this system")));
+
+	max_nodes = pg_numa_get_max_node() + 1;
+	nodes = palloc(sizeof(Size) * (max_nodes + 1));
+
+	/*
+	 * Query one pointer per OS page of each allocation.  Each chunk is
+	 * handled in turn, so size the arrays for the largest one.
+	 */
+	os_page_size = (Size) sysconf(_SC_PAGESIZE);
+	max_pages = 0;
+
+	LWLockAcquire(ShmemIndexLock, LW_SHARED);
+
+	hash_seq_init(&hstat, ShmemIndex);
+	while ((ent = (ShmemIndexEnt *) hash_seq_search(&hstat)) != NULL)
+		max_pages = Max(max_pages,
+						(ent->allocated_size + os_page_size - 1) / os_page_size + 1);
+
+	page_ptrs = palloc_extended(sizeof(void *) * max_pages, MCXT_ALLOC_HUGE);
+	pages_status = palloc_extended(sizeof(int) * max_pages, MCXT_ALLOC_HUGE);
+
+	memset(nulls, 0, sizeof(nulls));
+	hash_seq_init(&hstat, ShmemIndex);
+	while ((ent = (ShmemIndexEnt *) hash_seq_search(&hstat)) != NULL)
+	{
+		char	   *startptr;
+		char	   *endptr;
+		uint64		npages = 0;
+
+		startptr = (char *) TYPEALIGN_DOWN(os_page_size, ent->location);
+		endptr = (char *) ent->location + ent->allocated_size;
+
+		for (char *ptr = startptr; ptr < endptr; ptr += os_page_size)
+		{
+			/*
+			 * The kernel only reports the node of pages mapped in this
+			 * process, so read from each one first.  Pages nobody has written
+			 * to yet get placed by this, according to the area's policy.
+			 */
+			(void) *(volatile char *) ptr;
+			page_ptrs[npages] = ptr;
+			pages_status[npages] = 0;
+			npages++;
+		}
+
+		if (pg_numa_query_pages(0, npages, page_ptrs, pages_status) == -1)
+			ereport(ERROR,
+					(errmsg("failed NUMA pages inquiry status: %m")));
+
+		memset(nodes, 0, sizeof(Size) * (max_nodes + 1));
+		for (uint64 i = 0; i < npages; i++)
+		{
+			int			s = pages_status[i];
+
+			/* Not yet faulted in, or some other error: count separately */
+			if (s < 0 || s >= max_nodes)
+				nodes[max_nodes] += os_page_size;
+			else
+				nodes[s] += os_page_size;
+		}
+
+		for (int i = 0; i <= max_nodes; i++)
+		{
+			if (nodes[i] == 0)
+				continue;
+
+			values[0] = CStringGetTextDatum(ent->key);
+			if (i == max_nodes)
+			{
+				nulls[1] = true;
+				values[1] = (Datum) 0;
+			}
+			else
+			{
+				nulls[1] = false;
+				values[1] = Int32GetDatum(i);
+			}
+			values[2] = Int64GetDatum(nodes[i]);
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+								 values, nulls);
+		}
+	}
+
+	LWLockRelease(ShmemIndexLock);
+
+	return (Datum) 0;
+}
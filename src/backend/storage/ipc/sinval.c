@@ -21,6 +21,9 @@
 #include "storage/proc.h"
 #include "storage/sinvaladt.h"
 #include "utils/inval.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
+#include "utils/sharedtypcache.h"
 
 
 uint64		SharedInvalidMessageCounter;
@@ -48,7 +51,23 @@ volatile sig_atomic_t catchupInterruptPending = false;
 void
 SendSharedInvalidMessages(const SharedInvalidationMessage *msgs, int n)
 {
+	/*
+	 * The shared catalog cache must forget the tuples first, lest a backend
+	 * that processes the messages load the stale tuples from there again.
+	 */
+	SharedCatCacheInvalidate(msgs, n);
+	SharedTypeCacheInvalidate(msgs, n);
+
 	SIInsertDataEntries(msgs, n);
+
+	/*
+	 * The shared plan cache must instead be told afterwards, so that a
+	 * backend that sees its counters move finds the messages in the queue.
+	 */
+	SharedPlanCacheInvalidate(msgs, n);
+
+	/* and the shared type cache wants both; see sharedtypcache.c */
+	SharedTypeCacheInvalidate(msgs, n);
 }
 
 /*
@@ -25,123 +25,142 @@
 #include "storage/procsignal.h"
 #include "storage/shmem.h"
 #include "storage/sinvaladt.h"
-#include "storage/spin.h"
 
 /*
- * Conceptually, the shared cache invalidation messages are stored in an
- * infinite array, where maxMsgNum is the next array subscript to store a
- * submitted message in, minMsgNum is the smallest array subscript containing
- * a message not yet read by all backends, and we always have maxMsgNum >=
- * minMsgNum.  (They are equal when there are no messages pending.)  For each
- * active backend, there is a nextMsgNum pointer indicating the next message it
- * needs to read; we have maxMsgNum >= nextMsgNum >= minMsgNum for every
- * backend.
+ * Conceptually, the shared cache invalidation messages are stored in
+ * infinite arrays, one per shard (see below), where maxMsgNum is the next
+ * array subscript to store a submitted message in, minMsgNum is the smallest
+ * array subscript containing a message not yet read by all backends reading
+ * that shard, and we always have maxMsgNum >= minMsgNum.  (They are equal
+ * when there are no messages pending.)  For each active backend, there is a
+ * nextMsgNum pointer per shard it reads indicating the next message it needs
+ * to read; we have maxMsgNum >= nextMsgNum >= minMsgNum for every backend.
  *
  * (In the current implementation, minMsgNum is a lower bound for the
  * per-process nextMsgNum values, but it isn't rigorously kept equal to the
  * smallest nextMsgNum --- it may lag behind.  We only update it when
  * SICleanupQueue is called, and we try not to do that often.)
  *
- * In reality, the messages are stored in a circular buffer of MAXNUMMESSAGES
- * entries.  We translate MsgNum values into circular-buffer indexes by
- * computing MsgNum % MAXNUMMESSAGES (this should be fast as long as
- * MAXNUMMESSAGES is a constant and a power of 2).  As long as maxMsgNum
- * doesn't exceed minMsgNum by more than MAXNUMMESSAGES, we have enough space
+ * In reality, the messages of a shard are stored in a circular buffer of
+ * sinval_queue_size entries.  We translate MsgNum values into circular-buffer
+ * indexes by computing MsgNum % sinval_queue_size.  As long as maxMsgNum
+ * doesn't exceed minMsgNum by more than the buffer size, we have enough space
  * in the buffer.  If the buffer does overflow, we recover by setting the
  * "reset" flag for each backend that has fallen too far behind.  A backend
  * that is in "reset" state is ignored while determining minMsgNum.  When
  * it does finally attempt to receive inval messages, it must discard all
- * its invalidatable state, since it won't know what it missed.
+ * its invalidatable state, since it won't know what it missed.  MsgNum
+ * values are 64 bits wide, so they never wrap around.
+ *
+ * Almost all messages concern objects of a single database, and only
+ * backends connected to that database are interested in them.  So rather
+ * than a single queue, which DDL in one database could overflow and thereby
+ * reset the caches of the backends of all the others, there is one shard
+ * for messages about shared catalogs and relations (dbId 0), which every
+ * backend reads, and sinval_database_shards shards for the messages about
+ * objects of individual databases, which a database's messages are assigned
+ * to by its OID.  A backend reads the shared shard, and once it is connected
+ * to a database (see SharedInvalBackendSetDatabase()) also that database's
+ * shard.  With no more active databases than database shards, DDL in one
+ * database can thus never overflow a queue another database's backends
+ * read, except for DDL on shared catalogs.  Messages for the other databases
+ * sharing a shard are delivered too, and ignored by the receiving backend
+ * just as before.
  *
  * To reduce the probability of needing resets, we send a "catchup" interrupt
  * to any backend that seems to be falling unreasonably far behind.  The
- * normal behavior is that at most one such interrupt is in flight at a time;
- * when a backend completes processing a catchup interrupt, it executes
- * SICleanupQueue, which will signal the next-furthest-behind backend if
- * needed.  This avoids undue contention from multiple backends all trying
- * to catch up at once.  However, the furthest-back backend might be stuck
- * in a state where it can't catch up.  Eventually it will get reset, so it
- * won't cause any more problems for anyone but itself.  But we don't want
- * to find that a bunch of other backends are now too close to the reset
- * threshold to be saved.  So SICleanupQueue is designed to occasionally
- * send extra catchup interrupts as the queue gets fuller, to backends that
- * are far behind and haven't gotten one yet.  As long as there aren't a lot
- * of "stuck" backends, we won't need a lot of extra interrupts, since ones
- * that aren't stuck will propagate their interrupts to the next guy.
- *
- * We would have problems if the MsgNum values overflow an integer, so
- * whenever minMsgNum exceeds MSGNUMWRAPAROUND, we subtract MSGNUMWRAPAROUND
- * from all the MsgNum variables simultaneously.  MSGNUMWRAPAROUND can be
- * large so that we don't need to do this often.  It must be a multiple of
- * MAXNUMMESSAGES so that the existing circular-buffer entries don't need
- * to be moved when we do it.
+ * normal behavior is that at most one such interrupt per shard is in flight
+ * at a time; when a backend completes processing a catchup interrupt, it
+ * executes SICleanupQueue, which will signal the next-furthest-behind
+ * backend if needed.  This avoids undue contention from multiple backends
+ * all trying to catch up at once.  However, the furthest-back backend might
+ * be stuck in a state where it can't catch up.  Eventually it will get
+ * reset, so it won't cause any more problems for anyone but itself.  But we
+ * don't want to find that a bunch of other backends are now too close to
+ * the reset threshold to be saved.  So SICleanupQueue is designed to
+ * occasionally send extra catchup interrupts as the queue gets fuller, to
+ * backends that are far behind and haven't gotten one yet.  As long as
+ * there aren't a lot of "stuck" backends, we won't need a lot of extra
+ * interrupts, since ones that aren't stuck will propagate their interrupts
+ * to the next guy.
  *
- * Access to the shared sinval array is protected by two locks, SInvalReadLock
- * and SInvalWriteLock.  Readers take SInvalReadLock in shared mode; this
- * authorizes them to modify their own ProcState but not to modify or even
- * look at anyone else's.  When we need to perform array-wide updates,
- * such as in SICleanupQueue, we take SInvalReadLock in exclusive mode to
- * lock out all readers.  Writers take SInvalWriteLock (always in exclusive
- * mode) to serialize adding messages to the queue.  Note that a writer
- * can operate in parallel with one or more readers, because the writer
- * has no need to touch anyone's ProcState, except in the infrequent cases
- * when SICleanupQueue is needed.  The only point of overlap is that
- * the writer wants to change maxMsgNum while readers need to read it.
- * We deal with that by having a spinlock that readers must take for just
- * long enough to read maxMsgNum, while writers take it for just long enough
- * to write maxMsgNum.  (The exact rule is that you need the spinlock to
- * read maxMsgNum if you are not holding SInvalWriteLock, and you need the
- * spinlock to write maxMsgNum unless you are holding both locks.)
+ * Each shard has an LWLock, which writers take (always in exclusive mode)
+ * to serialize adding messages to the shard, and which serializes the
+ * array-wide updates of SICleanupQueue with them.  SInvalWriteLock only
+ * protects the allocation of procState entries.
  *
- * Note: since maxMsgNum is an int and hence presumably atomically readable/
- * writable, the spinlock might seem unnecessary.  The reason it is needed
- * is to provide a memory barrier: we need to be sure that messages written
- * to the array are actually there before maxMsgNum is increased, and that
- * readers will see that data after fetching maxMsgNum.  Multiprocessors
- * that have weak memory-ordering guarantees can fail without the memory
- * barrier instructions that are included in the spinlock sequences.
+ * Readers take no lock at all.  A reader only modifies its own ProcState,
+ * and finds out how far to read from maxMsgNum, which the writer advances
+ * with a write barrier after storing the messages, and which the reader
+ * fetches with a read barrier before reading them.  The messages between the
+ * reader's nextMsgNum and maxMsgNum can only be overwritten once
+ * SICleanupQueue has set the reader's resetState, and the writer issues a
+ * write barrier after that; so the reader rechecks resetState after copying
+ * the messages, and if it's been set meanwhile, discards them and resets.
+ * The values a reader stores into its nextMsgNum and its flags may race
+ * with SICleanupQueue looking at them, but the consequences are limited to
+ * a needless reset or catchup interrupt, or to a too small minMsgNum.
  */
 
 
 /*
  * Configurable parameters.
  *
- * MAXNUMMESSAGES: max number of shared-inval messages we can buffer.
- * Must be a power of 2 for speed.
+ * sinval_queue_size: max number of shared-inval messages each shard can
+ * buffer.
  *
- * MSGNUMWRAPAROUND: how often to reduce MsgNum variables to avoid overflow.
- * Must be a multiple of MAXNUMMESSAGES.  Should be large.
+ * sinval_database_shards: number of shards for the messages of individual
+ * databases.
  *
- * CLEANUP_MIN: the minimum number of messages that must be in the buffer
- * before we bother to call SICleanupQueue.
+ * CLEANUP_MIN: the minimum number of messages that must be in a shard's
+ * buffer before we bother to call SICleanupQueue.
  *
  * CLEANUP_QUANTUM: how often (in messages) to call SICleanupQueue once
- * we exceed CLEANUP_MIN.  Should be a power of 2 for speed.
+ * we exceed CLEANUP_MIN.
  *
  * SIG_THRESHOLD: the minimum number of messages a backend must have fallen
  * behind before we'll send it PROCSIG_CATCHUP_INTERRUPT.
  *
- * WRITE_QUANTUM: the max number of messages to push into the buffer per
+ * WRITE_QUANTUM: the max number of messages to push into a buffer per
  * iteration of SIInsertDataEntries.  Noncritical but should be less than
  * CLEANUP_QUANTUM, because we only consider calling SICleanupQueue once
  * per iteration.
  */
 
-#define MAXNUMMESSAGES 4096
-#define MSGNUMWRAPAROUND (MAXNUMMESSAGES * 262144)
-#define CLEANUP_MIN (MAXNUMMESSAGES / 2)
-#define CLEANUP_QUANTUM (MAXNUMMESSAGES / 16)
-#define SIG_THRESHOLD (MAXNUMMESSAGES / 2)
+int			sinval_queue_size = 4096;
+int			sinval_database_shards = 16;
+
+#define CLEANUP_MIN(segP) ((segP)->queueSize / 2)
+#define CLEANUP_QUANTUM(segP) ((segP)->queueSize / 16)
+#define SIG_THRESHOLD(segP) ((segP)->queueSize / 2)
 #define WRITE_QUANTUM 64
 
+/* Shard for messages about shared objects, and the max # of shards */
+#define SHARED_SHARD 0
+#define MAX_SHARDS (1 + MAX_SINVAL_DATABASE_SHARDS)
+
+/* Indexes into ProcState->nextMsgNum[] */
+#define SHARED_SHARD_POS 0
+#define DATABASE_SHARD_POS 1
+
 /* Per-backend state in shared invalidation structure */
 typedef struct ProcState
 {
 	/* procPid is zero in an inactive ProcState array entry. */
 	pid_t		procPid;		/* PID of backend, for signaling */
 	PGPROC	   *proc;			/* PGPROC of backend */
-	/* nextMsgNum is meaningless if procPid == 0 or resetState is true. */
-	int			nextMsgNum;		/* next message number to read */
+
+	/*
+	 * Index of the shard of our database, or -1 if not connected to one.
+	 * Only changed while holding that shard's lock.
+	 */
+	int			dbShard;
+
+	/*
+	 * Next message number to read from the shared shard and from dbShard.
+	 * Meaningless if procPid == 0 or resetState is true.
+	 */
+	pg_atomic_uint64 nextMsgNum[2];
 	bool		resetState;		/* backend needs to reset its state */
 	bool		signaled;		/* backend has been sent catchup signal */
 	bool		hasMessages;	/* backend has unread messages */
@@ -163,39 +182,78 @@ typedef struct ProcState
 	LocalTransactionId nextLXID;
 } ProcState;
 
+/* A queue of messages */
+typedef struct SIShard
+{
+	LWLock		lock;			/* serializes writers and cleanup */
+	pg_atomic_uint64 maxMsgNum; /* next message number to be assigned */
+	uint64		minMsgNum;		/* oldest message still needed */
+	uint64		nextThreshold;	/* # of messages to call SICleanupQueue */
+} SIShard;
+
 /* Shared cache invalidation memory segment */
 typedef struct SISeg
 {
 	/*
 	 * General state information
 	 */
-	int			minMsgNum;		/* oldest message still needed */
-	int			maxMsgNum;		/* next message number to be assigned */
-	int			nextThreshold;	/* # of messages to call SICleanupQueue */
 	int			lastBackend;	/* index of last active procState entry, +1 */
 	int			maxBackends;	/* size of procState array */
-
-	slock_t		msgnumLock;		/* spinlock protecting maxMsgNum */
+	int			numShards;		/* 1 + sinval_database_shards */
+	int			queueSize;		/* sinval_queue_size */
 
 	/*
-	 * Circular buffer holding shared-inval messages
-	 */
-	SharedInvalidationMessage buffer[MAXNUMMESSAGES];
-
-	/*
-	 * Per-backend invalidation state info (has MaxBackends entries).
+	 * Per-backend invalidation state info (has MaxBackends entries), followed
+	 * by numShards SIShards and their circular buffers of queueSize
+	 * messages each; see SIShardGet() and SIShardBuffer().
 	 */
 	ProcState	procState[FLEXIBLE_ARRAY_MEMBER];
 } SISeg;
 
 static SISeg *shmInvalBuffer;	/* pointer to the shared inval buffer */
+static SIShard *shmInvalShards; /* pointer to its array of shards */
+static SharedInvalidationMessage *shmInvalMessages; /* and to the buffers */
+
+#define SIShardGet(shard) (&shmInvalShards[shard])
+#define SIShardBuffer(segP, shard) \
+	(&shmInvalMessages[(Size) (shard) * (segP)->queueSize])
 
 
 static LocalTransactionId nextLocalTransactionId;
 
 static void CleanupInvalidationState(int status, Datum arg);
+static void SICleanupShard(int shard, bool callerHasLock, int minFree);
 
 
+/*
+ * Return the shard a message goes to.
+ */
+static inline int
+SIMessageShard(SISeg *segP, const SharedInvalidationMessage *msg)
+{
+	Oid			dbId;
+
+	if (msg->id >= 0)
+		dbId = msg->cc.dbId;
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+		dbId = msg->cat.dbId;
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+		dbId = msg->rc.dbId;
+	else if (msg->id == SHAREDINVALSMGR_ID)
+		dbId = msg->sm.rlocator.dbOid;
+	else if (msg->id == SHAREDINVALRELMAP_ID)
+		dbId = msg->rm.dbId;
+	else if (msg->id == SHAREDINVALSNAPSHOT_ID)
+		dbId = msg->sn.dbId;
+	else
+		elog(FATAL, "unrecognized SI message ID: %d", msg->id);
+
+	if (!OidIsValid(dbId))
+		return SHARED_SHARD;
+
+	return 1 + dbId % (segP->numShards - 1);
+}
+
 /*
  * SInvalShmemSize --- return shared-memory space needed
  */
@@ -203,6 +261,7 @@ Size
 SInvalShmemSize(void)
 {
 	Size		size;
+	int			numShards = 1 + sinval_database_shards;
 
 	size = offsetof(SISeg, procState);
 
@@ -216,6 +275,11 @@ SInvalShmemSize(void)
 	 */
 	size = add_size(size, mul_size(sizeof(ProcState), MaxBackends));
 
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(sizeof(SIShard), numShards));
+	size = add_size(size, mul_size(sizeof(SharedInvalidationMessage),
+								   mul_size(numShards, sinval_queue_size)));
+
 	return size;
 }
 
@@ -228,29 +292,49 @@ CreateSharedInvalidationState(void)
 {
 	int			i;
 	bool		found;
+	Size		procStateSize;
+
+	StaticAssertStmt(WRITE_QUANTUM < MIN_SINVAL_QUEUE_SIZE / 16,
+					 "WRITE_QUANTUM must be less than the minimum CLEANUP_QUANTUM");
 
 	/* Allocate space in shared memory */
 	shmInvalBuffer = (SISeg *)
 		ShmemInitStruct("shmInvalBuffer", SInvalShmemSize(), &found);
+
+	procStateSize = MAXALIGN(add_size(offsetof(SISeg, procState),
+									  mul_size(sizeof(ProcState), MaxBackends)));
+	shmInvalShards = (SIShard *) ((char *) shmInvalBuffer + procStateSize);
+	shmInvalMessages = (SharedInvalidationMessage *)
+		(shmInvalShards + 1 + sinval_database_shards);
+
 	if (found)
 		return;
 
-	/* Clear message counters, save size of procState array, init spinlock */
-	shmInvalBuffer->minMsgNum = 0;
-	shmInvalBuffer->maxMsgNum = 0;
-	shmInvalBuffer->nextThreshold = CLEANUP_MIN;
+	/* Save the sizes of the arrays */
 	shmInvalBuffer->lastBackend = 0;
 	shmInvalBuffer->maxBackends = MaxBackends;
-	SpinLockInit(&shmInvalBuffer->msgnumLock);
+	shmInvalBuffer->numShards = 1 + sinval_database_shards;
+	shmInvalBuffer->queueSize = sinval_queue_size;
 
-	/* The buffer[] array is initially all unused, so we need not fill it */
+	/* Clear message counters and init locks; buffers need not be filled */
+	for (i = 0; i < shmInvalBuffer->numShards; i++)
+	{
+		SIShard    *shardP = SIShardGet(i);
+
+		LWLockInitialize(&shardP->lock, LWTRANCHE_SINVAL_SHARD);
+		pg_atomic_init_u64(&shardP->maxMsgNum, 0);
+		shardP->minMsgNum = 0;
+		shardP->nextThreshold = CLEANUP_MIN(shmInvalBuffer);
+	}
 
 	/* Mark all backends inactive, and initialize nextLXID */
 	for (i = 0; i < shmInvalBuffer->maxBackends; i++)
 	{
 		shmInvalBuffer->procState[i].procPid = 0;	/* inactive */
 		shmInvalBuffer->procState[i].proc = NULL;
-		shmInvalBuffer->procState[i].nextMsgNum = 0;	/* meaningless */
+		shmInvalBuffer->procState[i].dbShard = -1;
+		pg_atomic_init_u64(&shmInvalBuffer->procState[i].nextMsgNum[SHARED_SHARD_POS], 0);
+		pg_atomic_init_u64(&shmInvalBuffer->procState[i].nextMsgNum[DATABASE_SHARD_POS], 0);
 		shmInvalBuffer->procState[i].resetState = false;
 		shmInvalBuffer->procState[i].signaled = false;
 		shmInvalBuffer->procState[i].hasMessages = false;
@@ -261,6 +345,9 @@ CreateSharedInvalidationState(void)
 /*
  * SharedInvalBackendInit
  *		Initialize a new backend to operate on the sinval buffer
+ *
+ * At first, the backend only receives messages about shared objects; see
+ * SharedInvalBackendSetDatabase().
  */
 void
 SharedInvalBackendInit(bool sendOnly)
@@ -268,12 +355,8 @@ SharedInvalBackendInit(bool sendOnly)
 	int			index;
 	ProcState  *stateP = NULL;
 	SISeg	   *segP = shmInvalBuffer;
+	SIShard    *shardP = SIShardGet(SHARED_SHARD);
 
-	/*
-	 * This can run in parallel with read operations, but not with write
-	 * operations, since SIInsertDataEntries relies on lastBackend to set
-	 * hasMessages appropriately.
-	 */
 	LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
 
 	/* Look for a free entry in the procState array */
@@ -315,15 +398,24 @@ SharedInvalBackendInit(bool sendOnly)
 	/* Fetch next local transaction ID into local memory */
 	nextLocalTransactionId = stateP->nextLXID;
 
-	/* mark myself active, with all extant messages already read */
-	stateP->procPid = MyProcPid;
 	stateP->proc = MyProc;
-	stateP->nextMsgNum = segP->maxMsgNum;
+	stateP->dbShard = -1;
 	stateP->resetState = false;
 	stateP->signaled = false;
 	stateP->hasMessages = false;
 	stateP->sendOnly = sendOnly;
 
+	/*
+	 * Mark myself active, with all extant messages already read.  This has to
+	 * be done while holding the shard's lock, so that writers set our
+	 * hasMessages for anything they add after the maxMsgNum we start with.
+	 */
+	LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
+	pg_atomic_write_u64(&stateP->nextMsgNum[SHARED_SHARD_POS],
+						pg_atomic_read_u64(&shardP->maxMsgNum));
+	stateP->procPid = MyProcPid;
+	LWLockRelease(&shardP->lock);
+
 	LWLockRelease(SInvalWriteLock);
 
 	/* register exit routine to mark my entry inactive at exit */
@@ -332,6 +424,39 @@ SharedInvalBackendInit(bool sendOnly)
 	elog(DEBUG4, "my backend ID is %d", MyBackendId);
 }
 
+/*
+ * SharedInvalBackendSetDatabase
+ *		Start receiving the messages about objects of a database
+ *
+ * Called as soon as MyDatabaseId has been set, before anything of the
+ * database is read into our caches, so that we need none of the messages
+ * sent before.
+ */
+void
+SharedInvalBackendSetDatabase(Oid dbid)
+{
+	SISeg	   *segP = shmInvalBuffer;
+	ProcState  *stateP = &segP->procState[MyBackendId - 1];
+	SharedInvalidationMessage msg;
+	int			shard;
+	SIShard    *shardP;
+
+	Assert(OidIsValid(dbid));
+	Assert(stateP->dbShard < 0);
+
+	/* any message about the database will do to find its shard */
+	msg.rc.id = SHAREDINVALRELCACHE_ID;
+	msg.rc.dbId = dbid;
+	shard = SIMessageShard(segP, &msg);
+	shardP = SIShardGet(shard);
+
+	LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
+	pg_atomic_write_u64(&stateP->nextMsgNum[DATABASE_SHARD_POS],
+						pg_atomic_read_u64(&shardP->maxMsgNum));
+	stateP->dbShard = shard;
+	LWLockRelease(&shardP->lock);
+}
+
 /*
  * CleanupInvalidationState
  *		Mark the current backend as no longer active.
@@ -349,17 +474,26 @@ CleanupInvalidationState(int status, Datum arg)
 
 	Assert(PointerIsValid(segP));
 
-	LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
-
 	stateP = &segP->procState[MyBackendId - 1];
 
+	/* Stop receiving the messages of our database */
+	if (stateP->dbShard >= 0)
+	{
+		SIShard    *shardP = SIShardGet(stateP->dbShard);
+
+		LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
+		stateP->dbShard = -1;
+		LWLockRelease(&shardP->lock);
+	}
+
+	LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
+
 	/* Update next local transaction ID for next holder of this backendID */
 	stateP->nextLXID = nextLocalTransactionId;
 
 	/* Mark myself inactive */
 	stateP->procPid = 0;
 	stateP->proc = NULL;
-	stateP->nextMsgNum = 0;
 	stateP->resetState = false;
 	stateP->signaled = false;
 
@@ -440,13 +574,14 @@ BackendIdGetTransactionIds(int backendID, TransactionId *xid,
 }
 
 /*
- * SIInsertDataEntries
- *		Add new invalidation message(s) to the buffer.
+ * Add new invalidation message(s) to the buffer of one shard.
  */
-void
-SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
+static void
+SIInsertShardEntries(int shard, const SharedInvalidationMessage *data, int n)
 {
 	SISeg	   *segP = shmInvalBuffer;
+	SIShard    *shardP = SIShardGet(shard);
+	SharedInvalidationMessage *buffer = SIShardBuffer(segP, shard);
 
 	/*
 	 * N can be arbitrarily large.  We divide the work into groups of no more
@@ -460,64 +595,145 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 	while (n > 0)
 	{
 		int			nthistime = Min(n, WRITE_QUANTUM);
-		int			numMsgs;
-		int			max;
+		uint64		numMsgs;
+		uint64		max;
 		int			i;
 
 		n -= nthistime;
 
-		LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
+		LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
 
 		/*
 		 * If the buffer is full, we *must* acquire some space.  Clean the
 		 * queue and reset anyone who is preventing space from being freed.
 		 * Otherwise, clean the queue only when it's exceeded the next
 		 * fullness threshold.  We have to loop and recheck the buffer state
-		 * after any call of SICleanupQueue.
+		 * after any call of SICleanupShard.
 		 */
 		for (;;)
 		{
-			numMsgs = segP->maxMsgNum - segP->minMsgNum;
-			if (numMsgs + nthistime > MAXNUMMESSAGES ||
-				numMsgs >= segP->nextThreshold)
-				SICleanupQueue(true, nthistime);
+			max = pg_atomic_read_u64(&shardP->maxMsgNum);
+			numMsgs = max - shardP->minMsgNum;
+			if (numMsgs + nthistime > segP->queueSize ||
+				numMsgs >= shardP->nextThreshold)
+				SICleanupShard(shard, true, nthistime);
 			else
 				break;
 		}
 
+		/*
+		 * Make sure that the resetState of any backend whose unread messages
+		 * we're about to overwrite is visible before the new messages are.
+		 */
+		pg_write_barrier();
+
 		/*
 		 * Insert new message(s) into proper slot of circular buffer
 		 */
-		max = segP->maxMsgNum;
 		while (nthistime-- > 0)
 		{
-			segP->buffer[max % MAXNUMMESSAGES] = *data++;
+			buffer[max % segP->queueSize] = *data++;
 			max++;
 		}
 
-		/* Update current value of maxMsgNum using spinlock */
-		SpinLockAcquire(&segP->msgnumLock);
-		segP->maxMsgNum = max;
-		SpinLockRelease(&segP->msgnumLock);
+		/* The messages must be in place before maxMsgNum says so */
+		pg_write_barrier();
+		pg_atomic_write_u64(&shardP->maxMsgNum, max);
 
 		/*
 		 * Now that the maxMsgNum change is globally visible, we give everyone
-		 * a swift kick to make sure they read the newly added messages.
-		 * Releasing SInvalWriteLock will enforce a full memory barrier, so
-		 * these (unlocked) changes will be committed to memory before we exit
-		 * the function.
+		 * reading the shard a swift kick to make sure they read the newly
+		 * added messages.  Releasing the lock will enforce a full memory
+		 * barrier, so these (unlocked) changes will be committed to memory
+		 * before we exit the function.
 		 */
+		pg_write_barrier();
 		for (i = 0; i < segP->lastBackend; i++)
 		{
 			ProcState  *stateP = &segP->procState[i];
 
-			stateP->hasMessages = true;
+			if (shard == SHARED_SHARD || stateP->dbShard == shard)
+				stateP->hasMessages = true;
+		}
+
+		LWLockRelease(&shardP->lock);
+	}
+}
+
+/*
+ * SIInsertDataEntries
+ *		Add new invalidation message(s) to the buffers.
+ *
+ * The messages are distributed among the shards, keeping their order within
+ * each.
+ */
+void
+SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
+{
+	SISeg	   *segP = shmInvalBuffer;
+	bool		done[MAX_SHARDS];
+	SharedInvalidationMessage batch[WRITE_QUANTUM];
+
+	memset(done, 0, sizeof(bool) * segP->numShards);
+
+	for (int i = 0; i < n; i++)
+	{
+		int			shard = SIMessageShard(segP, &data[i]);
+		int			nbatch = 0;
+
+		if (done[shard])
+			continue;
+		done[shard] = true;
+
+		/* usually all messages go to the same shard */
+		if (i == 0)
+		{
+			int			j;
+
+			for (j = 1; j < n; j++)
+			{
+				if (SIMessageShard(segP, &data[j]) != shard)
+					break;
+			}
+			if (j == n)
+			{
+				SIInsertShardEntries(shard, data, n);
+				return;
+			}
 		}
 
-		LWLockRelease(SInvalWriteLock);
+		for (int j = i; j < n; j++)
+		{
+			if (SIMessageShard(segP, &data[j]) != shard)
+				continue;
+			batch[nbatch++] = data[j];
+			if (nbatch == WRITE_QUANTUM)
+			{
+				SIInsertShardEntries(shard, batch, nbatch);
+				nbatch = 0;
+			}
+		}
+		if (nbatch > 0)
+			SIInsertShardEntries(shard, batch, nbatch);
 	}
 }
 
+/*
+ * Handle a reset: we can say we have dealt with any messages added since the
+ * reset, as well; and that means we should clear the signaled flag, too.
+ */
+static void
+SIResetProcState(SISeg *segP, ProcState *stateP)
+{
+	pg_atomic_write_u64(&stateP->nextMsgNum[SHARED_SHARD_POS],
+						pg_atomic_read_u64(&SIShardGet(SHARED_SHARD)->maxMsgNum));
+	if (stateP->dbShard >= 0)
+		pg_atomic_write_u64(&stateP->nextMsgNum[DATABASE_SHARD_POS],
+							pg_atomic_read_u64(&SIShardGet(stateP->dbShard)->maxMsgNum));
+	stateP->resetState = false;
+	stateP->signaled = false;
+}
+
 /*
  * SIGetDataEntries
  *		get next SI message(s) for current backend, if there are any
@@ -531,37 +747,33 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
  * can assume that there are no more SI messages after the one(s) returned.
  * Otherwise, another call is needed to collect more messages.
  *
- * NB: this can run in parallel with other instances of SIGetDataEntries
- * executing on behalf of other backends, since each instance will modify only
- * fields of its own backend's ProcState, and no instance will look at fields
- * of other backends' ProcStates.  We express this by grabbing SInvalReadLock
- * in shared mode.  Note that this is not exactly the normal (read-only)
- * interpretation of a shared lock! Look closely at the interactions before
- * allowing SInvalReadLock to be grabbed in shared mode for any other reason!
+ * This takes no locks; see the comments at the top of the file for why
+ * that's safe.  It can run in parallel with other instances of
+ * SIGetDataEntries executing on behalf of other backends, since each
+ * instance will modify only fields of its own backend's ProcState.
  *
  * NB: this can also run in parallel with SIInsertDataEntries.  It is not
  * guaranteed that we will return any messages added after the routine is
  * entered.
- *
- * Note: we assume that "datasize" is not so large that it might be important
- * to break our hold on SInvalReadLock into segments.
  */
 int
 SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 {
 	SISeg	   *segP;
 	ProcState  *stateP;
-	int			max;
+	uint64		next[2];
+	bool		caughtUp = true;
+	int			nshards;
 	int			n;
 
 	segP = shmInvalBuffer;
 	stateP = &segP->procState[MyBackendId - 1];
 
 	/*
-	 * Before starting to take locks, do a quick, unlocked test to see whether
-	 * there can possibly be anything to read.  On a multiprocessor system,
-	 * it's possible that this load could migrate backwards and occur before
-	 * we actually enter this function, so we might miss a sinval message that
+	 * Before doing anything else, do a quick test to see whether there can
+	 * possibly be anything to read.  On a multiprocessor system, it's
+	 * possible that this load could migrate backwards and occur before we
+	 * actually enter this function, so we might miss a sinval message that
 	 * was just added by some other processor.  But they can't migrate
 	 * backwards over a preceding lock acquisition, so it should be OK.  If we
 	 * haven't acquired a lock preventing against further relevant
@@ -571,8 +783,6 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	if (!stateP->hasMessages)
 		return 0;
 
-	LWLockAcquire(SInvalReadLock, LW_SHARED);
-
 	/*
 	 * We must reset hasMessages before determining how many messages we're
 	 * going to read.  That way, if new messages arrive after we have
@@ -583,41 +793,59 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	 * better be certain to reset this flag before exiting!
 	 */
 	stateP->hasMessages = false;
-
-	/* Fetch current value of maxMsgNum using spinlock */
-	SpinLockAcquire(&segP->msgnumLock);
-	max = segP->maxMsgNum;
-	SpinLockRelease(&segP->msgnumLock);
+	pg_memory_barrier();
 
 	if (stateP->resetState)
 	{
-		/*
-		 * Force reset.  We can say we have dealt with any messages added
-		 * since the reset, as well; and that means we should clear the
-		 * signaled flag, too.
-		 */
-		stateP->nextMsgNum = max;
-		stateP->resetState = false;
-		stateP->signaled = false;
-		LWLockRelease(SInvalReadLock);
+		SIResetProcState(segP, stateP);
 		return -1;
 	}
 
 	/*
-	 * Retrieve messages and advance backend's counter, until data array is
-	 * full or there are no more messages.
+	 * Retrieve messages, first from the shared shard and then from our
+	 * database's, until data array is full or there are no more messages.
 	 *
 	 * There may be other backends that haven't read the message(s), so we
 	 * cannot delete them here.  SICleanupQueue() will eventually remove them
 	 * from the queue.
 	 */
 	n = 0;
-	while (n < datasize && stateP->nextMsgNum < max)
+	nshards = (stateP->dbShard >= 0) ? 2 : 1;
+	for (int pos = 0; pos < nshards; pos++)
 	{
-		data[n++] = segP->buffer[stateP->nextMsgNum % MAXNUMMESSAGES];
-		stateP->nextMsgNum++;
+		int			shard = (pos == SHARED_SHARD_POS) ? SHARED_SHARD : stateP->dbShard;
+		SIShard    *shardP = SIShardGet(shard);
+		SharedInvalidationMessage *buffer = SIShardBuffer(segP, shard);
+		uint64		max;
+
+		max = pg_atomic_read_u64(&shardP->maxMsgNum);
+		pg_read_barrier();
+
+		next[pos] = pg_atomic_read_u64(&stateP->nextMsgNum[pos]);
+		while (n < datasize && next[pos] < max)
+		{
+			data[n++] = buffer[next[pos] % segP->queueSize];
+			next[pos]++;
+		}
+
+		if (next[pos] < max)
+			caughtUp = false;
 	}
 
+	/*
+	 * If we've been reset meanwhile, the messages we copied may already have
+	 * been overwritten.
+	 */
+	pg_read_barrier();
+	if (stateP->resetState)
+	{
+		SIResetProcState(segP, stateP);
+		return -1;
+	}
+
+	for (int pos = 0; pos < nshards; pos++)
+		pg_atomic_write_u64(&stateP->nextMsgNum[pos], next[pos]);
+
 	/*
 	 * If we have caught up completely, reset our "signaled" flag so that
 	 * we'll get another signal if we fall behind again.
@@ -625,12 +853,11 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	 * If we haven't caught up completely, reset the hasMessages flag so that
 	 * we see the remaining messages next time.
 	 */
-	if (stateP->nextMsgNum >= max)
+	if (caughtUp)
 		stateP->signaled = false;
 	else
 		stateP->hasMessages = true;
 
-	LWLockRelease(SInvalReadLock);
 	return n;
 }
 
@@ -638,7 +865,28 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
  * SICleanupQueue
  *		Remove messages that have been consumed by all active backends
  *
- * callerHasWriteLock is true if caller is holding SInvalWriteLock.
+ * This is called by a backend that has just caught up, to pass on catchup
+ * interrupts; it cleans up the shards the backend reads.  callerHasWriteLock
+ * must be false, and minFree is passed on; see SICleanupShard().
+ */
+void
+SICleanupQueue(bool callerHasWriteLock, int minFree)
+{
+	ProcState  *stateP = &shmInvalBuffer->procState[MyBackendId - 1];
+
+	Assert(!callerHasWriteLock);
+
+	SICleanupShard(SHARED_SHARD, false, minFree);
+	if (stateP->dbShard >= 0)
+		SICleanupShard(stateP->dbShard, false, minFree);
+}
+
+/*
+ * SICleanupShard
+ *		Remove messages of a shard that have been consumed by all active
+ *		backends reading it
+ *
+ * callerHasLock is true if caller is holding the shard's lock.
  * minFree is the minimum number of message slots to make free.
  *
  * Possible side effects of this routine include marking one or more
@@ -646,25 +894,27 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
  * to some backend that seems to be getting too far behind.  We signal at
  * most one backend at a time, for reasons explained at the top of the file.
  *
- * Caution: because we transiently release write lock when we have to signal
+ * Caution: because we transiently release the lock when we have to signal
  * some other backend, it is NOT guaranteed that there are still minFree
  * free message slots at exit.  Caller must recheck and perhaps retry.
  */
-void
-SICleanupQueue(bool callerHasWriteLock, int minFree)
+static void
+SICleanupShard(int shard, bool callerHasLock, int minFree)
 {
 	SISeg	   *segP = shmInvalBuffer;
-	int			min,
+	SIShard    *shardP = SIShardGet(shard);
+	int			pos = (shard == SHARED_SHARD) ? SHARED_SHARD_POS : DATABASE_SHARD_POS;
+	uint64		max,
+				min,
 				minsig,
 				lowbound,
-				numMsgs,
-				i;
+				numMsgs;
+	int			i;
 	ProcState  *needSig = NULL;
 
-	/* Lock out all writers and readers */
-	if (!callerHasWriteLock)
-		LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
-	LWLockAcquire(SInvalReadLock, LW_EXCLUSIVE);
+	/* Lock out all writers */
+	if (!callerHasLock)
+		LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
 
 	/*
 	 * Recompute minMsgNum = minimum of all backends' nextMsgNum, identify the
@@ -673,19 +923,27 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 	 * backends here it is possible for them to keep sending messages without
 	 * a problem even when they are the only active backend.
 	 */
-	min = segP->maxMsgNum;
-	minsig = min - SIG_THRESHOLD;
-	lowbound = min - MAXNUMMESSAGES + minFree;
+	max = pg_atomic_read_u64(&shardP->maxMsgNum);
+	min = max;
+	minsig = (max > SIG_THRESHOLD(segP)) ? max - SIG_THRESHOLD(segP) : 0;
+	lowbound = (max + minFree > segP->queueSize) ?
+		max + minFree - segP->queueSize : 0;
 
 	for (i = 0; i < segP->lastBackend; i++)
 	{
 		ProcState  *stateP = &segP->procState[i];
-		int			n = stateP->nextMsgNum;
+		uint64		n;
 
 		/* Ignore if inactive or already in reset state */
 		if (stateP->procPid == 0 || stateP->resetState || stateP->sendOnly)
 			continue;
 
+		/* Ignore if not reading this shard */
+		if (shard != SHARED_SHARD && stateP->dbShard != shard)
+			continue;
+
+		n = pg_atomic_read_u64(&stateP->nextMsgNum[pos]);
+
 		/*
 		 * If we must free some space and this backend is preventing it, force
 		 * him into reset state and then ignore until he catches up.
@@ -708,33 +966,18 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 			needSig = stateP;
 		}
 	}
-	segP->minMsgNum = min;
-
-	/*
-	 * When minMsgNum gets really large, decrement all message counters so as
-	 * to forestall overflow of the counters.  This happens seldom enough that
-	 * folding it into the previous loop would be a loser.
-	 */
-	if (min >= MSGNUMWRAPAROUND)
-	{
-		segP->minMsgNum -= MSGNUMWRAPAROUND;
-		segP->maxMsgNum -= MSGNUMWRAPAROUND;
-		for (i = 0; i < segP->lastBackend; i++)
-		{
-			/* we don't bother skipping inactive entries here */
-			segP->procState[i].nextMsgNum -= MSGNUMWRAPAROUND;
-		}
-	}
+	shardP->minMsgNum = min;
 
 	/*
 	 * Determine how many messages are still in the queue, and set the
-	 * threshold at which we should repeat SICleanupQueue().
+	 * threshold at which we should repeat SICleanupShard().
 	 */
-	numMsgs = segP->maxMsgNum - segP->minMsgNum;
-	if (numMsgs < CLEANUP_MIN)
-		segP->nextThreshold = CLEANUP_MIN;
+	numMsgs = max - min;
+	if (numMsgs < CLEANUP_MIN(segP))
+		shardP->nextThreshold = CLEANUP_MIN(segP);
 	else
-		segP->nextThreshold = (numMsgs / CLEANUP_QUANTUM + 1) * CLEANUP_QUANTUM;
+		shardP->nextThreshold = (numMsgs / CLEANUP_QUANTUM(segP) + 1) *
+			CLEANUP_QUANTUM(segP);
 
 	/*
 	 * Lastly, signal anyone who needs a catchup interrupt.  Since
@@ -747,19 +990,14 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 		BackendId	his_backendId = (needSig - &segP->procState[0]) + 1;
 
 		needSig->signaled = true;
-		LWLockRelease(SInvalReadLock);
-		LWLockRelease(SInvalWriteLock);
+		LWLockRelease(&shardP->lock);
 		elog(DEBUG4, "sending sinval catchup signal to PID %d", (int) his_pid);
 		SendProcSignal(his_pid, PROCSIG_CATCHUP_INTERRUPT, his_backendId);
-		if (callerHasWriteLock)
-			LWLockAcquire(SInvalWriteLock, LW_EXCLUSIVE);
-	}
-	else
-	{
-		LWLockRelease(SInvalReadLock);
-		if (!callerHasWriteLock)
-			LWLockRelease(SInvalWriteLock);
+		if (callerHasLock)
+			LWLockAcquire(&shardP->lock, LW_EXCLUSIVE);
 	}
+	else if (!callerHasLock)
+		LWLockRelease(&shardP->lock);
 }
 
 
@@ -17,6 +17,7 @@
  *	Interface:
  *
  *	DeadLockCheck()
+ *	DeadLockCheckQuick()
  *	DeadLockReport()
  *	RememberSimpleDeadLock()
  *	InitDeadLockChecking()
@@ -85,6 +86,10 @@ static bool FindLockCycleRecurse(PGPROC *checkProc, int depth,
 static bool FindLockCycleRecurseMember(PGPROC *checkProc,
 									   PGPROC *checkProcLeader,
 									   int depth, EDGE *softEdges, int *nSoftEdges);
+static LOCK *FindLockCycleWaitLock(PGPROC *proc);
+static bool QuickCheckHoldsPartition(int partition);
+static void QuickCheckAcquirePartition(int partition);
+static void QuickCheckReleasePartitions(void);
 static bool ExpandConstraints(EDGE *constraints, int nConstraints);
 static bool TopoSort(LOCK *lock, EDGE *constraints, int nConstraints,
 					 PGPROC **ordering);
@@ -127,6 +132,16 @@ static int	nDeadlockDetails;
 /* PGPROC pointer of any blocking autovacuum worker found */
 static PGPROC *blocking_autovacuum_proc = NULL;
 
+/*
+ * Workspace for DeadLockCheckQuick: the lock partitions we hold in shared
+ * mode, the highest of them, and the first one a traversal needed but didn't
+ * have (or -1).
+ */
+static bool quickCheck = false;
+static bool partitionHeld[MAX_LOCK_PARTITIONS];
+static int	maxPartitionHeld;
+static int	missingPartition;
+
 
 /*
  * InitDeadLockChecking -- initialize deadlock checker during backend startup
@@ -278,6 +293,178 @@ DeadLockCheck(PGPROC *proc)
 		return DS_NO_DEADLOCK;
 }
 
+/*
+ * DeadLockCheckQuick -- look for a deadlock without locking the lock table
+ *
+ * This runs the cycle search of DeadLockCheck, but only holds the partitions
+ * of the lock table it actually looks at, and only in shared mode, so that
+ * a backend that waits for a lock, as is common, doesn't stall all lock
+ * traffic for the time of the check.  hashcode is that of the lock proc
+ * waits for.
+ *
+ * The partitions are taken as the traversal of the waits-for graph reaches
+ * them: when it needs a partition it doesn't hold, it is abandoned, the
+ * partition is acquired, and the traversal starts over.  To avoid LWLock
+ * deadlocks we only wait for partitions above those we already hold;
+ * otherwise we release them all and take them again in order.  Only the
+ * final traversal, done with all the partitions it consults held at once,
+ * counts.  A deadlock, once formed, stays until one of its members is
+ * canceled, so if there is one it is found then.
+ *
+ * Returns true, with *state set, if there is no cycle through proc; and also
+ * if proc isn't waiting any more, leaving *state alone, as CheckDeadLock
+ * does.  Returns false if there is a cycle, soft or hard, in which case the
+ * caller must run DeadLockCheck to resolve it or report it.
+ */
+bool
+DeadLockCheckQuick(PGPROC *proc, uint32 hashcode, DeadLockState *state)
+{
+	int			nSoftEdges;
+	bool		found;
+
+	Assert(!quickCheck);
+	quickCheck = true;
+	memset(partitionHeld, 0, sizeof(partitionHeld));
+	maxPartitionHeld = -1;
+	QuickCheckAcquirePartition(LockHashPartition(hashcode));
+
+	for (;;)
+	{
+		/* There is nothing to check if we've been awoken meanwhile */
+		if (proc->links.prev == NULL || proc->links.next == NULL)
+		{
+			QuickCheckReleasePartitions();
+			quickCheck = false;
+			return true;
+		}
+
+		nWaitOrders = 0;
+		blocking_autovacuum_proc = NULL;
+		missingPartition = -1;
+
+		found = FindLockCycle(proc, possibleConstraints, &nSoftEdges);
+		if (missingPartition < 0)
+			break;
+
+		QuickCheckAcquirePartition(missingPartition);
+	}
+
+	QuickCheckReleasePartitions();
+	quickCheck = false;
+
+	if (found)
+		return false;
+
+	if (blocking_autovacuum_proc != NULL)
+		*state = DS_BLOCKED_BY_AUTOVACUUM;
+	else
+		*state = DS_NO_DEADLOCK;
+	return true;
+}
+
+/*
+ * Acquire a lock partition in shared mode for DeadLockCheckQuick.
+ *
+ * Partitions are always waited for in ascending order.  If we need one
+ * below the highest we hold and can't get it at once, release everything
+ * and take the whole set again in order.
+ */
+static void
+QuickCheckAcquirePartition(int partition)
+{
+	Assert(!partitionHeld[partition]);
+
+	if (partition > maxPartitionHeld)
+		LWLockAcquire(LockHashPartitionLockByIndex(partition), LW_SHARED);
+	else if (!LWLockConditionalAcquire(LockHashPartitionLockByIndex(partition),
+									   LW_SHARED))
+	{
+		QuickCheckReleasePartitions();
+		partitionHeld[partition] = true;
+		for (int i = 0; i < NUM_LOCK_PARTITIONS; i++)
+		{
+			if (partitionHeld[i])
+			{
+				LWLockAcquire(LockHashPartitionLockByIndex(i), LW_SHARED);
+				maxPartitionHeld = i;
+			}
+		}
+		return;
+	}
+
+	partitionHeld[partition] = true;
+	maxPartitionHeld = Max(maxPartitionHeld, partition);
+}
+
+/*
+ * Release the partitions held by DeadLockCheckQuick, highest first, but
+ * remember which they were in partitionHeld[].
+ */
+static void
+QuickCheckReleasePartitions(void)
+{
+	for (int i = maxPartitionHeld; i >= 0; i--)
+	{
+		if (partitionHeld[i])
+			LWLockRelease(LockHashPartitionLockByIndex(i));
+	}
+	maxPartitionHeld = -1;
+}
+
+/*
+ * In a quick check, is the given partition held?  If not, remember it so
+ * that DeadLockCheckQuick takes it before trying again.
+ */
+static bool
+QuickCheckHoldsPartition(int partition)
+{
+	if (partitionHeld[partition])
+		return true;
+
+	if (missingPartition < 0)
+		missingPartition = partition;
+	return false;
+}
+
+/*
+ * Return the lock proc is waiting for, or NULL if it isn't waiting.
+ *
+ * In a quick check, the wait state of proc is protected by the partition of
+ * the lock it waits for, which we don't know before looking at it.  So peek
+ * at it without any lock, and if we hold that partition, look again to make
+ * sure proc is still waiting for the same lock.  If we don't hold the
+ * partition, return NULL with missingPartition set, and the traversal is
+ * abandoned.
+ */
+static LOCK *
+FindLockCycleWaitLock(PGPROC *proc)
+{
+	volatile PGPROC *vproc = proc;
+	LOCK	   *lock;
+	int			partition;
+
+	if (!quickCheck)
+		return (proc->links.next != NULL) ? proc->waitLock : NULL;
+
+	for (;;)
+	{
+		lock = vproc->waitLock;
+		if (lock == NULL)
+			return NULL;
+
+		partition = LockHashPartition(LockTagHashCode(&lock->tag));
+		if (!QuickCheckHoldsPartition(partition))
+			return NULL;
+
+		/* Now that it can't change, check it again */
+		if (vproc->waitLock == lock &&
+			LockHashPartition(LockTagHashCode(&lock->tag)) == partition)
+			break;
+	}
+
+	return (proc->links.next != NULL) ? lock : NULL;
+}
+
 /*
  * Return the PGPROC of the autovacuum that's blocking a process.
  *
@@ -499,12 +686,15 @@ FindLockCycleRecurse(PGPROC *checkProc,
 
 	/*
 	 * If the process is waiting, there is an outgoing waits-for edge to each
-	 * process that blocks it.
+	 * process that blocks it.  (In a quick check, we also get here when the
+	 * partition the wait state is in isn't held; unwind then.)
 	 */
-	if (checkProc->links.next != NULL && checkProc->waitLock != NULL &&
+	if (FindLockCycleWaitLock(checkProc) != NULL &&
 		FindLockCycleRecurseMember(checkProc, checkProc, depth, softEdges,
 								   nSoftEdges))
 		return true;
+	if (quickCheck && missingPartition >= 0)
+		return true;
 
 	/*
 	 * If the process is not waiting, there could still be outgoing waits-for
@@ -512,18 +702,32 @@ FindLockCycleRecurse(PGPROC *checkProc,
 	 * group might be waiting even though this process is not.  (Given lock
 	 * groups {A1, A2} and {B1, B2}, if A1 waits for B1 and B2 waits for A2,
 	 * that is a deadlock even neither of B1 and A2 are waiting for anything.)
+	 *
+	 * The members list is protected by the leader's partition.  A quick
+	 * check need not take it if the list is empty: a group that has just
+	 * been formed can't be part of a deadlock the list doesn't show yet.
 	 */
+	if (quickCheck)
+	{
+		if (dlist_is_empty(&checkProc->lockGroupMembers))
+			return false;
+		if (!QuickCheckHoldsPartition(LockHashPartition(checkProc->pgprocno)))
+			return true;
+	}
+
 	dlist_foreach(iter, &checkProc->lockGroupMembers)
 	{
 		PGPROC	   *memberProc;
 
 		memberProc = dlist_container(PGPROC, lockGroupLink, iter.cur);
 
-		if (memberProc->links.next != NULL && memberProc->waitLock != NULL &&
-			memberProc != checkProc &&
+		if (memberProc != checkProc &&
+			FindLockCycleWaitLock(memberProc) != NULL &&
 			FindLockCycleRecurseMember(memberProc, checkProc, depth, softEdges,
 									   nSoftEdges))
 			return true;
+		if (quickCheck && missingPartition >= 0)
+			return true;
 	}
 
 	return false;
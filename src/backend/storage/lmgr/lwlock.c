@@ -72,10 +72,39 @@
  *
  * This protects us against the problem from above as nobody can release too
  *	  quick, before we're queued, since after Phase 2 we're already queued.
+ *
+ * As most LWLocks are held for very short periods, going to sleep in Phase 4
+ * is often much more expensive than the wait itself: it costs a futex round
+ * trip and two context switches, and the semaphore wakeups of the releaser
+ * add up under heavy contention.  So LWLockAcquire() spins for a while before
+ * Phase 2, watching the lock word without atomic operations until the lock
+ * looks free; and once queued, spins on its own PGPROC's lwWaiting before
+ * sleeping.  The latter is the same idea as the local spinning of MCS queue
+ * locks: every waiter watches a cacheline of its own, which only the backend
+ * that wakes it up writes to, instead of all of them hammering the lock word.
+ * How long to spin is adapted per backend, like spins_per_delay in s_lock.c,
+ * so that on a single CPU or on locks held for longer sections we soon stop
+ * wasting time on it.
+ *
+ * With lwlock_profiling on, LWLockAcquire() also remembers where it was
+ * called from, and how long the caller waited for and then held the lock.
+ * Those events go to a ring buffer per process in shared memory, which
+ * pg_stat_lwlock_profile aggregates by tranche and call site, to tell which
+ * code paths hold and wait for contended locks.  With it off, the only cost
+ * is a test of the setting in LWLockAcquire() and of the handle in
+ * LWLockRelease().
  * -------------------------------------------------------------------------
  */
 #include "postgres.h"
 
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
 #include "pgstat.h"
@@ -86,17 +115,38 @@
 #include "storage/predicate.h"
 #include "storage/proc.h"
 #include "storage/proclist.h"
+#include "storage/shmem.h"
 #include "storage/spin.h"
-#include "utils/memutils.h"
-
-#ifdef LWLOCK_STATS
+#include "utils/builtins.h"
 #include "utils/hsearch.h"
-#endif
+#include "utils/memutils.h"
 
 
 /* We use the ShmemLock spinlock to protect LWLockCounter */
 extern slock_t *ShmemLock;
 
+/*
+ * Bounds and adaptation of the number of iterations LWLockAcquire() spins,
+ * each time before queueing and before sleeping.  Like s_lock.c, increase
+ * quickly when spinning pays off, and decrease slowly when it doesn't.
+ */
+#define MIN_LWLOCK_SPINS			10
+#define MAX_LWLOCK_SPINS			1000
+#define DEFAULT_LWLOCK_SPINS		100
+#define LWLOCK_SPINS_INCREMENT		100
+
+static int	lwlock_spins = DEFAULT_LWLOCK_SPINS;
+
+/*
+ * On NUMA machines, LWLockWakeup() may hand an exclusive lock to a waiter
+ * on the releasing backend's node ahead of waiters on other nodes, so that
+ * the lock and the data it protects stay in that node's caches.  It only
+ * looks that many waiters deep, and doesn't pass over any waiter more than
+ * that many times, so nobody is starved.
+ */
+#define LWLOCK_NUMA_WINDOW			4
+#define LWLOCK_NUMA_MAX_SKIPS		2
+
 #define LW_FLAG_HAS_WAITERS			((uint32) 1 << 30)
 #define LW_FLAG_RELEASE_OK			((uint32) 1 << 29)
 #define LW_FLAG_LOCKED				((uint32) 1 << 28)
@@ -190,6 +240,46 @@ static const char *const BuiltinTrancheNames[] = {
 	"LogicalRepLauncherDSA",
 	/* LWTRANCHE_LAUNCHER_HASH: */
 	"LogicalRepLauncherHash",
+	/* LWTRANCHE_AIO_URING_COMPLETION: */
+	"AioUringCompletion",
+	/* LWTRANCHE_BUFFER_REL_INDEX: */
+	"BufferRelIndex",
+	/* LWTRANCHE_PARALLEL_REDO_EXTENSION: */
+	"ParallelRedoExtension",
+	/* LWTRANCHE_PARALLEL_MEMOIZE: */
+	"ParallelMemoize",
+	/* LWTRANCHE_INDEX_TID_LOG: */
+	"IndexTidLog",
+	/* LWTRANCHE_SHARED_TIDSTORE: */
+	"SharedTidStore",
+	/* LWTRANCHE_SINVAL_SHARD: */
+	"SInvalShard",
+	/* LWTRANCHE_XACT_SLRU: */
+	"XactSLRU",
+	/* LWTRANCHE_COMMITTS_SLRU: */
+	"CommitTsSLRU",
+	/* LWTRANCHE_SUBTRANS_SLRU: */
+	"SubtransSLRU",
+	/* LWTRANCHE_MULTIXACTOFFSET_SLRU: */
+	"MultiXactOffsetSLRU",
+	/* LWTRANCHE_MULTIXACTMEMBER_SLRU: */
+	"MultiXactMemberSLRU",
+	/* LWTRANCHE_NOTIFY_SLRU: */
+	"NotifySLRU",
+	/* LWTRANCHE_SERIAL_SLRU: */
+	"SerialSLRU",
+	/* LWTRANCHE_RELSIZE_CACHE: */
+	"RelSizeCache",
+	/* LWTRANCHE_SHARED_CATCACHE: */
+	"SharedCatCache",
+	/* LWTRANCHE_SHARED_CATCACHE_DSA: */
+	"SharedCatCacheDSA",
+	/* LWTRANCHE_SHARED_PLAN_CACHE: */
+	"SharedPlanCache",
+	/* LWTRANCHE_SHARED_PLAN_CACHE_DSA: */
+	"SharedPlanCacheDSA",
+	/* LWTRANCHE_SHARED_TYPE_CACHE: */
+	"SharedTypeCache",
 };
 
 StaticAssertDecl(lengthof(BuiltinTrancheNames) ==
@@ -224,11 +314,57 @@ typedef struct LWLockHandle
 {
 	LWLock	   *lock;
 	LWLockMode	mode;
+	/* the rest is only set if the acquisition is profiled, see below */
+	uintptr_t	site;			/* caller of LWLockAcquire, or 0 */
+	uint64		wait_ns;		/* time waited for the lock */
+	instr_time	acquired;		/* when the lock was granted */
 } LWLockHandle;
 
 static int	num_held_lwlocks = 0;
 static LWLockHandle held_lwlocks[MAX_SIMUL_LWLOCKS];
 
+/* GUC variable */
+bool		lwlock_profiling = false;
+
+/*
+ * One profiled lock acquisition, recorded at release.  Acquisitions that
+ * neither waited nor held the lock for LWLOCK_PROFILE_MIN_NS are left out,
+ * so that the ring buffers cover a useful stretch of time.
+ */
+typedef struct LWLockProfileEvent
+{
+	uintptr_t	site;
+	uint64		wait_ns;
+	uint64		hold_ns;
+	uint16		tranche;
+	uint8		mode;
+} LWLockProfileEvent;
+
+#define LWLOCK_PROFILE_RING_SIZE	512
+#define LWLOCK_PROFILE_MIN_NS		1000
+
+/*
+ * Ring buffer of the latest events of one process.  Only the owning process
+ * writes to it, and readers don't lock it, so an event being overwritten
+ * may be read torn; that's good enough for profiling.
+ */
+typedef struct LWLockProfileRing
+{
+	pg_atomic_uint64 nevents;	/* events recorded so far */
+	LWLockProfileEvent events[LWLOCK_PROFILE_RING_SIZE];
+} LWLockProfileRing;
+
+/* points to the ring buffers in shared memory, one per PGPROC */
+static LWLockProfileRing *LWLockProfileRings = NULL;
+
+#if defined(__GNUC__)
+#define LWLOCK_CALLER_ADDRESS() ((uintptr_t) __builtin_return_address(0))
+#elif defined(_MSC_VER)
+#define LWLOCK_CALLER_ADDRESS() ((uintptr_t) _ReturnAddress())
+#else
+#define LWLOCK_CALLER_ADDRESS() ((uintptr_t) 1)
+#endif
+
 /* struct representing the LWLock tranche request for named tranche */
 typedef struct NamedLWLockTrancheRequest
 {
@@ -251,6 +387,10 @@ int			NamedLWLockTrancheRequests = 0;
 NamedLWLockTranche *NamedLWLockTrancheArray = NULL;
 
 static void InitializeLWLocks(void);
+static inline bool LWLockAcquireInternal(LWLock *lock, LWLockMode mode);
+static pg_noinline bool LWLockAcquireProfiled(LWLock *lock, LWLockMode mode,
+											  uintptr_t site);
+static pg_noinline void LWLockProfileRecord(LWLockHandle *handle);
 static inline void LWLockReportWaitStart(LWLock *lock);
 static inline void LWLockReportWaitEnd(void);
 static const char *GetLWTrancheName(uint16 trancheId);
@@ -273,6 +413,8 @@ typedef struct lwlock_stats
 	int			block_count;
 	int			dequeue_self_count;
 	int			spin_delay_count;
+	int			spin_acquire_count;
+	int			spin_wakeup_count;
 }			lwlock_stats;
 
 static HTAB *lwlock_stats_htab;
@@ -378,11 +520,12 @@ print_lwlock_stats(int code, Datum arg)
 	while ((lwstats = (lwlock_stats *) hash_seq_search(&scan)) != NULL)
 	{
 		fprintf(stderr,
-				"PID %d lwlock %s %p: shacq %u exacq %u blk %u spindelay %u dequeue self %u\n",
+				"PID %d lwlock %s %p: shacq %u exacq %u blk %u spindelay %u dequeue self %u spinacq %u spinwake %u\n",
 				MyProcPid, GetLWTrancheName(lwstats->key.tranche),
 				lwstats->key.instance, lwstats->sh_acquire_count,
 				lwstats->ex_acquire_count, lwstats->block_count,
-				lwstats->spin_delay_count, lwstats->dequeue_self_count);
+				lwstats->spin_delay_count, lwstats->dequeue_self_count,
+				lwstats->spin_acquire_count, lwstats->spin_wakeup_count);
 	}
 
 	LWLockRelease(&MainLWLockArray[0].lock);
@@ -415,6 +558,8 @@ get_lwlock_stats_entry(LWLock *lock)
 		lwstats->block_count = 0;
 		lwstats->dequeue_self_count = 0;
 		lwstats->spin_delay_count = 0;
+		lwstats->spin_acquire_count = 0;
+		lwstats->spin_wakeup_count = 0;
 	}
 	return lwstats;
 }
@@ -528,16 +673,16 @@ InitializeLWLocks(void)
 	for (id = 0; id < NUM_BUFFER_PARTITIONS; id++, lock++)
 		LWLockInitialize(&lock->lock, LWTRANCHE_BUFFER_MAPPING);
 
-	/* Initialize lmgrs' LWLocks in main array */
-	lock = MainLWLockArray + LOCK_MANAGER_LWLOCK_OFFSET;
-	for (id = 0; id < NUM_LOCK_PARTITIONS; id++, lock++)
-		LWLockInitialize(&lock->lock, LWTRANCHE_LOCK_MANAGER);
-
 	/* Initialize predicate lmgrs' LWLocks in main array */
 	lock = MainLWLockArray + PREDICATELOCK_MANAGER_LWLOCK_OFFSET;
 	for (id = 0; id < NUM_PREDICATELOCK_PARTITIONS; id++, lock++)
 		LWLockInitialize(&lock->lock, LWTRANCHE_PREDICATE_LOCK_MANAGER);
 
+	/* Initialize lmgrs' LWLocks in main array */
+	lock = MainLWLockArray + LOCK_MANAGER_LWLOCK_OFFSET;
+	for (id = 0; id < NUM_LOCK_PARTITIONS; id++, lock++)
+		LWLockInitialize(&lock->lock, LWTRANCHE_LOCK_MANAGER);
+
 	/*
 	 * Copy the info about any named tranches into shared memory (so that
 	 * other processes can see it), and initialize the requested LWLocks.
@@ -574,6 +719,34 @@ InitializeLWLocks(void)
 	}
 }
 
+/*
+ * Compute shmem space needed for the lwlock_profiling ring buffers.
+ */
+Size
+LWLockProfileShmemSize(void)
+{
+	return mul_size(MaxBackends + NUM_AUXILIARY_PROCS,
+					sizeof(LWLockProfileRing));
+}
+
+/*
+ * Allocate and initialize the lwlock_profiling ring buffers.
+ */
+void
+LWLockProfileShmemInit(void)
+{
+	bool		found;
+
+	LWLockProfileRings = (LWLockProfileRing *)
+		ShmemInitStruct("LWLock Profile", LWLockProfileShmemSize(), &found);
+
+	if (!found)
+	{
+		for (int i = 0; i < MaxBackends + NUM_AUXILIARY_PROCS; i++)
+			pg_atomic_init_u64(&LWLockProfileRings[i].nevents, 0);
+	}
+}
+
 /*
  * InitLWLockAccess - initialize backend-local state needed to hold LWLocks
  */
@@ -870,6 +1043,71 @@ LWLockAttemptLock(LWLock *lock, LWLockMode mode)
 	pg_unreachable();
 }
 
+/*
+ * Adjust lwlock_spins after spinning, depending on whether it was worth it.
+ */
+static inline void
+LWLockAdjustSpins(bool success)
+{
+	if (success)
+		lwlock_spins = Min(lwlock_spins + LWLOCK_SPINS_INCREMENT,
+						   MAX_LWLOCK_SPINS);
+	else
+		lwlock_spins = Max(lwlock_spins - 1, MIN_LWLOCK_SPINS);
+}
+
+/*
+ * Spin for a while, trying to acquire the lock whenever it looks free.
+ *
+ * Only reads the lock word while waiting, so that spinning doesn't bounce
+ * its cacheline around more than necessary.  Returns true if we got the lock.
+ */
+static bool
+LWLockSpinAttemptLock(LWLock *lock, LWLockMode mode)
+{
+	uint32		conflict = (mode == LW_EXCLUSIVE) ? LW_LOCK_MASK : LW_VAL_EXCLUSIVE;
+
+	for (int spins = 0; spins < lwlock_spins; spins++)
+	{
+		uint32		state = pg_atomic_read_u32(&lock->state);
+
+		if ((state & conflict) == 0 && !LWLockAttemptLock(lock, mode))
+		{
+			LWLockAdjustSpins(true);
+			return true;
+		}
+
+		pg_spin_delay();
+	}
+
+	LWLockAdjustSpins(false);
+	return false;
+}
+
+/*
+ * Spin for a while on our own PGPROC, waiting for LWLockWakeup() to take us
+ * off the wait queue, before the caller goes to sleep on the semaphore.  The
+ * waker still posts the semaphore, which the caller then absorbs without
+ * having to sleep.  Returns true if we were woken up while spinning.
+ */
+static bool
+LWLockSpinWait(PGPROC *proc)
+{
+	for (int spins = 0; spins < lwlock_spins; spins++)
+	{
+		if (((volatile PGPROC *) proc)->lwWaiting == LW_WS_NOT_WAITING)
+		{
+			LWLockAdjustSpins(true);
+			return true;
+		}
+
+		pg_spin_delay();
+	}
+
+	LWLockAdjustSpins(false);
+	return false;
+}
+
 /*
  * Lock the LWLock's wait list against concurrent activity.
  *
@@ -940,6 +1178,58 @@ LWLockWaitListUnlock(LWLock *lock)
 	Assert(old_state & LW_FLAG_LOCKED);
 }
 
+/*
+ * Move an exclusive waiter on our NUMA node to the front of the wait queue,
+ * if it's among the first few exclusive waiters and those it passes over
+ * haven't been passed over too often already.
+ *
+ * Only the leading run of exclusive waiters is considered: if the queue
+ * starts with shared or LW_WAIT_UNTIL_FREE waiters, LWLockWakeup() wakes all
+ * of those anyway, and reordering behind them would gain nothing.
+ *
+ * The wait list lock must be held.
+ */
+static void
+LWLockNumaReorder(LWLock *lock)
+{
+	int			passed[LWLOCK_NUMA_WINDOW];
+	int			npassed = 0;
+	int			mynode;
+	proclist_mutable_iter iter;
+
+	if (ShmemNumaNodes() <= 1 || MyProc == NULL)
+		return;
+
+	mynode = ProcNumaNode(MyProc->pgprocno);
+
+	proclist_foreach_modify(iter, &lock->waiters, lwWaitLink)
+	{
+		PGPROC	   *waiter = GetPGProcByNumber(iter.cur);
+
+		if (waiter->lwWaitMode != LW_EXCLUSIVE)
+			return;
+
+		if (ProcNumaNode(iter.cur) == mynode)
+		{
+			if (npassed == 0)
+				return;			/* already first in line */
+
+			proclist_delete(&lock->waiters, iter.cur, lwWaitLink);
+			proclist_push_head(&lock->waiters, iter.cur, lwWaitLink);
+
+			for (int i = 0; i < npassed; i++)
+				GetPGProcByNumber(passed[i])->lwNumaSkips++;
+			return;
+		}
+
+		if (waiter->lwNumaSkips >= LWLOCK_NUMA_MAX_SKIPS ||
+			npassed >= LWLOCK_NUMA_WINDOW)
+			return;
+
+		passed[npassed++] = iter.cur;
+	}
+}
+
 /*
  * Wakeup all the lockers that currently have a chance to acquire the lock.
  */
@@ -958,6 +1248,8 @@ LWLockWakeup(LWLock *lock)
 	/* lock wait list while collecting backends to wake up */
 	LWLockWaitListLock(lock);
 
+	LWLockNumaReorder(lock);
+
 	proclist_foreach_modify(iter, &lock->waiters, lwWaitLink)
 	{
 		PGPROC	   *waiter = GetPGProcByNumber(iter.cur);
@@ -1080,6 +1372,7 @@ LWLockQueueSelf(LWLock *lock, LWLockMode mode)
 
 	MyProc->lwWaiting = LW_WS_WAITING;
 	MyProc->lwWaitMode = mode;
+	MyProc->lwNumaSkips = 0;
 
 	/* LW_WAIT_UNTIL_FREE waiters are always at the front of the queue */
 	if (mode == LW_WAIT_UNTIL_FREE)
@@ -1193,6 +1486,81 @@ LWLockDequeueSelf(LWLock *lock)
  */
 bool
 LWLockAcquire(LWLock *lock, LWLockMode mode)
+{
+	if (unlikely(lwlock_profiling))
+		return LWLockAcquireProfiled(lock, mode, LWLOCK_CALLER_ADDRESS());
+
+	return LWLockAcquireInternal(lock, mode);
+}
+
+/*
+ * LWLockAcquireProfiled - LWLockAcquire with lwlock_profiling on
+ *
+ * 'site' is the address LWLockAcquire was called from.  The wait is timed
+ * here, and the hold time by LWLockRelease, which records the event.
+ */
+static pg_noinline bool
+LWLockAcquireProfiled(LWLock *lock, LWLockMode mode, uintptr_t site)
+{
+	LWLockHandle *handle;
+	instr_time	start;
+	bool		result;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	result = LWLockAcquireInternal(lock, mode);
+
+	handle = &held_lwlocks[num_held_lwlocks - 1];
+	INSTR_TIME_SET_CURRENT(handle->acquired);
+	handle->wait_ns = INSTR_TIME_GET_NANOSEC(handle->acquired) -
+		INSTR_TIME_GET_NANOSEC(start);
+	handle->site = site;
+
+	return result;
+}
+
+/*
+ * LWLockProfileRecord - record a profiled acquisition, at release
+ */
+static pg_noinline void
+LWLockProfileRecord(LWLockHandle *handle)
+{
+	LWLockProfileRing *ring;
+	LWLockProfileEvent *event;
+	instr_time	now;
+	uint64		hold_ns;
+	uint64		n;
+
+	INSTR_TIME_SET_CURRENT(now);
+	hold_ns = INSTR_TIME_GET_NANOSEC(now) -
+		INSTR_TIME_GET_NANOSEC(handle->acquired);
+
+	if (handle->wait_ns < LWLOCK_PROFILE_MIN_NS &&
+		hold_ns < LWLOCK_PROFILE_MIN_NS)
+		return;
+
+	/* prepared transactions' PGPROCs don't get a ring, nor does bootstrap */
+	if (LWLockProfileRings == NULL || MyProc == NULL ||
+		MyProc->pgprocno >= MaxBackends + NUM_AUXILIARY_PROCS)
+		return;
+
+	ring = &LWLockProfileRings[MyProc->pgprocno];
+	n = pg_atomic_read_u64(&ring->nevents);
+	event = &ring->events[n % LWLOCK_PROFILE_RING_SIZE];
+	event->site = handle->site;
+	event->wait_ns = handle->wait_ns;
+	event->hold_ns = hold_ns;
+	event->tranche = handle->lock->tranche;
+	event->mode = (uint8) handle->mode;
+	pg_write_barrier();
+	pg_atomic_write_u64(&ring->nevents, n + 1);
+}
+
+/*
+ * LWLockAcquireInternal - guts of LWLockAcquire
+ */
+static inline bool
+LWLockAcquireInternal(LWLock *lock, LWLockMode mode)
 {
 	PGPROC	   *proc = MyProc;
 	bool		result = true;
@@ -1265,6 +1633,20 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 			break;				/* got the lock */
 		}
 
+		/*
+		 * The holder is likely to release it soon, so spin for a bit before
+		 * going through the trouble of queueing.  Not in single-user mode,
+		 * where nobody else could release it.
+		 */
+		if (IsUnderPostmaster && LWLockSpinAttemptLock(lock, mode))
+		{
+			LOG_LWDEBUG("LWLockAcquire", lock, "acquired after spinning");
+#ifdef LWLOCK_STATS
+			lwstats->spin_acquire_count++;
+#endif
+			break;
+		}
+
 		/*
 		 * Ok, at this point we couldn't grab the lock on the first try. We
 		 * cannot simply queue ourselves to the end of the list and wait to be
@@ -1309,6 +1691,18 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 		if (TRACE_POSTGRESQL_LWLOCK_WAIT_START_ENABLED())
 			TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), mode);
 
+		/*
+		 * Spin on our own lwWaiting first.  Either way the wakeup is consumed
+		 * from the semaphore below; if we saw it already, it has been posted
+		 * or is just about to be, so that doesn't have to sleep.
+		 */
+#ifdef LWLOCK_STATS
+		if (LWLockSpinWait(proc))
+			lwstats->spin_wakeup_count++;
+#else
+		(void) LWLockSpinWait(proc);
+#endif
+
 		for (;;)
 		{
 			PGSemaphoreLock(proc->sem);
@@ -1344,6 +1738,7 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 
 	/* Add lock to list of locks held by this backend */
 	held_lwlocks[num_held_lwlocks].lock = lock;
+	held_lwlocks[num_held_lwlocks].site = 0;
 	held_lwlocks[num_held_lwlocks++].mode = mode;
 
 	/*
@@ -1398,6 +1793,7 @@ LWLockConditionalAcquire(LWLock *lock, LWLockMode mode)
 	{
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
+		held_lwlocks[num_held_lwlocks].site = 0;
 		held_lwlocks[num_held_lwlocks++].mode = mode;
 		if (TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE_ENABLED())
 			TRACE_POSTGRESQL_LWLOCK_CONDACQUIRE(T_NAME(lock), mode);
@@ -1529,6 +1925,7 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 		LOG_LWDEBUG("LWLockAcquireOrWait", lock, "succeeded");
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
+		held_lwlocks[num_held_lwlocks].site = 0;
 		held_lwlocks[num_held_lwlocks++].mode = mode;
 		if (TRACE_POSTGRESQL_LWLOCK_ACQUIRE_OR_WAIT_ENABLED())
 			TRACE_POSTGRESQL_LWLOCK_ACQUIRE_OR_WAIT(T_NAME(lock), mode);
@@ -1548,7 +1945,7 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
  */
 static bool
 LWLockConflictsWithVar(LWLock *lock,
-					   uint64 *valptr, uint64 oldval, uint64 *newval,
+					   pg_atomic_uint64 *valptr, uint64 oldval, uint64 *newval,
 					   bool *result)
 {
 	bool		mustwait;
@@ -1572,13 +1969,11 @@ LWLockConflictsWithVar(LWLock *lock,
 	*result = false;
 
 	/*
-	 * Read value using the lwlock's wait list lock, as we can't generally
-	 * rely on atomic 64 bit reads/stores.  TODO: On platforms with a way to
-	 * do atomic 64 bit reads/writes the spinlock should be optimized away.
+	 * Reading this value atomically is safe even on platforms where uint64
+	 * cannot be read without observing a torn value, and saves taking the
+	 * wait list lock of every busy lock a waiter looks at.
 	 */
-	LWLockWaitListLock(lock);
-	value = *valptr;
-	LWLockWaitListUnlock(lock);
+	value = pg_atomic_read_u64(valptr);
 
 	if (value != oldval)
 	{
@@ -1607,7 +2002,8 @@ LWLockConflictsWithVar(LWLock *lock,
  * in shared mode, returns 'true'.
  */
 bool
-LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
+LWLockWaitForVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 oldval,
+				 uint64 *newval)
 {
 	PGPROC	   *proc = MyProc;
 	int			extraWaits = 0;
@@ -1742,22 +2138,25 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
  * The caller must be holding the lock in exclusive mode.
  */
 void
-LWLockUpdateVar(LWLock *lock, uint64 *valptr, uint64 val)
+LWLockUpdateVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 val)
 {
 	proclist_head wakeup;
 	proclist_mutable_iter iter;
 
 	PRINT_LWDEBUG("LWLockUpdateVar", lock, LW_EXCLUSIVE);
 
+	/*
+	 * Note that pg_atomic_exchange_u64 is a full barrier, so we're guaranteed
+	 * that the variable is updated before waking up waiters.
+	 */
+	pg_atomic_exchange_u64(valptr, val);
+
 	proclist_init(&wakeup);
 
 	LWLockWaitListLock(lock);
 
 	Assert(pg_atomic_read_u32(&lock->state) & LW_VAL_EXCLUSIVE);
 
-	/* Update the lock's value */
-	*valptr = val;
-
 	/*
 	 * See if there are any LW_WAIT_UNTIL_FREE waiters that need to be woken
 	 * up. They are always in the front of the queue.
@@ -1820,6 +2219,9 @@ LWLockRelease(LWLock *lock)
 
 	mode = held_lwlocks[i].mode;
 
+	if (unlikely(held_lwlocks[i].site != 0))
+		LWLockProfileRecord(&held_lwlocks[i]);
+
 	num_held_lwlocks--;
 	for (; i < num_held_lwlocks; i++)
 		held_lwlocks[i] = held_lwlocks[i + 1];
@@ -1873,17 +2275,15 @@ LWLockRelease(LWLock *lock)
  * LWLockReleaseClearVar - release a previously acquired lock, reset variable
  */
 void
-LWLockReleaseClearVar(LWLock *lock, uint64 *valptr, uint64 val)
+LWLockReleaseClearVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 val)
 {
-	LWLockWaitListLock(lock);
-
 	/*
 	 * Set the variable's value before releasing the lock, that prevents race
 	 * a race condition wherein a new locker acquires the lock, but hasn't yet
-	 * set the variables value.
+	 * set the variables value.  Note that pg_atomic_exchange_u64 is a full
+	 * barrier, so the update is visible before the lock is released.
 	 */
-	*valptr = val;
-	LWLockWaitListUnlock(lock);
+	pg_atomic_exchange_u64(valptr, val);
 
 	LWLockRelease(lock);
 }
@@ -1971,3 +2371,143 @@ LWLockHeldByMeInMode(LWLock *lock, LWLockMode mode)
 	}
 	return false;
 }
+
+/*
+ * Aggregated profile events of one tranche, call site and mode, for
+ * pg_get_lwlock_profile().
+ */
+typedef struct LWLockProfileKey
+{
+	uintptr_t	site;
+	uint16		tranche;
+	uint8		mode;
+} LWLockProfileKey;
+
+typedef struct LWLockProfileEntry
+{
+	LWLockProfileKey key;		/* hash key, must be first */
+	int64		count;
+	int64		waits;
+	uint64		total_wait_ns;
+	uint64		max_wait_ns;
+	uint64		total_hold_ns;
+	uint64		max_hold_ns;
+} LWLockProfileEntry;
+
+/*
+ * SQL function returning the lwlock_profiling events in the ring buffers of
+ * all processes, aggregated by tranche, call site and lock mode.
+ */
+Datum
+pg_get_lwlock_profile(PG_FUNCTION_ARGS)
+{
+#define PG_GET_LWLOCK_PROFILE_COLS	10
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	LWLockProfileEvent *events;
+	HASHCTL		ctl;
+	HTAB	   *htab;
+	HASH_SEQ_STATUS hstat;
+	LWLockProfileEntry *entry;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	ctl.keysize = sizeof(LWLockProfileKey);
+	ctl.entrysize = sizeof(LWLockProfileEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("LWLock profile", 256, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	events = palloc(sizeof(LWLockProfileEvent) * LWLOCK_PROFILE_RING_SIZE);
+
+	for (int i = 0; i < MaxBackends + NUM_AUXILIARY_PROCS; i++)
+	{
+		LWLockProfileRing *ring = &LWLockProfileRings[i];
+		uint64		nevents;
+		int			n;
+
+		nevents = pg_atomic_read_u64(&ring->nevents);
+		if (nevents == 0)
+			continue;
+		pg_read_barrier();
+		memcpy(events, ring->events,
+			   sizeof(LWLockProfileEvent) * LWLOCK_PROFILE_RING_SIZE);
+		n = (int) Min(nevents, LWLOCK_PROFILE_RING_SIZE);
+
+		for (int j = 0; j < n; j++)
+		{
+			LWLockProfileEvent *event = &events[j];
+			LWLockProfileKey key;
+			bool		found;
+
+			/* skip events torn by a concurrent overwrite */
+			if (event->site == 0)
+				continue;
+
+			memset(&key, 0, sizeof(key));
+			key.site = event->site;
+			key.tranche = event->tranche;
+			key.mode = event->mode;
+
+			entry = (LWLockProfileEntry *) hash_search(htab, &key, HASH_ENTER,
+													   &found);
+			if (!found)
+				memset((char *) entry + sizeof(LWLockProfileKey), 0,
+					   sizeof(LWLockProfileEntry) - sizeof(LWLockProfileKey));
+
+			entry->count++;
+			if (event->wait_ns >= LWLOCK_PROFILE_MIN_NS)
+				entry->waits++;
+			entry->total_wait_ns += event->wait_ns;
+			entry->max_wait_ns = Max(entry->max_wait_ns, event->wait_ns);
+			entry->total_hold_ns += event->hold_ns;
+			entry->max_hold_ns = Max(entry->max_hold_ns, event->hold_ns);
+		}
+	}
+
+	hash_seq_init(&hstat, htab);
+	while ((entry = (LWLockProfileEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		Datum		values[PG_GET_LWLOCK_PROFILE_COLS] = {0};
+		bool		nulls[PG_GET_LWLOCK_PROFILE_COLS] = {0};
+		char		site[32];
+
+		values[0] = CStringGetTextDatum(GetLWTrancheName(entry->key.tranche));
+		snprintf(site, sizeof(site), "%p", (void *) entry->key.site);
+		values[1] = CStringGetTextDatum(site);
+
+#ifdef HAVE_BACKTRACE_SYMBOLS
+		{
+			void	   *addr = (void *) entry->key.site;
+			char	  **symbols = backtrace_symbols(&addr, 1);
+
+			if (symbols != NULL)
+			{
+				values[2] = CStringGetTextDatum(symbols[0]);
+				free(symbols);
+			}
+			else
+				nulls[2] = true;
+		}
+#else
+		nulls[2] = true;
+#endif
+
+		values[3] = CStringGetTextDatum(entry->key.mode == LW_EXCLUSIVE ?
+										"exclusive" : "shared");
+		values[4] = Int64GetDatum(entry->count);
+		values[5] = Int64GetDatum(entry->waits);
+		/* times are shown in milliseconds */
+		values[6] = Float8GetDatum(entry->total_wait_ns / 1000000.0);
+		values[7] = Float8GetDatum(entry->max_wait_ns / 1000000.0);
+		values[8] = Float8GetDatum(entry->total_hold_ns / 1000000.0);
+		values[9] = Float8GetDatum(entry->max_hold_ns / 1000000.0);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	pfree(events);
+	hash_destroy(htab);
+
+	return (Datum) 0;
+}
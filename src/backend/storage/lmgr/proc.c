@@ -38,6 +38,7 @@
 #include "access/xlogutils.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "port/pg_numa.h"
 #include "postmaster/autovacuum.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
@@ -45,6 +46,7 @@
 #include "storage/condition_variable.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
+#include "storage/pg_shmem.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
@@ -61,6 +63,7 @@ int			LockTimeout = 0;
 int			IdleInTransactionSessionTimeout = 0;
 int			IdleSessionTimeout = 0;
 bool		log_lock_waits = false;
+int			max_cached_subxids = 256;
 
 /* Pointer to this process's PGPROC struct, if any */
 PGPROC	   *MyProc = NULL;
@@ -91,6 +94,7 @@ static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
+static Size FastPathLockShmemSizePerProc(void);
 
 
 /*
@@ -112,9 +116,51 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->subxidStates)));
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->statusFlags)));
 
+	/* fast-path lock slots */
+	size = add_size(size, mul_size(TotalProcs, FastPathLockShmemSizePerProc()));
+
+	/* subxid caches */
+	size = add_size(size, mul_size(TotalProcs,
+								   mul_size(max_cached_subxids,
+											sizeof(TransactionId))));
+
+	/* PROCLOCK lists, one per lock partition */
+	size = add_size(size, mul_size(TotalProcs,
+								   mul_size(NUM_LOCK_PARTITIONS,
+											sizeof(dlist_head))));
+
 	return size;
 }
 
+/*
+ * Size of the fast-path lock arrays of one PGPROC
+ */
+static Size
+FastPathLockShmemSizePerProc(void)
+{
+	return MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64)) +
+		MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+}
+
+/*
+ * InitializeFastPathLocks -- size the fast-path lock arrays
+ *
+ * Fast-path locks are used for a large part of the locks a transaction
+ * takes, so give each backend enough groups of slots to cover
+ * max_locks_per_transaction, rounded up to a power of two.  Must be called
+ * after the GUCs are loaded and before shared memory is sized.
+ */
+void
+InitializeFastPathLocks(void)
+{
+	Assert(FastPathLockGroupsPerBackend == 0);
+
+	FastPathLockGroupsPerBackend = 1;
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX &&
+		   FastPathLockSlotsPerBackend() < max_locks_per_xact)
+		FastPathLockGroupsPerBackend *= 2;
+}
+
 /*
  * Report number of semaphores needed by InitProcGlobal.
  */
@@ -128,6 +174,36 @@ ProcGlobalSemas(void)
 	return MaxBackends + NUM_AUXILIARY_PROCS;
 }
 
+/*
+ * ProcNumaNode -- NUMA node the given PGPROC was placed on by InitProcGlobal
+ */
+int
+ProcNumaNode(int pgprocno)
+{
+	uint32		TotalProcs = MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts;
+	int			nnodes = ShmemNumaNodes();
+
+	return pgprocno / ((TotalProcs + nnodes - 1) / nnodes);
+}
+
+/*
+ * ProcNumaPin -- run this process on the node its PGPROC lives on
+ *
+ * This is done once we have a PGPROC, rather than at fork time, because
+ * that's only when it's known which one we got.  Private memory allocated
+ * from here on then also comes from the same node.
+ */
+static void
+ProcNumaPin(void)
+{
+	if (!numa_pin_backends || !ShmemNumaAvailable())
+		return;
+
+	if (pg_numa_run_on_node(ProcNumaNode(MyProc->pgprocno)) != 0)
+		elog(DEBUG1, "could not run process on NUMA node %d: %m",
+			 ProcNumaNode(MyProc->pgprocno));
+}
+
 /*
  * InitProcGlobal -
  *	  Initialize the global process table during postmaster or standalone
@@ -161,6 +237,11 @@ InitProcGlobal(void)
 				j;
 	bool		found;
 	uint32		TotalProcs = MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts;
+	char	   *fpPtr;
+	Size		fpLockBitsSize,
+				fpRelIdSize;
+	TransactionId *subxids;
+	dlist_head *procLocks;
 
 	/* Create the ProcGlobal shared structure */
 	ProcGlobal = (PROC_HDR *)
@@ -181,6 +262,7 @@ InitProcGlobal(void)
 	ProcGlobal->checkpointerLatch = NULL;
 	pg_atomic_init_u32(&ProcGlobal->procArrayGroupFirst, INVALID_PGPROCNO);
 	pg_atomic_init_u32(&ProcGlobal->clogGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u32(&ProcGlobal->walFlushGroupFirst, INVALID_PGPROCNO);
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -191,6 +273,23 @@ InitProcGlobal(void)
 	 * between groups.
 	 */
 	procs = (PGPROC *) ShmemAlloc(TotalProcs * sizeof(PGPROC)); // 分配一个PGPROC数组，个数由TotalProcs决定
+
+	/*
+	 * With numa enabled, split the array into one contiguous chunk per node
+	 * and place each chunk on its node, before the memory is touched.  A
+	 * process is then (optionally) run on the node holding its PGPROC, see
+	 * ProcNumaNode().
+	 */
+	if (ShmemNumaAvailable())
+	{
+		int			nnodes = ShmemNumaNodes();
+		uint32		chunk = (TotalProcs + nnodes - 1) / nnodes;
+
+		for (int node = 0; node < nnodes && node * chunk < TotalProcs; node++)
+			ShmemNumaBind("PGPROC", &procs[node * chunk],
+						  Min(chunk, TotalProcs - node * chunk) * sizeof(PGPROC),
+						  node);
+	}
 	MemSet(procs, 0, TotalProcs * sizeof(PGPROC));
 	ProcGlobal->allProcs = procs;
 	/* XXX allProcCount isn't really all of them; it excludes prepared xacts */
@@ -212,12 +311,42 @@ InitProcGlobal(void)
 	ProcGlobal->statusFlags = (uint8 *) ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->statusFlags));
 	MemSet(ProcGlobal->statusFlags, 0, TotalProcs * sizeof(*ProcGlobal->statusFlags));
 
+	/*
+	 * Allocate the fast-path lock arrays, whose size depends on
+	 * max_locks_per_transaction, separately from the PGPROCs.
+	 */
+	fpLockBitsSize = MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64));
+	fpRelIdSize = MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+	fpPtr = ShmemAlloc(TotalProcs * (fpLockBitsSize + fpRelIdSize));
+	MemSet(fpPtr, 0, TotalProcs * (fpLockBitsSize + fpRelIdSize));
+
+	/* Likewise the subxid caches, sized by max_cached_subxids. */
+	subxids = (TransactionId *)
+		ShmemAlloc(mul_size(TotalProcs,
+							mul_size(max_cached_subxids, sizeof(TransactionId))));
+
+	/* And the PROCLOCK lists, whose number depends on lock_partitions. */
+	procLocks = (dlist_head *)
+		ShmemAlloc(mul_size(TotalProcs,
+							mul_size(NUM_LOCK_PARTITIONS, sizeof(dlist_head))));
+
 	for (i = 0; i < TotalProcs; i++) // 扫描数组
 	{
 		PGPROC	   *proc = &procs[i];
 
 		/* Common initialization for all PGPROCs, regardless of type. */
 
+		proc->fpLockBits = (uint64 *) fpPtr;
+		fpPtr += fpLockBitsSize;
+		proc->fpRelId = (Oid *) fpPtr;
+		fpPtr += fpRelIdSize;
+
+		proc->subxids.xids = subxids;
+		subxids += max_cached_subxids;
+
+		proc->myProcLocks = procLocks;
+		procLocks += NUM_LOCK_PARTITIONS;
+
 		/*
 		 * Set up per-PGPROC semaphore, latch, and fpInfoLock.  Prepared xact
 		 * dummy PGPROCs don't need these though - they're never associated
@@ -230,6 +359,7 @@ InitProcGlobal(void)
 			LWLockInitialize(&(proc->fpInfoLock), LWTRANCHE_LOCK_FASTPATH);
 		}
 		proc->pgprocno = i;
+		proc->runningXidIndex = -1;
 
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
@@ -277,6 +407,7 @@ InitProcGlobal(void)
 		 */
 		pg_atomic_init_u32(&(proc->procArrayGroupNext), INVALID_PGPROCNO);
 		pg_atomic_init_u32(&(proc->clogGroupNext), INVALID_PGPROCNO);
+		pg_atomic_init_u32(&(proc->walFlushGroupNext), INVALID_PGPROCNO);
 		pg_atomic_init_u64(&(proc->waitStart), 0);
 	}
 
@@ -395,6 +526,7 @@ InitProcess(void)
 		MyProc->statusFlags |= PROC_IS_AUTOVACUUM;
 	MyProc->lwWaiting = LW_WS_NOT_WAITING;
 	MyProc->lwWaitMode = 0;
+	MyProc->lwNumaSkips = 0;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
 	pg_atomic_write_u64(&MyProc->waitStart, 0);
@@ -417,6 +549,7 @@ InitProcess(void)
 	/* Initialize fields for group XID clearing. */
 	MyProc->procArrayGroupMember = false;
 	MyProc->procArrayGroupMemberXid = InvalidTransactionId;
+	MyProc->procArrayGroupMemberRemove = NULL;
 	Assert(pg_atomic_read_u32(&MyProc->procArrayGroupNext) == INVALID_PGPROCNO);
 
 	/* Check that group locking fields are in a proper initial state. */
@@ -429,11 +562,18 @@ InitProcess(void)
 	/* Initialize fields for group transaction status update. */
 	MyProc->clogGroupMember = false;
 	MyProc->clogGroupMemberXid = InvalidTransactionId;
+	MyProc->clogGroupMemberSubxids = NULL;
+	MyProc->clogGroupMemberNsubxids = 0;
 	MyProc->clogGroupMemberXidStatus = TRANSACTION_STATUS_IN_PROGRESS;
 	MyProc->clogGroupMemberPage = -1;
 	MyProc->clogGroupMemberLsn = InvalidXLogRecPtr;
 	Assert(pg_atomic_read_u32(&MyProc->clogGroupNext) == INVALID_PGPROCNO);
 
+	/* Initialize fields for group WAL flush. */
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupLsn = InvalidXLogRecPtr;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch
 	 * on it.  That allows us to repoint the process latch, which so far
@@ -442,6 +582,8 @@ InitProcess(void)
 	OwnLatch(&MyProc->procLatch);
 	SwitchToSharedLatch();
 
+	ProcNumaPin();
+
 	/* now that we have a proc, report wait events to shared memory */
 	pgstat_set_wait_event_storage(&MyProc->wait_event_info);
 
@@ -577,9 +719,13 @@ InitAuxiliaryProcess(void)
 	MyProc->statusFlags = 0;
 	MyProc->lwWaiting = LW_WS_NOT_WAITING;
 	MyProc->lwWaitMode = 0;
+	MyProc->lwNumaSkips = 0;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
 	pg_atomic_write_u64(&MyProc->waitStart, 0);
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupLsn = InvalidXLogRecPtr;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
 #ifdef USE_ASSERT_CHECKING
 	{
 		int			i;
@@ -598,6 +744,8 @@ InitAuxiliaryProcess(void)
 	OwnLatch(&MyProc->procLatch);
 	SwitchToSharedLatch();
 
+	ProcNumaPin();
+
 	/* now that we have a proc, report wait events to shared memory */
 	pgstat_set_wait_event_storage(&MyProc->wait_event_info);
 
@@ -1696,6 +1844,15 @@ CheckDeadLock(void)
 {
 	int			i;
 
+	/*
+	 * Most of the time there is no deadlock, and a search of the waits-for
+	 * graph that only locks the partitions it visits, in shared mode, can
+	 * tell.  Only if it finds a cycle do we need the full check, which may
+	 * rearrange wait queues.
+	 */
+	if (DeadLockCheckQuick(MyProc, lockAwaited->hashcode, &deadlock_state))
+		return;
+
 	/*
 	 * Acquire exclusive lock on the entire shared lock data structures. Must
 	 * grab LWLocks in partition-number order to avoid LWLock deadlock.
@@ -1850,6 +2007,40 @@ BecomeLockGroupLeader(void)
 	LWLockRelease(leader_lwlock);
 }
 
+/*
+ * LeaveLockGroup - stop being a lock group member
+ *
+ * This is for a parallel worker that goes on to serve other leaders, once it
+ * is done with the current one's transaction and holds no locks anymore.
+ * Like ProcKill, we must return the leader's PGPROC if the leader has exited
+ * already and we were the last member of its group.
+ */
+void
+LeaveLockGroup(void)
+{
+	PGPROC	   *leader = MyProc->lockGroupLeader;
+	LWLock	   *leader_lwlock;
+
+	Assert(leader != NULL && leader != MyProc);
+
+	leader_lwlock = LockHashPartitionLockByProc(leader);
+	LWLockAcquire(leader_lwlock, LW_EXCLUSIVE);
+	Assert(!dlist_is_empty(&leader->lockGroupMembers));
+	dlist_delete(&MyProc->lockGroupLink);
+	if (dlist_is_empty(&leader->lockGroupMembers))
+	{
+		dlist_head *procgloballist = leader->procgloballist;
+
+		/* Leader exited first; return its PGPROC. */
+		leader->lockGroupLeader = NULL;
+		SpinLockAcquire(ProcStructLock);
+		dlist_push_head(procgloballist, &leader->links);
+		SpinLockRelease(ProcStructLock);
+	}
+	MyProc->lockGroupLeader = NULL;
+	LWLockRelease(leader_lwlock);
+}
+
 /*
  * BecomeLockGroupMember - designate process as lock group member
  *
@@ -810,6 +810,9 @@ PageRepairFragmentation(Page page) // 在页面修剪后，进行碎片化整理
 		PageSetHasFreeLinePointers(page);
 	else
 		PageClearHasFreeLinePointers(page);
+
+	/* Storage of all removed items has been reclaimed now */
+	PageClearNeedsDefrag(page);
 }
 
 /*
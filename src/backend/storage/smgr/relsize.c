@@ -0,0 +1,417 @@
+/*-------------------------------------------------------------------------
+ *
+ * relsize.c
+ *	  shared cache of relation fork sizes.
+ *
+ * smgrnblocks() used to ask the kernel for the size of a relation fork,
+ * with an lseek(SEEK_END) per segment, every time it was called outside
+ * recovery: when planning a query, at the start of each sequential scan,
+ * and so on.  With many relations, as when planning a query on a table
+ * with thousands of partitions, those system calls add up.  This module
+ * keeps the sizes of recently used forks of permanent and unlogged
+ * relations in a small shared hash table keyed by RelFileLocator, so that
+ * in the common case the size is just read from memory.
+ *
+ * The cache is kept coherent by smgr.c, which every change of a fork's
+ * size goes through: extension raises the cached size (to the larger of the
+ * two, as concurrent extenders may report out of order), truncation sets
+ * it, and unlinking a relation or dropping a database removes its entries.
+ * Sizes only grow between those events, which need AccessExclusiveLock.
+ *
+ * A backend that misses the cache asks the kernel, and then stores what it
+ * was told.  As the fork could have been truncated or dropped in between,
+ * or its entry evicted after an extension, each partition has a generation
+ * counter that is bumped whenever an entry goes away or shrinks; the size is
+ * only stored if the counter hasn't changed since the miss.
+ *
+ * Entries are replaced with a clock sweep over the entries of a partition.
+ * Temporary relations are not cached here; they are private to a backend.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/smgr/relsize.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "lib/ilist.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/hsearch.h"
+
+/* number of partitions of the cache; must be a power of 2 */
+#define NUM_RELSIZE_PARTITIONS	16
+
+/* GUC variable: maximum number of relations in the cache */
+int			relsize_cache_size = 8192;
+
+/* entry of the cache hashtable */
+typedef struct RelSizeEnt
+{
+	RelFileLocator key;			/* relation file, hash key */
+	BlockNumber nblocks[MAX_FORKNUM + 1];	/* or InvalidBlockNumber */
+	bool		recently_used;	/* for the clock sweep */
+	dlist_node	link;			/* in the partition's list of entries */
+} RelSizeEnt;
+
+typedef struct RelSizePartition
+{
+	LWLock		lock;
+	uint64		generation;		/* see file header comment */
+	dlist_head	entries;		/* newest first */
+} RelSizePartition;
+
+typedef union RelSizePartitionPadded
+{
+	RelSizePartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} RelSizePartitionPadded;
+
+static HTAB *SharedRelSize = NULL;
+static RelSizePartitionPadded *RelSizePartitions;
+
+static inline RelSizePartition *
+RelSizeGetPartition(uint32 hashcode)
+{
+	return &RelSizePartitions[hashcode % NUM_RELSIZE_PARTITIONS].part;
+}
+
+/*
+ * Estimate space needed for the cache
+ */
+Size
+RelSizeShmemSize(void)
+{
+	Size		size = 0;
+
+	if (relsize_cache_size == 0)
+		return 0;
+
+	size = add_size(size, hash_estimate_size(relsize_cache_size,
+											 sizeof(RelSizeEnt)));
+	size = add_size(size, mul_size(NUM_RELSIZE_PARTITIONS,
+								   sizeof(RelSizePartitionPadded)));
+
+	return size;
+}
+
+/*
+ * Initialize the cache in shared memory
+ */
+void
+RelSizeShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (relsize_cache_size == 0)
+		return;
+
+	/* assume no locking is needed yet */
+
+	info.keysize = sizeof(RelFileLocator);
+	info.entrysize = sizeof(RelSizeEnt);
+	info.num_partitions = NUM_RELSIZE_PARTITIONS;
+
+	SharedRelSize = ShmemInitHash("Shared Relation Size Cache",
+								  relsize_cache_size, relsize_cache_size,
+								  &info,
+								  HASH_ELEM | HASH_BLOBS |
+								  HASH_PARTITION | HASH_FIXED_SIZE);
+
+	RelSizePartitions = (RelSizePartitionPadded *)
+		ShmemInitStruct("Shared Relation Size Cache Partitions",
+						mul_size(NUM_RELSIZE_PARTITIONS,
+								 sizeof(RelSizePartitionPadded)),
+						&found);
+
+	if (!found)
+	{
+		for (int i = 0; i < NUM_RELSIZE_PARTITIONS; i++)
+		{
+			RelSizePartition *part = &RelSizePartitions[i].part;
+
+			LWLockInitialize(&part->lock, LWTRANCHE_RELSIZE_CACHE);
+			part->generation = 0;
+			dlist_init(&part->entries);
+		}
+	}
+}
+
+/*
+ * Evict an entry of the partition to make room for a new one.  Returns false
+ * if the partition has no entries to give up.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static bool
+RelSizeEvict(RelSizePartition *part)
+{
+	/* two passes clear all the usage bits, if need be */
+	while (!dlist_is_empty(&part->entries))
+	{
+		RelSizeEnt *ent = dlist_tail_element(RelSizeEnt, link, &part->entries);
+
+		if (ent->recently_used)
+		{
+			ent->recently_used = false;
+			dlist_move_head(&part->entries, &ent->link);
+			continue;
+		}
+
+		dlist_delete(&ent->link);
+		hash_search(SharedRelSize, &ent->key, HASH_REMOVE, NULL);
+		part->generation++;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Find the entry for rlocator, creating it, with all sizes unknown, if it
+ * doesn't exist.  Returns NULL if there is no room.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static RelSizeEnt *
+RelSizeEnter(RelSizePartition *part, const RelFileLocator *rlocator,
+			 uint32 hashcode)
+{
+	RelSizeEnt *ent;
+	bool		found;
+
+	for (;;)
+	{
+		ent = (RelSizeEnt *)
+			hash_search_with_hash_value(SharedRelSize, rlocator, hashcode,
+										HASH_ENTER_NULL, &found);
+		if (ent != NULL)
+			break;
+		if (!RelSizeEvict(part))
+			return NULL;
+	}
+
+	if (!found)
+	{
+		for (int i = 0; i <= MAX_FORKNUM; i++)
+			ent->nblocks[i] = InvalidBlockNumber;
+		ent->recently_used = false;
+		dlist_push_head(&part->entries, &ent->link);
+	}
+
+	return ent;
+}
+
+/*
+ * RelSizeGet
+ *		Return the cached size of a fork, or InvalidBlockNumber
+ *
+ * On a miss, *generation is set for use with a following RelSizeSet().
+ */
+BlockNumber
+RelSizeGet(const RelFileLocator *rlocator, ForkNumber forknum,
+		   uint64 *generation)
+{
+	uint32		hashcode;
+	RelSizePartition *part;
+	RelSizeEnt *ent;
+	BlockNumber result = InvalidBlockNumber;
+
+	if (SharedRelSize == NULL)
+		return InvalidBlockNumber;
+
+	hashcode = get_hash_value(SharedRelSize, rlocator);
+	part = RelSizeGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_SHARED);
+
+	ent = (RelSizeEnt *)
+		hash_search_with_hash_value(SharedRelSize, rlocator, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		result = ent->nblocks[forknum];
+
+		/* racy, but only the clock sweep looks at it */
+		if (!ent->recently_used)
+			ent->recently_used = true;
+	}
+	if (result == InvalidBlockNumber)
+		*generation = part->generation;
+
+	LWLockRelease(&part->lock);
+
+	return result;
+}
+
+/*
+ * RelSizeSet
+ *		Store the size of a fork that was read from the kernel after a miss
+ *
+ * Nothing is stored if an entry of the partition has gone away or shrunk
+ * since generation was returned by RelSizeGet(), as our size may be stale.
+ */
+void
+RelSizeSet(const RelFileLocator *rlocator, ForkNumber forknum,
+		   BlockNumber nblocks, uint64 generation)
+{
+	uint32		hashcode;
+	RelSizePartition *part;
+	RelSizeEnt *ent;
+
+	if (SharedRelSize == NULL)
+		return;
+
+	hashcode = get_hash_value(SharedRelSize, rlocator);
+	part = RelSizeGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	if (part->generation == generation)
+	{
+		ent = RelSizeEnter(part, rlocator, hashcode);
+		if (ent != NULL &&
+			(ent->nblocks[forknum] == InvalidBlockNumber ||
+			 ent->nblocks[forknum] < nblocks))
+			ent->nblocks[forknum] = nblocks;
+	}
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * RelSizeExtend
+ *		Note that a fork now has at least nblocks blocks
+ */
+void
+RelSizeExtend(const RelFileLocator *rlocator, ForkNumber forknum,
+			  BlockNumber nblocks)
+{
+	uint32		hashcode;
+	RelSizePartition *part;
+	RelSizeEnt *ent;
+
+	if (SharedRelSize == NULL)
+		return;
+
+	hashcode = get_hash_value(SharedRelSize, rlocator);
+	part = RelSizeGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	ent = RelSizeEnter(part, rlocator, hashcode);
+	if (ent != NULL &&
+		(ent->nblocks[forknum] == InvalidBlockNumber ||
+		 ent->nblocks[forknum] < nblocks))
+		ent->nblocks[forknum] = nblocks;
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * RelSizeTruncate
+ *		Note that a fork has been truncated to nblocks blocks
+ *
+ * nblocks may be InvalidBlockNumber if the new size isn't known, as when it
+ * was created again.
+ */
+void
+RelSizeTruncate(const RelFileLocator *rlocator, ForkNumber forknum,
+				BlockNumber nblocks)
+{
+	uint32		hashcode;
+	RelSizePartition *part;
+	RelSizeEnt *ent;
+
+	if (SharedRelSize == NULL)
+		return;
+
+	hashcode = get_hash_value(SharedRelSize, rlocator);
+	part = RelSizeGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	ent = (RelSizeEnt *)
+		hash_search_with_hash_value(SharedRelSize, rlocator, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		ent->nblocks[forknum] = nblocks;
+	part->generation++;
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * RelSizeDrop
+ *		Forget all forks of a relation that is being unlinked
+ */
+void
+RelSizeDrop(const RelFileLocator *rlocator)
+{
+	uint32		hashcode;
+	RelSizePartition *part;
+	RelSizeEnt *ent;
+
+	if (SharedRelSize == NULL)
+		return;
+
+	hashcode = get_hash_value(SharedRelSize, rlocator);
+	part = RelSizeGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	ent = (RelSizeEnt *)
+		hash_search_with_hash_value(SharedRelSize, rlocator, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		dlist_delete(&ent->link);
+		hash_search_with_hash_value(SharedRelSize, rlocator, hashcode,
+									HASH_REMOVE, NULL);
+	}
+	part->generation++;
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * RelSizeDropDatabase
+ *		Forget all relations of a database whose files are being removed
+ *		or moved wholesale, without going through smgr
+ */
+void
+RelSizeDropDatabase(Oid dbid)
+{
+	HASH_SEQ_STATUS status;
+	RelSizeEnt *ent;
+
+	if (SharedRelSize == NULL)
+		return;
+
+	/* a consistent scan of the hashtable needs all partition locks */
+	for (int i = 0; i < NUM_RELSIZE_PARTITIONS; i++)
+		LWLockAcquire(&RelSizePartitions[i].part.lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedRelSize);
+	while ((ent = (RelSizeEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (ent->key.dbOid == dbid)
+		{
+			dlist_delete(&ent->link);
+			hash_search(SharedRelSize, &ent->key, HASH_REMOVE, NULL);
+		}
+	}
+
+	for (int i = NUM_RELSIZE_PARTITIONS; --i >= 0;)
+	{
+		RelSizePartitions[i].part.generation++;
+		LWLockRelease(&RelSizePartitions[i].part.lock);
+	}
+}
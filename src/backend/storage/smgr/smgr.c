@@ -19,6 +19,7 @@
 
 #include "access/xlogutils.h"
 #include "lib/ilist.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
@@ -54,11 +55,20 @@ typedef struct f_smgr
 	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
 									BlockNumber blocknum, int nblocks, bool skipFsync);
 	bool		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
-								  BlockNumber blocknum);
-	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
-							  BlockNumber blocknum, void *buffer);
-	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
-							   BlockNumber blocknum, const void *buffer, bool skipFsync);
+								  BlockNumber blocknum, int nblocks);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+							   BlockNumber blocknum,
+							   void **buffers, BlockNumber nblocks);
+	BlockNumber (*smgr_maxcombine) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum);
+	void		(*smgr_startreadv) (PgAioHandle *ioh,
+									SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum,
+									void **buffers, BlockNumber nblocks);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+								BlockNumber blocknum,
+								const void **buffers, BlockNumber nblocks,
+								bool skipFsync);
 	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
 								   BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
@@ -80,8 +90,10 @@ static const f_smgr smgrsw[] = {
 		.smgr_extend = mdextend,
 		.smgr_zeroextend = mdzeroextend,
 		.smgr_prefetch = mdprefetch,
-		.smgr_read = mdread,
-		.smgr_write = mdwrite,
+		.smgr_readv = mdreadv,
+		.smgr_maxcombine = mdmaxcombine,
+		.smgr_startreadv = mdstartreadv,
+		.smgr_writev = mdwritev,
 		.smgr_writeback = mdwriteback,
 		.smgr_nblocks = mdnblocks,
 		.smgr_truncate = mdtruncate,
@@ -374,6 +386,11 @@ void
 smgrcreate(SMgrRelation reln, ForkNumber forknum, bool isRedo)
 {
 	smgrsw[reln->smgr_which].smgr_create(reln, forknum, isRedo);
+
+	/* In redo, the file may have existed; don't trust any cached size */
+	if (!SmgrIsTemp(reln))
+		RelSizeTruncate(&reln->smgr_rlocator.locator, forknum,
+						InvalidBlockNumber);
 }
 
 /*
@@ -465,6 +482,13 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 	for (i = 0; i < nrels; i++)
 		CacheInvalidateSmgr(rlocators[i]);
 
+	/* The files' WAL statistics won't be looked at anymore */
+	for (i = 0; i < nrels; i++)
+	{
+		if (!RelFileLocatorBackendIsTemp(rlocators[i]))
+			pgstat_drop_wal_relation(&rlocators[i].locator);
+	}
+
 	/*
 	 * Delete the physical file(s).
 	 *
@@ -479,6 +503,9 @@ smgrdounlinkall(SMgrRelation *rels, int nrels, bool isRedo)
 
 		for (forknum = 0; forknum <= MAX_FORKNUM; forknum++)
 			smgrsw[which].smgr_unlink(rlocators[i], forknum, isRedo);
+
+		if (!RelFileLocatorBackendIsTemp(rlocators[i]))
+			RelSizeDrop(&rlocators[i].locator);
 	}
 
 	pfree(rlocators);
@@ -501,6 +528,9 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_extend(reln, forknum, blocknum,
 										 buffer, skipFsync);
 
+	if (!SmgrIsTemp(reln))
+		RelSizeExtend(&reln->smgr_rlocator.locator, forknum, blocknum + 1);
+
 	/*
 	 * Normally we expect this to increase nblocks by one, but if the cached
 	 * value isn't as expected, just invalidate it so the next call asks the
@@ -526,6 +556,10 @@ smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	smgrsw[reln->smgr_which].smgr_zeroextend(reln, forknum, blocknum,
 											 nblocks, skipFsync);
 
+	if (!SmgrIsTemp(reln))
+		RelSizeExtend(&reln->smgr_rlocator.locator, forknum,
+					  blocknum + nblocks);
+
 	/*
 	 * Normally we expect this to increase the fork size by nblocks, but if
 	 * the cached value isn't as expected, just invalidate it so the next call
@@ -538,16 +572,19 @@ smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 }
 
 /*
- * smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
+ * smgrprefetch() -- Initiate asynchronous read of the specified blocks of a
+ *					 relation.
  *
  * In recovery only, this can return false to indicate that a file
  * doesn't exist (presumably it has been dropped by a later WAL
  * record).
  */
 bool
-smgrprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
+smgrprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 int nblocks)
 {
-	return smgrsw[reln->smgr_which].smgr_prefetch(reln, forknum, blocknum);
+	return smgrsw[reln->smgr_which].smgr_prefetch(reln, forknum, blocknum,
+												  nblocks);
 }
 
 /*
@@ -562,7 +599,49 @@ void
 smgrread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		 void *buffer)
 {
-	smgrsw[reln->smgr_which].smgr_read(reln, forknum, blocknum, buffer);
+	smgrsw[reln->smgr_which].smgr_readv(reln, forknum, blocknum, &buffer, 1);
+}
+
+/*
+ * smgrreadv() -- read a run of consecutive blocks from a relation into the
+ *				  supplied buffers.
+ *
+ * This is the multi-block variant of smgrread(); buffers[i] receives block
+ * blocknum + i.  Storage managers are expected to combine the transfer into
+ * as few system calls as they can.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  void **buffers, BlockNumber nblocks)
+{
+	smgrsw[reln->smgr_which].smgr_readv(reln, forknum, blocknum, buffers,
+										nblocks);
+}
+
+/*
+ * smgrmaxcombine() -- the maximum number of blocks, starting at blocknum,
+ *					   that smgrstartreadv() can read with one I/O.
+ */
+BlockNumber
+smgrmaxcombine(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
+{
+	return smgrsw[reln->smgr_which].smgr_maxcombine(reln, forknum, blocknum);
+}
+
+/*
+ * smgrstartreadv() -- start an asynchronous read of a run of consecutive
+ *					   blocks into the supplied buffers.
+ *
+ * The I/O is performed using the given AIO handle; nblocks must not exceed
+ * smgrmaxcombine().  Completion, including checking for a short read, is the
+ * business of the handle's completion callback.
+ */
+void
+smgrstartreadv(PgAioHandle *ioh, SMgrRelation reln, ForkNumber forknum,
+			   BlockNumber blocknum, void **buffers, BlockNumber nblocks)
+{
+	smgrsw[reln->smgr_which].smgr_startreadv(ioh, reln, forknum, blocknum,
+											 buffers, nblocks);
 }
 
 /*
@@ -584,8 +663,23 @@ void
 smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		  const void *buffer, bool skipFsync)
 {
-	smgrsw[reln->smgr_which].smgr_write(reln, forknum, blocknum,
-										buffer, skipFsync);
+	smgrsw[reln->smgr_which].smgr_writev(reln, forknum, blocknum,
+										 &buffer, 1, skipFsync);
+}
+
+/*
+ * smgrwritev() -- write a run of consecutive blocks of a relation from the
+ *				   supplied buffers.
+ *
+ * This is the multi-block variant of smgrwrite(); buffers[i] is written to
+ * block blocknum + i.  The same rules as for smgrwrite() apply.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   const void **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	smgrsw[reln->smgr_which].smgr_writev(reln, forknum, blocknum, buffers,
+										 nblocks, skipFsync);
 }
 
 
@@ -604,19 +698,37 @@ smgrwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 /*
  * smgrnblocks() -- Calculate the number of blocks in the
  *					supplied relation.
+ *
+ * Outside recovery, the size normally comes from the shared relation size
+ * cache (see relsize.c), rather than from the kernel.
  */
 BlockNumber
 smgrnblocks(SMgrRelation reln, ForkNumber forknum)
 {
 	BlockNumber result;
+	uint64		generation = 0;
 
 	/* Check and return if we get the cached value for the number of blocks. */
 	result = smgrnblocks_cached(reln, forknum);
 	if (result != InvalidBlockNumber)
 		return result;
 
+	if (!SmgrIsTemp(reln))
+	{
+		result = RelSizeGet(&reln->smgr_rlocator.locator, forknum,
+							&generation);
+		if (result != InvalidBlockNumber)
+		{
+			reln->smgr_cached_nblocks[forknum] = result;
+			return result;
+		}
+	}
+
 	result = smgrsw[reln->smgr_which].smgr_nblocks(reln, forknum);
 
+	if (!SmgrIsTemp(reln))
+		RelSizeSet(&reln->smgr_rlocator.locator, forknum, result, generation);
+
 	reln->smgr_cached_nblocks[forknum] = result;
 
 	return result;
@@ -634,14 +746,29 @@ smgrnblocks_cached(SMgrRelation reln, ForkNumber forknum)
 {
 	/*
 	 * For now, we only use cached values in recovery due to lack of a shared
-	 * invalidation mechanism for changes in file size.
+	 * invalidation mechanism for changes in file size.  Not in parallel redo
+	 * workers either, which extend relations concurrently.
 	 */
-	if (InRecovery && reln->smgr_cached_nblocks[forknum] != InvalidBlockNumber)
+	if (InRecovery && !InParallelRedoWorker &&
+		reln->smgr_cached_nblocks[forknum] != InvalidBlockNumber)
 		return reln->smgr_cached_nblocks[forknum];
 
 	return InvalidBlockNumber;
 }
 
+/*
+ * smgrforgetnblocks() -- Forget the cached sizes of all forks of a relation
+ *
+ * The startup process uses this for relations that parallel redo workers
+ * may have extended.
+ */
+void
+smgrforgetnblocks(SMgrRelation reln)
+{
+	for (int i = 0; i <= MAX_FORKNUM; ++i)
+		reln->smgr_cached_nblocks[i] = InvalidBlockNumber;
+}
+
 /*
  * smgrtruncate() -- Truncate the given forks of supplied relation to
  *					 each specified numbers of blocks
@@ -680,9 +807,16 @@ smgrtruncate(SMgrRelation reln, ForkNumber *forknum, int nforks, BlockNumber *nb
 	{
 		/* Make the cached size is invalid if we encounter an error. */
 		reln->smgr_cached_nblocks[forknum[i]] = InvalidBlockNumber;
+		if (!SmgrIsTemp(reln))
+			RelSizeTruncate(&reln->smgr_rlocator.locator, forknum[i],
+							InvalidBlockNumber);
 
 		smgrsw[reln->smgr_which].smgr_truncate(reln, forknum[i], nblocks[i]);
 
+		if (!SmgrIsTemp(reln))
+			RelSizeTruncate(&reln->smgr_rlocator.locator, forknum[i],
+							nblocks[i]);
+
 		/*
 		 * We might as well update the local smgr_cached_nblocks values. The
 		 * smgr cache inval message that this function sent will cause other
@@ -284,6 +284,17 @@ SyncPostCheckpoint(void)
 	}
 }
 
+/*
+ *	NumPendingSyncRequests() -- Number of fsyncs remembered but not done yet.
+ */
+int
+NumPendingSyncRequests(void)
+{
+	if (!pendingOps)
+		return 0;
+	return (int) hash_get_num_entries(pendingOps);
+}
+
 /*
  *	ProcessSyncRequests() -- Process queued fsync requests.
  */
@@ -295,6 +306,7 @@ ProcessSyncRequests(void)
 	HASH_SEQ_STATUS hstat;
 	PendingFsyncEntry *entry;
 	int			absorb_counter;
+	long		ntosync;
 
 	/* Statistics on sync times */
 	int			processed = 0;
@@ -363,6 +375,9 @@ ProcessSyncRequests(void)
 	/* Set flag to detect failure if we don't reach the end of the loop */
 	sync_in_progress = true;
 
+	/* Entries absorbed from here on are new, so this is all we'll sync */
+	ntosync = hash_get_num_entries(pendingOps);
+
 	/* Now scan the hashtable for fsync requests to process */
 	absorb_counter = FSYNCS_PER_ABSORB;
 	hash_seq_init(&hstat, pendingOps);
@@ -436,6 +451,9 @@ ProcessSyncRequests(void)
 							 path,
 							 (double) elapsed / 1000);
 
+					/* Let the checkpointer spread the fsyncs */
+					CheckpointSyncDelay((double) processed / ntosync, elapsed);
+
 					break;		/* out of retry loop */
 				}
 
@@ -55,6 +55,7 @@
 #include "postmaster/autovacuum.h"
 #include "postmaster/interrupt.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/sessionkeeper.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalworker.h"
 #include "replication/slot.h"
@@ -68,13 +69,17 @@
 #include "storage/sinval.h"
 #include "tcop/fastpath.h"
 #include "tcop/pquery.h"
+#include "tcop/stmtcache.h"
 #include "tcop/tcopprot.h"
 #include "tcop/utility.h"
+#include "utils/backend_memory.h"
 #include "utils/guc_hooks.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
 #include "utils/timeout.h"
 #include "utils/timestamp.h"
 
@@ -169,6 +174,29 @@ static ProcSignalReason RecoveryConflictReason;
 static MemoryContext row_description_context = NULL;
 static StringInfoData row_description_buf;
 
+/*
+ * Input function lookups for Bind parameters, by parameter position.
+ *
+ * A pipeline that binds the same statement over and over, as array-style
+ * DML through the extended protocol does, would otherwise look up and set
+ * up the same input functions for every Bind message.  Keeping the FmgrInfo
+ * also lets input functions that cache things in fn_extra (array_in,
+ * domain_in and so on) reuse that work from one Bind to the next.  The
+ * whole cache is thrown away when pg_type or pg_proc changes.
+ */
+typedef struct BindParamIOData
+{
+	Oid			ptype;			/* parameter type, or InvalidOid if unset */
+	int16		pformat;		/* 0 = text, 1 = binary */
+	Oid			typioparam;
+	FmgrInfo	iofunc;			/* typinput or typreceive function */
+} BindParamIOData;
+
+static MemoryContext bind_param_io_context = NULL;
+static BindParamIOData *bind_param_io = NULL;
+static int	bind_param_io_size = 0;
+static bool bind_param_io_valid = false;
+
 /* ----------------------------------------------------------------
  *		decls for routines only used in this file
  * ----------------------------------------------------------------
@@ -184,6 +212,10 @@ static int	errdetail_params(ParamListInfo params);
 static int	errdetail_abort(void);
 static int	errdetail_recovery_conflict(void);
 static void bind_param_error_callback(void *arg);
+static BindParamIOData *get_bind_param_io(int paramno, Oid ptype,
+										  int16 pformat);
+static void invalidate_bind_param_io(Datum arg, int cacheid,
+									 uint32 hashvalue);
 static void start_xact_command(void);
 static void finish_xact_command(void);
 static bool IsTransactionExitStmt(Node *parsetree);
@@ -1020,6 +1052,8 @@ exec_simple_query(const char *query_string)
 	bool		was_logged = false;
 	bool		use_implicit_block;
 	char		msec_str[32];
+	StmtCacheQuery *scquery;
+	CachedPlanSource *scpsrc = NULL;
 
 	/*
 	 * Report query to various monitoring facilities.
@@ -1059,11 +1093,23 @@ exec_simple_query(const char *query_string)
 	 */
 	oldcontext = MemoryContextSwitchTo(MessageContext);
 
+	/*
+	 * If the statement cache already has a statement like this one, we can
+	 * skip parsing.  The raw parse tree is copied, as the cache entry could
+	 * go away while the query runs.
+	 */
+	scquery = StmtCacheScanQuery(query_string);
+	if (scquery != NULL)
+		scpsrc = StmtCacheLookup(scquery);
+	if (scpsrc != NULL)
+		parsetree_list = list_make1(copyObject(scpsrc->raw_parse_tree));
+
 	/*
 	 * Do basic parsing of the query or queries (this should be safe even if
 	 * we are in aborted transaction state!)
 	 */
-	parsetree_list = pg_parse_query(query_string);
+	else
+		parsetree_list = pg_parse_query(query_string);
 
 	/* Log immediately if dictated by log_statement */
 	if (check_log_statement(parsetree_list))
@@ -1102,6 +1148,8 @@ exec_simple_query(const char *query_string)
 		MemoryContext per_parsetree_context = NULL;
 		List	   *querytree_list,
 				   *plantree_list;
+		CachedPlan *cplan = NULL;
+		ParamListInfo params = NULL;
 		Portal		portal;
 		DestReceiver *receiver;
 		int16		format;
@@ -1187,11 +1235,41 @@ exec_simple_query(const char *query_string)
 		else
 			oldcontext = MemoryContextSwitchTo(MessageContext);
 
-		querytree_list = pg_analyze_and_rewrite_fixedparams(parsetree, query_string,
-															NULL, 0, NULL);
+		/*
+		 * Statements that go into the statement cache are analyzed there,
+		 * with their literals made into parameters, and planned by the plan
+		 * cache.
+		 */
+		if (scquery != NULL && scpsrc == NULL)
+			scpsrc = StmtCacheCreate(scquery, parsetree, commandTag);
+
+		if (scpsrc != NULL)
+		{
+			ListCell   *lc;
+
+			/* Report the query id as exec_bind_message() does */
+			foreach(lc, scpsrc->query_list)
+			{
+				Query	   *query = lfirst_node(Query, lc);
+
+				if (query->queryId != UINT64CONST(0))
+				{
+					pgstat_report_query_id(query->queryId, false);
+					break;
+				}
+			}
 
-		plantree_list = pg_plan_queries(querytree_list, query_string,
-										CURSOR_OPT_PARALLEL_OK, NULL);
+			cplan = StmtCacheGetPlan(scquery, &params);
+			plantree_list = cplan->stmt_list;
+		}
+		else
+		{
+			querytree_list = pg_analyze_and_rewrite_fixedparams(parsetree, query_string,
+																NULL, 0, NULL);
+
+			plantree_list = pg_plan_queries(querytree_list, query_string,
+											CURSOR_OPT_PARALLEL_OK, NULL);
+		}
 
 		/*
 		 * Done with the snapshot used for parsing/planning.
@@ -1220,19 +1298,21 @@ exec_simple_query(const char *query_string)
 		/*
 		 * We don't have to copy anything into the portal, because everything
 		 * we are passing here is in MessageContext or the
-		 * per_parsetree_context, and so will outlive the portal anyway.
+		 * per_parsetree_context, and so will outlive the portal anyway.  A
+		 * plan from the statement cache is kept by the portal's reference.
 		 */
 		PortalDefineQuery(portal,
 						  NULL,
 						  query_string,
 						  commandTag,
 						  plantree_list,
-						  NULL);
+						  cplan);
 
 		/*
-		 * Start the portal.  No parameters here.
+		 * Start the portal.  The only parameters are the literals of a
+		 * statement from the statement cache.
 		 */
-		PortalStart(portal, NULL, 0, InvalidSnapshot);
+		PortalStart(portal, params, 0, InvalidSnapshot);
 
 		/*
 		 * Select the appropriate output format: text unless we are doing a
@@ -1851,12 +1931,9 @@ exec_bind_message(StringInfo input_message)
 
 			if (pformat == 0)	/* text mode */
 			{
-				Oid			typinput;
-				Oid			typioparam;
+				BindParamIOData *io = get_bind_param_io(paramno, ptype, 0);
 				char	   *pstring;
 
-				getTypeInputInfo(ptype, &typinput, &typioparam);
-
 				/*
 				 * We have to do encoding conversion before calling the
 				 * typinput routine.
@@ -1869,7 +1946,8 @@ exec_bind_message(StringInfo input_message)
 				/* Now we can log the input string in case of error */
 				one_param_data.paramval = pstring;
 
-				pval = OidInputFunctionCall(typinput, pstring, typioparam, -1);
+				pval = InputFunctionCall(&io->iofunc, pstring,
+										 io->typioparam, -1);
 
 				one_param_data.paramval = NULL;
 
@@ -1914,21 +1992,19 @@ exec_bind_message(StringInfo input_message)
 			}
 			else if (pformat == 1)	/* binary mode */
 			{
-				Oid			typreceive;
-				Oid			typioparam;
+				BindParamIOData *io = get_bind_param_io(paramno, ptype, 1);
 				StringInfo	bufptr;
 
 				/*
 				 * Call the parameter type's binary input converter
 				 */
-				getTypeBinaryInputInfo(ptype, &typreceive, &typioparam);
-
 				if (isNull)
 					bufptr = NULL;
 				else
 					bufptr = &pbuf;
 
-				pval = OidReceiveFunctionCall(typreceive, bufptr, typioparam, -1);
+				pval = ReceiveFunctionCall(&io->iofunc, bufptr,
+										   io->typioparam, -1);
 
 				/* Trouble if it didn't eat the whole buffer */
 				if (!isNull && pbuf.cursor != pbuf.len)
@@ -2080,6 +2156,79 @@ exec_bind_message(StringInfo input_message)
 	debug_query_string = NULL;
 }
 
+/*
+ * get_bind_param_io
+ *
+ * Return the input function of the given Bind parameter position, setting
+ * it up unless the previous Bind at that position used the same type and
+ * format.
+ */
+static BindParamIOData *
+get_bind_param_io(int paramno, Oid ptype, int16 pformat)
+{
+	BindParamIOData *io;
+	Oid			func;
+
+	if (bind_param_io_context == NULL)
+	{
+		bind_param_io_context = AllocSetContextCreate(TopMemoryContext,
+													  "BindParamIOCache",
+													  ALLOCSET_SMALL_SIZES);
+		CacheRegisterSyscacheCallback(TYPEOID, invalidate_bind_param_io,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(PROCOID, invalidate_bind_param_io,
+									  (Datum) 0);
+	}
+
+	/* Flushed since last time?  The callback only sets the flag. */
+	if (!bind_param_io_valid)
+	{
+		MemoryContextReset(bind_param_io_context);
+		bind_param_io = NULL;
+		bind_param_io_size = 0;
+		bind_param_io_valid = true;
+	}
+
+	if (paramno >= bind_param_io_size)
+	{
+		int			newsize = Max(paramno + 1, Max(bind_param_io_size * 2, 8));
+
+		if (bind_param_io == NULL)
+			bind_param_io = MemoryContextAllocZero(bind_param_io_context,
+												   newsize * sizeof(BindParamIOData));
+		else
+			bind_param_io = repalloc0_array(bind_param_io, BindParamIOData,
+											bind_param_io_size, newsize);
+		bind_param_io_size = newsize;
+	}
+
+	io = &bind_param_io[paramno];
+	if (io->ptype == ptype && io->pformat == pformat && OidIsValid(ptype))
+		return io;
+
+	/* mark the entry unset, in case the lookup fails */
+	io->ptype = InvalidOid;
+	if (pformat == 0)
+		getTypeInputInfo(ptype, &func, &io->typioparam);
+	else
+		getTypeBinaryInputInfo(ptype, &func, &io->typioparam);
+	fmgr_info_cxt(func, &io->iofunc, bind_param_io_context);
+	io->ptype = ptype;
+	io->pformat = pformat;
+
+	return io;
+}
+
+/*
+ * Syscache callback for the Bind parameter I/O cache.  We may be inside a
+ * lookup, so just mark the cache for reset at the next use.
+ */
+static void
+invalidate_bind_param_io(Datum arg, int cacheid, uint32 hashvalue)
+{
+	bind_param_io_valid = false;
+}
+
 /*
  * exec_execute_message
  *
@@ -3436,6 +3585,12 @@ ProcessInterrupts(void)
 		pgstat_report_stat(true);
 	}
 
+	if (ResourceUsageTimeoutPending)
+	{
+		ResourceUsageTimeoutPending = false;
+		pgstat_report_resource_usage();
+	}
+
 	if (ProcSignalBarrierPending)
 		ProcessProcSignalBarrier();
 
@@ -3445,6 +3600,9 @@ ProcessInterrupts(void)
 	if (LogMemoryContextPending)
 		ProcessLogMemoryContextInterrupt();
 
+	if (PublishMemoryContextsPending)
+		ProcessPublishMemoryContextsInterrupt();
+
 	if (ParallelApplyMessagePending)
 		HandleParallelApplyMessages();
 }
@@ -4057,6 +4215,12 @@ PostgresSingleUserMain(int argc, char *argv[],
 	/* Initialize MaxBackends */
 	InitializeMaxBackends();
 
+	/* Initialize size of fast-path lock cache. */
+	InitializeFastPathLocks();
+
+	/* Choose the number of lock table partitions. */
+	InitializeLockPartitions();
+
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
 	 */
@@ -4233,9 +4397,11 @@ PostgresMain(const char *dbname, const char *username)
 		InitWalSender();
 
 	/*
-	 * Send this backend's cancellation info to the frontend.
+	 * Send this backend's cancellation info to the frontend, unless it's a
+	 * resumed parked session whose client has it already.
 	 */
-	if (whereToSendOutput == DestRemote)
+	if (whereToSendOutput == DestRemote &&
+		MyProcPort->parked_session == NULL)
 	{
 		StringInfoData buf;
 
@@ -4422,6 +4588,7 @@ PostgresMain(const char *dbname, const char *username)
 	{
 		int			firstchar;
 		StringInfoData input_message;
+		bool		idle_outside_xact = false;
 
 		/*
 		 * At top of loop, reset extended-query-message flag, so that any
@@ -4546,12 +4713,24 @@ PostgresMain(const char *dbname, const char *username)
 					enable_timeout_after(IDLE_SESSION_TIMEOUT,
 										 IdleSessionTimeout);
 				}
+
+				idle_outside_xact = true;
 			}
 
 			/* Report any recently-changed GUC options */
 			ReportChangedGUCOptions();
 
-			ReadyForQuery(whereToSendOutput);
+			/*
+			 * The client of a resumed parked session sent a query already,
+			 * rather than waiting for us to be ready.
+			 */
+			if (MyProcPort && MyProcPort->parked_session)
+			{
+				free(MyProcPort->parked_session);
+				MyProcPort->parked_session = NULL;
+			}
+			else
+				ReadyForQuery(whereToSendOutput);
 			send_ready_for_query = false;
 		}
 
@@ -4563,6 +4742,14 @@ PostgresMain(const char *dbname, const char *username)
 		 */
 		DoingCommandRead = true;
 
+		/*
+		 * (2b) If we're idle outside a transaction, and stay so, see if the
+		 * session can give up this backend until the client sends something;
+		 * see sessionkeeper.c.  The unnamed statement is state of our own.
+		 */
+		if (idle_outside_xact && session_parking && unnamed_stmt_psrc == NULL)
+			ParkSessionIfIdle();
+
 		/*
 		 * (3) read a command (loop blocks here)
 		 */
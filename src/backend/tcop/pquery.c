@@ -85,6 +85,7 @@ CreateQueryDesc(PlannedStmt *plannedstmt,
 	qd->params = params;		/* parameter values passed into query */
 	qd->queryEnv = queryEnv;
 	qd->instrument_options = instrument_options;	/* instrumentation wanted? */
+	qd->instrument_sample = 0;	/* time every node call */
 
 	/* null these fields until set by ExecutorStart */
 	qd->tupDesc = NULL;
@@ -0,0 +1,667 @@
+/*-------------------------------------------------------------------------
+ *
+ * stmtcache.c
+ *	  Per-backend cache of simple-Query statements by shape.
+ *
+ * Applications that don't use prepared statements tend to send the same
+ * statements again and again, differing only in their literal constants.
+ * The statement cache keeps a saved CachedPlanSource for each "shape" of
+ * statement seen, that is, its query text with the literals replaced by
+ * placeholders.  When a statement of a known shape comes along, we only
+ * need to scan it for its literals, which become the values of the Params
+ * that parse analysis substituted for the literals of the cached statement.
+ * Raw parsing, parse analysis and rewriting are skipped, and plancache.c
+ * chooses between custom and generic plans as for any prepared statement.
+ *
+ * A literal becomes a Param of the type that the parser would have given to
+ * the constant: int4, int8 or numeric for numbers, bit for bit strings, and
+ * for quoted strings whatever type the constant gets coerced to.  Literals
+ * that are identical in the cached statement share their Params, so that
+ * for instance a GROUP BY expression still matches its target list entry;
+ * a statement only matches the entry if those literals are still identical.
+ * Literals that parse analysis doesn't see as an expression, like ORDER BY
+ * column numbers and type modifiers, become part of the shape: a statement
+ * only matches if they are unchanged.
+ *
+ * Only single SELECT, INSERT, UPDATE and DELETE statements are cached.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/tcop/stmtcache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "lib/ilist.h"
+#include "parser/parse_node.h"
+#include "tcop/stmtcache.h"
+#include "tcop/tcopprot.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+
+/* GUC parameter: maximum number of cached statements, 0 disables */
+int			statement_cache_size = 0;
+
+/*
+ * Parse analysis state of a cached statement, kept in the CachedPlanSource's
+ * context.  This is the parserSetupArg for plancache.c, so it gets rebuilt
+ * whenever the statement has to be analyzed again.
+ */
+typedef struct StmtCacheParseState
+{
+	MemoryContext context;		/* context of the CachedPlanSource */
+	int			nliterals;
+	QueryLiteral *literals;		/* literals of the cached query string */
+	char	  **littext;		/* their text */
+	int		   *litclass;		/* first literal with the same text */
+	bool	   *litused;		/* was the literal replaced by a Param? */
+	int			nparams;
+	int			maxparams;
+	int		   *paramliteral;	/* literal class each Param stands for */
+	Oid		   *paramtypes;		/* type of each Param */
+	uint64		generation;		/* number of parse analyses done */
+} StmtCacheParseState;
+
+/* A cached statement */
+struct StmtCacheShape
+{
+	StmtCacheShape *next;		/* next shape with the same hash value */
+	dlist_node	lru_node;		/* most recently used is at the head */
+	uint32		hashvalue;
+	char	   *normtext;
+	CachedPlanSource *plansource;
+	StmtCacheParseState *state;
+};
+
+/* Hash table entry, the shapes whose text has the same hash value */
+typedef struct StmtCacheHashEntry
+{
+	uint32		hashvalue;		/* hash key, must be first */
+	StmtCacheShape *shapes;
+} StmtCacheHashEntry;
+
+static HTAB *stmtcache_hash = NULL;
+static dlist_head stmtcache_lru = DLIST_STATIC_INIT(stmtcache_lru);
+static int	stmtcache_count = 0;
+
+/* Type of the constant the parser makes of each kind of literal */
+static const Oid literal_types[] = {
+	INT4OID,					/* QUERY_LITERAL_INT4 */
+	INT8OID,					/* QUERY_LITERAL_INT8 */
+	NUMERICOID,					/* QUERY_LITERAL_NUMERIC */
+	UNKNOWNOID,					/* QUERY_LITERAL_STRING */
+	BITOID						/* QUERY_LITERAL_BITSTRING */
+};
+
+/* Placeholder of each kind of literal in the normalized query text */
+static const char literal_placeholders[] = "ilnsb";
+
+static void stmtcache_parser_setup(ParseState *pstate, void *arg);
+static Node *stmtcache_aconst_hook(ParseState *pstate, A_Const *aconst);
+static Node *stmtcache_coerce_param_hook(ParseState *pstate, Param *param,
+										 Oid targetTypeId, int32 targetTypeMod,
+										 int location);
+static int	stmtcache_param(StmtCacheParseState *state, int literal, Oid type);
+static bool stmtcache_matches(StmtCacheShape *shape, StmtCacheQuery *scquery);
+static void stmtcache_remove(StmtCacheShape *shape);
+static void stmtcache_trim(int size);
+
+
+/*
+ * StmtCacheScanQuery
+ *		Prepare to look up a simple-Query string in the statement cache.
+ *
+ * Returns NULL if the statement cache can't be used for the string.
+ */
+StmtCacheQuery *
+StmtCacheScanQuery(const char *query_string)
+{
+	StmtCacheQuery *scquery;
+	int			last = 0;
+
+	/* Apply any reduction of statement_cache_size */
+	stmtcache_trim(Max(statement_cache_size, 0));
+
+	/*
+	 * Literal scanning must neither raise scanner warnings of its own nor
+	 * depend on settings other than the defaults, and there's no use doing
+	 * parse analysis in an aborted transaction.
+	 */
+	if (statement_cache_size <= 0 || !standard_conforming_strings ||
+		IsAbortedTransactionBlockState())
+		return NULL;
+
+	scquery = palloc(sizeof(StmtCacheQuery));
+	scquery->query_string = query_string;
+	scquery->shape = NULL;
+	if (!scan_query_literals(query_string, &scquery->literals,
+							 &scquery->nliterals))
+	{
+		pfree(scquery->literals);
+		pfree(scquery);
+		return NULL;
+	}
+
+	initStringInfo(&scquery->normtext);
+	for (int i = 0; i < scquery->nliterals; i++)
+	{
+		QueryLiteral *lit = &scquery->literals[i];
+
+		appendBinaryStringInfo(&scquery->normtext, query_string + last,
+							   lit->location - last);
+		appendStringInfoChar(&scquery->normtext, '$');
+		appendStringInfoChar(&scquery->normtext,
+							 literal_placeholders[lit->kind]);
+		last = lit->location + lit->length;
+	}
+	appendStringInfoString(&scquery->normtext, query_string + last);
+
+	scquery->hashvalue = hash_bytes((const unsigned char *) scquery->normtext.data,
+									scquery->normtext.len);
+
+	return scquery;
+}
+
+/*
+ * StmtCacheLookup
+ *		Find the cached statement that a scanned query string matches.
+ *
+ * Returns the statement's CachedPlanSource, or NULL if there is none.
+ */
+CachedPlanSource *
+StmtCacheLookup(StmtCacheQuery *scquery)
+{
+	StmtCacheHashEntry *entry;
+	StmtCacheShape *shape;
+
+	if (stmtcache_hash == NULL)
+		return NULL;
+
+	entry = (StmtCacheHashEntry *) hash_search(stmtcache_hash,
+											   &scquery->hashvalue,
+											   HASH_FIND, NULL);
+	if (entry == NULL)
+		return NULL;
+
+	for (shape = entry->shapes; shape != NULL; shape = shape->next)
+	{
+		if (stmtcache_matches(shape, scquery))
+			break;
+	}
+	if (shape == NULL)
+		return NULL;
+
+	dlist_move_head(&stmtcache_lru, &shape->lru_node);
+	scquery->shape = shape;
+
+	return shape->plansource;
+}
+
+/*
+ * StmtCacheCreate
+ *		Add the raw parse tree of a scanned query string to the cache.
+ *
+ * This does parse analysis and rewriting of the statement, so the caller
+ * must have set a snapshot.  Returns the new CachedPlanSource, or NULL if
+ * the statement is not of a kind that we cache.
+ */
+CachedPlanSource *
+StmtCacheCreate(StmtCacheQuery *scquery, RawStmt *parsetree,
+				CommandTag commandTag)
+{
+	Node	   *stmt = parsetree->stmt;
+	CachedPlanSource *psrc;
+	StmtCacheParseState *state;
+	StmtCacheShape *shape;
+	StmtCacheHashEntry *entry;
+	MemoryContext oldcxt;
+	List	   *querytree_list;
+	bool		found;
+
+	if (IsA(stmt, SelectStmt))
+	{
+		SelectStmt *leftmost = (SelectStmt *) stmt;
+
+		/* SELECT INTO is really CREATE TABLE AS */
+		while (leftmost->op != SETOP_NONE)
+			leftmost = leftmost->larg;
+		if (leftmost->intoClause != NULL)
+			return NULL;
+	}
+	else if (!IsA(stmt, InsertStmt) && !IsA(stmt, UpdateStmt) &&
+			 !IsA(stmt, DeleteStmt))
+		return NULL;
+
+	/*
+	 * Create the CachedPlanSource before we do parse analysis, since it needs
+	 * to see the unmodified raw parse tree.
+	 */
+	psrc = CreateCachedPlan(parsetree, scquery->query_string, commandTag);
+
+	/* Set up our parse analysis state in the plan source's context */
+	oldcxt = MemoryContextSwitchTo(psrc->context);
+	state = palloc0(sizeof(StmtCacheParseState));
+	state->context = psrc->context;
+	state->nliterals = scquery->nliterals;
+	state->literals = palloc(Max(state->nliterals, 1) * sizeof(QueryLiteral));
+	state->littext = palloc(Max(state->nliterals, 1) * sizeof(char *));
+	state->litclass = palloc(Max(state->nliterals, 1) * sizeof(int));
+	state->litused = palloc0(Max(state->nliterals, 1) * sizeof(bool));
+	for (int i = 0; i < state->nliterals; i++)
+	{
+		QueryLiteral *lit = &scquery->literals[i];
+
+		state->literals[i] = *lit;
+		state->literals[i].value = pstrdup(lit->value);
+		state->littext[i] = pnstrdup(scquery->query_string + lit->location,
+									 lit->length);
+
+		state->litclass[i] = i;
+		for (int j = 0; j < i; j++)
+		{
+			if (state->literals[j].kind == lit->kind &&
+				strcmp(state->littext[j], state->littext[i]) == 0)
+			{
+				state->litclass[i] = j;
+				break;
+			}
+		}
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	querytree_list = pg_analyze_and_rewrite_withcb(parsetree,
+												   scquery->query_string,
+												   stmtcache_parser_setup,
+												   state,
+												   NULL);
+
+	CompleteCachedPlan(psrc,
+					   querytree_list,
+					   NULL,
+					   state->paramtypes,
+					   state->nparams,
+					   stmtcache_parser_setup,
+					   state,
+					   CURSOR_OPT_PARALLEL_OK,
+					   true);
+
+	shape = MemoryContextAlloc(psrc->context, sizeof(StmtCacheShape));
+	shape->hashvalue = scquery->hashvalue;
+	shape->normtext = MemoryContextStrdup(psrc->context,
+										  scquery->normtext.data);
+	shape->plansource = psrc;
+	shape->state = state;
+
+	SaveCachedPlan(psrc);
+
+	/* Now enter it into the cache */
+	if (stmtcache_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(StmtCacheHashEntry);
+		ctl.hcxt = CacheMemoryContext;
+		stmtcache_hash = hash_create("Statement cache", 256, &ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = (StmtCacheHashEntry *) hash_search(stmtcache_hash,
+											   &shape->hashvalue,
+											   HASH_ENTER, &found);
+	if (!found)
+		entry->shapes = NULL;
+	shape->next = entry->shapes;
+	entry->shapes = shape;
+	dlist_push_head(&stmtcache_lru, &shape->lru_node);
+	stmtcache_count++;
+
+	stmtcache_trim(statement_cache_size);
+
+	scquery->shape = shape;
+
+	return psrc;
+}
+
+/*
+ * StmtCacheGetPlan
+ *		Get a plan for a query string that matches a cached statement.
+ *
+ * The literals of the query string are returned as the parameters in
+ * *params.  The caller must have set a snapshot, both for parse analysis
+ * and for the types' input functions.
+ */
+CachedPlan *
+StmtCacheGetPlan(StmtCacheQuery *scquery, ParamListInfo *params)
+{
+	StmtCacheShape *shape = scquery->shape;
+	CachedPlanSource *psrc = shape->plansource;
+	StmtCacheParseState *state = shape->state;
+
+	Assert(shape != NULL);
+
+	for (;;)
+	{
+		uint64		generation;
+		CachedPlan *cplan;
+
+		/*
+		 * Redo parse analysis first if it is known to be stale, as that can
+		 * change the types of the Params.
+		 */
+		if (!CachedPlanIsValid(psrc))
+			(void) CachedPlanGetTargetList(psrc, NULL);
+		generation = state->generation;
+
+		if (state->nparams > 0)
+		{
+			*params = makeParamList(state->nparams);
+			(*params)->numParams = state->nparams;
+			for (int i = 0; i < state->nparams; i++)
+			{
+				ParamExternData *prm = &(*params)->params[i];
+				QueryLiteral *lit = &scquery->literals[state->paramliteral[i]];
+				Oid			typinput;
+				Oid			typioparam;
+
+				getTypeInputInfo(state->paramtypes[i], &typinput, &typioparam);
+				prm->value = OidInputFunctionCall(typinput, lit->value,
+												  typioparam, -1);
+				prm->isnull = false;
+				prm->pflags = PARAM_FLAG_CONST;
+				prm->ptype = state->paramtypes[i];
+			}
+		}
+		else
+			*params = NULL;
+
+		cplan = GetCachedPlan(psrc, *params, NULL, NULL);
+
+		/*
+		 * If parse analysis was redone while getting the plan, the Params
+		 * might not be the ones we filled in, so do it again.
+		 */
+		if (state->generation == generation)
+			return cplan;
+		ReleaseCachedPlan(cplan, NULL);
+	}
+}
+
+/*
+ * StmtCacheReset
+ *		Drop all cached statements.
+ */
+void
+StmtCacheReset(void)
+{
+	stmtcache_trim(0);
+}
+
+/*
+ * Parser setup hook for the parse analysis of a cached statement.
+ */
+static void
+stmtcache_parser_setup(ParseState *pstate, void *arg)
+{
+	StmtCacheParseState *state = (StmtCacheParseState *) arg;
+
+	/* Start over, in case this is a repeated parse analysis */
+	state->nparams = 0;
+	memset(state->litused, 0, Max(state->nliterals, 1) * sizeof(bool));
+	state->generation++;
+
+	pstate->p_aconst_hook = stmtcache_aconst_hook;
+	pstate->p_coerce_param_hook = stmtcache_coerce_param_hook;
+	pstate->p_ref_hook_state = (void *) state;
+}
+
+/*
+ * Replace a constant that is one of the literals by a Param.
+ */
+static Node *
+stmtcache_aconst_hook(ParseState *pstate, A_Const *aconst)
+{
+	StmtCacheParseState *state = (StmtCacheParseState *) pstate->p_ref_hook_state;
+	QueryLiteral *lit = NULL;
+	int			low = 0;
+	int			high = state->nliterals - 1;
+	int			litno;
+	bool		matches;
+	Param	   *param;
+
+	/*
+	 * Constants that the planner matches against index expressions and
+	 * predicates, as in ON CONFLICT, have to stay constants.
+	 */
+	if (aconst->isnull ||
+		pstate->p_expr_kind == EXPR_KIND_INDEX_EXPRESSION ||
+		pstate->p_expr_kind == EXPR_KIND_INDEX_PREDICATE)
+		return NULL;
+
+	/* Find the literal at the constant's location */
+	while (low <= high)
+	{
+		int			mid = (low + high) / 2;
+
+		if (state->literals[mid].location < aconst->location)
+			low = mid + 1;
+		else if (state->literals[mid].location > aconst->location)
+			high = mid - 1;
+		else
+		{
+			lit = &state->literals[mid];
+			break;
+		}
+	}
+	if (lit == NULL)
+		return NULL;
+	litno = lit - state->literals;
+
+	/*
+	 * Make sure the constant is the literal as scanned; the grammar makes
+	 * some constants of its own, and folds a minus sign into a number.
+	 */
+	switch (nodeTag(&aconst->val))
+	{
+		case T_Integer:
+			matches = (lit->kind == QUERY_LITERAL_INT4 &&
+					   atoi(lit->value) == aconst->val.ival.ival);
+			break;
+		case T_Float:
+			matches = (lit->kind != QUERY_LITERAL_STRING &&
+					   lit->kind != QUERY_LITERAL_BITSTRING &&
+					   strcmp(lit->value, aconst->val.fval.fval) == 0);
+			break;
+		case T_String:
+			matches = (lit->kind == QUERY_LITERAL_STRING &&
+					   strcmp(lit->value, aconst->val.sval.sval) == 0);
+			break;
+		case T_BitString:
+			matches = (lit->kind == QUERY_LITERAL_BITSTRING &&
+					   strcmp(lit->value, aconst->val.bsval.bsval) == 0);
+			break;
+		default:
+			matches = false;
+			break;
+	}
+	if (!matches)
+		return NULL;
+
+	state->litused[litno] = true;
+
+	param = makeNode(Param);
+	param->paramkind = PARAM_EXTERN;
+	param->paramtype = literal_types[lit->kind];
+	param->paramid = stmtcache_param(state, state->litclass[litno],
+									 param->paramtype);
+	param->paramtypmod = -1;
+	param->paramcollid = get_typcollation(param->paramtype);
+	param->location = aconst->location;
+
+	return (Node *) param;
+}
+
+/*
+ * Coerce a Param that stands for a quoted string to a query-requested type.
+ *
+ * This works like variable_coerce_param_hook(), except that a different
+ * Param is used for each type the same literal gets coerced to; any
+ * occurrence that never gets coerced keeps a Param of type unknown, just as
+ * a constant would.
+ */
+static Node *
+stmtcache_coerce_param_hook(ParseState *pstate, Param *param,
+							Oid targetTypeId, int32 targetTypeMod,
+							int location)
+{
+	if (param->paramkind == PARAM_EXTERN && param->paramtype == UNKNOWNOID)
+	{
+		StmtCacheParseState *state = (StmtCacheParseState *) pstate->p_ref_hook_state;
+		int			literal = state->paramliteral[param->paramid - 1];
+
+		param->paramid = stmtcache_param(state, literal, targetTypeId);
+		param->paramtype = targetTypeId;
+
+		/* As in variable_coerce_param_hook(), leave typmod checks to run time */
+		param->paramtypmod = -1;
+		param->paramcollid = get_typcollation(param->paramtype);
+
+		/* Use the leftmost of the param's and coercion's locations */
+		if (location >= 0 &&
+			(param->location < 0 || location < param->location))
+			param->location = location;
+
+		return (Node *) param;
+	}
+
+	/* Else signal to proceed with normal coercion */
+	return NULL;
+}
+
+/*
+ * Get the number of the Param for a literal class and type, adding one if
+ * there's none yet.
+ */
+static int
+stmtcache_param(StmtCacheParseState *state, int literal, Oid type)
+{
+	for (int i = 0; i < state->nparams; i++)
+	{
+		if (state->paramliteral[i] == literal && state->paramtypes[i] == type)
+			return i + 1;
+	}
+
+	if (state->nparams >= state->maxparams)
+	{
+		if (state->maxparams == 0)
+		{
+			state->maxparams = 8;
+			state->paramliteral = MemoryContextAlloc(state->context,
+													 state->maxparams * sizeof(int));
+			state->paramtypes = MemoryContextAlloc(state->context,
+												   state->maxparams * sizeof(Oid));
+		}
+		else
+		{
+			state->maxparams *= 2;
+			state->paramliteral = repalloc(state->paramliteral,
+										   state->maxparams * sizeof(int));
+			state->paramtypes = repalloc(state->paramtypes,
+										 state->maxparams * sizeof(Oid));
+		}
+	}
+
+	state->paramliteral[state->nparams] = literal;
+	state->paramtypes[state->nparams] = type;
+
+	return ++state->nparams;
+}
+
+/*
+ * Does a scanned query string match a cached statement?
+ */
+static bool
+stmtcache_matches(StmtCacheShape *shape, StmtCacheQuery *scquery)
+{
+	StmtCacheParseState *state = shape->state;
+
+	if (state->nliterals != scquery->nliterals ||
+		strcmp(shape->normtext, scquery->normtext.data) != 0)
+		return false;
+
+	for (int i = 0; i < state->nliterals; i++)
+	{
+		QueryLiteral *lit = &scquery->literals[i];
+		const char *text = scquery->query_string + lit->location;
+
+		/* Literals sharing a Param must still be identical */
+		if (state->litclass[i] != i)
+		{
+			QueryLiteral *first = &scquery->literals[state->litclass[i]];
+
+			if (first->length != lit->length ||
+				memcmp(scquery->query_string + first->location, text,
+					   lit->length) != 0)
+				return false;
+		}
+
+		/* Literals that are part of the statement mustn't change */
+		if (!state->litused[i] &&
+			(strlen(state->littext[i]) != lit->length ||
+			 memcmp(state->littext[i], text, lit->length) != 0))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Remove a statement from the cache and drop it.
+ */
+static void
+stmtcache_remove(StmtCacheShape *shape)
+{
+	StmtCacheHashEntry *entry;
+	StmtCacheShape **prev;
+
+	entry = (StmtCacheHashEntry *) hash_search(stmtcache_hash,
+											   &shape->hashvalue,
+											   HASH_FIND, NULL);
+	Assert(entry != NULL);
+	for (prev = &entry->shapes; *prev != shape; prev = &(*prev)->next)
+		Assert(*prev != NULL);
+	*prev = shape->next;
+	if (entry->shapes == NULL)
+		(void) hash_search(stmtcache_hash, &shape->hashvalue,
+						   HASH_REMOVE, NULL);
+
+	dlist_delete(&shape->lru_node);
+	stmtcache_count--;
+
+	/* This frees the shape itself, too */
+	DropCachedPlan(shape->plansource);
+}
+
+/*
+ * Drop the least recently used statements until at most size are left.
+ */
+static void
+stmtcache_trim(int size)
+{
+	while (stmtcache_count > size)
+	{
+		StmtCacheShape *shape;
+
+		shape = dlist_container(StmtCacheShape, lru_node,
+								dlist_tail_node(&stmtcache_lru));
+		stmtcache_remove(shape);
+	}
+}
@@ -0,0 +1,471 @@
+/* ----------
+ * backend_memory.c
+ *
+ *	Per-process memory accounting in shared memory.
+ *
+ *	Memory contexts count every block they obtain from malloc() (see
+ *	MemoryContextMallocBlock in memutils_internal.h).  Once a process has a
+ *	PGPROC, that running total is mirrored into a shared memory slot indexed
+ *	by pgprocno, so that pg_stat_backend_memory can show it for every process
+ *	without disturbing anyone.  The same slot is used to hand back a summary
+ *	of the largest memory contexts when pg_get_process_memory_contexts()
+ *	asks for one.
+ *
+ *	Processes also reserve headroom from a shared pool in chunks of
+ *	MEMORY_ACCOUNTING_CHUNK as their total grows, which is what lets
+ *	total_backend_memory_limit be enforced without touching shared state on
+ *	each block allocation.  backend_memory_limit is enforced locally.  Only
+ *	regular backends and background workers ever have an allocation refused;
+ *	other processes, critical sections and ErrorContext are exempt.  A refused
+ *	allocation surfaces as the usual "out of memory" error.
+ *
+ *	Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ *	src/backend/utils/activity/backend_memory.c
+ * ----------
+ */
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/condition_variable.h"
+#include "storage/ipc.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/backend_memory.h"
+#include "utils/guc_hooks.h"
+#include "utils/memutils_internal.h"
+#include "utils/timestamp.h"
+#include "utils/wait_event.h"
+
+/* How long pg_get_process_memory_contexts() waits for the target, in ms */
+#define BACKEND_MEMORY_PUBLISH_TIMEOUT	5000
+
+/* Shared state of one process */
+typedef struct BackendMemorySlot
+{
+	pg_atomic_uint64 allocated_bytes;	/* memory obtained from malloc() */
+
+	slock_t		mutex;			/* protects the fields below */
+	int			pid;			/* owning process, or 0 if unused */
+	uint32		requested;		/* number of publish requests made */
+	uint32		published;		/* last request that has been answered */
+	int			ncontexts;		/* valid entries in contexts[] */
+	BackendMemoryContextEntry contexts[BACKEND_MEMORY_TOP_CONTEXTS];
+
+	ConditionVariable cv;		/* signaled when published advances */
+} BackendMemorySlot;
+
+typedef struct BackendMemoryShared
+{
+	pg_atomic_uint64 total_reserved;	/* sum of all processes' reservations */
+	int			nslots;
+	BackendMemorySlot slots[FLEXIBLE_ARRAY_MEMBER];
+} BackendMemoryShared;
+
+/* GUC variables, in megabytes */
+int			backend_memory_limit = 0;
+int			total_backend_memory_limit = 0;
+
+static BackendMemoryShared *BackendMemory = NULL;
+static BackendMemorySlot *MyBackendMemorySlot = NULL;
+
+/* backend_memory_limit in bytes, or PG_UINT64_MAX if disabled */
+static uint64 backend_memory_limit_bytes = PG_UINT64_MAX;
+
+static void BackendMemoryDetach(int code, Datum arg);
+static void BackendMemoryComputeAllowance(void);
+
+
+static int
+BackendMemorySlotCount(void)
+{
+	return MaxBackends + NUM_AUXILIARY_PROCS;
+}
+
+/*
+ * Report shared memory space needed by BackendMemoryShmemInit.
+ */
+Size
+BackendMemoryShmemSize(void)
+{
+	return add_size(offsetof(BackendMemoryShared, slots),
+					mul_size(BackendMemorySlotCount(),
+							 sizeof(BackendMemorySlot)));
+}
+
+/*
+ * Initialize the shared memory slots during postmaster startup.
+ */
+void
+BackendMemoryShmemInit(void)
+{
+	bool		found;
+
+	BackendMemory = (BackendMemoryShared *)
+		ShmemInitStruct("Backend Memory Status", BackendMemoryShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		int			i;
+
+		pg_atomic_init_u64(&BackendMemory->total_reserved, 0);
+		BackendMemory->nslots = BackendMemorySlotCount();
+		for (i = 0; i < BackendMemory->nslots; i++)
+		{
+			BackendMemorySlot *slot = &BackendMemory->slots[i];
+
+			pg_atomic_init_u64(&slot->allocated_bytes, 0);
+			SpinLockInit(&slot->mutex);
+			slot->pid = 0;
+			slot->requested = 0;
+			slot->published = 0;
+			slot->ncontexts = 0;
+			ConditionVariableInit(&slot->cv);
+		}
+	}
+}
+
+/*
+ * Does this process have allocations refused when over a limit?
+ */
+static inline bool
+BackendMemoryLimitsApply(MemoryContext context)
+{
+	if (context == NULL || context == ErrorContext)
+		return false;
+	if (CritSectionCount > 0 || proc_exit_inprogress)
+		return false;
+	return MyBackendType == B_BACKEND || MyBackendType == B_BG_WORKER;
+}
+
+/*
+ * Recompute MemoryAllocatedAllowance, the total this process can reach
+ * before MemoryAccountingReserveSlow has to be consulted.
+ */
+static void
+BackendMemoryComputeAllowance(void)
+{
+	uint64		allowance = backend_memory_limit_bytes;
+
+	if (MemoryAllocatedReport != NULL)
+		allowance = Min(allowance, MemoryAllocatedReserved);
+	MemoryAllocatedAllowance = allowance;
+}
+
+/*
+ * Attach this process to its slot.  Called from pgstat_beinit, once MyProc
+ * is set up.
+ */
+void
+BackendMemoryAttach(void)
+{
+	BackendMemorySlot *slot;
+	uint64		reserve;
+
+	Assert(MyProc != NULL);
+	Assert(MyProc->pgprocno < BackendMemory->nslots);
+
+	slot = &BackendMemory->slots[MyProc->pgprocno];
+
+	SpinLockAcquire(&slot->mutex);
+	slot->pid = MyProcPid;
+	/* forget about requests made to a previous owner of the slot */
+	slot->published = slot->requested;
+	slot->ncontexts = 0;
+	SpinLockRelease(&slot->mutex);
+
+	/*
+	 * Reserve shared headroom for what we already have.  This is never
+	 * refused; the limits are enforced from here on.
+	 */
+	reserve = TYPEALIGN64(MEMORY_ACCOUNTING_CHUNK, MemoryAllocatedBytes);
+	pg_atomic_fetch_add_u64(&BackendMemory->total_reserved, reserve);
+	MemoryAllocatedReserved = reserve;
+
+	pg_atomic_write_u64(&slot->allocated_bytes, MemoryAllocatedBytes);
+	MemoryAllocatedReport = &slot->allocated_bytes;
+	MyBackendMemorySlot = slot;
+
+	BackendMemoryComputeAllowance();
+
+	on_shmem_exit(BackendMemoryDetach, 0);
+}
+
+/*
+ * Give back our reservation and clear our slot at process exit.
+ */
+static void
+BackendMemoryDetach(int code, Datum arg)
+{
+	BackendMemorySlot *slot = MyBackendMemorySlot;
+
+	MemoryAllocatedReport = NULL;
+	MyBackendMemorySlot = NULL;
+
+	pg_atomic_fetch_sub_u64(&BackendMemory->total_reserved,
+							MemoryAllocatedReserved);
+	MemoryAllocatedReserved = 0;
+	BackendMemoryComputeAllowance();
+
+	pg_atomic_write_u64(&slot->allocated_bytes, 0);
+	SpinLockAcquire(&slot->mutex);
+	slot->pid = 0;
+	SpinLockRelease(&slot->mutex);
+
+	/* wake anyone waiting for us to publish; they'll find us gone */
+	ConditionVariableBroadcast(&slot->cv);
+}
+
+/*
+ * MemoryAccountingReserveSlow
+ *		Account for 'size' more bytes when that takes us past the allowance.
+ *
+ * Returns false, without accounting anything, if the allocation has to be
+ * refused.
+ */
+bool
+MemoryAccountingReserveSlow(MemoryContext context, Size size)
+{
+	uint64		newtotal = MemoryAllocatedBytes + size;
+	bool		limited = BackendMemoryLimitsApply(context);
+
+	if (newtotal > backend_memory_limit_bytes && limited)
+		return false;
+
+	if (MemoryAllocatedReport != NULL && newtotal > MemoryAllocatedReserved)
+	{
+		uint64		want;
+		uint64		total;
+
+		want = TYPEALIGN64(MEMORY_ACCOUNTING_CHUNK, newtotal) -
+			MemoryAllocatedReserved;
+		total = pg_atomic_add_fetch_u64(&BackendMemory->total_reserved, want);
+		if (total_backend_memory_limit > 0 && limited &&
+			total > (uint64) total_backend_memory_limit * 1024 * 1024)
+		{
+			pg_atomic_fetch_sub_u64(&BackendMemory->total_reserved, want);
+			return false;
+		}
+		MemoryAllocatedReserved += want;
+	}
+
+	MemoryAllocatedBytes = newtotal;
+	if (MemoryAllocatedReport != NULL)
+		pg_atomic_write_u64(MemoryAllocatedReport, MemoryAllocatedBytes);
+	BackendMemoryComputeAllowance();
+
+	return true;
+}
+
+/*
+ * MemoryAccountingReleaseSlow
+ *		Return shared headroom we no longer need.
+ */
+void
+MemoryAccountingReleaseSlow(void)
+{
+	uint64		keep = TYPEALIGN64(MEMORY_ACCOUNTING_CHUNK, MemoryAllocatedBytes);
+
+	Assert(MemoryAllocatedReserved > keep);
+	pg_atomic_fetch_sub_u64(&BackendMemory->total_reserved,
+							MemoryAllocatedReserved - keep);
+	MemoryAllocatedReserved = keep;
+	BackendMemoryComputeAllowance();
+}
+
+/*
+ * GUC assign hook for backend_memory_limit
+ */
+void
+assign_backend_memory_limit(int newval, void *extra)
+{
+	if (newval > 0)
+		backend_memory_limit_bytes = (uint64) newval * 1024 * 1024;
+	else
+		backend_memory_limit_bytes = PG_UINT64_MAX;
+	BackendMemoryComputeAllowance();
+}
+
+/*
+ * Accessors for pg_stat_backend_memory.
+ */
+int
+BackendMemoryNumSlots(void)
+{
+	return BackendMemory->nslots;
+}
+
+bool
+BackendMemoryGetSlot(int slotno, int *pid, uint64 *allocated_bytes)
+{
+	BackendMemorySlot *slot = &BackendMemory->slots[slotno];
+
+	SpinLockAcquire(&slot->mutex);
+	*pid = slot->pid;
+	SpinLockRelease(&slot->mutex);
+
+	if (*pid == 0)
+		return false;
+	*allocated_bytes = pg_atomic_read_u64(&slot->allocated_bytes);
+	return true;
+}
+
+uint64
+BackendMemoryTotalReserved(void)
+{
+	return pg_atomic_read_u64(&BackendMemory->total_reserved);
+}
+
+/*
+ * BackendMemoryRequestContexts
+ *		Ask 'proc' to publish its largest memory contexts, and wait for it.
+ *
+ * Copies up to BACKEND_MEMORY_TOP_CONTEXTS entries into 'entries' and
+ * returns how many; returns -1 if the process went away or didn't answer in
+ * time.
+ */
+int
+BackendMemoryRequestContexts(PGPROC *proc, BackendId backendId,
+							 BackendMemoryContextEntry *entries)
+{
+	BackendMemorySlot *slot = &BackendMemory->slots[proc->pgprocno];
+	int			pid = proc->pid;
+	uint32		request;
+	TimestampTz start = GetCurrentTimestamp();
+	int			result = -1;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->pid != pid)
+	{
+		SpinLockRelease(&slot->mutex);
+		return -1;
+	}
+	request = ++slot->requested;
+	SpinLockRelease(&slot->mutex);
+
+	if (SendProcSignal(pid, PROCSIG_PUBLISH_MEMORY_CONTEXTS, backendId) < 0)
+		return -1;
+
+	ConditionVariablePrepareToSleep(&slot->cv);
+	for (;;)
+	{
+		bool		done = false;
+
+		SpinLockAcquire(&slot->mutex);
+		if (slot->pid != pid)
+			done = true;
+		else if ((int32) (slot->published - request) >= 0)
+		{
+			result = slot->ncontexts;
+			memcpy(entries, slot->contexts,
+				   sizeof(BackendMemoryContextEntry) * result);
+			done = true;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		if (done ||
+			TimestampDifferenceExceeds(start, GetCurrentTimestamp(),
+									   BACKEND_MEMORY_PUBLISH_TIMEOUT))
+			break;
+
+		ConditionVariableTimedSleep(&slot->cv, 100,
+									WAIT_EVENT_MEMORY_CONTEXT_PUBLISH);
+	}
+	ConditionVariableCancelSleep();
+
+	return result;
+}
+
+/*
+ * HandlePublishMemoryContextsInterrupt
+ *		Handle receipt of a request to publish our memory contexts.
+ *
+ * The work is deferred to ProcessPublishMemoryContextsInterrupt().
+ */
+void
+HandlePublishMemoryContextsInterrupt(void)
+{
+	InterruptPending = true;
+	PublishMemoryContextsPending = true;
+	/* latch will be set by procsignal_sigusr1_handler */
+}
+
+/*
+ * Recursively collect the largest contexts under 'context' into 'top',
+ * which is kept sorted by total_bytes, largest first.
+ */
+static void
+BackendMemoryCollect(MemoryContext context, int level,
+					 BackendMemoryContextEntry *top, int *ntop)
+{
+	MemoryContextCounters stat;
+	MemoryContext child;
+	int			pos;
+
+	memset(&stat, 0, sizeof(stat));
+	context->methods->stats(context, NULL, NULL, &stat, false);
+
+	for (pos = *ntop; pos > 0; pos--)
+	{
+		if (top[pos - 1].total_bytes >= (int64) stat.totalspace)
+			break;
+	}
+
+	if (pos < BACKEND_MEMORY_TOP_CONTEXTS)
+	{
+		BackendMemoryContextEntry *entry;
+		int			nmove = Min(*ntop, BACKEND_MEMORY_TOP_CONTEXTS - 1) - pos;
+
+		if (nmove > 0)
+			memmove(&top[pos + 1], &top[pos],
+					sizeof(BackendMemoryContextEntry) * nmove);
+		if (*ntop < BACKEND_MEMORY_TOP_CONTEXTS)
+			(*ntop)++;
+
+		entry = &top[pos];
+		strlcpy(entry->name, context->name, NAMEDATALEN);
+		if (context->ident)
+			strlcpy(entry->ident, context->ident, NAMEDATALEN);
+		else
+			entry->ident[0] = '\0';
+		entry->level = level;
+		entry->total_bytes = stat.totalspace;
+		entry->free_bytes = stat.freespace;
+	}
+
+	for (child = context->firstchild; child != NULL; child = child->nextchild)
+		BackendMemoryCollect(child, level + 1, top, ntop);
+}
+
+/*
+ * ProcessPublishMemoryContextsInterrupt
+ *		Publish our largest memory contexts into our slot.
+ *
+ * Any process that participates in ProcSignal signaling must arrange to
+ * call this when it sees PublishMemoryContextsPending set.
+ */
+void
+ProcessPublishMemoryContextsInterrupt(void)
+{
+	BackendMemoryContextEntry top[BACKEND_MEMORY_TOP_CONTEXTS];
+	BackendMemorySlot *slot = MyBackendMemorySlot;
+	int			ntop = 0;
+
+	PublishMemoryContextsPending = false;
+
+	if (slot == NULL)
+		return;
+
+	BackendMemoryCollect(TopMemoryContext, 0, top, &ntop);
+
+	SpinLockAcquire(&slot->mutex);
+	memcpy(slot->contexts, top, sizeof(BackendMemoryContextEntry) * ntop);
+	slot->ncontexts = ntop;
+	slot->published = slot->requested;
+	SpinLockRelease(&slot->mutex);
+
+	ConditionVariableBroadcast(&slot->cv);
+}
@@ -0,0 +1,374 @@
+/* ----------
+ * backend_profile.c
+ *
+ *	Continuous sampling of what busy backends are executing.
+ *
+ *	While profile_sample_interval is set, each backend that is running a
+ *	query records, every that many milliseconds, a sample of its query id,
+ *	the plan node it is executing and the wait event it is waiting on, if
+ *	any, into a ring of samples shared by all backends.  Counting the samples
+ *	of a query id and plan node over some period gives a statistical profile
+ *	of where time goes, on CPU or waiting, without having to run
+ *	EXPLAIN ANALYZE.
+ *
+ *	The samples are taken in the timeout signal handler, not at the next
+ *	CHECK_FOR_INTERRUPTS(), since code that goes a long time without
+ *	checking for interrupts is exactly what a profile is for.  So taking a
+ *	sample only reads integers the backend maintains anyway, and writes
+ *	them into a slot claimed with an atomic increment.  Each slot carries
+ *	the sequence number it was claimed with, stored last, which lets readers
+ *	skip slots that are being overwritten.
+ *
+ *	Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ *	IDENTIFICATION
+ *	  src/backend/utils/activity/backend_profile.c
+ * ----------
+ */
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/nodes.h"
+#include "port/atomics.h"
+#include "storage/shmem.h"
+#include "utils/backend_profile.h"
+#include "utils/backend_status.h"
+#include "utils/builtins.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+#include "utils/wait_event.h"
+
+
+typedef struct ProfileSample
+{
+	uint32		seq;			/* claim number + 1, 0 while being written */
+	int			pid;
+	BackendType backend_type;
+	int			plan_node_id;	/* -1 if not executing a plan node */
+	int			node_tag;		/* NodeTag of the PlanState, or T_Invalid */
+	uint32		wait_event_info;
+	uint64		query_id;
+	TimestampTz sample_time;
+} ProfileSample;
+
+typedef struct ProfileRing
+{
+	pg_atomic_uint32 next;		/* number of slots claimed so far */
+	ProfileSample samples[PROFILE_NUM_SAMPLES];
+} ProfileRing;
+
+
+/* GUC parameter */
+int			profile_sample_interval = 0;
+
+volatile int ProfilePlanNodeId = -1;
+volatile int ProfileNodeTag = T_Invalid;
+
+static ProfileRing *ProfileSamples = NULL;
+
+/* has PROFILE_SAMPLE_TIMEOUT been registered? */
+static bool profile_sampling = false;
+
+/* interval the timeout was last armed with */
+static int	profile_armed_interval = 0;
+
+
+/* Report shared-memory space needed by BackendProfileShmemInit */
+Size
+BackendProfileShmemSize(void)
+{
+	return sizeof(ProfileRing);
+}
+
+/* Allocate and initialize the shared ring of samples */
+void
+BackendProfileShmemInit(void)
+{
+	bool		found;
+
+	ProfileSamples = (ProfileRing *)
+		ShmemInitStruct("Backend Profile Samples", BackendProfileShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		MemSet(ProfileSamples, 0, BackendProfileShmemSize());
+		pg_atomic_init_u32(&ProfileSamples->next, 0);
+	}
+}
+
+/* ----------
+ * pgstat_enable_profile_sampling() -
+ *
+ * Called once the PROFILE_SAMPLE_TIMEOUT handler is registered.
+ * ----------
+ */
+void
+pgstat_enable_profile_sampling(void)
+{
+	profile_sampling = true;
+}
+
+/* ----------
+ * pgstat_profile_report_state() -
+ *
+ * Called from pgstat_report_activity(), to sample only while the backend is
+ * running something.  The timeout is (re-)armed when the backend starts
+ * running with profile_sample_interval set, or the interval changed; a
+ * change of profile_sample_interval thus takes effect at the next statement.
+ * ----------
+ */
+void
+pgstat_profile_report_state(bool running)
+{
+	if (!profile_sampling)
+		return;
+
+	if (running && profile_sample_interval > 0)
+	{
+		if (profile_armed_interval != profile_sample_interval ||
+			!get_timeout_active(PROFILE_SAMPLE_TIMEOUT))
+		{
+			TimestampTz fin_time;
+
+			fin_time = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+												   profile_sample_interval);
+			enable_timeout_every(PROFILE_SAMPLE_TIMEOUT, fin_time,
+								 profile_sample_interval);
+			profile_armed_interval = profile_sample_interval;
+		}
+	}
+	else
+	{
+		if (profile_armed_interval != 0)
+		{
+			disable_timeout(PROFILE_SAMPLE_TIMEOUT, false);
+			profile_armed_interval = 0;
+		}
+
+		/* forget the node left behind by an error, if any */
+		ProfilePlanNodeId = -1;
+		ProfileNodeTag = T_Invalid;
+	}
+}
+
+/* ----------
+ * ProfileSampleTimeoutHandler() -
+ *
+ * Handler of PROFILE_SAMPLE_TIMEOUT, which records a sample.  This runs in
+ * the signal handler, see the notes at the top of the file.
+ * ----------
+ */
+void
+ProfileSampleTimeoutHandler(void)
+{
+	volatile PgBackendStatus *beentry = MyBEEntry;
+	volatile ProfileSample *sample;
+	uint32		n;
+
+	if (ProfileSamples == NULL || beentry == NULL ||
+		profile_sample_interval <= 0)
+		return;
+
+	n = pg_atomic_fetch_add_u32(&ProfileSamples->next, 1);
+	sample = &ProfileSamples->samples[n % PROFILE_NUM_SAMPLES];
+
+	sample->seq = 0;
+	pg_write_barrier();
+
+	sample->pid = MyProcPid;
+	sample->backend_type = MyBackendType;
+	sample->plan_node_id = ProfilePlanNodeId;
+	sample->node_tag = ProfileNodeTag;
+	sample->wait_event_info = *(volatile uint32 *) my_wait_event_info;
+	sample->query_id = beentry->st_query_id;
+	sample->sample_time = GetCurrentTimestamp();
+
+	pg_write_barrier();
+	sample->seq = n + 1;
+}
+
+/*
+ * Name of a plan node type, as shown by EXPLAIN, from the NodeTag of its
+ * PlanState.
+ */
+static const char *
+profile_node_type_name(int tag)
+{
+	switch ((NodeTag) tag)
+	{
+		case T_ResultState:
+			return "Result";
+		case T_ProjectSetState:
+			return "ProjectSet";
+		case T_ModifyTableState:
+			return "ModifyTable";
+		case T_AppendState:
+			return "Append";
+		case T_MergeAppendState:
+			return "Merge Append";
+		case T_RecursiveUnionState:
+			return "Recursive Union";
+		case T_BitmapAndState:
+			return "BitmapAnd";
+		case T_BitmapOrState:
+			return "BitmapOr";
+		case T_SeqScanState:
+			return "Seq Scan";
+		case T_SampleScanState:
+			return "Sample Scan";
+		case T_GatherState:
+			return "Gather";
+		case T_GatherMergeState:
+			return "Gather Merge";
+		case T_IndexScanState:
+			return "Index Scan";
+		case T_IndexOnlyScanState:
+			return "Index Only Scan";
+		case T_BitmapIndexScanState:
+			return "Bitmap Index Scan";
+		case T_BitmapHeapScanState:
+			return "Bitmap Heap Scan";
+		case T_TidScanState:
+			return "Tid Scan";
+		case T_TidRangeScanState:
+			return "Tid Range Scan";
+		case T_SubqueryScanState:
+			return "Subquery Scan";
+		case T_FunctionScanState:
+			return "Function Scan";
+		case T_TableFuncScanState:
+			return "Table Function Scan";
+		case T_ValuesScanState:
+			return "Values Scan";
+		case T_CteScanState:
+			return "CTE Scan";
+		case T_NamedTuplestoreScanState:
+			return "Named Tuplestore Scan";
+		case T_WorkTableScanState:
+			return "WorkTable Scan";
+		case T_ForeignScanState:
+			return "Foreign Scan";
+		case T_CustomScanState:
+			return "Custom Scan";
+		case T_NestLoopState:
+			return "Nested Loop";
+		case T_MergeJoinState:
+			return "Merge Join";
+		case T_HashJoinState:
+			return "Hash Join";
+		case T_MaterialState:
+			return "Materialize";
+		case T_MemoizeState:
+			return "Memoize";
+		case T_SortState:
+			return "Sort";
+		case T_IncrementalSortState:
+			return "Incremental Sort";
+		case T_GroupState:
+			return "Group";
+		case T_AggState:
+			return "Aggregate";
+		case T_WindowAggState:
+			return "WindowAgg";
+		case T_UniqueState:
+			return "Unique";
+		case T_SetOpState:
+			return "SetOp";
+		case T_LockRowsState:
+			return "LockRows";
+		case T_LimitState:
+			return "Limit";
+		case T_HashState:
+			return "Hash";
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * SQL function returning the samples in the ring, oldest first.
+ */
+Datum
+pg_stat_get_profile_samples(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PROFILE_SAMPLES_COLS	8
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	uint32		next;
+	uint32		nsamples;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	next = pg_atomic_read_u32(&ProfileSamples->next);
+	nsamples = Min(next, PROFILE_NUM_SAMPLES);
+
+	for (uint32 n = next - nsamples; n != next; n++)
+	{
+		volatile ProfileSample *slot;
+		ProfileSample sample;
+		Datum		values[PG_STAT_GET_PROFILE_SAMPLES_COLS] = {0};
+		bool		nulls[PG_STAT_GET_PROFILE_SAMPLES_COLS] = {0};
+		const char *node_type;
+		uint32		seq;
+
+		slot = &ProfileSamples->samples[n % PROFILE_NUM_SAMPLES];
+
+		/* skip slots being written, or overwritten since we started */
+		seq = slot->seq;
+		if (seq != n + 1)
+			continue;
+		pg_read_barrier();
+		memcpy(&sample, unvolatize(ProfileSample *, slot), sizeof(sample));
+		pg_read_barrier();
+		if (slot->seq != seq)
+			continue;
+
+		values[0] = TimestampTzGetDatum(sample.sample_time);
+		values[1] = Int32GetDatum(sample.pid);
+		values[2] = CStringGetTextDatum(GetBackendTypeDesc(sample.backend_type));
+		if (sample.query_id != 0)
+			values[3] = Int64GetDatum((int64) sample.query_id);
+		else
+			nulls[3] = true;
+
+		node_type = profile_node_type_name(sample.node_tag);
+		if (sample.plan_node_id >= 0 && node_type != NULL)
+		{
+			values[4] = Int32GetDatum(sample.plan_node_id);
+			values[5] = CStringGetTextDatum(node_type);
+		}
+		else
+		{
+			nulls[4] = true;
+			nulls[5] = true;
+		}
+
+		if (sample.wait_event_info != 0)
+		{
+			const char *wait_event_type;
+			const char *wait_event;
+
+			wait_event_type = pgstat_get_wait_event_type(sample.wait_event_info);
+			wait_event = pgstat_get_wait_event(sample.wait_event_info);
+			if (wait_event_type)
+				values[6] = CStringGetTextDatum(wait_event_type);
+			else
+				nulls[6] = true;
+			if (wait_event)
+				values[7] = CStringGetTextDatum(wait_event);
+			else
+				nulls[7] = true;
+		}
+		else
+		{
+			nulls[6] = true;
+			nulls[7] = true;
+		}
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
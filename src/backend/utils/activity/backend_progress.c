@@ -131,3 +131,26 @@ pgstat_progress_end_command(void)
 	beentry->st_progress_command_target = InvalidOid;
 	PGSTAT_END_WRITE_ACTIVITY(beentry);
 }
+
+/*-----------
+ * pgstat_progress_report_temp_files() -
+ *
+ * Update the slot'th temporary file usage entry of own backend entry.  This
+ * is reported while track_activities is on, whatever the command.
+ *-----------
+ */
+void
+pgstat_progress_report_temp_files(int slot, const PgBackendTempFileNode *node)
+{
+	volatile PgBackendStatus *beentry = MyBEEntry;
+
+	Assert(slot >= 0 && slot < PGSTAT_NUM_TEMP_FILE_NODES);
+
+	if (!beentry || !pgstat_track_activities)
+		return;
+
+	PGSTAT_BEGIN_WRITE_ACTIVITY(beentry);
+	memcpy(unvolatize(PgBackendTempFileNode *, &beentry->st_temp_file_nodes[slot]),
+		   node, sizeof(PgBackendTempFileNode));
+	PGSTAT_END_WRITE_ACTIVITY(beentry);
+}
@@ -11,6 +11,8 @@
  */
 #include "postgres.h"
 
+#include <sys/resource.h>
+
 #include "access/xact.h"
 #include "libpq/libpq.h"
 #include "miscadmin.h"
@@ -21,9 +23,13 @@
 #include "storage/proc.h"		/* for MyProc */
 #include "storage/sinvaladt.h"
 #include "utils/ascii.h"
+#include "utils/backend_memory.h"
+#include "utils/backend_profile.h"
 #include "utils/backend_status.h"
 #include "utils/guc.h"			/* for application_name */
 #include "utils/memutils.h"
+#include "utils/memutils_internal.h"	/* for MemoryAllocatedBytes */
+#include "utils/timeout.h"
 
 
 /* ----------
@@ -44,6 +50,7 @@
  */
 bool		pgstat_track_activities = false;
 int			pgstat_track_activity_query_size = 1024;
+int			pgstat_track_resource_usage_interval = 1000;
 
 
 /* exposed so that backend_progress.c can access it */
@@ -71,6 +78,10 @@ static int	localNumBackends = 0;
 
 static MemoryContext backendStatusSnapContext;
 
+/* resource usage sampling, see pgstat_report_resource_usage() */
+static bool resource_usage_sampling = false;
+static bool resource_usage_active = true;
+
 
 static void pgstat_beshutdown_hook(int code, Datum arg);
 static void pgstat_read_current_status(void);
@@ -272,6 +283,9 @@ pgstat_beinit(void)
 
 	/* Set up a process-exit hook to clean up */
 	on_shmem_exit(pgstat_beshutdown_hook, 0);
+
+	/* Start publishing our memory usage too */
+	BackendMemoryAttach();
 }
 
 
@@ -400,6 +414,10 @@ pgstat_bestart(void)
 	lbeentry.st_progress_command = PROGRESS_COMMAND_INVALID;
 	lbeentry.st_progress_command_target = InvalidOid;
 	lbeentry.st_query_id = UINT64CONST(0);
+	memset(&lbeentry.st_resource_usage, 0, sizeof(lbeentry.st_resource_usage));
+	memset(&lbeentry.st_temp_file_nodes, 0, sizeof(lbeentry.st_temp_file_nodes));
+	for (int i = 0; i < PGSTAT_NUM_TEMP_FILE_NODES; i++)
+		lbeentry.st_temp_file_nodes[i].plan_node_id = -1;
 
 	/*
 	 * we don't zero st_progress_param here to save cycles; nobody should
@@ -531,6 +549,18 @@ pgstat_report_activity(BackendState state, const char *cmd_str)
 	if (!beentry)
 		return;
 
+	/*
+	 * Resource usage is sampled only while there's something to sample; an
+	 * idle session gets one last sample after it goes idle.
+	 */
+	resource_usage_active = (state == STATE_RUNNING || state == STATE_FASTPATH);
+	if (resource_usage_active && resource_usage_sampling &&
+		pgstat_track_resource_usage_interval > 0 &&
+		!get_timeout_active(RESOURCE_USAGE_TIMEOUT))
+		enable_timeout_after(RESOURCE_USAGE_TIMEOUT,
+							 pgstat_track_resource_usage_interval);
+	pgstat_profile_report_state(resource_usage_active);
+
 	if (!pgstat_track_activities)
 	{
 		if (beentry->st_state != STATE_DISABLED)
@@ -1057,6 +1087,81 @@ pgstat_get_my_query_id(void)
 	return MyBEEntry->st_query_id;
 }
 
+/* ----------
+ * pgstat_get_resource_usage() -
+ *
+ * Get the resources used by this process so far.
+ * ----------
+ */
+void
+pgstat_get_resource_usage(PgBackendResourceUsage *usage)
+{
+	struct rusage r;
+
+	getrusage(RUSAGE_SELF, &r);
+	usage->cpu_user_time = (int64) r.ru_utime.tv_sec * 1000000 +
+		r.ru_utime.tv_usec;
+	usage->cpu_system_time = (int64) r.ru_stime.tv_sec * 1000000 +
+		r.ru_stime.tv_usec;
+	usage->memory_allocated = (int64) MemoryAllocatedBytes;
+	usage->read_bytes = pgStatIOReadBytes;
+	usage->write_bytes = pgStatIOWriteBytes;
+}
+
+/* ----------
+ * pgstat_enable_resource_usage_sampling() -
+ *
+ * Called once the RESOURCE_USAGE_TIMEOUT handler is registered, to start
+ * sampling this process's resource usage.
+ * ----------
+ */
+void
+pgstat_enable_resource_usage_sampling(void)
+{
+	resource_usage_sampling = true;
+
+	if (pgstat_track_resource_usage_interval > 0)
+		enable_timeout_after(RESOURCE_USAGE_TIMEOUT,
+							 pgstat_track_resource_usage_interval);
+}
+
+/* ----------
+ * pgstat_report_resource_usage() -
+ *
+ * Called from ProcessInterrupts() when RESOURCE_USAGE_TIMEOUT has fired, to
+ * record our resource usage in our status entry.
+ *
+ * The timeout is re-armed as long as the backend is busy.  Sampling on a
+ * timer rather than around each query keeps the cost, a getrusage() call
+ * every track_resource_usage_interval, independent of the query rate.
+ * ----------
+ */
+void
+pgstat_report_resource_usage(void)
+{
+	volatile PgBackendStatus *beentry = MyBEEntry;
+	PgBackendResourceUsage usage;
+
+	if (resource_usage_active && pgstat_track_resource_usage_interval > 0)
+		enable_timeout_after(RESOURCE_USAGE_TIMEOUT,
+							 pgstat_track_resource_usage_interval);
+
+	if (!beentry)
+		return;
+
+	pgstat_get_resource_usage(&usage);
+
+	/*
+	 * Update my status entry, following the protocol of bumping
+	 * st_changecount before and after.  We use a volatile pointer here to
+	 * ensure the compiler doesn't try to get cute.
+	 */
+	PGSTAT_BEGIN_WRITE_ACTIVITY(beentry);
+	memcpy(unvolatize(PgBackendResourceUsage *, &beentry->st_resource_usage),
+		   &usage, sizeof(usage));
+	PGSTAT_END_WRITE_ACTIVITY(beentry);
+}
+
 /* ----------
  * cmp_lbestatus
  *
@@ -77,6 +77,7 @@
  * - pgstat_replslot.c
  * - pgstat_slru.c
  * - pgstat_subscription.c
+ * - pgstat_wait.c
  * - pgstat_wal.c
  *
  * Whenever possible infrastructure files should not contain code related to
@@ -337,6 +338,60 @@ static const PgStat_KindInfo pgstat_kind_infos[PGSTAT_NUM_KINDS] = {
 		.reset_timestamp_cb = pgstat_subscription_reset_timestamp_cb,
 	},
 
+	[PGSTAT_KIND_WALRELATION] = {
+		.name = "walrelation",
+
+		.fixed_amount = false,
+
+		.shared_size = sizeof(PgStatShared_WalRelation),
+		.shared_data_off = offsetof(PgStatShared_WalRelation, stats),
+		.shared_data_len = sizeof(((PgStatShared_WalRelation *) 0)->stats),
+
+		.reset_timestamp_cb = pgstat_wal_relation_reset_timestamp_cb,
+	},
+
+	[PGSTAT_KIND_PLANNING] = {
+		.name = "planning",
+
+		.fixed_amount = false,
+
+		.shared_size = sizeof(PgStatShared_Planning),
+		.shared_data_off = offsetof(PgStatShared_Planning, stats),
+		.shared_data_len = sizeof(((PgStatShared_Planning *) 0)->stats),
+		.pending_size = sizeof(PgStat_PlanningCounts),
+
+		.flush_pending_cb = pgstat_planning_flush_cb,
+		.reset_timestamp_cb = pgstat_planning_reset_timestamp_cb,
+	},
+
+	[PGSTAT_KIND_QUERY] = {
+		.name = "query",
+
+		.fixed_amount = false,
+
+		.shared_size = sizeof(PgStatShared_Query),
+		.shared_data_off = offsetof(PgStatShared_Query, stats),
+		.shared_data_len = sizeof(((PgStatShared_Query *) 0)->stats),
+		.pending_size = sizeof(PgStat_QueryCounts),
+
+		.flush_pending_cb = pgstat_query_flush_cb,
+		.reset_timestamp_cb = pgstat_query_reset_timestamp_cb,
+	},
+
+	[PGSTAT_KIND_TABLESPACE] = {
+		.name = "tablespace",
+
+		.fixed_amount = false,
+		/* tablespaces are shared by all databases */
+		.accessed_across_databases = true,
+
+		.shared_size = sizeof(PgStatShared_TablespaceIO),
+		.shared_data_off = offsetof(PgStatShared_TablespaceIO, stats),
+		.shared_data_len = sizeof(((PgStatShared_TablespaceIO *) 0)->stats),
+
+		.reset_timestamp_cb = pgstat_tablespace_io_reset_timestamp_cb,
+	},
+
 
 	/* stats for fixed-numbered (mostly 1) objects */
 
@@ -385,6 +440,15 @@ static const PgStat_KindInfo pgstat_kind_infos[PGSTAT_NUM_KINDS] = {
 		.snapshot_cb = pgstat_slru_snapshot_cb,
 	},
 
+	[PGSTAT_KIND_WAIT] = {
+		.name = "wait",
+
+		.fixed_amount = true,
+
+		.reset_all_cb = pgstat_wait_reset_all_cb,
+		.snapshot_cb = pgstat_wait_snapshot_cb,
+	},
+
 	[PGSTAT_KIND_WAL] = {
 		.name = "wal",
 
@@ -601,6 +665,7 @@ pgstat_report_stat(bool force)
 	if (dlist_is_empty(&pgStatPending) &&
 		!have_iostats &&
 		!have_slrustats &&
+		!have_waitstats &&
 		!pgstat_have_pending_wal())
 	{
 		Assert(pending_since == 0);
@@ -666,6 +731,9 @@ pgstat_report_stat(bool force)
 	/* flush SLRU stats */
 	partial_flush |= pgstat_slru_flush(nowait);
 
+	/* flush wait event stats */
+	partial_flush |= pgstat_flush_wait(nowait);
+
 	last_flush = now;
 
 	/*
@@ -734,7 +802,7 @@ pgstat_reset_counters(void)
  * GRANT system.
  */
 void
-pgstat_reset(PgStat_Kind kind, Oid dboid, Oid objoid)
+pgstat_reset(PgStat_Kind kind, Oid dboid, uint64 objoid)
 {
 	const PgStat_KindInfo *kind_info = pgstat_get_kind_info(kind);
 	TimestampTz ts = GetCurrentTimestamp();
@@ -812,7 +880,7 @@ pgstat_clear_snapshot(void)
 }
 
 void *
-pgstat_fetch_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
+pgstat_fetch_entry(PgStat_Kind kind, Oid dboid, uint64 objoid)
 {
 	PgStat_HashKey key;
 	PgStat_EntryRef *entry_ref;
@@ -922,7 +990,7 @@ pgstat_get_stat_snapshot_timestamp(bool *have_snapshot)
 }
 
 bool
-pgstat_have_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
+pgstat_have_entry(PgStat_Kind kind, Oid dboid, uint64 objoid)
 {
 	/* fixed-numbered stats always exist */
 	if (pgstat_get_kind_info(kind)->fixed_amount)
@@ -1102,7 +1170,7 @@ pgstat_build_snapshot_fixed(PgStat_Kind kind)
  * created, false otherwise.
  */
 PgStat_EntryRef *
-pgstat_prep_pending_entry(PgStat_Kind kind, Oid dboid, Oid objoid, bool *created_entry)
+pgstat_prep_pending_entry(PgStat_Kind kind, Oid dboid, uint64 objoid, bool *created_entry)
 {
 	PgStat_EntryRef *entry_ref;
 
@@ -1140,7 +1208,7 @@ pgstat_prep_pending_entry(PgStat_Kind kind, Oid dboid, Oid objoid, bool *created
  * that it shouldn't be needed.
  */
 PgStat_EntryRef *
-pgstat_fetch_pending_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
+pgstat_fetch_pending_entry(PgStat_Kind kind, Oid dboid, uint64 objoid)
 {
 	PgStat_EntryRef *entry_ref;
 
@@ -1376,6 +1444,12 @@ pgstat_write_statsfile(void)
 	pgstat_build_snapshot_fixed(PGSTAT_KIND_SLRU);
 	write_chunk_s(fpout, &pgStatLocal.snapshot.slru);
 
+	/*
+	 * Write wait event stats struct
+	 */
+	pgstat_build_snapshot_fixed(PGSTAT_KIND_WAIT);
+	write_chunk_s(fpout, &pgStatLocal.snapshot.wait);
+
 	/*
 	 * Write WAL stats struct
 	 */
@@ -1556,6 +1630,12 @@ pgstat_read_statsfile(void)
 	if (!read_chunk_s(fpin, &shmem->slru.stats))
 		goto error;
 
+	/*
+	 * Read wait event stats struct
+	 */
+	if (!read_chunk_s(fpin, &shmem->wait.stats))
+		goto error;
+
 	/*
 	 * Read WAL stats struct
 	 */
@@ -1632,7 +1712,7 @@ pgstat_read_statsfile(void)
 					if (found)
 					{
 						dshash_release_lock(pgStatLocal.shared_hash, p);
-						elog(WARNING, "found duplicate stats entry %d/%u/%u",
+						elog(WARNING, "found duplicate stats entry %d/%u/" UINT64_FORMAT,
 							 key.kind, key.dboid, key.objoid);
 						goto error;
 					}
@@ -35,6 +35,7 @@ SessionEndType pgStatSessionEndCause = DISCONNECT_NORMAL;
 static int	pgStatXactCommit = 0;
 static int	pgStatXactRollback = 0;
 static PgStat_Counter pgLastSessionReportTime = 0;
+static PgBackendResourceUsage pgLastResourceUsage;
 
 
 /*
@@ -263,13 +264,14 @@ AtEOXact_PgStat_Database(bool isCommit, bool parallel)
 }
 
 /*
- * Subroutine for pgstat_report_stat(): Handle xact commit/rollback and I/O
- * timings.
+ * Subroutine for pgstat_report_stat(): Handle xact commit/rollback, I/O
+ * timings and resource usage.
  */
 void
 pgstat_update_dbstats(TimestampTz ts)
 {
 	PgStat_StatDBEntry *dbentry;
+	PgBackendResourceUsage usage;
 
 	/*
 	 * If not connected to a database yet, don't attribute time to "shared
@@ -289,6 +291,19 @@ pgstat_update_dbstats(TimestampTz ts)
 	dbentry->blk_read_time += pgStatBlockReadTime;
 	dbentry->blk_write_time += pgStatBlockWriteTime;
 
+	/*
+	 * Accumulate the resources used since the last report.  Unlike session
+	 * times, this includes all processes connected to the database.
+	 */
+	pgstat_get_resource_usage(&usage);
+	dbentry->cpu_user_time +=
+		usage.cpu_user_time - pgLastResourceUsage.cpu_user_time;
+	dbentry->cpu_system_time +=
+		usage.cpu_system_time - pgLastResourceUsage.cpu_system_time;
+	dbentry->read_bytes += usage.read_bytes - pgLastResourceUsage.read_bytes;
+	dbentry->write_bytes += usage.write_bytes - pgLastResourceUsage.write_bytes;
+	pgLastResourceUsage = usage;
+
 	if (pgstat_should_report_connstat())
 	{
 		long		secs;
@@ -425,6 +440,10 @@ pgstat_database_flush_cb(PgStat_EntryRef *entry_ref, bool nowait)
 	PGSTAT_ACCUM_DBCOUNT(sessions_abandoned);
 	PGSTAT_ACCUM_DBCOUNT(sessions_fatal);
 	PGSTAT_ACCUM_DBCOUNT(sessions_killed);
+	PGSTAT_ACCUM_DBCOUNT(cpu_user_time);
+	PGSTAT_ACCUM_DBCOUNT(cpu_system_time);
+	PGSTAT_ACCUM_DBCOUNT(read_bytes);
+	PGSTAT_ACCUM_DBCOUNT(write_bytes);
 #undef PGSTAT_ACCUM_DBCOUNT
 
 	pgstat_unlock_entry(entry_ref);
@@ -17,6 +17,7 @@
 #include "postgres.h"
 
 #include "executor/instrument.h"
+#include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
 #include "utils/pgstat_internal.h"
 
@@ -25,12 +26,88 @@ typedef struct PgStat_PendingIO
 {
 	PgStat_Counter counts[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES];
 	instr_time	pending_times[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES];
+	PgStat_Counter hist[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES][PGSTAT_IO_HIST_BUCKETS];
 } PgStat_PendingIO;
 
+/*
+ * IO counted per tablespace since the last flush.  IO is counted where no
+ * memory can be allocated, so there's room for a fixed number of tablespaces;
+ * IO in further tablespaces is only counted in the totals until the next
+ * flush makes room.
+ */
+#define PGSTAT_IO_PENDING_TABLESPACES	16
+
+typedef struct PgStat_PendingTablespaceIO
+{
+	Oid			spcoid;
+	PgStat_Counter counts[IOOP_NUM_TYPES];
+	instr_time	pending_times[IOOP_NUM_TYPES];
+	PgStat_Counter hist[IOOP_NUM_TYPES][PGSTAT_IO_HIST_BUCKETS];
+} PgStat_PendingTablespaceIO;
+
 
 static PgStat_PendingIO PendingIOStats;
+static PgStat_PendingTablespaceIO PendingTablespaceIOStats[PGSTAT_IO_PENDING_TABLESPACES];
+static int	nPendingTablespaceIOStats = 0;
 bool		have_iostats = false;
 
+PgStat_Counter pgStatIOReadBytes = 0;
+PgStat_Counter pgStatIOWriteBytes = 0;
+
+static bool pgstat_flush_tablespace_io(bool nowait);
+
+
+/*
+ * Latency histogram bucket of an IO taking io_time.  Bucket 0 holds times
+ * below 1us, bucket i times in [2^(i-1), 2^i) us, and the last bucket
+ * everything longer.
+ */
+static inline int
+pgstat_io_hist_bucket(instr_time io_time)
+{
+	int64		usec = INSTR_TIME_GET_MICROSEC(io_time);
+
+	if (usec <= 0)
+		return 0;
+	return Min(pg_leftmost_one_pos64((uint64) usec) + 1,
+			   PGSTAT_IO_HIST_BUCKETS - 1);
+}
+
+/*
+ * Count IO in tablespace spcoid.  io_time is NULL if the IO wasn't timed.
+ */
+static void
+pgstat_count_tablespace_io(Oid spcoid, IOOp io_op, instr_time *io_time,
+						   uint32 cnt)
+{
+	PgStat_PendingTablespaceIO *pending = NULL;
+
+	for (int i = 0; i < nPendingTablespaceIOStats; i++)
+	{
+		if (PendingTablespaceIOStats[i].spcoid == spcoid)
+		{
+			pending = &PendingTablespaceIOStats[i];
+			break;
+		}
+	}
+
+	if (pending == NULL)
+	{
+		if (nPendingTablespaceIOStats >= PGSTAT_IO_PENDING_TABLESPACES)
+			return;
+		pending = &PendingTablespaceIOStats[nPendingTablespaceIOStats++];
+		memset(pending, 0, sizeof(*pending));
+		pending->spcoid = spcoid;
+	}
+
+	pending->counts[io_op] += cnt;
+	if (io_time)
+	{
+		INSTR_TIME_ADD(pending->pending_times[io_op], *io_time);
+		pending->hist[io_op][pgstat_io_hist_bucket(*io_time)]++;
+	}
+}
+
 
 /*
  * Check that stats have not been counted for any combination of IOObject,
@@ -89,6 +166,11 @@ pgstat_count_io_op_n(IOObject io_object, IOContext io_context, IOOp io_op, uint3
 
 	PendingIOStats.counts[io_object][io_context][io_op] += cnt;
 
+	if (io_op == IOOP_READ)
+		pgStatIOReadBytes += (PgStat_Counter) cnt * BLCKSZ;
+	else if (io_op == IOOP_WRITE || io_op == IOOP_EXTEND)
+		pgStatIOWriteBytes += (PgStat_Counter) cnt * BLCKSZ;
+
 	have_iostats = true;
 }
 
@@ -106,16 +188,19 @@ pgstat_prepare_io_time(void)
 }
 
 /*
- * Like pgstat_count_io_op_n() except it also accumulates time.
+ * Like pgstat_count_io_op_n() except it also accumulates time, and a latency
+ * histogram where each call counts as one IO, however many blocks it covers.
+ *
+ * If spcoid is valid, the IO is also counted for that tablespace.
  */
 void
 pgstat_count_io_op_time(IOObject io_object, IOContext io_context, IOOp io_op,
-						instr_time start_time, uint32 cnt)
+						Oid spcoid, instr_time start_time, uint32 cnt)
 {
+	instr_time	io_time;
+
 	if (track_io_timing)
 	{
-		instr_time	io_time;
-
 		INSTR_TIME_SET_CURRENT(io_time);
 		INSTR_TIME_SUBTRACT(io_time, start_time);
 
@@ -134,8 +219,13 @@ pgstat_count_io_op_time(IOObject io_object, IOContext io_context, IOOp io_op,
 
 		INSTR_TIME_ADD(PendingIOStats.pending_times[io_object][io_context][io_op],
 					   io_time);
+		PendingIOStats.hist[io_object][io_context][io_op][pgstat_io_hist_bucket(io_time)]++;
 	}
 
+	if (OidIsValid(spcoid))
+		pgstat_count_tablespace_io(spcoid, io_op,
+								   track_io_timing ? &io_time : NULL, cnt);
+
 	pgstat_count_io_op_n(io_object, io_context, io_op, cnt);
 }
 
@@ -147,6 +237,17 @@ pgstat_fetch_stat_io(void)
 	return &pgStatLocal.snapshot.io;
 }
 
+/*
+ * Support function for the SQL-callable pgstat* functions. Returns
+ * the collected IO statistics for one tablespace or NULL.
+ */
+PgStat_StatTablespaceIOEntry *
+pgstat_fetch_stat_tablespace_io(Oid spcoid)
+{
+	return (PgStat_StatTablespaceIOEntry *)
+		pgstat_fetch_entry(PGSTAT_KIND_TABLESPACE, InvalidOid, spcoid);
+}
+
 /*
  * Flush out locally pending IO statistics
  *
@@ -188,6 +289,10 @@ pgstat_flush_io(bool nowait)
 
 				bktype_shstats->times[io_object][io_context][io_op] +=
 					INSTR_TIME_GET_MICROSEC(time);
+
+				for (int bucket = 0; bucket < PGSTAT_IO_HIST_BUCKETS; bucket++)
+					bktype_shstats->hist[io_object][io_context][io_op][bucket] +=
+						PendingIOStats.hist[io_object][io_context][io_op][bucket];
 			}
 		}
 	}
@@ -198,9 +303,72 @@ pgstat_flush_io(bool nowait)
 
 	memset(&PendingIOStats, 0, sizeof(PendingIOStats));
 
-	have_iostats = false;
+	/* keep have_iostats set while some tablespace stats are left */
+	have_iostats = pgstat_flush_tablespace_io(nowait);
 
-	return false;
+	return have_iostats;
+}
+
+/*
+ * Flush out the pending IO statistics of tablespaces.  Returns true if some
+ * could not be flushed because nowait is true and their entry was locked.
+ */
+static bool
+pgstat_flush_tablespace_io(bool nowait)
+{
+	int			nremaining = 0;
+
+	for (int i = 0; i < nPendingTablespaceIOStats; i++)
+	{
+		PgStat_PendingTablespaceIO *pending = &PendingTablespaceIOStats[i];
+		PgStat_EntryRef *entry_ref;
+		PgStat_StatTablespaceIOEntry *shstats;
+
+		entry_ref = pgstat_get_entry_ref_locked(PGSTAT_KIND_TABLESPACE,
+												InvalidOid, pending->spcoid,
+												nowait);
+		if (entry_ref == NULL)
+		{
+			/* keep it for the next time */
+			if (nremaining != i)
+				PendingTablespaceIOStats[nremaining] = *pending;
+			nremaining++;
+			continue;
+		}
+
+		shstats = &((PgStatShared_TablespaceIO *) entry_ref->shared_stats)->stats;
+
+		for (int io_op = 0; io_op < IOOP_NUM_TYPES; io_op++)
+		{
+			shstats->counts[io_op] += pending->counts[io_op];
+			shstats->times[io_op] +=
+				INSTR_TIME_GET_MICROSEC(pending->pending_times[io_op]);
+			for (int bucket = 0; bucket < PGSTAT_IO_HIST_BUCKETS; bucket++)
+				shstats->hist[io_op][bucket] += pending->hist[io_op][bucket];
+		}
+
+		pgstat_unlock_entry(entry_ref);
+	}
+
+	nPendingTablespaceIOStats = nremaining;
+
+	return nremaining > 0;
+}
+
+void
+pgstat_tablespace_io_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts)
+{
+	((PgStatShared_TablespaceIO *) header)->stats.stat_reset_timestamp = ts;
+}
+
+/*
+ * Report the drop of a tablespace, removing its IO statistics once the
+ * transaction commits.
+ */
+void
+pgstat_drop_tablespace(Oid spcoid)
+{
+	pgstat_drop_transactional(PGSTAT_KIND_TABLESPACE, InvalidOid, spcoid);
 }
 
 const char *
@@ -237,6 +405,33 @@ pgstat_get_io_object_name(IOObject io_object)
 	pg_unreachable();
 }
 
+const char *
+pgstat_get_io_op_name(IOOp io_op)
+{
+	switch (io_op)
+	{
+		case IOOP_EVICT:
+			return "evict";
+		case IOOP_EXTEND:
+			return "extend";
+		case IOOP_FSYNC:
+			return "fsync";
+		case IOOP_HIT:
+			return "hit";
+		case IOOP_READ:
+			return "read";
+		case IOOP_REUSE:
+			return "reuse";
+		case IOOP_WRITE:
+			return "write";
+		case IOOP_WRITEBACK:
+			return "writeback";
+	}
+
+	elog(ERROR, "unrecognized IOOp value: %d", io_op);
+	pg_unreachable();
+}
+
 void
 pgstat_io_reset_all_cb(TimestampTz ts)
 {
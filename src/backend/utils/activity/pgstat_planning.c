@@ -0,0 +1,168 @@
+/* -------------------------------------------------------------------------
+ *
+ * pgstat_planning.c
+ *	  Implementation of planner statistics.
+ *
+ * This file contains the implementation of planner statistics, which are
+ * collected per database and query id when track_planning_detail is on.  It
+ * is kept separate from pgstat.c to enforce the line between the statistics
+ * access / storage implementation and the details about individual types of
+ * statistics.
+ *
+ * Entries are never dropped individually.  They accumulate until
+ * pgstat_reset_planning() or until the database is dropped.
+ *
+ * Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/activity/pgstat_planning.c
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "optimizer/optimizer.h"
+#include "utils/pgstat_internal.h"
+
+
+static bool match_planning_entry(PgStatShared_HashEntry *entry,
+								 Datum match_data);
+
+
+/*
+ * Report the instrumentation collected while planning a query.
+ */
+void
+pgstat_report_planning(uint64 queryid, instr_time duration,
+					   const PlannerInstrumentation *instr)
+{
+	PgStat_EntryRef *entry_ref;
+	PgStat_PlanningCounts *pending;
+
+	entry_ref = pgstat_prep_pending_entry(PGSTAT_KIND_PLANNING, MyDatabaseId,
+										  queryid, NULL);
+	pending = (PgStat_PlanningCounts *) entry_ref->pending;
+
+	pending->plans++;
+	INSTR_TIME_ADD(pending->total_time, duration);
+	INSTR_TIME_ADD(pending->expand_time, instr->expand_time);
+	INSTR_TIME_ADD(pending->path_time, instr->path_time);
+	INSTR_TIME_ADD(pending->join_time, instr->join_time);
+	INSTR_TIME_ADD(pending->selectivity_time, instr->selectivity_time);
+	pending->selectivity_calls += instr->selectivity_calls;
+	pending->paths_considered += instr->paths_considered;
+	pending->joinrels_built += instr->joinrels_built;
+	pending->max_memory = Max(pending->max_memory,
+							  (PgStat_Counter) instr->memory_allocated);
+}
+
+/*
+ * Flush out pending stats for the entry
+ *
+ * If nowait is true, this function returns false if lock could not
+ * immediately acquired, otherwise true is returned.
+ */
+bool
+pgstat_planning_flush_cb(PgStat_EntryRef *entry_ref, bool nowait)
+{
+	PgStat_PlanningCounts *localent;
+	PgStatShared_Planning *shplanent;
+
+	localent = (PgStat_PlanningCounts *) entry_ref->pending;
+	shplanent = (PgStatShared_Planning *) entry_ref->shared_stats;
+
+	if (!pgstat_lock_entry(entry_ref, nowait))
+		return false;
+
+#define PLANSTAT_ACC(fld) \
+	(shplanent->stats.fld += localent->fld)
+#define PLANSTAT_ACC_TIME(fld) \
+	(shplanent->stats.fld += INSTR_TIME_GET_MICROSEC(localent->fld))
+	PLANSTAT_ACC(plans);
+	PLANSTAT_ACC_TIME(total_time);
+	PLANSTAT_ACC_TIME(expand_time);
+	PLANSTAT_ACC_TIME(path_time);
+	PLANSTAT_ACC_TIME(join_time);
+	PLANSTAT_ACC_TIME(selectivity_time);
+	PLANSTAT_ACC(selectivity_calls);
+	PLANSTAT_ACC(paths_considered);
+	PLANSTAT_ACC(joinrels_built);
+#undef PLANSTAT_ACC
+#undef PLANSTAT_ACC_TIME
+	shplanent->stats.max_memory = Max(shplanent->stats.max_memory,
+									  localent->max_memory);
+
+	pgstat_unlock_entry(entry_ref);
+
+	return true;
+}
+
+void
+pgstat_planning_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts)
+{
+	((PgStatShared_Planning *) header)->stats.stat_reset_timestamp = ts;
+}
+
+static bool
+match_planning_entry(PgStatShared_HashEntry *entry, Datum match_data)
+{
+	return entry->key.kind == PGSTAT_KIND_PLANNING &&
+		entry->key.dboid == DatumGetObjectId(match_data);
+}
+
+/*
+ * Remove the planner statistics of all query ids of the current database.
+ */
+void
+pgstat_reset_planning(void)
+{
+	pgstat_drop_matching_entries(match_planning_entry,
+								 ObjectIdGetDatum(MyDatabaseId));
+}
+
+/*
+ * Return the query ids that have planner statistics in the current database,
+ * for the SQL-callable functions.  The stats themselves are fetched with
+ * pgstat_fetch_stat_planning(), so that stats_fetch_consistency applies.
+ */
+uint64 *
+pgstat_fetch_planning_queryids(int *nqueryids)
+{
+	dshash_seq_status hstat;
+	PgStatShared_HashEntry *p;
+	uint64	   *queryids;
+	int			n = 0;
+	int			maxn = 64;
+
+	queryids = palloc(maxn * sizeof(uint64));
+
+	dshash_seq_init(&hstat, pgStatLocal.shared_hash, false);
+	while ((p = dshash_seq_next(&hstat)) != NULL)
+	{
+		if (p->dropped || !match_planning_entry(p, ObjectIdGetDatum(MyDatabaseId)))
+			continue;
+
+		if (n >= maxn)
+		{
+			maxn *= 2;
+			queryids = repalloc(queryids, maxn * sizeof(uint64));
+		}
+		queryids[n++] = p->key.objoid;
+	}
+	dshash_seq_term(&hstat);
+
+	*nqueryids = n;
+	return queryids;
+}
+
+/*
+ * Support function for the SQL-callable pgstat* functions. Returns
+ * the collected planner statistics for one query id or NULL.
+ */
+PgStat_StatPlanningEntry *
+pgstat_fetch_stat_planning(uint64 queryid)
+{
+	return (PgStat_StatPlanningEntry *)
+		pgstat_fetch_entry(PGSTAT_KIND_PLANNING, MyDatabaseId, queryid);
+}
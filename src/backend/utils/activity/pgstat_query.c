@@ -0,0 +1,337 @@
+/* -------------------------------------------------------------------------
+ *
+ * pgstat_query.c
+ *	  Implementation of query statistics.
+ *
+ * This file contains the implementation of query statistics, which are
+ * collected per database and query id when track_queries is on: execution
+ * count and time, a latency histogram, rows, and buffer and WAL usage.  It
+ * is kept separate from pgstat.c to enforce the line between the statistics
+ * access / storage implementation and the details about individual types of
+ * statistics.
+ *
+ * Executions are accumulated in backend-local pending entries, and flushed
+ * to shared memory by pgstat_report_stat() like other variable-numbered
+ * stats.  To bound the memory used, at most track_queries_max entries are
+ * kept: when a new query id pushes the count over that, the least executed
+ * tenth of the entries is evicted.
+ *
+ * Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/activity/pgstat_query.c
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/instrument.h"
+#include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "utils/pgstat_internal.h"
+
+
+/* GUC parameters */
+bool		pgstat_track_queries = true;
+int			pgstat_track_queries_max = 5000;
+
+
+typedef struct QueryEvictCandidate
+{
+	Oid			dboid;
+	uint64		queryid;
+	PgStat_Counter calls;
+} QueryEvictCandidate;
+
+static void pgstat_evict_queries(uint64 keep_queryid);
+static int	evict_candidate_cmp(const void *a, const void *b);
+static bool match_query_entry(PgStatShared_HashEntry *entry,
+							  Datum match_data);
+
+
+/*
+ * Histogram bucket of an execution time in microseconds.  Bucket 0 holds
+ * times below 1us, bucket i times in [2^(i-1), 2^i) us, and the last bucket
+ * everything longer.
+ */
+static inline int
+query_hist_bucket(PgStat_Counter usec)
+{
+	if (usec <= 0)
+		return 0;
+	return Min(pg_leftmost_one_pos64((uint64) usec) + 1,
+			   PGSTAT_QUERY_HIST_BUCKETS - 1);
+}
+
+/*
+ * Report one execution of a query, with the time, buffer and WAL usage
+ * gathered in totaltime.
+ */
+void
+pgstat_report_query(uint64 queryid, const Instrumentation *totaltime,
+					uint64 rows)
+{
+	PgStat_EntryRef *entry_ref;
+	PgStat_QueryCounts *pending;
+	PgStat_Counter usec;
+	bool		created_entry;
+
+	entry_ref = pgstat_prep_pending_entry(PGSTAT_KIND_QUERY, MyDatabaseId,
+										  queryid, &created_entry);
+	pending = (PgStat_QueryCounts *) entry_ref->pending;
+
+	usec = (PgStat_Counter) (totaltime->total * 1000000.0);
+
+	if (pending->calls == 0 || usec < pending->min_time)
+		pending->min_time = usec;
+	pending->max_time = Max(pending->max_time, usec);
+	pending->calls++;
+	pending->total_time += usec;
+	pending->hist[query_hist_bucket(usec)]++;
+	pending->rows += rows;
+
+	pending->shared_blks_hit += totaltime->bufusage.shared_blks_hit;
+	pending->shared_blks_read += totaltime->bufusage.shared_blks_read;
+	pending->shared_blks_dirtied += totaltime->bufusage.shared_blks_dirtied;
+	pending->shared_blks_written += totaltime->bufusage.shared_blks_written;
+	pending->local_blks_hit += totaltime->bufusage.local_blks_hit;
+	pending->local_blks_read += totaltime->bufusage.local_blks_read;
+	pending->temp_blks_read += totaltime->bufusage.temp_blks_read;
+	pending->temp_blks_written += totaltime->bufusage.temp_blks_written;
+	pending->wal_records += totaltime->walusage.wal_records;
+	pending->wal_fpi += totaltime->walusage.wal_fpi;
+	pending->wal_bytes += totaltime->walusage.wal_bytes;
+
+	/*
+	 * A new query id adds a shared entry.  The count is only approximate,
+	 * as entries also go away when databases are dropped or stats reset;
+	 * the eviction recounts them.
+	 */
+	if (created_entry &&
+		pg_atomic_add_fetch_u32(&pgStatLocal.shmem->query_entries, 1) >
+		(uint32) pgstat_track_queries_max)
+		pgstat_evict_queries(queryid);
+}
+
+/*
+ * Evict the least executed query entries, to bring the number of entries
+ * down to 90% of track_queries_max.  The entry of keep_queryid, which the
+ * caller just created, is kept.
+ *
+ * Entries that have not been flushed to yet have no calls, and most likely
+ * are new ones that other backends are about to fill in.  They are kept
+ * too, rather than making room for them by evicting them.
+ */
+static void
+pgstat_evict_queries(uint64 keep_queryid)
+{
+	dshash_seq_status hstat;
+	PgStatShared_HashEntry *p;
+	QueryEvictCandidate *candidates;
+	int			ncandidates = 0;
+	int			maxcandidates = 64;
+	int			nentries = 0;
+	int			nevict;
+	uint64		not_freed_count = 0;
+
+	/* one backend at a time is enough */
+	if (!pg_atomic_test_set_flag(&pgStatLocal.shmem->query_evicting))
+		return;
+
+	PG_TRY();
+	{
+		candidates = palloc(maxcandidates * sizeof(QueryEvictCandidate));
+
+		dshash_seq_init(&hstat, pgStatLocal.shared_hash, false);
+		while ((p = dshash_seq_next(&hstat)) != NULL)
+		{
+			PgStatShared_Query *shent;
+
+			if (p->dropped || p->key.kind != PGSTAT_KIND_QUERY)
+				continue;
+
+			nentries++;
+
+			if (p->key.dboid == MyDatabaseId && p->key.objoid == keep_queryid)
+				continue;
+
+			/* read without locking; an approximate count is good enough */
+			shent = (PgStatShared_Query *) dsa_get_address(pgStatLocal.dsa,
+														   p->body);
+			if (shent->stats.calls == 0)
+				continue;
+
+			if (ncandidates >= maxcandidates)
+			{
+				maxcandidates *= 2;
+				candidates = repalloc(candidates,
+									  maxcandidates * sizeof(QueryEvictCandidate));
+			}
+			candidates[ncandidates].dboid = p->key.dboid;
+			candidates[ncandidates].queryid = p->key.objoid;
+			candidates[ncandidates].calls = shent->stats.calls;
+			ncandidates++;
+		}
+		dshash_seq_term(&hstat);
+
+		nevict = nentries - pgstat_track_queries_max * 9 / 10;
+		nevict = Min(Max(nevict, 0), ncandidates);
+
+		qsort(candidates, ncandidates, sizeof(QueryEvictCandidate),
+			  evict_candidate_cmp);
+
+		for (int i = 0; i < nevict; i++)
+		{
+			if (!pgstat_drop_entry(PGSTAT_KIND_QUERY, candidates[i].dboid,
+								   candidates[i].queryid))
+				not_freed_count++;
+		}
+
+		if (not_freed_count > 0)
+			pgstat_request_entry_refs_gc();
+
+		pg_atomic_write_u32(&pgStatLocal.shmem->query_entries,
+							(uint32) (nentries - nevict));
+
+		pfree(candidates);
+	}
+	PG_FINALLY();
+	{
+		pg_atomic_clear_flag(&pgStatLocal.shmem->query_evicting);
+	}
+	PG_END_TRY();
+}
+
+/*
+ * qsort comparator for eviction candidates, least executed first
+ */
+static int
+evict_candidate_cmp(const void *a, const void *b)
+{
+	const QueryEvictCandidate *ca = (const QueryEvictCandidate *) a;
+	const QueryEvictCandidate *cb = (const QueryEvictCandidate *) b;
+
+	if (ca->calls < cb->calls)
+		return -1;
+	if (ca->calls > cb->calls)
+		return 1;
+	return 0;
+}
+
+/*
+ * Flush out pending stats for the entry
+ *
+ * If nowait is true, this function returns false if lock could not
+ * immediately acquired, otherwise true is returned.
+ */
+bool
+pgstat_query_flush_cb(PgStat_EntryRef *entry_ref, bool nowait)
+{
+	PgStat_QueryCounts *localent;
+	PgStatShared_Query *shqueryent;
+
+	localent = (PgStat_QueryCounts *) entry_ref->pending;
+	shqueryent = (PgStatShared_Query *) entry_ref->shared_stats;
+
+	if (!pgstat_lock_entry(entry_ref, nowait))
+		return false;
+
+	if (shqueryent->stats.calls == 0 ||
+		localent->min_time < shqueryent->stats.min_time)
+		shqueryent->stats.min_time = localent->min_time;
+	shqueryent->stats.max_time = Max(shqueryent->stats.max_time,
+									 localent->max_time);
+
+#define QUERYSTAT_ACC(fld) \
+	(shqueryent->stats.fld += localent->fld)
+	QUERYSTAT_ACC(calls);
+	QUERYSTAT_ACC(total_time);
+	QUERYSTAT_ACC(rows);
+	QUERYSTAT_ACC(shared_blks_hit);
+	QUERYSTAT_ACC(shared_blks_read);
+	QUERYSTAT_ACC(shared_blks_dirtied);
+	QUERYSTAT_ACC(shared_blks_written);
+	QUERYSTAT_ACC(local_blks_hit);
+	QUERYSTAT_ACC(local_blks_read);
+	QUERYSTAT_ACC(temp_blks_read);
+	QUERYSTAT_ACC(temp_blks_written);
+	QUERYSTAT_ACC(wal_records);
+	QUERYSTAT_ACC(wal_fpi);
+	QUERYSTAT_ACC(wal_bytes);
+	for (int i = 0; i < PGSTAT_QUERY_HIST_BUCKETS; i++)
+		QUERYSTAT_ACC(hist[i]);
+#undef QUERYSTAT_ACC
+
+	pgstat_unlock_entry(entry_ref);
+
+	return true;
+}
+
+void
+pgstat_query_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts)
+{
+	((PgStatShared_Query *) header)->stats.stat_reset_timestamp = ts;
+}
+
+static bool
+match_query_entry(PgStatShared_HashEntry *entry, Datum match_data)
+{
+	return entry->key.kind == PGSTAT_KIND_QUERY &&
+		entry->key.dboid == DatumGetObjectId(match_data);
+}
+
+/*
+ * Remove the query statistics of all query ids of the current database.
+ */
+void
+pgstat_reset_queries(void)
+{
+	pgstat_drop_matching_entries(match_query_entry,
+								 ObjectIdGetDatum(MyDatabaseId));
+}
+
+/*
+ * Return the query ids that have query statistics in the current database,
+ * for the SQL-callable functions.  The stats themselves are fetched with
+ * pgstat_fetch_stat_query(), so that stats_fetch_consistency applies.
+ */
+uint64 *
+pgstat_fetch_query_queryids(int *nqueryids)
+{
+	dshash_seq_status hstat;
+	PgStatShared_HashEntry *p;
+	uint64	   *queryids;
+	int			n = 0;
+	int			maxn = 64;
+
+	queryids = palloc(maxn * sizeof(uint64));
+
+	dshash_seq_init(&hstat, pgStatLocal.shared_hash, false);
+	while ((p = dshash_seq_next(&hstat)) != NULL)
+	{
+		if (p->dropped || !match_query_entry(p, ObjectIdGetDatum(MyDatabaseId)))
+			continue;
+
+		if (n >= maxn)
+		{
+			maxn *= 2;
+			queryids = repalloc(queryids, maxn * sizeof(uint64));
+		}
+		queryids[n++] = p->key.objoid;
+	}
+	dshash_seq_term(&hstat);
+
+	*nqueryids = n;
+	return queryids;
+}
+
+/*
+ * Support function for the SQL-callable pgstat* functions. Returns
+ * the collected query statistics for one query id or NULL.
+ */
+PgStat_StatQueryEntry *
+pgstat_fetch_stat_query(uint64 queryid)
+{
+	return (PgStat_StatQueryEntry *)
+		pgstat_fetch_entry(PGSTAT_KIND_QUERY, MyDatabaseId, queryid);
+}
@@ -207,10 +207,17 @@ pgstat_drop_relation(Relation rel)
 
 /*
  * Report that the table was just vacuumed and flush IO statistics.
+ *
+ * eagerfrozenpages is the number of pages frozen only because of the eager
+ * freezing strategy, freezedebtpages the number of all-visible pages still
+ * not all-frozen, and vacuumlsn the insert LSN as of the end of the vacuum.
  */
 void
 pgstat_report_vacuum(Oid tableoid, bool shared,
-					 PgStat_Counter livetuples, PgStat_Counter deadtuples)
+					 PgStat_Counter livetuples, PgStat_Counter deadtuples,
+					 PgStat_Counter eagerfrozenpages,
+					 PgStat_Counter freezedebtpages,
+					 XLogRecPtr vacuumlsn)
 {
 	PgStat_EntryRef *entry_ref;
 	PgStatShared_Relation *shtabentry;
@@ -233,6 +240,9 @@ pgstat_report_vacuum(Oid tableoid, bool shared,
 
 	tabentry->live_tuples = livetuples;
 	tabentry->dead_tuples = deadtuples;
+	tabentry->eager_frozen_pages += eagerfrozenpages;
+	tabentry->freeze_debt_pages = freezedebtpages;
+	tabentry->last_vacuum_lsn = vacuumlsn;
 
 	/*
 	 * It is quite possible that a non-aggressive VACUUM ended up skipping
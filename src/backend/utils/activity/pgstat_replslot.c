@@ -96,6 +96,7 @@ pgstat_report_replslot(ReplicationSlot *slot, const PgStat_StatReplSlotEntry *re
 	REPLSLOT_ACC(stream_bytes);
 	REPLSLOT_ACC(total_txns);
 	REPLSLOT_ACC(total_bytes);
+	REPLSLOT_ACC(snapshot_build_time);
 #undef REPLSLOT_ACC
 
 	pgstat_unlock_entry(entry_ref);
@@ -183,7 +184,7 @@ pgstat_replslot_to_serialized_name_cb(const PgStat_HashKey *key, const PgStatSha
 	 */
 	if (!ReplicationSlotName(key->objoid, name))
 		elog(ERROR, "could not find name for replication slot index %u",
-			 key->objoid);
+			 (uint32) key->objoid);
 }
 
 bool
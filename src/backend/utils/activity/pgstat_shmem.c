@@ -195,12 +195,16 @@ StatsShmemInit(void)
 
 		pg_atomic_init_u64(&ctl->gc_request_count, 1);
 
+		pg_atomic_init_u32(&ctl->query_entries, 0);
+		pg_atomic_init_flag(&ctl->query_evicting);
+
 
 		/* initialize fixed-numbered stats */
 		LWLockInitialize(&ctl->archiver.lock, LWTRANCHE_PGSTATS_DATA);
 		LWLockInitialize(&ctl->bgwriter.lock, LWTRANCHE_PGSTATS_DATA);
 		LWLockInitialize(&ctl->checkpointer.lock, LWTRANCHE_PGSTATS_DATA);
 		LWLockInitialize(&ctl->slru.lock, LWTRANCHE_PGSTATS_DATA);
+		LWLockInitialize(&ctl->wait.lock, LWTRANCHE_PGSTATS_DATA);
 		LWLockInitialize(&ctl->wal.lock, LWTRANCHE_PGSTATS_DATA);
 
 		for (int i = 0; i < BACKEND_NUM_TYPES; i++)
@@ -394,7 +398,7 @@ pgstat_get_entry_ref_cached(PgStat_HashKey key, PgStat_EntryRef **entry_ref_p)
  * if the entry is newly created, false otherwise.
  */
 PgStat_EntryRef *
-pgstat_get_entry_ref(PgStat_Kind kind, Oid dboid, Oid objoid, bool create,
+pgstat_get_entry_ref(PgStat_Kind kind, Oid dboid, uint64 objoid, bool create,
 					 bool *created_entry)
 {
 	PgStat_HashKey key = {.kind = kind,.dboid = dboid,.objoid = objoid};
@@ -609,7 +613,7 @@ pgstat_unlock_entry(PgStat_EntryRef *entry_ref)
  * Helper function to fetch and lock shared stats.
  */
 PgStat_EntryRef *
-pgstat_get_entry_ref_locked(PgStat_Kind kind, Oid dboid, Oid objoid,
+pgstat_get_entry_ref_locked(PgStat_Kind kind, Oid dboid, uint64 objoid,
 							bool nowait)
 {
 	PgStat_EntryRef *entry_ref;
@@ -855,7 +859,7 @@ pgstat_drop_database_and_contents(Oid dboid)
 }
 
 bool
-pgstat_drop_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
+pgstat_drop_entry(PgStat_Kind kind, Oid dboid, uint64 objoid)
 {
 	PgStat_HashKey key = {.kind = kind,.dboid = dboid,.objoid = objoid};
 	PgStatShared_HashEntry *shent;
@@ -893,6 +897,17 @@ pgstat_drop_entry(PgStat_Kind kind, Oid dboid, Oid objoid)
 
 void
 pgstat_drop_all_entries(void)
+{
+	pgstat_drop_matching_entries(NULL, 0);
+}
+
+/*
+ * Drop all entries for which do_drop returns true, or all entries if do_drop
+ * is NULL.  Local references to them, and any pending stats, are discarded.
+ */
+void
+pgstat_drop_matching_entries(bool (*do_drop) (PgStatShared_HashEntry *, Datum),
+							 Datum match_data)
 {
 	dshash_seq_status hstat;
 	PgStatShared_HashEntry *ps;
@@ -904,6 +919,20 @@ pgstat_drop_all_entries(void)
 		if (ps->dropped)
 			continue;
 
+		if (do_drop != NULL && !do_drop(ps, match_data))
+			continue;
+
+		/* delete local reference */
+		if (pgStatEntryRefHash)
+		{
+			PgStat_EntryRefHashEntry *lohashent =
+				pgstat_entry_ref_hash_lookup(pgStatEntryRefHash, ps->key);
+
+			if (lohashent)
+				pgstat_release_entry_ref(lohashent->key, lohashent->entry_ref,
+										 true);
+		}
+
 		if (!pgstat_drop_entry_internal(ps, &hstat))
 			not_freed_count++;
 	}
@@ -930,7 +959,7 @@ shared_stat_reset_contents(PgStat_Kind kind, PgStatShared_Common *header,
  * Reset one variable-numbered stats entry.
  */
 void
-pgstat_reset_entry(PgStat_Kind kind, Oid dboid, Oid objoid, TimestampTz ts)
+pgstat_reset_entry(PgStat_Kind kind, Oid dboid, uint64 objoid, TimestampTz ts)
 {
 	PgStat_EntryRef *entry_ref;
 
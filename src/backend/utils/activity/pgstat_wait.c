@@ -0,0 +1,167 @@
+/* -------------------------------------------------------------------------
+ *
+ * pgstat_wait.c
+ *	  Implementation of wait event statistics.
+ *
+ * This file contains the implementation of wait event statistics, which are
+ * collected when track_wait_timing is on: for each wait event, how many
+ * times processes waited for it and for how long.  It is kept separate from
+ * pgstat.c to enforce the line between the statistics access / storage
+ * implementation and the details about individual types of statistics.
+ *
+ * pgstat_report_wait_start() and pgstat_report_wait_end() are called in
+ * critical sections and with spinlocks held, so the counting below must not
+ * allocate memory, throw errors or take locks: it only reads the clock and
+ * adds to backend-local arrays, which pgstat_report_stat() flushes.
+ *
+ * Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/activity/pgstat_wait.c
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "portability/instr_time.h"
+#include "utils/pgstat_internal.h"
+#include "utils/wait_event.h"
+
+
+typedef struct PgStat_PendingWait
+{
+	PgStat_Counter counts[PGSTAT_WAIT_NUM_CLASSES][PGSTAT_WAIT_EVENTS_PER_CLASS];
+	instr_time	times[PGSTAT_WAIT_NUM_CLASSES][PGSTAT_WAIT_EVENTS_PER_CLASS];
+} PgStat_PendingWait;
+
+
+/* GUC parameter */
+bool		pgstat_track_wait_timing = false;
+
+static PgStat_PendingWait PendingWaitStats;
+bool		have_waitstats = false;
+
+/* the wait being timed, if any */
+static uint32 timed_wait_event_info = 0;
+static instr_time timed_wait_start;
+
+
+/*
+ * Start timing a wait, for pgstat_report_wait_start().
+ */
+void
+pgstat_count_wait_start(uint32 wait_event_info)
+{
+	timed_wait_event_info = wait_event_info;
+	INSTR_TIME_SET_CURRENT(timed_wait_start);
+}
+
+/*
+ * Count the wait being timed, for pgstat_report_wait_end().
+ *
+ * If track_wait_timing was turned on during the wait, there's nothing to
+ * count: the start of the wait has not been recorded.
+ */
+void
+pgstat_count_wait_end(void)
+{
+	uint32		classid;
+	uint32		eventid;
+	instr_time	now;
+
+	if (timed_wait_event_info == 0)
+		return;
+
+	classid = (timed_wait_event_info >> 24) - 1;
+	eventid = timed_wait_event_info & 0x0000FFFF;
+	timed_wait_event_info = 0;
+
+	if (classid >= PGSTAT_WAIT_NUM_CLASSES ||
+		eventid >= PGSTAT_WAIT_EVENTS_PER_CLASS)
+		return;
+
+	INSTR_TIME_SET_CURRENT(now);
+	INSTR_TIME_ACCUM_DIFF(PendingWaitStats.times[classid][eventid],
+						  now, timed_wait_start);
+	PendingWaitStats.counts[classid][eventid]++;
+
+	have_waitstats = true;
+}
+
+/*
+ * Support function for the SQL-callable pgstat* functions. Returns
+ * a pointer to the wait event statistics struct.
+ */
+PgStat_WaitStats *
+pgstat_fetch_stat_wait(void)
+{
+	pgstat_snapshot_fixed(PGSTAT_KIND_WAIT);
+
+	return &pgStatLocal.snapshot.wait;
+}
+
+/*
+ * Flush out locally pending wait event statistics
+ *
+ * If no stats have been recorded, this function returns false.
+ *
+ * If nowait is true, this function returns true if the lock could not be
+ * acquired. Otherwise, return false.
+ */
+bool
+pgstat_flush_wait(bool nowait)
+{
+	PgStatShared_Wait *stats_shmem = &pgStatLocal.shmem->wait;
+
+	if (!have_waitstats)
+		return false;
+
+	if (!nowait)
+		LWLockAcquire(&stats_shmem->lock, LW_EXCLUSIVE);
+	else if (!LWLockConditionalAcquire(&stats_shmem->lock, LW_EXCLUSIVE))
+		return true;
+
+	for (int classid = 0; classid < PGSTAT_WAIT_NUM_CLASSES; classid++)
+	{
+		for (int eventid = 0; eventid < PGSTAT_WAIT_EVENTS_PER_CLASS; eventid++)
+		{
+			if (PendingWaitStats.counts[classid][eventid] == 0)
+				continue;
+
+			stats_shmem->stats.counts[classid][eventid] +=
+				PendingWaitStats.counts[classid][eventid];
+			stats_shmem->stats.times[classid][eventid] +=
+				INSTR_TIME_GET_MICROSEC(PendingWaitStats.times[classid][eventid]);
+		}
+	}
+
+	LWLockRelease(&stats_shmem->lock);
+
+	memset(&PendingWaitStats, 0, sizeof(PendingWaitStats));
+
+	have_waitstats = false;
+
+	return false;
+}
+
+void
+pgstat_wait_reset_all_cb(TimestampTz ts)
+{
+	PgStatShared_Wait *stats_shmem = &pgStatLocal.shmem->wait;
+
+	LWLockAcquire(&stats_shmem->lock, LW_EXCLUSIVE);
+	memset(&stats_shmem->stats, 0, sizeof(stats_shmem->stats));
+	stats_shmem->stats.stat_reset_timestamp = ts;
+	LWLockRelease(&stats_shmem->lock);
+}
+
+void
+pgstat_wait_snapshot_cb(void)
+{
+	PgStatShared_Wait *stats_shmem = &pgStatLocal.shmem->wait;
+
+	LWLockAcquire(&stats_shmem->lock, LW_SHARED);
+	memcpy(&pgStatLocal.snapshot.wait, &stats_shmem->stats,
+		   sizeof(pgStatLocal.snapshot.wait));
+	LWLockRelease(&stats_shmem->lock);
+}
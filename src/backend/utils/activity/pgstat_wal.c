@@ -8,6 +8,12 @@
  * storage implementation and the details about individual types of
  * statistics.
  *
+ * Besides the cluster-wide totals, the WAL volume is broken down by resource
+ * manager and by relation.  Each record is charged to the relation of its
+ * first block reference; records without one only show up in the totals.
+ * Per-relation stats are keyed by database and relfilenumber, as that's all
+ * XLogInsert() knows, and the relation's OID can't be looked up from there.
+ *
  * Copyright (c) 2001-2023, PostgreSQL Global Development Group
  *
  * IDENTIFICATION
@@ -17,10 +23,32 @@
 
 #include "postgres.h"
 
+#include "common/hashfn.h"
 #include "utils/pgstat_internal.h"
 #include "executor/instrument.h"
 
 
+/*
+ * Per-relation WAL counts not yet flushed.  They're accumulated while WAL is
+ * being inserted, usually in a critical section, so this has to be a
+ * fixed-size table that needs no memory allocation.  Once counted, a slot
+ * keeps its key until all slots have been flushed, so that open addressing
+ * doesn't lose track of keys behind it.  WAL for relations that don't fit
+ * before the next flush is only reflected in the totals.
+ */
+#define PGSTAT_WAL_RELATION_SLOTS	256
+
+typedef struct PgStat_PendingWalRelation
+{
+	bool		used;
+	Oid			dboid;
+	RelFileNumber relnumber;
+	PgStat_WalCounts counts;
+} PgStat_PendingWalRelation;
+
+static PgStat_PendingWalRelation PendingWalRelations[PGSTAT_WAL_RELATION_SLOTS];
+static bool have_walrelstats = false;
+
 PgStat_PendingWalStats PendingWalStats = {0};
 
 /*
@@ -59,6 +87,143 @@ pgstat_report_wal(bool force)
 	pgstat_flush_io(nowait);
 }
 
+/*
+ * Find or make the pending slot for a relation.  Returns NULL if the table
+ * is full.
+ */
+static PgStat_PendingWalRelation *
+pgstat_wal_relation_slot(Oid dboid, RelFileNumber relnumber, bool create)
+{
+	uint32		hash = hash_combine(murmurhash32(relnumber), dboid);
+
+	for (int i = 0; i < PGSTAT_WAL_RELATION_SLOTS; i++)
+	{
+		PgStat_PendingWalRelation *slot;
+
+		slot = &PendingWalRelations[(hash + i) % PGSTAT_WAL_RELATION_SLOTS];
+		if (!slot->used)
+		{
+			if (!create)
+				return NULL;
+			slot->used = true;
+			slot->dboid = dboid;
+			slot->relnumber = relnumber;
+			return slot;
+		}
+		if (slot->relnumber == relnumber && slot->dboid == dboid)
+			return slot;
+	}
+
+	return NULL;
+}
+
+/*
+ * Charge a WAL record of the given size to a relation.
+ *
+ * Called from XLogInsert(), so this mustn't allocate memory or throw errors.
+ */
+void
+pgstat_count_wal_relation(const RelFileLocator *rlocator, uint32 bytes,
+						  int fpi)
+{
+	PgStat_PendingWalRelation *slot;
+
+	slot = pgstat_wal_relation_slot(rlocator->dbOid, rlocator->relNumber,
+									true);
+	if (slot == NULL)
+		return;
+
+	slot->counts.wal_records++;
+	slot->counts.wal_fpi += fpi;
+	slot->counts.wal_bytes += bytes;
+	have_walrelstats = true;
+}
+
+/*
+ * Drop the WAL stats of a relation file that's being unlinked.  The relation
+ * might have been created and dropped since the last flush, so forget about
+ * any not yet flushed counts too.
+ */
+void
+pgstat_drop_wal_relation(const RelFileLocator *rlocator)
+{
+	PgStat_PendingWalRelation *slot;
+
+	slot = pgstat_wal_relation_slot(rlocator->dbOid, rlocator->relNumber,
+									false);
+	if (slot != NULL)
+		memset(&slot->counts, 0, sizeof(slot->counts));
+
+	pgstat_drop_entry(PGSTAT_KIND_WALRELATION, rlocator->dbOid,
+					  rlocator->relNumber);
+}
+
+/*
+ * Support function for the SQL-callable pgstat* functions. Returns
+ * the collected WAL statistics for one relation file or NULL.
+ */
+PgStat_StatWalRelEntry *
+pgstat_fetch_stat_wal_relation(Oid dboid, RelFileNumber relnumber)
+{
+	return (PgStat_StatWalRelEntry *)
+		pgstat_fetch_entry(PGSTAT_KIND_WALRELATION, dboid, relnumber);
+}
+
+/*
+ * Flush out the pending per-relation WAL stats.
+ *
+ * If nowait is true, this function returns true if some of the stats could
+ * not be flushed because of lock contention.
+ */
+static bool
+pgstat_flush_wal_relations(bool nowait)
+{
+	bool		have_pending = false;
+
+	if (!have_walrelstats)
+		return false;
+
+	for (int i = 0; i < PGSTAT_WAL_RELATION_SLOTS; i++)
+	{
+		PgStat_PendingWalRelation *slot = &PendingWalRelations[i];
+		PgStat_EntryRef *entry_ref;
+		PgStatShared_WalRelation *shwalrelent;
+
+		if (!slot->used || slot->counts.wal_records == 0)
+			continue;
+
+		entry_ref = pgstat_get_entry_ref_locked(PGSTAT_KIND_WALRELATION,
+												slot->dboid, slot->relnumber,
+												nowait);
+		if (entry_ref == NULL)
+		{
+			have_pending = true;
+			continue;
+		}
+		shwalrelent = (PgStatShared_WalRelation *) entry_ref->shared_stats;
+
+#define WALRELSTAT_ACC(fld) \
+	(shwalrelent->stats.counts.fld += slot->counts.fld)
+		WALRELSTAT_ACC(wal_records);
+		WALRELSTAT_ACC(wal_fpi);
+		WALRELSTAT_ACC(wal_bytes);
+#undef WALRELSTAT_ACC
+
+		pgstat_unlock_entry(entry_ref);
+
+		memset(&slot->counts, 0, sizeof(slot->counts));
+	}
+
+	if (have_pending)
+		return true;
+
+	/* all flushed, so the keys can go too */
+	MemSet(PendingWalRelations, 0, sizeof(PendingWalRelations));
+	have_walrelstats = false;
+
+	return false;
+}
+
 /*
  * Support function for the SQL-callable pgstat* functions. Returns
  * a pointer to the WAL statistics struct.
@@ -83,6 +248,7 @@ pgstat_flush_wal(bool nowait)
 {
 	PgStatShared_Wal *stats_shmem = &pgStatLocal.shmem->wal;
 	WalUsage	wal_usage_diff = {0};
+	bool		partial_flush;
 
 	Assert(IsUnderPostmaster || !IsPostmasterEnvironment);
 	Assert(pgStatLocal.shmem != NULL &&
@@ -95,6 +261,8 @@ pgstat_flush_wal(bool nowait)
 	if (!pgstat_have_pending_wal())
 		return false;
 
+	partial_flush = pgstat_flush_wal_relations(nowait);
+
 	/*
 	 * We don't update the WAL usage portion of the local WalStats elsewhere.
 	 * Calculate how much WAL usage counters were increased by subtracting the
@@ -115,10 +283,18 @@ pgstat_flush_wal(bool nowait)
 	WALSTAT_ACC(wal_fpi, wal_usage_diff);
 	WALSTAT_ACC(wal_bytes, wal_usage_diff);
 	WALSTAT_ACC(wal_buffers_full, PendingWalStats);
+	WALSTAT_ACC(wal_buffers_init, PendingWalStats);
+	WALSTAT_ACC(wal_segments_created, PendingWalStats);
 	WALSTAT_ACC(wal_write, PendingWalStats);
 	WALSTAT_ACC(wal_sync, PendingWalStats);
 	WALSTAT_ACC_INSTR_TIME(wal_write_time);
 	WALSTAT_ACC_INSTR_TIME(wal_sync_time);
+	for (int rmid = 0; rmid < RM_N_IDS; rmid++)
+	{
+		WALSTAT_ACC(rmgrs[rmid].wal_records, PendingWalStats);
+		WALSTAT_ACC(rmgrs[rmid].wal_fpi, PendingWalStats);
+		WALSTAT_ACC(rmgrs[rmid].wal_bytes, PendingWalStats);
+	}
 #undef WALSTAT_ACC_INSTR_TIME
 #undef WALSTAT_ACC
 
@@ -134,7 +310,7 @@ pgstat_flush_wal(bool nowait)
 	 */
 	MemSet(&PendingWalStats, 0, sizeof(PendingWalStats));
 
-	return false;
+	return partial_flush;
 }
 
 void
@@ -160,7 +336,8 @@ pgstat_have_pending_wal(void)
 {
 	return pgWalUsage.wal_records != prevWalUsage.wal_records ||
 		PendingWalStats.wal_write != 0 ||
-		PendingWalStats.wal_sync != 0;
+		PendingWalStats.wal_sync != 0 ||
+		have_walrelstats;
 }
 
 void
@@ -174,6 +351,12 @@ pgstat_wal_reset_all_cb(TimestampTz ts)
 	LWLockRelease(&stats_shmem->lock);
 }
 
+void
+pgstat_wal_relation_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts)
+{
+	((PgStatShared_WalRelation *) header)->stats.stat_reset_timestamp = ts;
+}
+
 void
 pgstat_wal_snapshot_cb(void)
 {
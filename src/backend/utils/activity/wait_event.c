@@ -233,6 +233,9 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN:
 			event_name = "LogicalParallelApplyMain";
 			break;
+		case WAIT_EVENT_PARALLEL_WORKER_POOL_MAIN:
+			event_name = "ParallelWorkerPoolMain";
+			break;
 		case WAIT_EVENT_RECOVERY_WAL_STREAM:
 			event_name = "RecoveryWalStream";
 			break;
@@ -322,6 +325,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_BACKEND_TERMINATION:
 			event_name = "BackendTermination";
 			break;
+		case WAIT_EVENT_BACKUP_WAIT_PARALLEL_WORKERS:
+			event_name = "BackupWaitParallelWorkers";
+			break;
 		case WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE:
 			event_name = "BackupWaitWalArchive";
 			break;
@@ -346,6 +352,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_EXECUTE_GATHER:
 			event_name = "ExecuteGather";
 			break;
+		case WAIT_EVENT_HASH_AGG_PARTITION:
+			event_name = "HashAggPartition";
+			break;
 		case WAIT_EVENT_HASH_BATCH_ALLOCATE:
 			event_name = "HashBatchAllocate";
 			break;
@@ -403,6 +412,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_LOGICAL_SYNC_STATE_CHANGE:
 			event_name = "LogicalSyncStateChange";
 			break;
+		case WAIT_EVENT_MEMORY_CONTEXT_PUBLISH:
+			event_name = "MemoryContextPublish";
+			break;
 		case WAIT_EVENT_MQ_INTERNAL:
 			event_name = "MessageQueueInternal";
 			break;
@@ -424,6 +436,15 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_PARALLEL_FINISH:
 			event_name = "ParallelFinish";
 			break;
+		case WAIT_EVENT_PARALLEL_REDO_BARRIER:
+			event_name = "ParallelRedoBarrier";
+			break;
+		case WAIT_EVENT_PARALLEL_SORT_PLAN:
+			event_name = "ParallelSortPlan";
+			break;
+		case WAIT_EVENT_PARALLEL_SORT_RANGE:
+			event_name = "ParallelSortRange";
+			break;
 		case WAIT_EVENT_PROCARRAY_GROUP_UPDATE:
 			event_name = "ProcArrayGroupUpdate";
 			break;
@@ -460,6 +481,9 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_SYNC_REP:
 			event_name = "SyncRep";
 			break;
+		case WAIT_EVENT_WAL_FLUSH_GROUP:
+			event_name = "WalFlushGroup";
+			break;
 		case WAIT_EVENT_WAL_RECEIVER_EXIT:
 			event_name = "WalReceiverExit";
 			break;
@@ -491,6 +515,9 @@ pgstat_get_wait_timeout(WaitEventTimeout w)
 		case WAIT_EVENT_BASE_BACKUP_THROTTLE:
 			event_name = "BaseBackupThrottle";
 			break;
+		case WAIT_EVENT_CHECKPOINT_SYNC_DELAY:
+			event_name = "CheckpointSyncDelay";
+			break;
 		case WAIT_EVENT_CHECKPOINT_WRITE_DELAY:
 			event_name = "CheckpointWriteDelay";
 			break;
@@ -534,6 +561,15 @@ pgstat_get_wait_io(WaitEventIO w)
 
 	switch (w)
 	{
+		case WAIT_EVENT_AIO_IO_COMPLETION:
+			event_name = "AioIoCompletion";
+			break;
+		case WAIT_EVENT_AUTOPREWARM_DUMP_READ:
+			event_name = "AutoprewarmDumpRead";
+			break;
+		case WAIT_EVENT_AUTOPREWARM_DUMP_WRITE:
+			event_name = "AutoprewarmDumpWrite";
+			break;
 		case WAIT_EVENT_BASEBACKUP_READ:
 			event_name = "BaseBackupRead";
 			break;
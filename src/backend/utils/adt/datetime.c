@@ -65,6 +65,11 @@ static bool AdjustDays(int64 val, int scale,
 static bool AdjustMonths(int64 val, struct pg_itm_in *itm_in);
 static bool AdjustYears(int64 val, int scale,
 						struct pg_itm_in *itm_in);
+static int	next_dst_boundary_cached(pg_time_t t,
+									 long int *before_gmtoff, int *before_isdst,
+									 pg_time_t *boundary,
+									 long int *after_gmtoff, int *after_isdst,
+									 pg_tz *tzp);
 static int	DetermineTimeZoneOffsetInternal(struct pg_tm *tm, pg_tz *tzp,
 											pg_time_t *tp);
 static bool DetermineTimeZoneAbbrevOffsetInternal(pg_time_t t,
@@ -949,6 +954,128 @@ ParseDateTime(const char *timestr, char *workbuf, size_t buflen,
 }
 
 
+/* DecodeISO8601DateTime()
+ * Fast path for the most common input format, as produced by COPY TO and by
+ * the ISO DateStyle:
+ *				"YYYY-MM-DD HH:MM:SS[.ffffff][{+|-}HH[[:]MM]]"
+ * with a space or 'T' between date and time.  Fields are extracted at fixed
+ * positions, without tokenizing the string as ParseDateTime does.
+ *
+ * Returns true and fills *tm and *fsec if str is in exactly that format with
+ * all fields in range; if tzp isn't NULL, *tzp is set to the given UTC offset
+ * or, lacking one, to the offset of the session timezone, as DecodeDateTime
+ * does.  Returns false for anything else, including valid input this does
+ * not handle (leap seconds, 24:00:00, more than six fractional digits, zone
+ * names), in which case the caller must use the general parser.
+ */
+bool
+DecodeISO8601DateTime(const char *str, struct pg_tm *tm, fsec_t *fsec,
+					  int *tzp)
+{
+	const char *cp = str;
+	int			tz;
+	bool		have_tz = false;
+
+#define ISO_DIGIT(c) ((unsigned char) ((c) - '0') <= 9)
+#define ISO_2DIGITS(p) (((p)[0] - '0') * 10 + ((p)[1] - '0'))
+
+	/* YYYY-MM-DD */
+	if (!ISO_DIGIT(cp[0]) || !ISO_DIGIT(cp[1]) ||
+		!ISO_DIGIT(cp[2]) || !ISO_DIGIT(cp[3]) || cp[4] != '-' ||
+		!ISO_DIGIT(cp[5]) || !ISO_DIGIT(cp[6]) || cp[7] != '-' ||
+		!ISO_DIGIT(cp[8]) || !ISO_DIGIT(cp[9]) ||
+		(cp[10] != ' ' && cp[10] != 'T'))
+		return false;
+	tm->tm_year = ISO_2DIGITS(cp) * 100 + ISO_2DIGITS(cp + 2);
+	tm->tm_mon = ISO_2DIGITS(cp + 5);
+	tm->tm_mday = ISO_2DIGITS(cp + 8);
+	if (tm->tm_year < 1 || tm->tm_mon < 1 || tm->tm_mon > MONTHS_PER_YEAR ||
+		tm->tm_mday < 1 ||
+		tm->tm_mday > day_tab[isleap(tm->tm_year)][tm->tm_mon - 1])
+		return false;
+	cp += 11;
+
+	/* HH:MM:SS */
+	if (!ISO_DIGIT(cp[0]) || !ISO_DIGIT(cp[1]) || cp[2] != ':' ||
+		!ISO_DIGIT(cp[3]) || !ISO_DIGIT(cp[4]) || cp[5] != ':' ||
+		!ISO_DIGIT(cp[6]) || !ISO_DIGIT(cp[7]))
+		return false;
+	tm->tm_hour = ISO_2DIGITS(cp);
+	tm->tm_min = ISO_2DIGITS(cp + 3);
+	tm->tm_sec = ISO_2DIGITS(cp + 6);
+	if (tm->tm_hour >= HOURS_PER_DAY || tm->tm_min >= MINS_PER_HOUR ||
+		tm->tm_sec >= SECS_PER_MINUTE)
+		return false;
+	cp += 8;
+
+	/* .ffffff */
+	*fsec = 0;
+	if (*cp == '.')
+	{
+		int			ndigits = 0;
+
+		cp++;
+		while (ISO_DIGIT(*cp))
+		{
+			if (++ndigits > 6)
+				return false;
+			*fsec = *fsec * 10 + (*cp++ - '0');
+		}
+		if (ndigits == 0)
+			return false;
+		while (ndigits++ < 6)
+			*fsec *= 10;
+	}
+
+	/* {+|-}HH[[:]MM] */
+	if (*cp == '+' || *cp == '-')
+	{
+		char		sign = *cp++;
+		int			hr,
+					min = 0;
+
+		if (!ISO_DIGIT(cp[0]) || !ISO_DIGIT(cp[1]))
+			return false;
+		hr = ISO_2DIGITS(cp);
+		cp += 2;
+		if (*cp == ':')
+			cp++;
+		if (ISO_DIGIT(cp[0]) && ISO_DIGIT(cp[1]))
+		{
+			min = ISO_2DIGITS(cp);
+			cp += 2;
+		}
+		else if (cp[-1] == ':')
+			return false;
+		if (hr > MAX_TZDISP_HOUR || min >= MINS_PER_HOUR)
+			return false;
+
+		/* our convention is positive west of Greenwich, see DecodeTimezone */
+		tz = (hr * MINS_PER_HOUR + min) * SECS_PER_MINUTE;
+		if (sign == '+')
+			tz = -tz;
+		have_tz = true;
+	}
+
+	if (*cp != '\0')
+		return false;
+
+#undef ISO_DIGIT
+#undef ISO_2DIGITS
+
+	tm->tm_isdst = -1;
+	if (tzp != NULL)
+	{
+		if (have_tz)
+			*tzp = tz;
+		else
+			*tzp = DetermineTimeZoneOffset(tm, session_timezone);
+	}
+
+	return true;
+}
+
+
 /* DecodeDateTime()
  * Interpret previously parsed fields for general date and time.
  * Return 0 if full date, 1 if only time, and negative DTERR code if problems.
@@ -1571,6 +1698,81 @@ DecodeDateTime(char **field, int *ftype, int nf,
 }
 
 
+/* next_dst_boundary_cached()
+ *
+ * pg_next_dst_boundary(), remembering its last result for the session
+ * timezone.  The result is the same for all times from the one it was asked
+ * for up to the boundary it returned, or for all later times if it found no
+ * boundary; so a run of nearby local times, as in a COPY of a timestamptz
+ * column, only consults the zone data when it crosses a DST transition.
+ *
+ * Only the session timezone is cached, since it comes from pg_tzset() and
+ * so stays valid for the life of the process; see pg_tzenumerate_next() for
+ * a pg_tz that does not.
+ */
+static int
+next_dst_boundary_cached(pg_time_t t,
+						 long int *before_gmtoff, int *before_isdst,
+						 pg_time_t *boundary,
+						 long int *after_gmtoff, int *after_isdst,
+						 pg_tz *tzp)
+{
+	static pg_tz *cached_tz = NULL;
+	static int	cached_res;
+	static pg_time_t cached_lo;
+	static pg_time_t cached_boundary;
+	static long int cached_before_gmtoff;
+	static int	cached_before_isdst;
+	static long int cached_after_gmtoff;
+	static int	cached_after_isdst;
+	int			res;
+
+	if (tzp == cached_tz && t >= cached_lo &&
+		(cached_res == 0 || t < cached_boundary))
+	{
+		*before_gmtoff = cached_before_gmtoff;
+		*before_isdst = cached_before_isdst;
+		*boundary = cached_boundary;
+		*after_gmtoff = cached_after_gmtoff;
+		*after_isdst = cached_after_isdst;
+		return cached_res;
+	}
+
+	res = pg_next_dst_boundary(&t, before_gmtoff, before_isdst,
+							   boundary, after_gmtoff, after_isdst, tzp);
+	if (res < 0 || tzp != session_timezone)
+		return res;
+
+	if (tzp == cached_tz && res == cached_res && t < cached_lo &&
+		(res == 0 || *boundary == cached_boundary))
+	{
+		/* same stretch between transitions, reached from further back */
+		cached_lo = t;
+		return res;
+	}
+
+	cached_tz = tzp;
+	cached_res = res;
+	cached_lo = t;
+	cached_before_gmtoff = *before_gmtoff;
+	cached_before_isdst = *before_isdst;
+	if (res > 0)
+	{
+		cached_boundary = *boundary;
+		cached_after_gmtoff = *after_gmtoff;
+		cached_after_isdst = *after_isdst;
+	}
+	else
+	{
+		cached_boundary = 0;
+		cached_after_gmtoff = 0;
+		cached_after_isdst = 0;
+	}
+
+	return res;
+}
+
+
 /* DetermineTimeZoneOffset()
  *
  * Given a struct pg_tm in which tm_year, tm_mon, tm_mday, tm_hour, tm_min,
@@ -1651,11 +1853,11 @@ DetermineTimeZoneOffsetInternal(struct pg_tm *tm, pg_tz *tzp, pg_time_t *tp)
 	if (mytime < 0 && prevtime > 0)
 		goto overflow;
 
-	res = pg_next_dst_boundary(&prevtime,
-							   &before_gmtoff, &before_isdst,
-							   &boundary,
-							   &after_gmtoff, &after_isdst,
-							   tzp);
+	res = next_dst_boundary_cached(prevtime,
+								   &before_gmtoff, &before_isdst,
+								   &boundary,
+								   &after_gmtoff, &after_isdst,
+								   tzp);
 	if (res < 0)
 		goto overflow;			/* failure? */
 
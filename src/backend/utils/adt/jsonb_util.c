@@ -13,6 +13,7 @@
  */
 #include "postgres.h"
 
+#include "access/detoast.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_type.h"
 #include "common/hashfn.h"
@@ -25,6 +26,7 @@
 #include "utils/jsonb.h"
 #include "utils/memutils.h"
 #include "utils/varlena.h"
+#include "varatt.h"
 
 /*
  * Maximum number of elements in an array (or key/value pairs in an object).
@@ -38,6 +40,8 @@
 #define JSONB_MAX_ELEMS (Min(MaxAllocSize / sizeof(JsonbValue), JB_CMASK))
 #define JSONB_MAX_PAIRS (Min(MaxAllocSize / sizeof(JsonbPair), JB_CMASK))
 
+static int	findJsonbKeyIndex(JsonbContainer *container,
+							  const char *keyVal, int keyLen);
 static void fillJsonbValue(JsonbContainer *container, int index,
 						   char *base_addr, uint32 offset,
 						   JsonbValue *result);
@@ -400,11 +404,8 @@ JsonbValue *
 getKeyJsonValueFromContainer(JsonbContainer *container,
 							 const char *keyVal, int keyLen, JsonbValue *res)
 {
-	JEntry	   *children = container->children;
 	int			count = JsonContainerSize(container);
-	char	   *baseAddr;
-	uint32		stopLow,
-				stopHigh;
+	int			index;
 
 	Assert(JsonContainerIsObject(container));
 
@@ -412,6 +413,124 @@ getKeyJsonValueFromContainer(JsonbContainer *container,
 	if (count <= 0)
 		return NULL;
 
+	index = findJsonbKeyIndex(container, keyVal, keyLen);
+	if (index < 0)
+		return NULL;
+
+	/* Found our key, return corresponding value */
+	index += count;
+
+	if (!res)
+		res = palloc(sizeof(JsonbValue));
+
+	fillJsonbValue(container, index, (char *) (container->children + count * 2),
+				   getJsonbOffset(container, index),
+				   res);
+
+	return res;
+}
+
+/*
+ * Find value by key in the root object of a jsonb datum, like
+ * getKeyJsonValueFromContainer(), but without detoasting more of the datum
+ * than the search reads, if it is stored out of line and uncompressed.  The
+ * root's JEntries and keys are fetched first, and then the value found, so
+ * reading one key of a large document only fetches the TOAST chunks
+ * covering those.
+ *
+ * Returns false if the datum isn't stored that way or its root isn't an
+ * object, and the caller must detoast it and search it as usual.  Otherwise,
+ * returns true, and sets *found, and 'res' if the key was found.  Strings,
+ * numerics and containers in 'res' point into memory palloc'd here.
+ */
+bool
+getKeyJsonValueFromToast(struct varlena *attr, const char *keyVal,
+						 int keyLen, JsonbValue *res, bool *found)
+{
+	struct varatt_external toast_pointer;
+	struct varlena *slice;
+	struct varlena *value;
+	JsonbContainer *container;
+	uint32		header;
+	int			count;
+	int32		base_off;
+	int32		start;
+	uint32		offset;
+	int			index;
+
+	if (!VARATT_IS_EXTERNAL_ONDISK(attr))
+		return false;
+	VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+	if (VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+		return false;
+
+	/* the root container's header */
+	slice = detoast_attr_slice(attr, 0, sizeof(uint32));
+	if (VARSIZE(slice) - VARHDRSZ < sizeof(uint32))
+		elog(ERROR, "invalid jsonb datum");
+	memcpy(&header, VARDATA(slice), sizeof(uint32));
+	pfree(slice);
+
+	if ((header & JB_FOBJECT) == 0)
+		return false;
+
+	*found = false;
+	count = header & JB_CMASK;
+	if (count == 0)
+		return true;
+
+	/* its JEntries, to learn the length of the keys, and then the keys */
+	base_off = offsetof(JsonbContainer, children) + count * 2 * sizeof(JEntry);
+	slice = detoast_attr_slice(attr, 0, base_off);
+	container = (JsonbContainer *) VARDATA(slice);
+	offset = getJsonbOffset(container, count);
+	pfree(slice);
+
+	slice = detoast_attr_slice(attr, 0, base_off + offset);
+	container = (JsonbContainer *) VARDATA(slice);
+
+	index = findJsonbKeyIndex(container, keyVal, keyLen);
+	if (index < 0)
+	{
+		pfree(slice);
+		return true;
+	}
+	index += count;
+	offset = getJsonbOffset(container, index);
+
+	/*
+	 * Finally the value.  The slice starts at an int-aligned offset from the
+	 * start of the values, so that the alignment of numerics and containers,
+	 * which is relative to that, is kept.
+	 */
+	start = base_off + INTALIGN_DOWN(offset);
+	value = detoast_attr_slice(attr, start,
+							   base_off + offset +
+							   getJsonbLength(container, index) - start);
+
+	fillJsonbValue(container, index, VARDATA(value) - (start - base_off),
+				   offset, res);
+	*found = true;
+
+	pfree(slice);
+
+	return true;
+}
+
+/*
+ * Binary search an object container for a key.  Returns the index of the
+ * key, or -1 if it isn't there; the value's index is that plus the number of
+ * pairs.  Only the JEntries and the keys of the container are read.
+ */
+static int
+findJsonbKeyIndex(JsonbContainer *container, const char *keyVal, int keyLen)
+{
+	JEntry	   *children = container->children;
+	int			count = JsonContainerSize(container);
+	char	   *baseAddr;
+	uint32		stopLow,
+				stopHigh;
+
 	/*
 	 * Binary search the container. Since we know this is an object, account
 	 * for *Pairs* of Jentrys
@@ -435,19 +554,7 @@ getKeyJsonValueFromContainer(JsonbContainer *container,
 											  keyVal, keyLen);
 
 		if (difference == 0)
-		{
-			/* Found our key, return corresponding value */
-			int			index = stopMiddle + count;
-
-			if (!res)
-				res = palloc(sizeof(JsonbValue));
-
-			fillJsonbValue(container, index, baseAddr,
-						   getJsonbOffset(container, index),
-						   res);
-
-			return res;
-		}
+			return stopMiddle;
 		else
 		{
 			if (difference < 0)
@@ -458,7 +565,7 @@ getKeyJsonValueFromContainer(JsonbContainer *container,
 	}
 
 	/* Not found */
-	return NULL;
+	return -1;
 }
 
 /*
@@ -850,10 +850,24 @@ json_object_field(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Datum		jsonb = PG_GETARG_DATUM(0);
 	text	   *key = PG_GETARG_TEXT_PP(1);
+	Jsonb	   *jb;
 	JsonbValue *v;
 	JsonbValue	vbuf;
+	bool		found;
+
+	/* fetch only the part of a large value we need, if we can */
+	if (getKeyJsonValueFromToast((struct varlena *) DatumGetPointer(jsonb),
+								 VARDATA_ANY(key), VARSIZE_ANY_EXHDR(key),
+								 &vbuf, &found))
+	{
+		if (found)
+			PG_RETURN_JSONB_P(JsonbValueToJsonb(&vbuf));
+		PG_RETURN_NULL();
+	}
+
+	jb = DatumGetJsonbP(jsonb);
 
 	if (!JB_ROOT_IS_OBJECT(jb))
 		PG_RETURN_NULL();
@@ -888,10 +902,24 @@ json_object_field_text(PG_FUNCTION_ARGS)
 Datum
 jsonb_object_field_text(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Datum		jsonb = PG_GETARG_DATUM(0);
 	text	   *key = PG_GETARG_TEXT_PP(1);
+	Jsonb	   *jb;
 	JsonbValue *v;
 	JsonbValue	vbuf;
+	bool		found;
+
+	/* fetch only the part of a large value we need, if we can */
+	if (getKeyJsonValueFromToast((struct varlena *) DatumGetPointer(jsonb),
+								 VARDATA_ANY(key), VARSIZE_ANY_EXHDR(key),
+								 &vbuf, &found))
+	{
+		if (found && vbuf.type != jbvNull)
+			PG_RETURN_TEXT_P(JsonbValueAsText(&vbuf));
+		PG_RETURN_NULL();
+	}
+
+	jb = DatumGetJsonbP(jsonb);
 
 	if (!JB_ROOT_IS_OBJECT(jb))
 		PG_RETURN_NULL();
@@ -1487,7 +1515,7 @@ jsonb_extract_path_text(PG_FUNCTION_ARGS)
 static Datum
 get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Datum		jsonb = PG_GETARG_DATUM(0);
 	ArrayType  *path = PG_GETARG_ARRAYTYPE_P(1);
 	Datum	   *pathtext;
 	bool	   *pathnulls;
@@ -1507,7 +1535,47 @@ get_jsonb_path_all(FunctionCallInfo fcinfo, bool as_text)
 
 	deconstruct_array_builtin(path, TEXTOID, &pathtext, &pathnulls, &npath);
 
-	res = jsonb_get_element(jb, pathtext, npath, &isnull, as_text);
+	/*
+	 * If the first key can be looked up without detoasting the whole value,
+	 * walk the rest of the path from the value found.
+	 */
+	if (npath > 0)
+	{
+		text	   *subscr = DatumGetTextPP(pathtext[0]);
+		JsonbValue	vbuf;
+		bool		found;
+
+		if (getKeyJsonValueFromToast((struct varlena *) DatumGetPointer(jsonb),
+									 VARDATA_ANY(subscr),
+									 VARSIZE_ANY_EXHDR(subscr),
+									 &vbuf, &found))
+		{
+			if (!found)
+				PG_RETURN_NULL();
+
+			if (npath == 1)
+			{
+				if (!as_text)
+					PG_RETURN_JSONB_P(JsonbValueToJsonb(&vbuf));
+				if (vbuf.type == jbvNull)
+					PG_RETURN_NULL();
+				PG_RETURN_TEXT_P(JsonbValueAsText(&vbuf));
+			}
+
+			/* scalar, extraction yields a null */
+			if (vbuf.type != jbvBinary)
+				PG_RETURN_NULL();
+
+			res = jsonb_get_element(JsonbValueToJsonb(&vbuf),
+									pathtext + 1, npath - 1, &isnull, as_text);
+			if (isnull)
+				PG_RETURN_NULL();
+			PG_RETURN_DATUM(res);
+		}
+	}
+
+	res = jsonb_get_element(DatumGetJsonbP(jsonb), pathtext, npath, &isnull,
+							as_text);
 
 	if (isnull)
 		PG_RETURN_NULL();
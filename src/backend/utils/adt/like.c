@@ -147,6 +147,114 @@ SB_lower_char(unsigned char c, pg_locale_t locale, bool locale_is_c)
 
 #include "like_match.c"
 
+/*
+ * Compare bytes, folding ASCII letters to lower case if fold is true.
+ */
+static inline bool
+like_bytes_equal(const char *a, const char *b, int len, bool fold)
+{
+	if (!fold)
+		return memcmp(a, b, len) == 0;
+
+	for (int i = 0; i < len; i++)
+	{
+		if (pg_ascii_tolower((unsigned char) a[i]) !=
+			pg_ascii_tolower((unsigned char) b[i]))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Fast path for patterns that are a literal, optionally preceded and/or
+ * followed by '%': 'lit', 'lit%', '%lit' and '%lit%'.  These are matched
+ * with memcmp(), or a search for the literal using memchr() to find
+ * candidate positions, instead of the recursive MatchText().  If fold is
+ * true, ASCII letters are compared case-insensitively, as SB_IMatchText()
+ * does in the C locale.
+ *
+ * Returns false if the pattern is not of this form; a pattern containing
+ * '_' or an escape is never treated as one.  Otherwise sets *result to
+ * LIKE_TRUE or LIKE_FALSE.
+ *
+ * Matching bytes is only correct in encodings in which a byte string that
+ * is a valid character sequence can't match at a position that isn't a
+ * character boundary: single-byte encodings and UTF-8.
+ */
+static inline bool
+like_match_literal(const char *s, int slen, const char *p, int plen,
+				   bool fold, int *result)
+{
+	bool		leading = false;
+	bool		trailing = false;
+	const char *lit;
+	int			litlen;
+
+	while (plen > 0 && *p == '%')
+	{
+		leading = true;
+		p++, plen--;
+	}
+	while (plen > 0 && p[plen - 1] == '%')
+	{
+		trailing = true;
+		plen--;
+	}
+
+	lit = p;
+	litlen = plen;
+	for (int i = 0; i < litlen; i++)
+	{
+		if (lit[i] == '%' || lit[i] == '_' || lit[i] == '\\')
+			return false;
+	}
+
+	if (!leading && !trailing)
+		*result = (slen == litlen && like_bytes_equal(s, lit, litlen, fold)) ?
+			LIKE_TRUE : LIKE_FALSE;
+	else if (slen < litlen)
+		*result = LIKE_FALSE;
+	else if (!leading)
+		*result = like_bytes_equal(s, lit, litlen, fold) ?
+			LIKE_TRUE : LIKE_FALSE;
+	else if (!trailing)
+		*result = like_bytes_equal(s + slen - litlen, lit, litlen, fold) ?
+			LIKE_TRUE : LIKE_FALSE;
+	else if (litlen == 0)
+		*result = LIKE_TRUE;
+	else
+	{
+		const char *last = s + slen - litlen;
+		const char *c = s;
+
+		*result = LIKE_FALSE;
+		while (c <= last)
+		{
+			if (!fold)
+			{
+				c = memchr(c, lit[0], last - c + 1);
+				if (c == NULL)
+					break;
+			}
+			else if (pg_ascii_tolower((unsigned char) *c) !=
+					 pg_ascii_tolower((unsigned char) lit[0]))
+			{
+				c++;
+				continue;
+			}
+
+			if (like_bytes_equal(c + 1, lit + 1, litlen - 1, fold))
+			{
+				*result = LIKE_TRUE;
+				break;
+			}
+			c++;
+		}
+	}
+
+	return true;
+}
+
 /* Generic for all cases not requiring inline case-folding */
 static inline int
 GenericMatchText(const char *s, int slen, const char *p, int plen, Oid collation)
@@ -162,9 +270,21 @@ GenericMatchText(const char *s, int slen, const char *p, int plen, Oid collation
 	}
 
 	if (pg_database_encoding_max_length() == 1)
+	{
+		int			result;
+
+		if (like_match_literal(s, slen, p, plen, false, &result))
+			return result;
 		return SB_MatchText(s, slen, p, plen, 0, true);
+	}
 	else if (GetDatabaseEncoding() == PG_UTF8)
+	{
+		int			result;
+
+		if (like_match_literal(s, slen, p, plen, false, &result))
+			return result;
 		return UTF8_MatchText(s, slen, p, plen, 0, true);
+	}
 	else
 		return MB_MatchText(s, slen, p, plen, 0, true);
 }
@@ -226,10 +346,15 @@ Generic_Text_IC_like(text *str, text *pat, Oid collation)
 	}
 	else
 	{
+		int			result;
+
 		p = VARDATA_ANY(pat);
 		plen = VARSIZE_ANY_EXHDR(pat);
 		s = VARDATA_ANY(str);
 		slen = VARSIZE_ANY_EXHDR(str);
+		if (locale_is_c &&
+			like_match_literal(s, slen, p, plen, true, &result))
+			return result;
 		return SB_IMatchText(s, slen, p, plen, locale, locale_is_c);
 	}
 }
@@ -331,14 +456,17 @@ bytealike(PG_FUNCTION_ARGS)
 	char	   *s,
 			   *p;
 	int			slen,
-				plen;
+				plen,
+				match;
 
 	s = VARDATA_ANY(str);
 	slen = VARSIZE_ANY_EXHDR(str);
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (SB_MatchText(s, slen, p, plen, 0, true) == LIKE_TRUE);
+	if (!like_match_literal(s, slen, p, plen, false, &match))
+		match = SB_MatchText(s, slen, p, plen, 0, true);
+	result = (match == LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -352,14 +480,17 @@ byteanlike(PG_FUNCTION_ARGS)
 	char	   *s,
 			   *p;
 	int			slen,
-				plen;
+				plen,
+				match;
 
 	s = VARDATA_ANY(str);
 	slen = VARSIZE_ANY_EXHDR(str);
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
 
-	result = (SB_MatchText(s, slen, p, plen, 0, true) != LIKE_TRUE);
+	if (!like_match_literal(s, slen, p, plen, false, &match))
+		match = SB_MatchText(s, slen, p, plen, 0, true);
+	result = (match != LIKE_TRUE);
 
 	PG_RETURN_BOOL(result);
 }
@@ -20,6 +20,7 @@
 #include "mb/pg_wchar.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "utils/backend_memory.h"
 #include "utils/builtins.h"
 
 /* ----------
@@ -193,3 +194,108 @@ pg_log_backend_memory_contexts(PG_FUNCTION_ARGS)
 
 	PG_RETURN_BOOL(true);
 }
+
+/*
+ * pg_stat_get_backend_memory
+ *		SQL SRF showing the memory allocated by each server process.
+ *
+ * The figures are published by each process in shared memory as it
+ * allocates and frees memory blocks, so this doesn't disturb the processes
+ * being looked at.
+ */
+Datum
+pg_stat_get_backend_memory(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_BACKEND_MEMORY_COLS	2
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			nslots;
+	int			i;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	nslots = BackendMemoryNumSlots();
+	for (i = 0; i < nslots; i++)
+	{
+		Datum		values[PG_STAT_GET_BACKEND_MEMORY_COLS];
+		bool		nulls[PG_STAT_GET_BACKEND_MEMORY_COLS];
+		int			pid;
+		uint64		allocated_bytes;
+
+		if (!BackendMemoryGetSlot(i, &pid, &allocated_bytes))
+			continue;
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int32GetDatum(pid);
+		values[1] = Int64GetDatum((int64) allocated_bytes);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_get_process_memory_contexts
+ *		SQL SRF showing the largest memory contexts of another process.
+ *
+ * The target process is signalled to publish its largest memory contexts in
+ * shared memory, and we wait briefly for it to do so.  Like
+ * pg_log_backend_memory_contexts, this is restricted to superusers by
+ * default.
+ */
+Datum
+pg_get_process_memory_contexts(PG_FUNCTION_ARGS)
+{
+#define PG_GET_PROCESS_MEMORY_CONTEXTS_COLS	5
+	int			pid = PG_GETARG_INT32(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	BackendMemoryContextEntry entries[BACKEND_MEMORY_TOP_CONTEXTS];
+	PGPROC	   *proc;
+	BackendId	backendId = InvalidBackendId;
+	int			n;
+	int			i;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	/* See pg_log_backend_memory_contexts about the use of backendId */
+	proc = BackendPidGetProc(pid);
+	if (proc != NULL)
+		backendId = proc->backendId;
+	else
+		proc = AuxiliaryPidGetProc(pid);
+
+	if (proc == NULL)
+	{
+		ereport(WARNING,
+				(errmsg("PID %d is not a PostgreSQL server process", pid)));
+		return (Datum) 0;
+	}
+
+	n = BackendMemoryRequestContexts(proc, backendId, entries);
+	if (n < 0)
+	{
+		ereport(WARNING,
+				(errmsg("could not get memory contexts of process %d", pid)));
+		return (Datum) 0;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		Datum		values[PG_GET_PROCESS_MEMORY_CONTEXTS_COLS];
+		bool		nulls[PG_GET_PROCESS_MEMORY_CONTEXTS_COLS];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = CStringGetTextDatum(entries[i].name);
+		if (entries[i].ident[0] != '\0')
+			values[1] = CStringGetTextDatum(entries[i].ident);
+		else
+			nulls[1] = true;
+		values[2] = Int32GetDatum(entries[i].level);
+		values[3] = Int64GetDatum(entries[i].total_bytes);
+		values[4] = Int64GetDatum(entries[i].free_bytes);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
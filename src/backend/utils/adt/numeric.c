@@ -102,6 +102,9 @@ typedef signed char NumericDigit;
 typedef int16 NumericDigit;
 #endif
 
+/* NBASE digits needed to hold any int64 */
+#define NUMERIC_INT64_NDIGITS	((19 + DEC_DIGITS - 1) / DEC_DIGITS)
+
 /*
  * The Numeric type as stored on disk.
  *
@@ -517,6 +520,8 @@ static void numericvar_deserialize(StringInfo buf, NumericVar *var);
 static Numeric duplicate_numeric(Numeric num);
 static Numeric make_result(const NumericVar *var);
 static Numeric make_result_opt_error(const NumericVar *var, bool *have_error);
+static Numeric add_sub_int64(const NumericVar *var1, const NumericVar *var2,
+							 bool subtract, bool *have_error);
 
 static bool apply_typmod(NumericVar *var, int32 typmod, Node *escontext);
 static bool apply_typmod_special(Numeric num, int32 typmod, Node *escontext);
@@ -524,6 +529,10 @@ static bool apply_typmod_special(Numeric num, int32 typmod, Node *escontext);
 static bool numericvar_to_int32(const NumericVar *var, int32 *result);
 static bool numericvar_to_int64(const NumericVar *var, int64 *result);
 static void int64_to_numericvar(int64 val, NumericVar *var);
+static bool numericvar_to_scaled_int64(const NumericVar *var, int fracdigits,
+									   int64 *result);
+static void scaled_int64_to_numericvar(int64 val, int fracdigits,
+									   NumericVar *var, NumericDigit *digits);
 static bool numericvar_to_uint64(const NumericVar *var, uint64 *result);
 #ifdef HAVE_INT128
 static bool numericvar_to_int128(const NumericVar *var, int128 *result);
@@ -2899,11 +2908,16 @@ numeric_add_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	}
 
 	/*
-	 * Unpack the values, let add_var() compute the result and return it.
+	 * Unpack the values, let add_var() compute the result and return it,
+	 * unless they are small enough to be added as integers.
 	 */
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
+	res = add_sub_int64(&arg1, &arg2, false, have_error);
+	if (res != NULL)
+		return res;
+
 	init_var(&result);
 	add_var(&arg1, &arg2, &result);
 
@@ -2977,11 +2991,16 @@ numeric_sub_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	}
 
 	/*
-	 * Unpack the values, let sub_var() compute the result and return it.
+	 * Unpack the values, let sub_var() compute the result and return it,
+	 * unless they are small enough to be subtracted as integers.
 	 */
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
+	res = add_sub_int64(&arg1, &arg2, true, have_error);
+	if (res != NULL)
+		return res;
+
 	init_var(&result);
 	sub_var(&arg1, &arg2, &result);
 
@@ -2993,6 +3012,43 @@ numeric_sub_opt_error(Numeric num1, Numeric num2, bool *have_error)
 }
 
 
+/*
+ * add_sub_int64() -
+ *
+ *	Fast path of numeric_add_opt_error() and numeric_sub_opt_error(), for
+ *	finite values that fit in an int64 when scaled to the fractional digits
+ *	of the result, as money amounts and the like do.  The result is computed
+ *	as an integer and packed straight from a local digit buffer, without
+ *	allocating NumericVar work space.  Returns NULL if the values don't
+ *	qualify, or the integer operation overflows.
+ */
+static Numeric
+add_sub_int64(const NumericVar *var1, const NumericVar *var2,
+			  bool subtract, bool *have_error)
+{
+	int			dscale = Max(var1->dscale, var2->dscale);
+	int			fracdigits = (dscale + DEC_DIGITS - 1) / DEC_DIGITS;
+	int64		val1;
+	int64		val2;
+	int64		val;
+	NumericDigit digits[NUMERIC_INT64_NDIGITS];
+	NumericVar	result;
+
+	if (!numericvar_to_scaled_int64(var1, fracdigits, &val1) ||
+		!numericvar_to_scaled_int64(var2, fracdigits, &val2))
+		return NULL;
+
+	if (subtract ? pg_sub_s64_overflow(val1, val2, &val) :
+		pg_add_s64_overflow(val1, val2, &val))
+		return NULL;
+
+	scaled_int64_to_numericvar(val, fracdigits, &result, digits);
+	result.dscale = dscale;
+
+	return make_result_opt_error(&result, have_error);
+}
+
+
 /*
  * numeric_mul() -
  *
@@ -4726,11 +4782,120 @@ typedef struct NumericAggState
 	int64		NaNcount;		/* count of NaN values */
 	int64		pInfcount;		/* count of +Inf values */
 	int64		nInfcount;		/* count of -Inf values */
+#ifdef HAVE_INT128
+
+	/*
+	 * Inputs that fit in an int64 as integers in units of
+	 * NBASE^-pendingFracDigits are summed in these, rather than in sumX and
+	 * sumX2, and numeric_agg_flush() folds them into those before they are
+	 * used.  Only inputs below 2^31 in those units are taken when sumX2 is
+	 * needed, so that their squares fit in an int64 too.  Sums of int64s
+	 * can't overflow an int128 in fewer than 2^63 additions.
+	 */
+	bool		pendingUsed;	/* have any inputs been summed here? */
+	int			pendingFracDigits;	/* NBASE digits after the point */
+	int			pendingDscale;	/* maximum dscale of those inputs */
+	int128		pendingSumX;
+	int128		pendingSumX2;	/* in units of NBASE^-(2*pendingFracDigits) */
+#endif
 } NumericAggState;
 
 #define NA_TOTAL_COUNT(na) \
 	((na)->N + (na)->NaNcount + (na)->pInfcount + (na)->nInfcount)
 
+/*
+ * Fold the integer sums of a numeric aggregate state, if any, into sumX and
+ * sumX2.  This doesn't change the value of the state, so it is done even by
+ * functions that must not modify it, like final functions.
+ */
+static void
+numeric_agg_flush(NumericAggState *state)
+{
+#ifdef HAVE_INT128
+	NumericVar	tmp_var;
+	MemoryContext old_context;
+
+	if (!state->pendingUsed)
+		return;
+
+	init_var(&tmp_var);
+	old_context = MemoryContextSwitchTo(state->agg_context);
+
+	int128_to_numericvar(state->pendingSumX, &tmp_var);
+	if (tmp_var.ndigits > 0)
+		tmp_var.weight -= state->pendingFracDigits;
+	tmp_var.dscale = state->pendingDscale;
+	accum_sum_add(&state->sumX, &tmp_var);
+
+	if (state->calcSumX2)
+	{
+		int128_to_numericvar(state->pendingSumX2, &tmp_var);
+		if (tmp_var.ndigits > 0)
+			tmp_var.weight -= 2 * state->pendingFracDigits;
+		tmp_var.dscale = 2 * state->pendingDscale;
+		accum_sum_add(&state->sumX2, &tmp_var);
+	}
+
+	MemoryContextSwitchTo(old_context);
+	free_var(&tmp_var);
+
+	state->pendingUsed = false;
+	state->pendingDscale = 0;
+	state->pendingSumX = 0;
+	state->pendingSumX2 = 0;
+#endif
+}
+
+#ifdef HAVE_INT128
+/*
+ * Add X to the integer sums of a numeric aggregate state, or subtract it if
+ * discard is true.  Returns false if X does not qualify for this fast path,
+ * in which case the caller must add it to sumX as usual.
+ */
+static bool
+numeric_agg_pending_add(NumericAggState *state, const NumericVar *X,
+						bool discard)
+{
+	int			fracdigits = (X->dscale + DEC_DIGITS - 1) / DEC_DIGITS;
+	int64		val;
+
+	/*
+	 * Inputs with fewer fractional digits are scaled up to the current
+	 * units; one with more needs finer units, which can only be switched to
+	 * once the sums in the current ones have been folded away.
+	 */
+	if (!state->pendingUsed)
+		state->pendingFracDigits = fracdigits;
+	else if (fracdigits > state->pendingFracDigits)
+	{
+		numeric_agg_flush(state);
+		state->pendingFracDigits = fracdigits;
+	}
+
+	if (!numericvar_to_scaled_int64(X, state->pendingFracDigits, &val))
+		return false;
+	if (state->calcSumX2 && (val > PG_INT32_MAX || val < -PG_INT32_MAX))
+		return false;
+
+	if (discard)
+	{
+		state->pendingSumX -= val;
+		if (state->calcSumX2)
+			state->pendingSumX2 -= val * val;
+	}
+	else
+	{
+		state->pendingSumX += val;
+		if (state->calcSumX2)
+			state->pendingSumX2 += val * val;
+	}
+	state->pendingDscale = Max(state->pendingDscale, X->dscale);
+	state->pendingUsed = true;
+
+	return true;
+}
+#endif
+
 /*
  * Prepare state data for a numeric aggregate function that needs to compute
  * sum, count and optionally sum of squares of the input.
@@ -4809,6 +4974,14 @@ do_numeric_accum(NumericAggState *state, Numeric newval)
 	else if (X.dscale == state->maxScale)
 		state->maxScaleCount++;
 
+#ifdef HAVE_INT128
+	if (numeric_agg_pending_add(state, &X, false))
+	{
+		state->N++;
+		return;
+	}
+#endif
+
 	/* if we need X^2, calculate that in short-lived context */
 	if (state->calcSumX2)
 	{
@@ -4897,6 +5070,14 @@ do_numeric_discard(NumericAggState *state, Numeric newval)
 		}
 	}
 
+#ifdef HAVE_INT128
+	if (state->N > 1 && numeric_agg_pending_add(state, &X, true))
+	{
+		state->N--;
+		return true;
+	}
+#endif
+
 	/* if we need X^2, calculate that in short-lived context */
 	if (state->calcSumX2)
 	{
@@ -4928,6 +5109,12 @@ do_numeric_discard(NumericAggState *state, Numeric newval)
 		accum_sum_reset(&state->sumX);
 		if (state->calcSumX2)
 			accum_sum_reset(&state->sumX2);
+#ifdef HAVE_INT128
+		state->pendingUsed = false;
+		state->pendingDscale = 0;
+		state->pendingSumX = 0;
+		state->pendingSumX2 = 0;
+#endif
 	}
 
 	MemoryContextSwitchTo(old_context);
@@ -4975,6 +5162,8 @@ numeric_combine(PG_FUNCTION_ARGS)
 	if (state2 == NULL)
 		PG_RETURN_POINTER(state1);
 
+	numeric_agg_flush(state2);
+
 	/* manually copy all fields from state2 to state1 */
 	if (state1 == NULL)
 	{
@@ -5015,6 +5204,8 @@ numeric_combine(PG_FUNCTION_ARGS)
 		else if (state2->maxScale == state1->maxScale)
 			state1->maxScaleCount += state2->maxScaleCount;
 
+		numeric_agg_flush(state1);
+
 		/* The rest of this needs to work in the aggregate context */
 		old_context = MemoryContextSwitchTo(agg_context);
 
@@ -5067,6 +5258,8 @@ numeric_avg_combine(PG_FUNCTION_ARGS)
 	if (state2 == NULL)
 		PG_RETURN_POINTER(state1);
 
+	numeric_agg_flush(state2);
+
 	/* manually copy all fields from state2 to state1 */
 	if (state1 == NULL)
 	{
@@ -5106,6 +5299,8 @@ numeric_avg_combine(PG_FUNCTION_ARGS)
 		else if (state2->maxScale == state1->maxScale)
 			state1->maxScaleCount += state2->maxScaleCount;
 
+		numeric_agg_flush(state1);
+
 		/* The rest of this needs to work in the aggregate context */
 		old_context = MemoryContextSwitchTo(agg_context);
 
@@ -5136,6 +5331,8 @@ numeric_avg_serialize(PG_FUNCTION_ARGS)
 
 	state = (NumericAggState *) PG_GETARG_POINTER(0);
 
+	numeric_agg_flush(state);
+
 	init_var(&tmp_var);
 
 	pq_begintypsend(&buf);
@@ -5248,6 +5445,8 @@ numeric_serialize(PG_FUNCTION_ARGS)
 
 	state = (NumericAggState *) PG_GETARG_POINTER(0);
 
+	numeric_agg_flush(state);
+
 	init_var(&tmp_var);
 
 	pq_begintypsend(&buf);
@@ -6081,6 +6280,8 @@ numeric_avg(PG_FUNCTION_ARGS)
 
 	N_datum = NumericGetDatum(int64_to_numeric(state->N));
 
+	numeric_agg_flush(state);
+
 	init_var(&sumX_var);
 	accum_sum_final(&state->sumX, &sumX_var);
 	sumX_datum = NumericGetDatum(make_result(&sumX_var));
@@ -6113,6 +6314,8 @@ numeric_sum(PG_FUNCTION_ARGS)
 	if (state->nInfcount > 0)
 		PG_RETURN_NUMERIC(make_result(&const_ninf));
 
+	numeric_agg_flush(state);
+
 	init_var(&sumX_var);
 	accum_sum_final(&state->sumX, &sumX_var);
 	result = make_result(&sumX_var);
@@ -6176,6 +6379,8 @@ numeric_stddev_internal(NumericAggState *state,
 	init_var(&vsumX);
 	init_var(&vsumX2);
 
+	numeric_agg_flush(state);
+
 	int64_to_numericvar(state->N, &vN);
 	accum_sum_final(&(state->sumX), &vsumX);
 	accum_sum_final(&(state->sumX2), &vsumX2);
@@ -8072,6 +8277,89 @@ int64_to_numericvar(int64 val, NumericVar *var)
 	var->weight = ndigits - 1;
 }
 
+/*
+ * Convert var to an integer in units of NBASE^-fracdigits, without rounding.
+ *
+ * Returns false if var has digits below that unit, or the result doesn't fit
+ * in an int64 (no error is raised).  Return true if okay.
+ */
+static bool
+numericvar_to_scaled_int64(const NumericVar *var, int fracdigits,
+						   int64 *result)
+{
+	int			lastdigit = var->weight + fracdigits;
+	int64		val = 0;
+
+	if (var->ndigits == 0)
+	{
+		*result = 0;
+		return true;
+	}
+
+	/* the last digit of var must be in the integer part, once scaled */
+	if (var->ndigits - 1 > lastdigit)
+		return false;
+
+	for (int i = 0; i <= lastdigit; i++)
+	{
+		if (pg_mul_s64_overflow(val, NBASE, &val) ||
+			(i < var->ndigits &&
+			 pg_add_s64_overflow(val, var->digits[i], &val)))
+			return false;
+	}
+
+	*result = (var->sign == NUMERIC_NEG) ? -val : val;
+	return true;
+}
+
+/*
+ * Set var to val * NBASE^-fracdigits, the inverse of
+ * numericvar_to_scaled_int64().  The digits are stored in the caller's
+ * buffer of NUMERIC_INT64_NDIGITS digits, not allocated, so var must not be
+ * freed; var->dscale is left for the caller to set.
+ */
+static void
+scaled_int64_to_numericvar(int64 val, int fracdigits, NumericVar *var,
+						   NumericDigit *digits)
+{
+	uint64		uval,
+				newuval;
+	NumericDigit *ptr;
+	int			ndigits;
+
+	var->buf = NULL;
+	if (val < 0)
+	{
+		var->sign = NUMERIC_NEG;
+		uval = -((uint64) val);
+	}
+	else
+	{
+		var->sign = NUMERIC_POS;
+		uval = val;
+	}
+	if (val == 0)
+	{
+		var->ndigits = 0;
+		var->weight = 0;
+		var->digits = digits;
+		return;
+	}
+	ptr = digits + NUMERIC_INT64_NDIGITS;
+	ndigits = 0;
+	do
+	{
+		ptr--;
+		ndigits++;
+		newuval = uval / NBASE;
+		*ptr = uval - newuval * NBASE;
+		uval = newuval;
+	} while (uval);
+	var->digits = ptr;
+	var->ndigits = ndigits;
+	var->weight = ndigits - 1 - fracdigits;
+}
+
 /*
  * Convert numeric to uint64, rounding if needed.
  *
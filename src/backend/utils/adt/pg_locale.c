@@ -1952,6 +1952,35 @@ pg_strncoll_icu_no_utf8(const char *arg1, int32_t len1,
 	return result;
 }
 
+#ifdef HAVE_UCOL_STRCOLLUTF8
+/*
+ * Is the string pure ASCII?  A length of -1 means the string is
+ * NUL-terminated.
+ */
+static bool
+icu_string_is_ascii(const char *str, int32_t len)
+{
+	if (len < 0)
+	{
+		for (; *str; str++)
+		{
+			if (IS_HIGHBIT_SET(*str))
+				return false;
+		}
+	}
+	else
+	{
+		for (int32_t i = 0; i < len; i++)
+		{
+			if (IS_HIGHBIT_SET(str[i]))
+				return false;
+		}
+	}
+
+	return true;
+}
+#endif
+
 /*
  * pg_strncoll_icu
  *
@@ -1970,7 +1999,15 @@ pg_strncoll_icu(const char *arg1, int32_t len1, const char *arg2, int32_t len2,
 	Assert(locale->provider == COLLPROVIDER_ICU);
 
 #ifdef HAVE_UCOL_STRCOLLUTF8
-	if (GetDatabaseEncoding() == PG_UTF8)
+
+	/*
+	 * All server encodings are ASCII supersets, and ASCII is valid UTF-8, so
+	 * strings that are pure ASCII can be passed to ucol_strcollUTF8() in any
+	 * database encoding.  That saves converting them to UTF-16 in the common
+	 * case of a database in a single-byte encoding holding mostly ASCII.
+	 */
+	if (GetDatabaseEncoding() == PG_UTF8 ||
+		(icu_string_is_ascii(arg1, len1) && icu_string_is_ascii(arg2, len2)))
 	{
 		UErrorCode	status;
 
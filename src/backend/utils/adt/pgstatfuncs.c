@@ -16,6 +16,7 @@
 
 #include "access/htup_details.h"
 #include "access/xlog.h"
+#include "access/xlog_internal.h"
 #include "access/xlogprefetcher.h"
 #include "catalog/catalog.h"
 #include "catalog/pg_authid.h"
@@ -25,11 +26,14 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/bgworker_internals.h"
+#include "postmaster/bgwriter.h"
 #include "postmaster/postmaster.h"
 #include "replication/logicallauncher.h"
+#include "storage/dsm.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/inet.h"
 #include "utils/timestamp.h"
@@ -72,6 +76,12 @@ PG_STAT_GET_RELENTRY_INT64(blocks_hit)
 /* pg_stat_get_dead_tuples */
 PG_STAT_GET_RELENTRY_INT64(dead_tuples)
 
+/* pg_stat_get_eager_frozen_pages */
+PG_STAT_GET_RELENTRY_INT64(eager_frozen_pages)
+
+/* pg_stat_get_freeze_debt_pages */
+PG_STAT_GET_RELENTRY_INT64(freeze_debt_pages)
+
 /* pg_stat_get_ins_since_vacuum */
 PG_STAT_GET_RELENTRY_INT64(ins_since_vacuum)
 
@@ -298,13 +308,77 @@ pg_stat_get_progress_info(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Returns the temporary file usage of the plan nodes of running queries
+ * that have spilled to temporary files, one row per node.
+ */
+Datum
+pg_stat_get_progress_temp_files(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PROGRESS_TEMP_FILES_COLS	9
+	int			num_backends = pgstat_fetch_stat_numbackends();
+	int			curr_backend;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	/* 1-based index */
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
+
+		local_beentry = pgstat_get_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
+
+		for (int i = 0; i < PGSTAT_NUM_TEMP_FILE_NODES; i++)
+		{
+			PgBackendTempFileNode *node = &beentry->st_temp_file_nodes[i];
+			Datum		values[PG_STAT_GET_PROGRESS_TEMP_FILES_COLS] = {0};
+			bool		nulls[PG_STAT_GET_PROGRESS_TEMP_FILES_COLS] = {0};
+
+			if (node->plan_node_id < 0)
+				continue;
+
+			/* Value available to all callers */
+			values[0] = Int32GetDatum(beentry->st_procpid);
+			values[1] = ObjectIdGetDatum(beentry->st_databaseid);
+
+			/* show the rest only to role members */
+			if (HAS_PGSTAT_PERMISSIONS(beentry->st_userid))
+			{
+				if (beentry->st_query_id == 0)
+					nulls[2] = true;
+				else
+					values[2] = UInt64GetDatum(beentry->st_query_id);
+				values[3] = Int32GetDatum(node->plan_node_id);
+				values[4] = CStringGetTextDatum(node->node_type);
+				values[5] = Int32GetDatum(node->files);
+				values[6] = Int64GetDatum(node->size);
+				values[7] = Int64GetDatum(node->peak_size);
+				values[8] = Int64GetDatum(node->bytes_written);
+			}
+			else
+			{
+				for (int j = 2; j < PG_STAT_GET_PROGRESS_TEMP_FILES_COLS; j++)
+					nulls[j] = true;
+			}
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+								 values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
 /*
  * Returns activity of PG backends.
  */
 Datum
 pg_stat_get_activity(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_ACTIVITY_COLS	31
+#define PG_STAT_GET_ACTIVITY_COLS	36
 	int			num_backends = pgstat_fetch_stat_numbackends();
 	int			curr_backend;
 	int			pid = PG_ARGISNULL(0) ? -1 : PG_GETARG_INT32(0);
@@ -617,6 +691,13 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 				nulls[30] = true;
 			else
 				values[30] = UInt64GetDatum(beentry->st_query_id);
+
+			/* resource usage, in milliseconds and bytes */
+			values[31] = Float8GetDatum(beentry->st_resource_usage.cpu_user_time / 1000.0);
+			values[32] = Float8GetDatum(beentry->st_resource_usage.cpu_system_time / 1000.0);
+			values[33] = Int64GetDatum(beentry->st_resource_usage.memory_allocated);
+			values[34] = Int64GetDatum(beentry->st_resource_usage.read_bytes);
+			values[35] = Int64GetDatum(beentry->st_resource_usage.write_bytes);
 		}
 		else
 		{
@@ -646,6 +727,11 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			nulls[28] = true;
 			nulls[29] = true;
 			nulls[30] = true;
+			nulls[31] = true;
+			nulls[32] = true;
+			nulls[33] = true;
+			nulls[34] = true;
+			nulls[35] = true;
 		}
 
 		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
@@ -1075,6 +1161,12 @@ PG_STAT_GET_DBENTRY_INT64(xact_rollback)
 /* pg_stat_get_db_conflict_logicalslot */
 PG_STAT_GET_DBENTRY_INT64(conflict_logicalslot)
 
+/* pg_stat_get_db_read_bytes */
+PG_STAT_GET_DBENTRY_INT64(read_bytes)
+
+/* pg_stat_get_db_write_bytes */
+PG_STAT_GET_DBENTRY_INT64(write_bytes)
+
 Datum
 pg_stat_get_db_stat_reset_time(PG_FUNCTION_ARGS)
 {
@@ -1185,6 +1277,12 @@ PG_STAT_GET_DBENTRY_FLOAT8_MS(idle_in_transaction_time)
 /* pg_stat_get_db_session_time */
 PG_STAT_GET_DBENTRY_FLOAT8_MS(session_time)
 
+/* pg_stat_get_db_cpu_user_time */
+PG_STAT_GET_DBENTRY_FLOAT8_MS(cpu_user_time)
+
+/* pg_stat_get_db_cpu_system_time */
+PG_STAT_GET_DBENTRY_FLOAT8_MS(cpu_system_time)
+
 Datum
 pg_stat_get_bgwriter_timed_checkpoints(PG_FUNCTION_ARGS)
 {
@@ -1255,6 +1353,50 @@ pg_stat_get_buf_alloc(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(pgstat_fetch_stat_bgwriter()->buf_alloc);
 }
 
+/*
+ * Returns the write activity samples kept by the checkpointer, one row per
+ * second or so, oldest first.
+ */
+Datum
+pg_stat_get_checkpointer_samples(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_CHECKPOINTER_SAMPLES_COLS	10
+	ReturnSetInfo *rsinfo;
+	CheckpointerSample *samples;
+	int			nsamples;
+
+	InitMaterializedSRF(fcinfo, 0);
+	rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	samples = palloc(CHECKPOINTER_NUM_SAMPLES * sizeof(CheckpointerSample));
+	nsamples = GetCheckpointerSamples(samples);
+
+	for (int i = 0; i < nsamples; i++)
+	{
+		Datum		values[PG_STAT_GET_CHECKPOINTER_SAMPLES_COLS] = {0};
+		bool		nulls[PG_STAT_GET_CHECKPOINTER_SAMPLES_COLS] = {0};
+		CheckpointerSample *sample = &samples[i];
+
+		values[0] = TimestampTzGetDatum(sample->sample_time);
+		values[1] = Float8GetDatum(sample->seconds);
+		values[2] = Int64GetDatum(sample->checkpoint_writes);
+		values[3] = Int64GetDatum(sample->bgwriter_writes);
+		values[4] = Float8GetDatum(sample->write_time);
+		values[5] = Int64GetDatum(sample->fsyncs);
+		values[6] = Float8GetDatum(sample->fsync_time);
+		values[7] = Float8GetDatum(sample->fsync_max_time);
+		values[8] = Int32GetDatum(sample->sync_requests);
+		values[9] = Int32GetDatum(sample->fsyncs_pending);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	pfree(samples);
+
+	return (Datum) 0;
+}
+
 /*
 * When adding a new column to the pg_stat_io view, add a new enum value
 * here above IO_NUM_COLUMNS.
@@ -1456,13 +1598,187 @@ pg_stat_get_io(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Build an int8[] from a latency histogram.
+ */
+static Datum
+io_histogram_datum(PgStat_Counter *hist)
+{
+	Datum		elems[PGSTAT_IO_HIST_BUCKETS];
+
+	for (int bucket = 0; bucket < PGSTAT_IO_HIST_BUCKETS; bucket++)
+		elems[bucket] = Int64GetDatum(hist[bucket]);
+
+	return PointerGetDatum(construct_array_builtin(elems,
+												   PGSTAT_IO_HIST_BUCKETS,
+												   INT8OID));
+}
+
+/*
+ * Returns the IO latency histograms, one row per timed IOOp of each
+ * combination of BackendType, IOObject and IOContext that was timed.
+ */
+Datum
+pg_stat_get_io_histogram(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_IO_HISTOGRAM_COLS	6
+	ReturnSetInfo *rsinfo;
+	PgStat_IO  *backends_io_stats;
+	Datum		reset_time;
+
+	InitMaterializedSRF(fcinfo, 0);
+	rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	backends_io_stats = pgstat_fetch_stat_io();
+
+	reset_time = TimestampTzGetDatum(backends_io_stats->stat_reset_timestamp);
+
+	for (int bktype = 0; bktype < BACKEND_NUM_TYPES; bktype++)
+	{
+		PgStat_BktypeIO *bktype_stats = &backends_io_stats->stats[bktype];
+
+		if (!pgstat_tracks_io_bktype(bktype))
+			continue;
+
+		for (int io_obj = 0; io_obj < IOOBJECT_NUM_TYPES; io_obj++)
+		{
+			for (int io_context = 0; io_context < IOCONTEXT_NUM_TYPES; io_context++)
+			{
+				if (!pgstat_tracks_io_object(bktype, io_obj, io_context))
+					continue;
+
+				for (int io_op = 0; io_op < IOOP_NUM_TYPES; io_op++)
+				{
+					Datum		values[PG_STAT_GET_IO_HISTOGRAM_COLS] = {0};
+					bool		nulls[PG_STAT_GET_IO_HISTOGRAM_COLS] = {0};
+					PgStat_Counter *hist = bktype_stats->hist[io_obj][io_context][io_op];
+					bool		timed = false;
+
+					if (pgstat_get_io_time_index(io_op) == IO_COL_INVALID ||
+						!pgstat_tracks_io_op(bktype, io_obj, io_context, io_op))
+						continue;
+
+					for (int bucket = 0; bucket < PGSTAT_IO_HIST_BUCKETS; bucket++)
+						timed |= hist[bucket] != 0;
+					if (!timed)
+						continue;
+
+					values[0] = CStringGetTextDatum(GetBackendTypeDesc(bktype));
+					values[1] = CStringGetTextDatum(pgstat_get_io_object_name(io_obj));
+					values[2] = CStringGetTextDatum(pgstat_get_io_context_name(io_context));
+					values[3] = CStringGetTextDatum(pgstat_get_io_op_name(io_op));
+					values[4] = io_histogram_datum(hist);
+					values[5] = reset_time;
+
+					tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+										 values, nulls);
+				}
+			}
+		}
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the IO statistics of a tablespace, one row per timed IOOp.
+ */
+Datum
+pg_stat_get_tablespace_io(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_TABLESPACE_IO_COLS	5
+	Oid			spcoid = PG_GETARG_OID(0);
+	ReturnSetInfo *rsinfo;
+	PgStat_StatTablespaceIOEntry *spcentry;
+
+	InitMaterializedSRF(fcinfo, 0);
+	rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	spcentry = pgstat_fetch_stat_tablespace_io(spcoid);
+	if (spcentry == NULL)
+		return (Datum) 0;
+
+	for (int io_op = 0; io_op < IOOP_NUM_TYPES; io_op++)
+	{
+		Datum		values[PG_STAT_GET_TABLESPACE_IO_COLS] = {0};
+		bool		nulls[PG_STAT_GET_TABLESPACE_IO_COLS] = {0};
+
+		if (pgstat_get_io_time_index(io_op) == IO_COL_INVALID)
+			continue;
+
+		values[0] = CStringGetTextDatum(pgstat_get_io_op_name(io_op));
+		values[1] = Int64GetDatum(spcentry->counts[io_op]);
+		values[2] = Float8GetDatum(pg_stat_us_to_ms(spcentry->times[io_op]));
+		values[3] = io_histogram_datum(spcentry->hist[io_op]);
+
+		if (spcentry->stat_reset_timestamp == 0)
+			nulls[4] = true;
+		else
+			values[4] = TimestampTzGetDatum(spcentry->stat_reset_timestamp);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the wait event statistics, one row per wait event waited for.
+ */
+Datum
+pg_stat_get_wait_events(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_WAIT_EVENTS_COLS	5
+	ReturnSetInfo *rsinfo;
+	PgStat_WaitStats *wait_stats;
+	Datum		reset_time;
+
+	InitMaterializedSRF(fcinfo, 0);
+	rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	wait_stats = pgstat_fetch_stat_wait();
+
+	reset_time = TimestampTzGetDatum(wait_stats->stat_reset_timestamp);
+
+	for (int classid = 0; classid < PGSTAT_WAIT_NUM_CLASSES; classid++)
+	{
+		for (int eventid = 0; eventid < PGSTAT_WAIT_EVENTS_PER_CLASS; eventid++)
+		{
+			Datum		values[PG_STAT_GET_WAIT_EVENTS_COLS] = {0};
+			bool		nulls[PG_STAT_GET_WAIT_EVENTS_COLS] = {0};
+			uint32		wait_event_info;
+
+			if (wait_stats->counts[classid][eventid] == 0)
+				continue;
+
+			wait_event_info = ((uint32) (classid + 1) << 24) | eventid;
+
+			values[0] = CStringGetTextDatum(pgstat_get_wait_event_type(wait_event_info));
+			values[1] = CStringGetTextDatum(pgstat_get_wait_event(wait_event_info));
+			values[2] = Int64GetDatum(wait_stats->counts[classid][eventid]);
+			/* convert counter from microsec to millisec for display */
+			values[3] = Float8GetDatum(((double) wait_stats->times[classid][eventid]) / 1000.0);
+
+			if (wait_stats->stat_reset_timestamp != 0)
+				values[4] = reset_time;
+			else
+				nulls[4] = true;
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+								 values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
 /*
  * Returns statistics of WAL activity
  */
 Datum
 pg_stat_get_wal(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_COLS	9
+#define PG_STAT_GET_WAL_COLS	11
 	TupleDesc	tupdesc;
 	Datum		values[PG_STAT_GET_WAL_COLS] = {0};
 	bool		nulls[PG_STAT_GET_WAL_COLS] = {0};
@@ -1479,15 +1795,19 @@ pg_stat_get_wal(PG_FUNCTION_ARGS)
 					   NUMERICOID, -1, 0);
 	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "wal_buffers_full",
 					   INT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "wal_write",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "wal_buffers_init",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "wal_segments_created",
 					   INT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "wal_sync",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "wal_write",
 					   INT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "wal_write_time",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "wal_sync",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 9, "wal_write_time",
 					   FLOAT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "wal_sync_time",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "wal_sync_time",
 					   FLOAT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 9, "stats_reset",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 11, "stats_reset",
 					   TIMESTAMPTZOID, -1, 0);
 
 	BlessTupleDesc(tupdesc);
@@ -1507,19 +1827,299 @@ pg_stat_get_wal(PG_FUNCTION_ARGS)
 									Int32GetDatum(-1));
 
 	values[3] = Int64GetDatum(wal_stats->wal_buffers_full);
-	values[4] = Int64GetDatum(wal_stats->wal_write);
-	values[5] = Int64GetDatum(wal_stats->wal_sync);
+	values[4] = Int64GetDatum(wal_stats->wal_buffers_init);
+	values[5] = Int64GetDatum(wal_stats->wal_segments_created);
+	values[6] = Int64GetDatum(wal_stats->wal_write);
+	values[7] = Int64GetDatum(wal_stats->wal_sync);
 
 	/* Convert counters from microsec to millisec for display */
-	values[6] = Float8GetDatum(((double) wal_stats->wal_write_time) / 1000.0);
-	values[7] = Float8GetDatum(((double) wal_stats->wal_sync_time) / 1000.0);
+	values[8] = Float8GetDatum(((double) wal_stats->wal_write_time) / 1000.0);
+	values[9] = Float8GetDatum(((double) wal_stats->wal_sync_time) / 1000.0);
+
+	values[10] = TimestampTzGetDatum(wal_stats->stat_reset_timestamp);
+
+	/* Returns the record as Datum */
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * Returns WAL statistics per resource manager.
+ */
+Datum
+pg_stat_get_wal_rmgrs(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_WAL_RMGRS_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	PgStat_WalStats *wal_stats;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	/* Get statistics about WAL activity */
+	wal_stats = pgstat_fetch_stat_wal();
+
+	for (int rmid = 0; rmid < RM_N_IDS; rmid++)
+	{
+		/* for each row */
+		Datum		values[PG_STAT_GET_WAL_RMGRS_COLS] = {0};
+		bool		nulls[PG_STAT_GET_WAL_RMGRS_COLS] = {0};
+		PgStat_WalCounts *counts = &wal_stats->rmgrs[rmid];
+		char		buf[256];
+
+		/* only resource managers that are known here, or have stats */
+		if (!RmgrIdExists(rmid) && counts->wal_records == 0)
+			continue;
+
+		if (RmgrIdExists(rmid))
+			values[0] = CStringGetTextDatum(GetRmgr(rmid).rm_name);
+		else
+		{
+			snprintf(buf, sizeof buf, "custom%03d", rmid);
+			values[0] = CStringGetTextDatum(buf);
+		}
+
+		values[1] = Int64GetDatum(counts->wal_records);
+		values[2] = Int64GetDatum(counts->wal_fpi);
+
+		/* Convert to numeric. */
+		snprintf(buf, sizeof buf, UINT64_FORMAT, counts->wal_bytes);
+		values[3] = DirectFunctionCall3(numeric_in,
+										CStringGetDatum(buf),
+										ObjectIdGetDatum(0),
+										Int32GetDatum(-1));
+
+		values[4] = TimestampTzGetDatum(wal_stats->stat_reset_timestamp);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns WAL statistics of a relation file, given its relfilenumber, in the
+ * current database or among the shared relations.
+ */
+Datum
+pg_stat_get_wal_relation(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_WAL_RELATION_COLS	4
+	bool		isshared = PG_GETARG_BOOL(0);
+	RelFileNumber relnumber = PG_GETARG_OID(1);
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_WAL_RELATION_COLS] = {0};
+	bool		nulls[PG_STAT_GET_WAL_RELATION_COLS] = {0};
+	char		buf[256];
+	PgStat_StatWalRelEntry *walrelentry;
+	PgStat_StatWalRelEntry allzero;
 
-	values[8] = TimestampTzGetDatum(wal_stats->stat_reset_timestamp);
+	/* Get WAL stats of the relation */
+	walrelentry = pgstat_fetch_stat_wal_relation(isshared ? InvalidOid : MyDatabaseId,
+												 relnumber);
+
+	/* Initialise attributes information in the tuple descriptor */
+	tupdesc = CreateTemplateTupleDesc(PG_STAT_GET_WAL_RELATION_COLS);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "wal_records",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "wal_fpi",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "wal_bytes",
+					   NUMERICOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "stats_reset",
+					   TIMESTAMPTZOID, -1, 0);
+	BlessTupleDesc(tupdesc);
+
+	if (!walrelentry)
+	{
+		/* If the relation has no stats, report zeroes */
+		memset(&allzero, 0, sizeof(PgStat_StatWalRelEntry));
+		walrelentry = &allzero;
+	}
+
+	values[0] = Int64GetDatum(walrelentry->counts.wal_records);
+	values[1] = Int64GetDatum(walrelentry->counts.wal_fpi);
+
+	/* Convert to numeric. */
+	snprintf(buf, sizeof buf, UINT64_FORMAT, walrelentry->counts.wal_bytes);
+	values[2] = DirectFunctionCall3(numeric_in,
+									CStringGetDatum(buf),
+									ObjectIdGetDatum(0),
+									Int32GetDatum(-1));
+
+	if (walrelentry->stat_reset_timestamp == 0)
+		nulls[3] = true;
+	else
+		values[3] = TimestampTzGetDatum(walrelentry->stat_reset_timestamp);
 
 	/* Returns the record as Datum */
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
+/*
+ * Returns planner statistics per query id of the current database.
+ */
+Datum
+pg_stat_get_planning(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PLANNING_COLS	12
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	uint64	   *queryids;
+	int			nqueryids;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	queryids = pgstat_fetch_planning_queryids(&nqueryids);
+
+	for (int i = 0; i < nqueryids; i++)
+	{
+		/* for each row */
+		Datum		values[PG_STAT_GET_PLANNING_COLS] = {0};
+		bool		nulls[PG_STAT_GET_PLANNING_COLS] = {0};
+		PgStat_StatPlanningEntry *planentry;
+
+		planentry = pgstat_fetch_stat_planning(queryids[i]);
+
+		/* might have been removed meanwhile */
+		if (planentry == NULL)
+			continue;
+
+		values[0] = Int64GetDatum((int64) queryids[i]);
+		values[1] = Int64GetDatum(planentry->plans);
+		/* convert counters from microsec to millisec for display */
+		values[2] = Float8GetDatum(((double) planentry->total_time) / 1000.0);
+		values[3] = Float8GetDatum(((double) planentry->expand_time) / 1000.0);
+		values[4] = Float8GetDatum(((double) planentry->path_time) / 1000.0);
+		values[5] = Float8GetDatum(((double) planentry->join_time) / 1000.0);
+		values[6] = Float8GetDatum(((double) planentry->selectivity_time) / 1000.0);
+		values[7] = Int64GetDatum(planentry->selectivity_calls);
+		values[8] = Int64GetDatum(planentry->paths_considered);
+		values[9] = Int64GetDatum(planentry->joinrels_built);
+		values[10] = Int64GetDatum(planentry->max_memory);
+
+		if (planentry->stat_reset_timestamp == 0)
+			nulls[11] = true;
+		else
+			values[11] = TimestampTzGetDatum(planentry->stat_reset_timestamp);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Estimate a percentile of the execution time of a query, in milliseconds,
+ * from its latency histogram.  Within a bucket, executions are assumed to be
+ * spread evenly.
+ */
+static double
+query_time_percentile(PgStat_StatQueryEntry *queryentry, double fraction)
+{
+	double		target = fraction * queryentry->calls;
+	double		seen = 0;
+	double		usec = (double) queryentry->max_time;
+
+	for (int i = 0; i < PGSTAT_QUERY_HIST_BUCKETS; i++)
+	{
+		double		count = (double) queryentry->hist[i];
+		double		lo;
+		double		hi;
+
+		if (count <= 0 || seen + count < target)
+		{
+			seen += count;
+			continue;
+		}
+
+		lo = i == 0 ? 0 : (double) (UINT64CONST(1) << (i - 1));
+		hi = i == PGSTAT_QUERY_HIST_BUCKETS - 1 ?
+			Max(lo, (double) queryentry->max_time) :
+			(double) (UINT64CONST(1) << i);
+		usec = lo + (hi - lo) * (target - seen) / count;
+		break;
+	}
+
+	usec = Max(usec, (double) queryentry->min_time);
+	usec = Min(usec, (double) queryentry->max_time);
+
+	return usec / 1000.0;
+}
+
+/*
+ * Returns execution statistics per query id of the current database.
+ */
+Datum
+pg_stat_get_queries(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_QUERIES_COLS	22
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	uint64	   *queryids;
+	int			nqueryids;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	queryids = pgstat_fetch_query_queryids(&nqueryids);
+
+	for (int i = 0; i < nqueryids; i++)
+	{
+		/* for each row */
+		Datum		values[PG_STAT_GET_QUERIES_COLS] = {0};
+		bool		nulls[PG_STAT_GET_QUERIES_COLS] = {0};
+		Datum		hist[PGSTAT_QUERY_HIST_BUCKETS];
+		PgStat_StatQueryEntry *queryentry;
+		char		buf[256];
+
+		queryentry = pgstat_fetch_stat_query(queryids[i]);
+
+		/* might have been removed meanwhile */
+		if (queryentry == NULL || queryentry->calls == 0)
+			continue;
+
+		values[0] = Int64GetDatum((int64) queryids[i]);
+		values[1] = Int64GetDatum(queryentry->calls);
+		/* convert counters from microsec to millisec for display */
+		values[2] = Float8GetDatum(((double) queryentry->total_time) / 1000.0);
+		values[3] = Float8GetDatum(((double) queryentry->min_time) / 1000.0);
+		values[4] = Float8GetDatum(((double) queryentry->max_time) / 1000.0);
+		values[5] = Float8GetDatum(query_time_percentile(queryentry, 0.50));
+		values[6] = Float8GetDatum(query_time_percentile(queryentry, 0.90));
+		values[7] = Float8GetDatum(query_time_percentile(queryentry, 0.99));
+
+		for (int j = 0; j < PGSTAT_QUERY_HIST_BUCKETS; j++)
+			hist[j] = Int64GetDatum(queryentry->hist[j]);
+		values[8] = PointerGetDatum(construct_array_builtin(hist,
+															PGSTAT_QUERY_HIST_BUCKETS,
+															INT8OID));
+
+		values[9] = Int64GetDatum(queryentry->rows);
+		values[10] = Int64GetDatum(queryentry->shared_blks_hit);
+		values[11] = Int64GetDatum(queryentry->shared_blks_read);
+		values[12] = Int64GetDatum(queryentry->shared_blks_dirtied);
+		values[13] = Int64GetDatum(queryentry->shared_blks_written);
+		values[14] = Int64GetDatum(queryentry->local_blks_hit);
+		values[15] = Int64GetDatum(queryentry->local_blks_read);
+		values[16] = Int64GetDatum(queryentry->temp_blks_read);
+		values[17] = Int64GetDatum(queryentry->temp_blks_written);
+		values[18] = Int64GetDatum(queryentry->wal_records);
+		values[19] = Int64GetDatum(queryentry->wal_fpi);
+
+		/* Convert to numeric. */
+		snprintf(buf, sizeof buf, UINT64_FORMAT, queryentry->wal_bytes);
+		values[20] = DirectFunctionCall3(numeric_in,
+										 CStringGetDatum(buf),
+										 ObjectIdGetDatum(0),
+										 Int32GetDatum(-1));
+
+		if (queryentry->stat_reset_timestamp == 0)
+			nulls[21] = true;
+		else
+			values[21] = TimestampTzGetDatum(queryentry->stat_reset_timestamp);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 /*
  * Returns statistics of SLRU caches.
  */
@@ -1763,16 +2363,21 @@ pg_stat_reset_shared(PG_FUNCTION_ARGS)
 		pgstat_reset_of_kind(PGSTAT_KIND_CHECKPOINTER);
 	}
 	else if (strcmp(target, "io") == 0)
+	{
 		pgstat_reset_of_kind(PGSTAT_KIND_IO);
+		pgstat_reset_of_kind(PGSTAT_KIND_TABLESPACE);
+	}
 	else if (strcmp(target, "recovery_prefetch") == 0)
 		XLogPrefetchResetStats();
+	else if (strcmp(target, "wait") == 0)
+		pgstat_reset_of_kind(PGSTAT_KIND_WAIT);
 	else if (strcmp(target, "wal") == 0)
 		pgstat_reset_of_kind(PGSTAT_KIND_WAL);
 	else
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("unrecognized reset target: \"%s\"", target),
-				 errhint("Target must be \"archiver\", \"bgwriter\", \"io\", \"recovery_prefetch\", or \"wal\".")));
+				 errhint("Target must be \"archiver\", \"bgwriter\", \"io\", \"recovery_prefetch\", \"wait\", or \"wal\".")));
 
 	PG_RETURN_VOID();
 }
@@ -1802,6 +2407,24 @@ pg_stat_reset_single_function_counters(PG_FUNCTION_ARGS)
 	PG_RETURN_VOID();
 }
 
+/* Remove the planner statistics of the current database */
+Datum
+pg_stat_reset_planning(PG_FUNCTION_ARGS)
+{
+	pgstat_reset_planning();
+
+	PG_RETURN_VOID();
+}
+
+/* Remove the query execution statistics of the current database */
+Datum
+pg_stat_reset_queries(PG_FUNCTION_ARGS)
+{
+	pgstat_reset_queries();
+
+	PG_RETURN_VOID();
+}
+
 /* Reset SLRU counters (a specific one or all of them). */
 Datum
 pg_stat_reset_slru(PG_FUNCTION_ARGS)
@@ -1923,6 +2546,37 @@ pg_stat_get_archiver(PG_FUNCTION_ARGS)
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
+/*
+ * Returns how often new dynamic shared memory segments could be taken from
+ * the kept ones, see dynamic_shared_memory_cache_size.
+ */
+Datum
+pg_stat_get_dsm_cache(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	Datum		values[2] = {0};
+	bool		nulls[2] = {0};
+	uint64		hits;
+	uint64		misses;
+
+	/* Initialise attributes information in the tuple descriptor */
+	tupdesc = CreateTemplateTupleDesc(2);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "hits",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "misses",
+					   INT8OID, -1, 0);
+
+	BlessTupleDesc(tupdesc);
+
+	dsm_cache_stats(&hits, &misses);
+
+	values[0] = Int64GetDatum((int64) hits);
+	values[1] = Int64GetDatum((int64) misses);
+
+	/* Returns the record as Datum */
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
 /*
  * Get the statistics for the replication slot. If the slot statistics is not
  * available, return all-zeroes stats.
@@ -1930,7 +2584,7 @@ pg_stat_get_archiver(PG_FUNCTION_ARGS)
 Datum
 pg_stat_get_replication_slot(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_REPLICATION_SLOT_COLS 10
+#define PG_STAT_GET_REPLICATION_SLOT_COLS 11
 	text	   *slotname_text = PG_GETARG_TEXT_P(0);
 	NameData	slotname;
 	TupleDesc	tupdesc;
@@ -1959,7 +2613,9 @@ pg_stat_get_replication_slot(PG_FUNCTION_ARGS)
 					   INT8OID, -1, 0);
 	TupleDescInitEntry(tupdesc, (AttrNumber) 9, "total_bytes",
 					   INT8OID, -1, 0);
-	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "stats_reset",
+	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "snapshot_build_time",
+					   FLOAT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 11, "stats_reset",
 					   TIMESTAMPTZOID, -1, 0);
 	BlessTupleDesc(tupdesc);
 
@@ -1984,11 +2640,12 @@ pg_stat_get_replication_slot(PG_FUNCTION_ARGS)
 	values[6] = Int64GetDatum(slotent->stream_bytes);
 	values[7] = Int64GetDatum(slotent->total_txns);
 	values[8] = Int64GetDatum(slotent->total_bytes);
+	values[9] = Float8GetDatum(pg_stat_us_to_ms(slotent->snapshot_build_time));
 
 	if (slotent->stat_reset_timestamp == 0)
-		nulls[9] = true;
+		nulls[10] = true;
 	else
-		values[9] = TimestampTzGetDatum(slotent->stat_reset_timestamp);
+		values[10] = TimestampTzGetDatum(slotent->stat_reset_timestamp);
 
 	/* Returns the record as Datum */
 	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
@@ -18,9 +18,11 @@
 #include "access/stratnum.h"
 #include "utils/datum.h"
 #include "utils/float.h"
+#include "utils/fmgroids.h"
 #include "utils/fmgrprotos.h"
 #include "utils/multirangetypes.h"
 #include "utils/rangetypes.h"
+#include "utils/sortsupport.h"
 
 /*
  * Range class properties used to segregate different classes of ranges in
@@ -1797,3 +1799,18 @@ call_subtype_diff(TypeCacheEntry *typcache, Datum val1, Datum val2)
 		return value;
 	return 0.0;
 }
+
+/*
+ * Sort support routine for fast GiST index build by sorting.
+ *
+ * Ranges are one-dimensional, so the btree order, by lower and then upper
+ * bound, linearizes them well.  Keys of multirange_ops are ranges as well.
+ */
+Datum
+range_gist_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	PrepareSortSupportComparisonShim(F_RANGE_CMP, ssup);
+	PG_RETURN_VOID();
+}
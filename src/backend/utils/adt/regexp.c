@@ -29,9 +29,12 @@
  */
 #include "postgres.h"
 
+#include <ctype.h>
+
 #include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "miscadmin.h"
+#include "portability/instr_time.h"
 #include "regex/regex.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
@@ -81,6 +84,11 @@ typedef struct regexp_matches_ctx
  * never-before-seen items used circularly.  We ought to be able to handle
  * that case, so we have to insert at the front.)
  *
+ * To make room, we discard the entry that took the least time to compile
+ * among the last REGEXP_EVICT_WINDOW ones, rather than just the last entry:
+ * a pattern that is expensive to compile is worth keeping a bit longer than
+ * one that is cheap to recompile.
+ *
  * Knuth mentions a variant strategy in which a used item is moved up just
  * one place in the list.  Although he says this uses fewer comparisons on
  * average, it seems not to adapt very well to the situation where you have
@@ -88,14 +96,21 @@ typedef struct regexp_matches_ctx
  * A reusable pattern that isn't used at least as often as non-reusable
  * patterns are seen will "fail to keep up" and will drop off the end of the
  * cache.  With move-to-front, a reusable pattern is guaranteed to stay in
- * the cache as long as it's used at least once in every MAX_CACHED_RES uses.
+ * the cache as long as it's used at least once in every
+ * MAX_CACHED_RES - REGEXP_EVICT_WINDOW uses.
  */
 
 /* this is the maximum number of cached regular expressions */
 #ifndef MAX_CACHED_RES
-#define MAX_CACHED_RES	32
+#define MAX_CACHED_RES	128
 #endif
 
+/* number of entries at the end of the list considered for eviction */
+#define REGEXP_EVICT_WINDOW	8
+
+/* shortest required literal worth searching for before running the RE */
+#define REGEXP_MIN_LITERAL	2
+
 /* A parent memory context for regular expressions. */
 static MemoryContext RegexpCacheMemoryContext;
 
@@ -107,6 +122,9 @@ typedef struct cached_re_str
 	int			cre_pat_len;	/* length of original RE, in bytes */
 	int			cre_flags;		/* compile flags: extended,icase etc */
 	Oid			cre_collation;	/* collation to use */
+	uint64		cre_cost;		/* time taken to compile, in microseconds */
+	char	   *cre_literal;	/* string every match contains, or NULL */
+	int			cre_literal_len;	/* length of cre_literal, in bytes */
 	regex_t		cre_re;			/* the compiled regular expression */
 } cached_re_str;
 
@@ -115,6 +133,12 @@ static cached_re_str re_array[MAX_CACHED_RES];	/* cached re's */
 
 
 /* Local functions */
+static cached_re_str *RE_compile_and_cache_entry(text *text_re, int cflags,
+												 Oid collation);
+static int	regexp_required_literal(const char *pat, int len, int cflags,
+									char *literal);
+static bool regexp_contains_literal(const char *dat, int dat_len,
+									const char *literal, int literal_len);
 static regexp_matches_ctx *setup_regexp_matches(text *orig_str, text *pattern,
 												pg_re_flags *re_flags,
 												int start_search,
@@ -140,6 +164,18 @@ static Datum build_regexp_split_result(regexp_matches_ctx *splitctx);
  */
 regex_t *
 RE_compile_and_cache(text *text_re, int cflags, Oid collation)
+{
+	return &RE_compile_and_cache_entry(text_re, cflags, collation)->cre_re;
+}
+
+/*
+ * RE_compile_and_cache_entry - workhorse of RE_compile_and_cache
+ *
+ * Returns the cache entry of the compiled RE, which stays valid until the
+ * next call.
+ */
+static cached_re_str *
+RE_compile_and_cache_entry(text *text_re, int cflags, Oid collation)
 {
 	int			text_re_len = VARSIZE_ANY_EXHDR(text_re);
 	char	   *text_re_val = VARDATA_ANY(text_re);
@@ -147,9 +183,13 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	int			pattern_len;
 	int			i;
 	int			regcomp_result;
+	int			literal_len;
+	int			victim;
 	cached_re_str re_temp;
 	char		errMsg[100];
 	MemoryContext oldcontext;
+	instr_time	start_time;
+	instr_time	duration;
 
 	/*
 	 * Look for a match among previously compiled REs.  Since the data
@@ -173,7 +213,7 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 				re_array[0] = re_temp;
 			}
 
-			return &re_array[0].cre_re;
+			return &re_array[0];
 		}
 	}
 
@@ -189,6 +229,8 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	 * resources on failure, we build into the re_temp local.
 	 */
 
+	INSTR_TIME_SET_CURRENT(start_time);
+
 	/* Convert pattern string to wide characters */
 	pattern = (pg_wchar *) palloc((text_re_len + 1) * sizeof(pg_wchar));
 	pattern_len = pg_mb2wchar_with_len(text_re_val,
@@ -239,16 +281,43 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 	re_temp.cre_flags = cflags;
 	re_temp.cre_collation = collation;
 
+	/* Look for a literal to reject data that can't match quickly with. */
+	re_temp.cre_literal = palloc(text_re_len + 1);
+	literal_len = regexp_required_literal(text_re_val, text_re_len, cflags,
+										  re_temp.cre_literal);
+	if (literal_len >= REGEXP_MIN_LITERAL)
+		re_temp.cre_literal_len = literal_len;
+	else
+	{
+		pfree(re_temp.cre_literal);
+		re_temp.cre_literal = NULL;
+		re_temp.cre_literal_len = 0;
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start_time);
+	re_temp.cre_cost = INSTR_TIME_GET_MICROSEC(duration);
+
 	/*
 	 * Okay, we have a valid new item in re_temp; insert it into the storage
-	 * array.  Discard last entry if needed.
+	 * array.  Discard the cheapest of the last few entries if needed.
 	 */
 	if (num_res >= MAX_CACHED_RES)
 	{
+		victim = num_res - 1;
+		for (i = num_res - 2; i >= num_res - REGEXP_EVICT_WINDOW && i >= 0; i--)
+		{
+			if (re_array[i].cre_cost < re_array[victim].cre_cost)
+				victim = i;
+		}
+
+		/* Delete the memory context holding the regexp and pattern. */
+		MemoryContextDelete(re_array[victim].cre_context);
+
 		--num_res;
 		Assert(num_res < MAX_CACHED_RES);
-		/* Delete the memory context holding the regexp and pattern. */
-		MemoryContextDelete(re_array[num_res].cre_context);
+		memmove(&re_array[victim], &re_array[victim + 1],
+				(num_res - victim) * sizeof(cached_re_str));
 	}
 
 	/* Re-parent the memory context to our long-lived cache context. */
@@ -262,7 +331,232 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 
 	MemoryContextSwitchTo(oldcontext);
 
-	return &re_array[0].cre_re;
+	return &re_array[0];
+}
+
+/*
+ * regexp_required_literal - find a literal string every match contains
+ *
+ * Stores into *literal the longest run of literal characters that the
+ * pattern requires in all of its matches, and returns its length in bytes,
+ * or 0 if there's none.  The caller can then reject data that doesn't
+ * contain it with a plain substring search, which is much cheaper than
+ * running the regex engine over it.
+ *
+ * This only looks at the text of the pattern, and is deliberately
+ * conservative: anything inside parentheses or brackets, and any escape
+ * other than a quoted punctuation character, just ends the current run, and
+ * patterns with top-level alternation, case-insensitive or expanded syntax,
+ * embedded options or directors get no literal at all.  A character
+ * followed by a quantifier that allows zero repetitions is not required.
+ * The literal is in the pattern's encoding, as is the data it's searched
+ * in; since a matching character is always the same bytes, a byte-wise
+ * search can't reject data that matches.
+ */
+static int
+regexp_required_literal(const char *pat, int len, int cflags, char *literal)
+{
+	char	   *cur;
+	int			cur_len = 0;
+	int			last_len = 0;	/* byte length of cur's last character */
+	int			best_len = 0;
+	int			i = 0;
+
+	if (cflags & (REG_ICASE | REG_EXPANDED))
+		return 0;
+
+	if ((cflags & REG_QUOTE) && !(cflags & REG_EXTENDED))
+	{
+		memcpy(literal, pat, len);
+		return len;
+	}
+
+	if (!(cflags & REG_EXTENDED))
+		return 0;
+
+	/* directors and embedded options */
+	if ((len >= 3 && strncmp(pat, "***", 3) == 0) ||
+		(len >= 2 && strncmp(pat, "(?", 2) == 0))
+		return 0;
+
+	cur = palloc(len + 1);
+
+#define END_RUN() \
+	do { \
+		if (cur_len > best_len) \
+		{ \
+			memcpy(literal, cur, cur_len); \
+			best_len = cur_len; \
+		} \
+		cur_len = 0; \
+		last_len = 0; \
+	} while (0)
+
+	while (i < len)
+	{
+		char		c = pat[i];
+
+		switch (c)
+		{
+			case '|':
+				/* alternation: no single literal is required */
+				pfree(cur);
+				return 0;
+
+			case '\\':
+				if (i + 1 >= len)
+				{
+					pfree(cur);
+					return 0;
+				}
+				if (IS_HIGHBIT_SET(pat[i + 1]) || isalnum((unsigned char) pat[i + 1]))
+				{
+					/* class shorthand, constraint, backref, char code... */
+					END_RUN();
+					i += 2;
+					while (i < len && isalnum((unsigned char) pat[i]))
+						i++;
+				}
+				else
+				{
+					/* quoted punctuation stands for itself */
+					cur[cur_len++] = pat[i + 1];
+					last_len = 1;
+					i += 2;
+				}
+				break;
+
+			case '(':
+			case '[':
+				{
+					int			depth = 0;
+
+					END_RUN();
+
+					/* skip the whole group or bracket expression */
+					do
+					{
+						if (pat[i] == '\\')
+							i++;
+						else if (pat[i] == '[')
+						{
+							/* bracket expression, possibly in a group */
+							i++;
+							if (i < len && pat[i] == '^')
+								i++;
+							if (i < len && pat[i] == ']')
+								i++;
+							while (i < len && pat[i] != ']')
+							{
+								if (pat[i] == '\\')
+									i++;
+								else if (pat[i] == '[' && i + 1 < len &&
+										 (pat[i + 1] == ':' ||
+										  pat[i + 1] == '.' ||
+										  pat[i + 1] == '='))
+								{
+									char		delim = pat[i + 1];
+
+									i += 2;
+									while (i + 1 < len &&
+										   !(pat[i] == delim && pat[i + 1] == ']'))
+										i++;
+									i++;
+								}
+								i++;
+							}
+						}
+						else if (pat[i] == '(')
+							depth++;
+						else if (pat[i] == ')')
+							depth--;
+						i++;
+					} while (i < len && depth > 0);
+
+					if (depth > 0)
+					{
+						/* unbalanced */
+						pfree(cur);
+						return 0;
+					}
+				}
+				break;
+
+			case '{':
+				/* bound: the preceding character may be optional */
+				cur_len -= last_len;
+				END_RUN();
+				while (i < len && pat[i] != '}')
+					i++;
+				i++;
+				break;
+
+			case '*':
+			case '?':
+				cur_len -= last_len;
+				END_RUN();
+				i++;
+				break;
+
+			case ')':
+				pfree(cur);
+				return 0;
+
+			case '+':
+			case '.':
+			case '^':
+			case '$':
+				END_RUN();
+				i++;
+				break;
+
+			default:
+				{
+					int			clen = pg_mblen(pat + i);
+
+					if (i + clen > len)
+						clen = len - i;
+					memcpy(cur + cur_len, pat + i, clen);
+					cur_len += clen;
+					last_len = clen;
+					i += clen;
+				}
+				break;
+		}
+	}
+	END_RUN();
+
+#undef END_RUN
+
+	pfree(cur);
+
+	return best_len;
+}
+
+/*
+ * regexp_contains_literal - does the data contain the literal?
+ *
+ * memchr() for the first byte is vectorized in most C libraries, so this
+ * skips quickly over data that doesn't even contain that.
+ */
+static bool
+regexp_contains_literal(const char *dat, int dat_len,
+						const char *literal, int literal_len)
+{
+	const char *p = dat;
+	const char *last = dat + dat_len - literal_len;
+
+	while (p <= last)
+	{
+		p = memchr(p, (unsigned char) literal[0], last - p + 1);
+		if (p == NULL)
+			return false;
+		if (memcmp(p + 1, literal + 1, literal_len - 1) == 0)
+			return true;
+		p++;
+	}
+
+	return false;
 }
 
 /*
@@ -360,16 +654,22 @@ RE_compile_and_execute(text *text_re, char *dat, int dat_len,
 					   int cflags, Oid collation,
 					   int nmatch, regmatch_t *pmatch)
 {
-	regex_t    *re;
+	cached_re_str *cre;
 
 	/* Use REG_NOSUB if caller does not want sub-match details */
 	if (nmatch < 2)
 		cflags |= REG_NOSUB;
 
 	/* Compile RE */
-	re = RE_compile_and_cache(text_re, cflags, collation);
+	cre = RE_compile_and_cache_entry(text_re, cflags, collation);
+
+	/* No match is possible without the literal all matches contain */
+	if (cre->cre_literal != NULL &&
+		!regexp_contains_literal(dat, dat_len,
+								 cre->cre_literal, cre->cre_literal_len))
+		return false;
 
-	return RE_execute(re, dat, dat_len, nmatch, pmatch);
+	return RE_execute(&cre->cre_re, dat, dat_len, nmatch, pmatch);
 }
 
 
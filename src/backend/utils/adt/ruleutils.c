@@ -1635,6 +1635,7 @@ pg_get_statisticsobj_worker(Oid statextid, bool columns_only, bool missing_ok)
 	bool		ndistinct_enabled;
 	bool		dependencies_enabled;
 	bool		mcv_enabled;
+	bool		sketch_enabled;
 	int			i;
 	List	   *context;
 	ListCell   *lc;
@@ -1703,6 +1704,7 @@ pg_get_statisticsobj_worker(Oid statextid, bool columns_only, bool missing_ok)
 		ndistinct_enabled = false;
 		dependencies_enabled = false;
 		mcv_enabled = false;
+		sketch_enabled = false;
 
 		for (i = 0; i < ARR_DIMS(arr)[0]; i++)
 		{
@@ -1712,6 +1714,8 @@ pg_get_statisticsobj_worker(Oid statextid, bool columns_only, bool missing_ok)
 				dependencies_enabled = true;
 			else if (enabled[i] == STATS_EXT_MCV)
 				mcv_enabled = true;
+			else if (enabled[i] == STATS_EXT_SKETCH)
+				sketch_enabled = true;
 
 			/* ignore STATS_EXT_EXPRESSIONS (it's built automatically) */
 		}
@@ -1725,10 +1729,13 @@ pg_get_statisticsobj_worker(Oid statextid, bool columns_only, bool missing_ok)
 		 *
 		 * But if the statistics is defined on just a single column, it has to
 		 * be an expression statistics. In that case we don't need to specify
-		 * kinds.
+		 * kinds.  Sketches are the exception: they are on a single column or
+		 * expression, and never combined with other kinds.
 		 */
-		if ((!ndistinct_enabled || !dependencies_enabled || !mcv_enabled) &&
-			(ncolumns > 1))
+		if (sketch_enabled)
+			appendStringInfoString(&buf, " (sketch)");
+		else if ((!ndistinct_enabled || !dependencies_enabled || !mcv_enabled) &&
+				 (ncolumns > 1))
 		{
 			bool		gotone = false;
 
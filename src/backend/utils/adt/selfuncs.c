@@ -153,7 +153,8 @@ static double eqjoinsel_inner(Oid opfuncoid, Oid collation,
 							  bool isdefault1, bool isdefault2,
 							  AttStatsSlot *sslot1, AttStatsSlot *sslot2,
 							  Form_pg_statistic stats1, Form_pg_statistic stats2,
-							  bool have_mcvs1, bool have_mcvs2);
+							  bool have_mcvs1, bool have_mcvs2,
+							  double containment);
 static double eqjoinsel_semi(Oid opfuncoid, Oid collation,
 							 VariableStatData *vardata1, VariableStatData *vardata2,
 							 double nd1, double nd2,
@@ -161,7 +162,7 @@ static double eqjoinsel_semi(Oid opfuncoid, Oid collation,
 							 AttStatsSlot *sslot1, AttStatsSlot *sslot2,
 							 Form_pg_statistic stats1, Form_pg_statistic stats2,
 							 bool have_mcvs1, bool have_mcvs2,
-							 RelOptInfo *inner_rel);
+							 RelOptInfo *inner_rel, double containment);
 static bool estimate_multivariate_ndistinct(PlannerInfo *root,
 											RelOptInfo *rel, List **varinfos, double *ndistinct);
 static bool convert_to_scalar(Datum value, Oid valuetypid, Oid collid,
@@ -2265,6 +2266,7 @@ eqjoinsel(PG_FUNCTION_ARGS)
 	bool		get_mcv_stats;
 	bool		join_is_reversed;
 	RelOptInfo *inner_rel;
+	double		containment = 1.0;
 
 	get_join_variables(root, args, sjinfo,
 					   &vardata1, &vardata2, &join_is_reversed);
@@ -2272,6 +2274,15 @@ eqjoinsel(PG_FUNCTION_ARGS)
 	nd1 = get_variable_numdistinct(&vardata1, &isdefault1);
 	nd2 = get_variable_numdistinct(&vardata2, &isdefault2);
 
+	/*
+	 * With sketches on both sides, we know how much the distinct values
+	 * overlap, rather than assuming that the side with fewer of them is
+	 * contained in the other.
+	 */
+	if (!isdefault1 && !isdefault2)
+		(void) statext_sketch_containment(root, &vardata1, &vardata2,
+										  operator, collation, &containment);
+
 	opfuncoid = get_opcode(operator);
 
 	memset(&sslot1, 0, sizeof(sslot1));
@@ -2319,7 +2330,8 @@ eqjoinsel(PG_FUNCTION_ARGS)
 								  isdefault1, isdefault2,
 								  &sslot1, &sslot2,
 								  stats1, stats2,
-								  have_mcvs1, have_mcvs2);
+								  have_mcvs1, have_mcvs2,
+								  containment);
 
 	switch (sjinfo->jointype)
 	{
@@ -2347,7 +2359,7 @@ eqjoinsel(PG_FUNCTION_ARGS)
 									   &sslot1, &sslot2,
 									   stats1, stats2,
 									   have_mcvs1, have_mcvs2,
-									   inner_rel);
+									   inner_rel, containment);
 			else
 			{
 				Oid			commop = get_commutator(operator);
@@ -2360,7 +2372,7 @@ eqjoinsel(PG_FUNCTION_ARGS)
 									   &sslot2, &sslot1,
 									   stats2, stats1,
 									   have_mcvs2, have_mcvs1,
-									   inner_rel);
+									   inner_rel, containment);
 			}
 
 			/*
@@ -2407,7 +2419,8 @@ eqjoinsel_inner(Oid opfuncoid, Oid collation,
 				bool isdefault1, bool isdefault2,
 				AttStatsSlot *sslot1, AttStatsSlot *sslot2,
 				Form_pg_statistic stats1, Form_pg_statistic stats2,
-				bool have_mcvs1, bool have_mcvs2)
+				bool have_mcvs1, bool have_mcvs2,
+				double containment)
 {
 	double		selec;
 
@@ -2531,20 +2544,23 @@ eqjoinsel_inner(Oid opfuncoid, Oid collation,
 		 * unmatched MCVs that are assumed to match against random members of
 		 * relation 2's non-MCV population, plus non-MCV values that are
 		 * assumed to match against random members of relation 2's unmatched
-		 * MCVs plus non-MCV values.
+		 * MCVs plus non-MCV values.  Only the given containment fraction of
+		 * the values that aren't matched MCVs is assumed to find a match.
 		 */
 		totalsel1 = matchprodfreq;
 		if (nd2 > sslot2->nvalues)
-			totalsel1 += unmatchfreq1 * otherfreq2 / (nd2 - sslot2->nvalues);
+			totalsel1 += containment * unmatchfreq1 * otherfreq2 /
+				(nd2 - sslot2->nvalues);
 		if (nd2 > nmatches)
-			totalsel1 += otherfreq1 * (otherfreq2 + unmatchfreq2) /
+			totalsel1 += containment * otherfreq1 * (otherfreq2 + unmatchfreq2) /
 				(nd2 - nmatches);
 		/* Same estimate from the point of view of relation 2. */
 		totalsel2 = matchprodfreq;
 		if (nd1 > sslot1->nvalues)
-			totalsel2 += unmatchfreq2 * otherfreq1 / (nd1 - sslot1->nvalues);
+			totalsel2 += containment * unmatchfreq2 * otherfreq1 /
+				(nd1 - sslot1->nvalues);
 		if (nd1 > nmatches)
-			totalsel2 += otherfreq2 * (otherfreq1 + unmatchfreq1) /
+			totalsel2 += containment * otherfreq2 * (otherfreq1 + unmatchfreq1) /
 				(nd1 - nmatches);
 
 		/*
@@ -2571,7 +2587,8 @@ eqjoinsel_inner(Oid opfuncoid, Oid collation,
 		 * from the point of view of the relation with smaller nd (since the
 		 * larger nd is determining the MIN).  It is reasonable to assume that
 		 * most tuples in this rel will have join partners, so the bound is
-		 * probably reasonably tight and should be taken as-is.
+		 * probably reasonably tight and should be taken as-is, unless
+		 * sketches told us that only a fraction of them do.
 		 *
 		 * XXX Can we be smarter if we have an MCV list for just one side? It
 		 * seems that if we assume equal distribution for the other side, we
@@ -2580,7 +2597,7 @@ eqjoinsel_inner(Oid opfuncoid, Oid collation,
 		double		nullfrac1 = stats1 ? stats1->stanullfrac : 0.0;
 		double		nullfrac2 = stats2 ? stats2->stanullfrac : 0.0;
 
-		selec = (1.0 - nullfrac1) * (1.0 - nullfrac2);
+		selec = (1.0 - nullfrac1) * (1.0 - nullfrac2) * containment;
 		if (nd1 > nd2)
 			selec /= nd1;
 		else
@@ -2605,7 +2622,7 @@ eqjoinsel_semi(Oid opfuncoid, Oid collation,
 			   AttStatsSlot *sslot1, AttStatsSlot *sslot2,
 			   Form_pg_statistic stats1, Form_pg_statistic stats2,
 			   bool have_mcvs1, bool have_mcvs2,
-			   RelOptInfo *inner_rel)
+			   RelOptInfo *inner_rel, double containment)
 {
 	double		selec;
 
@@ -2738,7 +2755,8 @@ eqjoinsel_semi(Oid opfuncoid, Oid collation,
 		 * assume all non-null rel1 rows have join partners, else assume for
 		 * the uncertain rows that a fraction nd2/nd1 have join partners. We
 		 * can discount the known-matched MCVs from the distinct-values counts
-		 * before doing the division.
+		 * before doing the division.  If sketches showed that only part of
+		 * the distinct values are shared, scale by that.
 		 *
 		 * Crude as the above is, it's completely useless if we don't have
 		 * reliable ndistinct values for both sides.  Hence, if either nd1 or
@@ -2750,9 +2768,9 @@ eqjoinsel_semi(Oid opfuncoid, Oid collation,
 			nd1 -= nmatches;
 			nd2 -= nmatches;
 			if (nd1 <= nd2 || nd2 < 0)
-				uncertainfrac = 1.0;
+				uncertainfrac = containment;
 			else
-				uncertainfrac = nd2 / nd1;
+				uncertainfrac = containment * nd2 / nd1;
 		}
 		else
 			uncertainfrac = 0.5;
@@ -2771,9 +2789,9 @@ eqjoinsel_semi(Oid opfuncoid, Oid collation,
 		if (!isdefault1 && !isdefault2)
 		{
 			if (nd1 <= nd2 || nd2 < 0)
-				selec = 1.0 - nullfrac1;
+				selec = containment * (1.0 - nullfrac1);
 			else
-				selec = (nd2 / nd1) * (1.0 - nullfrac1);
+				selec = containment * (nd2 / nd1) * (1.0 - nullfrac1);
 		}
 		else
 			selec = 0.5 * (1.0 - nullfrac1);
@@ -6679,11 +6697,14 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	VariableStatData vardata = {0};
 	double		numIndexTuples;
 	Cost		descentCost;
+	Cost		scanDescentCost = 0;
 	List	   *indexBoundQuals;
 	int			indexcol;
 	bool		eqQualHere;
 	bool		found_saop;
 	bool		found_is_null_op;
+	bool		skip_scan;
+	double		skipGroups = 1;
 	double		num_sa_scans;
 	ListCell   *lc;
 
@@ -6703,9 +6724,36 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 * If there's a ScalarArrayOpExpr in the quals, we'll actually perform N
 	 * index scans not one, but the ScalarArrayOpExpr's operator can be
 	 * considered to act the same as it normally does.
+	 *
+	 * If the first column has no quals but the second one has, the scan
+	 * skips over the distinct values of the first column (see nbtutils.c),
+	 * doing one index scan per value as if there were an '=' qual for it.
 	 */
+	skip_scan = false;
+	if (enable_indexskipscan && index->nkeycolumns > 1)
+	{
+		foreach(lc, path->indexclauses)
+		{
+			IndexClause *iclause = lfirst_node(IndexClause, lc);
+			ListCell   *lc2;
+
+			if (iclause->indexcol != 1)
+				break;
+
+			/* IS NOT NULL alone doesn't bound the scans */
+			foreach(lc2, iclause->indexquals)
+			{
+				Expr	   *clause = lfirst_node(RestrictInfo, lc2)->clause;
+
+				if (!IsA(clause, NullTest) ||
+					((NullTest *) clause)->nulltesttype == IS_NULL)
+					skip_scan = true;
+			}
+		}
+	}
+
 	indexBoundQuals = NIL;
-	indexcol = 0;
+	indexcol = skip_scan ? 1 : 0;
 	eqQualHere = false;
 	found_saop = false;
 	found_is_null_op = false;
@@ -6797,7 +6845,8 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 		indexcol == index->nkeycolumns - 1 &&
 		eqQualHere &&
 		!found_saop &&
-		!found_is_null_op)
+		!found_is_null_op &&
+		!skip_scan)
 		numIndexTuples = 1.0;
 	else
 	{
@@ -6825,6 +6874,19 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 		numIndexTuples = rint(numIndexTuples / num_sa_scans);
 	}
 
+	/* A skip scan does one primitive scan per value of the first column */
+	if (skip_scan)
+	{
+		VariableStatData skipdata;
+		TargetEntry *tle = linitial_node(TargetEntry, index->indextlist);
+		bool		isdefault;
+
+		examine_variable(root, (Node *) tle->expr, 0, &skipdata);
+		skipGroups = get_variable_numdistinct(&skipdata, &isdefault);
+		ReleaseVariableStats(skipdata);
+		skipGroups = clamp_row_est(Min(skipGroups, index->tuples));
+	}
+
 	/*
 	 * Now do generic index cost estimation.
 	 */
@@ -6848,6 +6910,7 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 		descentCost = ceil(log(index->tuples) / log(2.0)) * cpu_operator_cost;
 		costs.indexStartupCost += descentCost;
 		costs.indexTotalCost += costs.num_sa_scans * descentCost;
+		scanDescentCost += descentCost;
 	}
 
 	/*
@@ -6863,6 +6926,46 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	descentCost = (index->tree_height + 1) * DEFAULT_PAGE_CPU_MULTIPLIER * cpu_operator_cost;
 	costs.indexStartupCost += descentCost;
 	costs.indexTotalCost += costs.num_sa_scans * descentCost;
+	scanDescentCost += descentCost;
+
+	/*
+	 * A skip scan descends the tree again for each value of the first
+	 * column, and visits at least one leaf page for each.  But when the
+	 * values turn out to have few tuples each, it gives up skipping and
+	 * reads the rest of the index (unless there are arrays to step through
+	 * for each value), so it never costs much more than a full index scan.
+	 */
+	if (skip_scan)
+	{
+		double		skipScans = costs.num_sa_scans * skipGroups;
+		double		skipPages = Min(skipScans, index->pages);
+		double		spc_random_page_cost;
+
+		get_tablespace_page_costs(index->reltablespace,
+								  &spc_random_page_cost, NULL);
+		costs.indexTotalCost += (skipGroups - 1) * costs.num_sa_scans *
+			scanDescentCost;
+		if (skipPages > costs.numIndexPages)
+			costs.indexTotalCost += (skipPages - costs.numIndexPages) *
+				spc_random_page_cost;
+
+		if (costs.num_sa_scans <= 1)
+		{
+			GenericCosts fullcosts = {0};
+			List	   *predQuals = add_predicate_to_index_quals(index, NIL);
+
+			fullcosts.numIndexTuples =
+				rint(clauselist_selectivity(root, predQuals,
+											index->rel->relid,
+											JOIN_INNER, NULL) *
+					 index->rel->tuples);
+			genericcostestimate(root, path, loop_count, &fullcosts);
+			fullcosts.indexStartupCost += scanDescentCost;
+			fullcosts.indexTotalCost += scanDescentCost;
+			if (fullcosts.indexTotalCost < costs.indexTotalCost)
+				costs = fullcosts;
+		}
+	}
 
 	/*
 	 * If we can get an estimate of the first column's ordering correlation C
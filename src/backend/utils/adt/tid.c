@@ -356,7 +356,7 @@ currtid_for_view(Relation viewrel, ItemPointer tid)
 	}
 	if (tididx < 0)
 		elog(ERROR, "currtid cannot handle views with no CTID");
-	rulelock = viewrel->rd_rules;
+	rulelock = RelationGetRuleLock(viewrel);
 	if (!rulelock)
 		elog(ERROR, "the view has no rules");
 	for (i = 0; i < rulelock->numLocks; i++)
@@ -166,15 +166,21 @@ timestamp_in(PG_FUNCTION_ARGS)
 	char		workbuf[MAXDATELEN + MAXDATEFIELDS];
 	DateTimeErrorExtra extra;
 
-	dterr = ParseDateTime(str, workbuf, sizeof(workbuf),
-						  field, ftype, MAXDATEFIELDS, &nf);
-	if (dterr == 0)
-		dterr = DecodeDateTime(field, ftype, nf,
-							   &dtype, tm, &fsec, &tz, &extra);
-	if (dterr != 0)
+	/* try the common ISO format first, see DecodeISO8601DateTime */
+	if (DecodeISO8601DateTime(str, tm, &fsec, NULL))
+		dtype = DTK_DATE;
+	else
 	{
-		DateTimeParseError(dterr, &extra, str, "timestamp", escontext);
-		PG_RETURN_NULL();
+		dterr = ParseDateTime(str, workbuf, sizeof(workbuf),
+							  field, ftype, MAXDATEFIELDS, &nf);
+		if (dterr == 0)
+			dterr = DecodeDateTime(field, ftype, nf,
+								   &dtype, tm, &fsec, &tz, &extra);
+		if (dterr != 0)
+		{
+			DateTimeParseError(dterr, &extra, str, "timestamp", escontext);
+			PG_RETURN_NULL();
+		}
 	}
 
 	switch (dtype)
@@ -418,16 +424,22 @@ timestamptz_in(PG_FUNCTION_ARGS)
 	char		workbuf[MAXDATELEN + MAXDATEFIELDS];
 	DateTimeErrorExtra extra;
 
-	dterr = ParseDateTime(str, workbuf, sizeof(workbuf),
-						  field, ftype, MAXDATEFIELDS, &nf);
-	if (dterr == 0)
-		dterr = DecodeDateTime(field, ftype, nf,
-							   &dtype, tm, &fsec, &tz, &extra);
-	if (dterr != 0)
+	/* try the common ISO format first, see DecodeISO8601DateTime */
+	if (DecodeISO8601DateTime(str, tm, &fsec, &tz))
+		dtype = DTK_DATE;
+	else
 	{
-		DateTimeParseError(dterr, &extra, str, "timestamp with time zone",
-						   escontext);
-		PG_RETURN_NULL();
+		dterr = ParseDateTime(str, workbuf, sizeof(workbuf),
+							  field, ftype, MAXDATEFIELDS, &nf);
+		if (dterr == 0)
+			dterr = DecodeDateTime(field, ftype, nf,
+								   &dtype, tm, &fsec, &tz, &extra);
+		if (dterr != 0)
+		{
+			DateTimeParseError(dterr, &extra, str, "timestamp with time zone",
+							   escontext);
+			PG_RETURN_NULL();
+		}
 	}
 
 	switch (dtype)
@@ -34,8 +34,24 @@ static const float weights[] = {0.1f, 0.2f, 0.4f, 1.0f};
 #define RANK_NORM_RDIVRPLUS1	0x20
 #define DEF_NORM_METHOD			RANK_NO_NORM
 
-static float calc_rank_or(const float *w, TSVector t, TSQuery q);
-static float calc_rank_and(const float *w, TSVector t, TSQuery q);
+/*
+ * The operands of the query last ranked by a ts_rank() call site, sorted and
+ * de-duplicated, kept in fn_extra.  Ranking many documents by one query,
+ * as ORDER BY ts_rank(...) does, then sorts the query once instead of for
+ * every document.
+ */
+typedef struct RankQueryCache
+{
+	TSQuery		query;			/* copy of the query */
+	int			nitems;
+	int			items[FLEXIBLE_ARRAY_MEMBER];	/* indexes of the operands in
+												 * the query's items */
+} RankQueryCache;
+
+static float calc_rank_or(const float *w, TSVector t, TSQuery q,
+						  QueryOperand **item, int size);
+static float calc_rank_and(const float *w, TSVector t, TSQuery q,
+						   QueryOperand **item, int size);
 
 /*
  * Returns a weight of a word collocation
@@ -81,11 +97,16 @@ cnt_length(TSVector t)
  * Returns a pointer to a WordEntry's array corresponding to 'item' from
  * tsvector 't'. 'q' is the TSQuery containing 'item'.
  * Returns NULL if not found.
+ *
+ * If lowbound is not NULL, the search starts at *lowbound, which is then
+ * advanced to where 'item' is or would be.  Callers looking up operands in
+ * ascending order can thus search only the rest of the tsvector each time.
  */
 static WordEntry *
-find_wordentry(TSVector t, TSQuery q, QueryOperand *item, int32 *nitem)
+find_wordentry(TSVector t, TSQuery q, QueryOperand *item, int32 *nitem,
+			   WordEntry **lowbound)
 {
-	WordEntry  *StopLow = ARRPTR(t);
+	WordEntry  *StopLow = lowbound ? *lowbound : ARRPTR(t);
 	WordEntry  *StopHigh = (WordEntry *) STRPTR(t);
 	WordEntry  *StopMiddle = StopHigh;
 	int			difference;
@@ -109,6 +130,10 @@ find_wordentry(TSVector t, TSQuery q, QueryOperand *item, int32 *nitem)
 			StopHigh = StopMiddle;
 	}
 
+	/* entries are unique, so StopHigh now is the lower bound of 'item' */
+	if (lowbound)
+		*lowbound = StopHigh;
+
 	if (item->prefix)
 	{
 		if (StopLow >= StopHigh)
@@ -196,8 +221,61 @@ SortAndUniqItems(TSQuery q, int *size)
 	return res;
 }
 
+/*
+ * Returns the sorted, de-duplicated array of QueryOperands in a query, like
+ * SortAndUniqItems(), using the cache in flinfo->fn_extra if flinfo is not
+ * NULL.  The array is palloc'd in either case.
+ */
+static QueryOperand **
+getRankItems(FmgrInfo *flinfo, TSQuery q, int *size)
+{
+	RankQueryCache *cache;
+	QueryOperand **res;
+
+	if (flinfo == NULL)
+	{
+		*size = q->size;
+		return SortAndUniqItems(q, size);
+	}
+
+	cache = (RankQueryCache *) flinfo->fn_extra;
+	if (cache == NULL || VARSIZE(cache->query) != VARSIZE(q) ||
+		memcmp(cache->query, q, VARSIZE(q)) != 0)
+	{
+		int			nitems = q->size;
+
+		res = SortAndUniqItems(q, &nitems);
+
+		if (cache != NULL)
+		{
+			pfree(cache->query);
+			pfree(cache);
+		}
+		cache = MemoryContextAlloc(flinfo->fn_mcxt,
+								   offsetof(RankQueryCache, items) +
+								   sizeof(int) * nitems);
+		cache->query = MemoryContextAlloc(flinfo->fn_mcxt, VARSIZE(q));
+		memcpy(cache->query, q, VARSIZE(q));
+		cache->nitems = nitems;
+		for (int i = 0; i < nitems; i++)
+			cache->items[i] = (QueryItem *) res[i] - GETQUERY(q);
+		flinfo->fn_extra = cache;
+
+		*size = nitems;
+		return res;
+	}
+
+	res = (QueryOperand **) palloc(sizeof(QueryOperand *) * q->size);
+	for (int i = 0; i < cache->nitems; i++)
+		res[i] = &GETQUERY(q)[cache->items[i]].qoperand;
+
+	*size = cache->nitems;
+	return res;
+}
+
 static float
-calc_rank_and(const float *w, TSVector t, TSQuery q)
+calc_rank_and(const float *w, TSVector t, TSQuery q, QueryOperand **item,
+			  int size)
 {
 	WordEntryPosVector **pos;
 	WordEntryPosVector1 posnull;
@@ -215,15 +293,10 @@ calc_rank_and(const float *w, TSVector t, TSQuery q)
 				dist,
 				nitem;
 	float		res = -1.0;
-	QueryOperand **item;
-	int			size = q->size;
+	WordEntry  *lowbound = ARRPTR(t);
 
-	item = SortAndUniqItems(q, &size);
 	if (size < 2)
-	{
-		pfree(item);
-		return calc_rank_or(w, t, q);
-	}
+		return calc_rank_or(w, t, q, item, size);
 	pos = (WordEntryPosVector **) palloc0(sizeof(WordEntryPosVector *) * q->size);
 
 	/* A dummy WordEntryPos array to use when haspos is false */
@@ -234,7 +307,7 @@ calc_rank_and(const float *w, TSVector t, TSQuery q)
 
 	for (i = 0; i < size; i++)
 	{
-		firstentry = entry = find_wordentry(t, q, item[i], &nitem);
+		firstentry = entry = find_wordentry(t, q, item[i], &nitem, &lowbound);
 		if (!entry)
 			continue;
 
@@ -275,12 +348,12 @@ calc_rank_and(const float *w, TSVector t, TSQuery q)
 		}
 	}
 	pfree(pos);
-	pfree(item);
 	return res;
 }
 
 static float
-calc_rank_or(const float *w, TSVector t, TSQuery q)
+calc_rank_or(const float *w, TSVector t, TSQuery q, QueryOperand **item,
+			 int size)
 {
 	WordEntry  *entry,
 			   *firstentry;
@@ -291,22 +364,19 @@ calc_rank_or(const float *w, TSVector t, TSQuery q)
 				i,
 				nitem;
 	float		res = 0.0;
-	QueryOperand **item;
-	int			size = q->size;
+	WordEntry  *lowbound = ARRPTR(t);
 
 	/* A dummy WordEntryPos array to use when haspos is false */
 	posnull.npos = 1;
 	posnull.pos[0] = 0;
 
-	item = SortAndUniqItems(q, &size);
-
 	for (i = 0; i < size; i++)
 	{
 		float		resj,
 					wjm;
 		int32		jm;
 
-		firstentry = entry = find_wordentry(t, q, item[i], &nitem);
+		firstentry = entry = find_wordentry(t, q, item[i], &nitem, &lowbound);
 		if (!entry)
 			continue;
 
@@ -349,25 +419,31 @@ calc_rank_or(const float *w, TSVector t, TSQuery q)
 	}
 	if (size > 0)
 		res = res / size;
-	pfree(item);
 	return res;
 }
 
 static float
-calc_rank(const float *w, TSVector t, TSQuery q, int32 method)
+calc_rank(FmgrInfo *flinfo, const float *w, TSVector t, TSQuery q,
+		  int32 method)
 {
 	QueryItem  *item = GETQUERY(q);
+	QueryOperand **operands;
+	int			noperands;
 	float		res = 0.0;
 	int			len;
 
 	if (!t->size || !q->size)
 		return 0.0;
 
+	operands = getRankItems(flinfo, q, &noperands);
+
 	/* XXX: What about NOT? */
 	res = (item->type == QI_OPR && (item->qoperator.oper == OP_AND ||
 									item->qoperator.oper == OP_PHRASE)) ?
-		calc_rank_and(w, t, q) :
-		calc_rank_or(w, t, q);
+		calc_rank_and(w, t, q, operands, noperands) :
+		calc_rank_or(w, t, q, operands, noperands);
+
+	pfree(operands);
 
 	if (res < 0)
 		res = 1e-20f;
@@ -443,7 +519,7 @@ ts_rank_wttf(PG_FUNCTION_ARGS)
 	int			method = PG_GETARG_INT32(3);
 	float		res;
 
-	res = calc_rank(getWeights(win), txt, query, method);
+	res = calc_rank(fcinfo->flinfo, getWeights(win), txt, query, method);
 
 	PG_FREE_IF_COPY(win, 0);
 	PG_FREE_IF_COPY(txt, 1);
@@ -459,7 +535,8 @@ ts_rank_wtt(PG_FUNCTION_ARGS)
 	TSQuery		query = PG_GETARG_TSQUERY(2);
 	float		res;
 
-	res = calc_rank(getWeights(win), txt, query, DEF_NORM_METHOD);
+	res = calc_rank(fcinfo->flinfo, getWeights(win), txt, query,
+					DEF_NORM_METHOD);
 
 	PG_FREE_IF_COPY(win, 0);
 	PG_FREE_IF_COPY(txt, 1);
@@ -475,7 +552,7 @@ ts_rank_ttf(PG_FUNCTION_ARGS)
 	int			method = PG_GETARG_INT32(2);
 	float		res;
 
-	res = calc_rank(getWeights(NULL), txt, query, method);
+	res = calc_rank(fcinfo->flinfo, getWeights(NULL), txt, query, method);
 
 	PG_FREE_IF_COPY(txt, 0);
 	PG_FREE_IF_COPY(query, 1);
@@ -489,7 +566,8 @@ ts_rank_tt(PG_FUNCTION_ARGS)
 	TSQuery		query = PG_GETARG_TSQUERY(1);
 	float		res;
 
-	res = calc_rank(getWeights(NULL), txt, query, DEF_NORM_METHOD);
+	res = calc_rank(fcinfo->flinfo, getWeights(NULL), txt, query,
+					DEF_NORM_METHOD);
 
 	PG_FREE_IF_COPY(txt, 0);
 	PG_FREE_IF_COPY(query, 1);
@@ -753,7 +831,8 @@ get_docrep(TSVector txt, QueryRepresentation *qr, int *doclen)
 
 		curoperand = &item[i].qoperand;
 
-		firstentry = entry = find_wordentry(txt, qr->query, curoperand, &nitem);
+		firstentry = entry = find_wordentry(txt, qr->query, curoperand, &nitem,
+											NULL);
 		if (!entry)
 			continue;
 
@@ -75,6 +75,42 @@ typedef struct
 	int			refpos;			/* 0-based character offset of the same point */
 } TextPositionState;
 
+/*
+ * Cache of ICU sort keys, for varstrfastcmp_locale().  Entries are keyed by
+ * the string itself, copied into the cache, so that a string compared many
+ * times during a sort has its sort key computed once rather than being
+ * passed to the collator in every comparison.
+ */
+typedef struct SortKeyCacheKey
+{
+	const char *str;
+	int			len;
+} SortKeyCacheKey;
+
+typedef struct SortKeyCacheEntry
+{
+	SortKeyCacheKey key;
+	uint32		hash;			/* hash of the string */
+	char		status;			/* hash status */
+	int			keylen;			/* length of sort key, -1 until computed */
+	char	   *sortkey;
+} SortKeyCacheEntry;
+
+#define SH_PREFIX sortkeycache
+#define SH_ELEMENT_TYPE SortKeyCacheEntry
+#define SH_KEY_TYPE SortKeyCacheKey
+#define SH_KEY key
+#define SH_HASH_KEY(tb, k) \
+	hash_bytes((const unsigned char *) (k).str, (k).len)
+#define SH_EQUAL(tb, a, b) \
+	((a).len == (b).len && memcmp((a).str, (b).str, (a).len) == 0)
+#define SH_STORE_HASH
+#define SH_GET_HASH(tb, a) a->hash
+#define SH_SCOPE static inline
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
 typedef struct
 {
 	char	   *buf1;			/* 1st string, or abbreviation original string
@@ -92,6 +128,9 @@ typedef struct
 	hyperLogLogState full_card; /* Full key cardinality state */
 	double		prop_card;		/* Required cardinality proportion */
 	pg_locale_t locale;
+	sortkeycache_hash *keycache;	/* ICU sort keys, or NULL if not used */
+	MemoryContext keycache_cxt; /* holds keycache and its entries */
+	Size		keycache_limit; /* memory allowed for keycache_cxt */
 } VarStringSortSupport;
 
 /*
@@ -120,6 +159,8 @@ static int	namefastcmp_c(Datum x, Datum y, SortSupport ssup);
 static int	varlenafastcmp_locale(Datum x, Datum y, SortSupport ssup);
 static int	namefastcmp_locale(Datum x, Datum y, SortSupport ssup);
 static int	varstrfastcmp_locale(char *a1p, int len1, char *a2p, int len2, SortSupport ssup);
+static bool varstr_cached_sortkey(VarStringSortSupport *sss, char *str, int len,
+								  char **sortkey, int *keylen);
 static Datum varstr_abbrev_convert(Datum original, SortSupport ssup);
 static bool varstr_abbrev_abort(int memtupcount, SortSupport ssup);
 static int32 text_length(Datum str);
@@ -1982,8 +2023,33 @@ varstr_sortsupport(SortSupport ssup, Oid typid, Oid collid)
 		sss->cache_blob = true;
 		sss->collate_c = collate_c;
 		sss->typid = typid;
+		sss->keycache = NULL;
 		ssup->ssup_extra = sss;
 
+		/*
+		 * When sorting with an ICU collation, keep the full sort keys of the
+		 * strings that the comparator sees more than once.  Abbreviated keys
+		 * resolve most comparisons in a sort with a strxfrm() prefix, but the
+		 * rest, and all of those of a sort in which abbreviation was aborted,
+		 * compare strings that tend to come back many times, since every
+		 * string is compared O(log n) times.  memcmp() of two cached sort keys
+		 * is much cheaper than a call to the collator.  The keys are only
+		 * trustworthy with ICU; see pg_strxfrm_enabled().
+		 *
+		 * The cache may use up to a quarter of work_mem, on top of what the
+		 * sort itself uses; it is emptied whenever it grows past that.
+		 * Callers that don't ask for abbreviation are not sorting, but
+		 * comparing each value once or twice, and wouldn't benefit.
+		 */
+		if (abbreviate && locale && locale->provider == COLLPROVIDER_ICU)
+		{
+			sss->keycache_cxt = AllocSetContextCreate(ssup->ssup_cxt,
+													  "text sort key cache",
+													  ALLOCSET_DEFAULT_SIZES);
+			sss->keycache = sortkeycache_create(sss->keycache_cxt, 256, NULL);
+			sss->keycache_limit = (Size) work_mem * 1024 / 4;
+		}
+
 		/*
 		 * If possible, plan to use the abbreviated keys optimization.  The
 		 * core code may switch back to authoritative comparator should
@@ -2165,6 +2231,47 @@ varstrfastcmp_locale(char *a1p, int len1, char *a2p, int len2, SortSupport ssup)
 		len2 = bpchartruelen(a2p, len2);
 	}
 
+	/*
+	 * Compare the cached sort keys, if both strings have been seen before.
+	 * Both lookups are done even if the first one misses, so as to remember
+	 * the second string.  The strings contain no NUL bytes, so memcmp()
+	 * breaks ties the way strcmp() does below.
+	 */
+	if (sss->keycache != NULL)
+	{
+		char	   *key1,
+				   *key2;
+		int			keylen1,
+					keylen2;
+		bool		found1,
+					found2;
+
+		if (MemoryContextMemAllocated(sss->keycache_cxt, false) >
+			sss->keycache_limit)
+		{
+			MemoryContextReset(sss->keycache_cxt);
+			sss->keycache = sortkeycache_create(sss->keycache_cxt, 256, NULL);
+		}
+
+		found1 = varstr_cached_sortkey(sss, a1p, len1, &key1, &keylen1);
+		found2 = varstr_cached_sortkey(sss, a2p, len2, &key2, &keylen2);
+		if (found1 && found2)
+		{
+			result = memcmp(key1, key2, Min(keylen1, keylen2));
+			if (result == 0 && keylen1 != keylen2)
+				result = (keylen1 < keylen2) ? -1 : 1;
+
+			if (result == 0 && pg_locale_deterministic(sss->locale))
+			{
+				result = memcmp(a1p, a2p, Min(len1, len2));
+				if (result == 0 && len1 != len2)
+					result = (len1 < len2) ? -1 : 1;
+			}
+
+			return result;
+		}
+	}
+
 	if (len1 >= sss->buflen1)
 	{
 		sss->buflen1 = Max(len1 + 1, Min(sss->buflen1 * 2, MaxAllocSize));
@@ -2225,6 +2332,67 @@ varstrfastcmp_locale(char *a1p, int len1, char *a2p, int len2, SortSupport ssup)
 	return result;
 }
 
+/*
+ * Look up a string in the sort key cache of varstrfastcmp_locale().
+ *
+ * A string is entered into the cache the first time it is looked up, and its
+ * sort key computed the second time: strings that are compared only once
+ * are common enough, like those that an abbreviated key sets apart from
+ * all but a few others, and computing a sort key costs more than a
+ * comparison.  Returns true and sets *sortkey and *keylen if the string has
+ * a sort key.
+ */
+static bool
+varstr_cached_sortkey(VarStringSortSupport *sss, char *str, int len,
+					  char **sortkey, int *keylen)
+{
+	SortKeyCacheKey key;
+	SortKeyCacheEntry *entry;
+	bool		found;
+	char	   *copy;
+
+	key.str = str;
+	key.len = len;
+	entry = sortkeycache_insert(sss->keycache, key, &found);
+
+	if (!found)
+	{
+		copy = MemoryContextAlloc(sss->keycache_cxt, len);
+		memcpy(copy, str, len);
+		entry->key.str = copy;
+		entry->keylen = -1;
+		entry->sortkey = NULL;
+		return false;
+	}
+
+	if (entry->keylen < 0)
+	{
+		size_t		bsize;
+		size_t		bufsize = len * 2 + 16;
+
+		/* as in varstr_abbrev_convert(), retry until the key fits */
+		for (;;)
+		{
+			char	   *buf = MemoryContextAlloc(sss->keycache_cxt, bufsize);
+
+			bsize = pg_strnxfrm(buf, bufsize, entry->key.str, len,
+								sss->locale);
+			if (bsize < bufsize)
+			{
+				entry->sortkey = buf;
+				break;
+			}
+			pfree(buf);
+			bufsize = bsize + 1;
+		}
+		entry->keylen = (int) bsize;
+	}
+
+	*sortkey = entry->sortkey;
+	*keylen = entry->keylen;
+	return true;
+}
+
 /*
  * Conversion routine for sortsupport.  Converts original to abbreviated key
  * representation.  Our encoding strategy is simple -- pack the first 8 bytes
@@ -5062,6 +5230,9 @@ pg_column_compression(PG_FUNCTION_ARGS)
 		case TOAST_LZ4_COMPRESSION_ID:
 			result = "lz4";
 			break;
+		case TOAST_ZSTD_COMPRESSION_ID:
+			result = "zstd";
+			break;
 		default:
 			elog(ERROR, "invalid compression method id %d", cmid);
 	}
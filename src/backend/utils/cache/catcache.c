@@ -37,6 +37,8 @@
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
+#include "utils/sharedcatcache.h"
+#include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
 
@@ -1317,6 +1319,8 @@ SearchCatCacheMiss(CatCache *cache,
 	HeapTuple	ntp;
 	CatCTup    *ct;
 	Datum		arguments[CATCACHE_MAXKEYS];
+	bool		use_shared;
+	uint64		generation = 0;
 
 	/* Initialize local parameter array */
 	arguments[0] = v1;
@@ -1324,6 +1328,43 @@ SearchCatCacheMiss(CatCache *cache,
 	arguments[2] = v3;
 	arguments[3] = v4;
 
+	/*
+	 * See if another backend has loaded the tuple into the shared catalog
+	 * cache.  That's only for backends that don't see catalog contents of
+	 * their own; see sharedcatcache.c.
+	 */
+	use_shared = SharedCatCacheEnabled() &&
+		!IsBootstrapProcessingMode() &&
+		(cache->cc_relisshared || OidIsValid(MyDatabaseId)) &&
+		!TransactionIdIsValid(GetTopTransactionIdIfAny()) &&
+		!TransactionHasInvalidations() &&
+		!HistoricSnapshotActive();
+
+	if (use_shared)
+	{
+		ntp = SharedCatCacheLookup(cache, hashValue, arguments);
+		if (ntp != NULL)
+		{
+			ct = CatalogCacheCreateEntry(cache, ntp, arguments,
+										 hashValue, hashIndex,
+										 false);
+			heap_freetuple(ntp);
+			/* immediately set the refcount to 1 */
+			ResourceOwnerEnlargeCatCacheRefs(CurrentResourceOwner);
+			ct->refcount++;
+			ResourceOwnerRememberCatCacheRef(CurrentResourceOwner, &ct->tuple);
+			return &ct->tuple;
+		}
+
+		/*
+		 * We'll store what we find, unless it has been invalidated meanwhile;
+		 * to tell, remember the generation before our scan's snapshot is
+		 * taken, and make sure the snapshot is a new one.
+		 */
+		generation = SharedCatCacheGeneration(cache);
+		InvalidateCatalogSnapshot();
+	}
+
 	/*
 	 * Ok, need to make a lookup in the relation, copy the scankey and fill
 	 * out any per-call fields.
@@ -1376,6 +1417,10 @@ SearchCatCacheMiss(CatCache *cache,
 
 	table_close(relation, AccessShareLock);
 
+	/* Share the tuple, flattened as the local entry has it */
+	if (use_shared && ct != NULL && !ct->dead)
+		SharedCatCacheInsert(cache, hashValue, &ct->tuple, generation);
+
 	/*
 	 * If tuple was not found, we need to build a negative cache entry
 	 * containing a fake tuple.  The fake tuple has the correct key columns,
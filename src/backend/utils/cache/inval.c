@@ -867,6 +867,19 @@ PostPrepare_Inval(void)
 	AtEOXact_Inval(false);
 }
 
+/*
+ * TransactionHasInvalidations
+ *		Has the current transaction queued any invalidation messages?
+ *
+ * If so, it may have changed catalog contents in ways that other backends
+ * won't see until it commits.
+ */
+bool
+TransactionHasInvalidations(void)
+{
+	return transInvalInfo != NULL;
+}
+
 /*
  * xactGetCommittedInvalidationMessages() is called by
  * RecordTransactionCommit() to collect invalidation messages to add to the
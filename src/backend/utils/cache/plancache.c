@@ -58,6 +58,8 @@
 
 #include "access/transam.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "executor/execPartition.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
@@ -71,6 +73,7 @@
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 #include "utils/rls.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -103,14 +106,18 @@ static dlist_head cached_expression_list = DLIST_STATIC_INIT(cached_expression_l
 static void ReleaseGenericPlan(CachedPlanSource *plansource);
 static List *RevalidateCachedQuery(CachedPlanSource *plansource,
 								   QueryEnvironment *queryEnv);
-static bool CheckCachedPlan(CachedPlanSource *plansource);
+static bool CheckCachedPlan(CachedPlanSource *plansource,
+							ParamListInfo boundParams);
 static CachedPlan *BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 								   ParamListInfo boundParams, QueryEnvironment *queryEnv);
 static bool choose_custom_plan(CachedPlanSource *plansource,
 							   ParamListInfo boundParams);
 static double cached_plan_cost(CachedPlan *plan, bool include_planner);
+static bool SharedPlanCacheUsable(CachedPlanSource *plansource);
 static Query *QueryListGetPrimaryStmt(List *stmts);
-static void AcquireExecutorLocks(List *stmt_list, bool acquire);
+static List *AcquireExecutorLocks(List *stmt_list, bool acquire,
+								  CachedPlan *plan, ParamListInfo boundParams,
+								  List *unlocked);
 static void AcquirePlannerLocks(List *stmt_list, bool acquire);
 static void ScanQueryForLocks(Query *parsetree, bool acquire);
 static bool ScanQueryWalker(Node *node, bool *acquire);
@@ -224,6 +231,7 @@ CreateCachedPlan(RawStmt *raw_parse_tree,
 	plansource->total_custom_cost = 0;
 	plansource->num_generic_plans = 0;
 	plansource->num_custom_plans = 0;
+	plansource->shared_generic = false;
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -292,6 +300,7 @@ CreateOneShotCachedPlan(RawStmt *raw_parse_tree,
 	plansource->total_custom_cost = 0;
 	plansource->num_generic_plans = 0;
 	plansource->num_custom_plans = 0;
+	plansource->shared_generic = false;
 
 	return plansource;
 }
@@ -756,6 +765,9 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
 	plansource->rewriteRoleId = GetUserId();
 	plansource->rewriteRowSecurity = row_security;
 
+	/* Ask the shared plan cache about the new query tree afresh */
+	plansource->shared_generic = false;
+
 	/*
 	 * Also save the current search_path in the query_context.  (This should
 	 * not generate much extra cruft either, since almost certainly the path
@@ -796,9 +808,10 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
  * (We must do this for the "true" result to be race-condition-free.)
  */
 static bool
-CheckCachedPlan(CachedPlanSource *plansource)
+CheckCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams)
 {
 	CachedPlan *plan = plansource->gplan;
+	List	   *unlocked;
 
 	/* Assert that caller checked the querytree */
 	Assert(plansource->is_valid);
@@ -830,7 +843,8 @@ CheckCachedPlan(CachedPlanSource *plansource)
 		 */
 		Assert(plan->refcount > 0);
 
-		AcquireExecutorLocks(plan->stmt_list, true);
+		unlocked = AcquireExecutorLocks(plan->stmt_list, true, plan,
+										boundParams, NIL);
 
 		/*
 		 * If plan was transient, check to see if TransactionXmin has
@@ -852,7 +866,8 @@ CheckCachedPlan(CachedPlanSource *plansource)
 		}
 
 		/* Oops, the race case happened.  Release useless locks. */
-		AcquireExecutorLocks(plan->stmt_list, false);
+		AcquireExecutorLocks(plan->stmt_list, false, NULL, NULL,
+							 unlocked);
 	}
 
 	/*
@@ -890,6 +905,9 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	MemoryContext plan_context;
 	MemoryContext oldcxt = CurrentMemoryContext;
 	ListCell   *lc;
+	bool		use_shared;
+	bool		from_shared = false;
+	uint64		shared_generation = 0;
 
 	/*
 	 * Normally the querytree should be valid already, but if it's not,
@@ -908,40 +926,84 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 		qlist = RevalidateCachedQuery(plansource, queryEnv);
 
 	/*
-	 * If we don't already have a copy of the querytree list that can be
-	 * scribbled on by the planner, make one.  For a one-shot plan, we assume
-	 * it's okay to scribble on the original query_list.
+	 * Another session may have made a generic plan for the same statement
+	 * already.  Its relations haven't been locked by planning, so lock them
+	 * as CheckCachedPlan would, and check that the plan is still valid.
 	 */
-	if (qlist == NIL)
+	use_shared = boundParams == NULL && queryEnv == NULL &&
+		SharedPlanCacheUsable(plansource);
+	plist = NIL;
+	if (use_shared)
 	{
-		if (!plansource->is_oneshot)
-			qlist = copyObject(plansource->query_list);
-		else
-			qlist = plansource->query_list;
+		SharedPlanDeps *deps;
+
+		plist = SharedPlanCacheLookup(plansource, &deps);
+		if (plist != NIL)
+		{
+			AcquireExecutorLocks(plist, true, NULL, NULL, NIL);
+			if (SharedPlanCacheRecheck(deps) && plansource->is_valid)
+				from_shared = true;
+			else
+			{
+				AcquireExecutorLocks(plist, false, NULL, NULL, NIL);
+				plist = NIL;
+			}
+			pfree(deps);
+		}
+
+		if (!from_shared)
+		{
+			/*
+			 * We will offer the plan we make to the shared plan cache, which
+			 * needs it made from catalog contents no older than the current
+			 * generation.  See sharedplancache.c.
+			 */
+			shared_generation = SharedPlanCacheGeneration();
+			AcceptInvalidationMessages();
+			InvalidateCatalogSnapshot();
+			if (!plansource->is_valid)
+				qlist = RevalidateCachedQuery(plansource, queryEnv);
+		}
 	}
 
-	/*
-	 * If a snapshot is already set (the normal case), we can just use that
-	 * for planning.  But if it isn't, and we need one, install one.
-	 */
-	snapshot_set = false;
-	if (!ActiveSnapshotSet() &&
-		plansource->raw_parse_tree &&
-		analyze_requires_snapshot(plansource->raw_parse_tree))
+	if (!from_shared)
 	{
-		PushActiveSnapshot(GetTransactionSnapshot());
-		snapshot_set = true;
-	}
+		/*
+		 * If we don't already have a copy of the querytree list that can be
+		 * scribbled on by the planner, make one.  For a one-shot plan, we
+		 * assume it's okay to scribble on the original query_list.
+		 */
+		if (qlist == NIL)
+		{
+			if (!plansource->is_oneshot)
+				qlist = copyObject(plansource->query_list);
+			else
+				qlist = plansource->query_list;
+		}
 
-	/*
-	 * Generate the plan.
-	 */
-	plist = pg_plan_queries(qlist, plansource->query_string,
-							plansource->cursor_options, boundParams);
+		/*
+		 * If a snapshot is already set (the normal case), we can just use
+		 * that for planning.  But if it isn't, and we need one, install one.
+		 */
+		snapshot_set = false;
+		if (!ActiveSnapshotSet() &&
+			plansource->raw_parse_tree &&
+			analyze_requires_snapshot(plansource->raw_parse_tree))
+		{
+			PushActiveSnapshot(GetTransactionSnapshot());
+			snapshot_set = true;
+		}
 
-	/* Release snapshot if we got one */
-	if (snapshot_set)
-		PopActiveSnapshot();
+		/*
+		 * Generate the plan.
+		 */
+		plist = pg_plan_queries(qlist, plansource->query_string,
+								plansource->cursor_options, boundParams);
+
+		/* Release snapshot if we got one */
+		if (snapshot_set)
+			PopActiveSnapshot();
+	}
 
 	/*
 	 * Normally we make a dedicated memory context for the CachedPlan and its
@@ -1011,6 +1073,23 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 
 	MemoryContextSwitchTo(oldcxt);
 
+	/*
+	 * Offer a new generic plan to the shared plan cache, noting whether we'd
+	 * use it in preference to custom plans, so that other sessions can skip
+	 * making custom plans of their own to find out.
+	 */
+	if (use_shared && !from_shared)
+	{
+		bool		generic_preferred = false;
+
+		if (plansource->num_custom_plans >= 5)
+			generic_preferred = cached_plan_cost(plan, false) <
+				plansource->total_custom_cost / plansource->num_custom_plans;
+
+		SharedPlanCacheInsert(plansource, plan->stmt_list, generic_preferred,
+							  shared_generation);
+	}
+
 	return plan;
 }
 
@@ -1047,9 +1126,17 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 	if (plansource->cursor_options & CURSOR_OPT_CUSTOM_PLAN)
 		return true;
 
-	/* Generate custom plans until we have done at least 5 (arbitrary) */
+	/*
+	 * Generate custom plans until we have done at least 5 (arbitrary), unless
+	 * another session that did has found the generic plan to be cheaper.
+	 */
 	if (plansource->num_custom_plans < 5)
-		return true;
+	{
+		if (!plansource->shared_generic && SharedPlanCacheUsable(plansource))
+			plansource->shared_generic =
+				SharedPlanCacheGenericPreferred(plansource);
+		return !plansource->shared_generic;
+	}
 
 	avg_custom_cost = plansource->total_custom_cost / plansource->num_custom_plans;
 
@@ -1069,6 +1156,27 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 	return true;
 }
 
+/*
+ * SharedPlanCacheUsable: may this plan source use the shared plan cache?
+ *
+ * Only saved plan sources are considered, since invalidations of the
+ * generic plan are only tracked for those.  Statements whose parameters are
+ * resolved by hooks, as in PL/pgSQL, may mean different things in different
+ * places, so they are not considered either.  Nor are transactions that
+ * have written the catalogs, as their plans may depend on changes other
+ * sessions don't see.
+ */
+static bool
+SharedPlanCacheUsable(CachedPlanSource *plansource)
+{
+	return SharedPlanCacheEnabled() &&
+		plansource->is_saved &&
+		!plansource->is_oneshot &&
+		plansource->parserSetup == NULL &&
+		StmtPlanRequiresRevalidation(plansource) &&
+		!TransactionHasInvalidations();
+}
+
 /*
  * cached_plan_cost: calculate estimated cost of a plan
  *
@@ -1164,7 +1272,7 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 
 	if (!customplan)
 	{
-		if (CheckCachedPlan(plansource))
+		if (CheckCachedPlan(plansource, boundParams))
 		{
 			/* We want a generic plan, and we already have a valid one */
 			plan = plansource->gplan;
@@ -1586,6 +1694,7 @@ CopyCachedPlan(CachedPlanSource *plansource)
 	newsource->total_custom_cost = plansource->total_custom_cost;
 	newsource->num_generic_plans = plansource->num_generic_plans;
 	newsource->num_custom_plans = plansource->num_custom_plans;
+	newsource->shared_generic = plansource->shared_generic;
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -1744,16 +1853,28 @@ QueryListGetPrimaryStmt(List *stmts)
 /*
  * AcquireExecutorLocks: acquire locks needed for execution of a cached plan;
  * or release them if acquire is false.
+ *
+ * When acquiring for a CachedPlan with boundParams, leaf partitions that
+ * initial pruning will eliminate with those parameter values are left
+ * unlocked; see ExecGetPrunedPartitionRelids().  With thousands of partitions of which
+ * only a few are scanned, locking them all would be most of the work.  We
+ * return a list with the range table indexes of those for each statement,
+ * which must be passed back when releasing the locks.
  */
-static void
-AcquireExecutorLocks(List *stmt_list, bool acquire)
+static List *
+AcquireExecutorLocks(List *stmt_list, bool acquire, CachedPlan *plan,
+					 ParamListInfo boundParams, List *unlocked)
 {
+	List	   *result = NIL;
 	ListCell   *lc1;
 
 	foreach(lc1, stmt_list)
 	{
 		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc1);
+		Bitmapset  *pruned = NULL;
+		bool		partitioned_locked = false;
 		ListCell   *lc2;
+		Index		rti;
 
 		if (plannedstmt->commandType == CMD_UTILITY)
 		{
@@ -1768,17 +1889,63 @@ AcquireExecutorLocks(List *stmt_list, bool acquire)
 
 			if (query)
 				ScanQueryForLocks(query, acquire);
+			result = lappend(result, NULL);
 			continue;
 		}
 
+		if (!acquire)
+		{
+			if (unlocked != NIL)
+				pruned = (Bitmapset *) list_nth(unlocked,
+												foreach_current_index(lc1));
+		}
+		else if (plan != NULL && boundParams != NULL &&
+				 plannedstmt->commandType == CMD_SELECT &&
+				 plannedstmt->rowMarks == NIL &&
+				 !plannedstmt->hasModifyingCTE &&
+				 ActiveSnapshotSet())
+		{
+			/*
+			 * Pruning needs the partitioned tables locked, so lock those
+			 * first.  Plain SELECTs without row marks only open the
+			 * partitions they scan.
+			 */
+			foreach(lc2, plannedstmt->rtable)
+			{
+				RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc2);
+
+				if (rte->rtekind == RTE_RELATION &&
+					rte->relkind == RELKIND_PARTITIONED_TABLE)
+				{
+					LockRelationOid(rte->relid, rte->rellockmode);
+					partitioned_locked = true;
+				}
+			}
+
+			/* Don't look into a plan that was invalidated meanwhile */
+			if (partitioned_locked && plan->is_valid)
+				pruned = ExecGetPrunedPartitionRelids(plannedstmt,
+													  boundParams);
+		}
+
+		rti = 0;
 		foreach(lc2, plannedstmt->rtable)
 		{
 			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc2);
 
+			rti++;
+
 			if (!(rte->rtekind == RTE_RELATION ||
 				  (rte->rtekind == RTE_SUBQUERY && OidIsValid(rte->relid))))
 				continue;
 
+			/* Skip what was locked above, or is left unlocked */
+			if (partitioned_locked && rte->rtekind == RTE_RELATION &&
+				rte->relkind == RELKIND_PARTITIONED_TABLE)
+				continue;
+			if (bms_is_member(rti, pruned))
+				continue;
+
 			/*
 			 * Acquire the appropriate type of lock on each relation OID. Note
 			 * that we don't actually try to open the rel, and hence will not
@@ -1790,7 +1957,11 @@ AcquireExecutorLocks(List *stmt_list, bool acquire)
 			else
 				UnlockRelationOid(rte->relid, rte->rellockmode);
 		}
+
+		result = lappend(result, pruned);
 	}
+
+	return result;
 }
 
 /*
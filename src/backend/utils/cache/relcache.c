@@ -43,6 +43,7 @@
 #include "access/xlog.h"
 #include "catalog/binary_upgrade.h"
 #include "catalog/catalog.h"
+#include "catalog/index.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
 #include "catalog/partition.h"
@@ -270,6 +271,27 @@ typedef struct opclasscacheent
 
 static HTAB *OpClassCache = NULL;
 
+/*
+ * Catalog rows read ahead of time by RelationCachePrefetch, which
+ * RelationBuildDesc, RelationBuildTupleDesc and RelationGetIndexList use
+ * instead of scanning the catalogs for one relation at a time.  An entry is
+ * discarded when an invalidation arrives for its relation, and all of them
+ * at end of transaction, so they never outlive the catalog state they were
+ * read from.
+ */
+typedef struct relprefetchent
+{
+	Oid			relid;			/* lookup key: OID of relation */
+	HeapTuple	classtup;		/* its pg_class row */
+	List	   *atttups;		/* its pg_attribute rows with attnum > 0 */
+	List	   *indextups;		/* its pg_index rows */
+} RelPrefetchEnt;
+
+static HTAB *RelPrefetchCache = NULL;
+static MemoryContext RelPrefetchContext = NULL;
+static TupleDesc RelPrefetchAttDesc = NULL; /* pg_attribute's, for
+											 * attmissingval */
+
 
 /* non-export function prototypes */
 
@@ -294,6 +316,9 @@ static void formrdesc(const char *relationName, Oid relationReltype,
 					  bool isshared, int natts, const FormData_pg_attribute *attrs);
 
 static HeapTuple ScanPgRelation(Oid targetRelId, bool indexOK, bool force_non_historic);
+static RelPrefetchEnt *RelationPrefetchLookup(Oid relid);
+static void RelationPrefetchForget(Oid relid);
+static void RelationPrefetchReset(void);
 static Relation AllocateRelationDesc(Form_pg_class relp);
 static void RelationParseRelOptions(Relation relation, HeapTuple tuple);
 static void RelationBuildTupleDesc(Relation relation);
@@ -397,6 +422,246 @@ ScanPgRelation(Oid targetRelId, bool indexOK, bool force_non_historic)
 	return pg_class_tuple;
 }
 
+/*
+ * RelationCachePrefetch
+ *
+ *		Read the pg_class, pg_attribute and pg_index rows of the given
+ *		relations that aren't in the relcache yet, using one index scan per
+ *		catalog that searches for all of them at once, so that building
+ *		their relcache entries afterwards needs no scans of those catalogs.
+ *		This is meant for callers about to open many relations, such as the
+ *		partitions of a partitioned table, where the per-relation index
+ *		descents otherwise dominate.
+ *
+ *		The caller needn't hold locks on the relations yet: any change to
+ *		them is announced by an invalidation, which we will have absorbed
+ *		by the time we've locked a relation and then build its entry.
+ */
+void
+RelationCachePrefetch(Oid *relids, int nrelids)
+{
+	Datum	   *keys;
+	int			nkeys = 0;
+	ArrayType  *keyarray;
+	Relation	classrel;
+	Relation	attrel;
+	Relation	indexrel;
+	Relation	classidx;
+	Relation	attidx;
+	Relation	indexidx;
+	Snapshot	snapshot;
+	ScanKeyData skey[2];
+	SysScanDesc scan;
+	HeapTuple	htup;
+	RelPrefetchEnt *entry;
+	MemoryContext oldcxt;
+	HASH_SEQ_STATUS status;
+	int			i;
+
+	/*
+	 * Heap scans can't search for an array of keys, so we can only do this
+	 * when the catalog indexes are usable.  Logical decoding's historic
+	 * snapshots are left to the regular code paths.
+	 */
+	if (!criticalRelcachesBuilt || IgnoreSystemIndexes ||
+		HistoricSnapshotActive() ||
+		ReindexIsProcessingIndex(ClassOidIndexId) ||
+		ReindexIsProcessingIndex(AttributeRelidNumIndexId) ||
+		ReindexIsProcessingIndex(IndexIndrelidIndexId))
+		return;
+
+	if (RelPrefetchCache == NULL)
+	{
+		HASHCTL		ctl;
+
+		RelPrefetchContext = AllocSetContextCreate(CacheMemoryContext,
+												   "relcache prefetch",
+												   ALLOCSET_DEFAULT_SIZES);
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(RelPrefetchEnt);
+		ctl.hcxt = RelPrefetchContext;
+		RelPrefetchCache = hash_create("Relcache prefetch", 64, &ctl,
+									   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	/* Only bother with relations we'd otherwise have to read one by one */
+	keys = (Datum *) palloc(nrelids * sizeof(Datum));
+	for (i = 0; i < nrelids; i++)
+	{
+		Relation	relation;
+
+		RelationIdCacheLookup(relids[i], relation);
+		if (relation != NULL ||
+			hash_search(RelPrefetchCache, &relids[i], HASH_FIND, NULL) != NULL)
+			continue;
+		keys[nkeys++] = ObjectIdGetDatum(relids[i]);
+	}
+	if (nkeys < 2)
+	{
+		pfree(keys);
+		return;
+	}
+	keyarray = construct_array_builtin(keys, nkeys, OIDOID);
+
+	/*
+	 * Lock the catalogs and their indexes before we start, so that no
+	 * invalidation is absorbed, possibly destroying entries we are filling
+	 * in, until we are done; and read all three with the same snapshot, so
+	 * that the rows we keep are consistent with each other.
+	 */
+	classrel = table_open(RelationRelationId, AccessShareLock);
+	attrel = table_open(AttributeRelationId, AccessShareLock);
+	indexrel = table_open(IndexRelationId, AccessShareLock);
+	classidx = index_open(ClassOidIndexId, AccessShareLock);
+	attidx = index_open(AttributeRelidNumIndexId, AccessShareLock);
+	indexidx = index_open(IndexIndrelidIndexId, AccessShareLock);
+	snapshot = RegisterSnapshot(GetCatalogSnapshot(RelationRelationId));
+
+	oldcxt = MemoryContextSwitchTo(RelPrefetchContext);
+
+	if (RelPrefetchAttDesc == NULL)
+		RelPrefetchAttDesc = CreateTupleDescCopy(RelationGetDescr(attrel));
+
+	for (i = 0; i < nkeys; i++)
+	{
+		Oid			relid = DatumGetObjectId(keys[i]);
+
+		entry = hash_search(RelPrefetchCache, &relid, HASH_ENTER, NULL);
+		entry->classtup = NULL;
+		entry->atttups = NIL;
+		entry->indextups = NIL;
+	}
+
+	ScanKeyEntryInitialize(&skey[0], SK_SEARCHARRAY,
+						   Anum_pg_class_oid,
+						   BTEqualStrategyNumber, InvalidOid,
+						   InvalidOid, F_OIDEQ,
+						   PointerGetDatum(keyarray));
+	scan = systable_beginscan(classrel, ClassOidIndexId, true,
+							  snapshot, 1, skey);
+	while (HeapTupleIsValid(htup = systable_getnext(scan)))
+	{
+		Oid			relid = ((Form_pg_class) GETSTRUCT(htup))->oid;
+
+		entry = hash_search(RelPrefetchCache, &relid, HASH_FIND, NULL);
+		if (entry != NULL && entry->classtup == NULL)
+			entry->classtup = heap_copytuple(htup);
+	}
+	systable_endscan(scan);
+
+	ScanKeyEntryInitialize(&skey[0], SK_SEARCHARRAY,
+						   Anum_pg_attribute_attrelid,
+						   BTEqualStrategyNumber, InvalidOid,
+						   InvalidOid, F_OIDEQ,
+						   PointerGetDatum(keyarray));
+	ScanKeyInit(&skey[1],
+				Anum_pg_attribute_attnum,
+				BTGreaterStrategyNumber, F_INT2GT,
+				Int16GetDatum(0));
+	scan = systable_beginscan(attrel, AttributeRelidNumIndexId, true,
+							  snapshot, 2, skey);
+	while (HeapTupleIsValid(htup = systable_getnext(scan)))
+	{
+		Oid			relid = ((Form_pg_attribute) GETSTRUCT(htup))->attrelid;
+
+		entry = hash_search(RelPrefetchCache, &relid, HASH_FIND, NULL);
+		if (entry != NULL)
+			entry->atttups = lappend(entry->atttups, heap_copytuple(htup));
+	}
+	systable_endscan(scan);
+
+	ScanKeyEntryInitialize(&skey[0], SK_SEARCHARRAY,
+						   Anum_pg_index_indrelid,
+						   BTEqualStrategyNumber, InvalidOid,
+						   InvalidOid, F_OIDEQ,
+						   PointerGetDatum(keyarray));
+	scan = systable_beginscan(indexrel, IndexIndrelidIndexId, true,
+							  snapshot, 1, skey);
+	while (HeapTupleIsValid(htup = systable_getnext(scan)))
+	{
+		Oid			relid = ((Form_pg_index) GETSTRUCT(htup))->indrelid;
+
+		entry = hash_search(RelPrefetchCache, &relid, HASH_FIND, NULL);
+		if (entry != NULL)
+			entry->indextups = lappend(entry->indextups, heap_copytuple(htup));
+	}
+	systable_endscan(scan);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	UnregisterSnapshot(snapshot);
+	index_close(indexidx, AccessShareLock);
+	index_close(attidx, AccessShareLock);
+	index_close(classidx, AccessShareLock);
+	table_close(indexrel, AccessShareLock);
+	table_close(attrel, AccessShareLock);
+	table_close(classrel, AccessShareLock);
+
+	/* Relations that have gone away are left to the regular code paths */
+	hash_seq_init(&status, RelPrefetchCache);
+	while ((entry = (RelPrefetchEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (entry->classtup == NULL)
+			RelationPrefetchForget(entry->relid);
+	}
+
+	pfree(keyarray);
+	pfree(keys);
+}
+
+/*
+ * RelationPrefetchLookup
+ *
+ *		Return the rows RelationCachePrefetch read for relid, or NULL.
+ *		The result is only good until the next catalog access.
+ */
+static RelPrefetchEnt *
+RelationPrefetchLookup(Oid relid)
+{
+	if (RelPrefetchCache == NULL)
+		return NULL;
+	return (RelPrefetchEnt *) hash_search(RelPrefetchCache, &relid,
+										  HASH_FIND, NULL);
+}
+
+/*
+ * RelationPrefetchForget
+ *
+ *		Discard the rows RelationCachePrefetch read for relid, if any.
+ */
+static void
+RelationPrefetchForget(Oid relid)
+{
+	RelPrefetchEnt *entry;
+
+	entry = RelationPrefetchLookup(relid);
+	if (entry == NULL)
+		return;
+
+	if (entry->classtup)
+		heap_freetuple(entry->classtup);
+	list_free_deep(entry->atttups);
+	list_free_deep(entry->indextups);
+	hash_search(RelPrefetchCache, &relid, HASH_REMOVE, NULL);
+}
+
+/*
+ * RelationPrefetchReset
+ *
+ *		Discard everything RelationCachePrefetch has read.
+ */
+static void
+RelationPrefetchReset(void)
+{
+	if (RelPrefetchContext == NULL)
+		return;
+
+	MemoryContextDelete(RelPrefetchContext);
+	RelPrefetchContext = NULL;
+	RelPrefetchCache = NULL;
+	RelPrefetchAttDesc = NULL;
+}
+
 /*
  *		AllocateRelationDesc
  *
@@ -519,9 +784,12 @@ static void
 RelationBuildTupleDesc(Relation relation)
 {
 	HeapTuple	pg_attribute_tuple;
-	Relation	pg_attribute_desc;
-	SysScanDesc pg_attribute_scan;
+	Relation	pg_attribute_desc = NULL;
+	SysScanDesc pg_attribute_scan = NULL;
+	TupleDesc	pg_attribute_tupdesc;
 	ScanKeyData skey[2];
+	RelPrefetchEnt *prefetch;
+	ListCell   *prefetch_cell = NULL;
 	int			need;
 	TupleConstr *constr;
 	AttrMissing *attrmiss = NULL;
@@ -538,41 +806,69 @@ RelationBuildTupleDesc(Relation relation)
 	constr->has_generated_stored = false;
 
 	/*
-	 * Form a scan key that selects only user attributes (attnum > 0).
-	 * (Eliminating system attribute rows at the index level is lots faster
-	 * than fetching them.)
+	 * Use the rows RelationCachePrefetch read, if there are any.  Nothing in
+	 * the loop below accesses the catalogs, so they can't go away under us.
 	 */
-	ScanKeyInit(&skey[0],
-				Anum_pg_attribute_attrelid,
-				BTEqualStrategyNumber, F_OIDEQ,
-				ObjectIdGetDatum(RelationGetRelid(relation)));
-	ScanKeyInit(&skey[1],
-				Anum_pg_attribute_attnum,
-				BTGreaterStrategyNumber, F_INT2GT,
-				Int16GetDatum(0));
+	prefetch = RelationPrefetchLookup(RelationGetRelid(relation));
+	if (prefetch)
+	{
+		pg_attribute_tupdesc = RelPrefetchAttDesc;
+		prefetch_cell = list_head(prefetch->atttups);
+	}
+	else
+	{
+		/*
+		 * Form a scan key that selects only user attributes (attnum > 0).
+		 * (Eliminating system attribute rows at the index level is lots
+		 * faster than fetching them.)
+		 */
+		ScanKeyInit(&skey[0],
+					Anum_pg_attribute_attrelid,
+					BTEqualStrategyNumber, F_OIDEQ,
+					ObjectIdGetDatum(RelationGetRelid(relation)));
+		ScanKeyInit(&skey[1],
+					Anum_pg_attribute_attnum,
+					BTGreaterStrategyNumber, F_INT2GT,
+					Int16GetDatum(0));
 
-	/*
-	 * Open pg_attribute and begin a scan.  Force heap scan if we haven't yet
-	 * built the critical relcache entries (this includes initdb and startup
-	 * without a pg_internal.init file).
-	 */
-	pg_attribute_desc = table_open(AttributeRelationId, AccessShareLock);
-	pg_attribute_scan = systable_beginscan(pg_attribute_desc,
-										   AttributeRelidNumIndexId,
-										   criticalRelcachesBuilt,
-										   NULL,
-										   2, skey);
+		/*
+		 * Open pg_attribute and begin a scan.  Force heap scan if we haven't
+		 * yet built the critical relcache entries (this includes initdb and
+		 * startup without a pg_internal.init file).
+		 */
+		pg_attribute_desc = table_open(AttributeRelationId, AccessShareLock);
+		pg_attribute_tupdesc = RelationGetDescr(pg_attribute_desc);
+		pg_attribute_scan = systable_beginscan(pg_attribute_desc,
+											   AttributeRelidNumIndexId,
+											   criticalRelcachesBuilt,
+											   NULL,
+											   2, skey);
+	}
 
 	/*
 	 * add attribute data to relation->rd_att
 	 */
 	need = RelationGetNumberOfAttributes(relation);
 
-	while (HeapTupleIsValid(pg_attribute_tuple = systable_getnext(pg_attribute_scan)))
+	for (;;)
 	{
 		Form_pg_attribute attp;
 		int			attnum;
 
+		if (prefetch)
+		{
+			if (prefetch_cell == NULL)
+				break;
+			pg_attribute_tuple = (HeapTuple) lfirst(prefetch_cell);
+			prefetch_cell = lnext(prefetch->atttups, prefetch_cell);
+		}
+		else
+		{
+			pg_attribute_tuple = systable_getnext(pg_attribute_scan);
+			if (!HeapTupleIsValid(pg_attribute_tuple))
+				break;
+		}
+
 		attp = (Form_pg_attribute) GETSTRUCT(pg_attribute_tuple);
 
 		attnum = attp->attnum;
@@ -601,7 +897,7 @@ RelationBuildTupleDesc(Relation relation)
 			/* Do we have a missing value? */
 			missingval = heap_getattr(pg_attribute_tuple,
 									  Anum_pg_attribute_attmissingval,
-									  pg_attribute_desc->rd_att,
+									  pg_attribute_tupdesc,
 									  &missingNull);
 			if (!missingNull)
 			{
@@ -651,8 +947,11 @@ RelationBuildTupleDesc(Relation relation)
 	/*
 	 * end the scan and close the attribute relation
 	 */
-	systable_endscan(pg_attribute_scan);
-	table_close(pg_attribute_desc, AccessShareLock);
+	if (!prefetch)
+	{
+		systable_endscan(pg_attribute_scan);
+		table_close(pg_attribute_desc, AccessShareLock);
+	}
 
 	if (need != 0)
 		elog(ERROR, "pg_attribute catalog is missing %d attribute(s) for relation OID %u",
@@ -1042,6 +1341,7 @@ RelationBuildDesc(Oid targetRelId, bool insertIt)
 	Oid			relid;
 	HeapTuple	pg_class_tuple;
 	Form_pg_class relp;
+	RelPrefetchEnt *prefetch;
 
 	/*
 	 * This function and its subroutines can allocate a good deal of transient
@@ -1087,9 +1387,14 @@ retry:
 	in_progress_list[in_progress_offset].invalidated = false;
 
 	/*
-	 * find the tuple in pg_class corresponding to the given relation id
+	 * find the tuple in pg_class corresponding to the given relation id,
+	 * unless RelationCachePrefetch has already read it
 	 */
-	pg_class_tuple = ScanPgRelation(targetRelId, true, false);
+	prefetch = RelationPrefetchLookup(targetRelId);
+	if (prefetch)
+		pg_class_tuple = heap_copytuple(prefetch->classtup);
+	else
+		pg_class_tuple = ScanPgRelation(targetRelId, true, false);
 
 	/*
 	 * if no such tuple exists, return NULL
@@ -1214,28 +1519,18 @@ retry:
 	RelationParseRelOptions(relation, pg_class_tuple);
 
 	/*
-	 * Fetch rules and triggers that affect this relation.
-	 *
-	 * Note that RelationBuildRuleLock() relies on this being done after
-	 * extracting the relation's reloptions.
+	 * Rules, triggers and row security policies are not loaded here; most
+	 * relation opens never look at them, and scanning pg_rewrite, pg_trigger
+	 * and pg_policy for each of many partitions adds up.  They are fetched
+	 * on first use by RelationGetRuleLock and friends.
 	 */
-	if (relation->rd_rel->relhasrules)
-		RelationBuildRuleLock(relation);
-	else
-	{
-		relation->rd_rules = NULL;
-		relation->rd_rulescxt = NULL;
-	}
-
-	if (relation->rd_rel->relhastriggers)
-		RelationBuildTriggers(relation);
-	else
-		relation->trigdesc = NULL;
-
-	if (relation->rd_rel->relrowsecurity)
-		RelationBuildRowSecurity(relation);
-	else
-		relation->rd_rsdesc = NULL;
+	relation->rd_rules = NULL;
+	relation->rd_rulescxt = NULL;
+	relation->rd_rulesvalid = false;
+	relation->trigdesc = NULL;
+	relation->rd_trigdescvalid = false;
+	relation->rd_rsdesc = NULL;
+	relation->rd_rsdescvalid = false;
 
 	/*
 	 * initialize the relation lock manager information
@@ -2632,6 +2927,18 @@ RelationClearRelation(Relation relation, bool rebuild)
 		/* Build temporary entry, but don't link it into hashtable */
 		newrel = RelationBuildDesc(save_relid, false);
 
+		/*
+		 * If the old entry has loaded its rules or policies, load the new
+		 * entry's too, so that we can tell below whether they changed.
+		 */
+		if (newrel != NULL)
+		{
+			if (relation->rd_rulesvalid)
+				(void) RelationGetRuleLock(newrel);
+			if (relation->rd_rsdescvalid)
+				(void) RelationGetRowSecurity(newrel);
+		}
+
 		/*
 		 * Between here and the end of the swap, don't add code that does or
 		 * reasonably could read system catalogs.  That range must be free
@@ -2671,8 +2978,16 @@ RelationClearRelation(Relation relation, bool rebuild)
 		Assert(relation->rd_rel->relkind == newrel->rd_rel->relkind);
 
 		keep_tupdesc = equalTupleDescs(relation->rd_att, newrel->rd_att);
-		keep_rules = equalRuleLocks(relation->rd_rules, newrel->rd_rules);
-		keep_policies = equalRSDesc(relation->rd_rsdesc, newrel->rd_rsdesc);
+
+		/*
+		 * Rules and policies that were never loaded are kept not-loaded.  The
+		 * old entry may be in the midst of loading them, in which case its
+		 * private memory context must stay with it.
+		 */
+		keep_rules = !relation->rd_rulesvalid ||
+			equalRuleLocks(relation->rd_rules, newrel->rd_rules);
+		keep_policies = !relation->rd_rsdescvalid ||
+			equalRSDesc(relation->rd_rsdesc, newrel->rd_rsdesc);
 		/* partkey is immutable once set up, so we can always keep it */
 		keep_partkey = (relation->rd_partkey != NULL);
 
@@ -2724,9 +3039,13 @@ RelationClearRelation(Relation relation, bool rebuild)
 		{
 			SWAPFIELD(RuleLock *, rd_rules);
 			SWAPFIELD(MemoryContext, rd_rulescxt);
+			SWAPFIELD(bool, rd_rulesvalid);
 		}
 		if (keep_policies)
+		{
 			SWAPFIELD(RowSecurityDesc *, rd_rsdesc);
+			SWAPFIELD(bool, rd_rsdescvalid);
+		}
 		/* toast OID override must be preserved */
 		SWAPFIELD(Oid, rd_toastoid);
 		/* pgstat_info / enabled must be preserved */
@@ -2879,6 +3198,8 @@ RelationCacheInvalidateEntry(Oid relationId)
 {
 	Relation	relation;
 
+	RelationPrefetchForget(relationId);
+
 	RelationIdCacheLookup(relationId, relation);
 
 	if (PointerIsValid(relation))
@@ -2941,6 +3262,9 @@ RelationCacheInvalidate(bool debug_discard)
 	ListCell   *l;
 	int			i;
 
+	/* Forget any prefetched catalog rows */
+	RelationPrefetchReset();
+
 	/*
 	 * Reload relation mapping data before starting to reconstruct cache.
 	 */
@@ -3188,6 +3512,9 @@ AtEOXact_RelationCache(bool isCommit)
 	Assert(in_progress_list_len == 0 || !isCommit);
 	in_progress_list_len = 0;
 
+	/* Prefetched catalog rows are only good for one transaction */
+	RelationPrefetchReset();
+
 	/*
 	 * Unless the eoxact_list[] overflowed, we only need to examine the rels
 	 * listed in it.  Otherwise fall back on a hash_seq_search scan.
@@ -4235,42 +4562,10 @@ RelationCacheInitializePhase3(void)
 		}
 
 		/*
-		 * Fix data that isn't saved in relcache cache file.
-		 *
-		 * relhasrules or relhastriggers could possibly be wrong or out of
-		 * date.  If we don't actually find any rules or triggers, clear the
-		 * local copy of the flag so that we don't get into an infinite loop
-		 * here.  We don't make any attempt to fix the pg_class entry, though.
+		 * Rules, triggers and row security policies aren't saved in the
+		 * relcache cache file either, but they are loaded on first use (see
+		 * RelationGetRuleLock and friends), so nothing need be done here.
 		 */
-		if (relation->rd_rel->relhasrules && relation->rd_rules == NULL)
-		{
-			RelationBuildRuleLock(relation);
-			if (relation->rd_rules == NULL)
-				relation->rd_rel->relhasrules = false;
-			restart = true;
-		}
-		if (relation->rd_rel->relhastriggers && relation->trigdesc == NULL)
-		{
-			RelationBuildTriggers(relation);
-			if (relation->trigdesc == NULL)
-				relation->rd_rel->relhastriggers = false;
-			restart = true;
-		}
-
-		/*
-		 * Re-load the row security policies if the relation has them, since
-		 * they are not preserved in the cache.  Note that we can never NOT
-		 * have a policy while relrowsecurity is true,
-		 * RelationBuildRowSecurity will create a single default-deny policy
-		 * if there is no policy defined in pg_policy.
-		 */
-		if (relation->rd_rel->relrowsecurity && relation->rd_rsdesc == NULL)
-		{
-			RelationBuildRowSecurity(relation);
-
-			Assert(relation->rd_rsdesc != NULL);
-			restart = true;
-		}
 
 		/* Reload tableam data if needed */
 		if (relation->rd_tableam == NULL &&
@@ -4613,6 +4908,75 @@ CheckConstraintCmp(const void *a, const void *b)
 	return strcmp(ca->ccname, cb->ccname);
 }
 
+/*
+ * RelationGetRuleLock -- get the rewrite rules of the relation
+ *
+ * Returns NULL if the relation has no rules.  The rules are read from
+ * pg_rewrite the first time they are asked for.  Note that
+ * RelationBuildRuleLock relies on the relation's reloptions having been
+ * extracted already, which RelationBuildDesc does.
+ *
+ * CAUTION: like rd_rules itself, the result could vanish in a relcache
+ * entry reset.
+ */
+RuleLock *
+RelationGetRuleLock(Relation relation)
+{
+	if (relation->rd_rulesvalid)
+		return relation->rd_rules;
+
+	/* forget any remains of a load that failed partway through */
+	if (relation->rd_rulescxt)
+		MemoryContextDelete(relation->rd_rulescxt);
+	relation->rd_rules = NULL;
+	relation->rd_rulescxt = NULL;
+
+	if (relation->rd_rel->relhasrules)
+		RelationBuildRuleLock(relation);
+	relation->rd_rulesvalid = true;
+
+	return relation->rd_rules;
+}
+
+/*
+ * RelationGetTriggerDesc -- get the triggers of the relation
+ *
+ * Returns NULL if the relation has no triggers.  As for the rules, the
+ * triggers are read from pg_trigger the first time they are asked for.
+ */
+TriggerDesc *
+RelationGetTriggerDesc(Relation relation)
+{
+	if (relation->rd_trigdescvalid)
+		return relation->trigdesc;
+
+	if (relation->rd_rel->relhastriggers)
+		RelationBuildTriggers(relation);
+	relation->rd_trigdescvalid = true;
+
+	return relation->trigdesc;
+}
+
+/*
+ * RelationGetRowSecurity -- get the row security policies of the relation
+ *
+ * Returns NULL unless row security is enabled for the relation.  Note that
+ * RelationBuildRowSecurity builds a default-deny policy if pg_policy has
+ * none for a relation that has row security enabled.
+ */
+RowSecurityDesc *
+RelationGetRowSecurity(Relation relation)
+{
+	if (relation->rd_rsdescvalid)
+		return relation->rd_rsdesc;
+
+	if (relation->rd_rel->relrowsecurity)
+		RelationBuildRowSecurity(relation);
+	relation->rd_rsdescvalid = true;
+
+	return relation->rd_rsdesc;
+}
+
 /*
  * RelationGetFKeyList -- get a list of foreign key info for the relation
  *
@@ -4739,10 +5103,12 @@ RelationGetFKeyList(Relation relation)
 List *
 RelationGetIndexList(Relation relation)
 {
-	Relation	indrel;
-	SysScanDesc indscan;
+	Relation	indrel = NULL;
+	SysScanDesc indscan = NULL;
 	ScanKeyData skey;
 	HeapTuple	htup;
+	RelPrefetchEnt *prefetch;
+	ListCell   *prefetch_cell = NULL;
 	List	   *result;
 	List	   *oldlist;
 	char		replident = relation->rd_rel->relreplident;
@@ -4762,19 +5128,43 @@ RelationGetIndexList(Relation relation)
 	 */
 	result = NIL;
 
-	/* Prepare to scan pg_index for entries having indrelid = this rel. */
-	ScanKeyInit(&skey,
-				Anum_pg_index_indrelid,
-				BTEqualStrategyNumber, F_OIDEQ,
-				ObjectIdGetDatum(RelationGetRelid(relation)));
+	/*
+	 * Use the rows RelationCachePrefetch read, if there are any; otherwise
+	 * prepare to scan pg_index for entries having indrelid = this rel.
+	 */
+	prefetch = RelationPrefetchLookup(RelationGetRelid(relation));
+	if (prefetch)
+		prefetch_cell = list_head(prefetch->indextups);
+	else
+	{
+		ScanKeyInit(&skey,
+					Anum_pg_index_indrelid,
+					BTEqualStrategyNumber, F_OIDEQ,
+					ObjectIdGetDatum(RelationGetRelid(relation)));
 
-	indrel = table_open(IndexRelationId, AccessShareLock);
-	indscan = systable_beginscan(indrel, IndexIndrelidIndexId, true,
-								 NULL, 1, &skey);
+		indrel = table_open(IndexRelationId, AccessShareLock);
+		indscan = systable_beginscan(indrel, IndexIndrelidIndexId, true,
+									 NULL, 1, &skey);
+	}
 
-	while (HeapTupleIsValid(htup = systable_getnext(indscan)))
+	for (;;)
 	{
-		Form_pg_index index = (Form_pg_index) GETSTRUCT(htup);
+		Form_pg_index index;
+
+		if (prefetch)
+		{
+			if (prefetch_cell == NULL)
+				break;
+			htup = (HeapTuple) lfirst(prefetch_cell);
+			prefetch_cell = lnext(prefetch->indextups, prefetch_cell);
+		}
+		else
+		{
+			htup = systable_getnext(indscan);
+			if (!HeapTupleIsValid(htup))
+				break;
+		}
+		index = (Form_pg_index) GETSTRUCT(htup);
 
 		/*
 		 * Ignore any indexes that are currently being dropped.  This will
@@ -4807,9 +5197,11 @@ RelationGetIndexList(Relation relation)
 			candidateIndex = index->indexrelid;
 	}
 
-	systable_endscan(indscan);
-
-	table_close(indrel, AccessShareLock);
+	if (!prefetch)
+	{
+		systable_endscan(indscan);
+		table_close(indrel, AccessShareLock);
+	}
 
 	/* Sort the result list into OID order, per API spec. */
 	list_sort(result, list_oid_cmp);
@@ -6305,16 +6697,19 @@ load_relcache_init_file(bool shared)
 
 		/*
 		 * Rules and triggers are not saved (mainly because the internal
-		 * format is complex and subject to change).  They must be rebuilt if
-		 * needed by RelationCacheInitializePhase3.  This is not expected to
-		 * be a big performance hit since few system catalogs have such. Ditto
-		 * for RLS policy data, partition info, index expressions, predicates,
+		 * format is complex and subject to change).  They are loaded on first
+		 * use, like any other entry's.  This is not expected to be a big
+		 * performance hit since few system catalogs have such. Ditto for RLS
+		 * policy data, partition info, index expressions, predicates,
 		 * exclusion info, and FDW info.
 		 */
 		rel->rd_rules = NULL;
 		rel->rd_rulescxt = NULL;
+		rel->rd_rulesvalid = false;
 		rel->trigdesc = NULL;
+		rel->rd_trigdescvalid = false;
 		rel->rd_rsdesc = NULL;
+		rel->rd_rsdescvalid = false;
 		rel->rd_partkey = NULL;
 		rel->rd_partkeycxt = NULL;
 		rel->rd_partdesc = NULL;
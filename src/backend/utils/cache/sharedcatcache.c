@@ -0,0 +1,573 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedcatcache.c
+ *	  shared cache of system catalog tuples, in front of the catcaches.
+ *
+ * Each backend builds its own catcache entries, with an index scan of the
+ * catalog for every miss.  A new connection thus pays for all of these
+ * lookups again.  This module keeps the catalog tuples that backends have
+ * looked up in shared memory, so that a backend missing its local catcache
+ * can usually copy the tuple from here instead of scanning the catalog.
+ * The local catcache still holds its own copy; only the catalog lookups are
+ * saved.  Only positive entries are shared, and list searches are not.
+ *
+ * Entries are keyed by database (InvalidOid for shared catalogs), catcache
+ * id and the catcache hash value of the tuple's keys; on a hash collision,
+ * the keys won't match and the lookup misses.  The table of entries is a
+ * fixed-size partitioned hashtable, and the tuples themselves live in a DSA
+ * area created in place in the main shared memory segment, limited to its
+ * initial size.  When either is full, entries of the partition are evicted
+ * with a clock sweep.
+ *
+ * A shared entry can only hold committed catalog contents that every
+ * backend could see.  So backends that may see catalog contents of their
+ * own, because their transaction has written to the catalogs or has
+ * pending invalidations, or that use a historic snapshot, neither use nor
+ * fill the cache.  Entries are removed by SendSharedInvalidMessages(), as
+ * the invalidation messages of a committed transaction are put into the
+ * sinval queue, before any other backend can act on them.
+ *
+ * A backend that misses the cache scans the catalog, and then stores the
+ * tuple it found.  The tuple is stale if the catalog was changed, and the
+ * change's invalidation processed, after the scan's snapshot was taken.
+ * Each cache id therefore has a generation counter that invalidation bumps
+ * before removing entries; the missing backend reads it before taking a
+ * new catalog snapshot for its scan, and the tuple is only stored if the
+ * counter hasn't moved.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedcatcache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/sinval.h"
+#include "utils/catcache.h"
+#include "utils/dsa.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/sharedcatcache.h"
+#include "utils/syscache.h"
+
+/* number of partitions of the cache; must be a power of 2 */
+#define NUM_SHARED_CATCACHE_PARTITIONS	16
+
+/* average tuple size assumed when sizing the hashtable */
+#define SHARED_CATCACHE_AVG_TUPLE	256
+
+/* GUC variable: size of the cache in kilobytes, or 0 to disable it */
+int			shared_catcache_size = 16384;
+
+typedef struct SharedCatCacheKey
+{
+	Oid			dbid;			/* InvalidOid for shared catalogs */
+	int			cacheid;
+	uint32		hashvalue;
+} SharedCatCacheKey;
+
+/* entry of the cache hashtable */
+typedef struct SharedCatCacheEnt
+{
+	SharedCatCacheKey key;		/* hash key */
+	Oid			reloid;			/* catalog the tuple comes from */
+	ItemPointerData self;		/* t_self of the tuple */
+	uint32		len;			/* t_len of the tuple */
+	dsa_pointer tuple;			/* the HeapTupleHeader itself */
+	bool		recently_used;	/* for the clock sweep */
+	dlist_node	link;			/* in the partition's list of entries */
+} SharedCatCacheEnt;
+
+typedef struct SharedCatCachePartition
+{
+	LWLock		lock;
+	dlist_head	entries;		/* newest first */
+} SharedCatCachePartition;
+
+typedef union SharedCatCachePartitionPadded
+{
+	SharedCatCachePartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} SharedCatCachePartitionPadded;
+
+typedef struct SharedCatCacheControl
+{
+	pg_atomic_uint64 generation[SysCacheSize];	/* see file header */
+	SharedCatCachePartitionPadded partitions[NUM_SHARED_CATCACHE_PARTITIONS];
+	/* the in-place DSA area follows */
+} SharedCatCacheControl;
+
+static HTAB *SharedCatCacheHash = NULL;
+static SharedCatCacheControl *SharedCatCacheCtl = NULL;
+static dsa_area *SharedCatCacheArea = NULL;
+
+static inline SharedCatCachePartition *
+SharedCatCacheGetPartition(uint32 hashcode)
+{
+	return &SharedCatCacheCtl->partitions[hashcode %
+										  NUM_SHARED_CATCACHE_PARTITIONS].part;
+}
+
+static inline char *
+SharedCatCacheRawArea(void)
+{
+	return (char *) SharedCatCacheCtl + MAXALIGN(sizeof(SharedCatCacheControl));
+}
+
+/* size of the DSA area */
+static Size
+SharedCatCacheAreaSize(void)
+{
+	Size		size = (Size) shared_catcache_size * 1024;
+
+	return MAXALIGN(Max(size, dsa_minimum_size()));
+}
+
+/* number of entries of the hashtable */
+static long
+SharedCatCacheEntries(void)
+{
+	return Max(SharedCatCacheAreaSize() / SHARED_CATCACHE_AVG_TUPLE, 64);
+}
+
+/*
+ * Estimate space needed for the cache
+ */
+Size
+SharedCatCacheShmemSize(void)
+{
+	Size		size = 0;
+
+	if (shared_catcache_size == 0)
+		return 0;
+
+	size = add_size(size, hash_estimate_size(SharedCatCacheEntries(),
+											 sizeof(SharedCatCacheEnt)));
+	size = add_size(size, MAXALIGN(sizeof(SharedCatCacheControl)));
+	size = add_size(size, SharedCatCacheAreaSize());
+
+	return size;
+}
+
+/*
+ * Initialize the cache in shared memory
+ */
+void
+SharedCatCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (shared_catcache_size == 0)
+		return;
+
+	info.keysize = sizeof(SharedCatCacheKey);
+	info.entrysize = sizeof(SharedCatCacheEnt);
+	info.num_partitions = NUM_SHARED_CATCACHE_PARTITIONS;
+
+	SharedCatCacheHash = ShmemInitHash("Shared Catalog Cache",
+									   SharedCatCacheEntries(),
+									   SharedCatCacheEntries(),
+									   &info,
+									   HASH_ELEM | HASH_BLOBS |
+									   HASH_PARTITION | HASH_FIXED_SIZE);
+
+	SharedCatCacheCtl = (SharedCatCacheControl *)
+		ShmemInitStruct("Shared Catalog Cache Data",
+						add_size(MAXALIGN(sizeof(SharedCatCacheControl)),
+								 SharedCatCacheAreaSize()),
+						&found);
+
+	if (!found)
+	{
+		dsa_area   *area;
+
+		for (int i = 0; i < SysCacheSize; i++)
+			pg_atomic_init_u64(&SharedCatCacheCtl->generation[i], 0);
+
+		for (int i = 0; i < NUM_SHARED_CATCACHE_PARTITIONS; i++)
+		{
+			SharedCatCachePartition *part = &SharedCatCacheCtl->partitions[i].part;
+
+			LWLockInitialize(&part->lock, LWTRANCHE_SHARED_CATCACHE);
+			dlist_init(&part->entries);
+		}
+
+		/*
+		 * The tuples go into a DSA area in plain shared memory, which is not
+		 * allowed to grow into DSM segments.  As in StatsShmemInit(), the
+		 * creating process doesn't keep it attached.
+		 */
+		area = dsa_create_in_place(SharedCatCacheRawArea(),
+								   SharedCatCacheAreaSize(),
+								   LWTRANCHE_SHARED_CATCACHE_DSA, 0);
+		dsa_pin(area);
+		dsa_set_size_limit(area, SharedCatCacheAreaSize());
+		dsa_detach(area);
+	}
+}
+
+/*
+ * Attach to the DSA area, if not done yet.  The mapping is kept for the
+ * lifetime of the backend.
+ */
+static void
+SharedCatCacheAttach(void)
+{
+	MemoryContext oldcontext;
+
+	if (SharedCatCacheArea != NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	SharedCatCacheArea = dsa_attach_in_place(SharedCatCacheRawArea(), NULL);
+	dsa_pin_mapping(SharedCatCacheArea);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Is the cache there at all?
+ */
+bool
+SharedCatCacheEnabled(void)
+{
+	return SharedCatCacheHash != NULL && IsUnderPostmaster;
+}
+
+static inline void
+SharedCatCacheMakeKey(SharedCatCacheKey *key, CatCache *cache,
+					  uint32 hashValue)
+{
+	/* zero the padding, as the key is hashed as a blob */
+	memset(key, 0, sizeof(SharedCatCacheKey));
+	key->dbid = cache->cc_relisshared ? InvalidOid : MyDatabaseId;
+	key->cacheid = cache->id;
+	key->hashvalue = hashValue;
+}
+
+/*
+ * Remove an entry and free its tuple.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static void
+SharedCatCacheRemove(SharedCatCacheEnt *ent, uint32 hashcode)
+{
+	dlist_delete(&ent->link);
+	dsa_free(SharedCatCacheArea, ent->tuple);
+	hash_search_with_hash_value(SharedCatCacheHash, &ent->key, hashcode,
+								HASH_REMOVE, NULL);
+}
+
+/*
+ * Evict an entry of the partition to make room for a new one.  Returns false
+ * if the partition has no entries to give up.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static bool
+SharedCatCacheEvict(SharedCatCachePartition *part)
+{
+	/* two passes clear all the usage bits, if need be */
+	while (!dlist_is_empty(&part->entries))
+	{
+		SharedCatCacheEnt *ent = dlist_tail_element(SharedCatCacheEnt, link,
+													&part->entries);
+
+		if (ent->recently_used)
+		{
+			ent->recently_used = false;
+			dlist_move_head(&part->entries, &ent->link);
+			continue;
+		}
+
+		SharedCatCacheRemove(ent, get_hash_value(SharedCatCacheHash,
+												 &ent->key));
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * SharedCatCacheGeneration
+ *		Return the generation of a cache, to pass to SharedCatCacheInsert()
+ *
+ * Must be called before the snapshot for the catalog scan is taken.
+ */
+uint64
+SharedCatCacheGeneration(CatCache *cache)
+{
+	return pg_atomic_read_u64(&SharedCatCacheCtl->generation[cache->id]);
+}
+
+/*
+ * SharedCatCacheLookup
+ *		Look for the tuple with the given keys and hash value
+ *
+ * Returns a copy of the tuple, palloc'd in the current memory context, or
+ * NULL if it isn't in the cache.
+ */
+HeapTuple
+SharedCatCacheLookup(CatCache *cache, uint32 hashValue, Datum *arguments)
+{
+	SharedCatCacheKey key;
+	uint32		hashcode;
+	SharedCatCachePartition *part;
+	SharedCatCacheEnt *ent;
+	HeapTuple	result = NULL;
+
+	SharedCatCacheAttach();
+
+	SharedCatCacheMakeKey(&key, cache, hashValue);
+	hashcode = get_hash_value(SharedCatCacheHash, &key);
+	part = SharedCatCacheGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_SHARED);
+
+	ent = (SharedCatCacheEnt *)
+		hash_search_with_hash_value(SharedCatCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		HeapTupleData tuple;
+		bool		match = true;
+
+		tuple.t_len = ent->len;
+		tuple.t_self = ent->self;
+		tuple.t_tableOid = ent->reloid;
+		tuple.t_data = (HeapTupleHeader) dsa_get_address(SharedCatCacheArea,
+														 ent->tuple);
+
+		/* the hash value may have collided, so check the keys */
+		for (int i = 0; i < cache->cc_nkeys; i++)
+		{
+			Datum		atp;
+			bool		isnull;
+
+			atp = heap_getattr(&tuple, cache->cc_keyno[i], cache->cc_tupdesc,
+							   &isnull);
+			Assert(!isnull);
+			if (!(cache->cc_fastequal[i]) (atp, arguments[i]))
+			{
+				match = false;
+				break;
+			}
+		}
+
+		if (match)
+		{
+			result = heap_copytuple(&tuple);
+
+			/* racy, but only the clock sweep looks at it */
+			if (!ent->recently_used)
+				ent->recently_used = true;
+		}
+	}
+
+	LWLockRelease(&part->lock);
+
+	return result;
+}
+
+/*
+ * SharedCatCacheInsert
+ *		Store a tuple found by a catalog scan after a miss
+ *
+ * The tuple must not have out-of-line toasted fields.  Nothing is stored if
+ * the cache's generation has moved since SharedCatCacheGeneration()
+ * returned generation, as the tuple may be stale, or if there's no room.
+ */
+void
+SharedCatCacheInsert(CatCache *cache, uint32 hashValue, HeapTuple tuple,
+					 uint64 generation)
+{
+	SharedCatCacheKey key;
+	uint32		hashcode;
+	SharedCatCachePartition *part;
+	SharedCatCacheEnt *ent;
+	dsa_pointer dp;
+	bool		found;
+
+	Assert(!HeapTupleHasExternal(tuple));
+
+	SharedCatCacheAttach();
+
+	SharedCatCacheMakeKey(&key, cache, hashValue);
+	hashcode = get_hash_value(SharedCatCacheHash, &key);
+	part = SharedCatCacheGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	/* pairs with the atomic increment in SharedCatCacheInvalidateCache */
+	if (SharedCatCacheGeneration(cache) != generation)
+	{
+		LWLockRelease(&part->lock);
+		return;
+	}
+
+	/* replace any entry that's there, whose hash value collided */
+	ent = (SharedCatCacheEnt *)
+		hash_search_with_hash_value(SharedCatCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		SharedCatCacheRemove(ent, hashcode);
+
+	for (;;)
+	{
+		dp = dsa_allocate_extended(SharedCatCacheArea, tuple->t_len,
+								   DSA_ALLOC_NO_OOM);
+		if (DsaPointerIsValid(dp))
+			break;
+		if (!SharedCatCacheEvict(part))
+		{
+			LWLockRelease(&part->lock);
+			return;
+		}
+	}
+
+	for (;;)
+	{
+		ent = (SharedCatCacheEnt *)
+			hash_search_with_hash_value(SharedCatCacheHash, &key, hashcode,
+										HASH_ENTER_NULL, &found);
+		if (ent != NULL)
+			break;
+		if (!SharedCatCacheEvict(part))
+		{
+			dsa_free(SharedCatCacheArea, dp);
+			LWLockRelease(&part->lock);
+			return;
+		}
+	}
+	Assert(!found);
+
+	memcpy(dsa_get_address(SharedCatCacheArea, dp), tuple->t_data,
+		   tuple->t_len);
+	ent->reloid = tuple->t_tableOid;
+	ent->self = tuple->t_self;
+	ent->len = tuple->t_len;
+	ent->tuple = dp;
+	ent->recently_used = false;
+	dlist_push_head(&part->entries, &ent->link);
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * Remove the entry of a catcache invalidation message, if any.
+ */
+static void
+SharedCatCacheInvalidateCache(int cacheid, Oid dbid, uint32 hashValue)
+{
+	SharedCatCacheKey key;
+	uint32		hashcode;
+	SharedCatCachePartition *part;
+	SharedCatCacheEnt *ent;
+
+	/* first make backends that are scanning give up on storing */
+	pg_atomic_fetch_add_u64(&SharedCatCacheCtl->generation[cacheid], 1);
+
+	memset(&key, 0, sizeof(SharedCatCacheKey));
+	key.dbid = dbid;
+	key.cacheid = cacheid;
+	key.hashvalue = hashValue;
+	hashcode = get_hash_value(SharedCatCacheHash, &key);
+	part = SharedCatCacheGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	ent = (SharedCatCacheEnt *)
+		hash_search_with_hash_value(SharedCatCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		SharedCatCacheRemove(ent, hashcode);
+
+	LWLockRelease(&part->lock);
+}
+
+/*
+ * Remove all entries of a database, or of a catalog if reloid is valid.
+ */
+static void
+SharedCatCacheInvalidateAll(Oid dbid, Oid reloid)
+{
+	HASH_SEQ_STATUS status;
+	SharedCatCacheEnt *ent;
+
+	for (int i = 0; i < SysCacheSize; i++)
+		pg_atomic_fetch_add_u64(&SharedCatCacheCtl->generation[i], 1);
+
+	/* a consistent scan of the hashtable needs all partition locks */
+	for (int i = 0; i < NUM_SHARED_CATCACHE_PARTITIONS; i++)
+		LWLockAcquire(&SharedCatCacheCtl->partitions[i].part.lock,
+					  LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedCatCacheHash);
+	while ((ent = (SharedCatCacheEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (ent->key.dbid != dbid)
+			continue;
+		if (OidIsValid(reloid) && ent->reloid != reloid)
+			continue;
+
+		/* removing the current element is allowed during a scan */
+		SharedCatCacheRemove(ent, get_hash_value(SharedCatCacheHash,
+												 &ent->key));
+	}
+
+	for (int i = NUM_SHARED_CATCACHE_PARTITIONS; --i >= 0;)
+		LWLockRelease(&SharedCatCacheCtl->partitions[i].part.lock);
+}
+
+/*
+ * SharedCatCacheInvalidate
+ *		Apply invalidation messages that are about to be sent to the cache
+ */
+void
+SharedCatCacheInvalidate(const SharedInvalidationMessage *msgs, int n)
+{
+	if (!SharedCatCacheEnabled())
+		return;
+
+	SharedCatCacheAttach();
+
+	for (int i = 0; i < n; i++)
+	{
+		const SharedInvalidationMessage *msg = &msgs[i];
+
+		if (msg->id >= 0)
+			SharedCatCacheInvalidateCache(msg->cc.id, msg->cc.dbId,
+										  msg->cc.hashValue);
+		else if (msg->id == SHAREDINVALCATALOG_ID)
+			SharedCatCacheInvalidateAll(msg->cat.dbId, msg->cat.catId);
+	}
+}
+
+/*
+ * SharedCatCacheDropDatabase
+ *		Forget all tuples of a database that is being dropped
+ *
+ * Dropping a database sends no invalidation messages for its catalogs, and
+ * a later database could get the same OID.
+ */
+void
+SharedCatCacheDropDatabase(Oid dbid)
+{
+	if (!SharedCatCacheEnabled())
+		return;
+
+	SharedCatCacheAttach();
+	SharedCatCacheInvalidateAll(dbid, InvalidOid);
+}
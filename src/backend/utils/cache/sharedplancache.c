@@ -0,0 +1,848 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.c
+ *	  shared cache of generic plans, in front of the planner.
+ *
+ * Each backend plans its own prepared statements, and GetCachedPlan() even
+ * makes five custom plans before it considers a generic one.  With pooled
+ * connections, every server process thus parses, analyzes and plans the
+ * same statements of an application over again.  This module keeps the
+ * generic plans that backends have made in shared memory, serialized with
+ * nodeToString(), so that another backend preparing the same statement can
+ * read the plan in instead of planning, and can skip straight to the
+ * generic plan when the backend that made it found it the better choice.
+ * Parse analysis and rewriting are still done locally.
+ *
+ * Entries are keyed by database, current user and the query text, and by
+ * everything else that goes into a plan besides the catalogs: parameter
+ * types, cursor options, the search path and the row_security setting.
+ * Like a backend's own cached plans, shared plans do not depend on planner
+ * settings; a session with different settings can get a plan made under
+ * other ones.  Only statements with fixed parameter types, prepared with
+ * PREPARE or the extended query protocol, are shared.
+ *
+ * The table of entries is a fixed-size partitioned hashtable, and the plans
+ * themselves live in a DSA area created in place in the main shared memory
+ * segment, limited to its initial size.  When either is full, entries of
+ * the partition are evicted with a clock sweep.
+ *
+ * Invalidation follows the dependencies a backend's own plans are tracked
+ * by, a plan's relation OIDs and its PlanInvalItems.  Each maps to one of a
+ * fixed number of counters, which SendSharedInvalidMessages() bumps for the
+ * objects of the messages it has put into the sinval queue; messages that
+ * make backends flush all their plans bump a reset counter instead.  An
+ * entry records the values of its counters, and is dead once any of them
+ * has moved.  Counters are shared by unrelated objects, which just costs an
+ * occasional needless replan.
+ *
+ * A backend that misses the cache plans the statement itself, and then
+ * stores the plan.  The plan is stale if an invalidation was sent but not
+ * yet absorbed by the backend when it planned.  So there also is a global
+ * generation counter, bumped by every invalidation before the object
+ * counters; the planning backend reads it before absorbing invalidations,
+ * and the plan is only stored if the generation hasn't moved.  As with the
+ * shared catalog cache, backends whose transaction has queued invalidations
+ * of its own neither use nor fill the cache.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedplancache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "common/hashfn.h"
+#include "lib/ilist.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "nodes/plannodes.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rls.h"
+#include "utils/sharedplancache.h"
+#include "utils/syscache.h"
+
+/* number of partitions of the cache; must be a power of 2 */
+#define NUM_SHARED_PLAN_CACHE_PARTITIONS	16
+
+/* number of dependency counters; must be a power of 2 */
+#define NUM_SHARED_PLAN_COUNTERS	4096
+
+/* average plan size assumed when sizing the hashtable */
+#define SHARED_PLAN_CACHE_AVG_PLAN	4096
+
+/* GUC variable: size of the cache in kilobytes, or 0 to disable it */
+int			shared_plan_cache_size = 0;
+
+typedef struct SharedPlanCacheKey
+{
+	Oid			dbid;
+	Oid			userid;
+	uint32		texthash;		/* hash of the query text */
+	uint32		envhash;		/* hash of the rest, see SharedPlanMakeKey */
+} SharedPlanCacheKey;
+
+/* entry of the cache hashtable */
+typedef struct SharedPlanCacheEnt
+{
+	SharedPlanCacheKey key;		/* hash key */
+	dsa_pointer data;			/* SharedPlanData */
+	bool		generic_preferred;	/* maker chose the generic plan */
+	bool		recently_used;	/* for the clock sweep */
+	dlist_node	link;			/* in the partition's list of entries */
+} SharedPlanCacheEnt;
+
+/* a dependency counter, and its value when the plan was made */
+typedef struct SharedPlanDep
+{
+	uint64		value;
+	uint32		counter;
+} SharedPlanDep;
+
+/*
+ * What an entry points to.  The dependencies, the statement's environment
+ * (see SharedPlanMakeKey), its text and the serialized plan follow.
+ */
+typedef struct SharedPlanData
+{
+	uint64		reset;			/* reset counter when the plan was made */
+	uint32		ndeps;
+	uint32		envlen;
+	uint32		querylen;		/* without the terminating zero */
+	uint32		planlen;		/* with the terminating zero */
+} SharedPlanData;
+
+#define SharedPlanDataDeps(data) \
+	((SharedPlanDep *) ((char *) (data) + MAXALIGN(sizeof(SharedPlanData))))
+#define SharedPlanDataEnv(data) \
+	((char *) &SharedPlanDataDeps(data)[(data)->ndeps])
+#define SharedPlanDataQuery(data) \
+	(SharedPlanDataEnv(data) + (data)->envlen)
+#define SharedPlanDataPlan(data) \
+	(SharedPlanDataQuery(data) + (data)->querylen + 1)
+
+/* the dependencies of a plan found in the cache, for the caller to recheck */
+struct SharedPlanDeps
+{
+	uint64		reset;
+	uint32		ndeps;
+	SharedPlanDep deps[FLEXIBLE_ARRAY_MEMBER];
+};
+
+typedef struct SharedPlanCachePartition
+{
+	LWLock		lock;
+	dlist_head	entries;		/* newest first */
+} SharedPlanCachePartition;
+
+typedef union SharedPlanCachePartitionPadded
+{
+	SharedPlanCachePartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} SharedPlanCachePartitionPadded;
+
+typedef struct SharedPlanCacheControl
+{
+	pg_atomic_uint64 generation;	/* see file header */
+	pg_atomic_uint64 reset;
+	pg_atomic_uint64 counters[NUM_SHARED_PLAN_COUNTERS];
+	SharedPlanCachePartitionPadded partitions[NUM_SHARED_PLAN_CACHE_PARTITIONS];
+	/* the in-place DSA area follows */
+} SharedPlanCacheControl;
+
+static HTAB *SharedPlanCacheHash = NULL;
+static SharedPlanCacheControl *SharedPlanCacheCtl = NULL;
+static dsa_area *SharedPlanCacheArea = NULL;
+
+static inline SharedPlanCachePartition *
+SharedPlanCacheGetPartition(uint32 hashcode)
+{
+	return &SharedPlanCacheCtl->partitions[hashcode %
+										   NUM_SHARED_PLAN_CACHE_PARTITIONS].part;
+}
+
+static inline char *
+SharedPlanCacheRawArea(void)
+{
+	return (char *) SharedPlanCacheCtl + MAXALIGN(sizeof(SharedPlanCacheControl));
+}
+
+/* dependency counters of relations and of PlanInvalItems */
+static inline uint32
+SharedPlanRelCounter(Oid relid)
+{
+	return hash_uint32(relid) & (NUM_SHARED_PLAN_COUNTERS - 1);
+}
+
+static inline uint32
+SharedPlanItemCounter(int cacheid, uint32 hashvalue)
+{
+	return hash_combine(hash_uint32((uint32) cacheid), hashvalue) &
+		(NUM_SHARED_PLAN_COUNTERS - 1);
+}
+
+/* size of the DSA area */
+static Size
+SharedPlanCacheAreaSize(void)
+{
+	Size		size = (Size) shared_plan_cache_size * 1024;
+
+	return MAXALIGN(Max(size, dsa_minimum_size()));
+}
+
+/* number of entries of the hashtable */
+static long
+SharedPlanCacheEntries(void)
+{
+	return Max(SharedPlanCacheAreaSize() / SHARED_PLAN_CACHE_AVG_PLAN, 64);
+}
+
+/*
+ * Estimate space needed for the cache
+ */
+Size
+SharedPlanCacheShmemSize(void)
+{
+	Size		size = 0;
+
+	if (shared_plan_cache_size == 0)
+		return 0;
+
+	size = add_size(size, hash_estimate_size(SharedPlanCacheEntries(),
+											 sizeof(SharedPlanCacheEnt)));
+	size = add_size(size, MAXALIGN(sizeof(SharedPlanCacheControl)));
+	size = add_size(size, SharedPlanCacheAreaSize());
+
+	return size;
+}
+
+/*
+ * Initialize the cache in shared memory
+ */
+void
+SharedPlanCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (shared_plan_cache_size == 0)
+		return;
+
+	info.keysize = sizeof(SharedPlanCacheKey);
+	info.entrysize = sizeof(SharedPlanCacheEnt);
+	info.num_partitions = NUM_SHARED_PLAN_CACHE_PARTITIONS;
+
+	SharedPlanCacheHash = ShmemInitHash("Shared Plan Cache",
+										SharedPlanCacheEntries(),
+										SharedPlanCacheEntries(),
+										&info,
+										HASH_ELEM | HASH_BLOBS |
+										HASH_PARTITION | HASH_FIXED_SIZE);
+
+	SharedPlanCacheCtl = (SharedPlanCacheControl *)
+		ShmemInitStruct("Shared Plan Cache Data",
+						add_size(MAXALIGN(sizeof(SharedPlanCacheControl)),
+								 SharedPlanCacheAreaSize()),
+						&found);
+
+	if (!found)
+	{
+		dsa_area   *area;
+
+		pg_atomic_init_u64(&SharedPlanCacheCtl->generation, 0);
+		pg_atomic_init_u64(&SharedPlanCacheCtl->reset, 0);
+		for (int i = 0; i < NUM_SHARED_PLAN_COUNTERS; i++)
+			pg_atomic_init_u64(&SharedPlanCacheCtl->counters[i], 0);
+
+		for (int i = 0; i < NUM_SHARED_PLAN_CACHE_PARTITIONS; i++)
+		{
+			SharedPlanCachePartition *part = &SharedPlanCacheCtl->partitions[i].part;
+
+			LWLockInitialize(&part->lock, LWTRANCHE_SHARED_PLAN_CACHE);
+			dlist_init(&part->entries);
+		}
+
+		/* as in SharedCatCacheShmemInit() */
+		area = dsa_create_in_place(SharedPlanCacheRawArea(),
+								   SharedPlanCacheAreaSize(),
+								   LWTRANCHE_SHARED_PLAN_CACHE_DSA, 0);
+		dsa_pin(area);
+		dsa_set_size_limit(area, SharedPlanCacheAreaSize());
+		dsa_detach(area);
+	}
+}
+
+/*
+ * Attach to the DSA area, if not done yet.  The mapping is kept for the
+ * lifetime of the backend.
+ */
+static void
+SharedPlanCacheAttach(void)
+{
+	MemoryContext oldcontext;
+
+	if (SharedPlanCacheArea != NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	SharedPlanCacheArea = dsa_attach_in_place(SharedPlanCacheRawArea(), NULL);
+	dsa_pin_mapping(SharedPlanCacheArea);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Is the cache there at all?
+ */
+bool
+SharedPlanCacheEnabled(void)
+{
+	return SharedPlanCacheHash != NULL && IsUnderPostmaster;
+}
+
+/*
+ * Build the key of a statement, and its environment: everything besides
+ * the query text and the catalogs that the plan depends on.
+ */
+static void
+SharedPlanMakeKey(CachedPlanSource *plansource, SharedPlanCacheKey *key,
+				  StringInfo env)
+{
+	List	   *search_path;
+	ListCell   *lc;
+
+	initStringInfo(env);
+	appendBinaryStringInfo(env, &plansource->cursor_options, sizeof(int));
+	appendBinaryStringInfo(env, &row_security, sizeof(bool));
+	appendBinaryStringInfo(env, &plansource->num_params, sizeof(int));
+	if (plansource->num_params > 0)
+		appendBinaryStringInfo(env, plansource->param_types,
+							   plansource->num_params * sizeof(Oid));
+	search_path = fetch_search_path(true);
+	foreach(lc, search_path)
+	{
+		Oid			nspid = lfirst_oid(lc);
+
+		appendBinaryStringInfo(env, &nspid, sizeof(Oid));
+	}
+	list_free(search_path);
+
+	/* zero the padding, as the key is hashed as a blob */
+	memset(key, 0, sizeof(SharedPlanCacheKey));
+	key->dbid = MyDatabaseId;
+	key->userid = GetUserId();
+	key->texthash = hash_bytes((const unsigned char *) plansource->query_string,
+							   strlen(plansource->query_string));
+	key->envhash = hash_bytes((const unsigned char *) env->data, env->len);
+}
+
+/*
+ * Is an entry for the given statement, and still valid?
+ *
+ * Caller must hold the partition lock.
+ */
+static bool
+SharedPlanEntryMatches(SharedPlanData *data, CachedPlanSource *plansource,
+					   StringInfo env)
+{
+	SharedPlanDep *deps = SharedPlanDataDeps(data);
+
+	/* the hash values may have collided, so check the statement */
+	if (data->envlen != env->len ||
+		memcmp(SharedPlanDataEnv(data), env->data, env->len) != 0 ||
+		data->querylen != strlen(plansource->query_string) ||
+		memcmp(SharedPlanDataQuery(data), plansource->query_string,
+			   data->querylen) != 0)
+		return false;
+
+	if (data->reset != pg_atomic_read_u64(&SharedPlanCacheCtl->reset))
+		return false;
+	for (uint32 i = 0; i < data->ndeps; i++)
+	{
+		if (deps[i].value !=
+			pg_atomic_read_u64(&SharedPlanCacheCtl->counters[deps[i].counter]))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Remove an entry and free its plan.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static void
+SharedPlanCacheRemove(SharedPlanCacheEnt *ent, uint32 hashcode)
+{
+	dlist_delete(&ent->link);
+	dsa_free(SharedPlanCacheArea, ent->data);
+	hash_search_with_hash_value(SharedPlanCacheHash, &ent->key, hashcode,
+								HASH_REMOVE, NULL);
+}
+
+/*
+ * Evict an entry of the partition to make room for a new one.  Returns false
+ * if the partition has no entries to give up.
+ *
+ * Caller must hold the partition lock exclusively.
+ */
+static bool
+SharedPlanCacheEvict(SharedPlanCachePartition *part)
+{
+	/* two passes clear all the usage bits, if need be */
+	while (!dlist_is_empty(&part->entries))
+	{
+		SharedPlanCacheEnt *ent = dlist_tail_element(SharedPlanCacheEnt, link,
+													 &part->entries);
+
+		if (ent->recently_used)
+		{
+			ent->recently_used = false;
+			dlist_move_head(&part->entries, &ent->link);
+			continue;
+		}
+
+		SharedPlanCacheRemove(ent, get_hash_value(SharedPlanCacheHash,
+												  &ent->key));
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * SharedPlanCacheGeneration
+ *		Return the generation, to pass to SharedPlanCacheInsert()
+ *
+ * Must be called before absorbing invalidations and planning.
+ */
+uint64
+SharedPlanCacheGeneration(void)
+{
+	return pg_atomic_read_u64(&SharedPlanCacheCtl->generation);
+}
+
+/*
+ * SharedPlanCacheLookup
+ *		Look for a generic plan of the statement
+ *
+ * Returns the list of PlannedStmts, palloc'd in the current memory context,
+ * or NIL if there's none.  The plan's relations are not locked yet; after
+ * locking them, the caller must check with SharedPlanCacheRecheck(*deps)
+ * that the plan is still valid.
+ */
+List *
+SharedPlanCacheLookup(CachedPlanSource *plansource, SharedPlanDeps **deps)
+{
+	SharedPlanCacheKey key;
+	StringInfoData env;
+	uint32		hashcode;
+	SharedPlanCachePartition *part;
+	SharedPlanCacheEnt *ent;
+	char	   *planstr = NULL;
+	List	   *result;
+
+	SharedPlanCacheAttach();
+
+	SharedPlanMakeKey(plansource, &key, &env);
+	hashcode = get_hash_value(SharedPlanCacheHash, &key);
+	part = SharedPlanCacheGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_SHARED);
+
+	ent = (SharedPlanCacheEnt *)
+		hash_search_with_hash_value(SharedPlanCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+	{
+		SharedPlanData *data = dsa_get_address(SharedPlanCacheArea, ent->data);
+
+		if (SharedPlanEntryMatches(data, plansource, &env))
+		{
+			planstr = pnstrdup(SharedPlanDataPlan(data), data->planlen - 1);
+
+			*deps = palloc(offsetof(SharedPlanDeps, deps) +
+						   data->ndeps * sizeof(SharedPlanDep));
+			(*deps)->reset = data->reset;
+			(*deps)->ndeps = data->ndeps;
+			memcpy((*deps)->deps, SharedPlanDataDeps(data),
+				   data->ndeps * sizeof(SharedPlanDep));
+
+			/* racy, but only the clock sweep looks at it */
+			if (!ent->recently_used)
+				ent->recently_used = true;
+		}
+	}
+
+	LWLockRelease(&part->lock);
+
+	pfree(env.data);
+
+	if (planstr == NULL)
+		return NIL;
+
+	result = (List *) stringToNode(planstr);
+	pfree(planstr);
+
+	return result;
+}
+
+/*
+ * SharedPlanCacheRecheck
+ *		Is a plan found by SharedPlanCacheLookup() still valid?
+ */
+bool
+SharedPlanCacheRecheck(SharedPlanDeps *deps)
+{
+	if (deps->reset != pg_atomic_read_u64(&SharedPlanCacheCtl->reset))
+		return false;
+	for (uint32 i = 0; i < deps->ndeps; i++)
+	{
+		if (deps->deps[i].value !=
+			pg_atomic_read_u64(&SharedPlanCacheCtl->counters[deps->deps[i].counter]))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * SharedPlanCacheGenericPreferred
+ *		Has the backend that stored the statement's plan preferred it to
+ *		custom plans?
+ */
+bool
+SharedPlanCacheGenericPreferred(CachedPlanSource *plansource)
+{
+	SharedPlanCacheKey key;
+	StringInfoData env;
+	uint32		hashcode;
+	SharedPlanCachePartition *part;
+	SharedPlanCacheEnt *ent;
+	bool		result = false;
+
+	SharedPlanCacheAttach();
+
+	SharedPlanMakeKey(plansource, &key, &env);
+	hashcode = get_hash_value(SharedPlanCacheHash, &key);
+	part = SharedPlanCacheGetPartition(hashcode);
+
+	LWLockAcquire(&part->lock, LW_SHARED);
+
+	ent = (SharedPlanCacheEnt *)
+		hash_search_with_hash_value(SharedPlanCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL && ent->generic_preferred)
+		result = SharedPlanEntryMatches(dsa_get_address(SharedPlanCacheArea,
+														ent->data),
+										plansource, &env);
+
+	LWLockRelease(&part->lock);
+
+	pfree(env.data);
+
+	return result;
+}
+
+/* qsort comparator for dependency counter numbers */
+static int
+SharedPlanCounterCmp(const void *a, const void *b)
+{
+	uint32		ca = *(const uint32 *) a;
+	uint32		cb = *(const uint32 *) b;
+
+	if (ca < cb)
+		return -1;
+	if (ca > cb)
+		return 1;
+	return 0;
+}
+
+/*
+ * Collect the dependency counters of a plan into *counters, without
+ * duplicates, and return how many there are.  Returns -1 if the plan can't
+ * be shared.
+ */
+static int
+SharedPlanCollectDeps(CachedPlanSource *plansource, List *stmt_list,
+					  uint32 **counters)
+{
+	List	   *relids = list_copy(plansource->relationOids);
+	List	   *items = list_copy(plansource->invalItems);
+	ListCell   *lc;
+	uint32	   *result;
+	int			n = 0;
+	int			nunique = 0;
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+
+		/* Utility statements may hold nodes we can't read back in */
+		if (plannedstmt->commandType == CMD_UTILITY)
+			return -1;
+		/* Transient plans are only good while TransactionXmin stays put */
+		if (plannedstmt->transientPlan)
+			return -1;
+
+		relids = list_concat(relids, plannedstmt->relationOids);
+		items = list_concat(items, plannedstmt->invalItems);
+	}
+
+	result = palloc(Max(list_length(relids) + list_length(items), 1) *
+					sizeof(uint32));
+
+	foreach(lc, relids)
+	{
+		Oid			relid = lfirst_oid(lc);
+
+		/* Other backends can't use our temporary tables */
+		if (get_rel_persistence(relid) == RELPERSISTENCE_TEMP)
+			return -1;
+		result[n++] = SharedPlanRelCounter(relid);
+	}
+	foreach(lc, items)
+	{
+		PlanInvalItem *item = lfirst_node(PlanInvalItem, lc);
+
+		result[n++] = SharedPlanItemCounter(item->cacheId, item->hashValue);
+	}
+
+	if (n > 0)
+	{
+		qsort(result, n, sizeof(uint32), SharedPlanCounterCmp);
+		nunique = 1;
+		for (int i = 1; i < n; i++)
+		{
+			if (result[i] != result[nunique - 1])
+				result[nunique++] = result[i];
+		}
+	}
+
+	*counters = result;
+	return nunique;
+}
+
+/*
+ * SharedPlanCacheInsert
+ *		Store a generic plan made after a miss
+ *
+ * Nothing is stored if the generation has moved since
+ * SharedPlanCacheGeneration() returned generation, as the plan may be stale,
+ * if the plan can't be shared, or if there's no room.
+ */
+void
+SharedPlanCacheInsert(CachedPlanSource *plansource, List *stmt_list,
+					  bool generic_preferred, uint64 generation)
+{
+	SharedPlanCacheKey key;
+	StringInfoData env;
+	uint32		hashcode;
+	SharedPlanCachePartition *part;
+	SharedPlanCacheEnt *ent;
+	uint32	   *counters;
+	int			ndeps;
+	char	   *planstr;
+	SharedPlanData header;
+	SharedPlanData *data;
+	SharedPlanDep *deps;
+	Size		size;
+	dsa_pointer dp;
+	bool		found;
+
+	ndeps = SharedPlanCollectDeps(plansource, stmt_list, &counters);
+	if (ndeps < 0)
+		return;
+
+	SharedPlanCacheAttach();
+
+	planstr = nodeToString(stmt_list);
+	SharedPlanMakeKey(plansource, &key, &env);
+	hashcode = get_hash_value(SharedPlanCacheHash, &key);
+	part = SharedPlanCacheGetPartition(hashcode);
+
+	header.reset = 0;			/* set below */
+	header.ndeps = ndeps;
+	header.envlen = env.len;
+	header.querylen = strlen(plansource->query_string);
+	header.planlen = strlen(planstr) + 1;
+	size = MAXALIGN(sizeof(SharedPlanData)) +
+		ndeps * sizeof(SharedPlanDep) +
+		header.envlen + header.querylen + 1 + header.planlen;
+
+	LWLockAcquire(&part->lock, LW_EXCLUSIVE);
+
+	/* replace any entry that's there, stale or whose hash values collided */
+	ent = (SharedPlanCacheEnt *)
+		hash_search_with_hash_value(SharedPlanCacheHash, &key, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		SharedPlanCacheRemove(ent, hashcode);
+
+	for (;;)
+	{
+		dp = dsa_allocate_extended(SharedPlanCacheArea, size,
+								   DSA_ALLOC_NO_OOM);
+		if (DsaPointerIsValid(dp))
+			break;
+		if (!SharedPlanCacheEvict(part))
+			goto out;
+	}
+
+	for (;;)
+	{
+		ent = (SharedPlanCacheEnt *)
+			hash_search_with_hash_value(SharedPlanCacheHash, &key, hashcode,
+										HASH_ENTER_NULL, &found);
+		if (ent != NULL)
+			break;
+		if (!SharedPlanCacheEvict(part))
+		{
+			dsa_free(SharedPlanCacheArea, dp);
+			goto out;
+		}
+	}
+	Assert(!found);
+
+	data = dsa_get_address(SharedPlanCacheArea, dp);
+	memcpy(data, &header, sizeof(SharedPlanData));
+	deps = SharedPlanDataDeps(data);
+	data->reset = pg_atomic_read_u64(&SharedPlanCacheCtl->reset);
+	for (int i = 0; i < ndeps; i++)
+	{
+		deps[i].counter = counters[i];
+		deps[i].value = pg_atomic_read_u64(&SharedPlanCacheCtl->counters[counters[i]]);
+	}
+	memcpy(SharedPlanDataEnv(data), env.data, env.len);
+	memcpy(SharedPlanDataQuery(data), plansource->query_string,
+		   header.querylen + 1);
+	memcpy(SharedPlanDataPlan(data), planstr, header.planlen);
+
+	ent->data = dp;
+	ent->generic_preferred = generic_preferred;
+	ent->recently_used = false;
+	dlist_push_head(&part->entries, &ent->link);
+
+	/*
+	 * The counters we recorded are only good if no invalidation began since
+	 * the caller read the generation: invalidations bump the generation
+	 * before the other counters.  Otherwise take the entry back out.
+	 */
+	pg_memory_barrier();
+	if (SharedPlanCacheGeneration() != generation)
+		SharedPlanCacheRemove(ent, hashcode);
+
+out:
+	LWLockRelease(&part->lock);
+
+	pfree(env.data);
+	pfree(planstr);
+	pfree(counters);
+}
+
+/*
+ * SharedPlanCacheInvalidate
+ *		Apply invalidation messages that have been sent to the cache
+ *
+ * This mirrors the invalidation callbacks of plancache.c.  Entries are not
+ * removed, just marked dead by bumping counters; the space of dead entries
+ * is reclaimed as they are replaced or evicted.
+ */
+void
+SharedPlanCacheInvalidate(const SharedInvalidationMessage *msgs, int n)
+{
+	if (!SharedPlanCacheEnabled() || n == 0)
+		return;
+
+	/* first make backends that are planning give up on storing */
+	pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->generation, 1);
+
+	for (int i = 0; i < n; i++)
+	{
+		const SharedInvalidationMessage *msg = &msgs[i];
+		uint32		counter;
+
+		if (msg->id >= 0)
+		{
+			switch (msg->cc.id)
+			{
+				case PROCOID:
+				case TYPEOID:
+					counter = SharedPlanItemCounter(msg->cc.id,
+													msg->cc.hashValue);
+					pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->counters[counter], 1);
+					break;
+				case NAMESPACEOID:
+				case OPEROID:
+				case AMOPOPID:
+				case FOREIGNSERVEROID:
+				case FOREIGNDATAWRAPPEROID:
+					pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->reset, 1);
+					break;
+				default:
+					break;
+			}
+		}
+		else if (msg->id == SHAREDINVALCATALOG_ID)
+			pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->reset, 1);
+		else if (msg->id == SHAREDINVALRELCACHE_ID)
+		{
+			if (!OidIsValid(msg->rc.relId))
+				pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->reset, 1);
+			else
+			{
+				counter = SharedPlanRelCounter(msg->rc.relId);
+				pg_atomic_fetch_add_u64(&SharedPlanCacheCtl->counters[counter], 1);
+			}
+		}
+	}
+}
+
+/*
+ * SharedPlanCacheDropDatabase
+ *		Forget all plans of a database that is being dropped
+ *
+ * A later database could get the same OID, and the same relation OIDs.
+ */
+void
+SharedPlanCacheDropDatabase(Oid dbid)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanCacheEnt *ent;
+
+	if (!SharedPlanCacheEnabled())
+		return;
+
+	SharedPlanCacheAttach();
+
+	/* a consistent scan of the hashtable needs all partition locks */
+	for (int i = 0; i < NUM_SHARED_PLAN_CACHE_PARTITIONS; i++)
+		LWLockAcquire(&SharedPlanCacheCtl->partitions[i].part.lock,
+					  LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedPlanCacheHash);
+	while ((ent = (SharedPlanCacheEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (ent->key.dbid != dbid)
+			continue;
+
+		/* removing the current element is allowed during a scan */
+		SharedPlanCacheRemove(ent, get_hash_value(SharedPlanCacheHash,
+												  &ent->key));
+	}
+
+	for (int i = NUM_SHARED_PLAN_CACHE_PARTITIONS; --i >= 0;)
+		LWLockRelease(&SharedPlanCacheCtl->partitions[i].part.lock);
+}
@@ -0,0 +1,285 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedtypcache.c
+ *	  shared cache of operator data of builtin types, behind the typcache.
+ *
+ * For every type it is asked about, lookup_type_cache() finds the default
+ * btree and hash opclasses and then the equality and ordering operators and
+ * the comparison and hash functions, which takes a handful of catalog scans
+ * and syscache lookups per type.  Every new backend repeats that for the
+ * same builtin types.  This module keeps the results in shared memory, so
+ * that a backend building a typcache entry for a builtin type can take them
+ * from here; the fmgr lookups that follow need no catalog access for
+ * builtin functions anyway.  The data can't be computed before the first
+ * backend connects, since the postmaster can't read catalogs, so it is
+ * filled in by the first backend of each database that looks a type up.
+ *
+ * Entries are keyed by database and type OID, since the opclasses of even
+ * builtin types can be altered in one database.  Only builtin types that
+ * are neither composite nor domains are cached; see typcache.c.  The table
+ * is a small fixed-size hashtable under a single lock, as it is only
+ * consulted when a backend creates a typcache entry.
+ *
+ * The same rules as for the shared catalog cache keep the entries fresh:
+ * only backends that see no catalog contents of their own use or fill the
+ * cache, and sending invalidation messages for pg_opclass removes the
+ * entries of the database, which is what the typcache itself does on such
+ * messages.  That happens both before the messages go into the sinval queue
+ * and after, each time bumping a generation counter.  A backend about to
+ * look up a type's operators reads the counter and then processes pending
+ * invalidation messages, and it stores its results only if the counter
+ * hasn't moved since; so it either has processed the messages of any change
+ * that it doesn't see as a concurrent one, or it stores nothing.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedtypcache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_opclass.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/sinval.h"
+#include "utils/hsearch.h"
+#include "utils/sharedtypcache.h"
+#include "utils/syscache.h"
+
+/*
+ * Number of entries of the cache.  There are a few hundred builtin types
+ * that aren't composite, and few of them are used in any one database.
+ */
+#define SHARED_TYPE_CACHE_ENTRIES	4096
+
+typedef struct SharedTypeCacheKey
+{
+	Oid			dbid;
+	Oid			type_id;
+} SharedTypeCacheKey;
+
+/* entry of the cache hashtable */
+typedef struct SharedTypeCacheEnt
+{
+	SharedTypeCacheKey key;		/* hash key */
+	SharedTypeCacheData data;
+} SharedTypeCacheEnt;
+
+typedef struct SharedTypeCacheControl
+{
+	LWLock		lock;			/* protects the hashtable */
+	pg_atomic_uint64 generation;	/* see file header */
+} SharedTypeCacheControl;
+
+static HTAB *SharedTypeCacheHash = NULL;
+static SharedTypeCacheControl *SharedTypeCacheCtl = NULL;
+
+/*
+ * Estimate space needed for the cache
+ */
+Size
+SharedTypeCacheShmemSize(void)
+{
+	Size		size = 0;
+
+	size = add_size(size, hash_estimate_size(SHARED_TYPE_CACHE_ENTRIES,
+											 sizeof(SharedTypeCacheEnt)));
+	size = add_size(size, MAXALIGN(sizeof(SharedTypeCacheControl)));
+
+	return size;
+}
+
+/*
+ * Initialize the cache in shared memory
+ */
+void
+SharedTypeCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	info.keysize = sizeof(SharedTypeCacheKey);
+	info.entrysize = sizeof(SharedTypeCacheEnt);
+
+	SharedTypeCacheHash = ShmemInitHash("Shared Type Cache",
+										SHARED_TYPE_CACHE_ENTRIES,
+										SHARED_TYPE_CACHE_ENTRIES,
+										&info,
+										HASH_ELEM | HASH_BLOBS |
+										HASH_FIXED_SIZE);
+
+	SharedTypeCacheCtl = (SharedTypeCacheControl *)
+		ShmemInitStruct("Shared Type Cache Data",
+						sizeof(SharedTypeCacheControl), &found);
+
+	if (!found)
+	{
+		LWLockInitialize(&SharedTypeCacheCtl->lock,
+						 LWTRANCHE_SHARED_TYPE_CACHE);
+		pg_atomic_init_u64(&SharedTypeCacheCtl->generation, 0);
+	}
+}
+
+/*
+ * Is the cache usable?
+ */
+bool
+SharedTypeCacheEnabled(void)
+{
+	return SharedTypeCacheHash != NULL && IsUnderPostmaster &&
+		OidIsValid(MyDatabaseId);
+}
+
+/*
+ * SharedTypeCacheGeneration
+ *		Return the generation of the cache, to pass to SharedTypeCacheInsert()
+ *
+ * The caller must process pending invalidation messages after this, and
+ * before looking anything up.
+ */
+uint64
+SharedTypeCacheGeneration(void)
+{
+	return pg_atomic_read_u64(&SharedTypeCacheCtl->generation);
+}
+
+/*
+ * SharedTypeCacheLookup
+ *		Copy out what is known about a type of the current database
+ *
+ * Returns false if the type isn't in the cache.
+ */
+bool
+SharedTypeCacheLookup(Oid type_id, SharedTypeCacheData *data)
+{
+	SharedTypeCacheKey key;
+	SharedTypeCacheEnt *ent;
+
+	key.dbid = MyDatabaseId;
+	key.type_id = type_id;
+
+	LWLockAcquire(&SharedTypeCacheCtl->lock, LW_SHARED);
+	ent = (SharedTypeCacheEnt *) hash_search(SharedTypeCacheHash, &key,
+											 HASH_FIND, NULL);
+	if (ent != NULL)
+		*data = ent->data;
+	LWLockRelease(&SharedTypeCacheCtl->lock);
+
+	return ent != NULL;
+}
+
+/*
+ * SharedTypeCacheInsert
+ *		Store what a backend found out about a type of the current database
+ *
+ * If the type is there already, the entry is replaced if 'data' has all of
+ * its fields and more.  Nothing is stored if the generation has moved
+ * since SharedTypeCacheGeneration() returned 'generation', or if the cache
+ * is full.
+ */
+void
+SharedTypeCacheInsert(Oid type_id, const SharedTypeCacheData *data,
+					  uint64 generation)
+{
+	SharedTypeCacheKey key;
+	SharedTypeCacheEnt *ent;
+	bool		found;
+
+	key.dbid = MyDatabaseId;
+	key.type_id = type_id;
+
+	LWLockAcquire(&SharedTypeCacheCtl->lock, LW_EXCLUSIVE);
+
+	/* pairs with the atomic increment in SharedTypeCacheInvalidateAll */
+	if (SharedTypeCacheGeneration() != generation)
+	{
+		LWLockRelease(&SharedTypeCacheCtl->lock);
+		return;
+	}
+
+	ent = (SharedTypeCacheEnt *) hash_search(SharedTypeCacheHash, &key,
+											 HASH_ENTER_NULL, &found);
+	if (ent == NULL)
+	{
+		/* cache is full */
+		LWLockRelease(&SharedTypeCacheCtl->lock);
+		return;
+	}
+
+	if (!found || (data->flags & ent->data.flags) == ent->data.flags)
+		ent->data = *data;
+
+	LWLockRelease(&SharedTypeCacheCtl->lock);
+}
+
+/*
+ * Remove all entries of a database.
+ */
+static void
+SharedTypeCacheInvalidateAll(Oid dbid)
+{
+	HASH_SEQ_STATUS status;
+	SharedTypeCacheEnt *ent;
+
+	/* first make backends that are looking types up give up on storing */
+	pg_atomic_fetch_add_u64(&SharedTypeCacheCtl->generation, 1);
+
+	LWLockAcquire(&SharedTypeCacheCtl->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedTypeCacheHash);
+	while ((ent = (SharedTypeCacheEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (ent->key.dbid != dbid)
+			continue;
+
+		/* removing the current element is allowed during a scan */
+		hash_search(SharedTypeCacheHash, &ent->key, HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(&SharedTypeCacheCtl->lock);
+}
+
+/*
+ * SharedTypeCacheInvalidate
+ *		Apply invalidation messages to the cache
+ *
+ * Called both before and after the messages are put into the sinval queue;
+ * see file header.
+ */
+void
+SharedTypeCacheInvalidate(const SharedInvalidationMessage *msgs, int n)
+{
+	if (SharedTypeCacheHash == NULL || !IsUnderPostmaster)
+		return;
+
+	for (int i = 0; i < n; i++)
+	{
+		const SharedInvalidationMessage *msg = &msgs[i];
+
+		if (msg->id == CLAOID)
+			SharedTypeCacheInvalidateAll(msg->cc.dbId);
+		else if (msg->id == SHAREDINVALCATALOG_ID &&
+				 msg->cat.catId == OperatorClassRelationId)
+			SharedTypeCacheInvalidateAll(msg->cat.dbId);
+	}
+}
+
+/*
+ * SharedTypeCacheDropDatabase
+ *		Forget all entries of a database that is being dropped
+ */
+void
+SharedTypeCacheDropDatabase(Oid dbid)
+{
+	if (SharedTypeCacheHash == NULL || !IsUnderPostmaster)
+		return;
+
+	SharedTypeCacheInvalidateAll(dbid);
+}
@@ -30,6 +30,7 @@
 #include "catalog/pg_authid.h"
 #include "catalog/pg_cast.h"
 #include "catalog/pg_collation.h"
+#include "catalog/pg_compression_dictionary.h"
 #include "catalog/pg_constraint.h"
 #include "catalog/pg_conversion.h"
 #include "catalog/pg_database.h"
@@ -248,6 +249,12 @@ static const struct cachedesc cacheinfo[] = {
 		KEY(Anum_pg_collation_oid),
 		8
 	},
+	[COMPRESSIONDICTOID] = {
+		CompressionDictionaryRelationId,
+		CompressionDictionaryOidIndexId,
+		KEY(Anum_pg_compression_dictionary_oid),
+		8
+	},
 	[CONDEFAULT] = {
 		ConversionRelationId,
 		ConversionDefaultIndexId,
@@ -50,6 +50,8 @@
 #include "access/relation.h"
 #include "access/session.h"
 #include "access/table.h"
+#include "access/transam.h"
+#include "access/xact.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_constraint.h"
 #include "catalog/pg_enum.h"
@@ -69,6 +71,7 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/sharedtypcache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 #include "utils/typcache.h"
@@ -102,6 +105,7 @@ static TypeCacheEntry *firstDomainTypeEntry = NULL;
 #define TCFLAGS_HAVE_FIELD_EXTENDED_HASHING	0x040000
 #define TCFLAGS_CHECKED_DOMAIN_CONSTRAINTS	0x080000
 #define TCFLAGS_DOMAIN_BASE_IS_COMPOSITE	0x100000
+#define TCFLAGS_CHECKED_SHARED				0x200000
 
 /* The flags associated with equality/comparison/hashing are all but these: */
 #define TCFLAGS_OPERATOR_FLAGS \
@@ -109,6 +113,17 @@ static TypeCacheEntry *firstDomainTypeEntry = NULL;
 	   TCFLAGS_CHECKED_DOMAIN_CONSTRAINTS | \
 	   TCFLAGS_DOMAIN_BASE_IS_COMPOSITE))
 
+/* The flags whose data can come from the shared type cache */
+#define TCFLAGS_SHARED_FLAGS \
+	(TCFLAGS_CHECKED_BTREE_OPCLASS | \
+	 TCFLAGS_CHECKED_HASH_OPCLASS | \
+	 TCFLAGS_CHECKED_EQ_OPR | \
+	 TCFLAGS_CHECKED_LT_OPR | \
+	 TCFLAGS_CHECKED_GT_OPR | \
+	 TCFLAGS_CHECKED_CMP_PROC | \
+	 TCFLAGS_CHECKED_HASH_PROC | \
+	 TCFLAGS_CHECKED_HASH_EXTENDED_PROC)
+
 /*
  * Data stored about a domain type's constraints.  Note that we do not create
  * this struct for the common case of a constraint-less domain; we just set
@@ -252,13 +267,18 @@ shared_record_table_hash(const void *a, size_t size, void *arg)
 	return hashTupleDesc(t);
 }
 
-/* Parameters for SharedRecordTypmodRegistry's TupleDesc table. */
+/*
+ * Parameters for SharedRecordTypmodRegistry's TupleDesc table.  Its entries
+ * are never deleted, and are complete once the inserting backend releases
+ * the lock, so parallel workers can look up their row types without locking.
+ */
 static const dshash_parameters srtr_record_table_params = {
 	sizeof(SharedRecordTableKey),	/* unused */
 	sizeof(SharedRecordTableEntry),
 	shared_record_table_compare,
 	shared_record_table_hash,
-	LWTRANCHE_PER_SESSION_RECORD_TYPE
+	LWTRANCHE_PER_SESSION_RECORD_TYPE,
+	true						/* unlocked_reads */
 };
 
 /* Parameters for SharedRecordTypmodRegistry's typmod hash table. */
@@ -291,6 +311,12 @@ static int32 NextRecordTypmod = 0;	/* number of entries used */
  */
 static uint64 tupledesc_id_counter = INVALID_TUPLEDESC_IDENTIFIER;
 
+static bool typcache_use_shared(TypeCacheEntry *typentry, int flags,
+								uint64 *generation);
+static void load_shared_type_data(TypeCacheEntry *typentry,
+								  const SharedTypeCacheData *data);
+static void store_shared_type_data(TypeCacheEntry *typentry,
+								   uint64 generation);
 static void load_typcache_tupdesc(TypeCacheEntry *typentry);
 static void load_rangetype_info(TypeCacheEntry *typentry);
 static void load_multirangetype_info(TypeCacheEntry *typentry);
@@ -345,6 +371,8 @@ lookup_type_cache(Oid type_id, int flags)
 {
 	TypeCacheEntry *typentry;
 	bool		found;
+	bool		use_shared;
+	uint64		shared_generation = 0;
 
 	if (TypeCacheHash == NULL)
 	{
@@ -468,6 +496,12 @@ lookup_type_cache(Oid type_id, int flags)
 		ReleaseSysCache(tp);
 	}
 
+	/*
+	 * For builtin types, the operator data may have been looked up by another
+	 * backend already; and if not, we'll share what we find.
+	 */
+	use_shared = typcache_use_shared(typentry, flags, &shared_generation);
+
 	/*
 	 * Look up opclasses if we haven't already and any dependent info is
 	 * requested.
@@ -769,6 +803,9 @@ lookup_type_cache(Oid type_id, int flags)
 		typentry->flags |= TCFLAGS_CHECKED_HASH_EXTENDED_PROC;
 	}
 
+	if (use_shared)
+		store_shared_type_data(typentry, shared_generation);
+
 	/*
 	 * Set up fmgr lookup info as requested
 	 *
@@ -871,6 +908,146 @@ lookup_type_cache(Oid type_id, int flags)
 	return typentry;
 }
 
+/*
+ * typcache_use_shared --- decide whether lookup_type_cache uses the shared
+ * type cache
+ *
+ * Only builtin types that are neither composite nor domains are shared, and
+ * only by backends that see no catalog changes of their own; see
+ * sharedtypcache.c.  If the operator data the caller wants isn't in the
+ * entry yet, we first try to load it from the shared cache.  If that's not
+ * enough, we return true, and the caller stores what it looks up in the
+ * shared cache afterwards, unless *generation has changed by then.
+ */
+static bool
+typcache_use_shared(TypeCacheEntry *typentry, int flags, uint64 *generation)
+{
+	int			needed = 0;
+
+	if (typentry->type_id >= FirstGenbkiObjectId ||
+		typentry->typtype == TYPTYPE_COMPOSITE ||
+		typentry->typtype == TYPTYPE_DOMAIN ||
+		!SharedTypeCacheEnabled())
+		return false;
+
+	if (flags & TYPECACHE_BTREE_OPFAMILY)
+		needed |= TCFLAGS_CHECKED_BTREE_OPCLASS;
+	if (flags & TYPECACHE_HASH_OPFAMILY)
+		needed |= TCFLAGS_CHECKED_HASH_OPCLASS;
+	if (flags & (TYPECACHE_EQ_OPR | TYPECACHE_EQ_OPR_FINFO))
+		needed |= TCFLAGS_CHECKED_EQ_OPR;
+	if (flags & TYPECACHE_LT_OPR)
+		needed |= TCFLAGS_CHECKED_LT_OPR;
+	if (flags & TYPECACHE_GT_OPR)
+		needed |= TCFLAGS_CHECKED_GT_OPR;
+	if (flags & (TYPECACHE_CMP_PROC | TYPECACHE_CMP_PROC_FINFO))
+		needed |= TCFLAGS_CHECKED_CMP_PROC;
+	if (flags & (TYPECACHE_HASH_PROC | TYPECACHE_HASH_PROC_FINFO))
+		needed |= TCFLAGS_CHECKED_HASH_PROC;
+	if (flags & (TYPECACHE_HASH_EXTENDED_PROC |
+				 TYPECACHE_HASH_EXTENDED_PROC_FINFO))
+		needed |= TCFLAGS_CHECKED_HASH_EXTENDED_PROC;
+
+	needed &= ~typentry->flags;
+	if (needed == 0)
+		return false;
+
+	if (TransactionIdIsValid(GetTopTransactionIdIfAny()) ||
+		TransactionHasInvalidations() ||
+		HistoricSnapshotActive())
+		return false;
+
+	/*
+	 * Consult the shared cache once per entry, or after our opclass data got
+	 * invalidated.  Don't mix its data with what we have looked up already.
+	 */
+	if (!(typentry->flags & TCFLAGS_CHECKED_SHARED))
+	{
+		SharedTypeCacheData data;
+
+		typentry->flags |= TCFLAGS_CHECKED_SHARED;
+		if ((typentry->flags & TCFLAGS_SHARED_FLAGS) == 0 &&
+			SharedTypeCacheLookup(typentry->type_id, &data))
+		{
+			load_shared_type_data(typentry, &data);
+			if ((needed & ~typentry->flags) == 0)
+				return false;
+		}
+	}
+
+	/*
+	 * We'll look the rest up ourselves.  For what we find to be current if
+	 * the generation doesn't move meanwhile, catch up with invalidations
+	 * after reading it, and make sure our catalog snapshot is a new one.
+	 */
+	*generation = SharedTypeCacheGeneration();
+	AcceptInvalidationMessages();
+	InvalidateCatalogSnapshot();
+
+	return true;
+}
+
+/*
+ * load_shared_type_data --- copy operator data from the shared type cache
+ * into a typcache entry
+ */
+static void
+load_shared_type_data(TypeCacheEntry *typentry,
+					  const SharedTypeCacheData *data)
+{
+	Assert((data->flags & ~TCFLAGS_SHARED_FLAGS) == 0);
+
+	typentry->btree_opf = data->btree_opf;
+	typentry->btree_opintype = data->btree_opintype;
+	typentry->hash_opf = data->hash_opf;
+	typentry->hash_opintype = data->hash_opintype;
+	typentry->lt_opr = data->lt_opr;
+	typentry->gt_opr = data->gt_opr;
+
+	/* As in lookup_type_cache, reset the finfos only if changing state */
+	if (typentry->eq_opr != data->eq_opr)
+		typentry->eq_opr_finfo.fn_oid = InvalidOid;
+	typentry->eq_opr = data->eq_opr;
+	if (typentry->cmp_proc != data->cmp_proc)
+		typentry->cmp_proc_finfo.fn_oid = InvalidOid;
+	typentry->cmp_proc = data->cmp_proc;
+	if (typentry->hash_proc != data->hash_proc)
+		typentry->hash_proc_finfo.fn_oid = InvalidOid;
+	typentry->hash_proc = data->hash_proc;
+	if (typentry->hash_extended_proc != data->hash_extended_proc)
+		typentry->hash_extended_proc_finfo.fn_oid = InvalidOid;
+	typentry->hash_extended_proc = data->hash_extended_proc;
+
+	typentry->flags |= data->flags;
+}
+
+/*
+ * store_shared_type_data --- put a typcache entry's operator data into the
+ * shared type cache
+ */
+static void
+store_shared_type_data(TypeCacheEntry *typentry, uint64 generation)
+{
+	SharedTypeCacheData data;
+
+	data.flags = typentry->flags & TCFLAGS_SHARED_FLAGS;
+	if (data.flags == 0)
+		return;
+
+	data.btree_opf = typentry->btree_opf;
+	data.btree_opintype = typentry->btree_opintype;
+	data.hash_opf = typentry->hash_opf;
+	data.hash_opintype = typentry->hash_opintype;
+	data.eq_opr = typentry->eq_opr;
+	data.lt_opr = typentry->lt_opr;
+	data.gt_opr = typentry->gt_opr;
+	data.cmp_proc = typentry->cmp_proc;
+	data.hash_proc = typentry->hash_proc;
+	data.hash_extended_proc = typentry->hash_extended_proc;
+
+	SharedTypeCacheInsert(typentry->type_id, &data, generation);
+}
+
 /*
  * load_typcache_tupdesc --- helper routine to set up composite type's tupDesc
  */
@@ -2773,12 +2950,10 @@ find_or_make_matching_shared_tupledesc(TupleDesc tupdesc)
 	key.shared = false;
 	key.u.local_tupdesc = tupdesc;
 	record_table_entry = (SharedRecordTableEntry *)
-		dshash_find(CurrentSession->shared_record_table, &key, false);
+		dshash_find_unlocked(CurrentSession->shared_record_table, &key);
 	if (record_table_entry)
 	{
 		Assert(record_table_entry->key.shared);
-		dshash_release_lock(CurrentSession->shared_record_table,
-							record_table_entry);
 		result = (TupleDesc)
 			dsa_get_address(CurrentSession->area,
 							record_table_entry->key.u.shared_tupdesc);
@@ -29,6 +29,7 @@
 #include <utime.h>
 
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "catalog/pg_authid.h"
 #include "common/file_perm.h"
 #include "libpq/libpq.h"
@@ -865,8 +866,13 @@ InitializeSystemUser(const char *authn_id, const char *auth_method)
 {
 	char	   *system_user;
 
-	/* call only once */
-	Assert(SystemUser == NULL);
+	/* call only once, except in a parallel worker reused from the pool */
+	Assert(SystemUser == NULL || IsParallelWorker());
+	if (SystemUser != NULL)
+	{
+		pfree(unconstify(char *, SystemUser));
+		SystemUser = NULL;
+	}
 
 	/*
 	 * InitializeSystemUser should be called only when authn_id is not NULL,
@@ -42,8 +42,10 @@
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/sessionkeeper.h"
 #include "replication/slot.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
@@ -56,6 +58,7 @@
 #include "storage/sync.h"
 #include "tcop/tcopprot.h"
 #include "utils/acl.h"
+#include "utils/backend_profile.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/guc_hooks.h"
@@ -77,6 +80,7 @@ static void LockTimeoutHandler(void);
 static void IdleInTransactionSessionTimeoutHandler(void);
 static void IdleSessionTimeoutHandler(void);
 static void IdleStatsUpdateTimeoutHandler(void);
+static void ResourceUsageTimeoutHandler(void);
 static void ClientCheckTimeoutHandler(void);
 static bool ThereIsAtLeastOneRole(void);
 static void process_startup_options(Port *port, bool am_superuser);
@@ -240,17 +244,23 @@ PerformAuthentication(Port *port)
 	enable_timeout_after(STATEMENT_TIMEOUT, AuthenticationTimeout * 1000);
 
 	/*
-	 * Now perform authentication exchange.
+	 * Now perform authentication exchange.  The client of a resumed parked
+	 * session authenticated when it first connected.
 	 */
-	set_ps_display("authentication");
-	ClientAuthentication(port); /* might not return, if failure */
+	if (port->parked_session)
+		RestoreParkedSessionAuthentication(port);
+	else
+	{
+		set_ps_display("authentication");
+		ClientAuthentication(port); /* might not return, if failure */
+	}
 
 	/*
 	 * Done with authentication.  Disable the timeout, and log if needed.
 	 */
 	disable_timeout(STATEMENT_TIMEOUT, false);
 
-	if (Log_connections)
+	if (Log_connections && port->parked_session == NULL)
 	{
 		StringInfoData logmsg;
 
@@ -653,6 +663,7 @@ BaseInit(void)
 	InitSync();
 	smgrinit();
 	InitBufferPoolAccess();
+	pgaio_init_backend();
 
 	/*
 	 * Initialize temporary file access after pgstat, so that the temporary
@@ -767,6 +778,10 @@ InitPostgres(const char *in_dbname, Oid dboid,
 		RegisterTimeout(CLIENT_CONNECTION_CHECK_TIMEOUT, ClientCheckTimeoutHandler);
 		RegisterTimeout(IDLE_STATS_UPDATE_TIMEOUT,
 						IdleStatsUpdateTimeoutHandler);
+		RegisterTimeout(RESOURCE_USAGE_TIMEOUT, ResourceUsageTimeoutHandler);
+		pgstat_enable_resource_usage_sampling();
+		RegisterTimeout(PROFILE_SAMPLE_TIMEOUT, ProfileSampleTimeoutHandler);
+		pgstat_enable_profile_sampling();
 	}
 
 	/*
@@ -1119,6 +1134,9 @@ InitPostgres(const char *in_dbname, Oid dboid,
 	 */
 	MyDatabaseId = dboid;
 
+	/* Start receiving cache invalidations for objects of the database */
+	SharedInvalBackendSetDatabase(dboid);
+
 	/*
 	 * Now we can mark our PGPROC entry with the database ID.
 	 *
@@ -1415,6 +1433,14 @@ IdleStatsUpdateTimeoutHandler(void)
 	SetLatch(MyLatch);
 }
 
+static void
+ResourceUsageTimeoutHandler(void)
+{
+	ResourceUsageTimeoutPending = true;
+	InterruptPending = true;
+	SetLatch(MyLatch);
+}
+
 static void
 ClientCheckTimeoutHandler(void)
 {
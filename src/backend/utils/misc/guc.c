@@ -186,6 +186,7 @@ static const unit_conversion time_unit_conversion_table[] =
 static const char *const map_old_guc_names[] = {
 	"sort_mem", "work_mem",
 	"vacuum_mem", "maintenance_work_mem",
+	"debug_io_direct", "io_direct",
 	NULL
 };
 
@@ -2069,6 +2070,29 @@ ResetAllOptions(void)
 }
 
 
+/*
+ * Has any option been SET in this session, rather than coming from the
+ * configuration files, the startup packet or ALTER ROLE/DATABASE ... SET?
+ */
+bool
+AnyOptionsSetInSession(void)
+{
+	dlist_iter	iter;
+
+	/* We need only consider GUCs not already at PGC_S_DEFAULT */
+	dlist_foreach(iter, &guc_nondef_list)
+	{
+		struct config_generic *gconf = dlist_container(struct config_generic,
+													   nondef_link, iter.cur);
+
+		if (gconf->source == PGC_S_SESSION)
+			return true;
+	}
+
+	return false;
+}
+
+
 /*
  * Apply a change to a GUC variable's "source" field.
  *
@@ -26,11 +26,15 @@
 #include <syslog.h>
 #endif
 
+#include "access/columnar.h"
 #include "access/commit_ts.h"
 #include "access/gin.h"
+#include "access/parallel.h"
+#include "access/slru.h"
 #include "access/toast_compression.h"
 #include "access/twophase.h"
 #include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
 #include "archive/archive_module.h"
@@ -42,6 +46,12 @@
 #include "commands/user.h"
 #include "commands/vacuum.h"
 #include "common/scram-common.h"
+#include "executor/execBatch.h"
+#include "executor/nodeHashjoin.h"
+#include "executor/nodeMemoize.h"
+#include "executor/nodeMergejoin.h"
+#include "executor/nodeNestloop.h"
+#include "executor/nodeSubplan.h"
 #include "jit/jit.h"
 #include "libpq/auth.h"
 #include "libpq/libpq.h"
@@ -55,23 +65,38 @@
 #include "parser/parse_expr.h"
 #include "parser/parser.h"
 #include "pgstat.h"
+#include "postmaster/autoprewarm.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/sessionkeeper.h"
 #include "postmaster/startup.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
 #include "replication/logicallauncher.h"
+#include "replication/logicalworker.h"
+#include "replication/shareddecoding.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
+#include "replication/walsender.h"
+#include "storage/aio.h"
+#include "storage/buffile.h"
 #include "storage/bufmgr.h"
+#include "storage/freespace.h"
 #include "storage/large_object.h"
+#include "storage/lwlock.h"
 #include "storage/pg_shmem.h"
 #include "storage/predicate.h"
+#include "storage/sinvaladt.h"
+#include "storage/smgr.h"
 #include "storage/standby.h"
+#include "tcop/stmtcache.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
+#include "utils/backend_memory.h"
+#include "utils/backend_profile.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
 #include "utils/float.h"
@@ -81,6 +106,9 @@
 #include "utils/pg_locale.h"
 #include "utils/portal.h"
 #include "utils/ps_status.h"
+#include "utils/sharedcatcache.h"
+#include "utils/sharedplancache.h"
+#include "utils/tuplesort.h"
 #include "utils/inval.h"
 #include "utils/xml.h"
 
@@ -312,6 +340,12 @@ static const struct config_enum_entry compute_query_id_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry join_search_method_options[] = {
+	{"geqo", JOIN_SEARCH_GEQO, false},
+	{"greedy", JOIN_SEARCH_GREEDY, false},
+	{NULL, 0, false}
+};
+
 /*
  * Although only "on", "off", and "partition" are documented, we
  * accept all the likely variants of "on" and "off".
@@ -391,6 +425,12 @@ static const struct config_enum_entry debug_parallel_query_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry vacuum_freeze_strategy_options[] = {
+	{"lazy", VACUUM_FREEZE_STRATEGY_LAZY, false},
+	{"eager", VACUUM_FREEZE_STRATEGY_EAGER, false},
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry plan_cache_mode_options[] = {
 	{"auto", PLAN_CACHE_MODE_AUTO, false},
 	{"force_generic_plan", PLAN_CACHE_MODE_FORCE_GENERIC_PLAN, false},
@@ -447,6 +487,21 @@ static const struct config_enum_entry default_toast_compression_options[] = {
 	{"pglz", TOAST_PGLZ_COMPRESSION, false},
 #ifdef  USE_LZ4
 	{"lz4", TOAST_LZ4_COMPRESSION, false},
+#endif
+#ifdef  USE_ZSTD
+	{"zstd", TOAST_ZSTD_COMPRESSION, false},
+#endif
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry columnar_compression_options[] = {
+	{"none", COLUMNAR_COMPRESSION_NONE, false},
+	{"pglz", COLUMNAR_COMPRESSION_PGLZ, false},
+#ifdef  USE_LZ4
+	{"lz4", COLUMNAR_COMPRESSION_LZ4, false},
+#endif
+#ifdef  USE_ZSTD
+	{"zstd", COLUMNAR_COMPRESSION_ZSTD, false},
 #endif
 	{NULL, 0, false}
 };
@@ -470,6 +525,21 @@ static const struct config_enum_entry wal_compression_options[] = {
 	{NULL, 0, false}
 };
 
+/* methods for compressing WAL streamed or archived, see xlogcompress.c */
+static const struct config_enum_entry wal_stream_compression_options[] = {
+#ifdef USE_LZ4
+	{"lz4", WAL_COMPRESSION_LZ4, false},
+#endif
+#ifdef USE_ZSTD
+	{"zstd", WAL_COMPRESSION_ZSTD, false},
+#endif
+	{"off", WAL_COMPRESSION_NONE, false},
+	{"false", WAL_COMPRESSION_NONE, true},
+	{"no", WAL_COMPRESSION_NONE, true},
+	{"0", WAL_COMPRESSION_NONE, true},
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
@@ -478,6 +548,7 @@ extern const struct config_enum_entry archive_mode_options[];
 extern const struct config_enum_entry recovery_target_action_options[];
 extern const struct config_enum_entry sync_method_options[];
 extern const struct config_enum_entry dynamic_shared_memory_options[];
+extern const struct config_enum_entry io_method_options[];
 
 /*
  * GUC option variables that are exported from this module
@@ -520,6 +591,7 @@ int			trace_recovery_messages = LOG;
 char	   *backtrace_functions;
 
 int			temp_file_limit = -1;
+int			node_temp_file_limit = -1;
 
 int			num_temp_buffers = 1024;
 
@@ -550,6 +622,9 @@ int			ssl_renegotiation_limit;
  */
 int			huge_pages = HUGE_PAGES_TRY;
 int			huge_page_size;
+bool		numa_enabled = false;
+bool		numa_pin_backends = false;
+bool		shared_memory_prefault = false;
 
 /*
  * These variables are all dummies that don't do anything, except in some
@@ -563,7 +638,7 @@ static char *datestyle_string;
 static char *server_encoding_string;
 static char *server_version_string;
 static int	server_version_num;
-static char *debug_io_direct_string;
+static char *io_direct_string;
 
 #ifdef HAVE_SYSLOG
 #define	DEFAULT_SYSLOG_FACILITY LOG_LOCAL0
@@ -830,6 +905,16 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_indexskipscan", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables skipping over the distinct values of an unconstrained leading btree index column."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_indexskipscan,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_bitmapscan", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of bitmap-scan plans."),
@@ -840,6 +925,16 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_eager_aggregate", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of partial aggregation below joins."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_eager_aggregate,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_tidscan", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of TID scan plans."),
@@ -900,6 +995,17 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_adaptive_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables nested-loop joins to switch to hashing at run time."),
+			gettext_noop("A nested loop that reads far more outer rows than "
+						 "estimated builds a hash table over its inner side."),
+			GUC_EXPLAIN
+		},
+		&enable_adaptive_nestloop,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of nested-loop join plans."),
@@ -980,6 +1086,16 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_parallel_hashagg", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of parallel-aware hashed aggregation plans."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_parallel_hashagg,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_partition_pruning", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables plan-time and execution-time partition pruning."),
@@ -992,6 +1108,19 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_partition_path_reuse", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables reusing the access paths of a partition for its like siblings."),
+			gettext_noop("Allows the query planner to build the access paths of "
+						 "a partition from those of a partition with the same "
+						 "structure and a similar size, instead of searching "
+						 "for them again."),
+			GUC_EXPLAIN
+		},
+		&enable_partition_path_reuse,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_presorted_aggregate", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's ability to produce plans that "
@@ -1048,6 +1177,16 @@ struct config_bool ConfigureNamesBool[] =
 		false,
 		check_bonjour, NULL, NULL
 	},
+	{
+		{"session_parking", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
+			gettext_noop("Lets idle sessions give up their backend until their client sends something."),
+			gettext_noop("Sessions idle for session_park_timeout are kept by the session keeper "
+						 "process, and resumed in a new backend.")
+		},
+		&session_parking,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"track_commit_timestamp", PGC_POSTMASTER, REPLICATION_SENDING,
 			gettext_noop("Collects transaction commit time."),
@@ -1057,6 +1196,15 @@ struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"logical_decoding_shared", PGC_SIGHUP, REPLICATION_SENDING,
+			gettext_noop("Shares logical decoding between WAL senders producing the same output."),
+			gettext_noop("Takes effect when logical replication is started.")
+		},
+		&logical_decoding_shared,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"ssl", PGC_SIGHUP, CONN_AUTH_SSL,
 			gettext_noop("Enables SSL connections."),
@@ -1084,6 +1232,15 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"ssl_ktls", PGC_SIGHUP, CONN_AUTH_SSL,
+			gettext_noop("Uses kernel TLS offload for SSL connections, if available."),
+			NULL
+		},
+		&ssl_ktls,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"fsync", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Forces synchronization of updates to disk."),
@@ -1168,6 +1325,17 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_group_commit", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Flushes the WAL for concurrent commits as a group."),
+			gettext_noop("One backend flushes the WAL for all that are waiting, "
+						 "after a delay adapted to the measured fsync time.")
+		},
+		&wal_group_commit,
+		true,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_init_zero", PGC_SUSET, WAL_SETTINGS,
 			gettext_noop("Writes zeroes to new WAL files before first use."),
@@ -1188,6 +1356,18 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"end_of_recovery_checkpoint", PGC_SIGHUP, WAL_RECOVERY,
+			gettext_noop("Waits for a checkpoint at the end of crash recovery."),
+			gettext_noop("If off, crash recovery only writes an end-of-recovery "
+						 "record, and the server accepts connections while the "
+						 "checkpoint runs in the background.")
+		},
+		&end_of_recovery_checkpoint,
+		true,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_checkpoints", PGC_SIGHUP, LOGGING_WHAT,
 			gettext_noop("Logs each checkpoint."),
@@ -1197,6 +1377,16 @@ struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"checkpoint_adaptive_pacing", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Adapts the pacing of checkpoint writes and fsyncs to the measured I/O times."),
+			gettext_noop("Part of the checkpoint is reserved for spreading the fsyncs, "
+						 "according to how long they took in previous checkpoints.")
+		},
+		&checkpoint_adaptive_pacing,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"log_connections", PGC_SU_BACKEND, LOGGING_WHAT,
 			gettext_noop("Logs each successful connection."),
@@ -1416,6 +1606,44 @@ struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"track_wait_timing", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Collects timing statistics for wait events."),
+			NULL
+		},
+		&pgstat_track_wait_timing,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"lwlock_profiling", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Records where LWLocks are acquired, and how long they are waited for and held."),
+			gettext_noop("The recent acquisitions are shown in pg_stat_lwlock_profile.")
+		},
+		&lwlock_profiling,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"track_planning_detail", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Collects planner statistics per query id."),
+			gettext_noop("Requires compute_query_id.  The statistics are "
+						 "kept until pg_stat_reset_planning() is called.")
+		},
+		&track_planning_detail,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"track_queries", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Collects execution statistics per query id."),
+			gettext_noop("Requires compute_query_id.  The statistics are "
+						 "kept until pg_stat_reset_queries() is called.")
+		},
+		&pgstat_track_queries,
+		true,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"update_process_title", PGC_SUSET, PROCESS_TITLE,
@@ -1763,6 +1991,17 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"fsm_spread_inserts", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Spreads concurrent searches for free space over different pages."),
+			gettext_noop("Otherwise concurrent inserters tend to be sent to the same "
+						 "page by the free space map.")
+		},
+		&fsm_spread_inserts,
+		true,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"recovery_target_inclusive", PGC_POSTMASTER, WAL_RECOVERY_TARGET,
 			gettext_noop("Sets whether to include or exclude transaction with recovery target."),
@@ -1901,6 +2140,54 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"parallel_sort_merge", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Enables parallel workers to perform the final merge of a parallel sort."),
+			gettext_noop("The workers merge key ranges of the sorted runs, instead of the "
+						 "leader merging all runs by itself."),
+			GUC_EXPLAIN
+		},
+		&parallel_sort_merge,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"hashjoin_runtime_filter", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Lets hash joins filter their outer scans with a "
+						 "bloom filter of the inner keys."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&hashjoin_runtime_filter,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"memoize_shared_cache", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Lets the processes of a parallel query share "
+						 "the cache of a memoize node."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&memoize_shared_cache,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"mergejoin_seek", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Lets merge joins skip ahead in an index scan input "
+						 "by descending the index again."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&mergejoin_seek,
+		true,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"jit", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Allow JIT compilation."),
@@ -1988,6 +2275,49 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"numa", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Places shared memory on NUMA nodes."),
+			gettext_noop("Spreads shared buffers and WAL buffers across all NUMA nodes, "
+						 "and places each process's shared state on a single node.")
+		},
+		&numa_enabled,
+		false,
+		check_numa, NULL, NULL
+	},
+
+	{
+		{"numa_pin_backends", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Runs each process on the NUMA node holding its shared state."),
+			gettext_noop("Has no effect unless \"numa\" is also enabled.")
+		},
+		&numa_pin_backends,
+		false,
+		check_numa, NULL, NULL
+	},
+
+	{
+		{"shared_memory_prefault", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Faults in all of shared memory at server start."),
+			gettext_noop("Otherwise, the cost of allocating the pages of shared memory, huge pages "
+						 "in particular, is paid by the queries that first touch them.")
+		},
+		&shared_memory_prefault,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"autoprewarm", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Reloads the contents of shared buffers after a restart."),
+			gettext_noop("The list of blocks in shared buffers is saved periodically and at shutdown, "
+						 "and the blocks are read back in at server start.")
+		},
+		&autoprewarm,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_receiver_create_temp_slot", PGC_SIGHUP, REPLICATION_STANDBY,
 			gettext_noop("Sets whether a WAL receiver should create a temporary replication slot if no permanent slot is configured."),
@@ -1997,6 +2327,28 @@ struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"parallel_apply_non_streamed", PGC_SIGHUP, REPLICATION_SUBSCRIBERS,
+			gettext_noop("Allows parallel apply workers to apply non-streamed transactions."),
+			gettext_noop("Applies to subscriptions with streaming = parallel. "
+						 "Transactions are committed in the publisher's commit order.")
+		},
+		&parallel_apply_non_streamed,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"logical_replication_row_batches", PGC_SIGHUP, REPLICATION_SUBSCRIBERS,
+			gettext_noop("Asks publishers to send consecutive inserts into a table in a single message."),
+			gettext_noop("Takes effect when an apply worker starts. The publisher "
+						 "must support logical replication protocol version 5.")
+		},
+		&logical_replication_row_batches,
+		false,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, false, NULL, NULL, NULL
@@ -2038,6 +2390,28 @@ struct config_int ConfigureNamesInt[] =
 		100, 1, 10000,
 		NULL, NULL, NULL
 	},
+	{
+		{"executor_batch_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of tuples passed at a time between "
+						 "plan nodes that support batch execution."),
+			gettext_noop("Zero disables batch execution."),
+			GUC_EXPLAIN
+		},
+		&executor_batch_size,
+		64, 0, 8192,
+		NULL, NULL, NULL
+	},
+	{
+		{"nestloop_batch_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of outer tuples whose inner index "
+						 "probes a nested loop join combines into one index scan."),
+			gettext_noop("Zero or one disables batching of the probes."),
+			GUC_EXPLAIN
+		},
+		&nestloop_batch_size,
+		64, 0, 1024,
+		NULL, NULL, NULL
+	},
 	{
 		{"from_collapse_limit", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Sets the FROM-list size beyond which subqueries "
@@ -2064,6 +2438,51 @@ struct config_int ConfigureNamesInt[] =
 		8, 1, INT_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"jit_cache_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the maximum number of JIT-compiled functions kept for reuse."),
+			gettext_noop("Tuple deforming functions are compiled once per "
+						 "session and tuple shape, up to this many.  "
+						 "0 disables the cache."),
+			GUC_EXPLAIN
+		},
+		&jit_cache_size,
+		256, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"jit_warmup_evaluations", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the number of times an expression is interpreted before its JIT-compiled code is used."),
+			gettext_noop("Queries that end before that don't wait for code "
+						 "to be emitted.  0 uses the compiled code from the "
+						 "first evaluation."),
+			GUC_EXPLAIN
+		},
+		&jit_warmup_evaluations,
+		1000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"statement_cache_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the maximum number of simple-query statements whose parse analysis is cached."),
+			gettext_noop("Statements that differ only in their literals share "
+						 "an entry.  0 disables the cache.")
+		},
+		&statement_cache_size,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+	{
+		{"initplan_cache_ttl", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets how long the results of uncorrelated initplans are reused."),
+			gettext_noop("Later executions of the same plan with the same parameters "
+						 "reuse a result for this long.  0 disables the cache."),
+			GUC_UNIT_MS
+		},
+		&initplan_cache_ttl,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
 	{
 		{"geqo_threshold", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("Sets the threshold of FROM items beyond which GEQO is used."),
@@ -2204,6 +2623,29 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"prefork_backends", PGC_SIGHUP, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the number of backends started ahead of time for new connections."),
+			gettext_noop("Up to this many idle backends wait for a connection, "
+						 "so that it needn't wait for a new process to start.")
+		},
+		&prefork_backends,
+		0, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"session_park_timeout", PGC_SIGHUP, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the idle time after which a session gives up its backend."),
+			gettext_noop("Only takes effect with session_parking enabled. "
+						 "A value of 0 turns off parking."),
+			GUC_UNIT_MS
+		},
+		&session_park_timeout,
+		60000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"min_dynamic_shared_memory", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("Amount of dynamic shared memory reserved at startup."),
@@ -2215,6 +2657,19 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"dynamic_shared_memory_cache_size", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Amount of dynamic shared memory each process may keep for reuse."),
+			gettext_noop("Segments for parallel queries that are no longer in use "
+						 "are kept, up to this amount, for the next parallel query "
+						 "of the process to use."),
+			GUC_UNIT_MB
+		},
+		&dynamic_shared_memory_cache_size,
+		0, 0, (int) Min((size_t) INT_MAX, SIZE_MAX / (1024 * 1024)),
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We sometimes multiply the number of shared buffers by two without
 	 * checking for overflow, so we mustn't allow more than INT_MAX / 2.
@@ -2230,6 +2685,38 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"shared_catcache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to cache system catalog tuples."),
+			gettext_noop("0 disables the shared catalog cache."),
+			GUC_UNIT_KB
+		},
+		&shared_catcache_size,
+		16384, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_plan_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to share generic plans between sessions."),
+			gettext_noop("0 disables the shared plan cache."),
+			GUC_UNIT_KB
+		},
+		&shared_plan_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"relsize_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of relations whose sizes are cached in shared memory."),
+			gettext_noop("0 disables the cache.")
+		},
+		&relsize_cache_size,
+		8192, 0, INT_MAX / 4,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_buffer_usage_limit", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the buffer pool size for VACUUM, ANALYZE, and autovacuum."),
@@ -2352,6 +2839,43 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"memory_block_cache_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the amount of freed memory context blocks kept for reuse."),
+			gettext_noop("Blocks released when a memory context is reset or deleted "
+						 "are kept up to this size instead of being returned to the "
+						 "operating system. 0 disables the cache."),
+			GUC_UNIT_KB
+		},
+		&memory_block_cache_size,
+		2048, 0, MAX_KILOBYTES,
+		NULL, assign_memory_block_cache_size, NULL
+	},
+
+	{
+		{"backend_memory_limit", PGC_SUSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory a single backend may allocate."),
+			gettext_noop("Allocations beyond this fail with an out-of-memory error. "
+						 "0 disables the limit."),
+			GUC_UNIT_MB
+		},
+		&backend_memory_limit,
+		0, 0, INT_MAX,
+		NULL, assign_backend_memory_limit, NULL
+	},
+
+	{
+		{"total_backend_memory_limit", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory all backends together may allocate."),
+			gettext_noop("Allocations beyond this fail with an out-of-memory error. "
+						 "0 disables the limit."),
+			GUC_UNIT_MB
+		},
+		&total_backend_memory_limit,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"logical_decoding_work_mem", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum memory to be used for logical decoding."),
@@ -2391,6 +2915,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"node_temp_file_limit", PGC_SUSET, RESOURCES_DISK,
+			gettext_noop("Limits the total size of the temporary files used by each plan node."),
+			gettext_noop("-1 means no limit."),
+			GUC_UNIT_KB
+		},
+		&node_temp_file_limit,
+		-1, -1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_cost_page_hit", PGC_USERSET, RESOURCES_VACUUM_DELAY,
 			gettext_noop("Vacuum cost for a page found in the buffer cache."),
@@ -2464,6 +2999,114 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"sinval_queue_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of cache invalidation messages each shard of the shared invalidation queue can hold."),
+			gettext_noop("Backends that fall further behind must discard all their caches.")
+		},
+		&sinval_queue_size,
+		4096, MIN_SINVAL_QUEUE_SIZE, MAX_SINVAL_QUEUE_SIZE,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"sinval_database_shards", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shards of the shared invalidation queue used for messages about objects of individual databases."),
+			gettext_noop("Databases are assigned to the shards by their OID.")
+		},
+		&sinval_database_shards,
+		16, 1, MAX_SINVAL_DATABASE_SHARDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_cached_subxids", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the maximum number of subtransaction IDs each server process advertises in shared memory."),
+			gettext_noop("Snapshots taken while a transaction has more subtransactions "
+						 "than this must look up subtransactions in pg_subtrans.")
+		},
+		&max_cached_subxids,
+		256, PGPROC_MAX_CACHED_SUBXIDS, PGPROC_MAX_CACHED_SUBXIDS_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"commit_timestamp_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the commit timestamp cache."),
+			gettext_noop("0 means use a fraction of \"shared_buffers\"."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_timestamp_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_commit_ts_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_member_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact member cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_member_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_member_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_offset_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact offset cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offset_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_offset_buffers, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the LISTEN/NOTIFY message cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_notify_buffers, NULL, NULL
+	},
+
+	{
+		{"serializable_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the serializable transaction cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&serializable_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_serial_buffers, NULL, NULL
+	},
+
+	{
+		{"subtransaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the subtransaction cache."),
+			gettext_noop("0 means use a fraction of \"shared_buffers\"."),
+			GUC_UNIT_BLOCKS
+		},
+		&subtransaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_subtrans_buffers, NULL, NULL
+	},
+
+	{
+		{"transaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the transaction status cache."),
+			gettext_noop("0 means use a fraction of \"shared_buffers\"."),
+			GUC_UNIT_BLOCKS
+		},
+		&transaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_transaction_buffers, NULL, NULL
+	},
+
 #ifdef LOCK_DEBUG
 	{
 		{"trace_lock_oidmin", PGC_SUSET, DEVELOPER_OPTIONS,
@@ -2605,6 +3248,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"lock_partitions", PGC_POSTMASTER, LOCK_MANAGEMENT,
+			gettext_noop("Sets the number of partitions of the shared lock table."),
+			gettext_noop("Must be a power of two.  0 picks a value from the number of CPUs.")
+		},
+		&lock_partitions,
+		0, 0, MAX_LOCK_PARTITIONS,
+		check_lock_partitions, NULL, NULL
+	},
+
 	{
 		{"max_pred_locks_per_transaction", PGC_POSTMASTER, LOCK_MANAGEMENT,
 			gettext_noop("Sets the maximum number of predicate locks per transaction."),
@@ -2674,6 +3327,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_parallel_workers", PGC_POSTMASTER, WAL_RECOVERY,
+			gettext_noop("Sets the number of worker processes replaying WAL records in parallel during recovery."),
+			gettext_noop("Zero replays all WAL in the startup process. Parallel redo starts once recovery has reached a consistent state.")
+		},
+		&recovery_parallel_workers,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_keep_size", PGC_SIGHUP, REPLICATION_SENDING,
 			gettext_noop("Sets the size of WAL files held for standby servers."),
@@ -2697,6 +3360,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_preallocate_segments", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Sets the maximum number of future WAL segments to create ahead of time."),
+			gettext_noop("The checkpointer creates as many as the recent WAL rate calls for, "
+						 "up to this number.  0 only preallocates at checkpoints.")
+		},
+		&wal_preallocate_segments,
+		8, 0, 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_wal_size", PGC_SIGHUP, WAL_CHECKPOINTS,
 			gettext_noop("Sets the WAL size that triggers a checkpoint."),
@@ -2757,6 +3431,16 @@ struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks allowing concurrent WAL insertion."),
+			gettext_noop("With NUMA enabled, backends prefer the locks of their own node."),
+		},
+		&wal_insert_locks,
+		8, 1, 128,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Time between WAL flushes performed in the WAL writer."),
@@ -2779,6 +3463,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_buffer_init_ahead", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Number of WAL buffer pages the WAL writer initializes ahead of the insert position."),
+			gettext_noop("At most half of wal_buffers is used.  0 disables."),
+			GUC_UNIT_XBLOCKS
+		},
+		&wal_buffer_init_ahead,
+		64, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_skip_threshold", PGC_USERSET, WAL_SETTINGS,
 			gettext_noop("Minimum size of new file to fsync instead of writing WAL."),
@@ -2993,6 +3688,32 @@ struct config_int ConfigureNamesInt[] =
 		NULL
 	},
 
+	{
+		{"io_combine_limit",
+			PGC_USERSET,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Limit on the size of data reads and writes."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&io_combine_limit,
+		DEFAULT_IO_COMBINE_LIMIT,
+		1, MAX_IO_COMBINE_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"io_max_concurrency",
+			PGC_POSTMASTER,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Maximum number of asynchronous I/Os each process can have in flight."),
+			NULL
+		},
+		&io_max_concurrency,
+		32, 1, 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"backend_flush_after", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
 			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
@@ -3040,6 +3761,18 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_sync_copy_streams_per_table",
+			PGC_SIGHUP,
+			REPLICATION_SUBSCRIBERS,
+			gettext_noop("Maximum number of publisher connections a table synchronization worker copies a table over."),
+			gettext_noop("Each additional connection uses a WAL sender on the publisher."),
+		},
+		&max_sync_copy_streams_per_table,
+		1, 1, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_parallel_apply_workers_per_subscription",
 			PGC_SIGHUP,
@@ -3269,6 +4002,28 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"parallel_worker_pool_size", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of idle parallel query workers kept for reuse."),
+			gettext_noop("Pooled workers count toward max_worker_processes and max_parallel_workers while idle. "
+						 "Zero disables the pool.")
+		},
+		&parallel_worker_pool_size,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"parallel_worker_pool_idle_timeout", PGC_SIGHUP, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the time a pooled parallel worker waits for reuse before exiting."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&parallel_worker_pool_idle_timeout,
+		60000, 1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"autovacuum_work_mem", PGC_SIGHUP, RESOURCES_MEM,
 			gettext_noop("Sets the maximum memory to be used by each autovacuum worker process."),
@@ -3415,6 +4170,40 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"track_resource_usage_interval", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Sets the interval at which busy processes sample their resource usage."),
+			gettext_noop("CPU time, memory and I/O of each process are shown in "
+						 "pg_stat_activity.  Zero turns off sampling."),
+			GUC_UNIT_MS
+		},
+		&pgstat_track_resource_usage_interval,
+		1000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"profile_sample_interval", PGC_SUSET, STATS_CUMULATIVE,
+			gettext_noop("Sets the interval at which busy processes sample what they are executing."),
+			gettext_noop("The query id, plan node and wait event of each sample are "
+						 "shown in pg_stat_profile_samples.  Zero turns off sampling."),
+			GUC_UNIT_MS
+		},
+		&profile_sample_interval,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"track_queries_max", PGC_SIGHUP, STATS_CUMULATIVE,
+			gettext_noop("Sets the maximum number of query ids tracked by track_queries."),
+			NULL
+		},
+		&pgstat_track_queries_max,
+		5000, 100, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gin_pending_list_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum size of the pending list for GIN index."),
@@ -3426,6 +4215,27 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"columnar_stripe_row_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the maximum number of rows per stripe of columnar tables."),
+			NULL
+		},
+		&columnar_stripe_row_limit,
+		150000, 1000, 10000000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"columnar_chunk_group_row_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the number of rows per chunk group of columnar tables."),
+			gettext_noop("Each chunk group records the minimum and maximum of its columns, "
+						 "which lets scans skip it.")
+		},
+		&columnar_chunk_group_row_limit,
+		10000, 1000, 100000,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"tcp_user_timeout", PGC_USERSET, CONN_AUTH_TCP,
 			gettext_noop("TCP user timeout."),
@@ -3437,6 +4247,17 @@ struct config_int ConfigureNamesInt[] =
 		NULL, assign_tcp_user_timeout, show_tcp_user_timeout
 	},
 
+	{
+		{"send_buffer_size", PGC_SIGHUP, CONN_AUTH_TCP,
+			gettext_noop("Sets the size of the buffer for data sent to clients."),
+			gettext_noop("Takes effect for new connections."),
+			GUC_UNIT_KB
+		},
+		&send_buffer_size,
+		8, 8, 64 * 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"huge_page_size", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("The size of huge page that should be requested."),
@@ -3448,6 +4269,17 @@ struct config_int ConfigureNamesInt[] =
 		check_huge_page_size, NULL, NULL
 	},
 
+	{
+		{"autoprewarm_interval", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Sets the time between saves of the list of blocks in shared buffers."),
+			gettext_noop("Zero saves it only at shutdown."),
+			GUC_UNIT_S
+		},
+		&autoprewarm_interval,
+		300, 0, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"debug_discard_caches", PGC_SUSET, DEVELOPER_OPTIONS,
 			gettext_noop("Aggressively flush system caches for debugging purposes."),
@@ -3625,6 +4457,18 @@ struct config_real ConfigureNamesReal[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"adaptive_nestloop_factor", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets how many times more outer rows than estimated "
+						 "a nested loop reads before switching to hashing."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&adaptive_nestloop_factor,
+		100.0, 1.0, 1000000.0,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"cursor_tuple_fraction", PGC_USERSET, QUERY_TUNING_OTHER,
 			gettext_noop("Sets the planner's estimate of the fraction of "
@@ -4539,14 +5383,16 @@ struct config_string ConfigureNamesString[] =
 	},
 
 	{
-		{"debug_io_direct", PGC_POSTMASTER, DEVELOPER_OPTIONS,
+		{"io_direct", PGC_POSTMASTER, RESOURCES_DISK,
 			gettext_noop("Use direct I/O for file access."),
-			NULL,
-			GUC_LIST_INPUT | GUC_NOT_IN_SAMPLE
+			gettext_noop("A comma-separated list of \"data\", \"wal\" and \"wal_init\". "
+						 "Direct I/O for data bypasses the kernel's page cache and "
+						 "its read-ahead, so it is best combined with an asynchronous io_method."),
+			GUC_LIST_INPUT
 		},
-		&debug_io_direct_string,
+		&io_direct_string,
 		"",
-		check_debug_io_direct, assign_debug_io_direct, NULL
+		check_io_direct, assign_io_direct, NULL
 	},
 
 	/* End-of-list marker */
@@ -4611,6 +5457,18 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"join_search_method", PGC_USERSET, QUERY_TUNING_GEQO,
+			gettext_noop("Sets the join search method used at or above geqo_threshold."),
+			gettext_noop("\"greedy\" is a deterministic alternative to the genetic "
+						 "query optimizer."),
+			GUC_EXPLAIN
+		},
+		&join_search_method,
+		JOIN_SEARCH_GEQO, join_search_method_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"default_toast_compression", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the default compression method for compressible values."),
@@ -4622,6 +5480,17 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"columnar_compression", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the compression method for new stripes of columnar tables."),
+			NULL
+		},
+		&columnar_compression,
+		DEFAULT_COLUMNAR_COMPRESSION,
+		columnar_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"default_transaction_isolation", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the transaction isolation level of each new transaction."),
@@ -4717,6 +5586,18 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, assign_syslog_facility, NULL
 	},
 
+	{
+		{"vacuum_freeze_strategy", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets which pages VACUUM freezes."),
+			gettext_noop("With \"eager\", VACUUM also freezes pages that have not been "
+						 "modified since the previous VACUUM of the table, spreading the "
+						 "work of anti-wraparound vacuums over regular ones.")
+		},
+		&vacuum_freeze_strategy,
+		VACUUM_FREEZE_STRATEGY_LAZY, vacuum_freeze_strategy_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"session_replication_role", PGC_SUSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the session's behavior for triggers and rewrite rules."),
@@ -4747,6 +5628,57 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"archive_compression", PGC_SIGHUP, WAL_ARCHIVING,
+			gettext_noop("Compresses WAL segments handed to archive_command or archive_library with the specified method."),
+			gettext_noop("Compressed segments keep their file names, and are decompressed automatically when restored.")
+		},
+		&archive_compression,
+		WAL_COMPRESSION_NONE, wal_stream_compression_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"wal_receiver_compression", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Asks the sending server to compress the WAL it streams with the specified method."),
+			gettext_noop("Takes effect when the WAL receiver connects.")
+		},
+		&wal_receiver_compression,
+		WAL_COMPRESSION_NONE, wal_stream_compression_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"wal_sender_compression", PGC_BACKEND, REPLICATION_SENDING,
+			gettext_noop("Compresses the WAL sent by a WAL sender with the specified method."),
+			gettext_noop("This is set by the receiving server, see wal_receiver_compression."),
+			GUC_NOT_IN_SAMPLE
+		},
+		&wal_sender_compression,
+		WAL_COMPRESSION_NONE, wal_stream_compression_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"logical_decoding_spill_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Compresses the changes logical decoding spills to disk with the specified method."),
+			NULL
+		},
+		&logical_decoding_spill_compression,
+		WAL_COMPRESSION_NONE, wal_stream_compression_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"temp_file_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Compresses the temporary files of hash joins with the specified method."),
+			NULL
+		},
+		&temp_file_compression,
+		WAL_COMPRESSION_NONE, wal_stream_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"recovery_target_action", PGC_POSTMASTER, WAL_RECOVERY_TARGET,
 			gettext_noop("Sets the action to perform upon reaching the recovery target."),
@@ -4825,6 +5757,16 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"io_method", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method used for asynchronous I/O."),
+			NULL
+		},
+		&io_method,
+		DEFAULT_IO_METHOD, io_method_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"shared_memory_type", PGC_POSTMASTER, RESOURCES_MEM,
 			gettext_noop("Selects the shared memory implementation used for the main shared memory region."),
@@ -47,6 +47,7 @@
 #include "postgres.h"
 
 #include "port/pg_bitutils.h"
+#include "utils/guc_hooks.h"
 #include "utils/memdebug.h"
 #include "utils/memutils.h"
 #include "utils/memutils_memorychunk.h"
@@ -258,6 +259,34 @@ static AllocSetFreeList context_freelists[2] =
 	}
 };
 
+/*
+ * Regular blocks released by AllocSetReset and AllocSetDelete are kept in a
+ * per-process cache, up to memory_block_cache_size kilobytes, and handed out
+ * again to the next context that wants a block of the same size.  Per-query
+ * contexts grow through the same power-of-2 block sizes over and over, so
+ * this saves a malloc/free pair (often an mmap/munmap pair, for the bigger
+ * blocks) per block per query.
+ *
+ * Only power-of-2 sizes from 1 << ALLOC_BLOCK_CACHE_MINBITS up to
+ * ALLOCSET_DEFAULT_MAXSIZE are cached, one list per size, chained via the
+ * blocks' next pointers.  Cached blocks stay counted as allocated by this
+ * process for the purposes of memory accounting; they are given back to
+ * malloc if a new block can't be obtained otherwise.
+ */
+#define ALLOC_BLOCK_CACHE_MINBITS	13	/* smallest cached block is 8kB */
+#define ALLOC_BLOCK_CACHE_CLASSES	11	/* largest is 8MB */
+
+typedef struct AllocBlockCache
+{
+	Size		cached_bytes;	/* total size of cached blocks */
+	AllocBlock	blocks[ALLOC_BLOCK_CACHE_CLASSES];	/* list headers */
+} AllocBlockCache;
+
+static AllocBlockCache block_cache;
+
+/* GUC variable, in kilobytes */
+int			memory_block_cache_size = 2048;
+
 
 /* ----------
  * AllocSetFreeIndex -
@@ -316,6 +345,131 @@ AllocSetFreeIndex(Size size)
 }
 
 
+/*
+ * AllocBlockCacheIndex
+ *		Return the block cache list for blocks of 'blksize', or -1 if blocks
+ *		of that size aren't cached.
+ */
+static inline int
+AllocBlockCacheIndex(Size blksize)
+{
+	int			idx;
+
+	if (blksize < ((Size) 1 << ALLOC_BLOCK_CACHE_MINBITS) ||
+		(blksize & (blksize - 1)) != 0)
+		return -1;
+
+	idx = pg_leftmost_one_pos_size_t(blksize) - ALLOC_BLOCK_CACHE_MINBITS;
+	if (idx >= ALLOC_BLOCK_CACHE_CLASSES)
+		return -1;
+	return idx;
+}
+
+/*
+ * AllocSetMallocBlock
+ *		Obtain a block of 'blksize' bytes for 'set', from the block cache if
+ *		possible.
+ *
+ * Returns NULL if neither the cache nor malloc can provide one.
+ */
+static AllocBlock
+AllocSetMallocBlock(AllocSet set, Size blksize)
+{
+	int			idx = AllocBlockCacheIndex(blksize);
+	AllocBlock	block;
+
+	if (idx >= 0 && block_cache.blocks[idx] != NULL)
+	{
+		block = block_cache.blocks[idx];
+		VALGRIND_MAKE_MEM_DEFINED(block, ALLOC_BLOCKHDRSZ);
+		block_cache.blocks[idx] = block->next;
+		block_cache.cached_bytes -= blksize;
+		return block;
+	}
+
+	block = (AllocBlock) MemoryContextMallocBlock((MemoryContext) set, blksize);
+
+	/* If that failed, see whether giving back the cached blocks helps */
+	if (block == NULL && block_cache.cached_bytes > 0)
+	{
+		AllocSetTrimBlockCache(0);
+		block = (AllocBlock) MemoryContextMallocBlock((MemoryContext) set,
+													  blksize);
+	}
+
+	return block;
+}
+
+/*
+ * AllocSetFreeBlock
+ *		Release a block no longer used by its set, keeping it in the block
+ *		cache if there's room.
+ *
+ * The caller should already have wiped the block if it wants that.
+ */
+static void
+AllocSetFreeBlock(AllocBlock block, Size blksize)
+{
+	int			idx = AllocBlockCacheIndex(blksize);
+
+	if (idx >= 0 &&
+		block_cache.cached_bytes + blksize <=
+		(Size) memory_block_cache_size * 1024)
+	{
+		/* wipe_mem may have marked the header NOACCESS */
+		VALGRIND_MAKE_MEM_UNDEFINED(block, ALLOC_BLOCKHDRSZ);
+		block->aset = NULL;
+		block->next = block_cache.blocks[idx];
+		block_cache.blocks[idx] = block;
+		block_cache.cached_bytes += blksize;
+		VALGRIND_MAKE_MEM_NOACCESS(block, blksize);
+		return;
+	}
+
+	MemoryContextFreeBlock(block, blksize);
+}
+
+/*
+ * AllocSetTrimBlockCache
+ *		Give cached blocks back to malloc until at most 'budget' bytes
+ *		remain cached.
+ *
+ * The largest blocks are released first.
+ */
+void
+AllocSetTrimBlockCache(Size budget)
+{
+	int			idx;
+
+	for (idx = ALLOC_BLOCK_CACHE_CLASSES - 1;
+		 idx >= 0 && block_cache.cached_bytes > budget;
+		 idx--)
+	{
+		Size		blksize = (Size) 1 << (idx + ALLOC_BLOCK_CACHE_MINBITS);
+
+		while (block_cache.blocks[idx] != NULL &&
+			   block_cache.cached_bytes > budget)
+		{
+			AllocBlock	block = block_cache.blocks[idx];
+
+			VALGRIND_MAKE_MEM_DEFINED(block, ALLOC_BLOCKHDRSZ);
+			block_cache.blocks[idx] = block->next;
+			block_cache.cached_bytes -= blksize;
+			MemoryContextFreeBlock(block, blksize);
+		}
+	}
+}
+
+/*
+ * GUC assign_hook for memory_block_cache_size
+ */
+void
+assign_memory_block_cache_size(int newval, void *extra)
+{
+	AllocSetTrimBlockCache((Size) newval * 1024);
+}
+
+
 /*
  * Public routines
  */
@@ -435,7 +589,7 @@ AllocSetContextCreateInternal(MemoryContext parent,
 	 * Allocate the initial block.  Unlike other aset.c blocks, it starts with
 	 * the context header and its block header follows that.
 	 */
-	set = (AllocSet) malloc(firstBlockSize);
+	set = (AllocSet) MemoryContextMallocBlock(NULL, firstBlockSize);
 	if (set == NULL)
 	{
 		if (TopMemoryContext)
@@ -576,12 +730,14 @@ AllocSetReset(MemoryContext context)
 		else
 		{
 			/* Normal case, release the block */
-			context->mem_allocated -= block->endptr - ((char *) block);
+			Size		blksize = block->endptr - ((char *) block);
+
+			context->mem_allocated -= blksize;
 
 #ifdef CLOBBER_FREED_MEMORY
 			wipe_mem(block, block->freeptr - ((char *) block));
 #endif
-			free(block);
+			AllocSetFreeBlock(block, blksize);
 		}
 		block = next;
 	}
@@ -604,7 +760,7 @@ AllocSetDelete(MemoryContext context)
 {
 	AllocSet	set = (AllocSet) context;
 	AllocBlock	block = set->blocks;
-	Size		keepersize PG_USED_FOR_ASSERTS_ONLY;
+	Size		keepersize;
 
 	Assert(AllocSetIsValid(set));
 
@@ -645,7 +801,8 @@ AllocSetDelete(MemoryContext context)
 				freelist->num_free--;
 
 				/* All that remains is to free the header/initial block */
-				free(oldset);
+				MemoryContextFreeBlock(oldset,
+									   oldset->keeper->endptr - ((char *) oldset));
 			}
 			Assert(freelist->num_free == 0);
 		}
@@ -662,16 +819,17 @@ AllocSetDelete(MemoryContext context)
 	while (block != NULL)
 	{
 		AllocBlock	next = block->next;
+		Size		blksize = block->endptr - ((char *) block);
 
 		if (block != set->keeper)
-			context->mem_allocated -= block->endptr - ((char *) block);
+			context->mem_allocated -= blksize;
 
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, block->freeptr - ((char *) block));
 #endif
 
 		if (block != set->keeper)
-			free(block);
+			AllocSetFreeBlock(block, blksize);
 
 		block = next;
 	}
@@ -679,7 +837,7 @@ AllocSetDelete(MemoryContext context)
 	Assert(context->mem_allocated == keepersize);
 
 	/* Finally, free the context header, including the keeper block */
-	free(set);
+	MemoryContextFreeBlock(set, keepersize);
 }
 
 /*
@@ -721,7 +879,7 @@ AllocSetAlloc(MemoryContext context, Size size)
 #endif
 
 		blksize = chunk_size + ALLOC_BLOCKHDRSZ + ALLOC_CHUNKHDRSZ;
-		block = (AllocBlock) malloc(blksize);
+		block = AllocSetMallocBlock(set, blksize);
 		if (block == NULL)
 			return NULL;
 
@@ -921,7 +1079,7 @@ AllocSetAlloc(MemoryContext context, Size size)
 			blksize <<= 1;
 
 		/* Try to allocate it */
-		block = (AllocBlock) malloc(blksize);
+		block = AllocSetMallocBlock(set, blksize);
 
 		/*
 		 * We could be asking for pretty big blocks here, so cope if malloc
@@ -932,7 +1090,7 @@ AllocSetAlloc(MemoryContext context, Size size)
 			blksize >>= 1;
 			if (blksize < required_size)
 				break;
-			block = (AllocBlock) malloc(blksize);
+			block = AllocSetMallocBlock(set, blksize);
 		}
 
 		if (block == NULL)
@@ -1007,6 +1165,7 @@ AllocSetFree(void *pointer)
 	{
 		/* Release single-chunk block. */
 		AllocBlock	block = ExternalChunkGetBlock(chunk);
+		Size		blksize;
 
 		/*
 		 * Try to verify that we have a sane block pointer: the block header
@@ -1035,12 +1194,13 @@ AllocSetFree(void *pointer)
 		if (block->next)
 			block->next->prev = block->prev;
 
-		set->header.mem_allocated -= block->endptr - ((char *) block);
+		blksize = block->endptr - ((char *) block);
+		set->header.mem_allocated -= blksize;
 
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, block->freeptr - ((char *) block));
 #endif
-		free(block);
+		MemoryContextFreeBlock(block, blksize);
 	}
 	else
 	{
@@ -1156,7 +1316,9 @@ AllocSetRealloc(void *pointer, Size size)
 		blksize = chksize + ALLOC_BLOCKHDRSZ + ALLOC_CHUNKHDRSZ;
 		oldblksize = block->endptr - ((char *) block);
 
-		block = (AllocBlock) realloc(block, blksize);
+		block = (AllocBlock) MemoryContextReallocBlock((MemoryContext) set,
+													   block, oldblksize,
+													   blksize);
 		if (block == NULL)
 		{
 			/* Disallow access to the chunk header. */
@@ -2150,8 +2150,11 @@ make_new_segment(dsa_area *area, size_t requested_pages)
 			return NULL;
 	}
 
-	/* Create the segment. */
-	segment = dsm_create(total_size, 0);
+	/*
+	 * Create the segment.  Nobody attaches to it after the area is gone or
+	 * the segment is freed, so a kept one may be reused.
+	 */
+	segment = dsm_create(total_size, DSM_CREATE_CACHED);
 	if (segment == NULL)
 		return NULL;
 	dsm_pin_segment(segment);
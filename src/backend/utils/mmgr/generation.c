@@ -196,7 +196,7 @@ GenerationContextCreate(MemoryContext parent,
 	 * Allocate the initial block.  Unlike other generation.c blocks, it
 	 * starts with the context header and its block header follows that.
 	 */
-	set = (GenerationContext *) malloc(allocSize);
+	set = (GenerationContext *) MemoryContextMallocBlock(NULL, allocSize);
 	if (set == NULL)
 	{
 		MemoryContextStats(TopMemoryContext);
@@ -318,10 +318,13 @@ GenerationReset(MemoryContext context)
 void
 GenerationDelete(MemoryContext context)
 {
+	GenerationContext *set = (GenerationContext *) context;
+
 	/* Reset to release all releasable GenerationBlocks */
 	GenerationReset(context);
 	/* And free the context header and keeper block */
-	free(context);
+	MemoryContextFreeBlock(context,
+						   MAXALIGN(sizeof(GenerationContext)) + set->keeper->blksize);
 }
 
 /*
@@ -361,7 +364,7 @@ GenerationAlloc(MemoryContext context, Size size)
 	{
 		Size		blksize = required_size + Generation_BLOCKHDRSZ;
 
-		block = (GenerationBlock *) malloc(blksize);
+		block = (GenerationBlock *) MemoryContextMallocBlock(context, blksize);
 		if (block == NULL)
 			return NULL;
 
@@ -463,7 +466,7 @@ GenerationAlloc(MemoryContext context, Size size)
 			if (blksize < required_size)
 				blksize = pg_nextpower2_size_t(required_size);
 
-			block = (GenerationBlock *) malloc(blksize);
+			block = (GenerationBlock *) MemoryContextMallocBlock(context, blksize);
 
 			if (block == NULL)
 				return NULL;
@@ -593,6 +596,8 @@ GenerationBlockFreeBytes(GenerationBlock *block)
 static inline void
 GenerationBlockFree(GenerationContext *set, GenerationBlock *block)
 {
+	Size		blksize = block->blksize;
+
 	/* Make sure nobody tries to free the keeper block */
 	Assert(block != set->keeper);
 	/* We shouldn't be freeing the freeblock either */
@@ -601,13 +606,13 @@ GenerationBlockFree(GenerationContext *set, GenerationBlock *block)
 	/* release the block from the list of blocks */
 	dlist_delete(&block->node);
 
-	((MemoryContext) set)->mem_allocated -= block->blksize;
+	((MemoryContext) set)->mem_allocated -= blksize;
 
 #ifdef CLOBBER_FREED_MEMORY
-	wipe_mem(block, block->blksize);
+	wipe_mem(block, blksize);
 #endif
 
-	free(block);
+	MemoryContextFreeBlock(block, blksize);
 }
 
 /*
@@ -721,7 +726,7 @@ GenerationFree(void *pointer)
 	dlist_delete(&block->node);
 
 	set->header.mem_allocated -= block->blksize;
-	free(block);
+	MemoryContextFreeBlock(block, block->blksize);
 }
 
 /*
@@ -99,6 +99,20 @@ static const MemoryContextMethods mcxt_methods[] = { /// 这个是写死的，
 	[MCTX_ALIGNED_REDIRECT_ID].check = NULL,	/* not required */
 #endif
 
+	/* bump.c */
+	[MCTX_BUMP_ID].alloc = BumpAlloc,
+	[MCTX_BUMP_ID].free_p = BumpFree,
+	[MCTX_BUMP_ID].realloc = BumpRealloc,
+	[MCTX_BUMP_ID].reset = BumpReset,
+	[MCTX_BUMP_ID].delete_context = BumpDelete,
+	[MCTX_BUMP_ID].get_chunk_context = BumpGetChunkContext,
+	[MCTX_BUMP_ID].get_chunk_space = BumpGetChunkSpace,
+	[MCTX_BUMP_ID].is_empty = BumpIsEmpty,
+	[MCTX_BUMP_ID].stats = BumpStats,
+#ifdef MEMORY_CONTEXT_CHECKING
+	[MCTX_BUMP_ID].check = BumpCheck,
+#endif
+
 
 	/*
 	 * Unused (as yet) IDs should have dummy entries here.  This allows us to
@@ -126,8 +140,53 @@ static const MemoryContextMethods mcxt_methods[] = { /// 这个是写死的，
 	[MCTX_UNUSED4_ID].realloc = BogusRealloc,
 	[MCTX_UNUSED4_ID].get_chunk_context = BogusGetChunkContext,
 	[MCTX_UNUSED4_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED5_ID].free_p = BogusFree,
+	[MCTX_UNUSED5_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED5_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED5_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED6_ID].free_p = BogusFree,
+	[MCTX_UNUSED6_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED6_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED6_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED7_ID].free_p = BogusFree,
+	[MCTX_UNUSED7_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED7_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED7_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED8_ID].free_p = BogusFree,
+	[MCTX_UNUSED8_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED8_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED8_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED9_ID].free_p = BogusFree,
+	[MCTX_UNUSED9_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED9_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED9_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED10_ID].free_p = BogusFree,
+	[MCTX_UNUSED10_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED10_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED10_ID].get_chunk_space = BogusGetChunkSpace,
+
+	[MCTX_UNUSED11_ID].free_p = BogusFree,
+	[MCTX_UNUSED11_ID].realloc = BogusRealloc,
+	[MCTX_UNUSED11_ID].get_chunk_context = BogusGetChunkContext,
+	[MCTX_UNUSED11_ID].get_chunk_space = BogusGetChunkSpace,
 };
 
+/*
+ * Memory obtained from malloc() by memory contexts; see memutils_internal.h.
+ * MemoryAllocatedReserved and MemoryAllocatedReport are maintained by
+ * backend_memory.c.
+ */
+uint64		MemoryAllocatedBytes = 0;
+uint64		MemoryAllocatedAllowance = PG_UINT64_MAX;
+uint64		MemoryAllocatedReserved = 0;
+pg_atomic_uint64 *MemoryAllocatedReport = NULL;
+
 /*
  * CurrentMemoryContext
  *		Default memory context for allocations.
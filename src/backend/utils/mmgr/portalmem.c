@@ -1184,6 +1184,17 @@ ThereAreNoReadyPortals(void)
 	return true;
 }
 
+/*
+ * Are there any portals at all?  Outside a transaction, that means some
+ * holdable cursor is open.
+ */
+bool
+HavePortals(void)
+{
+	return PortalHashTable != NULL &&
+		hash_get_num_entries(PortalHashTable) > 0;
+}
+
 /*
  * Hold all pinned portals.
  *
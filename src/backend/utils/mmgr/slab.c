@@ -357,7 +357,8 @@ SlabContextCreate(MemoryContext parent,
 
 
 
-	slab = (SlabContext *) malloc(Slab_CONTEXT_HDRSZ(chunksPerBlock));
+	slab = (SlabContext *) MemoryContextMallocBlock(NULL,
+												   Slab_CONTEXT_HDRSZ(chunksPerBlock));
 	if (slab == NULL)
 	{
 		MemoryContextStats(TopMemoryContext);
@@ -447,7 +448,7 @@ SlabReset(MemoryContext context)
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, slab->blockSize);
 #endif
-		free(block);
+		MemoryContextFreeBlock(block, slab->blockSize);
 		context->mem_allocated -= slab->blockSize;
 	}
 
@@ -463,7 +464,7 @@ SlabReset(MemoryContext context)
 #ifdef CLOBBER_FREED_MEMORY
 			wipe_mem(block, slab->blockSize);
 #endif
-			free(block);
+			MemoryContextFreeBlock(block, slab->blockSize);
 			context->mem_allocated -= slab->blockSize;
 		}
 	}
@@ -480,10 +481,12 @@ SlabReset(MemoryContext context)
 void
 SlabDelete(MemoryContext context)
 {
+	SlabContext *slab PG_USED_FOR_ASSERTS_ONLY = (SlabContext *) context;
+
 	/* Reset to release all the SlabBlocks */
 	SlabReset(context);
 	/* And free the context header */
-	free(context);
+	MemoryContextFreeBlock(context, Slab_CONTEXT_HDRSZ(slab->chunksPerBlock));
 }
 
 /*
@@ -539,7 +542,8 @@ SlabAlloc(MemoryContext context, Size size)
 		}
 		else
 		{
-			block = (SlabBlock *) malloc(slab->blockSize);
+			block = (SlabBlock *) MemoryContextMallocBlock(context,
+														   slab->blockSize);
 
 			if (unlikely(block == NULL))
 				return NULL;
@@ -738,7 +742,7 @@ SlabFree(void *pointer)
 #ifdef CLOBBER_FREED_MEMORY
 			wipe_mem(block, slab->blockSize);
 #endif
-			free(block);
+			MemoryContextFreeBlock(block, slab->blockSize);
 			slab->header.mem_allocated -= slab->blockSize;
 		}
 
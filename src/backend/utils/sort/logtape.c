@@ -124,6 +124,13 @@ typedef struct TapeBlockTrailer
 #define TAPE_WRITE_PREALLOC_MIN 8
 #define TAPE_WRITE_PREALLOC_MAX 128
 
+/*
+ * When filling a tape's read buffer, read up to this many blocks that follow
+ * the next block of the tape in the file together with it, since they are
+ * likely to be the blocks after it on the tape.
+ */
+#define TAPE_READAHEAD_BLOCKS	32
+
 /*
  * This data structure represents a single "logical tape" within the set
  * of logical tapes stored in the same file.
@@ -222,6 +229,8 @@ struct LogicalTapeSet
 static LogicalTape *ltsCreateTape(LogicalTapeSet *lts);
 static void ltsWriteBlock(LogicalTapeSet *lts, long blocknum, const void *buffer);
 static void ltsReadBlock(LogicalTapeSet *lts, long blocknum, void *buffer);
+static int	ltsReadBlocks(LogicalTapeSet *lts, long blocknum, int nblocks,
+						  void *buffer);
 static long ltsGetBlock(LogicalTapeSet *lts, LogicalTape *lt);
 static long ltsGetFreeBlock(LogicalTapeSet *lts);
 static long ltsGetPreallocBlock(LogicalTapeSet *lts, LogicalTape *lt);
@@ -289,14 +298,45 @@ ltsReadBlock(LogicalTapeSet *lts, long blocknum, void *buffer)
 	BufFileReadExact(lts->pfile, buffer, BLCKSZ);
 }
 
+/*
+ * Read up to nblocks consecutive blocks, starting at blocknum, into buffer.
+ * The first block must exist; returns the number of blocks read.
+ */
+static int
+ltsReadBlocks(LogicalTapeSet *lts, long blocknum, int nblocks, void *buffer)
+{
+	size_t		nread;
+
+	if (BufFileSeekBlock(lts->pfile, blocknum) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek to block %ld of temporary file",
+						blocknum)));
+	nread = BufFileRead(lts->pfile, buffer, (size_t) nblocks * BLCKSZ);
+	if (nread < BLCKSZ)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from temporary file: read only %zu of %zu bytes",
+						nread, (size_t) BLCKSZ)));
+
+	return nread / BLCKSZ;
+}
+
 /*
  * Read as many blocks as we can into the per-tape buffer.
  *
+ * Rather than reading the blocks one at a time, we read the next block with
+ * the ones after it in the file that fit, and keep as many of those as turn
+ * out to be the next blocks of the tape too.  Each block's payload is moved
+ * up against the preceding one's, over its trailer.
+ *
  * Returns true if anything was read, 'false' on EOF.
  */
 static bool
 ltsReadFillBuffer(LogicalTape *lt)
 {
+	LogicalTapeSet *lts = lt->tapeSet;
+
 	lt->pos = 0;
 	lt->nbytes = 0;
 
@@ -304,6 +344,7 @@ ltsReadFillBuffer(LogicalTape *lt)
 	{
 		char	   *thisbuf = lt->buffer + lt->nbytes;
 		long		datablocknum = lt->nextBlockNumber;
+		int			nblocks;
 
 		/* Fetch next block number */
 		if (datablocknum == -1L)
@@ -311,21 +352,40 @@ ltsReadFillBuffer(LogicalTape *lt)
 		/* Apply worker offset, needed for leader tapesets */
 		datablocknum += lt->offsetBlockNumber;
 
-		/* Read the block */
-		ltsReadBlock(lt->tapeSet, datablocknum, thisbuf);
-		if (!lt->frozen)
-			ltsReleaseBlock(lt->tapeSet, datablocknum);
-		lt->curBlockNumber = lt->nextBlockNumber;
+		/* Read the block, and those after it that fit */
+		nblocks = Min((lt->buffer_size - lt->nbytes) / BLCKSZ,
+					  TAPE_READAHEAD_BLOCKS);
+		nblocks = Min(nblocks, lts->nBlocksWritten - datablocknum);
+		Assert(nblocks > 0);
+		nblocks = ltsReadBlocks(lts, datablocknum, nblocks, thisbuf);
 
-		lt->nbytes += TapeBlockGetNBytes(thisbuf);
-		if (TapeBlockIsLast(thisbuf))
+		for (int i = 0; i < nblocks; i++)
 		{
-			lt->nextBlockNumber = -1L;
-			/* EOF */
-			break;
+			char	   *blockbuf = thisbuf + (size_t) i * BLCKSZ;
+			long		next = TapeBlockGetTrailer(blockbuf)->next;
+			int			nbytes = TapeBlockGetNBytes(blockbuf);
+
+			/* Is this block the next one on the tape? */
+			if (i > 0 &&
+				lt->nextBlockNumber + lt->offsetBlockNumber != datablocknum + i)
+				break;
+
+			if (!lt->frozen)
+				ltsReleaseBlock(lts, datablocknum + i);
+			lt->curBlockNumber = lt->nextBlockNumber;
+
+			if (i > 0)
+				memmove(lt->buffer + lt->nbytes, blockbuf, nbytes);
+			lt->nbytes += nbytes;
+			if (next < 0)
+			{
+				lt->nextBlockNumber = -1L;
+				/* EOF */
+				break;
+			}
+			else
+				lt->nextBlockNumber = next;
 		}
-		else
-			lt->nextBlockNumber = TapeBlockGetTrailer(thisbuf)->next;
 
 		/* Advance to next block, if we have buffer space left */
 	} while (lt->buffer_size - lt->nbytes > BLCKSZ);
@@ -1173,6 +1233,38 @@ LogicalTapeTell(LogicalTape *lt, long *blocknum, int *offset)
 	*offset = lt->pos;
 }
 
+/*
+ * Seek to a position in a tape imported with LogicalTapeImport().
+ *
+ * blocknum/offset must have been returned by LogicalTapeTell() in the worker
+ * that wrote the tape, while it was writing it or after freezing it.  Unlike
+ * LogicalTapeSeek(), this works with a read buffer of any size: only the block
+ * sought is read here, and reading continues from the next block as usual.
+ * This lets several processes read different parts of a worker's tape, as
+ * the parallel final merge does.
+ */
+void
+LogicalTapeSeekImported(LogicalTape *lt, long blocknum, int offset)
+{
+	Assert(!lt->writing);
+	Assert(offset >= 0 && offset <= TapeBlockPayloadSize);
+
+	if (lt->buffer == NULL)
+		lt->buffer = palloc(lt->buffer_size);
+
+	ltsReadBlock(lt->tapeSet, blocknum + lt->offsetBlockNumber, lt->buffer);
+	lt->curBlockNumber = blocknum;
+	lt->nbytes = TapeBlockGetNBytes(lt->buffer);
+	if (TapeBlockIsLast(lt->buffer))
+		lt->nextBlockNumber = -1L;
+	else
+		lt->nextBlockNumber = TapeBlockGetTrailer(lt->buffer)->next;
+
+	if (offset > lt->nbytes)
+		elog(ERROR, "invalid tape seek position");
+	lt->pos = offset;
+}
+
 /*
  * Obtain total disk space currently used by a LogicalTapeSet, in blocks.
  *
@@ -62,6 +62,7 @@ struct SharedTuplestore
 	int			nparticipants;	/* Number of participants that can write. */
 	int			flags;			/* Flag bits from SHARED_TUPLESTORE_XXX */
 	size_t		meta_data_size; /* Size of per-tuple header. */
+	int			compression;	/* temp_file_compression of the creator. */
 	char		name[NAMEDATALEN];	/* A name for this tuplestore. */
 
 	/* Followed by per-participant shared state. */
@@ -139,6 +140,7 @@ sts_initialize(SharedTuplestore *sts, int participants,
 	sts->nparticipants = participants;
 	sts->meta_data_size = meta_data_size;
 	sts->flags = flags;
+	sts->compression = temp_file_compression;
 
 	if (strlen(name) > sizeof(sts->name) - 1)
 		elog(ERROR, "SharedTuplestore name too long");
@@ -315,7 +317,8 @@ sts_puttuple(SharedTuplestoreAccessor *accessor, void *meta_data,
 
 		oldcxt = MemoryContextSwitchTo(accessor->context);
 		accessor->write_file =
-			BufFileCreateFileSet(&accessor->fileset->fs, name);
+			BufFileCreateCompressedFileSet(&accessor->fileset->fs, name,
+										   accessor->sts->compression);
 		MemoryContextSwitchTo(oldcxt);
 
 		/* Set up the shared state for this backend's file. */
@@ -537,8 +540,8 @@ sts_parallel_scan_next(SharedTuplestoreAccessor *accessor, void *meta_data)
 
 				oldcxt = MemoryContextSwitchTo(accessor->context);
 				accessor->read_file =
-					BufFileOpenFileSet(&accessor->fileset->fs, name, O_RDONLY,
-									   false);
+					BufFileOpenCompressedFileSet(&accessor->fileset->fs, name,
+												 accessor->sts->compression);
 				MemoryContextSwitchTo(oldcxt);
 			}
 
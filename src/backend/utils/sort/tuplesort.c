@@ -87,6 +87,15 @@
  * worker process.  This is then merged.  Worker processes are guaranteed to
  * produce exactly one output run from their partial input.
  *
+ * With parallel_sort_merge, the final merge of a large parallel sort is done
+ * by the workers too.  While writing its output run, each worker remembers
+ * the tape position of every so many tuples.  The leader reads those sample
+ * tuples back, and picks splitters among them that divide the key space into
+ * ranges of about equal size.  Workers then claim ranges one at a time, seek
+ * into every run to the start of the range, and merge the range into a tape
+ * of its own.  The leader returns the ranges' tuples in order, so it only has
+ * to wait for the first range before the caller can start consuming output.
+ *
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -106,11 +115,13 @@
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "pg_trace.h"
+#include "storage/condition_variable.h"
 #include "storage/shmem.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/rel.h"
 #include "utils/tuplesort.h"
+#include "utils/wait_event.h"
 
 /*
  * Initial size of memtuples array.  We're trying to select this size so that
@@ -131,6 +142,8 @@ bool		trace_sort = false;
 bool		optimize_bounded_sort = true;
 #endif
 
+bool		parallel_sort_merge = true;
+
 
 /*
  * During merge, we use a pre-allocated set of fixed-size slots to hold
@@ -162,7 +175,8 @@ typedef enum
 	TSS_BUILDRUNS,				/* Loading tuples; writing to tape */
 	TSS_SORTEDINMEM,			/* Sort completed entirely in memory */
 	TSS_SORTEDONTAPE,			/* Sort completed, final run is on tape */
-	TSS_FINALMERGE				/* Performing final merge on-the-fly */
+	TSS_FINALMERGE,				/* Performing final merge on-the-fly */
+	TSS_SORTEDINRANGES			/* Workers merge ranges, leader reads them */
 } TupSortStatus;
 
 /*
@@ -196,6 +210,9 @@ struct Tuplesortstate
 	int			bound;			/* if bounded, the maximum number of tuples */
 	int64		availMem;		/* remaining memory available, in bytes */
 	int64		allowedMem;		/* total memory allowed, in bytes */
+	int64		tupleMem;		/* memory consumed by tuples in tuplecontext,
+								 * counted separately so that dumptuples can
+								 * release it all at once */
 	int			maxTapes;		/* max number of input tapes to merge in each
 								 * pass */
 	int64		maxSpace;		/* maximum amount of space occupied among sort
@@ -320,6 +337,15 @@ struct Tuplesortstate
 	Sharedsort *shared;
 	int			nParticipants;
 
+	/*
+	 * Parallel final merge.  In a worker, sampleRun is set while writing the
+	 * output run, whose positions are sampled into runSamples.  In the
+	 * leader, curRange is the next merged range to read.
+	 */
+	bool		sampleRun;
+	struct SortRunSamples *runSamples;
+	int			curRange;
+
 	/*
 	 * Additional state for managing "abbreviated key" sortsupport routines
 	 * (which currently may be used by all cases except the hash index case).
@@ -337,6 +363,60 @@ struct Tuplesortstate
 #endif
 };
 
+/*
+ * Parallel final merge (see parallel_sort_merge).
+ *
+ * A worker samples at most TS_RUN_SAMPLES positions of its output run; the
+ * interval between samples doubles whenever the array fills up.  The leader
+ * only lets workers merge when there are at least
+ * TS_MIN_RANGE_MERGE_PARTICIPANTS runs (so that at least two worker
+ * processes are around to do it) and TS_MIN_RANGE_MERGE_TUPLES tuples.
+ */
+#define TS_RUN_SAMPLES						128
+#define TS_INITIAL_SAMPLE_INTERVAL			64
+#define TS_MIN_RANGE_MERGE_PARTICIPANTS		3
+#define TS_MIN_RANGE_MERGE_TUPLES			100000
+
+/* position of a tuple in a worker's run, from LogicalTapeTell() */
+typedef struct SortTapePos
+{
+	long		blocknum;
+	int			offset;
+	int64		ordinal;		/* tuple's number within the run */
+} SortTapePos;
+
+/* sampled positions of one worker's run */
+typedef struct SortRunSamples
+{
+	int64		ntuples;		/* tuples in run */
+	int64		interval;		/* tuples between samples */
+	int			nsamples;
+	SortTapePos pos[TS_RUN_SAMPLES];
+} SortRunSamples;
+
+/* lower bound of a merge range: a sampled tuple of some run */
+typedef struct SortSplitter
+{
+	int			tape;			/* run the tuple belongs to */
+	SortTapePos pos;
+} SortSplitter;
+
+/* a merge range's output tape */
+typedef struct SortRangeShare
+{
+	TapeShare	tape;
+	bool		done;			/* merged, and tape is frozen? */
+} SortRangeShare;
+
+/* a sample tuple read back by the leader, while choosing splitters */
+typedef struct SortSample
+{
+	SortTuple	stup;
+	int			tape;
+	SortTapePos pos;
+	int64		weight;			/* tuples the sample stands for */
+} SortSample;
+
 /*
  * Private mutable state of tuplesort-parallel-operation.  This is allocated
  * in shared memory.
@@ -357,6 +437,22 @@ struct Sharedsort
 	int			currentWorker;
 	int			workersFinished;
 
+	/*
+	 * Parallel final merge.  rangeMerge is fixed when the shared state is
+	 * initialized; if set, workers wait after their sort until the leader has
+	 * published its merge plan by setting planReady.  nRanges is then the
+	 * number of ranges the workers are to merge, or 0 if the leader merges
+	 * the runs itself; nInputs is the number of runs.  Workers claim ranges
+	 * with nextRange.  mergecv is signaled when the plan is ready and when a
+	 * range is done.
+	 */
+	bool		rangeMerge;
+	bool		planReady;
+	int			nRanges;
+	int			nInputs;
+	int			nextRange;
+	ConditionVariable mergecv;
+
 	/* Temporary file space */
 	SharedFileSet fileset;
 
@@ -368,8 +464,23 @@ struct Sharedsort
 	 * leader to concatenate all worker tapes into one for merging
 	 */
 	TapeShare	tapes[FLEXIBLE_ARRAY_MEMBER];
+
+	/*
+	 * The tapes array is followed by three more arrays of nTapes elements,
+	 * for the parallel final merge: the SortRunSamples of each run, the
+	 * splitters (nRanges - 1 are used) and the SortRangeShare of each range.
+	 */
 };
 
+#define SharedSortRunSamples(shared) \
+	((SortRunSamples *) ((char *) (shared) + \
+						 MAXALIGN(offsetof(Sharedsort, tapes) + \
+								  sizeof(TapeShare) * (shared)->nTapes)))
+#define SharedSortSplitters(shared) \
+	((SortSplitter *) (SharedSortRunSamples(shared) + (shared)->nTapes))
+#define SharedSortRanges(shared) \
+	((SortRangeShare *) (SharedSortSplitters(shared) + (shared)->nTapes))
+
 /*
  * Is the given tuple allocated from the slab memory arena?
  */
@@ -476,6 +587,23 @@ static int	worker_get_identifier(Tuplesortstate *state);
 static void worker_freeze_result_tape(Tuplesortstate *state);
 static void worker_nomergeruns(Tuplesortstate *state);
 static void leader_takeover_tapes(Tuplesortstate *state);
+static void worker_sample_run(Tuplesortstate *state);
+static bool leader_range_merge(Tuplesortstate *state);
+static void worker_sample_init(Tuplesortstate *state);
+static int	leader_choose_splitters(Tuplesortstate *state, int nRanges);
+static int	splitter_sample_cmp(const void *a, const void *b, void *arg);
+static bool leader_next_range(Tuplesortstate *state);
+static void worker_merge_range(Tuplesortstate *state, int range,
+							   LogicalTape **inputs, int64 *ordinals);
+static bool worker_range_start(Tuplesortstate *state, LogicalTape *tape,
+							   int tapenum, SortSplitter *lo, SortTuple *lotup,
+							   SortTuple *stup, int64 *ordinal);
+static bool range_tuple_beyond(Tuplesortstate *state, SortTuple *stup,
+							   int tapenum, int64 ordinal,
+							   SortSplitter *splitter, SortTuple *sptup);
+static void read_tuple_at(Tuplesortstate *state, LogicalTape *tape,
+						  SortTapePos *pos, SortTuple *stup);
+static void forget_abbreviation(Tuplesortstate *state);
 static void free_sort_tuple(Tuplesortstate *state, SortTuple *stup);
 static void tuplesort_free(Tuplesortstate *state);
 static void tuplesort_updatemax(Tuplesortstate *state);
@@ -623,6 +751,195 @@ qsort_tuple_int32_compare(SortTuple *a, SortTuple *b, Tuplesortstate *state)
 #define ST_DEFINE
 #include "lib/sort_template.h"
 
+/*
+ * Radix sort of SortTuples on a pass-by-value leading datum.
+ *
+ * When the leading datum1 is compared with one of the specialized
+ * comparators above, its order is the order of an unsigned integer derived
+ * from it by flipping the sign bit (for signed comparators) and all bits
+ * (for DESC).  That lets us sort large arrays with an in-place MSD radix
+ * sort ("American flag sort") on one byte of that key at a time, which
+ * avoids most comparator calls.  Buckets that get small are finished with
+ * the specialized quicksort, and groups of tuples whose datum1 are
+ * entirely equal -- the ties of an abbreviated key, or of a multi-key sort
+ * -- are sorted with the full comparator, unless datum1 is the only key.
+ */
+#define RADIX_SORT_MIN_TUPLES	2048	/* use quicksort for smaller arrays */
+#define RADIX_SORT_QSORT_THRESHOLD	64	/* ... and for smaller buckets */
+
+typedef void (*SortTupleSortFunc) (SortTuple *data, size_t n,
+								   Tuplesortstate *state);
+
+typedef struct RadixSortState
+{
+	uint64		keymask;		/* bits of datum1 that make up the key */
+	uint64		keyxor;			/* bits to flip to get an unsigned order */
+	int			keybytes;		/* key width in bytes */
+	SortTupleSortFunc qsort_func;	/* specialized quicksort for datum1 */
+	Tuplesortstate *state;
+} RadixSortState;
+
+static inline int
+radix_sort_digit(const SortTuple *tup, int byte, const RadixSortState *rs)
+{
+	uint64		key = ((uint64) tup->datum1 & rs->keymask) ^ rs->keyxor;
+
+	return (int) ((key >> (byte * BITS_PER_BYTE)) & 0xFF);
+}
+
+static void
+radix_sort_tuple(SortTuple *data, size_t n, int byte, RadixSortState *rs)
+{
+	size_t		counts[256];
+	size_t		offsets[256];
+	size_t		ends[256];
+	size_t		start;
+	size_t		i;
+	int			b;
+
+	if (n < RADIX_SORT_QSORT_THRESHOLD)
+	{
+		rs->qsort_func(data, n, rs->state);
+		return;
+	}
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* find the next byte on which the keys in this range differ */
+	for (;;)
+	{
+		if (byte < 0)
+		{
+			/* all of datum1 is equal; resolve the ties, if there can be any */
+			if (rs->state->base.onlyKey == NULL)
+				qsort_tuple(data, n, rs->state->base.comparetup, rs->state);
+			return;
+		}
+
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < n; i++)
+			counts[radix_sort_digit(&data[i], byte, rs)]++;
+
+		if (counts[radix_sort_digit(&data[0], byte, rs)] != n)
+			break;
+		byte--;
+	}
+
+	start = 0;
+	for (b = 0; b < 256; b++)
+	{
+		offsets[b] = start;
+		start += counts[b];
+		ends[b] = start;
+	}
+
+	/* permute the tuples into their buckets, one cycle at a time */
+	for (b = 0; b < 256; b++)
+	{
+		while (offsets[b] < ends[b])
+		{
+			SortTuple	tmp = data[offsets[b]];
+			int			d = radix_sort_digit(&tmp, byte, rs);
+
+			while (d != b)
+			{
+				SortTuple	next = data[offsets[d]];
+
+				data[offsets[d]++] = tmp;
+				tmp = next;
+				d = radix_sort_digit(&tmp, byte, rs);
+			}
+			data[offsets[b]++] = tmp;
+		}
+	}
+
+	/* sort each bucket on the remaining bytes */
+	start = 0;
+	for (b = 0; b < 256; b++)
+	{
+		if (counts[b] > 1)
+			radix_sort_tuple(data + start, counts[b], byte - 1, rs);
+		start += counts[b];
+	}
+}
+
+/*
+ * Sort memtuples by radix on datum1, whose comparator is one of the
+ * specialized ones; qsort_func is the matching specialized quicksort.
+ */
+static void
+tuplesort_radix_sort(Tuplesortstate *state, SortTupleSortFunc qsort_func)
+{
+	SortSupport ssup = &state->base.sortKeys[0];
+	SortTuple  *memtuples = state->memtuples;
+	size_t		n = state->memtupcount;
+	size_t		nnulls = 0;
+	size_t		i;
+	RadixSortState rs;
+
+	if (ssup->comparator == ssup_datum_int32_cmp)
+	{
+		rs.keybytes = sizeof(int32);
+		rs.keymask = PG_UINT32_MAX;
+		rs.keyxor = UINT64CONST(1) << 31;
+	}
+#if SIZEOF_DATUM >= 8
+	else if (ssup->comparator == ssup_datum_signed_cmp)
+	{
+		rs.keybytes = sizeof(int64);
+		rs.keymask = PG_UINT64_MAX;
+		rs.keyxor = UINT64CONST(1) << 63;
+	}
+#endif
+	else
+	{
+		Assert(ssup->comparator == ssup_datum_unsigned_cmp);
+		rs.keybytes = SIZEOF_DATUM;
+		rs.keymask = SIZEOF_DATUM >= 8 ? PG_UINT64_MAX : PG_UINT32_MAX;
+		rs.keyxor = 0;
+	}
+	if (ssup->ssup_reverse)
+		rs.keyxor ^= rs.keymask;
+	rs.qsort_func = qsort_func;
+	rs.state = state;
+
+	/* move the NULLs to the end, in whatever order */
+	for (i = 0; i < n - nnulls;)
+	{
+		if (memtuples[i].isnull1)
+		{
+			SortTuple	tmp = memtuples[i];
+
+			nnulls++;
+			memtuples[i] = memtuples[n - nnulls];
+			memtuples[n - nnulls] = tmp;
+		}
+		else
+			i++;
+	}
+
+	/* ... or to the front, if they sort first */
+	if (nnulls > 0 && ssup->ssup_nulls_first)
+	{
+		for (i = 0; i < Min(nnulls, n - nnulls); i++)
+		{
+			SortTuple	tmp = memtuples[i];
+
+			memtuples[i] = memtuples[n - 1 - i];
+			memtuples[n - 1 - i] = tmp;
+		}
+		radix_sort_tuple(memtuples + nnulls, n - nnulls, rs.keybytes - 1, &rs);
+		if (nnulls > 1)
+			qsort_func(memtuples, nnulls, state);
+	}
+	else
+	{
+		radix_sort_tuple(memtuples, n - nnulls, rs.keybytes - 1, &rs);
+		if (nnulls > 1)
+			qsort_func(memtuples + n - nnulls, nnulls, state);
+	}
+}
+
 /*
  *		tuplesort_begin_xxx
  *
@@ -770,18 +1087,19 @@ tuplesort_begin_batch(Tuplesortstate *state)
 	 * in the parent context, not this context, because there is no need to
 	 * free memtuples early.  For bounded sorts, tuples may be pfreed in any
 	 * order, so we use a regular aset.c context so that it can make use of
-	 * free'd memory.  When the sort is not bounded, we make use of a
-	 * generation.c context as this keeps allocations more compact with less
-	 * wastage.  Allocations are also slightly more CPU efficient.
+	 * free'd memory.  When the sort is not bounded, tuples are only ever
+	 * released by resetting the context, so we use a bump.c context: it has
+	 * no chunk headers, which keeps allocations as compact as possible and
+	 * makes them cheaper too.
 	 */
-	if (state->base.sortopt & TUPLESORT_ALLOWBOUNDED)
+	if (!TupleSortUseBumpTupleCxt(state->base.sortopt))
 		state->base.tuplecontext = AllocSetContextCreate(state->base.sortcontext,
 														 "Caller tuples",
 														 ALLOCSET_DEFAULT_SIZES);
 	else
-		state->base.tuplecontext = GenerationContextCreate(state->base.sortcontext,
-														   "Caller tuples",
-														   ALLOCSET_DEFAULT_SIZES);
+		state->base.tuplecontext = BumpContextCreate(state->base.sortcontext,
+													 "Caller tuples",
+													 ALLOCSET_DEFAULT_SIZES);
 
 
 	state->status = TSS_INITIAL;
@@ -789,6 +1107,7 @@ tuplesort_begin_batch(Tuplesortstate *state)
 	state->boundUsed = false;
 
 	state->availMem = state->allowedMem;
+	state->tupleMem = 0;
 
 	state->tapeset = NULL;
 
@@ -1187,15 +1506,16 @@ noalloc:
  * Shared code for tuple and datum cases.
  */
 void
-tuplesort_puttuple_common(Tuplesortstate *state, SortTuple *tuple, bool useAbbrev)
+tuplesort_puttuple_common(Tuplesortstate *state, SortTuple *tuple,
+						  bool useAbbrev, Size tuplen)
 {
 	MemoryContext oldcontext = MemoryContextSwitchTo(state->base.sortcontext);
 
 	Assert(!LEADER(state));
 
 	/* Count the size of the out-of-line data */
-	if (tuple->tuple != NULL)
-		USEMEM(state, GetMemoryChunkSpace(tuple->tuple));
+	USEMEM(state, tuplen);
+	state->tupleMem += tuplen;
 
 	if (!useAbbrev)
 	{
@@ -1413,6 +1733,8 @@ tuplesort_performsort(Tuplesortstate *state)
 				 * merge is required to produce single output run, though.
 				 */
 				inittapes(state, false);
+				if (state->shared->rangeMerge)
+					worker_sample_init(state);
 				dumptuples(state, true);
 				worker_nomergeruns(state);
 				state->status = TSS_SORTEDONTAPE;
@@ -1420,11 +1742,14 @@ tuplesort_performsort(Tuplesortstate *state)
 			else
 			{
 				/*
-				 * Leader will take over worker tapes and merge worker runs.
-				 * Note that mergeruns sets the correct state->status.
+				 * Leader will take over worker tapes and merge worker runs,
+				 * unless the workers are to merge them by key range.  Note
+				 * that mergeruns and leader_range_merge set the correct
+				 * state->status.
 				 */
 				leader_takeover_tapes(state);
-				mergeruns(state);
+				if (!leader_range_merge(state))
+					mergeruns(state);
 			}
 			state->current = 0;
 			state->eof_reached = false;
@@ -1662,6 +1987,46 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 
 			return true;
 
+		case TSS_SORTEDINRANGES:
+			Assert(forward);
+			Assert(state->slabAllocatorUsed);
+
+			/*
+			 * The slot that held the tuple that we returned in previous
+			 * gettuple call can now be reused.
+			 */
+			if (state->lastReturnedTuple)
+			{
+				RELEASE_SLAB_SLOT(state, state->lastReturnedTuple);
+				state->lastReturnedTuple = NULL;
+			}
+
+			/*
+			 * Return the tuples of each range in turn, waiting for a range's
+			 * worker to finish merging it if need be.
+			 */
+			while (!state->eof_reached)
+			{
+				if (state->result_tape == NULL && !leader_next_range(state))
+				{
+					state->eof_reached = true;
+					break;
+				}
+
+				if ((tuplen = getlen(state->result_tape, true)) != 0)
+				{
+					READTUP(state, stup, state->result_tape, tuplen);
+					state->lastReturnedTuple = stup->tuple;
+					return true;
+				}
+
+				/* End of this range, release its tape */
+				LogicalTapeClose(state->result_tape);
+				state->result_tape = NULL;
+				state->curRange++;
+			}
+			return false;
+
 		case TSS_FINALMERGE:
 			Assert(forward);
 			/* We are managing memory ourselves, with the slab allocator. */
@@ -1726,6 +2091,25 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 	}
 }
 
+/*
+ * Look at the n'th tuple (counting from 1) of a sort completed in memory,
+ * without changing the read position.  Returns false if the result is not
+ * in memory, or has fewer than n tuples.  As with tuplesort_gettuple_common,
+ * the tuple belongs to the tuplesort.
+ */
+bool
+tuplesort_peek_common(Tuplesortstate *state, int64 n, SortTuple *stup)
+{
+	Assert(n > 0);
+	Assert(!WORKER(state));
+
+	if (state->status != TSS_SORTEDINMEM || n > state->memtupcount)
+		return false;
+
+	*stup = state->memtuples[n - 1];
+	return true;
+}
+
 
 /*
  * Advance over N tuples in either forward or back direction,
@@ -1767,6 +2151,7 @@ tuplesort_skiptuples(Tuplesortstate *state, int64 ntuples, bool forward)
 			return false;
 
 		case TSS_SORTEDONTAPE:
+		case TSS_SORTEDINRANGES:
 		case TSS_FINALMERGE:
 
 			/*
@@ -2036,27 +2421,16 @@ init_slab_allocator(Tuplesortstate *state, int numSlots)
 }
 
 /*
- * mergeruns -- merge all the completed initial runs.
+ * forget_abbreviation - stop using abbreviated keys
  *
- * This implements the Balanced k-Way Merge Algorithm.  All input data has
- * already been written to initial runs on tape (see dumptuples).
+ * Tuples read back from tape don't have their abbreviated keys, so this must
+ * be called before comparing any of them.
  */
 static void
-mergeruns(Tuplesortstate *state)
+forget_abbreviation(Tuplesortstate *state)
 {
-	int			tapenum;
-
-	Assert(state->status == TSS_BUILDRUNS);
-	Assert(state->memtupcount == 0);
-
 	if (state->base.sortKeys != NULL && state->base.sortKeys->abbrev_converter != NULL)
 	{
-		/*
-		 * If there are multiple runs to be merged, when we go to read back
-		 * tuples from disk, abbreviated keys will not have been stored, and
-		 * we don't care to regenerate them.  Disable abbreviation from this
-		 * point on.
-		 */
 		state->base.sortKeys->abbrev_converter = NULL;
 		state->base.sortKeys->comparator = state->base.sortKeys->abbrev_full_comparator;
 
@@ -2064,6 +2438,28 @@ mergeruns(Tuplesortstate *state)
 		state->base.sortKeys->abbrev_abort = NULL;
 		state->base.sortKeys->abbrev_full_comparator = NULL;
 	}
+}
+
+/*
+ * mergeruns -- merge all the completed initial runs.
+ *
+ * This implements the Balanced k-Way Merge Algorithm.  All input data has
+ * already been written to initial runs on tape (see dumptuples).
+ */
+static void
+mergeruns(Tuplesortstate *state)
+{
+	int			tapenum;
+
+	Assert(state->status == TSS_BUILDRUNS);
+	Assert(state->memtupcount == 0);
+
+	/*
+	 * If there are multiple runs to be merged, when we go to read back tuples
+	 * from disk, abbreviated keys will not have been stored, and we don't
+	 * care to regenerate them.  Disable abbreviation from this point on.
+	 */
+	forget_abbreviation(state);
 
 	/*
 	 * Reset tuple memory.  We've freed all the tuples that we previously
@@ -2177,6 +2573,15 @@ mergeruns(Tuplesortstate *state)
 			for (tapenum = 0; tapenum < state->nInputTapes; tapenum++)
 				LogicalTapeRewindForRead(state->inputTapes[tapenum], input_buffer_size);
 
+			/*
+			 * In a worker, this pass produces the output run if there is at
+			 * most one run on each input tape.  Sample it for the leader, if
+			 * the final merge may be done by key range.
+			 */
+			if (WORKER(state) && state->shared->rangeMerge &&
+				state->nInputRuns <= state->nInputTapes)
+				worker_sample_init(state);
+
 			/*
 			 * If there's just one run left on each input tape, then only one
 			 * merge pass remains.  If we don't have to produce a materialized
@@ -2254,6 +2659,8 @@ mergeonerun(Tuplesortstate *state)
 		/* write the tuple to destTape */
 		srcTapeIndex = state->memtuples[0].srctape;
 		srcTape = state->inputTapes[srcTapeIndex];
+		if (state->sampleRun)
+			worker_sample_run(state);
 		WRITETUP(state, state->destTape, &state->memtuples[0]);
 
 		/* recycle the slot of the tuple we just wrote out, for the next read */
@@ -2402,14 +2809,9 @@ dumptuples(Tuplesortstate *state, bool alltuples)
 	{
 		SortTuple  *stup = &state->memtuples[i];
 
+		if (state->sampleRun)
+			worker_sample_run(state);
 		WRITETUP(state, state->destTape, stup);
-
-		/*
-		 * Account for freeing the tuple, but no need to do the actual pfree
-		 * since the tuplecontext is being reset after the loop.
-		 */
-		if (stup->tuple != NULL)
-			FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
 	}
 
 	state->memtupcount = 0;
@@ -2423,6 +2825,13 @@ dumptuples(Tuplesortstate *state, bool alltuples)
 	 */
 	MemoryContextReset(state->base.tuplecontext);
 
+	/*
+	 * Now account for freeing the tuples.  No need to do the actual pfrees,
+	 * the reset above took care of that.
+	 */
+	FREEMEM(state, state->tupleMem);
+	state->tupleMem = 0;
+
 	markrunend(state->destTape);
 
 #ifdef TRACE_SORT
@@ -2565,6 +2974,7 @@ tuplesort_get_stats(Tuplesortstate *state,
 		case TSS_SORTEDONTAPE:
 			stats->sortMethod = SORT_TYPE_EXTERNAL_SORT;
 			break;
+		case TSS_SORTEDINRANGES:
 		case TSS_FINALMERGE:
 			stats->sortMethod = SORT_TYPE_EXTERNAL_MERGE;
 			break;
@@ -2709,6 +3119,8 @@ sort_bounded_heap(Tuplesortstate *state)
  * Sort all memtuples using specialized qsort() routines.
  *
  * Quicksort is used for small in-memory sorts, and external sort runs.
+ * Larger arrays whose leading datum has a specialized comparator are radix
+ * sorted instead, see tuplesort_radix_sort().
  */
 static void
 tuplesort_sort_memtuples(Tuplesortstate *state)
@@ -2723,6 +3135,24 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 		 */
 		if (state->base.haveDatum1 && state->base.sortKeys)
 		{
+			SortTupleSortFunc qsort_func = NULL;
+
+			if (state->base.sortKeys[0].comparator == ssup_datum_unsigned_cmp)
+				qsort_func = qsort_tuple_unsigned;
+#if SIZEOF_DATUM >= 8
+			else if (state->base.sortKeys[0].comparator == ssup_datum_signed_cmp)
+				qsort_func = qsort_tuple_signed;
+#endif
+			else if (state->base.sortKeys[0].comparator == ssup_datum_int32_cmp)
+				qsort_func = qsort_tuple_int32;
+
+			if (qsort_func != NULL &&
+				state->memtupcount >= RADIX_SORT_MIN_TUPLES)
+			{
+				tuplesort_radix_sort(state, qsort_func);
+				return;
+			}
+
 			if (state->base.sortKeys[0].comparator == ssup_datum_unsigned_cmp)
 			{
 				qsort_tuple_unsigned(state->memtuples,
@@ -2962,6 +3392,12 @@ tuplesort_estimate_shared(int nWorkers)
 	tapesSize = mul_size(sizeof(TapeShare), nWorkers);
 	tapesSize = MAXALIGN(add_size(tapesSize, offsetof(Sharedsort, tapes)));
 
+	/* Add the arrays used by the parallel final merge */
+	tapesSize = add_size(tapesSize,
+						 mul_size(sizeof(SortRunSamples) +
+								  sizeof(SortSplitter) +
+								  sizeof(SortRangeShare), nWorkers));
+
 	return tapesSize;
 }
 
@@ -2982,11 +3418,19 @@ tuplesort_initialize_shared(Sharedsort *shared, int nWorkers, dsm_segment *seg)
 	SpinLockInit(&shared->mutex);
 	shared->currentWorker = 0;
 	shared->workersFinished = 0;
+	shared->rangeMerge = parallel_sort_merge;
+	shared->planReady = false;
+	shared->nRanges = 0;
+	shared->nInputs = 0;
+	shared->nextRange = 0;
+	ConditionVariableInit(&shared->mergecv);
 	SharedFileSetInit(&shared->fileset, seg);
 	shared->nTapes = nWorkers;
 	for (i = 0; i < nWorkers; i++)
 	{
 		shared->tapes[i].firstblocknumber = 0L;
+		memset(&SharedSortRunSamples(shared)[i], 0, sizeof(SortRunSamples));
+		SharedSortRanges(shared)[i].done = false;
 	}
 }
 
@@ -3068,6 +3512,13 @@ worker_freeze_result_tape(Tuplesortstate *state)
 	 */
 	LogicalTapeFreeze(state->result_tape, &output);
 
+	/* Publish the run's samples, if we took any */
+	if (state->sampleRun)
+	{
+		SharedSortRunSamples(shared)[state->worker] = *state->runSamples;
+		state->sampleRun = false;
+	}
+
 	/* Store properties of output tape, and update finished worker count */
 	SpinLockAcquire(&shared->mutex);
 	shared->tapes[state->worker] = output;
@@ -3159,6 +3610,614 @@ leader_takeover_tapes(Tuplesortstate *state)
 	state->status = TSS_BUILDRUNS;
 }
 
+/*
+ * worker_sample_init - start sampling worker's output run
+ *
+ * Called just before a worker starts writing the run that becomes its result
+ * tape.
+ */
+static void
+worker_sample_init(Tuplesortstate *state)
+{
+	Assert(WORKER(state));
+
+	if (state->runSamples == NULL)
+		state->runSamples = (SortRunSamples *)
+			MemoryContextAlloc(state->base.maincontext, sizeof(SortRunSamples));
+	memset(state->runSamples, 0, sizeof(SortRunSamples));
+	state->runSamples->interval = TS_INITIAL_SAMPLE_INTERVAL;
+	state->sampleRun = true;
+}
+
+/*
+ * worker_sample_run - remember position of the tuple about to be written
+ *
+ * Called before each tuple of the output run is written.  Every interval'th
+ * tuple's position is recorded.  When the array fills up, every other sample
+ * is discarded and the interval is doubled, so the samples always evenly
+ * cover the run written so far.
+ */
+static void
+worker_sample_run(Tuplesortstate *state)
+{
+	SortRunSamples *samples = state->runSamples;
+	int64		ordinal = samples->ntuples++;
+	SortTapePos *pos;
+	int			i;
+
+	if (ordinal == 0 || ordinal % samples->interval != 0)
+		return;
+
+	if (samples->nsamples == TS_RUN_SAMPLES)
+	{
+		for (i = 1; i < TS_RUN_SAMPLES; i += 2)
+			samples->pos[i / 2] = samples->pos[i];
+		samples->nsamples = TS_RUN_SAMPLES / 2;
+		samples->interval *= 2;
+
+		if (ordinal % samples->interval != 0)
+			return;
+	}
+
+	pos = &samples->pos[samples->nsamples++];
+	LogicalTapeTell(state->destTape, &pos->blocknum, &pos->offset);
+	pos->ordinal = ordinal;
+}
+
+/*
+ * read_tuple_at - read the tuple at a sampled position of a run
+ */
+static void
+read_tuple_at(Tuplesortstate *state, LogicalTape *tape, SortTapePos *pos,
+			  SortTuple *stup)
+{
+	unsigned int tuplen;
+
+	LogicalTapeSeekImported(tape, pos->blocknum, pos->offset);
+	tuplen = getlen(tape, false);
+	READTUP(state, stup, tape, tuplen);
+}
+
+/*
+ * splitter_sample_cmp - qsort_arg comparator for SortSamples
+ *
+ * Samples are ordered by their tuples, then by run, then by position in the
+ * run.  Ties between runs must be broken consistently here and in
+ * range_tuple_beyond(), so that every tuple ends up in exactly one range.
+ * Samples from the same run are compared by position alone, which agrees
+ * with the tuple order and never compares a tuple with itself.
+ */
+static int
+splitter_sample_cmp(const void *a, const void *b, void *arg)
+{
+	const SortSample *sa = (const SortSample *) a;
+	const SortSample *sb = (const SortSample *) b;
+	Tuplesortstate *state = (Tuplesortstate *) arg;
+	int			compare;
+
+	if (sa->tape == sb->tape)
+	{
+		if (sa->pos.ordinal == sb->pos.ordinal)
+			return 0;
+		return (sa->pos.ordinal < sb->pos.ordinal) ? -1 : 1;
+	}
+
+	compare = COMPARETUP(state, &sa->stup, &sb->stup);
+	if (compare != 0)
+		return compare;
+	return (sa->tape < sb->tape) ? -1 : 1;
+}
+
+/*
+ * range_tuple_beyond - is a tuple at or beyond a splitter?
+ *
+ * stup is the ordinal'th tuple of run tapenum; sptup is the splitter's tuple.
+ * This uses the same order as splitter_sample_cmp().
+ */
+static bool
+range_tuple_beyond(Tuplesortstate *state, SortTuple *stup, int tapenum,
+				   int64 ordinal, SortSplitter *splitter, SortTuple *sptup)
+{
+	int			compare;
+
+	if (tapenum == splitter->tape)
+		return ordinal >= splitter->pos.ordinal;
+
+	compare = COMPARETUP(state, stup, sptup);
+	if (compare != 0)
+		return compare > 0;
+	return tapenum > splitter->tape;
+}
+
+/*
+ * leader_range_merge - let workers do the final merge, if worthwhile
+ *
+ * Called by the leader instead of mergeruns(), once it has taken over the
+ * worker tapes.  Whatever is decided, the plan is published to the workers
+ * waiting in tuplesort_merge_ranges().  Returns true if the workers are to
+ * merge the runs, in which case the output is read from their range tapes.
+ */
+static bool
+leader_range_merge(Tuplesortstate *state)
+{
+	Sharedsort *shared = state->shared;
+	SortRunSamples *samples = SharedSortRunSamples(shared);
+	int			nParticipants = state->nParticipants;
+	int			nRanges = 0;
+
+	Assert(LEADER(state));
+
+	if (!shared->rangeMerge)
+		return false;
+
+	if (nParticipants >= TS_MIN_RANGE_MERGE_PARTICIPANTS &&
+		(state->base.sortopt & TUPLESORT_RANDOMACCESS) == 0)
+	{
+		int64		ntuples = 0;
+		int			nsamples = 0;
+		int			j;
+
+		for (j = 0; j < nParticipants; j++)
+		{
+			ntuples += samples[j].ntuples;
+			nsamples += samples[j].nsamples;
+		}
+
+		if (ntuples >= TS_MIN_RANGE_MERGE_TUPLES && nsamples >= nParticipants)
+			nRanges = leader_choose_splitters(state, nParticipants);
+	}
+
+	SpinLockAcquire(&shared->mutex);
+	shared->planReady = true;
+	shared->nRanges = nRanges;
+	shared->nInputs = nParticipants;
+	shared->nextRange = 0;
+	SpinLockRelease(&shared->mutex);
+	ConditionVariableBroadcast(&shared->mergecv);
+
+	if (nRanges == 0)
+		return false;
+
+	/* Use the remaining memory for reading the range tapes */
+	state->tape_buffer_mem = state->availMem;
+	USEMEM(state, state->tape_buffer_mem);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG, "leader handing final merge of %d runs to workers in %d ranges: %s",
+			 nParticipants, nRanges, pg_rusage_show(&state->ru_start));
+#endif
+
+	state->result_tape = NULL;
+	state->curRange = 0;
+	state->status = TSS_SORTEDINRANGES;
+	return true;
+}
+
+/*
+ * leader_choose_splitters - divide the key space among nRanges ranges
+ *
+ * Reads back the sample tuples of all runs, sorts them, and picks as
+ * splitters the samples at which the cumulative number of tuples they stand
+ * for crosses each multiple of 1/nRanges.  The worker tapes are closed, as
+ * the leader only reads the range tapes from here on.  Returns the number of
+ * ranges, which is at least 2 given at least one sample.
+ */
+static int
+leader_choose_splitters(Tuplesortstate *state, int nRanges)
+{
+	Sharedsort *shared = state->shared;
+	SortRunSamples *samples = SharedSortRunSamples(shared);
+	SortSplitter *splitters = SharedSortSplitters(shared);
+	SortSample *sample;
+	int			nParticipants = state->nParticipants;
+	int			nsamples = 0;
+	int64		totalweight = 0;
+	int64		weight;
+	int			nsplitters;
+	int			i;
+	int			j;
+
+	for (j = 0; j < nParticipants; j++)
+		nsamples += samples[j].nsamples;
+	Assert(nsamples > 0);
+
+	forget_abbreviation(state);
+
+	/* One slab slot per sample, plus one for the tuple last returned */
+	if (state->base.tuples)
+		init_slab_allocator(state, nsamples + 1);
+	else
+		init_slab_allocator(state, 0);
+
+	sample = (SortSample *) palloc(nsamples * sizeof(SortSample));
+	i = 0;
+	for (j = 0; j < nParticipants; j++)
+	{
+		LogicalTape *tape = state->outputTapes[j];
+		int			k;
+
+		LogicalTapeRewindForRead(tape, BLCKSZ);
+		for (k = 0; k < samples[j].nsamples; k++)
+		{
+			read_tuple_at(state, tape, &samples[j].pos[k], &sample[i].stup);
+			sample[i].tape = j;
+			sample[i].pos = samples[j].pos[k];
+			sample[i].weight = samples[j].interval;
+			totalweight += samples[j].interval;
+			i++;
+		}
+		LogicalTapeClose(tape);
+		state->outputTapes[j] = NULL;
+	}
+
+	qsort_arg(sample, nsamples, sizeof(SortSample), splitter_sample_cmp, state);
+
+	/*
+	 * A sample that stands for several ranges' worth of tuples can only be
+	 * used once, so we may end up with fewer ranges than asked for.
+	 */
+	nsplitters = 0;
+	weight = 0;
+	for (i = 0; i < nsamples && nsplitters < nRanges - 1; i++)
+	{
+		weight += sample[i].weight;
+		if (weight >= (nsplitters + 1) * (totalweight / nRanges))
+		{
+			splitters[nsplitters].tape = sample[i].tape;
+			splitters[nsplitters].pos = sample[i].pos;
+			nsplitters++;
+		}
+	}
+
+	for (i = 0; i < nsamples; i++)
+	{
+		if (sample[i].stup.tuple)
+			RELEASE_SLAB_SLOT(state, sample[i].stup.tuple);
+	}
+	pfree(sample);
+
+	return nsplitters + 1;
+}
+
+/*
+ * leader_next_range - open the leader's next range tape for reading
+ *
+ * Waits for the range's worker to finish merging it.  Returns false if there
+ * are no more ranges.
+ */
+static bool
+leader_next_range(Tuplesortstate *state)
+{
+	Sharedsort *shared = state->shared;
+	SortRangeShare *range = &SharedSortRanges(shared)[state->curRange];
+	TapeShare	tape;
+
+	Assert(state->result_tape == NULL);
+
+	if (state->curRange >= shared->nRanges)
+		return false;
+
+	for (;;)
+	{
+		bool		done;
+
+		SpinLockAcquire(&shared->mutex);
+		done = range->done;
+		tape = range->tape;
+		SpinLockRelease(&shared->mutex);
+
+		if (done)
+			break;
+
+		ConditionVariableSleep(&shared->mergecv,
+							   WAIT_EVENT_PARALLEL_SORT_RANGE);
+	}
+	ConditionVariableCancelSleep();
+
+	state->result_tape = LogicalTapeImport(state->tapeset,
+										   shared->nTapes + state->curRange,
+										   &tape);
+	LogicalTapeRewindForRead(state->result_tape, state->tape_buffer_mem);
+	return true;
+}
+
+/*
+ * tuplesort_merge_ranges - merge key ranges of the runs of all workers
+ *
+ * Must be called by worker processes after tuplesort_performsort(), once
+ * the caller has told the leader that the worker is done, and before
+ * tuplesort_end().  It must not be called for a worker Tuplesortstate within
+ * the leader process, since the leader only decides on the merge after all
+ * workers are done.  Waits for the leader's plan, then merges ranges until
+ * there are none left to claim; does nothing if the leader merges the runs
+ * itself.
+ */
+void
+tuplesort_merge_ranges(Tuplesortstate *state)
+{
+	Sharedsort *shared = state->shared;
+	MemoryContext oldcontext;
+	LogicalTapeSet *tapeset;
+	LogicalTape **inputs;
+	int64	   *ordinals;
+	int64		buffer_size;
+	int			nRanges;
+	int			nInputs;
+	int			j;
+
+	Assert(WORKER(state));
+
+	if (!shared->rangeMerge)
+		return;
+
+	for (;;)
+	{
+		bool		ready;
+
+		SpinLockAcquire(&shared->mutex);
+		ready = shared->planReady;
+		nRanges = shared->nRanges;
+		nInputs = shared->nInputs;
+		SpinLockRelease(&shared->mutex);
+
+		if (ready)
+			break;
+
+		ConditionVariableSleep(&shared->mergecv,
+							   WAIT_EVENT_PARALLEL_SORT_PLAN);
+	}
+	ConditionVariableCancelSleep();
+
+	if (nRanges == 0)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(state->base.sortcontext);
+
+	forget_abbreviation(state);
+
+	/* Open all runs for reading, dividing our memory among them */
+	tapeset = LogicalTapeSetCreate(false, &shared->fileset, -1);
+	inputs = (LogicalTape **) palloc(nInputs * sizeof(LogicalTape *));
+	ordinals = (int64 *) palloc(nInputs * sizeof(int64));
+	buffer_size = Max(BLCKSZ, state->allowedMem / (nInputs + 2));
+	for (j = 0; j < nInputs; j++)
+	{
+		inputs[j] = LogicalTapeImport(tapeset, j, &shared->tapes[j]);
+		LogicalTapeRewindForRead(inputs[j], buffer_size);
+	}
+	LogicalTapeSetForgetFreeSpace(tapeset);
+
+	/*
+	 * One slab slot for the tuple of each input in the heap, one for each of
+	 * the range's splitters, and one for a tuple being examined.
+	 */
+	if (state->slabMemoryBegin)
+		pfree(state->slabMemoryBegin);
+	if (state->base.tuples)
+		init_slab_allocator(state, nInputs + 3);
+	else
+		init_slab_allocator(state, 0);
+
+	if (state->memtuples)
+		pfree(state->memtuples);
+	state->memtuples = (SortTuple *) MemoryContextAlloc(state->base.maincontext,
+														nInputs * sizeof(SortTuple));
+	state->memtupsize = nInputs;
+	state->memtupcount = 0;
+
+	for (;;)
+	{
+		int			range = -1;
+
+		SpinLockAcquire(&shared->mutex);
+		if (shared->nextRange < nRanges)
+			range = shared->nextRange++;
+		SpinLockRelease(&shared->mutex);
+
+		if (range < 0)
+			break;
+
+		worker_merge_range(state, range, inputs, ordinals);
+	}
+
+	for (j = 0; j < nInputs; j++)
+		LogicalTapeClose(inputs[j]);
+	LogicalTapeSetClose(tapeset);
+	pfree(inputs);
+	pfree(ordinals);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * worker_range_start - position a run at the start of a range
+ *
+ * lo is the range's lower splitter, or NULL for the first range.  Reads the
+ * run's first tuple in the range into *stup, and its position in the run into
+ * *ordinal.  Returns false if the range has no tuples of this run.
+ */
+static bool
+worker_range_start(Tuplesortstate *state, LogicalTape *tape, int tapenum,
+				   SortSplitter *lo, SortTuple *lotup, SortTuple *stup,
+				   int64 *ordinal)
+{
+	Sharedsort *shared = state->shared;
+	SortRunSamples *samples = &SharedSortRunSamples(shared)[tapenum];
+	SortTapePos start;
+
+	start.blocknum = shared->tapes[tapenum].firstblocknumber;
+	start.offset = 0;
+	start.ordinal = 0;
+
+	if (lo != NULL && lo->tape == tapenum)
+		start = lo->pos;
+	else if (lo != NULL)
+	{
+		int			low = 0;
+		int			high = samples->nsamples;
+
+		/* Find the first sample at or beyond the splitter */
+		while (low < high)
+		{
+			int			mid = low + (high - low) / 2;
+			SortTuple	probe;
+			bool		beyond;
+
+			read_tuple_at(state, tape, &samples->pos[mid], &probe);
+			beyond = range_tuple_beyond(state, &probe, tapenum,
+										samples->pos[mid].ordinal, lo, lotup);
+			if (probe.tuple)
+				RELEASE_SLAB_SLOT(state, probe.tuple);
+
+			if (beyond)
+				high = mid;
+			else
+				low = mid + 1;
+		}
+
+		/* The range starts somewhere after the sample before that one */
+		if (low > 0)
+			start = samples->pos[low - 1];
+	}
+
+	LogicalTapeSeekImported(tape, start.blocknum, start.offset);
+	for (;;)
+	{
+		if (!mergereadnext(state, tape, stup))
+			return false;
+		if (lo == NULL || lo->tape == tapenum ||
+			range_tuple_beyond(state, stup, tapenum, start.ordinal, lo, lotup))
+			break;
+		if (stup->tuple)
+			RELEASE_SLAB_SLOT(state, stup->tuple);
+		start.ordinal++;
+	}
+
+	*ordinal = start.ordinal;
+	return true;
+}
+
+/*
+ * worker_merge_range - merge one range of all runs onto its own tape
+ *
+ * The range runs from splitter range - 1 (inclusive) to splitter range
+ * (exclusive); the first and last ranges are open-ended.
+ */
+static void
+worker_merge_range(Tuplesortstate *state, int range, LogicalTape **inputs,
+				   int64 *ordinals)
+{
+	Sharedsort *shared = state->shared;
+	SortSplitter *splitters = SharedSortSplitters(shared);
+	SortRangeShare *ranges = SharedSortRanges(shared);
+	int			nRanges = shared->nRanges;
+	int			nInputs = shared->nInputs;
+	SortSplitter *lo = NULL;
+	SortSplitter *hi = NULL;
+	SortTuple	lotup;
+	SortTuple	hitup;
+	LogicalTapeSet *tapeset;
+	LogicalTape *destTape;
+	TapeShare	output;
+	int			j;
+
+	Assert(state->memtupcount == 0);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG, "worker %d starting merge of range %d of %d: %s",
+			 state->worker, range, nRanges, pg_rusage_show(&state->ru_start));
+#endif
+
+	/* Read the splitters' tuples, before positioning the runs */
+	if (range > 0)
+	{
+		lo = &splitters[range - 1];
+		read_tuple_at(state, inputs[lo->tape], &lo->pos, &lotup);
+	}
+	if (range < nRanges - 1)
+	{
+		hi = &splitters[range];
+		read_tuple_at(state, inputs[hi->tape], &hi->pos, &hitup);
+	}
+
+	for (j = 0; j < nInputs; j++)
+	{
+		SortTuple	stup;
+
+		if (!worker_range_start(state, inputs[j], j, lo, &lotup, &stup,
+								&ordinals[j]))
+			continue;
+		if (hi != NULL &&
+			range_tuple_beyond(state, &stup, j, ordinals[j], hi, &hitup))
+		{
+			if (stup.tuple)
+				RELEASE_SLAB_SLOT(state, stup.tuple);
+			continue;
+		}
+		stup.srctape = j;
+		tuplesort_heap_insert(state, &stup);
+	}
+
+	/* Each range is written as the tape of a pseudo-worker of its own */
+	tapeset = LogicalTapeSetCreate(false, &shared->fileset,
+								   shared->nTapes + range);
+	destTape = LogicalTapeCreate(tapeset);
+
+	/*
+	 * This code should match the inner loop of mergeonerun(), except that
+	 * each run ends at the range's upper splitter.
+	 */
+	while (state->memtupcount > 0)
+	{
+		int			srcTapeIndex = state->memtuples[0].srctape;
+		SortTuple	stup;
+
+		WRITETUP(state, destTape, &state->memtuples[0]);
+		if (state->memtuples[0].tuple)
+			RELEASE_SLAB_SLOT(state, state->memtuples[0].tuple);
+		ordinals[srcTapeIndex]++;
+
+		if (mergereadnext(state, inputs[srcTapeIndex], &stup))
+		{
+			if (hi == NULL ||
+				!range_tuple_beyond(state, &stup, srcTapeIndex,
+									ordinals[srcTapeIndex], hi, &hitup))
+			{
+				stup.srctape = srcTapeIndex;
+				tuplesort_heap_replace_top(state, &stup);
+				continue;
+			}
+			if (stup.tuple)
+				RELEASE_SLAB_SLOT(state, stup.tuple);
+		}
+		tuplesort_heap_delete_top(state);
+	}
+	markrunend(destTape);
+
+	if (lo != NULL && lotup.tuple)
+		RELEASE_SLAB_SLOT(state, lotup.tuple);
+	if (hi != NULL && hitup.tuple)
+		RELEASE_SLAB_SLOT(state, hitup.tuple);
+
+	LogicalTapeFreeze(destTape, &output);
+	LogicalTapeClose(destTape);
+	LogicalTapeSetClose(tapeset);
+
+	SpinLockAcquire(&shared->mutex);
+	ranges[range].tape = output;
+	ranges[range].done = true;
+	SpinLockRelease(&shared->mutex);
+	ConditionVariableBroadcast(&shared->mergecv);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG, "worker %d finished merge of range %d of %d: %s",
+			 state->worker, range, nRanges, pg_rusage_show(&state->ru_start));
+#endif
+}
+
 /*
  * Convenience routine to free a tuple previously loaded into sort memory
  */
@@ -3167,7 +4226,10 @@ free_sort_tuple(Tuplesortstate *state, SortTuple *stup)
 {
 	if (stup->tuple)
 	{
-		FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
+		Size		tuplen = GetMemoryChunkSpace(stup->tuple);
+
+		FREEMEM(state, tuplen);
+		state->tupleMem -= tuplen;
 		pfree(stup->tuple);
 		stup->tuple = NULL;
 	}
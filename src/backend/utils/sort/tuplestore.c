@@ -263,7 +263,17 @@ tuplestore_begin_common(int eflags, bool interXact, int maxKBytes)
 	state->allowedMem = maxKBytes * 1024L;
 	state->availMem = state->allowedMem;
 	state->myfile = NULL;
-	state->context = CurrentMemoryContext;
+
+	/*
+	 * Tuples are stored in a generation context of their own.  They're
+	 * allocated in order and freed all at once, or oldest first by
+	 * tuplestore_trim, which is what generation.c is designed for: it packs
+	 * them tightly, without the rounding up to a power of 2 of allocations
+	 * that aset.c does, and scans of them are friendlier to the CPU caches.
+	 */
+	state->context = GenerationContextCreate(CurrentMemoryContext,
+											 "tuplestore tuples",
+											 ALLOCSET_DEFAULT_SIZES);
 	state->resowner = CurrentResourceOwner;
 
 	state->memtupdeleted = 0;
@@ -426,11 +436,10 @@ tuplestore_clear(Tuplestorestate *state)
 	if (state->memtuples)
 	{
 		for (i = state->memtupdeleted; i < state->memtupcount; i++)
-		{
 			FREEMEM(state, GetMemoryChunkSpace(state->memtuples[i]));
-			pfree(state->memtuples[i]);
-		}
 	}
+	/* release the tuples all at once */
+	MemoryContextReset(state->context);
 	state->status = TSS_INMEM;
 	state->truncated = false;
 	state->memtupdeleted = 0;
@@ -452,16 +461,11 @@ tuplestore_clear(Tuplestorestate *state)
 void
 tuplestore_end(Tuplestorestate *state)
 {
-	int			i;
-
 	if (state->myfile)
 		BufFileClose(state->myfile);
+	MemoryContextDelete(state->context);
 	if (state->memtuples)
-	{
-		for (i = state->memtupdeleted; i < state->memtupcount; i++)
-			pfree(state->memtuples[i]);
 		pfree(state->memtuples);
-	}
 	pfree(state->readptrs);
 	pfree(state);
 }
@@ -767,6 +771,7 @@ tuplestore_puttuple_common(Tuplestorestate *state, void *tuple)
 	TSReadPointer *readptr;
 	int			i;
 	ResourceOwner oldowner;
+	MemoryContext oldcxt;
 
 	state->tuples++;
 
@@ -818,8 +823,12 @@ tuplestore_puttuple_common(Tuplestorestate *state, void *tuple)
 			oldowner = CurrentResourceOwner;
 			CurrentResourceOwner = state->resowner;
 
+			/* the file outlives the tuples, keep it out of their context */
+			oldcxt = MemoryContextSwitchTo(MemoryContextGetParent(state->context));
+
 			state->myfile = BufFileCreateTemp(state->interXact);
 
+			MemoryContextSwitchTo(oldcxt);
 			CurrentResourceOwner = oldowner;
 
 			/*
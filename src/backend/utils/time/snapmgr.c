@@ -951,6 +951,7 @@ SnapshotResetXmin(void)
 	if (pairingheap_is_empty(&RegisteredSnapshots))
 	{
 		MyProc->xmin = InvalidTransactionId;
+		TransactionLogCacheReset();
 		return;
 	}
 
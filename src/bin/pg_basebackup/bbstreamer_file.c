@@ -32,6 +32,7 @@ typedef struct bbstreamer_extractor
 	char	   *basepath;
 	const char *(*link_map) (const char *);
 	void		(*report_output_file) (const char *);
+	bool		allow_existing_dirs;
 	char		filename[MAXPGPATH];
 	FILE	   *file;
 } bbstreamer_extractor;
@@ -55,7 +56,8 @@ static void bbstreamer_extractor_content(bbstreamer *streamer,
 										 bbstreamer_archive_context context);
 static void bbstreamer_extractor_finalize(bbstreamer *streamer);
 static void bbstreamer_extractor_free(bbstreamer *streamer);
-static void extract_directory(const char *filename, mode_t mode);
+static void extract_directory(const char *filename, mode_t mode,
+							  bool allow_existing);
 static void extract_link(const char *filename, const char *linktarget);
 static FILE *create_file_for_extract(const char *filename, mode_t mode);
 
@@ -178,11 +180,15 @@ bbstreamer_plain_writer_free(bbstreamer *streamer)
  * 'report_output_file' is a function that will be called each time we open a
  * new output file. The pathname to that file is passed as an argument. If
  * NULL, the call is skipped.
+ *
+ * 'allow_existing_dirs' says that directories in the archive may already
+ * exist, because other streams are being extracted into the same place.
  */
 bbstreamer *
 bbstreamer_extractor_new(const char *basepath,
 						 const char *(*link_map) (const char *),
-						 void (*report_output_file) (const char *))
+						 void (*report_output_file) (const char *),
+						 bool allow_existing_dirs)
 {
 	bbstreamer_extractor *streamer;
 
@@ -192,6 +198,7 @@ bbstreamer_extractor_new(const char *basepath,
 	streamer->basepath = pstrdup(basepath);
 	streamer->link_map = link_map;
 	streamer->report_output_file = report_output_file;
+	streamer->allow_existing_dirs = allow_existing_dirs;
 
 	return &streamer->base;
 }
@@ -226,7 +233,8 @@ bbstreamer_extractor_content(bbstreamer *streamer, bbstreamer_member *member,
 
 			/* Dispatch based on file type. */
 			if (member->is_directory)
-				extract_directory(mystreamer->filename, member->mode);
+				extract_directory(mystreamer->filename, member->mode,
+								  mystreamer->allow_existing_dirs);
 			else if (member->is_link)
 			{
 				const char *linktarget = member->linktarget;
@@ -311,12 +319,17 @@ should_allow_existing_directory(const char *pathname)
 
 /*
  * Create a directory.
+ *
+ * If allow_existing is true, any directory may already exist; that's the
+ * case when several streams are extracted into the same place, as in a
+ * parallel backup.
  */
 static void
-extract_directory(const char *filename, mode_t mode)
+extract_directory(const char *filename, mode_t mode, bool allow_existing)
 {
 	if (mkdir(filename, pg_dir_create_mode) != 0 &&
-		(errno != EEXIST || !should_allow_existing_directory(filename)))
+		(errno != EEXIST ||
+		 !(allow_existing || should_allow_existing_directory(filename))))
 		pg_fatal("could not create directory \"%s\": %m",
 				 filename);
 
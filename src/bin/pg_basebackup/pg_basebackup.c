@@ -27,6 +27,7 @@
 
 #include "access/xlog_internal.h"
 #include "backup/basebackup.h"
+#include "backup/basebackup_parallel.h"
 #include "bbstreamer.h"
 #include "common/compression.h"
 #include "common/file_perm.h"
@@ -148,6 +149,8 @@ static bool verify_checksums = true;
 static bool manifest = true;
 static bool manifest_force_encode = false;
 static char *manifest_checksums = NULL;
+static char *incremental_lsn = NULL;
+static int	num_jobs = 1;
 
 static bool success = false;
 static bool made_new_pgdata = false;
@@ -172,6 +175,16 @@ static int	bgpipe[2] = {-1, -1};
 static pid_t bgchild = -1;
 static bool in_log_streamer = false;
 
+/*
+ * Processes receiving the parts of a parallel backup sent over the other
+ * connections, see StartParallelWorkers().
+ */
+#ifndef WIN32
+static pid_t *parallel_children = NULL;
+static int	num_parallel_children = 0;
+#endif
+static bool in_parallel_worker = false;
+
 /* Flag to indicate if child process exited unexpectedly */
 static volatile sig_atomic_t bgchild_exited = false;
 
@@ -214,6 +227,11 @@ static void ReceiveBackupManifestChunk(size_t r, char *copybuf,
 static void ReceiveBackupManifestInMemory(PGconn *conn, PQExpBuffer buf);
 static void ReceiveBackupManifestInMemoryChunk(size_t r, char *copybuf,
 											   void *callback_data);
+#ifndef WIN32
+static void StartParallelWorkers(const char *command,
+								 pg_compress_specification *client_compress);
+static void WaitForParallelWorkers(void);
+#endif
 static void BaseBackup(char *compression_algorithm, char *compression_detail,
 					   CompressionLocation compressloc,
 					   pg_compress_specification *client_compress);
@@ -228,7 +246,7 @@ static void tablespace_list_append(const char *arg);
 static void
 cleanup_directories_atexit(void)
 {
-	if (success || in_log_streamer)
+	if (success || in_log_streamer || in_parallel_worker)
 		return;
 
 	if (!noclean && !checksum_failure)
@@ -300,9 +318,26 @@ sigchld_handler(SIGNAL_ARGS)
 static void
 kill_bgchild_atexit(void)
 {
+	if (in_parallel_worker)
+		return;
 	if (bgchild > 0 && !bgchild_exited)
 		kill(bgchild, SIGTERM);
 }
+
+/*
+ * Likewise for the processes receiving a parallel backup.
+ */
+static void
+kill_parallel_children_atexit(void)
+{
+	if (in_parallel_worker)
+		return;
+	for (int i = 0; i < num_parallel_children; i++)
+	{
+		if (parallel_children[i] > 0)
+			kill(parallel_children[i], SIGTERM);
+	}
+}
 #endif
 
 /*
@@ -408,6 +443,9 @@ usage(void)
 	printf(_("  -c, --checkpoint=fast|spread\n"
 			 "                         set fast or spread checkpointing\n"));
 	printf(_("  -C, --create-slot      create replication slot\n"));
+	printf(_("  -i, --incremental=LSN  take an incremental backup of the blocks changed\n"
+			 "                         since an earlier backup started at LSN\n"));
+	printf(_("  -j, --jobs=NUM         use this many connections to send the backup\n"));
 	printf(_("  -l, --label=LABEL      set backup label\n"));
 	printf(_("  -n, --no-clean         do not clean up after errors\n"));
 	printf(_("  -N, --no-sync          do not wait for changes to be written safely to disk\n"));
@@ -1136,7 +1174,8 @@ CreateBackupStreamer(char *archive_name, char *spclocation,
 			directory = get_tablespace_mapping(spclocation);
 		streamer = bbstreamer_extractor_new(directory,
 											get_tablespace_mapping,
-											progress_update_filename);
+											progress_update_filename,
+											num_jobs > 1);
 	}
 	else
 	{
@@ -1723,6 +1762,105 @@ ReceiveBackupManifestInMemoryChunk(size_t r, char *copybuf,
 	appendPQExpBuffer(buf, copybuf, r);
 }
 
+#ifndef WIN32
+/*
+ * Start a process for each of the other connections of a parallel backup.
+ *
+ * Each one opens its own connection, joins the backup with the given
+ * command, and extracts what it receives into the same directories as the
+ * main connection; the server divides the files among them.
+ */
+static void
+StartParallelWorkers(const char *command,
+					 pg_compress_specification *client_compress)
+{
+	num_parallel_children = 0;
+	parallel_children = pg_malloc0(sizeof(pid_t) * (num_jobs - 1));
+	atexit(kill_parallel_children_atexit);
+
+	/* make sure nothing buffered gets written twice */
+	fflush(NULL);
+
+	for (int i = 0; i < num_jobs - 1; i++)
+	{
+		pid_t		pid = fork();
+
+		if (pid == 0)
+		{
+			PGresult   *res;
+
+			/* in child process; leave the parent's connection alone */
+			in_parallel_worker = true;
+			writerecoveryconf = false;
+			showprogress = false;
+
+			conn = GetConnection();
+			if (!conn)
+				exit(1);
+
+			if (PQsendQuery(conn, command) == 0)
+				pg_fatal("could not send replication command \"%s\": %s",
+						 "BASE_BACKUP", PQerrorMessage(conn));
+
+			/* start location and tablespace header, as for the leader */
+			for (int j = 0; j < 2; j++)
+			{
+				res = PQgetResult(conn);
+				if (PQresultStatus(res) != PGRES_TUPLES_OK)
+					pg_fatal("could not join parallel backup: %s",
+							 PQerrorMessage(conn));
+				PQclear(res);
+			}
+
+			ReceiveArchiveStream(conn, client_compress);
+
+			/* end location, then the command's completion */
+			res = PQgetResult(conn);
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pg_fatal("backup failed: %s", PQerrorMessage(conn));
+			PQclear(res);
+			res = PQgetResult(conn);
+			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+				pg_fatal("final receive failed: %s", PQerrorMessage(conn));
+			PQclear(res);
+
+			PQfinish(conn);
+			conn = NULL;
+			exit(0);
+		}
+		else if (pid < 0)
+			pg_fatal("could not create background process: %m");
+
+		parallel_children[num_parallel_children++] = pid;
+	}
+}
+
+/*
+ * Wait for all the processes of a parallel backup to exit, and check that
+ * they succeeded.
+ */
+static void
+WaitForParallelWorkers(void)
+{
+	for (int i = 0; i < num_parallel_children; i++)
+	{
+		int			status;
+
+		if (waitpid(parallel_children[i], &status, 0) != parallel_children[i])
+			pg_fatal("could not wait for child process: %m");
+		parallel_children[i] = 0;
+
+		if (!WIFEXITED(status))
+			pg_fatal("parallel backup worker %d died with signal %d",
+					 i + 1, WTERMSIG(status));
+		if (WEXITSTATUS(status) != 0)
+			pg_fatal("parallel backup worker %d exited with error %d",
+					 i + 1, WEXITSTATUS(status));
+	}
+	num_parallel_children = 0;
+}
+#endif
+
 static void
 BaseBackup(char *compression_algorithm, char *compression_detail,
 		   CompressionLocation compressloc, pg_compress_specification *client_compress)
@@ -1742,9 +1880,11 @@ BaseBackup(char *compression_algorithm, char *compression_detail,
 	int			writing_to_stdout;
 	bool		use_new_option_syntax = false;
 	PQExpBufferData buf;
+	PQExpBufferData workerbuf;
 
 	Assert(conn != NULL);
 	initPQExpBuffer(&buf);
+	initPQExpBuffer(&workerbuf);
 
 	/*
 	 * Check server version. BASE_BACKUP command was introduced in 9.1, so we
@@ -1881,6 +2021,22 @@ BaseBackup(char *compression_algorithm, char *compression_detail,
 									  compression_detail);
 	}
 
+	if (incremental_lsn != NULL)
+	{
+		if (!use_new_option_syntax)
+			pg_fatal("server does not support incremental backup");
+		AppendStringCommandOption(&buf, use_new_option_syntax,
+								  "INCREMENTAL", incremental_lsn);
+	}
+
+	if (num_jobs > 1)
+	{
+		if (!use_new_option_syntax)
+			pg_fatal("server does not support parallel backup");
+		AppendIntegerCommandOption(&buf, use_new_option_syntax, "PARALLEL",
+								   num_jobs);
+	}
+
 	if (verbose)
 		pg_log_info("initiating base backup, waiting for checkpoint to complete");
 
@@ -1933,6 +2089,36 @@ BaseBackup(char *compression_algorithm, char *compression_detail,
 		pg_log_info("write-ahead log start point: %s on timeline %u",
 					xlogstart, starttli);
 
+	/*
+	 * The other connections of a parallel backup join this one by its start
+	 * location, and just send their share of the files; the rest of what
+	 * the server needs to know they take from the backup they join.
+	 */
+	if (num_jobs > 1)
+	{
+		AppendStringCommandOption(&workerbuf, true, "PARALLEL_JOIN",
+								  xlogstart);
+		if (maxrate > 0)
+			AppendIntegerCommandOption(&workerbuf, true, "MAX_RATE", maxrate);
+		if (!verify_checksums)
+			AppendIntegerCommandOption(&workerbuf, true,
+									   "VERIFY_CHECKSUMS", 0);
+		AppendStringCommandOption(&workerbuf, true, "MANIFEST", "no");
+		AppendStringCommandOption(&workerbuf, true, "TARGET", "client");
+		if (compressloc == COMPRESS_LOCATION_SERVER)
+		{
+			AppendStringCommandOption(&workerbuf, true,
+									  "COMPRESSION", compression_algorithm);
+			if (compression_detail != NULL)
+				AppendStringCommandOption(&workerbuf, true,
+										  "COMPRESSION_DETAIL",
+										  compression_detail);
+		}
+		if (incremental_lsn != NULL)
+			AppendStringCommandOption(&workerbuf, true,
+									  "INCREMENTAL", incremental_lsn);
+	}
+
 	/*
 	 * Get the header
 	 */
@@ -2015,6 +2201,19 @@ BaseBackup(char *compression_algorithm, char *compression_detail,
 						 wal_compress_level);
 	}
 
+#ifndef WIN32
+	if (num_jobs > 1)
+	{
+		char	   *workercmd = psprintf("BASE_BACKUP (%s)", workerbuf.data);
+
+		if (verbose)
+			pg_log_info("starting %d parallel backup workers", num_jobs - 1);
+		StartParallelWorkers(workercmd, client_compress);
+		pfree(workercmd);
+	}
+#endif
+	termPQExpBuffer(&workerbuf);
+
 	if (serverMajor >= 1500)
 	{
 		/* Receive a single tar stream with everything. */
@@ -2108,6 +2307,11 @@ BaseBackup(char *compression_algorithm, char *compression_detail,
 		exit(1);
 	}
 
+#ifndef WIN32
+	if (num_parallel_children > 0)
+		WaitForParallelWorkers();
+#endif
+
 	if (bgchild > 0)
 	{
 #ifndef WIN32
@@ -2255,6 +2459,7 @@ main(int argc, char **argv)
 		{"format", required_argument, NULL, 'F'},
 		{"checkpoint", required_argument, NULL, 'c'},
 		{"create-slot", no_argument, NULL, 'C'},
+		{"incremental", required_argument, NULL, 'i'},
 		{"max-rate", required_argument, NULL, 'r'},
 		{"write-recovery-conf", no_argument, NULL, 'R'},
 		{"slot", required_argument, NULL, 'S'},
@@ -2263,6 +2468,7 @@ main(int argc, char **argv)
 		{"wal-method", required_argument, NULL, 'X'},
 		{"gzip", no_argument, NULL, 'z'},
 		{"compress", required_argument, NULL, 'Z'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"label", required_argument, NULL, 'l'},
 		{"no-clean", no_argument, NULL, 'n'},
 		{"no-sync", no_argument, NULL, 'N'},
@@ -2313,7 +2519,7 @@ main(int argc, char **argv)
 
 	atexit(cleanup_directories_atexit);
 
-	while ((c = getopt_long(argc, argv, "c:Cd:D:F:h:l:nNp:Pr:Rs:S:t:T:U:vwWX:zZ:",
+	while ((c = getopt_long(argc, argv, "c:Cd:D:F:h:i:j:l:nNp:Pr:Rs:S:t:T:U:vwWX:zZ:",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -2348,6 +2554,23 @@ main(int argc, char **argv)
 			case 'h':
 				dbhost = pg_strdup(optarg);
 				break;
+			case 'i':
+				{
+					uint32		hi,
+								lo;
+
+					if (sscanf(optarg, "%X/%X", &hi, &lo) != 2)
+						pg_fatal("invalid incremental backup LSN \"%s\"",
+								 optarg);
+					incremental_lsn = pg_strdup(optarg);
+				}
+				break;
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1,
+									  MAX_PARALLEL_BACKUP_JOBS,
+									  &num_jobs))
+					exit(1);
+				break;
 			case 'l':
 				label = pg_strdup(optarg);
 				break;
@@ -2658,6 +2881,23 @@ main(int argc, char **argv)
 		}
 	}
 
+	/*
+	 * Sanity checks for parallel backup.
+	 */
+	if (num_jobs > 1)
+	{
+#ifdef WIN32
+		pg_log_error("parallel backups are not supported on this platform");
+		exit(1);
+#endif
+		if (backup_target != NULL || format != 'p')
+		{
+			pg_log_error("parallel backups can only be taken in plain mode");
+			pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+			exit(1);
+		}
+	}
+
 	/*
 	 * Sanity checks for progress reporting options.
 	 */
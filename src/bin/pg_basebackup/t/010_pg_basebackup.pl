@@ -588,6 +588,23 @@ $node->command_ok(
 	],
 	'pg_basebackup -X stream runs with --no-slot');
 rmtree("$tempdir/backupnoslot");
+
+# A parallel backup must be the same as any other, manifest included.
+$node->command_ok(
+	[
+		@pg_basebackup_defs, '-D', "$tempdir/backupjobs", '-X',
+		'stream', '-j', '3', '--manifest-checksums', 'SHA256'
+	],
+	'pg_basebackup -j runs');
+ok(-f "$tempdir/backupjobs/backup_manifest",
+	'parallel backup manifest included');
+$node->command_ok([ 'pg_verifybackup', "$tempdir/backupjobs" ],
+	'parallel backup verifies');
+rmtree("$tempdir/backupjobs");
+$node->command_fails_like(
+	[ @pg_basebackup_defs, '-D', "$tempdir/backupjobs", '-j', '2', '-Ft' ],
+	qr/parallel backups can only be taken in plain mode/,
+	'parallel backup requires plain mode');
 $node->command_ok(
 	[ @pg_basebackup_defs, '-D', "$tempdir/backupxf", '-X', 'fetch' ],
 	'pg_basebackup -X fetch runs');
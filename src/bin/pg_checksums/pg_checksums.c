@@ -32,6 +32,81 @@
 #include "storage/checksum.h"
 #include "storage/checksum_impl.h"
 
+/*
+ * Multi-platform thread implementations, as in pgbench
+ */
+#ifdef WIN32
+/* Use Windows threads */
+#include <windows.h>
+#define THREAD_T HANDLE
+#define THREAD_FUNC_RETURN_TYPE unsigned
+#define THREAD_FUNC_RETURN return 0
+#define THREAD_FUNC_CC __stdcall
+#define THREAD_CREATE(handle, function, arg) \
+	((*(handle) = (HANDLE) _beginthreadex(NULL, 0, (function), (arg), 0, NULL)) == 0 ? errno : 0)
+#define THREAD_JOIN(handle) \
+	(WaitForSingleObject(handle, INFINITE), CloseHandle(handle))
+#elif defined(ENABLE_THREAD_SAFETY)
+/* Use POSIX threads */
+#include "port/pg_pthread.h"
+#define THREAD_T pthread_t
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#define THREAD_CREATE(handle, function, arg) \
+	pthread_create((handle), NULL, (function), (arg))
+#define THREAD_JOIN(handle) \
+	pthread_join((handle), NULL)
+#else
+/* No threads implementation, use none (-j 1) */
+#define THREAD_T void *
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#endif
+
+/*
+ * How many blocks to read from a file at once.  Large reads keep the
+ * number of system calls down, and let the checksum loop run over many
+ * pages in a row.
+ */
+#define READ_CHUNK_BLOCKS	128
+
+/*
+ * A file to operate on, as found by scan_directory().
+ */
+typedef struct scan_item
+{
+	char	   *path;
+	int			segmentno;
+	int64		size;
+} scan_item;
+
+static scan_item *scan_items = NULL;
+static int	n_scan_items = 0;
+static int	max_scan_items = 0;
+
+/*
+ * State of one worker.  Each worker operates on a fixed set of files, and
+ * keeps counters of its own, so that the workers don't need to synchronize.
+ */
+typedef struct scan_worker
+{
+	THREAD_T	thread;			/* thread handle, unless worker 0 */
+	scan_item **items;			/* the files assigned to this worker */
+	int			nitems;
+	int64		size;			/* total size of those files */
+	char	   *buf;			/* READ_CHUNK_BLOCKS blocks */
+	int64		files_scanned;
+	int64		files_written;
+	int64		blocks_scanned;
+	int64		blocks_written;
+	int64		badblocks;
+	int64		current_size;	/* bytes processed so far */
+} scan_worker;
+
+static scan_worker *workers = NULL;
+static int	num_workers = 0;
 
 static int64 files_scanned = 0;
 static int64 files_written = 0;
@@ -44,6 +119,7 @@ static char *only_filenode = NULL;
 static bool do_sync = true;
 static bool verbose = false;
 static bool showprogress = false;
+static int	num_jobs = 1;
 
 typedef enum
 {
@@ -67,7 +143,8 @@ static PgChecksumMode mode = PG_MODE_CHECK;
 static const char *progname;
 
 /*
- * Progress status information.
+ * Progress status information.  current_size is added up from the workers'
+ * counters, which they update without locking, so it can lag a little.
  */
 int64		total_size = 0;
 int64		current_size = 0;
@@ -85,6 +162,7 @@ usage(void)
 	printf(_("  -d, --disable            disable data checksums\n"));
 	printf(_("  -e, --enable             enable data checksums\n"));
 	printf(_("  -f, --filenode=FILENODE  check only relation with specified filenode\n"));
+	printf(_("  -j, --jobs=NUM           use this many parallel jobs\n"));
 	printf(_("  -N, --no-sync            do not wait for changes to be written safely to disk\n"));
 	printf(_("  -P, --progress           show progress information\n"));
 	printf(_("  -v, --verbose            output verbose messages\n"));
@@ -143,6 +221,10 @@ progress_report(bool finished)
 	/* Save current time */
 	last_progress_report = now;
 
+	current_size = 0;
+	for (int i = 0; i < num_workers; i++)
+		current_size += workers[i].current_size;
+
 	/* Adjust total size if current_size is larger */
 	if (current_size > total_size)
 		total_size = current_size;
@@ -180,11 +262,34 @@ skipfile(const char *fn)
 	return false;
 }
 
+/*
+ * Write back the blocks of buf whose checksum was set, from first to
+ * (not including) last, starting at block number startblock of the file.
+ */
+static void
+write_blocks(int f, const char *fn, char *buf, BlockNumber startblock,
+			 int first, int last)
+{
+	size_t		len = (size_t) (last - first) * BLCKSZ;
+	ssize_t		w;
+
+	w = pg_pwrite(f, buf + (size_t) first * BLCKSZ, len,
+				  (off_t) (startblock + first) * BLCKSZ);
+	if (w != len)
+	{
+		if (w < 0)
+			pg_fatal("could not write block %u in file \"%s\": %m",
+					 startblock + first, fn);
+		else
+			pg_fatal("could not write block %u in file \"%s\": wrote %zd of %zu",
+					 startblock + first, fn, w, len);
+	}
+}
+
 static void
-scan_file(const char *fn, int segmentno)
+scan_file(scan_worker *worker, const char *fn, int segmentno)
 {
-	PGIOAlignedBlock buf;
-	PageHeader	header = (PageHeader) buf.data;
+	char	   *buf = worker->buf;
 	int			f;
 	BlockNumber blockno;
 	int			flags;
@@ -199,84 +304,103 @@ scan_file(const char *fn, int segmentno)
 	if (f < 0)
 		pg_fatal("could not open file \"%s\": %m", fn);
 
-	files_scanned++;
+	worker->files_scanned++;
 
-	for (blockno = 0;; blockno++)
+	for (blockno = 0;;)
 	{
-		uint16		csum;
-		int			r = read(f, buf.data, BLCKSZ);
+		size_t		nread = 0;
+		int			nblocks;
+		int			dirty_start = -1;
 
-		if (r == 0)
-			break;
-		if (r != BLCKSZ)
+		/* Fill the buffer, unless we reach the end of the file first */
+		while (nread < READ_CHUNK_BLOCKS * BLCKSZ)
 		{
+			ssize_t		r = pg_pread(f, buf + nread,
+									 READ_CHUNK_BLOCKS * BLCKSZ - nread,
+									 (off_t) blockno * BLCKSZ + nread);
+
 			if (r < 0)
 				pg_fatal("could not read block %u in file \"%s\": %m",
-						 blockno, fn);
-			else
-				pg_fatal("could not read block %u in file \"%s\": read %d of %d",
-						 blockno, fn, r, BLCKSZ);
+						 blockno + (BlockNumber) (nread / BLCKSZ), fn);
+			if (r == 0)
+				break;
+			nread += r;
 		}
-		blocks_scanned++;
-
-		/*
-		 * Since the file size is counted as total_size for progress status
-		 * information, the sizes of all pages including new ones in the file
-		 * should be counted as current_size. Otherwise the progress reporting
-		 * calculated using those counters may not reach 100%.
-		 */
-		current_size += r;
+		if (nread % BLCKSZ != 0)
+			pg_fatal("could not read block %u in file \"%s\": read %d of %d",
+					 blockno + (BlockNumber) (nread / BLCKSZ), fn,
+					 (int) (nread % BLCKSZ), BLCKSZ);
+		nblocks = nread / BLCKSZ;
 
-		/* New pages have no checksum yet */
-		if (PageIsNew(buf.data))
-			continue;
-
-		csum = pg_checksum_page(buf.data, blockno + segmentno * RELSEG_SIZE);
-		if (mode == PG_MODE_CHECK)
-		{
-			if (csum != header->pd_checksum)
-			{
-				if (ControlFile->data_checksum_version == PG_DATA_CHECKSUM_VERSION)
-					pg_log_error("checksum verification failed in file \"%s\", block %u: calculated checksum %X but block contains %X",
-								 fn, blockno, csum, header->pd_checksum);
-				badblocks++;
-			}
-		}
-		else if (mode == PG_MODE_ENABLE)
+		for (int i = 0; i < nblocks; i++)
 		{
-			int			w;
+			char	   *page = buf + (size_t) i * BLCKSZ;
+			PageHeader	header = (PageHeader) page;
+			uint16		csum;
+
+			worker->blocks_scanned++;
 
 			/*
-			 * Do not rewrite if the checksum is already set to the expected
-			 * value.
+			 * Since the file size is counted as total_size for progress
+			 * status information, the sizes of all pages including new ones
+			 * in the file should be counted as current_size. Otherwise the
+			 * progress reporting calculated using those counters may not
+			 * reach 100%.
 			 */
-			if (header->pd_checksum == csum)
-				continue;
+			worker->current_size += BLCKSZ;
 
-			blocks_written_in_file++;
+			/* New pages have no checksum yet */
+			if (PageIsNew(page))
+				csum = 0;
+			else
+				csum = pg_checksum_page(page,
+										blockno + i + segmentno * RELSEG_SIZE);
 
-			/* Set checksum in page header */
-			header->pd_checksum = csum;
+			if (mode == PG_MODE_CHECK)
+			{
+				if (!PageIsNew(page) && csum != header->pd_checksum)
+				{
+					if (ControlFile->data_checksum_version == PG_DATA_CHECKSUM_VERSION)
+						pg_log_error("checksum verification failed in file \"%s\", block %u: calculated checksum %X but block contains %X",
+									 fn, blockno + i, csum, header->pd_checksum);
+					worker->badblocks++;
+				}
+			}
+			else if (mode == PG_MODE_ENABLE)
+			{
+				/*
+				 * Do not rewrite if the checksum is already set to the
+				 * expected value.  Consecutive blocks that need it are
+				 * written back together.
+				 */
+				if (PageIsNew(page) || header->pd_checksum == csum)
+				{
+					if (dirty_start >= 0)
+						write_blocks(f, fn, buf, blockno, dirty_start, i);
+					dirty_start = -1;
+					continue;
+				}
 
-			/* Seek back to beginning of block */
-			if (lseek(f, -BLCKSZ, SEEK_CUR) < 0)
-				pg_fatal("seek failed for block %u in file \"%s\": %m", blockno, fn);
+				blocks_written_in_file++;
 
-			/* Write block with checksum */
-			w = write(f, buf.data, BLCKSZ);
-			if (w != BLCKSZ)
-			{
-				if (w < 0)
-					pg_fatal("could not write block %u in file \"%s\": %m",
-							 blockno, fn);
-				else
-					pg_fatal("could not write block %u in file \"%s\": wrote %d of %d",
-							 blockno, fn, w, BLCKSZ);
+				/* Set checksum in page header */
+				header->pd_checksum = csum;
+
+				if (dirty_start < 0)
+					dirty_start = i;
 			}
 		}
 
-		if (showprogress)
+		if (dirty_start >= 0)
+			write_blocks(f, fn, buf, blockno, dirty_start, nblocks);
+
+		blockno += nblocks;
+
+		if (showprogress && worker == &workers[0])
 			progress_report(false);
+
+		if (nblocks < READ_CHUNK_BLOCKS)
+			break;
 	}
 
 	if (verbose)
@@ -290,22 +414,20 @@ scan_file(const char *fn, int segmentno)
 	/* Update write counters if any write activity has happened */
 	if (blocks_written_in_file > 0)
 	{
-		files_written++;
-		blocks_written += blocks_written_in_file;
+		worker->files_written++;
+		worker->blocks_written += blocks_written_in_file;
 	}
 
 	close(f);
 }
 
 /*
- * Scan the given directory for items which can be checksummed and
- * operate on each one of them.  If "sizeonly" is true, the size of
- * all the items which have checksums is computed and returned back
- * to the caller without operating on the files.  This is used to compile
- * the total size of the data directory for progress reports.
+ * Scan the given directory for items which can be checksummed, and add
+ * each one of them to scan_items.  The total size of the items is returned
+ * back to the caller, for progress reports.
  */
 static int64
-scan_directory(const char *basedir, const char *subdir, bool sizeonly)
+scan_directory(const char *basedir, const char *subdir)
 {
 	int64		dirsize = 0;
 	char		path[MAXPGPATH];
@@ -377,12 +499,16 @@ scan_directory(const char *basedir, const char *subdir, bool sizeonly)
 
 			dirsize += st.st_size;
 
-			/*
-			 * No need to work on the file when calculating only the size of
-			 * the items in the data folder.
-			 */
-			if (!sizeonly)
-				scan_file(fn, segmentno);
+			if (n_scan_items >= max_scan_items)
+			{
+				max_scan_items = Max(max_scan_items * 2, 1024);
+				scan_items = pg_realloc(scan_items,
+										max_scan_items * sizeof(scan_item));
+			}
+			scan_items[n_scan_items].path = pstrdup(fn);
+			scan_items[n_scan_items].segmentno = segmentno;
+			scan_items[n_scan_items].size = st.st_size;
+			n_scan_items++;
 		}
 		else if (S_ISDIR(st.st_mode) || S_ISLNK(st.st_mode))
 		{
@@ -420,12 +546,11 @@ scan_directory(const char *basedir, const char *subdir, bool sizeonly)
 
 				/* Looks like a valid tablespace location */
 				dirsize += scan_directory(tblspc_path,
-										  TABLESPACE_VERSION_DIRECTORY,
-										  sizeonly);
+										  TABLESPACE_VERSION_DIRECTORY);
 			}
 			else
 			{
-				dirsize += scan_directory(path, de->d_name, sizeonly);
+				dirsize += scan_directory(path, de->d_name);
 			}
 		}
 	}
@@ -433,6 +558,103 @@ scan_directory(const char *basedir, const char *subdir, bool sizeonly)
 	return dirsize;
 }
 
+/*
+ * qsort comparator for scan_item pointers, by decreasing size
+ */
+static int
+scan_item_size_cmp(const void *a, const void *b)
+{
+	const scan_item *ia = *(const scan_item *const *) a;
+	const scan_item *ib = *(const scan_item *const *) b;
+
+	if (ia->size > ib->size)
+		return -1;
+	if (ia->size < ib->size)
+		return 1;
+	return 0;
+}
+
+/*
+ * Work through the files assigned to one worker
+ */
+static THREAD_FUNC_RETURN_TYPE THREAD_FUNC_CC
+scan_worker_run(void *arg)
+{
+	scan_worker *worker = (scan_worker *) arg;
+
+	for (int i = 0; i < worker->nitems; i++)
+		scan_file(worker, worker->items[i]->path, worker->items[i]->segmentno);
+
+	THREAD_FUNC_RETURN;
+}
+
+/*
+ * Operate on all the files in scan_items, using up to num_jobs threads.
+ *
+ * The files are handed out largest first, each to the worker with the least
+ * data so far, so that one huge relation doesn't leave the other workers
+ * idle at the end.  Worker 0 runs in the calling thread.
+ */
+static void
+scan_all_files(void)
+{
+	scan_item **sorted;
+
+	num_workers = Max(Min(num_jobs, n_scan_items), 1);
+	workers = pg_malloc0(num_workers * sizeof(scan_worker));
+
+	sorted = pg_malloc(n_scan_items * sizeof(scan_item *));
+	for (int i = 0; i < n_scan_items; i++)
+		sorted[i] = &scan_items[i];
+	qsort(sorted, n_scan_items, sizeof(scan_item *), scan_item_size_cmp);
+
+	for (int i = 0; i < num_workers; i++)
+	{
+		workers[i].items = pg_malloc(n_scan_items * sizeof(scan_item *));
+		workers[i].buf = pg_malloc(READ_CHUNK_BLOCKS * BLCKSZ);
+	}
+	for (int i = 0; i < n_scan_items; i++)
+	{
+		scan_worker *least = &workers[0];
+
+		for (int w = 1; w < num_workers; w++)
+		{
+			if (workers[w].size < least->size)
+				least = &workers[w];
+		}
+		least->items[least->nitems++] = sorted[i];
+		least->size += sorted[i]->size;
+	}
+	pg_free(sorted);
+
+#ifdef ENABLE_THREAD_SAFETY
+	for (int i = 1; i < num_workers; i++)
+	{
+		errno = THREAD_CREATE(&workers[i].thread, scan_worker_run, &workers[i]);
+		if (errno != 0)
+			pg_fatal("could not create thread: %m");
+	}
+#else
+	Assert(num_workers == 1);
+#endif							/* ENABLE_THREAD_SAFETY */
+
+	(void) scan_worker_run(&workers[0]);
+
+	for (int i = 0; i < num_workers; i++)
+	{
+#ifdef ENABLE_THREAD_SAFETY
+		if (i > 0)
+			THREAD_JOIN(workers[i].thread);
+#endif							/* ENABLE_THREAD_SAFETY */
+
+		files_scanned += workers[i].files_scanned;
+		files_written += workers[i].files_written;
+		blocks_scanned += workers[i].blocks_scanned;
+		blocks_written += workers[i].blocks_written;
+		badblocks += workers[i].badblocks;
+	}
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -442,6 +664,7 @@ main(int argc, char *argv[])
 		{"disable", no_argument, NULL, 'd'},
 		{"enable", no_argument, NULL, 'e'},
 		{"filenode", required_argument, NULL, 'f'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"no-sync", no_argument, NULL, 'N'},
 		{"progress", no_argument, NULL, 'P'},
 		{"verbose", no_argument, NULL, 'v'},
@@ -471,7 +694,7 @@ main(int argc, char *argv[])
 		}
 	}
 
-	while ((c = getopt_long(argc, argv, "cdD:ef:NPv", long_options, &option_index)) != -1)
+	while ((c = getopt_long(argc, argv, "cdD:ef:j:NPv", long_options, &option_index)) != -1)
 	{
 		switch (c)
 		{
@@ -494,6 +717,15 @@ main(int argc, char *argv[])
 					exit(1);
 				only_filenode = pstrdup(optarg);
 				break;
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &num_jobs))
+					exit(1);
+#ifndef ENABLE_THREAD_SAFETY
+				if (num_jobs != 1)
+					pg_fatal("threads are not supported on this platform; use -j1");
+#endif							/* !ENABLE_THREAD_SAFETY */
+				break;
 			case 'N':
 				do_sync = false;
 				break;
@@ -584,20 +816,14 @@ main(int argc, char *argv[])
 	if (mode == PG_MODE_CHECK || mode == PG_MODE_ENABLE)
 	{
 		/*
-		 * If progress status information is requested, we need to scan the
-		 * directory tree twice: once to know how much total data needs to be
-		 * processed and once to do the real work.
+		 * Collect the files to operate on first, which also tells how much
+		 * total data needs to be processed, and then do the real work.
 		 */
-		if (showprogress)
-		{
-			total_size = scan_directory(DataDir, "global", true);
-			total_size += scan_directory(DataDir, "base", true);
-			total_size += scan_directory(DataDir, "pg_tblspc", true);
-		}
+		total_size = scan_directory(DataDir, "global");
+		total_size += scan_directory(DataDir, "base");
+		total_size += scan_directory(DataDir, "pg_tblspc");
 
-		(void) scan_directory(DataDir, "global", false);
-		(void) scan_directory(DataDir, "base", false);
-		(void) scan_directory(DataDir, "pg_tblspc", false);
+		scan_all_files();
 
 		if (showprogress)
 			progress_report(true);
@@ -0,0 +1,594 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_combinebackup.c
+ *	  Combine a full base backup and incremental backups taken after it
+ *	  into a single, full backup.
+ *
+ * The backups are given oldest first.  Every file is copied from the newest
+ * backup, except that relation files an incremental backup sent as
+ * INCREMENTAL.<name> are rebuilt block by block: each block comes from the
+ * newest backup that has a copy of it.  See basebackup_incremental.h for
+ * the format of those files.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/bin/pg_combinebackup/pg_combinebackup.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/xlogdefs.h"
+#include "backup/basebackup_incremental.h"
+#include "common/file_perm.h"
+#include "common/file_utils.h"
+#include "common/logging.h"
+#include "getopt_long.h"
+#include "storage/block.h"
+
+/*
+ * How many bytes should we try to copy from a file at once?
+ */
+#define COPY_CHUNK_SIZE				(128 * 1024)
+
+/*
+ * A backup given on the command line, and what its backup_label says.
+ */
+typedef struct backup_info
+{
+	char	   *path;
+	XLogRecPtr	start_lsn;		/* START WAL LOCATION */
+	XLogRecPtr	incremental_lsn;	/* INCREMENTAL FROM LSN, or invalid */
+} backup_info;
+
+/*
+ * The copy one backup has of a relation file: either the whole file, or an
+ * INCREMENTAL file holding some of its blocks.
+ */
+typedef struct block_source
+{
+	int			fd;
+	char	   *path;
+	bool		incremental;
+	BlockNumber nblocks;		/* length of the file, in blocks */
+	uint32		nchanged;		/* INCREMENTAL: number of blocks included */
+	BlockNumber *blocks;		/* INCREMENTAL: the included block numbers */
+} block_source;
+
+static const char *progname;
+static backup_info *backups;
+static int	nbackups;
+static char *output_path;
+static bool do_sync = true;
+
+static void usage(void);
+static void read_backup_label(backup_info *backup);
+static void check_backup_chain(void);
+static void combine_directory(const char *relpath);
+static void copy_file(const char *src, const char *dst);
+static void copy_backup_label(const char *src, const char *dst);
+static void reconstruct_file(const char *reldir, const char *name,
+							 const char *dst);
+static bool open_block_source(block_source *source, const char *reldir,
+							  const char *name, int backupno);
+static void read_block(block_source *source, off_t offset, char *buf);
+static int	compare_block_numbers(const void *a, const void *b);
+
+int
+main(int argc, char **argv)
+{
+	static struct option long_options[] = {
+		{"no-sync", no_argument, NULL, 'N'},
+		{"output", required_argument, NULL, 'o'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int			c;
+
+	pg_logging_init(argv[0]);
+	set_pglocale_pgservice(argv[0], PG_TEXTDOMAIN("pg_combinebackup"));
+	progname = get_progname(argv[0]);
+
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)
+		{
+			usage();
+			exit(0);
+		}
+		if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-V") == 0)
+		{
+			puts("pg_combinebackup (PostgreSQL) " PG_VERSION);
+			exit(0);
+		}
+	}
+
+	while ((c = getopt_long(argc, argv, "No:", long_options, NULL)) != -1)
+	{
+		switch (c)
+		{
+			case 'N':
+				do_sync = false;
+				break;
+			case 'o':
+				output_path = pg_strdup(optarg);
+				canonicalize_path(output_path);
+				break;
+			default:
+				/* getopt_long already emitted a complaint */
+				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+				exit(1);
+		}
+	}
+
+	if (output_path == NULL)
+	{
+		pg_log_error("no output directory specified");
+		pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+		exit(1);
+	}
+
+	if (argc - optind < 2)
+	{
+		pg_log_error("at least two backup directories must be specified");
+		pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+		exit(1);
+	}
+
+	nbackups = argc - optind;
+	backups = pg_malloc0(sizeof(backup_info) * nbackups);
+	for (int i = 0; i < nbackups; i++)
+	{
+		backups[i].path = pg_strdup(argv[optind + i]);
+		canonicalize_path(backups[i].path);
+		read_backup_label(&backups[i]);
+	}
+	check_backup_chain();
+
+	if (pg_check_dir(output_path) > 1)
+		pg_fatal("output directory \"%s\" exists but is not empty",
+				 output_path);
+	if (pg_mkdir_p(output_path, pg_dir_create_mode) != 0 && errno != EEXIST)
+		pg_fatal("could not create directory \"%s\": %m", output_path);
+
+	combine_directory("");
+
+	if (do_sync)
+		fsync_pgdata(output_path, PG_VERSION_NUM);
+
+	exit(0);
+}
+
+/*
+ * Read the start LSN of a backup, and the LSN it was taken relative to if
+ * it's incremental, from its backup_label.
+ */
+static void
+read_backup_label(backup_info *backup)
+{
+	char		path[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *fp;
+	uint32		hi,
+				lo;
+	bool		found_start = false;
+
+	snprintf(path, sizeof(path), "%s/backup_label", backup->path);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		pg_fatal("could not open file \"%s\": %m", path);
+
+	backup->incremental_lsn = InvalidXLogRecPtr;
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+		{
+			backup->start_lsn = ((uint64) hi) << 32 | lo;
+			found_start = true;
+		}
+		else if (strncmp(line, INCREMENTAL_LABEL_LINE,
+						 strlen(INCREMENTAL_LABEL_LINE)) == 0)
+		{
+			if (sscanf(line + strlen(INCREMENTAL_LABEL_LINE), "%X/%X",
+					   &hi, &lo) != 2)
+				pg_fatal("invalid data in file \"%s\"", path);
+			backup->incremental_lsn = ((uint64) hi) << 32 | lo;
+		}
+	}
+	if (ferror(fp))
+		pg_fatal("could not read file \"%s\": %m", path);
+	fclose(fp);
+
+	if (!found_start)
+		pg_fatal("could not find START WAL LOCATION in file \"%s\"", path);
+}
+
+/*
+ * Check that the first backup is a full one, and that each of the others is
+ * relative to a point no later than the start of the one before it, so that
+ * every change since the full backup falls in one of them.
+ *
+ * Tablespaces are not supported yet, since that needs their mapping in the
+ * output to be worked out as well.
+ */
+static void
+check_backup_chain(void)
+{
+	char		path[MAXPGPATH];
+
+	if (!XLogRecPtrIsInvalid(backups[0].incremental_lsn))
+		pg_fatal("backup \"%s\" is an incremental backup, but the first backup must be a full backup",
+				 backups[0].path);
+
+	for (int i = 1; i < nbackups; i++)
+	{
+		if (XLogRecPtrIsInvalid(backups[i].incremental_lsn))
+			pg_fatal("backup \"%s\" is a full backup, but only the first backup should be a full backup",
+					 backups[i].path);
+		if (backups[i].incremental_lsn > backups[i - 1].start_lsn)
+			pg_fatal("backup \"%s\" starts from %X/%X, but the backup \"%s\" before it started at %X/%X",
+					 backups[i].path,
+					 LSN_FORMAT_ARGS(backups[i].incremental_lsn),
+					 backups[i - 1].path,
+					 LSN_FORMAT_ARGS(backups[i - 1].start_lsn));
+	}
+
+	for (int i = 0; i < nbackups; i++)
+	{
+		snprintf(path, sizeof(path), "%s/pg_tblspc", backups[i].path);
+		if (pg_check_dir(path) > 1)
+			pg_fatal("backup \"%s\" has tablespaces, which are not supported",
+					 backups[i].path);
+	}
+}
+
+/*
+ * Recreate one directory of the newest backup in the output directory.
+ */
+static void
+combine_directory(const char *relpath)
+{
+	char		srcdir[MAXPGPATH];
+	DIR		   *dir;
+	struct dirent *de;
+	bool		toplevel = (relpath[0] == '\0');
+
+	snprintf(srcdir, sizeof(srcdir), "%s%s%s", backups[nbackups - 1].path,
+			 toplevel ? "" : "/", relpath);
+	dir = opendir(srcdir);
+	if (dir == NULL)
+		pg_fatal("could not open directory \"%s\": %m", srcdir);
+
+	while (errno = 0, (de = readdir(dir)) != NULL)
+	{
+		char		srcpath[MAXPGPATH];
+		char		dstpath[MAXPGPATH];
+		char		subpath[MAXPGPATH];
+		struct stat st;
+
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		/* the manifest does not describe the combined backup */
+		if (toplevel && strcmp(de->d_name, "backup_manifest") == 0)
+			continue;
+
+		snprintf(srcpath, sizeof(srcpath), "%s/%s", srcdir, de->d_name);
+		snprintf(subpath, sizeof(subpath), "%s%s%s", relpath,
+				 toplevel ? "" : "/", de->d_name);
+		if (stat(srcpath, &st) != 0)
+			pg_fatal("could not stat file \"%s\": %m", srcpath);
+
+		if (S_ISDIR(st.st_mode))
+		{
+			snprintf(dstpath, sizeof(dstpath), "%s/%s", output_path, subpath);
+			if (mkdir(dstpath, pg_dir_create_mode) != 0)
+				pg_fatal("could not create directory \"%s\": %m", dstpath);
+			combine_directory(subpath);
+		}
+		else if (!S_ISREG(st.st_mode))
+			pg_log_warning("skipping special file \"%s\"", srcpath);
+		else if (strncmp(de->d_name, INCREMENTAL_PREFIX,
+						 INCREMENTAL_PREFIX_LENGTH) == 0)
+		{
+			const char *name = de->d_name + INCREMENTAL_PREFIX_LENGTH;
+
+			snprintf(dstpath, sizeof(dstpath), "%s/%s%s%s", output_path,
+					 relpath, toplevel ? "" : "/", name);
+			reconstruct_file(relpath, name, dstpath);
+		}
+		else
+		{
+			snprintf(dstpath, sizeof(dstpath), "%s/%s", output_path, subpath);
+			if (toplevel && strcmp(de->d_name, "backup_label") == 0)
+				copy_backup_label(srcpath, dstpath);
+			else
+				copy_file(srcpath, dstpath);
+		}
+	}
+
+	if (errno)
+		pg_fatal("could not read directory \"%s\": %m", srcdir);
+	if (closedir(dir))
+		pg_fatal("could not close directory \"%s\": %m", srcdir);
+}
+
+/*
+ * Copy a file as is.
+ */
+static void
+copy_file(const char *src, const char *dst)
+{
+	char	   *buf = pg_malloc(COPY_CHUNK_SIZE);
+	int			srcfd;
+	int			dstfd;
+	ssize_t		rb;
+
+	srcfd = open(src, O_RDONLY | PG_BINARY, 0);
+	if (srcfd < 0)
+		pg_fatal("could not open file \"%s\": %m", src);
+	dstfd = open(dst, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+				 pg_file_create_mode);
+	if (dstfd < 0)
+		pg_fatal("could not create file \"%s\": %m", dst);
+
+	while ((rb = read(srcfd, buf, COPY_CHUNK_SIZE)) > 0)
+	{
+		if (write(dstfd, buf, rb) != rb)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			pg_fatal("could not write file \"%s\": %m", dst);
+		}
+	}
+	if (rb < 0)
+		pg_fatal("could not read file \"%s\": %m", src);
+
+	if (close(dstfd) != 0)
+		pg_fatal("could not close file \"%s\": %m", dst);
+	close(srcfd);
+	pg_free(buf);
+}
+
+/*
+ * Copy the newest backup's backup_label, leaving out the line that marks it
+ * as incremental: the combined backup is a full one.
+ */
+static void
+copy_backup_label(const char *src, const char *dst)
+{
+	char		line[MAXPGPATH];
+	FILE	   *in;
+	FILE	   *out;
+
+	in = fopen(src, "r");
+	if (in == NULL)
+		pg_fatal("could not open file \"%s\": %m", src);
+	out = fopen(dst, "w");
+	if (out == NULL)
+		pg_fatal("could not create file \"%s\": %m", dst);
+
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		if (strncmp(line, INCREMENTAL_LABEL_LINE,
+					strlen(INCREMENTAL_LABEL_LINE)) == 0)
+			continue;
+		if (fputs(line, out) < 0)
+			pg_fatal("could not write file \"%s\": %m", dst);
+	}
+	if (ferror(in))
+		pg_fatal("could not read file \"%s\": %m", src);
+
+	if (fclose(out) != 0)
+		pg_fatal("could not close file \"%s\": %m", dst);
+	fclose(in);
+}
+
+/*
+ * Rebuild the relation file reldir/name, which the newest backup sent
+ * incrementally, into dst.
+ *
+ * Each block is looked for from the newest backup back: an incremental copy
+ * either includes it, or, if the file was shorter than that at the time,
+ * shows that it must be zeroes (the file was truncated and extended again
+ * later); otherwise an older backup has it.  A block past the end of the
+ * file in the full backup, or in a backup that doesn't have the file at
+ * all, didn't exist yet then, and is written as zeroes, like the server
+ * would have had it when it was first written out.
+ */
+static void
+reconstruct_file(const char *reldir, const char *name, const char *dst)
+{
+	block_source *sources;
+	int			nsources = 0;
+	BlockNumber nblocks;
+	char	   *buf = pg_malloc(BLCKSZ);
+	int			dstfd;
+
+	sources = pg_malloc0(sizeof(block_source) * nbackups);
+	for (int i = nbackups - 1; i >= 0; i--)
+	{
+		if (!open_block_source(&sources[nsources], reldir, name, i))
+			break;
+		if (!sources[nsources++].incremental)
+			break;
+	}
+	if (nsources == 0 || !sources[0].incremental)
+		pg_fatal("could not find incremental file for \"%s/%s\"", reldir, name);
+	nblocks = sources[0].nblocks;
+
+	dstfd = open(dst, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+				 pg_file_create_mode);
+	if (dstfd < 0)
+		pg_fatal("could not create file \"%s\": %m", dst);
+
+	for (BlockNumber blkno = 0; blkno < nblocks; blkno++)
+	{
+		bool		found = false;
+
+		for (int i = 0; i < nsources && !found; i++)
+		{
+			block_source *source = &sources[i];
+
+			if (blkno >= source->nblocks)
+				break;			/* zeroes */
+
+			if (source->incremental)
+			{
+				BlockNumber *match;
+
+				match = bsearch(&blkno, source->blocks, source->nchanged,
+								sizeof(BlockNumber), compare_block_numbers);
+				if (match == NULL)
+					continue;
+				read_block(source,
+						   INCREMENTAL_HEADER_SIZE +
+						   sizeof(BlockNumber) * source->nchanged +
+						   (off_t) BLCKSZ * (match - source->blocks),
+						   buf);
+			}
+			else
+				read_block(source, (off_t) BLCKSZ * blkno, buf);
+			found = true;
+		}
+		if (!found)
+			memset(buf, 0, BLCKSZ);
+
+		if (write(dstfd, buf, BLCKSZ) != BLCKSZ)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			pg_fatal("could not write file \"%s\": %m", dst);
+		}
+	}
+
+	if (close(dstfd) != 0)
+		pg_fatal("could not close file \"%s\": %m", dst);
+
+	for (int i = 0; i < nsources; i++)
+	{
+		close(sources[i].fd);
+		pg_free(sources[i].path);
+		if (sources[i].blocks)
+			pg_free(sources[i].blocks);
+	}
+	pg_free(sources);
+	pg_free(buf);
+}
+
+/*
+ * Open the copy of reldir/name in the given backup, and for an incremental
+ * copy read its header.  Returns false if the backup has no copy at all.
+ */
+static bool
+open_block_source(block_source *source, const char *reldir, const char *name,
+				  int backupno)
+{
+	char		path[MAXPGPATH];
+	const char *sep = reldir[0] == '\0' ? "" : "/";
+	struct stat st;
+
+	snprintf(path, sizeof(path), "%s/%s%s%s%s", backups[backupno].path,
+			 reldir, sep, INCREMENTAL_PREFIX, name);
+	source->fd = open(path, O_RDONLY | PG_BINARY, 0);
+	if (source->fd >= 0)
+	{
+		uint32		header[3];
+		ssize_t		rb;
+
+		source->path = pg_strdup(path);
+		source->incremental = true;
+
+		rb = read(source->fd, header, sizeof(header));
+		if (rb < 0)
+			pg_fatal("could not read file \"%s\": %m", path);
+		if (rb != sizeof(header) || header[0] != INCREMENTAL_MAGIC)
+			pg_fatal("file \"%s\" is not a valid incremental file", path);
+		source->nchanged = header[1];
+		source->nblocks = header[2];
+		if (source->nchanged > source->nblocks)
+			pg_fatal("file \"%s\" is not a valid incremental file", path);
+
+		source->blocks = pg_malloc(sizeof(BlockNumber) *
+								   Max(source->nchanged, 1));
+		rb = read(source->fd, source->blocks,
+				  sizeof(BlockNumber) * source->nchanged);
+		if (rb < 0)
+			pg_fatal("could not read file \"%s\": %m", path);
+		if (rb != sizeof(BlockNumber) * source->nchanged)
+			pg_fatal("file \"%s\" is not a valid incremental file", path);
+		return true;
+	}
+	if (errno != ENOENT)
+		pg_fatal("could not open file \"%s\": %m", path);
+
+	snprintf(path, sizeof(path), "%s/%s%s%s", backups[backupno].path,
+			 reldir, sep, name);
+	source->fd = open(path, O_RDONLY | PG_BINARY, 0);
+	if (source->fd < 0)
+	{
+		if (errno == ENOENT)
+			return false;
+		pg_fatal("could not open file \"%s\": %m", path);
+	}
+	if (fstat(source->fd, &st) != 0)
+		pg_fatal("could not stat file \"%s\": %m", path);
+
+	source->path = pg_strdup(path);
+	source->incremental = false;
+	source->nblocks = st.st_size / BLCKSZ;
+	return true;
+}
+
+/*
+ * Read one block at the given offset of a source file.
+ */
+static void
+read_block(block_source *source, off_t offset, char *buf)
+{
+	ssize_t		rb;
+
+	rb = pg_pread(source->fd, buf, BLCKSZ, offset);
+	if (rb < 0)
+		pg_fatal("could not read file \"%s\": %m", source->path);
+	if (rb != BLCKSZ)
+		pg_fatal("could not read file \"%s\": read %zd of %d",
+				 source->path, rb, BLCKSZ);
+}
+
+static int
+compare_block_numbers(const void *a, const void *b)
+{
+	BlockNumber aa = *(const BlockNumber *) a;
+	BlockNumber bb = *(const BlockNumber *) b;
+
+	if (aa < bb)
+		return -1;
+	if (aa > bb)
+		return 1;
+	return 0;
+}
+
+static void
+usage(void)
+{
+	printf(_("%s combines a full backup and incremental backups taken after it.\n\n"), progname);
+	printf(_("Usage:\n  %s [OPTION]... FULLBACKUP INCREMENTALBACKUP...\n\n"), progname);
+	printf(_("The backups are to be given oldest first.\n\n"));
+	printf(_("Options:\n"));
+	printf(_("  -N, --no-sync               do not wait for changes to be written safely to disk\n"));
+	printf(_("  -o, --output=DIRECTORY      write the combined backup to DIRECTORY\n"));
+	printf(_("  -V, --version               output version information, then exit\n"));
+	printf(_("  -?, --help                  show this help, then exit\n"));
+	printf(_("\nReport bugs to <%s>.\n"), PACKAGE_BUGREPORT);
+	printf(_("%s home page: <%s>\n"), PACKAGE_NAME, PACKAGE_URL);
+}
@@ -0,0 +1,136 @@
+# Copyright (c) 2023, PostgreSQL Global Development Group
+
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+program_help_ok('pg_combinebackup');
+program_version_ok('pg_combinebackup');
+program_options_handling_ok('pg_combinebackup');
+
+my $tempdir = PostgreSQL::Test::Utils::tempdir;
+
+# Set up an instance.
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init('allows_streaming' => 1);
+$node->start();
+my $backupdir = $node->backup_dir;
+
+# Return the START WAL LOCATION of a backup, from its backup_label.
+sub backup_start_lsn
+{
+	my ($backup_name) = @_;
+	my $label = slurp_file("$backupdir/$backup_name/backup_label");
+
+	$label =~ m/^START WAL LOCATION: ([0-9A-F]+\/[0-9A-F]+)/m
+	  or die "could not find START WAL LOCATION in backup_label";
+	return $1;
+}
+
+# Take a full backup, then two incremental backups, each based on the one
+# before, changing some data in between.
+$node->safe_psql('postgres', <<EOM);
+CREATE TABLE t1 (a int, b text);
+INSERT INTO t1 SELECT g, repeat('x', 100) FROM generate_series(1, 10000) g;
+CREATE TABLE t2 (a int);
+INSERT INTO t2 SELECT generate_series(1, 1000);
+EOM
+$node->backup('full');
+
+$node->safe_psql('postgres', <<EOM);
+UPDATE t1 SET b = 'updated' WHERE a % 100 = 0;
+INSERT INTO t2 SELECT generate_series(1001, 2000);
+CREATE TABLE t3 AS SELECT generate_series(1, 500) AS a;
+EOM
+$node->backup('incr1',
+	backup_options => [ '--incremental', backup_start_lsn('full') ]);
+ok(-f "$backupdir/incr1/backup_label", 'first incremental backup taken');
+like(
+	slurp_file("$backupdir/incr1/backup_label"),
+	qr/^INCREMENTAL FROM LSN: /m,
+	'backup_label of incremental backup records its base');
+
+$node->safe_psql('postgres', <<EOM);
+DELETE FROM t1 WHERE a > 9000;
+DROP TABLE t2;
+INSERT INTO t3 SELECT generate_series(501, 1000);
+EOM
+$node->backup('incr2',
+	backup_options => [ '--incremental', backup_start_lsn('incr1') ]);
+
+my $expected = $node->safe_psql('postgres', <<EOM);
+SELECT count(*), sum(a), count(*) FILTER (WHERE b = 'updated') FROM t1;
+SELECT count(*), sum(a) FROM t3;
+SELECT count(*) FROM pg_class WHERE relname = 't2';
+EOM
+
+# Combine them, and check that the result has the data of the last backup.
+$node->command_ok(
+	[
+		'pg_combinebackup', '--no-sync',
+		'-o', "$backupdir/combined",
+		"$backupdir/full", "$backupdir/incr1",
+		"$backupdir/incr2"
+	],
+	'pg_combinebackup runs');
+unlike(
+	slurp_file("$backupdir/combined/backup_label"),
+	qr/^INCREMENTAL FROM LSN: /m,
+	'combined backup is a full backup');
+
+my $restored = PostgreSQL::Test::Cluster->new('restored');
+$restored->init_from_backup($node, 'combined', standby => 0);
+$restored->start;
+
+my $result = $restored->safe_psql('postgres', <<EOM);
+SELECT count(*), sum(a), count(*) FILTER (WHERE b = 'updated') FROM t1;
+SELECT count(*), sum(a) FROM t3;
+SELECT count(*) FROM pg_class WHERE relname = 't2';
+EOM
+is($result, $expected, 'combined backup has the same data');
+
+$restored->stop;
+
+# A chain with a gap is refused.
+$node->command_fails_like(
+	[
+		'pg_combinebackup', '--no-sync',
+		'-o', "$tempdir/gap",
+		"$backupdir/full", "$backupdir/incr2"
+	],
+	qr/starts from .*, but the backup .* before it started at/,
+	'missing incremental backup in the chain is detected');
+
+# The first backup must be a full one.
+$node->command_fails_like(
+	[
+		'pg_combinebackup', '--no-sync',
+		'-o', "$tempdir/nofull",
+		"$backupdir/incr1", "$backupdir/incr2"
+	],
+	qr/is an incremental backup, but the first backup must be a full backup/,
+	'chain without a full backup is detected');
+
+# Only the first backup may be a full one.
+$node->command_fails_like(
+	[
+		'pg_combinebackup', '--no-sync',
+		'-o', "$tempdir/twofull",
+		"$backupdir/full", "$backupdir/combined"
+	],
+	qr/is a full backup, but only the first backup should be a full backup/,
+	'full backup in the middle of the chain is detected');
+
+# The output directory must be empty.
+$node->command_fails_like(
+	[
+		'pg_combinebackup', '--no-sync',
+		'-o', "$backupdir/combined",
+		"$backupdir/full", "$backupdir/incr1"
+	],
+	qr/exists but is not empty/,
+	'non-empty output directory is refused');
+
+done_testing();
@@ -21,7 +21,9 @@
  *
  * The leader process dispatches an individual work item to one of the worker
  * processes in DispatchJobForTocEntry().  We send a command string such as
- * "DUMP 1234" or "RESTORE 1234", where 1234 is the TocEntry ID.
+ * "DUMP 1234" or "RESTORE 1234", where 1234 is the TocEntry ID.  A RESTORE
+ * of an index build may be followed by its maintenance_work_mem and
+ * max_parallel_maintenance_workers grants, as in "RESTORE 1234 256 2".
  * The worker process receives and decodes the command and passes it to the
  * routine pointed to by AH->WorkerJobDumpPtr or AH->WorkerJobRestorePtr,
  * which are routines of the current archive format.  That routine performs
@@ -1111,7 +1113,14 @@ buildWorkerCommand(ArchiveHandle *AH, TocEntry *te, T_Action act,
 	if (act == ACT_DUMP)
 		snprintf(buf, buflen, "DUMP %d", te->dumpId);
 	else if (act == ACT_RESTORE)
-		snprintf(buf, buflen, "RESTORE %d", te->dumpId);
+	{
+		/* pass along the item's share of the index build budget, if any */
+		if (te->maintMemGrant > 0 || te->maintWorkersGrant > 0)
+			snprintf(buf, buflen, "RESTORE %d %d %d", te->dumpId,
+					 te->maintMemGrant, te->maintWorkersGrant);
+		else
+			snprintf(buf, buflen, "RESTORE %d", te->dumpId);
+	}
 	else
 		Assert(false);
 }
@@ -1125,6 +1134,8 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 {
 	DumpId		dumpId;
 	int			nBytes;
+	int			memGrant = 0;
+	int			workersGrant = 0;
 
 	if (messageStartsWith(msg, "DUMP "))
 	{
@@ -1137,10 +1148,14 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 	else if (messageStartsWith(msg, "RESTORE "))
 	{
 		*act = ACT_RESTORE;
-		sscanf(msg, "RESTORE %d%n", &dumpId, &nBytes);
+		if (sscanf(msg, "RESTORE %d %d %d%n", &dumpId, &memGrant,
+				   &workersGrant, &nBytes) != 3)
+			sscanf(msg, "RESTORE %d%n", &dumpId, &nBytes);
 		Assert(nBytes == strlen(msg));
 		*te = getTocEntryByDumpId(AH, dumpId);
 		Assert(*te != NULL);
+		(*te)->maintMemGrant = memGrant;
+		(*te)->maintWorkersGrant = workersGrant;
 	}
 	else
 		pg_fatal("unrecognized command received from leader: \"%s\"",
@@ -154,6 +154,10 @@ typedef struct _restoreOptions
 	int			enable_row_security;
 	int			sequence_data;	/* dump sequence data even in schema-only mode */
 	int			binary_upgrade;
+
+	/* budget for index builds running concurrently; see restore_toc_entry */
+	int			maint_mem_budget;	/* in MB; 0 = don't set */
+	int			maint_workers_budget;	/* -1 = don't set */
 } RestoreOptions;
 
 typedef struct _dumpOptions
@@ -169,6 +173,7 @@ typedef struct _dumpOptions
 	bool		aclsSkip;
 	const char *lockWaitTimeout;
 	int			dump_inserts;	/* 0 = COPY, otherwise rows per INSERT */
+	int			table_chunk_size;	/* in MB; 0 = dump tables whole */
 
 	/* flags for various command-line long options */
 	int			disable_dollar_quoting;
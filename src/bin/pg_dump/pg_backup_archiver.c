@@ -121,6 +121,10 @@ static void move_to_ready_list(TocEntry *pending_list,
 							   RestorePass pass);
 static TocEntry *pop_next_work_item(ParallelReadyList *ready_list,
 									ParallelState *pstate);
+static bool is_index_build(TocEntry *te);
+static void assign_maintenance_grant(ArchiveHandle *AH, TocEntry *te,
+									 ParallelReadyList *ready_list,
+									 ParallelState *pstate);
 static void mark_dump_job_done(ArchiveHandle *AH,
 							   TocEntry *te,
 							   int status,
@@ -798,6 +802,26 @@ restore_toc_entry(ArchiveHandle *AH, TocEntry *te, bool is_parallel)
 			pg_log_info("creating %s \"%s\"",
 						te->desc, te->tag);
 
+		/*
+		 * Index builds get their share of the maintenance budget, if one was
+		 * given.  That's all of it when restoring serially; in parallel
+		 * restore, the leader decided the share when dispatching the item.
+		 */
+		if (is_index_build(te))
+		{
+			if (!is_parallel)
+			{
+				te->maintMemGrant = ropt->maint_mem_budget;
+				te->maintWorkersGrant = ropt->maint_workers_budget;
+			}
+			if (ropt->maint_mem_budget > 0)
+				ahprintf(AH, "SET maintenance_work_mem = '%dMB';\n",
+						 te->maintMemGrant);
+			if (ropt->maint_workers_budget >= 0)
+				ahprintf(AH, "SET max_parallel_maintenance_workers = %d;\n",
+						 te->maintWorkersGrant);
+		}
+
 		_printTocEntry(AH, te, false);
 		defnDumped = true;
 
@@ -992,6 +1016,7 @@ NewRestoreOptions(void)
 	opts->dumpSections = DUMP_UNSECTIONED;
 	opts->compression_spec.algorithm = PG_COMPRESSION_NONE;
 	opts->compression_spec.level = 0;
+	opts->maint_workers_budget = -1;
 
 	return opts;
 }
@@ -1862,7 +1887,10 @@ buildTocEntryArrays(ArchiveHandle *AH)
 		 * tableDataId provides the TABLE DATA item's dump ID for each TABLE
 		 * TOC entry that has a DATA item.  We compute this by reversing the
 		 * TABLE DATA item's dependency, knowing that a TABLE DATA item has
-		 * just one dependency and it is the TABLE item.
+		 * just one dependency and it is the TABLE item.  A table whose data
+		 * was dumped in chunks has several TABLE DATA items; tableDataId
+		 * gives the first, and the others are chained from it through
+		 * nextDataChunk.
 		 */
 		if (strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
 		{
@@ -1876,7 +1904,16 @@ buildTocEntryArrays(ArchiveHandle *AH)
 			if (tableId <= 0 || tableId > maxDumpId)
 				pg_fatal("bad table dumpId for TABLE DATA item");
 
-			AH->tableDataId[tableId] = te->dumpId;
+			if (AH->tableDataId[tableId] == 0)
+				AH->tableDataId[tableId] = te->dumpId;
+			else
+			{
+				TocEntry   *chunkte = AH->tocsByDumpId[AH->tableDataId[tableId]];
+
+				while (chunkte->nextDataChunk != 0)
+					chunkte = AH->tocsByDumpId[chunkte->nextDataChunk];
+				chunkte->nextDataChunk = te->dumpId;
+			}
 		}
 	}
 }
@@ -4091,6 +4128,8 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 						next_work_item->dumpId,
 						next_work_item->desc, next_work_item->tag);
 
+			assign_maintenance_grant(AH, next_work_item, &ready_list, pstate);
+
 			/* Dispatch to some worker */
 			DispatchJobForTocEntry(AH, pstate, next_work_item, ACT_RESTORE,
 								   mark_restore_job_done, &ready_list);
@@ -4423,6 +4462,86 @@ pop_next_work_item(ParallelReadyList *ready_list,
 	return NULL;
 }
 
+/*
+ * Does this item build an index?  Those are the items that run with the
+ * maintenance budget given by --maintenance-work-mem and
+ * --maintenance-workers.
+ */
+static bool
+is_index_build(TocEntry *te)
+{
+	/* CONSTRAINT covers primary keys and unique and exclusion constraints */
+	return (strcmp(te->desc, "INDEX") == 0 ||
+			strcmp(te->desc, "CONSTRAINT") == 0);
+}
+
+/*
+ * Decide the share of the maintenance budget that an index build about to
+ * be dispatched gets.
+ *
+ * The budget, less what the index builds already running hold, is split
+ * between this item and the largest index builds that are ready to run on
+ * the other idle workers, in proportion to the size of their tables.  Since
+ * the ready list is processed largest-first, that gives the big builds more
+ * memory and parallel workers, without going over the budget as long as
+ * there's at least 1MB for each.
+ */
+static void
+assign_maintenance_grant(ArchiveHandle *AH, TocEntry *te,
+						 ParallelReadyList *ready_list,
+						 ParallelState *pstate)
+{
+	RestoreOptions *ropt = AH->public.ropt;
+	int			mem_free = ropt->maint_mem_budget;
+	int			workers_free = ropt->maint_workers_budget;
+	int			nidle = 0;
+	double		total_size;
+	double		share;
+
+	te->maintMemGrant = 0;
+	te->maintWorkersGrant = 0;
+
+	if (!is_index_build(te) ||
+		(ropt->maint_mem_budget <= 0 && ropt->maint_workers_budget < 0))
+		return;
+
+	for (int k = 0; k < pstate->numWorkers; k++)
+	{
+		TocEntry   *running_te = pstate->te[k];
+
+		if (running_te == NULL)
+			nidle++;
+		else if (is_index_build(running_te))
+		{
+			mem_free -= running_te->maintMemGrant;
+			workers_free -= running_te->maintWorkersGrant;
+		}
+	}
+
+	/* count the item itself as at least one page, so that shares add up */
+	total_size = Max(te->dataLength, 1);
+	for (int i = ready_list->first_te;
+		 i <= ready_list->last_te && nidle > 1; i++)
+	{
+		TocEntry   *ready_te = ready_list->tes[i];
+
+		if (is_index_build(ready_te))
+		{
+			total_size += Max(ready_te->dataLength, 1);
+			nidle--;
+		}
+	}
+	share = Max(te->dataLength, 1) / total_size;
+
+	if (ropt->maint_mem_budget > 0)
+		te->maintMemGrant = Max((int) (mem_free * share), 1);
+	if (ropt->maint_workers_budget >= 0)
+		te->maintWorkersGrant = Max((int) (workers_free * share), 0);
+
+	pg_log_debug("item %d gets maintenance_work_mem %dMB and %d parallel workers",
+				 te->dumpId, te->maintMemGrant, te->maintWorkersGrant);
+}
+
 
 /*
  * Restore a single TOC item in parallel with others
@@ -4635,9 +4754,14 @@ repoint_table_dependencies(ArchiveHandle *AH)
 
 	for (te = AH->toc->next; te != AH->toc; te = te->next)
 	{
+		int			nDeps;
+
 		if (te->section != SECTION_POST_DATA)
 			continue;
-		for (i = 0; i < te->nDeps; i++)
+
+		/* chunks appended below need no repointing */
+		nDeps = te->nDeps;
+		for (i = 0; i < nDeps; i++)
 		{
 			olddep = te->dependencies[i];
 			if (olddep <= AH->maxDumpId &&
@@ -4650,6 +4774,20 @@ repoint_table_dependencies(ArchiveHandle *AH)
 				te->dataLength = Max(te->dataLength, tabledatate->dataLength);
 				pg_log_debug("transferring dependency %d -> %d to %d",
 							 te->dumpId, olddep, tabledataid);
+
+				/* if the data is in chunks, wait for all of them */
+				while (tabledatate->nextDataChunk != 0)
+				{
+					tabledataid = tabledatate->nextDataChunk;
+					tabledatate = AH->tocsByDumpId[tabledataid];
+
+					te->dependencies = pg_realloc(te->dependencies,
+												  (te->nDeps + 1) * sizeof(DumpId));
+					te->dependencies[te->nDeps++] = tabledataid;
+					te->dataLength = Max(te->dataLength, tabledatate->dataLength);
+					pg_log_debug("adding dependency %d -> %d",
+								 te->dumpId, tabledataid);
+				}
 			}
 		}
 	}
@@ -4771,7 +4909,12 @@ mark_create_done(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->created = true;
+		/*
+		 * The flag lets the data be loaded after a TRUNCATE, which must not
+		 * be done when it's in chunks restored separately.
+		 */
+		if (ted->nextDataChunk == 0)
+			ted->created = true;
 	}
 }
 
@@ -4789,7 +4932,13 @@ inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->reqs = 0;
+		for (;;)
+		{
+			ted->reqs = 0;
+			if (ted->nextDataChunk == 0)
+				break;
+			ted = AH->tocsByDumpId[ted->nextDataChunk];
+		}
 	}
 }
 
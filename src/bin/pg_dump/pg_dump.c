@@ -431,6 +431,7 @@ main(int argc, char **argv)
 		{"table-and-children", required_argument, NULL, 12},
 		{"exclude-table-and-children", required_argument, NULL, 13},
 		{"exclude-table-data-and-children", required_argument, NULL, 14},
+		{"table-chunk-size", required_argument, NULL, 15},
 
 		{NULL, 0, NULL, 0}
 	};
@@ -657,6 +658,12 @@ main(int argc, char **argv)
 										  optarg);
 				break;
 
+			case 15:			/* split large tables into chunks */
+				if (!option_parse_int(optarg, "--table-chunk-size", 1, INT_MAX,
+									  &dopt.table_chunk_size))
+					exit_nicely(1);
+				break;
+
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -812,6 +819,13 @@ main(int argc, char **argv)
 	if (fout->isStandby)
 		dopt.no_unlogged_table_data = true;
 
+	/*
+	 * Table chunks are read with TID range scans, without which each chunk
+	 * would scan the whole table.
+	 */
+	if (dopt.table_chunk_size > 0 && fout->remoteVersion < 140000)
+		pg_fatal("option --table-chunk-size requires server version 14 or later");
+
 	/*
 	 * Find the last built-in OID, if needed (prior to 8.1)
 	 *
@@ -1127,6 +1141,8 @@ help(const char *progname)
 			 "                               match at least one entity each\n"));
 	printf(_("  --table-and-children=PATTERN dump only the specified table(s), including\n"
 			 "                               child and partition tables\n"));
+	printf(_("  --table-chunk-size=MB        dump the data of tables larger than MB megabytes\n"
+			 "                               in chunks, to be dumped and restored in parallel\n"));
 	printf(_("  --use-set-session-authorization\n"
 			 "                               use SET SESSION AUTHORIZATION commands instead of\n"
 			 "                               ALTER OWNER commands to set ownership\n"));
@@ -2589,44 +2605,103 @@ dumpTableData(Archive *fout, const TableDataInfo *tdinfo)
 	 */
 	if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
 	{
-		TocEntry   *te;
-
-		te = ArchiveEntry(fout, tdinfo->dobj.catId, tdinfo->dobj.dumpId,
-						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
-									   .namespace = tbinfo->dobj.namespace->dobj.name,
-									   .owner = tbinfo->rolname,
-									   .description = "TABLE DATA",
-									   .section = SECTION_DATA,
-									   .createStmt = tdDefn,
-									   .copyStmt = copyStmt,
-									   .deps = &(tbinfo->dobj.dumpId),
-									   .nDeps = 1,
-									   .dumpFn = dumpFn,
-									   .dumpArg = tdinfo));
+		BlockNumber relpages = (BlockNumber) tbinfo->relpages;
+		BlockNumber toastpages = (BlockNumber) tbinfo->toastpages;
+		uint64		chunkpages = 0;
+		int			nchunks = 1;
 
 		/*
-		 * Set the TocEntry's dataLength in case we are doing a parallel dump
-		 * and want to order dump jobs by table size.  We choose to measure
-		 * dataLength in table pages (including TOAST pages) during dump, so
-		 * no scaling is needed.
-		 *
-		 * However, relpages is declared as "integer" in pg_class, and hence
-		 * also in TableInfo, but it's really BlockNumber a/k/a unsigned int.
-		 * Cast so that we get the right interpretation of table sizes
-		 * exceeding INT_MAX pages.
+		 * With --table-chunk-size, split the data of big enough heap tables
+		 * into ranges of blocks, each its own TABLE DATA entry, so that they
+		 * can be dumped and restored in parallel.  Tables with a filter
+		 * condition are dumped whole.  The last chunk is open-ended, in case
+		 * the table grew since relpages was last updated.
 		 */
-		te->dataLength = (BlockNumber) tbinfo->relpages;
-		te->dataLength += (BlockNumber) tbinfo->toastpages;
+		if (dopt->table_chunk_size > 0 &&
+			tbinfo->relkind == RELKIND_RELATION &&
+			tbinfo->amname != NULL && strcmp(tbinfo->amname, "heap") == 0 &&
+			tdinfo->filtercond == NULL)
+		{
+			chunkpages = (uint64) dopt->table_chunk_size * (1024 * 1024 / BLCKSZ);
+			if (relpages > chunkpages)
+				nchunks = (relpages + chunkpages - 1) / chunkpages;
+		}
 
-		/*
-		 * If pgoff_t is only 32 bits wide, the above refinement is useless,
-		 * and instead we'd better worry about integer overflow.  Clamp to
-		 * INT_MAX if the correct result exceeds that.
-		 */
-		if (sizeof(te->dataLength) == 4 &&
-			(tbinfo->relpages < 0 || tbinfo->toastpages < 0 ||
-			 te->dataLength < 0))
-			te->dataLength = INT_MAX;
+		for (int i = 0; i < nchunks; i++)
+		{
+			const TableDataInfo *chunk = tdinfo;
+			DumpId		dumpId = tdinfo->dobj.dumpId;
+			TocEntry   *te;
+
+			if (nchunks > 1)
+			{
+				TableDataInfo *cinfo;
+
+				cinfo = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+				memcpy(cinfo, tdinfo, sizeof(TableDataInfo));
+				if (i == 0)
+					cinfo->filtercond = psprintf("WHERE ctid < '(" UINT64_FORMAT ",0)'",
+												 chunkpages);
+				else if (i < nchunks - 1)
+					cinfo->filtercond = psprintf("WHERE ctid >= '(" UINT64_FORMAT ",0)' AND ctid < '(" UINT64_FORMAT ",0)'",
+												 i * chunkpages, (i + 1) * chunkpages);
+				else
+					cinfo->filtercond = psprintf("WHERE ctid >= '(" UINT64_FORMAT ",0)'",
+												 i * chunkpages);
+
+				/* the first chunk keeps the dump ID of the table's data */
+				if (i > 0)
+					dumpId = cinfo->dobj.dumpId = createDumpId();
+				chunk = cinfo;
+			}
+
+			te = ArchiveEntry(fout, chunk->dobj.catId, dumpId,
+							  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+										   .namespace = tbinfo->dobj.namespace->dobj.name,
+										   .owner = tbinfo->rolname,
+										   .description = "TABLE DATA",
+										   .section = SECTION_DATA,
+										   .createStmt = tdDefn,
+										   .copyStmt = copyStmt,
+										   .deps = &(tbinfo->dobj.dumpId),
+										   .nDeps = 1,
+										   .dumpFn = dumpFn,
+										   .dumpArg = chunk));
+
+			/*
+			 * Set the TocEntry's dataLength in case we are doing a parallel
+			 * dump and want to order dump jobs by table size.  We choose to
+			 * measure dataLength in table pages (including TOAST pages)
+			 * during dump, so no scaling is needed.  A chunk gets its share
+			 * of those.
+			 *
+			 * However, relpages is declared as "integer" in pg_class, and
+			 * hence also in TableInfo, but it's really BlockNumber a/k/a
+			 * unsigned int.  Cast so that we get the right interpretation of
+			 * table sizes exceeding INT_MAX pages.
+			 */
+			if (nchunks > 1)
+			{
+				te->dataLength = (i < nchunks - 1) ? chunkpages :
+					relpages - i * chunkpages;
+				te->dataLength += toastpages / nchunks;
+			}
+			else
+			{
+				te->dataLength = relpages;
+				te->dataLength += toastpages;
+			}
+
+			/*
+			 * If pgoff_t is only 32 bits wide, the above refinement is
+			 * useless, and instead we'd better worry about integer overflow.
+			 * Clamp to INT_MAX if the correct result exceeds that.
+			 */
+			if (sizeof(te->dataLength) == 4 &&
+				(tbinfo->relpages < 0 || tbinfo->toastpages < 0 ||
+				 te->dataLength < 0))
+				te->dataLength = INT_MAX;
+		}
 	}
 
 	destroyPQExpBuffer(copyBuf);
@@ -16074,6 +16149,9 @@ dumpTableSchema(Archive *fout, const TableInfo *tbinfo)
 					case 'l':
 						cmname = "lz4";
 						break;
+					case 'z':
+						cmname = "zstd";
+						break;
 					default:
 						cmname = NULL;
 						break;
@@ -117,6 +117,8 @@ main(int argc, char **argv)
 		{"no-tablespaces", no_argument, &outputNoTablespaces, 1},
 		{"role", required_argument, NULL, 2},
 		{"section", required_argument, NULL, 3},
+		{"maintenance-work-mem", required_argument, NULL, 4},
+		{"maintenance-workers", required_argument, NULL, 5},
 		{"strict-names", no_argument, &strict_names, 1},
 		{"use-set-session-authorization", no_argument, &use_setsessauth, 1},
 		{"no-comments", no_argument, &no_comments, 1},
@@ -286,6 +288,20 @@ main(int argc, char **argv)
 				set_dump_section(optarg, &(opts->dumpSections));
 				break;
 
+			case 4:				/* memory budget for index builds */
+				if (!option_parse_int(optarg, "--maintenance-work-mem", 1,
+									  INT_MAX / 1024,
+									  &opts->maint_mem_budget))
+					exit(1);
+				break;
+
+			case 5:				/* parallel workers budget for index builds */
+				if (!option_parse_int(optarg, "--maintenance-workers", 0,
+									  1024,
+									  &opts->maint_workers_budget))
+					exit(1);
+				break;
+
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -464,6 +480,10 @@ usage(const char *progname)
 	printf(_("  --disable-triggers           disable triggers during data-only restore\n"));
 	printf(_("  --enable-row-security        enable row security\n"));
 	printf(_("  --if-exists                  use IF EXISTS when dropping objects\n"));
+	printf(_("  --maintenance-work-mem=MB    total maintenance_work_mem to share among the\n"
+			 "                               index builds running at the same time\n"));
+	printf(_("  --maintenance-workers=NUM    total max_parallel_maintenance_workers to share\n"
+			 "                               among the index builds running at the same time\n"));
 	printf(_("  --no-comments                do not restore comments\n"));
 	printf(_("  --no-data-for-failed-tables  do not restore data of tables that could not be\n"
 			 "                               created\n"));
@@ -11,6 +11,7 @@ use Test::More;
 my $dbname1 = 'regression_src';
 my $dbname2 = 'regression_dest1';
 my $dbname3 = 'regression_dest2';
+my $dbname4 = 'regression_dest3';
 
 my $node = PostgreSQL::Test::Cluster->new('main');
 $node->init;
@@ -21,6 +22,7 @@ my $backupdir = $node->backup_dir;
 $node->run_log([ 'createdb', $dbname1 ]);
 $node->run_log([ 'createdb', $dbname2 ]);
 $node->run_log([ 'createdb', $dbname3 ]);
+$node->run_log([ 'createdb', $dbname4 ]);
 
 $node->safe_psql(
 	$dbname1,
@@ -44,8 +46,15 @@ create table tht_p1 partition of tht for values with (modulus 3, remainder 0);
 create table tht_p2 partition of tht for values with (modulus 3, remainder 1);
 create table tht_p3 partition of tht for values with (modulus 3, remainder 2);
 insert into tht select (x%10)::text::digit, x from generate_series(1,1000) x;
+
+-- table of a few megabytes, to be dumped in chunks
+create table tchunk (id int primary key, filler text);
+insert into tchunk select x, repeat('x', 100) from generate_series(1,30000) x;
 	});
 
+# chunks are sized from relpages
+$node->safe_psql($dbname1, 'vacuum analyze tchunk');
+
 $node->command_ok(
 	[
 		'pg_dump', '-Fd', '--no-sync', '-j2', '-f', "$backupdir/dump1",
@@ -78,4 +87,34 @@ $node->command_ok(
 	],
 	'parallel restore as inserts');
 
+$node->command_ok(
+	[
+		'pg_dump', '-Fd',
+		'--no-sync', '-j2',
+		'-f', "$backupdir/dump3",
+		'--table-chunk-size', '1', $node->connstr($dbname1)
+	],
+	'parallel dump in chunks');
+
+my ($toc) = run_command([ 'pg_restore', '-l', "$backupdir/dump3" ]);
+my $nchunks = () = $toc =~ /TABLE DATA public tchunk/g;
+cmp_ok($nchunks, '>', 1, 'large table is dumped in several chunks');
+
+$node->command_ok(
+	[
+		'pg_restore', '-v',
+		'-d', $node->connstr($dbname4),
+		'-j3', "$backupdir/dump3"
+	],
+	'parallel restore of chunks');
+
+my $counts = q{
+	select (select count(*) from tplain), (select count(*) from ths),
+	  (select count(*) from tht), (select count(*) from tchunk),
+	  (select count(distinct id) from tchunk)
+};
+is( $node->safe_psql($dbname4, $counts),
+	$node->safe_psql($dbname1, $counts),
+	'row counts match after parallel restore of chunks');
+
 done_testing();
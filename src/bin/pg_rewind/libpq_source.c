@@ -9,6 +9,8 @@
  */
 #include "postgres_fe.h"
 
+#include <sys/select.h>
+
 #include "catalog/pg_type_d.h"
 #include "common/connect.h"
 #include "datapagemap.h"
@@ -34,6 +36,22 @@ typedef struct
 	size_t		length;
 } fetch_range_request;
 
+/*
+ * A connection that fetches chunks.  Each runs one query for up to
+ * MAX_CHUNKS_PER_QUERY chunks at a time; with several of them, the queries
+ * run concurrently, and we process the results as they arrive on any of the
+ * connections.
+ */
+typedef struct
+{
+	PGconn	   *conn;
+
+	/* requests of the query in progress, if num_requests > 0 */
+	int			num_requests;
+	int			chunkno;		/* next chunk to receive */
+	fetch_range_request request_queue[MAX_CHUNKS_PER_QUERY];
+} fetch_conn;
+
 typedef struct
 {
 	rewind_source common;		/* common interface functions */
@@ -42,12 +60,19 @@ typedef struct
 
 	/*
 	 * Queue of chunks that have been requested with the queue_fetch_range()
-	 * function, but have not been fetched from the remote server yet.
+	 * function, but have not been sent to the remote server yet.
 	 */
 	int			num_requests;
 	fetch_range_request request_queue[MAX_CHUNKS_PER_QUERY];
 
-	/* temporary space for process_queued_fetch_requests() */
+	/*
+	 * Connections to fetch the chunks with; the first is 'conn', the others
+	 * were opened by us.
+	 */
+	int			num_fetch_conns;
+	fetch_conn *fetch_conns;
+
+	/* temporary space for send_queued_fetch_requests() */
 	StringInfoData paths;
 	StringInfoData offsets;
 	StringInfoData lengths;
@@ -58,7 +83,9 @@ static char *run_simple_query(PGconn *conn, const char *sql);
 static void run_simple_command(PGconn *conn, const char *sql);
 static void appendArrayEscapedString(StringInfo buf, const char *str);
 
-static void process_queued_fetch_requests(libpq_source *src);
+static void send_queued_fetch_requests(libpq_source *src);
+static bool receive_fetched_chunks(fetch_conn *fc);
+static void wait_for_fetch_conns(libpq_source *src, bool all);
 
 /* public interface functions */
 static void libpq_traverse_files(rewind_source *source,
@@ -76,10 +103,12 @@ static void libpq_destroy(rewind_source *source);
  * Create a new libpq source.
  *
  * The caller has already established the connection, but should not try
- * to use it while the source is active.
+ * to use it while the source is active.  If nconns is more than 1, we open
+ * that many connections in all with connstr, to fetch files over them in
+ * parallel.
  */
 rewind_source *
-init_libpq_source(PGconn *conn)
+init_libpq_source(PGconn *conn, const char *connstr, int nconns)
 {
 	libpq_source *src;
 
@@ -87,6 +116,19 @@ init_libpq_source(PGconn *conn)
 
 	src = pg_malloc0(sizeof(libpq_source));
 
+	src->num_fetch_conns = Max(nconns, 1);
+	src->fetch_conns = pg_malloc0(src->num_fetch_conns * sizeof(fetch_conn));
+	src->fetch_conns[0].conn = conn;
+	for (int i = 1; i < src->num_fetch_conns; i++)
+	{
+		PGconn	   *fetchconn = PQconnectdb(connstr);
+
+		if (PQstatus(fetchconn) == CONNECTION_BAD)
+			pg_fatal("%s", PQerrorMessage(fetchconn));
+		init_libpq_conn(fetchconn);
+		src->fetch_conns[i].conn = fetchconn;
+	}
+
 	src->common.traverse_files = libpq_traverse_files;
 	src->common.fetch_file = libpq_fetch_file;
 	src->common.queue_fetch_file = libpq_queue_fetch_file;
@@ -389,9 +431,9 @@ libpq_queue_fetch_range(rewind_source *source, const char *path, off_t off,
 	{
 		int32		thislen;
 
-		/* if the queue is full, perform all the work queued up so far */
+		/* if the queue is full, send all the work queued up so far */
 		if (src->num_requests == MAX_CHUNKS_PER_QUERY)
-			process_queued_fetch_requests(src);
+			send_queued_fetch_requests(src);
 
 		thislen = Min(len, MAX_CHUNK_SIZE);
 		src->request_queue[src->num_requests].path = path;
@@ -410,19 +452,37 @@ libpq_queue_fetch_range(rewind_source *source, const char *path, off_t off,
 static void
 libpq_finish_fetch(rewind_source *source)
 {
-	process_queued_fetch_requests((libpq_source *) source);
+	libpq_source *src = (libpq_source *) source;
+
+	send_queued_fetch_requests(src);
+	wait_for_fetch_conns(src, true);
 }
 
+/*
+ * Send the queued requests in a query on an idle fetch connection, waiting
+ * for one to become idle if needed.  The results are processed as they
+ * arrive, by wait_for_fetch_conns().
+ */
 static void
-process_queued_fetch_requests(libpq_source *src)
+send_queued_fetch_requests(libpq_source *src)
 {
 	const char *params[3];
-	PGresult   *res;
-	int			chunkno;
+	fetch_conn *fc = NULL;
 
 	if (src->num_requests == 0)
 		return;
 
+	wait_for_fetch_conns(src, false);
+	for (int i = 0; i < src->num_fetch_conns; i++)
+	{
+		if (src->fetch_conns[i].num_requests == 0)
+		{
+			fc = &src->fetch_conns[i];
+			break;
+		}
+	}
+	Assert(fc != NULL);
+
 	pg_log_debug("getting %d file chunks", src->num_requests);
 
 	/*
@@ -463,12 +523,73 @@ process_queued_fetch_requests(libpq_source *src)
 	params[1] = src->offsets.data;
 	params[2] = src->lengths.data;
 
-	if (PQsendQueryPrepared(src->conn, "fetch_chunks_stmt", 3, params, NULL, NULL, 1) != 1)
-		pg_fatal("could not send query: %s", PQerrorMessage(src->conn));
+	if (PQsendQueryPrepared(fc->conn, "fetch_chunks_stmt", 3, params, NULL, NULL, 1) != 1)
+		pg_fatal("could not send query: %s", PQerrorMessage(fc->conn));
 
-	if (PQsetSingleRowMode(src->conn) != 1)
+	if (PQsetSingleRowMode(fc->conn) != 1)
 		pg_fatal("could not set libpq connection to single row mode");
 
+	/* the connection now owns the requests */
+	memcpy(fc->request_queue, src->request_queue,
+		   src->num_requests * sizeof(fetch_range_request));
+	fc->num_requests = src->num_requests;
+	fc->chunkno = 0;
+	src->num_requests = 0;
+}
+
+/*
+ * Wait until at least one fetch connection is idle, or all of them if 'all',
+ * processing the results that arrive meanwhile.
+ */
+static void
+wait_for_fetch_conns(libpq_source *src, bool all)
+{
+	for (;;)
+	{
+		fd_set		input_mask;
+		int			maxfd = -1;
+		int			nbusy = 0;
+
+		FD_ZERO(&input_mask);
+		for (int i = 0; i < src->num_fetch_conns; i++)
+		{
+			fetch_conn *fc = &src->fetch_conns[i];
+			int			sock;
+
+			if (fc->num_requests == 0)
+				continue;
+
+			if (PQconsumeInput(fc->conn) != 1)
+				pg_fatal("could not receive data from source server: %s",
+						 PQerrorMessage(fc->conn));
+			if (receive_fetched_chunks(fc))
+				continue;
+
+			nbusy++;
+			sock = PQsocket(fc->conn);
+			FD_SET(sock, &input_mask);
+			maxfd = Max(maxfd, sock);
+		}
+
+		if (nbusy == 0 || (!all && nbusy < src->num_fetch_conns))
+			return;
+
+		if (select(maxfd + 1, &input_mask, NULL, NULL, NULL) < 0 &&
+			errno != EINTR)
+			pg_fatal("%s() failed: %m", "select");
+	}
+}
+
+/*
+ * Process the results that have arrived on a fetch connection, without
+ * blocking.  Returns true once the whole result of its query has been
+ * processed, and the connection is idle again.
+ */
+static bool
+receive_fetched_chunks(fetch_conn *fc)
+{
+	PGresult   *res;
+
 	/*----
 	 * The result set is of format:
 	 *
@@ -477,16 +598,24 @@ process_queued_fetch_requests(libpq_source *src)
 	 * chunk	bytea	-- file content
 	 *----
 	 */
-	chunkno = 0;
-	while ((res = PQgetResult(src->conn)) != NULL)
+	while (!PQisBusy(fc->conn))
 	{
-		fetch_range_request *rq = &src->request_queue[chunkno];
+		fetch_range_request *rq;
 		char	   *filename;
 		int			filenamelen;
 		int64		chunkoff;
 		int			chunksize;
 		char	   *chunk;
 
+		res = PQgetResult(fc->conn);
+		if (res == NULL)
+		{
+			if (fc->chunkno != fc->num_requests)
+				pg_fatal("unexpected number of data chunks received");
+			fc->num_requests = 0;
+			return true;
+		}
+
 		switch (PQresultStatus(res))
 		{
 			case PGRES_SINGLE_TUPLE:
@@ -501,8 +630,9 @@ process_queued_fetch_requests(libpq_source *src)
 						 PQresultErrorMessage(res));
 		}
 
-		if (chunkno > src->num_requests)
+		if (fc->chunkno >= fc->num_requests)
 			pg_fatal("received more data chunks than requested");
+		rq = &fc->request_queue[fc->chunkno];
 
 		/* sanity check the result set */
 		if (PQnfields(res) != 3 || PQntuples(res) != 1)
@@ -589,12 +719,10 @@ process_queued_fetch_requests(libpq_source *src)
 		pg_free(filename);
 
 		PQclear(res);
-		chunkno++;
+		fc->chunkno++;
 	}
-	if (chunkno != src->num_requests)
-		pg_fatal("unexpected number of data chunks received");
 
-	src->num_requests = 0;
+	return false;
 }
 
 /*
@@ -666,10 +794,16 @@ libpq_destroy(rewind_source *source)
 {
 	libpq_source *src = (libpq_source *) source;
 
+	/*
+	 * NOTE: we don't close the first connection here, as it was not opened
+	 * by us.  The other fetch connections were.
+	 */
+	for (int i = 1; i < src->num_fetch_conns; i++)
+		PQfinish(src->fetch_conns[i].conn);
+	pfree(src->fetch_conns);
+
 	pfree(src->paths.data);
 	pfree(src->offsets.data);
 	pfree(src->lengths.data);
 	pfree(src);
-
-	/* NOTE: we don't close the connection here, as it was not opened by us. */
 }
@@ -9,6 +9,7 @@
  */
 #include "postgres_fe.h"
 
+#include <limits.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <time.h>
@@ -22,6 +23,7 @@
 #include "common/file_perm.h"
 #include "common/restricted_token.h"
 #include "common/string.h"
+#include "fe_utils/option_utils.h"
 #include "fe_utils/recovery_gen.h"
 #include "fe_utils/string_utils.h"
 #include "file_ops.h"
@@ -74,6 +76,7 @@ bool		showprogress = false;
 bool		dry_run = false;
 bool		do_sync = true;
 bool		restore_wal = false;
+static int	num_jobs = 1;
 
 /* Target history */
 TimeLineHistoryEntry *targetHistory;
@@ -95,6 +98,8 @@ usage(const char *progname)
 	printf(_("  -c, --restore-target-wal       use restore_command in target configuration to\n"
 			 "                                 retrieve WAL files from archives\n"));
 	printf(_("  -D, --target-pgdata=DIRECTORY  existing data directory to modify\n"));
+	printf(_("  -j, --jobs=NUM                 use this many connections to fetch files\n"
+			 "                                 (requires --source-server)\n"));
 	printf(_("      --source-pgdata=DIRECTORY  source data directory to synchronize with\n"));
 	printf(_("      --source-server=CONNSTR    source server to synchronize with\n"));
 	printf(_("  -n, --dry-run                  stop before modifying anything\n"));
@@ -131,6 +136,7 @@ main(int argc, char **argv)
 		{"no-sync", no_argument, NULL, 'N'},
 		{"progress", no_argument, NULL, 'P'},
 		{"debug", no_argument, NULL, 3},
+		{"jobs", required_argument, NULL, 'j'},
 		{NULL, 0, NULL, 0}
 	};
 	int			option_index;
@@ -169,7 +175,7 @@ main(int argc, char **argv)
 		}
 	}
 
-	while ((c = getopt_long(argc, argv, "cD:nNPR", long_options, &option_index)) != -1)
+	while ((c = getopt_long(argc, argv, "cD:j:nNPR", long_options, &option_index)) != -1)
 	{
 		switch (c)
 		{
@@ -181,6 +187,12 @@ main(int argc, char **argv)
 				showprogress = true;
 				break;
 
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &num_jobs))
+					exit(1);
+				break;
+
 			case 'n':
 				dry_run = true;
 				break;
@@ -253,6 +265,13 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (num_jobs > 1 && connstr_source == NULL)
+	{
+		pg_log_error("option %s requires a source server (--source-server)", "-j/--jobs");
+		pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+		exit(1);
+	}
+
 	if (optind < argc)
 	{
 		pg_log_error("too many command-line arguments (first is \"%s\")",
@@ -304,7 +323,7 @@ main(int argc, char **argv)
 		if (showprogress)
 			pg_log_info("connected to server");
 
-		source = init_libpq_source(conn);
+		source = init_libpq_source(conn, connstr_source, num_jobs);
 	}
 	else
 		source = init_local_source(datadir_source);
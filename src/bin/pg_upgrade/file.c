@@ -95,6 +95,39 @@ copyFile(const char *src, const char *dst,
 		pg_fatal("error while copying relation \"%s.%s\": could not create file \"%s\": %s",
 				 schemaName, relName, dst, strerror(errno));
 
+#ifdef HAVE_COPY_FILE_RANGE
+
+	/*
+	 * Let the kernel copy the file, without passing the data through user
+	 * space; some file systems even share the blocks like a clone does.  If
+	 * it's not supported between these files, fall back to read and write.
+	 */
+	for (;;)
+	{
+		ssize_t		nbytes = copy_file_range(src_fd, NULL, dest_fd, NULL,
+											 1024 * 1024 * 1024, 0);
+
+		if (nbytes < 0)
+		{
+			off_t		pos = lseek(dest_fd, 0, SEEK_CUR);
+
+			if (pos == 0 &&
+				(errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP ||
+				 errno == EINVAL))
+				break;			/* nothing copied yet, fall back */
+			pg_fatal("error while copying relation \"%s.%s\" (\"%s\" to \"%s\"): %s",
+					 schemaName, relName, src, dst, strerror(errno));
+		}
+
+		if (nbytes == 0)
+		{
+			close(src_fd);
+			close(dest_fd);
+			return;
+		}
+	}
+#endif							/* HAVE_COPY_FILE_RANGE */
+
 	/* copy in fairly large chunks for best efficiency */
 #define COPY_BUF_SIZE (50 * BLCKSZ)
 
@@ -35,11 +35,9 @@ typedef struct
 
 typedef struct
 {
-	DbInfoArr  *old_db_arr;
-	DbInfoArr  *new_db_arr;
-	char	   *old_pgdata;
-	char	   *new_pgdata;
-	char	   *old_tablespace;
+	TransferFile *files;
+	int			n_files;
+	int			worker;
 } transfer_thread_arg;
 
 exec_thread_arg **exec_thread_args;
@@ -49,7 +47,7 @@ transfer_thread_arg **transfer_thread_args;
 void	  **cur_thread_args;
 
 DWORD		win32_exec_prog(exec_thread_arg *args);
-DWORD		win32_transfer_all_new_dbs(transfer_thread_arg *args);
+DWORD		win32_transfer_files(transfer_thread_arg *args);
 #endif
 
 /*
@@ -163,15 +161,13 @@ win32_exec_prog(exec_thread_arg *args)
 
 
 /*
- *	parallel_transfer_all_new_dbs
+ *	parallel_transfer_files
  *
- *	This has the same API as transfer_all_new_dbs, except it does parallel execution
- *	by transferring multiple tablespaces in parallel
+ *	This has the same API as transfer_files, except it does parallel execution
+ *	by transferring the files of the given job in a child.
  */
 void
-parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-							  char *old_pgdata, char *new_pgdata,
-							  char *old_tablespace)
+parallel_transfer_files(TransferFile *files, int n_files, int worker)
 {
 #ifndef WIN32
 	pid_t		child;
@@ -181,7 +177,7 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 #endif
 
 	if (user_opts.jobs <= 1)
-		transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata, new_pgdata, NULL);
+		transfer_files(files, n_files, worker);
 	else
 	{
 		/* parallel */
@@ -224,8 +220,7 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 		child = fork();
 		if (child == 0)
 		{
-			transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata, new_pgdata,
-								 old_tablespace);
+			transfer_files(files, n_files, worker);
 			/* if we take another exit path, it will be non-zero */
 			/* use _exit to skip atexit() functions */
 			_exit(0);
@@ -238,16 +233,11 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 		new_arg = transfer_thread_args[parallel_jobs - 1];
 
 		/* Can only pass one pointer into the function, so use a struct */
-		new_arg->old_db_arr = old_db_arr;
-		new_arg->new_db_arr = new_db_arr;
-		pg_free(new_arg->old_pgdata);
-		new_arg->old_pgdata = pg_strdup(old_pgdata);
-		pg_free(new_arg->new_pgdata);
-		new_arg->new_pgdata = pg_strdup(new_pgdata);
-		pg_free(new_arg->old_tablespace);
-		new_arg->old_tablespace = old_tablespace ? pg_strdup(old_tablespace) : NULL;
-
-		child = (HANDLE) _beginthreadex(NULL, 0, (void *) win32_transfer_all_new_dbs,
+		new_arg->files = files;
+		new_arg->n_files = n_files;
+		new_arg->worker = worker;
+
+		child = (HANDLE) _beginthreadex(NULL, 0, (void *) win32_transfer_files,
 										new_arg, 0, NULL);
 		if (child == 0)
 			pg_fatal("could not create worker thread: %s", strerror(errno));
@@ -260,10 +250,9 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 
 #ifdef WIN32
 DWORD
-win32_transfer_all_new_dbs(transfer_thread_arg *args)
+win32_transfer_files(transfer_thread_arg *args)
 {
-	transfer_all_new_dbs(args->old_db_arr, args->new_db_arr, args->old_pgdata,
-						 args->new_pgdata, args->old_tablespace);
+	transfer_files(args->files, args->n_files, args->worker);
 
 	/* terminates thread */
 	return 0;
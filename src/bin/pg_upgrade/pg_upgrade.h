@@ -166,6 +166,18 @@ typedef struct
 	char	   *relname;
 } FileNameMap;
 
+/*
+ * The following structure represents a file of a relation to transfer.
+ */
+typedef struct
+{
+	FileNameMap *map;			/* relation the file belongs to */
+	const char *type_suffix;	/* fork: "", "_fsm", "_vm" or "_cnt" */
+	int			segno;			/* segment number */
+	off_t		size;			/* size in the old cluster, in bytes */
+	int			worker;			/* parallel job that transfers it */
+} TransferFile;
+
 /*
  * Structure to store database information
  */
@@ -411,9 +423,7 @@ void		get_sock_dir(ClusterInfo *cluster, bool live_check);
 
 void		transfer_all_new_tablespaces(DbInfoArr *old_db_arr,
 										 DbInfoArr *new_db_arr, char *old_pgdata, char *new_pgdata);
-void		transfer_all_new_dbs(DbInfoArr *old_db_arr,
-								 DbInfoArr *new_db_arr, char *old_pgdata, char *new_pgdata,
-								 char *old_tablespace);
+void		transfer_files(TransferFile *files, int n_files, int worker);
 
 /* tablespace.c */
 
@@ -467,7 +477,5 @@ void		report_extension_updates(ClusterInfo *cluster);
 /* parallel.c */
 void		parallel_exec_prog(const char *log_file, const char *opt_log_file,
 							   const char *fmt,...) pg_attribute_printf(3, 4);
-void		parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-										  char *old_pgdata, char *new_pgdata,
-										  char *old_tablespace);
+void		parallel_transfer_files(TransferFile *files, int n_files, int worker);
 bool		reap_child(bool wait_for_child);
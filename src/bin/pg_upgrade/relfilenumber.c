@@ -15,8 +15,19 @@
 #include "catalog/pg_class_d.h"
 #include "pg_upgrade.h"
 
-static void transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace);
-static void transfer_relfile(FileNameMap *map, const char *type_suffix, bool vm_must_add_frozenbit);
+static TransferFile *collect_transfer_files(DbInfoArr *old_db_arr,
+											DbInfoArr *new_db_arr,
+											char *old_pgdata, char *new_pgdata,
+											FileNameMap ***all_maps,
+											int *n_dbs, int *n_files);
+static void collect_relfiles(FileNameMap *map, const char *type_suffix,
+							 TransferFile **files, int *n_files,
+							 int *max_files);
+static void assign_transfer_workers(TransferFile *files, int n_files);
+static void transfer_relfile(TransferFile *file, bool vm_must_add_frozenbit,
+							 int pct);
+
+static const char *const relfile_type_suffixes[] = {"", "_fsm", "_vm", "_cnt"};
 
 
 /*
@@ -29,6 +40,11 @@ void
 transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 							 char *old_pgdata, char *new_pgdata)
 {
+	FileNameMap **all_maps;
+	int			n_dbs;
+	TransferFile *files;
+	int			n_files;
+
 	switch (user_opts.transfer_mode)
 	{
 		case TRANSFER_MODE_CLONE:
@@ -43,53 +59,64 @@ transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 	}
 
 	/*
-	 * Transferring files by tablespace is tricky because a single database
-	 * can use multiple tablespaces.  For non-parallel mode, we just pass a
-	 * NULL tablespace path, which matches all tablespaces.  In parallel mode,
-	 * we pass the default tablespace and all user-created tablespaces and let
-	 * those operations happen in parallel.
+	 * List all the files to transfer first, so that in parallel mode they can
+	 * be spread over the jobs by size, regardless of which database and
+	 * tablespace they are in.  A single big tablespace, or a single big
+	 * relation, still keeps all the jobs busy that way.
 	 */
+	files = collect_transfer_files(old_db_arr, new_db_arr, old_pgdata,
+								   new_pgdata, &all_maps, &n_dbs, &n_files);
+
 	if (user_opts.jobs <= 1)
-		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, NULL);
+		transfer_files(files, n_files, 0);
 	else
 	{
-		int			tblnum;
-
-		/* transfer default tablespace */
-		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, old_pgdata);
-
-		for (tblnum = 0; tblnum < os_info.num_old_tablespaces; tblnum++)
-			parallel_transfer_all_new_dbs(old_db_arr,
-										  new_db_arr,
-										  old_pgdata,
-										  new_pgdata,
-										  os_info.old_tablespaces[tblnum]);
+		int			worker;
+
+		assign_transfer_workers(files, n_files);
+
+		for (worker = 0; worker < user_opts.jobs; worker++)
+			parallel_transfer_files(files, n_files, worker);
+
 		/* reap all children */
 		while (reap_child(true) == true)
 			;
 	}
 
+	for (int dbnum = 0; dbnum < n_dbs; dbnum++)
+		pg_free(all_maps[dbnum]);
+	pg_free(all_maps);
+	pg_free(files);
+
 	end_progress_output();
 	check_ok();
 }
 
 
 /*
- * transfer_all_new_dbs()
+ * collect_transfer_files()
  *
- * Responsible for upgrading all database. invokes routines to generate mappings and then
- * physically link the databases.
+ * Generate the mappings of all databases, and list the files of all the
+ * relations in them.  The mappings are returned in *all_maps, one array per
+ * database, since the files point into them.
  */
-void
-transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-					 char *old_pgdata, char *new_pgdata, char *old_tablespace)
+static TransferFile *
+collect_transfer_files(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
+					   char *old_pgdata, char *new_pgdata,
+					   FileNameMap ***all_maps, int *n_dbs, int *n_files)
 {
 	int			old_dbnum,
 				new_dbnum;
+	TransferFile *files;
+	int			max_files = 1024;
+
+	files = (TransferFile *) pg_malloc(max_files * sizeof(TransferFile));
+	*n_files = 0;
+	*all_maps = (FileNameMap **) pg_malloc0(Max(old_db_arr->ndbs, 1) *
+											sizeof(FileNameMap *));
+	*n_dbs = 0;
 
-	/* Scan the old cluster databases and transfer their files */
+	/* Scan the old cluster databases and list their files */
 	for (old_dbnum = new_dbnum = 0;
 		 old_dbnum < old_db_arr->ndbs;
 		 old_dbnum++, new_dbnum++)
@@ -117,25 +144,179 @@ transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 
 		mappings = gen_db_file_maps(old_db, new_db, &n_maps, old_pgdata,
 									new_pgdata);
-		if (n_maps)
+		for (int mapnum = 0; mapnum < n_maps; mapnum++)
 		{
-			transfer_single_new_db(mappings, n_maps, old_tablespace);
+			/* primary file, then any fsm, vm and tuple count map files */
+			for (int i = 0; i < lengthof(relfile_type_suffixes); i++)
+				collect_relfiles(&mappings[mapnum], relfile_type_suffixes[i],
+								 &files, n_files, &max_files);
 		}
 		/* We allocate something even for n_maps == 0 */
-		pg_free(mappings);
+		(*all_maps)[(*n_dbs)++] = mappings;
+	}
+
+	return files;
+}
+
+
+/*
+ * Build the path of a file of a relation in the old or the new cluster.
+ */
+static void
+relfile_path(char *path, size_t size, const TransferFile *file, bool old)
+{
+	const FileNameMap *map = file->map;
+	char		extent_suffix[65];
+
+	if (file->segno == 0)
+		extent_suffix[0] = '\0';
+	else
+		snprintf(extent_suffix, sizeof(extent_suffix), ".%d", file->segno);
+
+	snprintf(path, size, "%s%s/%u/%u%s%s",
+			 old ? map->old_tablespace : map->new_tablespace,
+			 old ? map->old_tablespace_suffix : map->new_tablespace_suffix,
+			 map->db_oid,
+			 map->relfilenumber,
+			 file->type_suffix,
+			 extent_suffix);
+}
+
+
+/*
+ * collect_relfiles()
+ *
+ * Add the segments of one fork of a relation to the list of files to
+ * transfer.
+ */
+static void
+collect_relfiles(FileNameMap *map, const char *type_suffix,
+				 TransferFile **files, int *n_files, int *max_files)
+{
+	char		old_file[MAXPGPATH];
+	char		new_file[MAXPGPATH];
+	int			segno;
+	struct stat statbuf;
+
+	/*
+	 * Now list any related segments as well. Remember, PG breaks large files
+	 * into 1GB segments, the first segment has no extension, subsequent
+	 * segments are named relfilenumber.1, relfilenumber.2, relfilenumber.3.
+	 */
+	for (segno = 0;; segno++)
+	{
+		TransferFile *file;
+
+		if (*n_files >= *max_files)
+		{
+			*max_files *= 2;
+			*files = (TransferFile *) pg_realloc(*files,
+												 *max_files * sizeof(TransferFile));
+		}
+		file = &(*files)[*n_files];
+		file->map = map;
+		file->type_suffix = type_suffix;
+		file->segno = segno;
+		file->size = 0;
+		file->worker = 0;
+
+		relfile_path(old_file, sizeof(old_file), file, true);
+
+		if (stat(old_file, &statbuf) != 0)
+		{
+			/*
+			 * File does not exist?  That's OK for an extent, fsm, or vm file,
+			 * there are no more segments.  The first segment of the primary
+			 * file is transferred anyway, and its transfer reports the error.
+			 */
+			if (errno == ENOENT && (type_suffix[0] != '\0' || segno != 0))
+				return;
+			if (errno != ENOENT)
+			{
+				relfile_path(new_file, sizeof(new_file), file, false);
+				pg_fatal("error while checking for file existence \"%s.%s\" (\"%s\" to \"%s\"): %s",
+						 map->nspname, map->relname, old_file, new_file,
+						 strerror(errno));
+			}
+		}
+		else
+		{
+			/* If an extent, fsm, or vm file is empty, we're done */
+			if (statbuf.st_size == 0 && (type_suffix[0] != '\0' || segno != 0))
+				return;
+			file->size = statbuf.st_size;
+		}
+
+		(*n_files)++;
 	}
 }
 
+
+/*
+ * Sort callback for assign_transfer_workers, largest files first
+ */
+static int
+transfer_file_size_cmp(const void *a, const void *b)
+{
+	const TransferFile *fa = *(TransferFile *const *) a;
+	const TransferFile *fb = *(TransferFile *const *) b;
+
+	if (fa->size > fb->size)
+		return -1;
+	if (fa->size < fb->size)
+		return 1;
+	return 0;
+}
+
 /*
- * transfer_single_new_db()
+ * assign_transfer_workers()
  *
- * create links for mappings stored in "maps" array.
+ * Spread the files over the parallel jobs, so that each gets about the same
+ * number of bytes to transfer: taking the files largest first, each goes to
+ * the job with the fewest bytes so far.
  */
 static void
-transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
+assign_transfer_workers(TransferFile *files, int n_files)
+{
+	TransferFile **sorted;
+	off_t	   *load;
+
+	sorted = (TransferFile **) pg_malloc(Max(n_files, 1) * sizeof(TransferFile *));
+	for (int i = 0; i < n_files; i++)
+		sorted[i] = &files[i];
+	qsort(sorted, n_files, sizeof(TransferFile *), transfer_file_size_cmp);
+
+	load = (off_t *) pg_malloc0(user_opts.jobs * sizeof(off_t));
+	for (int i = 0; i < n_files; i++)
+	{
+		int			least = 0;
+
+		for (int worker = 1; worker < user_opts.jobs; worker++)
+			if (load[worker] < load[least])
+				least = worker;
+
+		sorted[i]->worker = least;
+		/* count empty files as something, so that they're spread too */
+		load[least] += Max(sorted[i]->size, 1);
+	}
+
+	pg_free(load);
+	pg_free(sorted);
+}
+
+
+/*
+ * transfer_files()
+ *
+ * Copy or link the listed files that were assigned to the given parallel
+ * job (all of them, if not in parallel mode).
+ */
+void
+transfer_files(TransferFile *files, int n_files, int worker)
 {
-	int			mapnum;
 	bool		vm_must_add_frozenbit = false;
+	off_t		total = 0;
+	off_t		done = 0;
 
 	/*
 	 * Do we need to rewrite visibilitymap?
@@ -144,20 +325,18 @@ transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
 		new_cluster.controldata.cat_ver >= VISIBILITY_MAP_FROZEN_BIT_CAT_VER)
 		vm_must_add_frozenbit = true;
 
-	for (mapnum = 0; mapnum < size; mapnum++)
+	for (int i = 0; i < n_files; i++)
+		if (files[i].worker == worker)
+			total += files[i].size;
+
+	for (int i = 0; i < n_files; i++)
 	{
-		if (old_tablespace == NULL ||
-			strcmp(maps[mapnum].old_tablespace, old_tablespace) == 0)
-		{
-			/* transfer primary file */
-			transfer_relfile(&maps[mapnum], "", vm_must_add_frozenbit);
+		if (files[i].worker != worker)
+			continue;
 
-			/*
-			 * Copy/link any fsm and vm files, if they exist
-			 */
-			transfer_relfile(&maps[mapnum], "_fsm", vm_must_add_frozenbit);
-			transfer_relfile(&maps[mapnum], "_vm", vm_must_add_frozenbit);
-		}
+		transfer_relfile(&files[i], vm_must_add_frozenbit,
+						 total > 0 ? (int) (done * 100 / total) : 100);
+		done += files[i].size;
 	}
 }
 
@@ -167,93 +346,47 @@ transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
  *
  * Copy or link file from old cluster to new one.  If vm_must_add_frozenbit
  * is true, visibility map forks are converted and rewritten, even in link
- * mode.
+ * mode.  pct is how much of its share the current job has transferred so
+ * far, for the progress report.
  */
 static void
-transfer_relfile(FileNameMap *map, const char *type_suffix, bool vm_must_add_frozenbit)
+transfer_relfile(TransferFile *file, bool vm_must_add_frozenbit, int pct)
 {
+	FileNameMap *map = file->map;
 	char		old_file[MAXPGPATH];
 	char		new_file[MAXPGPATH];
-	int			segno;
-	char		extent_suffix[65];
-	struct stat statbuf;
 
-	/*
-	 * Now copy/link any related segments as well. Remember, PG breaks large
-	 * files into 1GB segments, the first segment has no extension, subsequent
-	 * segments are named relfilenumber.1, relfilenumber.2, relfilenumber.3.
-	 */
-	for (segno = 0;; segno++)
-	{
-		if (segno == 0)
-			extent_suffix[0] = '\0';
-		else
-			snprintf(extent_suffix, sizeof(extent_suffix), ".%d", segno);
-
-		snprintf(old_file, sizeof(old_file), "%s%s/%u/%u%s%s",
-				 map->old_tablespace,
-				 map->old_tablespace_suffix,
-				 map->db_oid,
-				 map->relfilenumber,
-				 type_suffix,
-				 extent_suffix);
-		snprintf(new_file, sizeof(new_file), "%s%s/%u/%u%s%s",
-				 map->new_tablespace,
-				 map->new_tablespace_suffix,
-				 map->db_oid,
-				 map->relfilenumber,
-				 type_suffix,
-				 extent_suffix);
-
-		/* Is it an extent, fsm, or vm file? */
-		if (type_suffix[0] != '\0' || segno != 0)
-		{
-			/* Did file open fail? */
-			if (stat(old_file, &statbuf) != 0)
-			{
-				/* File does not exist?  That's OK, just return */
-				if (errno == ENOENT)
-					return;
-				else
-					pg_fatal("error while checking for file existence \"%s.%s\" (\"%s\" to \"%s\"): %s",
-							 map->nspname, map->relname, old_file, new_file,
-							 strerror(errno));
-			}
-
-			/* If file is empty, just return */
-			if (statbuf.st_size == 0)
-				return;
-		}
+	relfile_path(old_file, sizeof(old_file), file, true);
+	relfile_path(new_file, sizeof(new_file), file, false);
 
-		unlink(new_file);
+	unlink(new_file);
 
-		/* Copying files might take some time, so give feedback. */
-		pg_log(PG_STATUS, "%s", old_file);
+	/* Copying files might take some time, so give feedback. */
+	pg_log(PG_STATUS, "%s (%d%%)", old_file, pct);
 
-		if (vm_must_add_frozenbit && strcmp(type_suffix, "_vm") == 0)
+	if (vm_must_add_frozenbit && strcmp(file->type_suffix, "_vm") == 0)
+	{
+		/* Need to rewrite visibility map format */
+		pg_log(PG_VERBOSE, "rewriting \"%s\" to \"%s\"",
+			   old_file, new_file);
+		rewriteVisibilityMap(old_file, new_file, map->nspname, map->relname);
+	}
+	else
+		switch (user_opts.transfer_mode)
 		{
-			/* Need to rewrite visibility map format */
-			pg_log(PG_VERBOSE, "rewriting \"%s\" to \"%s\"",
-				   old_file, new_file);
-			rewriteVisibilityMap(old_file, new_file, map->nspname, map->relname);
+			case TRANSFER_MODE_CLONE:
+				pg_log(PG_VERBOSE, "cloning \"%s\" to \"%s\"",
+					   old_file, new_file);
+				cloneFile(old_file, new_file, map->nspname, map->relname);
+				break;
+			case TRANSFER_MODE_COPY:
+				pg_log(PG_VERBOSE, "copying \"%s\" to \"%s\"",
+					   old_file, new_file);
+				copyFile(old_file, new_file, map->nspname, map->relname);
+				break;
+			case TRANSFER_MODE_LINK:
+				pg_log(PG_VERBOSE, "linking \"%s\" to \"%s\"",
+					   old_file, new_file);
+				linkFile(old_file, new_file, map->nspname, map->relname);
 		}
-		else
-			switch (user_opts.transfer_mode)
-			{
-				case TRANSFER_MODE_CLONE:
-					pg_log(PG_VERBOSE, "cloning \"%s\" to \"%s\"",
-						   old_file, new_file);
-					cloneFile(old_file, new_file, map->nspname, map->relname);
-					break;
-				case TRANSFER_MODE_COPY:
-					pg_log(PG_VERBOSE, "copying \"%s\" to \"%s\"",
-						   old_file, new_file);
-					copyFile(old_file, new_file, map->nspname, map->relname);
-					break;
-				case TRANSFER_MODE_LINK:
-					pg_log(PG_VERBOSE, "linking \"%s\" to \"%s\"",
-						   old_file, new_file);
-					linkFile(old_file, new_file, map->nspname, map->relname);
-			}
-	}
 }
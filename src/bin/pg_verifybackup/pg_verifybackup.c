@@ -15,16 +15,51 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <time.h>
 
 #include "common/hashfn.h"
 #include "common/logging.h"
+#include "fe_utils/option_utils.h"
 #include "fe_utils/simple_list.h"
 #include "getopt_long.h"
 #include "parse_manifest.h"
 #include "pgtime.h"
 
+/*
+ * Multi-platform thread implementations, as in pgbench
+ */
+#ifdef WIN32
+/* Use Windows threads */
+#include <windows.h>
+#define THREAD_T HANDLE
+#define THREAD_FUNC_RETURN_TYPE unsigned
+#define THREAD_FUNC_RETURN return 0
+#define THREAD_FUNC_CC __stdcall
+#define THREAD_CREATE(handle, function, arg) \
+	((*(handle) = (HANDLE) _beginthreadex(NULL, 0, (function), (arg), 0, NULL)) == 0 ? errno : 0)
+#define THREAD_JOIN(handle) \
+	(WaitForSingleObject(handle, INFINITE), CloseHandle(handle))
+#elif defined(ENABLE_THREAD_SAFETY)
+/* Use POSIX threads */
+#include "port/pg_pthread.h"
+#define THREAD_T pthread_t
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#define THREAD_CREATE(handle, function, arg) \
+	pthread_create((handle), NULL, (function), (arg))
+#define THREAD_JOIN(handle) \
+	pthread_join((handle), NULL)
+#else
+/* No threads implementation, use none (-j 1) */
+#define THREAD_T void *
+#define THREAD_FUNC_RETURN_TYPE void *
+#define THREAD_FUNC_RETURN return NULL
+#define THREAD_FUNC_CC
+#endif
+
 /*
  * For efficiency, we'd like our hash table containing information about the
  * manifest to start out with approximately the correct number of entries.
@@ -40,9 +75,10 @@
 #define ESTIMATED_BYTES_PER_MANIFEST_LINE	100
 
 /*
- * How many bytes should we try to read from a file at once?
+ * How many bytes should we try to read from a file at once?  Large reads
+ * keep the number of system calls down when checksumming big files.
  */
-#define READ_CHUNK_SIZE				4096
+#define READ_CHUNK_SIZE				(1024 * 1024)
 
 /*
  * Each file described by the manifest file is parsed to produce an object
@@ -115,6 +151,22 @@ typedef struct verifier_context
 	bool		saw_any_error;
 } verifier_context;
 
+/*
+ * State of one worker verifying checksums.  Each worker verifies a fixed
+ * set of files, with a private copy of the verifier context to record
+ * errors in, so that the workers don't need to synchronize.
+ */
+typedef struct verify_worker
+{
+	THREAD_T	thread;			/* thread handle, unless worker 0 */
+	verifier_context context;
+	manifest_file **files;		/* the files assigned to this worker */
+	int			nfiles;
+	uint64		size;			/* total size of those files */
+	uint64		done_size;		/* bytes verified so far */
+	uint8	   *buffer;			/* READ_CHUNK_SIZE bytes */
+} verify_worker;
+
 static void parse_manifest_file(char *manifest_path,
 								manifest_files_hash **ht_p,
 								manifest_wal_range **first_wal_range_p);
@@ -138,7 +190,7 @@ static void verify_backup_file(verifier_context *context,
 							   char *relpath, char *fullpath);
 static void report_extra_backup_files(verifier_context *context);
 static void verify_backup_checksums(verifier_context *context);
-static void verify_file_checksum(verifier_context *context,
+static void verify_file_checksum(verify_worker *worker,
 								 manifest_file *m, char *fullpath);
 static void parse_required_wal(verifier_context *context,
 							   char *pg_waldump_path,
@@ -160,8 +212,16 @@ static const char *progname;
 /* options */
 static bool show_progress = false;
 static bool skip_checksums = false;
+static int	num_jobs = 1;
+
+/* Checksum verification workers */
+static verify_worker *workers = NULL;
+static int	num_workers = 0;
 
-/* Progress indicators */
+/*
+ * Progress indicators.  done_size is added up from the workers' counters,
+ * which they update without locking, so it can lag a little.
+ */
 static uint64 total_size = 0;
 static uint64 done_size = 0;
 
@@ -174,6 +234,7 @@ main(int argc, char **argv)
 	static struct option long_options[] = {
 		{"exit-on-error", no_argument, NULL, 'e'},
 		{"ignore", required_argument, NULL, 'i'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"manifest-path", required_argument, NULL, 'm'},
 		{"no-parse-wal", no_argument, NULL, 'n'},
 		{"progress", no_argument, NULL, 'P'},
@@ -233,7 +294,7 @@ main(int argc, char **argv)
 	simple_string_list_append(&context.ignore_list, "recovery.signal");
 	simple_string_list_append(&context.ignore_list, "standby.signal");
 
-	while ((c = getopt_long(argc, argv, "ei:m:nPqsw:", long_options, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "ei:j:m:nPqsw:", long_options, NULL)) != -1)
 	{
 		switch (c)
 		{
@@ -248,6 +309,15 @@ main(int argc, char **argv)
 					simple_string_list_append(&context.ignore_list, arg);
 					break;
 				}
+			case 'j':
+				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
+									  &num_jobs))
+					exit(1);
+#ifndef ENABLE_THREAD_SAFETY
+				if (num_jobs != 1)
+					pg_fatal("threads are not supported on this platform; use -j1");
+#endif							/* !ENABLE_THREAD_SAFETY */
+				break;
 			case 'm':
 				manifest_path = pstrdup(optarg);
 				canonicalize_path(manifest_path);
@@ -690,37 +760,126 @@ report_extra_backup_files(verifier_context *context)
 								m->pathname);
 }
 
+/*
+ * qsort comparator for manifest_file pointers, by decreasing size
+ */
+static int
+manifest_file_size_cmp(const void *a, const void *b)
+{
+	const manifest_file *ma = *(const manifest_file *const *) a;
+	const manifest_file *mb = *(const manifest_file *const *) b;
+
+	if (ma->size > mb->size)
+		return -1;
+	if (ma->size < mb->size)
+		return 1;
+	return 0;
+}
+
+/*
+ * Verify the checksums of the files assigned to one worker
+ */
+static THREAD_FUNC_RETURN_TYPE THREAD_FUNC_CC
+verify_worker_run(void *arg)
+{
+	verify_worker *worker = (verify_worker *) arg;
+
+	for (int i = 0; i < worker->nfiles; i++)
+	{
+		manifest_file *m = worker->files[i];
+		char	   *fullpath;
+
+		/* Compute the full pathname to the target file. */
+		fullpath = psprintf("%s/%s", worker->context.backup_directory,
+							m->pathname);
+
+		/* Do the actual checksum verification. */
+		verify_file_checksum(worker, m, fullpath);
+
+		/* Avoid leaking memory. */
+		pfree(fullpath);
+	}
+
+	THREAD_FUNC_RETURN;
+}
+
 /*
  * Verify checksums for hash table entries that are otherwise unproblematic.
  * If we've already reported some problem related to a hash table entry, or
  * if it has no checksum, just skip it.
+ *
+ * The files are verified by up to num_jobs threads.  They are handed out
+ * largest first, each to the worker with the least data so far, so that one
+ * huge file doesn't leave the other workers idle at the end.  Worker 0 runs
+ * in the calling thread.
  */
 static void
 verify_backup_checksums(verifier_context *context)
 {
 	manifest_files_iterator it;
 	manifest_file *m;
+	manifest_file **files;
+	int			nfiles = 0;
 
-	progress_report(false);
-
+	/* Collect the files to verify. */
+	files = pg_malloc(context->ht->members * sizeof(manifest_file *));
 	manifest_files_start_iterate(context->ht, &it);
 	while ((m = manifest_files_iterate(context->ht, &it)) != NULL)
 	{
 		if (should_verify_checksum(m) &&
 			!should_ignore_relpath(context, m->pathname))
+			files[nfiles++] = m;
+	}
+	qsort(files, nfiles, sizeof(manifest_file *), manifest_file_size_cmp);
+
+	/* Assign them to the workers. */
+	num_workers = Max(Min(num_jobs, nfiles), 1);
+	workers = pg_malloc0(num_workers * sizeof(verify_worker));
+	for (int i = 0; i < num_workers; i++)
+	{
+		workers[i].context = *context;
+		workers[i].files = pg_malloc(nfiles * sizeof(manifest_file *));
+		workers[i].buffer = pg_malloc(READ_CHUNK_SIZE);
+	}
+	for (int i = 0; i < nfiles; i++)
+	{
+		verify_worker *least = &workers[0];
+
+		for (int w = 1; w < num_workers; w++)
 		{
-			char	   *fullpath;
+			if (workers[w].size < least->size)
+				least = &workers[w];
+		}
+		least->files[least->nfiles++] = files[i];
+		least->size += files[i]->size;
+	}
+	pg_free(files);
 
-			/* Compute the full pathname to the target file. */
-			fullpath = psprintf("%s/%s", context->backup_directory,
-								m->pathname);
+	progress_report(false);
+
+#ifdef ENABLE_THREAD_SAFETY
+	for (int i = 1; i < num_workers; i++)
+	{
+		errno = THREAD_CREATE(&workers[i].thread, verify_worker_run,
+							  &workers[i]);
+		if (errno != 0)
+			report_fatal_error("could not create thread: %m");
+	}
+#else
+	Assert(num_workers == 1);
+#endif							/* ENABLE_THREAD_SAFETY */
 
-			/* Do the actual checksum verification. */
-			verify_file_checksum(context, m, fullpath);
+	(void) verify_worker_run(&workers[0]);
 
-			/* Avoid leaking memory. */
-			pfree(fullpath);
-		}
+	for (int i = 0; i < num_workers; i++)
+	{
+#ifdef ENABLE_THREAD_SAFETY
+		if (i > 0)
+			THREAD_JOIN(workers[i].thread);
+#endif							/* ENABLE_THREAD_SAFETY */
+
+		if (workers[i].context.saw_any_error)
+			context->saw_any_error = true;
 	}
 
 	progress_report(true);
@@ -730,15 +889,16 @@ verify_backup_checksums(verifier_context *context)
  * Verify the checksum of a single file.
  */
 static void
-verify_file_checksum(verifier_context *context, manifest_file *m,
+verify_file_checksum(verify_worker *worker, manifest_file *m,
 					 char *fullpath)
 {
+	verifier_context *context = &worker->context;
 	pg_checksum_context checksum_ctx;
 	char	   *relpath = m->pathname;
 	int			fd;
 	int			rc;
 	size_t		bytes_read = 0;
-	uint8		buffer[READ_CHUNK_SIZE];
+	uint8	   *buffer = worker->buffer;
 	uint8		checksumbuf[PG_CHECKSUM_MAX_LENGTH];
 	int			checksumlen;
 
@@ -772,8 +932,9 @@ verify_file_checksum(verifier_context *context, manifest_file *m,
 		}
 
 		/* Report progress */
-		done_size += rc;
-		progress_report(false);
+		worker->done_size += rc;
+		if (worker == &workers[0])
+			progress_report(false);
 	}
 	if (rc < 0)
 		report_backup_error(context, "could not read file \"%s\": %m",
@@ -954,6 +1115,10 @@ progress_report(bool finished)
 		return;					/* Max once per second */
 
 	last_progress_report = now;
+
+	done_size = 0;
+	for (int i = 0; i < num_workers; i++)
+		done_size += workers[i].done_size;
 	percent_size = total_size ? (int) ((done_size * 100 / total_size)) : 0;
 
 	snprintf(totalsize_str, sizeof(totalsize_str), UINT64_FORMAT,
@@ -984,6 +1149,7 @@ usage(void)
 	printf(_("Options:\n"));
 	printf(_("  -e, --exit-on-error         exit immediately on error\n"));
 	printf(_("  -i, --ignore=RELATIVE_PATH  ignore indicated path\n"));
+	printf(_("  -j, --jobs=NUM              use this many parallel jobs to verify checksums\n"));
 	printf(_("  -m, --manifest-path=PATH    use specified path for manifest\n"));
 	printf(_("  -n, --no-parse-wal          do not try to parse WAL files\n"));
 	printf(_("  -P, --progress              show progress information\n"));
@@ -13,9 +13,13 @@
 #include "postgres.h"
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <signal.h>
 #include <sys/stat.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "access/transam.h"
@@ -26,6 +30,7 @@
 #include "common/fe_memutils.h"
 #include "common/file_perm.h"
 #include "common/file_utils.h"
+#include "common/hashfn.h"
 #include "common/logging.h"
 #include "common/relpath.h"
 #include "getopt_long.h"
@@ -62,6 +67,9 @@ typedef struct XLogDumpConfig
 	bool		follow;
 	bool		stats;
 	bool		stats_per_record;
+	bool		stats_per_relation;
+	bool		stats_csv;
+	int			jobs;
 
 	/* filter options */
 	bool		filter_by_rmgr[RM_MAX_ID + 1];
@@ -80,6 +88,47 @@ typedef struct XLogDumpConfig
 	char	   *save_fullpage_path;
 } XLogDumpConfig;
 
+/*
+ * Statistics per relation, for --stats=relation.  A record is counted for
+ * the relation of its first block reference, and each full-page image for
+ * the relation it belongs to.
+ */
+typedef struct XLogDumpRelStats
+{
+	RelFileLocator rlocator;	/* hash key */
+	char		status;			/* hash status */
+	XLogRecStats stats;
+} XLogDumpRelStats;
+
+#define SH_PREFIX		relstats
+#define SH_ELEMENT_TYPE	XLogDumpRelStats
+#define SH_KEY_TYPE		RelFileLocator
+#define	SH_KEY			rlocator
+#define SH_HASH_KEY(tb, key)	hash_bytes((const unsigned char *) &(key), sizeof(RelFileLocator))
+#define SH_EQUAL(tb, a, b)		RelFileLocatorEquals(a, b)
+#define	SH_SCOPE		static inline
+#define SH_RAW_ALLOCATOR	pg_malloc0
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+static relstats_hash *RelStats = NULL;
+
+#ifndef WIN32
+/*
+ * What a worker process of a parallel --stats run sends back to the leader,
+ * followed by nrels XLogDumpRelStats entries.
+ */
+typedef struct XLogDumpWorkerResult
+{
+	XLogStats	stats;
+	uint32		nrels;
+	bool		failed;			/* stopped at an invalid record? */
+	XLogRecPtr	failptr;		/* ... at this location */
+	char		errormsg[1024];
+} XLogDumpWorkerResult;
+#endif
+
 
 /*
  * When sigint is called, just tell the system to exit at the next possible
@@ -350,7 +399,21 @@ WALDumpOpenSegment(XLogReaderState *state, XLogSegNo nextSegNo,
 	{
 		state->seg.ws_file = open_file_in_directory(state->segcxt.ws_dir, fname);
 		if (state->seg.ws_file >= 0)
+		{
+#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+
+			/*
+			 * We're going to read the file from start to end, page by page.
+			 * Ask the kernel to read it ahead in large chunks, so the page
+			 * reads don't have to wait for the disk.
+			 */
+			(void) posix_fadvise(state->seg.ws_file, 0, 0,
+								 POSIX_FADV_SEQUENTIAL);
+			(void) posix_fadvise(state->seg.ws_file, 0, 0,
+								 POSIX_FADV_WILLNEED);
+#endif
 			return;
+		}
 		if (errno == ENOENT)
 		{
 			int			save_errno = errno;
@@ -574,11 +637,66 @@ XLogDumpDisplayRecord(XLogDumpConfig *config, XLogReaderState *record)
 	pfree(s.data);
 }
 
+/*
+ * Count a record for --stats=relation.
+ */
+static void
+XLogDumpStoreRelStats(XLogReaderState *record)
+{
+	uint32		rec_len;
+	uint32		fpi_len;
+	bool		counted = false;
+	int			block_id;
+
+	XLogRecGetLen(record, &rec_len, &fpi_len);
+
+	for (block_id = 0; block_id <= XLogRecMaxBlockId(record); block_id++)
+	{
+		RelFileLocator rlocator;
+		XLogDumpRelStats *entry;
+		bool		found;
+
+		if (!XLogRecGetBlockTagExtended(record, block_id,
+										&rlocator, NULL, NULL, NULL))
+			continue;
+
+		entry = relstats_insert(RelStats, rlocator, &found);
+		if (!found)
+			memset(&entry->stats, 0, sizeof(entry->stats));
+
+		if (!counted)
+		{
+			entry->stats.count++;
+			entry->stats.rec_len += rec_len;
+			counted = true;
+		}
+
+		if (XLogRecHasBlockImage(record, block_id))
+			entry->stats.fpi_len += XLogRecGetBlock(record, block_id)->bimg_len;
+	}
+}
+
+/*
+ * qsort comparator for XLogDumpRelStats pointers, largest combined size first.
+ */
+static int
+relstats_cmp(const void *a, const void *b)
+{
+	const XLogDumpRelStats *ra = *(XLogDumpRelStats *const *) a;
+	const XLogDumpRelStats *rb = *(XLogDumpRelStats *const *) b;
+	uint64		la = ra->stats.rec_len + ra->stats.fpi_len;
+	uint64		lb = rb->stats.rec_len + rb->stats.fpi_len;
+
+	if (la != lb)
+		return la > lb ? -1 : 1;
+	return memcmp(&ra->rlocator, &rb->rlocator, sizeof(RelFileLocator));
+}
+
 /*
  * Display a single row of record counts and sizes for an rmgr or record.
  */
 static void
-XLogDumpStatsRow(const char *name,
+XLogDumpStatsRow(XLogDumpConfig *config, const char *kind, const char *name,
 				 uint64 n, uint64 total_count,
 				 uint64 rec_len, uint64 total_rec_len,
 				 uint64 fpi_len, uint64 total_fpi_len,
@@ -589,6 +707,14 @@ XLogDumpStatsRow(const char *name,
 				fpi_len_pct,
 				tot_len_pct;
 
+	/* for machine consumption, just the raw numbers */
+	if (config->stats_csv)
+	{
+		printf("%s,%s," UINT64_FORMAT "," UINT64_FORMAT "," UINT64_FORMAT "," UINT64_FORMAT "\n",
+			   kind, name, n, rec_len, fpi_len, tot_len);
+		return;
+	}
+
 	n_pct = 0;
 	if (total_count != 0)
 		n_pct = 100 * (double) n / total_count;
@@ -629,6 +755,8 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 	uint64		total_len = 0;
 	double		rec_len_pct,
 				fpi_len_pct;
+	XLogDumpRelStats **rels = NULL;
+	int			nrels = 0;
 
 	/*
 	 * Leave if no stats have been computed yet, as tracked by the end LSN.
@@ -641,31 +769,74 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 	 * calculate column totals.
 	 */
 
-	for (ri = 0; ri <= RM_MAX_ID; ri++)
+	if (config->stats_per_relation)
 	{
-		if (!RmgrIdIsValid(ri))
-			continue;
+		relstats_iterator it;
+		XLogDumpRelStats *entry;
+
+		rels = pg_malloc(sizeof(XLogDumpRelStats *) * Max(RelStats->members, 1));
 
-		total_count += stats->rmgr_stats[ri].count;
-		total_rec_len += stats->rmgr_stats[ri].rec_len;
-		total_fpi_len += stats->rmgr_stats[ri].fpi_len;
+		relstats_start_iterate(RelStats, &it);
+		while ((entry = relstats_iterate(RelStats, &it)) != NULL)
+		{
+			rels[nrels++] = entry;
+
+			total_count += entry->stats.count;
+			total_rec_len += entry->stats.rec_len;
+			total_fpi_len += entry->stats.fpi_len;
+		}
+
+		qsort(rels, nrels, sizeof(XLogDumpRelStats *), relstats_cmp);
 	}
-	total_len = total_rec_len + total_fpi_len;
+	else
+	{
+		for (ri = 0; ri <= RM_MAX_ID; ri++)
+		{
+			if (!RmgrIdIsValid(ri))
+				continue;
 
-	printf("WAL statistics between %X/%X and %X/%X:\n",
-		   LSN_FORMAT_ARGS(stats->startptr), LSN_FORMAT_ARGS(stats->endptr));
+			total_count += stats->rmgr_stats[ri].count;
+			total_rec_len += stats->rmgr_stats[ri].rec_len;
+			total_fpi_len += stats->rmgr_stats[ri].fpi_len;
+		}
+	}
+	total_len = total_rec_len + total_fpi_len;
 
-	/*
-	 * 27 is strlen("Transaction/COMMIT_PREPARED"), 20 is strlen(2^64), 8 is
-	 * strlen("(100.00%)")
-	 */
+	if (config->stats_csv)
+		printf("kind,name,count,record_size,fpi_size,combined_size\n");
+	else
+	{
+		printf("WAL statistics between %X/%X and %X/%X:\n",
+			   LSN_FORMAT_ARGS(stats->startptr), LSN_FORMAT_ARGS(stats->endptr));
+
+		/*
+		 * 27 is strlen("Transaction/COMMIT_PREPARED"), 20 is strlen(2^64), 8
+		 * is strlen("(100.00%)")
+		 */
+
+		printf("%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n"
+			   "%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n",
+			   config->stats_per_relation ? "Relation" : "Type",
+			   "N", "(%)", "Record size", "(%)", "FPI size", "(%)", "Combined size", "(%)",
+			   "----", "-", "---", "-----------", "---", "--------", "---", "-------------", "---");
+	}
 
-	printf("%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n"
-		   "%-27s %20s %8s %20s %8s %20s %8s %20s %8s\n",
-		   "Type", "N", "(%)", "Record size", "(%)", "FPI size", "(%)", "Combined size", "(%)",
-		   "----", "-", "---", "-----------", "---", "--------", "---", "-------------", "---");
+	for (int i = 0; i < nrels; i++)
+	{
+		XLogRecStats *relstats = &rels[i]->stats;
+
+		XLogDumpStatsRow(config, "relation",
+						 psprintf("%u/%u/%u",
+								  rels[i]->rlocator.spcOid,
+								  rels[i]->rlocator.dbOid,
+								  rels[i]->rlocator.relNumber),
+						 relstats->count, total_count,
+						 relstats->rec_len, total_rec_len,
+						 relstats->fpi_len, total_fpi_len,
+						 relstats->rec_len + relstats->fpi_len, total_len);
+	}
 
-	for (ri = 0; ri <= RM_MAX_ID; ri++)
+	for (ri = 0; ri <= RM_MAX_ID && !config->stats_per_relation; ri++)
 	{
 		uint64		count,
 					rec_len,
@@ -688,7 +859,7 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 			if (RmgrIdIsCustom(ri) && count == 0)
 				continue;
 
-			XLogDumpStatsRow(desc->rm_name,
+			XLogDumpStatsRow(config, "rmgr", desc->rm_name,
 							 count, total_count, rec_len, total_rec_len,
 							 fpi_len, total_fpi_len, tot_len, total_len);
 		}
@@ -712,13 +883,18 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 				if (id == NULL)
 					id = psprintf("UNKNOWN (%x)", rj << 4);
 
-				XLogDumpStatsRow(psprintf("%s/%s", desc->rm_name, id),
+				XLogDumpStatsRow(config, "record",
+								 psprintf("%s/%s", desc->rm_name, id),
 								 count, total_count, rec_len, total_rec_len,
 								 fpi_len, total_fpi_len, tot_len, total_len);
 			}
 		}
 	}
 
+	/* no totals in CSV output, they're easily computed */
+	if (config->stats_csv)
+		return;
+
 	printf("%-27s %20s %8s %20s %8s %20s %8s %20s\n",
 		   "", "--------", "", "--------", "", "--------", "", "--------");
 
@@ -742,12 +918,402 @@ XLogDumpDisplayStats(XLogDumpConfig *config, XLogStats *stats)
 		   "%20" INT64_MODIFIER "u %-9s"
 		   "%20" INT64_MODIFIER "u %-9s"
 		   "%20" INT64_MODIFIER "u %-6s\n",
-		   "Total", stats->count, "",
+		   "Total", config->stats_per_relation ? total_count : stats->count, "",
 		   total_rec_len, psprintf("[%.02f%%]", rec_len_pct),
 		   total_fpi_len, psprintf("[%.02f%%]", fpi_len_pct),
 		   total_len, "[100%]");
 }
 
+/*
+ * Display a message that we're skipping data if `from` wasn't a pointer to
+ * the start of a record and also wasn't a pointer to the beginning of a
+ * segment (e.g. we were used in file mode).
+ */
+static void
+XLogDumpReportSkip(XLogRecPtr from, XLogRecPtr first_record)
+{
+	if (first_record != from &&
+		XLogSegmentOffset(from, WalSegSz) != 0)
+		printf(ngettext("first record is after %X/%X, at %X/%X, skipping over %u byte\n",
+						"first record is after %X/%X, at %X/%X, skipping over %u bytes\n",
+						(first_record - from)),
+			   LSN_FORMAT_ARGS(from),
+			   LSN_FORMAT_ARGS(first_record),
+			   (uint32) (first_record - from));
+}
+
+/*
+ * Read records until the end of WAL, an invalid record, or a record that starts
+ * at or after stopptr (if valid), and display or count those that pass the
+ * filters.
+ *
+ * Returns the error message if reading stopped at an invalid record, or NULL.
+ */
+static char *
+XLogDumpReadRecords(XLogDumpConfig *config, XLogReaderState *xlogreader_state,
+					XLogStats *stats, XLogRecPtr stopptr)
+{
+	XLogDumpPrivate *private = xlogreader_state->private_data;
+	XLogRecord *record;
+	char	   *errormsg = NULL;
+
+	for (;;)
+	{
+		if (time_to_stop)
+		{
+			/* We've been Ctrl-C'ed, so leave */
+			break;
+		}
+
+		/* try to read the next record */
+		record = XLogReadRecord(xlogreader_state, &errormsg);
+		if (!record)
+		{
+			if (!config->follow || private->endptr_reached)
+				break;
+			else
+			{
+				pg_usleep(1000000L);	/* 1 second */
+				continue;
+			}
+		}
+
+		/* the rest is left to the next worker */
+		if (!XLogRecPtrIsInvalid(stopptr) &&
+			xlogreader_state->ReadRecPtr >= stopptr)
+			break;
+
+		/* apply all specified filters */
+		if (config->filter_by_rmgr_enabled &&
+			!config->filter_by_rmgr[record->xl_rmid])
+			continue;
+
+		if (config->filter_by_xid_enabled &&
+			config->filter_by_xid != record->xl_xid)
+			continue;
+
+		/* check for extended filtering */
+		if (config->filter_by_extended &&
+			!XLogRecordMatchesRelationBlock(xlogreader_state,
+											config->filter_by_relation_enabled ?
+											config->filter_by_relation :
+											emptyRelFileLocator,
+											config->filter_by_relation_block_enabled ?
+											config->filter_by_relation_block :
+											InvalidBlockNumber,
+											config->filter_by_relation_forknum))
+			continue;
+
+		if (config->filter_by_fpw && !XLogRecordHasFPW(xlogreader_state))
+			continue;
+
+		/* perform any per-record work */
+		if (!config->quiet)
+		{
+			if (config->stats == true)
+			{
+				XLogRecStoreStats(stats, xlogreader_state);
+				if (config->stats_per_relation)
+					XLogDumpStoreRelStats(xlogreader_state);
+				stats->endptr = xlogreader_state->EndRecPtr;
+			}
+			else
+				XLogDumpDisplayRecord(config, xlogreader_state);
+		}
+
+		/* save full pages if requested */
+		if (config->save_fullpage_path != NULL)
+			XLogRecordSaveFPWs(xlogreader_state, config->save_fullpage_path);
+
+		/* check whether we printed enough */
+		config->already_displayed_records++;
+		if (config->stop_after_records > 0 &&
+			config->already_displayed_records >= config->stop_after_records)
+			break;
+	}
+
+	return errormsg;
+}
+
+#ifndef WIN32
+/*
+ * Write or read all of a buffer to or from a pipe.
+ */
+static void
+write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t		rc = write(fd, p, len);
+
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			pg_fatal("could not write to pipe: %m");
+		}
+		p += rc;
+		len -= rc;
+	}
+}
+
+static bool
+read_all(int fd, void *buf, size_t len)
+{
+	char	   *p = buf;
+
+	while (len > 0)
+	{
+		ssize_t		rc = read(fd, p, len);
+
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			pg_fatal("could not read from pipe: %m");
+		}
+		if (rc == 0)
+			return false;
+		p += rc;
+		len -= rc;
+	}
+
+	return true;
+}
+
+/*
+ * Add the statistics collected by a worker process to *stats and RelStats.
+ */
+static void
+XLogDumpMergeStats(XLogStats *stats, const XLogStats *wstats)
+{
+	int			ri,
+				rj;
+
+	if (XLogRecPtrIsInvalid(wstats->endptr))
+		return;
+
+	stats->count += wstats->count;
+	for (ri = 0; ri <= RM_MAX_ID; ri++)
+	{
+		stats->rmgr_stats[ri].count += wstats->rmgr_stats[ri].count;
+		stats->rmgr_stats[ri].rec_len += wstats->rmgr_stats[ri].rec_len;
+		stats->rmgr_stats[ri].fpi_len += wstats->rmgr_stats[ri].fpi_len;
+
+		for (rj = 0; rj < MAX_XLINFO_TYPES; rj++)
+		{
+			stats->record_stats[ri][rj].count += wstats->record_stats[ri][rj].count;
+			stats->record_stats[ri][rj].rec_len += wstats->record_stats[ri][rj].rec_len;
+			stats->record_stats[ri][rj].fpi_len += wstats->record_stats[ri][rj].fpi_len;
+		}
+	}
+
+	/* the workers are merged in WAL order */
+	if (XLogRecPtrIsInvalid(stats->startptr))
+		stats->startptr = wstats->startptr;
+	stats->endptr = wstats->endptr;
+}
+
+/*
+ * Body of a worker process: compute the statistics of the records starting
+ * between startptr and stopptr (or the end, if invalid), and send them to
+ * the leader through fd.
+ */
+static void
+XLogDumpWorker(XLogDumpConfig *config, XLogDumpPrivate *private,
+			   char *waldir, XLogRecPtr startptr, XLogRecPtr stopptr,
+			   bool first, int fd)
+{
+	XLogReaderState *xlogreader_state;
+	XLogDumpWorkerResult *result;
+	XLogRecPtr	first_record;
+	char	   *errormsg = NULL;
+
+	result = pg_malloc0(sizeof(XLogDumpWorkerResult));
+	result->stats.startptr = InvalidXLogRecPtr;
+	result->stats.endptr = InvalidXLogRecPtr;
+
+	xlogreader_state =
+		XLogReaderAllocate(WalSegSz, waldir,
+						   XL_ROUTINE(.page_read = WALDumpReadPage,
+									  .segment_open = WALDumpOpenSegment,
+									  .segment_close = WALDumpCloseSegment),
+						   private);
+	if (!xlogreader_state)
+		pg_fatal("out of memory while allocating a WAL reading processor");
+
+	/*
+	 * Resynchronize on the first record starting in our part.  Only the
+	 * leader's start location must have one; later parts may be past the
+	 * end of WAL, or taken up by a record continued from before.
+	 */
+	first_record = XLogFindNextRecord(xlogreader_state, startptr);
+	if (first)
+	{
+		if (first_record == InvalidXLogRecPtr)
+			pg_fatal("could not find a valid record after %X/%X",
+					 LSN_FORMAT_ARGS(startptr));
+		XLogDumpReportSkip(startptr, first_record);
+	}
+
+	if (first_record != InvalidXLogRecPtr &&
+		(XLogRecPtrIsInvalid(stopptr) || first_record < stopptr))
+	{
+		result->stats.startptr = first_record;
+		errormsg = XLogDumpReadRecords(config, xlogreader_state,
+									   &result->stats, stopptr);
+		if (errormsg)
+		{
+			result->failed = true;
+			result->failptr = xlogreader_state->ReadRecPtr;
+			strlcpy(result->errormsg, errormsg, sizeof(result->errormsg));
+		}
+	}
+
+	if (RelStats)
+		result->nrels = RelStats->members;
+
+	write_all(fd, result, sizeof(XLogDumpWorkerResult));
+	if (RelStats)
+	{
+		relstats_iterator it;
+		XLogDumpRelStats *entry;
+
+		relstats_start_iterate(RelStats, &it);
+		while ((entry = relstats_iterate(RelStats, &it)) != NULL)
+			write_all(fd, entry, sizeof(XLogDumpRelStats));
+	}
+	close(fd);
+
+	XLogReaderFree(xlogreader_state);
+}
+
+/*
+ * Compute statistics for the WAL between private->startptr and
+ * private->endptr using config->jobs worker processes.  Each takes an equal
+ * share of the segments, and counts the records starting in them.  The
+ * results are merged into *stats in WAL order, up to the first worker that
+ * found an invalid record, as a serial run would have stopped there.
+ *
+ * Returns the error message for the invalid record, if any, and its location
+ * in *failptr.
+ */
+static char *
+XLogDumpParallelStats(XLogDumpConfig *config, XLogDumpPrivate *private,
+					  char *waldir, XLogStats *stats, XLogRecPtr *failptr)
+{
+	XLogSegNo	startsegno;
+	XLogSegNo	endsegno;
+	uint64		nsegs;
+	int			njobs;
+	int		   *fds;
+	pid_t	   *pids;
+	XLogDumpWorkerResult *result;
+	char	   *errormsg = NULL;
+
+	XLByteToSeg(private->startptr, startsegno, WalSegSz);
+	XLByteToPrevSeg(private->endptr, endsegno, WalSegSz);
+	nsegs = endsegno - startsegno + 1;
+	njobs = (int) Min((uint64) config->jobs, nsegs);
+
+	fds = pg_malloc(sizeof(int) * njobs);
+	pids = pg_malloc(sizeof(pid_t) * njobs);
+
+	/* don't let the workers inherit unflushed output */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (int i = 0; i < njobs; i++)
+	{
+		XLogRecPtr	startptr;
+		XLogRecPtr	stopptr = InvalidXLogRecPtr;
+		int			pipefd[2];
+
+		if (i == 0)
+			startptr = private->startptr;
+		else
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * i / njobs, 0,
+									WalSegSz, startptr);
+		if (i < njobs - 1)
+			XLogSegNoOffsetToRecPtr(startsegno + nsegs * (i + 1) / njobs, 0,
+									WalSegSz, stopptr);
+
+		if (pipe(pipefd) < 0)
+			pg_fatal("could not create pipe: %m");
+
+		pids[i] = fork();
+		if (pids[i] < 0)
+			pg_fatal("could not create worker process: %m");
+		if (pids[i] == 0)
+		{
+			/* in the worker */
+			close(pipefd[0]);
+			for (int j = 0; j < i; j++)
+				close(fds[j]);
+			XLogDumpWorker(config, private, waldir, startptr, stopptr,
+						   i == 0, pipefd[1]);
+			exit(0);
+		}
+
+		close(pipefd[1]);
+		fds[i] = pipefd[0];
+	}
+
+	/* collect the results in WAL order */
+	result = pg_malloc(sizeof(XLogDumpWorkerResult));
+	for (int i = 0; i < njobs; i++)
+	{
+		bool		complete;
+		int			status;
+
+		complete = read_all(fds[i], result, sizeof(XLogDumpWorkerResult));
+		for (uint32 j = 0; complete && j < result->nrels; j++)
+		{
+			XLogDumpRelStats wentry;
+			XLogDumpRelStats *entry;
+			bool		found;
+
+			complete = read_all(fds[i], &wentry, sizeof(XLogDumpRelStats));
+			if (!complete || errormsg)
+				continue;
+
+			entry = relstats_insert(RelStats, wentry.rlocator, &found);
+			if (!found)
+				memset(&entry->stats, 0, sizeof(entry->stats));
+			entry->stats.count += wentry.stats.count;
+			entry->stats.rec_len += wentry.stats.rec_len;
+			entry->stats.fpi_len += wentry.stats.fpi_len;
+		}
+		close(fds[i]);
+
+		if (waitpid(pids[i], &status, 0) != pids[i])
+			pg_fatal("could not wait for worker process: %m");
+		if (status != 0)
+			pg_fatal("worker process failed: %s", wait_result_to_str(status));
+		if (!complete)
+			pg_fatal("worker process exited without sending its statistics");
+
+		if (errormsg)
+			continue;
+
+		XLogDumpMergeStats(stats, &result->stats);
+		if (result->failed)
+		{
+			*failptr = result->failptr;
+			errormsg = pg_strdup(result->errormsg);
+		}
+	}
+
+	pg_free(result);
+	pg_free(fds);
+	pg_free(pids);
+
+	return errormsg;
+}
+#endif							/* !WIN32 */
+
 static void
 usage(void)
 {
@@ -762,6 +1328,7 @@ usage(void)
 	printf(_("  -f, --follow           keep retrying after reaching end of WAL\n"));
 	printf(_("  -F, --fork=FORK        only show records that modify blocks in fork FORK;\n"
 			 "                         valid names are main, fsm, vm, init\n"));
+	printf(_("  -j, --jobs=NUM         use this many parallel jobs to compute statistics\n"));
 	printf(_("  -n, --limit=N          number of records to display\n"));
 	printf(_("  -p, --path=PATH        directory in which to find WAL segment files or a\n"
 			 "                         directory with a ./pg_wal that contains such files\n"
@@ -778,7 +1345,9 @@ usage(void)
 	printf(_("  -x, --xid=XID          only show records with transaction ID XID\n"));
 	printf(_("  -z, --stats[=record]   show statistics instead of records\n"
 			 "                         (optionally, show per-record statistics)\n"));
+	printf(_("  -z, --stats=relation   show statistics per relation instead of records\n"));
 	printf(_("  --save-fullpage=DIR    save full page images to DIR\n"));
+	printf(_("  --stats-format=FORMAT  output format of statistics: text (default) or csv\n"));
 	printf(_("  -?, --help             show this help, then exit\n"));
 	printf(_("\nReport bugs to <%s>.\n"), PACKAGE_BUGREPORT);
 	printf(_("%s home page: <%s>\n"), PACKAGE_NAME, PACKAGE_URL);
@@ -793,7 +1362,6 @@ main(int argc, char **argv)
 	XLogDumpPrivate private;
 	XLogDumpConfig config;
 	XLogStats	stats;
-	XLogRecord *record;
 	XLogRecPtr	first_record;
 	char	   *waldir = NULL;
 	char	   *errormsg;
@@ -806,6 +1374,7 @@ main(int argc, char **argv)
 		{"fork", required_argument, NULL, 'F'},
 		{"fullpage", no_argument, NULL, 'w'},
 		{"help", no_argument, NULL, '?'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"limit", required_argument, NULL, 'n'},
 		{"path", required_argument, NULL, 'p'},
 		{"quiet", no_argument, NULL, 'q'},
@@ -817,6 +1386,7 @@ main(int argc, char **argv)
 		{"version", no_argument, NULL, 'V'},
 		{"stats", optional_argument, NULL, 'z'},
 		{"save-fullpage", required_argument, NULL, 1},
+		{"stats-format", required_argument, NULL, 2},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -871,6 +1441,9 @@ main(int argc, char **argv)
 	config.save_fullpage_path = NULL;
 	config.stats = false;
 	config.stats_per_record = false;
+	config.stats_per_relation = false;
+	config.stats_csv = false;
+	config.jobs = 1;
 
 	stats.startptr = InvalidXLogRecPtr;
 	stats.endptr = InvalidXLogRecPtr;
@@ -881,7 +1454,7 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
-	while ((option = getopt_long(argc, argv, "bB:e:fF:n:p:qr:R:s:t:wx:z",
+	while ((option = getopt_long(argc, argv, "bB:e:fF:j:n:p:qr:R:s:t:wx:z",
 								 long_options, &optindex)) != -1)
 	{
 		switch (option)
@@ -920,6 +1493,14 @@ main(int argc, char **argv)
 				}
 				config.filter_by_extended = true;
 				break;
+			case 'j':
+				if (sscanf(optarg, "%d", &config.jobs) != 1 ||
+					config.jobs < 1)
+				{
+					pg_log_error("invalid value \"%s\" for option %s", optarg, "-j/--jobs");
+					goto bad_argument;
+				}
+				break;
 			case 'n':
 				if (sscanf(optarg, "%d", &config.stop_after_records) != 1)
 				{
@@ -1057,10 +1638,13 @@ main(int argc, char **argv)
 			case 'z':
 				config.stats = true;
 				config.stats_per_record = false;
+				config.stats_per_relation = false;
 				if (optarg)
 				{
 					if (strcmp(optarg, "record") == 0)
 						config.stats_per_record = true;
+					else if (strcmp(optarg, "relation") == 0)
+						config.stats_per_relation = true;
 					else if (strcmp(optarg, "rmgr") != 0)
 					{
 						pg_log_error("unrecognized value for option %s: %s",
@@ -1072,6 +1656,18 @@ main(int argc, char **argv)
 			case 1:
 				config.save_fullpage_path = pg_strdup(optarg);
 				break;
+			case 2:
+				if (strcmp(optarg, "csv") == 0)
+					config.stats_csv = true;
+				else if (strcmp(optarg, "text") == 0)
+					config.stats_csv = false;
+				else
+				{
+					pg_log_error("unrecognized value for option %s: %s",
+								 "--stats-format", optarg);
+					goto bad_argument;
+				}
+				break;
 			default:
 				goto bad_argument;
 		}
@@ -1085,6 +1681,33 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
+	if (config.jobs > 1)
+	{
+#ifdef WIN32
+		pg_log_error("option %s is not supported on this platform",
+					 "-j/--jobs");
+		goto bad_argument;
+#endif
+		if (!config.stats)
+		{
+			pg_log_error("option %s requires option %s to be specified",
+						 "-j/--jobs", "-z/--stats");
+			goto bad_argument;
+		}
+		if (config.follow)
+		{
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-f/--follow");
+			goto bad_argument;
+		}
+		if (config.stop_after_records > 0)
+		{
+			pg_log_error("options %s and %s cannot be used together",
+						 "-j/--jobs", "-n/--limit");
+			goto bad_argument;
+		}
+	}
+
 	if ((optind + 2) < argc)
 	{
 		pg_log_error("too many command-line arguments (first is \"%s\")",
@@ -1194,8 +1817,41 @@ main(int argc, char **argv)
 		goto bad_argument;
 	}
 
+	/* the WAL is divided between the jobs by segments */
+	if (config.jobs > 1 && XLogRecPtrIsInvalid(private.endptr))
+	{
+		pg_log_error("option %s requires an end WAL location",
+					 "-j/--jobs");
+		goto bad_argument;
+	}
+
+	if (config.stats_per_relation)
+		RelStats = relstats_create(1024, NULL);
+
 	/* done with argument parsing, do the actual work */
 
+#ifndef WIN32
+	if (config.jobs > 1)
+	{
+		XLogRecPtr	failptr = InvalidXLogRecPtr;
+
+		errormsg = XLogDumpParallelStats(&config, &private, waldir, &stats,
+										 &failptr);
+
+		if (!config.quiet)
+			XLogDumpDisplayStats(&config, &stats);
+
+		if (time_to_stop)
+			exit(0);
+
+		if (errormsg)
+			pg_fatal("error in WAL record at %X/%X: %s",
+					 LSN_FORMAT_ARGS(failptr), errormsg);
+
+		return EXIT_SUCCESS;
+	}
+#endif
+
 	/* we have everything we need, start reading */
 	xlogreader_state =
 		XLogReaderAllocate(WalSegSz, waldir,
@@ -1213,90 +1869,13 @@ main(int argc, char **argv)
 		pg_fatal("could not find a valid record after %X/%X",
 				 LSN_FORMAT_ARGS(private.startptr));
 
-	/*
-	 * Display a message that we're skipping data if `from` wasn't a pointer
-	 * to the start of a record and also wasn't a pointer to the beginning of
-	 * a segment (e.g. we were used in file mode).
-	 */
-	if (first_record != private.startptr &&
-		XLogSegmentOffset(private.startptr, WalSegSz) != 0)
-		printf(ngettext("first record is after %X/%X, at %X/%X, skipping over %u byte\n",
-						"first record is after %X/%X, at %X/%X, skipping over %u bytes\n",
-						(first_record - private.startptr)),
-			   LSN_FORMAT_ARGS(private.startptr),
-			   LSN_FORMAT_ARGS(first_record),
-			   (uint32) (first_record - private.startptr));
+	XLogDumpReportSkip(private.startptr, first_record);
 
 	if (config.stats == true && !config.quiet)
 		stats.startptr = first_record;
 
-	for (;;)
-	{
-		if (time_to_stop)
-		{
-			/* We've been Ctrl-C'ed, so leave */
-			break;
-		}
-
-		/* try to read the next record */
-		record = XLogReadRecord(xlogreader_state, &errormsg);
-		if (!record)
-		{
-			if (!config.follow || private.endptr_reached)
-				break;
-			else
-			{
-				pg_usleep(1000000L);	/* 1 second */
-				continue;
-			}
-		}
-
-		/* apply all specified filters */
-		if (config.filter_by_rmgr_enabled &&
-			!config.filter_by_rmgr[record->xl_rmid])
-			continue;
-
-		if (config.filter_by_xid_enabled &&
-			config.filter_by_xid != record->xl_xid)
-			continue;
-
-		/* check for extended filtering */
-		if (config.filter_by_extended &&
-			!XLogRecordMatchesRelationBlock(xlogreader_state,
-											config.filter_by_relation_enabled ?
-											config.filter_by_relation :
-											emptyRelFileLocator,
-											config.filter_by_relation_block_enabled ?
-											config.filter_by_relation_block :
-											InvalidBlockNumber,
-											config.filter_by_relation_forknum))
-			continue;
-
-		if (config.filter_by_fpw && !XLogRecordHasFPW(xlogreader_state))
-			continue;
-
-		/* perform any per-record work */
-		if (!config.quiet)
-		{
-			if (config.stats == true)
-			{
-				XLogRecStoreStats(&stats, xlogreader_state);
-				stats.endptr = xlogreader_state->EndRecPtr;
-			}
-			else
-				XLogDumpDisplayRecord(&config, xlogreader_state);
-		}
-
-		/* save full pages if requested */
-		if (config.save_fullpage_path != NULL)
-			XLogRecordSaveFPWs(xlogreader_state, config.save_fullpage_path);
-
-		/* check whether we printed enough */
-		config.already_displayed_records++;
-		if (config.stop_after_records > 0 &&
-			config.already_displayed_records >= config.stop_after_records)
-			break;
-	}
+	errormsg = XLogDumpReadRecords(&config, xlogreader_state, &stats,
+								   InvalidXLogRecPtr);
 
 	if (config.stats == true && !config.quiet)
 		XLogDumpDisplayStats(&config, &stats);
@@ -358,7 +358,22 @@ typedef struct
 #define SHELL_COMMAND_SIZE	256 /* maximum size allowed for shell command */
 
 /*
- * Simple data structure to keep stats about something.
+ * Latency histogram, in the manner of HDR histograms: values below
+ * LATENCY_HIST_SUB_COUNT microseconds have a bucket each, and every power of
+ * two above that is divided into LATENCY_HIST_SUB_COUNT / 2 buckets, so that
+ * any value is known to within 1/64th, up to 2^(LATENCY_HIST_MAX_MSB + 1)
+ * microseconds (about 100 days).  Larger values go into the last bucket.
+ */
+#define LATENCY_HIST_SUB_BITS	7
+#define LATENCY_HIST_SUB_COUNT	(1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_MSB	42
+#define LATENCY_HIST_BUCKETS	(LATENCY_HIST_SUB_COUNT + \
+								 (LATENCY_HIST_MAX_MSB - LATENCY_HIST_SUB_BITS + 1) * \
+								 (LATENCY_HIST_SUB_COUNT / 2))
+
+/*
+ * Simple data structure to keep stats about something, which is a latency in
+ * microseconds for all the users of it.
  *
  * XXX probably the first value should be kept and used as an offset for
  * better numerical stability...
@@ -370,8 +385,12 @@ typedef struct SimpleStats
 	double		max;			/* the maximum seen */
 	double		sum;			/* sum of values */
 	double		sum2;			/* sum of squared values */
+	int64		hist[LATENCY_HIST_BUCKETS]; /* distribution of values */
 } SimpleStats;
 
+/* latency percentiles shown in reports, the last one being the maximum */
+static const double report_pcts[] = {50.0, 99.0, 99.9, 100.0};
+
 /*
  * The instr_time type is expensive when dealing with time arithmetic.  Define
  * a type to hold microseconds instead.  Type int64 is good enough for about
@@ -881,6 +900,7 @@ usage(void)
 		   "  -I, --init-steps=[" ALL_INIT_STEPS "]+ (default \"" DEFAULT_INIT_STEPS "\")\n"
 		   "                           run selected initialization steps\n"
 		   "  -F, --fillfactor=NUM     set fill factor\n"
+		   "  -j, --jobs=NUM           number of connections to initialize with (default: 1)\n"
 		   "  -n, --no-vacuum          do not run VACUUM during initialization\n"
 		   "  -q, --quiet              quiet logging (one message each 5 seconds)\n"
 		   "  -s, --scale=NUM          scaling factor\n"
@@ -1391,6 +1411,48 @@ initSimpleStats(SimpleStats *ss)
 	memset(ss, 0, sizeof(SimpleStats));
 }
 
+/*
+ * Return the histogram bucket of a latency, in microseconds.
+ */
+static int
+latencyHistBucket(double val)
+{
+	uint64		v = val > 0 ? (uint64) val : 0;
+	int			msb;
+
+	if (v < LATENCY_HIST_SUB_COUNT)
+		return (int) v;
+
+	msb = pg_leftmost_one_pos64(v);
+	if (msb > LATENCY_HIST_MAX_MSB)
+		return LATENCY_HIST_BUCKETS - 1;
+
+	return LATENCY_HIST_SUB_COUNT +
+		(msb - LATENCY_HIST_SUB_BITS) * (LATENCY_HIST_SUB_COUNT / 2) +
+		(int) (v >> (msb - LATENCY_HIST_SUB_BITS + 1)) -
+		LATENCY_HIST_SUB_COUNT / 2;
+}
+
+/*
+ * Return the highest latency, in microseconds, that falls in a bucket.
+ */
+static double
+latencyHistBucketMax(int bucket)
+{
+	int			msb;
+	uint64		sub;
+
+	if (bucket < LATENCY_HIST_SUB_COUNT)
+		return bucket;
+
+	msb = LATENCY_HIST_SUB_BITS +
+		(bucket - LATENCY_HIST_SUB_COUNT) / (LATENCY_HIST_SUB_COUNT / 2);
+	sub = (bucket - LATENCY_HIST_SUB_COUNT) % (LATENCY_HIST_SUB_COUNT / 2) +
+		LATENCY_HIST_SUB_COUNT / 2;
+
+	return (double) (((sub + 1) << (msb - LATENCY_HIST_SUB_BITS + 1)) - 1);
+}
+
 /*
  * Accumulate one value into a SimpleStats struct.
  */
@@ -1404,6 +1466,7 @@ addToSimpleStats(SimpleStats *ss, double val)
 	ss->count++;
 	ss->sum += val;
 	ss->sum2 += val * val;
+	ss->hist[latencyHistBucket(val)]++;
 }
 
 /*
@@ -1412,6 +1475,8 @@ addToSimpleStats(SimpleStats *ss, double val)
 static void
 mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 {
+	if (ss->count == 0)
+		return;
 	if (acc->count == 0 || ss->min < acc->min)
 		acc->min = ss->min;
 	if (acc->count == 0 || ss->max > acc->max)
@@ -1419,6 +1484,37 @@ mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 	acc->count += ss->count;
 	acc->sum += ss->sum;
 	acc->sum2 += ss->sum2;
+	for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		acc->hist[i] += ss->hist[i];
+}
+
+/*
+ * Compute percentiles of the values added to a SimpleStats struct since it
+ * looked like 'base' (NULL to take all of them).  pcts[] must be ascending;
+ * the corresponding results, in microseconds, are stored into res[], and are
+ * the highest value of the histogram bucket they fall in, so they may be over
+ * by up to 1/64th.  The 100th percentile comes out as the maximum.
+ */
+static void
+getSimpleStatsPercentiles(SimpleStats *ss, SimpleStats *base,
+						  const double *pcts, int npcts, double *res)
+{
+	int64		count = ss->count - (base ? base->count : 0);
+	int64		seen = 0;
+	int			p = 0;
+
+	for (int i = 0; i < LATENCY_HIST_BUCKETS && p < npcts; i++)
+	{
+		seen += ss->hist[i] - (base ? base->hist[i] : 0);
+
+		while (p < npcts && seen > 0 &&
+			   seen >= (int64) ceil(count * pcts[p] / 100.0))
+			res[p++] = Min(latencyHistBucketMax(i), ss->max);
+	}
+
+	/* nothing counted */
+	while (p < npcts)
+		res[p++] = 0.0;
 }
 
 /*
@@ -3995,7 +4091,7 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 					command = sql_script[st->use_file].commands[st->command];
 					/* XXX could use a mutex here, but we choose not to */
 					addToSimpleStats(&command->stats,
-									 PG_TIME_GET_DOUBLE(now - st->stmt_begin));
+									 (double) (now - st->stmt_begin));
 				}
 
 				/* Go ahead with next command, to be executed or skipped */
@@ -4869,6 +4965,256 @@ initTruncateTables(PGconn *con)
 					 "pgbench_tellers");
 }
 
+/*
+ * Fill pgbench_branches and pgbench_tellers, with rows generated either on
+ * the client or on the server
+ */
+static void
+initGenerateBranchesTellers(PGconn *con, bool server_side)
+{
+	PQExpBufferData sql;
+
+	initPQExpBuffer(&sql);
+
+	if (server_side)
+	{
+		printfPQExpBuffer(&sql,
+						  "insert into pgbench_branches(bid,bbalance) "
+						  "select bid, 0 "
+						  "from generate_series(1, %d) as bid", nbranches * scale);
+		executeStatement(con, sql.data);
+
+		printfPQExpBuffer(&sql,
+						  "insert into pgbench_tellers(tid,bid,tbalance) "
+						  "select tid, (tid - 1) / %d + 1, 0 "
+						  "from generate_series(1, %d) as tid", ntellers, ntellers * scale);
+		executeStatement(con, sql.data);
+	}
+	else
+	{
+		for (int i = 0; i < nbranches * scale; i++)
+		{
+			/* "filler" column defaults to NULL */
+			printfPQExpBuffer(&sql,
+							  "insert into pgbench_branches(bid,bbalance) values(%d,0)",
+							  i + 1);
+			executeStatement(con, sql.data);
+		}
+
+		for (int i = 0; i < ntellers * scale; i++)
+		{
+			/* "filler" column defaults to NULL */
+			printfPQExpBuffer(&sql,
+							  "insert into pgbench_tellers(tid,bid,tbalance) values (%d,%d,0)",
+							  i + 1, i / ntellers + 1);
+			executeStatement(con, sql.data);
+		}
+	}
+
+	termPQExpBuffer(&sql);
+}
+
+/*
+ * A piece of initialization work that runs on a connection of its own, so
+ * that with -j several of them run concurrently.  A task either runs a
+ * single statement, or loads a range of aids of pgbench_accounts into the
+ * given table, in a transaction of its own.
+ */
+typedef struct InitTask
+{
+	char	   *sql;			/* statement to run, or NULL to load rows */
+
+	/* fields used when loading rows */
+	char	   *target;			/* table to load */
+	int64		first_aid;		/* range of aids to load */
+	int64		last_aid;
+	bool		truncate;		/* truncate target in the same transaction */
+	bool		server_side;	/* generate the rows on the server */
+} InitTask;
+
+typedef struct InitWorker
+{
+	THREAD_T	thread;			/* thread handle, unless worker 0 */
+	PGconn	   *con;			/* connection of this worker */
+	int			id;				/* worker number, 0..nworkers - 1 */
+	int			nworkers;		/* total number of workers */
+	InitTask   *tasks;			/* all the tasks; this worker runs those */
+	int			ntasks;			/* whose index is id modulo nworkers */
+	pg_time_usec_t start;		/* start of the step, for progress messages */
+} InitWorker;
+
+/*
+ * Load one range of aids into one table, in a transaction of its own
+ */
+static void
+runLoadTask(PGconn *con, InitTask *task)
+{
+	PQExpBufferData sql;
+
+	initPQExpBuffer(&sql);
+
+	executeStatement(con, "begin");
+
+	/*
+	 * Truncating in the loading transaction enables the backend's
+	 * data-loading optimizations, like it does for the non-parallel case.
+	 */
+	if (task->truncate)
+	{
+		printfPQExpBuffer(&sql, "truncate table %s", task->target);
+		executeStatement(con, sql.data);
+	}
+
+	if (task->first_aid > task->last_aid)
+		;						/* nothing to load, e.g. a trailing partition */
+	else if (task->server_side)
+	{
+		printfPQExpBuffer(&sql,
+						  "insert into %s(aid,bid,abalance,filler) "
+						  "select aid, (aid - 1) / %d + 1, 0, '' "
+						  "from generate_series(" INT64_FORMAT ", " INT64_FORMAT ") as aid",
+						  task->target, naccounts,
+						  task->first_aid, task->last_aid);
+		executeStatement(con, sql.data);
+	}
+	else
+	{
+		PGresult   *res;
+
+		/* COPY FREEZE is only allowed when truncating in this transaction */
+		printfPQExpBuffer(&sql, "copy %s from stdin%s", task->target,
+						  task->truncate && PQserverVersion(con) >= 140000 ?
+						  " with (freeze on)" : "");
+		res = PQexec(con, sql.data);
+		if (PQresultStatus(res) != PGRES_COPY_IN)
+			pg_fatal("unexpected copy in result: %s", PQerrorMessage(con));
+		PQclear(res);
+
+		for (int64 aid = task->first_aid; aid <= task->last_aid; aid++)
+		{
+			/* "filler" column defaults to blank padded empty string */
+			printfPQExpBuffer(&sql,
+							  INT64_FORMAT "\t" INT64_FORMAT "\t%d\t\n",
+							  aid, (aid - 1) / naccounts + 1, 0);
+			if (PQputline(con, sql.data))
+				pg_fatal("PQputline failed");
+
+			if (CancelRequested)
+				break;
+		}
+
+		if (PQputline(con, "\\.\n"))
+			pg_fatal("very last PQputline failed");
+		if (PQendcopy(con))
+			pg_fatal("PQendcopy failed");
+	}
+
+	executeStatement(con, "commit");
+
+	termPQExpBuffer(&sql);
+}
+
+/*
+ * Run the share of the tasks of one worker
+ */
+static THREAD_FUNC_RETURN_TYPE THREAD_FUNC_CC
+initWorkerRun(void *arg)
+{
+	InitWorker *worker = (InitWorker *) arg;
+
+	for (int i = worker->id; i < worker->ntasks; i += worker->nworkers)
+	{
+		InitTask   *task = &worker->tasks[i];
+
+		if (CancelRequested)
+			break;
+
+		if (task->sql != NULL)
+			executeStatement(worker->con, task->sql);
+		else
+		{
+			runLoadTask(worker->con, task);
+
+			if (!use_quiet)
+				fprintf(stderr, "loaded aids " INT64_FORMAT " to " INT64_FORMAT " into %s (elapsed %.2f s)\n",
+						task->first_aid, task->last_aid, task->target,
+						PG_TIME_GET_DOUBLE(pg_time_now() - worker->start));
+		}
+	}
+
+	THREAD_FUNC_RETURN;
+}
+
+/*
+ * Run the given tasks over up to nthreads connections, one thread each.
+ * The caller's connection serves the first worker, which runs in the
+ * calling thread; the others get connections of their own.
+ */
+static void
+runInitTasks(PGconn *con, InitTask *tasks, int ntasks)
+{
+	int			nworkers = Min(nthreads, ntasks);
+	InitWorker *workers;
+	pg_time_usec_t start = pg_time_now();
+
+	if (nworkers < 1)
+		return;
+
+	workers = pg_malloc0(sizeof(InitWorker) * nworkers);
+
+	for (int i = 0; i < nworkers; i++)
+	{
+		workers[i].id = i;
+		workers[i].nworkers = nworkers;
+		workers[i].tasks = tasks;
+		workers[i].ntasks = ntasks;
+		workers[i].start = start;
+
+		if (i == 0)
+			workers[i].con = con;
+		else if ((workers[i].con = doConnect()) == NULL)
+			pg_fatal("could not create connection for initialization");
+	}
+
+#ifdef ENABLE_THREAD_SAFETY
+	/* start all workers but worker 0 which is executed directly later */
+	for (int i = 1; i < nworkers; i++)
+	{
+		errno = THREAD_CREATE(&workers[i].thread, initWorkerRun, &workers[i]);
+		if (errno != 0)
+			pg_fatal("could not create thread: %m");
+	}
+#else
+	Assert(nworkers == 1);
+#endif							/* ENABLE_THREAD_SAFETY */
+
+	(void) initWorkerRun(&workers[0]);
+
+	for (int i = 1; i < nworkers; i++)
+	{
+#ifdef ENABLE_THREAD_SAFETY
+		THREAD_JOIN(workers[i].thread);
+#endif							/* ENABLE_THREAD_SAFETY */
+		PQfinish(workers[i].con);
+	}
+
+	pg_free(workers);
+}
+
+/*
+ * Release the statements of tasks made by the functions below
+ */
+static void
+freeInitTasks(InitTask *tasks, int ntasks)
+{
+	for (int i = 0; i < ntasks; i++)
+	{
+		pg_free(tasks[i].sql);
+		pg_free(tasks[i].target);
+	}
+	pg_free(tasks);
+}
+
 /*
  * Fill the standard tables with some data generated and sent from the client
  */
@@ -4877,7 +5223,6 @@ initGenerateDataClientSide(PGconn *con)
 {
 	PQExpBufferData sql;
 	PGresult   *res;
-	int			i;
 	int64		k;
 	char	   *copy_statement;
 
@@ -4905,23 +5250,7 @@ initGenerateDataClientSide(PGconn *con)
 	 * fill branches, tellers, accounts in that order in case foreign keys
 	 * already exist
 	 */
-	for (i = 0; i < nbranches * scale; i++)
-	{
-		/* "filler" column defaults to NULL */
-		printfPQExpBuffer(&sql,
-						  "insert into pgbench_branches(bid,bbalance) values(%d,0)",
-						  i + 1);
-		executeStatement(con, sql.data);
-	}
-
-	for (i = 0; i < ntellers * scale; i++)
-	{
-		/* "filler" column defaults to NULL */
-		printfPQExpBuffer(&sql,
-						  "insert into pgbench_tellers(tid,bid,tbalance) values (%d,%d,0)",
-						  i + 1, i / ntellers + 1);
-		executeStatement(con, sql.data);
-	}
+	initGenerateBranchesTellers(con, false);
 
 	/*
 	 * accounts is big enough to be worth using COPY and tracking runtime
@@ -5024,19 +5353,9 @@ initGenerateDataServerSide(PGconn *con)
 	/* truncate away any old data */
 	initTruncateTables(con);
 
-	initPQExpBuffer(&sql);
-
-	printfPQExpBuffer(&sql,
-					  "insert into pgbench_branches(bid,bbalance) "
-					  "select bid, 0 "
-					  "from generate_series(1, %d) as bid", nbranches * scale);
-	executeStatement(con, sql.data);
+	initGenerateBranchesTellers(con, true);
 
-	printfPQExpBuffer(&sql,
-					  "insert into pgbench_tellers(tid,bid,tbalance) "
-					  "select tid, (tid - 1) / %d + 1, 0 "
-					  "from generate_series(1, %d) as tid", ntellers, ntellers * scale);
-	executeStatement(con, sql.data);
+	initPQExpBuffer(&sql);
 
 	printfPQExpBuffer(&sql,
 					  "insert into pgbench_accounts(aid,bid,abalance,filler) "
@@ -5050,17 +5369,133 @@ initGenerateDataServerSide(PGconn *con)
 	executeStatement(con, "commit");
 }
 
+/*
+ * Fill the standard tables over several connections, for -j greater than 1
+ *
+ * pgbench_branches and pgbench_tellers are small, and are filled first on
+ * the main connection.  pgbench_accounts is then loaded in disjoint ranges
+ * of aids, one transaction each.  With range partitioning and at least as
+ * many partitions as connections, each range is a partition, truncated in
+ * the loading transaction so that the backend's data-loading optimizations
+ * still apply.  Otherwise the ranges are loaded into pgbench_accounts
+ * itself, which gets its rows frozen by the vacuum step instead.
+ */
+static void
+initGenerateDataParallel(PGconn *con, bool server_side)
+{
+	int64		total = (int64) naccounts * scale;
+	bool		per_partition;
+	InitTask   *tasks;
+	int			ntasks;
+
+	fprintf(stderr, "generating data (%s-side) with %d connections...\n",
+			server_side ? "server" : "client", nthreads);
+
+	/*
+	 * A partition can't be truncated on its own while a foreign key
+	 * references pgbench_accounts, so load the partitions separately only
+	 * if there's none.
+	 */
+	per_partition = (partition_method == PART_RANGE && partitions >= nthreads);
+	if (per_partition)
+	{
+		PGresult   *res;
+
+		res = PQexec(con,
+					 "select 1 from pg_catalog.pg_constraint "
+					 "where confrelid = 'pgbench_accounts'::pg_catalog.regclass");
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pg_fatal("query failed: %s", PQerrorMessage(con));
+		if (PQntuples(res) > 0)
+			per_partition = false;
+		PQclear(res);
+	}
+
+	executeStatement(con, "begin");
+
+	/* truncate away any old data, but leave partitions to their loaders */
+	if (per_partition)
+		executeStatement(con, "truncate table "
+						 "pgbench_branches, "
+						 "pgbench_history, "
+						 "pgbench_tellers");
+	else
+		initTruncateTables(con);
+
+	initGenerateBranchesTellers(con, server_side);
+
+	executeStatement(con, "commit");
+
+	ntasks = per_partition ? partitions : nthreads;
+	tasks = pg_malloc0(sizeof(InitTask) * ntasks);
+
+	for (int i = 0; i < ntasks; i++)
+	{
+		InitTask   *task = &tasks[i];
+
+		task->server_side = server_side;
+		if (per_partition)
+		{
+			/* same bounds as in createPartitions */
+			int64		part_size = (total + partitions - 1) / partitions;
+
+			task->target = psprintf("pgbench_accounts_%d", i + 1);
+			task->truncate = true;
+			task->first_aid = i * part_size + 1;
+			task->last_aid = Min((i + 1) * part_size, total);
+		}
+		else
+		{
+			task->target = pg_strdup("pgbench_accounts");
+			task->first_aid = total * i / ntasks + 1;
+			task->last_aid = total * (i + 1) / ntasks;
+		}
+	}
+
+	runInitTasks(con, tasks, ntasks);
+	freeInitTasks(tasks, ntasks);
+}
+
 /*
  * Invoke vacuum on the standard tables
  */
 static void
 initVacuum(PGconn *con)
 {
-	fprintf(stderr, "vacuuming...\n");
-	executeStatement(con, "vacuum analyze pgbench_branches");
-	executeStatement(con, "vacuum analyze pgbench_tellers");
-	executeStatement(con, "vacuum analyze pgbench_accounts");
-	executeStatement(con, "vacuum analyze pgbench_history");
+	InitTask   *tasks;
+	int			ntasks = 0;
+
+	if (nthreads == 1)
+	{
+		fprintf(stderr, "vacuuming...\n");
+		executeStatement(con, "vacuum analyze pgbench_branches");
+		executeStatement(con, "vacuum analyze pgbench_tellers");
+		executeStatement(con, "vacuum analyze pgbench_accounts");
+		executeStatement(con, "vacuum analyze pgbench_history");
+		return;
+	}
+
+	/*
+	 * With several connections, vacuum the tables concurrently, and each
+	 * partition of pgbench_accounts on its own.
+	 */
+	fprintf(stderr, "vacuuming with %d connections...\n", nthreads);
+
+	tasks = pg_malloc0(sizeof(InitTask) * (Max(partitions, 1) + 3));
+	for (int p = 1; p <= partitions; p++)
+		tasks[ntasks++].sql = psprintf("vacuum analyze pgbench_accounts_%d", p);
+	if (partitions == 0)
+		tasks[ntasks++].sql = pg_strdup("vacuum analyze pgbench_accounts");
+	tasks[ntasks++].sql = pg_strdup("vacuum analyze pgbench_branches");
+	tasks[ntasks++].sql = pg_strdup("vacuum analyze pgbench_tellers");
+	tasks[ntasks++].sql = pg_strdup("vacuum analyze pgbench_history");
+
+	runInitTasks(con, tasks, ntasks);
+	freeInitTasks(tasks, ntasks);
+
+	/* statistics of the partitioned table as a whole */
+	if (partitions > 0)
+		executeStatement(con, "analyze pgbench_accounts");
 }
 
 /*
@@ -5076,29 +5511,72 @@ initCreatePKeys(PGconn *con)
 	};
 	int			i;
 	PQExpBufferData query;
+	char	   *tablespace_clause = "";
+	InitTask   *tasks;
+	int			ntasks = 0;
 
-	fprintf(stderr, "creating primary keys...\n");
-	initPQExpBuffer(&query);
+	if (index_tablespace != NULL)
+	{
+		char	   *escape_tablespace;
 
-	for (i = 0; i < lengthof(DDLINDEXes); i++)
+		escape_tablespace = PQescapeIdentifier(con, index_tablespace,
+											   strlen(index_tablespace));
+		tablespace_clause = psprintf(" using index tablespace %s",
+									 escape_tablespace);
+		PQfreemem(escape_tablespace);
+	}
+
+	if (nthreads == 1)
 	{
-		resetPQExpBuffer(&query);
-		appendPQExpBufferStr(&query, DDLINDEXes[i]);
+		fprintf(stderr, "creating primary keys...\n");
+		initPQExpBuffer(&query);
 
-		if (index_tablespace != NULL)
+		for (i = 0; i < lengthof(DDLINDEXes); i++)
 		{
-			char	   *escape_tablespace;
-
-			escape_tablespace = PQescapeIdentifier(con, index_tablespace,
-												   strlen(index_tablespace));
-			appendPQExpBuffer(&query, " using index tablespace %s", escape_tablespace);
-			PQfreemem(escape_tablespace);
+			printfPQExpBuffer(&query, "%s%s", DDLINDEXes[i], tablespace_clause);
+			executeStatement(con, query.data);
 		}
 
+		termPQExpBuffer(&query);
+		if (index_tablespace != NULL)
+			pg_free(tablespace_clause);
+		return;
+	}
+
+	/*
+	 * With several connections, build the indexes concurrently.  On a
+	 * partitioned pgbench_accounts, each partition gets its primary key on
+	 * its own first; adding the primary key to pgbench_accounts afterwards
+	 * then just attaches those.
+	 */
+	fprintf(stderr, "creating primary keys with %d connections...\n", nthreads);
+
+	tasks = pg_malloc0(sizeof(InitTask) * (Max(partitions, 1) + 2));
+	for (int p = 1; p <= partitions; p++)
+		tasks[ntasks++].sql = psprintf("alter table pgbench_accounts_%d add primary key (aid)%s",
+									   p, tablespace_clause);
+	for (i = 0; i < lengthof(DDLINDEXes); i++)
+	{
+		/* pgbench_accounts is last, see above */
+		if (partitions > 0 && i == lengthof(DDLINDEXes) - 1)
+			break;
+		tasks[ntasks++].sql = psprintf("%s%s", DDLINDEXes[i], tablespace_clause);
+	}
+
+	runInitTasks(con, tasks, ntasks);
+	freeInitTasks(tasks, ntasks);
+
+	if (partitions > 0)
+	{
+		initPQExpBuffer(&query);
+		printfPQExpBuffer(&query, "%s%s",
+						  DDLINDEXes[lengthof(DDLINDEXes) - 1], tablespace_clause);
 		executeStatement(con, query.data);
+		termPQExpBuffer(&query);
 	}
 
-	termPQExpBuffer(&query);
+	if (index_tablespace != NULL)
+		pg_free(tablespace_clause);
 }
 
 /*
@@ -5184,11 +5662,17 @@ runInitSteps(const char *initialize_steps)
 				break;
 			case 'g':
 				op = "client-side generate";
-				initGenerateDataClientSide(con);
+				if (nthreads > 1)
+					initGenerateDataParallel(con, false);
+				else
+					initGenerateDataClientSide(con);
 				break;
 			case 'G':
 				op = "server-side generate";
-				initGenerateDataServerSide(con);
+				if (nthreads > 1)
+					initGenerateDataParallel(con, true);
+				else
+					initGenerateDataServerSide(con);
 				break;
 			case 'v':
 				op = "vacuum";
@@ -6156,6 +6640,7 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 				lag,
 				stdev;
 	char		tbuf[315];
+	double		pcts[lengthof(report_pcts)];
 	StatsData	cur;
 
 	/*
@@ -6200,6 +6685,9 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 	failures = getFailures(&cur) - getFailures(last);
 	retried = cur.retried - last->retried;
 
+	getSimpleStatsPercentiles(&cur.latency, &last->latency, report_pcts,
+							  lengthof(report_pcts), pcts);
+
 	if (progress_timestamp)
 	{
 		snprintf(tbuf, sizeof(tbuf), "%.3f s",
@@ -6212,8 +6700,10 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 	}
 
 	fprintf(stderr,
-			"progress: %s, %.1f tps, lat %.3f ms stddev %.3f, " INT64_FORMAT " failed",
-			tbuf, tps, latency, stdev, failures);
+			"progress: %s, %.1f tps, lat %.3f ms stddev %.3f, p50 %.3f p99 %.3f p99.9 %.3f max %.3f ms, " INT64_FORMAT " failed",
+			tbuf, tps, latency, stdev,
+			0.001 * pcts[0], 0.001 * pcts[1], 0.001 * pcts[2],
+			0.001 * pcts[3], failures);
 
 	if (throttle_delay)
 	{
@@ -6241,9 +6731,16 @@ printSimpleStats(const char *prefix, SimpleStats *ss)
 	{
 		double		latency = ss->sum / ss->count;
 		double		stddev = sqrt(ss->sum2 / ss->count - latency * latency);
+		double		pcts[lengthof(report_pcts)];
+
+		getSimpleStatsPercentiles(ss, NULL, report_pcts,
+								  lengthof(report_pcts), pcts);
 
 		printf("%s average = %.3f ms\n", prefix, 0.001 * latency);
 		printf("%s stddev = %.3f ms\n", prefix, 0.001 * stddev);
+		printf("%s percentiles: p50 = %.3f ms, p99 = %.3f ms, p99.9 = %.3f ms, max = %.3f ms\n",
+			   prefix, 0.001 * pcts[0], 0.001 * pcts[1], 0.001 * pcts[2],
+			   0.001 * pcts[3]);
 	}
 }
 
@@ -6372,8 +6869,13 @@ printResults(StatsData *total,
 		 * transaction.  The measured lag may be caused by thread/client load,
 		 * the database load, or the Poisson throttling process.
 		 */
-		printf("rate limit schedule lag: avg %.3f (max %.3f) ms\n",
-			   0.001 * total->lag.sum / total->cnt, 0.001 * total->lag.max);
+		double		pcts[lengthof(report_pcts)];
+
+		getSimpleStatsPercentiles(&total->lag, NULL, report_pcts,
+								  lengthof(report_pcts), pcts);
+		printf("rate limit schedule lag: avg %.3f (p99 %.3f, max %.3f) ms\n",
+			   0.001 * total->lag.sum / total->cnt, 0.001 * pcts[1],
+			   0.001 * total->lag.max);
 	}
 
 	/*
@@ -6462,7 +6964,7 @@ printResults(StatsData *total,
 			{
 				Command   **commands;
 
-				printf("%sstatement latencies in milliseconds%s:\n",
+				printf("%sstatement latencies in milliseconds (average, p99, max)%s:\n",
 					   per_script_stats ? " - " : "",
 					   (max_tries == 1 ?
 						" and failures" :
@@ -6473,17 +6975,23 @@ printResults(StatsData *total,
 					 commands++)
 				{
 					SimpleStats *cstats = &(*commands)->stats;
+					double		pcts[lengthof(report_pcts)];
+
+					getSimpleStatsPercentiles(cstats, NULL, report_pcts,
+											  lengthof(report_pcts), pcts);
 
 					if (max_tries == 1)
-						printf("   %11.3f  %10" INT64_MODIFIER "d  %s\n",
+						printf("   %11.3f %11.3f %11.3f  %10" INT64_MODIFIER "d  %s\n",
 							   (cstats->count > 0) ?
-							   1000.0 * cstats->sum / cstats->count : 0.0,
+							   0.001 * cstats->sum / cstats->count : 0.0,
+							   0.001 * pcts[1], 0.001 * pcts[3],
 							   (*commands)->failures,
 							   (*commands)->first_line);
 					else
-						printf("   %11.3f  %10" INT64_MODIFIER "d  %10" INT64_MODIFIER "d  %s\n",
+						printf("   %11.3f %11.3f %11.3f  %10" INT64_MODIFIER "d  %10" INT64_MODIFIER "d  %s\n",
 							   (cstats->count > 0) ?
-							   1000.0 * cstats->sum / cstats->count : 0.0,
+							   0.001 * cstats->sum / cstats->count : 0.0,
+							   0.001 * pcts[1], 0.001 * pcts[3],
 							   (*commands)->failures,
 							   (*commands)->retries,
 							   (*commands)->first_line);
@@ -6742,8 +7250,7 @@ main(int argc, char **argv)
 				checkInitSteps(initialize_steps);
 				initialization_option_set = true;
 				break;
-			case 'j':			/* jobs */
-				benchmarking_option_set = true;
+			case 'j':			/* jobs, in both modes */
 				if (!option_parse_int(optarg, "-j/--jobs", 1, INT_MAX,
 									  &nthreads))
 				{
@@ -84,6 +84,51 @@ $node->pgbench(
 	],
 	'pgbench scale 1 initialization');
 
+# Initialize over several connections, client-side into a plain table and
+# server-side into partitions
+$node->pgbench(
+	'-i -j 3 -s 2',
+	0,
+	[qr{^$}],
+	[
+		qr{dropping old tables},
+		qr{creating tables},
+		qr{generating data \(client-side\) with 3 connections},
+		qr{vacuuming with 3 connections},
+		qr{creating primary keys with 3 connections},
+		qr{done in \d+\.\d\d s }
+	],
+	'pgbench parallel initialization');
+is( $node->safe_psql(
+		'postgres',
+		'SELECT (SELECT count(*) FROM pgbench_branches), '
+		  . '(SELECT count(*) FROM pgbench_tellers), '
+		  . '(SELECT count(*) FROM pgbench_accounts), '
+		  . '(SELECT count(DISTINCT aid) FROM pgbench_accounts)'),
+	'2|20|200000|200000',
+	'pgbench parallel initialization row counts');
+
+$node->pgbench(
+	'-i -j 2 -s 2 -I dtGvp --partitions=4',
+	0,
+	[qr{^$}],
+	[
+		qr{creating 4 partitions},
+		qr{generating data \(server-side\) with 2 connections},
+		qr{vacuuming with 2 connections},
+		qr{creating primary keys with 2 connections},
+		qr{done in \d+\.\d\d s }
+	],
+	'pgbench parallel server-side initialization with partitions');
+is( $node->safe_psql(
+		'postgres',
+		'SELECT (SELECT count(*) FROM pgbench_branches), '
+		  . '(SELECT count(*) FROM pgbench_tellers), '
+		  . '(SELECT count(*) FROM pgbench_accounts), '
+		  . '(SELECT count(DISTINCT aid) FROM pgbench_accounts)'),
+	'2|20|200000|200000',
+	'pgbench parallel server-side initialization row counts');
+
 # Test interaction of --init-steps with legacy step-selection options
 $node->pgbench(
 	'--initialize --init-steps=dtpvGvv --no-vacuum --foreign-keys --unlogged-tables --partitions=3',
@@ -24,6 +24,13 @@
 #include "settings.h"
 #include "stringutils.h"
 
+/*
+ * stdio buffer size for the files and pipes \copy opens itself.  The default
+ * of a few kB means a system call for every few rows, which makes psql the
+ * bottleneck of a large \copy.
+ */
+#define COPY_STREAM_BUFSIZ	(1024 * 1024)
+
 /*
  * parse_slash_copy
  * -- parses \copy command line
@@ -332,6 +339,10 @@ do_copy(const char *args)
 		return false;
 	}
 
+	/* use a large buffer for the streams we opened; see COPY_STREAM_BUFSIZ */
+	if (options->file)
+		setvbuf(copystream, NULL, _IOFBF, COPY_STREAM_BUFSIZ);
+
 	if (!options->program)
 	{
 		struct stat st;
@@ -504,8 +515,11 @@ handleCopyOut(PGconn *conn, FILE *copystream, PGresult **res)
  * result is true if successful, false if not.
  */
 
-/* read chunk size for COPY IN - size is not critical */
-#define COPYBUFSIZ 8192
+/*
+ * read chunk size for COPY IN; each chunk is sent with one PQputCopyData()
+ * call, so make it large enough that the per-call overhead doesn't matter
+ */
+#define COPYBUFSIZ 65536
 
 bool
 handleCopyIn(PGconn *conn, FILE *copystream, bool isbinary, PGresult **res)
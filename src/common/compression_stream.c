@@ -0,0 +1,409 @@
+/*-------------------------------------------------------------------------
+ *
+ * compression_stream.c
+ *	  Streaming compression for the frontend/backend protocol.
+ *
+ * A ZStream compresses everything one side of a connection sends, and
+ * decompresses everything it receives, as two continuous streams.  Each
+ * call to zs_compress() flushes the compressor, so that the peer can
+ * decompress all the data handed over so far as soon as it arrives; the
+ * compression context is kept across calls, so later messages still
+ * benefit from what earlier ones looked like.
+ *
+ * This is shared by libpq and the backend's pqcomm.c, and therefore never
+ * throws errors: failures are reported by the return value, with a message
+ * available from zs_errmsg().
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  src/common/compression_stream.c
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "common/compression_stream.h"
+
+/*
+ * In backend, allocate in TopMemoryContext without throwing errors, as this
+ * is used from the communication layer.  In frontend, use malloc to be able
+ * to return a failure status back to the caller.
+ */
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#define ALLOC(size) MemoryContextAllocExtended(TopMemoryContext, size, \
+											   MCXT_ALLOC_NO_OOM)
+#define FREE(ptr) pfree(ptr)
+#else
+#define ALLOC(size) malloc(size)
+#define FREE(ptr) free(ptr)
+#endif
+
+struct ZStream
+{
+	pg_compress_algorithm algorithm;
+	const char *errmsg;			/* last error, or NULL */
+	bool		read_pending;	/* might decompress more without new input? */
+
+	/* output of the last zs_compress() call */
+	char	   *outbuf;
+	size_t		outbufsize;
+
+#ifdef USE_LZ4
+	LZ4F_cctx  *lz4_cctx;
+	LZ4F_dctx  *lz4_dctx;
+	LZ4F_preferences_t lz4_prefs;
+	bool		lz4_started;	/* frame header sent? */
+#endif
+#ifdef USE_ZSTD
+	ZSTD_CCtx  *zstd_cctx;
+	ZSTD_DCtx  *zstd_dctx;
+#endif
+};
+
+/*
+ * Parse a protocol compression setting of the form "algorithm" or
+ * "algorithm:level", where level 0 stands for the library's default.
+ *
+ * Returns false if the setting is malformed, or names an algorithm that is
+ * not usable for protocol compression in this build.
+ */
+bool
+zs_parse_spec(const char *spec, pg_compress_algorithm *algorithm, int *level)
+{
+	char		name[16];
+	const char *sep = strchr(spec, ':');
+	size_t		namelen = sep ? sep - spec : strlen(spec);
+	int			minlevel = 0;
+	int			maxlevel = 0;
+
+	if (namelen >= sizeof(name))
+		return false;
+	memcpy(name, spec, namelen);
+	name[namelen] = '\0';
+	if (!parse_compress_algorithm(name, algorithm))
+		return false;
+
+	switch (*algorithm)
+	{
+#ifdef USE_LZ4
+		case PG_COMPRESSION_LZ4:
+			minlevel = 0;
+			maxlevel = 12;		/* LZ4HC_CLEVEL_MAX */
+			break;
+#endif
+#ifdef USE_ZSTD
+		case PG_COMPRESSION_ZSTD:
+			minlevel = ZSTD_minCLevel();
+			maxlevel = ZSTD_maxCLevel();
+			break;
+#endif
+		default:
+			return false;
+	}
+
+	*level = 0;
+	if (sep != NULL)
+	{
+		char	   *end;
+		long		val;
+
+		errno = 0;
+		val = strtol(sep + 1, &end, 10);
+		if (sep[1] == '\0' || *end != '\0' || errno != 0 ||
+			val < minlevel || val > maxlevel)
+			return false;
+		*level = (int) val;
+	}
+
+	return true;
+}
+
+/*
+ * Create a stream for the given algorithm, which must have been accepted by
+ * zs_parse_spec().  Returns NULL if out of memory.
+ */
+ZStream *
+zs_create(pg_compress_algorithm algorithm, int level)
+{
+	ZStream    *zs;
+
+	zs = ALLOC(sizeof(ZStream));
+	if (zs == NULL)
+		return NULL;
+	memset(zs, 0, sizeof(ZStream));
+	zs->algorithm = algorithm;
+
+	switch (algorithm)
+	{
+#ifdef USE_LZ4
+		case PG_COMPRESSION_LZ4:
+			if (LZ4F_isError(LZ4F_createCompressionContext(&zs->lz4_cctx,
+														   LZ4F_VERSION)) ||
+				LZ4F_isError(LZ4F_createDecompressionContext(&zs->lz4_dctx,
+															 LZ4F_VERSION)))
+				goto fail;
+			zs->lz4_prefs.compressionLevel = level;
+			zs->lz4_prefs.autoFlush = 1;
+			break;
+#endif
+#ifdef USE_ZSTD
+		case PG_COMPRESSION_ZSTD:
+			zs->zstd_cctx = ZSTD_createCCtx();
+			zs->zstd_dctx = ZSTD_createDCtx();
+			if (zs->zstd_cctx == NULL || zs->zstd_dctx == NULL)
+				goto fail;
+			if (level != 0 &&
+				ZSTD_isError(ZSTD_CCtx_setParameter(zs->zstd_cctx,
+													ZSTD_c_compressionLevel,
+													level)))
+				goto fail;
+			break;
+#endif
+		default:
+			goto fail;
+	}
+
+	return zs;
+
+fail:
+	zs_free(zs);
+	return NULL;
+}
+
+void
+zs_free(ZStream *zs)
+{
+	if (zs == NULL)
+		return;
+#ifdef USE_LZ4
+	if (zs->lz4_cctx)
+		LZ4F_freeCompressionContext(zs->lz4_cctx);
+	if (zs->lz4_dctx)
+		LZ4F_freeDecompressionContext(zs->lz4_dctx);
+#endif
+#ifdef USE_ZSTD
+	if (zs->zstd_cctx)
+		ZSTD_freeCCtx(zs->zstd_cctx);
+	if (zs->zstd_dctx)
+		ZSTD_freeDCtx(zs->zstd_dctx);
+#endif
+	if (zs->outbuf)
+		FREE(zs->outbuf);
+	FREE(zs);
+}
+
+/*
+ * Make sure the output buffer can hold at least size bytes, keeping the
+ * first used bytes.
+ */
+static bool
+zs_reserve(ZStream *zs, size_t size, size_t used)
+{
+	char	   *newbuf;
+
+	if (zs->outbufsize >= size)
+		return true;
+
+	newbuf = ALLOC(size);
+	if (newbuf == NULL)
+	{
+		zs->errmsg = "out of memory";
+		return false;
+	}
+	if (zs->outbuf)
+	{
+		memcpy(newbuf, zs->outbuf, used);
+		FREE(zs->outbuf);
+	}
+	zs->outbuf = newbuf;
+	zs->outbufsize = size;
+	return true;
+}
+
+/*
+ * Compress srclen bytes and flush them out.
+ *
+ * Returns the compressed data and sets *dstlen to its length.  The buffer
+ * belongs to the stream and is overwritten by the next call.  Returns NULL
+ * on failure.
+ */
+const char *
+zs_compress(ZStream *zs, const char *src, size_t srclen, size_t *dstlen)
+{
+	switch (zs->algorithm)
+	{
+#ifdef USE_LZ4
+		case PG_COMPRESSION_LZ4:
+			{
+				size_t		pos = 0;
+				size_t		n;
+
+				/* the bound covers flushing, and the header is added once */
+				if (!zs_reserve(zs, LZ4F_compressBound(srclen, &zs->lz4_prefs) +
+								LZ4F_HEADER_SIZE_MAX, 0))
+					return NULL;
+
+				if (!zs->lz4_started)
+				{
+					n = LZ4F_compressBegin(zs->lz4_cctx, zs->outbuf,
+										   zs->outbufsize, &zs->lz4_prefs);
+					if (LZ4F_isError(n))
+						goto lz4_error;
+					pos += n;
+					zs->lz4_started = true;
+				}
+				n = LZ4F_compressUpdate(zs->lz4_cctx, zs->outbuf + pos,
+										zs->outbufsize - pos, src, srclen,
+										NULL);
+				if (LZ4F_isError(n))
+					goto lz4_error;
+				pos += n;
+				n = LZ4F_flush(zs->lz4_cctx, zs->outbuf + pos,
+							   zs->outbufsize - pos, NULL);
+				if (LZ4F_isError(n))
+					goto lz4_error;
+				pos += n;
+
+				*dstlen = pos;
+				return zs->outbuf;
+
+		lz4_error:
+				zs->errmsg = LZ4F_getErrorName(n);
+				return NULL;
+			}
+#endif
+#ifdef USE_ZSTD
+		case PG_COMPRESSION_ZSTD:
+			{
+				ZSTD_inBuffer in = {src, srclen, 0};
+				ZSTD_outBuffer out;
+				size_t		remaining;
+
+				if (!zs_reserve(zs, ZSTD_compressBound(srclen) +
+								ZSTD_CStreamOutSize(), 0))
+					return NULL;
+				out.dst = zs->outbuf;
+				out.size = zs->outbufsize;
+				out.pos = 0;
+
+				for (;;)
+				{
+					remaining = ZSTD_compressStream2(zs->zstd_cctx, &out, &in,
+													 ZSTD_e_flush);
+					if (ZSTD_isError(remaining))
+					{
+						zs->errmsg = ZSTD_getErrorName(remaining);
+						return NULL;
+					}
+					if (remaining == 0)
+						break;
+
+					/* shouldn't happen given the bound, but cope */
+					if (!zs_reserve(zs, zs->outbufsize * 2, out.pos))
+						return NULL;
+					out.dst = zs->outbuf;
+					out.size = zs->outbufsize;
+				}
+
+				*dstlen = out.pos;
+				return zs->outbuf;
+			}
+#endif
+		default:
+			break;
+	}
+
+	zs->errmsg = "unsupported compression algorithm";
+	return NULL;
+}
+
+/*
+ * Decompress data from src into dst.
+ *
+ * Sets *srcused to the number of input bytes consumed, and returns the
+ * number of bytes stored in dst, or -1 on failure.  Zero is returned if more
+ * input is needed before anything can be produced.
+ */
+ssize_t
+zs_decompress(ZStream *zs, const char *src, size_t srclen, size_t *srcused,
+			  char *dst, size_t dstlen)
+{
+	switch (zs->algorithm)
+	{
+#ifdef USE_LZ4
+		case PG_COMPRESSION_LZ4:
+			{
+				size_t		srcsize = srclen;
+				size_t		dstsize = dstlen;
+				size_t		ret;
+
+				ret = LZ4F_decompress(zs->lz4_dctx, dst, &dstsize,
+									  src, &srcsize, NULL);
+				if (LZ4F_isError(ret))
+				{
+					zs->errmsg = LZ4F_getErrorName(ret);
+					return -1;
+				}
+				*srcused = srcsize;
+				zs->read_pending = (srcsize < srclen || dstsize == dstlen);
+				return dstsize;
+			}
+#endif
+#ifdef USE_ZSTD
+		case PG_COMPRESSION_ZSTD:
+			{
+				ZSTD_inBuffer in = {src, srclen, 0};
+				ZSTD_outBuffer out = {dst, dstlen, 0};
+				size_t		ret;
+
+				ret = ZSTD_decompressStream(zs->zstd_dctx, &out, &in);
+				if (ZSTD_isError(ret))
+				{
+					zs->errmsg = ZSTD_getErrorName(ret);
+					return -1;
+				}
+				*srcused = in.pos;
+				zs->read_pending = (in.pos < in.size || out.pos == out.size);
+				return out.pos;
+			}
+#endif
+		default:
+			break;
+	}
+
+	zs->errmsg = "unsupported compression algorithm";
+	return -1;
+}
+
+/*
+ * Could zs_decompress() produce more output from the input it was already
+ * given?  Callers must not wait for more input from the socket while this
+ * is true.
+ */
+bool
+zs_read_pending(ZStream *zs)
+{
+	return zs->read_pending;
+}
+
+/*
+ * Return a message describing the last failure.
+ */
+const char *
+zs_errmsg(ZStream *zs)
+{
+	return zs->errmsg ? zs->errmsg : "unknown error";
+}
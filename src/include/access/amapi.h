@@ -173,6 +173,16 @@ typedef void (*amrescan_function) (IndexScanDesc scan,
 typedef bool (*amgettuple_function) (IndexScanDesc scan,
 									 ScanDirection direction);
 
+/*
+ * next batch of valid tuples: store up to maxtids heap TIDs and their recheck
+ * flags, and return the number stored, zero at the end of the scan
+ */
+typedef int (*amgetbatch_function) (IndexScanDesc scan,
+									ScanDirection direction,
+									ItemPointer tids,
+									bool *recheck,
+									int maxtids);
+
 /* fetch all valid tuples */
 typedef int64 (*amgetbitmap_function) (IndexScanDesc scan,
 									   TIDBitmap *tbm);
@@ -273,6 +283,7 @@ typedef struct IndexAmRoutine
 	ambeginscan_function ambeginscan;
 	amrescan_function amrescan;
 	amgettuple_function amgettuple; /* can be NULL */
+	amgetbatch_function amgetbatch; /* can be NULL */
 	amgetbitmap_function amgetbitmap;	/* can be NULL */
 	amendscan_function amendscan;
 	ammarkpos_function ammarkpos;	/* can be NULL */
@@ -79,6 +79,16 @@ typedef struct BrinTuple
 
 #define SizeOfBrinTuple (offsetof(BrinTuple, bt_info) + sizeof(uint8))
 
+/*
+ * A BrinTuple with its length, as passed through tuplesort by parallel index
+ * builds.
+ */
+typedef struct BrinSortTuple
+{
+	Size		tuplen;			/* length of tuple */
+	BrinTuple	tuple;			/* variable-length part follows */
+} BrinSortTuple;
+
 /*
  * bt_info manipulation macros
  */
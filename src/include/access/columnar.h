@@ -0,0 +1,207 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar.h
+ *	  POSTGRES columnar table access method definitions.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/columnar.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "access/htup_details.h"
+#include "storage/buf.h"
+#include "storage/bufpage.h"
+#include "storage/itemptr.h"
+#include "utils/relcache.h"
+#include "utils/snapshot.h"
+
+/* GUC variables */
+extern PGDLLIMPORT int columnar_compression;
+extern PGDLLIMPORT int columnar_stripe_row_limit;
+extern PGDLLIMPORT int columnar_chunk_group_row_limit;
+
+/* Compression methods for column chunks, also the values of the GUC */
+typedef enum ColumnarCompression
+{
+	COLUMNAR_COMPRESSION_NONE,
+	COLUMNAR_COMPRESSION_PGLZ,
+	COLUMNAR_COMPRESSION_LZ4,
+	COLUMNAR_COMPRESSION_ZSTD
+} ColumnarCompression;
+
+#ifdef USE_LZ4
+#define DEFAULT_COLUMNAR_COMPRESSION	COLUMNAR_COMPRESSION_LZ4
+#else
+#define DEFAULT_COLUMNAR_COMPRESSION	COLUMNAR_COMPRESSION_PGLZ
+#endif
+
+/*
+ * On-disk layout
+ *
+ * Block 0 is the metapage.  The rest of the main fork holds stripes, each a
+ * run of consecutive pages holding a ColumnarStripeHeader, one
+ * ColumnarChunk per chunk group and column, and the chunk data; and the
+ * pages of two lists, the stripe directory and the delete log, chained from
+ * the metapage.  All pages have a standard page header, and their contents
+ * start at PageGetContents(); pd_lower marks the end of the contents, so
+ * that full-page images keep them.  See columnar_storage.c.
+ */
+#define COLUMNAR_METAPAGE_BLKNO		0
+#define COLUMNAR_MAGIC				0x436F6C31	/* "Col1" */
+#define COLUMNAR_VERSION			1
+
+#define COLUMNAR_PAGE_DATA_SIZE \
+	(BLCKSZ - MAXALIGN(SizeOfPageHeaderData))
+
+typedef struct ColumnarMetaPageData
+{
+	uint32		magic;
+	uint32		version;
+	BlockNumber dir_head;		/* first stripe directory page, or invalid */
+	BlockNumber dir_tail;		/* last stripe directory page */
+	BlockNumber del_head;		/* first delete log page, or invalid */
+	BlockNumber del_tail;		/* last delete log page */
+	uint64		next_rownum;	/* first row number not yet reserved */
+} ColumnarMetaPageData;
+
+/* Header of stripe directory and delete log pages */
+typedef struct ColumnarListPageHeader
+{
+	BlockNumber next;			/* next page of the list, or invalid */
+	uint32		nitems;
+} ColumnarListPageHeader;
+
+/*
+ * A stripe directory entry.  xmin and cmin tell who wrote the stripe, for
+ * visibility checks; VACUUM replaces an old xmin with FrozenTransactionId,
+ * or with InvalidTransactionId if the writer aborted.
+ */
+typedef struct ColumnarStripeEntry
+{
+	uint64		first_rownum;
+	uint32		nrows;
+	BlockNumber first_block;
+	uint32		nblocks;
+	uint32		datalen;		/* bytes of stripe data */
+	TransactionId xmin;
+	CommandId	cmin;
+} ColumnarStripeEntry;
+
+/* A delete log entry; xmax is handled like a stripe's xmin */
+typedef struct ColumnarDeleteEntry
+{
+	uint64		rownum;
+	TransactionId xmax;
+	CommandId	cmax;
+} ColumnarDeleteEntry;
+
+/* How far a reader has read a list; start with an invalid blkno */
+typedef struct ColumnarListPosition
+{
+	BlockNumber blkno;			/* last page read */
+	uint32		nitems;			/* items read from it */
+} ColumnarListPosition;
+
+#define COLUMNAR_ITEMS_PER_PAGE(itemsz) \
+	((COLUMNAR_PAGE_DATA_SIZE - sizeof(ColumnarListPageHeader)) / (itemsz))
+
+typedef struct ColumnarStripeHeader
+{
+	uint32		magic;
+	uint32		nrows;
+	uint16		natts;			/* columns at the time it was written */
+	uint16		ngroups;		/* number of chunk groups */
+	uint32		group_rows;		/* rows per chunk group but the last */
+	/* ColumnarChunk chunks[ngroups][natts] follows */
+} ColumnarStripeHeader;
+
+/* ColumnarChunk flags */
+#define COLUMNAR_CHUNK_HAS_NULLS	0x01	/* a null bitmap precedes values */
+#define COLUMNAR_CHUNK_ALL_NULL		0x02	/* no values at all */
+#define COLUMNAR_CHUNK_HAS_MINMAX	0x04	/* min and max are set */
+
+typedef struct ColumnarChunk
+{
+	uint32		offset;			/* from the start of the stripe data */
+	uint32		length;			/* stored length */
+	uint32		rawlength;		/* length after decompression */
+	uint8		compression;	/* ColumnarCompression */
+	uint8		flags;
+	Datum		min;			/* for pass-by-value types only */
+	Datum		max;
+} ColumnarChunk;
+
+#define ColumnarStripeChunk(chunks, natts, group, attno) \
+	(&(chunks)[(group) * (natts) + (attno)])
+
+/*
+ * Rows are numbered in insertion order, and row numbers map to TIDs with
+ * MaxHeapTuplesPerPage offsets per block, the most other code expects.
+ */
+#define COLUMNAR_ROWS_PER_TID_BLOCK		MaxHeapTuplesPerPage
+#define COLUMNAR_MAX_ROWNUM \
+	((uint64) (MaxBlockNumber - 1) * COLUMNAR_ROWS_PER_TID_BLOCK)
+
+static inline void
+ColumnarRowNumberToTid(uint64 rownum, ItemPointer tid)
+{
+	ItemPointerSet(tid,
+				   (BlockNumber) (rownum / COLUMNAR_ROWS_PER_TID_BLOCK),
+				   (OffsetNumber) (rownum % COLUMNAR_ROWS_PER_TID_BLOCK) +
+				   FirstOffsetNumber);
+}
+
+static inline uint64
+ColumnarTidToRowNumber(ItemPointer tid)
+{
+	return (uint64) ItemPointerGetBlockNumberNoCheck(tid) *
+		COLUMNAR_ROWS_PER_TID_BLOCK +
+		(ItemPointerGetOffsetNumberNoCheck(tid) - FirstOffsetNumber);
+}
+
+/* columnar_storage.c */
+extern uint64 columnar_reserve_rownums(Relation rel, uint64 nrows);
+extern uint64 columnar_next_rownum(Relation rel);
+extern void columnar_write_stripe(Relation rel, char *data, uint32 datalen,
+								  uint64 first_rownum, uint32 nrows,
+								  TransactionId xmin, CommandId cmin);
+extern void columnar_append_delete(Relation rel, uint64 rownum,
+								   TransactionId xmax, CommandId cmax);
+extern ColumnarStripeEntry *columnar_read_stripes(Relation rel,
+												  ColumnarListPosition *pos,
+												  int *nstripes);
+extern ColumnarDeleteEntry *columnar_read_deletes(Relation rel,
+												  ColumnarListPosition *pos,
+												  int *ndeletes);
+extern void columnar_read_stripe_data(Relation rel, ColumnarStripeEntry *stripe,
+									  uint32 offset, uint32 len, char *dest,
+									  BufferAccessStrategy strategy);
+extern void columnar_freeze(Relation rel, TransactionId OldestXmin);
+extern bool columnar_xid_visible(TransactionId xid, CommandId cid,
+								 Snapshot snapshot);
+
+/* columnar_stripe.c */
+extern char *columnar_encode_stripe(TupleDesc tupdesc, uint32 nrows,
+									Datum **values, bool **nulls,
+									uint32 group_rows, int compression,
+									uint32 *datalen);
+extern ColumnarChunk *columnar_read_stripe_header(Relation rel,
+												  ColumnarStripeEntry *stripe,
+												  ColumnarStripeHeader *hdr,
+												  BufferAccessStrategy strategy);
+extern void columnar_decode_chunk(Relation rel, ColumnarStripeEntry *stripe,
+								  ColumnarChunk *chunk, Form_pg_attribute att,
+								  uint32 nrows, Datum *values, bool *isnull,
+								  BufferAccessStrategy strategy);
+
+/* columnar_tableam.c */
+extern void columnar_flush_pending(Relation rel);
+extern void columnar_discard_pending(Relation rel);
+
+#endif							/* COLUMNAR_H */
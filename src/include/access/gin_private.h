@@ -18,6 +18,7 @@
 #include "fmgr.h"
 #include "lib/rbtree.h"
 #include "storage/bufmgr.h"
+#include "storage/shm_toc.h"
 
 /*
  * Storage type for GIN's reloptions
@@ -123,6 +124,30 @@ extern void ginEntryInsert(GinState *ginstate,
 						   ItemPointerData *items, uint32 nitem,
 						   GinStatsData *buildStats);
 
+/*
+ * GinTuple is how a parallel index build passes a key and some of its heap
+ * TIDs through tuplesort.  Participants sort them by key and first TID, and
+ * the leader merges the TID lists of equal keys.  The key value follows the
+ * header, and the (sorted) TIDs follow the key, both MAXALIGN'd.
+ */
+typedef struct GinTuple
+{
+	int			tuplen;			/* length of the whole tuple */
+	OffsetNumber attrnum;		/* index column the key belongs to */
+	GinNullCategory category;	/* key category */
+	int			keylen;			/* bytes of key data, 0 unless normal key */
+	int			nitems;			/* number of heap TIDs, at least 1 */
+} GinTuple;
+
+#define GinTupleGetKeyData(tup) \
+	((char *) (tup) + MAXALIGN(sizeof(GinTuple)))
+#define GinTupleGetItems(tup) \
+	((ItemPointer) (GinTupleGetKeyData(tup) + MAXALIGN((tup)->keylen)))
+
+extern Datum _gin_tuple_get_key(GinState *ginstate, GinTuple *tup);
+extern int	_gin_compare_tuples(GinTuple *a, GinTuple *b, GinState *ginstate);
+extern void _gin_parallel_build_main(dsm_segment *seg, shm_toc *toc);
+
 /* ginbtree.c */
 
 typedef struct GinBtreeStack
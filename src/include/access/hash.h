@@ -25,6 +25,7 @@
 #include "lib/stringinfo.h"
 #include "storage/bufmgr.h"
 #include "storage/lockdefs.h"
+#include "storage/shm_toc.h"
 #include "utils/hsearch.h"
 #include "utils/relcache.h"
 
@@ -369,6 +370,8 @@ extern bool hashinsert(Relation rel, Datum *values, bool *isnull,
 					   bool indexUnchanged,
 					   struct IndexInfo *indexInfo);
 extern bool hashgettuple(IndexScanDesc scan, ScanDirection dir);
+extern int	hashgetbatch(IndexScanDesc scan, ScanDirection dir,
+						 ItemPointer tids, bool *recheck, int maxtids);
 extern int64 hashgetbitmap(IndexScanDesc scan, TIDBitmap *tbm);
 extern IndexScanDesc hashbeginscan(Relation rel, int nkeys, int norderbys);
 extern void hashrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
@@ -453,6 +456,14 @@ extern void _h_spooldestroy(HSpool *hspool);
 extern void _h_spool(HSpool *hspool, ItemPointer self,
 					 Datum *values, bool *isnull);
 extern void _h_indexbuild(HSpool *hspool, Relation heapRel);
+extern HSpool *_h_parallel_spoolinit(Relation heap, Relation index,
+									 struct IndexInfo *indexInfo,
+									 uint32 num_buckets, double *reltuples,
+									 double *indtuples);
+extern void _hash_parallel_build_main(dsm_segment *seg, shm_toc *toc);
+
+/* hashfunc.c */
+extern DatumHashFunction hash_direct_function(Oid hashfn, Oid collation);
 
 /* hashutil.c */
 extern bool _hash_checkqual(IndexScanDesc scan, IndexTuple itup);
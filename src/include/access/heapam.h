@@ -25,6 +25,7 @@
 #include "storage/bufpage.h"
 #include "storage/dsm.h"
 #include "storage/lockdefs.h"
+#include "storage/read_stream.h"
 #include "storage/shm_toc.h"
 #include "utils/relcache.h"
 #include "utils/snapshot.h"
@@ -66,6 +67,34 @@ typedef struct HeapScanDescData
 
 	HeapTupleData rs_ctup;		/* current tuple in scan, if any */
 
+	/* For scans that stream reads */
+	ReadStream *rs_read_stream;
+
+	/*
+	 * For sequential scans and TID range scans to stream reads.  The read
+	 * stream is allocated at the beginning of the scan and reset on rescan or
+	 * when the scan direction changes.  The scan direction is saved each time
+	 * a new page is requested.  If the scan direction changes from one page
+	 * to the next, the read stream releases all previously pinned buffers and
+	 * resets the prefetch block.
+	 */
+	ScanDirection rs_dir;
+	BlockNumber rs_prefetch_block;
+
+	/*
+	 * For bitmap scans and count-only sequential scans: the visibility map
+	 * buffer used by the read stream callback to skip fetching all-visible
+	 * pages, and the number of empty tuples still to be returned for the
+	 * pages it skipped.  Skipped bitmap pages are counted as exact pages the
+	 * next time a block is returned.  Sequential scans also use the tuple
+	 * count map to tell how many tuples a skipped page holds.
+	 */
+	Buffer		rs_vmbuffer;
+	Buffer		rs_tcmbuffer;
+	int			rs_empty_tuples_pending;
+	long		rs_skipped_pages;
+	bool		rs_count_only;	/* may skip pages with a known count? */
+
 	/*
 	 * For parallel scans to store page allocation data.  NULL when not
 	 * performing a parallel scan.
@@ -235,6 +264,8 @@ extern void heap_get_latest_tid(TableScanDesc sscan, ItemPointer tid);
 extern BulkInsertState GetBulkInsertState(void);
 extern void FreeBulkInsertState(BulkInsertState);
 extern void ReleaseBulkInsertStatePin(BulkInsertState bistate);
+extern void SetBulkInsertStateExpectedSize(BulkInsertState bistate,
+										   uint64 nbytes);
 
 extern void heap_insert(Relation relation, HeapTuple tup, CommandId cid,
 						int options, BulkInsertState bistate);
@@ -288,18 +319,24 @@ extern int	heap_page_prune(Relation relation, Buffer buffer,
 							struct GlobalVisState *vistest,
 							TransactionId old_snap_xmin,
 							TimestampTz old_snap_ts,
+							bool defragment,
 							int *nnewlpdead,
 							OffsetNumber *off_loc);
 extern void heap_page_prune_execute(Buffer buffer,
 									OffsetNumber *redirected, int nredirected,
 									OffsetNumber *nowdead, int ndead,
-									OffsetNumber *nowunused, int nunused);
+									OffsetNumber *nowunused, int nunused,
+									bool defragment);
 extern void heap_get_root_tuples(Page page, OffsetNumber *root_offsets);
 
 /* in heap/vacuumlazy.c */
 struct VacuumParams;
+struct TidStore;
 extern void heap_vacuum_rel(Relation rel,
 							struct VacuumParams *params, BufferAccessStrategy bstrategy);
+extern void heap_vacuum_parallel_scan(Relation rel, int nindexes,
+									  struct TidStore *dead_items, void *state,
+									  BufferAccessStrategy bstrategy);
 
 /* in heap/heapam_visibility.c */
 extern bool HeapTupleSatisfiesVisibility(HeapTuple htup, Snapshot snapshot,
@@ -238,7 +238,8 @@ typedef struct xl_heap_update
  * Note that nunused is not explicitly stored, but may be found by reference
  * to the total record length.
  *
- * Acquires a full cleanup lock.
+ * Acquires a full cleanup lock, unless deferDefrag is set; then an ordinary
+ * exclusive lock is enough, as no tuple is moved.
  */
 typedef struct xl_heap_prune
 {
@@ -247,10 +248,11 @@ typedef struct xl_heap_prune
 	uint16		ndead;
 	bool		isCatalogRel;	/* to handle recovery conflict during logical
 								 * decoding on standby */
+	bool		deferDefrag;	/* leave fragmentation for a later prune */
 	/* OFFSET NUMBERS are in the block reference 0 */
 } xl_heap_prune;
 
-#define SizeOfHeapPrune (offsetof(xl_heap_prune, isCatalogRel) + sizeof(bool))
+#define SizeOfHeapPrune (offsetof(xl_heap_prune, deferDefrag) + sizeof(bool))
 
 /*
  * The vacuum page record is similar to the prune record, but can only mark
@@ -361,6 +363,8 @@ typedef struct xl_heap_freeze_page
  *
  * Backup blk 0: visibility map buffer
  * Backup blk 1: heap buffer
+ * Backup blk 2: tuple count map buffer, if the map covers the heap page; its
+ *				 data is the int16 tuple count
  */
 typedef struct xl_heap_visible
 {
@@ -414,7 +418,8 @@ extern const char *heap2_identify(uint8 info);
 extern void heap_xlog_logical_rewrite(XLogReaderState *r);
 
 extern XLogRecPtr log_heap_visible(Relation rel, Buffer heap_buffer,
-								   Buffer vm_buffer,
+								   Buffer vm_buffer, Buffer tcm_buffer,
+								   int ntuples,
 								   TransactionId snapshotConflictHorizon,
 								   uint8 vmflags);
 
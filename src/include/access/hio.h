@@ -18,6 +18,9 @@
 #include "storage/buf.h"
 #include "utils/relcache.h"
 
+/* maximum number of pages a bulk insert asks the FSM for at once */
+#define BULK_INSERT_FSM_PAGES	32
+
 /*
  * state for bulk inserts --- private to heapam.c and hio.c
  *
@@ -44,10 +47,23 @@ typedef struct BulkInsertStateData
 	 * already_extended_by is the number of pages that this bulk inserted
 	 * extended by. If we already extended by a significant number of pages,
 	 * we can be more aggressive about extending going forward.
+	 *
+	 * expected_pages is the caller's estimate of how many more pages the
+	 * insert will need, see SetBulkInsertStateExpectedSize(), or 0.
 	 */
 	BlockNumber next_free;
 	BlockNumber last_free;
 	uint32		already_extended_by;
+	uint32		expected_pages;
+
+	/*
+	 * fsm_pages[next_fsm_page .. nfsm_pages - 1] are further pages that the
+	 * FSM reported to have enough free space when a multi-insert needed
+	 * several pages, see GetPagesWithFreeSpace().  They need rechecks too.
+	 */
+	int			nfsm_pages;
+	int			next_fsm_page;
+	BlockNumber fsm_pages[BULK_INSERT_FSM_PAGES];
 } BulkInsertStateData;
 
 
@@ -82,6 +82,8 @@ typedef BTPageOpaqueData *BTPageOpaque;
 #define BTP_HAS_GARBAGE (1 << 6)	/* page has LP_DEAD tuples (deprecated) */
 #define BTP_INCOMPLETE_SPLIT (1 << 7)	/* right sibling's downlink is missing */
 #define BTP_HAS_FULLXID	(1 << 8)	/* contains BTDeletedPageData */
+#define BTP_ALL_VISIBLE	(1 << 9)	/* all TIDs may point to all-visible
+									 * heap pages, see _bt_set_allvisible_hint */
 
 /*
  * The max allowed value of a cycle ID is a bit less than 64K.  This is
@@ -226,6 +228,7 @@ typedef struct BTMetaPageData
 #define P_HAS_GARBAGE(opaque)	(((opaque)->btpo_flags & BTP_HAS_GARBAGE) != 0)
 #define P_INCOMPLETE_SPLIT(opaque)	(((opaque)->btpo_flags & BTP_INCOMPLETE_SPLIT) != 0)
 #define P_HAS_FULLXID(opaque)	(((opaque)->btpo_flags & BTP_HAS_FULLXID) != 0)
+#define P_ALL_VISIBLE(opaque)	(((opaque)->btpo_flags & BTP_ALL_VISIBLE) != 0)
 
 /*
  * BTDeletedPageData is the page contents of a deleted page
@@ -970,6 +973,13 @@ typedef struct BTScanPosData
 	bool		moreLeft;
 	bool		moreRight;
 
+	/*
+	 * allvisible is set if the page's all-visible hint was valid when we
+	 * read it, so that all of its TIDs point to all-visible heap pages.  Only
+	 * checked for index-only scans.
+	 */
+	bool		allvisible;
+
 	/*
 	 * If we are doing an index-only scan, nextTupleOffset is the first free
 	 * location in the associated tuple storage workspace.
@@ -1024,7 +1034,14 @@ typedef BTScanPosData *BTScanPos;
 		(scanpos).nextTupleOffset = 0; \
 	} while (0)
 
-/* We need one of these for each equality-type SK_SEARCHARRAY scan key */
+/*
+ * We need one of these for each equality-type SK_SEARCHARRAY scan key, and
+ * for the skip array of a skip scan.  A skip array stands for "= any value"
+ * on a leading index column that the query doesn't constrain: its elements
+ * are the distinct values of that column, which are found in the index as
+ * the scan goes (see _bt_skip_next).  The current element is kept in the
+ * scan key itself.
+ */
 typedef struct BTArrayKeyInfo
 {
 	int			scan_key;		/* index of associated key in arrayKeyData */
@@ -1032,6 +1049,19 @@ typedef struct BTArrayKeyInfo
 	int			mark_elem;		/* index of marked element in elem_values */
 	int			num_elems;		/* number of elems in current array value */
 	Datum	   *elem_values;	/* array of num_elems Datums */
+
+	/* fields used only by a skip array */
+	bool		skip;			/* is this the skip array? */
+	bool		skip_done;		/* no more elements after the current one */
+	bool		next_valid;		/* next element already known? */
+	bool		next_null;
+	Datum		next_value;		/* next element, found by _bt_readpage */
+	BlockNumber next_page;		/* leaf page where next_value was found */
+	BlockNumber elem_page;		/* leaf page where the current one was */
+	bool		mark_done;		/* skip_done when the mark was set */
+	ScanKeyData mark_key;		/* scan key when the mark was set */
+	int			ndense;			/* consecutive elements whose tuples all
+								 * fit on a single leaf page */
 } BTArrayKeyInfo;
 
 typedef struct BTScanOpaqueData
@@ -1045,12 +1075,17 @@ typedef struct BTScanOpaqueData
 
 	/* workspace for SK_SEARCHARRAY support */
 	ScanKey		arrayKeyData;	/* modified copy of scan->keyData */
+	int			numArrayKeyData;	/* length of arrayKeyData */
 	int			numArrayKeys;	/* number of equality-type array keys (-1 if
 								 * there are any unsatisfiable array keys) */
 	int			arrayKeyCount;	/* count indicating number of array scan keys
 								 * processed */
 	BTArrayKeyInfo *arrayKeys;	/* info about each equality-type array key */
+	BTArrayKeyInfo *skipArray;	/* skip array in arrayKeys[], or NULL */
 	MemoryContext arrayContext; /* scan-lifespan context for array data */
+	BlockNumber arrayLeaf;		/* leaf page where a forward scan for the
+								 * previous array keys stopped, or
+								 * InvalidBlockNumber */
 
 	/* info about killed items if any (killedItems is NULL if never used) */
 	int		   *killedItems;	/* currPos.items indexes of killed items */
@@ -1136,6 +1171,8 @@ extern IndexScanDesc btbeginscan(Relation rel, int nkeys, int norderbys);
 extern Size btestimateparallelscan(void);
 extern void btinitparallelscan(void *target);
 extern bool btgettuple(IndexScanDesc scan, ScanDirection dir);
+extern int	btgetbatch(IndexScanDesc scan, ScanDirection dir,
+					   ItemPointer tids, bool *recheck, int maxtids);
 extern int64 btgetbitmap(IndexScanDesc scan, TIDBitmap *tbm);
 extern void btrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 					 ScanKey orderbys, int norderbys);
@@ -1243,6 +1280,9 @@ extern bool _bt_first(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_next(IndexScanDesc scan, ScanDirection dir);
 extern Buffer _bt_get_endpoint(Relation rel, uint32 level, bool rightmost,
 							   Snapshot snapshot);
+extern bool _bt_skip_next(IndexScanDesc scan, ScanDirection dir, bool first,
+						  Datum *value, bool *isnull, BlockNumber *blkno);
+extern bool _bt_tid_exists(Relation rel, Relation heaprel, IndexTuple itup);
 
 /*
  * prototypes for functions in nbtutils.c
@@ -1264,6 +1304,10 @@ extern void _bt_end_vacuum(Relation rel);
 extern void _bt_end_vacuum_callback(int code, Datum arg);
 extern Size BTreeShmemSize(void);
 extern void BTreeShmemInit(void);
+extern void _bt_set_allvisible_hint(Relation rel, Relation heaprel,
+									Buffer buf);
+extern bool _bt_allvisible_hint_valid(Relation rel, Relation heaprel,
+									  Buffer buf);
 extern bytea *btoptions(Datum reloptions, bool validate);
 extern bool btproperty(Oid index_oid, int attno,
 					   IndexAMProperty prop, const char *propname,
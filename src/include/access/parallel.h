@@ -27,6 +27,8 @@ typedef struct ParallelWorkerInfo
 	BackgroundWorkerHandle *bgwhandle;
 	shm_mq_handle *error_mqh;
 	int32		pid;
+	int			pool_slot;		/* slot in the worker pool, or -1 */
+	uint64		pool_assignment;	/* our assignment of that slot */
 } ParallelWorkerInfo;
 
 typedef struct ParallelContext
@@ -58,6 +60,10 @@ extern PGDLLIMPORT volatile sig_atomic_t ParallelMessagePending;
 extern PGDLLIMPORT int ParallelWorkerNumber;
 extern PGDLLIMPORT bool InitializingParallelWorker;
 
+/* GUC parameters */
+extern PGDLLIMPORT int parallel_worker_pool_size;
+extern PGDLLIMPORT int parallel_worker_pool_idle_timeout;
+
 #define		IsParallelWorker()		(ParallelWorkerNumber >= 0)
 
 extern ParallelContext *CreateParallelContext(const char *library_name,
@@ -79,4 +85,8 @@ extern void ParallelWorkerReportLastRecEnd(XLogRecPtr last_xlog_end);
 
 extern void ParallelWorkerMain(Datum main_arg);
 
+extern Size ParallelWorkerPoolShmemSize(void);
+extern void ParallelWorkerPoolShmemInit(void);
+extern void TerminateIdleParallelWorkers(Oid databaseId);
+
 #endif							/* PARALLEL_H */
@@ -40,6 +40,10 @@ typedef struct TableScanDescData
 	ItemPointerData rs_mintid;
 	ItemPointerData rs_maxtid;
 
+	/* Iterators for Bitmap Table Scans */
+	struct TBMIterator *rs_tbmiterator;
+	struct TBMSharedIterator *rs_shared_tbmiterator;
+
 	/*
 	 * Information about type and behaviour of the scan, a bitmask of members
 	 * of the ScanOptions enum (see tableam.h).
@@ -145,6 +149,8 @@ typedef struct IndexScanDescData
 	struct TupleDescData *xs_hitupdesc; /* rowtype descriptor of xs_hitup */
 
 	ItemPointerData xs_heaptid; /* result */
+	bool		xs_heap_allvisible; /* T if AM knows xs_heaptid's heap page is
+									 * all-visible */
 	bool		xs_heap_continue;	/* T if must keep walking, potential
 									 * further results */
 	IndexFetchTableData *xs_heapfetch;
@@ -164,6 +170,9 @@ typedef struct IndexScanDescData
 
 	/* parallel index scan information, in shared memory */
 	struct ParallelIndexScanDescData *parallel_scan;
+
+	/* lookahead queue for heap prefetching, see index_set_prefetch */
+	struct IndexPrefetchData *xs_prefetch;
 }			IndexScanDescData;
 
 /* Generic structure for parallel scans */
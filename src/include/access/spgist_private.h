@@ -19,6 +19,7 @@
 #include "catalog/pg_am_d.h"
 #include "nodes/tidbitmap.h"
 #include "storage/buf.h"
+#include "storage/shm_toc.h"
 #include "utils/geo_decls.h"
 #include "utils/relcache.h"
 
@@ -158,7 +159,9 @@ typedef struct SpGistState
 	char	   *deadTupleStorage;	/* workspace for spgFormDeadTuple */
 
 	TransactionId myXid;		/* XID to use when creating a redirect tuple */
-	bool		isBuild;		/* true if doing index build */
+	bool		isBuild;		/* true if doing serial index build */
+	bool		skipWAL;		/* true if the index is WAL-logged as a whole
+								 * at the end of its build */
 } SpGistState;
 
 /* Item to be re-examined later during a search */
@@ -487,6 +490,9 @@ typedef SpGistDeadTupleData *SpGistDeadTuple;
 #define GBUF_REQ_LEAF(flags)	(((flags) & GBUF_PARITY_MASK) == GBUF_LEAF)
 #define GBUF_REQ_NULLS(flags)	((flags) & GBUF_NULLS)
 
+/* spginsert.c */
+extern void _spg_parallel_build_main(dsm_segment *seg, shm_toc *toc);
+
 /* spgutils.c */
 
 /* reloption parameters */
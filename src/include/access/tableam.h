@@ -21,6 +21,7 @@
 #include "access/sdir.h"
 #include "access/xact.h"
 #include "executor/tuptable.h"
+#include "storage/read_stream.h"
 #include "utils/rel.h"
 #include "utils/snapshot.h"
 
@@ -35,7 +36,6 @@ extern PGDLLIMPORT bool synchronize_seqscans;
 struct BulkInsertStateData;
 struct IndexInfo;
 struct SampleScanState;
-struct TBMIterateResult;
 struct VacuumParams;
 struct ValidateIndexState;
 
@@ -61,7 +61,16 @@ typedef enum ScanOptions
 	SO_ALLOW_PAGEMODE = 1 << 8,
 
 	/* unregister snapshot at scan end? */
-	SO_TEMP_SNAPSHOT = 1 << 9
+	SO_TEMP_SNAPSHOT = 1 << 9,
+
+	/*
+	 * At the discretion of the table AM, bitmap and sequential table scans
+	 * may be able to skip fetching a block from the table if none of the
+	 * table data is needed.  If table data may be needed, set SO_NEED_TUPLES.
+	 * The table_beginscan* entry points set it for sequential scans, except
+	 * for table_beginscan_count and table_beginscan_parallel_count.
+	 */
+	SO_NEED_TUPLES = 1 << 10
 } ScanOptions;
 
 /*
@@ -373,6 +382,19 @@ typedef struct TableAmRoutine
 											  ScanDirection direction,
 											  TupleTableSlot *slot);
 
+	/*
+	 * Optional: tell the scan that the caller will only look at the columns
+	 * in attrs, a set of attribute numbers offset by
+	 * FirstLowInvalidHeapAttributeNumber (see pull_varattnos); an empty set
+	 * means none.  The scan may then leave the other columns of the
+	 * returned tuples null, which saves a column-oriented AM from reading
+	 * them.  The columns of the scan keys needn't be included.  Called after
+	 * scan_begin, before the first tuple is fetched, and stays in effect
+	 * across rescans; without a call, all columns are needed.
+	 */
+	void		(*scan_set_projection) (TableScanDesc scan,
+										struct Bitmapset *attrs);
+
 	/* ------------------------------------------------------------------------
 	 * Parallel table scan related functions.
 	 * ------------------------------------------------------------------------
@@ -648,8 +670,9 @@ typedef struct TableAmRoutine
 									BufferAccessStrategy bstrategy);
 
 	/*
-	 * Prepare to analyze block `blockno` of `scan`. The scan has been started
-	 * with table_beginscan_analyze().  See also
+	 * Prepare to analyze the next block in the read stream.  Returns false if
+	 * the stream is exhausted and true otherwise.  The scan must have been
+	 * started with table_beginscan_analyze().  See also
 	 * table_scan_analyze_next_block().
 	 *
 	 * The callback may acquire resources like locks that are held until
@@ -657,16 +680,16 @@ typedef struct TableAmRoutine
 	 * to hold a lock until all tuples on a block have been analyzed by
 	 * scan_analyze_next_tuple.
 	 *
-	 * The callback can return false if the block is not suitable for
-	 * sampling, e.g. because it's a metapage that could never contain tuples.
+	 * The callback should skip blocks that are not suitable for sampling,
+	 * e.g. because they are metapages that could never contain tuples, and
+	 * move on to the next block of the stream.
 	 *
 	 * XXX: This obviously is primarily suited for block-based AMs. It's not
 	 * clear what a good interface for non block based AMs would be, so there
 	 * isn't one yet.
 	 */
 	bool		(*scan_analyze_next_block) (TableScanDesc scan,
-											BlockNumber blockno,
-											BufferAccessStrategy bstrategy);
+											ReadStream *stream);
 
 	/*
 	 * See table_scan_analyze_next_tuple().
@@ -773,52 +796,40 @@ typedef struct TableAmRoutine
 	 */
 
 	/*
-	 * Prepare to fetch / check / return tuples from `tbmres->blockno` as part
-	 * of a bitmap table scan. `scan` was started via table_beginscan_bm().
-	 * Return false if there are no tuples to be found on the page, true
-	 * otherwise.
+	 * Prepare to fetch / check / return tuples from the next block of a
+	 * bitmap table scan.  `scan` was started via table_beginscan_bm(), and
+	 * the caller has set scan->rs_tbmiterator or scan->rs_shared_tbmiterator
+	 * to the iterator over the bitmap.  Return false if the bitmap is
+	 * exhausted, true otherwise.
 	 *
-	 * This will typically read and pin the target block, and do the necessary
-	 * work to allow scan_bitmap_next_tuple() to return tuples (e.g. it might
-	 * make sense to perform tuple visibility checks at this time). For some
-	 * AMs it will make more sense to do all the work referencing `tbmres`
-	 * contents here, for others it might be better to defer more work to
-	 * scan_bitmap_next_tuple.
+	 * This will typically read and pin the block for the next bitmap entry,
+	 * and do the necessary work to allow scan_bitmap_next_tuple() to return
+	 * tuples (e.g. it might make sense to perform tuple visibility checks at
+	 * this time).  The AM is expected to read ahead in the bitmap and
+	 * prefetch the blocks it will need, as it sees fit.
 	 *
-	 * If `tbmres->blockno` is -1, this is a lossy scan and all visible tuples
-	 * on the page have to be returned, otherwise the tuples at offsets in
-	 * `tbmres->offsets` need to be returned.
-	 *
-	 * XXX: Currently this may only be implemented if the AM uses md.c as its
-	 * storage manager, and uses ItemPointer->ip_blkid in a manner that maps
-	 * blockids directly to the underlying storage. nodeBitmapHeapscan.c
-	 * performs prefetching directly using that interface.  This probably
-	 * needs to be rectified at a later point.
-	 *
-	 * XXX: Currently this may only be implemented if the AM uses the
-	 * visibilitymap, as nodeBitmapHeapscan.c unconditionally accesses it to
-	 * perform prefetching.  This probably needs to be rectified at a later
-	 * point.
+	 * *recheck is set to whether the tuples returned for this block need to
+	 * be checked against the original index quals, and *lossy_pages or
+	 * *exact_pages is incremented for each block processed, depending on
+	 * whether the bitmap entry for it was lossy.
 	 *
 	 * Optional callback, but either both scan_bitmap_next_block and
 	 * scan_bitmap_next_tuple need to exist, or neither.
 	 */
 	bool		(*scan_bitmap_next_block) (TableScanDesc scan,
-										   struct TBMIterateResult *tbmres);
+										   bool *recheck,
+										   long *lossy_pages,
+										   long *exact_pages);
 
 	/*
 	 * Fetch the next tuple of a bitmap table scan into `slot` and return true
-	 * if a visible tuple was found, false otherwise.
-	 *
-	 * For some AMs it will make more sense to do all the work referencing
-	 * `tbmres` contents in scan_bitmap_next_block, for others it might be
-	 * better to defer more work to this callback.
+	 * if a visible tuple was found, false if there are no more tuples on the
+	 * current block.
 	 *
 	 * Optional callback, but either both scan_bitmap_next_block and
 	 * scan_bitmap_next_tuple need to exist, or neither.
 	 */
 	bool		(*scan_bitmap_next_tuple) (TableScanDesc scan,
-										   struct TBMIterateResult *tbmres,
 										   TupleTableSlot *slot);
 
 	/*
@@ -902,11 +913,26 @@ table_beginscan(Relation rel, Snapshot snapshot,
 				int nkeys, struct ScanKeyData *key)
 {
 	uint32		flags = SO_TYPE_SEQSCAN |
-		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE;
+		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE | SO_NEED_TUPLES;
 
 	return rel->rd_tableam->scan_begin(rel, snapshot, nkeys, key, NULL, flags);
 }
 
+/*
+ * Like table_beginscan(), but for a caller that only needs to know how many
+ * tuples are visible, not their contents; the returned tuples may have all
+ * columns set to null.  This lets the AM skip reading blocks whose tuple
+ * count it knows otherwise (see SO_NEED_TUPLES).
+ */
+static inline TableScanDesc
+table_beginscan_count(Relation rel, Snapshot snapshot)
+{
+	uint32		flags = SO_TYPE_SEQSCAN |
+		SO_ALLOW_STRAT | SO_ALLOW_SYNC | SO_ALLOW_PAGEMODE;
+
+	return rel->rd_tableam->scan_begin(rel, snapshot, 0, NULL, NULL, flags);
+}
+
 /*
  * Like table_beginscan(), but for scanning catalog. It'll automatically use a
  * snapshot appropriate for scanning catalog relations.
@@ -926,7 +952,7 @@ table_beginscan_strat(Relation rel, Snapshot snapshot,
 					  int nkeys, struct ScanKeyData *key,
 					  bool allow_strat, bool allow_sync)
 {
-	uint32		flags = SO_TYPE_SEQSCAN | SO_ALLOW_PAGEMODE;
+	uint32		flags = SO_TYPE_SEQSCAN | SO_ALLOW_PAGEMODE | SO_NEED_TUPLES;
 
 	if (allow_strat)
 		flags |= SO_ALLOW_STRAT;
@@ -941,13 +967,19 @@ table_beginscan_strat(Relation rel, Snapshot snapshot,
  * TableScanDesc for a bitmap heap scan.  Although that scan technology is
  * really quite unlike a standard seqscan, there is just enough commonality to
  * make it worth using the same data structure.
+ *
+ * need_tuple says whether the caller needs the contents of the tuples, as
+ * opposed to only knowing how many there are (see SO_NEED_TUPLES).
  */
 static inline TableScanDesc
 table_beginscan_bm(Relation rel, Snapshot snapshot,
-				   int nkeys, struct ScanKeyData *key)
+				   int nkeys, struct ScanKeyData *key, bool need_tuple)
 {
 	uint32		flags = SO_TYPE_BITMAPSCAN | SO_ALLOW_PAGEMODE;
 
+	if (need_tuple)
+		flags |= SO_NEED_TUPLES;
+
 	return rel->rd_tableam->scan_begin(rel, snapshot, nkeys, key, NULL, flags);
 }
 
@@ -1066,6 +1098,17 @@ table_scan_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableS
 	return sscan->rs_rd->rd_tableam->scan_getnextslot(sscan, direction, slot);
 }
 
+/*
+ * Limit the columns `sscan` has to return, if the AM supports that; see
+ * scan_set_projection.
+ */
+static inline void
+table_scan_set_projection(TableScanDesc sscan, struct Bitmapset *attrs)
+{
+	if (sscan->rs_rd->rd_tableam->scan_set_projection)
+		sscan->rs_rd->rd_tableam->scan_set_projection(sscan, attrs);
+}
+
 /* ----------------------------------------------------------------------------
  * TID Range scanning related functions.
  * ----------------------------------------------------------------------------
@@ -1160,6 +1203,21 @@ extern void table_parallelscan_initialize(Relation rel,
 extern TableScanDesc table_beginscan_parallel(Relation relation,
 											  ParallelTableScanDesc pscan);
 
+/*
+ * Like table_beginscan_parallel, but with scan keys, as for table_beginscan.
+ */
+extern TableScanDesc table_beginscan_parallel_keys(Relation relation,
+												   ParallelTableScanDesc pscan,
+												   int nkeys,
+												   struct ScanKeyData *key);
+
+/*
+ * Like table_beginscan_parallel, but for counting tuples, as for
+ * table_beginscan_count.
+ */
+extern TableScanDesc table_beginscan_parallel_count(Relation relation,
+													ParallelTableScanDesc pscan);
+
 /*
  * Restart a parallel scan.  Call this in the leader process.  Caller is
  * responsible for making sure that all workers have finished the scan
@@ -1706,19 +1764,17 @@ table_relation_vacuum(Relation rel, struct VacuumParams *params,
 }
 
 /*
- * Prepare to analyze block `blockno` of `scan`. The scan needs to have been
- * started with table_beginscan_analyze().  Note that this routine might
- * acquire resources like locks that are held until
+ * Prepare to analyze the next block in the read stream. The scan needs to
+ * have been started with table_beginscan_analyze().  Note that this routine
+ * might acquire resources like locks that are held until
  * table_scan_analyze_next_tuple() returns false.
  *
- * Returns false if block is unsuitable for sampling, true otherwise.
+ * Returns false if the stream has no more blocks to sample, true otherwise.
  */
 static inline bool
-table_scan_analyze_next_block(TableScanDesc scan, BlockNumber blockno,
-							  BufferAccessStrategy bstrategy)
+table_scan_analyze_next_block(TableScanDesc scan, ReadStream *stream)
 {
-	return scan->rs_rd->rd_tableam->scan_analyze_next_block(scan, blockno,
-															bstrategy);
+	return scan->rs_rd->rd_tableam->scan_analyze_next_block(scan, stream);
 }
 
 /*
@@ -1946,17 +2002,21 @@ table_relation_estimate_size(Relation rel, int32 *attr_widths,
  */
 
 /*
- * Prepare to fetch / check / return tuples from `tbmres->blockno` as part of
- * a bitmap table scan. `scan` needs to have been started via
- * table_beginscan_bm(). Returns false if there are no tuples to be found on
- * the page, true otherwise.
+ * Prepare to fetch / check / return tuples from the next block of a bitmap
+ * table scan. `scan` needs to have been started via table_beginscan_bm(),
+ * and its bitmap iterator set up.  Returns false if there are no more blocks
+ * to scan, true otherwise.  *recheck is set to whether the tuples of the
+ * block need rechecking, and the block is counted in *lossy_pages or
+ * *exact_pages.
  *
  * Note, this is an optionally implemented function, therefore should only be
  * used after verifying the presence (at plan time or such).
  */
 static inline bool
 table_scan_bitmap_next_block(TableScanDesc scan,
-							 struct TBMIterateResult *tbmres)
+							 bool *recheck,
+							 long *lossy_pages,
+							 long *exact_pages)
 {
 	/*
 	 * We don't expect direct calls to table_scan_bitmap_next_block with valid
@@ -1966,8 +2026,9 @@ table_scan_bitmap_next_block(TableScanDesc scan,
 	if (unlikely(TransactionIdIsValid(CheckXidAlive) && !bsysscan))
 		elog(ERROR, "unexpected table_scan_bitmap_next_block call during logical decoding");
 
-	return scan->rs_rd->rd_tableam->scan_bitmap_next_block(scan,
-														   tbmres);
+	return scan->rs_rd->rd_tableam->scan_bitmap_next_block(scan, recheck,
+														   lossy_pages,
+														   exact_pages);
 }
 
 /*
@@ -1980,7 +2041,6 @@ table_scan_bitmap_next_block(TableScanDesc scan,
  */
 static inline bool
 table_scan_bitmap_next_tuple(TableScanDesc scan,
-							 struct TBMIterateResult *tbmres,
 							 TupleTableSlot *slot)
 {
 	/*
@@ -1991,9 +2051,7 @@ table_scan_bitmap_next_tuple(TableScanDesc scan,
 	if (unlikely(TransactionIdIsValid(CheckXidAlive) && !bsysscan))
 		elog(ERROR, "unexpected table_scan_bitmap_next_tuple call during logical decoding");
 
-	return scan->rs_rd->rd_tableam->scan_bitmap_next_tuple(scan,
-														   tbmres,
-														   slot);
+	return scan->rs_rd->rd_tableam->scan_bitmap_next_tuple(scan, slot);
 }
 
 /*
@@ -2097,4 +2155,11 @@ extern void table_block_relation_estimate_size(Relation rel,
 extern const TableAmRoutine *GetTableAmRoutine(Oid amhandler);
 extern const TableAmRoutine *GetHeapamTableAmRoutine(void);
 
+/* ----------------------------------------------------------------------------
+ * Functions in columnar_tableam.c
+ * ----------------------------------------------------------------------------
+ */
+
+extern const TableAmRoutine *GetColumnarTableAmRoutine(void);
+
 #endif							/* TABLEAM_H */
@@ -283,6 +283,7 @@ extern bool TransactionIdFollowsOrEquals(TransactionId id1, TransactionId id2);
 extern TransactionId TransactionIdLatest(TransactionId mainxid,
 										 int nxids, const TransactionId *xids);
 extern XLogRecPtr TransactionIdGetCommitLSN(TransactionId xid);
+extern void TransactionLogCacheReset(void);
 
 /* in transam/varsup.c */
 extern FullTransactionId GetNewTransactionId(bool isSubXact);
@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * tuplecountmap.h
+ *		tuple count map interface
+ *
+ *
+ * Portions Copyright (c) 2007-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/tuplecountmap.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef TUPLECOUNTMAP_H
+#define TUPLECOUNTMAP_H
+
+#include "storage/block.h"
+#include "storage/buf.h"
+#include "storage/bufpage.h"
+#include "utils/relcache.h"
+
+extern bool tuplecountmap_exists(Relation rel);
+extern void tuplecountmap_extend(Relation rel, BlockNumber nheapblocks);
+extern void tuplecountmap_pin(Relation rel, BlockNumber heapBlk,
+							  Buffer *tcmbuf);
+extern bool tuplecountmap_pin_ok(BlockNumber heapBlk, Buffer tcmBuf);
+extern int	tuplecountmap_get_entry(Buffer tcmBuf, BlockNumber heapBlk);
+extern void tuplecountmap_set_entry(Buffer tcmBuf, BlockNumber heapBlk,
+									int ntuples);
+extern int	tuplecountmap_get(Relation rel, BlockNumber heapBlk,
+							  Buffer *tcmbuf);
+extern int	tuplecountmap_count_page(Page heapPage);
+
+#endif							/* TUPLECOUNTMAP_H */
@@ -32,11 +32,14 @@ extern void visibilitymap_pin(Relation rel, BlockNumber heapBlk,
 							  Buffer *vmbuf);
 extern bool visibilitymap_pin_ok(BlockNumber heapBlk, Buffer vmbuf);
 extern void visibilitymap_set(Relation rel, BlockNumber heapBlk, Buffer heapBuf,
-							  XLogRecPtr recptr, Buffer vmBuf, TransactionId cutoff_xid,
-							  uint8 flags);
+							  XLogRecPtr recptr, Buffer vmBuf, Buffer tcmBuf,
+							  TransactionId cutoff_xid, uint8 flags);
 extern uint8 visibilitymap_get_status(Relation rel, BlockNumber heapBlk, Buffer *vmbuf);
 extern void visibilitymap_count(Relation rel, BlockNumber *all_visible, BlockNumber *all_frozen);
 extern BlockNumber visibilitymap_prepare_truncate(Relation rel,
 												  BlockNumber nheapblocks);
+extern uint64 visibilitymap_clear_count(Relation rel);
+extern Size VisibilityMapShmemSize(void);
+extern void VisibilityMapShmemInit(void);
 
 #endif							/* VISIBILITYMAP_H */
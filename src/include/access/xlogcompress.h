@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogcompress.h
+ *		Compression of WAL data for streaming replication and archiving.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/xlogcompress.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGCOMPRESS_H
+#define XLOGCOMPRESS_H
+
+#include "access/xlog.h"
+
+extern const char *XLogCompressionName(WalCompression method);
+
+/* compression of single buffers, for WAL messages */
+extern int	XLogCompressBound(WalCompression method, int srclen);
+extern int	XLogCompressData(WalCompression method, const char *src, int srclen,
+							 char *dst, int dstlen);
+extern bool XLogDecompressData(WalCompression method, const char *src,
+							   int srclen, char *dst, int rawlen);
+
+/* compression of whole files, for archived WAL segments */
+extern bool XLogCompressFile(WalCompression method, const char *srcpath,
+							 const char *dstpath, int elevel);
+extern bool XLogDecompressFile(const char *path, int elevel);
+
+#endif							/* XLOGCOMPRESS_H */
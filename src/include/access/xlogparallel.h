@@ -0,0 +1,32 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.h
+ *		Declarations for parallel WAL redo.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogparallel.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPARALLEL_H
+#define XLOGPARALLEL_H
+
+#include "access/xlogreader.h"
+
+/* GUCs */
+extern PGDLLIMPORT int recovery_parallel_workers;
+
+/* in the startup process */
+extern bool XLogParallelRedoDispatch(XLogReaderState *record);
+extern void XLogParallelRedoBarrier(void);
+extern void XLogParallelRedoShutdown(void);
+
+/* in parallel redo workers */
+extern void XLogParallelRedoLockExtension(void);
+extern void XLogParallelRedoUnlockExtension(void);
+
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif							/* XLOGPARALLEL_H */
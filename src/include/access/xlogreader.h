@@ -56,6 +56,9 @@ typedef struct WALSegmentContext
 	int			ws_segsize;
 } WALSegmentContext;
 
+/* size of the buffer allocated for error message. */
+#define MAX_ERRORMSG_LEN 1000
+
 typedef struct XLogReaderState XLogReaderState;
 
 /* Function type definitions for various xlogreader interactions */
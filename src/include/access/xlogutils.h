@@ -23,6 +23,13 @@
  */
 extern PGDLLIMPORT bool InRecovery;
 
+/*
+ * Set in parallel redo workers (see xlogparallel.c), which also have
+ * InRecovery set, but have to cope with other processes replaying WAL at
+ * the same time.
+ */
+extern PGDLLIMPORT bool InParallelRedoWorker;
+
 /*
  * Like InRecovery, standbyState is only valid in the startup process.
  * In all other processes it will have the value STANDBY_DISABLED (so
@@ -38,11 +38,16 @@ typedef struct backup_manifest_info
 extern void InitializeBackupManifest(backup_manifest_info *manifest,
 									 backup_manifest_option want_manifest,
 									 pg_checksum_type manifest_checksum_type);
+extern void InitializeBackupManifestPart(backup_manifest_info *manifest,
+										 BufFile *buffile, bool force_encode,
+										 pg_checksum_type manifest_checksum_type);
 extern void AddFileToBackupManifest(backup_manifest_info *manifest,
 									const char *spcoid,
 									const char *pathname, size_t size,
 									pg_time_t mtime,
 									pg_checksum_context *checksum_ctx);
+extern void AddPartToBackupManifest(backup_manifest_info *manifest,
+									BufFile *part);
 extern void AddWALInfoToBackupManifest(backup_manifest_info *manifest,
 									   XLogRecPtr startptr,
 									   TimeLineID starttli, XLogRecPtr endptr,
@@ -0,0 +1,42 @@
+/*-------------------------------------------------------------------------
+ *
+ * basebackup_incremental.h
+ *	  Format of the files an incremental base backup sends in place of
+ *	  relation files.
+ *
+ * An incremental backup taken with BASE_BACKUP (INCREMENTAL 'lsn') sends
+ * each relation main fork segment as a file named INCREMENTAL.<name>, which
+ * holds only the blocks whose page LSN is at or after the given LSN.  The
+ * file consists of
+ *
+ *	uint32		INCREMENTAL_MAGIC
+ *	uint32		number of blocks included, N
+ *	uint32		length of the segment at backup time, in blocks
+ *	uint32		block numbers of the N blocks, in increasing order
+ *	N blocks of BLCKSZ bytes each
+ *
+ * in native byte order.  pg_combinebackup puts the segment back together
+ * from these and the copies of the other blocks in older backups.
+ *
+ * This file is included by both backend and frontend code.
+ *
+ * Portions Copyright (c) 2010-2023, PostgreSQL Global Development Group
+ *
+ * src/include/backup/basebackup_incremental.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef BASEBACKUP_INCREMENTAL_H
+#define BASEBACKUP_INCREMENTAL_H
+
+#define INCREMENTAL_MAGIC			0xd3ae1f0d
+#define INCREMENTAL_PREFIX			"INCREMENTAL."
+#define INCREMENTAL_PREFIX_LENGTH	(sizeof(INCREMENTAL_PREFIX) - 1)
+
+/* size of the fixed part of the header */
+#define INCREMENTAL_HEADER_SIZE		(3 * sizeof(uint32))
+
+/* line added to the backup_label of an incremental backup */
+#define INCREMENTAL_LABEL_LINE		"INCREMENTAL FROM LSN: "
+
+#endif							/* BASEBACKUP_INCREMENTAL_H */
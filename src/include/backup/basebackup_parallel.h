@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * basebackup_parallel.h
+ *	  Coordination of a base backup sent over several connections.
+ *
+ * Portions Copyright (c) 2010-2023, PostgreSQL Global Development Group
+ *
+ * src/include/backup/basebackup_parallel.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef BASEBACKUP_PARALLEL_H
+#define BASEBACKUP_PARALLEL_H
+
+#include "access/xlogdefs.h"
+#include "backup/backup_manifest.h"
+
+/*
+ * Maximum value of the PARALLEL option in BASE_BACKUP command, counting the
+ * leader.
+ */
+#define MAX_PARALLEL_BACKUP_JOBS	64
+
+extern Size BaseBackupParallelShmemSize(void);
+extern void BaseBackupParallelShmemInit(void);
+
+extern void ParallelBackupBegin(XLogRecPtr startptr, TimeLineID starttli,
+								int nparticipants,
+								backup_manifest_info *manifest);
+extern void ParallelBackupWaitForWorkers(backup_manifest_info *manifest);
+extern int	ParallelBackupJoin(XLogRecPtr startptr, TimeLineID *starttli,
+							   int *nparticipants,
+							   backup_manifest_info *manifest);
+extern void ParallelBackupCheckAborted(void);
+extern void ParallelBackupWorkerDone(backup_manifest_info *manifest);
+extern void ParallelBackupRelease(void);
+
+#endif							/* BASEBACKUP_PARALLEL_H */
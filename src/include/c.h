@@ -144,6 +144,16 @@
 #define pg_attribute_no_sanitize_alignment()
 #endif
 
+/*
+ * pg_attribute_target allows specifying different target options that the
+ * function should be compiled with (e.g., for using special CPU instructions).
+ */
+#if __has_attribute (target)
+#define pg_attribute_target(...) __attribute__((target(__VA_ARGS__)))
+#else
+#define pg_attribute_target(...)
+#endif
+
 /*
  * pg_attribute_nonnull means the compiler should warn if the function is
  * called with the listed arguments set to NULL.  If no arguments are
@@ -280,6 +290,17 @@
 #define pg_unreachable() abort()
 #endif
 
+/*
+ * Hint to the CPU to start loading the cache line containing the given
+ * address, so that a later access to it doesn't stall.  It's only a hint:
+ * the address needn't be valid, and nothing happens without compiler support.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define pg_prefetch_mem(a) __builtin_prefetch(a)
+#else
+#define pg_prefetch_mem(a) ((void) 0)
+#endif
+
 /*
  * Hints to the compiler about the likelihood of a branch. Both likely() and
  * unlikely() return the boolean value of the contained expression.
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * indextidlog.h
+ *	  prototypes for functions in backend/catalog/indextidlog.c
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/catalog/indextidlog.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef INDEXTIDLOG_H
+#define INDEXTIDLOG_H
+
+#include "storage/itemptr.h"
+#include "utils/relcache.h"
+#include "utils/snapshot.h"
+
+extern Size IndexTidLogShmemSize(void);
+extern void IndexTidLogShmemInit(void);
+
+extern bool index_tidlog_begin(Oid indexOid);
+extern void index_tidlog_end(Oid indexOid);
+extern void index_tidlog_record(Relation indexRelation, ItemPointer tid);
+extern bool index_tidlog_merge(Oid heapId, Oid indexId, Snapshot snapshot);
+
+#endif							/* INDEXTIDLOG_H */
@@ -0,0 +1,67 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_compression_dictionary.h
+ *	  definition of the "compression dictionary" system catalog
+ *	  (pg_compression_dictionary)
+ *
+ * This catalog stores the zstd dictionaries trained by ANALYZE for columns
+ * that use zstd compression.  A compressed datum refers to its dictionary
+ * by OID, so entries are never removed: compressed values can be copied
+ * verbatim into other relations, and they must stay decompressible after
+ * the column or table they were trained for is gone.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/catalog/pg_compression_dictionary.h
+ *
+ * NOTES
+ *	  The Catalog.pm module reads this file and derives schema
+ *	  information.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_COMPRESSION_DICTIONARY_H
+#define PG_COMPRESSION_DICTIONARY_H
+
+#include "catalog/genbki.h"
+#include "catalog/pg_compression_dictionary_d.h"
+#include "utils/relcache.h"
+
+/* ----------------
+ *		pg_compression_dictionary definition.  cpp turns this into
+ *		typedef struct FormData_pg_compression_dictionary
+ * ----------------
+ */
+CATALOG(pg_compression_dictionary,9009,CompressionDictionaryRelationId)
+{
+	Oid			oid;			/* oid */
+	Oid			cdrelid BKI_LOOKUP_OPT(pg_class);	/* table the dictionary
+													 * was trained for, or 0
+													 * once it's dropped */
+	int16		cdattnum;		/* column number in that table */
+
+#ifdef CATALOG_VARLEN			/* variable-length fields start here */
+	bytea		cddict BKI_FORCE_NOT_NULL;	/* zstd dictionary contents */
+#endif
+} FormData_pg_compression_dictionary;
+
+/* ----------------
+ *		Form_pg_compression_dictionary corresponds to a pointer to a tuple
+ *		with the format of pg_compression_dictionary relation.
+ * ----------------
+ */
+typedef FormData_pg_compression_dictionary *Form_pg_compression_dictionary;
+
+DECLARE_TOAST(pg_compression_dictionary, 9010, 9011);
+
+DECLARE_UNIQUE_INDEX_PKEY(pg_compression_dictionary_oid_index, 9012, CompressionDictionaryOidIndexId, on pg_compression_dictionary using btree(oid oid_ops));
+DECLARE_INDEX(pg_compression_dictionary_relid_attnum_index, 9013, CompressionDictionaryRelidAttnumIndexId, on pg_compression_dictionary using btree(cdrelid oid_ops, cdattnum int2_ops));
+
+extern Oid	CompressionDictionaryCreate(Oid relid, AttrNumber attnum,
+										bytea *dict);
+extern Oid	GetColumnCompressionDictionary(Relation rel, AttrNumber attnum);
+extern bytea *GetCompressionDictionaryData(Oid dictid);
+extern void CompressionDictionaryDetachRelation(Oid relid);
+
+#endif							/* PG_COMPRESSION_DICTIONARY_H */
@@ -14,6 +14,7 @@
 #ifndef COPY_H
 #define COPY_H
 
+#include "access/parallel.h"
 #include "nodes/execnodes.h"
 #include "nodes/parsenodes.h"
 #include "parser/parse_node.h"
@@ -32,8 +33,9 @@ typedef enum CopyHeaderChoice
 
 /*
  * A struct to hold COPY options, in a parsed form. All of these are related
- * to formatting, except for 'freeze', which doesn't really belong here, but
- * it's expedient to parse it along with all the other options.
+ * to formatting, except for 'freeze' and 'nworkers', which don't really
+ * belong here, but it's expedient to parse them along with all the other
+ * options.
  */
 typedef struct CopyFormatOptions
 {
@@ -41,7 +43,9 @@ typedef struct CopyFormatOptions
 	int			file_encoding;	/* file or remote side's character encoding,
 								 * -1 if not specified */
 	bool		binary;			/* binary format? */
+	bool		columnar;		/* columnar binary format? (implies binary) */
 	bool		freeze;			/* freeze rows on loading? */
+	int			nworkers;		/* number of parallel workers, or 0 */
 	bool		csv_mode;		/* Comma Separated Value format? */
 	CopyHeaderChoice header_line;	/* header line? */
 	char	   *null_print;		/* NULL marker string (server encoding!) */
@@ -87,6 +91,8 @@ extern void CopyFromErrorCallback(void *arg);
 
 extern uint64 CopyFrom(CopyFromState cstate);
 
+extern void ParallelCopyFromMain(dsm_segment *seg, shm_toc *toc);
+
 extern DestReceiver *CreateCopyDestReceiver(void);
 
 /*
@@ -99,5 +105,6 @@ extern void EndCopyTo(CopyToState cstate);
 extern uint64 DoCopyTo(CopyToState cstate);
 extern List *CopyGetAttnums(TupleDesc tupDesc, Relation rel,
 							List *attnamelist);
+extern int	CopyColumnarWidth(Oid typid, int32 typmod);
 
 #endif							/* COPY_H */
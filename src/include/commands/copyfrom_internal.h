@@ -70,6 +70,8 @@ typedef struct CopyFromStateData
 	/* parameters from the COPY command */
 	Relation	rel;			/* relation to copy from */
 	List	   *attnumlist;		/* integer list of attnums to copy */
+	List	   *attnamelist;	/* column names, for parallel workers */
+	List	   *options;		/* COPY options, for parallel workers */
 	char	   *filename;		/* filename, or NULL for STDIN */
 	bool		is_program;		/* is 'filename' a program to popen? */
 	copy_data_source_cb data_source_cb; /* function for reading data */
@@ -173,9 +175,32 @@ typedef struct CopyFromStateData
 #define RAW_BUF_BYTES(cstate) ((cstate)->raw_buf_len - (cstate)->raw_buf_index)
 
 	uint64		bytes_processed;	/* number of bytes processed so far */
+	uint64		bytes_total;	/* size of the input file, or 0 if unknown */
+
+	/*
+	 * In columnar COPY FROM, each batch of rows is read into
+	 * columnar_context one column buffer at a time, and NextCopyFrom then
+	 * decodes one row at a time directly out of those buffers.  All arrays
+	 * are indexed by position in attnumlist.
+	 */
+	int16	   *columnar_widths;	/* fixed width of each column, or -1 */
+	MemoryContext columnar_context; /* holds the current batch */
+	int			columnar_nrows; /* number of rows in the current batch */
+	int			columnar_nextrow;	/* next row of the batch to return */
+	uint8	  **columnar_validity;	/* validity bitmaps, bit set = not null */
+	char	  **columnar_data;	/* packed values, or variable-width data */
+	int32	  **columnar_offsets;	/* nrows + 1 offsets into columnar_data,
+									 * for variable-width columns */
 } CopyFromStateData;
 
 extern void ReceiveCopyBegin(CopyFromState cstate);
 extern void ReceiveCopyBinaryHeader(CopyFromState cstate);
+extern void ReceiveCopyColumnarHeader(CopyFromState cstate);
+extern int	CopyReadRawData(CopyFromState cstate, char *dest, int maxread);
+extern void CopyResetInput(CopyFromState cstate, uint64 lineno);
+
+/* in copyfromparallel.c */
+extern uint64 ParallelCopyFrom(CopyFromState cstate,
+							   ResultRelInfo *resultRelInfo);
 
 #endif							/* COPYFROM_INTERNAL_H */
@@ -28,6 +28,8 @@ extern ObjectAddress ExecCreateTableAs(ParseState *pstate, CreateTableAsStmt *st
 extern int	GetIntoRelEFlags(IntoClause *intoClause);
 
 extern DestReceiver *CreateIntoRelDestReceiver(IntoClause *intoClause);
+extern DestReceiver *CreateIntoRelWorkerDestReceiver(Oid relid);
+extern Oid	IntoRelGetRelid(DestReceiver *self);
 
 extern bool CreateTableAsRelExists(CreateTableAsStmt *ctas);
 
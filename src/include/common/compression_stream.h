@@ -0,0 +1,32 @@
+/*-------------------------------------------------------------------------
+ *
+ * compression_stream.h
+ *	  Streaming compression for the frontend/backend protocol.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  src/include/common/compression_stream.h
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COMPRESSION_STREAM_H
+#define COMPRESSION_STREAM_H
+
+#include "common/compression.h"
+
+/* opaque; a compressor and a decompressor for one connection */
+typedef struct ZStream ZStream;
+
+extern bool zs_parse_spec(const char *spec, pg_compress_algorithm *algorithm,
+						  int *level);
+extern ZStream *zs_create(pg_compress_algorithm algorithm, int level);
+extern void zs_free(ZStream *zs);
+extern const char *zs_compress(ZStream *zs, const char *src, size_t srclen,
+							   size_t *dstlen);
+extern ssize_t zs_decompress(ZStream *zs, const char *src, size_t srclen,
+							 size_t *srcused, char *dst, size_t dstlen);
+extern bool zs_read_pending(ZStream *zs);
+extern const char *zs_errmsg(ZStream *zs);
+
+#endif							/* COMPRESSION_STREAM_H */
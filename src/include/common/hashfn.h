@@ -50,6 +50,9 @@ hash_uint32_extended(uint32 k, uint64 seed)
 {
 	return UInt64GetDatum(hash_bytes_uint32_extended(k, seed));
 }
+
+/* A hash support function called without fmgr; see hash_direct_function() */
+typedef uint32 (*DatumHashFunction) (Datum value);
 #endif
 
 extern uint32 string_hash(const void *key, Size keysize);
@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------------
+ * execBatch.h
+ *		Support for batch-at-a-time execution between plan nodes
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/executor/execBatch.h
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "nodes/execnodes.h"
+
+/*
+ * A TupleBatch is an array of tuple slots filled by one call of a node's
+ * ExecProcNodeBatch method, together with a selection vector giving the
+ * indexes of the slots that passed the node's quals.  The consumer owns the
+ * batch; the slots stay valid until it asks for the next batch.  The column
+ * values of the selected slots are deformed at least up to the last column
+ * used by the producer's quals.
+ */
+typedef struct TupleBatch
+{
+	int			maxrows;		/* allocated length of slots[] and sel[] */
+	int			nrows;			/* number of slots filled */
+	int			nselected;		/* number of valid entries in sel[] */
+	int			next;			/* next entry of sel[] to return */
+	TupleTableSlot **slots;
+	int		   *sel;			/* selection vector */
+} TupleBatch;
+
+/* opaque vectorized qual, see execBatch.c */
+typedef struct BatchQual BatchQual;
+
+/* GUC */
+extern PGDLLIMPORT int executor_batch_size;
+
+extern TupleBatch *ExecCreateBatch(EState *estate, TupleDesc tupdesc,
+								   const TupleTableSlotOps *tts_ops,
+								   int maxrows);
+extern TupleBatch *ExecInitBatch(PlanState *producer);
+extern void ExecResetBatch(TupleBatch *batch);
+extern int	ExecProcBatch(PlanState *node, TupleBatch *batch);
+
+extern BatchQual *ExecInitBatchQual(List *qual, int maxrows);
+extern void ExecBatchQual(BatchQual *bqual, TupleBatch *batch);
+extern void ExecBatchQualRows(ExprState *qual, ExprContext *econtext,
+							  TupleBatch *batch);
+extern void ExecProjectBatch(ProjectionInfo *projInfo, TupleBatch *in,
+							 TupleBatch *out);
+
+/*
+ * Return the next selected tuple of the batch, fetching a new batch from
+ * the node when the current one is used up; NULL at the end of the node's
+ * output, the same as ExecProcNode.
+ */
+#ifndef FRONTEND
+static inline TupleTableSlot *
+ExecProcNodeViaBatch(PlanState *node, TupleBatch *batch)
+{
+	if (batch->next >= batch->nselected)
+	{
+		if (ExecProcBatch(node, batch) == 0)
+			return NULL;
+	}
+
+	return batch->slots[batch->sel[batch->next++]];
+}
+#endif
+
+#endif							/* EXECBATCH_H */
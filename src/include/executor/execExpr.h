@@ -112,6 +112,13 @@ typedef enum ExprEvalOp
 	EEOP_FUNCEXPR_FUSAGE,
 	EEOP_FUNCEXPR_STRICT_FUSAGE,
 
+	/*
+	 * Compare a Var with a Const, or two Vars, of builtin integer, float,
+	 * date, timestamp or text types without calling the operator's function.
+	 */
+	EEOP_CMP_VAR_CONST,
+	EEOP_CMP_VAR_VAR,
+
 	/*
 	 * Evaluate boolean AND expression, one step per subexpression. FIRST/LAST
 	 * subexpressions are special-cased for performance.  Since AND always has
@@ -255,6 +262,9 @@ typedef enum ExprEvalOp
 	EEOP_AGG_PLAIN_TRANS_INIT_STRICT_BYREF,
 	EEOP_AGG_PLAIN_TRANS_STRICT_BYREF,
 	EEOP_AGG_PLAIN_TRANS_BYREF,
+	/* inlined transitions of count() and of sum() for int2 and int4 */
+	EEOP_AGG_PLAIN_TRANS_COUNT,
+	EEOP_AGG_PLAIN_TRANS_INT_SUM,
 	EEOP_AGG_PRESORTED_DISTINCT_SINGLE,
 	EEOP_AGG_PRESORTED_DISTINCT_MULTI,
 	EEOP_AGG_ORDERED_TRANS_DATUM,
@@ -352,6 +362,22 @@ typedef struct ExprEvalStep
 			int			nargs;	/* number of arguments */
 		}			func;
 
+		/* for EEOP_CMP_VAR_{CONST,VAR} */
+		struct
+		{
+			/* offsetof the Vars' slots in ExprContext */
+			uint16		lslotoff;
+			uint16		rslotoff;
+			uint8		ltype;		/* ExprCmpType of each side */
+			uint8		rtype;
+			uint8		strategy;	/* btree strategy, or EEO_CMP_NE */
+			int			lattnum;	/* attnums of the Vars, 0-based */
+			int			rattnum;	/* -1 for EEOP_CMP_VAR_CONST */
+			Oid			lvartype;	/* types of the Vars, for checking */
+			Oid			rvartype;
+			Datum		constval;	/* non-null Const, for EEOP_CMP_VAR_CONST */
+		}			cmp;
+
 		/* for EEOP_BOOL_*_STEP */
 		struct
 		{
@@ -673,6 +699,7 @@ typedef struct ExprEvalStep
 		}			agg_presorted_distinctcheck;
 
 		/* for EEOP_AGG_PLAIN_TRANS_[INIT_][STRICT_]{BYVAL,BYREF} */
+		/* for EEOP_AGG_PLAIN_TRANS_{COUNT,INT_SUM} */
 		/* for EEOP_AGG_ORDERED_TRANS_{DATUM,TUPLE} */
 		struct
 		{
@@ -696,6 +723,24 @@ typedef struct ExprEvalStep
 StaticAssertDecl(sizeof(ExprEvalStep) <= 64,
 				 "size of ExprEvalStep exceeds 64 bytes");
 
+/*
+ * How the two sides of an EEOP_CMP_VAR_* step are compared: integer types
+ * (including date and timestamps) as int64, float types as float8 and text
+ * bytewise.
+ */
+typedef enum ExprCmpType
+{
+	EEO_CMP_INT2,
+	EEO_CMP_INT4,
+	EEO_CMP_INT8,
+	EEO_CMP_FLOAT4,
+	EEO_CMP_FLOAT8,
+	EEO_CMP_TEXT
+} ExprCmpType;
+
+/* EEOP_CMP_VAR_* strategy for "<>", beyond the btree strategies */
+#define EEO_CMP_NE		6
+
 
 /* Non-inline data for container operations */
 typedef struct SubscriptingRefState
@@ -772,6 +817,8 @@ extern void ExecEvalFuncExprFusage(ExprState *state, ExprEvalStep *op,
 								   ExprContext *econtext);
 extern void ExecEvalFuncExprStrictFusage(ExprState *state, ExprEvalStep *op,
 										 ExprContext *econtext);
+extern void ExecEvalCmpVar(ExprState *state, ExprEvalStep *op,
+						   ExprContext *econtext);
 extern void ExecEvalParamExec(ExprState *state, ExprEvalStep *op,
 							  ExprContext *econtext);
 extern void ExecEvalParamExtern(ExprState *state, ExprEvalStep *op,
@@ -826,5 +873,7 @@ extern void ExecEvalAggOrderedTransDatum(ExprState *state, ExprEvalStep *op,
 										 ExprContext *econtext);
 extern void ExecEvalAggOrderedTransTuple(ExprState *state, ExprEvalStep *op,
 										 ExprContext *econtext);
+extern void ExecEvalAggPlainTransCount(ExprState *state, ExprEvalStep *op);
+extern void ExecEvalAggPlainTransIntSum(ExprState *state, ExprEvalStep *op);
 
 #endif							/* EXEC_EXPR_H */
@@ -32,6 +32,10 @@ typedef struct ParallelExecutorInfo
 	dsa_area   *area;			/* points to DSA area in DSM */
 	dsa_pointer param_exec;		/* serialized PARAM_EXEC parameters */
 	bool		finished;		/* set true by ExecParallelFinish */
+	/* Tuple queue waits, summed over workers and runs, for EXPLAIN: */
+	uint64		tqueue_send_stalls; /* workers found their queue full */
+	uint64		tqueue_receive_stalls;	/* leader found a queue empty */
+	uint64		tuples_inserted;	/* inserted by workers, see insert_relid */
 	/* These two arrays have pcxt->nworkers_launched entries: */
 	shm_mq_handle **tqueue;		/* tuple queues for worker output */
 	struct TupleQueueReader **reader;	/* tuple reader/writer support */
@@ -39,7 +43,7 @@ typedef struct ParallelExecutorInfo
 
 extern ParallelExecutorInfo *ExecInitParallelPlan(PlanState *planstate,
 												  EState *estate, Bitmapset *sendParams, int nworkers,
-												  int64 tuples_needed);
+												  int64 tuples_needed, Oid insert_relid);
 extern void ExecParallelCreateReaders(ParallelExecutorInfo *pei);
 extern void ExecParallelFinish(ParallelExecutorInfo *pei);
 extern void ExecParallelCleanup(ParallelExecutorInfo *pei);
@@ -14,6 +14,7 @@
 #ifndef HASHJOIN_H
 #define HASHJOIN_H
 
+#include "lib/bloomfilter.h"
 #include "nodes/execnodes.h"
 #include "port/atomics.h"
 #include "storage/barrier.h"
@@ -91,6 +92,30 @@ typedef struct HashJoinTupleData
 #define HJTUPLE_MINTUPLE(hjtup)  \
 	((MinimalTuple) ((char *) (hjtup) + HJTUPLE_OVERHEAD))
 
+/*
+ * A bucket of the in-memory hash table is the head of its chain of tuples,
+ * together with a one-word bloom filter of the chain's hash values.  Each
+ * tuple sets the tag bit selected by the high bits of its hash value (the
+ * low ones choose the bucket), so that a probe can reject most buckets that
+ * lack its hash value without following the chain, which would mean a
+ * dependent cache miss per tuple.  Tags are only ever set, never cleared
+ * while the bucket is in use: they may have false positives, like any bloom
+ * filter, but no false negatives.
+ */
+typedef struct HashJoinBucketData
+{
+	struct HashJoinTupleData *tuples;	/* head of chain, or NULL */
+	uint32		tags;			/* HJ_HASH_TAG of all tuples in chain */
+} HashJoinBucketData;
+
+typedef struct ParallelHashJoinBucket
+{
+	dsa_pointer_atomic tuples;	/* head of chain, or InvalidDsaPointer */
+	pg_atomic_uint32 tags;		/* HJ_HASH_TAG of all tuples in chain */
+} ParallelHashJoinBucket;
+
+#define HJ_HASH_TAG(hashvalue)	((uint32) 1 << ((hashvalue) >> 27))
+
 /*
  * If the outer relation's distribution is sufficiently nonuniform, we attempt
  * to optimize the join by treating the hash values corresponding to the outer
@@ -171,6 +196,7 @@ typedef struct ParallelHashJoinBatch
 	size_t		old_ntuples;	/* number of tuples before repartitioning */
 	bool		space_exhausted;
 	bool		skip_unmatched; /* whether to abandon unmatched scan */
+	bool		hot;			/* too skewed to be split by adding batches */
 
 	/*
 	 * Variable-sized SharedTuplestore objects follow this struct in memory.
@@ -255,6 +281,7 @@ typedef struct ParallelHashJoinState
 	int			nparticipants;
 	size_t		space_allowed;
 	size_t		total_tuples;	/* total number of inner tuples */
+	dsa_pointer bloom;			/* bloom filter of inner hash values */
 	LWLock		lock;			/* lock protecting the above */
 
 	Barrier		build_barrier;	/* synchronization for the build phases */
@@ -308,9 +335,9 @@ typedef struct HashJoinTableData
 	union
 	{
 		/* unshared array is per-batch storage, as are all the tuples */
-		struct HashJoinTupleData **unshared;
+		HashJoinBucketData *unshared;
 		/* shared array is per-query DSA area, as are all the tuples */
-		dsa_pointer_atomic *shared;
+		ParallelHashJoinBucket *shared;
 	}			buckets;
 
 	bool		keepNulls;		/* true to store unmatchable NULL tuples */
@@ -328,6 +355,8 @@ typedef struct HashJoinTableData
 	int			nbatch_outstart;	/* nbatch when we started outer scan */
 
 	bool		growEnabled;	/* flag to shut off nbatch increases */
+	int			curstripe;		/* current stripe of curbatch; 0 normally */
+	bool		moreStripes;	/* curbatch's inner file has more stripes */
 
 	double		totalTuples;	/* # tuples obtained from inner plan */
 	double		partialTuples;	/* # tuples obtained from inner plan by me */
@@ -350,6 +379,8 @@ typedef struct HashJoinTableData
 	 */
 	FmgrInfo   *outer_hashfunctions;	/* lookup data for hash functions */
 	FmgrInfo   *inner_hashfunctions;	/* lookup data for hash functions */
+	DatumHashFunction *outer_hashdirect;	/* direct versions, or NULL */
+	DatumHashFunction *inner_hashdirect;	/* direct versions, or NULL */
 	bool	   *hashStrict;		/* is each hash join operator strict? */
 	Oid		   *collations;
 
@@ -372,6 +403,29 @@ typedef struct HashJoinTableData
 	ParallelHashJoinState *parallel_state;
 	ParallelHashJoinBatchAccessor *batches;
 	dsa_pointer current_chunk_shared;
+
+	/*
+	 * Bloom filter of the hash values of the inner tuples, for runtime
+	 * filtering of the outer side.  Each backend adds the tuples it hashes to
+	 * bloom_build; in Parallel Hash, those are merged into a shared filter at
+	 * the end of the build.  bloom is set to the complete filter once the
+	 * build is done, and is NULL otherwise.
+	 */
+	bloom_filter *bloom_build;
+	bloom_filter *bloom;
 } HashJoinTableData;
 
+/*
+ * Runtime filter pushed down from a hash join into the scans producing its
+ * outer tuples; see ExecHashJoinRuntimeFilterLacks.
+ */
+typedef struct HashRuntimeFilter
+{
+	HashJoinState *hjstate;		/* hash join the filter belongs to */
+	HashJoinTable hashtable;	/* hash table the counters are about */
+	uint64		ntested;		/* tuples tested */
+	uint64		nrejected;		/* tuples found to have no join partner */
+	bool		disabled;		/* not selective enough to be worth it */
+} HashRuntimeFilter;
+
 #endif							/* HASHJOIN_H */
@@ -70,6 +70,7 @@ typedef struct Instrumentation
 	bool		need_bufusage;	/* true if we need buffer usage data */
 	bool		need_walusage;	/* true if we need WAL usage data */
 	bool		async_mode;		/* true if node is in async mode */
+	int			sample_every;	/* if > 1, time only 1 in this many calls */
 	/* Info about current plan cycle: */
 	bool		running;		/* true if we've completed first tuple */
 	instr_time	starttime;		/* start time of current iteration of node */
@@ -78,6 +79,12 @@ typedef struct Instrumentation
 	double		tuplecount;		/* # of tuples emitted so far this cycle */
 	BufferUsage bufusage_start; /* buffer usage at start */
 	WalUsage	walusage_start; /* WAL usage at start */
+	/* Sampled timing of calls after the first of each cycle: */
+	int			sample_countdown;	/* calls to skip before timing one */
+	double		sample_calls;	/* # of such calls this cycle */
+	instr_time	sample_counter; /* runtime of the timed ones this cycle */
+	double		sample_timed;	/* # of those timed, across all cycles */
+	double		sample_total;	/* their runtime (in seconds), ditto */
 	/* Accumulated statistics across all completed cycles: */
 	double		startup;		/* total startup time (in seconds) */
 	double		total;			/* total time (in seconds) */
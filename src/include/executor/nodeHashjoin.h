@@ -18,6 +18,9 @@
 #include "nodes/execnodes.h"
 #include "storage/buffile.h"
 
+/* GUC parameter */
+extern PGDLLIMPORT bool hashjoin_runtime_filter;
+
 extern HashJoinState *ExecInitHashJoin(HashJoin *node, EState *estate, int eflags);
 extern void ExecEndHashJoin(HashJoinState *node);
 extern void ExecReScanHashJoin(HashJoinState *node);
@@ -28,6 +31,10 @@ extern void ExecHashJoinReInitializeDSM(HashJoinState *state, ParallelContext *p
 extern void ExecHashJoinInitializeWorker(HashJoinState *state,
 										 ParallelWorkerContext *pwcxt);
 
+extern bool ExecHashJoinRuntimeFilterLacks(struct HashRuntimeFilter *rf,
+										   TupleTableSlot *slot,
+										   ExprContext *econtext);
+
 extern void ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
 								  BufFile **fileptr, HashJoinTable hashtable);
 
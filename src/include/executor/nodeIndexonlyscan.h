@@ -15,6 +15,7 @@
 #define NODEINDEXONLYSCAN_H
 
 #include "access/parallel.h"
+#include "access/skey.h"
 #include "nodes/execnodes.h"
 
 extern IndexOnlyScanState *ExecInitIndexOnlyScan(IndexOnlyScan *node, EState *estate, int eflags);
@@ -22,6 +23,8 @@ extern void ExecEndIndexOnlyScan(IndexOnlyScanState *node);
 extern void ExecIndexOnlyMarkPos(IndexOnlyScanState *node);
 extern void ExecIndexOnlyRestrPos(IndexOnlyScanState *node);
 extern void ExecReScanIndexOnlyScan(IndexOnlyScanState *node);
+extern void ExecIndexOnlyScanReserveSeekKey(IndexOnlyScanState *node);
+extern void ExecIndexOnlyScanSeek(IndexOnlyScanState *node, ScanKey seekkey);
 
 /* Support functions for parallel index-only scans */
 extern void ExecIndexOnlyScanEstimate(IndexOnlyScanState *node,
@@ -23,6 +23,8 @@ extern void ExecEndIndexScan(IndexScanState *node);
 extern void ExecIndexMarkPos(IndexScanState *node);
 extern void ExecIndexRestrPos(IndexScanState *node);
 extern void ExecReScanIndexScan(IndexScanState *node);
+extern void ExecIndexScanReserveSeekKey(IndexScanState *node);
+extern void ExecIndexScanSeek(IndexScanState *node, ScanKey seekkey);
 extern void ExecIndexScanEstimate(IndexScanState *node, ParallelContext *pcxt);
 extern void ExecIndexScanInitializeDSM(IndexScanState *node, ParallelContext *pcxt);
 extern void ExecIndexScanReInitializeDSM(IndexScanState *node, ParallelContext *pcxt);
@@ -43,5 +45,12 @@ extern void ExecIndexEvalRuntimeKeys(ExprContext *econtext,
 extern bool ExecIndexEvalArrayKeys(ExprContext *econtext,
 								   IndexArrayKeyInfo *arrayKeys, int numArrayKeys);
 extern bool ExecIndexAdvanceArrayKeys(IndexArrayKeyInfo *arrayKeys, int numArrayKeys);
+extern ScanKey ExecIndexReserveSeekKey(ScanKey *scanKeys, int *numScanKeys,
+									   IndexRuntimeKeyInfo *runtimeKeys,
+									   int numRuntimeKeys);
+extern void ExecIndexResetSeekKey(ScanKey seekkey);
+extern bool ExecIndexFindParamKey(PlanState *node, int paramid,
+								  ScanKey *scankey, AttrNumber *scanattno,
+								  Relation *indexrel);
 
 #endif							/* NODEINDEXSCAN_H */
@@ -17,6 +17,9 @@
 #include "access/parallel.h"
 #include "nodes/execnodes.h"
 
+/* GUC parameter */
+extern PGDLLIMPORT bool memoize_shared_cache;
+
 extern MemoizeState *ExecInitMemoize(Memoize *node, EState *estate, int eflags);
 extern void ExecEndMemoize(MemoizeState *node);
 extern void ExecReScanMemoize(MemoizeState *node);
@@ -16,6 +16,15 @@
 
 #include "nodes/execnodes.h"
 
+/*
+ * A merge join seeks an index scan input forward after skipping this many of
+ * its tuples in a row; the planner assumes the same.
+ */
+#define MJ_SEEK_THRESHOLD	32
+
+/* GUC parameter */
+extern PGDLLIMPORT bool mergejoin_seek;
+
 extern MergeJoinState *ExecInitMergeJoin(MergeJoin *node, EState *estate, int eflags);
 extern void ExecEndMergeJoin(MergeJoinState *node);
 extern void ExecReScanMergeJoin(MergeJoinState *node);
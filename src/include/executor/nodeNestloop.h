@@ -16,6 +16,10 @@
 
 #include "nodes/execnodes.h"
 
+/* GUC parameters */
+extern PGDLLIMPORT int nestloop_batch_size;
+extern PGDLLIMPORT double adaptive_nestloop_factor;
+
 extern NestLoopState *ExecInitNestLoop(NestLoop *node, EState *estate, int eflags);
 extern void ExecEndNestLoop(NestLoopState *node);
 extern void ExecReScanNestLoop(NestLoopState *node);
@@ -16,6 +16,9 @@
 
 #include "nodes/execnodes.h"
 
+/* GUC parameter */
+extern PGDLLIMPORT int initplan_cache_ttl;
+
 extern SubPlanState *ExecInitSubPlan(SubPlan *subplan, PlanState *parent);
 
 extern Datum ExecSubPlan(SubPlanState *node, ExprContext *econtext, bool *isNull);
@@ -26,4 +29,6 @@ extern void ExecSetParamPlan(SubPlanState *node, ExprContext *econtext);
 
 extern void ExecSetParamPlanMulti(const Bitmapset *params, ExprContext *econtext);
 
+extern void ResetInitPlanCache(void);
+
 #endif							/* NODESUBPLAN_H */
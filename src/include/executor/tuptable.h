@@ -128,6 +128,9 @@ typedef struct TupleTableSlot
 	MemoryContext tts_mcxt;		/* slot itself is in this context */
 	ItemPointerData tts_tid;	/* stored tuple's tid */
 	Oid			tts_tableOid;	/* table oid of tuple */
+	AttrNumber	tts_nfixed;		/* # of leading fixed-width attributes, or
+								 * -1 if not computed yet */
+	uint32	   *tts_attoffs;	/* their offsets, if no nulls precede them */
 } TupleTableSlot;
 
 /* routines for a TupleTableSlot implementation */
@@ -118,6 +118,7 @@ extern bool llvm_compile_expr(struct ExprState *state);
 struct TupleTableSlotOps;
 extern LLVMValueRef slot_compile_deform(struct LLVMJitContext *context, TupleDesc desc,
 										const struct TupleTableSlotOps *ops, int natts);
+extern LLVMTypeRef slot_deform_func_type(void);
 
 /*
  ****************************************************************************
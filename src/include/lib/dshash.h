@@ -48,6 +48,9 @@ typedef dshash_hash (*dshash_hash_function) (const void *v, size_t size,
  * function pointers should be NULL.  If the arg variants are supplied then the
  * user data pointer supplied to the create and attach functions will be
  * passed to the hash and compare functions.
+ *
+ * unlocked_reads, which only matters at creation, allows lookups with
+ * dshash_find_unlocked(), but then entries can never be deleted.
  */
 typedef struct dshash_parameters
 {
@@ -56,6 +59,7 @@ typedef struct dshash_parameters
 	dshash_compare_function compare_function;	/* Compare function */
 	dshash_hash_function hash_function; /* Hash function */
 	int			tranche_id;		/* The tranche ID to use for locks */
+	bool		unlocked_reads; /* Allow dshash_find_unlocked()? */
 } dshash_parameters;
 
 /* Forward declaration of private types for use only by dshash.c. */
@@ -69,8 +73,8 @@ typedef struct dshash_table_item dshash_table_item;
 typedef struct dshash_seq_status
 {
 	dshash_table *hash_table;	/* dshash table working on */
-	int			curbucket;		/* bucket number we are at */
-	int			nbuckets;		/* total number of buckets in the dshash */
+	int			curbucket;		/* bucket number we are at, in the partition */
+	int			nbuckets;		/* number of buckets in the partition */
 	dshash_table_item *curitem; /* item we are currently at */
 	dsa_pointer pnextitem;		/* dsa-pointer to the next item */
 	int			curpartition;	/* partition number we are at */
@@ -92,6 +96,7 @@ extern void dshash_destroy(dshash_table *hash_table);
 /* Finding, creating, deleting entries. */
 extern void *dshash_find(dshash_table *hash_table,
 						 const void *key, bool exclusive);
+extern void *dshash_find_unlocked(dshash_table *hash_table, const void *key);
 extern void *dshash_find_or_insert(dshash_table *hash_table,
 								   const void *key, bool *found);
 extern bool dshash_delete_key(dshash_table *hash_table, const void *key);
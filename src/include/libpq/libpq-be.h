@@ -53,6 +53,7 @@ typedef struct
 #endif
 #endif							/* ENABLE_SSPI */
 
+#include "common/compression.h"
 #include "datatype/timestamp.h"
 #include "libpq/hba.h"
 #include "libpq/pqcomm.h"
@@ -175,6 +176,21 @@ typedef struct Port
 	 */
 	char	   *application_name;
 
+	/*
+	 * Protocol compression requested in the startup packet, which starts
+	 * once authentication has succeeded.  PG_COMPRESSION_NONE if none.
+	 */
+	pg_compress_algorithm compression_algorithm;
+	int			compression_level;
+
+	/*
+	 * For a parked session being resumed rather than a new connection, the
+	 * malloc'd session descriptor the backend that parked it made; see
+	 * postmaster/sessionkeeper.c.  NULL otherwise.
+	 */
+	char	   *parked_session;
+	int			parked_session_len;
+
 	/*
 	 * Information that needs to be held during the authentication cycle.
 	 */
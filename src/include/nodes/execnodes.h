@@ -30,6 +30,7 @@
 #define EXECNODES_H
 
 #include "access/tupconvert.h"
+#include "common/hashfn.h"
 #include "executor/instrument.h"
 #include "fmgr.h"
 #include "lib/ilist.h"
@@ -57,6 +58,9 @@ struct RangeTblEntry;			/* avoid including parsenodes.h here */
 struct ExprEvalStep;			/* avoid including execExpr.h everywhere */
 struct CopyMultiInsertBuffer;
 struct LogicalTapeSet;
+struct TupleBatch;				/* avoid including execBatch.h here */
+struct BatchQual;
+struct HashRuntimeFilter;
 
 
 /* ----------------
@@ -667,6 +671,7 @@ typedef struct EState
 
 	int			es_top_eflags;	/* eflags passed to ExecutorStart */
 	int			es_instrument;	/* OR of InstrumentOption flags */
+	int			es_instrument_sample;	/* sample_every for node timing */
 	bool		es_finished;	/* true when ExecutorFinish is done */
 
 	List	   *es_exprcontexts;	/* List of ExprContexts within EState */
@@ -810,6 +815,7 @@ typedef struct TupleHashTableData
 	int			numCols;		/* number of columns in lookup key */
 	AttrNumber *keyColIdx;		/* attr numbers of key columns */
 	FmgrInfo   *tab_hash_funcs; /* hash functions for table datatype(s) */
+	DatumHashFunction *tab_hash_direct; /* direct versions of them, or NULL */
 	ExprState  *tab_eq_func;	/* comparator for table datatype(s) */
 	Oid		   *tab_collations; /* collations for hash and comparison */
 	MemoryContext tablecxt;		/* memory context containing table */
@@ -819,6 +825,7 @@ typedef struct TupleHashTableData
 	/* The following fields are set transiently for each table search: */
 	TupleTableSlot *inputslot;	/* current input tuple's slot */
 	FmgrInfo   *in_hash_funcs;	/* hash functions for input datatype(s) */
+	DatumHashFunction *in_hash_direct;	/* direct versions, NULL if none */
 	ExprState  *cur_eq_func;	/* comparator for input vs. table */
 	uint32		hash_iv;		/* hash-function IV */
 	ExprContext *exprcontext;	/* expression context */
@@ -1021,6 +1028,18 @@ typedef struct DomainConstraintState
  */
 typedef TupleTableSlot *(*ExecProcNodeMtd) (struct PlanState *pstate);
 
+/* ----------------
+ *	 ExecProcNodeBatchMtd
+ *
+ * This is the optional method called by ExecProcBatch to fill a batch of
+ * tuples from an executor node (see executor/execBatch.h).  It returns the
+ * number of tuples selected in the batch, or 0 if no more tuples are
+ * available.  Nodes that don't support the batch protocol leave it NULL.
+ * ----------------
+ */
+typedef int (*ExecProcNodeBatchMtd) (struct PlanState *pstate,
+									 struct TupleBatch *batch);
+
 /* ----------------
  *		PlanState node
  *
@@ -1043,6 +1062,8 @@ typedef struct PlanState
 	ExecProcNodeMtd ExecProcNode;	/* function to return next tuple */
 	ExecProcNodeMtd ExecProcNodeReal;	/* actual function, if above is a
 										 * wrapper */
+	ExecProcNodeBatchMtd ExecProcNodeBatch; /* function to return next batch
+											 * of tuples, or NULL */
 
 	Instrumentation *instrument;	/* Optional runtime stats for this node */
 	WorkerInstrumentation *worker_instrument;	/* per-worker instrumentation */
@@ -1050,6 +1071,9 @@ typedef struct PlanState
 	/* Per-worker JIT instrumentation */
 	struct SharedJitInstrumentation *worker_jit_instrument;
 
+	/* What temporary files of this node are charged to, or NULL */
+	struct TempFileOwner *temp_file_owner;
+
 	/*
 	 * Common structural data for all Plan types.  These links to subsidiary
 	 * state trees parallel links in the associated plan tree (except for the
@@ -1241,6 +1265,7 @@ typedef struct ResultState
 	ExprState  *resconstantqual;
 	bool		rs_done;		/* are we done? */
 	bool		rs_checkqual;	/* do we need to check the qual? */
+	struct TupleBatch *rs_batch;	/* input batch, in batch mode */
 } ResultState;
 
 /* ----------------
@@ -1386,6 +1411,10 @@ struct AppendState
  *						eliminated from the scan, or NULL if not possible.
  *		valid_subplans	for runtime pruning, valid mergeplans indexes to
  *						scan.
+ *		bound			tuples needed by the parent, or -1 if not bounded
+ *		threshold		tuple that child Sorts may discard input beyond,
+ *						if bounded
+ *		peekslot		slot to fetch a child Sort's bound'th tuple into
  * ----------------
  */
 typedef struct MergeAppendState
@@ -1400,6 +1429,9 @@ typedef struct MergeAppendState
 	bool		ms_initialized; /* are subplans started? */
 	struct PartitionPruneState *ms_prune_state;
 	Bitmapset  *ms_valid_subplans;
+	int64		ms_bound;
+	struct SortThreshold *ms_threshold;
+	TupleTableSlot *ms_peekslot;
 } MergeAppendState;
 
 /* ----------------
@@ -1475,6 +1507,8 @@ typedef struct ScanState
 	Relation	ss_currentRelation;
 	struct TableScanDescData *ss_currentScanDesc;
 	TupleTableSlot *ss_ScanTupleSlot;
+	struct HashRuntimeFilter *ss_runtimefilter; /* filter from a hash join
+												 * above, or NULL */
 } ScanState;
 
 /* ----------------
@@ -1485,6 +1519,13 @@ typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+	int			ss_nkeys;		/* number of quals pushed into the scan */
+	struct ScanKeyData *ss_scankeys;	/* those quals, as scan keys */
+	struct TupleBatch *ss_batch;	/* scan tuples to project, in batch mode */
+	struct BatchQual *ss_batchqual; /* vectorized form of qual, or NULL */
+	bool		ss_need_tuples; /* false if only the tuple count matters */
+	bool		ss_project;		/* limit the scan to ss_projection? */
+	Bitmapset  *ss_projection;	/* columns needed, see scan_set_projection */
 } SeqScanState;
 
 /* ----------------
@@ -1554,6 +1595,8 @@ typedef struct
  *		OrderByTypByVals   is the datatype of order by expression pass-by-value?
  *		OrderByTypLens	   typlens of the datatypes of order by expressions
  *		PscanLen		   size of parallel index scan descriptor
+ *		PrefetchMaximum	   heap blocks to prefetch ahead of the scan, or 0
+ *		SeekKey			   scankey reserved for ExecIndexScanSeek, or NULL
  * ----------------
  */
 typedef struct IndexScanState
@@ -1581,6 +1624,8 @@ typedef struct IndexScanState
 	bool	   *iss_OrderByTypByVals;
 	int16	   *iss_OrderByTypLens;
 	Size		iss_PscanLen;
+	int			iss_PrefetchMaximum;
+	struct ScanKeyData *iss_SeekKey;
 } IndexScanState;
 
 /* ----------------
@@ -1600,6 +1645,8 @@ typedef struct IndexScanState
  *		TableSlot		   slot for holding tuples fetched from the table
  *		VMBuffer		   buffer in use for visibility map testing, if any
  *		PscanLen		   size of parallel index-only scan descriptor
+ *		PrefetchMaximum	   heap blocks to prefetch ahead of the scan, or 0
+ *		SeekKey			   scankey reserved for ExecIndexOnlyScanSeek, or NULL
  * ----------------
  */
 typedef struct IndexOnlyScanState
@@ -1619,6 +1666,8 @@ typedef struct IndexOnlyScanState
 	TupleTableSlot *ioss_TableSlot;
 	Buffer		ioss_VMBuffer;
 	Size		ioss_PscanLen;
+	int			ioss_PrefetchMaximum;
+	struct ScanKeyData *ioss_SeekKey;
 } IndexOnlyScanState;
 
 /* ----------------
@@ -1676,11 +1725,7 @@ typedef enum
 /* ----------------
  *	 ParallelBitmapHeapState information
  *		tbmiterator				iterator for scanning current pages
- *		prefetch_iterator		iterator for prefetching ahead of current page
- *		mutex					mutual exclusion for the prefetching variable
- *								and state
- *		prefetch_pages			# pages prefetch iterator is ahead of current
- *		prefetch_target			current target prefetch distance
+ *		mutex					mutual exclusion for the state
  *		state					current state of the TIDBitmap
  *		cv						conditional wait variable
  *		phs_snapshot_data		snapshot data shared to workers
@@ -1689,10 +1734,7 @@ typedef enum
 typedef struct ParallelBitmapHeapState
 {
 	dsa_pointer tbmiterator;
-	dsa_pointer prefetch_iterator;
 	slock_t		mutex;
-	int			prefetch_pages;
-	int			prefetch_target;
 	SharedBitmapState state;
 	ConditionVariable cv;
 	char		phs_snapshot_data[FLEXIBLE_ARRAY_MEMBER];
@@ -1703,23 +1745,12 @@ typedef struct ParallelBitmapHeapState
  *
  *		bitmapqualorig	   execution state for bitmapqualorig expressions
  *		tbm				   bitmap obtained from child index scan(s)
- *		tbmiterator		   iterator for scanning current pages
- *		tbmres			   current-page data
- *		can_skip_fetch	   can we potentially skip tuple fetches in this scan?
- *		return_empty_tuples number of empty tuples to return
- *		vmbuffer		   buffer for visibility-map lookups
- *		pvmbuffer		   ditto, for prefetched pages
  *		exact_pages		   total number of exact pages retrieved
  *		lossy_pages		   total number of lossy pages retrieved
- *		prefetch_iterator  iterator for prefetching ahead of current page
- *		prefetch_pages	   # pages prefetch iterator is ahead of current
- *		prefetch_target    current target prefetch distance
- *		prefetch_maximum   maximum value for prefetch_target
  *		pscan_len		   size of the shared memory for parallel bitmap
  *		initialized		   is node is ready to iterate
- *		shared_tbmiterator	   shared iterator
- *		shared_prefetch_iterator shared iterator for prefetching
  *		pstate			   shared state for parallel bitmap scan
+ *		recheck			   do current page's tuples need recheck
  * ----------------
  */
 typedef struct BitmapHeapScanState
@@ -1727,23 +1758,12 @@ typedef struct BitmapHeapScanState
 	ScanState	ss;				/* its first field is NodeTag */
 	ExprState  *bitmapqualorig;
 	TIDBitmap  *tbm;
-	TBMIterator *tbmiterator;
-	TBMIterateResult *tbmres;
-	bool		can_skip_fetch;
-	int			return_empty_tuples;
-	Buffer		vmbuffer;
-	Buffer		pvmbuffer;
 	long		exact_pages;
 	long		lossy_pages;
-	TBMIterator *prefetch_iterator;
-	int			prefetch_pages;
-	int			prefetch_target;
-	int			prefetch_maximum;
 	Size		pscan_len;
 	bool		initialized;
-	TBMSharedIterator *shared_tbmiterator;
-	TBMSharedIterator *shared_prefetch_iterator;
 	ParallelBitmapHeapState *pstate;
+	bool		recheck;
 } BitmapHeapScanState;
 
 /* ----------------
@@ -2012,14 +2032,31 @@ typedef struct JoinState
  *		NeedNewOuter	   true if need new outer tuple on next call
  *		MatchedOuter	   true if found a join match for current outer tuple
  *		NullInnerTupleSlot prepared null tuple for left outer joins
+ *		Batch			   state for batched inner index probes, or NULL
+ *		Hash			   state for switching to hashing the inner side,
+ *						   or NULL
+ *		HashSwitchedAfter  outer tuples read before we switched, or 0
+ *		HashInnerTuples	   inner tuples in the hash table
+ *		HashSpaceUsed	   peak memory used by the hash table
+ *		HashAbandoned	   true if the inner side didn't fit in memory
  * ----------------
  */
+/* private in nodeNestloop.c: */
+typedef struct NestLoopBatchData *NestLoopBatch;
+typedef struct NestLoopHashData *NestLoopHash;
+
 typedef struct NestLoopState
 {
 	JoinState	js;				/* its first field is NodeTag */
 	bool		nl_NeedNewOuter;
 	bool		nl_MatchedOuter;
 	TupleTableSlot *nl_NullInnerTupleSlot;
+	NestLoopBatch nl_Batch;
+	NestLoopHash nl_Hash;
+	int64		nl_HashSwitchedAfter;
+	int64		nl_HashInnerTuples;
+	Size		nl_HashSpaceUsed;
+	bool		nl_HashAbandoned;
 } NestLoopState;
 
 /* ----------------
@@ -2042,10 +2079,13 @@ typedef struct NestLoopState
  *		NullInnerTupleSlot prepared null tuple for left outer joins
  *		OuterEContext	   workspace for computing outer tuple's join values
  *		InnerEContext	   workspace for computing inner tuple's join values
+ *		OuterSeek		   info for seeking the outer index scan, or NULL
+ *		InnerSeek		   info for seeking the inner index scan, or NULL
  * ----------------
  */
 /* private in nodeMergejoin.c: */
 typedef struct MergeJoinClauseData *MergeJoinClause;
+typedef struct MergeJoinSeekData *MergeJoinSeek;
 
 typedef struct MergeJoinState
 {
@@ -2067,6 +2107,8 @@ typedef struct MergeJoinState
 	TupleTableSlot *mj_NullInnerTupleSlot;
 	ExprContext *mj_OuterEContext;
 	ExprContext *mj_InnerEContext;
+	MergeJoinSeek mj_OuterSeek;
+	MergeJoinSeek mj_InnerSeek;
 } MergeJoinState;
 
 /* ----------------
@@ -2093,6 +2135,12 @@ typedef struct MergeJoinState
  *		hj_JoinState			current state of ExecHashJoin state machine
  *		hj_MatchedOuter			true if found a join match for current outer
  *		hj_OuterNotEmpty		true if outer relation known not empty
+ *		hj_RuntimeFilter		filter pushed into the outer scans, or NULL
+ *		hj_OuterBatch			batch of outer tuples, if the outer plan
+ *								supports batch execution
+ *		hj_OuterHashValues		hash values of the outer batch's tuples
+ *		hj_OuterHashValid		false for outer tuples that can't match
+ *		hj_OuterBatchHashed		hash values computed for current batch?
  * ----------------
  */
 
@@ -2120,6 +2168,11 @@ typedef struct HashJoinState
 	int			hj_JoinState;
 	bool		hj_MatchedOuter;
 	bool		hj_OuterNotEmpty;
+	struct HashRuntimeFilter *hj_RuntimeFilter;
+	struct TupleBatch *hj_OuterBatch;
+	uint32	   *hj_OuterHashValues;
+	bool	   *hj_OuterHashValid;
+	bool		hj_OuterBatchHashed;
 } HashJoinState;
 
 
@@ -2148,6 +2201,7 @@ typedef struct MaterialState
 struct MemoizeEntry;
 struct MemoizeTuple;
 struct MemoizeKey;
+struct MemoizeSharedData;
 
 typedef struct MemoizeInstrumentation
 {
@@ -2213,6 +2267,13 @@ typedef struct MemoizeState
 	SharedMemoizeInfo *shared_info; /* statistics for parallel workers */
 	Bitmapset  *keyparamids;	/* Param->paramids of expressions belonging to
 								 * param_exprs */
+	uint64		inflation;		/* eviction priority of the last entry
+								 * evicted */
+	instr_time	fill_time;		/* time spent in the subplan filling the
+								 * current entry */
+	struct MemoizeSharedData *shared;	/* cache shared with the other
+										 * processes of a parallel query, or
+										 * NULL */
 } MemoizeState;
 
 /* ----------------
@@ -2239,6 +2300,22 @@ typedef struct SharedSortInfo
 	TuplesortInstrumentation sinstrument[FLEXIBLE_ARRAY_MEMBER];
 } SharedSortInfo;
 
+/* ----------------
+ *	 SortThreshold information
+ *
+ *		A bounded MergeAppend shares this with its Sort children.  Once
+ *		some child is known to return at least bound tuples that sort at or
+ *		before the threshold tuple, the other children can discard input
+ *		tuples that sort after it.  The sort keys are the MergeAppend's.
+ * ----------------
+ */
+typedef struct SortThreshold
+{
+	TupleTableSlot *slot;		/* threshold tuple, or empty if none yet */
+	int			nkeys;
+	SortSupport sortkeys;		/* array of length nkeys */
+} SortThreshold;
+
 /* ----------------
  *	 SortState information
  * ----------------
@@ -2256,6 +2333,8 @@ typedef struct SortState
 	bool		am_worker;		/* are we a worker? */
 	bool		datumSort;		/* Datum sort instead of tuple sort? */
 	SharedSortInfo *shared_info;	/* one entry per worker */
+	SortThreshold *threshold;	/* set by a bounded MergeAppend parent */
+	bool		threshold_Done; /* did the sort discard tuples by it? */
 } SortState;
 
 /* ----------------
@@ -2449,6 +2528,10 @@ typedef struct AggState
 										 * ->hash_pergroup */
 	ProjectionInfo *combinedproj;	/* projection machinery */
 	SharedAggInfo *shared_info; /* one entry per worker */
+	struct TupleBatch *input_batch; /* outer tuples, if outer plan
+									 * supports batch mode */
+	struct HashAggParallelData *hash_parallel;	/* Parallel HashAgg state, or
+												 * NULL */
 } AggState;
 
 /* ----------------
@@ -2587,6 +2670,8 @@ typedef struct GatherState
 	bool		initialized;	/* workers launched? */
 	bool		need_to_scan_locally;	/* need to read from local plan? */
 	int64		tuples_needed;	/* tuple bound, see ExecSetTupleBound */
+	struct _DestReceiver *insert_dest;	/* insert into this CREATE TABLE AS
+										 * receiver ourselves, or NULL */
 	/* these fields are set up once: */
 	TupleTableSlot *funnel_slot;
 	struct ParallelExecutorInfo *pei;
@@ -2595,6 +2680,9 @@ typedef struct GatherState
 	int			nreaders;		/* number of still-active workers */
 	int			nextreader;		/* next one to try to read from */
 	struct TupleQueueReader **reader;	/* array with nreaders active entries */
+	/* tuple queue waits over all runs, for EXPLAIN ANALYZE: */
+	uint64		queue_full_stalls;	/* times a worker found its queue full */
+	uint64		queue_empty_stalls; /* times we found all queues empty */
 } GatherState;
 
 /* ----------------
@@ -2627,6 +2715,9 @@ typedef struct GatherMergeState
 	struct TupleQueueReader **reader;	/* array with nreaders active entries */
 	struct GMReaderTupleBuffer *gm_tuple_buffers;	/* nreaders tuple buffers */
 	struct binaryheap *gm_heap; /* binary heap of slot indices */
+	/* tuple queue waits over all runs, for EXPLAIN ANALYZE: */
+	uint64		queue_full_stalls;	/* times a worker found its queue full */
+	uint64		queue_empty_stalls; /* times we found a queue empty */
 } GatherMergeState;
 
 /* ----------------
@@ -2661,6 +2752,7 @@ typedef struct HashState
 	PlanState	ps;				/* its first field is NodeTag */
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
+	bool		hs_want_bloom;	/* build a bloom filter of the hash values? */
 
 	/*
 	 * In a parallelized hash join, the leader retains a pointer to the
@@ -2679,6 +2771,9 @@ typedef struct HashState
 
 	/* Parallel hash state. */
 	struct ParallelHashJoinState *parallel_state;
+
+	/* Outer tuples, if the outer plan supports batch mode. */
+	struct TupleBatch *hs_batch;
 } HashState;
 
 /* ----------------
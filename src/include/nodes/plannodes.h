@@ -801,12 +801,18 @@ typedef struct Join
  * Vars, but perhaps someday that'd be worth relaxing.  (Note: during plan
  * creation, the paramval can actually be a PlaceHolderVar expression; but it
  * must be a Var with varno OUTER_VAR by the time it gets to the executor.)
+ *
+ * adaptive_hashclauses is a subset of the joinquals that the executor can
+ * use to build a hash table over the inner side, if far more outer rows
+ * arrive than estimated.  Each is a hashable OpExpr with its outer argument
+ * on the left; NIL if the join can't switch to hashing.
  * ----------------
  */
 typedef struct NestLoop
 {
 	Join		join;
 	List	   *nestParams;		/* list of NestLoopParam nodes */
+	List	   *adaptive_hashclauses;	/* hashable joinquals, outer on left */
 } NestLoop;
 
 typedef struct NestLoopParam
@@ -1010,6 +1010,9 @@ typedef struct SubPlan
 								 * simpler handling of null values */
 	bool		parallel_safe;	/* is the subplan parallel-safe? */
 	/* Note: parallel_safe does not consider contents of testexpr or args */
+	bool		result_cacheable;	/* may an initplan's result be reused by
+									 * later executions with the same query
+									 * parameters? */
 	/* Information for passing params into and out of the subselect: */
 	/* setParam and parParam are lists of integers (param IDs) */
 	List	   *setParam;		/* initplan and MULTIEXPR subqueries have to
@@ -23,6 +23,7 @@
 #define OPTIMIZER_H
 
 #include "nodes/parsenodes.h"
+#include "portability/instr_time.h"
 
 /*
  * We don't want to include nodes/pathnodes.h here, because non-planner
@@ -107,9 +108,47 @@ typedef enum
 	DEBUG_PARALLEL_REGRESS
 }			DebugParallelMode;
 
+/*
+ * Where planning time and effort went, collected for EXPLAIN
+ * (PLANNING_DETAIL) and, with track_planning_detail, for pg_stat_planning.
+ * The phase times are for the top query level only; subqueries are planned
+ * while sizing its base relations, so they count toward path_time.  The
+ * selectivity time and the counters cover all levels.  The planner frees little
+ * memory before it's done, so the memory allocated is close to its peak.
+ */
+typedef struct PlannerInstrumentation
+{
+	instr_time	expand_time;	/* inheritance and partition expansion */
+	instr_time	path_time;		/* sizes and paths of base relations */
+	instr_time	join_time;		/* join search */
+	instr_time	selectivity_time;	/* in clauselist_selectivity() */
+	int64		selectivity_calls;	/* clauselist_selectivity() calls */
+	int64		paths_considered;	/* paths offered to add_path() etc */
+	int64		joinrels_built; /* join relations created */
+	Size		memory_allocated;	/* memory allocated while planning */
+
+	/* private state */
+	struct PlannerInstrumentation *prev;	/* outer collection, if any */
+	MemoryContext context;		/* context planning happens in */
+	Size		context_start;	/* its allocation before planning */
+} PlannerInstrumentation;
+
 /* GUC parameters */
 extern PGDLLIMPORT int debug_parallel_query;
 extern PGDLLIMPORT bool parallel_leader_participation;
+extern PGDLLIMPORT bool track_planning_detail;
+
+/* instrumentation being collected for the current planning, if any */
+extern PGDLLIMPORT PlannerInstrumentation *planner_instrument;
+
+#define PLANNER_INSTR_COUNT(field) \
+	do { \
+		if (unlikely(planner_instrument != NULL)) \
+			planner_instrument->field++; \
+	} while (0)
+
+extern void PlannerInstrumentBegin(PlannerInstrumentation *instr);
+extern void PlannerInstrumentEnd(PlannerInstrumentation *instr);
 
 extern struct PlannedStmt *planner(Query *parse, const char *query_string,
 								   int cursorOptions,
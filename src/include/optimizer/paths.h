@@ -63,6 +63,13 @@ extern void create_partial_bitmap_paths(PlannerInfo *root, RelOptInfo *rel,
 extern void generate_partitionwise_join_paths(PlannerInfo *root,
 											  RelOptInfo *rel);
 
+/*
+ * childpaths.c
+ *	  routines to reuse the access paths of appendrel children
+ */
+extern bool reuse_sibling_paths(PlannerInfo *root, RelOptInfo *rel,
+								RelOptInfo *sibling);
+
 #ifdef OPTIMIZER_DEBUG
 extern void debug_print_rel(PlannerInfo *root, RelOptInfo *rel);
 #endif
@@ -97,6 +104,21 @@ extern void add_paths_to_joinrel(PlannerInfo *root, RelOptInfo *joinrel,
 								 JoinType jointype, SpecialJoinInfo *sjinfo,
 								 List *restrictlist);
 
+/*
+ * joinsearch.c
+ *	  deterministic join search for large join problems
+ */
+typedef enum
+{
+	JOIN_SEARCH_GEQO,			/* genetic query optimizer */
+	JOIN_SEARCH_GREEDY			/* greedy ordering refined by linearized DP */
+} JoinSearchMethod;
+
+extern PGDLLIMPORT int join_search_method;
+
+extern RelOptInfo *greedy_join_search(PlannerInfo *root, int levels_needed,
+									  List *initial_rels);
+
 /*
  * joinrels.c
  *	  routines to determine which relations to join
@@ -93,6 +93,7 @@ typedef Node *(*ParseParamRefHook) (ParseState *pstate, ParamRef *pref);
 typedef Node *(*CoerceParamHook) (ParseState *pstate, Param *param,
 								  Oid targetTypeId, int32 targetTypeMod,
 								  int location);
+typedef Node *(*ParseAConstHook) (ParseState *pstate, A_Const *aconst);
 
 
 /*
@@ -235,6 +236,7 @@ struct ParseState
 	PostParseColumnRefHook p_post_columnref_hook;
 	ParseParamRefHook p_paramref_hook;
 	CoerceParamHook p_coerce_param_hook;
+	ParseAConstHook p_aconst_hook;
 	void	   *p_ref_hook_state;	/* common passthrough link for above */
 };
 
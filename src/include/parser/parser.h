@@ -44,6 +44,28 @@ typedef enum
 	RAW_PARSE_PLPGSQL_ASSIGN3
 } RawParseMode;
 
+/*
+ * A literal constant found by scan_query_literals().  The kind tells what
+ * type the parser gives the constant; quoted strings are of unknown type
+ * until parse analysis coerces them.
+ */
+typedef enum QueryLiteralKind
+{
+	QUERY_LITERAL_INT4,
+	QUERY_LITERAL_INT8,
+	QUERY_LITERAL_NUMERIC,
+	QUERY_LITERAL_STRING,
+	QUERY_LITERAL_BITSTRING
+} QueryLiteralKind;
+
+typedef struct QueryLiteral
+{
+	QueryLiteralKind kind;
+	int			location;		/* byte offset of the literal in the query */
+	int			length;			/* length of the literal's text */
+	char	   *value;			/* value that make_const() would see */
+} QueryLiteral;
+
 /* Values for the backslash_quote GUC */
 typedef enum
 {
@@ -60,6 +82,8 @@ extern PGDLLIMPORT bool standard_conforming_strings;
 
 /* Primary entry point for the raw parsing functions */
 extern List *raw_parser(const char *str, RawParseMode mode);
+extern bool scan_query_literals(const char *str, QueryLiteral **literals,
+								int *nliterals);
 
 /* Utility functions exported by gram.y (perhaps these should be elsewhere) */
 extern List *SystemFuncName(char *name);
@@ -11,9 +11,12 @@
 #ifndef PGSTAT_H
 #define PGSTAT_H
 
+#include "access/rmgr.h"
+#include "access/xlogdefs.h"
 #include "datatype/timestamp.h"
 #include "portability/instr_time.h"
 #include "postmaster/pgarch.h"	/* for MAX_XFN_CHARS */
+#include "storage/relfilelocator.h"
 #include "utils/backend_progress.h" /* for backward compatibility */
 #include "utils/backend_status.h"	/* for backward compatibility */
 #include "utils/relcache.h"
@@ -43,6 +46,10 @@ typedef enum PgStat_Kind // 统计数据的分类
 	PGSTAT_KIND_FUNCTION,		/* per-function statistics */
 	PGSTAT_KIND_REPLSLOT,		/* per-slot statistics */
 	PGSTAT_KIND_SUBSCRIPTION,	/* per-subscription statistics */
+	PGSTAT_KIND_WALRELATION,	/* per-relation WAL statistics */
+	PGSTAT_KIND_PLANNING,		/* per-query-id planner statistics */
+	PGSTAT_KIND_QUERY,			/* per-query-id execution statistics */
+	PGSTAT_KIND_TABLESPACE,		/* per-tablespace IO statistics */
 
 	/* stats for fixed-numbered objects */
 	PGSTAT_KIND_ARCHIVER,
@@ -50,6 +57,7 @@ typedef enum PgStat_Kind // 统计数据的分类
 	PGSTAT_KIND_CHECKPOINTER,
 	PGSTAT_KIND_IO,
 	PGSTAT_KIND_SLRU,
+	PGSTAT_KIND_WAIT,
 	PGSTAT_KIND_WAL,
 } PgStat_Kind;
 
@@ -235,7 +243,7 @@ typedef struct PgStat_TableXactStatus
  * ------------------------------------------------------------
  */
 
-#define PGSTAT_FILE_FORMAT_ID	0x01A5BCAC
+#define PGSTAT_FILE_FORMAT_ID	0x01A5BCB6
 
 typedef struct PgStat_ArchiverStats
 {
@@ -305,10 +313,19 @@ typedef enum IOOp
 
 #define IOOP_NUM_TYPES (IOOP_WRITEBACK + 1)
 
+/*
+ * Number of buckets of the IO latency histograms, kept when track_io_timing
+ * is on.  Bucket 0 counts IOs faster than 1us, bucket i those taking
+ * [2^(i-1), 2^i) us, and the last one all that take longer, i.e. about 4
+ * seconds or more.
+ */
+#define PGSTAT_IO_HIST_BUCKETS	24
+
 typedef struct PgStat_BktypeIO
 {
 	PgStat_Counter counts[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES];
 	PgStat_Counter times[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES];
+	PgStat_Counter hist[IOOBJECT_NUM_TYPES][IOCONTEXT_NUM_TYPES][IOOP_NUM_TYPES][PGSTAT_IO_HIST_BUCKETS];
 } PgStat_BktypeIO;
 
 typedef struct PgStat_IO
@@ -317,6 +334,19 @@ typedef struct PgStat_IO
 	PgStat_BktypeIO stats[BACKEND_NUM_TYPES];
 } PgStat_IO;
 
+/* ----------
+ * PgStat_StatTablespaceIOEntry	IO statistics of one tablespace, by IOOp.
+ *								Times are in microseconds.
+ * ----------
+ */
+typedef struct PgStat_StatTablespaceIOEntry
+{
+	PgStat_Counter counts[IOOP_NUM_TYPES];
+	PgStat_Counter times[IOOP_NUM_TYPES];
+	PgStat_Counter hist[IOOP_NUM_TYPES][PGSTAT_IO_HIST_BUCKETS];
+	TimestampTz stat_reset_timestamp;
+} PgStat_StatTablespaceIOEntry;
+
 
 typedef struct PgStat_StatDBEntry
 {
@@ -350,6 +380,10 @@ typedef struct PgStat_StatDBEntry
 	PgStat_Counter sessions_abandoned;
 	PgStat_Counter sessions_fatal;
 	PgStat_Counter sessions_killed;
+	PgStat_Counter cpu_user_time;	/* times in microseconds */
+	PgStat_Counter cpu_system_time;
+	PgStat_Counter read_bytes;
+	PgStat_Counter write_bytes;
 
 	TimestampTz stat_reset_timestamp;
 } PgStat_StatDBEntry;
@@ -372,6 +406,7 @@ typedef struct PgStat_StatReplSlotEntry
 	PgStat_Counter stream_bytes;
 	PgStat_Counter total_txns;
 	PgStat_Counter total_bytes;
+	PgStat_Counter snapshot_build_time; /* time in microseconds */
 	TimestampTz stat_reset_timestamp;
 } PgStat_StatReplSlotEntry;
 
@@ -424,18 +459,155 @@ typedef struct PgStat_StatTabEntry
 	PgStat_Counter analyze_count;
 	TimestampTz last_autoanalyze_time;	/* autovacuum initiated */
 	PgStat_Counter autoanalyze_count;
+
+	XLogRecPtr	last_vacuum_lsn;	/* insert LSN at end of last vacuum */
+	PgStat_Counter eager_frozen_pages;	/* pages frozen ahead of need */
+	PgStat_Counter freeze_debt_pages;	/* all-visible, not all-frozen */
 } PgStat_StatTabEntry;
 
+/* WAL generated by one relation or resource manager */
+typedef struct PgStat_WalCounts
+{
+	PgStat_Counter wal_records;
+	PgStat_Counter wal_fpi;
+	uint64		wal_bytes;
+} PgStat_WalCounts;
+
+typedef struct PgStat_StatWalRelEntry
+{
+	PgStat_WalCounts counts;
+	TimestampTz stat_reset_timestamp;
+} PgStat_StatWalRelEntry;
+
+/* ----------
+ * PgStat_PlanningCounts	The planner's counters for one query id, as
+ *							accumulated in a backend and not yet flushed
+ * ----------
+ */
+typedef struct PgStat_PlanningCounts
+{
+	PgStat_Counter plans;
+	instr_time	total_time;
+	instr_time	expand_time;
+	instr_time	path_time;
+	instr_time	join_time;
+	instr_time	selectivity_time;
+	PgStat_Counter selectivity_calls;
+	PgStat_Counter paths_considered;
+	PgStat_Counter joinrels_built;
+	PgStat_Counter max_memory;
+} PgStat_PlanningCounts;
+
+/* ----------
+ * PgStat_StatPlanningEntry	Planner statistics of one query id.  Times are
+ *							in microseconds.
+ * ----------
+ */
+typedef struct PgStat_StatPlanningEntry
+{
+	PgStat_Counter plans;
+	PgStat_Counter total_time;
+	PgStat_Counter expand_time;
+	PgStat_Counter path_time;
+	PgStat_Counter join_time;
+	PgStat_Counter selectivity_time;
+	PgStat_Counter selectivity_calls;
+	PgStat_Counter paths_considered;
+	PgStat_Counter joinrels_built;
+	PgStat_Counter max_memory;
+	TimestampTz stat_reset_timestamp;
+} PgStat_StatPlanningEntry;
+
+/*
+ * Number of buckets of the query latency histograms.  Bucket 0 counts
+ * executions faster than 1us, bucket i those taking [2^(i-1), 2^i) us, and
+ * the last one all that take longer, i.e. about 18 minutes or more.
+ */
+#define PGSTAT_QUERY_HIST_BUCKETS	32
+
+/* ----------
+ * PgStat_QueryCounts		The execution counters for one query id, as
+ *							accumulated in a backend and not yet flushed.
+ *							Times are in microseconds.
+ * ----------
+ */
+typedef struct PgStat_QueryCounts
+{
+	PgStat_Counter calls;
+	PgStat_Counter total_time;
+	PgStat_Counter min_time;
+	PgStat_Counter max_time;
+	PgStat_Counter rows;
+	PgStat_Counter shared_blks_hit;
+	PgStat_Counter shared_blks_read;
+	PgStat_Counter shared_blks_dirtied;
+	PgStat_Counter shared_blks_written;
+	PgStat_Counter local_blks_hit;
+	PgStat_Counter local_blks_read;
+	PgStat_Counter temp_blks_read;
+	PgStat_Counter temp_blks_written;
+	PgStat_Counter wal_records;
+	PgStat_Counter wal_fpi;
+	PgStat_Counter wal_bytes;
+	PgStat_Counter hist[PGSTAT_QUERY_HIST_BUCKETS];
+} PgStat_QueryCounts;
+
+/* ----------
+ * PgStat_StatQueryEntry	Execution statistics of one query id.  Times are
+ *							in microseconds.
+ * ----------
+ */
+typedef struct PgStat_StatQueryEntry
+{
+	PgStat_Counter calls;
+	PgStat_Counter total_time;
+	PgStat_Counter min_time;
+	PgStat_Counter max_time;
+	PgStat_Counter rows;
+	PgStat_Counter shared_blks_hit;
+	PgStat_Counter shared_blks_read;
+	PgStat_Counter shared_blks_dirtied;
+	PgStat_Counter shared_blks_written;
+	PgStat_Counter local_blks_hit;
+	PgStat_Counter local_blks_read;
+	PgStat_Counter temp_blks_read;
+	PgStat_Counter temp_blks_written;
+	PgStat_Counter wal_records;
+	PgStat_Counter wal_fpi;
+	PgStat_Counter wal_bytes;
+	PgStat_Counter hist[PGSTAT_QUERY_HIST_BUCKETS];
+	TimestampTz stat_reset_timestamp;
+} PgStat_StatQueryEntry;
+
+/*
+ * Wait events are counted per class, indexed by the class byte of the
+ * wait_event_info minus one, and by event number within the class.  Events
+ * with a higher number, such as LWLock tranches of extensions beyond the
+ * limit, are not counted.
+ */
+#define PGSTAT_WAIT_NUM_CLASSES			(PG_WAIT_IO >> 24)
+#define PGSTAT_WAIT_EVENTS_PER_CLASS	256
+
+typedef struct PgStat_WaitStats
+{
+	PgStat_Counter counts[PGSTAT_WAIT_NUM_CLASSES][PGSTAT_WAIT_EVENTS_PER_CLASS];
+	PgStat_Counter times[PGSTAT_WAIT_NUM_CLASSES][PGSTAT_WAIT_EVENTS_PER_CLASS];	/* in microseconds */
+	TimestampTz stat_reset_timestamp;
+} PgStat_WaitStats;
+
 typedef struct PgStat_WalStats
 {
 	PgStat_Counter wal_records;
 	PgStat_Counter wal_fpi;
 	uint64		wal_bytes;
 	PgStat_Counter wal_buffers_full;
+	PgStat_Counter wal_buffers_init;
+	PgStat_Counter wal_segments_created;
 	PgStat_Counter wal_write;
 	PgStat_Counter wal_sync;
 	PgStat_Counter wal_write_time;
 	PgStat_Counter wal_sync_time;
+	PgStat_WalCounts rmgrs[RM_N_IDS];
 	TimestampTz stat_reset_timestamp;
 } PgStat_WalStats;
 
@@ -448,10 +620,13 @@ typedef struct PgStat_WalStats
 typedef struct PgStat_PendingWalStats
 {
 	PgStat_Counter wal_buffers_full;
+	PgStat_Counter wal_buffers_init;
+	PgStat_Counter wal_segments_created;
 	PgStat_Counter wal_write;
 	PgStat_Counter wal_sync;
 	instr_time	wal_write_time;
 	instr_time	wal_sync_time;
+	PgStat_WalCounts rmgrs[RM_N_IDS];
 } PgStat_PendingWalStats;
 
 
@@ -476,7 +651,7 @@ extern long pgstat_report_stat(bool force);
 extern void pgstat_force_next_flush(void);
 
 extern void pgstat_reset_counters(void);
-extern void pgstat_reset(PgStat_Kind kind, Oid dboid, Oid objoid);
+extern void pgstat_reset(PgStat_Kind kind, Oid dboid, uint64 objoid);
 extern void pgstat_reset_of_kind(PgStat_Kind kind);
 
 /* stats accessors */
@@ -485,7 +660,7 @@ extern TimestampTz pgstat_get_stat_snapshot_timestamp(bool *have_snapshot);
 
 /* helpers */
 extern PgStat_Kind pgstat_get_kind_from_str(char *kind_str);
-extern bool pgstat_have_entry(PgStat_Kind kind, Oid dboid, Oid objoid);
+extern bool pgstat_have_entry(PgStat_Kind kind, Oid dboid, uint64 objoid);
 
 
 /*
@@ -522,11 +697,15 @@ extern void pgstat_count_io_op(IOObject io_object, IOContext io_context, IOOp io
 extern void pgstat_count_io_op_n(IOObject io_object, IOContext io_context, IOOp io_op, uint32 cnt);
 extern instr_time pgstat_prepare_io_time(void);
 extern void pgstat_count_io_op_time(IOObject io_object, IOContext io_context,
-									IOOp io_op, instr_time start_time, uint32 cnt);
+									IOOp io_op, Oid spcoid,
+									instr_time start_time, uint32 cnt);
+extern void pgstat_drop_tablespace(Oid spcoid);
 
 extern PgStat_IO *pgstat_fetch_stat_io(void);
+extern PgStat_StatTablespaceIOEntry *pgstat_fetch_stat_tablespace_io(Oid spcoid);
 extern const char *pgstat_get_io_context_name(IOContext io_context);
 extern const char *pgstat_get_io_object_name(IOObject io_object);
+extern const char *pgstat_get_io_op_name(IOOp io_op);
 
 extern bool pgstat_tracks_io_bktype(BackendType bktype);
 extern bool pgstat_tracks_io_object(BackendType bktype,
@@ -576,6 +755,33 @@ extern PgStat_StatFuncEntry *pgstat_fetch_stat_funcentry(Oid func_id);
 extern PgStat_FunctionCounts *find_funcstat_entry(Oid func_id);
 
 
+/*
+ * Functions in pgstat_planning.c
+ */
+
+struct PlannerInstrumentation;
+
+extern void pgstat_report_planning(uint64 queryid, instr_time duration,
+								   const struct PlannerInstrumentation *instr);
+extern void pgstat_reset_planning(void);
+extern uint64 *pgstat_fetch_planning_queryids(int *nqueryids);
+extern PgStat_StatPlanningEntry *pgstat_fetch_stat_planning(uint64 queryid);
+
+
+/*
+ * Functions in pgstat_query.c
+ */
+
+struct Instrumentation;
+
+extern void pgstat_report_query(uint64 queryid,
+								const struct Instrumentation *totaltime,
+								uint64 rows);
+extern void pgstat_reset_queries(void);
+extern uint64 *pgstat_fetch_query_queryids(int *nqueryids);
+extern PgStat_StatQueryEntry *pgstat_fetch_stat_query(uint64 queryid);
+
+
 /*
  * Functions in pgstat_relation.c
  */
@@ -589,7 +795,10 @@ extern void pgstat_assoc_relation(Relation rel);
 extern void pgstat_unlink_relation(Relation rel);
 
 extern void pgstat_report_vacuum(Oid tableoid, bool shared,
-								 PgStat_Counter livetuples, PgStat_Counter deadtuples);
+								 PgStat_Counter livetuples, PgStat_Counter deadtuples,
+								 PgStat_Counter eagerfrozenpages,
+								 PgStat_Counter freezedebtpages,
+								 XLogRecPtr vacuumlsn);
 extern void pgstat_report_analyze(Relation rel,
 								  PgStat_Counter livetuples, PgStat_Counter deadtuples,
 								  bool resetcounter);
@@ -711,6 +920,13 @@ extern int	pgstat_get_transactional_drops(bool isCommit, struct xl_xact_stats_it
 extern void pgstat_execute_transactional_drops(int ndrops, struct xl_xact_stats_item *items, bool is_redo);
 
 
+/*
+ * Functions in pgstat_wait.c
+ */
+
+extern PgStat_WaitStats *pgstat_fetch_stat_wait(void);
+
+
 /*
  * Functions in pgstat_wal.c
  */
@@ -718,6 +934,12 @@ extern void pgstat_execute_transactional_drops(int ndrops, struct xl_xact_stats_
 extern void pgstat_report_wal(bool force);
 extern PgStat_WalStats *pgstat_fetch_stat_wal(void);
 
+extern void pgstat_count_wal_relation(const RelFileLocator *rlocator,
+									  uint32 bytes, int fpi);
+extern void pgstat_drop_wal_relation(const RelFileLocator *rlocator);
+extern PgStat_StatWalRelEntry *pgstat_fetch_stat_wal_relation(Oid dboid,
+															  RelFileNumber relnumber);
+
 
 /*
  * Variables in pgstat.c
@@ -729,6 +951,15 @@ extern PGDLLIMPORT int pgstat_track_functions;
 extern PGDLLIMPORT int pgstat_fetch_consistency;
 
 
+/*
+ * Variables in pgstat_query.c
+ */
+
+/* GUC parameters */
+extern PGDLLIMPORT bool pgstat_track_queries;
+extern PGDLLIMPORT int pgstat_track_queries_max;
+
+
 /*
  * Variables in pgstat_bgwriter.c
  */
@@ -767,6 +998,18 @@ extern PGDLLIMPORT PgStat_Counter pgStatTransactionIdleTime;
 extern PGDLLIMPORT SessionEndType pgStatSessionEndCause;
 
 
+/*
+ * Variables in pgstat_io.c
+ */
+
+/*
+ * Bytes read and written by this process since it started, for its
+ * resource usage.  Updated by pgstat_count_io_op_n().
+ */
+extern PGDLLIMPORT PgStat_Counter pgStatIOReadBytes;
+extern PGDLLIMPORT PgStat_Counter pgStatIOWriteBytes;
+
+
 /*
  * Variables in pgstat_wal.c
  */
@@ -127,6 +127,32 @@ pg_bswap64(uint64 x)
 
 #endif							/* WORDS_BIGENDIAN */
 
+/*
+ * Likewise for little-endian byte order, which is used by some on-disk and
+ * wire formats (e.g. the columnar COPY format).
+ */
+#ifdef WORDS_BIGENDIAN
+
+#define pg_htole16(x)		pg_bswap16(x)
+#define pg_htole32(x)		pg_bswap32(x)
+#define pg_htole64(x)		pg_bswap64(x)
+
+#define pg_letoh16(x)		pg_bswap16(x)
+#define pg_letoh32(x)		pg_bswap32(x)
+#define pg_letoh64(x)		pg_bswap64(x)
+
+#else
+
+#define pg_htole16(x)		(x)
+#define pg_htole32(x)		(x)
+#define pg_htole64(x)		(x)
+
+#define pg_letoh16(x)		(x)
+#define pg_letoh32(x)		(x)
+#define pg_letoh64(x)		(x)
+
+#endif							/* WORDS_BIGENDIAN */
+
 
 /*
  * Rearrange the bytes of a Datum from big-endian order into the native byte
@@ -37,11 +37,24 @@
 
 typedef uint32 pg_crc32c;
 
+/*
+ * Along with SSE 4.2, an AVX-512 implementation can be chosen at runtime, if
+ * the compiler can target AVX-512 VL and VPCLMULQDQ for a single function
+ * and has _mm512_zextsi128_si512(); that takes GCC 10 or clang 8.
+ */
+#if defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK) && \
+	!defined(USE_AVX512_CRC32C_WITH_RUNTIME_CHECK) && \
+	defined(__x86_64__) && defined(HAVE__GET_CPUID) && \
+	((defined(__clang__) && __clang_major__ >= 8) || \
+	 (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 10))
+#define USE_AVX512_CRC32C_WITH_RUNTIME_CHECK 1
+#endif
+
 /* The INIT and EQ macros are the same for all implementations. */
 #define INIT_CRC32C(crc) ((crc) = 0xFFFFFFFF)
 #define EQ_CRC32C(c1, c2) ((c1) == (c2))
 
-#if defined(USE_SSE42_CRC32C)
+#if defined(USE_SSE42_CRC32C) && !defined(USE_AVX512_CRC32C_WITH_RUNTIME_CHECK)
 /* Use Intel SSE4.2 instructions. */
 #define COMP_CRC32C(crc, data, len) \
 	((crc) = pg_comp_crc32c_sse42((crc), (data), (len)))
@@ -58,11 +71,12 @@ extern pg_crc32c pg_comp_crc32c_sse42(pg_crc32c crc, const void *data, size_t le
 
 extern pg_crc32c pg_comp_crc32c_armv8(pg_crc32c crc, const void *data, size_t len);
 
-#elif defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK) || defined(USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK)
+#elif defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK) || defined(USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK) || \
+	defined(USE_AVX512_CRC32C_WITH_RUNTIME_CHECK)
 
 /*
- * Use Intel SSE 4.2 or ARMv8 instructions, but perform a runtime check first
- * to check that they are available.
+ * Use Intel SSE 4.2, AVX-512 or ARMv8 instructions, but perform a runtime
+ * check first to check that they are available.
  */
 #define COMP_CRC32C(crc, data, len) \
 	((crc) = pg_comp_crc32c((crc), (data), (len)))
@@ -71,9 +85,12 @@ extern pg_crc32c pg_comp_crc32c_armv8(pg_crc32c crc, const void *data, size_t le
 extern pg_crc32c pg_comp_crc32c_sb8(pg_crc32c crc, const void *data, size_t len);
 extern pg_crc32c (*pg_comp_crc32c) (pg_crc32c crc, const void *data, size_t len);
 
-#ifdef USE_SSE42_CRC32C_WITH_RUNTIME_CHECK
+#if defined(USE_SSE42_CRC32C) || defined(USE_SSE42_CRC32C_WITH_RUNTIME_CHECK)
 extern pg_crc32c pg_comp_crc32c_sse42(pg_crc32c crc, const void *data, size_t len);
 #endif
+#ifdef USE_AVX512_CRC32C_WITH_RUNTIME_CHECK
+extern pg_crc32c pg_comp_crc32c_avx512(pg_crc32c crc, const void *data, size_t len);
+#endif
 #ifdef USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK
 extern pg_crc32c pg_comp_crc32c_armv8(pg_crc32c crc, const void *data, size_t len);
 #endif
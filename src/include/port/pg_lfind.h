@@ -80,6 +80,56 @@ pg_lfind8_le(uint8 key, uint8 *base, uint32 nelem)
 	return false;
 }
 
+/*
+ * pg_lfind8_skip4
+ *
+ * Return the number of leading elements of 'base' that are known not to
+ * equal any of the four keys.  Only whole vectors are examined, so the
+ * result is a multiple of the vector length and may be smaller than the
+ * actual number of such elements.  The caller is expected to examine the
+ * elements from there on one at a time.
+ */
+static inline uint32
+pg_lfind8_skip4(uint8 key1, uint8 key2, uint8 key3, uint8 key4,
+				const uint8 *base, uint32 nelem)
+{
+	uint32		i;
+
+	/* round down to multiple of vector length */
+	uint32		tail_idx = nelem & ~(sizeof(Vector8) - 1);
+	Vector8		chunk;
+
+#ifndef USE_NO_SIMD
+	const Vector8 keys1 = vector8_broadcast(key1);
+	const Vector8 keys2 = vector8_broadcast(key2);
+	const Vector8 keys3 = vector8_broadcast(key3);
+	const Vector8 keys4 = vector8_broadcast(key4);
+
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		Vector8		result;
+
+		vector8_load(&chunk, &base[i]);
+		result = vector8_or(vector8_or(vector8_eq(chunk, keys1),
+									   vector8_eq(chunk, keys2)),
+							vector8_or(vector8_eq(chunk, keys3),
+									   vector8_eq(chunk, keys4)));
+		if (vector8_is_highbit_set(result))
+			break;
+	}
+#else
+	for (i = 0; i < tail_idx; i += sizeof(Vector8))
+	{
+		vector8_load(&chunk, &base[i]);
+		if (vector8_has(chunk, key1) || vector8_has(chunk, key2) ||
+			vector8_has(chunk, key3) || vector8_has(chunk, key4))
+			break;
+	}
+#endif
+
+	return i;
+}
+
 /*
  * pg_lfind32
  *
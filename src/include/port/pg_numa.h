@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.h
+ *	  Basic NUMA portability routines
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/port/pg_numa.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_NUMA_H
+#define PG_NUMA_H
+
+extern int	pg_numa_init(void);
+extern int	pg_numa_get_max_node(void);
+extern int	pg_numa_query_pages(int pid, unsigned long count, void **pages,
+								int *status);
+extern int	pg_numa_interleave_memory(void *ptr, size_t size,
+									  size_t pagesize);
+extern int	pg_numa_bind_memory(void *ptr, size_t size, size_t pagesize,
+								int node);
+extern int	pg_numa_run_on_node(int node);
+
+#endif							/* PG_NUMA_H */
@@ -0,0 +1,32 @@
+/*-------------------------------------------------------------------------
+ *
+ * autoprewarm.h
+ *	  Exports from postmaster/autoprewarm.c.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/postmaster/autoprewarm.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _AUTOPREWARM_H
+#define _AUTOPREWARM_H
+
+/* File in the data directory holding the saved list of buffers */
+#define AUTOPREWARM_FILE		"pg_buffer_map"
+
+/* GUCs */
+extern PGDLLIMPORT bool autoprewarm;
+extern PGDLLIMPORT int autoprewarm_interval;
+
+extern Size AutoPrewarmShmemSize(void);
+extern void AutoPrewarmShmemInit(void);
+extern void AutoPrewarmRegister(void);
+extern bool AutoPrewarmDumpAllowed(void);
+extern void AutoPrewarmDumpBufferMap(void);
+
+extern void AutoPrewarmLeaderMain(Datum main_arg);
+extern void AutoPrewarmDatabaseMain(Datum main_arg);
+
+#endif							/* _AUTOPREWARM_H */
@@ -15,23 +15,53 @@
 #ifndef _BGWRITER_H
 #define _BGWRITER_H
 
+#include "datatype/timestamp.h"
 #include "storage/block.h"
 #include "storage/relfilelocator.h"
 #include "storage/smgr.h"
 #include "storage/sync.h"
 
+struct WritebackContext;
+
+/* Number of per-second samples of write activity kept by the checkpointer */
+#define CHECKPOINTER_NUM_SAMPLES	300
+
+/*
+ * Write activity of the checkpointer and bgwriter over an interval of about
+ * one second, and the state of the sync request queue at its end.  Intervals
+ * in which the checkpointer was asleep can be longer.
+ */
+typedef struct CheckpointerSample
+{
+	TimestampTz sample_time;	/* end of the interval */
+	double		seconds;		/* length of the interval */
+	int64		checkpoint_writes;	/* buffers written by checkpoints */
+	int64		bgwriter_writes;	/* buffers written by the bgwriter */
+	double		write_time;		/* checkpoint write time, in ms */
+	int64		fsyncs;			/* files fsync'd */
+	double		fsync_time;		/* total and longest fsync time, in ms */
+	double		fsync_max_time;
+	int			sync_requests;	/* requests queued for the checkpointer */
+	int			fsyncs_pending; /* fsyncs absorbed but not done yet */
+} CheckpointerSample;
+
 
 /* GUC options */
 extern PGDLLIMPORT int BgWriterDelay;
 extern PGDLLIMPORT int CheckPointTimeout;
 extern PGDLLIMPORT int CheckPointWarning;
 extern PGDLLIMPORT double CheckPointCompletionTarget;
+extern PGDLLIMPORT bool checkpoint_adaptive_pacing;
 
 extern void BackgroundWriterMain(void) pg_attribute_noreturn();
 extern void CheckpointerMain(void) pg_attribute_noreturn();
 
 extern void RequestCheckpoint(int flags);
-extern void CheckpointWriteDelay(int flags, double progress);
+extern void CheckpointWriteDelay(int flags, double progress, bool written,
+								 struct WritebackContext *wb_context);
+extern void CheckpointSyncDelay(double progress, uint64 sync_time);
+extern void CountBgWriterWrites(int num_written);
+extern int	GetCheckpointerSamples(CheckpointerSample *samples);
 
 extern bool ForwardSyncRequest(const FileTag *ftag, SyncRequestType type);
 
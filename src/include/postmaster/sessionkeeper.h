@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ *
+ * sessionkeeper.h
+ *	  Exports from postmaster/sessionkeeper.c.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/postmaster/sessionkeeper.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _SESSIONKEEPER_H
+#define _SESSIONKEEPER_H
+
+#include "libpq/libpq-be.h"
+
+/* GUCs */
+extern PGDLLIMPORT bool session_parking;
+extern PGDLLIMPORT int session_park_timeout;
+
+/* in the postmaster */
+extern void SessionKeeperInit(void);
+extern void SessionKeeperRegister(void);
+extern pgsocket SessionKeeperPostmasterSocket(void);
+extern bool SessionKeeperReceive(pgsocket *sock, char **session,
+								 int *session_len);
+extern void ParkedSessionCancelKey(const char *session, int *pid,
+								   int32 *cancel_key);
+
+/* in backends */
+extern void SessionKeeperCloseKeeperSocket(void);
+extern int	RestoreParkedSession(Port *port);
+extern void RestoreParkedSessionAuthentication(Port *port);
+extern void ParkSessionIfIdle(void);
+
+extern void SessionKeeperMain(Datum main_arg);
+
+#endif							/* _SESSIONKEEPER_H */
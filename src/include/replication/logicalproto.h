@@ -15,6 +15,7 @@
 
 #include "access/xact.h"
 #include "executor/tuptable.h"
+#include "fmgr.h"
 #include "replication/reorderbuffer.h"
 #include "utils/rel.h"
 
@@ -36,13 +37,17 @@
  * LOGICALREP_PROTO_STREAM_PARALLEL_VERSION_NUM is the minimum protocol version
  * where we support applying large streaming transactions in parallel.
  * Introduced in PG16.
+ *
+ * LOGICALREP_PROTO_BATCH_VERSION_NUM is the minimum protocol version with
+ * support for sending consecutive inserts into a table as a single message.
  */
 #define LOGICALREP_PROTO_MIN_VERSION_NUM 1
 #define LOGICALREP_PROTO_VERSION_NUM 1
 #define LOGICALREP_PROTO_STREAM_VERSION_NUM 2
 #define LOGICALREP_PROTO_TWOPHASE_VERSION_NUM 3
 #define LOGICALREP_PROTO_STREAM_PARALLEL_VERSION_NUM 4
-#define LOGICALREP_PROTO_MAX_VERSION_NUM LOGICALREP_PROTO_STREAM_PARALLEL_VERSION_NUM
+#define LOGICALREP_PROTO_BATCH_VERSION_NUM 5
+#define LOGICALREP_PROTO_MAX_VERSION_NUM LOGICALREP_PROTO_BATCH_VERSION_NUM
 
 /*
  * Logical message types
@@ -60,6 +65,7 @@ typedef enum LogicalRepMsgType
 	LOGICAL_REP_MSG_COMMIT = 'C',
 	LOGICAL_REP_MSG_ORIGIN = 'O',
 	LOGICAL_REP_MSG_INSERT = 'I',
+	LOGICAL_REP_MSG_INSERT_BATCH = 'i',
 	LOGICAL_REP_MSG_UPDATE = 'U',
 	LOGICAL_REP_MSG_DELETE = 'D',
 	LOGICAL_REP_MSG_TRUNCATE = 'T',
@@ -100,6 +106,25 @@ typedef struct LogicalRepTupleData
 
 typedef uint32 LogicalRepRelId;
 
+/*
+ * Output functions of the columns of a relation, looked up once for writing
+ * many tuples of it.  format is LOGICALREP_COLUMN_TEXT or
+ * LOGICALREP_COLUMN_BINARY, or '\0' for columns that aren't sent.
+ */
+typedef struct LogicalRepColumnOutput
+{
+	char		format;
+	bool		isvarlena;
+	FmgrInfo	finfo;			/* output or send function */
+} LogicalRepColumnOutput;
+
+typedef struct LogicalRepTupleOutput
+{
+	int			natts;			/* number of attributes of the relation */
+	uint16		nliveatts;		/* number of columns sent */
+	LogicalRepColumnOutput *columns;	/* one per attribute */
+} LogicalRepTupleOutput;
+
 /* Relation information */
 typedef struct LogicalRepRelation
 {
@@ -227,6 +252,18 @@ extern void logicalrep_write_insert(StringInfo out, TransactionId xid,
 									TupleTableSlot *newslot,
 									bool binary, Bitmapset *columns);
 extern LogicalRepRelId logicalrep_read_insert(StringInfo in, LogicalRepTupleData *newtup);
+extern LogicalRepTupleOutput *logicalrep_tuple_output_init(Relation rel,
+														   bool binary,
+														   Bitmapset *columns);
+extern void logicalrep_write_batch_tuple(StringInfo out,
+										 TupleTableSlot *slot,
+										 LogicalRepTupleOutput *output);
+extern void logicalrep_write_insert_batch(StringInfo out, TransactionId xid,
+										  Oid relid, int nrows,
+										  StringInfo rows);
+extern LogicalRepRelId logicalrep_read_insert_batch(StringInfo in, int *nrows);
+extern void logicalrep_read_batch_tuple(StringInfo in,
+										LogicalRepTupleData *tuple);
 extern void logicalrep_write_update(StringInfo out, TransactionId xid,
 									Relation rel,
 									TupleTableSlot *oldslot,
@@ -16,6 +16,11 @@
 
 extern PGDLLIMPORT volatile sig_atomic_t ParallelApplyMessagePending;
 
+/* GUC parameter */
+extern PGDLLIMPORT bool parallel_apply_non_streamed;
+extern PGDLLIMPORT int max_sync_copy_streams_per_table;
+extern PGDLLIMPORT bool logical_replication_row_batches;
+
 extern void ApplyWorkerMain(Datum main_arg);
 extern void ParallelApplyWorkerMain(Datum main_arg);
 
@@ -13,6 +13,7 @@
 #ifndef PGOUTPUT_H
 #define PGOUTPUT_H
 
+#include "lib/stringinfo.h"
 #include "nodes/pg_list.h"
 
 typedef struct PGOutputData
@@ -30,6 +31,13 @@ typedef struct PGOutputData
 	bool		messages;
 	bool		two_phase;
 	char	   *origin;
+	bool		row_batches;
+
+	/* INSERTs collected for an INSERT BATCH message, see pgoutput_change */
+	StringInfo	batch;			/* the rows written so far */
+	int			batch_nrows;
+	Oid			batch_relid;
+	TransactionId batch_xid;
 } PGOutputData;
 
 #endif							/* PGOUTPUT_H */
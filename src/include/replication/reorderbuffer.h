@@ -20,6 +20,7 @@
 /* GUC variables */
 extern PGDLLIMPORT int logical_decoding_work_mem;
 extern PGDLLIMPORT int debug_logical_replication_streaming;
+extern PGDLLIMPORT int logical_decoding_spill_compression;
 
 /* possible values for debug_logical_replication_streaming */
 typedef enum
@@ -647,6 +648,15 @@ struct ReorderBuffer /// 这是一个重要的数据结构
 	char	   *outbuf;
 	Size		outbufsize;
 
+	/* block of serialized changes not yet written to the spill file */
+	char	   *spillbuf;
+	Size		spillbufsize;
+	Size		spilllen;
+
+	/* buffer for compressing and decompressing spill file blocks */
+	char	   *compressbuf;
+	Size		compressbufsize;
+
 	/* memory accounting */
 	Size		size;
 
@@ -673,6 +683,9 @@ struct ReorderBuffer /// 这是一个重要的数据结构
 	 */
 	int64		totalTxns;		/* total number of transactions sent */
 	int64		totalBytes;		/* total amount of data decoded */
+
+	/* Time spent building historic catalog snapshots, in microseconds */
+	int64		snapBuildTime;
 };
 
 
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * shareddecoding.h
+ *	  Sharing the output of logical decoding between WAL senders.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/replication/shareddecoding.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDDECODING_H
+#define SHAREDDECODING_H
+
+#include "replication/logical.h"
+
+/* GUC variable */
+extern PGDLLIMPORT bool logical_decoding_shared;
+
+extern Size SharedDecodingShmemSize(void);
+extern void SharedDecodingShmemInit(void);
+
+extern void SharedDecodingStart(LogicalDecodingContext *ctx, List *options);
+extern void SharedDecodingStop(void);
+
+/* used by the WAL sender decoding for its group */
+extern void SharedDecodingBeginRecord(void);
+extern void SharedDecodingEndRecord(LogicalDecodingContext *ctx);
+extern void SharedDecodingForward(const char *data, Size len);
+
+/* used by the WAL senders forwarding the leader's output */
+extern bool SharedDecodingIsFollower(void);
+extern bool SharedDecodingReceive(char **data, Size *len, XLogRecPtr *upto);
+extern void SharedDecodingAdvanceSlot(void);
+
+#endif							/* SHAREDDECODING_H */
@@ -30,6 +30,7 @@
 extern PGDLLIMPORT int wal_receiver_status_interval;
 extern PGDLLIMPORT int wal_receiver_timeout;
 extern PGDLLIMPORT bool hot_standby_feedback;
+extern PGDLLIMPORT int wal_receiver_compression;
 
 /*
  * MAXCONNINFO: maximum size of a connection string.
@@ -187,6 +188,8 @@ typedef struct
 									 * prepare time */
 			char	   *origin; /* Only publish data originating from the
 								 * specified origin */
+			bool		row_batches;	/* Send inserts in INSERT BATCH
+										 * messages */
 		}			logical;
 	}			proto;
 } WalRcvStreamOptions;
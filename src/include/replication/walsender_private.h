@@ -16,6 +16,7 @@
 #include "lib/ilist.h"
 #include "nodes/nodes.h"
 #include "nodes/replnodes.h"
+#include "port/atomics.h"
 #include "replication/syncrep.h"
 #include "storage/condition_variable.h"
 #include "storage/latch.h"
@@ -97,10 +98,12 @@ typedef struct
 	dlist_head	SyncRepQueue[NUM_SYNC_REP_WAIT_MODE];
 
 	/*
-	 * Current location of the head of the queue. All waiters should have a
-	 * waitLSN that follows this value. Protected by SyncRepLock.
+	 * Current location of the head of the queue, i.e. the position waiters
+	 * have been released up to. All waiters should have a waitLSN that
+	 * follows this value. Only advanced while holding SyncRepLock, but may
+	 * be read without it; it never goes backwards.
 	 */
-	XLogRecPtr	lsn[NUM_SYNC_REP_WAIT_MODE]; // NUM_SYNC_REP_WAIT_MODE的值是3
+	pg_atomic_uint64 lsn[NUM_SYNC_REP_WAIT_MODE]; // NUM_SYNC_REP_WAIT_MODE的值是3
 
 	/*
 	 * Are any sync standbys defined?  Waiting backends can't reload the
@@ -170,6 +170,13 @@ typedef struct ParallelApplyWorkerShared
 	 */
 	PartialFileSetState fileset_state;
 	FileSet		fileset;
+
+	/*
+	 * Set by the leader apply worker while it waits for an earlier
+	 * non-streamed transaction to finish in the middle of sending the changes
+	 * of the one this worker applies.  See pa_wait_for_committed_xact().
+	 */
+	bool		leader_waiting;
 } ParallelApplyWorkerShared;
 
 /*
@@ -305,6 +312,15 @@ extern void pa_decr_and_wait_stream_block(void);
 extern void pa_xact_finish(ParallelApplyWorkerInfo *winfo,
 						   XLogRecPtr remote_lsn);
 
+/* Parallel apply of non-streamed transactions */
+extern bool pa_begin_committed_xact(TransactionId xid, StringInfo s);
+extern void pa_send_committed_change(LogicalRepMsgType action, StringInfo s);
+extern void pa_commit_committed_xact(XLogRecPtr end_lsn, StringInfo s);
+extern ParallelApplyWorkerInfo *pa_committed_xact_worker(void);
+extern bool pa_committed_xacts_pending(void);
+extern void pa_process_committed_xacts(void);
+extern void pa_wait_for_committed_xacts(void);
+
 #define isParallelApplyWorker(worker) ((worker)->leader_pid != InvalidPid) // 如果领头的pid, leader_pid是0，就是并发进程， InvalidPid的值是-1
 
 static inline bool
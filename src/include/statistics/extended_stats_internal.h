@@ -82,6 +82,11 @@ extern MCVList *statext_mcv_build(StatsBuildData *data,
 extern bytea *statext_mcv_serialize(MCVList *mcvlist, VacAttrStats **stats);
 extern MCVList *statext_mcv_deserialize(bytea *data);
 
+extern MVSketch *statext_sketch_build(Relation onerel, bool inh,
+									  StatsBuildData *data, List *exprs);
+extern bytea *statext_sketch_serialize(MVSketch *sketch);
+extern MVSketch *statext_sketch_deserialize(bytea *data);
+
 extern MultiSortSupport multi_sort_init(int ndims);
 extern void multi_sort_add_dimension(MultiSortSupport mss, int sortdim,
 									 Oid oper, Oid collation);
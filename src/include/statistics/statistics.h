@@ -94,9 +94,34 @@ typedef struct MCVList
 	MCVItem		items[FLEXIBLE_ARRAY_MEMBER];	/* array of MCV items */
 } MCVList;
 
+/* join cardinality sketches */
+#define STATS_SKETCH_MAGIC		0x5C3E7C11	/* marks serialized bytea */
+#define STATS_SKETCH_TYPE_BASIC	1	/* basic sketch type */
+
+/* register width of the HyperLogLog estimator, for 4096 registers */
+#define STATS_SKETCH_BWIDTH		12
+
+/*
+ * A HyperLogLog estimator over the hashes of the values of a single column
+ * or expression, made with the given hash opfamily and collation.
+ */
+typedef struct MVSketch
+{
+	uint32		magic;			/* magic constant marker */
+	uint32		type;			/* type of sketch (BASIC) */
+	Oid			opfamily;		/* hash opfamily of the hash function */
+	Oid			collation;		/* collation passed to the hash function */
+	uint8		bwidth;			/* register width, in bits */
+	uint8		registers[FLEXIBLE_ARRAY_MEMBER];	/* 2^bwidth registers */
+} MVSketch;
+
+/* avoid including selfuncs.h here */
+struct VariableStatData;
+
 extern MVNDistinct *statext_ndistinct_load(Oid mvoid, bool inh);
 extern MVDependencies *statext_dependencies_load(Oid mvoid, bool inh);
 extern MCVList *statext_mcv_load(Oid mvoid, bool inh);
+extern MVSketch *statext_sketch_load(Oid mvoid, bool inh);
 
 extern void BuildRelationExtStatistics(Relation onerel, bool inh, double totalrows,
 									   int numrows, HeapTuple *rows,
@@ -126,5 +151,10 @@ extern StatisticExtInfo *choose_best_statistics(List *stats, char requiredkind,
 												List **clause_exprs,
 												int nclauses);
 extern HeapTuple statext_expressions_load(Oid stxoid, bool inh, int idx);
+extern bool statext_sketch_containment(PlannerInfo *root,
+									   struct VariableStatData *vardata1,
+									   struct VariableStatData *vardata2,
+									   Oid operator, Oid collation,
+									   double *containment);
 
 #endif							/* STATISTICS_H */
@@ -0,0 +1,100 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Asynchronous I/O on data files
+ *
+ * See src/backend/storage/aio/aio.c for an overview.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+#include "port/pg_iovec.h"
+#include "storage/buf.h"
+
+/* I/O methods. */
+#define IOMETHOD_SYNC			0
+#define IOMETHOD_IO_URING		1
+
+/*
+ * io_uring is used through its system calls directly, so all that's needed
+ * is the kernel's header.  It relies on child processes inheriting the rings
+ * created by the postmaster, so it isn't available with EXEC_BACKEND.
+ */
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H) && !defined(EXEC_BACKEND)
+#define USE_IO_URING
+#endif
+
+#define DEFAULT_IO_METHOD		IOMETHOD_SYNC
+
+/* GUCs */
+extern PGDLLIMPORT int io_method;
+extern PGDLLIMPORT int io_max_concurrency;
+
+/* Operations a handle can perform. */
+typedef enum PgAioOp
+{
+	PGAIO_OP_INVALID = 0,
+	PGAIO_OP_READV,
+	PGAIO_OP_WRITEV
+} PgAioOp;
+
+/*
+ * Completion callbacks.  These run in whichever process happens to reap the
+ * I/O, which needn't be the one that started it, so they're identified by
+ * number rather than by function pointer, and may only touch shared state.
+ * They must not throw errors.
+ */
+typedef enum PgAioCallbackID
+{
+	PGAIO_CB_NONE = 0,
+	PGAIO_CB_SHARED_BUFFER_READV
+} PgAioCallbackID;
+
+typedef struct PgAioHandle PgAioHandle;
+
+/*
+ * A reference to an I/O that survives the handle being recycled, for
+ * waiting on it.
+ */
+typedef struct PgAioWaitRef
+{
+	int			aio_index;		/* index of the handle, or -1 */
+	uint64		generation;		/* generation of the I/O we're waiting for */
+} PgAioWaitRef;
+
+/* aio.c */
+extern Size AioShmemSize(void);
+extern void AioShmemInit(void);
+extern void pgaio_init_backend(void);
+extern void pgaio_at_abort(void);
+
+extern bool pgaio_enabled(void);
+extern PgAioHandle *pgaio_io_acquire(void);
+extern void pgaio_io_release(PgAioHandle *ioh);
+extern int	pgaio_io_get_index(PgAioHandle *ioh);
+extern void pgaio_io_get_wref(PgAioHandle *ioh, PgAioWaitRef *wref);
+extern void pgaio_io_set_callback(PgAioHandle *ioh, PgAioCallbackID cb);
+extern void pgaio_io_set_buffers(PgAioHandle *ioh, const Buffer *buffers,
+								 int nbuffers);
+extern int	pgaio_io_get_buffers(PgAioHandle *ioh, Buffer **buffers);
+extern void pgaio_io_start_readv(PgAioHandle *ioh, int fd,
+								 const struct iovec *iov, int iovcnt,
+								 off_t offset);
+extern void pgaio_io_start_writev(PgAioHandle *ioh, int fd,
+								  const struct iovec *iov, int iovcnt,
+								  off_t offset);
+extern int	pgaio_io_get_result(PgAioHandle *ioh);
+
+extern bool pgaio_wref_check_done(PgAioWaitRef *wref);
+extern void pgaio_wref_wait(PgAioWaitRef *wref);
+extern void pgaio_wait_index(int aio_index);
+extern void pgaio_wait_all(void);
+
+#endif							/* AIO_H */
@@ -198,9 +198,9 @@ BufMappingPartitionLockByIndex(uint32 index)
  *	BufferDesc -- shared descriptor/state data for a single shared buffer.
  *
  * Note: Buffer header lock (BM_LOCKED flag) must be held to examine or change
- * tag, state or wait_backend_pgprocno fields.  In general, buffer header lock
- * is a spinlock which is combined with flags, refcount and usagecount into
- * single atomic variable.  This layout allow us to do some operations in a
+ * tag, state, wait_backend_pgprocno or io_handle fields.  In general, buffer
+ * header lock is a spinlock which is combined with flags, refcount and
+ * usagecount into single atomic variable.  This layout allow us to do some operations in a
  * single atomic operation, without actually acquiring and releasing spinlock;
  * for instance, increase or decrease refcount.  buf_id field never changes
  * after initialization, so does not need locking.  freeNext is protected by
@@ -251,6 +251,7 @@ typedef struct BufferDesc
 
 	int			wait_backend_pgprocno;	/* backend of pin-count waiter */
 	int			freeNext;		/* link in freelist chain */
+	int			io_handle;		/* AIO handle of read in progress, or -1 */
 	LWLock		content_lock;	/* to lock access to buffer contents */ // 每一个页面都有一个LWLock
 } BufferDesc;
 
@@ -400,7 +401,9 @@ extern void StrategyFreeBuffer(BufferDesc *buf);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 								 BufferDesc *buf, bool from_ring);
 
-extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
+extern int	StrategySyncPartitions(void);
+extern int	StrategySyncStart(int partno, int *first_buffer, int *num_buffers,
+							  uint32 *complete_passes, uint32 *num_buf_alloc);
 extern void StrategyNotifyBgWriter(int bgwprocno);
 
 extern Size StrategyShmemSize(void);
@@ -412,9 +415,18 @@ extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupLockless(BufferTag *tagPtr, uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
+/* buf_relindex.c */
+extern Size BufRelIndexShmemSize(void);
+extern void InitBufRelIndex(void);
+extern void BufRelIndexAdd(int buf_id, const BufferTag *tagPtr);
+extern void BufRelIndexRemove(int buf_id, const BufferTag *tagPtr);
+extern int	BufRelIndexCollect(const RelFileLocator *rlocator, int **buffers);
+extern int	BufRelIndexCollectDatabase(Oid dbid, int **buffers);
+
 /* localbuf.c */
 extern bool PinLocalBuffer(BufferDesc *buf_hdr, bool adjust_usagecount);
 extern void UnpinLocalBuffer(Buffer buffer);
@@ -423,6 +435,7 @@ extern PrefetchBufferResult PrefetchLocalBuffer(SMgrRelation smgr,
 												BlockNumber blockNum);
 extern BufferDesc *LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 									BlockNumber blockNum, bool *foundPtr);
+extern void LimitAdditionalLocalPins(uint32 *additional_pins);
 extern BlockNumber ExtendBufferedRelLocal(BufferManagerRelation bmr,
 										  ForkNumber fork,
 										  uint32 flags,
@@ -32,11 +32,15 @@
 
 typedef struct BufFile BufFile;
 
+/* GUC parameter */
+extern PGDLLIMPORT int temp_file_compression;
+
 /*
  * prototypes for functions in buffile.c
  */
 
 extern BufFile *BufFileCreateTemp(bool interXact);
+extern BufFile *BufFileCreateCompressedTemp(bool interXact, int method);
 extern void BufFileClose(BufFile *file);
 extern pg_nodiscard size_t BufFileRead(BufFile *file, void *ptr, size_t size);
 extern void BufFileReadExact(BufFile *file, void *ptr, size_t size);
@@ -52,6 +56,10 @@ extern BufFile *BufFileCreateFileSet(FileSet *fileset, const char *name);
 extern void BufFileExportFileSet(BufFile *file);
 extern BufFile *BufFileOpenFileSet(FileSet *fileset, const char *name,
 								   int mode, bool missing_ok);
+extern BufFile *BufFileCreateCompressedFileSet(FileSet *fileset,
+											   const char *name, int method);
+extern BufFile *BufFileOpenCompressedFileSet(FileSet *fileset,
+											 const char *name, int method);
 extern void BufFileDeleteFileSet(FileSet *fileset, const char *name,
 								 bool missing_ok);
 extern void BufFileTruncateFileSet(BufFile *file, int fileno, off_t offset);
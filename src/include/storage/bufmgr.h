@@ -14,6 +14,8 @@
 #ifndef BUFMGR_H
 #define BUFMGR_H
 
+#include "port/pg_iovec.h"
+#include "storage/aio.h"
 #include "storage/block.h"
 #include "storage/buf.h"
 #include "storage/bufpage.h"
@@ -106,6 +108,30 @@ typedef struct BufferManagerRelation
 #define BMR_REL(p_rel) ((BufferManagerRelation){.rel = p_rel})
 #define BMR_SMGR(p_smgr, p_relpersistence) ((BufferManagerRelation){.smgr = p_smgr, .relpersistence = p_relpersistence})
 
+/* Flags for StartReadBuffers() */
+#define READ_BUFFERS_ISSUE_ADVICE (1 << 0)	/* advise the kernel, for sync I/O */
+
+/*
+ * State of a read begun with StartReadBuffers(), to be finished with
+ * WaitReadBuffers().  The caller sets the first group of members; either
+ * smgr and persistence, or rel, from which they're then filled in.
+ */
+typedef struct ReadBuffersOperation
+{
+	Relation	rel;			/* optional, for pgstat counters */
+	struct SMgrRelationData *smgr;
+	char		persistence;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+
+	/* private to bufmgr.c */
+	Buffer	   *buffers;
+	BlockNumber blocknum;
+	int			flags;
+	int			nblocks;
+	PgAioWaitRef io_wref;		/* asynchronous read, if any */
+} ReadBuffersOperation;
+
 
 /* forward declared, to avoid having to expose buf_internals.h here */
 struct WritebackContext;
@@ -133,6 +159,11 @@ extern PGDLLIMPORT bool track_io_timing;
 extern PGDLLIMPORT int effective_io_concurrency;
 extern PGDLLIMPORT int maintenance_io_concurrency;
 
+/* limits for io_combine_limit, in blocks */
+#define MAX_IO_COMBINE_LIMIT PG_IOV_MAX
+#define DEFAULT_IO_COMBINE_LIMIT Min(MAX_IO_COMBINE_LIMIT, (128 * 1024) / BLCKSZ)
+extern PGDLLIMPORT int io_combine_limit;
+
 extern PGDLLIMPORT int checkpoint_flush_after;
 extern PGDLLIMPORT int backend_flush_after;
 extern PGDLLIMPORT int bgwriter_flush_after;
@@ -162,6 +193,9 @@ extern PGDLLIMPORT int32 *LocalRefCount;
 /*
  * prototypes for functions in bufmgr.c
  */
+extern Buffer PeekSharedBuffer(struct SMgrRelationData *smgr_reln,
+							   ForkNumber forkNum,
+							   BlockNumber blockNum);
 extern PrefetchBufferResult PrefetchSharedBuffer(struct SMgrRelationData *smgr_reln,
 												 ForkNumber forkNum,
 												 BlockNumber blockNum);
@@ -173,6 +207,11 @@ extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 								 BlockNumber blockNum, ReadBufferMode mode,
 								 BufferAccessStrategy strategy);
+extern bool StartReadBuffers(ReadBuffersOperation *operation,
+							 Buffer *buffers, BlockNumber blocknum,
+							 int *nblocks, int flags);
+extern void WaitReadBuffers(ReadBuffersOperation *operation);
+extern void shared_buffer_readv_complete(PgAioHandle *ioh);
 extern Buffer ReadBufferWithoutRelcache(RelFileLocator rlocator,
 										ForkNumber forkNum, BlockNumber blockNum,
 										ReadBufferMode mode, BufferAccessStrategy strategy,
@@ -180,13 +180,20 @@ typedef PageHeaderData *PageHeader;
  * PD_PAGE_FULL is set if an UPDATE doesn't find enough free space in the
  * page for its new tuple version; this suggests that a prune is needed.
  * Again, this is just a hint.
+ *
+ * PD_NEEDS_DEFRAG is set when items were removed from the page without
+ * reclaiming their storage, because that would have meant moving tuples
+ * while other backends might have the page pinned.  PageRepairFragmentation
+ * clears it.  Unlike the above, this is WAL-logged.
  */
 #define PD_HAS_FREE_LINES	0x0001	/* are there any unused line pointers? */
 #define PD_PAGE_FULL		0x0002	/* not enough free space for new tuple? */
 #define PD_ALL_VISIBLE		0x0004	/* all tuples on page are visible to
 									 * everyone */
+#define PD_NEEDS_DEFRAG		0x0008	/* storage of removed items not yet
+									 * reclaimed? */
 
-#define PD_VALID_FLAG_BITS	0x0007	/* OR of all valid pd_flags bits */
+#define PD_VALID_FLAG_BITS	0x000F	/* OR of all valid pd_flags bits */
 
 /*
  * Page layout version number 0 is for pre-7.3 Postgres releases.
@@ -439,6 +446,22 @@ PageClearAllVisible(Page page)
 	((PageHeader) page)->pd_flags &= ~PD_ALL_VISIBLE;
 }
 
+static inline bool
+PageNeedsDefrag(Page page)
+{
+	return ((PageHeader) page)->pd_flags & PD_NEEDS_DEFRAG;
+}
+static inline void
+PageSetNeedsDefrag(Page page)
+{
+	((PageHeader) page)->pd_flags |= PD_NEEDS_DEFRAG;
+}
+static inline void
+PageClearNeedsDefrag(Page page)
+{
+	((PageHeader) page)->pd_flags &= ~PD_NEEDS_DEFRAG;
+}
+
 /*
  * These two require "access/transam.h", so left as macros.
  */
@@ -18,6 +18,7 @@
 typedef struct dsm_segment dsm_segment;
 
 #define DSM_CREATE_NULL_IF_MAXSEGMENTS			0x0001
+#define DSM_CREATE_CACHED						0x0002
 
 /* Startup and shutdown functions. */
 struct PGShmemHeader;			/* avoid including pg_shmem.h */
@@ -49,6 +50,7 @@ extern dsm_segment *dsm_find_mapping(dsm_handle handle);
 extern void *dsm_segment_address(dsm_segment *seg);
 extern Size dsm_segment_map_length(dsm_segment *seg);
 extern dsm_handle dsm_segment_handle(dsm_segment *seg);
+extern void dsm_cache_stats(uint64 *hits, uint64 *misses);
 
 /* Cleanup hooks. */
 typedef void (*on_dsm_detach_callback) (dsm_segment *, Datum arg);
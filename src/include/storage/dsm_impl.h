@@ -41,6 +41,7 @@
 /* GUC. */
 extern PGDLLIMPORT int dynamic_shared_memory_type;
 extern PGDLLIMPORT int min_dynamic_shared_memory;
+extern PGDLLIMPORT int dynamic_shared_memory_cache_size;
 
 /*
  * Directory for on-disk state.
@@ -46,6 +46,9 @@
 #include <dirent.h>
 #include <fcntl.h>
 
+#include "port/pg_iovec.h"
+#include "storage/aio.h"
+
 typedef enum RecoveryInitSyncMethod
 {
 	RECOVERY_INIT_SYNC_METHOD_FSYNC,
@@ -54,6 +57,20 @@ typedef enum RecoveryInitSyncMethod
 
 typedef int File;
 
+/*
+ * A plan node, or anything else, that temporary files created while it is
+ * CurrentTempFileOwner are charged to.  The usage of each owner is shown in
+ * pg_stat_progress_temp_files, and is subject to node_temp_file_limit.
+ * 'slot' and 'generation' are private to fd.c.
+ */
+typedef struct TempFileOwner
+{
+	int			plan_node_id;
+	const char *node_type;
+	int			slot;
+	uint32		generation;
+} TempFileOwner;
+
 
 #define IO_DIRECT_DATA			0x01
 #define IO_DIRECT_WAL			0x02
@@ -66,6 +83,8 @@ extern PGDLLIMPORT bool data_sync_retry;
 extern PGDLLIMPORT int recovery_init_sync_method;
 extern PGDLLIMPORT int io_direct_flags;
 
+extern PGDLLIMPORT TempFileOwner *CurrentTempFileOwner;
+
 /*
  * This is private to fd.c, but exported for save/restore_backend_variables()
  */
@@ -111,8 +130,10 @@ extern File PathNameOpenFilePerm(const char *fileName, int fileFlags, mode_t fil
 extern File OpenTemporaryFile(bool interXact);
 extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, off_t amount, uint32 wait_event_info);
-extern int	FileRead(File file, void *buffer, size_t amount, off_t offset, uint32 wait_event_info);
-extern int	FileWrite(File file, const void *buffer, size_t amount, off_t offset, uint32 wait_event_info);
+extern int	FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset, uint32 wait_event_info);
+extern int	FileStartReadV(PgAioHandle *ioh, File file, const struct iovec *iov, int iovcnt, off_t offset);
+extern int	FileWriteV(File file, const struct iovec *iov, int iovcnt, off_t offset, uint32 wait_event_info);
+extern int	FileStartWriteV(PgAioHandle *ioh, File file, const struct iovec *iov, int iovcnt, off_t offset);
 extern int	FileSync(File file, uint32 wait_event_info);
 extern int	FileZero(File file, off_t offset, off_t amount, uint32 wait_event_info);
 extern int	FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info);
@@ -133,6 +154,13 @@ extern void PathNameCreateTemporaryDir(const char *basedir, const char *director
 extern void PathNameDeleteTemporaryDir(const char *dirname);
 extern void TempTablespacePath(char *path, Oid tablespace);
 
+/* Charging temporary files to their owner */
+extern void InitTempFileOwner(TempFileOwner *owner, int plan_node_id,
+							  const char *node_type);
+extern void ReleaseTempFileOwner(TempFileOwner *owner);
+extern bool GetTempFileOwnerUsage(TempFileOwner *owner, int *files,
+								  int64 *bytes_written, int64 *peak_size);
+
 /* Operations that allow use of regular stdio --- USE WITH CAUTION */
 extern FILE *AllocateFile(const char *name, const char *mode);
 extern int	FreeFile(FILE *file);
@@ -199,4 +227,30 @@ extern int	data_sync_elevel(int elevel);
 #define PG_TEMP_FILES_DIR "pgsql_tmp"
 #define PG_TEMP_FILE_PREFIX "pgsql_tmp"
 
+/* Single-buffer variant of FileReadV() */
+static inline int
+FileRead(File file, void *buffer, size_t amount, off_t offset,
+		 uint32 wait_event_info)
+{
+	struct iovec iov = {
+		.iov_base = buffer,
+		.iov_len = amount
+	};
+
+	return FileReadV(file, &iov, 1, offset, wait_event_info);
+}
+
+/* Single-buffer variant of FileWriteV() */
+static inline int
+FileWrite(File file, const void *buffer, size_t amount, off_t offset,
+		  uint32 wait_event_info)
+{
+	struct iovec iov = {
+		.iov_base = unconstify(void *, buffer),
+		.iov_len = amount
+	};
+
+	return FileWriteV(file, &iov, 1, offset, wait_event_info);
+}
+
 #endif							/* FD_H */
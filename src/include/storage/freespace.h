@@ -20,13 +20,19 @@
 
 /* prototypes for public functions in freespace.c */
 extern Size GetRecordedFreeSpace(Relation rel, BlockNumber heapBlk);
+extern PGDLLIMPORT bool fsm_spread_inserts;
+
 extern BlockNumber GetPageWithFreeSpace(Relation rel, Size spaceNeeded);
+extern int	GetPagesWithFreeSpace(Relation rel, Size spaceNeeded,
+								  BlockNumber *pages, int npages);
 extern BlockNumber RecordAndGetPageWithFreeSpace(Relation rel,
 												 BlockNumber oldPage,
 												 Size oldSpaceAvail,
 												 Size spaceNeeded);
 extern void RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk,
 									Size spaceAvail);
+extern void RecordRangeWithFreeSpace(Relation rel, BlockNumber startBlk,
+									 BlockNumber endBlk, Size spaceAvail);
 extern void XLogRecordPageWithFreeSpace(RelFileLocator rlocator, BlockNumber heapBlk,
 										Size spaceAvail);
 
@@ -36,4 +42,7 @@ extern void FreeSpaceMapVacuum(Relation rel);
 extern void FreeSpaceMapVacuumRange(Relation rel, BlockNumber start,
 									BlockNumber end);
 
+extern Size FreeSpaceMapShmemSize(void);
+extern void FreeSpaceMapShmemInit(void);
+
 #endif							/* FREESPACE_H_ */
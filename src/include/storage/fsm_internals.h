@@ -62,7 +62,9 @@ typedef FSMPageData *FSMPage;
 
 /* Prototypes for functions in fsmpage.c */
 extern int	fsm_search_avail(Buffer buf, uint8 minvalue, bool advancenext,
-							 bool exclusive_lock_held);
+							 bool exclusive_lock_held, bool spread);
+extern int	fsm_search_avail_slots(Buffer buf, uint8 minvalue, bool spread,
+								   uint16 *slots, int maxslots);
 extern uint8 fsm_get_avail(Page page, int slot);
 extern uint8 fsm_get_max_avail(Page page);
 extern bool fsm_set_avail(Page page, int slot, uint8 value);
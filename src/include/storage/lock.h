@@ -30,6 +30,7 @@ typedef struct PGPROC PGPROC;
 
 /* GUC variables */
 extern PGDLLIMPORT int max_locks_per_xact;
+extern PGDLLIMPORT int lock_partitions;
 
 #ifdef LOCK_DEBUG
 extern PGDLLIMPORT int Trace_lock_oidmin;
@@ -523,7 +524,7 @@ typedef enum
  * NB: NUM_LOCK_PARTITIONS must be a power of 2!
  */
 #define LockHashPartition(hashcode) \
-	((hashcode) % NUM_LOCK_PARTITIONS)
+	((hashcode) & (NUM_LOCK_PARTITIONS - 1))
 #define LockHashPartitionLock(hashcode) \
 	(&MainLWLockArray[LOCK_MANAGER_LWLOCK_OFFSET + \
 		LockHashPartition(hashcode)].lock)
@@ -545,6 +546,7 @@ typedef enum
 /*
  * function prototypes
  */
+extern void InitializeLockPartitions(void);
 extern void InitLocks(void);
 extern LockMethod GetLocksMethodTable(const LOCK *lock);
 extern LockMethod GetLockTagsMethodTable(const LOCKTAG *locktag);
@@ -566,6 +568,7 @@ extern bool LockRelease(const LOCKTAG *locktag,
 						LOCKMODE lockmode, bool sessionLock);
 extern void LockReleaseAll(LOCKMETHODID lockmethodid, bool allLocks);
 extern void LockReleaseSession(LOCKMETHODID lockmethodid);
+extern bool AnyLocksHeld(void);
 extern void LockReleaseCurrentOwner(LOCALLOCK **locallocks, int nlocks);
 extern void LockReassignCurrentOwner(LOCALLOCK **locallocks, int nlocks);
 extern bool LockHeldByMe(const LOCKTAG *locktag, LOCKMODE lockmode);
@@ -601,6 +604,8 @@ extern void lock_twophase_standby_recover(TransactionId xid, uint16 info,
 										  void *recdata, uint32 len);
 
 extern DeadLockState DeadLockCheck(PGPROC *proc);
+extern bool DeadLockCheckQuick(PGPROC *proc, uint32 hashcode,
+							   DeadLockState *state);
 extern PGPROC *GetBlockingAutoVacuumPgproc(void);
 extern void DeadLockReport(void) pg_attribute_noreturn();
 extern void RememberSimpleDeadLock(PGPROC *proc1,
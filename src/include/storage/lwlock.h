@@ -95,22 +95,35 @@ extern PGDLLIMPORT int NamedLWLockTrancheRequests;
 /* Number of partitions of the shared buffer mapping hashtable */
 #define NUM_BUFFER_PARTITIONS  128
 
-/* Number of partitions the shared lock tables are divided into */
-#define LOG2_NUM_LOCK_PARTITIONS  4
-#define NUM_LOCK_PARTITIONS  (1 << LOG2_NUM_LOCK_PARTITIONS)
+/*
+ * Number of partitions the shared lock tables are divided into.  It is a
+ * power of 2 chosen at postmaster start, from lock_partitions or the number
+ * of CPUs; see InitializeLockPartitions().  The maximum keeps the code that
+ * locks all partitions at once well below MAX_SIMUL_LWLOCKS.
+ */
+extern PGDLLIMPORT int NumLockPartitions;
+extern PGDLLIMPORT int Log2NumLockPartitions;
+
+#define LOG2_NUM_LOCK_PARTITIONS  Log2NumLockPartitions
+#define NUM_LOCK_PARTITIONS  NumLockPartitions
+#define MIN_LOCK_PARTITIONS  16
+#define MAX_LOCK_PARTITIONS  128
 
 /* Number of partitions the shared predicate lock tables are divided into */
 #define LOG2_NUM_PREDICATELOCK_PARTITIONS  4
 #define NUM_PREDICATELOCK_PARTITIONS  (1 << LOG2_NUM_PREDICATELOCK_PARTITIONS)
 
-/* Offsets for various chunks of preallocated lwlocks. */
+/*
+ * Offsets for various chunks of preallocated lwlocks.  The lock manager's
+ * come last, since their number is only known at run time.
+ */
 #define BUFFER_MAPPING_LWLOCK_OFFSET	NUM_INDIVIDUAL_LWLOCKS
-#define LOCK_MANAGER_LWLOCK_OFFSET		\
-	(BUFFER_MAPPING_LWLOCK_OFFSET + NUM_BUFFER_PARTITIONS)
 #define PREDICATELOCK_MANAGER_LWLOCK_OFFSET \
-	(LOCK_MANAGER_LWLOCK_OFFSET + NUM_LOCK_PARTITIONS)
-#define NUM_FIXED_LWLOCKS \
+	(BUFFER_MAPPING_LWLOCK_OFFSET + NUM_BUFFER_PARTITIONS)
+#define LOCK_MANAGER_LWLOCK_OFFSET		\
 	(PREDICATELOCK_MANAGER_LWLOCK_OFFSET + NUM_PREDICATELOCK_PARTITIONS)
+#define NUM_FIXED_LWLOCKS \
+	(LOCK_MANAGER_LWLOCK_OFFSET + NUM_LOCK_PARTITIONS)
 
 typedef enum LWLockMode
 {
@@ -126,21 +139,26 @@ typedef enum LWLockMode
 extern PGDLLIMPORT bool Trace_lwlocks;
 #endif
 
+extern PGDLLIMPORT bool lwlock_profiling;
+
 extern bool LWLockAcquire(LWLock *lock, LWLockMode mode);
 extern bool LWLockConditionalAcquire(LWLock *lock, LWLockMode mode);
 extern bool LWLockAcquireOrWait(LWLock *lock, LWLockMode mode);
 extern void LWLockRelease(LWLock *lock);
-extern void LWLockReleaseClearVar(LWLock *lock, uint64 *valptr, uint64 val);
+extern void LWLockReleaseClearVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 val);
 extern void LWLockReleaseAll(void);
 extern bool LWLockHeldByMe(LWLock *lock);
 extern bool LWLockAnyHeldByMe(LWLock *lock, int nlocks, size_t stride);
 extern bool LWLockHeldByMeInMode(LWLock *lock, LWLockMode mode);
 
-extern bool LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval);
-extern void LWLockUpdateVar(LWLock *lock, uint64 *valptr, uint64 val);
+extern bool LWLockWaitForVar(LWLock *lock, pg_atomic_uint64 *valptr,
+							 uint64 oldval, uint64 *newval);
+extern void LWLockUpdateVar(LWLock *lock, pg_atomic_uint64 *valptr, uint64 val);
 
 extern Size LWLockShmemSize(void);
 extern void CreateLWLocks(void);
+extern Size LWLockProfileShmemSize(void);
+extern void LWLockProfileShmemInit(void);
 extern void InitLWLockAccess(void);
 
 extern const char *GetLWLockIdentifier(uint32 classId, uint16 eventId);
@@ -208,6 +226,26 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_PGSTATS_DATA,
 	LWTRANCHE_LAUNCHER_DSA,
 	LWTRANCHE_LAUNCHER_HASH,
+	LWTRANCHE_AIO_URING_COMPLETION,
+	LWTRANCHE_BUFFER_REL_INDEX,
+	LWTRANCHE_PARALLEL_REDO_EXTENSION,
+	LWTRANCHE_PARALLEL_MEMOIZE,
+	LWTRANCHE_INDEX_TID_LOG,
+	LWTRANCHE_SHARED_TIDSTORE,
+	LWTRANCHE_SINVAL_SHARD,
+	LWTRANCHE_XACT_SLRU,
+	LWTRANCHE_COMMITTS_SLRU,
+	LWTRANCHE_SUBTRANS_SLRU,
+	LWTRANCHE_MULTIXACTOFFSET_SLRU,
+	LWTRANCHE_MULTIXACTMEMBER_SLRU,
+	LWTRANCHE_NOTIFY_SLRU,
+	LWTRANCHE_SERIAL_SLRU,
+	LWTRANCHE_RELSIZE_CACHE,
+	LWTRANCHE_SHARED_CATCACHE,
+	LWTRANCHE_SHARED_CATCACHE_DSA,
+	LWTRANCHE_SHARED_PLAN_CACHE,
+	LWTRANCHE_SHARED_PLAN_CACHE_DSA,
+	LWTRANCHE_SHARED_TYPE_CACHE,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
@@ -45,6 +45,9 @@ typedef struct PGShmemHeader	/* standard header for all Postgres shmem */
 extern PGDLLIMPORT int shared_memory_type;
 extern PGDLLIMPORT int huge_pages;
 extern PGDLLIMPORT int huge_page_size;
+extern PGDLLIMPORT bool numa_enabled;
+extern PGDLLIMPORT bool numa_pin_backends;
+extern PGDLLIMPORT bool shared_memory_prefault;
 
 /* Possible values for huge_pages */
 typedef enum
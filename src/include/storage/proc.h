@@ -23,9 +23,12 @@
 #include "storage/proclist_types.h"
 
 /*
- * Each backend advertises up to PGPROC_MAX_CACHED_SUBXIDS TransactionIds
- * for non-aborted subtransactions of its current top transaction.  These
- * have to be treated as running XIDs by other backends.
+ * Each backend advertises up to max_cached_subxids TransactionIds for
+ * non-aborted subtransactions of its current top transaction.  These have to
+ * be treated as running XIDs by other backends.  PGPROC_MAX_CACHED_SUBXIDS
+ * is the minimum of max_cached_subxids, and also how often the subxids
+ * assigned are WAL-logged for the benefit of hot standbys, which keep at
+ * most that many subxids per transaction in KnownAssignedXids.
  *
  * We also keep track of whether the cache overflowed (ie, the transaction has
  * generated at least one subtransaction that didn't fit in the cache).
@@ -36,18 +39,22 @@
  * See src/test/isolation/specs/subxid-overflow.spec if you change this.
  */
 #define PGPROC_MAX_CACHED_SUBXIDS 64	/* XXX guessed-at value */
+#define PGPROC_MAX_CACHED_SUBXIDS_LIMIT 8192
+
+extern PGDLLIMPORT int max_cached_subxids;
 
 typedef struct XidCacheStatus
 {
-	/* number of cached subxids, never more than PGPROC_MAX_CACHED_SUBXIDS */
-	uint8		count;
+	/* number of cached subxids, never more than max_cached_subxids */
+	uint16		count;
 	/* has PGPROC->subxids overflowed */
 	bool		overflowed;
 } XidCacheStatus;
 
 struct XidCache
 {
-	TransactionId xids[PGPROC_MAX_CACHED_SUBXIDS];
+	/* max_cached_subxids entries, allocated by InitProcGlobal() */
+	TransactionId *xids;
 };
 
 /*
@@ -77,12 +84,21 @@ struct XidCache
 #define		PROC_XMIN_FLAGS (PROC_IN_VACUUM | PROC_IN_SAFE_IC)
 
 /*
- * We allow a small number of "weak" relation locks (AccessShareLock,
- * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
- * rather than the main lock table.  This eases contention on the lock
- * manager LWLocks.  See storage/lmgr/README for additional details.
+ * We allow a limited number of "weak" relation locks (AccessShareLock,
+ * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure (or
+ * rather in shared memory referenced from PGPROC) rather than the main lock
+ * table.  This eases contention on the lock manager LWLocks.  See
+ * storage/lmgr/README for additional details.
+ *
+ * The slots come in groups of FP_LOCK_SLOTS_PER_GROUP, and the number of
+ * groups scales with max_locks_per_transaction.
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+extern PGDLLIMPORT int FastPathLockGroupsPerBackend;
+
+#define		FP_LOCK_GROUPS_PER_BACKEND_MAX	1024
+#define		FP_LOCK_SLOTS_PER_GROUP		16	/* don't change, see fpLockBits */
+#define		FastPathLockSlotsPerBackend() \
+	(FP_LOCK_SLOTS_PER_GROUP * FastPathLockGroupsPerBackend)
 
 /*
  * An invalid pgprocno.  Must be larger than the maximum number of PGPROC
@@ -195,6 +211,9 @@ struct PGPROC
 	int			pgxactoff;		/* offset into various ProcGlobal->arrays with
 								 * data mirrored from this PGPROC */
 
+	int			runningXidIndex;	/* position in procarray.c's list of
+									 * running xids, or -1 */
+
 	int			pgprocno;		/* Number of this PGPROC in
 								 * ProcGlobal->allProcs array. This is set
 								 * once by InitProcGlobal().
@@ -220,6 +239,7 @@ struct PGPROC
 	/* Info about LWLock the process is currently waiting for, if any. */
 	uint8		lwWaiting;		/* see LWLockWaitState */
 	uint8		lwWaitMode;		/* lwlock mode being waited for */
+	uint8		lwNumaSkips;	/* times passed over for a same-node waiter */
 	proclist_node lwWaitLink;	/* position in LW lock wait list */
 
 	/* Support for condition variables. */
@@ -254,9 +274,10 @@ struct PGPROC
 	/*
 	 * All PROCLOCK objects for locks held or awaited by this backend are
 	 * linked into one of these lists, according to the partition number of
-	 * their lock.
+	 * their lock.  The array, of NUM_LOCK_PARTITIONS lists, is allocated
+	 * separately by InitProcGlobal().
 	 */
-	dlist_head	myProcLocks[NUM_LOCK_PARTITIONS];
+	dlist_head *myProcLocks;
 
 	XidCacheStatus subxidStatus;	/* mirrored with
 									 * ProcGlobal->subxidStates[i] */
@@ -274,12 +295,18 @@ struct PGPROC
 	 */
 	TransactionId procArrayGroupMemberXid;
 
+	/* dummy PGPROC of a prepared transaction to remove from the ProcArray */
+	PGPROC	   *procArrayGroupMemberRemove;
+
 	uint32		wait_event_info;	/* proc's wait information */
 
 	/* Support for group transaction status update. */
 	bool		clogGroupMember;	/* true, if member of clog group */
 	pg_atomic_uint32 clogGroupNext; /* next clog group member */
 	TransactionId clogGroupMemberXid;	/* transaction id of clog group member */
+	TransactionId *clogGroupMemberSubxids;	/* its subxids on the page, in
+											 * shared memory */
+	int			clogGroupMemberNsubxids;	/* number of those subxids */
 	XidStatus	clogGroupMemberXidStatus;	/* transaction status of clog
 											 * group member */
 	int			clogGroupMemberPage;	/* clog page corresponding to
@@ -287,10 +314,16 @@ struct PGPROC
 	XLogRecPtr	clogGroupMemberLsn; /* WAL location of commit record for clog
 									 * group member */
 
+	/* Support for group WAL flush. */
+	bool		walFlushGroupMember;	/* true, if member of WAL flush group */
+	pg_atomic_uint32 walFlushGroupNext; /* next WAL flush group member */
+	XLogRecPtr	walFlushGroupLsn;	/* WAL location the member needs flushed */
+
 	/* Lock manager data, recording fast-path locks taken by this backend. */
 	LWLock		fpInfoLock;		/* protects per-backend fast-path state */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND]; /* slots for rel oids */
+	uint64	   *fpLockBits;		/* lock modes held for each fast-path slot,
+								 * one word per group */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
@@ -397,6 +430,8 @@ typedef struct PROC_HDR
 	pg_atomic_uint32 procArrayGroupFirst;
 	/* First pgproc waiting for group transaction status update */
 	pg_atomic_uint32 clogGroupFirst;
+	/* First pgproc waiting for group WAL flush */
+	pg_atomic_uint32 walFlushGroupFirst;
 	/* WALWriter process's latch */
 	Latch	   *walwriterLatch;
 	/* Checkpointer process's latch */
@@ -438,7 +473,9 @@ extern PGDLLIMPORT bool log_lock_waits;
  */
 extern int	ProcGlobalSemas(void);
 extern Size ProcGlobalShmemSize(void);
+extern void InitializeFastPathLocks(void);
 extern void InitProcGlobal(void);
+extern int	ProcNumaNode(int pgprocno);
 extern void InitProcess(void);
 extern void InitProcessPhase2(void);
 extern void InitAuxiliaryProcess(void);
@@ -463,5 +500,6 @@ extern PGPROC *AuxiliaryPidGetProc(int pid);
 
 extern void BecomeLockGroupLeader(void);
 extern bool BecomeLockGroupMember(PGPROC *leader, int pid);
+extern void LeaveLockGroup(void);
 
 #endif							/* _PROC_H_ */
@@ -68,6 +68,10 @@ extern void shm_mq_detach(shm_mq_handle *mqh);
 /* Get the shm_mq from handle. */
 extern shm_mq *shm_mq_get_queue(shm_mq_handle *mqh);
 
+/* Report how often either side had to wait for the other. */
+extern void shm_mq_get_stalls(shm_mq *mq, uint64 *send_stalls,
+							  uint64 *receive_stalls);
+
 /* Send or receive messages. */
 extern shm_mq_result shm_mq_send(shm_mq_handle *mqh,
 								 Size nbytes, const void *data, bool nowait,
@@ -80,6 +84,12 @@ extern shm_mq_result shm_mq_receive(shm_mq_handle *mqh,
 /* Wait for our counterparty to attach to the queue. */
 extern shm_mq_result shm_mq_wait_for_attach(shm_mq_handle *mqh);
 
+/*
+ * How long a blocked sender or receiver spins, waiting for its counterparty,
+ * before going to sleep on its latch.
+ */
+#define SHM_MQ_BUSY_POLL_USEC	20
+
 /* Smallest possible queue. */
 extern PGDLLIMPORT const Size shm_mq_minimum_size;
 
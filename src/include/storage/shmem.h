@@ -37,6 +37,11 @@ extern HTAB *ShmemInitHash(const char *name, long init_size, long max_size,
 extern void *ShmemInitStruct(const char *name, Size size, bool *foundPtr);
 extern Size add_size(Size s1, Size s2);
 extern Size mul_size(Size s1, Size s2);
+extern bool ShmemNumaAvailable(void);
+extern int	ShmemNumaNodes(void);
+extern void ShmemNumaInterleave(const char *name, void *ptr, Size size);
+extern void ShmemNumaBind(const char *name, void *ptr, Size size, int node);
+extern void ShmemPrefault(void);
 
 /* ipci.c */
 extern void RequestAddinShmemSpace(Size size);
@@ -25,12 +25,21 @@
 #include "storage/lock.h"
 #include "storage/sinval.h"
 
+/* GUC variables */
+extern PGDLLIMPORT int sinval_queue_size;
+extern PGDLLIMPORT int sinval_database_shards;
+
+#define MIN_SINVAL_QUEUE_SIZE		2048
+#define MAX_SINVAL_QUEUE_SIZE		(1024 * 1024)
+#define MAX_SINVAL_DATABASE_SHARDS	64
+
 /*
  * prototypes for functions in sinvaladt.c
  */
 extern Size SInvalShmemSize(void);
 extern void CreateSharedInvalidationState(void);
 extern void SharedInvalBackendInit(bool sendOnly);
+extern void SharedInvalBackendSetDatabase(Oid dbid);
 extern PGPROC *BackendIdGetProc(int backendID);
 extern void BackendIdGetTransactionIds(int backendID, TransactionId *xid,
 									   TransactionId *xmin, int *nsubxid,
@@ -15,6 +15,7 @@
 #define SMGR_H
 
 #include "lib/ilist.h"
+#include "storage/aio.h"
 #include "storage/block.h"
 #include "storage/relfilelocator.h"
 
@@ -95,19 +96,48 @@ extern void smgrextend(SMgrRelation reln, ForkNumber forknum,
 extern void smgrzeroextend(SMgrRelation reln, ForkNumber forknum,
 						   BlockNumber blocknum, int nblocks, bool skipFsync);
 extern bool smgrprefetch(SMgrRelation reln, ForkNumber forknum,
-						 BlockNumber blocknum);
+						 BlockNumber blocknum, int nblocks);
 extern void smgrread(SMgrRelation reln, ForkNumber forknum,
 					 BlockNumber blocknum, void *buffer);
+extern void smgrreadv(SMgrRelation reln, ForkNumber forknum,
+					  BlockNumber blocknum,
+					  void **buffers, BlockNumber nblocks);
+extern BlockNumber smgrmaxcombine(SMgrRelation reln, ForkNumber forknum,
+								  BlockNumber blocknum);
+extern void smgrstartreadv(PgAioHandle *ioh, SMgrRelation reln,
+						   ForkNumber forknum, BlockNumber blocknum,
+						   void **buffers, BlockNumber nblocks);
 extern void smgrwrite(SMgrRelation reln, ForkNumber forknum,
 					  BlockNumber blocknum, const void *buffer, bool skipFsync);
+extern void smgrwritev(SMgrRelation reln, ForkNumber forknum,
+					   BlockNumber blocknum,
+					   const void **buffers, BlockNumber nblocks,
+					   bool skipFsync);
 extern void smgrwriteback(SMgrRelation reln, ForkNumber forknum,
 						  BlockNumber blocknum, BlockNumber nblocks);
 extern BlockNumber smgrnblocks(SMgrRelation reln, ForkNumber forknum);
 extern BlockNumber smgrnblocks_cached(SMgrRelation reln, ForkNumber forknum);
+extern void smgrforgetnblocks(SMgrRelation reln);
 extern void smgrtruncate(SMgrRelation reln, ForkNumber *forknum,
 						 int nforks, BlockNumber *nblocks);
 extern void smgrimmedsync(SMgrRelation reln, ForkNumber forknum);
 extern void AtEOXact_SMgr(void);
 extern bool ProcessBarrierSmgrRelease(void);
 
+/* relsize.c */
+extern PGDLLIMPORT int relsize_cache_size;
+
+extern Size RelSizeShmemSize(void);
+extern void RelSizeShmemInit(void);
+extern BlockNumber RelSizeGet(const RelFileLocator *rlocator,
+							  ForkNumber forknum, uint64 *generation);
+extern void RelSizeSet(const RelFileLocator *rlocator, ForkNumber forknum,
+					   BlockNumber nblocks, uint64 generation);
+extern void RelSizeExtend(const RelFileLocator *rlocator, ForkNumber forknum,
+						  BlockNumber nblocks);
+extern void RelSizeTruncate(const RelFileLocator *rlocator, ForkNumber forknum,
+							BlockNumber nblocks);
+extern void RelSizeDrop(const RelFileLocator *rlocator);
+extern void RelSizeDropDatabase(Oid dbid);
+
 #endif							/* SMGR_H */
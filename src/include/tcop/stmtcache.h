@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * stmtcache.h
+ *	  Per-backend cache of simple-Query statements by shape.
+ *
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/tcop/stmtcache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef STMTCACHE_H
+#define STMTCACHE_H
+
+#include "lib/stringinfo.h"
+#include "nodes/params.h"
+#include "parser/parser.h"
+#include "utils/plancache.h"
+
+/* GUC parameter */
+extern PGDLLIMPORT int statement_cache_size;
+
+typedef struct StmtCacheShape StmtCacheShape;
+
+/*
+ * A query string that the statement cache can handle, as scanned by
+ * StmtCacheScanQuery().
+ */
+typedef struct StmtCacheQuery
+{
+	const char *query_string;
+	StringInfoData normtext;	/* query string with literals replaced */
+	uint32		hashvalue;		/* hash of normtext */
+	int			nliterals;
+	QueryLiteral *literals;
+	StmtCacheShape *shape;		/* matching cache entry, if any */
+} StmtCacheQuery;
+
+extern StmtCacheQuery *StmtCacheScanQuery(const char *query_string);
+extern CachedPlanSource *StmtCacheLookup(StmtCacheQuery *scquery);
+extern CachedPlanSource *StmtCacheCreate(StmtCacheQuery *scquery,
+										 RawStmt *parsetree,
+										 CommandTag commandTag);
+extern CachedPlan *StmtCacheGetPlan(StmtCacheQuery *scquery,
+									ParamListInfo *params);
+extern void StmtCacheReset(void);
+
+#endif							/* STMTCACHE_H */
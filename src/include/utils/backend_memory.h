@@ -0,0 +1,45 @@
+/* ----------
+ * backend_memory.h
+ *	  Definitions for per-process memory accounting in shared memory.
+ *
+ * Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ * src/include/utils/backend_memory.h
+ * ----------
+ */
+#ifndef BACKEND_MEMORY_H
+#define BACKEND_MEMORY_H
+
+#include "storage/proc.h"
+
+/* Number of memory contexts a process publishes when asked to */
+#define BACKEND_MEMORY_TOP_CONTEXTS		16
+
+/* One published memory context */
+typedef struct BackendMemoryContextEntry
+{
+	char		name[NAMEDATALEN];
+	char		ident[NAMEDATALEN];
+	int			level;
+	int64		total_bytes;
+	int64		free_bytes;
+} BackendMemoryContextEntry;
+
+/* GUC variables, in megabytes */
+extern PGDLLIMPORT int backend_memory_limit;
+extern PGDLLIMPORT int total_backend_memory_limit;
+
+extern Size BackendMemoryShmemSize(void);
+extern void BackendMemoryShmemInit(void);
+extern void BackendMemoryAttach(void);
+
+extern int	BackendMemoryNumSlots(void);
+extern bool BackendMemoryGetSlot(int slotno, int *pid, uint64 *allocated_bytes);
+extern uint64 BackendMemoryTotalReserved(void);
+extern int	BackendMemoryRequestContexts(PGPROC *proc, BackendId backendId,
+										 BackendMemoryContextEntry *entries);
+
+extern void HandlePublishMemoryContextsInterrupt(void);
+extern void ProcessPublishMemoryContextsInterrupt(void);
+
+#endif							/* BACKEND_MEMORY_H */
@@ -0,0 +1,35 @@
+/* ----------
+ * backend_profile.h
+ *	  Sampling of what busy backends are executing.
+ *
+ *	Copyright (c) 2001-2023, PostgreSQL Global Development Group
+ *
+ *	src/include/utils/backend_profile.h
+ * ----------
+ */
+#ifndef BACKEND_PROFILE_H
+#define BACKEND_PROFILE_H
+
+/* number of samples kept in the shared ring */
+#define PROFILE_NUM_SAMPLES		16384
+
+/* GUC parameter */
+extern PGDLLIMPORT int profile_sample_interval;
+
+/*
+ * Plan node being executed, maintained by the ExecProcNode wrappers while
+ * profile_sample_interval is set.  Plain integers rather than a pointer to
+ * the PlanState, so that the timer signal handler never follows a pointer
+ * into executor state that might be getting freed.
+ */
+extern PGDLLIMPORT volatile int ProfilePlanNodeId;
+extern PGDLLIMPORT volatile int ProfileNodeTag;
+
+extern Size BackendProfileShmemSize(void);
+extern void BackendProfileShmemInit(void);
+
+extern void pgstat_enable_profile_sampling(void);
+extern void pgstat_profile_report_state(bool running);
+extern void ProfileSampleTimeoutHandler(void);
+
+#endif							/* BACKEND_PROFILE_H */
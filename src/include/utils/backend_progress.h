@@ -32,6 +32,23 @@ typedef enum ProgressCommandType
 
 #define PGSTAT_NUM_PROGRESS_PARAM	20
 
+/*
+ * Temporary file usage of a plan node, for pg_stat_progress_temp_files.
+ * Each backend shows up to PGSTAT_NUM_TEMP_FILE_NODES nodes at a time.
+ */
+#define PGSTAT_NUM_TEMP_FILE_NODES	8
+#define PGSTAT_TEMP_FILE_NODE_TYPE_LEN	24
+
+typedef struct PgBackendTempFileNode
+{
+	int			plan_node_id;	/* -1 if this entry is unused */
+	char		node_type[PGSTAT_TEMP_FILE_NODE_TYPE_LEN];
+	int			files;			/* temporary files created so far */
+	int64		size;			/* current size of its temporary files */
+	int64		peak_size;		/* largest size reached */
+	int64		bytes_written;
+} PgBackendTempFileNode;
+
 
 extern void pgstat_progress_start_command(ProgressCommandType cmdtype,
 										  Oid relid);
@@ -40,6 +57,8 @@ extern void pgstat_progress_incr_param(int index, int64 incr);
 extern void pgstat_progress_update_multi_param(int nparam, const int *index,
 											   const int64 *val);
 extern void pgstat_progress_end_command(void);
+extern void pgstat_progress_report_temp_files(int slot,
+											  const PgBackendTempFileNode *node);
 
 
 #endif							/* BACKEND_PROGRESS_H */
@@ -82,6 +82,23 @@ typedef struct PgBackendGSSStatus
 } PgBackendGSSStatus;
 
 
+/* ----------
+ * PgBackendResourceUsage
+ *
+ * Resources used by a backend since it started, as last sampled.  See
+ * pgstat_report_resource_usage().
+ * ----------
+ */
+typedef struct PgBackendResourceUsage
+{
+	int64		cpu_user_time;	/* CPU times in microseconds */
+	int64		cpu_system_time;
+	int64		memory_allocated;	/* bytes held by memory contexts */
+	int64		read_bytes;		/* data read and written via the I/O stats */
+	int64		write_bytes;
+} PgBackendResourceUsage;
+
+
 /* ----------
  * PgBackendStatus
  *
@@ -171,6 +188,12 @@ typedef struct PgBackendStatus
 
 	/* query identifier, optionally computed using post_parse_analyze_hook */
 	uint64		st_query_id;
+
+	/* resource usage, sampled every track_resource_usage_interval */
+	PgBackendResourceUsage st_resource_usage;
+
+	/* temporary file usage of the plan nodes that have some */
+	PgBackendTempFileNode st_temp_file_nodes[PGSTAT_NUM_TEMP_FILE_NODES];
 } PgBackendStatus;
 
 
@@ -288,6 +311,7 @@ typedef struct LocalPgBackendStatus
  */
 extern PGDLLIMPORT bool pgstat_track_activities;
 extern PGDLLIMPORT int pgstat_track_activity_query_size;
+extern PGDLLIMPORT int pgstat_track_resource_usage_interval;
 
 
 /* ----------
@@ -326,6 +350,9 @@ extern const char *pgstat_get_backend_current_activity(int pid, bool checkUser);
 extern const char *pgstat_get_crashed_backend_activity(int pid, char *buffer,
 													   int buflen);
 extern uint64 pgstat_get_my_query_id(void);
+extern void pgstat_get_resource_usage(PgBackendResourceUsage *usage);
+extern void pgstat_enable_resource_usage_sampling(void);
+extern void pgstat_report_resource_usage(void);
 
 
 /* ----------
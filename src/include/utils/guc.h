@@ -266,6 +266,7 @@ extern PGDLLIMPORT double log_xact_sample_rate;
 extern PGDLLIMPORT char *backtrace_functions;
 
 extern PGDLLIMPORT int temp_file_limit;
+extern PGDLLIMPORT int node_temp_file_limit;
 
 extern PGDLLIMPORT int num_temp_buffers;
 
@@ -367,6 +368,7 @@ extern bool check_GUC_name_for_parameter_acl(const char *name);
 extern void InitializeGUCOptions(void);
 extern bool SelectConfigFiles(const char *userDoption, const char *progname);
 extern void ResetAllOptions(void);
+extern bool AnyOptionsSetInSession(void);
 extern void AtStart_GUC(void);
 extern int	NewGUCNestLevel(void);
 extern void AtEOXact_GUC(bool isCommit, int nestLevel);
@@ -402,6 +402,8 @@ extern JsonbValue *findJsonbValueFromContainer(JsonbContainer *container,
 extern JsonbValue *getKeyJsonValueFromContainer(JsonbContainer *container,
 												const char *keyVal, int keyLen,
 												JsonbValue *res);
+extern bool getKeyJsonValueFromToast(struct varlena *attr, const char *keyVal,
+									 int keyLen, JsonbValue *res, bool *found);
 extern JsonbValue *getIthJsonbValueFromContainer(JsonbContainer *container,
 												 uint32 i);
 extern JsonbValue *pushJsonbValue(JsonbParseState **pstate,
@@ -72,6 +72,8 @@ extern void LogicalTapeFreeze(LogicalTape *lt, TapeShare *share);
 extern size_t LogicalTapeBackspace(LogicalTape *lt, size_t size);
 extern void LogicalTapeSeek(LogicalTape *lt, long blocknum, int offset);
 extern void LogicalTapeTell(LogicalTape *lt, long *blocknum, int *offset);
+extern void LogicalTapeSeekImported(LogicalTape *lt, long blocknum,
+									int offset);
 extern long LogicalTapeSetBlocks(LogicalTapeSet *lts);
 
 #endif							/* LOGTAPE_H */
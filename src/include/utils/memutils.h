@@ -109,6 +109,9 @@ extern void ProcessLogMemoryContextInterrupt(void);
  */
 
 /* aset.c */
+extern PGDLLIMPORT int memory_block_cache_size;
+
+extern void AllocSetTrimBlockCache(Size budget);
 extern MemoryContext AllocSetContextCreateInternal(MemoryContext parent,
 												   const char *name,
 												   Size minContextSize,
@@ -143,6 +146,13 @@ extern MemoryContext GenerationContextCreate(MemoryContext parent,
 											 Size initBlockSize,
 											 Size maxBlockSize);
 
+/* bump.c */
+extern MemoryContext BumpContextCreate(MemoryContext parent,
+									   const char *name,
+									   Size minContextSize,
+									   Size initBlockSize,
+									   Size maxBlockSize);
+
 /*
  * Recommended default alloc parameters, suitable for "ordinary" contexts
  * that might hold quite a lot of data.
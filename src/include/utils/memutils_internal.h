@@ -16,6 +16,7 @@
 #ifndef MEMUTILS_INTERNAL_H
 #define MEMUTILS_INTERNAL_H
 
+#include "port/atomics.h"
 #include "utils/memutils.h"
 
 /* These functions implement the MemoryContext API for AllocSet context. */
@@ -70,6 +71,23 @@ extern void SlabStats(MemoryContext context,
 extern void SlabCheck(MemoryContext context);
 #endif
 
+/* These functions implement the MemoryContext API for Bump context. */
+extern void *BumpAlloc(MemoryContext context, Size size);
+extern void BumpFree(void *pointer);
+extern void *BumpRealloc(void *pointer, Size size);
+extern void BumpReset(MemoryContext context);
+extern void BumpDelete(MemoryContext context);
+extern MemoryContext BumpGetChunkContext(void *pointer);
+extern Size BumpGetChunkSpace(void *pointer);
+extern bool BumpIsEmpty(MemoryContext context);
+extern void BumpStats(MemoryContext context,
+					  MemoryStatsPrintFunc printfunc, void *passthru,
+					  MemoryContextCounters *totals,
+					  bool print_to_stderr);
+#ifdef MEMORY_CONTEXT_CHECKING
+extern void BumpCheck(MemoryContext context);
+#endif
+
 /*
  * These functions support the implementation of palloc_aligned() and are not
  * part of a fully-fledged MemoryContext type.
@@ -102,26 +120,146 @@ extern Size AlignedAllocGetChunkSpace(void *pointer);
  * but it happens that glibc stores flag bits in the same place where we put
  * the MemoryContextMethodID, so the possible values are predictable for it.)
  */
-typedef enum MemoryContextMethodID /// 定义了8种可能的方法
+typedef enum MemoryContextMethodID /// 定义了16种可能的方法
 {
-	MCTX_UNUSED1_ID,			/* 000 occurs in never-used memory */  /// 这个没有使用
-	MCTX_UNUSED2_ID,			/* glibc malloc'd chunks usually match 001 */
-	MCTX_UNUSED3_ID,			/* glibc malloc'd chunks > 128kB match 010 */
+	MCTX_UNUSED1_ID,			/* 0000 occurs in never-used memory */  /// 这个没有使用
+	MCTX_UNUSED2_ID,			/* glibc malloc'd chunks usually match 0001 */
+	MCTX_UNUSED3_ID,			/* glibc malloc'd chunks > 128kB match 0010 */
 	MCTX_ASET_ID,
 	MCTX_GENERATION_ID,
 	MCTX_SLAB_ID,
 	MCTX_ALIGNED_REDIRECT_ID,
-	MCTX_UNUSED4_ID				/* 111 occurs in wipe_mem'd memory */
+	MCTX_BUMP_ID,
+	MCTX_UNUSED5_ID,
+	MCTX_UNUSED6_ID,
+	MCTX_UNUSED7_ID,
+	MCTX_UNUSED8_ID,
+	MCTX_UNUSED9_ID,
+	MCTX_UNUSED10_ID,
+	MCTX_UNUSED11_ID,
+	MCTX_UNUSED4_ID				/* 1111 occurs in wipe_mem'd memory */
 } MemoryContextMethodID;
 
 /*
  * The number of bits that 8-byte memory chunk headers can use to encode the
  * MemoryContextMethodID.
  */
-#define MEMORY_CONTEXT_METHODID_BITS 3
+#define MEMORY_CONTEXT_METHODID_BITS 4
 #define MEMORY_CONTEXT_METHODID_MASK \
 	((((uint64) 1) << MEMORY_CONTEXT_METHODID_BITS) - 1)
 
+/*
+ * Accounting of the memory that memory contexts obtain from malloc().
+ *
+ * Every block is counted in MemoryAllocatedBytes, and the total is mirrored
+ * into this process's shared memory slot once backend_memory.c attaches it.
+ * Growing past MemoryAllocatedAllowance takes the slow path, which enforces
+ * backend_memory_limit and total_backend_memory_limit and reserves shared
+ * headroom in MEMORY_ACCOUNTING_CHUNK units.  Limits are never enforced when
+ * 'context' is NULL, which is what context creation passes.
+ */
+#define MEMORY_ACCOUNTING_CHUNK		(1024 * 1024)
+
+extern PGDLLIMPORT uint64 MemoryAllocatedBytes;
+extern PGDLLIMPORT uint64 MemoryAllocatedAllowance;
+extern PGDLLIMPORT uint64 MemoryAllocatedReserved;
+extern PGDLLIMPORT pg_atomic_uint64 *MemoryAllocatedReport;
+
+/* in utils/activity/backend_memory.c */
+extern bool MemoryAccountingReserveSlow(MemoryContext context, Size size);
+extern void MemoryAccountingReleaseSlow(void);
+
+static inline void
+MemoryAccountingRelease(Size size)
+{
+	Assert(MemoryAllocatedBytes >= size);
+	MemoryAllocatedBytes -= size;
+	if (MemoryAllocatedReport != NULL)
+		pg_atomic_write_u64(MemoryAllocatedReport, MemoryAllocatedBytes);
+	if (unlikely(MemoryAllocatedReserved >
+				 MemoryAllocatedBytes + 2 * MEMORY_ACCOUNTING_CHUNK))
+		MemoryAccountingReleaseSlow();
+}
+
+/*
+ * MemoryContextMallocBlock
+ *		malloc() 'size' bytes on behalf of 'context', counting them.
+ *
+ * Returns NULL if malloc fails or a memory limit would be exceeded.
+ */
+static inline void *
+MemoryContextMallocBlock(MemoryContext context, Size size)
+{
+	void	   *block;
+
+	if (unlikely(MemoryAllocatedBytes + size > MemoryAllocatedAllowance))
+	{
+		if (!MemoryAccountingReserveSlow(context, size))
+			return NULL;
+	}
+	else
+	{
+		MemoryAllocatedBytes += size;
+		if (MemoryAllocatedReport != NULL)
+			pg_atomic_write_u64(MemoryAllocatedReport, MemoryAllocatedBytes);
+	}
+
+	block = malloc(size);
+	if (unlikely(block == NULL))
+		MemoryAccountingRelease(size);
+	return block;
+}
+
+/*
+ * MemoryContextReallocBlock
+ *		realloc() a block from 'oldsize' to 'size' bytes, counting the change.
+ */
+static inline void *
+MemoryContextReallocBlock(MemoryContext context, void *block,
+						  Size oldsize, Size size)
+{
+	void	   *newblock;
+
+	if (size > oldsize)
+	{
+		Size		growth = size - oldsize;
+
+		if (unlikely(MemoryAllocatedBytes + growth > MemoryAllocatedAllowance))
+		{
+			if (!MemoryAccountingReserveSlow(context, growth))
+				return NULL;
+		}
+		else
+		{
+			MemoryAllocatedBytes += growth;
+			if (MemoryAllocatedReport != NULL)
+				pg_atomic_write_u64(MemoryAllocatedReport, MemoryAllocatedBytes);
+		}
+	}
+
+	newblock = realloc(block, size);
+	if (unlikely(newblock == NULL))
+	{
+		/* the old block is still there */
+		if (size > oldsize)
+			MemoryAccountingRelease(size - oldsize);
+	}
+	else if (size < oldsize)
+		MemoryAccountingRelease(oldsize - size);
+	return newblock;
+}
+
+/*
+ * MemoryContextFreeBlock
+ *		free() a block of 'size' bytes obtained by MemoryContextMallocBlock.
+ */
+static inline void
+MemoryContextFreeBlock(void *block, Size size)
+{
+	free(block);
+	MemoryAccountingRelease(size);
+}
+
 /*
  * This routine handles the context-type-independent part of memory
  * context creation.  It's intended to be called from context-type-
@@ -53,7 +53,7 @@ typedef struct PgStat_HashKey
 {
 	PgStat_Kind kind;			/* statistics entry kind */
 	Oid			dboid;			/* database ID. InvalidOid for shared objects. */
-	Oid			objoid;			/* object ID, either table or function. */
+	uint64		objoid;			/* object ID, e.g. table or function OID */
 } PgStat_HashKey;
 
 /*
@@ -347,6 +347,13 @@ typedef struct PgStatShared_SLRU
 	PgStat_SLRUStats stats[SLRU_NUM_ELEMENTS];
 } PgStatShared_SLRU;
 
+typedef struct PgStatShared_Wait
+{
+	/* lock protects ->stats */
+	LWLock		lock;
+	PgStat_WaitStats stats;
+} PgStatShared_Wait;
+
 typedef struct PgStatShared_Wal
 {
 	/* lock protects ->stats */
@@ -388,6 +395,30 @@ typedef struct PgStatShared_Subscription
 	PgStat_StatSubEntry stats;
 } PgStatShared_Subscription;
 
+typedef struct PgStatShared_WalRelation
+{
+	PgStatShared_Common header;
+	PgStat_StatWalRelEntry stats;
+} PgStatShared_WalRelation;
+
+typedef struct PgStatShared_Planning
+{
+	PgStatShared_Common header;
+	PgStat_StatPlanningEntry stats;
+} PgStatShared_Planning;
+
+typedef struct PgStatShared_Query
+{
+	PgStatShared_Common header;
+	PgStat_StatQueryEntry stats;
+} PgStatShared_Query;
+
+typedef struct PgStatShared_TablespaceIO
+{
+	PgStatShared_Common header;
+	PgStat_StatTablespaceIOEntry stats;
+} PgStatShared_TablespaceIO;
+
 typedef struct PgStatShared_ReplSlot
 {
 	PgStatShared_Common header;
@@ -424,6 +455,13 @@ typedef struct PgStat_ShmemControl
 	 */
 	pg_atomic_uint64 gc_request_count;
 
+	/*
+	 * Approximate number of query stats entries, and whether a backend is
+	 * evicting some of them; see pgstat_query.c.
+	 */
+	pg_atomic_uint32 query_entries;
+	pg_atomic_flag query_evicting;
+
 	/*
 	 * Stats data for fixed-numbered objects.
 	 */
@@ -432,6 +470,7 @@ typedef struct PgStat_ShmemControl
 	PgStatShared_Checkpointer checkpointer;
 	PgStatShared_IO io;
 	PgStatShared_SLRU slru;
+	PgStatShared_Wait wait;
 	PgStatShared_Wal wal;
 } PgStat_ShmemControl;
 
@@ -458,6 +497,8 @@ typedef struct PgStat_Snapshot
 
 	PgStat_SLRUStats slru[SLRU_NUM_ELEMENTS];
 
+	PgStat_WaitStats wait;
+
 	PgStat_WalStats wal;
 
 	/* to free snapshot in bulk */
@@ -511,10 +552,10 @@ extern void pgstat_assert_is_up(void);
 #endif
 
 extern void pgstat_delete_pending_entry(PgStat_EntryRef *entry_ref);
-extern PgStat_EntryRef *pgstat_prep_pending_entry(PgStat_Kind kind, Oid dboid, Oid objoid, bool *created_entry);
-extern PgStat_EntryRef *pgstat_fetch_pending_entry(PgStat_Kind kind, Oid dboid, Oid objoid);
+extern PgStat_EntryRef *pgstat_prep_pending_entry(PgStat_Kind kind, Oid dboid, uint64 objoid, bool *created_entry);
+extern PgStat_EntryRef *pgstat_fetch_pending_entry(PgStat_Kind kind, Oid dboid, uint64 objoid);
 
-extern void *pgstat_fetch_entry(PgStat_Kind kind, Oid dboid, Oid objoid);
+extern void *pgstat_fetch_entry(PgStat_Kind kind, Oid dboid, uint64 objoid);
 extern void pgstat_snapshot_fixed(PgStat_Kind kind);
 
 
@@ -563,6 +604,22 @@ extern void pgstat_database_reset_timestamp_cb(PgStatShared_Common *header, Time
 extern bool pgstat_function_flush_cb(PgStat_EntryRef *entry_ref, bool nowait);
 
 
+/*
+ * Functions in pgstat_planning.c
+ */
+
+extern bool pgstat_planning_flush_cb(PgStat_EntryRef *entry_ref, bool nowait);
+extern void pgstat_planning_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts);
+
+
+/*
+ * Functions in pgstat_query.c
+ */
+
+extern bool pgstat_query_flush_cb(PgStat_EntryRef *entry_ref, bool nowait);
+extern void pgstat_query_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts);
+
+
 /*
  * Functions in pgstat_io.c
  */
@@ -570,6 +627,7 @@ extern bool pgstat_function_flush_cb(PgStat_EntryRef *entry_ref, bool nowait);
 extern bool pgstat_flush_io(bool nowait);
 extern void pgstat_io_reset_all_cb(TimestampTz ts);
 extern void pgstat_io_snapshot_cb(void);
+extern void pgstat_tablespace_io_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts);
 
 
 /*
@@ -601,16 +659,18 @@ extern bool pgstat_replslot_from_serialized_name_cb(const NameData *name, PgStat
 extern void pgstat_attach_shmem(void);
 extern void pgstat_detach_shmem(void);
 
-extern PgStat_EntryRef *pgstat_get_entry_ref(PgStat_Kind kind, Oid dboid, Oid objoid,
+extern PgStat_EntryRef *pgstat_get_entry_ref(PgStat_Kind kind, Oid dboid, uint64 objoid,
 											 bool create, bool *created_entry);
 extern bool pgstat_lock_entry(PgStat_EntryRef *entry_ref, bool nowait);
 extern bool pgstat_lock_entry_shared(PgStat_EntryRef *entry_ref, bool nowait);
 extern void pgstat_unlock_entry(PgStat_EntryRef *entry_ref);
-extern bool pgstat_drop_entry(PgStat_Kind kind, Oid dboid, Oid objoid);
+extern bool pgstat_drop_entry(PgStat_Kind kind, Oid dboid, uint64 objoid);
 extern void pgstat_drop_all_entries(void);
-extern PgStat_EntryRef *pgstat_get_entry_ref_locked(PgStat_Kind kind, Oid dboid, Oid objoid,
+extern void pgstat_drop_matching_entries(bool (*do_drop) (PgStatShared_HashEntry *, Datum),
+										 Datum match_data);
+extern PgStat_EntryRef *pgstat_get_entry_ref_locked(PgStat_Kind kind, Oid dboid, uint64 objoid,
 													bool nowait);
-extern void pgstat_reset_entry(PgStat_Kind kind, Oid dboid, Oid objoid, TimestampTz ts);
+extern void pgstat_reset_entry(PgStat_Kind kind, Oid dboid, uint64 objoid, TimestampTz ts);
 extern void pgstat_reset_entries_of_kind(PgStat_Kind kind, TimestampTz ts);
 extern void pgstat_reset_matching_entries(bool (*do_reset) (PgStatShared_HashEntry *, Datum),
 										  Datum match_data,
@@ -630,6 +690,15 @@ extern void pgstat_slru_reset_all_cb(TimestampTz ts);
 extern void pgstat_slru_snapshot_cb(void);
 
 
+/*
+ * Functions in pgstat_wait.c
+ */
+
+extern bool pgstat_flush_wait(bool nowait);
+extern void pgstat_wait_reset_all_cb(TimestampTz ts);
+extern void pgstat_wait_snapshot_cb(void);
+
+
 /*
  * Functions in pgstat_wal.c
  */
@@ -640,6 +709,7 @@ extern bool pgstat_have_pending_wal(void);
 
 extern void pgstat_wal_reset_all_cb(TimestampTz ts);
 extern void pgstat_wal_snapshot_cb(void);
+extern void pgstat_wal_relation_reset_timestamp_cb(PgStatShared_Common *header, TimestampTz ts);
 
 
 /*
@@ -680,6 +750,13 @@ extern PGDLLIMPORT bool have_iostats;
 extern PGDLLIMPORT bool have_slrustats;
 
 
+/*
+ * Variables in pgstat_wait.c
+ */
+
+extern PGDLLIMPORT bool have_waitstats;
+
+
 /*
  * Implementation of inline functions declared above.
  */
@@ -783,7 +860,8 @@ pgstat_hash_hash_key(const void *d, size_t size, void *arg)
 
 	hash = murmurhash32(key->kind);
 	hash = hash_combine(hash, murmurhash32(key->dboid));
-	hash = hash_combine(hash, murmurhash32(key->objoid));
+	hash = hash_combine(hash, murmurhash32((uint32) key->objoid));
+	hash = hash_combine(hash, murmurhash32((uint32) (key->objoid >> 32)));
 
 	return hash;
 }
@@ -112,11 +112,20 @@ typedef struct RelationData
 	TupleDesc	rd_att;			/* tuple descriptor */
 	Oid			rd_id;			/* relation's object id */  // 这张表的Oid
 	LockInfoData rd_lockInfo;	/* lock mgr's info for locking relation */
+
+	/*
+	 * Rules, triggers and row security policies are loaded on first use; read
+	 * them with RelationGetRuleLock, RelationGetTriggerDesc and
+	 * RelationGetRowSecurity rather than directly.
+	 */
 	RuleLock   *rd_rules;		/* rewrite rules */
 	MemoryContext rd_rulescxt;	/* private memory cxt for rd_rules, if any */
+	bool		rd_rulesvalid;	/* true if rd_rules has been loaded */
 	TriggerDesc *trigdesc;		/* Trigger info, or NULL if rel has none */
+	bool		rd_trigdescvalid;	/* true if trigdesc has been loaded */
 	/* use "struct" here to avoid needing to include rowsecurity.h: */
 	struct RowSecurityDesc *rd_rsdesc;	/* row security policies, or NULL */
+	bool		rd_rsdescvalid; /* true if rd_rsdesc has been loaded */
 
 	/* data managed by RelationGetFKeyList: */
 	List	   *rd_fkeylist;	/* list of ForeignKeyCacheInfo (see below) */
@@ -311,6 +320,7 @@ typedef struct AutoVacOpts
 	int			vacuum_ins_threshold;
 	int			analyze_threshold;
 	int			vacuum_cost_limit;
+	int			parallel_workers;	/* 0 means no parallel vacuum */
 	int			freeze_min_age;
 	int			freeze_max_age;
 	int			freeze_table_age;
@@ -342,6 +352,8 @@ typedef struct StdRdOptions
 	int			parallel_workers;	/* max number of parallel workers */
 	StdRdOptIndexCleanup vacuum_index_cleanup;	/* controls index vacuuming */
 	bool		vacuum_truncate;	/* enables vacuum to truncate a relation */
+	bool		tuple_count_map;	/* enables vacuum to extend the tuple
+									 * count map */
 } StdRdOptions;
 
 #define HEAP_MIN_FILLFACTOR			10
@@ -397,6 +409,16 @@ typedef struct StdRdOptions
 	((relation)->rd_options ? \
 	 ((StdRdOptions *) (relation)->rd_options)->parallel_workers : (defaultpw))
 
+/*
+ * RelationWantsTupleCountMap
+ *		Returns whether VACUUM should extend the relation's tuple count map.
+ *		Note multiple eval of argument!
+ */
+#define RelationWantsTupleCountMap(relation) \
+	((relation)->rd_options && \
+	 (relation)->rd_rel->relkind == RELKIND_RELATION ? \
+	 ((StdRdOptions *) (relation)->rd_options)->tuple_count_map : false)
+
 /* ViewOptions->check_option values */
 typedef enum ViewOptCheckOption
 {
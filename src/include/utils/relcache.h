@@ -39,11 +39,15 @@ typedef Relation *RelationPtr;
  */
 extern Relation RelationIdGetRelation(Oid relationId);
 extern void RelationClose(Relation relation);
+extern void RelationCachePrefetch(Oid *relids, int nrelids);
 
 /*
  * Routines to compute/retrieve additional cached information
  */
 extern List *RelationGetFKeyList(Relation relation);
+extern struct RuleLock *RelationGetRuleLock(Relation relation);
+extern struct TriggerDesc *RelationGetTriggerDesc(Relation relation);
+extern struct RowSecurityDesc *RelationGetRowSecurity(Relation relation);
 extern List *RelationGetIndexList(Relation relation);
 extern List *RelationGetStatExtList(Relation relation);
 extern Oid	RelationGetPrimaryKeyIndex(Relation relation);
@@ -0,0 +1,36 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedcatcache.h
+ *	  Shared cache of system catalog tuples.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedcatcache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDCATCACHE_H
+#define SHAREDCATCACHE_H
+
+#include "access/htup.h"
+#include "storage/sinval.h"
+#include "utils/catcache.h"
+
+/* GUC variable */
+extern PGDLLIMPORT int shared_catcache_size;
+
+extern Size SharedCatCacheShmemSize(void);
+extern void SharedCatCacheShmemInit(void);
+
+extern bool SharedCatCacheEnabled(void);
+extern uint64 SharedCatCacheGeneration(CatCache *cache);
+extern HeapTuple SharedCatCacheLookup(CatCache *cache, uint32 hashValue,
+									  Datum *arguments);
+extern void SharedCatCacheInsert(CatCache *cache, uint32 hashValue,
+								 HeapTuple tuple, uint64 generation);
+extern void SharedCatCacheInvalidate(const SharedInvalidationMessage *msgs,
+									 int n);
+extern void SharedCatCacheDropDatabase(Oid dbid);
+
+#endif							/* SHAREDCATCACHE_H */
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.h
+ *	  Shared cache of generic plans.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedplancache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDPLANCACHE_H
+#define SHAREDPLANCACHE_H
+
+#include "storage/sinval.h"
+#include "utils/plancache.h"
+
+/* GUC variable */
+extern PGDLLIMPORT int shared_plan_cache_size;
+
+/* opaque; what a plan found in the cache depended on */
+typedef struct SharedPlanDeps SharedPlanDeps;
+
+extern Size SharedPlanCacheShmemSize(void);
+extern void SharedPlanCacheShmemInit(void);
+
+extern bool SharedPlanCacheEnabled(void);
+extern uint64 SharedPlanCacheGeneration(void);
+extern List *SharedPlanCacheLookup(CachedPlanSource *plansource,
+								   SharedPlanDeps **deps);
+extern bool SharedPlanCacheRecheck(SharedPlanDeps *deps);
+extern bool SharedPlanCacheGenericPreferred(CachedPlanSource *plansource);
+extern void SharedPlanCacheInsert(CachedPlanSource *plansource,
+								  List *stmt_list, bool generic_preferred,
+								  uint64 generation);
+extern void SharedPlanCacheInvalidate(const SharedInvalidationMessage *msgs,
+									  int n);
+extern void SharedPlanCacheDropDatabase(Oid dbid);
+
+#endif							/* SHAREDPLANCACHE_H */
@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedtypcache.h
+ *	  Shared cache of operator data of builtin types.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedtypcache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDTYPCACHE_H
+#define SHAREDTYPCACHE_H
+
+#include "storage/sinval.h"
+
+/*
+ * What typcache.c found out about a type's operators.  'flags' holds
+ * typcache.c's TCFLAGS_CHECKED_xxx bits telling which of the other fields
+ * are valid; this module doesn't look at them.
+ */
+typedef struct SharedTypeCacheData
+{
+	int			flags;
+	Oid			btree_opf;
+	Oid			btree_opintype;
+	Oid			hash_opf;
+	Oid			hash_opintype;
+	Oid			eq_opr;
+	Oid			lt_opr;
+	Oid			gt_opr;
+	Oid			cmp_proc;
+	Oid			hash_proc;
+	Oid			hash_extended_proc;
+} SharedTypeCacheData;
+
+extern Size SharedTypeCacheShmemSize(void);
+extern void SharedTypeCacheShmemInit(void);
+
+extern bool SharedTypeCacheEnabled(void);
+extern uint64 SharedTypeCacheGeneration(void);
+extern bool SharedTypeCacheLookup(Oid type_id, SharedTypeCacheData *data);
+extern void SharedTypeCacheInsert(Oid type_id, const SharedTypeCacheData *data,
+								  uint64 generation);
+extern void SharedTypeCacheInvalidate(const SharedInvalidationMessage *msgs,
+									  int n);
+extern void SharedTypeCacheDropDatabase(Oid dbid);
+
+#endif							/* SHAREDTYPCACHE_H */
@@ -48,6 +48,7 @@ enum SysCacheIdentifier
 	CLAOID,
 	COLLNAMEENCNSP,
 	COLLOID,
+	COMPRESSIONDICTOID,
 	CONDEFAULT,
 	CONNAMENSP,
 	CONSTROID,
@@ -36,6 +36,9 @@
 typedef struct Tuplesortstate Tuplesortstate;
 typedef struct Sharedsort Sharedsort;
 
+struct BrinTuple;					/* avoid including brin_tuple.h here */
+struct GinTuple;					/* avoid including gin_private.h here */
+
 /*
  * Tuplesort parallel coordination state, allocated by each participant in
  * local memory.  Participant caller initializes everything.  See usage notes
@@ -97,6 +100,12 @@ typedef enum
 /* specifies if the tuplesort is able to support bounded sorts */
 #define TUPLESORT_ALLOWBOUNDED			(1 << 1)
 
+/*
+ * Tuples of sorts that never need to pfree individual tuples are stored in a
+ * bump.c context, on which GetMemoryChunkSpace can't be used.
+ */
+#define TupleSortUseBumpTupleCxt(opt) (((opt) & TUPLESORT_ALLOWBOUNDED) == 0)
+
 typedef struct TuplesortInstrumentation
 {
 	TuplesortMethod sortMethod; /* sort algorithm used */
@@ -300,8 +309,11 @@ typedef struct
  * 5. tuplesort_attach_shared() should be called by all workers.  Feed tuples
  *    to each worker, and call tuplesort_performsort() within each when input
  *    is exhausted.
- * 6. Call tuplesort_end() in each worker process.  Worker processes can shut
- *    down once tuplesort_end() returns.
+ * 6. Once the worker has told the leader that it is done, call
+ *    tuplesort_merge_ranges() and then tuplesort_end() in each worker
+ *    process.  tuplesort_merge_ranges() waits for the leader to reach step 8,
+ *    and may then merge part of the sort's output on the leader's behalf.
+ *    Worker processes can shut down once tuplesort_end() returns.
  * 7. Begin a tuplesort in the leader using the same tuplesort_begin*
  *    routine, passing a leader-appropriate coordinate argument (this can
  *    happen as early as during step 3, actually, since we only need to know
@@ -329,8 +341,9 @@ typedef struct
  * worker process.  The steps above don't touch on this directly.  The only
  * difference is that the tuplesort_attach_shared() call is never needed within
  * leader process, because the backend as a whole holds the shared fileset
- * reference.  A worker Tuplesortstate in leader is expected to do exactly the
- * same amount of total initial processing work as a worker process
+ * reference, and that tuplesort_merge_ranges() must not be called for it.
+ * A worker Tuplesortstate in leader is expected to do exactly the same
+ * amount of total initial processing work as a worker process
  * Tuplesortstate, since the leader process has nothing else to do before
  * workers finish.
  *
@@ -349,6 +362,8 @@ typedef struct
  * generated (typically, caller uses a parallel heap scan).
  */
 
+/* GUC variables */
+extern PGDLLIMPORT bool parallel_sort_merge;
 
 extern Tuplesortstate *tuplesort_begin_common(int workMem,
 											  SortCoordinate coordinate,
@@ -356,12 +371,15 @@ extern Tuplesortstate *tuplesort_begin_common(int workMem,
 extern void tuplesort_set_bound(Tuplesortstate *state, int64 bound);
 extern bool tuplesort_used_bound(Tuplesortstate *state);
 extern void tuplesort_puttuple_common(Tuplesortstate *state,
-									  SortTuple *tuple, bool useAbbrev);
+									  SortTuple *tuple, bool useAbbrev,
+									  Size tuplen);
 extern void tuplesort_performsort(Tuplesortstate *state);
 extern bool tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 									  SortTuple *stup);
 extern bool tuplesort_skiptuples(Tuplesortstate *state, int64 ntuples,
 								 bool forward);
+extern bool tuplesort_peek_common(Tuplesortstate *state, int64 n,
+								  SortTuple *stup);
 extern void tuplesort_end(Tuplesortstate *state);
 extern void tuplesort_reset(Tuplesortstate *state);
 
@@ -376,6 +394,7 @@ extern Size tuplesort_estimate_shared(int nWorkers);
 extern void tuplesort_initialize_shared(Sharedsort *shared, int nWorkers,
 										dsm_segment *seg);
 extern void tuplesort_attach_shared(Sharedsort *shared, dsm_segment *seg);
+extern void tuplesort_merge_ranges(Tuplesortstate *state);
 
 /*
  * These routines may only be called if TUPLESORT_RANDOMACCESS was specified
@@ -419,6 +438,13 @@ extern Tuplesortstate *tuplesort_begin_index_gist(Relation heapRel,
 												  Relation indexRel,
 												  int workMem, SortCoordinate coordinate,
 												  int sortopt);
+extern Tuplesortstate *tuplesort_begin_index_brin(int workMem,
+												  SortCoordinate coordinate,
+												  int sortopt);
+extern Tuplesortstate *tuplesort_begin_index_gin(Relation heapRel,
+												 Relation indexRel,
+												 int workMem, SortCoordinate coordinate,
+												 int sortopt);
 extern Tuplesortstate *tuplesort_begin_datum(Oid datumType,
 											 Oid sortOperator, Oid sortCollation,
 											 bool nullsFirstFlag,
@@ -433,13 +459,23 @@ extern void tuplesort_putindextuplevalues(Tuplesortstate *state,
 										  Datum *values, bool *isnull);
 extern void tuplesort_putdatum(Tuplesortstate *state, Datum val,
 							   bool isNull);
+extern void tuplesort_putbrintuple(Tuplesortstate *state,
+								   struct BrinTuple *tuple, Size size);
+extern void tuplesort_putgintuple(Tuplesortstate *state,
+								  struct GinTuple *tuple);
 
 extern bool tuplesort_gettupleslot(Tuplesortstate *state, bool forward,
 								   bool copy, TupleTableSlot *slot, Datum *abbrev);
+extern bool tuplesort_peektupleslot(Tuplesortstate *state, int64 n,
+									TupleTableSlot *slot);
 extern HeapTuple tuplesort_getheaptuple(Tuplesortstate *state, bool forward);
 extern IndexTuple tuplesort_getindextuple(Tuplesortstate *state, bool forward);
 extern bool tuplesort_getdatum(Tuplesortstate *state, bool forward, bool copy,
 							   Datum *val, bool *isNull, Datum *abbrev);
+extern struct BrinTuple *tuplesort_getbrintuple(Tuplesortstate *state,
+												Size *len, bool forward);
+extern struct GinTuple *tuplesort_getgintuple(Tuplesortstate *state,
+											  bool forward);
 
 
 #endif							/* TUPLESORT_H */
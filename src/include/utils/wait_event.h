@@ -43,6 +43,7 @@ typedef enum
 	WAIT_EVENT_LOGICAL_APPLY_MAIN,
 	WAIT_EVENT_LOGICAL_LAUNCHER_MAIN,
 	WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN,
+	WAIT_EVENT_PARALLEL_WORKER_POOL_MAIN,
 	WAIT_EVENT_RECOVERY_WAL_STREAM,
 	WAIT_EVENT_SYSLOGGER_MAIN,
 	WAIT_EVENT_WAL_RECEIVER_MAIN,
@@ -83,6 +84,7 @@ typedef enum
 	WAIT_EVENT_ARCHIVE_CLEANUP_COMMAND,
 	WAIT_EVENT_ARCHIVE_COMMAND,
 	WAIT_EVENT_BACKEND_TERMINATION,
+	WAIT_EVENT_BACKUP_WAIT_PARALLEL_WORKERS,
 	WAIT_EVENT_BACKUP_WAIT_WAL_ARCHIVE,
 	WAIT_EVENT_BGWORKER_SHUTDOWN,
 	WAIT_EVENT_BGWORKER_STARTUP,
@@ -91,6 +93,7 @@ typedef enum
 	WAIT_EVENT_CHECKPOINT_DONE,
 	WAIT_EVENT_CHECKPOINT_START,
 	WAIT_EVENT_EXECUTE_GATHER,
+	WAIT_EVENT_HASH_AGG_PARTITION,
 	WAIT_EVENT_HASH_BATCH_ALLOCATE,
 	WAIT_EVENT_HASH_BATCH_ELECT,
 	WAIT_EVENT_HASH_BATCH_LOAD,
@@ -110,6 +113,7 @@ typedef enum
 	WAIT_EVENT_LOGICAL_PARALLEL_APPLY_STATE_CHANGE,
 	WAIT_EVENT_LOGICAL_SYNC_DATA,
 	WAIT_EVENT_LOGICAL_SYNC_STATE_CHANGE,
+	WAIT_EVENT_MEMORY_CONTEXT_PUBLISH,
 	WAIT_EVENT_MQ_INTERNAL,
 	WAIT_EVENT_MQ_PUT_MESSAGE,
 	WAIT_EVENT_MQ_RECEIVE,
@@ -117,6 +121,9 @@ typedef enum
 	WAIT_EVENT_PARALLEL_BITMAP_SCAN,
 	WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN,
 	WAIT_EVENT_PARALLEL_FINISH,
+	WAIT_EVENT_PARALLEL_REDO_BARRIER,
+	WAIT_EVENT_PARALLEL_SORT_PLAN,
+	WAIT_EVENT_PARALLEL_SORT_RANGE,
 	WAIT_EVENT_PROCARRAY_GROUP_UPDATE,
 	WAIT_EVENT_PROC_SIGNAL_BARRIER,
 	WAIT_EVENT_PROMOTE,
@@ -129,6 +136,7 @@ typedef enum
 	WAIT_EVENT_RESTORE_COMMAND,
 	WAIT_EVENT_SAFE_SNAPSHOT,
 	WAIT_EVENT_SYNC_REP,
+	WAIT_EVENT_WAL_FLUSH_GROUP,
 	WAIT_EVENT_WAL_RECEIVER_EXIT,
 	WAIT_EVENT_WAL_RECEIVER_WAIT_START,
 	WAIT_EVENT_XACT_GROUP_UPDATE
@@ -143,6 +151,7 @@ typedef enum
 typedef enum
 {
 	WAIT_EVENT_BASE_BACKUP_THROTTLE = PG_WAIT_TIMEOUT,
+	WAIT_EVENT_CHECKPOINT_SYNC_DELAY,
 	WAIT_EVENT_CHECKPOINT_WRITE_DELAY,
 	WAIT_EVENT_PG_SLEEP,
 	WAIT_EVENT_RECOVERY_APPLY_DELAY,
@@ -161,7 +170,10 @@ typedef enum
  */
 typedef enum
 {
-	WAIT_EVENT_BASEBACKUP_READ = PG_WAIT_IO,
+	WAIT_EVENT_AIO_IO_COMPLETION = PG_WAIT_IO,
+	WAIT_EVENT_AUTOPREWARM_DUMP_READ,
+	WAIT_EVENT_AUTOPREWARM_DUMP_WRITE,
+	WAIT_EVENT_BASEBACKUP_READ,
 	WAIT_EVENT_BASEBACKUP_SYNC,
 	WAIT_EVENT_BASEBACKUP_WRITE,
 	WAIT_EVENT_BUFFILE_READ,
@@ -247,6 +259,11 @@ extern void pgstat_reset_wait_event_storage(void);
 
 extern PGDLLIMPORT uint32 *my_wait_event_info;
 
+/* in pgstat_wait.c */
+extern PGDLLIMPORT bool pgstat_track_wait_timing;
+extern void pgstat_count_wait_start(uint32 wait_event_info);
+extern void pgstat_count_wait_end(void);
+
 
 /* ----------
  * pgstat_report_wait_start() -
@@ -265,6 +282,9 @@ extern PGDLLIMPORT uint32 *my_wait_event_info;
  *
  *	my_wait_event_info initially points to local memory, making it safe to
  *	call this before MyProc has been initialized.
+ *
+ *	With track_wait_timing, the wait is also timed for the cumulative wait
+ *	event statistics.
  * ----------
  */
 static inline void
@@ -275,6 +295,9 @@ pgstat_report_wait_start(uint32 wait_event_info)
 	 * four-bytes, updates are atomic.
 	 */
 	*(volatile uint32 *) my_wait_event_info = wait_event_info;
+
+	if (unlikely(pgstat_track_wait_timing))
+		pgstat_count_wait_start(wait_event_info);
 }
 
 /* ----------
@@ -286,6 +309,9 @@ pgstat_report_wait_start(uint32 wait_event_info)
 static inline void
 pgstat_report_wait_end(void)
 {
+	if (unlikely(pgstat_track_wait_timing))
+		pgstat_count_wait_end();
+
 	/* see pgstat_report_wait_start() */
 	*(volatile uint32 *) my_wait_event_info = 0;
 }
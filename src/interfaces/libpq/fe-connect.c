@@ -361,6 +361,10 @@ static const internalPQconninfoOption PQconninfoOptions[] = {
 		"Load-Balance-Hosts", "", 8,	/* sizeof("disable") = 8 */
 	offsetof(struct pg_conn, load_balance_hosts)},
 
+	{"compression", "PGCOMPRESSION", NULL, NULL,
+		"Protocol-Compression", "", 16, /* sizeof("zstd:-131072") = 13 */
+	offsetof(struct pg_conn, compression)},
+
 	/* Terminating entry --- MUST BE LAST */
 	{NULL, NULL, NULL, NULL,
 	NULL, NULL, 0}
@@ -483,6 +487,16 @@ pqDropConnection(PGconn *conn, bool flushInput)
 	/* Always discard any unsent data */
 	conn->outCount = 0;
 
+	/* Drop protocol compression state; the next connection starts afresh */
+	if (conn->zstream)
+	{
+		zs_free(conn->zstream);
+		conn->zstream = NULL;
+	}
+	conn->zoutData = NULL;
+	conn->zoutStart = conn->zoutEnd = conn->zoutConsumed = 0;
+	conn->zinStart = conn->zinEnd = 0;
+
 	/* Likewise, discard any pending pipelined commands */
 	pqFreeCommandQueue(conn->cmd_queue_head);
 	conn->cmd_queue_head = conn->cmd_queue_tail = NULL;
@@ -1711,6 +1725,23 @@ connectOptions2(PGconn *conn)
 	else
 		conn->load_balance_type = LOAD_BALANCE_DISABLE;
 
+	/*
+	 * validate compression option, and set compress_algorithm
+	 */
+	conn->compress_algorithm = PG_COMPRESSION_NONE;
+	conn->compress_level = 0;
+	if (conn->compression && conn->compression[0])
+	{
+		if (!zs_parse_spec(conn->compression, &conn->compress_algorithm,
+						   &conn->compress_level))
+		{
+			conn->status = CONNECTION_BAD;
+			libpq_append_conn_error(conn, "invalid %s value: \"%s\"",
+									"compression", conn->compression);
+			return false;
+		}
+	}
+
 	if (conn->load_balance_type == LOAD_BALANCE_RANDOM)
 	{
 		libpq_prng_init(conn);
@@ -3824,6 +3855,14 @@ keep_going:						/* We will come back to here until there is
 					/* We are done with authentication exchange */
 					conn->status = CONNECTION_AUTH_OK;
 
+					/*
+					 * Everything the server sends after AuthenticationOk is
+					 * compressed, if we asked for that.
+					 */
+					if (conn->compress_algorithm != PG_COMPRESSION_NONE &&
+						pqEnableCompression(conn) != 0)
+						goto error_return;
+
 					/*
 					 * Set asyncStatus so that PQgetResult will think that
 					 * what comes back next is the result of a query.  See
@@ -4462,6 +4501,8 @@ freePGconn(PGconn *conn)
 	free(conn->rowBuf);
 	free(conn->target_session_attrs);
 	free(conn->load_balance_hosts);
+	free(conn->compression);
+	free(conn->zinBuffer);
 	termPQExpBuffer(&conn->errorMessage);
 	termPQExpBuffer(&conn->workBuffer);
 
@@ -41,7 +41,8 @@ char	   *const pgresStatus[] = {
 	"PGRES_COPY_BOTH",
 	"PGRES_SINGLE_TUPLE",
 	"PGRES_PIPELINE_SYNC",
-	"PGRES_PIPELINE_ABORTED"
+	"PGRES_PIPELINE_ABORTED",
+	"PGRES_TUPLES_CHUNK"
 };
 
 /* We return this if we're unable to make a PGresult at all */
@@ -199,6 +200,7 @@ PQmakeEmptyPGresult(PGconn *conn, ExecStatusType status)
 			case PGRES_COPY_IN:
 			case PGRES_COPY_BOTH:
 			case PGRES_SINGLE_TUPLE:
+			case PGRES_TUPLES_CHUNK:
 				/* non-error cases */
 				break;
 			default:
@@ -1197,10 +1199,15 @@ pqSaveParameterStatus(PGconn *conn, const char *name, const char *value)
  * (Such a string should already be translated via libpq_gettext().)
  * If it is left NULL, the error is presumed to be "out of memory".
  *
- * In single-row mode, we create a new result holding just the current row,
- * stashing the previous result in conn->next_result so that it becomes
- * active again after pqPrepareAsyncResult().  This allows the result metadata
- * (column descriptions) to be carried forward to each result row.
+ * In single-row and chunked-rows mode, we create a new result to collect the
+ * rows in, stashing the previous result in conn->next_result so that it
+ * becomes active again after pqPrepareAsyncResult().  This allows the result
+ * metadata (column descriptions) to be carried forward to each partial
+ * result.  Once the partial result holds conn->maxChunkSize rows, it is made
+ * available to the client.
+ *
+ * If the client set a row callback, the row is passed to it in place and not
+ * stored at all.
  */
 int
 pqRowProcessor(PGconn *conn, const char **errmsgp)
@@ -1212,11 +1219,26 @@ pqRowProcessor(PGconn *conn, const char **errmsgp)
 	int			i;
 
 	/*
-	 * In single-row mode, make a new PGresult that will hold just this one
-	 * row; the original conn->result is left unchanged so that it can be used
-	 * again as the template for future rows.
+	 * With a row callback, the field values are handed over straight from
+	 * the input buffer.
+	 */
+	if (conn->rowCallback)
+	{
+		if (!conn->rowCallback(res, columns, conn->rowCallbackArg))
+		{
+			*errmsgp = libpq_gettext("row callback failed");
+			return 0;
+		}
+		return 1;
+	}
+
+	/*
+	 * In single-row or chunked-rows mode, if there's no partial PGresult yet,
+	 * make a new one to hold the rows; the original conn->result is left
+	 * unchanged so that it can be used again as the template for future
+	 * partial results.
 	 */
-	if (conn->singleRowMode)
+	if (conn->maxChunkSize > 0 && conn->next_result == NULL)
 	{
 		/* Copy everything that should be in the result at this point */
 		res = PQcopyResult(res,
@@ -1224,6 +1246,12 @@ pqRowProcessor(PGconn *conn, const char **errmsgp)
 						   PG_COPYRES_NOTICEHOOKS);
 		if (!res)
 			return 0;
+		/* Change result status to the appropriate special value */
+		res->resultStatus = (conn->singleRowMode ? PGRES_SINGLE_TUPLE :
+							 PGRES_TUPLES_CHUNK);
+		/* Stash old result for re-use later */
+		conn->next_result = conn->result;
+		conn->result = res;
 	}
 
 	/*
@@ -1273,26 +1301,16 @@ pqRowProcessor(PGconn *conn, const char **errmsgp)
 		goto fail;
 
 	/*
-	 * Success.  In single-row mode, make the result available to the client
-	 * immediately.
+	 * Success.  In single-row or chunked-rows mode, make the partial result
+	 * available to the client once it's full.
 	 */
-	if (conn->singleRowMode)
-	{
-		/* Change result status to special single-row value */
-		res->resultStatus = PGRES_SINGLE_TUPLE;
-		/* Stash old result for re-use later */
-		conn->next_result = conn->result;
-		conn->result = res;
-		/* And mark the result ready to return */
+	if (conn->maxChunkSize > 0 && res->ntups >= conn->maxChunkSize)
 		conn->asyncStatus = PGASYNC_READY_MORE;
-	}
 
 	return 1;
 
 fail:
-	/* release locally allocated PGresult, if we made one */
-	if (res != conn->result)
-		PQclear(res);
+	/* a partial result is conn->result now, caller will clean it up */
 	return 0;
 }
 
@@ -1742,8 +1760,11 @@ PQsendQueryStart(PGconn *conn, bool newQuery)
 		 */
 		pqClearAsyncResult(conn);
 
-		/* reset single-row processing mode */
+		/* reset single-row and chunked-rows processing modes */
 		conn->singleRowMode = false;
+		conn->maxChunkSize = 0;
+		conn->rowCallback = NULL;
+		conn->rowCallbackArg = NULL;
 	}
 
 	/* ready to send command message */
@@ -1945,6 +1966,72 @@ PQsetSingleRowMode(PGconn *conn)
 
 	/* OK, set flag */
 	conn->singleRowMode = true;
+	conn->maxChunkSize = 1;
+	return 1;
+}
+
+/*
+ * Select chunked-rows processing mode
+ *
+ * This is like single-row mode, but up to chunkSize rows are returned in
+ * each PGRES_TUPLES_CHUNK result, saving the per-result overhead.
+ */
+int
+PQsetChunkedRowsMode(PGconn *conn, int chunkSize)
+{
+	/*
+	 * Only allow setting the mode when we have launched a query and not yet
+	 * received any results.
+	 */
+	if (!conn)
+		return 0;
+	if (chunkSize <= 0)
+		return 0;
+	if (conn->asyncStatus != PGASYNC_BUSY)
+		return 0;
+	if (!conn->cmd_queue_head ||
+		(conn->cmd_queue_head->queryclass != PGQUERY_SIMPLE &&
+		 conn->cmd_queue_head->queryclass != PGQUERY_EXTENDED))
+		return 0;
+	if (pgHavePendingResult(conn))
+		return 0;
+
+	/* OK, set mode */
+	conn->singleRowMode = false;
+	conn->maxChunkSize = chunkSize;
+	return 1;
+}
+
+/*
+ * Select a row callback for the current query
+ *
+ * Each row is passed to the callback as soon as it has been received, with
+ * the field values pointing directly into the connection's input buffer, and
+ * is not stored in any PGresult.  The callback returns nonzero to continue;
+ * if it returns zero, the rest of the result is discarded and the query
+ * reports an error.  The final PGRES_TUPLES_OK result holds no rows.
+ */
+int
+PQsetRowCallback(PGconn *conn, PQrowCallback callback, void *arg)
+{
+	/*
+	 * Only allow setting the callback when we have launched a query and not
+	 * yet received any results.
+	 */
+	if (!conn)
+		return 0;
+	if (conn->asyncStatus != PGASYNC_BUSY)
+		return 0;
+	if (!conn->cmd_queue_head ||
+		(conn->cmd_queue_head->queryclass != PGQUERY_SIMPLE &&
+		 conn->cmd_queue_head->queryclass != PGQUERY_EXTENDED))
+		return 0;
+	if (pgHavePendingResult(conn))
+		return 0;
+
+	/* OK, set callback */
+	conn->rowCallback = callback;
+	conn->rowCallbackArg = arg;
 	return 1;
 }
 
@@ -3070,10 +3157,13 @@ pqPipelineProcessQueue(PGconn *conn)
 	}
 
 	/*
-	 * Reset single-row processing mode.  (Client has to set it up for each
-	 * query, if desired.)
+	 * Reset single-row and chunked-rows processing modes, and the row
+	 * callback.  (Client has to set them up for each query, if desired.)
 	 */
 	conn->singleRowMode = false;
+	conn->maxChunkSize = 0;
+	conn->rowCallback = NULL;
+	conn->rowCallbackArg = NULL;
 
 	/*
 	 * If there are no further commands to process in the queue, get us in
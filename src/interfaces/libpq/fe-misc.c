@@ -53,6 +53,10 @@
 
 static int	pqPutMsgBytes(const void *buf, size_t len, PGconn *conn);
 static int	pqSendSome(PGconn *conn, int len);
+static ssize_t pqReadSome(PGconn *conn, void *ptr, size_t len);
+static int	pqSendSomeCompressed(PGconn *conn, int len);
+static int	pqSendFailed(PGconn *conn);
+static int	pqSendWait(PGconn *conn);
 static int	pqSocketCheck(PGconn *conn, int forRead, int forWrite,
 						  time_t end_time);
 static int	pqSocketPoll(int sock, int forRead, int forWrite, time_t end_time);
@@ -614,8 +618,8 @@ pqReadData(PGconn *conn)
 
 	/* OK, try to read some data */
 retry3:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqReadSome(conn, conn->inBuffer + conn->inEnd,
+					   conn->inBufSize - conn->inEnd);
 	if (nread < 0)
 	{
 		switch (SOCK_ERRNO)
@@ -709,8 +713,8 @@ retry3:
 	 * arrived.
 	 */
 retry4:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqReadSome(conn, conn->inBuffer + conn->inEnd,
+					   conn->inBufSize - conn->inEnd);
 	if (nread < 0)
 	{
 		switch (SOCK_ERRNO)
@@ -760,6 +764,120 @@ definitelyFailed:
 	return -1;
 }
 
+/*
+ * pqReadSome: read protocol data into ptr, with the same API as
+ * pqsecure_read().
+ *
+ * Once protocol compression has started, what arrives from the socket is
+ * collected in conn->zinBuffer, and this returns whatever can be
+ * decompressed from it.  The socket is read only when the decompressor
+ * cannot make progress on the data it already has.
+ */
+static ssize_t
+pqReadSome(PGconn *conn, void *ptr, size_t len)
+{
+	if (conn->zstream == NULL)
+		return pqsecure_read(conn, ptr, len);
+
+	for (;;)
+	{
+		ssize_t		nread;
+
+		if (conn->zinStart < conn->zinEnd || zs_read_pending(conn->zstream))
+		{
+			size_t		used;
+			ssize_t		n;
+
+			n = zs_decompress(conn->zstream,
+							  conn->zinBuffer + conn->zinStart,
+							  conn->zinEnd - conn->zinStart, &used,
+							  ptr, len);
+			if (n < 0)
+			{
+				libpq_append_conn_error(conn, "could not decompress data from server: %s",
+										zs_errmsg(conn->zstream));
+				SOCK_ERRNO_SET(0);
+				return -1;
+			}
+			conn->zinStart += used;
+			if (n > 0)
+				return n;
+		}
+
+		/* decompressor wants more input; make room for it */
+		if (conn->zinStart == conn->zinEnd)
+			conn->zinStart = conn->zinEnd = 0;
+		if (conn->zinBufSize - conn->zinEnd < 8192)
+		{
+			int			newsize = Max(conn->zinBufSize * 2, 16 * 1024);
+			char	   *newbuf;
+
+			newbuf = realloc(conn->zinBuffer, newsize);
+			if (newbuf == NULL)
+			{
+				libpq_append_conn_error(conn, "out of memory");
+				SOCK_ERRNO_SET(0);
+				return -1;
+			}
+			conn->zinBuffer = newbuf;
+			conn->zinBufSize = newsize;
+		}
+
+		nread = pqsecure_read(conn, conn->zinBuffer + conn->zinEnd,
+							  conn->zinBufSize - conn->zinEnd);
+		if (nread <= 0)
+			return nread;
+		conn->zinEnd += nread;
+	}
+}
+
+/*
+ * pqEnableCompression: start protocol compression, right after the server
+ * has sent AuthenticationOk.
+ *
+ * Whatever has already been read beyond that message was compressed by the
+ * server, so it is moved over to the compressed input buffer.
+ *
+ * Returns 0 on success, -1 on failure with conn->errorMessage set.
+ */
+int
+pqEnableCompression(PGconn *conn)
+{
+	int			avail = conn->inEnd - conn->inStart;
+
+	Assert(conn->zstream == NULL);
+	Assert(conn->outCount == 0);
+
+	conn->zstream = zs_create(conn->compress_algorithm, conn->compress_level);
+	if (conn->zstream == NULL)
+	{
+		libpq_append_conn_error(conn, "could not initialize protocol compression");
+		return -1;
+	}
+
+	if (avail > 0)
+	{
+		if (conn->zinBufSize < avail)
+		{
+			char	   *newbuf = realloc(conn->zinBuffer, avail);
+
+			if (newbuf == NULL)
+			{
+				libpq_append_conn_error(conn, "out of memory");
+				return -1;
+			}
+			conn->zinBuffer = newbuf;
+			conn->zinBufSize = avail;
+		}
+		memcpy(conn->zinBuffer, conn->inBuffer + conn->inStart, avail);
+	}
+	conn->zinStart = 0;
+	conn->zinEnd = avail;
+	conn->inEnd = conn->inCursor = conn->inStart;
+
+	return 0;
+}
+
 /*
  * pqSendSome: send data waiting in the output buffer.
  *
@@ -801,6 +919,7 @@ pqSendSome(PGconn *conn, int len)
 	{
 		/* conn->write_err_msg should be set up already */
 		conn->outCount = 0;
+		conn->zoutStart = conn->zoutEnd = conn->zoutConsumed = 0;
 		/* Absorb input data if any, and detect socket closure */
 		if (conn->sock != PGINVALID_SOCKET)
 		{
@@ -821,6 +940,9 @@ pqSendSome(PGconn *conn, int len)
 		return 0;
 	}
 
+	if (conn->zstream)
+		return pqSendSomeCompressed(conn, len);
+
 	/* while there's still data to send */
 	while (len > 0)
 	{
@@ -855,27 +977,7 @@ pqSendSome(PGconn *conn, int len)
 					continue;
 
 				default:
-					/* Discard queued data; no chance it'll ever be sent */
-					conn->outCount = 0;
-
-					/* Absorb input data if any, and detect socket closure */
-					if (conn->sock != PGINVALID_SOCKET)
-					{
-						if (pqReadData(conn) < 0)
-							return -1;
-					}
-
-					/*
-					 * Lower-level code should already have filled
-					 * conn->write_err_msg (and set conn->write_failed) or
-					 * conn->errorMessage.  In the former case, we pretend
-					 * there's no problem; the write_failed condition will be
-					 * dealt with later.  Otherwise, report the error now.
-					 */
-					if (conn->write_failed)
-						return 0;
-					else
-						return -1;
+					return pqSendFailed(conn);
 			}
 		}
 		else
@@ -887,59 +989,181 @@ pqSendSome(PGconn *conn, int len)
 
 		if (len > 0)
 		{
-			/*
-			 * We didn't send it all, wait till we can send more.
-			 *
-			 * There are scenarios in which we can't send data because the
-			 * communications channel is full, but we cannot expect the server
-			 * to clear the channel eventually because it's blocked trying to
-			 * send data to us.  (This can happen when we are sending a large
-			 * amount of COPY data, and the server has generated lots of
-			 * NOTICE responses.)  To avoid a deadlock situation, we must be
-			 * prepared to accept and buffer incoming data before we try
-			 * again.  Furthermore, it is possible that such incoming data
-			 * might not arrive until after we've gone to sleep.  Therefore,
-			 * we wait for either read ready or write ready.
-			 *
-			 * In non-blocking mode, we don't wait here directly, but return 1
-			 * to indicate that data is still pending.  The caller should wait
-			 * for both read and write ready conditions, and call
-			 * PQconsumeInput() on read ready, but just in case it doesn't, we
-			 * call pqReadData() ourselves before returning.  That's not
-			 * enough if the data has not arrived yet, but it's the best we
-			 * can do, and works pretty well in practice.  (The documentation
-			 * used to say that you only need to wait for write-ready, so
-			 * there are still plenty of applications like that out there.)
-			 *
-			 * Note that errors here don't result in write_failed becoming
-			 * set.
-			 */
-			if (pqReadData(conn) < 0)
-			{
-				result = -1;	/* error message already set up */
+			/* We didn't send it all, wait till we can send more */
+			result = pqSendWait(conn);
+			if (result != 0)
 				break;
+		}
+	}
+
+	/* shift the remaining contents of the buffer */
+	if (remaining > 0)
+		memmove(conn->outBuffer, ptr, remaining);
+	conn->outCount = remaining;
+
+	return result;
+}
+
+/*
+ * pqSendSomeCompressed: pqSendSome() once protocol compression has started.
+ *
+ * The front of the output buffer is compressed into conn->zoutData, which
+ * conn->zoutConsumed records.  Those bytes stay in outBuffer until all of
+ * their compressed form has been sent, so a partial send in non-blocking
+ * mode just resumes from conn->zoutStart on the next call.
+ */
+static int
+pqSendSomeCompressed(PGconn *conn, int len)
+{
+	for (;;)
+	{
+		int			sent;
+		int			result;
+
+		if (conn->zoutStart == conn->zoutEnd)
+		{
+			size_t		zlen;
+
+			/* the previous piece is out, so drop it from the buffer */
+			if (conn->zoutConsumed > 0)
+			{
+				conn->outCount -= conn->zoutConsumed;
+				if (conn->outCount > 0)
+					memmove(conn->outBuffer,
+							conn->outBuffer + conn->zoutConsumed,
+							conn->outCount);
+				len -= conn->zoutConsumed;
+				conn->zoutConsumed = 0;
 			}
+			if (len <= 0)
+				return 0;
 
-			if (pqIsnonblocking(conn))
+			conn->zoutData = zs_compress(conn->zstream, conn->outBuffer, len,
+										 &zlen);
+			if (conn->zoutData == NULL)
 			{
-				result = 1;
-				break;
+				libpq_append_conn_error(conn, "could not compress data: %s",
+										zs_errmsg(conn->zstream));
+				/* the stream is out of sync now; nothing more can be sent */
+				conn->outCount = 0;
+				return -1;
 			}
+			conn->zoutStart = 0;
+			conn->zoutEnd = (int) zlen;
+			conn->zoutConsumed = len;
+		}
+
+#ifndef WIN32
+		sent = pqsecure_write(conn, conn->zoutData + conn->zoutStart,
+							  conn->zoutEnd - conn->zoutStart);
+#else
+		/* see pqSendSome */
+		sent = pqsecure_write(conn, conn->zoutData + conn->zoutStart,
+							  Min(conn->zoutEnd - conn->zoutStart, 65536));
+#endif
 
-			if (pqWait(true, true, conn))
+		if (sent < 0)
+		{
+			switch (SOCK_ERRNO)
 			{
-				result = -1;
-				break;
+#ifdef EAGAIN
+				case EAGAIN:
+					break;
+#endif
+#if defined(EWOULDBLOCK) && (!defined(EAGAIN) || (EWOULDBLOCK != EAGAIN))
+				case EWOULDBLOCK:
+					break;
+#endif
+				case EINTR:
+					continue;
+
+				default:
+					return pqSendFailed(conn);
 			}
 		}
+		else
+			conn->zoutStart += sent;
+
+		if (conn->zoutStart < conn->zoutEnd)
+		{
+			result = pqSendWait(conn);
+			if (result != 0)
+				return result;
+		}
 	}
+}
 
-	/* shift the remaining contents of the buffer */
-	if (remaining > 0)
-		memmove(conn->outBuffer, ptr, remaining);
-	conn->outCount = remaining;
+/*
+ * pqSendFailed: clean up after a hard failure to write to the socket.
+ *
+ * Returns the value pqSendSome should return.
+ */
+static int
+pqSendFailed(PGconn *conn)
+{
+	/* Discard queued data; no chance it'll ever be sent */
+	conn->outCount = 0;
+	conn->zoutStart = conn->zoutEnd = conn->zoutConsumed = 0;
 
-	return result;
+	/* Absorb input data if any, and detect socket closure */
+	if (conn->sock != PGINVALID_SOCKET)
+	{
+		if (pqReadData(conn) < 0)
+			return -1;
+	}
+
+	/*
+	 * Lower-level code should already have filled conn->write_err_msg (and
+	 * set conn->write_failed) or conn->errorMessage.  In the former case, we
+	 * pretend there's no problem; the write_failed condition will be dealt
+	 * with later.  Otherwise, report the error now.
+	 */
+	if (conn->write_failed)
+		return 0;
+	else
+		return -1;
+}
+
+/*
+ * pqSendWait: we didn't send it all, wait till we can send more.
+ *
+ * There are scenarios in which we can't send data because the communications
+ * channel is full, but we cannot expect the server to clear the channel
+ * eventually because it's blocked trying to send data to us.  (This can
+ * happen when we are sending a large amount of COPY data, and the server has
+ * generated lots of NOTICE responses.)  To avoid a deadlock situation, we
+ * must be prepared to accept and buffer incoming data before we try again.
+ * Furthermore, it is possible that such incoming data might not arrive until
+ * after we've gone to sleep.  Therefore, we wait for either read ready or
+ * write ready.
+ *
+ * In non-blocking mode, we don't wait here directly, but return 1 to indicate
+ * that data is still pending.  The caller should wait for both read and write
+ * ready conditions, and call PQconsumeInput() on read ready, but just in case
+ * it doesn't, we call pqReadData() ourselves before returning.  That's not
+ * enough if the data has not arrived yet, but it's the best we can do, and
+ * works pretty well in practice.  (The documentation used to say that you
+ * only need to wait for write-ready, so there are still plenty of
+ * applications like that out there.)
+ *
+ * Note that errors here don't result in write_failed becoming set.
+ *
+ * Returns 0 if the caller should try to send again, else the value pqSendSome
+ * should return.
+ */
+static int
+pqSendWait(PGconn *conn)
+{
+	if (pqReadData(conn) < 0)
+		return -1;				/* error message already set up */
+
+	if (pqIsnonblocking(conn))
+		return 1;
+
+	if (pqWait(true, true, conn))
+		return -1;
+
+	return 0;
 }
 
 
@@ -1057,6 +1281,11 @@ pqSocketCheck(PGconn *conn, int forRead, int forWrite, time_t end_time)
 	}
 #endif
 
+	/* Likewise for data the decompressor has not handed out yet */
+	if (forRead && conn->zstream &&
+		(conn->zinStart < conn->zinEnd || zs_read_pending(conn->zstream)))
+		return 1;
+
 	/* We will retry as long as we get EINTR */
 	do
 		result = pqSocketPoll(conn->sock, forRead, forWrite, end_time);
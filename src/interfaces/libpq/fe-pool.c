@@ -0,0 +1,525 @@
+/*-------------------------------------------------------------------------
+ *
+ * fe-pool.c
+ *	  functions for keeping a pool of connections to the backend
+ *
+ * A PGpool holds up to maxConns connections made with one conninfo string,
+ * and keeps at least minConns of them open.  Connections are established
+ * asynchronously with PQconnectStart()/PQconnectPoll(), several at a time,
+ * and the pool is driven by PQpoolPoll() from the application's event loop,
+ * which can wait on the sockets PQpoolSockets() reports.  Failed connection
+ * attempts are retried with randomized exponential backoff, so that a
+ * restarting server isn't met by every client reconnecting at once.
+ *
+ * Each connection is set up independently, so multi-host conninfo with
+ * load_balance_hosts=random spreads the pool over the hosts, and
+ * target_session_attrs picks which of them are eligible; a pool for read
+ * traffic would typically use target_session_attrs=prefer-standby.
+ *
+ * All pool functions may be called from several threads; a connection that
+ * has been checked out belongs to the caller until it is released.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/interfaces/libpq/fe-pool.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres_fe.h"
+
+#include "common/pg_prng.h"
+#include "libpq-fe.h"
+#include "libpq-int.h"
+
+/* retry delays after failed connection attempts, in microseconds */
+#define POOL_BACKOFF_MIN	(100 * 1000)
+#define POOL_BACKOFF_MAX	(30 * 1000 * 1000)
+
+typedef enum
+{
+	POOL_SLOT_EMPTY,			/* no connection */
+	POOL_SLOT_CONNECTING,		/* connection being established */
+	POOL_SLOT_IDLE,				/* ready to be checked out */
+	POOL_SLOT_BUSY				/* checked out */
+} PGpoolSlotState;
+
+typedef struct
+{
+	PGpoolSlotState state;
+	PGconn	   *conn;
+	PostgresPollingStatusType pollstatus;	/* last PQconnectPoll() result */
+} PGpoolSlot;
+
+struct pg_pool
+{
+	char	   *conninfo;
+	int			minConns;
+	int			maxConns;
+	PGpoolSlot *slots;			/* array of maxConns slots */
+
+	int64		backoff;		/* current retry delay, or 0 */
+	int64		retryAt;		/* no new connections before this time */
+	char	   *errorMessage;	/* from the last failed attempt, or NULL */
+	pg_prng_state prng_state;	/* for backoff jitter */
+
+#ifdef ENABLE_THREAD_SAFETY
+	pthread_mutex_t lock;
+#endif
+};
+
+#ifdef ENABLE_THREAD_SAFETY
+#define POOL_LOCK(pool)		pthread_mutex_lock(&(pool)->lock)
+#define POOL_UNLOCK(pool)	pthread_mutex_unlock(&(pool)->lock)
+#else
+#define POOL_LOCK(pool)		((void) 0)
+#define POOL_UNLOCK(pool)	((void) 0)
+#endif
+
+static int64 pool_now(void);
+static void pool_start_connection(PGpool *pool, PGpoolSlot *slot, int64 now);
+static void pool_connection_failed(PGpool *pool, PGpoolSlot *slot, int64 now);
+static void pool_drop_connection(PGpoolSlot *slot);
+static bool pool_connection_usable(PGconn *conn);
+static int	pool_count_live(PGpool *pool);
+
+/*
+ * PQpoolCreate
+ *
+ * Create a pool of connections described by conninfo, and start opening
+ * minConns of them.  Returns NULL if out of memory or if the arguments are
+ * invalid; connection failures are reported by PQpoolErrorMessage() instead.
+ */
+PGpool *
+PQpoolCreate(const char *conninfo, int minConns, int maxConns)
+{
+	PGpool	   *pool;
+
+	if (conninfo == NULL || minConns < 0 || maxConns < 1 ||
+		minConns > maxConns)
+		return NULL;
+
+	pool = (PGpool *) calloc(1, sizeof(PGpool));
+	if (pool == NULL)
+		return NULL;
+	pool->conninfo = strdup(conninfo);
+	pool->slots = (PGpoolSlot *) calloc(maxConns, sizeof(PGpoolSlot));
+	if (pool->conninfo == NULL || pool->slots == NULL)
+	{
+		free(pool->conninfo);
+		free(pool->slots);
+		free(pool);
+		return NULL;
+	}
+	pool->minConns = minConns;
+	pool->maxConns = maxConns;
+
+	if (!pg_prng_strong_seed(&pool->prng_state))
+		pg_prng_seed(&pool->prng_state,
+					 ((uintptr_t) pool) ^ ((uint64) pool_now()));
+
+#ifdef ENABLE_THREAD_SAFETY
+	if (pthread_mutex_init(&pool->lock, NULL) != 0)
+	{
+		free(pool->conninfo);
+		free(pool->slots);
+		free(pool);
+		return NULL;
+	}
+#endif
+
+	/* start the initial connections straight away */
+	(void) PQpoolPoll(pool);
+
+	return pool;
+}
+
+/*
+ * PQpoolPoll
+ *
+ * Advance connections being established, check idle connections for
+ * closure by the server, and start new connections if the pool has fewer
+ * than minConns.  Never blocks, except that PQconnectStart() may need to
+ * resolve host names.
+ *
+ * Call this whenever one of the sockets reported by PQpoolSockets() is
+ * ready, and when the returned timeout has expired.  Returns the number of
+ * milliseconds until the pool next wants to be polled even without socket
+ * activity, because a connection attempt is due to be retried, or -1 if
+ * there is no such deadline.
+ */
+int
+PQpoolPoll(PGpool *pool)
+{
+	int64		now = pool_now();
+	int			live;
+	int			timeout = -1;
+
+	if (pool == NULL)
+		return -1;
+
+	POOL_LOCK(pool);
+
+	for (int i = 0; i < pool->maxConns; i++)
+	{
+		PGpoolSlot *slot = &pool->slots[i];
+
+		if (slot->state == POOL_SLOT_CONNECTING)
+		{
+			int			ready;
+
+			/*
+			 * PQconnectPoll() must only be called once the socket is ready
+			 * for what it last asked for.
+			 */
+			if (slot->pollstatus == PGRES_POLLING_READING)
+				ready = pqReadReady(slot->conn);
+			else
+				ready = pqWriteReady(slot->conn);
+			if (ready == 0)
+				continue;
+
+			if (ready > 0)
+				slot->pollstatus = PQconnectPoll(slot->conn);
+			else
+				slot->pollstatus = PGRES_POLLING_FAILED;
+
+			if (slot->pollstatus == PGRES_POLLING_OK)
+			{
+				slot->state = POOL_SLOT_IDLE;
+				pool->backoff = 0;
+			}
+			else if (slot->pollstatus == PGRES_POLLING_FAILED)
+				pool_connection_failed(pool, slot, now);
+		}
+		else if (slot->state == POOL_SLOT_IDLE)
+		{
+			/* the server may have closed it, eg. idle_session_timeout */
+			if (pqReadReady(slot->conn) != 0 &&
+				!pool_connection_usable(slot->conn))
+				pool_drop_connection(slot);
+		}
+	}
+
+	/* top up to minConns, unless we're backing off after failures */
+	live = pool_count_live(pool);
+	if (live < pool->minConns)
+	{
+		if (now >= pool->retryAt)
+		{
+			for (int i = 0; i < pool->maxConns && live < pool->minConns; i++)
+			{
+				if (pool->slots[i].state != POOL_SLOT_EMPTY)
+					continue;
+				pool_start_connection(pool, &pool->slots[i], now);
+				if (pool->slots[i].state == POOL_SLOT_EMPTY)
+					break;		/* failed immediately; now backing off */
+				live++;
+			}
+		}
+		if (live < pool->minConns && pool->retryAt > now)
+			timeout = (int) ((pool->retryAt - now + 999) / 1000);
+	}
+
+	POOL_UNLOCK(pool);
+
+	return timeout;
+}
+
+/*
+ * PQpoolSockets
+ *
+ * Report the sockets the pool wants the application to wait on, for use
+ * with select(), poll() or an event loop: connections being established,
+ * for reading or writing as PQconnectPoll() requested, and idle connections,
+ * for reading, so that closure by the server is noticed.
+ *
+ * Fills in at most nsocks entries of socks, and returns the number of
+ * sockets the pool has, which may be larger.  The set changes after each
+ * call of the other pool functions.
+ */
+int
+PQpoolSockets(PGpool *pool, PGpoolSocket *socks, int nsocks)
+{
+	int			n = 0;
+
+	if (pool == NULL)
+		return 0;
+
+	POOL_LOCK(pool);
+
+	for (int i = 0; i < pool->maxConns; i++)
+	{
+		PGpoolSlot *slot = &pool->slots[i];
+		int			forRead;
+		int			forWrite;
+
+		if (slot->state == POOL_SLOT_CONNECTING)
+		{
+			forRead = (slot->pollstatus == PGRES_POLLING_READING);
+			forWrite = !forRead;
+		}
+		else if (slot->state == POOL_SLOT_IDLE)
+		{
+			forRead = 1;
+			forWrite = 0;
+		}
+		else
+			continue;
+
+		if (PQsocket(slot->conn) < 0)
+			continue;
+
+		if (n < nsocks)
+		{
+			socks[n].sock = PQsocket(slot->conn);
+			socks[n].forRead = forRead;
+			socks[n].forWrite = forWrite;
+		}
+		n++;
+	}
+
+	POOL_UNLOCK(pool);
+
+	return n;
+}
+
+/*
+ * PQpoolGet
+ *
+ * Check out an idle connection.  The connection is in the OK state, idle
+ * outside a transaction block and not in pipeline mode, and belongs to the
+ * caller until it is given back with PQpoolRelease().
+ *
+ * Returns NULL if no connection is available right now.  In that case, if
+ * the pool isn't full, a new connection is started, and a later call may
+ * succeed once PQpoolPoll() has completed it.
+ */
+PGconn *
+PQpoolGet(PGpool *pool)
+{
+	PGconn	   *conn = NULL;
+	PGpoolSlot *empty = NULL;
+
+	if (pool == NULL)
+		return NULL;
+
+	POOL_LOCK(pool);
+
+	for (int i = 0; i < pool->maxConns; i++)
+	{
+		PGpoolSlot *slot = &pool->slots[i];
+
+		if (slot->state == POOL_SLOT_IDLE)
+		{
+			if (pool_connection_usable(slot->conn))
+			{
+				slot->state = POOL_SLOT_BUSY;
+				conn = slot->conn;
+				break;
+			}
+			pool_drop_connection(slot);
+		}
+		if (slot->state == POOL_SLOT_EMPTY && empty == NULL)
+			empty = slot;
+	}
+
+	if (conn == NULL && empty != NULL)
+	{
+		int64		now = pool_now();
+
+		if (now >= pool->retryAt)
+			pool_start_connection(pool, empty, now);
+	}
+
+	POOL_UNLOCK(pool);
+
+	return conn;
+}
+
+/*
+ * PQpoolRelease
+ *
+ * Give a connection obtained from PQpoolGet() back to the pool.
+ *
+ * The connection is kept for reuse only if it is back in the state
+ * PQpoolGet() handed it out in; a connection that was left inside a
+ * transaction block, in pipeline mode, or with a query still running is
+ * closed, since the next user could not safely continue from that state.
+ * Session state that the caller has set up, such as SET commands or
+ * prepared statements, is kept.
+ */
+void
+PQpoolRelease(PGpool *pool, PGconn *conn)
+{
+	if (pool == NULL || conn == NULL)
+		return;
+
+	POOL_LOCK(pool);
+
+	for (int i = 0; i < pool->maxConns; i++)
+	{
+		PGpoolSlot *slot = &pool->slots[i];
+
+		if (slot->state != POOL_SLOT_BUSY || slot->conn != conn)
+			continue;
+
+		if (pool_connection_usable(conn))
+			slot->state = POOL_SLOT_IDLE;
+		else
+			pool_drop_connection(slot);
+
+		POOL_UNLOCK(pool);
+		return;
+	}
+
+	POOL_UNLOCK(pool);
+
+	/* not one of ours; just close it */
+	PQfinish(conn);
+}
+
+/*
+ * PQpoolErrorMessage
+ *
+ * Return the error message of the last failed connection attempt, or an
+ * empty string if none has failed since a connection last succeeded.  The
+ * string is malloc'd, and the caller must free it with PQfreemem().
+ */
+char *
+PQpoolErrorMessage(PGpool *pool)
+{
+	char	   *msg;
+
+	if (pool == NULL)
+		return NULL;
+
+	POOL_LOCK(pool);
+	msg = strdup(pool->errorMessage ? pool->errorMessage : "");
+	POOL_UNLOCK(pool);
+
+	return msg;
+}
+
+/*
+ * PQpoolFinish
+ *
+ * Close all connections of the pool, including any still checked out, and
+ * free it.
+ */
+void
+PQpoolFinish(PGpool *pool)
+{
+	if (pool == NULL)
+		return;
+
+	for (int i = 0; i < pool->maxConns; i++)
+		pool_drop_connection(&pool->slots[i]);
+
+#if defined(ENABLE_THREAD_SAFETY) && !defined(WIN32)
+	pthread_mutex_destroy(&pool->lock);
+#endif
+	free(pool->errorMessage);
+	free(pool->conninfo);
+	free(pool->slots);
+	free(pool);
+}
+
+/*
+ * Current time in microseconds, for retry scheduling.
+ */
+static int64
+pool_now(void)
+{
+	struct timeval tval;
+
+	gettimeofday(&tval, NULL);
+	return (int64) tval.tv_sec * 1000000 + tval.tv_usec;
+}
+
+/*
+ * Start a new connection in an empty slot.
+ */
+static void
+pool_start_connection(PGpool *pool, PGpoolSlot *slot, int64 now)
+{
+	Assert(slot->state == POOL_SLOT_EMPTY);
+
+	slot->conn = PQconnectStart(pool->conninfo);
+	slot->state = POOL_SLOT_CONNECTING;
+	slot->pollstatus = PGRES_POLLING_WRITING;
+
+	if (slot->conn == NULL || PQstatus(slot->conn) == CONNECTION_BAD)
+		pool_connection_failed(pool, slot, now);
+}
+
+/*
+ * A connection attempt failed: remember why, and hold off new attempts for
+ * a while.  The delay doubles with each consecutive failure, and a random
+ * part of it is shaved off so that clients that failed together don't
+ * retry together.
+ */
+static void
+pool_connection_failed(PGpool *pool, PGpoolSlot *slot, int64 now)
+{
+	free(pool->errorMessage);
+	if (slot->conn == NULL)
+		pool->errorMessage = strdup(libpq_gettext("out of memory\n"));
+	else
+		pool->errorMessage = strdup(PQerrorMessage(slot->conn));
+
+	pool_drop_connection(slot);
+
+	if (pool->backoff == 0)
+		pool->backoff = POOL_BACKOFF_MIN;
+	else
+		pool->backoff = Min(pool->backoff * 2, POOL_BACKOFF_MAX);
+	pool->retryAt = now + pool->backoff / 2 +
+		(int64) pg_prng_uint64_range(&pool->prng_state, 0, pool->backoff / 2);
+}
+
+/*
+ * Close a slot's connection, if it has one.
+ */
+static void
+pool_drop_connection(PGpoolSlot *slot)
+{
+	if (slot->conn)
+		PQfinish(slot->conn);
+	slot->conn = NULL;
+	slot->state = POOL_SLOT_EMPTY;
+}
+
+/*
+ * Is this connection fit to be handed out?  This also absorbs whatever the
+ * server has sent meanwhile, which is how we find out that it has closed
+ * the connection.
+ */
+static bool
+pool_connection_usable(PGconn *conn)
+{
+	if (PQstatus(conn) != CONNECTION_OK ||
+		PQpipelineStatus(conn) != PQ_PIPELINE_OFF ||
+		PQtransactionStatus(conn) != PQTRANS_IDLE)
+		return false;
+	if (!PQconsumeInput(conn))
+		return false;
+	return PQstatus(conn) == CONNECTION_OK && !PQisBusy(conn);
+}
+
+/*
+ * Number of slots that have (or are getting) a connection.
+ */
+static int
+pool_count_live(PGpool *pool)
+{
+	int			live = 0;
+
+	for (int i = 0; i < pool->maxConns; i++)
+	{
+		if (pool->slots[i].state != POOL_SLOT_EMPTY)
+			live++;
+	}
+	return live;
+}
@@ -193,6 +193,17 @@ pqParseInput3(PGconn *conn)
 			switch (id)
 			{
 				case 'C':		/* command complete */
+
+					/*
+					 * In single-row or chunked-rows mode, first hand out the
+					 * partial result still being filled.  We come back to
+					 * this message once the application has collected it.
+					 */
+					if (conn->next_result != NULL)
+					{
+						conn->asyncStatus = PGASYNC_READY_MORE;
+						return;
+					}
 					if (pqGets(&conn->workBuffer, conn))
 						return;
 					if (!pgHavePendingResult(conn))
@@ -2276,6 +2287,8 @@ build_startup_packet(const PGconn *conn, char *packet,
 		ADD_STARTUP_OPTION("replication", conn->replication);
 	if (conn->pgoptions && conn->pgoptions[0])
 		ADD_STARTUP_OPTION("options", conn->pgoptions);
+	if (conn->compression && conn->compression[0])
+		ADD_STARTUP_OPTION("_pq_.compression", conn->compression);
 	if (conn->send_appname)
 	{
 		/* Use appname if present, otherwise use fallback */
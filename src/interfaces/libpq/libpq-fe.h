@@ -109,8 +109,9 @@ typedef enum
 	PGRES_COPY_BOTH,			/* Copy In/Out data transfer in progress */
 	PGRES_SINGLE_TUPLE,			/* single tuple from larger resultset */
 	PGRES_PIPELINE_SYNC,		/* pipeline synchronization point */
-	PGRES_PIPELINE_ABORTED		/* Command didn't run because of an abort
+	PGRES_PIPELINE_ABORTED,		/* Command didn't run because of an abort
 								 * earlier in a pipeline */
+	PGRES_TUPLES_CHUNK			/* chunk of tuples from larger resultset */
 } ExecStatusType;
 
 typedef enum
@@ -165,6 +166,12 @@ typedef enum
  */
 typedef struct pg_conn PGconn;
 
+/* PGpool is a pool of connections made with the same conninfo, see
+ * PQpoolCreate().
+ * The contents of this struct are not supposed to be known to applications.
+ */
+typedef struct pg_pool PGpool;
+
 /* PGresult encapsulates the result of a query (or more precisely, of a single
  * SQL command --- a query string given to PQsendQuery can contain multiple
  * commands and thus return multiple PGresult objects).
@@ -269,6 +276,36 @@ typedef struct pgresAttDesc
 	int			atttypmod;		/* type-specific modifier info */
 } PGresAttDesc;
 
+/* ----------------
+ * PGdataValue -- a data field value being passed to a row callback
+ *
+ * It could be either text or binary data; text data is not zero-terminated.
+ * A SQL NULL is represented by len < 0; then value is still valid but there
+ * are no data bytes there.  The value points into libpq's input buffer and
+ * is only valid until the callback returns.
+ * ----------------
+ */
+typedef struct pgDataValue
+{
+	int			len;			/* data length in bytes, or <0 if NULL */
+	const char *value;			/* data value, without zero-termination */
+} PGdataValue;
+
+/* Function type for row callbacks, see PQsetRowCallback() */
+typedef int (*PQrowCallback) (const PGresult *res, const PGdataValue *columns,
+							  void *arg);
+
+/* ----------------
+ * A socket a connection pool wants to be waited on, see PQpoolSockets()
+ * ----------------
+ */
+typedef struct pgPoolSocket
+{
+	int			sock;			/* as returned by PQsocket() */
+	int			forRead;		/* wait until readable? */
+	int			forWrite;		/* wait until writable? */
+} PGpoolSocket;
+
 /* ----------------
  * Exported functions of libpq
  * ----------------
@@ -417,6 +454,17 @@ extern void PQuntrace(PGconn *conn);
 #define PQTRACE_REGRESS_MODE			(1<<1)
 extern void PQsetTraceFlags(PGconn *conn, int flags);
 
+/* === in fe-pool.c === */
+
+/* Pools of asynchronously established connections */
+extern PGpool *PQpoolCreate(const char *conninfo, int minConns, int maxConns);
+extern int	PQpoolPoll(PGpool *pool);
+extern int	PQpoolSockets(PGpool *pool, PGpoolSocket *socks, int nsocks);
+extern PGconn *PQpoolGet(PGpool *pool);
+extern void PQpoolRelease(PGpool *pool, PGconn *conn);
+extern char *PQpoolErrorMessage(PGpool *pool);
+extern void PQpoolFinish(PGpool *pool);
+
 /* === in fe-exec.c === */
 
 /* Simple synchronous query */
@@ -463,6 +511,9 @@ extern int	PQsendQueryPrepared(PGconn *conn,
 								const int *paramFormats,
 								int resultFormat);
 extern int	PQsetSingleRowMode(PGconn *conn);
+extern int	PQsetChunkedRowsMode(PGconn *conn, int chunkSize);
+extern int	PQsetRowCallback(PGconn *conn, PQrowCallback callback,
+							 void *arg);
 extern PGresult *PQgetResult(PGconn *conn);
 
 /* Routines for managing an asynchronous query */
@@ -83,6 +83,7 @@ typedef struct
 #endif
 #endif							/* USE_OPENSSL */
 
+#include "common/compression_stream.h"
 #include "common/pg_prng.h"
 
 /*
@@ -294,17 +295,6 @@ typedef struct pgLobjfuncs
 	Oid			fn_lo_write;	/* OID of backend function LOwrite		*/
 } PGlobjfuncs;
 
-/* PGdataValue represents a data field value being passed to a row processor.
- * It could be either text or binary data; text data is not zero-terminated.
- * A SQL NULL is represented by len < 0; then value is still valid but there
- * are no data bytes there.
- */
-typedef struct pgDataValue
-{
-	int			len;			/* data length in bytes, or <0 if NULL */
-	const char *value;			/* data value, without zero-termination */
-} PGdataValue;
-
 /* Host address type enum for struct pg_conn_host */
 typedef enum pg_conn_host_type
 {
@@ -410,6 +400,7 @@ struct pg_conn /// 一个巨复杂的链接表示的数据结构
 	char	   *target_session_attrs;	/* desired session properties */
 	char	   *require_auth;	/* name of the expected auth method */
 	char	   *load_balance_hosts; /* load balance over hosts */
+	char	   *compression;	/* protocol compression, "algorithm[:level]" */
 
 	/* Optional file to write trace info to */
 	FILE	   *Pfdebug;
@@ -433,6 +424,11 @@ struct pg_conn /// 一个巨复杂的链接表示的数据结构
 								 * sending semantics */
 	PGpipelineStatus pipelineStatus;	/* status of pipeline mode */
 	bool		singleRowMode;	/* return current query result row-by-row? */
+	int			maxChunkSize;	/* return current query result in chunks of
+								 * this many rows, or 0 for all at once */
+	PQrowCallback rowCallback;	/* hand current query's rows to this
+								 * function instead of storing them */
+	void	   *rowCallbackArg; /* argument for rowCallback */
 	char		copy_is_binary; /* 1 = copy binary, 0 = copy text */
 	int			copy_already_done;	/* # bytes already returned in COPY OUT */
 	PGnotify   *notifyHead;		/* oldest unreported Notify msg */
@@ -518,6 +514,23 @@ struct pg_conn /// 一个巨复杂的链接表示的数据结构
 	int			outBufSize;		/* allocated size of buffer */
 	int			outCount;		/* number of chars waiting in buffer */
 
+	/*
+	 * Protocol compression state.  inBuffer and outBuffer still hold plain
+	 * protocol data; pqSendSome() sends the front of outBuffer compressed,
+	 * and pqReadData() decompresses what is received in zinBuffer.
+	 */
+	pg_compress_algorithm compress_algorithm;	/* decoded compression */
+	int			compress_level;
+	ZStream    *zstream;		/* NULL until compression has started */
+	const char *zoutData;		/* compressed data, owned by zstream */
+	int			zoutStart;		/* next byte of zoutData to send */
+	int			zoutEnd;		/* end of data in zoutData */
+	int			zoutConsumed;	/* bytes of outBuffer that zoutData covers */
+	char	   *zinBuffer;		/* compressed data not yet decompressed */
+	int			zinBufSize;		/* allocated size of zinBuffer */
+	int			zinStart;		/* next byte of zinBuffer to decompress */
+	int			zinEnd;			/* end of data in zinBuffer */
+
 	/* State for constructing messages in outBuffer */
 	int			outMsgStart;	/* offset to msg start (length word); if -1,
 								 * msg has no length word */
@@ -534,11 +547,14 @@ struct pg_conn /// 一个巨复杂的链接表示的数据结构
 	 * result, but haven't yet constructed it; text for the error has been
 	 * appended to conn->errorMessage.  (Delaying construction simplifies
 	 * dealing with out-of-memory cases.)  If next_result isn't NULL, it is a
-	 * PGresult that will replace "result" after we return that one.
+	 * PGresult that will replace "result" after we return that one; in
+	 * single-row and chunked-rows mode, "result" is then the partial result
+	 * being filled.
 	 */
 	PGresult   *result;			/* result being constructed */
 	bool		error_result;	/* do we need to make an ERROR result? */
-	PGresult   *next_result;	/* next result (used in single-row mode) */
+	PGresult   *next_result;	/* next result (used in single-row and
+								 * chunked-rows mode) */
 
 	/* Assorted state for SASL, SSL, GSS, etc */
 	const pg_fe_sasl_mech *sasl;
@@ -748,6 +764,7 @@ extern int	pqPutInt(int value, size_t bytes, PGconn *conn);
 extern int	pqPutMsgStart(char msg_type, PGconn *conn);
 extern int	pqPutMsgEnd(PGconn *conn);
 extern int	pqReadData(PGconn *conn);
+extern int	pqEnableCompression(PGconn *conn);
 extern int	pqFlush(PGconn *conn);
 extern int	pqWait(int forRead, int forWrite, PGconn *conn);
 extern int	pqWaitTimed(int forRead, int forWrite, PGconn *conn,
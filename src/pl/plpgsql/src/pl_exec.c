@@ -5857,6 +5857,7 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 	uint64		previous_id = INVALID_TUPLEDESC_IDENTIFIER;
 	bool		tupdescs_match = true;
 	uint64		n;
+	long		fetch_count;
 
 	/* Fetch loop variable's datum entry */
 	var = (PLpgSQL_variable *) estate->datums[stmt->var->dno];
@@ -5883,7 +5884,8 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 	 * few more rows to avoid multiple trips through executor startup
 	 * overhead.
 	 */
-	SPI_cursor_fetch(portal, true, prefetch_ok ? 10 : 1);
+	fetch_count = prefetch_ok ? 10 : 1;
+	SPI_cursor_fetch(portal, true, fetch_count);
 	tuptab = SPI_tuptable;
 	n = SPI_processed;
 
@@ -5973,9 +5975,14 @@ exec_for_query(PLpgSQL_execstate *estate, PLpgSQL_stmt_forq *stmt,
 		SPI_freetuptable(tuptab);
 
 		/*
-		 * Fetch more tuples.  If prefetching is allowed, grab 50 at a time.
+		 * Fetch more tuples.  If prefetching is allowed, grab 50 at first,
+		 * then twice as many each time up to 1000, so that a long loop
+		 * makes few round trips through the portal while a loop that exits
+		 * early hasn't fetched many rows for nothing.
 		 */
-		SPI_cursor_fetch(portal, true, prefetch_ok ? 50 : 1);
+		if (prefetch_ok)
+			fetch_count = Min(Max(fetch_count * 2, 50), 1000);
+		SPI_cursor_fetch(portal, true, fetch_count);
 		tuptab = SPI_tuptable;
 		n = SPI_processed;
 	}
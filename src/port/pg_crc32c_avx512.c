@@ -0,0 +1,92 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_crc32c_avx512.c
+ *	  Compute CRC-32C checksum using Intel AVX-512 and VPCLMULQDQ
+ *	  instructions.
+ *
+ * Inputs of 64 bytes or more are folded 512 bits at a time with carry-less
+ * multiplication, and the folded remainder is reduced with the SSE 4.2 CRC
+ * instruction.  Shorter inputs and any tail are handed to the SSE 4.2
+ * implementation, which any CPU with these extensions also supports.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_crc32c_avx512.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#include "port/pg_crc32c.h"
+
+#ifdef USE_AVX512_CRC32C_WITH_RUNTIME_CHECK
+
+#include <immintrin.h>
+
+#define clmul_lo(a, b) (_mm512_clmulepi64_epi128((a), (b), 0))
+#define clmul_hi(a, b) (_mm512_clmulepi64_epi128((a), (b), 17))
+
+pg_attribute_target("avx512vl,vpclmulqdq,sse4.2")
+pg_crc32c
+pg_comp_crc32c_avx512(pg_crc32c crc, const void *data, size_t len)
+{
+	const unsigned char *buf = data;
+
+	if (len >= 64)
+	{
+		const unsigned char *end = buf + len;
+		const unsigned char *limit = buf + len - 64;
+		__m512i		x0;
+		__m512i		y0;
+		__m512i		k;
+		__m128i		z0;
+
+		/*
+		 * Load the first 64 bytes and fold in the incoming CRC.  The
+		 * constants are powers of x modulo the bit-reflected CRC-32C
+		 * polynomial, chosen to fold each 128-bit lane 512 bits forward.
+		 */
+		x0 = _mm512_loadu_si512((const void *) buf);
+		x0 = _mm512_xor_si512(_mm512_zextsi128_si512(_mm_cvtsi32_si128(crc)), x0);
+		k = _mm512_broadcast_i32x4(_mm_setr_epi32(0x740eef02, 0, 0x9e4addf8, 0));
+		buf += 64;
+
+		/* Main loop: fold 64 bytes at a time */
+		while (buf <= limit)
+		{
+			y0 = clmul_lo(x0, k);
+			x0 = clmul_hi(x0, k);
+			x0 = _mm512_ternarylogic_epi64(x0, y0,
+										   _mm512_loadu_si512((const void *) buf),
+										   0x96);
+			buf += 64;
+		}
+
+		/* Reduce 512 bits to 128 bits */
+		k = _mm512_setr_epi32(0x1c291d04, 0, 0xddc0152b, 0,
+							  0x3da6d0cb, 0, 0xba4fc28e, 0,
+							  0xf20c0dfe, 0, 0x493c7d27, 0,
+							  0, 0, 0, 0);
+		y0 = clmul_lo(x0, k);
+		k = clmul_hi(x0, k);
+		y0 = _mm512_xor_si512(y0, k);
+		z0 = _mm_ternarylogic_epi64(_mm512_castsi512_si128(y0),
+									_mm512_extracti32x4_epi32(y0, 1),
+									_mm512_extracti32x4_epi32(y0, 2),
+									0x96);
+		z0 = _mm_xor_si128(z0, _mm512_extracti32x4_epi32(x0, 3));
+
+		/* Reduce 128 bits to 32 bits, which also multiplies by x^32 */
+		crc = (uint32) _mm_crc32_u64(0, _mm_extract_epi64(z0, 0));
+		crc = (uint32) _mm_crc32_u64(crc, _mm_extract_epi64(z0, 1));
+
+		len = end - buf;
+	}
+
+	return pg_comp_crc32c_sse42(crc, buf, len);
+}
+
+#endif							/* USE_AVX512_CRC32C_WITH_RUNTIME_CHECK */
@@ -1,12 +1,14 @@
 /*-------------------------------------------------------------------------
  *
  * pg_crc32c_sse42_choose.c
- *	  Choose between Intel SSE 4.2 and software CRC-32C implementation.
+ *	  Choose between Intel AVX-512, SSE 4.2 and software CRC-32C
+ *	  implementation.
  *
  * On first call, checks if the CPU we're running on supports Intel SSE
  * 4.2. If it does, use the special SSE instructions for CRC-32C
  * computation. Otherwise, fall back to the pure software implementation
- * (slicing-by-8).
+ * (slicing-by-8).  If the CPU and the OS also support AVX-512 with
+ * VPCLMULQDQ, use that instead, as it is much faster on large inputs.
  *
  * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -46,6 +48,60 @@ pg_crc32c_sse42_available(void)
 	return (exx[2] & (1 << 20)) != 0;	/* SSE 4.2 */
 }
 
+#ifdef USE_AVX512_CRC32C_WITH_RUNTIME_CHECK
+
+/*
+ * Check that the OS saves the ZMM registers, or using them would fault.
+ */
+static bool
+zmm_regs_available(void)
+{
+	unsigned int exx[4] = {0, 0, 0, 0};
+	uint64		xcr0;
+
+#if defined(HAVE__GET_CPUID)
+	__get_cpuid(1, &exx[0], &exx[1], &exx[2], &exx[3]);
+#elif defined(HAVE__CPUID)
+	__cpuid(exx, 1);
+#endif
+
+	if ((exx[2] & (1 << 27)) == 0)	/* OSXSAVE */
+		return false;
+
+#if defined(HAVE__GET_CPUID)
+	{
+		uint32		eax;
+		uint32		edx;
+
+		__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		xcr0 = ((uint64) edx << 32) | eax;
+	}
+#else
+	xcr0 = _xgetbv(0);
+#endif
+
+	/* XMM, YMM, opmask and ZMM state must all be enabled */
+	return (xcr0 & 0xe6) == 0xe6;
+}
+
+static bool
+pg_crc32c_avx512_available(void)
+{
+	unsigned int exx[4] = {0, 0, 0, 0};
+
+#if defined(HAVE__GET_CPUID)
+	__cpuid_count(7, 0, exx[0], exx[1], exx[2], exx[3]);
+#elif defined(HAVE__CPUID)
+	__cpuidex(exx, 7, 0);
+#endif
+
+	return (exx[2] & (1 << 10)) != 0 &&	/* VPCLMULQDQ */
+		(exx[1] & (1 << 31)) != 0 &&	/* AVX512-VL */
+		zmm_regs_available();
+}
+
+#endif							/* USE_AVX512_CRC32C_WITH_RUNTIME_CHECK */
+
 /*
  * This gets called on the first call. It replaces the function pointer
  * so that subsequent calls are routed directly to the chosen implementation.
@@ -53,10 +109,21 @@ pg_crc32c_sse42_available(void)
 static pg_crc32c
 pg_comp_crc32c_choose(pg_crc32c crc, const void *data, size_t len)
 {
+#ifdef USE_SSE42_CRC32C
+	/* built with SSE 4.2 enabled, so it's always available */
+	pg_comp_crc32c = pg_comp_crc32c_sse42;
+#else
 	if (pg_crc32c_sse42_available())
 		pg_comp_crc32c = pg_comp_crc32c_sse42;
 	else
 		pg_comp_crc32c = pg_comp_crc32c_sb8;
+#endif
+
+#ifdef USE_AVX512_CRC32C_WITH_RUNTIME_CHECK
+	if (pg_comp_crc32c == pg_comp_crc32c_sse42 &&
+		pg_crc32c_avx512_available())
+		pg_comp_crc32c = pg_comp_crc32c_avx512;
+#endif
 
 	return pg_comp_crc32c(crc, data, len);
 }
@@ -0,0 +1,161 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_numa.c
+ *		Basic NUMA portability routines
+ *
+ * These are thin wrappers around libnuma, so that callers needn't worry
+ * about whether we were built with it.  Without it, pg_numa_init() reports
+ * that NUMA isn't available and the other functions fail.
+ *
+ * Portions Copyright (c) 1996-2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_numa.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "c.h"
+
+#include "port/pg_numa.h"
+
+#ifdef USE_LIBNUMA
+
+#include <numa.h>
+#include <numaif.h>
+
+/*
+ * Memory policies apply to whole pages, so shrink a range to the pages that
+ * lie entirely inside it.  Returns false if there are none.
+ */
+static bool
+pg_numa_align_range(void **ptr, size_t *size, size_t pagesize)
+{
+	uintptr_t	start = (uintptr_t) *ptr;
+	uintptr_t	end = start + *size;
+
+	start = TYPEALIGN(pagesize, start);
+	end = TYPEALIGN_DOWN(pagesize, end);
+	if (end <= start)
+		return false;
+
+	*ptr = (void *) start;
+	*size = end - start;
+	return true;
+}
+
+/*
+ * Returns 0 if NUMA is available, -1 if not.
+ */
+int
+pg_numa_init(void)
+{
+	return numa_available();
+}
+
+int
+pg_numa_get_max_node(void)
+{
+	return numa_max_node();
+}
+
+/*
+ * Find out which node each of the given pages is on.  Pages that haven't been
+ * faulted in yet are reported with a negative status.
+ */
+int
+pg_numa_query_pages(int pid, unsigned long count, void **pages, int *status)
+{
+	return numa_move_pages(pid, count, pages, NULL, status, 0);
+}
+
+/*
+ * Spread the pages of a range round-robin over all nodes.  Pages that have
+ * already been faulted in are moved.
+ */
+int
+pg_numa_interleave_memory(void *ptr, size_t size, size_t pagesize)
+{
+	struct bitmask *nodes = numa_get_mems_allowed();
+	int			rc = 0;
+
+	if (pg_numa_align_range(&ptr, &size, pagesize))
+		rc = mbind(ptr, size, MPOL_INTERLEAVE, nodes->maskp, nodes->size + 1,
+				   MPOL_MF_MOVE);
+	numa_bitmask_free(nodes);
+	return rc;
+}
+
+/*
+ * Place the pages of a range on the given node.
+ */
+int
+pg_numa_bind_memory(void *ptr, size_t size, size_t pagesize, int node)
+{
+	struct bitmask *nodes = numa_allocate_nodemask();
+	int			rc = 0;
+
+	numa_bitmask_setbit(nodes, node);
+	if (pg_numa_align_range(&ptr, &size, pagesize))
+		rc = mbind(ptr, size, MPOL_BIND, nodes->maskp, nodes->size + 1,
+				   MPOL_MF_MOVE);
+	numa_bitmask_free(nodes);
+	return rc;
+}
+
+/*
+ * Restrict the calling process to the CPUs of the given node, and prefer that
+ * node for its own memory allocations.
+ */
+int
+pg_numa_run_on_node(int node)
+{
+	if (numa_run_on_node(node) != 0)
+		return -1;
+	numa_set_preferred(node);
+	return 0;
+}
+
+#else
+
+int
+pg_numa_init(void)
+{
+	return -1;
+}
+
+int
+pg_numa_get_max_node(void)
+{
+	return 0;
+}
+
+int
+pg_numa_query_pages(int pid, unsigned long count, void **pages, int *status)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_interleave_memory(void *ptr, size_t size, size_t pagesize)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_bind_memory(void *ptr, size_t size, size_t pagesize, int node)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int
+pg_numa_run_on_node(int node)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif							/* USE_LIBNUMA */
@@ -1,7 +1,8 @@
 # Subtransaction overflow
 #
 # This test is designed to cover some code paths which only occur when
-# one transaction has overflowed the subtransaction cache.
+# one transaction has overflowed the subtransaction cache, whose default size
+# (max_cached_subxids) is 256.
 
 setup
 {
@@ -36,7 +37,7 @@ session s1
 # setup step for each test
 step ins	{ TRUNCATE subxids; INSERT INTO subxids VALUES (0, 0); }
 # long running transaction with overflowed subxids
-step subxov	{ BEGIN; SELECT gen_subxids(100); }
+step subxov	{ BEGIN; SELECT gen_subxids(300); }
 # commit should always come last to make this long running
 step s1c	{ COMMIT; }
 
@@ -0,0 +1,11 @@
+CREATE EXTENSION test_benchmarks;
+
+-- Run every benchmark once; only the names are stable enough to check.
+SELECT benchmark FROM run_benchmarks(NULL, 1, 1) ORDER BY benchmark;
+
+-- error cases
+SELECT count(*) FROM run_benchmarks('no_such_benchmark', 1, 1);
+SELECT count(*) FROM run_benchmarks(NULL, -1, 1);
+SELECT count(*) FROM run_benchmarks(NULL, 1, 0);
+
+DROP EXTENSION test_benchmarks;
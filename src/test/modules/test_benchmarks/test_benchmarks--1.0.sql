@@ -0,0 +1,15 @@
+/* src/test/modules/test_benchmarks/test_benchmarks--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION test_benchmarks" to load this file. \quit
+
+CREATE FUNCTION run_benchmarks(name text DEFAULT NULL,
+                               nloops int8 DEFAULT 0,
+                               nrepeats int4 DEFAULT 5)
+RETURNS TABLE (benchmark text,
+               op text,
+               loops int8,
+               repeats int4,
+               best_ns_per_op float8,
+               median_ns_per_op float8)
+AS 'MODULE_PATHNAME' LANGUAGE C;
@@ -0,0 +1,659 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_benchmarks.c
+ *		Micro-benchmarks of core data structures and hot paths.
+ *
+ * Each benchmark times a loop of one primitive operation on synthetic
+ * input, generated from a fixed seed so that every run sees the same data.
+ * run_benchmarks() repeats each loop a number of times and reports the best
+ * and the median time per operation, which are stable enough to compare
+ * builds of different commits on the same machine.
+ *
+ * Copyright (c) 2023, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_benchmarks/test_benchmarks.c
+ *
+ * -------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/table.h"
+#include "access/xlog.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_operator_d.h"
+#include "catalog/pg_type_d.h"
+#include "common/hashfn.h"
+#include "common/pg_lzcompress.h"
+#include "common/pg_prng.h"
+#include "executor/executor.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "port/pg_crc32c.h"
+#include "port/pg_lfind.h"
+#include "portability/instr_time.h"
+#include "replication/message.h"
+#include "storage/bufmgr.h"
+#include "storage/lwlock.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/tuplesort.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(run_benchmarks);
+
+/* seed of the synthetic inputs */
+#define BENCH_SEED		UINT64CONST(0x5EED5EED)
+
+/* elements searched by each pg_lfind32() call */
+#define LFIND_NELEM		1024
+
+/* size of the WAL records inserted */
+#define WAL_MESSAGE_SIZE	64
+
+/*
+ * A benchmark runs "loops" operations and returns the time they took.  Any
+ * setup and cleanup it needs is done outside of the timed part.
+ */
+typedef void (*bench_function) (uint64 loops, instr_time *elapsed);
+
+typedef struct
+{
+	const char *name;			/* name of the benchmark */
+	const char *op;				/* what one operation is, for humans */
+	uint64		default_loops;	/* operations per repetition */
+	bench_function function;
+} bench_spec;
+
+static void bench_simplehash(uint64 loops, instr_time *elapsed);
+static void bench_dynahash(uint64 loops, instr_time *elapsed);
+static void bench_tuplesort(uint64 loops, instr_time *elapsed);
+static void bench_expr(uint64 loops, instr_time *elapsed);
+static void bench_lfind(uint64 loops, instr_time *elapsed);
+static void bench_crc32c(uint64 loops, instr_time *elapsed);
+static void bench_pglz_compress(uint64 loops, instr_time *elapsed);
+static void bench_pglz_decompress(uint64 loops, instr_time *elapsed);
+static void bench_buffer_pin(uint64 loops, instr_time *elapsed);
+static void bench_lwlock(uint64 loops, instr_time *elapsed);
+static void bench_wal_insert(uint64 loops, instr_time *elapsed);
+static void bench_snapshot(uint64 loops, instr_time *elapsed);
+
+static const bench_spec bench_specs[] = {
+	{"simplehash", "insert and lookup of a uint32 key", 1000000, bench_simplehash},
+	{"dynahash", "insert and lookup of a uint32 key", 1000000, bench_dynahash},
+	{"tuplesort", "int8 datum put and get, in-memory sort", 1000000, bench_tuplesort},
+	{"expr", "evaluation of int4pl(int4pl($1, 1), 2)", 1000000, bench_expr},
+	{"lfind32", "search of 1024 uint32 elements", 100000, bench_lfind},
+	{"crc32c", "checksum of a block", 100000, bench_crc32c},
+	{"pglz_compress", "compression of a block", 10000, bench_pglz_compress},
+	{"pglz_decompress", "decompression of a block", 10000, bench_pglz_decompress},
+	{"buffer_pin", "pin and unpin of a shared buffer hit", 1000000, bench_buffer_pin},
+	{"lwlock", "exclusive acquire and release of an LWLock", 1000000, bench_lwlock},
+	{"wal_insert", "insert of a 64-byte logical message record", 100000, bench_wal_insert},
+	{"snapshot", "GetLatestSnapshot()", 1000000, bench_snapshot},
+};
+
+/* results are added here, so that the compiler can't optimize loops away */
+static volatile uint64 bench_sink;
+
+/* set when loaded with shared_preload_libraries, see bench_lwlock() */
+static bool bench_lwlock_available = false;
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+
+static int	compare_double(const void *a, const void *b);
+
+
+/*
+ * The benchmarks that work on keys use these; distinct keys are not
+ * guaranteed, but collisions in 32 bits are rare enough not to matter.
+ */
+static uint32 *
+make_random_keys(uint64 nkeys)
+{
+	pg_prng_state prng;
+	uint32	   *keys;
+
+	pg_prng_seed(&prng, BENCH_SEED);
+	keys = palloc_extended(nkeys * sizeof(uint32), MCXT_ALLOC_HUGE);
+	for (uint64 i = 0; i < nkeys; i++)
+		keys[i] = pg_prng_uint32(&prng);
+
+	return keys;
+}
+
+/*
+ * A block of somewhat compressible data: words from a small vocabulary, in
+ * random order.
+ */
+static void
+make_block(char *block)
+{
+	static const char *const words[] = {
+		"select ", "from ", "where ", "tuple ", "buffer ", "index ",
+		"relation ", "snapshot ", "transaction ", "page ", "0 ", "42 ",
+	};
+	pg_prng_state prng;
+	int			len = 0;
+
+	pg_prng_seed(&prng, BENCH_SEED);
+	while (len < BLCKSZ)
+	{
+		const char *word = words[pg_prng_uint64_range(&prng, 0, lengthof(words) - 1)];
+		int			wlen = Min((int) strlen(word), BLCKSZ - len);
+
+		memcpy(block + len, word, wlen);
+		len += wlen;
+	}
+}
+
+
+/* simplehash instantiation for bench_simplehash() */
+typedef struct BenchHashEntry
+{
+	uint32		key;
+	uint32		value;
+	char		status;
+} BenchHashEntry;
+
+#define SH_PREFIX		benchhash
+#define SH_ELEMENT_TYPE	BenchHashEntry
+#define SH_KEY_TYPE		uint32
+#define SH_KEY			key
+#define SH_HASH_KEY(tb, key) murmurhash32(key)
+#define SH_EQUAL(tb, a, b)	((a) == (b))
+#define SH_SCOPE		static inline
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+static void
+bench_simplehash(uint64 loops, instr_time *elapsed)
+{
+	uint32	   *keys = make_random_keys(loops);
+	benchhash_hash *hash;
+	uint64		sum = 0;
+	instr_time	start;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	hash = benchhash_create(CurrentMemoryContext, 256, NULL);
+	for (uint64 i = 0; i < loops; i++)
+	{
+		bool		found;
+
+		benchhash_insert(hash, keys[i], &found)->value = i;
+	}
+	for (uint64 i = 0; i < loops; i++)
+		sum += benchhash_lookup(hash, keys[i])->value;
+	benchhash_destroy(hash);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+static void
+bench_dynahash(uint64 loops, instr_time *elapsed)
+{
+	uint32	   *keys = make_random_keys(loops);
+	HASHCTL		ctl;
+	HTAB	   *hash;
+	uint64		sum = 0;
+	instr_time	start;
+
+	ctl.keysize = sizeof(uint32);
+	ctl.entrysize = sizeof(BenchHashEntry);
+	ctl.hcxt = CurrentMemoryContext;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	hash = hash_create("benchmark hash", 256, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	for (uint64 i = 0; i < loops; i++)
+	{
+		BenchHashEntry *entry;
+
+		entry = hash_search(hash, &keys[i], HASH_ENTER, NULL);
+		entry->value = i;
+	}
+	for (uint64 i = 0; i < loops; i++)
+	{
+		BenchHashEntry *entry;
+
+		entry = hash_search(hash, &keys[i], HASH_FIND, NULL);
+		sum += entry->value;
+	}
+	hash_destroy(hash);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+static void
+bench_tuplesort(uint64 loops, instr_time *elapsed)
+{
+	uint32	   *keys = make_random_keys(loops);
+	Tuplesortstate *sortstate;
+	Datum		val;
+	bool		isnull;
+	uint64		sum = 0;
+	instr_time	start;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	/* no memory limit to speak of, this is about the in-memory sort */
+	sortstate = tuplesort_begin_datum(INT8OID, Int8LessOperator, InvalidOid,
+									  false, MAX_KILOBYTES, NULL,
+									  TUPLESORT_NONE);
+	for (uint64 i = 0; i < loops; i++)
+		tuplesort_putdatum(sortstate, Int64GetDatum((int64) keys[i]), false);
+	tuplesort_performsort(sortstate);
+	while (tuplesort_getdatum(sortstate, true, false, &val, &isnull, NULL))
+		sum += DatumGetInt64(val);
+	tuplesort_end(sortstate);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+/*
+ * Expression evaluation, through ExecInterpExpr() unless JIT kicks in, which
+ * it doesn't for expressions without a plan.  The input is a Param, so that
+ * the expression is evaluated like it would be in a query rather than being
+ * folded into a constant.
+ */
+static void
+bench_expr(uint64 loops, instr_time *elapsed)
+{
+	ParamListInfo params;
+	ExprContext *econtext;
+	ExprState  *exprstate;
+	Param	   *param;
+	Expr	   *expr;
+	uint64		sum = 0;
+	instr_time	start;
+
+	params = makeParamList(1);
+	params->params[0].ptype = INT4OID;
+	params->params[0].pflags = PARAM_FLAG_CONST;
+	params->params[0].isnull = false;
+
+	param = makeNode(Param);
+	param->paramkind = PARAM_EXTERN;
+	param->paramid = 1;
+	param->paramtype = INT4OID;
+	param->paramtypmod = -1;
+	param->paramcollid = InvalidOid;
+	param->location = -1;
+
+	expr = (Expr *)
+		makeFuncExpr(F_INT4PL, INT4OID,
+					 list_make2(makeFuncExpr(F_INT4PL, INT4OID,
+											 list_make2(param,
+														makeConst(INT4OID, -1, InvalidOid,
+																  sizeof(int32),
+																  Int32GetDatum(1),
+																  false, true)),
+											 InvalidOid, InvalidOid,
+											 COERCE_EXPLICIT_CALL),
+								makeConst(INT4OID, -1, InvalidOid, sizeof(int32),
+										  Int32GetDatum(2), false, true)),
+					 InvalidOid, InvalidOid, COERCE_EXPLICIT_CALL);
+
+	econtext = CreateStandaloneExprContext();
+	econtext->ecxt_param_list_info = params;
+	exprstate = ExecInitExprWithParams(expr, params);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+	{
+		bool		isnull;
+
+		params->params[0].value = Int32GetDatum((int32) (i & 0xFFFF));
+		sum += DatumGetInt32(ExecEvalExpr(exprstate, econtext, &isnull));
+	}
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	FreeExprContext(econtext, true);
+
+	bench_sink += sum;
+}
+
+/* Searches for keys of which about half are in the array. */
+static void
+bench_lfind(uint64 loops, instr_time *elapsed)
+{
+	uint32	   *keys = make_random_keys(LFIND_NELEM * 2);
+	uint64		found = 0;
+	instr_time	start;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+	{
+		if (pg_lfind32(keys[LFIND_NELEM / 2 + i % LFIND_NELEM], keys,
+					   LFIND_NELEM))
+			found++;
+	}
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += found;
+}
+
+static void
+bench_crc32c(uint64 loops, instr_time *elapsed)
+{
+	char	   *block = palloc(BLCKSZ);
+	pg_crc32c	crc = 0;
+	instr_time	start;
+
+	make_block(block);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+	{
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, block, BLCKSZ);
+		FIN_CRC32C(crc);
+	}
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += crc;
+}
+
+static void
+bench_pglz_compress(uint64 loops, instr_time *elapsed)
+{
+	char	   *block = palloc(BLCKSZ);
+	char	   *compressed = palloc(PGLZ_MAX_OUTPUT(BLCKSZ));
+	uint64		sum = 0;
+	instr_time	start;
+
+	make_block(block);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+		sum += pglz_compress(block, BLCKSZ, compressed, PGLZ_strategy_always);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+static void
+bench_pglz_decompress(uint64 loops, instr_time *elapsed)
+{
+	char	   *block = palloc(BLCKSZ);
+	char	   *compressed = palloc(PGLZ_MAX_OUTPUT(BLCKSZ));
+	int32		clen;
+	uint64		sum = 0;
+	instr_time	start;
+
+	make_block(block);
+	clen = pglz_compress(block, BLCKSZ, compressed, PGLZ_strategy_always);
+	if (clen < 0)
+		elog(ERROR, "could not compress benchmark block");
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+		sum += pglz_decompress(compressed, clen, block, BLCKSZ, true);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+/*
+ * Buffer lookup, pin and unpin of the first block of pg_class, which is
+ * always in shared buffers while this runs.
+ */
+static void
+bench_buffer_pin(uint64 loops, instr_time *elapsed)
+{
+	Relation	rel = table_open(RelationRelationId, AccessShareLock);
+	instr_time	start;
+
+	/* make sure the block is cached before timing */
+	ReleaseBuffer(ReadBuffer(rel, 0));
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+		ReleaseBuffer(ReadBuffer(rel, 0));
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	table_close(rel, AccessShareLock);
+}
+
+/*
+ * Acquire and release of an LWLock of our own.  Alone, this measures the
+ * uncontended path; to measure the lock under contention, run this
+ * benchmark in several sessions at once, e.g. with pgbench.
+ */
+static void
+bench_lwlock(uint64 loops, instr_time *elapsed)
+{
+	LWLock	   *lock;
+	instr_time	start;
+
+	if (!bench_lwlock_available)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("lwlock benchmark requires \"%s\" to be loaded with shared_preload_libraries",
+						"test_benchmarks")));
+
+	lock = &(GetNamedLWLockTranche("test_benchmarks")[0].lock);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+	{
+		LWLockAcquire(lock, LW_EXCLUSIVE);
+		LWLockRelease(lock);
+	}
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+}
+
+/*
+ * WAL insertion, without flushing.  Non-transactional logical messages are
+ * the simplest records that can be inserted from an extension without side
+ * effects.
+ */
+static void
+bench_wal_insert(uint64 loops, instr_time *elapsed)
+{
+	char		message[WAL_MESSAGE_SIZE];
+	instr_time	start;
+
+	if (RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("recovery is in progress"),
+				 errhint("WAL can't be inserted during recovery.")));
+
+	memset(message, 'x', sizeof(message));
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+		(void) LogLogicalMessage("test_benchmarks", message, sizeof(message),
+								 false);
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+}
+
+/*
+ * Snapshot acquisition.  As long as no transaction completes meanwhile,
+ * GetSnapshotData() reuses the previous snapshot's contents; running write
+ * transactions concurrently measures the full path.
+ */
+static void
+bench_snapshot(uint64 loops, instr_time *elapsed)
+{
+	uint64		sum = 0;
+	instr_time	start;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (uint64 i = 0; i < loops; i++)
+		sum += GetLatestSnapshot()->xcnt;
+
+	INSTR_TIME_SET_CURRENT(*elapsed);
+	INSTR_TIME_SUBTRACT(*elapsed, start);
+
+	bench_sink += sum;
+}
+
+
+/*
+ * SQL-callable entry point: run one benchmark, or all of them if name is
+ * NULL, and return a row of results for each.
+ */
+Datum
+run_benchmarks(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	char	   *name = PG_ARGISNULL(0) ? NULL : text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int64		nloops = PG_ARGISNULL(1) ? 0 : PG_GETARG_INT64(1);
+	int32		nrepeats = PG_ARGISNULL(2) ? 5 : PG_GETARG_INT32(2);
+	MemoryContext bench_context;
+	bool		matched = false;
+
+	if (nloops < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of loops must not be negative")));
+	if (nrepeats < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of repeats must be at least 1")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	bench_context = AllocSetContextCreate(CurrentMemoryContext,
+										  "benchmark context",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	for (int i = 0; i < lengthof(bench_specs); i++)
+	{
+		const bench_spec *spec = &bench_specs[i];
+		uint64		loops = nloops > 0 ? (uint64) nloops : spec->default_loops;
+		double	   *ns_per_op;
+		Datum		values[6];
+		bool		nulls[6] = {0};
+		MemoryContext oldcontext;
+
+		if (name != NULL && strcmp(name, spec->name) != 0)
+			continue;
+		matched = true;
+
+		ns_per_op = palloc(nrepeats * sizeof(double));
+
+		for (int r = 0; r < nrepeats; r++)
+		{
+			instr_time	elapsed;
+
+			CHECK_FOR_INTERRUPTS();
+
+			oldcontext = MemoryContextSwitchTo(bench_context);
+			spec->function(loops, &elapsed);
+			MemoryContextSwitchTo(oldcontext);
+			MemoryContextReset(bench_context);
+
+			ns_per_op[r] = INSTR_TIME_GET_DOUBLE(elapsed) * 1e9 / loops;
+		}
+
+		qsort(ns_per_op, nrepeats, sizeof(double), compare_double);
+
+		values[0] = CStringGetTextDatum(spec->name);
+		values[1] = CStringGetTextDatum(spec->op);
+		values[2] = Int64GetDatum((int64) loops);
+		values[3] = Int32GetDatum(nrepeats);
+		values[4] = Float8GetDatum(ns_per_op[0]);
+		values[5] = Float8GetDatum(ns_per_op[nrepeats / 2]);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+		pfree(ns_per_op);
+	}
+
+	MemoryContextDelete(bench_context);
+
+	if (!matched)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unrecognized benchmark \"%s\"", name)));
+
+	return (Datum) 0;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	double		da = *(const double *) a;
+	double		db = *(const double *) b;
+
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
+
+/*
+ * Module load callbacks and initialization.
+ */
+
+static void
+test_benchmarks_shmem_request(void)
+{
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	RequestNamedLWLockTranche("test_benchmarks", 1);
+}
+
+void
+_PG_init(void)
+{
+	/*
+	 * Only the lwlock benchmark needs preloading, to set up its lock; the
+	 * others also work with the library loaded by CREATE EXTENSION.
+	 */
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	bench_lwlock_available = true;
+
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = test_benchmarks_shmem_request;
+}
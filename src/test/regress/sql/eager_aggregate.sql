@@ -0,0 +1,59 @@
+--
+-- EAGER AGGREGATE
+-- Test partial aggregation below joins
+--
+
+SET enable_eager_aggregate = on;
+
+CREATE TABLE eager_fact (dim_id int, val int);
+CREATE TABLE eager_dim (id int PRIMARY KEY, name text);
+
+INSERT INTO eager_fact SELECT i % 10, i FROM generate_series(1, 10000) i;
+INSERT INTO eager_dim SELECT i, 'dim ' || i FROM generate_series(0, 9) i;
+ANALYZE eager_fact, eager_dim;
+
+-- The fact table can be partially aggregated on its join column
+EXPLAIN (COSTS OFF)
+SELECT d.name, sum(f.val), count(*)
+  FROM eager_fact f JOIN eager_dim d ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+SELECT d.name, sum(f.val), count(*)
+  FROM eager_fact f JOIN eager_dim d ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+
+-- Same result without eager aggregation
+SET enable_eager_aggregate = off;
+SELECT d.name, sum(f.val), count(*)
+  FROM eager_fact f JOIN eager_dim d ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+SET enable_eager_aggregate = on;
+
+-- Only inner joins are handled; outer joins must not be aggregated early
+EXPLAIN (COSTS OFF)
+SELECT d.name, sum(f.val), count(*)
+  FROM eager_dim d LEFT JOIN eager_fact f ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+SELECT d.name, sum(f.val), count(*)
+  FROM eager_dim d LEFT JOIN eager_fact f ON f.dim_id = d.id
+  GROUP BY d.name ORDER BY d.name;
+
+-- Equal but distinguishable values must not be grouped before the join:
+-- numeric 1.0 and 1.00 are equal, but their text forms are not.
+CREATE TABLE eager_num (x numeric, val int);
+CREATE TABLE eager_str (s text);
+INSERT INTO eager_num SELECT '1.0', i FROM generate_series(1, 500) i;
+INSERT INTO eager_num SELECT '1.00', i FROM generate_series(1, 500) i;
+INSERT INTO eager_str VALUES ('1.0'), ('1.00');
+ANALYZE eager_num, eager_str;
+
+EXPLAIN (COSTS OFF)
+SELECT o.s, count(*), sum(n.val)
+  FROM eager_num n JOIN eager_str o ON n.x::text = o.s
+  GROUP BY o.s ORDER BY o.s;
+SELECT o.s, count(*), sum(n.val)
+  FROM eager_num n JOIN eager_str o ON n.x::text = o.s
+  GROUP BY o.s ORDER BY o.s;
+
+DROP TABLE eager_fact, eager_dim, eager_num, eager_str;
+
+RESET enable_eager_aggregate;
@@ -230,6 +230,7 @@ sub GenerateFiles
 		HAVE_COMPUTED_GOTO => undef,
 		HAVE_COPYFILE => undef,
 		HAVE_COPYFILE_H => undef,
+		HAVE_COPY_FILE_RANGE => undef,
 		HAVE_CRTDEFS_H => undef,
 		HAVE_CRYPTO_LOCK => undef,
 		HAVE_DECL_FDATASYNC => 0,
@@ -427,6 +428,7 @@ sub GenerateFiles
 		USE_ARMV8_CRC32C => undef,
 		USE_ARMV8_CRC32C_WITH_RUNTIME_CHECK => undef,
 		USE_ASSERT_CHECKING => $self->{options}->{asserts} ? 1 : undef,
+		USE_AVX512_CRC32C_WITH_RUNTIME_CHECK => undef,
 		USE_BONJOUR => undef,
 		USE_BSD_AUTH => undef,
 		USE_ICU => $self->{options}->{icu} ? 1 : undef,